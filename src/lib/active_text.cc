@@ -72,11 +72,15 @@ ActiveText::get_burnt (DCPTimePeriod period, bool always_burn_captions) const
 			continue;
 		}
 
-		for (auto j: i.second) {
-			DCPTimePeriod test (j.from, j.to.get_value_or(DCPTime::max()));
+		/* Periods which start at or after the end of the period of interest cannot overlap it,
+		 * and clear_before() removes those which have finished.
+		 */
+		auto const& by_from = i.second.by_from;
+		for (auto j = by_from.begin(); j != by_from.lower_bound(period.to); ++j) {
+			DCPTimePeriod test (j->second.from, j->second.to.get_value_or(DCPTime::max()));
 			auto overlap = period.overlap (test);
 			if (overlap && overlap->duration() > DCPTime(period.duration().get() / 2)) {
-				ps.push_back (j.subs);
+				ps.push_back (j->second.subs);
 			}
 		}
 	}
@@ -93,19 +97,23 @@ ActiveText::clear_before (DCPTime time)
 {
 	boost::mutex::scoped_lock lm (_mutex);
 
-	Map updated;
-	for (auto const& i: _data) {
-		list<Period> as;
-		for (auto j: i.second) {
-			if (!j.to || j.to.get() >= time) {
-				as.push_back (j);
+	for (auto i = _data.begin(); i != _data.end(); ) {
+		auto& periods = i->second;
+		auto const end = periods.by_to.lower_bound(time);
+		for (auto j = periods.by_to.begin(); j != end; ++j) {
+			if (periods.last && *periods.last == j->second) {
+				periods.last = boost::none;
 			}
+			periods.by_from.erase (j->second);
 		}
-		if (!as.empty ()) {
-			updated[i.first] = as;
+		periods.by_to.erase (periods.by_to.begin(), end);
+
+		if (periods.by_from.empty()) {
+			i = _data.erase (i);
+		} else {
+			++i;
 		}
 	}
-	_data = updated;
 }
 
 
@@ -119,10 +127,8 @@ ActiveText::add_from (weak_ptr<const TextContent> content, PlayerText ps, DCPTim
 {
 	boost::mutex::scoped_lock lm (_mutex);
 
-	if (_data.find(content) == _data.end()) {
-		_data[content] = list<Period>();
-	}
-	_data[content].push_back (Period (ps, from));
+	auto& periods = _data[content];
+	periods.last = periods.by_from.insert (make_pair(from, Period(ps, from)));
 }
 
 
@@ -136,15 +142,32 @@ ActiveText::add_to (weak_ptr<const TextContent> content, DCPTime to)
 {
 	boost::mutex::scoped_lock lm (_mutex);
 
-	DCPOMATIC_ASSERT (_data.find(content) != _data.end());
+	auto periods = _data.find(content);
+	DCPOMATIC_ASSERT (periods != _data.end());
+	DCPOMATIC_ASSERT (!periods->second.by_from.empty());
+
+	/* If the last period that was added has since been cleared, use the latest one that we have */
+	auto last = periods->second.last.get_value_or(std::prev(periods->second.by_from.end()));
+	auto& by_to = periods->second.by_to;
+	if (last->second.to) {
+		/* We already have a to time for this period, so forget it */
+		auto const existing = by_to.equal_range(*last->second.to);
+		for (auto i = existing.first; i != existing.second; ++i) {
+			if (i->second == last) {
+				by_to.erase (i);
+				break;
+			}
+		}
+	}
 
-	_data[content].back().to = to;
+	last->second.to = to;
+	by_to.insert (make_pair(to, last));
 
-	for (auto& i: _data[content].back().subs.string) {
+	for (auto& i: last->second.subs.string) {
 		i.set_out (dcp::Time(to.seconds(), 1000));
 	}
 
-	return make_pair (_data[content].back().subs, _data[content].back().from);
+	return make_pair (last->second.subs, last->second.from);
 }
 
 
@@ -161,7 +184,7 @@ ActiveText::have (weak_ptr<const TextContent> content) const
 		return false;
 	}
 
-	return !i->second.empty();
+	return !i->second.by_from.empty();
 }
 
 
@@ -71,7 +71,21 @@ private:
 		boost::optional<dcpomatic::DCPTime> to;
 	};
 
-	typedef std::map<std::weak_ptr<const TextContent>, std::list<Period>, std::owner_less<std::weak_ptr<const TextContent>>> Map;
+	/** Periods from one piece of content */
+	class Periods
+	{
+	public:
+		typedef std::multimap<dcpomatic::DCPTime, Period> ByFrom;
+
+		/** all periods, ordered by their from time */
+		ByFrom by_from;
+		/** periods which have a to time, ordered by it */
+		std::multimap<dcpomatic::DCPTime, ByFrom::iterator> by_to;
+		/** the period that was most recently given to add_from */
+		boost::optional<ByFrom::iterator> last;
+	};
+
+	typedef std::map<std::weak_ptr<const TextContent>, Periods, std::owner_less<std::weak_ptr<const TextContent>>> Map;
 
 	mutable boost::mutex _mutex;
 	Map _data;
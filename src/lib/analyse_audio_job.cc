@@ -21,13 +21,17 @@
 
 #include "analyse_audio_job.h"
 #include "audio_analysis.h"
+#include "audio_content.h"
 #include "compose.hpp"
 #include "dcpomatic_log.h"
 #include "film.h"
 #include "filter.h"
+#include "maths_util.h"
 #include "player.h"
 #include "playlist.h"
 #include "config.h"
+#include <boost/filesystem.hpp>
+#include <cmath>
 #include <iostream>
 
 #include "i18n.h"
@@ -41,6 +45,7 @@ using std::min;
 using std::shared_ptr;
 using std::string;
 using std::vector;
+using boost::optional;
 using namespace dcpomatic;
 #if BOOST_VERSION >= 106100
 using namespace boost::placeholders;
@@ -50,8 +55,8 @@ using namespace boost::placeholders;
 /** @param from_zero true to analyse audio from time 0 in the playlist, otherwise begin at Playlist::start */
 AnalyseAudioJob::AnalyseAudioJob (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist, bool from_zero)
 	: Job (film)
-	, _analyser (film, playlist, from_zero, boost::bind(&Job::set_progress, this, _1, false))
 	, _playlist (playlist)
+	, _from_zero (from_zero)
 	, _path (film->audio_analysis_path(playlist))
 {
 	LOG_DEBUG_AUDIO_ANALYSIS_NC("AnalyseAudioJob::AnalyseAudioJob");
@@ -78,37 +83,233 @@ AnalyseAudioJob::json_name () const
 }
 
 
+/** An analysis reads the content, not anything that an encode makes, so it need not wait for one */
+bool
+AnalyseAudioJob::depends_on (Job const& earlier) const
+{
+	return earlier.resource() != Resource::ENCODE && Job::depends_on(earlier);
+}
+
+
 void
 AnalyseAudioJob::run ()
 {
 	LOG_DEBUG_AUDIO_ANALYSIS_NC("AnalyseAudioJob::run");
 
-	auto player = make_shared<Player>(_film, _playlist);
+	auto analysis = make_analysis ();
+	analysis.write (_path);
+
+	LOG_DEBUG_AUDIO_ANALYSIS_NC("Job finished");
+	set_progress (1);
+	set_state (FINISHED_OK);
+}
+
+
+/** @return an analysis of our playlist, made whichever way is quicker */
+AudioAnalysis
+AnalyseAudioJob::make_analysis ()
+{
+	return can_compose() ? compose() : analyse(_playlist, _from_zero, boost::bind(&Job::set_progress, this, _1, false));
+}
+
+
+/** Analyse a playlist by decoding all its audio */
+AudioAnalysis
+AnalyseAudioJob::analyse (shared_ptr<const Playlist> playlist, bool from_zero, std::function<void (float)> set_progress) const
+{
+	AudioAnalyser analyser (_film, playlist, from_zero, set_progress);
+
+	auto player = make_shared<Player>(_film, playlist);
 	player->set_ignore_video ();
 	player->set_ignore_text ();
 	player->set_fast ();
 	player->set_play_referenced ();
-	player->Audio.connect (bind(&AudioAnalyser::analyse, &_analyser, _1, _2));
+	player->Audio.connect (bind(&AudioAnalyser::analyse, &analyser, _1, _2));
 
 	bool has_any_audio = false;
-	for (auto c: _playlist->content()) {
+	for (auto c: playlist->content()) {
 		if (c->audio) {
 			has_any_audio = true;
 		}
 	}
 
 	if (has_any_audio) {
-		player->seek (_analyser.start(), true);
+		player->seek (analyser.start(), true);
 		while (!player->pass ()) {}
 	}
 
 	LOG_DEBUG_AUDIO_ANALYSIS_NC("Loop complete");
 
-	_analyser.finish ();
-	auto analysis = _analyser.get();
-	analysis.write (_path);
+	analyser.finish ();
+	return analyser.get ();
+}
 
-	LOG_DEBUG_AUDIO_ANALYSIS_NC("Job finished");
-	set_progress (1);
-	set_state (FINISHED_OK);
+
+/** @return true if our analysis can be made from analyses of each piece of content in the playlist */
+bool
+AnalyseAudioJob::can_compose () const
+{
+	if (_film->audio_processor()) {
+		/* The processor works on the mix of all the content */
+		return false;
+	}
+
+	vector<DCPTimePeriod> periods;
+	for (auto content: _playlist->content()) {
+		if (content->audio) {
+			periods.push_back (DCPTimePeriod(content->position(), content->end(_film)));
+		}
+	}
+
+	if (periods.size() < 2) {
+		return false;
+	}
+
+	/* Overlapping content is mixed together, and its analyses cannot be combined */
+	for (size_t i = 0; i < periods.size(); ++i) {
+		for (size_t j = i + 1; j < periods.size(); ++j) {
+			if (periods[i].overlap(periods[j])) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/** Make our analysis by combining analyses of each piece of audio content, analysing
+ *  only the content whose analyses are not already on disk.  Gain changes since a piece
+ *  of content was analysed are applied to its analysis.  The loudness range cannot be
+ *  found this way so is not set.
+ */
+AudioAnalysis
+AnalyseAudioJob::compose ()
+{
+	/* The quietest level that the analyser records */
+	float const silence = 10e-7;
+
+	auto const rate = _film->audio_frame_rate();
+	auto const channels = _film->audio_channels();
+	auto const start = _from_zero ? DCPTime() : _playlist->start().get_value_or(DCPTime());
+	auto const length = (_playlist->length(_film) - start).frames_round(rate);
+	auto const samples_per_point = AudioAnalyser::samples_per_point(length);
+	auto const points = std::max(Frame(1), (length + samples_per_point - 1) / samples_per_point);
+
+	vector<vector<float>> peak(channels, vector<float>(points, silence));
+	vector<vector<double>> sum_of_squares(channels, vector<double>(points, 0));
+	vector<AudioAnalysis::PeakTime> sample_peak(channels, AudioAnalysis::PeakTime(0, DCPTime()));
+	optional<vector<float>> true_peak = vector<float>(channels, 0);
+	/* Sums of each piece's loudness (as power) multiplied by its duration in seconds */
+	optional<double> loudness_energy = 0.0;
+	optional<double> leqm_energy = 0.0;
+
+	ContentList content;
+	DCPTime total;
+	for (auto i: _playlist->content()) {
+		if (i->audio) {
+			content.push_back (i);
+			total += i->end(_film) - i->position();
+		}
+	}
+
+	DCPTime done;
+	for (auto i: content) {
+		auto single = make_shared<Playlist>();
+		single->add (_film, i);
+		auto const path = _film->audio_analysis_path(single);
+		auto const duration = i->end(_film) - i->position();
+
+		optional<AudioAnalysis> analysis;
+		if (boost::filesystem::exists(path)) {
+			try {
+				analysis = AudioAnalysis(path);
+			} catch (std::exception& e) {
+				LOG_GENERAL("Could not use existing audio analysis %1 (%2)", path.string(), e.what());
+			}
+		}
+
+		if (!analysis) {
+			analysis = analyse(single, false, [this, done, duration, total](float p) {
+				set_progress ((done.seconds() + p * duration.seconds()) / total.seconds(), false);
+			});
+			analysis->write (path);
+		}
+
+		auto const correction = analysis->gain_correction(single);
+		auto const gain = db_to_linear(correction);
+		auto const offset = (i->position() - start).frames_round(rate);
+		auto const content_samples_per_point = analysis->samples_per_point();
+
+		for (int c = 0; c < std::min(channels, analysis->channels()); ++c) {
+			for (int j = 0; j < analysis->points(c); ++j) {
+				auto point = analysis->get_point(c, j);
+				/* The analyser's first point is of one sample, and each later point j is of the
+				 * samples_per_point samples ending at j * samples_per_point.
+				 */
+				Frame const centre = offset + (j == 0 ? 0 : j * content_samples_per_point - content_samples_per_point / 2);
+				Frame const weight = j == 0 ? 1 : content_samples_per_point;
+				auto const k = std::max(Frame(0), std::min(Frame(points - 1), (centre + samples_per_point - 1) / samples_per_point));
+				peak[c][k] = max(peak[c][k], point[AudioPoint::PEAK] * float(gain));
+				sum_of_squares[c][k] += pow(point[AudioPoint::RMS] * gain, 2) * weight;
+			}
+		}
+
+		auto const content_sample_peak = analysis->sample_peak();
+		for (int c = 0; c < std::min(channels, static_cast<int>(content_sample_peak.size())); ++c) {
+			auto const p = content_sample_peak[c].peak * gain;
+			if (p > sample_peak[c].peak) {
+				sample_peak[c] = AudioAnalysis::PeakTime(p, content_sample_peak[c].time + i->position() - start);
+			}
+		}
+
+		auto const content_true_peak = analysis->true_peak();
+		if (true_peak && static_cast<int>(content_true_peak.size()) == channels) {
+			for (int c = 0; c < channels; ++c) {
+				(*true_peak)[c] = max((*true_peak)[c], float(content_true_peak[c] * gain));
+			}
+		} else {
+			true_peak = boost::none;
+		}
+
+		if (loudness_energy && analysis->integrated_loudness()) {
+			*loudness_energy += duration.seconds() * pow(10, (*analysis->integrated_loudness() + correction) / 10);
+		} else {
+			loudness_energy = boost::none;
+		}
+
+		if (leqm_energy && analysis->leqm()) {
+			*leqm_energy += duration.seconds() * pow(10, (*analysis->leqm() + correction) / 10);
+		} else {
+			leqm_energy = boost::none;
+		}
+
+		done += duration;
+		set_progress (done.seconds() / total.seconds(), false);
+	}
+
+	AudioAnalysis analysis (channels);
+	for (int c = 0; c < channels; ++c) {
+		for (int64_t k = 0; k < points; ++k) {
+			AudioPoint point;
+			point[AudioPoint::PEAK] = peak[c][k];
+			point[AudioPoint::RMS] = max(float(sqrt(sum_of_squares[c][k] / samples_per_point)), silence);
+			analysis.add_point (c, point);
+		}
+	}
+
+	analysis.set_sample_peak (sample_peak);
+	if (true_peak) {
+		analysis.set_true_peak (*true_peak);
+	}
+	if (loudness_energy && *loudness_energy > 0) {
+		analysis.set_integrated_loudness (10 * log10(*loudness_energy / total.seconds()));
+	}
+	if (leqm_energy && *leqm_energy > 0 && length > 0) {
+		/* Leq(m) is averaged over the whole of the analysis, including any silence */
+		analysis.set_leqm (10 * log10(*leqm_energy / (double(length) / rate)));
+	}
+	analysis.set_samples_per_point (samples_per_point);
+	analysis.set_sample_rate (rate);
+	return analysis;
 }
@@ -47,6 +47,10 @@ class Filter;
  *
  *  After computing the peak and RMS levels the job will write a file
  *  to Film::audio_analysis_path.
+ *
+ *  Where the audio content in the playlist does not overlap the analysis
+ *  is made by combining analyses of each piece of content, so that only
+ *  content which has changed since it was last analysed must be decoded.
  */
 class AnalyseAudioJob : public Job
 {
@@ -57,6 +61,10 @@ public:
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::DISK;
+	}
+	bool depends_on (Job const& earlier) const override;
 	bool enable_notify () const override {
 		return true;
 	}
@@ -65,10 +73,16 @@ public:
 		return _path;
 	}
 
+protected:
+	AudioAnalysis make_analysis ();
+
 private:
-	AudioAnalyser _analyser;
+	bool can_compose () const;
+	AudioAnalysis analyse (std::shared_ptr<const Playlist> playlist, bool from_zero, std::function<void (float)> set_progress) const;
+	AudioAnalysis compose ();
 
 	std::shared_ptr<const Playlist> _playlist;
+	bool _from_zero;
 	/** playlist's audio analysis path when the job was created */
 	boost::filesystem::path _path;
 
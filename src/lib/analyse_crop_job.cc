@@ -0,0 +1,122 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "analyse_crop_job.h"
+#include "content.h"
+#include "crop_analysis.h"
+#include "decoder.h"
+#include "decoder_factory.h"
+#include "film.h"
+#include "guess_crop.h"
+#include "video_content.h"
+
+#include "i18n.h"
+
+
+using std::shared_ptr;
+using std::string;
+using namespace dcpomatic;
+
+
+int const AnalyseCropJob::_frames = 16;
+
+
+AnalyseCropJob::AnalyseCropJob (shared_ptr<const Film> film, shared_ptr<const Content> content)
+	: Job (film)
+	, _content (content)
+	, _path (film->crop_analysis_path(content))
+{
+
+}
+
+
+AnalyseCropJob::~AnalyseCropJob ()
+{
+	stop_thread ();
+}
+
+
+string
+AnalyseCropJob::name () const
+{
+	return _("Analysing crop");
+}
+
+
+string
+AnalyseCropJob::json_name () const
+{
+	return N_("analyse_crop");
+}
+
+
+/** An analysis reads the content, not anything that an encode makes, so it need not wait for one */
+bool
+AnalyseCropJob::depends_on (Job const& earlier) const
+{
+	return earlier.resource() != Resource::ENCODE && Job::depends_on(earlier);
+}
+
+
+void
+AnalyseCropJob::run ()
+{
+	auto content = _content.lock ();
+	DCPOMATIC_ASSERT (content);
+	DCPOMATIC_ASSERT (content->video);
+
+	/* We only look at the first frame after an inaccurate seek, which will usually be a key frame,
+	   so fast decoding is fine here.
+	*/
+	auto decoder = decoder_factory (_film, content, true, true, {});
+	DCPOMATIC_ASSERT (decoder->video);
+
+	auto const rate = content->video_frame_rate().get_value_or(24);
+	auto const length = content->video->length();
+
+	BrightnessProfile profile;
+	int frames = 0;
+	int const samples = std::max(1, static_cast<int>(std::min(static_cast<int64_t>(_frames), length)));
+
+	for (int i = 0; i < samples; ++i) {
+		/* Look at the middle of each of `samples' equal parts of the content, which avoids the
+		   very start and end where there are often fades.
+		*/
+		auto const frame = (length * (i * 2 + 1)) / (samples * 2);
+		auto frame_profile = brightness_profile(decoder, ContentTime::from_frames(frame, rate));
+		if (frame_profile) {
+			if (!profile.rows.empty() && (profile.rows.size() != frame_profile->rows.size() || profile.columns.size() != frame_profile->columns.size())) {
+				/* Some frame of a different size, which we can't compare with the others */
+				continue;
+			}
+			profile.merge (*frame_profile);
+			++frames;
+		}
+		set_progress (static_cast<float>(i + 1) / samples);
+		check_for_interruption_or_pause ();
+	}
+
+	CropAnalysis analysis (profile, frames);
+	analysis.write (_path);
+
+	set_progress (1);
+	set_state (FINISHED_OK);
+}
@@ -0,0 +1,57 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "job.h"
+
+
+class Content;
+class Film;
+
+
+/** @class AnalyseCropJob
+ *  @brief A job to find the brightest parts of a number of frames spread through some content,
+ *  so that its black borders can be found without needing to look at it again.
+ */
+class AnalyseCropJob : public Job
+{
+public:
+	AnalyseCropJob (std::shared_ptr<const Film> film, std::shared_ptr<const Content> content);
+	~AnalyseCropJob ();
+
+	std::string name () const override;
+	std::string json_name () const override;
+	void run () override;
+	Resource resource () const override {
+		return Resource::LIGHT;
+	}
+	bool depends_on (Job const& earlier) const override;
+
+	boost::filesystem::path path () const {
+		return _path;
+	}
+
+private:
+	std::weak_ptr<const Content> _content;
+	boost::filesystem::path _path;
+
+	/** number of frames to look at */
+	static int const _frames;
+};
@@ -63,6 +63,14 @@ AnalyseSubtitlesJob::json_name () const
 }
 
 
+/** An analysis reads the content, not anything that an encode makes, so it need not wait for one */
+bool
+AnalyseSubtitlesJob::depends_on (Job const& earlier) const
+{
+	return earlier.resource() != Resource::ENCODE && Job::depends_on(earlier);
+}
+
+
 void
 AnalyseSubtitlesJob::run ()
 {
@@ -109,10 +117,10 @@ AnalyseSubtitlesJob::analyse (PlayerText text, TextType type)
 	if (!text.string.empty()) {
 		/* We can provide dummy values for time and frame rate here as they are only used to calculate fades */
 		dcp::Size const frame = _film->frame_size();
-		for (auto i: render_text(text.string, frame, dcpomatic::DCPTime(), 24)) {
+		for (auto i: bounding_boxes(text.string, frame, dcpomatic::DCPTime(), 24)) {
 			dcpomatic::Rect<double> rect (
-					double(i.position.x) / frame.width, double(i.position.y) / frame.height,
-					double(i.image->size().width) / frame.width, double(i.image->size().height) / frame.height
+					double(i.x) / frame.width, double(i.y) / frame.height,
+					double(i.width) / frame.width, double(i.height) / frame.height
 					);
 			if (!_bounding_box) {
 				_bounding_box = rect;
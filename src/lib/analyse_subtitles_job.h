@@ -36,6 +36,10 @@ public:
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::LIGHT;
+	}
+	bool depends_on (Job const& earlier) const override;
 
 	boost::filesystem::path path () const {
 		return _path;
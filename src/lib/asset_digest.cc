@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/** @file  src/lib/asset_digest.cc
+ *  @brief Calculation of the digests of asset files, which go into CPLs and PKLs.
+ */
+
+
+#include "asset_digest.h"
+#include "exceptions.h"
+#include <dcp/file.h>
+#include <openssl/evp.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <future>
+#include <vector>
+
+#include "i18n.h"
+
+
+using std::string;
+using std::vector;
+
+
+/** Size of the blocks that we read from the file; big reads are much faster
+ *  than small ones on network storage.
+ */
+static size_t const block_size = 4 * 1024 * 1024;
+
+
+/** @return Base64-encoded SHA-1 digest of @p file.  This is the same as dcp::Asset::hash()
+ *  would give, but each block is hashed while the next one is being read, so (for big assets
+ *  on slow storage) hashing costs almost nothing on top of reading the file once.
+ *  @param set_progress Called with the proportion of the file done so far; this may
+ *  throw to stop the calculation.
+ */
+string
+asset_digest (boost::filesystem::path file, std::function<void (float)> set_progress)
+{
+	dcp::File f(file, "rb");
+	if (!f) {
+		throw OpenFileError (file, errno, OpenFileError::READ);
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise (fileno(f.get()), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	auto const total = boost::filesystem::file_size (file);
+
+	auto read_block = [&f](vector<uint8_t>* block) {
+		return f.read(block->data(), 1, block->size());
+	};
+
+	vector<uint8_t> blocks[2] = { vector<uint8_t>(block_size), vector<uint8_t>(block_size) };
+	int current = 0;
+
+	auto context = EVP_MD_CTX_new ();
+	if (!context) {
+		throw CryptoError ("could not create digest context");
+	}
+	EVP_DigestInit_ex (context, EVP_sha1(), nullptr);
+
+	try {
+		boost::uintmax_t done = 0;
+		auto pending = std::async (std::launch::async, read_block, &blocks[current]);
+		while (done < total) {
+			auto const got = pending.get ();
+			if (got == 0) {
+				throw ReadFileError (file, errno);
+			}
+			auto const& full = blocks[current];
+			current = 1 - current;
+			done += got;
+			if (done < total) {
+				pending = std::async (std::launch::async, read_block, &blocks[current]);
+			}
+			EVP_DigestUpdate (context, full.data(), got);
+			set_progress (static_cast<float>(done) / total);
+		}
+	} catch (...) {
+		EVP_MD_CTX_free (context);
+		throw;
+	}
+
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int digest_length = 0;
+	EVP_DigestFinal_ex (context, digest, &digest_length);
+	EVP_MD_CTX_free (context);
+
+	/* Four output characters for every three input bytes, plus a terminator */
+	char encoded[EVP_MAX_MD_SIZE * 2];
+	EVP_EncodeBlock (reinterpret_cast<unsigned char*>(encoded), digest, digest_length);
+	return encoded;
+}
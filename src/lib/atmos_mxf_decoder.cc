@@ -23,6 +23,7 @@
 #include "atmos_decoder.h"
 #include "atmos_mxf_content.h"
 #include "atmos_mxf_decoder.h"
+#include "config.h"
 #include "dcpomatic_time.h"
 #include <dcp/atmos_asset.h>
 #include <dcp/atmos_asset_reader.h>
@@ -42,6 +43,16 @@ AtmosMXFDecoder::AtmosMXFDecoder (std::shared_ptr<const Film> film, std::shared_
 	_reader = asset->start_read ();
 	_reader->set_check_hmac (false);
 	_metadata = AtmosMetadata (asset);
+
+	auto const read_ahead = Config::instance()->mxf_read_ahead_frames();
+	if (read_ahead > 0) {
+		auto reader = _reader;
+		_prefetcher.reset (
+			new FramePrefetcher<shared_ptr<const dcp::AtmosFrame>>(
+				[reader](int64_t index) { return reader->get_frame(index); }, asset->intrinsic_duration(), read_ahead
+				)
+			);
+	}
 }
 
 
@@ -55,7 +66,7 @@ AtmosMXFDecoder::pass ()
 		return true;
 	}
 
-	atmos->emit (film(), _reader->get_frame(frame), frame, *_metadata);
+	atmos->emit (film(), _prefetcher ? _prefetcher->get(frame) : _reader->get_frame(frame), frame, *_metadata);
 	_next += dcpomatic::ContentTime::from_frames (1, vfr);
 	return false;
 }
@@ -22,6 +22,7 @@
 #include "atmos_metadata.h"
 #include "dcpomatic_time.h"
 #include "decoder.h"
+#include "frame_prefetcher.h"
 #include <dcp/atmos_asset_reader.h>
 
 
@@ -40,6 +41,8 @@ private:
 	std::shared_ptr<const AtmosMXFContent> _content;
 	dcpomatic::ContentTime _next;
 	std::shared_ptr<dcp::AtmosAssetReader> _reader;
+	/** thing to read ahead from _reader, if we are doing that */
+	std::unique_ptr<FramePrefetcher<std::shared_ptr<const dcp::AtmosFrame>>> _prefetcher;
 	boost::optional<AtmosMetadata> _metadata;
 };
 
@@ -31,6 +31,7 @@
 #include "filter.h"
 #include "playlist.h"
 #include "types.h"
+#include "util.h"
 #include <dcp/warnings.h>
 extern "C" {
 #include <leqm_nrt.h>
@@ -41,6 +42,7 @@ LIBDCP_DISABLE_WARNINGS
 #endif
 LIBDCP_ENABLE_WARNINGS
 }
+#include <algorithm>
 
 
 using std::make_shared;
@@ -51,6 +53,10 @@ using namespace dcpomatic;
 
 
 static auto constexpr num_points = 1024;
+/** Largest number of groups that we split channels into to find their points */
+static int const max_groups = 4;
+/** Largest number of blocks of audio that we queue up for our thread */
+static size_t const max_pending = 32;
 
 
 AudioAnalyser::AudioAnalyser (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist, bool from_zero, std::function<void (float)> set_progress)
@@ -121,35 +127,198 @@ AudioAnalyser::AudioAnalyser (shared_ptr<const Film> film, shared_ptr<const Play
 	DCPTime const length = _playlist->length (_film);
 
 	Frame const len = DCPTime (length - _start).frames_round (film->audio_frame_rate());
-	_samples_per_point = max (int64_t (1), len / num_points);
+	_samples_per_point = samples_per_point (len);
+
+	/* Find the points of groups of (at least two) channels in parallel, and the EBU R128 data alongside them */
+	_groups = std::max(1, std::min({max_groups, static_cast<int>(boost::thread::hardware_concurrency()), (film->audio_channels() + 1) / 2}));
+	_work = make_shared<boost::asio::io_service::work>(_service);
+	for (int i = 0; i < _groups; ++i) {
+		_pool.create_thread ([this]() {
+			start_of_thread ("AudioAnalyser");
+			_service.run ();
+		});
+	}
+
+	_thread = boost::thread (boost::bind(&AudioAnalyser::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread.native_handle(), "audio-analyser");
+#endif
+}
+
+
+/** @return Number of samples in each point of an analysis of some audio which is `length' frames long */
+Frame
+AudioAnalyser::samples_per_point (Frame length)
+{
+	return max (int64_t (1), length / num_points);
 }
 
 
 AudioAnalyser::~AudioAnalyser ()
 {
+	boost::this_thread::disable_interruption dis;
+
+	{
+		/* We may be destroyed without finish() being called, in which case nobody wants the rest of our analysis */
+		boost::mutex::scoped_lock lm (_mutex);
+		_pending.clear ();
+		_finishing = true;
+		_pending_changed.notify_all ();
+	}
+
+	try {
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+	} catch (...) {}
+
+	_work.reset ();
+	_service.stop ();
+
+	try {
+		_pool.join_all ();
+	} catch (...) {}
+
 	for (auto i: _filters) {
 		delete const_cast<Filter*> (i);
 	}
 }
 
 
+/** Queue some audio to be analysed; may block until our thread has caught up */
 void
 AudioAnalyser::analyse (shared_ptr<AudioBuffers> b, DCPTime time)
 {
 	LOG_DEBUG_AUDIO_ANALYSIS("Received %1 frames at %2", b->frames(), to_string(time));
 	DCPOMATIC_ASSERT (time >= _start);
 
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_pending.size() >= max_pending && !_failed) {
+			_pending_changed.wait (lm);
+		}
+
+		if (!_failed) {
+			_pending.push_back ({b, time});
+			_pending_changed.notify_all ();
+			return;
+		}
+	}
+
+	rethrow ();
+}
+
+
+void
+AudioAnalyser::thread ()
+try
+{
+	start_of_thread ("AudioAnalyser");
+
+	while (true) {
+		Block block;
+
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			while (_pending.empty() && !_finishing) {
+				_pending_changed.wait (lm);
+			}
+
+			if (_pending.empty()) {
+				return;
+			}
+
+			block = _pending.front ();
+			_pending.pop_front ();
+			_pending_changed.notify_all ();
+		}
+
+		process (block.audio, block.time);
+	}
+}
+catch (...)
+{
+	store_current ();
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_pending.clear ();
+	_failed = true;
+	_pending_changed.notify_all ();
+}
+
+
+void
+AudioAnalyser::process (shared_ptr<AudioBuffers> b, DCPTime time)
+{
+	int const frames = b->frames ();
+	int const channels = b->channels ();
+	vector<double> interleaved(frames * channels);
+
+	int const per_group = (channels + _groups - 1) / _groups;
+	vector<std::exception_ptr> errors (_groups);
+	boost::mutex mutex;
+	boost::condition condition;
+	int remaining = 0;
+
+	for (int i = 0; i < _groups; ++i) {
+		int const first = i * per_group;
+		int const count = std::min(per_group, channels - first);
+		if (count <= 0) {
+			break;
+		}
+
+		++remaining;
+		_service.post ([this, i, b, first, count, &interleaved, &errors, &mutex, &condition, &remaining]() {
+			try {
+				analyse_channels (b, first, count, interleaved);
+			} catch (...) {
+				errors[i] = std::current_exception ();
+			}
+			boost::mutex::scoped_lock lm (mutex);
+			--remaining;
+			condition.notify_all ();
+		});
+	}
+
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 	if (Config::instance()->analyse_ebur128 ()) {
 		_ebur128->process (b);
 	}
 #endif
 
+	{
+		boost::mutex::scoped_lock lm (mutex);
+		while (remaining > 0) {
+			condition.wait (lm);
+		}
+	}
+
+	for (auto const& i: errors) {
+		if (i) {
+			std::rethrow_exception (i);
+		}
+	}
+
+	_leqm->add(interleaved);
+
+	_done += frames;
+
+	DCPTime const length = _playlist->length (_film);
+	_set_progress ((time.seconds() - _start.seconds()) / (length.seconds() - _start.seconds()));
+	LOG_DEBUG_AUDIO_ANALYSIS_NC("Frames processed");
+}
+
+
+/** Find the points and sample peaks of some channels of some audio, and put their samples in an
+ *  interleaved buffer for leqm_nrt.  This is called for different channels at the same time.
+ */
+void
+AudioAnalyser::analyse_channels (shared_ptr<const AudioBuffers> b, int first, int count, vector<double>& interleaved)
+{
 	int const frames = b->frames ();
 	int const channels = b->channels ();
-	vector<double> interleaved(frames * channels);
 
-	for (int j = 0; j < channels; ++j) {
+	for (int j = first; j < first + count; ++j) {
 		float const* data = b->data(j);
 		for (int i = 0; i < frames; ++i) {
 			float s = data[i];
@@ -162,7 +331,7 @@ AudioAnalyser::analyse (shared_ptr<AudioBuffers> b, DCPTime time)
 				   values by replacing with this (140dB down) */
 				s = as = 10e-7;
 			}
-			_current[j][AudioPoint::RMS] += pow (s, 2);
+			_current[j][AudioPoint::RMS] += s * s;
 			_current[j][AudioPoint::PEAK] = max (_current[j][AudioPoint::PEAK], as);
 
 			if (as > _sample_peak[j]) {
@@ -177,20 +346,23 @@ AudioAnalyser::analyse (shared_ptr<AudioBuffers> b, DCPTime time)
 			}
 		}
 	}
-
-	_leqm->add(interleaved);
-
-	_done += frames;
-
-	DCPTime const length = _playlist->length (_film);
-	_set_progress ((time.seconds() - _start.seconds()) / (length.seconds() - _start.seconds()));
-	LOG_DEBUG_AUDIO_ANALYSIS_NC("Frames processed");
 }
 
 
 void
 AudioAnalyser::finish ()
 {
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_finishing = true;
+		_pending_changed.notify_all ();
+	}
+
+	if (_thread.joinable()) {
+		_thread.join ();
+	}
+	rethrow ();
+
 	vector<AudioAnalysis::PeakTime> sample_peak;
 	for (int i = 0; i < _film->audio_channels(); ++i) {
 		sample_peak.push_back (
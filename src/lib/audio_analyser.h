@@ -21,9 +21,14 @@
 
 #include "audio_analysis.h"
 #include "dcpomatic_time.h"
+#include "exception_store.h"
 #include "types.h"
 #include <leqm_nrt.h>
+#include <boost/asio.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <list>
 #include <memory>
 
 
@@ -36,7 +41,14 @@ class Filter;
 class Playlist;
 
 
-class AudioAnalyser
+/** @class AudioAnalyser
+ *  @brief Analyser of the audio of a playlist.
+ *
+ *  Audio given to analyse() is analysed on a separate thread, so that the caller can carry on
+ *  decoding, with the points of groups of channels being found in parallel.  finish() waits
+ *  for all the audio to be analysed, and re-throws any exception thrown while analysing.
+ */
+class AudioAnalyser : public ExceptionStore
 {
 public:
 	AudioAnalyser (std::shared_ptr<const Film> film, std::shared_ptr<const Playlist> playlist, bool from_zero, std::function<void (float)> set_progress);
@@ -57,7 +69,13 @@ public:
 		return _analysis;
 	}
 
+	static Frame samples_per_point (Frame length);
+
 private:
+	void thread ();
+	void process (std::shared_ptr<AudioBuffers> b, dcpomatic::DCPTime time);
+	void analyse_channels (std::shared_ptr<const AudioBuffers> b, int first, int count, std::vector<double>& interleaved);
+
 	std::shared_ptr<const Film> _film;
 	std::shared_ptr<const Playlist> _playlist;
 
@@ -77,5 +95,30 @@ private:
 	std::vector<AudioPoint> _current;
 
 	AudioAnalysis _analysis;
+
+	struct Block
+	{
+		std::shared_ptr<AudioBuffers> audio;
+		dcpomatic::DCPTime time;
+	};
+
+	/** Mutex for _pending, _finishing and _failed */
+	boost::mutex _mutex;
+	/** Audio which has been given to analyse() but not yet analysed */
+	std::list<Block> _pending;
+	/** Condition which is signalled when _pending, _finishing or _failed change */
+	boost::condition _pending_changed;
+	/** true when no more audio will be given to analyse() */
+	bool _finishing = false;
+	/** true if our thread has stopped because of an error */
+	bool _failed = false;
+
+	/** Number of groups of channels whose points are found in parallel */
+	int _groups = 1;
+	boost::asio::io_service _service;
+	std::shared_ptr<boost::asio::io_service::work> _work;
+	boost::thread_group _pool;
+
+	boost::thread _thread;
 };
 
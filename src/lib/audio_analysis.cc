@@ -21,20 +21,22 @@
 
 #include "audio_analysis.h"
 #include "cross.h"
+#include "exceptions.h"
+#include "maths_util.h"
 #include "util.h"
 #include "playlist.h"
 #include "audio_content.h"
+#include <dcp/exceptions.h>
+#include <dcp/file.h>
 #include <dcp/raw_convert.h>
-#include <dcp/warnings.h>
-LIBDCP_DISABLE_WARNINGS
-#include <libxml++/libxml++.h>
-LIBDCP_ENABLE_WARNINGS
 #include <boost/filesystem.hpp>
 #include <stdint.h>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <inttypes.h>
+#include <type_traits>
 
 
 using std::cout;
@@ -54,7 +56,57 @@ using dcp::raw_convert;
 using namespace dcpomatic;
 
 
-int const AudioAnalysis::_current_state_version = 3;
+/* Version 3 was the last to be written as XML; we can still read (import) that */
+int const AudioAnalysis::_current_state_version = 4;
+static int const last_xml_state_version = 3;
+
+/** Written at the start of binary analysis files, followed by the version */
+static char const binary_magic[8] = { 'D', 'C', 'P', 'O', 'M', 'A', 'A', 'N' };
+
+/* Bits in the flags word of a binary analysis file saying which optional values are present */
+static int32_t const has_integrated_loudness = 0x1;
+static int32_t const has_loudness_range = 0x2;
+static int32_t const has_leqm = 0x4;
+static int32_t const has_analysis_gain = 0x8;
+
+static_assert (sizeof(AudioPoint) == AudioPoint::COUNT * sizeof(float), "AudioPoint must be an array of floats");
+static_assert (std::is_trivially_copyable<AudioPoint>::value, "AudioPoint must be trivially copyable");
+
+
+/** @return Size of the part of a binary analysis file which comes before the points */
+static int64_t
+index_size (int channels, int sample_peaks, int true_peaks)
+{
+	/* magic, 6 x int32_t, 2 x float, 1 x int64_t, 2 x double */
+	int64_t const header = sizeof(binary_magic) + 6 * 4 + 2 * 4 + 3 * 8;
+	return header + sample_peaks * (4 + 8) + true_peaks * 4 + channels * 8;
+}
+
+
+/** @return Offset within a binary analysis file of its block of points, which is 8-byte aligned */
+static int64_t
+points_offset (int channels, int sample_peaks, int true_peaks)
+{
+	return (index_size(channels, sample_peaks, true_peaks) + 7) & ~int64_t(7);
+}
+
+
+template <class T>
+static void
+write_value (dcp::File& f, T value)
+{
+	f.checked_write (&value, sizeof(T));
+}
+
+
+template <class T>
+static T
+read_value (dcp::File& f)
+{
+	T value;
+	f.checked_read (&value, sizeof(T));
+	return value;
+}
 
 
 AudioAnalysis::AudioAnalysis (int channels)
@@ -63,12 +115,113 @@ AudioAnalysis::AudioAnalysis (int channels)
 }
 
 
+/** Read an analysis which was written by write(), or import one from an XML file as
+ *  written by older versions of DCP-o-matic.
+ */
 AudioAnalysis::AudioAnalysis (boost::filesystem::path filename)
+{
+	dcp::File f (filename, "rb");
+	if (!f) {
+		throw OpenFileError (filename, errno, OpenFileError::READ);
+	}
+
+	char magic[sizeof(binary_magic)];
+	if (f.read(magic, 1, sizeof(magic)) == sizeof(magic) && memcmp(magic, binary_magic, sizeof(magic)) == 0) {
+		try {
+			read_binary (f, filename);
+		} catch (dcp::FileError& e) {
+			throw FileError ("Audio analysis file is too short", filename);
+		}
+	} else {
+		f.close ();
+		read_xml (filename);
+	}
+}
+
+
+/** Read a binary analysis; the magic number has already been read from f.
+ *
+ *  The file contains a header of fixed-size values, then the sample and true peaks,
+ *  then the number of points in each channel.  The points for all channels follow as one
+ *  contiguous, 8-byte aligned block of AudioPoint arrays, so each channel can be read straight
+ *  into memory (or mapped) without any parsing.
+ */
+void
+AudioAnalysis::read_binary (dcp::File& f, boost::filesystem::path filename)
+{
+	if (read_value<int32_t>(f) != _current_state_version) {
+		/* Too old (or too new).  Throw an exception so that this analysis is re-run. */
+		throw OldFormatError ("Audio analysis file has the wrong version");
+	}
+
+	auto const channels = read_value<int32_t>(f);
+	_samples_per_point = read_value<int64_t>(f);
+	_sample_rate = read_value<int32_t>(f);
+	auto const flags = read_value<int32_t>(f);
+	auto const integrated_loudness = read_value<float>(f);
+	auto const loudness_range = read_value<float>(f);
+	auto const leqm = read_value<double>(f);
+	auto const analysis_gain = read_value<double>(f);
+	auto const sample_peaks = read_value<int32_t>(f);
+	auto const true_peaks = read_value<int32_t>(f);
+
+	if (channels < 0 || sample_peaks < 0 || true_peaks < 0) {
+		throw FileError ("Unexpected audio analysis file header", filename);
+	}
+
+	if (flags & has_integrated_loudness) {
+		_integrated_loudness = integrated_loudness;
+	}
+	if (flags & has_loudness_range) {
+		_loudness_range = loudness_range;
+	}
+	if (flags & has_leqm) {
+		_leqm = leqm;
+	}
+	if (flags & has_analysis_gain) {
+		_analysis_gain = analysis_gain;
+	}
+
+	for (int32_t i = 0; i < sample_peaks; ++i) {
+		auto const peak = read_value<float>(f);
+		auto const time = read_value<int64_t>(f);
+		_sample_peak.push_back (PeakTime(peak, DCPTime(time)));
+	}
+
+	_true_peak.resize (true_peaks);
+	if (true_peaks > 0) {
+		f.checked_read (_true_peak.data(), true_peaks * sizeof(float));
+	}
+
+	vector<int64_t> points(channels);
+	if (channels > 0) {
+		f.checked_read (points.data(), channels * sizeof(int64_t));
+	}
+
+	if (f.seek(points_offset(channels, sample_peaks, true_peaks), SEEK_SET) != 0) {
+		throw FileError ("Audio analysis file is too short", filename);
+	}
+
+	_data.resize (channels);
+	for (int32_t i = 0; i < channels; ++i) {
+		if (points[i] < 0) {
+			throw FileError ("Unexpected audio analysis file header", filename);
+		}
+		_data[i].resize (points[i]);
+		if (points[i] > 0) {
+			f.checked_read (_data[i].data(), points[i] * sizeof(AudioPoint));
+		}
+	}
+}
+
+
+void
+AudioAnalysis::read_xml (boost::filesystem::path filename)
 {
 	cxml::Document f ("AudioAnalysis");
 	f.read_file (filename);
 
-	if (f.optional_number_child<int>("Version").get_value_or(1) < _current_state_version) {
+	if (f.optional_number_child<int>("Version").get_value_or(1) < last_xml_state_version) {
 		/* Too old.  Throw an exception so that this analysis is re-run. */
 		throw OldFormatError ("Audio analysis file is too old");
 	}
@@ -137,51 +290,71 @@ AudioAnalysis::points (int c) const
 }
 
 
+/** Write this analysis in the binary format described by read_binary() */
 void
 AudioAnalysis::write (boost::filesystem::path filename)
 {
-	auto doc = make_shared<xmlpp::Document>();
-	xmlpp::Element* root = doc->create_root_node ("AudioAnalysis");
-
-	root->add_child("Version")->add_child_text(raw_convert<string>(_current_state_version));
-
-	for (auto& i: _data) {
-		auto channel = root->add_child ("Channel");
-		for (auto& j: i) {
-			j.as_xml (channel->add_child ("Point"));
+	auto const tmp = filename.string() + ".tmp";
+	{
+		dcp::File f (tmp, "wb");
+		if (!f) {
+			throw OpenFileError (tmp, errno, OpenFileError::WRITE);
 		}
-	}
-
-	for (size_t i = 0; i < _sample_peak.size(); ++i) {
-		auto n = root->add_child("SamplePeak");
-		n->add_child_text (raw_convert<string> (_sample_peak[i].peak));
-		n->set_attribute ("Time", raw_convert<string> (_sample_peak[i].time.get()));
-	}
 
-	for (auto i: _true_peak) {
-		root->add_child("TruePeak")->add_child_text (raw_convert<string> (i));
-	}
+		int32_t flags = 0;
+		if (_integrated_loudness) {
+			flags |= has_integrated_loudness;
+		}
+		if (_loudness_range) {
+			flags |= has_loudness_range;
+		}
+		if (_leqm) {
+			flags |= has_leqm;
+		}
+		if (_analysis_gain) {
+			flags |= has_analysis_gain;
+		}
 
-	if (_integrated_loudness) {
-		root->add_child("IntegratedLoudness")->add_child_text (raw_convert<string> (_integrated_loudness.get ()));
-	}
+		f.checked_write (binary_magic, sizeof(binary_magic));
+		write_value<int32_t> (f, _current_state_version);
+		write_value<int32_t> (f, _data.size());
+		write_value<int64_t> (f, _samples_per_point);
+		write_value<int32_t> (f, _sample_rate);
+		write_value<int32_t> (f, flags);
+		write_value<float> (f, _integrated_loudness.get_value_or(0));
+		write_value<float> (f, _loudness_range.get_value_or(0));
+		write_value<double> (f, _leqm.get_value_or(0));
+		write_value<double> (f, _analysis_gain.get_value_or(0));
+		write_value<int32_t> (f, _sample_peak.size());
+		write_value<int32_t> (f, _true_peak.size());
+
+		for (auto const& i: _sample_peak) {
+			write_value<float> (f, i.peak);
+			write_value<int64_t> (f, i.time.get());
+		}
 
-	if (_loudness_range) {
-		root->add_child("LoudnessRange")->add_child_text (raw_convert<string> (_loudness_range.get ()));
-	}
+		if (!_true_peak.empty()) {
+			f.checked_write (_true_peak.data(), _true_peak.size() * sizeof(float));
+		}
 
-	if (_analysis_gain) {
-		root->add_child("AnalysisGain")->add_child_text (raw_convert<string> (_analysis_gain.get ()));
-	}
+		for (auto const& i: _data) {
+			write_value<int64_t> (f, i.size());
+		}
 
-	root->add_child("SamplesPerPoint")->add_child_text (raw_convert<string> (_samples_per_point));
-	root->add_child("SampleRate")->add_child_text (raw_convert<string> (_sample_rate));
+		char const zeros[8] = { 0 };
+		auto const padding = points_offset(_data.size(), _sample_peak.size(), _true_peak.size()) - index_size(_data.size(), _sample_peak.size(), _true_peak.size());
+		if (padding > 0) {
+			f.checked_write (zeros, padding);
+		}
 
-	if (_leqm) {
-		root->add_child("Leqm")->add_child_text(raw_convert<string>(*_leqm));
+		for (auto const& i: _data) {
+			if (!i.empty()) {
+				f.checked_write (i.data(), i.size() * sizeof(AudioPoint));
+			}
+		}
 	}
 
-	doc->write_to_file_formatted (filename.string ());
+	boost::filesystem::rename (tmp, filename);
 }
 
 
@@ -201,6 +374,44 @@ AudioAnalysis::gain_correction (shared_ptr<const Playlist> playlist)
 }
 
 
+/** Change this analysis to be what it would have been had all the audio been played
+ *  with an extra gain.
+ *  @param db Gain in dB.
+ */
+void
+AudioAnalysis::apply_gain (double db)
+{
+	auto const linear = db_to_linear (db);
+
+	for (auto& channel: _data) {
+		for (auto& point: channel) {
+			point[AudioPoint::PEAK] *= linear;
+			point[AudioPoint::RMS] *= linear;
+		}
+	}
+
+	for (auto& i: _sample_peak) {
+		i.peak *= linear;
+	}
+
+	for (auto& i: _true_peak) {
+		i *= linear;
+	}
+
+	if (_integrated_loudness) {
+		*_integrated_loudness += db;
+	}
+
+	if (_leqm) {
+		*_leqm += db;
+	}
+
+	if (_analysis_gain) {
+		*_analysis_gain += db;
+	}
+}
+
+
 /** @return Peak across all channels, and the channel number it is on */
 pair<AudioAnalysis::PeakTime, int>
 AudioAnalysis::overall_sample_peak () const
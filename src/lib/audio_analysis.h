@@ -31,8 +31,8 @@
 #include <vector>
 
 
-namespace xmlpp {
-	class Element;
+namespace dcp {
+	class File;
 }
 
 
@@ -132,8 +132,12 @@ public:
 	void write (boost::filesystem::path);
 
 	float gain_correction (std::shared_ptr<const Playlist> playlist);
+	void apply_gain (double db);
 
 private:
+	void read_binary (dcp::File& file, boost::filesystem::path filename);
+	void read_xml (boost::filesystem::path filename);
+
 	std::vector<std::vector<AudioPoint>> _data;
 	std::vector<PeakTime> _sample_peak;
 	std::vector<float> _true_peak;
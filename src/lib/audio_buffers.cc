@@ -21,17 +21,24 @@
 
 #include "audio_buffers.h"
 #include "dcpomatic_assert.h"
+#include "image_pool.h"
 #include "maths_util.h"
-#include "scope_guard.h"
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <cmath>
 
 
+using std::max;
+using std::min;
 using std::shared_ptr;
 using std::make_shared;
 
 
+/** Number of floats that each channel's data is aligned to */
+static int const alignment = 16;
+
+
 /** Construct a silent AudioBuffers */
 AudioBuffers::AudioBuffers (int channels, int frames)
 {
@@ -63,6 +70,12 @@ AudioBuffers::AudioBuffers (std::shared_ptr<const AudioBuffers> other, int frame
 }
 
 
+AudioBuffers::~AudioBuffers ()
+{
+	ImagePool::instance()->put(reinterpret_cast<uint8_t*>(_block), _channels * _stride * sizeof(float));
+}
+
+
 AudioBuffers &
 AudioBuffers::operator= (AudioBuffers const & other)
 {
@@ -77,18 +90,48 @@ AudioBuffers::operator= (AudioBuffers const & other)
 }
 
 
+/** Set our size.  Any samples that we had before within the new size are kept,
+ *  and any new ones are silent.
+ */
 void
 AudioBuffers::allocate (int channels, int frames)
 {
 	DCPOMATIC_ASSERT (frames >= 0);
 	DCPOMATIC_ASSERT (channels > 0);
 
-	ScopeGuard sg = [this]() { update_data_pointers(); };
+	if (_block && channels == _channels && frames <= _stride) {
+		/* There is already room */
+		if (frames > _frames) {
+			for (int channel = 0; channel < channels; ++channel) {
+				memset (_data_pointers[channel] + _frames, 0, (frames - _frames) * sizeof(float));
+			}
+		}
+		_frames = frames;
+		return;
+	}
 
-	_data.resize(channels);
+	/* If we are growing, leave some room to grow into as append() may be called many times */
+	auto stride = _block && channels == _channels ? max(frames, _stride * 2) : max(frames, 1);
+	stride = ((stride + alignment - 1) / alignment) * alignment;
+
+	auto block = reinterpret_cast<float*>(ImagePool::instance()->get(channels * stride * sizeof(float)));
 	for (int channel = 0; channel < channels; ++channel) {
-		_data[channel].resize(frames);
+		auto to = block + channel * stride;
+		int keep = 0;
+		if (_block && channel < _channels) {
+			keep = min(_frames, frames);
+			memcpy (to, _data_pointers[channel], keep * sizeof(float));
+		}
+		memset (to + keep, 0, (frames - keep) * sizeof(float));
 	}
+
+	ImagePool::instance()->put(reinterpret_cast<uint8_t*>(_block), _channels * _stride * sizeof(float));
+
+	_block = block;
+	_channels = channels;
+	_frames = frames;
+	_stride = stride;
+	update_data_pointers ();
 }
 
 
@@ -99,7 +142,7 @@ float*
 AudioBuffers::data (int channel)
 {
 	DCPOMATIC_ASSERT (channel >= 0 && channel < channels());
-	return _data[channel].data();
+	return _data_pointers[channel];
 }
 
 
@@ -110,7 +153,7 @@ float const*
 AudioBuffers::data (int channel) const
 {
 	DCPOMATIC_ASSERT (channel >= 0 && channel < channels());
-	return _data[channel].data();
+	return _data_pointers[channel];
 }
 
 
@@ -118,7 +161,7 @@ AudioBuffers::data (int channel) const
 void
 AudioBuffers::set_frames (int frames)
 {
-	allocate(_data.size(), frames);
+	allocate(_channels, frames);
 }
 
 
@@ -227,12 +270,7 @@ AudioBuffers::accumulate_channel (AudioBuffers const * from, int from_channel, i
 	DCPOMATIC_ASSERT (from->frames() == N);
 	DCPOMATIC_ASSERT (to_channel <= channels());
 
-	auto s = from->data (from_channel);
-	auto d = data(to_channel);
-
-	for (int i = 0; i < N; ++i) {
-		*d++ += (*s++) * gain;
-	}
+	accumulate_samples (data(to_channel), from->data(from_channel), N, gain);
 }
 
 
@@ -249,11 +287,8 @@ AudioBuffers::accumulate_frames (AudioBuffers const * from, int frames, int read
 	DCPOMATIC_ASSERT (read_offset >= 0);
 	DCPOMATIC_ASSERT (write_offset >= 0);
 
-	auto from_data = from->data ();
 	for (int i = 0; i < channels(); ++i) {
-		for (int j = 0; j < frames; ++j) {
-			_data[i][j + write_offset] += from_data[i][j + read_offset];
-		}
+		accumulate_samples (data(i) + write_offset, from->data(i) + read_offset, frames, 1);
 	}
 }
 
@@ -265,9 +300,7 @@ AudioBuffers::apply_gain (float dB)
 	auto const linear = db_to_linear (dB);
 
 	for (int i = 0; i < channels(); ++i) {
-		for (int j = 0; j < frames(); ++j) {
-			_data[i][j] *= linear;
-		}
+		scale_samples (data(i), frames(), linear);
 	}
 }
 
@@ -329,9 +362,9 @@ AudioBuffers::trim_start (int frames_to_trim)
 void
 AudioBuffers::update_data_pointers ()
 {
-        _data_pointers.resize (channels());
-        for (int i = 0; i < channels(); ++i) {
-                _data_pointers[i] = _data[i].data();
-        }
+	_data_pointers.resize (_channels);
+	for (int i = 0; i < _channels; ++i) {
+		_data_pointers[i] = _block + i * _stride;
+	}
 }
 
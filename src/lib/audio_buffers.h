@@ -34,6 +34,9 @@
 
 /** @class AudioBuffers
  *  @brief A class to hold multi-channel audio data in float format.
+ *
+ *  The samples for all channels are kept in one block from the ImagePool, with each
+ *  channel's data starting on an aligned boundary.
  */
 class AudioBuffers
 {
@@ -42,6 +45,7 @@ public:
 	AudioBuffers (AudioBuffers const &);
 	explicit AudioBuffers (std::shared_ptr<const AudioBuffers>);
 	AudioBuffers (std::shared_ptr<const AudioBuffers> other, int frames_to_copy, int read_offset);
+	~AudioBuffers ();
 
 	AudioBuffers & operator= (AudioBuffers const &);
 
@@ -56,11 +60,11 @@ public:
 	float* data (int);
 
 	int channels () const {
-		return _data.size();
+		return _channels;
 	}
 
 	int frames () const {
-		return _data[0].size();
+		return _frames;
 	}
 
 	void set_frames (int f);
@@ -83,9 +87,13 @@ private:
 	void allocate (int channels, int frames);
 	void update_data_pointers ();
 
-	/** Audio data (so that, e.g. _data[2][6] is channel 2, sample 6) */
-	std::vector<std::vector<float>> _data;
-	/** Pointers to the data of each vector in _data */
+	int _channels = 0;
+	int _frames = 0;
+	/** Number of floats between the start of one channel's data and the next */
+	int _stride = 0;
+	/** Audio data, so that _block[2 * _stride + 6] is channel 2, sample 6 */
+	float* _block = nullptr;
+	/** Pointers to the start of each channel's data in _block */
 	std::vector<float*> _data_pointers;
 };
 
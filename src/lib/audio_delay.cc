@@ -22,11 +22,13 @@
 #include "audio_delay.h"
 #include "audio_buffers.h"
 #include "dcpomatic_assert.h"
+#include <algorithm>
 #include <iostream>
 
 
 using std::cout;
 using std::make_shared;
+using std::min;
 using std::shared_ptr;
 
 
@@ -43,45 +45,38 @@ AudioDelay::run (shared_ptr<const AudioBuffers> in)
 	/* You can't call this with varying channel counts */
 	DCPOMATIC_ASSERT (!_tail || in->channels() == _tail->channels());
 
-	auto out = make_shared<AudioBuffers>(in->channels(), in->frames());
+	auto const frames = in->frames();
+	auto out = make_shared<AudioBuffers>(in->channels(), frames);
 
-	if (in->frames() > _samples) {
-
-		if (!_tail) {
-			/* No tail; use silence */
-			out->make_silent (0, _samples);
-		} else {
-			/* Copy tail */
-			out->copy_from (_tail.get(), _samples, 0, 0);
-		}
-
-		/* Copy in to out */
-		out->copy_from (in.get(), in->frames() - _samples, 0, _samples);
-
-		/* Keep tail */
-		if (!_tail) {
-			_tail = make_shared<AudioBuffers>(in->channels(), _samples);
-		}
-		_tail->copy_from (in.get(), _samples, in->frames() - _samples, 0);
-
-	} else {
+	if (_samples == 0) {
+		out->copy_from (in.get(), frames, 0, 0);
+		return out;
+	}
 
-		/* First part of the tail into the output */
-		if (_tail) {
-			out->copy_from (_tail.get(), out->frames(), 0, 0);
-		} else {
-			out->make_silent ();
-			_tail = make_shared<AudioBuffers>(out->channels(), _samples);
-			_tail->make_silent ();
-		}
+	if (!_tail) {
+		/* No tail; use silence */
+		_tail = make_shared<AudioBuffers>(in->channels(), _samples);
+		_tail->make_silent ();
+		_position = 0;
+	}
 
-		/* Shuffle the tail down */
-		_tail->move (_tail->frames() - out->frames(), out->frames(), 0);
+	/* The oldest part of the tail comes out first */
+	auto const from_tail = min(frames, _samples);
+	auto const first = min(from_tail, _samples - _position);
+	out->copy_from (_tail.get(), first, _position, 0);
+	out->copy_from (_tail.get(), from_tail - first, 0, first);
 
-		/* Copy input into the tail */
-		_tail->copy_from (in.get(), in->frames(), 0, _tail->frames() - in->frames());
+	/* Then any of the input that has been delayed enough already */
+	if (frames > _samples) {
+		out->copy_from (in.get(), frames - _samples, 0, _samples);
 	}
 
+	/* The end of the input replaces what we took from the tail */
+	auto const keep_from = frames - from_tail;
+	_tail->copy_from (in.get(), first, keep_from, _position);
+	_tail->copy_from (in.get(), from_tail - first, keep_from + first, 0);
+	_position = (_position + from_tail) % _samples;
+
 	return out;
 }
 
@@ -90,4 +85,5 @@ void
 AudioDelay::flush ()
 {
 	_tail.reset ();
+	_position = 0;
 }
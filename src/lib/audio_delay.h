@@ -26,7 +26,7 @@ class AudioBuffers;
 
 
 /** @class AudioDelay
- *  @brief An audio delay line
+ *  @brief An audio delay line, kept in a circular buffer so that running it only copies samples
  */
 class AudioDelay
 {
@@ -36,6 +36,8 @@ public:
 	void flush ();
 
 private:
+	/** The last _samples frames that we were given, oldest first starting at _position and wrapping round */
 	std::shared_ptr<AudioBuffers> _tail;
+	int _position = 0;
 	int _samples;
 };
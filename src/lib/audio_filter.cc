@@ -21,14 +21,17 @@
 
 #include "audio_filter.h"
 #include "audio_buffers.h"
+#include "dcpomatic_assert.h"
 #include "maths_util.h"
 #include "util.h"
+#include <algorithm>
 #include <cmath>
 
 
 using std::make_shared;
 using std::min;
 using std::shared_ptr;
+using std::vector;
 
 
 std::vector<float>
@@ -74,6 +77,10 @@ AudioFilter::sinc_blackman (float cutoff, bool invert) const
 }
 
 
+/** Smallest kernel for which we convolve using FFTs; below this the direct method is quicker */
+static int const fft_min_taps = 64;
+
+
 shared_ptr<AudioBuffers>
 AudioFilter::run (shared_ptr<const AudioBuffers> in)
 {
@@ -84,34 +91,179 @@ AudioFilter::run (shared_ptr<const AudioBuffers> in)
 		_tail->make_silent ();
 	}
 
-	int const channels = in->channels ();
-	int const frames = in->frames ();
-
-	for (int i = 0; i < channels; ++i) {
-		auto tail_p = _tail->data (i);
-		auto in_p = in->data (i);
-		auto out_p = out->data (i);
-		for (int j = 0; j < frames; ++j) {
-			float s = 0;
-			for (int k = 0; k <= _M; ++k) {
-				if ((j - k) < 0) {
-					s += tail_p[j - k + _M + 1] * _ir[k];
-				} else {
-					s += in_p[j - k] * _ir[k];
-				}
-			}
+	for (int i = 0; i < in->channels(); ++i) {
+		run_channel (i, in->data(i), in->frames(), out->data(i));
+	}
+
+	return out;
+}
+
+
+/** Filter some samples of a single channel straight from one buffer into another, so that
+ *  callers which already have the samples in place need not make AudioBuffers for them.
+ *  A filter used this way must not also be used with the AudioBuffers version of run().
+ */
+void
+AudioFilter::run (float const* in, int frames, float* out)
+{
+	if (!_tail) {
+		_tail = make_shared<AudioBuffers>(1, _M + 1);
+		_tail->make_silent ();
+	}
+
+	DCPOMATIC_ASSERT (_tail->channels() == 1);
+	run_channel (0, in, frames, out);
+}
+
 
-			out_p[j] = s;
+void
+AudioFilter::run_channel (int channel, float const* in, int frames, float* out)
+{
+	int const taps = _M + 1;
+
+	/* The channel's input with the last _M samples of the previous input before it */
+	_history.resize (_M + frames);
+	auto tail = _tail->data(channel);
+	std::copy (tail + 1, tail + _M + 1, _history.begin());
+	std::copy (in, in + frames, _history.begin() + _M);
+
+	if (taps >= fft_min_taps && frames >= taps) {
+		run_fft (_history.data(), frames, out);
+	} else {
+		run_direct (_history.data(), frames, out);
+	}
+
+	/* The new tail is the last _M + 1 samples of the old tail followed by the input, which
+	 * the end of _history will hold as long as there was some input.
+	 */
+	if (frames > 0) {
+		std::copy (_history.end() - taps, _history.end(), tail);
+	}
+}
+
+
+/** Convolve with _ir in the time domain.
+ *  @param history _M samples of previous input followed by frames samples of new input.
+ */
+void
+AudioFilter::run_direct (float const* history, int frames, float* out)
+{
+	if (_reversed_ir.size() != _ir.size()) {
+		_reversed_ir.assign (_ir.rbegin(), _ir.rend());
+	}
+
+	auto const kernel = _reversed_ir.data();
+	for (int i = 0; i < frames; ++i) {
+		auto const p = history + i;
+		float s = 0;
+		for (int j = 0; j <= _M; ++j) {
+			s += p[j] * kernel[j];
 		}
+		out[i] = s;
 	}
+}
 
-	int const amount = min (in->frames(), _tail->frames());
-	if (amount < _tail->frames ()) {
-		_tail->move (_tail->frames() - amount, amount, 0);
+
+/** Convolve with _ir using FFTs (overlap-save).  Since the input and kernel are real we
+ *  transform two segments of input at once, one as the real part and one as the imaginary.
+ *  @param history _M samples of previous input followed by frames samples of new input.
+ */
+void
+AudioFilter::run_fft (float const* history, int frames, float* out)
+{
+	if (_ir_fft.empty()) {
+		setup_fft ();
 	}
-	_tail->copy_from (in.get(), amount, in->frames() - amount, _tail->frames () - amount);
 
-	return out;
+	int const history_size = _M + frames;
+	/* Number of output samples that we get from each segment */
+	int const segment = _fft_size - _M;
+	double const scale = 1.0 / _fft_size;
+
+	_buffer.resize (_fft_size);
+	auto& buffer = _buffer;
+
+	for (int start = 0; start < frames; start += segment * 2) {
+		for (int i = 0; i < _fft_size; ++i) {
+			auto const a = start + i;
+			auto const b = start + segment + i;
+			buffer[i] = std::complex<double>(a < history_size ? history[a] : 0, b < history_size ? history[b] : 0);
+		}
+
+		fft (buffer, false);
+		for (int i = 0; i < _fft_size; ++i) {
+			buffer[i] *= _ir_fft[i];
+		}
+		fft (buffer, true);
+
+		/* The first _M samples of each circular convolution are wrapped around, so we throw them away */
+		int const first = min(segment, frames - start);
+		for (int i = 0; i < first; ++i) {
+			out[start + i] = buffer[_M + i].real() * scale;
+		}
+		int const second = min(segment, frames - start - segment);
+		for (int i = 0; i < second; ++i) {
+			out[start + segment + i] = buffer[_M + i].imag() * scale;
+		}
+	}
+}
+
+
+void
+AudioFilter::setup_fft ()
+{
+	_fft_size = 1;
+	int bits = 0;
+	while (_fft_size < (_M + 1) * 4) {
+		_fft_size *= 2;
+		++bits;
+	}
+
+	_twiddles.resize (_fft_size / 2);
+	for (int i = 0; i < _fft_size / 2; ++i) {
+		_twiddles[i] = std::polar(1.0, -2 * M_PI * i / _fft_size);
+	}
+
+	_bit_reverse.resize (_fft_size);
+	for (int i = 0; i < _fft_size; ++i) {
+		int r = 0;
+		for (int j = 0; j < bits; ++j) {
+			if (i & (1 << j)) {
+				r |= 1 << (bits - j - 1);
+			}
+		}
+		_bit_reverse[i] = r;
+	}
+
+	_ir_fft.assign (_fft_size, 0);
+	std::copy (_ir.begin(), _ir.end(), _ir_fft.begin());
+	fft (_ir_fft, false);
+}
+
+
+/** In-place radix-2 FFT of _fft_size points; the inverse is not scaled */
+void
+AudioFilter::fft (vector<std::complex<double>>& data, bool inverse) const
+{
+	for (int i = 0; i < _fft_size; ++i) {
+		if (i < _bit_reverse[i]) {
+			std::swap (data[i], data[_bit_reverse[i]]);
+		}
+	}
+
+	for (int length = 2; length <= _fft_size; length *= 2) {
+		int const half = length / 2;
+		int const step = _fft_size / length;
+		for (int i = 0; i < _fft_size; i += length) {
+			for (int j = 0; j < half; ++j) {
+				auto const w = inverse ? std::conj(_twiddles[j * step]) : _twiddles[j * step];
+				auto const u = data[i + j];
+				auto const v = data[i + j + half] * w;
+				data[i + j] = u + v;
+				data[i + j + half] = u - v;
+			}
+		}
+	}
 }
 
 
@@ -22,12 +22,14 @@
 #define DCPOMATIC_AUDIO_FILTER_H
 
 
+#include <complex>
 #include <memory>
 #include <vector>
 
 
 class AudioBuffers;
 struct audio_filter_impulse_input_test;
+struct audio_filter_fft_test;
 
 
 /** An audio filter which can take AudioBuffers and apply some filtering operation,
@@ -47,18 +49,40 @@ public:
 	virtual ~AudioFilter () {}
 
 	std::shared_ptr<AudioBuffers> run (std::shared_ptr<const AudioBuffers> in);
+	void run (float const* in, int frames, float* out);
 
 	void flush ();
 
 protected:
 	friend struct audio_filter_impulse_kernel_test;
 	friend struct audio_filter_impulse_input_test;
+	friend struct audio_filter_fft_test;
 
 	std::vector<float> sinc_blackman (float cutoff, bool invert) const;
 
 	std::vector<float> _ir;
 	int _M;
 	std::shared_ptr<AudioBuffers> _tail;
+
+private:
+	void run_channel (int channel, float const* in, int frames, float* out);
+	void run_direct (float const* history, int frames, float* out);
+	void run_fft (float const* history, int frames, float* out);
+	void setup_fft ();
+	void fft (std::vector<std::complex<double>>& data, bool inverse) const;
+
+	/** _ir reversed, so that the direct convolution can run forwards through its input */
+	std::vector<float> _reversed_ir;
+	/** size of the FFTs that run_fft() uses */
+	int _fft_size = 0;
+	/** FFT of _ir zero-padded to _fft_size */
+	std::vector<std::complex<double>> _ir_fft;
+	/** exp(-2 pi i k / _fft_size) for k from 0 to _fft_size / 2 */
+	std::vector<std::complex<double>> _twiddles;
+	std::vector<int> _bit_reverse;
+	/** buffers for run_channel() and run_fft(), kept so that we don't allocate them for every block */
+	std::vector<float> _history;
+	std::vector<std::complex<double>> _buffer;
 };
 
 
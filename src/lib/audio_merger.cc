@@ -25,6 +25,7 @@
 
 #include "audio_merger.h"
 #include "dcpomatic_time.h"
+#include <algorithm>
 #include <iostream>
 
 
@@ -54,6 +55,79 @@ AudioMerger::frames (DCPTime t) const
 }
 
 
+/** @return Offset of `frame' in a circular buffer of `ring_size' frames */
+static int
+position (Frame frame, int ring_size)
+{
+	auto p = frame % ring_size;
+	return p < 0 ? p + ring_size : p;
+}
+
+
+/** Copy or mix `count' frames from `audio' into `ring' at `frame', wrapping around the end of `ring' */
+static void
+ring_write (AudioBuffers* ring, AudioBuffers const* audio, int read_offset, Frame frame, int count, bool accumulate)
+{
+	auto const start = position(frame, ring->frames());
+	auto const first = min(count, ring->frames() - start);
+	if (accumulate) {
+		ring->accumulate_frames (audio, first, read_offset, start);
+		ring->accumulate_frames (audio, count - first, read_offset + first, 0);
+	} else {
+		ring->copy_from (audio, first, read_offset, start);
+		ring->copy_from (audio, count - first, read_offset + first, 0);
+	}
+}
+
+
+/** Copy `count' frames from `ring' at `frame' into `audio', wrapping around the end of `ring' */
+static void
+ring_read (AudioBuffers const* ring, AudioBuffers* audio, int write_offset, Frame frame, int count)
+{
+	auto const start = position(frame, ring->frames());
+	auto const first = min(count, ring->frames() - start);
+	audio->copy_from (ring, first, start, write_offset);
+	audio->copy_from (ring, count - first, 0, write_offset + first);
+}
+
+
+/** Make sure that _ring can hold all the audio that we have and [from, to) */
+void
+AudioMerger::reserve (int channels, Frame from, Frame to)
+{
+	if (!_ranges.empty()) {
+		from = min(from, _ranges.front().from);
+		to = max(to, _ranges.back().to);
+	}
+
+	if (_ring && _ring->channels() == channels && (to - from) <= _ring->frames()) {
+		return;
+	}
+
+	/* You can't push different channel counts at the same time */
+	DCPOMATIC_ASSERT (!_ring || _ring->channels() == channels || _ranges.empty());
+
+	int64_t size = _ring ? _ring->frames() : _frame_rate;
+	while (size < (to - from)) {
+		size *= 2;
+	}
+
+	DCPOMATIC_ASSERT (size <= INT32_MAX);
+
+	auto ring = make_shared<AudioBuffers>(channels, static_cast<int>(size));
+	if (_ring && _ring->channels() == channels) {
+		auto scratch = make_shared<AudioBuffers>(channels, _ring->frames());
+		for (auto const& i: _ranges) {
+			auto const count = static_cast<int>(i.to - i.from);
+			ring_read (_ring.get(), scratch.get(), 0, i.from, count);
+			ring_write (ring.get(), scratch.get(), 0, i.from, count, false);
+		}
+	}
+
+	_ring = ring;
+}
+
+
 /** Pull audio up to a given time; after this call, no more data can be pushed
  *  before the specified time.
  *  @param time Time to pull up to.
@@ -64,41 +138,23 @@ AudioMerger::pull (DCPTime time)
 {
 	list<pair<shared_ptr<AudioBuffers>, DCPTime>> out;
 
-	list<Buffer> new_buffers;
-
-	_buffers.sort ([](Buffer const& a, Buffer const& b) {
-		return a.time < b.time;
-	});
-
-	for (auto i: _buffers) {
-		if (i.period().to <= time) {
-			/* Completely within the pull period */
-			DCPOMATIC_ASSERT (i.audio->frames() > 0);
-			out.push_back (make_pair (i.audio, i.time));
-		} else if (i.time < time) {
-			/* Overlaps the end of the pull period */
-			int32_t const overlap = frames(DCPTime(time - i.time));
-			/* Though time > i.time, overlap could be 0 if the difference in time is less than one frame */
-			if (overlap > 0) {
-				auto audio = make_shared<AudioBuffers>(i.audio, overlap, 0);
-				out.push_back (make_pair(audio, i.time));
-				i.audio->trim_start (overlap);
-				i.time += DCPTime::from_frames(overlap, _frame_rate);
-				DCPOMATIC_ASSERT (i.audio->frames() > 0);
-				new_buffers.push_back (i);
-			}
+	auto const end = frames(time);
+
+	auto i = _ranges.begin();
+	while (i != _ranges.end() && i->from < end) {
+		auto const count = static_cast<int>(min(i->to, end) - i->from);
+		auto audio = make_shared<AudioBuffers>(_ring->channels(), count);
+		ring_read (_ring.get(), audio.get(), 0, i->from, count);
+		out.push_back (make_pair(audio, DCPTime::from_frames(i->from, _frame_rate)));
+		i->from += count;
+		if (i->from == i->to) {
+			++i;
 		} else {
-			/* Not involved */
-			DCPOMATIC_ASSERT (i.audio->frames() > 0);
-			new_buffers.push_back (i);
+			break;
 		}
 	}
 
-	_buffers = new_buffers;
-
-	for (auto const& i: out) {
-		DCPOMATIC_ASSERT (i.first->frames() > 0);
-	}
+	_ranges.erase (_ranges.begin(), i);
 
 	return out;
 }
@@ -110,62 +166,42 @@ AudioMerger::push (std::shared_ptr<const AudioBuffers> audio, DCPTime time)
 {
 	DCPOMATIC_ASSERT (audio->frames() > 0);
 
-	DCPTimePeriod period (time, time + DCPTime::from_frames (audio->frames(), _frame_rate));
-
-	/* Mix any overlapping parts of this new block with existing ones */
-	for (auto i: _buffers) {
-		auto overlap = i.period().overlap(period);
-		if (overlap) {
-			int32_t const offset = frames(DCPTime(overlap->from - i.time));
-			int32_t const frames_to_mix = frames(overlap->duration());
-			if (i.time < time) {
-				i.audio->accumulate_frames(audio.get(), frames_to_mix, 0, offset);
-			} else {
-				i.audio->accumulate_frames(audio.get(), frames_to_mix, offset, 0);
-			}
+	auto const from = frames(time);
+	auto const to = from + audio->frames();
+
+	reserve (audio->channels(), from, to);
+
+	/* Mix with the parts that we already have and copy into the gaps in between */
+	auto frame = from;
+	for (auto const& i: _ranges) {
+		if (i.from >= to) {
+			break;
+		}
+		if (i.to <= frame) {
+			continue;
+		}
+		if (i.from > frame) {
+			ring_write (_ring.get(), audio.get(), frame - from, frame, i.from - frame, false);
+			frame = i.from;
 		}
+		auto const mix_to = min(i.to, to);
+		ring_write (_ring.get(), audio.get(), frame - from, frame, mix_to - frame, true);
+		frame = mix_to;
 	}
 
-	list<DCPTimePeriod> periods;
-	for (auto i: _buffers) {
-		periods.push_back (i.period());
+	if (frame < to) {
+		ring_write (_ring.get(), audio.get(), frame - from, frame, to - frame, false);
 	}
 
-	/* Add the non-overlapping parts */
-	for (auto i: subtract(period, periods)) {
-		auto before = _buffers.end();
-		auto after = _buffers.end();
-		for (auto j = _buffers.begin(); j != _buffers.end(); ++j) {
-			if (j->period().to == i.from) {
-				before = j;
-			}
-			if (j->period().from == i.to) {
-				after = j;
-			}
-		}
-
-		/* Get the part of audio that we want to use */
-		auto part = make_shared<AudioBuffers>(audio, frames(i.to) - frames(i.from), frames(DCPTime(i.from - time)));
-
-		if (before == _buffers.end() && after == _buffers.end()) {
-			if (part->frames() > 0) {
-				/* New buffer */
-				_buffers.push_back (Buffer (part, time, _frame_rate));
-			}
-		} else if (before != _buffers.end() && after == _buffers.end()) {
-			/* We have an existing buffer before this one; append new data to it */
-			before->audio->append (part);
-		} else if (before ==_buffers.end() && after != _buffers.end()) {
-			/* We have an existing buffer after this one; append it to the new data and replace */
-			part->append (after->audio);
-			after->audio = part;
-			after->time = time;
-		} else {
-			/* We have existing buffers both before and after; coalesce them all */
-			before->audio->append (part);
-			before->audio->append (after->audio);
-			_buffers.erase (after);
-		}
+	/* Note that we now have [from, to), joining it to any ranges that it overlaps or touches */
+	auto first = std::find_if(_ranges.begin(), _ranges.end(), [from](Range const& range) { return range.to >= from; });
+	auto last = std::find_if(first, _ranges.end(), [to](Range const& range) { return range.from > to; });
+	if (first == last) {
+		_ranges.insert (first, Range(from, to));
+	} else {
+		first->from = min(first->from, from);
+		first->to = max(std::prev(last)->to, to);
+		_ranges.erase (std::next(first), last);
 	}
 }
 
@@ -173,5 +209,5 @@ AudioMerger::push (std::shared_ptr<const AudioBuffers> audio, DCPTime time)
 void
 AudioMerger::clear ()
 {
-	_buffers.clear ();
+	_ranges.clear ();
 }
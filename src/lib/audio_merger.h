@@ -26,10 +26,15 @@
 #include "audio_buffers.h"
 #include "dcpomatic_time.h"
 #include "util.h"
+#include <vector>
 
 
 /** @class AudioMerger.
  *  @brief A class that can merge audio data from many sources.
+ *
+ *  Audio is mixed into a circular buffer indexed by frame time, which is only
+ *  reallocated when it needs to hold more than it has room for, so that pushing
+ *  and pulling does not make, append or trim buffers.
  */
 class AudioMerger
 {
@@ -42,36 +47,23 @@ public:
 
 private:
 	Frame frames (dcpomatic::DCPTime t) const;
+	void reserve (int channels, Frame from, Frame to);
 
-	class Buffer
+	/** A range of frames [from, to) which contains audio */
+	struct Range
 	{
-	public:
-		/** @param c Channels
-		 *  @param f Frames
-		 *  @param t Time
-		 *  @param r Frame rate.
-		 */
-		Buffer (int c, int32_t f, dcpomatic::DCPTime t, int r)
-			: audio (std::make_shared<AudioBuffers>(c, f))
-			, time (t)
-			, frame_rate (r)
+		Range (Frame from_, Frame to_)
+			: from(from_)
+			, to(to_)
 		{}
 
-		Buffer (std::shared_ptr<AudioBuffers> a, dcpomatic::DCPTime t, int r)
-			: audio (a)
-			, time (t)
-			, frame_rate (r)
-		{}
-
-		std::shared_ptr<AudioBuffers> audio;
-		dcpomatic::DCPTime time;
-		int frame_rate;
-
-		dcpomatic::DCPTimePeriod period () const {
-			return dcpomatic::DCPTimePeriod (time, time + dcpomatic::DCPTime::from_frames (audio->frames(), frame_rate));
-		}
+		Frame from;
+		Frame to;
 	};
 
-	std::list<Buffer> _buffers;
+	/** Circular buffer where frame f of the audio is at f modulo its size */
+	std::shared_ptr<AudioBuffers> _ring;
+	/** Ranges of frames which are in _ring, earliest first, with none overlapping or touching */
+	std::vector<Range> _ranges;
 	int _frame_rate;
 };
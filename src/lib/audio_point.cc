@@ -20,15 +20,6 @@
 
 
 #include "audio_point.h"
-#include <dcp/raw_convert.h>
-#include <dcp/warnings.h>
-LIBDCP_DISABLE_WARNINGS
-#include <libxml++/libxml++.h>
-LIBDCP_ENABLE_WARNINGS
-
-
-using std::string;
-using dcp::raw_convert;
 
 
 AudioPoint::AudioPoint ()
@@ -45,33 +36,3 @@ AudioPoint::AudioPoint (cxml::ConstNodePtr node)
 	_data[RMS] = node->number_child<float>("RMS");
 }
 
-
-AudioPoint::AudioPoint (AudioPoint const & other)
-{
-	for (int i = 0; i < COUNT; ++i) {
-		_data[i] = other._data[i];
-	}
-}
-
-
-AudioPoint &
-AudioPoint::operator= (AudioPoint const & other)
-{
-	if (this == &other) {
-		return *this;
-	}
-
-	for (int i = 0; i < COUNT; ++i) {
-		_data[i] = other._data[i];
-	}
-
-	return *this;
-}
-
-
-void
-AudioPoint::as_xml (xmlpp::Element* parent) const
-{
-	parent->add_child("Peak")->add_child_text(raw_convert<string>(_data[PEAK]));
-	parent->add_child("RMS")->add_child_text(raw_convert<string>(_data[RMS]));
-}
@@ -26,11 +26,6 @@
 #include <libcxml/cxml.h>
 
 
-namespace xmlpp {
-	class Element;
-}
-
-
 class AudioPoint
 {
 public:
@@ -42,16 +37,13 @@ public:
 
 	AudioPoint ();
 	explicit AudioPoint (cxml::ConstNodePtr node);
-	AudioPoint (AudioPoint const &);
-	AudioPoint& operator= (AudioPoint const &);
-
-	void as_xml (xmlpp::Element *) const;
 
 	inline float& operator[] (int t) {
 		return _data[t];
 	}
 
 private:
+	/* This must stay plain data so that analyses can be written and read as arrays of AudioPoint */
 	float _data[COUNT];
 };
 
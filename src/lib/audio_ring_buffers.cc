@@ -20,24 +20,89 @@
 
 
 #include "audio_ring_buffers.h"
+#include "compose.hpp"
 #include "dcpomatic_assert.h"
 #include "exceptions.h"
+#include <algorithm>
 #include <iostream>
 
 
 using std::min;
+using std::max;
 using std::cout;
 using std::make_pair;
 using std::pair;
-using std::list;
 using std::shared_ptr;
+using std::string;
 using boost::optional;
 using namespace dcpomatic;
 
 
-AudioRingBuffers::AudioRingBuffers ()
+AudioRingBuffers::AudioRingBuffers (int channels, Frame capacity)
+	: _channels (channels)
+	, _capacity (capacity)
+	, _data (channels * capacity)
+	, _times (capacity)
+	, _write (0)
+	, _read (0)
+	, _discard (0)
+	, _in_get (false)
 {
+	DCPOMATIC_ASSERT (_capacity > 0);
+}
+
+
+/** @return index of the first frame that get() might still read, and which put() must therefore not overwrite */
+int64_t
+AudioRingBuffers::first_needed () const
+{
+	auto const read = _read.load(std::memory_order_acquire);
+	if (_in_get.load()) {
+		/* get() may have started before the last _discard was set, so it could still be reading
+		 * anything from _read onwards.
+		 */
+		return read;
+	}
 
+	/* Any get() that starts after this will see the current value of _discard */
+	return max(read, _discard.load());
+}
+
+
+/** Write some frames, dropping old data to make room if required.
+ *  @param fill Function taking a frame index (from 0 to frames) and a pointer to which to write _channels samples for that frame.
+ *  @param frame_rate Frame rate in use; this is only used to check timing consistency of the incoming data.
+ */
+template <class F>
+void
+AudioRingBuffers::put_frames (Frame frames, DCPTime time, int frame_rate, F fill)
+{
+	if (size() > 0) {
+		if (labs(_put_end.get() - time.get()) > 1) {
+			cout << "bad put " << to_string(_put_end) << " " << to_string(time) << "\n";
+		}
+		DCPOMATIC_ASSERT (labs(_put_end.get() - time.get()) < 2);
+	}
+
+	_put_end = time + DCPTime::from_frames(frames, frame_rate);
+
+	auto const write = _write.load(std::memory_order_relaxed);
+
+	if (write + frames - _capacity > _discard.load()) {
+		/* Drop the oldest data to make room for this; if get() is busy reading it we may
+		 * have to drop some of this data instead.
+		 */
+		_discard.store(min(write, write + frames - _capacity));
+	}
+
+	Frame const to_do = min(frames, _capacity - (write - first_needed()));
+	for (Frame i = 0; i < to_do; ++i) {
+		auto const index = (write + i) % _capacity;
+		fill (i, &_data[index * _channels]);
+		_times[index] = (time + DCPTime::from_frames(i, frame_rate)).get();
+	}
+
+	_write.store(write + to_do, std::memory_order_release);
 }
 
 
@@ -45,18 +110,45 @@ AudioRingBuffers::AudioRingBuffers ()
 void
 AudioRingBuffers::put (shared_ptr<const AudioBuffers> data, DCPTime time, int frame_rate)
 {
-	boost::mutex::scoped_lock lm (_mutex);
+	float* const* p = data->data();
+	int const c = min(data->channels(), _channels);
+	put_frames (data->frames(), time, frame_rate, [this, p, c](Frame i, float* out) {
+		for (int j = 0; j < c; ++j) {
+			*out++ = p[j][i];
+		}
+		for (int j = c; j < _channels; ++j) {
+			*out++ = 0;
+		}
+	});
+}
+
 
-	if (!_buffers.empty()) {
-		DCPOMATIC_ASSERT (_buffers.front().first->channels() == data->channels());
-		DCPTime const end = (_buffers.back().second + DCPTime::from_frames(_buffers.back().first->frames(), frame_rate));
-		if (labs(end.get() - time.get()) > 1) {
-			cout << "bad put " << to_string(_buffers.back().second) << " " << _buffers.back().first->frames() << " " << to_string(time) << "\n";
+/** Put some data, mixing its channels into ours according to a mapping.  This saves remapping (and
+ *  allocating new buffers) before calling put().
+ *  @param frame_rate Frame rate in use; this is only used to check timing consistency of the incoming data.
+ */
+void
+AudioRingBuffers::put (shared_ptr<const AudioBuffers> data, DCPTime time, int frame_rate, AudioMapping const& mapping)
+{
+	_routes.clear ();
+	int const inputs = min(mapping.input_channels(), data->channels());
+	int const outputs = min(mapping.output_channels(), _channels);
+	for (int i = 0; i < inputs; ++i) {
+		for (int j = 0; j < outputs; ++j) {
+			auto const gain = mapping.get(i, j);
+			if (gain > 0) {
+				_routes.push_back ({ i, j, gain });
+			}
 		}
-		DCPOMATIC_ASSERT (labs(end.get() - time.get()) < 2);
 	}
 
-	_buffers.push_back(make_pair(data, time));
+	float* const* p = data->data();
+	put_frames (data->frames(), time, frame_rate, [this, p](Frame i, float* out) {
+		std::fill (out, out + _channels, 0.0f);
+		for (auto const& route: _routes) {
+			out[route.output] += p[route.input][i] * route.gain;
+		}
+	});
 }
 
 
@@ -64,45 +156,36 @@ AudioRingBuffers::put (shared_ptr<const AudioBuffers> data, DCPTime time, int fr
 optional<DCPTime>
 AudioRingBuffers::get (float* out, int channels, int frames)
 {
-	boost::mutex::scoped_lock lm (_mutex);
+	_in_get.store(true);
+
+	auto const read = max(_read.load(std::memory_order_relaxed), _discard.load());
+	int const to_do = min(static_cast<int64_t>(frames), _write.load(std::memory_order_acquire) - read);
 
 	optional<DCPTime> time;
+	if (to_do > 0) {
+		time = DCPTime(_times[read % _capacity]);
+	}
 
-	while (frames > 0) {
-		if (_buffers.empty ()) {
-			for (int i = 0; i < frames; ++i) {
-				for (int j = 0; j < channels; ++j) {
-					*out++ = 0;
-				}
-			}
-			return time;
+	int const c = min(_channels, channels);
+	for (int i = 0; i < to_do; ++i) {
+		float const* in = &_data[((read + i) % _capacity) * _channels];
+		for (int j = 0; j < c; ++j) {
+			*out++ = in[j];
 		}
-
-		auto front = _buffers.front ();
-		if (!time) {
-			time = front.second + DCPTime::from_frames(_used_in_head, 48000);
+		for (int j = c; j < channels; ++j) {
+			*out++ = 0;
 		}
+	}
 
-		int const to_do = min (frames, front.first->frames() - _used_in_head);
-		float* const* p = front.first->data();
-		int const c = min (front.first->channels(), channels);
-		for (int i = 0; i < to_do; ++i) {
-			for (int j = 0; j < c; ++j) {
-				*out++ = p[j][i + _used_in_head];
-			}
-			for (int j = c; j < channels; ++j) {
-				*out++ = 0;
-			}
-		}
-		_used_in_head += to_do;
-		frames -= to_do;
-
-		if (_used_in_head == front.first->frames()) {
-			_buffers.pop_front ();
-			_used_in_head = 0;
+	for (int i = to_do; i < frames; ++i) {
+		for (int j = 0; j < channels; ++j) {
+			*out++ = 0;
 		}
 	}
 
+	_read.store(read + max(to_do, 0), std::memory_order_release);
+	_in_get.store(false);
+
 	return time;
 }
 
@@ -110,30 +193,34 @@ AudioRingBuffers::get (float* out, int channels, int frames)
 optional<DCPTime>
 AudioRingBuffers::peek () const
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	if (_buffers.empty()) {
+	auto const read = max(_read.load(), _discard.load());
+	if (read >= _write.load()) {
 		return {};
 	}
-	return _buffers.front().second;
+	return DCPTime(_times[read % _capacity]);
 }
 
 
 void
 AudioRingBuffers::clear ()
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	_buffers.clear ();
-	_used_in_head = 0;
+	_discard.store(_write.load());
 }
 
 
 Frame
 AudioRingBuffers::size () const
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	Frame s = 0;
-	for (auto const& i: _buffers) {
-		s += i.first->frames();
-	}
-	return s - _used_in_head;
+	auto const read = max(_read.load(), _discard.load());
+	return max(static_cast<int64_t>(0), _write.load() - read);
+}
+
+
+pair<size_t, string>
+AudioRingBuffers::memory_used () const
+{
+	return make_pair(
+		_data.size() * sizeof(float) + _times.size() * sizeof(DCPTime::Type),
+		String::compose("%1 audio frames", size())
+		);
 }
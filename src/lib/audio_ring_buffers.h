@@ -24,21 +24,37 @@
 
 
 #include "audio_buffers.h"
+#include "audio_mapping.h"
 #include "types.h"
 #include "dcpomatic_time.h"
-#include <boost/thread.hpp>
-#include <list>
-
-
+#include <boost/optional.hpp>
+#include <atomic>
+#include <string>
+#include <vector>
+
+
+/** @class AudioRingBuffers
+ *  @brief A fixed-size, lock-free store of audio passing from one thread to another.
+ *
+ *  put() and clear() may be called from one thread (or from several, as long as calls are
+ *  serialised by the caller) while get() is called from another.  get() does not lock or
+ *  allocate so it is safe to call from an audio callback.
+ */
 class AudioRingBuffers
 {
 public:
-	AudioRingBuffers ();
+	/** @param channels Number of channels to store; data given to put() with more channels will
+	 *  have the extra ones discarded, and data with fewer will have silent ones added.
+	 *  @param capacity Maximum number of frames that can be stored.  If more than this arrive before
+	 *  they can be taken by get() the oldest will be dropped.
+	 */
+	AudioRingBuffers (int channels, Frame capacity);
 
-	AudioRingBuffers (AudioBuffers const&) = delete;
-	AudioRingBuffers& operator= (AudioBuffers const&) = delete;
+	AudioRingBuffers (AudioRingBuffers const&) = delete;
+	AudioRingBuffers& operator= (AudioRingBuffers const&) = delete;
 
 	void put (std::shared_ptr<const AudioBuffers> data, dcpomatic::DCPTime time, int frame_rate);
+	void put (std::shared_ptr<const AudioBuffers> data, dcpomatic::DCPTime time, int frame_rate, AudioMapping const& mapping);
 	boost::optional<dcpomatic::DCPTime> get (float* out, int channels, int frames);
 	boost::optional<dcpomatic::DCPTime> peek () const;
 
@@ -46,10 +62,39 @@ public:
 	/** @return number of frames currently available */
 	Frame size () const;
 
+	std::pair<size_t, std::string> memory_used () const;
+
 private:
-	mutable boost::mutex _mutex;
-	std::list<std::pair<std::shared_ptr<const AudioBuffers>, dcpomatic::DCPTime>> _buffers;
-	int _used_in_head = 0;
+	int64_t first_needed () const;
+	template <class F>
+	void put_frames (Frame frames, dcpomatic::DCPTime time, int frame_rate, F fill);
+
+	int const _channels;
+	Frame const _capacity;
+	/** interleaved samples, _channels for each of _capacity frames */
+	std::vector<float> _data;
+	/** time of each frame in _data */
+	std::vector<dcpomatic::DCPTime::Type> _times;
+	/** index (counting all the frames ever put) of the next frame that put() will write; changed only by put() */
+	std::atomic<int64_t> _write;
+	/** index of the next frame that get() will read; changed only by get() */
+	std::atomic<int64_t> _read;
+	/** index before which frames have been dropped by clear() or by put() when full; changed only by those */
+	std::atomic<int64_t> _discard;
+	/** true while get() is reading from _data */
+	std::atomic<bool> _in_get;
+	/** time just after the end of the last data given to put(), to check consistency */
+	dcpomatic::DCPTime _put_end;
+
+	struct Route
+	{
+		int input;
+		int output;
+		float gain;
+	};
+
+	/** the non-zero gains of the mapping given to the last put(); kept here to save allocating them each time */
+	std::vector<Route> _routes;
 };
 
 
@@ -0,0 +1,193 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "background_uploader.h"
+#include "config.h"
+#include "cross.h"
+#include "curl_uploader.h"
+#include "dcpomatic_log.h"
+#include "scp_uploader.h"
+#include "uploader.h"
+#include "util.h"
+#include <algorithm>
+#include <memory>
+
+
+using std::function;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+#if BOOST_VERSION >= 106100
+using namespace boost::placeholders;
+#endif
+
+
+BackgroundUploader::BackgroundUploader (boost::filesystem::path dcp)
+	: _dcp (dcp)
+{
+	_thread = boost::thread (boost::bind(&BackgroundUploader::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread.native_handle(), "background-uploader");
+#endif
+}
+
+
+BackgroundUploader::~BackgroundUploader ()
+{
+	stop ();
+}
+
+
+/** Stop the thread; if it is in the middle of uploading a file this will wait until that file is done */
+void
+BackgroundUploader::stop ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	_thread.interrupt ();
+	try {
+		_thread.join ();
+	} catch (...) {}
+}
+
+
+/** Add a file in the DCP directory to the end of the list of things to upload.
+ *  Files which have already been added are ignored.
+ */
+void
+BackgroundUploader::add (boost::filesystem::path file)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_added.find(file) != _added.end()) {
+		return;
+	}
+
+	_added.insert (file);
+	_pending.push_back (file);
+	_total_size += boost::filesystem::file_size (file);
+	_condition.notify_all ();
+}
+
+
+/** Add everything in the DCP directory which has not yet been added */
+void
+BackgroundUploader::add_remaining ()
+{
+	vector<boost::filesystem::path> remaining;
+	for (auto i: boost::filesystem::recursive_directory_iterator(_dcp)) {
+		if (!boost::filesystem::is_directory(i.path())) {
+			remaining.push_back (i.path());
+		}
+	}
+
+	/* Make sure that the ASSETMAP goes last, after the things that it refers to */
+	std::stable_sort (remaining.begin(), remaining.end(), [](boost::filesystem::path const& a, boost::filesystem::path const& b) {
+		return upload_stage(a) < upload_stage(b);
+	});
+
+	for (auto const& i: remaining) {
+		add (i);
+	}
+}
+
+
+/** Wait for everything which has been added to be uploaded; this will throw
+ *  if any upload failed.
+ *  @param progress Function to call with the proportion of things uploaded so far.
+ */
+void
+BackgroundUploader::finish (function<void (float)> progress)
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_finishing = true;
+		_progress = progress;
+		_condition.notify_all ();
+	}
+
+	try {
+		_thread.join ();
+	} catch (...) {}
+
+	rethrow ();
+}
+
+
+void
+BackgroundUploader::set_progress (float progress)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_progress) {
+		_progress (progress);
+	}
+}
+
+
+void
+BackgroundUploader::thread ()
+try
+{
+	start_of_thread ("BackgroundUploader");
+
+	auto set_status = [](string status) {
+		LOG_GENERAL ("Background upload: %1", status);
+	};
+
+	unique_ptr<Uploader> uploader;
+	switch (Config::instance()->tms_protocol()) {
+	case FileTransferProtocol::SCP:
+		uploader.reset (new SCPUploader(set_status, boost::bind(&BackgroundUploader::set_progress, this, _1)));
+		break;
+	case FileTransferProtocol::FTP:
+		uploader.reset (new CurlUploader(set_status, boost::bind(&BackgroundUploader::set_progress, this, _1)));
+		break;
+	}
+
+	boost::uintmax_t transferred = 0;
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_pending.empty() && !_finishing) {
+			_condition.wait (lm);
+		}
+
+		if (_pending.empty()) {
+			/* _finishing is set and there's nothing left to do */
+			break;
+		}
+
+		auto const file = _pending.front();
+		_pending.pop_front ();
+		auto const total_size = _total_size;
+		lm.unlock ();
+
+		uploader->upload (_dcp, file, transferred, total_size);
+		boost::this_thread::interruption_point ();
+	}
+}
+catch (boost::thread_interrupted &)
+{
+	/* The writer has gone away before finishing */
+}
+catch (...)
+{
+	store_current ();
+}
@@ -0,0 +1,80 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_BACKGROUND_UPLOADER_H
+#define DCPOMATIC_BACKGROUND_UPLOADER_H
+
+
+#include "exception_store.h"
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <functional>
+#include <list>
+#include <set>
+
+
+/** @class BackgroundUploader
+ *  @brief Send the files of a DCP to the TMS (as set up in Config) while the DCP is still being made.
+ *
+ *  Files are uploaded by a thread in the order that they are given to add(); the writer
+ *  gives us each asset as soon as it is in the DCP directory and then, once it has written
+ *  the CPL and PKL, everything else.
+ */
+class BackgroundUploader : public ExceptionStore
+{
+public:
+	explicit BackgroundUploader (boost::filesystem::path dcp);
+	~BackgroundUploader ();
+
+	BackgroundUploader (BackgroundUploader const&) = delete;
+	BackgroundUploader& operator= (BackgroundUploader const&) = delete;
+
+	void add (boost::filesystem::path file);
+	void add_remaining ();
+	void finish (std::function<void (float)> progress);
+
+private:
+	void thread ();
+	void set_progress (float progress);
+	void stop ();
+
+	/** DCP directory that we are uploading */
+	boost::filesystem::path _dcp;
+
+	boost::mutex _mutex;
+	boost::condition _condition;
+	/** files which have been given to add() but not yet uploaded */
+	std::list<boost::filesystem::path> _pending;
+	/** every file which has been given to add() */
+	std::set<boost::filesystem::path> _added;
+	/** total size of all the files in _added */
+	boost::uintmax_t _total_size = 0;
+	/** true when there will be no more calls to add() */
+	bool _finishing = false;
+	std::function<void (float)> _progress;
+
+	boost::thread _thread;
+};
+
+
+#endif
@@ -0,0 +1,123 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "binary_descriptor.h"
+#include "exceptions.h"
+#include <cstring>
+
+#include "i18n.h"
+
+
+using std::string;
+
+
+void
+BinaryDescriptorWriter::add (int32_t value)
+{
+	auto const v = static_cast<uint32_t>(value);
+	for (int i = 0; i < 4; ++i) {
+		_data.push_back ((v >> (i * 8)) & 0xff);
+	}
+}
+
+
+void
+BinaryDescriptorWriter::add (double value)
+{
+	uint64_t v;
+	static_assert (sizeof(v) == sizeof(value), "double is not 64 bits");
+	memcpy (&v, &value, sizeof(v));
+	for (int i = 0; i < 8; ++i) {
+		_data.push_back ((v >> (i * 8)) & 0xff);
+	}
+}
+
+
+void
+BinaryDescriptorWriter::add (bool value)
+{
+	_data.push_back (value ? 1 : 0);
+}
+
+
+void
+BinaryDescriptorWriter::add (string const& value)
+{
+	add (static_cast<int32_t>(value.size()));
+	_data.insert (_data.end(), value.begin(), value.end());
+}
+
+
+void
+BinaryDescriptorReader::check (size_t size) const
+{
+	if (static_cast<size_t>(_end - _data) < size) {
+		throw NetworkError (_("Frame description from client is too short"));
+	}
+}
+
+
+int32_t
+BinaryDescriptorReader::read_int32 ()
+{
+	check (4);
+	uint32_t v = 0;
+	for (int i = 0; i < 4; ++i) {
+		v |= static_cast<uint32_t>(*_data++) << (i * 8);
+	}
+	return static_cast<int32_t>(v);
+}
+
+
+double
+BinaryDescriptorReader::read_double ()
+{
+	check (8);
+	uint64_t v = 0;
+	for (int i = 0; i < 8; ++i) {
+		v |= static_cast<uint64_t>(*_data++) << (i * 8);
+	}
+	double value;
+	memcpy (&value, &v, sizeof(value));
+	return value;
+}
+
+
+bool
+BinaryDescriptorReader::read_bool ()
+{
+	check (1);
+	return *_data++ != 0;
+}
+
+
+string
+BinaryDescriptorReader::read_string ()
+{
+	auto const size = read_int32 ();
+	if (size < 0) {
+		throw NetworkError (_("Frame description from client is corrupt"));
+	}
+	check (size);
+	string s (reinterpret_cast<char const*>(_data), size);
+	_data += size;
+	return s;
+}
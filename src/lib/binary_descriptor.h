@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_BINARY_DESCRIPTOR_H
+#define DCPOMATIC_BINARY_DESCRIPTOR_H
+
+
+/** @file  src/lib/binary_descriptor.h
+ *  @brief BinaryDescriptorWriter and BinaryDescriptorReader classes.
+ *
+ *  These are used to describe frames that we send to encoding servers
+ *  more cheaply than we could with XML.  Everything is little-endian.
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/** @class BinaryDescriptorWriter
+ *  @brief Builder for a block of values which can be read back by BinaryDescriptorReader.
+ */
+class BinaryDescriptorWriter
+{
+public:
+	void add (int32_t value);
+	void add (double value);
+	void add (bool value);
+	void add (std::string const& value);
+
+	std::vector<uint8_t> const& data () const {
+		return _data;
+	}
+
+private:
+	std::vector<uint8_t> _data;
+};
+
+
+/** @class BinaryDescriptorReader
+ *  @brief Reader for things written with BinaryDescriptorWriter, in the same order.
+ *
+ *  The reader throws NetworkError if it is asked for more than there is.
+ */
+class BinaryDescriptorReader
+{
+public:
+	BinaryDescriptorReader (uint8_t const* data, size_t size)
+		: _data (data)
+		, _end (data + size)
+	{}
+
+	int32_t read_int32 ();
+	double read_double ();
+	bool read_bool ();
+	std::string read_string ();
+
+private:
+	void check (size_t size) const;
+
+	uint8_t const* _data;
+	uint8_t const* _end;
+};
+
+
+#endif
@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "buffer_pool.h"
+
+
+using std::shared_ptr;
+using std::vector;
+
+
+BufferPool::BufferPool (int spare)
+	: _state (std::make_shared<State>())
+{
+	_state->max_spare = spare;
+}
+
+
+shared_ptr<vector<uint8_t>>
+BufferPool::get (size_t size)
+{
+	vector<uint8_t>* buffer = nullptr;
+
+	{
+		boost::mutex::scoped_lock lm (_state->mutex);
+		/* Look for one which is already big enough, otherwise take any (to grow) */
+		for (auto i = _state->spare.begin(); i != _state->spare.end(); ++i) {
+			if ((*i)->capacity() >= size) {
+				buffer = *i;
+				_state->spare.erase (i);
+				break;
+			}
+		}
+		if (!buffer && !_state->spare.empty()) {
+			buffer = _state->spare.front();
+			_state->spare.pop_front ();
+		}
+	}
+
+	if (!buffer) {
+		buffer = new vector<uint8_t>;
+	}
+
+	buffer->resize (size);
+
+	auto state = _state;
+	return shared_ptr<vector<uint8_t>>(buffer, [state](vector<uint8_t>* b) {
+		state->put (b);
+	});
+}
+
+
+void
+BufferPool::State::put (vector<uint8_t>* buffer)
+{
+	boost::mutex::scoped_lock lm (mutex);
+	if (spare.size() < max_spare) {
+		spare.push_back (buffer);
+	} else {
+		lm.unlock ();
+		delete buffer;
+	}
+}
+
+
+BufferPool::State::~State ()
+{
+	for (auto i: spare) {
+		delete i;
+	}
+}
@@ -0,0 +1,67 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_BUFFER_POOL_H
+#define DCPOMATIC_BUFFER_POOL_H
+
+
+#include <boost/thread/mutex.hpp>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+
+/** @class BufferPool
+ *  @brief A set of buffers which are re-used rather than being freed, so that
+ *  we don't allocate (and page in) a big block of memory for every frame.
+ *
+ *  Buffers go back to the pool when the last shared_ptr to them goes away, even
+ *  if that is after the pool has been destroyed.
+ */
+class BufferPool
+{
+public:
+	/** @param spare Maximum number of unused buffers to keep */
+	explicit BufferPool (int spare);
+
+	BufferPool (BufferPool const&) = delete;
+	BufferPool& operator= (BufferPool const&) = delete;
+
+	/** @return A buffer of @p size bytes, whose contents are undefined */
+	std::shared_ptr<std::vector<uint8_t>> get (size_t size);
+
+private:
+	struct State
+	{
+		boost::mutex mutex;
+		std::list<std::vector<uint8_t>*> spare;
+		size_t max_spare;
+
+		~State ();
+		void put (std::vector<uint8_t>* buffer);
+	};
+
+	std::shared_ptr<State> _state;
+};
+
+
+#endif
@@ -24,8 +24,11 @@
 #include "cross.h"
 #include "dcpomatic_log.h"
 #include "exceptions.h"
+#include "image_pool.h"
 #include "log.h"
+#include "metrics.h"
 #include "player.h"
+#include "prepare_queue.h"
 #include "util.h"
 #include "video_content.h"
 
@@ -59,6 +62,10 @@ using namespace boost::placeholders;
  *  butler.  This will be used (where possible) to prepare the PlayerVideos so that calling image() on them is quick.
  *  @param alignment Same as above for the `alignment' value.
  *  @param fast Same as above for the `fast' flag.
+ *  @param prepare_threads Maximum number of threads to use to prepare PlayerVideos, or 0 to use a
+ *  default based on the number of CPUs.  Fewer will be used if they are enough to keep up.
+ *  @param scale_threads Number of threads that each of the prepare threads should use to scale
+ *  a PlayerVideo's image (see Image::set_scale_threads).
  */
 Butler::Butler (
 	weak_ptr<const Film> film,
@@ -70,11 +77,16 @@ Butler::Butler (
 	Image::Alignment alignment,
 	bool fast,
 	bool prepare_only_proxy,
-	Audio audio
+	Audio audio,
+	int prepare_threads,
+	int scale_threads
 	)
 	: _film (film)
 	, _player (player)
-	, _prepare_work (new boost::asio::io_service::work(_prepare_service))
+	, _video (MAXIMUM_VIDEO_READAHEAD * 10)
+	, _audio (audio_channels, MAXIMUM_AUDIO_READAHEAD * 4)
+	/* Plenty of captions, even if nobody is taking them for a while */
+	, _closed_caption (4096)
 	, _pending_seek_accurate (false)
 	, _suspended (0)
 	, _finished (false)
@@ -105,10 +117,18 @@ Butler::Butler (
 	   multi-thread JPEG2000 decoding.
 	*/
 
-	LOG_TIMING("start-prepare-threads %1", boost::thread::hardware_concurrency() * 2);
+	if (prepare_threads == 0) {
+		prepare_threads = boost::thread::hardware_concurrency() * 2;
+	}
+
+	LOG_TIMING("start-prepare-threads %1", prepare_threads);
 
-	for (size_t i = 0; i < boost::thread::hardware_concurrency() * 2; ++i) {
-		_prepare_pool.create_thread (bind (&boost::asio::io_service::run, &_prepare_service));
+	_prepare_queue.reset (new PrepareQueue(prepare_threads, [scale_threads]() {
+		Image::set_scale_threads (scale_threads);
+	}));
+
+	if (auto f = _film.lock()) {
+		_prepare_queue->set_frame_rate (f->video_frame_rate());
 	}
 }
 
@@ -122,9 +142,7 @@ Butler::~Butler ()
 		_stop_thread = true;
 	}
 
-	_prepare_work.reset ();
-	_prepare_pool.join_all ();
-	_prepare_service.stop ();
+	_prepare_queue.reset ();
 
 	_thread.interrupt ();
 	try {
@@ -136,6 +154,11 @@ Butler::~Butler ()
 bool
 Butler::should_run () const
 {
+	static auto& video_metric = Metrics::instance()->gauge("dcpomatic_butler_video_frames", "Video frames that the butler has ready");
+	static auto& audio_metric = Metrics::instance()->gauge("dcpomatic_butler_audio_frames", "Audio frames that the butler has ready");
+	video_metric.set (_video.size());
+	audio_metric.set (_audio.size());
+
 	if (_video.size() >= MAXIMUM_VIDEO_READAHEAD * 10) {
 		/* This is way too big */
 		optional<DCPTime> pos = _audio.peek();
@@ -178,6 +201,11 @@ Butler::should_run () const
 		return true;
 	}
 
+	if (_video.full()) {
+		/* We can't store any more video, so there's no point running until some has been taken */
+		return false;
+	}
+
 	/* Run if we aren't full of video or audio */
 	return (_video.size() < MAXIMUM_VIDEO_READAHEAD) && (_audio.size() < MAXIMUM_AUDIO_READAHEAD);
 }
@@ -285,7 +313,7 @@ Butler::get_video (Behaviour behaviour, Error* e)
 optional<TextRingBuffers::Data>
 Butler::get_closed_caption ()
 {
-	boost::mutex::scoped_lock lm (_mutex);
+	/* _closed_caption needs no lock, so this will not wait for anything the butler thread is doing */
 	return _closed_caption.get ();
 }
 
@@ -313,15 +341,34 @@ Butler::seek_unlocked (DCPTime position, bool accurate)
 	_video.clear ();
 	_audio.clear ();
 	_closed_caption.clear ();
+	/* Nothing that is waiting to be prepared will be wanted now */
+	_prepare_queue->clear ();
+
+	{
+		/* Whoever set the deadline will need to tell us again once they are showing video from the new position */
+		boost::mutex::scoped_lock lm2 (_deadline_mutex);
+		_deadline = boost::none;
+	}
 
 	_summon.notify_all ();
 }
 
 
 void
-Butler::prepare (weak_ptr<PlayerVideo> weak_video)
+Butler::prepare (weak_ptr<PlayerVideo> weak_video, DCPTime time)
 try
 {
+	{
+		boost::mutex::scoped_lock lm (_deadline_mutex);
+		if (_deadline && time < *_deadline) {
+			/* This video will be dropped when it is taken, so don't waste time (perhaps decoding
+			 * JPEG2000) to prepare it.  If it is used after all it will be prepared then.
+			 */
+			LOG_TIMING("skip-prepare in %1", thread_id());
+			return;
+		}
+	}
+
 	auto video = weak_video.lock ();
 	/* If the weak_ptr cannot be locked the video obviously no longer requires any work */
 	if (video) {
@@ -355,9 +402,11 @@ Butler::video (shared_ptr<PlayerVideo> video, DCPTime time)
 		return;
 	}
 
-	_prepare_service.post (bind(&Butler::prepare, this, weak_ptr<PlayerVideo>(video)));
+	_prepare_queue->add (time, bind(&Butler::prepare, this, weak_ptr<PlayerVideo>(video), time));
 
-	_video.put (video, time);
+	if (!_video.put(video, time)) {
+		LOG_WARNING ("Butler video buffers full at %1 frames; dropping frame at %2", _video.size(), time.get());
+	}
 }
 
 
@@ -370,7 +419,7 @@ Butler::audio (shared_ptr<AudioBuffers> audio, DCPTime time, int frame_rate)
 		return;
 	}
 
-	_audio.put (remap(audio, _audio_channels, _audio_mapping), time, frame_rate);
+	_audio.put (audio, time, frame_rate, _audio_mapping);
 }
 
 
@@ -383,12 +432,16 @@ Butler::audio (shared_ptr<AudioBuffers> audio, DCPTime time, int frame_rate)
 optional<DCPTime>
 Butler::get_audio (Behaviour behaviour, float* out, Frame frames)
 {
-	boost::mutex::scoped_lock lm (_mutex);
-
-	while (behaviour == Behaviour::BLOCKING && !_finished && !_died && _audio.size() < frames) {
-		_arrived.wait (lm);
+	if (behaviour == Behaviour::BLOCKING) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_finished && !_died && _audio.size() < frames) {
+			_arrived.wait (lm);
+		}
 	}
 
+	/* This may be called from an audio callback, so in the NON_BLOCKING case we neither lock nor
+	 * allocate.  If the butler thread misses this notify it will get the next one.
+	 */
 	auto t = _audio.get (out, _audio_channels, frames);
 	_summon.notify_all ();
 	return t;
@@ -398,14 +451,34 @@ Butler::get_audio (Behaviour behaviour, float* out, Frame frames)
 pair<size_t, string>
 Butler::memory_used () const
 {
-	/* XXX: should also look at _audio.memory_used() */
-	return _video.memory_used();
+	auto const video = _video.memory_used();
+	auto const audio = _audio.memory_used();
+	auto const images = ImagePool::instance()->memory_used();
+	return make_pair(video.first + audio.first + images.first, String::compose("%1, %2, %3", video.second, audio.second, images.second));
+}
+
+
+/** Tell the butler that any video before a given time will be too late to be shown, so
+ *  it need not be prepared.
+ *  @param deadline Deadline, or boost::none to prepare all video.
+ */
+void
+Butler::set_deadline (optional<DCPTime> deadline)
+{
+	boost::mutex::scoped_lock lm (_deadline_mutex);
+	_deadline = deadline;
 }
 
 
 void
 Butler::player_change (ChangeType type, int property)
 {
+	if (property == PlayerProperty::FILM_VIDEO_FRAME_RATE && type == ChangeType::DONE) {
+		if (auto film = _film.lock()) {
+			_prepare_queue->set_frame_rate (film->video_frame_rate());
+		}
+	}
+
 	if (property == VideoContentProperty::CROP) {
 		if (type == ChangeType::DONE) {
 			auto film = _film.lock();
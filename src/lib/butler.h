@@ -29,7 +29,6 @@
 #include "exception_store.h"
 #include "text_ring_buffers.h"
 #include "video_ring_buffers.h"
-#include <boost/asio.hpp>
 #include <boost/signals2.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
@@ -37,6 +36,7 @@
 
 class Player;
 class PlayerVideo;
+class PrepareQueue;
 
 
 class Butler : public ExceptionStore
@@ -58,7 +58,9 @@ public:
 		Image::Alignment alignment,
 		bool fast,
 		bool prepare_only_proxy,
-		Audio audio
+		Audio audio,
+		int prepare_threads = 0,
+		int scale_threads = 1
 		);
 
 	~Butler ();
@@ -94,13 +96,15 @@ public:
 
 	std::pair<size_t, std::string> memory_used () const;
 
+	void set_deadline (boost::optional<dcpomatic::DCPTime> deadline);
+
 private:
 	void thread ();
 	void video (std::shared_ptr<PlayerVideo> video, dcpomatic::DCPTime time);
 	void audio (std::shared_ptr<AudioBuffers> audio, dcpomatic::DCPTime time, int frame_rate);
 	void text (PlayerText pt, TextType type, boost::optional<DCPTextTrack> track, dcpomatic::DCPTimePeriod period);
 	bool should_run () const;
-	void prepare (std::weak_ptr<PlayerVideo> video);
+	void prepare (std::weak_ptr<PlayerVideo> video, dcpomatic::DCPTime time);
 	void player_change (ChangeType type, int property);
 	void seek_unlocked (dcpomatic::DCPTime position, bool accurate);
 
@@ -112,9 +116,8 @@ private:
 	AudioRingBuffers _audio;
 	TextRingBuffers _closed_caption;
 
-	boost::thread_group _prepare_pool;
-	boost::asio::io_service _prepare_service;
-	std::shared_ptr<boost::asio::io_service::work> _prepare_work;
+	/** threads to prepare the PlayerVideos that we have, earliest first */
+	std::unique_ptr<PrepareQueue> _prepare_queue;
 
 	/** mutex to protect _pending_seek_position, _pending_seek_accurate, _finished, _died, _stop_thread */
 	boost::mutex _mutex;
@@ -151,6 +154,11 @@ private:
 	*/
 	boost::optional<dcpomatic::DCPTime> _awaiting;
 
+	/** mutex to protect _deadline */
+	mutable boost::mutex _deadline_mutex;
+	/** Video before this time will be too late to be shown, so there is no point in preparing it */
+	boost::optional<dcpomatic::DCPTime> _deadline;
+
 	boost::signals2::scoped_connection _player_video_connection;
 	boost::signals2::scoped_connection _player_audio_connection;
 	boost::signals2::scoped_connection _player_text_connection;
@@ -67,8 +67,14 @@ CheckContentJob::run ()
 	set_progress_unknown ();
 
 	auto content = _film->content();
+
+	/* Loading the film only checked some of the content's files, to save time; check the rest now */
+	for (auto c: content) {
+		c->check_paths ();
+	}
+
 	std::vector<shared_ptr<Content>> changed;
-	std::copy_if (content.begin(), content.end(), std::back_inserter(changed), [](shared_ptr<Content> c) { return c->changed(); });
+	std::copy_if (content.begin(), content.end(), std::back_inserter(changed), [](shared_ptr<Content> c) { return c->paths_valid() && c->changed(); });
 
 	if (_film->last_written_by_earlier_than(2, 16, 15)) {
 		for (auto c: content) {
@@ -22,15 +22,20 @@
 #include "combine_dcp_job.h"
 #include "compose.hpp"
 #include "config.h"
+#include "scope_guard.h"
+#include "util.h"
 #include <dcp/combine.h>
 #include <dcp/exceptions.h>
+#include <boost/thread.hpp>
 
 #include "i18n.h"
 
 
+using std::min;
 using std::string;
 using std::vector;
 using std::shared_ptr;
+using boost::optional;
 
 
 CombineDCPJob::CombineDCPJob (vector<boost::filesystem::path> inputs, boost::filesystem::path output, string annotation_text)
@@ -57,26 +62,75 @@ CombineDCPJob::json_name () const
 }
 
 
+/** @return total size of the files in a directory and its sub-directories, ignoring any errors */
+static boost::uintmax_t
+directory_size (boost::filesystem::path directory)
+{
+	boost::uintmax_t total = 0;
+	boost::system::error_code ec;
+	for (auto i = boost::filesystem::recursive_directory_iterator(directory, ec); i != boost::filesystem::recursive_directory_iterator(); i.increment(ec)) {
+		if (ec) {
+			break;
+		}
+		if (boost::filesystem::is_regular_file(i->path(), ec)) {
+			total += boost::filesystem::file_size(i->path(), ec);
+		}
+	}
+	return total;
+}
+
+
 void
 CombineDCPJob::run ()
 {
-	try {
-		dcp::combine (
-			_inputs,
-			_output,
-			String::compose("libdcp %1", dcp::version),
-			String::compose("libdcp %1", dcp::version),
-			dcp::LocalTime().as_string(),
-			_annotation_text,
-			Config::instance()->signer_chain()
-			);
-	} catch (dcp::CombineError& e) {
-		set_state (FINISHED_ERROR);
-		set_error (e.what(), "");
-		return;
-	} catch (dcp::ReadError& e) {
+	boost::uintmax_t total = 0;
+	for (auto const& input: _inputs) {
+		total += directory_size (input);
+	}
+
+	sub (_("Copying assets"));
+
+	optional<string> error;
+	string error_detail;
+
+	{
+		/* dcp::combine does not tell us how it is getting on, so we watch the output grow */
+		boost::thread progress ([this, total]() {
+			start_of_thread ("CombineDCPJob");
+			while (true) {
+				boost::this_thread::sleep (boost::posix_time::milliseconds(500));
+				if (total > 0) {
+					set_progress (min(0.99f, static_cast<float>(directory_size(_output)) / total));
+				}
+			}
+		});
+
+		ScopeGuard sg = [&progress]() {
+			progress.interrupt ();
+			progress.join ();
+		};
+
+		try {
+			dcp::combine (
+				_inputs,
+				_output,
+				String::compose("libdcp %1", dcp::version),
+				String::compose("libdcp %1", dcp::version),
+				dcp::LocalTime().as_string(),
+				_annotation_text,
+				Config::instance()->signer_chain()
+				);
+		} catch (dcp::CombineError& e) {
+			error = e.what();
+		} catch (dcp::ReadError& e) {
+			error = e.what();
+			error_detail = e.detail().get_value_or("");
+		}
+	}
+
+	if (error) {
 		set_state (FINISHED_ERROR);
-		set_error (e.what(), e.detail().get_value_or(""));
+		set_error (*error, error_detail);
 		return;
 	}
 
@@ -31,6 +31,9 @@ public:
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::DISK;
+	}
 
 private:
 	std::vector<boost::filesystem::path> _inputs;
@@ -31,6 +31,7 @@
 #include "film.h"
 #include "filter.h"
 #include "log.h"
+#include "metadata_writer.h"
 #include "ratio.h"
 #include "types.h"
 #include "util.h"
@@ -89,10 +90,21 @@ Config::set_defaults ()
 {
 	_master_encoding_threads = max (2U, boost::thread::hardware_concurrency ());
 	_server_encoding_threads = max (2U, boost::thread::hardware_concurrency ());
+	_decoding_threads = max (2U, boost::thread::hardware_concurrency ());
+	_read_ahead_size = 0;
+	_read_ahead_threads = 4;
+	_mxf_read_ahead_frames = 4;
+	_maximum_disk_jobs = 2;
+	_maximum_network_jobs = 2;
+	_gpu_encoding_threads = 0;
+	_gpu_device = 0;
 	_server_port_base = 6192;
 	_use_any_servers = true;
 	_servers.clear ();
 	_only_servers_encode = false;
+	_compress_frames_for_servers = true;
+	_encoding_priority = 0;
+	_encode_server_key = optional<string>();
 	_tms_protocol = FileTransferProtocol::SCP;
 	_tms_passive = true;
 	_tms_ip = "";
@@ -114,6 +126,8 @@ Config::set_defaults ()
 	_default_interop = false;
 	_default_metadata.clear ();
 	_upload_after_make_dcp = false;
+	_verify_after_make_dcp = false;
+	_disk_verification = DiskVerification::FULL;
 	_mail_server = "";
 	_mail_port = 25;
 	_mail_protocol = EmailProtocol::AUTO;
@@ -132,6 +146,7 @@ Config::set_defaults ()
 	_log_types = LogEntry::TYPE_GENERAL | LogEntry::TYPE_WARNING | LogEntry::TYPE_ERROR | LogEntry::TYPE_DISK;
 	_analyse_ebur128 = true;
 	_automatic_audio_analysis = false;
+	_quick_examination = false;
 #ifdef DCPOMATIC_WINDOWS
 	_win32_console = false;
 #endif
@@ -166,7 +181,13 @@ Config::set_defaults ()
 	   use about 240Mb with 72 encoding threads.
 	*/
 	_frames_in_memory_multiplier = 3;
+	_encode_queue_memory_limit = 2048;
+	_writer_memory_limit = 512;
+	_memory_budget = 0;
+	_j2k_frame_cache_directory = boost::none;
+	_j2k_frame_cache_size = 100;
 	_decode_reduction = optional<int>();
+	_video_decode_hardware = boost::none;
 	_default_notify = false;
 	for (int i = 0; i < NOTIFICATION_COUNT; ++i) {
 		_notification[i] = false;
@@ -182,7 +203,9 @@ Config::set_defaults ()
 	_video_view_type = VIDEO_VIEW_SIMPLE;
 	_respect_kdm_validity_periods = true;
 	_player_debug_log_file = boost::none;
+	_trace_file = boost::none;
 	_player_content_directory = boost::none;
+	_write_behind_directories.clear ();
 	_player_playlist_directory = boost::none;
 	_player_kdm_directory = boost::none;
 	_audio_mapping = boost::none;
@@ -276,8 +299,11 @@ void
 Config::read ()
 {
 	read_config();
-	read_cinemas();
-	read_dkdm_recipients();
+	/* Cinemas and DKDM recipients are read by ensure_cinemas_read() and ensure_dkdm_recipients_read()
+	 * when they are first needed.
+	 */
+	_cinemas_read = false;
+	_dkdm_recipients_read = false;
 }
 
 
@@ -301,12 +327,25 @@ try
 		_server_encoding_threads = f.number_child<int>("ServerEncodingThreads");
 	}
 
+	_decoding_threads = f.optional_number_child<int>("DecodingThreads").get_value_or(max(2U, boost::thread::hardware_concurrency()));
+	_read_ahead_size = f.optional_number_child<int>("ReadAheadSize").get_value_or(0);
+	_read_ahead_threads = f.optional_number_child<int>("ReadAheadThreads").get_value_or(4);
+	_mxf_read_ahead_frames = f.optional_number_child<int>("MXFReadAheadFrames").get_value_or(4);
+	_maximum_disk_jobs = f.optional_number_child<int>("MaximumDiskJobs").get_value_or(2);
+	_maximum_network_jobs = f.optional_number_child<int>("MaximumNetworkJobs").get_value_or(2);
+	_gpu_encoding_threads = f.optional_number_child<int>("GPUEncodingThreads").get_value_or(0);
+	_gpu_device = f.optional_number_child<int>("GPUDevice").get_value_or(0);
+
 	_default_directory = f.optional_string_child ("DefaultDirectory");
 	if (_default_directory && _default_directory->empty ()) {
 		/* We used to store an empty value for this to mean "none set" */
 		_default_directory = boost::optional<boost::filesystem::path> ();
 	}
 
+	for (auto i: f.node_children("WriteBehindDirectory")) {
+		_write_behind_directories.push_back (i->content());
+	}
+
 	auto b = f.optional_number_child<int> ("ServerPort");
 	if (!b) {
 		b = f.optional_number_child<int> ("ServerPortBase");
@@ -325,6 +364,9 @@ try
 	}
 
 	_only_servers_encode = f.optional_bool_child ("OnlyServersEncode").get_value_or (false);
+	_compress_frames_for_servers = f.optional_bool_child("CompressFramesForServers").get_value_or(true);
+	_encoding_priority = f.optional_number_child<int>("EncodingPriority").get_value_or(0);
+	_encode_server_key = f.optional_string_child("EncodeServerKey");
 	_tms_protocol = static_cast<FileTransferProtocol>(f.optional_number_child<int>("TMSProtocol").get_value_or(static_cast<int>(FileTransferProtocol::SCP)));
 	_tms_passive = f.optional_bool_child("TMSPassive").get_value_or(true);
 	_tms_ip = f.string_child ("TMSIP");
@@ -358,6 +400,12 @@ try
 		up = f.optional_bool_child("DefaultUploadAfterMakeDCP");
 	}
 	_upload_after_make_dcp = up.get_value_or (false);
+	_verify_after_make_dcp = f.optional_bool_child("VerifyAfterMakeDCP").get_value_or(false);
+	if (auto verification = f.optional_string_child("DiskVerification")) {
+		if (*verification == "full" || *verification == "fast" || *verification == "sampled") {
+			_disk_verification = string_to_disk_verification(*verification);
+		}
+	}
 	_dcp_creator = f.optional_string_child ("DCPCreator").get_value_or ("");
 	_dcp_company_name = f.optional_string_child("DCPCompanyName").get_value_or("");
 	_dcp_product_name = f.optional_string_child("DCPProductName").get_value_or("");
@@ -436,6 +484,7 @@ try
 	_log_types = f.optional_number_child<int> ("LogTypes").get_value_or (LogEntry::TYPE_GENERAL | LogEntry::TYPE_WARNING | LogEntry::TYPE_ERROR);
 	_analyse_ebur128 = f.optional_bool_child("AnalyseEBUR128").get_value_or (true);
 	_automatic_audio_analysis = f.optional_bool_child ("AutomaticAudioAnalysis").get_value_or (false);
+	_quick_examination = f.optional_bool_child("QuickExamination").get_value_or(false);
 #ifdef DCPOMATIC_WINDOWS
 	_win32_console = f.optional_bool_child ("Win32Console").get_value_or (false);
 #endif
@@ -545,7 +594,13 @@ try
 		}
 	}
 	_frames_in_memory_multiplier = f.optional_number_child<int>("FramesInMemoryMultiplier").get_value_or(3);
+	_encode_queue_memory_limit = f.optional_number_child<int>("EncodeQueueMemoryLimit").get_value_or(2048);
+	_writer_memory_limit = f.optional_number_child<int>("WriterMemoryLimit").get_value_or(512);
+	_memory_budget = f.optional_number_child<int>("MemoryBudget").get_value_or(0);
+	_j2k_frame_cache_directory = f.optional_string_child("J2KFrameCacheDirectory");
+	_j2k_frame_cache_size = f.optional_number_child<int>("J2KFrameCacheSize").get_value_or(100);
 	_decode_reduction = f.optional_number_child<int>("DecodeReduction");
+	_video_decode_hardware = f.optional_string_child("VideoDecodeHardware");
 	_default_notify = f.optional_bool_child("DefaultNotify").get_value_or(false);
 
 	for (auto i: f.node_children("Notification")) {
@@ -580,6 +635,7 @@ try
 	}
 	_respect_kdm_validity_periods = f.optional_bool_child("RespectKDMValidityPeriods").get_value_or(true);
 	_player_debug_log_file = f.optional_string_child("PlayerDebugLogFile");
+	_trace_file = f.optional_string_child("TraceFile");
 	_player_content_directory = f.optional_string_child("PlayerContentDirectory");
 	_player_playlist_directory = f.optional_string_child("PlayerPlaylistDirectory");
 	_player_kdm_directory = f.optional_string_child("PlayerKDMDirectory");
@@ -646,6 +702,18 @@ Config::read_cinemas()
 }
 
 
+void
+Config::ensure_cinemas_read() const
+{
+	if (_cinemas_read) {
+		return;
+	}
+
+	_cinemas_read = true;
+	const_cast<Config*>(this)->read_cinemas();
+}
+
+
 void
 Config::read_dkdm_recipients()
 {
@@ -663,6 +731,18 @@ Config::read_dkdm_recipients()
 }
 
 
+void
+Config::ensure_dkdm_recipients_read() const
+{
+	if (_dkdm_recipients_read) {
+		return;
+	}
+
+	_dkdm_recipients_read = true;
+	const_cast<Config*>(this)->read_dkdm_recipients();
+}
+
+
 /** @return Singleton instance */
 Config *
 Config::instance ()
@@ -684,11 +764,11 @@ Config::write () const
 	write_dkdm_recipients ();
 }
 
-void
-Config::write_config () const
+shared_ptr<xmlpp::Document>
+Config::config_document () const
 {
-	xmlpp::Document doc;
-	auto root = doc.create_root_node ("Config");
+	auto doc = make_shared<xmlpp::Document>();
+	auto root = doc->create_root_node ("Config");
 
 	/* [XML] Version The version number of the configuration file format. */
 	root->add_child("Version")->add_child_text (raw_convert<string>(_current_version));
@@ -696,10 +776,32 @@ Config::write_config () const
 	root->add_child("MasterEncodingThreads")->add_child_text (raw_convert<string> (_master_encoding_threads));
 	/* [XML] ServerEncodingThreads Number of encoding threads to use when running as server. */
 	root->add_child("ServerEncodingThreads")->add_child_text (raw_convert<string> (_server_encoding_threads));
+	/* [XML] DecodingThreads Number of threads to share between the video decoders that are in use at any one time. */
+	root->add_child("DecodingThreads")->add_child_text (raw_convert<string> (_decoding_threads));
+	/* [XML] ReadAheadSize Number of MB to read ahead of each decoder in the files that it is reading, or 0 to not read ahead. */
+	root->add_child("ReadAheadSize")->add_child_text (raw_convert<string> (_read_ahead_size));
+	/* [XML] ReadAheadThreads Number of threads that each decoder should use to read ahead. */
+	root->add_child("ReadAheadThreads")->add_child_text (raw_convert<string> (_read_ahead_threads));
+	/* [XML] MXFReadAheadFrames Number of frames that decoders of MXFs (and DCPs) should read ahead of the one that they need, or 0 to not read ahead. */
+	root->add_child("MXFReadAheadFrames")->add_child_text(raw_convert<string>(_mxf_read_ahead_frames));
+	/* [XML] MaximumDiskJobs Largest number of jobs which mostly read or write files that may run at the same time. */
+	root->add_child("MaximumDiskJobs")->add_child_text (raw_convert<string> (_maximum_disk_jobs));
+	/* [XML] MaximumNetworkJobs Largest number of jobs which mostly use the network that may run at the same time. */
+	root->add_child("MaximumNetworkJobs")->add_child_text (raw_convert<string> (_maximum_network_jobs));
+	/* [XML] GPUEncodingThreads Number of encoding threads which should use a GPU (only used if DCP-o-matic is built with GPU support). */
+	root->add_child("GPUEncodingThreads")->add_child_text (raw_convert<string> (_gpu_encoding_threads));
+	/* [XML] GPUDevice Index of the GPU to use for encoding. */
+	root->add_child("GPUDevice")->add_child_text (raw_convert<string> (_gpu_device));
 	if (_default_directory) {
 		/* [XML:opt] DefaultDirectory Default directory when creating a new film in the GUI. */
 		root->add_child("DefaultDirectory")->add_child_text (_default_directory->string ());
 	}
+	for (auto const& i: _write_behind_directories) {
+		/* [XML:opt] WriteBehindDirectory Directory in which films' picture assets should be written out to disk as they
+		   are made and then dropped from the cache; there can be any number of these tags.
+		*/
+		root->add_child("WriteBehindDirectory")->add_child_text(i.string());
+	}
 	/* [XML] ServerPortBase Port number to use for frame encoding requests.  <code>ServerPortBase</code> + 1 and
 	   <code>ServerPortBase</code> + 2 are used for querying servers.  <code>ServerPortBase</code> + 3 is used
 	   by the batch converter to listen for job requests.
@@ -719,6 +821,18 @@ Config::write_config () const
 	   is done by the encoding servers.  0 to set the master to do some encoding as well as coordinating the job.
 	*/
 	root->add_child("OnlyServersEncode")->add_child_text (_only_servers_encode ? "1" : "0");
+	/* [XML] CompressFramesForServers 1 to compress uncompressed frames (losslessly) before sending them to encoding servers,
+	   0 to send them as they are.
+	*/
+	root->add_child("CompressFramesForServers")->add_child_text(_compress_frames_for_servers ? "1" : "0");
+	/* [XML] EncodingPriority Priority (from -4 to 4) to ask encoding servers to give this master's frames, relative to
+	   other masters; each step up doubles this master's share of a busy server.
+	*/
+	root->add_child("EncodingPriority")->add_child_text(raw_convert<string>(_encoding_priority));
+	if (_encode_server_key) {
+		/* [XML] EncodeServerKey Key shared with encoding servers to encrypt and authenticate the frames sent to and from them. */
+		root->add_child("EncodeServerKey")->add_child_text(*_encode_server_key);
+	}
 	/* [XML] TMSProtocol Protocol to use to copy files to a TMS; 0 to use SCP, 1 for FTP. */
 	root->add_child("TMSProtocol")->add_child_text (raw_convert<string> (static_cast<int> (_tms_protocol)));
 	/* [XML] TMSPassive True to use PASV mode with TMS FTP connections. */
@@ -764,6 +878,13 @@ Config::write_config () const
 	root->add_child("DCPJ2KComment")->add_child_text (_dcp_j2k_comment);
 	/* [XML] UploadAfterMakeDCP 1 to upload to a TMS after making a DCP, 0 for no upload. */
 	root->add_child("UploadAfterMakeDCP")->add_child_text (_upload_after_make_dcp ? "1" : "0");
+	/* [XML] VerifyAfterMakeDCP 1 to check each DCP (alongside any upload) after making it, 0 to not do that. */
+	root->add_child("VerifyAfterMakeDCP")->add_child_text (_verify_after_make_dcp ? "1" : "0");
+	/* [XML] DiskVerification How the disk writer checks data that it has written to a drive: <code>full</code>
+	   to read it all back and compare MD5s, <code>fast</code> to read it all back and compare CRC-32Cs or
+	   <code>sampled</code> to read back and compare only some blocks.
+	*/
+	root->add_child("DiskVerification")->add_child_text (disk_verification_to_string(_disk_verification));
 
 	/* [XML] DefaultStillLength Default length (in seconds) for still images in new films. */
 	root->add_child("DefaultStillLength")->add_child_text (raw_convert<string> (_default_still_length));
@@ -862,6 +983,8 @@ Config::write_config () const
 	root->add_child("AnalyseEBUR128")->add_child_text (_analyse_ebur128 ? "1" : "0");
 	/* [XML] AutomaticAudioAnalysis 1 to run audio analysis automatically when audio content is added to the film, otherwise 0. */
 	root->add_child("AutomaticAudioAnalysis")->add_child_text (_automatic_audio_analysis ? "1" : "0");
+	/* [XML] QuickExamination 1 to examine content quickly when it is added to a film, and then exactly in the background, otherwise 0. */
+	root->add_child("QuickExamination")->add_child_text(_quick_examination ? "1" : "0");
 #ifdef DCPOMATIC_WINDOWS
 	if (_win32_console) {
 		/* [XML] Win32Console 1 to open a console when running on Windows, otherwise 0.
@@ -976,12 +1099,35 @@ Config::write_config () const
 	   frames to be held in memory at once.
 	*/
 	root->add_child("FramesInMemoryMultiplier")->add_child_text(raw_convert<string>(_frames_in_memory_multiplier));
+	/* [XML] EncodeQueueMemoryLimit maximum memory, in megabytes, to use for frames which are waiting to be encoded. */
+	root->add_child("EncodeQueueMemoryLimit")->add_child_text(raw_convert<string>(_encode_queue_memory_limit));
+	/* [XML] WriterMemoryLimit memory, in megabytes, that may be used for encoded frames which are waiting to be written before
+	   some are put in temporary files.
+	*/
+	root->add_child("WriterMemoryLimit")->add_child_text(raw_convert<string>(_writer_memory_limit));
+	/* [XML] MemoryBudget memory, in megabytes, that decoding, the encode queue, the writer queue and the subtitle cache
+	   may use between them before they are held back; 0 for no budget.
+	*/
+	root->add_child("MemoryBudget")->add_child_text(raw_convert<string>(_memory_budget));
+	if (_j2k_frame_cache_directory) {
+		/* [XML:opt] J2KFrameCacheDirectory Directory to keep encoded JPEG2000 frames in, so that they can be re-used by later encodes. */
+		root->add_child("J2KFrameCacheDirectory")->add_child_text(_j2k_frame_cache_directory->string());
+	}
+	/* [XML] J2KFrameCacheSize Maximum size of the JPEG2000 frame cache in gigabytes. */
+	root->add_child("J2KFrameCacheSize")->add_child_text(raw_convert<string>(_j2k_frame_cache_size));
 
 	/* [XML] DecodeReduction power of 2 to reduce DCP images by before decoding in the player. */
 	if (_decode_reduction) {
 		root->add_child("DecodeReduction")->add_child_text(raw_convert<string>(_decode_reduction.get()));
 	}
 
+	if (_video_decode_hardware) {
+		/* [XML:opt] VideoDecodeHardware FFmpeg name of the type of hardware to decode video with (e.g. vaapi, cuda, videotoolbox, d3d11va);
+		 * if this is not present video is decoded in software.
+		 */
+		root->add_child("VideoDecodeHardware")->add_child_text(*_video_decode_hardware);
+	}
+
 	/* [XML] DefaultNotify 1 to default jobs to notify when complete, otherwise 0. */
 	root->add_child("DefaultNotify")->add_child_text(_default_notify ? "1" : "0");
 
@@ -1050,6 +1196,10 @@ Config::write_config () const
 		/* [XML] PlayerLogFile Filename to use for player debug logs. */
 		root->add_child("PlayerDebugLogFile")->add_child_text(_player_debug_log_file->string());
 	}
+	if (_trace_file) {
+		/* [XML] TraceFile Filename to write a trace of the timing of each DCP encode to, which can be viewed with Perfetto or Chrome's about:tracing. */
+		root->add_child("TraceFile")->add_child_text(_trace_file->string());
+	}
 	if (_player_content_directory) {
 		/* [XML] PlayerContentDirectory Directory to use for player content in the dual-screen mode. */
 		root->add_child("PlayerContentDirectory")->add_child_text(_player_content_directory->string());
@@ -1089,10 +1239,21 @@ Config::write_config () const
 
 	_export.write(root->add_child("Export"));
 
+	return doc;
+}
+
+
+void
+Config::write_config () const
+{
+	auto doc = config_document ();
 	auto target = config_write_file();
 
+	/* Make sure that an older version waiting to be written in the background does not overwrite this one */
+	MetadataWriter::instance()->cancel(target);
+
 	try {
-		auto const s = doc.write_to_string_formatted ();
+		auto const s = doc->write_to_string_formatted ();
 		boost::filesystem::path tmp (string(target.string()).append(".tmp"));
 		dcp::File f(tmp, "w");
 		if (!f) {
@@ -1111,19 +1272,31 @@ Config::write_config () const
 
 
 template <class T>
-void
-write_file (string root_node, string node, string version, list<shared_ptr<T>> things, boost::filesystem::path file)
+shared_ptr<xmlpp::Document>
+list_document (string root_node, string node, string version, list<shared_ptr<T>> things)
 {
-	xmlpp::Document doc;
-	auto root = doc.create_root_node (root_node);
+	auto doc = make_shared<xmlpp::Document>();
+	auto root = doc->create_root_node (root_node);
 	root->add_child("Version")->add_child_text(version);
 
 	for (auto i: things) {
 		i->as_xml (root->add_child(node));
 	}
 
+	return doc;
+}
+
+
+template <class T>
+void
+write_file (string root_node, string node, string version, list<shared_ptr<T>> things, boost::filesystem::path file)
+{
+	auto doc = list_document (root_node, node, version, things);
+
+	MetadataWriter::instance()->cancel(file);
+
 	try {
-		doc.write_to_file_formatted (file.string() + ".tmp");
+		doc->write_to_file_formatted (file.string() + ".tmp");
 		boost::filesystem::remove (file);
 		boost::filesystem::rename (file.string() + ".tmp", file);
 	} catch (xmlpp::exception& e) {
@@ -1137,6 +1310,7 @@ write_file (string root_node, string node, string version, list<shared_ptr<T>> t
 void
 Config::write_cinemas () const
 {
+	ensure_cinemas_read ();
 	write_file ("Cinemas", "Cinema", "1", _cinemas, _cinemas_file);
 }
 
@@ -1144,10 +1318,34 @@ Config::write_cinemas () const
 void
 Config::write_dkdm_recipients () const
 {
+	ensure_dkdm_recipients_read ();
 	write_file ("DKDMRecipients", "DKDMRecipient", "1", _dkdm_recipients, _dkdm_recipients_file);
 }
 
 
+/** Write whichever of config.xml, the cinemas and the DKDM recipients a change to a property
+ *  affects.  The writing is done by a background thread a little later, so that a run of
+ *  changes results in one write; any error will be thrown by MetadataWriter::rethrow().
+ */
+void
+Config::write_soon (Property what) const
+{
+	switch (what) {
+	case CINEMAS:
+		ensure_cinemas_read ();
+		MetadataWriter::instance()->write(list_document("Cinemas", "Cinema", "1", _cinemas), _cinemas_file);
+		break;
+	case DKDM_RECIPIENTS:
+		ensure_dkdm_recipients_read ();
+		MetadataWriter::instance()->write(list_document("DKDMRecipients", "DKDMRecipient", "1", _dkdm_recipients), _dkdm_recipients_file);
+		break;
+	default:
+		MetadataWriter::instance()->write(config_document(), config_write_file());
+		break;
+	}
+}
+
+
 boost::filesystem::path
 Config::default_directory_or (boost::filesystem::path a) const
 {
@@ -1329,6 +1527,9 @@ Config::set_cinemas_file (boost::filesystem::path file)
 		return;
 	}
 
+	/* Pick up any cinemas from the old file before we replace them */
+	ensure_cinemas_read ();
+
 	_cinemas_file = file;
 
 	if (boost::filesystem::exists (_cinemas_file)) {
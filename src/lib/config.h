@@ -49,6 +49,10 @@ class DKDMRecipient;
 class Film;
 class Ratio;
 
+namespace xmlpp {
+	class Document;
+}
+
 
 extern void save_all_config_as_zip (boost::filesystem::path zip_file);
 
@@ -69,6 +73,46 @@ public:
 		return _server_encoding_threads;
 	}
 
+	/** @return number of threads to share between the video decoders that are being used at any one time */
+	int decoding_threads () const {
+		return _decoding_threads;
+	}
+
+	/** @return number of MB to read ahead of each decoder in the files that it is reading, or 0 to not read ahead */
+	int read_ahead_size () const {
+		return _read_ahead_size;
+	}
+
+	/** @return number of threads that each decoder should use to read ahead */
+	int read_ahead_threads () const {
+		return _read_ahead_threads;
+	}
+
+	/** @return number of frames that MXF decoders should read ahead of the one that they need, or 0 to not read ahead */
+	int mxf_read_ahead_frames () const {
+		return _mxf_read_ahead_frames;
+	}
+
+	/** @return largest number of jobs which mostly read or write files that may run at the same time */
+	int maximum_disk_jobs () const {
+		return _maximum_disk_jobs;
+	}
+
+	/** @return largest number of jobs which mostly use the network that may run at the same time */
+	int maximum_network_jobs () const {
+		return _maximum_network_jobs;
+	}
+
+	/** @return number of threads which should use a GPU for J2K encoding on the local machine */
+	int gpu_encoding_threads () const {
+		return _gpu_encoding_threads;
+	}
+
+	/** @return index of the GPU to use for J2K encoding */
+	int gpu_device () const {
+		return _gpu_device;
+	}
+
 	boost::optional<boost::filesystem::path> default_directory () const {
 		return _default_directory;
 	}
@@ -80,6 +124,13 @@ public:
 	boost::filesystem::path default_directory_or (boost::filesystem::path a) const;
 	boost::filesystem::path default_kdm_directory_or (boost::filesystem::path a) const;
 
+	/** @return directories in which films' picture assets should be pushed out to the disk
+	 *  as they are written and then dropped from the cache (see WriteBehind).
+	 */
+	std::vector<boost::filesystem::path> write_behind_directories () const {
+		return _write_behind_directories;
+	}
+
 	enum Property {
 		USE_ANY_SERVERS,
 		SERVERS,
@@ -126,6 +177,26 @@ public:
 		return _only_servers_encode;
 	}
 
+	/** @return true to compress uncompressed frames before sending them to encoding servers */
+	bool compress_frames_for_servers () const {
+		return _compress_frames_for_servers;
+	}
+
+	/** @return priority to ask encoding servers to give our frames, relative to other masters';
+	 *  each step up (from -4 to 4) doubles our share of a busy server.
+	 */
+	int encoding_priority () const {
+		return _encoding_priority;
+	}
+
+	/** @return key shared with encoding servers (and given to their copies of DCP-o-matic) to
+	 *  encrypt the frames that go between us and them, and to check that both ends are ours;
+	 *  if this is not set the frames go in the clear, as they always used to.
+	 */
+	boost::optional<std::string> encode_server_key () const {
+		return _encode_server_key;
+	}
+
 	FileTransferProtocol tms_protocol () const {
 		return _tms_protocol;
 	}
@@ -155,10 +226,12 @@ public:
 	}
 
 	std::list<std::shared_ptr<Cinema>> cinemas () const {
+		ensure_cinemas_read ();
 		return _cinemas;
 	}
 
 	std::list<std::shared_ptr<DKDMRecipient>> dkdm_recipients () const {
+		ensure_dkdm_recipients_read ();
 		return _dkdm_recipients;
 	}
 
@@ -250,6 +323,16 @@ public:
 		return _upload_after_make_dcp;
 	}
 
+	/** @return true to check each DCP (while it is being uploaded, if it is) after making it */
+	bool verify_after_make_dcp () const {
+		return _verify_after_make_dcp;
+	}
+
+	/** @return how the disk writer should check the data that it writes to drives */
+	DiskVerification disk_verification () const {
+		return _disk_verification;
+	}
+
 	void set_default_kdm_directory (boost::filesystem::path d) {
 		if (_default_kdm_directory && _default_kdm_directory.get() == d) {
 			return;
@@ -354,6 +437,10 @@ public:
 		return _automatic_audio_analysis;
 	}
 
+	bool quick_examination () const {
+		return _quick_examination;
+	}
+
 #ifdef DCPOMATIC_WINDOWS
 	bool win32_console () const {
 		return _win32_console;
@@ -471,10 +558,46 @@ public:
 		return _frames_in_memory_multiplier;
 	}
 
+	/** @return Maximum memory (in megabytes) that should be used by frames waiting to be encoded */
+	int encode_queue_memory_limit () const {
+		return _encode_queue_memory_limit;
+	}
+
+	/** @return Memory (in megabytes) that the writer may use to hold encoded frames which are waiting to be written,
+	 *  before it starts to put them in temporary files.
+	 */
+	int writer_memory_limit () const {
+		return _writer_memory_limit;
+	}
+
+	/** @return Memory (in megabytes) that the decoders, player, encoder queue, writer queue and
+	 *  subtitle cache may use between them, or 0 for no limit other than their own.
+	 */
+	int memory_budget () const {
+		return _memory_budget;
+	}
+
+	/** @return Directory to keep encoded J2K frames in for re-use, or none to not keep them */
+	boost::optional<boost::filesystem::path> j2k_frame_cache_directory () const {
+		return _j2k_frame_cache_directory;
+	}
+
+	/** @return Maximum size of the J2K frame cache in gigabytes */
+	int j2k_frame_cache_size () const {
+		return _j2k_frame_cache_size;
+	}
+
 	boost::optional<int> decode_reduction () const {
 		return _decode_reduction;
 	}
 
+	/** @return FFmpeg name of the type of hardware to decode video with (e.g. vaapi, cuda, videotoolbox, d3d11va),
+	 *  or none to decode in software.
+	 */
+	boost::optional<std::string> video_decode_hardware () const {
+		return _video_decode_hardware;
+	}
+
 	bool default_notify () const {
 		return _default_notify;
 	}
@@ -544,6 +667,10 @@ public:
 		return _player_debug_log_file;
 	}
 
+	boost::optional<boost::filesystem::path> trace_file () const {
+		return _trace_file;
+	}
+
 	boost::optional<boost::filesystem::path> player_content_directory () const {
 		return _player_content_directory;
 	}
@@ -612,6 +739,42 @@ public:
 		maybe_set (_server_encoding_threads, n);
 	}
 
+	void set_decoding_threads (int n) {
+		maybe_set (_decoding_threads, n);
+	}
+
+	void set_read_ahead_size (int s) {
+		maybe_set (_read_ahead_size, s);
+	}
+
+	void set_read_ahead_threads (int n) {
+		maybe_set (_read_ahead_threads, n);
+	}
+
+	void set_mxf_read_ahead_frames (int n) {
+		maybe_set (_mxf_read_ahead_frames, n);
+	}
+
+	void set_maximum_disk_jobs (int n) {
+		maybe_set (_maximum_disk_jobs, n);
+	}
+
+	void set_maximum_network_jobs (int n) {
+		maybe_set (_maximum_network_jobs, n);
+	}
+
+	void set_gpu_encoding_threads (int n) {
+		maybe_set (_gpu_encoding_threads, n);
+	}
+
+	void set_gpu_device (int d) {
+		maybe_set (_gpu_device, d);
+	}
+
+	void set_write_behind_directories (std::vector<boost::filesystem::path> d) {
+		maybe_set (_write_behind_directories, d);
+	}
+
 	void set_default_directory (boost::filesystem::path d) {
 		if (_default_directory && *_default_directory == d) {
 			return;
@@ -629,6 +792,22 @@ public:
 		maybe_set (_only_servers_encode, o);
 	}
 
+	void set_compress_frames_for_servers (bool c) {
+		maybe_set (_compress_frames_for_servers, c);
+	}
+
+	void set_encoding_priority (int p) {
+		maybe_set (_encoding_priority, p);
+	}
+
+	void set_encode_server_key (std::string k) {
+		maybe_set (_encode_server_key, k);
+	}
+
+	void unset_encode_server_key () {
+		maybe_set (_encode_server_key, boost::optional<std::string>());
+	}
+
 	void set_tms_protocol (FileTransferProtocol p) {
 		maybe_set (_tms_protocol, p);
 	}
@@ -658,21 +837,25 @@ public:
 	}
 
 	void add_cinema (std::shared_ptr<Cinema> c) {
+		ensure_cinemas_read ();
 		_cinemas.push_back (c);
 		changed (CINEMAS);
 	}
 
 	void remove_cinema (std::shared_ptr<Cinema> c) {
+		ensure_cinemas_read ();
 		_cinemas.remove (c);
 		changed (CINEMAS);
 	}
 
 	void add_dkdm_recipient (std::shared_ptr<DKDMRecipient> c) {
+		ensure_dkdm_recipients_read ();
 		_dkdm_recipients.push_back (c);
 		changed (DKDM_RECIPIENTS);
 	}
 
 	void remove_dkdm_recipient (std::shared_ptr<DKDMRecipient> c) {
+		ensure_dkdm_recipients_read ();
 		_dkdm_recipients.remove (c);
 		changed (DKDM_RECIPIENTS);
 	}
@@ -778,6 +961,14 @@ public:
 		maybe_set (_upload_after_make_dcp, u);
 	}
 
+	void set_verify_after_make_dcp (bool v) {
+		maybe_set (_verify_after_make_dcp, v);
+	}
+
+	void set_disk_verification (DiskVerification v) {
+		maybe_set (_disk_verification, v);
+	}
+
 	void set_mail_server (std::string s) {
 		maybe_set (_mail_server, s);
 	}
@@ -881,6 +1072,10 @@ public:
 		maybe_set (_automatic_audio_analysis, a);
 	}
 
+	void set_quick_examination (bool q) {
+		maybe_set (_quick_examination, q);
+	}
+
 #ifdef DCPOMATIC_WINDOWS
 	void set_win32_console (bool c) {
 		maybe_set (_win32_console, c);
@@ -955,10 +1150,50 @@ public:
 		maybe_set (_frames_in_memory_multiplier, m);
 	}
 
+	void set_encode_queue_memory_limit (int m) {
+		maybe_set (_encode_queue_memory_limit, m);
+	}
+
+	void set_writer_memory_limit (int m) {
+		maybe_set (_writer_memory_limit, m);
+	}
+
+	void set_memory_budget (int m) {
+		maybe_set (_memory_budget, m);
+	}
+
+	void set_j2k_frame_cache_directory (boost::filesystem::path p) {
+		maybe_set (_j2k_frame_cache_directory, p);
+	}
+
+	void unset_j2k_frame_cache_directory () {
+		if (!_j2k_frame_cache_directory) {
+			return;
+		}
+		_j2k_frame_cache_directory = boost::none;
+		changed ();
+	}
+
+	void set_j2k_frame_cache_size (int s) {
+		maybe_set (_j2k_frame_cache_size, s);
+	}
+
 	void set_decode_reduction (boost::optional<int> r) {
 		maybe_set (_decode_reduction, r);
 	}
 
+	void set_video_decode_hardware (std::string h) {
+		maybe_set (_video_decode_hardware, h);
+	}
+
+	void unset_video_decode_hardware () {
+		if (!_video_decode_hardware) {
+			return;
+		}
+		_video_decode_hardware = boost::none;
+		changed ();
+	}
+
 	void set_default_notify (bool n) {
 		maybe_set (_default_notify, n);
 	}
@@ -1072,6 +1307,18 @@ public:
 		changed (PLAYER_DEBUG_LOG);
 	}
 
+	void set_trace_file (boost::filesystem::path p) {
+		maybe_set (_trace_file, p);
+	}
+
+	void unset_trace_file () {
+		if (!_trace_file) {
+			return;
+		}
+		_trace_file = boost::none;
+		changed ();
+	}
+
 	void set_player_content_directory (boost::filesystem::path p) {
 		maybe_set (_player_content_directory, p, PLAYER_CONTENT_DIRECTORY);
 	}
@@ -1191,6 +1438,7 @@ public:
 	void write_config () const;
 	void write_cinemas () const;
 	void write_dkdm_recipients () const;
+	void write_soon (Property what) const;
 	void link (boost::filesystem::path new_file) const;
 	void copy_and_link (boost::filesystem::path new_file) const;
 	bool have_write_permission () const;
@@ -1235,7 +1483,9 @@ private:
 	void read () override;
 	void read_config();
 	void read_cinemas();
+	void ensure_cinemas_read() const;
 	void read_dkdm_recipients();
+	void ensure_dkdm_recipients_read() const;
 	void set_defaults ();
 	void set_kdm_email_to_default ();
 	void set_notification_email_to_default ();
@@ -1243,6 +1493,7 @@ private:
 	void read_cinemas (cxml::Document const & f);
 	void read_dkdm_recipients (cxml::Document const & f);
 	std::shared_ptr<dcp::CertificateChain> create_certificate_chain ();
+	std::shared_ptr<xmlpp::Document> config_document () const;
 	boost::filesystem::path directory_or (boost::optional<boost::filesystem::path> dir, boost::filesystem::path a) const;
 	void add_to_history_internal (std::vector<boost::filesystem::path>& h, boost::filesystem::path p);
 	void clean_history_internal (std::vector<boost::filesystem::path>& h);
@@ -1252,8 +1503,24 @@ private:
 	int _master_encoding_threads;
 	/** number of threads which a server should use for J2K encoding on the local machine */
 	int _server_encoding_threads;
+	/** number of threads to share between the video decoders that are being used at any one time */
+	int _decoding_threads;
+	/** number of MB to read ahead of each decoder, or 0 to not read ahead */
+	int _read_ahead_size;
+	/** number of threads that each decoder should use to read ahead */
+	int _read_ahead_threads;
+	/** number of frames that MXF decoders should read ahead, or 0 to not read ahead */
+	int _mxf_read_ahead_frames;
+	/** largest number of jobs which mostly read or write files that may run at the same time */
+	int _maximum_disk_jobs;
+	/** largest number of jobs which mostly use the network that may run at the same time */
+	int _maximum_network_jobs;
+	/** number of threads which should use a GPU for J2K encoding on the local machine */
+	int _gpu_encoding_threads;
+	int _gpu_device;
 	/** default directory to put new films in */
 	boost::optional<boost::filesystem::path> _default_directory;
+	std::vector<boost::filesystem::path> _write_behind_directories;
 	/** base port number to use for J2K encoding servers;
 	 *  this port and the two above it will be used.
 	 */
@@ -1263,6 +1530,9 @@ private:
 	/** J2K encoding servers that should definitely be used */
 	std::vector<std::string> _servers;
 	bool _only_servers_encode;
+	bool _compress_frames_for_servers;
+	int _encoding_priority;
+	boost::optional<std::string> _encode_server_key;
 	FileTransferProtocol _tms_protocol;
 	bool _tms_passive;
 	/** The IP address of a TMS that we can copy DCPs to */
@@ -1307,8 +1577,17 @@ private:
 	*/
 	boost::optional<boost::filesystem::path> _default_kdm_directory;
 	bool _upload_after_make_dcp;
-	std::list<std::shared_ptr<Cinema>> _cinemas;
+	bool _verify_after_make_dcp;
+	DiskVerification _disk_verification;
+	/** Our cinemas, which are only read from _cinemas_file when they are first needed, since
+	 *  there can be thousands of them and most of our tools never look at them.
+	 */
+	mutable std::list<std::shared_ptr<Cinema>> _cinemas;
+	/** true if _cinemas_file has been read into _cinemas (or does not exist) */
+	mutable bool _cinemas_read = false;
 	std::list<std::shared_ptr<DKDMRecipient>> _dkdm_recipients;
+	/** true if _dkdm_recipients has been read from _dkdm_recipients_file (or there's nothing to read) */
+	mutable bool _dkdm_recipients_read = false;
 	std::string _mail_server;
 	int _mail_port;
 	EmailProtocol _mail_protocol;
@@ -1338,6 +1617,8 @@ private:
 	int _log_types;
 	bool _analyse_ebur128;
 	bool _automatic_audio_analysis;
+	/** true to examine content quickly when it is added, then exactly with a background job */
+	bool _quick_examination;
 #ifdef DCPOMATIC_WINDOWS
 	bool _win32_console;
 #endif
@@ -1363,7 +1644,13 @@ private:
 	boost::optional<KDMWriteType> _last_kdm_write_type;
 	boost::optional<DKDMWriteType> _last_dkdm_write_type;
 	int _frames_in_memory_multiplier;
+	int _encode_queue_memory_limit;
+	int _writer_memory_limit;
+	int _memory_budget;
+	boost::optional<boost::filesystem::path> _j2k_frame_cache_directory;
+	int _j2k_frame_cache_size;
 	boost::optional<int> _decode_reduction;
+	boost::optional<std::string> _video_decode_hardware;
 	bool _default_notify;
 	bool _notification[NOTIFICATION_COUNT];
 	boost::optional<std::string> _barco_username;
@@ -1378,6 +1665,8 @@ private:
 	bool _respect_kdm_validity_periods;
 	/** Log file containing debug information for the player */
 	boost::optional<boost::filesystem::path> _player_debug_log_file;
+	/** File to write a trace of the timing of DCP encodes to, in Chrome's trace format */
+	boost::optional<boost::filesystem::path> _trace_file;
 	/** A directory containing DCPs whose contents are presented to the user
 	    in the dual-screen player mode.  DCPs on the list can be loaded
 	    for playback.
@@ -39,7 +39,10 @@
 #include <dcp/raw_convert.h>
 #include <libcxml/cxml.h>
 #include <libxml++/libxml++.h>
+#include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <future>
 #include <iostream>
 
 #include "i18n.h"
@@ -57,6 +60,37 @@ using dcp::raw_convert;
 using namespace dcpomatic;
 
 
+/** Call a function with each index from 0 to n - 1, sharing the calls between a few threads
+ *  if there are lots of them (which is worth doing when each call asks the filesystem about
+ *  a file of a long image sequence).  The function returns false to stop.
+ */
+static
+void
+for_each_index (size_t n, std::function<bool (size_t)> function)
+{
+	std::atomic<size_t> next (0);
+	std::atomic<bool> stop (false);
+	auto work = [n, &function, &next, &stop]() {
+		for (auto i = next++; i < n && !stop; i = next++) {
+			if (!function(i)) {
+				stop = true;
+			}
+		}
+	};
+
+	vector<std::future<void>> workers;
+	if (n >= 256) {
+		for (unsigned int i = 1; i < std::min(8U, boost::thread::hardware_concurrency()); ++i) {
+			workers.push_back (std::async(std::launch::async, work));
+		}
+	}
+	work ();
+	for (auto& i: workers) {
+		i.get ();
+	}
+}
+
+
 int const ContentProperty::PATH = 400;
 int const ContentProperty::POSITION = 401;
 int const ContentProperty::LENGTH = 402;
@@ -331,11 +365,29 @@ Content::identifier () const
 }
 
 
+/** @return true if our files exist.  So that this is quick to call for long image sequences
+ *  (perhaps on network storage) only the first and last files are looked at here; the rest
+ *  are looked at by check_paths(), which should be called from a background job.
+ */
 bool
 Content::paths_valid () const
 {
-	for (auto i: _paths) {
-		if (!boost::filesystem::exists (i)) {
+	vector<boost::filesystem::path> check;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_missing_paths) {
+			return false;
+		}
+		if (!_paths.empty()) {
+			check.push_back (_paths.front());
+			if (_paths.size() > 1) {
+				check.push_back (_paths.back());
+			}
+		}
+	}
+
+	for (auto const& i: check) {
+		if (!boost::filesystem::exists(i)) {
 			return false;
 		}
 	}
@@ -344,20 +396,52 @@ Content::paths_valid () const
 }
 
 
+/** Check that all our files exist, signalling a PATH change if that changes
+ *  what paths_valid() says.  This may take a while for a long sequence of files.
+ */
+void
+Content::check_paths ()
+{
+	auto const all = paths ();
+	std::atomic<bool> missing (false);
+	for_each_index (all.size(), [&all, &missing](size_t i) -> bool {
+		if (i > 0 && i + 1 < all.size() && !boost::filesystem::exists(all[i])) {
+			missing = true;
+		}
+		return !missing;
+	});
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (missing == _missing_paths || all != _paths) {
+			return;
+		}
+	}
+
+	ContentChangeSignaller cc (this, ContentProperty::PATH);
+	boost::mutex::scoped_lock lm (_mutex);
+	_missing_paths = missing;
+}
+
+
 void
 Content::set_paths (vector<boost::filesystem::path> paths)
 {
 	ContentChangeSignaller cc (this, ContentProperty::PATH);
 
+	vector<std::time_t> last_write_times (paths.size());
+	for_each_index (paths.size(), [&paths, &last_write_times](size_t i) -> bool {
+		boost::system::error_code ec;
+		auto last_write = boost::filesystem::last_write_time(paths[i], ec);
+		last_write_times[i] = ec ? 0 : last_write;
+		return true;
+	});
+
 	{
 		boost::mutex::scoped_lock lm (_mutex);
 		_paths = paths;
-		_last_write_times.clear ();
-		for (auto i: _paths) {
-			boost::system::error_code ec;
-			auto last_write = boost::filesystem::last_write_time(i, ec);
-			_last_write_times.push_back (ec ? 0 : last_write);
-		}
+		_missing_paths = false;
+		_last_write_times = last_write_times;
 	}
 }
 
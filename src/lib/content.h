@@ -133,6 +133,7 @@ public:
 	}
 
 	bool paths_valid () const;
+	void check_paths ();
 
 	/** @return Digest of the content's file(s).  Note: this is
 	 *  not a complete MD5-or-whatever hash, but a sort of poor
@@ -234,6 +235,8 @@ private:
 	/** Paths of our data files */
 	std::vector<boost::filesystem::path> _paths;
 	std::vector<std::time_t> _last_write_times;
+	/** true if check_paths() found that some of _paths which paths_valid() does not look at are missing */
+	bool _missing_paths = false;
 
 	std::string _digest;
 	dcpomatic::DCPTime _position;
@@ -20,7 +20,9 @@
 
 
 #include "compose.hpp"
+#include "config.h"
 #include "copy_to_drive_job.h"
+#include "dcpomatic_assert.h"
 #include "dcpomatic_log.h"
 #include "disk_writer_messages.h"
 #include "exceptions.h"
@@ -40,28 +42,36 @@ using std::cout;
 using std::min;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using boost::optional;
 using dcp::raw_convert;
 
 
-CopyToDriveJob::CopyToDriveJob(std::vector<boost::filesystem::path> const& dcps, Drive drive, Nanomsg& nanomsg)
+CopyToDriveJob::CopyToDriveJob(std::vector<boost::filesystem::path> const& dcps, std::vector<Drive> drives, Nanomsg& nanomsg)
 	: Job (shared_ptr<Film>())
 	, _dcps (dcps)
-	, _drive (drive)
+	, _drives (drives)
 	, _nanomsg (nanomsg)
 {
-
+	DCPOMATIC_ASSERT (!_drives.empty());
 }
 
 
 string
 CopyToDriveJob::name () const
 {
+	if (_drives.size() > 1) {
+		if (_dcps.size() == 1) {
+			return String::compose(_("Copying %1\nto %2 drives"), _dcps[0].filename().string(), _drives.size());
+		}
+		return String::compose(_("Copying DCPs to %1 drives"), _drives.size());
+	}
+
 	if (_dcps.size() == 1) {
-		return String::compose(_("Copying %1\nto %2"), _dcps[0].filename().string(), _drive.description());
+		return String::compose(_("Copying %1\nto %2"), _dcps[0].filename().string(), _drives[0].description());
 	}
 
-	return String::compose(_("Copying DCPs to %1"), _drive.description());
+	return String::compose(_("Copying DCPs to %1"), _drives[0].description());
 }
 
 
@@ -71,15 +81,57 @@ CopyToDriveJob::json_name () const
 	return N_("copy");
 }
 
+
+/** Write to each drive in turn.  A failure on one drive does not stop the others from
+ *  being written; the failures are reported together at the end.
+ */
 void
 CopyToDriveJob::run ()
 {
-	LOG_DISK("Sending write requests to disk %1 for:", _drive.device());
+	vector<string> failures;
+
+	for (size_t i = 0; i < _drives.size(); ++i) {
+		auto const& drive = _drives[i];
+		string prefix;
+		if (_drives.size() > 1) {
+			prefix = String::compose(_("Drive %1 of %2: "), i + 1, _drives.size());
+		}
+
+		try {
+			copy_to (drive, prefix);
+		} catch (CopyError& e) {
+			if (_drives.size() == 1) {
+				throw;
+			}
+			LOG_DISK("Copy to %1 failed: %2", drive.device(), e.message());
+			failures.push_back (String::compose("%1: %2", drive.description(), e.message()));
+		}
+	}
+
+	if (!failures.empty()) {
+		string message = String::compose(_("Could not write to %1 of %2 drives."), failures.size(), _drives.size());
+		for (auto const& i: failures) {
+			message += "\n" + i;
+		}
+		throw CopyError (message);
+	}
+
+	set_state (FINISHED_OK);
+}
+
+
+/** Ask the disk writer to write our DCPs to one drive, and follow its progress.
+ *  @param prefix Text to put before the name of each stage of the copy.
+ */
+void
+CopyToDriveJob::copy_to (Drive const& drive, string prefix)
+{
+	LOG_DISK("Sending write requests to disk %1 for:", drive.device());
 	for (auto dcp: _dcps) {
 		LOG_DISK("%1", dcp.string());
 	}
 
-	string request = String::compose(DISK_WRITER_WRITE "\n%1\n", _drive.device());
+	string request = String::compose(DISK_WRITER_WRITE "\n%1\n%2\n", drive.device(), disk_verification_to_string(Config::instance()->disk_verification()));
 	for (auto dcp: _dcps) {
 		request += String::compose("%1\n", dcp.string());
 	}
@@ -102,7 +154,6 @@ CopyToDriveJob::run ()
 			continue;
 		}
 		if (*s == DISK_WRITER_OK) {
-			set_state (FINISHED_OK);
 			return;
 		} else if (*s == DISK_WRITER_ERROR) {
 			auto const m = _nanomsg.receive (500);
@@ -110,7 +161,7 @@ CopyToDriveJob::run ()
 			throw CopyError (m.get_value_or("Unknown"), raw_convert<int>(n.get_value_or("0")));
 		} else if (*s == DISK_WRITER_FORMAT_PROGRESS) {
 			if (state == SETUP) {
-				sub (_("Formatting drive"));
+				sub (prefix + _("Formatting drive"));
 				state = FORMAT;
 			}
 			auto progress = _nanomsg.receive (500);
@@ -119,7 +170,7 @@ CopyToDriveJob::run ()
 			}
 		} else if (*s == DISK_WRITER_COPY_PROGRESS) {
 			if (state == FORMAT) {
-				sub (_("Copying DCP"));
+				sub (prefix + _("Copying DCP"));
 				state = COPY;
 			}
 			auto progress = _nanomsg.receive (500);
@@ -128,7 +179,7 @@ CopyToDriveJob::run ()
 			}
 		} else if (*s == DISK_WRITER_VERIFY_PROGRESS) {
 			if (state == COPY) {
-				sub (_("Verifying copied files"));
+				sub (prefix + _("Verifying copied files"));
 				state = VERIFY;
 			}
 			auto progress = _nanomsg.receive (500);
@@ -25,19 +25,24 @@
 class CopyToDriveJob : public Job
 {
 public:
-	CopyToDriveJob (std::vector<boost::filesystem::path> const& dcps, Drive drive, Nanomsg& nanomsg);
+	CopyToDriveJob (std::vector<boost::filesystem::path> const& dcps, std::vector<Drive> drives, Nanomsg& nanomsg);
 
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::DISK;
+	}
 	bool enable_notify () const override {
 		return true;
 	}
 
 private:
+	void copy_to (Drive const& drive, std::string prefix);
 	void count (boost::filesystem::path dir, uint64_t& total_bytes);
 	void copy (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total);
 	std::vector<boost::filesystem::path> _dcps;
-	Drive _drive;
+	/** drives to write to, one after another */
+	std::vector<Drive> _drives;
 	Nanomsg& _nanomsg;
 };
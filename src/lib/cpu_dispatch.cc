@@ -0,0 +1,224 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "cpu_dispatch.h"
+#include "dcpomatic_assert.h"
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+
+using std::pair;
+using std::string;
+using std::vector;
+using boost::optional;
+using namespace dcpomatic::cpu;
+
+
+/** Instruction set that we have been told to use at most, or -1 for no limit */
+static std::atomic<int> forced_isa{-1};
+
+
+static boost::mutex&
+kernels_mutex ()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+
+/** @return every kernel that exists; protected by kernels_mutex() */
+static vector<KernelBase*>&
+kernels ()
+{
+	static vector<KernelBase*> kernels;
+	return kernels;
+}
+
+
+string
+dcpomatic::cpu::isa_name (ISA isa)
+{
+	switch (isa) {
+	case ISA::SCALAR:
+		return "scalar";
+	case ISA::SSE2:
+		return "sse2";
+	case ISA::SSE4_2:
+		return "sse4.2";
+	case ISA::AVX2:
+		return "avx2";
+	case ISA::AVX512F:
+		return "avx512f";
+	case ISA::NEON:
+		return "neon";
+	}
+
+	DCPOMATIC_ASSERT (false);
+	return {};
+}
+
+
+optional<ISA>
+dcpomatic::cpu::isa_from_name (string name)
+{
+	for (auto isa: { ISA::SCALAR, ISA::SSE2, ISA::SSE4_2, ISA::AVX2, ISA::AVX512F, ISA::NEON }) {
+		if (isa_name(isa) == name) {
+			return isa;
+		}
+	}
+
+	return {};
+}
+
+
+/** @return true if this machine's CPU supports @p isa and we have code for it */
+bool
+dcpomatic::cpu::supported (ISA isa)
+{
+	static auto const support = []() {
+		std::array<bool, 6> s;
+		s.fill (false);
+		s[static_cast<int>(ISA::SCALAR)] = true;
+#ifdef DCPOMATIC_X86_DISPATCH
+		__builtin_cpu_init ();
+		s[static_cast<int>(ISA::SSE2)] = __builtin_cpu_supports("sse2");
+		s[static_cast<int>(ISA::SSE4_2)] = __builtin_cpu_supports("sse4.2");
+		s[static_cast<int>(ISA::AVX2)] = __builtin_cpu_supports("avx2");
+		s[static_cast<int>(ISA::AVX512F)] = __builtin_cpu_supports("avx512f");
+#endif
+#ifdef __ARM_NEON
+		s[static_cast<int>(ISA::NEON)] = true;
+#endif
+		return s;
+	}();
+
+	return support[static_cast<int>(isa)];
+}
+
+
+/** Called once at start-up; looks at the environment variable DCPOMATIC_FORCE_ISA
+ *  which can be set to the name of an instruction set (e.g. "scalar" or "sse2")
+ *  to use nothing better than that.
+ */
+void
+dcpomatic::cpu::setup ()
+{
+	supported (ISA::SCALAR);
+
+	if (auto env = getenv("DCPOMATIC_FORCE_ISA")) {
+		if (auto isa = isa_from_name(env)) {
+			force (isa);
+		}
+	}
+}
+
+
+/** Use nothing better than @p isa from now on, or remove any limit if @p isa is empty.
+ *  Every kernel chooses its implementation again the next time that it is used.
+ *  This is mostly useful for tests, and should not be called while kernels are running.
+ */
+void
+dcpomatic::cpu::force (optional<ISA> isa)
+{
+	forced_isa = isa ? static_cast<int>(*isa) : -1;
+
+	boost::mutex::scoped_lock lm (kernels_mutex());
+	for (auto i: kernels()) {
+		i->reset ();
+	}
+}
+
+
+optional<ISA>
+dcpomatic::cpu::forced ()
+{
+	auto const f = forced_isa.load ();
+	if (f < 0) {
+		return {};
+	}
+	return static_cast<ISA>(f);
+}
+
+
+/** @return true if force() allows us to use @p isa */
+static bool
+allowed (ISA isa)
+{
+	auto const limit = forced ();
+	if (!limit || isa == ISA::SCALAR) {
+		return true;
+	}
+
+	if (isa == ISA::NEON || *limit == ISA::NEON) {
+		return isa == *limit;
+	}
+
+	return static_cast<int>(isa) <= static_cast<int>(*limit);
+}
+
+
+/** @return name and chosen instruction set of every kernel, choosing them if necessary */
+vector<pair<string, ISA>>
+dcpomatic::cpu::choices ()
+{
+	boost::mutex::scoped_lock lm (kernels_mutex());
+
+	vector<pair<string, ISA>> result;
+	for (auto i: kernels()) {
+		result.push_back ({ i->name(), i->choice() });
+	}
+	return result;
+}
+
+
+KernelBase::KernelBase (string name)
+	: _name (name)
+{
+	boost::mutex::scoped_lock lm (kernels_mutex());
+	kernels().push_back (this);
+}
+
+
+KernelBase::~KernelBase ()
+{
+	boost::mutex::scoped_lock lm (kernels_mutex());
+	auto& k = kernels ();
+	k.erase (std::remove(k.begin(), k.end(), this), k.end());
+}
+
+
+/** @return index into @p isas of the best one that we can use */
+int
+KernelBase::choose (vector<ISA> const& isas)
+{
+	int best = -1;
+	for (size_t i = 0; i < isas.size(); ++i) {
+		if (supported(isas[i]) && allowed(isas[i]) && (best == -1 || static_cast<int>(isas[i]) > static_cast<int>(isas[best]))) {
+			best = i;
+		}
+	}
+
+	/* Every kernel should have a SCALAR implementation */
+	DCPOMATIC_ASSERT (best != -1);
+	return best;
+}
@@ -0,0 +1,164 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/cpu_dispatch.h
+ *  @brief Choice, at run time, between implementations of kernels that use different SIMD
+ *  instruction sets.
+ */
+
+
+#ifndef DCPOMATIC_CPU_DISPATCH_H
+#define DCPOMATIC_CPU_DISPATCH_H
+
+
+#include <boost/optional.hpp>
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/** Defined if we can compile kernels for x86 instruction sets beyond those that the whole
+ *  build uses (with __attribute__((target))) and check for them with __builtin_cpu_supports.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DCPOMATIC_X86_DISPATCH
+#endif
+
+
+namespace dcpomatic {
+namespace cpu {
+
+
+/** Instruction sets that kernels can be written for.  The x86 ones are in order, so that
+ *  each one implies those before it.
+ */
+enum class ISA
+{
+	SCALAR,
+	SSE2,
+	SSE4_2,
+	AVX2,
+	AVX512F,
+	NEON
+};
+
+
+extern std::string isa_name (ISA isa);
+extern boost::optional<ISA> isa_from_name (std::string name);
+extern bool supported (ISA isa);
+extern void setup ();
+extern void force (boost::optional<ISA> isa);
+extern boost::optional<ISA> forced ();
+
+
+/** @class KernelBase
+ *  @brief Parent of Kernel so that all the kernels can be listed and reset.
+ */
+class KernelBase
+{
+public:
+	explicit KernelBase (std::string name);
+	virtual ~KernelBase ();
+
+	KernelBase (KernelBase const&) = delete;
+	KernelBase& operator= (KernelBase const&) = delete;
+
+	std::string name () const {
+		return _name;
+	}
+
+	/** @return the instruction set of the implementation that is being used, choosing it if necessary */
+	virtual ISA choice () = 0;
+	/** Forget the choice of implementation so that it is made again the next time the kernel is used */
+	virtual void reset () = 0;
+
+protected:
+	static int choose (std::vector<ISA> const& isas);
+
+private:
+	std::string _name;
+};
+
+
+/** @class Kernel
+ *  @brief A function with implementations for different instruction sets.
+ *
+ *  The best implementation that the CPU supports (and that has not been ruled out by
+ *  force()) is chosen the first time the kernel is called.  Kernels should be
+ *  static objects, each with a SCALAR implementation.
+ */
+template <class F>
+class Kernel : public KernelBase
+{
+public:
+	Kernel (std::string name, std::vector<std::pair<ISA, F*>> implementations)
+		: KernelBase (name)
+		, _implementations (implementations)
+	{
+		for (auto const& i: _implementations) {
+			_isas.push_back (i.first);
+		}
+	}
+
+	template <class... Args>
+	auto operator() (Args&&... args) -> decltype(std::declval<F*>()(std::forward<Args>(args)...))
+	{
+		return get()(std::forward<Args>(args)...);
+	}
+
+	F* get ()
+	{
+		auto index = _chosen.load ();
+		if (index < 0) {
+			index = choose (_isas);
+			_chosen = index;
+		}
+		return _implementations[index].second;
+	}
+
+	ISA choice () override
+	{
+		get ();
+		return _implementations[_chosen].first;
+	}
+
+	void reset () override
+	{
+		_chosen = -1;
+	}
+
+private:
+	std::vector<std::pair<ISA, F*>> _implementations;
+	std::vector<ISA> _isas;
+	/** index into _implementations of the one that we are using, or -1 if we have not yet chosen */
+	std::atomic<int> _chosen{-1};
+};
+
+
+extern std::vector<std::pair<std::string, ISA>> choices ();
+
+
+}
+}
+
+
+#endif
@@ -0,0 +1,169 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "cpu_dispatch.h"
+#include "crc32c.h"
+#include <cstring>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define DCPOMATIC_CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define DCPOMATIC_CRC32C_ARM
+#endif
+
+
+/** Reflected CRC-32C polynomial */
+static uint32_t const polynomial = 0x82f63b78;
+
+
+namespace {
+
+/** Tables for the "slicing-by-8" software implementation */
+class Tables
+{
+public:
+	Tables ()
+	{
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t crc = i;
+			for (int j = 0; j < 8; ++j) {
+				crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+			}
+			table[0][i] = crc;
+		}
+
+		for (uint32_t i = 0; i < 256; ++i) {
+			for (int j = 1; j < 8; ++j) {
+				table[j][i] = (table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xff];
+			}
+		}
+	}
+
+	uint32_t table[8][256];
+};
+
+}
+
+
+static uint32_t
+crc32c_software (uint32_t crc, uint8_t const* data, size_t size)
+{
+	static Tables const tables;
+	auto const& t = tables.table;
+
+	while (size >= 8) {
+		uint32_t low;
+		uint32_t high;
+		memcpy (&low, data, 4);
+		memcpy (&high, data + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		low = __builtin_bswap32 (low);
+		high = __builtin_bswap32 (high);
+#endif
+		low ^= crc;
+		crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+			t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+		data += 8;
+		size -= 8;
+	}
+
+	while (size > 0) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+		--size;
+	}
+
+	return crc;
+}
+
+
+#ifdef DCPOMATIC_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hardware (uint32_t crc, uint8_t const* data, size_t size)
+{
+	uint64_t crc64 = crc;
+	while (size >= 8) {
+		uint64_t v;
+		memcpy (&v, data, 8);
+		crc64 = _mm_crc32_u64 (crc64, v);
+		data += 8;
+		size -= 8;
+	}
+
+	crc = static_cast<uint32_t>(crc64);
+	while (size > 0) {
+		crc = _mm_crc32_u8 (crc, *data++);
+		--size;
+	}
+
+	return crc;
+}
+#endif
+
+
+#ifdef DCPOMATIC_CRC32C_ARM
+static uint32_t
+crc32c_hardware (uint32_t crc, uint8_t const* data, size_t size)
+{
+	while (size >= 8) {
+		uint64_t v;
+		memcpy (&v, data, 8);
+		crc = __crc32cd (crc, v);
+		data += 8;
+		size -= 8;
+	}
+
+	while (size > 0) {
+		crc = __crc32cb (crc, *data++);
+		--size;
+	}
+
+	return crc;
+}
+#endif
+
+
+#ifdef DCPOMATIC_CRC32C_SSE42
+static dcpomatic::cpu::Kernel<uint32_t (uint32_t, uint8_t const*, size_t)> crc32c_kernel (
+	"crc32c",
+	{
+		{ dcpomatic::cpu::ISA::SCALAR, &crc32c_software },
+		{ dcpomatic::cpu::ISA::SSE4_2, &crc32c_hardware },
+	});
+#endif
+
+
+uint32_t
+crc32c (uint32_t crc, uint8_t const* data, size_t size)
+{
+	crc = ~crc;
+
+#if defined(DCPOMATIC_CRC32C_SSE42)
+	crc = crc32c_kernel (crc, data, size);
+#elif defined(DCPOMATIC_CRC32C_ARM)
+	crc = crc32c_hardware (crc, data, size);
+#else
+	crc = crc32c_software (crc, data, size);
+#endif
+
+	return ~crc;
+}
@@ -0,0 +1,38 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_CRC32C_H
+#define DCPOMATIC_CRC32C_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+/** Add some data to a CRC-32C (Castagnoli) checksum, using the CPU's CRC32 instructions
+ *  if it has them.
+ *  @param crc Checksum so far; 0 to start a new one.
+ *  @return New checksum.
+ */
+extern uint32_t crc32c (uint32_t crc, uint8_t const* data, size_t size);
+
+
+#endif
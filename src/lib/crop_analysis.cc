@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "crop_analysis.h"
+#include "exceptions.h"
+#include <libcxml/cxml.h>
+#include <dcp/raw_convert.h>
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+LIBDCP_ENABLE_WARNINGS
+#include <boost/algorithm/string.hpp>
+
+
+using std::make_shared;
+using std::string;
+using std::vector;
+using dcp::raw_convert;
+
+
+int const CropAnalysis::_current_state_version = 1;
+
+
+static
+vector<float>
+read_values (cxml::Node const& node, string name)
+{
+	vector<string> parts;
+	auto const text = node.string_child(name);
+	boost::split (parts, text, boost::is_any_of(" "), boost::token_compress_on);
+
+	vector<float> values;
+	for (auto const& i: parts) {
+		if (!i.empty()) {
+			values.push_back (raw_convert<float>(i));
+		}
+	}
+	return values;
+}
+
+
+static
+string
+write_values (vector<float> const& values)
+{
+	string s;
+	for (auto i: values) {
+		if (!s.empty()) {
+			s += " ";
+		}
+		s += raw_convert<string>(i);
+	}
+	return s;
+}
+
+
+CropAnalysis::CropAnalysis (boost::filesystem::path path)
+{
+	cxml::Document f ("CropAnalysis");
+
+	f.read_file (path);
+
+	if (f.optional_number_child<int>("Version").get_value_or(1) < _current_state_version) {
+		/* Too old.  Throw an exception so that this analysis is re-run. */
+		throw OldFormatError ("Crop analysis file is too old");
+	}
+
+	_profile.rows = read_values (f, "Rows");
+	_profile.columns = read_values (f, "Columns");
+	_frames = f.number_child<int>("Frames");
+}
+
+
+void
+CropAnalysis::write (boost::filesystem::path path) const
+{
+	auto doc = make_shared<xmlpp::Document>();
+	xmlpp::Element* root = doc->create_root_node ("CropAnalysis");
+
+	root->add_child("Version")->add_child_text (raw_convert<string>(_current_state_version));
+	root->add_child("Frames")->add_child_text (raw_convert<string>(_frames));
+	root->add_child("Rows")->add_child_text (write_values(_profile.rows));
+	root->add_child("Columns")->add_child_text (write_values(_profile.columns));
+
+	doc->write_to_file_formatted (path.string());
+}
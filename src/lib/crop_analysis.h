@@ -0,0 +1,72 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_CROP_ANALYSIS_H
+#define DCPOMATIC_CROP_ANALYSIS_H
+
+
+#include "guess_crop.h"
+#include "types.h"
+#include <boost/filesystem.hpp>
+
+
+/** @class CropAnalysis
+ *  @brief Class to store the results of an AnalyseCropJob.
+ */
+class CropAnalysis
+{
+public:
+	explicit CropAnalysis (boost::filesystem::path path);
+
+	CropAnalysis (BrightnessProfile profile, int frames)
+		: _profile (std::move(profile))
+		, _frames (frames)
+	{}
+
+	CropAnalysis (CropAnalysis const&) = delete;
+	CropAnalysis& operator= (CropAnalysis const&) = delete;
+
+	void write (boost::filesystem::path path) const;
+
+	/** @return Crop which would remove everything that is no brighter than threshold in any of the analysed frames */
+	Crop crop (double threshold) const {
+		return guess_crop (_profile, threshold);
+	}
+
+	BrightnessProfile const& profile () const {
+		return _profile;
+	}
+
+	/** @return Number of frames that were looked at */
+	int frames () const {
+		return _frames;
+	}
+
+private:
+	/** brightest value in each row and column over all the frames that were analysed */
+	BrightnessProfile _profile;
+	int _frames;
+
+	static int const _current_state_version;
+};
+
+
+#endif
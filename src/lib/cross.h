@@ -64,6 +64,14 @@ extern void unprivileged ();
 extern boost::filesystem::path config_path (boost::optional<std::string> version);
 extern boost::filesystem::path directory_containing_executable ();
 extern bool show_in_file_manager (boost::filesystem::path dir, boost::filesystem::path select);
+extern bool clone_file (boost::filesystem::path from, boost::filesystem::path to);
+extern bool preallocate_file (boost::filesystem::path file, uint64_t size);
+extern void release_preallocation (boost::filesystem::path file);
+extern std::vector<std::vector<int>> numa_nodes ();
+extern bool set_thread_cpus (std::vector<int> const& cpus);
+extern std::vector<int> parse_cpu_list (std::string list);
+extern int numa_node_count ();
+extern void pin_thread_to_numa_node (int index);
 namespace dcpomatic {
 	std::string get_process_id ();
 }
@@ -107,6 +115,8 @@ public:
 
 	std::string description () const;
 
+	bool operator== (Drive const& other) const;
+
 	std::string device () const {
 		return _device;
 	}
@@ -29,6 +29,7 @@ LIBDCP_DISABLE_WARNINGS
 #include <libxml++/libxml++.h>
 LIBDCP_ENABLE_WARNINGS
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -78,6 +79,13 @@ Drive::as_xml () const
 }
 
 
+bool
+Drive::operator== (Drive const& other) const
+{
+	return _device == other._device && _mount_points == other._mount_points && _size == other._size && _vendor == other._vendor && _model == other._model;
+}
+
+
 string
 Drive::description () const
 {
@@ -124,6 +132,78 @@ Drive::log_summary () const
 
 
 
+/** Parse a list of CPUs in the format used by Linux's sysfs, e.g. "0-7,16-23".
+ *  This is in _common so we can use it in unit tests.
+ *  @return CPU indices, or an empty vector if the list could not be parsed.
+ */
+vector<int>
+parse_cpu_list (string list)
+{
+	boost::algorithm::trim (list);
+	if (list.empty()) {
+		return {};
+	}
+
+	vector<string> ranges;
+	boost::algorithm::split (ranges, list, boost::is_any_of(","));
+
+	vector<int> cpus;
+	for (auto const& i: ranges) {
+		vector<string> ends;
+		boost::algorithm::split (ends, i, boost::is_any_of("-"));
+		if (ends.empty() || ends.size() > 2 || ends.front().empty() || ends.back().empty()) {
+			return {};
+		}
+		auto const first = dcp::raw_convert<int>(ends.front());
+		auto const last = dcp::raw_convert<int>(ends.back());
+		if (last < first) {
+			return {};
+		}
+		for (int j = first; j <= last; ++j) {
+			cpus.push_back (j);
+		}
+	}
+
+	return cpus;
+}
+
+
+static vector<vector<int>> const&
+cached_numa_nodes ()
+{
+	static auto const nodes = numa_nodes ();
+	return nodes;
+}
+
+
+/** @return the number of NUMA nodes in this machine (at least 1) */
+int
+numa_node_count ()
+{
+	return std::max(1, static_cast<int>(cached_numa_nodes().size()));
+}
+
+
+/** Pin the calling thread to the CPUs of one NUMA node, so that the memory it touches
+ *  first is allocated on that node.  Nodes are chosen by spreading @p index over them,
+ *  so thread i goes on node i % numa_node_count().  This does nothing on machines with
+ *  only one node.
+ */
+void
+pin_thread_to_numa_node (int index)
+{
+	auto const& nodes = cached_numa_nodes ();
+	if (nodes.size() < 2) {
+		return;
+	}
+
+	auto const node = index % nodes.size();
+	if (!set_thread_cpus(nodes[node])) {
+		LOG_WARNING ("Could not pin thread %1 to NUMA node %2", thread_id(), node);
+	}
+}
+
+
 /* This is in _common so we can use it in unit tests */
 optional<OSXMediaPath>
 analyse_osx_media_path (string path)
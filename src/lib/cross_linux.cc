@@ -33,13 +33,17 @@
 #if BOOST_VERSION >= 106100
 #include <boost/dll/runtime_symbol_info.hpp>
 #endif
+#include <pthread.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
 #include <mntent.h>
 #include <sys/types.h>
 #include <sys/mount.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <algorithm>
 #include <fstream>
 
 #include "i18n.h"
@@ -336,3 +340,109 @@ show_in_file_manager (boost::filesystem::path dir, boost::filesystem::path)
 	return true;
 }
 
+
+/* This is in linux/fs.h but that clashes with sys/mount.h on some systems */
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+
+/** Try to make @p to a copy-on-write clone of @p from (e.g. on Btrfs or XFS), so that
+ *  it takes no time and no extra space until one of them is changed.
+ *  @return true if it worked; if not, @p to will not exist.
+ */
+bool
+clone_file (boost::filesystem::path from, boost::filesystem::path to)
+{
+	int const from_fd = open (from.string().c_str(), O_RDONLY);
+	if (from_fd == -1) {
+		return false;
+	}
+
+	int const to_fd = open (to.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (to_fd == -1) {
+		close (from_fd);
+		return false;
+	}
+
+	bool const ok = ioctl (to_fd, FICLONE, from_fd) == 0;
+	close (to_fd);
+	close (from_fd);
+
+	if (!ok) {
+		boost::system::error_code ec;
+		boost::filesystem::remove (to, ec);
+	}
+
+	return ok;
+}
+
+
+/** Reserve space on disk for @p file to grow to @p size bytes without changing its length, so
+ *  that it is not fragmented as it is written.
+ *  @return true if it worked.
+ */
+bool
+preallocate_file (boost::filesystem::path file, uint64_t size)
+{
+	int const fd = open (file.string().c_str(), O_WRONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	bool const ok = fallocate (fd, FALLOC_FL_KEEP_SIZE, 0, size) == 0;
+	close (fd);
+	return ok;
+}
+
+
+/** @return CPUs in each NUMA node, or an empty vector if the topology could not be found */
+vector<vector<int>>
+numa_nodes ()
+{
+	boost::filesystem::path const base = "/sys/devices/system/node";
+	boost::system::error_code ec;
+
+	vector<pair<int, vector<int>>> nodes;
+	for (auto i = boost::filesystem::directory_iterator(base, ec); !ec && i != boost::filesystem::directory_iterator(); i.increment(ec)) {
+		auto const name = i->path().filename().string();
+		if (!boost::algorithm::starts_with(name, "node") || name.find_first_not_of("0123456789", 4) != string::npos || name.length() == 4) {
+			continue;
+		}
+		ifstream f ((i->path() / "cpulist").string());
+		string list;
+		if (!std::getline(f, list)) {
+			continue;
+		}
+		auto cpus = parse_cpu_list (list);
+		if (!cpus.empty()) {
+			nodes.push_back (make_pair(dcp::raw_convert<int>(name.substr(4)), cpus));
+		}
+	}
+
+	std::sort (nodes.begin(), nodes.end());
+
+	vector<vector<int>> result;
+	for (auto& i: nodes) {
+		result.push_back (std::move(i.second));
+	}
+	return result;
+}
+
+
+/** Restrict the calling thread to run only on some CPUs.
+ *  @return true if it worked.
+ */
+bool
+set_thread_cpus (vector<int> const& cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO (&set);
+	for (auto i: cpus) {
+		if (i >= 0 && i < CPU_SETSIZE) {
+			CPU_SET (i, &set);
+		}
+	}
+
+	return pthread_setaffinity_np (pthread_self(), sizeof(set), &set) == 0;
+}
@@ -41,6 +41,9 @@
 #include <DiskArbitration/DiskArbitration.h>
 #include <CoreFoundation/CFURL.h>
 #include <sys/types.h>
+#include <sys/clonefile.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -474,3 +477,57 @@ show_in_file_manager (boost::filesystem::path, boost::filesystem::path select)
 	return static_cast<bool>(WEXITSTATUS(r));
 }
 
+
+/** Try to make @p to a copy-on-write clone of @p from (on APFS), so that it takes
+ *  no time and no extra space until one of them is changed.
+ *  @return true if it worked; if not, @p to will not exist.
+ */
+bool
+clone_file (boost::filesystem::path from, boost::filesystem::path to)
+{
+	/* clonefile() will not replace an existing file */
+	boost::system::error_code ec;
+	boost::filesystem::remove (to, ec);
+	return clonefile (from.string().c_str(), to.string().c_str(), 0) == 0;
+}
+
+
+/** Reserve space on disk for @p file to grow to @p size bytes without changing its length, so
+ *  that it is not fragmented as it is written.
+ *  @return true if it worked.
+ */
+bool
+preallocate_file (boost::filesystem::path file, uint64_t size)
+{
+	int const fd = open (file.string().c_str(), O_WRONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	/* Try for contiguous space first, and then any space */
+	fstore_t store = { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(size), 0 };
+	bool ok = fcntl (fd, F_PREALLOCATE, &store) != -1;
+	if (!ok) {
+		store.fst_flags = F_ALLOCATEALL;
+		ok = fcntl (fd, F_PREALLOCATE, &store) != -1;
+	}
+
+	close (fd);
+	return ok;
+}
+
+
+/** macOS does not tell us about NUMA nodes (and the machines it runs on have only one) */
+vector<vector<int>>
+numa_nodes ()
+{
+	return {};
+}
+
+
+/** macOS has no way to pin threads to particular CPUs */
+bool
+set_thread_cpus (vector<int> const&)
+{
+	return false;
+}
@@ -22,6 +22,8 @@
 #include "cross.h"
 #include <dcp/raw_convert.h>
 #include <dcp/warnings.h>
+#include <fcntl.h>
+#include <unistd.h>
 LIBDCP_DISABLE_WARNINGS
 extern "C" {
 #include <libavformat/avio.h>
@@ -91,3 +93,25 @@ ArgFixer::ArgFixer(int argc, char** argv)
 
 }
 
+
+/** Give back any space that was reserved with preallocate_file() but not used */
+void
+release_preallocation (boost::filesystem::path file)
+{
+	boost::system::error_code ec;
+	auto const length = boost::filesystem::file_size (file, ec);
+	if (ec) {
+		return;
+	}
+
+	/* Truncating frees anything allocated past the end of the file */
+	int const fd = open (file.string().c_str(), O_WRONLY);
+	if (fd == -1) {
+		return;
+	}
+
+	if (ftruncate(fd, length) == -1) {
+		/* Never mind */
+	}
+	close (fd);
+}
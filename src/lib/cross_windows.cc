@@ -672,3 +672,78 @@ ArgFixer::ArgFixer(int, char**)
 	}
 }
 
+
+/** Cloning files (block cloning on ReFS) is not supported on Windows yet.
+ *  @return false.
+ */
+bool
+clone_file (boost::filesystem::path, boost::filesystem::path)
+{
+	return false;
+}
+
+
+/** Preallocation is not supported on Windows yet.
+ *  @return false.
+ */
+bool
+preallocate_file (boost::filesystem::path, uint64_t)
+{
+	return false;
+}
+
+
+void
+release_preallocation (boost::filesystem::path)
+{
+
+}
+
+
+/** @return CPUs in each NUMA node, or an empty vector if the topology could not be found.
+ *  Only CPUs in the first processor group are considered.
+ */
+vector<vector<int>>
+numa_nodes ()
+{
+	ULONG highest = 0;
+	if (!GetNumaHighestNodeNumber(&highest)) {
+		return {};
+	}
+
+	vector<vector<int>> nodes;
+	for (ULONG i = 0; i <= highest; ++i) {
+		ULONGLONG mask = 0;
+		if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(i), &mask)) {
+			continue;
+		}
+		vector<int> cpus;
+		for (int j = 0; j < 64; ++j) {
+			if (mask & (1ULL << j)) {
+				cpus.push_back(j);
+			}
+		}
+		if (!cpus.empty()) {
+			nodes.push_back(cpus);
+		}
+	}
+
+	return nodes;
+}
+
+
+/** Restrict the calling thread to run only on some CPUs.
+ *  @return true if it worked.
+ */
+bool
+set_thread_cpus (vector<int> const& cpus)
+{
+	DWORD_PTR mask = 0;
+	for (auto i: cpus) {
+		if (i >= 0 && i < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+			mask |= static_cast<DWORD_PTR>(1) << i;
+		}
+	}
+
+	return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
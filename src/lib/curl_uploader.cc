@@ -26,6 +26,7 @@
 #include "cross.h"
 #include "compose.hpp"
 #include "dcpomatic_assert.h"
+#include "scope_guard.h"
 #include <iostream>
 
 #include "i18n.h"
@@ -36,11 +37,50 @@ using std::cout;
 using std::function;
 
 
+/* Number of files to upload at the same time, each over its own connection */
+int constexpr upload_connections = 4;
+/* Number of times to try to send each file before giving up */
+int constexpr upload_attempts = 5;
+
+
+namespace {
+
+/** Details of one file that we are uploading */
+struct Transfer
+{
+	dcp::File* file;
+	function<void (boost::uintmax_t)> progress;
+	/** position in the file that we have sent up to */
+	boost::uintmax_t position;
+};
+
+}
+
+
 static size_t
 read_callback (void* ptr, size_t size, size_t nmemb, void* object)
 {
-	CurlUploader* u = reinterpret_cast<CurlUploader*> (object);
-	return u->read_callback (ptr, size, nmemb);
+	auto transfer = reinterpret_cast<Transfer*>(object);
+	size_t const r = transfer->file->read(ptr, size, nmemb);
+	transfer->position += r * size;
+	transfer->progress (transfer->position);
+	return r * size;
+}
+
+
+/** Called when libcurl resumes an upload, to move to the point in the file that
+ *  the server already has.
+ */
+static int
+seek_callback (void* object, curl_off_t offset, int origin)
+{
+	auto transfer = reinterpret_cast<Transfer*>(object);
+	if (origin != SEEK_SET || transfer->file->seek(offset, SEEK_SET) != 0) {
+		return CURL_SEEKFUNC_CANTSEEK;
+	}
+	transfer->position = offset;
+	transfer->progress (transfer->position);
+	return CURL_SEEKFUNC_OK;
 }
 
 
@@ -53,31 +93,74 @@ curl_debug_shim (CURL* curl, curl_infotype type, char* data, size_t size, void*
 
 CurlUploader::CurlUploader (function<void (string)> set_status, function<void (float)> set_progress)
 	: Uploader (set_status, set_progress)
+	, _host (Config::instance()->tms_ip())
+	, _path (Config::instance()->tms_path())
+	, _user (Config::instance()->tms_user())
+	, _password (Config::instance()->tms_password())
+	, _passive (Config::instance()->tms_passive())
+{
+	/* Make the first handle now so that we find out straight away if libcurl isn't working */
+	release_handle (get_handle());
+}
+
+
+CurlUploader::~CurlUploader ()
+{
+	for (auto i: _idle) {
+		curl_easy_cleanup (i);
+	}
+}
+
+
+/** @return A handle to use for an upload; this will be one that we have used before,
+ *  if there is one, so that its connection can be re-used.
+ */
+CURL*
+CurlUploader::get_handle ()
 {
-	_curl = curl_easy_init ();
-	if (!_curl) {
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (!_idle.empty()) {
+			auto curl = _idle.back();
+			_idle.pop_back();
+			return curl;
+		}
+	}
+
+	auto curl = curl_easy_init ();
+	if (!curl) {
 		throw NetworkError (_("Could not start transfer"));
 	}
 
-	curl_easy_setopt (_curl, CURLOPT_READFUNCTION, ::read_callback);
-	curl_easy_setopt (_curl, CURLOPT_READDATA, this);
-	curl_easy_setopt (_curl, CURLOPT_UPLOAD, 1L);
-	curl_easy_setopt (_curl, CURLOPT_FTP_CREATE_MISSING_DIRS, 1L);
-	curl_easy_setopt (_curl, CURLOPT_READDATA, this);
-	curl_easy_setopt (_curl, CURLOPT_USERNAME, Config::instance()->tms_user().c_str());
-	curl_easy_setopt (_curl, CURLOPT_PASSWORD, Config::instance()->tms_password().c_str());
-	if (!Config::instance()->tms_passive()) {
-		curl_easy_setopt(_curl, CURLOPT_FTPPORT, "-");
+	curl_easy_setopt (curl, CURLOPT_READFUNCTION, ::read_callback);
+	curl_easy_setopt (curl, CURLOPT_SEEKFUNCTION, ::seek_callback);
+	curl_easy_setopt (curl, CURLOPT_UPLOAD, 1L);
+	curl_easy_setopt (curl, CURLOPT_FTP_CREATE_MISSING_DIRS, 1L);
+	curl_easy_setopt (curl, CURLOPT_USERNAME, _user.c_str());
+	curl_easy_setopt (curl, CURLOPT_PASSWORD, _password.c_str());
+	if (!_passive) {
+		curl_easy_setopt(curl, CURLOPT_FTPPORT, "-");
 	}
-	curl_easy_setopt(_curl, CURLOPT_VERBOSE, 1L);
-	curl_easy_setopt(_curl, CURLOPT_DEBUGFUNCTION, curl_debug_shim);
-	curl_easy_setopt(_curl, CURLOPT_DEBUGDATA, this);
+	curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+	curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, curl_debug_shim);
+	curl_easy_setopt(curl, CURLOPT_DEBUGDATA, this);
+
+	return curl;
 }
 
 
-CurlUploader::~CurlUploader ()
+void
+CurlUploader::release_handle (CURL* handle)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_idle.push_back (handle);
+}
+
+
+int
+CurlUploader::parallel_uploads () const
 {
-	curl_easy_cleanup (_curl);
+	return upload_connections;
 }
 
 
@@ -89,43 +172,54 @@ CurlUploader::create_directory (boost::filesystem::path)
 
 
 void
-CurlUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+CurlUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, function<void (boost::uintmax_t)> progress)
 {
-	curl_easy_setopt (
-		_curl, CURLOPT_URL,
-		/* Use generic_string so that we get forward-slashes in the path, even on Windows */
-		String::compose ("ftp://%1/%2/%3", Config::instance()->tms_ip(), Config::instance()->tms_path(), to.generic_string ()).c_str ()
-		);
-
 	dcp::File file(from, "rb");
 	if (!file) {
 		throw NetworkError (String::compose (_("Could not open %1 to send"), from));
 	}
-	_file = file.get();
-	_transferred = &transferred;
-	_total_size = total_size;
-
-	auto const r = curl_easy_perform (_curl);
-	if (r != CURLE_OK) {
-		throw NetworkError (String::compose (_("Could not write to remote file (%1)"), curl_easy_strerror (r)));
-	}
-
-	_file = nullptr;
-}
 
+	auto curl = get_handle ();
+	ScopeGuard sg = [this, curl]() { release_handle(curl); };
 
-size_t
-CurlUploader::read_callback (void* ptr, size_t size, size_t nmemb)
-{
-	DCPOMATIC_ASSERT (_file);
-	size_t const r = fread(ptr, size, nmemb, _file);
-	*_transferred += size * nmemb;
+	curl_easy_setopt (
+		curl, CURLOPT_URL,
+		/* Use generic_string so that we get forward-slashes in the path, even on Windows */
+		String::compose ("ftp://%1/%2/%3", _host, _path, to.generic_string ()).c_str ()
+		);
 
-	if (_total_size > 0) {
-		_set_progress ((double) *_transferred / _total_size);
+	Transfer transfer = { &file, progress, 0 };
+	curl_easy_setopt (curl, CURLOPT_READDATA, &transfer);
+	curl_easy_setopt (curl, CURLOPT_SEEKDATA, &transfer);
+	curl_easy_setopt (curl, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(0));
+
+	for (int attempt = 1; ; ++attempt) {
+		auto const r = curl_easy_perform (curl);
+		if (r == CURLE_OK) {
+			break;
+		}
+
+		bool const transient =
+			r == CURLE_COULDNT_CONNECT ||
+			r == CURLE_OPERATION_TIMEDOUT ||
+			r == CURLE_SEND_ERROR ||
+			r == CURLE_RECV_ERROR ||
+			r == CURLE_PARTIAL_FILE ||
+			r == CURLE_UPLOAD_FAILED ||
+			r == CURLE_GOT_NOTHING;
+
+		if (!transient || attempt == upload_attempts) {
+			throw NetworkError (String::compose (_("Could not write to remote file (%1)"), curl_easy_strerror (r)));
+		}
+
+		LOG_GENERAL ("Upload of %1 failed (%2); will try to resume it", to.generic_string(), curl_easy_strerror(r));
+		dcpomatic_sleep_seconds (attempt);
+		/* Ask the server how much it has and carry on from there */
+		curl_easy_setopt (curl, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(-1));
 	}
 
-	return r;
+	curl_easy_setopt (curl, CURLOPT_READDATA, nullptr);
+	curl_easy_setopt (curl, CURLOPT_SEEKDATA, nullptr);
 }
 
 
@@ -137,4 +231,3 @@ CurlUploader::debug(CURL *, curl_infotype type, char* data, size_t size)
 	}
 	return 0;
 }
-
@@ -22,6 +22,8 @@
 #include "uploader.h"
 #include <dcp/file.h>
 #include <curl/curl.h>
+#include <boost/thread/mutex.hpp>
+#include <vector>
 
 
 class CurlUploader : public Uploader
@@ -30,17 +32,24 @@ public:
 	CurlUploader (std::function<void (std::string)> set_status, std::function<void (float)> set_progress);
 	~CurlUploader ();
 
-	size_t read_callback (void* ptr, size_t size, size_t nmemb);
 	int debug(CURL* curl, curl_infotype type, char* data, size_t size);
 
 protected:
 	void create_directory (boost::filesystem::path directory) override;
-	void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size) override;
+	void upload_file (boost::filesystem::path from, boost::filesystem::path to, std::function<void (boost::uintmax_t)> progress) override;
+	int parallel_uploads () const override;
 
 private:
-	CURL* _curl;
-
-	FILE* _file = nullptr;
-	boost::uintmax_t* _transferred = nullptr;
-	boost::uintmax_t _total_size = 0;
+	CURL* get_handle ();
+	void release_handle (CURL* handle);
+
+	std::string _host;
+	std::string _path;
+	std::string _user;
+	std::string _password;
+	bool _passive;
+
+	boost::mutex _mutex;
+	/** handles (each with any connection that it has made) which are not being used for an upload */
+	std::vector<CURL*> _idle;
 };
@@ -56,7 +56,6 @@ using std::shared_ptr;
 using std::string;
 using std::vector;
 using boost::optional;
-using boost::scoped_ptr;
 #if BOOST_VERSION >= 106100
 using namespace boost::placeholders;
 #endif
@@ -222,7 +221,7 @@ DCPContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 	}
 	Content::examine (film, job);
 
-	auto examiner = make_shared<DCPExaminer>(shared_from_this(), film ? film->tolerant() : true);
+	auto examiner = DCPExaminer::cached_or_new(shared_from_this(), film ? film->tolerant() : true);
 
 	if (examiner->has_video()) {
 		{
@@ -543,7 +542,7 @@ DCPContent::reels (shared_ptr<const Film> film) const
 	if (reel_lengths.empty()) {
 		/* Old metadata with no reel lengths; get them here instead */
 		try {
-			scoped_ptr<DCPExaminer> examiner (new DCPExaminer(shared_from_this(), film->tolerant()));
+			auto examiner = DCPExaminer::cached_or_new(shared_from_this(), film->tolerant());
 			reel_lengths = examiner->reel_lengths ();
 		} catch (...) {
 			/* Could not examine the DCP; guess reels */
@@ -650,28 +649,30 @@ bool check_video (shared_ptr<const Content> c)
 bool
 DCPContent::can_reference_video (shared_ptr<const Film> film, string& why_not) const
 {
-	if (!video) {
-		why_not = _("There is no video in this DCP");
-		return false;
-	}
+	return cached_can_reference (film, _can_reference_video, [this, film](string& reason) {
+		if (!video) {
+			reason = _("There is no video in this DCP");
+			return false;
+		}
 
-	if (film->resolution() != resolution()) {
-		if (resolution() == Resolution::FOUR_K) {
-			/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-			why_not = _("it is 4K and the film is 2K.");
-		} else {
+		if (film->resolution() != resolution()) {
+			if (resolution() == Resolution::FOUR_K) {
+				/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
+				reason = _("it is 4K and the film is 2K.");
+			} else {
+				/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
+				reason = _("it is 2K and the film is 4K.");
+			}
+			return false;
+		} else if (film->frame_size() != video->size()) {
 			/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-			why_not = _("it is 2K and the film is 4K.");
+			reason = _("its video frame size differs from the film's.");
+			return false;
 		}
-		return false;
-	} else if (film->frame_size() != video->size()) {
-		/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-		why_not = _("its video frame size differs from the film's.");
-		return false;
-	}
 
-	/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-	return can_reference (film, bind (&check_video, _1), _("it overlaps other video content; remove the other content."), why_not);
+		/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
+		return can_reference (film, bind (&check_video, _1), _("it overlaps other video content; remove the other content."), reason);
+	}, why_not);
 }
 
 static
@@ -683,30 +684,22 @@ bool check_audio (shared_ptr<const Content> c)
 bool
 DCPContent::can_reference_audio (shared_ptr<const Film> film, string& why_not) const
 {
-	shared_ptr<DCPDecoder> decoder;
-	try {
-		decoder = make_shared<DCPDecoder>(film, shared_from_this(), false, film->tolerant(), shared_ptr<DCPDecoder>());
-	} catch (dcp::ReadError &) {
-		/* We couldn't read the DCP, so it's probably missing */
-		return false;
-	} catch (DCPError &) {
-		/* We couldn't read the DCP, so it's probably missing */
-		return false;
-	} catch (dcp::KDMDecryptionError &) {
-		/* We have an incorrect KDM */
-		return false;
-	}
+	return cached_can_reference (film, _can_reference_audio, [this, film](string& reason) {
+		auto const summary = reel_summary (film);
+		if (!summary.readable) {
+			/* We couldn't read the DCP, so it's probably missing, or we have an incorrect KDM */
+			return false;
+		}
 
-        for (auto i: decoder->reels()) {
-                if (!i->main_sound()) {
+		if (!summary.sound_in_all_reels) {
 			/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-                        why_not = _("it does not have sound in all its reels.");
-                        return false;
-                }
-        }
+			reason = _("it does not have sound in all its reels.");
+			return false;
+		}
 
-	/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-	return can_reference (film, bind (&check_audio, _1), _("it overlaps other audio content; remove the other content."), why_not);
+		/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
+		return can_reference (film, bind (&check_audio, _1), _("it overlaps other audio content; remove the other content."), reason);
+	}, why_not);
 }
 
 static
@@ -718,53 +711,157 @@ bool check_text (shared_ptr<const Content> c)
 bool
 DCPContent::can_reference_text (shared_ptr<const Film> film, TextType type, string& why_not) const
 {
-	shared_ptr<DCPDecoder> decoder;
-	try {
-		decoder = make_shared<DCPDecoder>(film, shared_from_this(), false, film->tolerant(), shared_ptr<DCPDecoder>());
-	} catch (dcp::ReadError &) {
-		/* We couldn't read the DCP, so it's probably missing */
-		return false;
-	} catch (dcp::KDMDecryptionError &) {
-		/* We have an incorrect KDM */
-		return false;
-	}
+	return cached_can_reference (film, _can_reference_text[type], [this, film, type](string& reason) {
+		auto const summary = reel_summary (film);
+		if (!summary.readable) {
+			/* We couldn't read the DCP, so it's probably missing, or we have an incorrect KDM */
+			return false;
+		}
 
-        for (auto i: decoder->reels()) {
-                if (type == TextType::OPEN_SUBTITLE) {
-			if (!i->main_subtitle()) {
+		if (type == TextType::OPEN_SUBTITLE) {
+			if (!summary.subtitles_in_all_reels) {
 				/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-				why_not = _("it does not have open subtitles in all its reels.");
+				reason = _("it does not have open subtitles in all its reels.");
 				return false;
-			} else if (i->main_subtitle()->entry_point().get_value_or(0) != 0) {
+			} else if (!summary.subtitle_entry_points_zero) {
 				/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-				why_not = _("one of its subtitle reels has a non-zero entry point so it must be re-written.");
+				reason = _("one of its subtitle reels has a non-zero entry point so it must be re-written.");
 				return false;
 			}
-                }
+		}
 		if (type == TextType::CLOSED_CAPTION) {
-			if (i->closed_captions().empty()) {
+			if (!summary.closed_captions_in_all_reels) {
+				/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
+				reason = _("it does not have closed captions in all its reels.");
+				return false;
+			} else if (!summary.closed_caption_entry_points_zero) {
 				/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-				why_not = _("it does not have closed captions in all its reels.");
+				reason = _("one of its closed caption has a non-zero entry point so it must be re-written.");
 				return false;
 			}
+		}
+
+		if (trim_start() != dcpomatic::ContentTime()) {
+			/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
+			reason = _("it has a start trim so its subtitles or closed captions must be re-written.");
+			return false;
+		}
+
+		/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
+		return can_reference (film, bind (&check_text, _1), _("it overlaps other text content; remove the other content."), reason);
+	}, why_not);
+}
+
+/** Look through the reels of our DCP for the things that can_reference_audio() and
+ *  can_reference_text() need to know.  This means making a DCPDecoder, which is slow,
+ *  so the answer is kept until the film changes.
+ */
+DCPContent::ReelSummary
+DCPContent::reel_summary (shared_ptr<const Film> film) const
+{
+	uint64_t change;
+	{
+		boost::mutex::scoped_lock lm (_reference_cache_mutex);
+		change = use_reference_cache_for (film);
+		if (_reel_summary) {
+			return *_reel_summary;
+		}
+	}
+
+	ReelSummary summary;
+
+	try {
+		DCPDecoder decoder (film, shared_from_this(), false, film->tolerant(), shared_ptr<DCPDecoder>());
+		for (auto i: decoder.reels()) {
+			if (!i->main_sound()) {
+				summary.sound_in_all_reels = false;
+			}
+			if (!i->main_subtitle()) {
+				summary.subtitles_in_all_reels = false;
+			} else if (i->main_subtitle()->entry_point().get_value_or(0) != 0) {
+				summary.subtitle_entry_points_zero = false;
+			}
+			if (i->closed_captions().empty()) {
+				summary.closed_captions_in_all_reels = false;
+			}
 			for (auto j: i->closed_captions()) {
 				if (j->entry_point().get_value_or(0) != 0) {
-					/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-					why_not = _("one of its closed caption has a non-zero entry point so it must be re-written.");
-					return false;
+					summary.closed_caption_entry_points_zero = false;
 				}
 			}
 		}
-        }
+		summary.readable = true;
+	} catch (dcp::ReadError &) {
+		/* We couldn't read the DCP, so it's probably missing */
+	} catch (DCPError &) {
+		/* We couldn't read the DCP, so it's probably missing */
+	} catch (dcp::KDMDecryptionError &) {
+		/* We have an incorrect KDM */
+	}
+
+	boost::mutex::scoped_lock lm (_reference_cache_mutex);
+	if (_reference_cache_film == film.get() && _reference_cache_change == change) {
+		_reel_summary = summary;
+	}
+
+	return summary;
+}
+
+/** Forget anything in our reference cache that was worked out for a different film,
+ *  or before the last change to this one.  _reference_cache_mutex must be held.
+ *  @return Change count of film that anything now worked out should be stored against.
+ */
+uint64_t
+DCPContent::use_reference_cache_for (shared_ptr<const Film> film) const
+{
+	auto const change = film->change_count();
+	if (_reference_cache_film != film.get() || _reference_cache_change != change) {
+		_reference_cache_film = film.get();
+		_reference_cache_change = change;
+		_reel_summary = boost::none;
+		_can_reference_video = boost::none;
+		_can_reference_audio = boost::none;
+		_can_reference_text.clear();
+	}
+	return change;
+}
+
+/** Answer one of the can_reference_*() questions, using cache if it is still valid
+ *  or otherwise calling check and storing what it says in cache.
+ */
+bool
+DCPContent::cached_can_reference (
+	shared_ptr<const Film> film,
+	optional<ReferenceCheck>& cache,
+	function<bool (string&)> check,
+	string& why_not
+	) const
+{
+	uint64_t change;
+	{
+		boost::mutex::scoped_lock lm (_reference_cache_mutex);
+		change = use_reference_cache_for (film);
+		if (cache) {
+			if (!cache->can) {
+				why_not = cache->why_not;
+			}
+			return cache->can;
+		}
+	}
 
-	if (trim_start() != dcpomatic::ContentTime()) {
-		/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-		why_not = _("it has a start trim so its subtitles or closed captions must be re-written.");
-		return false;
+	/* This may take a while, so don't hold the lock */
+	ReferenceCheck result;
+	result.can = check (result.why_not);
+
+	boost::mutex::scoped_lock lm (_reference_cache_mutex);
+	if (_reference_cache_film == film.get() && _reference_cache_change == change) {
+		cache = result;
 	}
 
-	/// TRANSLATORS: this string will follow "Cannot reference this DCP: "
-	return can_reference (film, bind (&check_text, _1), _("it overlaps other text content; remove the other content."), why_not);
+	if (!result.can) {
+		why_not = result.why_not;
+	}
+	return result.can;
 }
 
 void
@@ -847,7 +944,7 @@ DCPContent::check_font_ids()
 		return;
 	}
 
-	DCPExaminer examiner(shared_from_this(), true);
-	add_fonts_from_examiner(text.front(), examiner.fonts());
+	auto examiner = DCPExaminer::cached_or_new(shared_from_this(), true);
+	add_fonts_from_examiner(text.front(), examiner->fonts());
 }
 
@@ -190,6 +190,35 @@ private:
 		std::string& why_not
 		) const;
 
+	/** What can_reference_audio() and can_reference_text() need to know about the assets in our reels */
+	struct ReelSummary
+	{
+		/** true if we could read the DCP */
+		bool readable = false;
+		bool sound_in_all_reels = true;
+		bool subtitles_in_all_reels = true;
+		bool subtitle_entry_points_zero = true;
+		bool closed_captions_in_all_reels = true;
+		bool closed_caption_entry_points_zero = true;
+	};
+
+	ReelSummary reel_summary (std::shared_ptr<const Film> film) const;
+
+	struct ReferenceCheck
+	{
+		bool can;
+		std::string why_not;
+	};
+
+	bool cached_can_reference (
+		std::shared_ptr<const Film> film,
+		boost::optional<ReferenceCheck>& cache,
+		std::function<bool (std::string&)> check,
+		std::string& why_not
+		) const;
+
+	uint64_t use_reference_cache_for (std::shared_ptr<const Film> film) const;
+
 	std::string _name;
 	/** true if our DCP is encrypted */
 	bool _encrypted;
@@ -224,6 +253,18 @@ private:
 	std::map<dcp::Marker, dcpomatic::ContentTime> _markers;
 	std::vector<dcp::Rating> _ratings;
 	std::vector<std::string> _content_versions;
+
+	/** Results of can_reference_*() and the reel summary that they use, all of which are
+	 *  valid while _reference_cache_film's change_count() is _reference_cache_change.
+	 *  These are protected by _reference_cache_mutex.
+	 */
+	mutable boost::mutex _reference_cache_mutex;
+	mutable Film const* _reference_cache_film = nullptr;
+	mutable uint64_t _reference_cache_change = 0;
+	mutable boost::optional<ReelSummary> _reel_summary;
+	mutable boost::optional<ReferenceCheck> _can_reference_video;
+	mutable boost::optional<ReferenceCheck> _can_reference_audio;
+	mutable EnumIndexedVector<boost::optional<ReferenceCheck>, TextType> _can_reference_text;
 };
 
 
@@ -51,6 +51,7 @@
 #include <dcp/stereo_picture_asset_reader.h>
 #include <dcp/stereo_picture_frame.h>
 #include <dcp/subtitle_image.h>
+#include <cmath>
 #include <iostream>
 
 #include "i18n.h"
@@ -134,11 +135,39 @@ DCPDecoder::DCPDecoder (shared_ptr<const Film> film, shared_ptr<const DCPContent
 
 	set_decode_referenced (false);
 
+	if (video && content->encrypted()) {
+		/* Reading an encrypted frame means decrypting it too, which is enough work that it is
+		 * worth doing a few frames at once ahead of time.
+		 */
+		auto const threads = std::max(1, std::min(Config::instance()->decoding_threads(), 4));
+		_prefetch_length = threads * 2;
+		_prefetch_work = make_shared<boost::asio::io_service::work>(_prefetch_service);
+		for (int i = 0; i < threads; ++i) {
+			_prefetch_pool.create_thread ([this]() {
+				_prefetch_service.run ();
+			});
+		}
+	}
+
 	_reel = _reels.begin ();
 	get_readers ();
 }
 
 
+DCPDecoder::~DCPDecoder ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	/* Abandon any frames that have not yet been started */
+	_prefetch_work.reset ();
+	_prefetch_service.stop ();
+
+	try {
+		_prefetch_pool.join_all ();
+	} catch (...) {}
+}
+
+
 bool
 DCPDecoder::pass ()
 {
@@ -161,18 +190,27 @@ DCPDecoder::pass ()
 	auto picture_asset = (*_reel)->main_picture()->asset();
 	DCPOMATIC_ASSERT (picture_asset);
 
+	bool const want_video = (_mono_reader || _stereo_reader) && (_decode_referenced || !_dcp_content->reference_video()) && video && !video->ignore();
+	bool const want_audio = _sound_reader && (_decode_referenced || !_dcp_content->reference_audio()) && audio && !audio->ignore();
+
+	/* If we have nothing to emit but texts (e.g. when exporting subtitles) we can do the rest
+	   of the reel in one go rather than looking at it a frame at a time.
+	*/
+	int64_t const frames = (want_video || want_audio || _atmos_reader) ? 1 : std::max(int64_t(1), (*_reel)->main_picture()->duration() - frame);
+
 	/* We must emit texts first as when we emit the video for this frame
 	   it will expect already to have the texts.
 	*/
-	pass_texts (_next, picture_asset->size());
+	pass_texts (_next, picture_asset->size(), frames);
 
-	if ((_mono_reader || _stereo_reader) && (_decode_referenced || !_dcp_content->reference_video())) {
+	if (want_video) {
 		auto const entry_point = (*_reel)->main_picture()->entry_point().get_value_or(0);
-		if (_mono_reader) {
+		auto const picture = picture_frame (entry_point + frame, entry_point + (*_reel)->main_picture()->duration());
+		if (picture.mono) {
 			video->emit (
 				film(),
 				std::make_shared<J2KImageProxy>(
-					_mono_reader->get_frame (entry_point + frame),
+					picture.mono,
 					picture_asset->size(),
 					AV_PIX_FMT_XYZ12LE,
 					_forced_reduction
@@ -183,7 +221,7 @@ DCPDecoder::pass ()
 			video->emit (
 				film(),
 				std::make_shared<J2KImageProxy>(
-					_stereo_reader->get_frame (entry_point + frame),
+					picture.stereo,
 					picture_asset->size(),
 					dcp::Eye::LEFT,
 					AV_PIX_FMT_XYZ12LE,
@@ -195,7 +233,7 @@ DCPDecoder::pass ()
 			video->emit (
 				film(),
 				std::make_shared<J2KImageProxy>(
-					_stereo_reader->get_frame (entry_point + frame),
+					picture.stereo,
 					picture_asset->size(),
 					dcp::Eye::RIGHT,
 					AV_PIX_FMT_XYZ12LE,
@@ -206,9 +244,9 @@ DCPDecoder::pass ()
 		}
 	}
 
-	if (_sound_reader && (_decode_referenced || !_dcp_content->reference_audio())) {
+	if (want_audio) {
 		auto const entry_point = (*_reel)->main_sound()->entry_point().get_value_or(0);
-		auto sf = _sound_reader->get_frame (entry_point + frame);
+		auto sf = _sound_prefetcher ? _sound_prefetcher->get(entry_point + frame) : _sound_reader->get_frame(entry_point + frame);
 		auto from = sf->data ();
 
 		int const channels = _dcp_content->audio->stream()->channels ();
@@ -228,10 +266,11 @@ DCPDecoder::pass ()
 	if (_atmos_reader) {
 		DCPOMATIC_ASSERT (_atmos_metadata);
 		auto const entry_point = (*_reel)->atmos()->entry_point().get_value_or(0);
-		atmos->emit (film(), _atmos_reader->get_frame(entry_point + frame), _offset + frame, *_atmos_metadata);
+		auto const atmos_frame = _atmos_prefetcher ? _atmos_prefetcher->get(entry_point + frame) : _atmos_reader->get_frame(entry_point + frame);
+		atmos->emit (film(), atmos_frame, _offset + frame, *_atmos_metadata);
 	}
 
-	_next += ContentTime::from_frames (1, vfr);
+	_next += ContentTime::from_frames (frames, vfr);
 
 	if ((*_reel)->main_picture ()) {
 		if (_next.frames_round (vfr) >= (*_reel)->main_picture()->duration()) {
@@ -244,8 +283,12 @@ DCPDecoder::pass ()
 }
 
 
+/** Emit the texts that start in some frames of the current reel.
+ *  @param next Time of the first frame relative to the start of the reel.
+ *  @param frames Number of frames.
+ */
 void
-DCPDecoder::pass_texts (ContentTime next, dcp::Size size)
+DCPDecoder::pass_texts (ContentTime next, dcp::Size size, int64_t frames)
 {
 	auto decoder = text.begin ();
 	if (decoder == text.end()) {
@@ -258,6 +301,7 @@ DCPDecoder::pass_texts (ContentTime next, dcp::Size size)
 	if ((*_reel)->main_subtitle()) {
 		pass_texts (
 			next,
+			frames,
 			(*_reel)->main_subtitle()->asset(),
 			_dcp_content->reference_text(TextType::OPEN_SUBTITLE),
 			(*_reel)->main_subtitle()->entry_point().get_value_or(0),
@@ -269,7 +313,7 @@ DCPDecoder::pass_texts (ContentTime next, dcp::Size size)
 
 	for (auto i: (*_reel)->closed_captions()) {
 		pass_texts (
-			next, i->asset(), _dcp_content->reference_text(TextType::CLOSED_CAPTION), i->entry_point().get_value_or(0), *decoder, size
+			next, frames, i->asset(), _dcp_content->reference_text(TextType::CLOSED_CAPTION), i->entry_point().get_value_or(0), *decoder, size
 			);
 		++decoder;
 	}
@@ -277,7 +321,7 @@ DCPDecoder::pass_texts (ContentTime next, dcp::Size size)
 
 void
 DCPDecoder::pass_texts (
-	ContentTime next, shared_ptr<dcp::SubtitleAsset> asset, bool reference, int64_t entry_point, shared_ptr<TextDecoder> decoder, dcp::Size size
+	ContentTime next, int64_t frames, shared_ptr<dcp::SubtitleAsset> asset, bool reference, int64_t entry_point, shared_ptr<TextDecoder> decoder, dcp::Size size
 	)
 {
 	auto const vfr = _dcp_content->active_video_frame_rate (film());
@@ -287,7 +331,7 @@ DCPDecoder::pass_texts (
 	if (_decode_referenced || !reference) {
 		auto subs = asset->subtitles_during (
 			dcp::Time (entry_point + frame, vfr, vfr),
-			dcp::Time (entry_point + frame + 1, vfr, vfr),
+			dcp::Time (entry_point + frame + frames, vfr, vfr),
 			true
 			);
 
@@ -357,9 +401,125 @@ DCPDecoder::next_reel ()
 }
 
 
+/** Read a picture frame, or get it from those that have been read in advance, and ask
+ *  for the ones after it to be read.
+ *  @param index Index of the frame within the current reel's picture asset.
+ *  @param end Index of the frame after the last one that we will play from the asset.
+ */
+DCPDecoder::PictureFrame
+DCPDecoder::picture_frame (int64_t index, int64_t end)
+{
+	if (_prefetch_length == 0) {
+		PictureFrame picture;
+		if (_mono_prefetcher) {
+			picture.mono = _mono_prefetcher->get (index);
+		} else if (_stereo_prefetcher) {
+			picture.stereo = _stereo_prefetcher->get (index);
+		} else if (_mono_reader) {
+			picture.mono = _mono_reader->get_frame (index);
+		} else {
+			picture.stereo = _stereo_reader->get_frame (index);
+		}
+		return picture;
+	}
+
+	_prefetch.erase (_prefetch.begin(), _prefetch.lower_bound(index));
+
+	auto const asset = (*_reel)->main_picture()->asset();
+	for (auto i = index; i < std::min(index + _prefetch_length, end); ++i) {
+		if (_prefetch.find(i) != _prefetch.end()) {
+			continue;
+		}
+
+		auto prefetch = make_shared<PicturePrefetch>();
+		_prefetch[i] = prefetch;
+		_prefetch_service.post ([this, asset, i, prefetch]() {
+			read_picture (asset, i, prefetch);
+		});
+	}
+
+	auto prefetch = _prefetch[index];
+	_prefetch.erase (index);
+
+	boost::mutex::scoped_lock lm (_prefetch_mutex);
+	while (!prefetch->done) {
+		_prefetch_condition.wait (lm);
+	}
+
+	if (prefetch->error) {
+		std::rethrow_exception (prefetch->error);
+	}
+
+	return prefetch->frame;
+}
+
+
+/** Called in one of our prefetch threads to read a picture frame from a reader of its own */
+void
+DCPDecoder::read_picture (shared_ptr<const dcp::PictureAsset> asset, int64_t index, shared_ptr<PicturePrefetch> prefetch)
+{
+	PictureFrame picture;
+	std::exception_ptr error;
+
+	try {
+		PictureReaders readers;
+		{
+			boost::mutex::scoped_lock lm (_prefetch_mutex);
+			if (asset == _prefetch_asset && !_spare_readers.empty()) {
+				readers = _spare_readers.back ();
+				_spare_readers.pop_back ();
+			}
+		}
+
+		if (!readers.mono && !readers.stereo) {
+			if (auto mono = dynamic_pointer_cast<const dcp::MonoPictureAsset>(asset)) {
+				readers.mono = mono->start_read ();
+				readers.mono->set_check_hmac (false);
+			} else {
+				auto stereo = dynamic_pointer_cast<const dcp::StereoPictureAsset>(asset);
+				DCPOMATIC_ASSERT (stereo);
+				readers.stereo = stereo->start_read ();
+				readers.stereo->set_check_hmac (false);
+			}
+		}
+
+		if (readers.mono) {
+			picture.mono = readers.mono->get_frame (index);
+		} else {
+			picture.stereo = readers.stereo->get_frame (index);
+		}
+
+		boost::mutex::scoped_lock lm (_prefetch_mutex);
+		if (asset == _prefetch_asset) {
+			_spare_readers.push_back (readers);
+		}
+	} catch (...) {
+		error = std::current_exception ();
+	}
+
+	boost::mutex::scoped_lock lm (_prefetch_mutex);
+	prefetch->frame = picture;
+	prefetch->error = error;
+	prefetch->done = true;
+	_prefetch_condition.notify_all ();
+}
+
+
 void
 DCPDecoder::get_readers ()
 {
+	_prefetch.clear ();
+	{
+		boost::mutex::scoped_lock lm (_prefetch_mutex);
+		_prefetch_asset.reset ();
+		_spare_readers.clear ();
+	}
+
+	_mono_prefetcher.reset ();
+	_stereo_prefetcher.reset ();
+	_sound_prefetcher.reset ();
+	_atmos_prefetcher.reset ();
+
 	if (_reel == _reels.end() || !_dcp_content->can_be_played ()) {
 		_mono_reader.reset ();
 		_stereo_reader.reset ();
@@ -382,6 +542,12 @@ DCPDecoder::get_readers ()
 			_stereo_reader->set_check_hmac (false);
 			_mono_reader.reset ();
 		}
+		if (_prefetch_length) {
+			/* Our prefetch threads can use the reader that we just made, as well as their own */
+			boost::mutex::scoped_lock lm (_prefetch_mutex);
+			_prefetch_asset = asset;
+			_spare_readers.push_back ({ _mono_reader, _stereo_reader });
+		}
 	} else {
 		_mono_reader.reset ();
 		_stereo_reader.reset ();
@@ -403,6 +569,46 @@ DCPDecoder::get_readers ()
 		_atmos_reader.reset ();
 		_atmos_metadata = boost::none;
 	}
+
+	auto const read_ahead = Config::instance()->mxf_read_ahead_frames();
+	if (read_ahead == 0) {
+		return;
+	}
+
+	/* The prefetchers' threads have the readers to themselves from now on */
+	if (_mono_reader && !_prefetch_length) {
+		auto reader = _mono_reader;
+		_mono_prefetcher.reset (
+			new FramePrefetcher<shared_ptr<const dcp::MonoPictureFrame>>(
+				[reader](int64_t index) { return reader->get_frame(index); }, (*_reel)->main_picture()->asset()->intrinsic_duration(), read_ahead
+				)
+			);
+	} else if (_stereo_reader && !_prefetch_length) {
+		auto reader = _stereo_reader;
+		_stereo_prefetcher.reset (
+			new FramePrefetcher<shared_ptr<const dcp::StereoPictureFrame>>(
+				[reader](int64_t index) { return reader->get_frame(index); }, (*_reel)->main_picture()->asset()->intrinsic_duration(), read_ahead
+				)
+			);
+	}
+
+	if (_sound_reader) {
+		auto reader = _sound_reader;
+		_sound_prefetcher.reset (
+			new FramePrefetcher<shared_ptr<const dcp::SoundFrame>>(
+				[reader](int64_t index) { return reader->get_frame(index); }, (*_reel)->main_sound()->asset()->intrinsic_duration(), read_ahead
+				)
+			);
+	}
+
+	if (_atmos_reader) {
+		auto reader = _atmos_reader;
+		_atmos_prefetcher.reset (
+			new FramePrefetcher<shared_ptr<const dcp::AtmosFrame>>(
+				[reader](int64_t index) { return reader->get_frame(index); }, (*_reel)->atmos()->asset()->intrinsic_duration(), read_ahead
+				)
+			);
+	}
 }
 
 
@@ -443,10 +649,9 @@ DCPDecoder::seek (ContentTime t, bool accurate)
 
 	/* Pass texts in the pre-roll */
 
-	auto const vfr = _dcp_content->active_video_frame_rate (film());
-	for (int i = 0; i < pre_roll_seconds * vfr; ++i) {
-		pass_texts (pre, (*_reel)->main_picture()->asset()->size());
-		pre += ContentTime::from_frames (1, vfr);
+	if (_reel != _reels.end()) {
+		auto const vfr = _dcp_content->active_video_frame_rate (film());
+		pass_texts (pre, (*_reel)->main_picture()->asset()->size(), std::ceil(pre_roll_seconds * vfr));
 	}
 
 	/* Seek to correct position */
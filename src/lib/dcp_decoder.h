@@ -26,13 +26,21 @@
 
 #include "atmos_metadata.h"
 #include "decoder.h"
+#include "frame_prefetcher.h"
+#include <dcp/atmos_asset_reader.h>
 #include <dcp/mono_picture_asset_reader.h>
 #include <dcp/stereo_picture_asset_reader.h>
 #include <dcp/sound_asset_reader.h>
 #include <dcp/subtitle_asset.h>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <exception>
+#include <map>
 
 
 namespace dcp {
+	class PictureAsset;
 	class Reel;
 }
 
@@ -51,6 +59,10 @@ public:
 		bool tolerant,
 		std::shared_ptr<DCPDecoder> old
 		);
+	~DCPDecoder ();
+
+	DCPDecoder (DCPDecoder const&) = delete;
+	DCPDecoder& operator= (DCPDecoder const&) = delete;
 
 	std::vector<std::shared_ptr<dcp::Reel>> reels () const {
 		return _reels;
@@ -71,11 +83,36 @@ public:
 private:
 	friend struct dcp_subtitle_within_dcp_test;
 
+	/** A frame from a picture asset; one of these will be set */
+	struct PictureFrame
+	{
+		std::shared_ptr<const dcp::MonoPictureFrame> mono;
+		std::shared_ptr<const dcp::StereoPictureFrame> stereo;
+	};
+
+	struct PicturePrefetch
+	{
+		PictureFrame frame;
+		/** exception thrown when reading the frame, if there was one */
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	/** Readers for a picture asset; one of these will be set */
+	struct PictureReaders
+	{
+		std::shared_ptr<dcp::MonoPictureAssetReader> mono;
+		std::shared_ptr<dcp::StereoPictureAssetReader> stereo;
+	};
+
 	void next_reel ();
 	void get_readers ();
-	void pass_texts (dcpomatic::ContentTime next, dcp::Size size);
+	PictureFrame picture_frame (int64_t index, int64_t end);
+	void read_picture (std::shared_ptr<const dcp::PictureAsset> asset, int64_t index, std::shared_ptr<PicturePrefetch> prefetch);
+	void pass_texts (dcpomatic::ContentTime next, dcp::Size size, int64_t frames);
 	void pass_texts (
 		dcpomatic::ContentTime next,
+		int64_t frames,
 		std::shared_ptr<dcp::SubtitleAsset> asset,
 		bool reference,
 		int64_t entry_point,
@@ -102,8 +139,34 @@ private:
 	std::shared_ptr<dcp::AtmosAssetReader> _atmos_reader;
 	boost::optional<AtmosMetadata> _atmos_metadata;
 
+	/* Things to read ahead from the readers above, if Config asks for that.  Encrypted pictures
+	 * are read ahead by our own pool of threads instead (see picture_frame()).
+	 */
+	std::unique_ptr<FramePrefetcher<std::shared_ptr<const dcp::MonoPictureFrame>>> _mono_prefetcher;
+	std::unique_ptr<FramePrefetcher<std::shared_ptr<const dcp::StereoPictureFrame>>> _stereo_prefetcher;
+	std::unique_ptr<FramePrefetcher<std::shared_ptr<const dcp::SoundFrame>>> _sound_prefetcher;
+	std::unique_ptr<FramePrefetcher<std::shared_ptr<const dcp::AtmosFrame>>> _atmos_prefetcher;
+
 	bool _decode_referenced = false;
 	boost::optional<int> _forced_reduction;
 
+	/** number of picture frames to read (and decrypt) in advance, or 0 to read each one when it is needed */
+	int _prefetch_length = 0;
+	boost::thread_group _prefetch_pool;
+	boost::asio::io_service _prefetch_service;
+	std::shared_ptr<boost::asio::io_service::work> _prefetch_work;
+	/** frames that have been given to _prefetch_service, indexed by their position in the current
+	 *  reel's picture asset; only used by the thread calling pass()
+	 */
+	std::map<int64_t, std::shared_ptr<PicturePrefetch>> _prefetch;
+
+	/** mutex to protect the contents of the PicturePrefetch objects, _prefetch_asset and _spare_readers */
+	boost::mutex _prefetch_mutex;
+	boost::condition _prefetch_condition;
+	/** picture asset that is being prefetched from */
+	std::shared_ptr<const dcp::PictureAsset> _prefetch_asset;
+	/** readers of _prefetch_asset which are not being used by any prefetch job */
+	std::vector<PictureReaders> _spare_readers;
+
 	std::string _lazy_digest;
 };
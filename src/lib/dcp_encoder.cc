@@ -25,19 +25,29 @@
  *  as a parameter to the constructor.
  */
 
+#include "config.h"
 #include "dcp_encoder.h"
+#include "dcpomatic_log.h"
+#include "export_sink.h"
 #include "j2k_encoder.h"
 #include "film.h"
 #include "video_decoder.h"
 #include "audio_decoder.h"
 #include "player.h"
 #include "job.h"
+#include "memory_budget.h"
+#include "version.h"
 #include "writer.h"
 #include "compose.hpp"
 #include "referenced_reel_asset.h"
 #include "text_content.h"
+#include "transcode_job.h"
 #include "player_video.h"
+#include "rate_control.h"
+#include <dcp/local_time.h>
 #include <boost/signals2.hpp>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
 #include "i18n.h"
@@ -91,9 +101,28 @@ DCPEncoder::~DCPEncoder ()
 	_player_atmos_connection.release ();
 }
 
+/** Add something which should be given the same video and audio as the DCP, so that it
+ *  can make another output from them.  This must be called before go().
+ */
+void
+DCPEncoder::add_sink (shared_ptr<ExportSink> sink)
+{
+	_sinks.push_back (sink);
+}
+
+
 void
 DCPEncoder::go ()
 {
+	if (_film->two_pass_encoding()) {
+		analyse_complexity ();
+	}
+
+	auto const start = std::chrono::steady_clock::now();
+	auto since_start = [start]() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+
 	_writer.start();
 	_j2k_encoder.begin();
 
@@ -107,6 +136,13 @@ DCPEncoder::go ()
 		_writer.write(_player.get_subtitle_fonts());
 	}
 
+	/* Our sinks need the whole film, so we can't skip any of it if we have some */
+	auto const resume = _sinks.empty() ? _writer.resume_time() : DCPTime();
+	if (resume != DCPTime()) {
+		LOG_GENERAL ("Reels up to %1 are already complete", to_string(resume));
+		_player.seek(resume, true);
+	}
+
 	while (!_player.pass()) {}
 
 	for (auto i: get_referenced_reel_assets(_film, _film->playlist())) {
@@ -115,18 +151,116 @@ DCPEncoder::go ()
 
 	_finishing = true;
 	_j2k_encoder.end();
+
+	PerformanceReport report;
+	report.encode_time = since_start();
+
+	for (auto sink: _sinks) {
+		sink->finish ();
+	}
+
+	/* The encoder's threads are now finished with, so another film can start encoding
+	 * while we write this one's metadata and hash its assets.
+	 */
+	if (auto job = dynamic_pointer_cast<TranscodeJob>(_job.lock())) {
+		job->encoding_finished ();
+	}
+
 	_writer.finish(_film->dir(_film->dcp_name()));
+
+	report.version = dcpomatic_version;
+	report.date = dcp::LocalTime().as_string();
+	_j2k_encoder.fill_report(report);
+	_writer.fill_report(report);
+	report.frames = report.full_written + report.fake_written + report.repeat_written;
+	report.finish_time = std::max(0.0, since_start() - report.encode_time - report.digest_time);
+
+	auto memory = MemoryBudget::instance();
+	for (int i = 0; i < static_cast<int>(MemoryBudget::Subsystem::COUNT); ++i) {
+		auto const subsystem = static_cast<MemoryBudget::Subsystem>(i);
+		report.peak_memory[MemoryBudget::name(subsystem)] = memory->peak(subsystem);
+	}
+	report.total_peak_memory = memory->peak_total();
+
+	_report = report;
 }
 
+/** Play through the film measuring how complex each frame of video is, and then
+ *  tell the J2K encoder to give the more complex frames more bandwidth.
+ */
+void
+DCPEncoder::analyse_complexity ()
+{
+	auto job = _job.lock ();
+	DCPOMATIC_ASSERT (job);
+	job->sub (_("Analysing picture"));
+
+	auto const video_frame_rate = _film->video_frame_rate();
+	auto const length = _film->length().frames_round(video_frame_rate);
+	vector<double> complexity (length, 0);
+	vector<bool> seen (length, false);
+
+	Player player (_film, Image::Alignment::PADDED);
+	player.set_ignore_audio ();
+	player.set_ignore_text ();
+	player.set_fast ();
+	player.Video.connect ([this, job, video_frame_rate, &complexity, &seen](shared_ptr<PlayerVideo> pv, DCPTime time) {
+		auto const frame = time.frames_floor(video_frame_rate);
+		if (frame < static_cast<Frame>(complexity.size())) {
+			auto image = pv->image(bind(&PlayerVideo::keep_xyz_or_rgb, _1), VideoRange::FULL, true);
+			/* Take the more complex eye of a 3D frame since both eyes get the same bandwidth */
+			complexity[frame] = std::max(complexity[frame], frame_complexity(image));
+			seen[frame] = true;
+		}
+		job->set_progress (float(time.get()) / _film->length().get());
+	});
+
+	while (!player.pass()) {}
+
+	/* Frames that we did not see (perhaps because they are referenced from another DCP)
+	   will not be encoded, so leave them out when sharing the bandwidth out.
+	*/
+	vector<double> seen_complexity;
+	for (size_t i = 0; i < complexity.size(); ++i) {
+		if (seen[i]) {
+			seen_complexity.push_back (complexity[i]);
+		}
+	}
+
+	/* The DCI specification's per-frame limit is 250Mbit/s; don't go over that, or the film's own bandwidth if that is bigger */
+	auto const average = _film->j2k_bandwidth();
+	auto const maximum = std::max(average, std::min(Config::instance()->maximum_j2k_bandwidth(), 250000000));
+	auto const seen_bandwidths = allocate_j2k_bandwidths (seen_complexity, average, average / 4, maximum);
+
+	vector<int> bandwidths (length, average);
+	auto next = seen_bandwidths.begin();
+	for (size_t i = 0; i < bandwidths.size(); ++i) {
+		if (seen[i]) {
+			bandwidths[i] = *next++;
+		}
+	}
+
+	_j2k_encoder.set_frame_bandwidths (bandwidths);
+}
+
+
 void
 DCPEncoder::video (shared_ptr<PlayerVideo> data, DCPTime time)
 {
+	for (auto sink: _sinks) {
+		sink->video (data, time);
+	}
+
 	_j2k_encoder.encode(data, time);
 }
 
 void
 DCPEncoder::audio (shared_ptr<AudioBuffers> data, DCPTime time)
 {
+	for (auto sink: _sinks) {
+		sink->audio (data, time);
+	}
+
 	_writer.write(data, time);
 
 	auto job = _job.lock ();
@@ -161,3 +295,10 @@ DCPEncoder::frames_done () const
 {
 	return _j2k_encoder.video_frames_enqueued();
 }
+
+
+optional<string>
+DCPEncoder::warning () const
+{
+	return _writer.disk_space_warning();
+}
@@ -31,6 +31,7 @@
 
 
 class AudioBuffers;
+class ExportSink;
 class Film;
 class Job;
 class Player;
@@ -46,8 +47,14 @@ public:
 
 	void go () override;
 
+	void add_sink (std::shared_ptr<ExportSink> sink);
+
 	boost::optional<float> current_rate () const override;
 	Frame frames_done () const override;
+	boost::optional<std::string> warning () const override;
+	boost::optional<PerformanceReport> performance_report () const override {
+		return _report;
+	}
 
 	/** @return true if we are in the process of calling Encoder::process_end */
 	bool finishing () const override {
@@ -56,6 +63,7 @@ public:
 
 private:
 
+	void analyse_complexity ();
 	void video (std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime);
 	void audio (std::shared_ptr<AudioBuffers>, dcpomatic::DCPTime);
 	void text (PlayerText, TextType, boost::optional<DCPTextTrack>, dcpomatic::DCPTimePeriod);
@@ -65,6 +73,9 @@ private:
 	J2KEncoder _j2k_encoder;
 	bool _finishing;
 	bool _non_burnt_subtitles;
+	/** other outputs that are being made from the same player pass as the DCP */
+	std::vector<std::shared_ptr<ExportSink>> _sinks;
+	boost::optional<PerformanceReport> _report;
 
 	boost::signals2::scoped_connection _player_video_connection;
 	boost::signals2::scoped_connection _player_audio_connection;
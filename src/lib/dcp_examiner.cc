@@ -23,8 +23,11 @@
 #include "dcp_content.h"
 #include "dcp_examiner.h"
 #include "dcpomatic_log.h"
+#include "digester.h"
 #include "exceptions.h"
+#include "font.h"
 #include "image.h"
+#include "state.h"
 #include "util.h"
 #include <dcp/cpl.h>
 #include <dcp/dcp.h>
@@ -32,6 +35,7 @@
 #include <dcp/mono_picture_asset.h>
 #include <dcp/mono_picture_asset_reader.h>
 #include <dcp/mono_picture_frame.h>
+#include <dcp/raw_convert.h>
 #include <dcp/reel.h>
 #include <dcp/reel_atmos_asset.h>
 #include <dcp/reel_closed_caption_asset.h>
@@ -47,6 +51,13 @@
 #include <dcp/stereo_picture_asset_reader.h>
 #include <dcp/stereo_picture_frame.h>
 #include <dcp/subtitle_asset.h>
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+LIBDCP_ENABLE_WARNINGS
+#ifdef DCPOMATIC_POSIX
+#include <sys/stat.h>
+#endif
 #include <iostream>
 
 #include "i18n.h"
@@ -59,6 +70,7 @@ using std::shared_ptr;
 using std::string;
 using std::vector;
 using boost::optional;
+using dcp::raw_convert;
 
 
 DCPExaminer::DCPExaminer (shared_ptr<const DCPContent> content, bool tolerant)
@@ -340,3 +352,288 @@ DCPExaminer::DCPExaminer (shared_ptr<const DCPContent> content, bool tolerant)
 
 	_cpl = cpl->id ();
 }
+
+
+int const DCPExaminer::_cache_size = 256;
+
+
+DCPExaminer::DCPExaminer (cxml::ConstNodePtr node, boost::filesystem::path directory)
+	: _from_cache (true)
+{
+	_video_frame_rate = node->optional_number_child<double>("VideoFrameRate");
+	auto const width = node->optional_number_child<int>("VideoWidth");
+	auto const height = node->optional_number_child<int>("VideoHeight");
+	if (width && height) {
+		_video_size = dcp::Size(*width, *height);
+	}
+	_video_length = node->number_child<Frame>("VideoLength");
+	_audio_channels = node->optional_number_child<int>("AudioChannels");
+	_audio_frame_rate = node->optional_number_child<int>("AudioFrameRate");
+	_audio_length = node->number_child<Frame>("AudioLength");
+	_name = node->string_child("Name");
+	_has_video = node->bool_child("HasVideo");
+	_has_audio = node->bool_child("HasAudio");
+	if (auto lang = node->optional_string_child("AudioLanguage")) {
+		_audio_language = dcp::LanguageTag(*lang);
+	}
+	_text_count[TextType::OPEN_SUBTITLE] = node->number_child<int>("OpenSubtitleCount");
+	_text_count[TextType::CLOSED_CAPTION] = node->number_child<int>("ClosedCaptionCount");
+	if (auto lang = node->optional_string_child("OpenSubtitleLanguage")) {
+		_open_subtitle_language = dcp::LanguageTag(*lang);
+	}
+	for (auto i: node->node_children("DCPTextTrack")) {
+		_dcp_text_tracks.push_back(DCPTextTrack(i));
+	}
+	_encrypted = node->bool_child("Encrypted");
+	_kdm_valid = node->bool_child("KDMValid");
+	if (auto standard = node->optional_string_child("Standard")) {
+		_standard = *standard == "Interop" ? dcp::Standard::INTEROP : dcp::Standard::SMPTE;
+	}
+	_three_d = node->bool_child("ThreeD");
+	if (auto kind = node->optional_string_child("ContentKind")) {
+		_content_kind = dcp::ContentKind::from_name(*kind);
+	}
+	_cpl = node->string_child("CPL");
+	for (auto i: node->node_children("ReelLength")) {
+		_reel_lengths.push_back(raw_convert<int64_t>(i->content()));
+	}
+	for (auto i: node->node_children("Marker")) {
+		_markers[dcp::marker_from_string(i->string_attribute("type"))] = dcp::Time(
+			i->number_attribute<int>("h"),
+			i->number_attribute<int>("m"),
+			i->number_attribute<int>("s"),
+			i->number_attribute<int>("e"),
+			i->number_attribute<int>("tcr")
+			);
+	}
+	for (auto i: node->node_children("Rating")) {
+		_ratings.push_back(dcp::Rating(i));
+	}
+	for (auto i: node->node_children("ContentVersion")) {
+		_content_versions.push_back(i->content());
+	}
+	_has_atmos = node->bool_child("HasAtmos");
+	_atmos_length = node->number_child<Frame>("AtmosLength");
+	_atmos_edit_rate = dcp::Fraction(node->string_child("AtmosEditRate"));
+	for (auto i: node->node_children("Reel")) {
+		vector<shared_ptr<dcpomatic::Font>> reel_fonts;
+		for (auto j: i->node_children("Font")) {
+			auto const id = j->string_attribute("id");
+			if (auto data = j->optional_string_attribute("data")) {
+				reel_fonts.push_back(make_shared<dcpomatic::Font>(id, dcp::ArrayData(directory / "fonts" / *data)));
+			} else {
+				reel_fonts.push_back(make_shared<dcpomatic::Font>(id));
+			}
+		}
+		_fonts.push_back(reel_fonts);
+	}
+}
+
+
+/** Write this examination to XML.  Any font data is written to files in the fonts
+ *  subdirectory of @param directory, named after its digest, so that fonts shared by
+ *  many DCPs are only stored once.
+ */
+void
+DCPExaminer::as_xml (xmlpp::Element* node, boost::filesystem::path directory) const
+{
+	if (_video_frame_rate) {
+		node->add_child("VideoFrameRate")->add_child_text(raw_convert<string>(*_video_frame_rate));
+	}
+	if (_video_size) {
+		node->add_child("VideoWidth")->add_child_text(raw_convert<string>(_video_size->width));
+		node->add_child("VideoHeight")->add_child_text(raw_convert<string>(_video_size->height));
+	}
+	node->add_child("VideoLength")->add_child_text(raw_convert<string>(_video_length));
+	if (_audio_channels) {
+		node->add_child("AudioChannels")->add_child_text(raw_convert<string>(*_audio_channels));
+	}
+	if (_audio_frame_rate) {
+		node->add_child("AudioFrameRate")->add_child_text(raw_convert<string>(*_audio_frame_rate));
+	}
+	node->add_child("AudioLength")->add_child_text(raw_convert<string>(_audio_length));
+	node->add_child("Name")->add_child_text(_name);
+	node->add_child("HasVideo")->add_child_text(_has_video ? "1" : "0");
+	node->add_child("HasAudio")->add_child_text(_has_audio ? "1" : "0");
+	if (_audio_language) {
+		node->add_child("AudioLanguage")->add_child_text(_audio_language->to_string());
+	}
+	node->add_child("OpenSubtitleCount")->add_child_text(raw_convert<string>(_text_count[TextType::OPEN_SUBTITLE]));
+	node->add_child("ClosedCaptionCount")->add_child_text(raw_convert<string>(_text_count[TextType::CLOSED_CAPTION]));
+	if (_open_subtitle_language) {
+		node->add_child("OpenSubtitleLanguage")->add_child_text(_open_subtitle_language->to_string());
+	}
+	for (auto const& i: _dcp_text_tracks) {
+		i.as_xml(node->add_child("DCPTextTrack"));
+	}
+	node->add_child("Encrypted")->add_child_text(_encrypted ? "1" : "0");
+	node->add_child("KDMValid")->add_child_text(_kdm_valid ? "1" : "0");
+	if (_standard) {
+		node->add_child("Standard")->add_child_text(*_standard == dcp::Standard::INTEROP ? "Interop" : "SMPTE");
+	}
+	node->add_child("ThreeD")->add_child_text(_three_d ? "1" : "0");
+	if (_content_kind) {
+		node->add_child("ContentKind")->add_child_text(_content_kind->name());
+	}
+	node->add_child("CPL")->add_child_text(_cpl);
+	for (auto i: _reel_lengths) {
+		node->add_child("ReelLength")->add_child_text(raw_convert<string>(i));
+	}
+	for (auto const& i: _markers) {
+		auto marker = node->add_child("Marker");
+		marker->set_attribute("type", dcp::marker_to_string(i.first));
+		marker->set_attribute("h", raw_convert<string>(i.second.h));
+		marker->set_attribute("m", raw_convert<string>(i.second.m));
+		marker->set_attribute("s", raw_convert<string>(i.second.s));
+		marker->set_attribute("e", raw_convert<string>(i.second.e));
+		marker->set_attribute("tcr", raw_convert<string>(i.second.tcr));
+	}
+	for (auto const& i: _ratings) {
+		i.as_xml(node->add_child("Rating"));
+	}
+	for (auto const& i: _content_versions) {
+		node->add_child("ContentVersion")->add_child_text(i);
+	}
+	node->add_child("HasAtmos")->add_child_text(_has_atmos ? "1" : "0");
+	node->add_child("AtmosLength")->add_child_text(raw_convert<string>(_atmos_length));
+	node->add_child("AtmosEditRate")->add_child_text(_atmos_edit_rate.as_string());
+
+	boost::filesystem::create_directories(directory / "fonts");
+	for (auto const& reel: _fonts) {
+		auto reel_node = node->add_child("Reel");
+		for (auto const& font: reel) {
+			auto font_node = reel_node->add_child("Font");
+			font_node->set_attribute("id", font->id());
+			if (auto data = font->data()) {
+				Digester digester;
+				digester.add(data->data(), data->size());
+				auto const digest = digester.get();
+				auto const file = directory / "fonts" / digest;
+				if (!boost::filesystem::exists(file)) {
+					data->write(file);
+				}
+				font_node->set_attribute("data", digest);
+			}
+		}
+	}
+}
+
+
+/** @return A digest of everything which affects the result of examining some content: the
+ *  identity (path, size, modification time and, where we can get it, inode) of every file in
+ *  the DCP's directories, the CPL and KDM that were asked for and the decryption key.
+ *  Checking these is much quicker than reading the DCP's XML and the headers of its assets.
+ */
+string
+DCPExaminer::cache_key (shared_ptr<const DCPContent> content, bool tolerant)
+{
+	Digester digester;
+
+	digester.add(tolerant);
+	digester.add(content->cpl().get_value_or(""));
+	if (content->kdm()) {
+		digester.add(content->kdm()->as_xml());
+		digester.add(Config::instance()->decryption_chain()->key().get_value_or(""));
+	}
+
+	for (auto directory: content->directories()) {
+		vector<boost::filesystem::path> files;
+		for (auto const& i: boost::filesystem::recursive_directory_iterator(directory)) {
+			if (boost::filesystem::is_regular_file(i.path())) {
+				files.push_back(i.path());
+			}
+		}
+		std::sort(files.begin(), files.end());
+
+		for (auto const& file: files) {
+			digester.add(file.string());
+			digester.add(static_cast<int64_t>(boost::filesystem::file_size(file)));
+			digester.add(static_cast<int64_t>(boost::filesystem::last_write_time(file)));
+#ifdef DCPOMATIC_POSIX
+			struct stat st;
+			if (stat(file.string().c_str(), &st) == 0) {
+				digester.add(static_cast<uint64_t>(st.st_ino));
+			}
+#endif
+		}
+	}
+
+	return digester.get();
+}
+
+
+boost::filesystem::path
+DCPExaminer::cache_directory ()
+{
+	return State::write_path("dcp_examinations");
+}
+
+
+shared_ptr<DCPExaminer>
+DCPExaminer::cached_or_new (shared_ptr<const DCPContent> content, bool tolerant)
+{
+	optional<string> key;
+	try {
+		key = cache_key(content, tolerant);
+		auto const file = cache_directory() / (*key + ".xml");
+		if (boost::filesystem::exists(file)) {
+			auto doc = make_shared<cxml::Document>("DCPExamination");
+			doc->read_file(file);
+			auto examiner = shared_ptr<DCPExaminer>(new DCPExaminer(doc, cache_directory()));
+			/* Note that this examination has been used recently, so that it is not the next to be removed */
+			boost::system::error_code ec;
+			boost::filesystem::last_write_time(file, time(nullptr), ec);
+			LOG_GENERAL("Using cached examination %1", *key);
+			return examiner;
+		}
+	} catch (std::exception& e) {
+		LOG_GENERAL("Could not use cached DCP examination (%1)", e.what());
+	}
+
+	auto examiner = make_shared<DCPExaminer>(content, tolerant);
+	if (key && !examiner->needs_assets()) {
+		try {
+			add_to_cache(*key, *examiner);
+		} catch (std::exception& e) {
+			LOG_GENERAL("Could not cache DCP examination (%1)", e.what());
+		}
+	}
+
+	return examiner;
+}
+
+
+void
+DCPExaminer::add_to_cache (string key, DCPExaminer const& examiner)
+{
+	auto const directory = cache_directory();
+	boost::filesystem::create_directories(directory);
+
+	xmlpp::Document doc;
+	auto root = doc.create_root_node("DCPExamination");
+	examiner.as_xml(root, directory);
+
+	/* Write to a temporary file and then rename it so that anybody else looking in the cache
+	 * never sees a half-written examination.
+	 */
+	auto const tmp = directory / (key + ".xml.tmp");
+	doc.write_to_file_formatted(tmp.string());
+	boost::filesystem::rename(tmp, directory / (key + ".xml"));
+
+	vector<boost::filesystem::path> entries;
+	for (auto const& i: boost::filesystem::directory_iterator(directory)) {
+		if (i.path().extension() == ".xml") {
+			entries.push_back(i.path());
+		}
+	}
+
+	if (static_cast<int>(entries.size()) > _cache_size) {
+		std::sort(entries.begin(), entries.end(), [](boost::filesystem::path const& a, boost::filesystem::path const& b) {
+			return boost::filesystem::last_write_time(a) > boost::filesystem::last_write_time(b);
+		});
+		boost::system::error_code ec;
+		for (auto i = entries.begin() + _cache_size; i != entries.end(); ++i) {
+			boost::filesystem::remove(*i, ec);
+		}
+	}
+}
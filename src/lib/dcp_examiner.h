@@ -30,6 +30,7 @@
 #include "video_examiner.h"
 #include <dcp/dcp_time.h>
 #include <dcp/rating.h>
+#include <libcxml/cxml.h>
 
 
 class DCPContent;
@@ -40,6 +41,12 @@ class DCPExaminer : public VideoExaminer, public AudioExaminer
 public:
 	explicit DCPExaminer (std::shared_ptr<const DCPContent>, bool tolerant);
 
+	/** @return An examiner for some content, taken from the on-disk cache if the files
+	 *  of the DCP look the same as they did when it was last examined, or made by
+	 *  examining the DCP (and then added to the cache) if not.
+	 */
+	static std::shared_ptr<DCPExaminer> cached_or_new (std::shared_ptr<const DCPContent> content, bool tolerant);
+
 	bool has_video () const override {
 		return _has_video;
 	}
@@ -172,7 +179,20 @@ public:
 		return _fonts;
 	}
 
+	/** @return true if this examination came from the on-disk cache */
+	bool from_cache () const {
+		return _from_cache;
+	}
+
 private:
+	DCPExaminer (cxml::ConstNodePtr node, boost::filesystem::path directory);
+
+	void as_xml (xmlpp::Element* node, boost::filesystem::path directory) const;
+
+	static std::string cache_key (std::shared_ptr<const DCPContent> content, bool tolerant);
+	static boost::filesystem::path cache_directory ();
+	static void add_to_cache (std::string key, DCPExaminer const& examiner);
+
 	boost::optional<double> _video_frame_rate;
 	boost::optional<dcp::Size> _video_size;
 	Frame _video_length = 0;
@@ -205,4 +225,8 @@ private:
 	Frame _atmos_length = 0;
 	dcp::Fraction _atmos_edit_rate;
 	std::vector<std::vector<std::shared_ptr<dcpomatic::Font>>> _fonts;
+	bool _from_cache = false;
+
+	/** maximum number of examinations to keep in the cache */
+	static int const _cache_size;
 };
@@ -0,0 +1,261 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "atmos_metadata.h"
+#include "audio_buffers.h"
+#include "audio_content.h"
+#include "dcp_content.h"
+#include "dcp_rewrap_encoder.h"
+#include "dcpomatic_assert.h"
+#include "exceptions.h"
+#include "film.h"
+#include "job.h"
+#include "text_content.h"
+#include "util.h"
+#include "video_content.h"
+#include <dcp/atmos_asset.h>
+#include <dcp/atmos_asset_reader.h>
+#include <dcp/cpl.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/reel.h>
+#include <dcp/reel_atmos_asset.h>
+#include <dcp/reel_picture_asset.h>
+#include <dcp/reel_sound_asset.h>
+#include <dcp/search.h>
+#include <dcp/sound_asset.h>
+#include <dcp/sound_asset_reader.h>
+#include <dcp/sound_frame.h>
+#include <dcp/stereo_picture_asset.h>
+#include <dcp/stereo_picture_asset_reader.h>
+#include <dcp/stereo_picture_frame.h>
+#include <climits>
+
+#include "i18n.h"
+
+
+using std::dynamic_pointer_cast;
+using std::make_shared;
+using std::shared_ptr;
+using std::weak_ptr;
+using namespace dcpomatic;
+
+
+DCPRewrapEncoder::DCPRewrapEncoder (shared_ptr<const Film> film, weak_ptr<Job> job)
+	: Encoder (film, job)
+	, _content (dynamic_pointer_cast<const DCPContent>(film->content().front()))
+	, _writer (film, job)
+	, _frames_done (0)
+	, _finishing (false)
+{
+	DCPOMATIC_ASSERT (_content);
+}
+
+
+/** @return true if the film is made of one DCP which would come out of the Player with every picture,
+ *  sound and Atmos frame unchanged, and without any text.
+ */
+bool
+DCPRewrapEncoder::possible (shared_ptr<const Film> film)
+{
+	auto const content = film->content();
+	if (content.size() != 1) {
+		return false;
+	}
+
+	auto dcp = dynamic_pointer_cast<const DCPContent>(content.front());
+	if (!dcp || !dcp->can_be_played() || !dcp->video || !dcp->video->use() || !dcp->audio || film->reencode_j2k()) {
+		return false;
+	}
+
+	if (dcp->reference_video() || dcp->reference_audio()) {
+		return false;
+	}
+
+	for (auto text: dcp->text) {
+		if (text->use()) {
+			return false;
+		}
+	}
+
+	/* Timing */
+	if (dcp->position() != DCPTime() || dcp->trim_start() != ContentTime() || dcp->trim_end() != ContentTime() || dcp->end(film) != film->length()) {
+		return false;
+	}
+
+	if (!dcp->video_frame_rate() || dcp->active_video_frame_rate(film) != film->video_frame_rate() || *dcp->video_frame_rate() != film->video_frame_rate()) {
+		return false;
+	}
+
+	/* Picture */
+	auto const video = dcp->video;
+	if (video->size() != film->frame_size() || video->scaled_size(film->frame_size()) != film->frame_size()) {
+		return false;
+	}
+
+	if (video->actual_crop() != Crop() || video->colour_conversion() || video->fade_in() || video->fade_out()) {
+		return false;
+	}
+
+	if ((video->frame_type() == VideoFrameType::THREE_D) != film->three_d()) {
+		return false;
+	}
+
+	/* Sound */
+	auto const audio = dcp->audio;
+	if (audio->gain() != 0 || audio->delay() != 0 || audio->fade_in() != ContentTime() || audio->fade_out() != ContentTime() || film->audio_processor()) {
+		return false;
+	}
+
+	if (audio->streams().size() != 1 || audio->stream()->frame_rate() != film->audio_frame_rate()) {
+		return false;
+	}
+
+	auto const mapping = audio->mapping();
+	if (mapping.input_channels() > film->audio_channels() || mapping.output_channels() < film->audio_channels()) {
+		return false;
+	}
+
+	for (int i = 0; i < mapping.input_channels(); ++i) {
+		for (int j = 0; j < film->audio_channels(); ++j) {
+			if (mapping.get(i, j) != (i == j ? 1 : 0)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+void
+DCPRewrapEncoder::go ()
+{
+	auto cpls = dcp::find_and_resolve_cpls (_content->directories(), false);
+	if (cpls.empty()) {
+		throw DCPError (_("No CPLs found in DCP."));
+	}
+
+	auto cpl = cpls.front();
+	for (auto i: cpls) {
+		if (_content->cpl() && i->id() == _content->cpl().get()) {
+			cpl = i;
+		}
+	}
+
+	if (_content->kdm()) {
+		cpl->add (decrypt_kdm_with_helpful_error(_content->kdm().get()));
+	}
+
+	_writer.start ();
+
+	auto job = _job.lock ();
+	DCPOMATIC_ASSERT (job);
+	job->sub (_("Copying"));
+
+	auto const video_frame_rate = _film->video_frame_rate();
+	auto const total = _film->length().frames_round(video_frame_rate);
+	auto const channels = _content->audio->stream()->channels();
+	auto const film_channels = _film->audio_channels();
+
+	Frame position = 0;
+
+	for (auto reel: cpl->reels()) {
+		auto picture = reel->main_picture();
+		DCPOMATIC_ASSERT (picture);
+
+		shared_ptr<dcp::MonoPictureAssetReader> mono_reader;
+		shared_ptr<dcp::StereoPictureAssetReader> stereo_reader;
+		if (auto mono = dynamic_pointer_cast<dcp::MonoPictureAsset>(picture->asset())) {
+			mono_reader = mono->start_read ();
+			mono_reader->set_check_hmac (false);
+		} else {
+			auto stereo = dynamic_pointer_cast<dcp::StereoPictureAsset>(picture->asset());
+			DCPOMATIC_ASSERT (stereo);
+			stereo_reader = stereo->start_read ();
+			stereo_reader->set_check_hmac (false);
+		}
+
+		shared_ptr<dcp::SoundAssetReader> sound_reader;
+		if (reel->main_sound()) {
+			sound_reader = reel->main_sound()->asset()->start_read ();
+			sound_reader->set_check_hmac (false);
+		}
+
+		shared_ptr<dcp::AtmosAssetReader> atmos_reader;
+		boost::optional<AtmosMetadata> atmos_metadata;
+		if (reel->atmos()) {
+			auto asset = reel->atmos()->asset();
+			atmos_reader = asset->start_read ();
+			atmos_reader->set_check_hmac (false);
+			atmos_metadata = AtmosMetadata (asset);
+		}
+
+		auto const picture_entry_point = picture->entry_point().get_value_or(0);
+
+		for (int64_t frame = 0; frame < picture->duration(); ++frame) {
+			auto const time = DCPTime::from_frames (position, video_frame_rate);
+
+			if (mono_reader) {
+				_writer.write (mono_reader->get_frame(picture_entry_point + frame), position, Eyes::BOTH);
+			} else {
+				auto stereo_frame = stereo_reader->get_frame (picture_entry_point + frame);
+				_writer.write (stereo_frame->left(), position, Eyes::LEFT);
+				_writer.write (stereo_frame->right(), position, Eyes::RIGHT);
+			}
+
+			/* Convert the sound in the same way that DCPDecoder does, so that we write exactly what
+			 * would have been written if the same frames had come through the Player.
+			 */
+			shared_ptr<AudioBuffers> sound;
+			if (sound_reader) {
+				auto sound_frame = sound_reader->get_frame (reel->main_sound()->entry_point().get_value_or(0) + frame);
+				auto from = sound_frame->data ();
+				int const frames = sound_frame->size() / (3 * channels);
+				sound = make_shared<AudioBuffers>(film_channels, frames);
+				sound->make_silent ();
+				auto to = sound->data();
+				for (int i = 0; i < frames; ++i) {
+					for (int j = 0; j < channels; ++j) {
+						to[j][i] = static_cast<int> ((from[0] << 8) | (from[1] << 16) | (from[2] << 24)) / static_cast<float> (INT_MAX - 256);
+						from += 3;
+					}
+				}
+			} else {
+				sound = make_shared<AudioBuffers>(film_channels, DCPTime::from_frames(1, video_frame_rate).frames_round(_film->audio_frame_rate()));
+				sound->make_silent ();
+			}
+			_writer.write (sound, time);
+
+			if (atmos_reader) {
+				_writer.write (atmos_reader->get_frame(reel->atmos()->entry_point().get_value_or(0) + frame), time, *atmos_metadata);
+			}
+
+			++position;
+			_frames_done = position;
+			job->set_progress (float(position) / total);
+		}
+	}
+
+	_finishing = true;
+	_writer.finish (_film->dir(_film->dcp_name()));
+}
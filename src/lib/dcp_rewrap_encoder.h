@@ -0,0 +1,66 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_DCP_REWRAP_ENCODER_H
+#define DCPOMATIC_DCP_REWRAP_ENCODER_H
+
+
+#include "encoder.h"
+#include "writer.h"
+#include <atomic>
+
+
+class DCPContent;
+
+
+/** @class DCPRewrapEncoder
+ *  @brief An encoder which makes a DCP from a single existing DCP by copying its picture, sound and
+ *  Atmos frames straight from the MXFs to the writer.
+ *
+ *  This is much quicker than going through the Player when all that is different is the reel breaks,
+ *  the encryption or the metadata.  It can only be used when possible() says so.
+ */
+class DCPRewrapEncoder : public Encoder
+{
+public:
+	DCPRewrapEncoder (std::shared_ptr<const Film> film, std::weak_ptr<Job> job);
+
+	void go () override;
+
+	Frame frames_done () const override {
+		return _frames_done;
+	}
+
+	bool finishing () const override {
+		return _finishing;
+	}
+
+	static bool possible (std::shared_ptr<const Film> film);
+
+private:
+	std::shared_ptr<const DCPContent> _content;
+	Writer _writer;
+	std::atomic<Frame> _frames_done;
+	std::atomic<bool> _finishing;
+};
+
+
+#endif
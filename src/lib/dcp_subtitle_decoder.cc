@@ -22,6 +22,7 @@
 #include "dcp_subtitle_content.h"
 #include "dcp_subtitle_decoder.h"
 #include "font.h"
+#include "parsed_file_cache.h"
 #include "text_content.h"
 #include <dcp/interop_subtitle_asset.h>
 #include <dcp/load_font_node.h>
@@ -40,17 +41,19 @@ using namespace dcpomatic;
 DCPSubtitleDecoder::DCPSubtitleDecoder (shared_ptr<const Film> film, shared_ptr<const DCPSubtitleContent> content)
 	: Decoder (film)
 {
-	/* Load the XML or MXF file */
-	auto const asset = load (content->path(0));
-	asset->fix_empty_font_ids ();
-	_subtitles = asset->subtitles ();
-	_next = _subtitles.begin ();
-
-	if (dynamic_pointer_cast<dcp::InteropSubtitleAsset>(asset)) {
-		_standard = dcp::Standard::INTEROP;
-	} else {
-		_standard = dcp::Standard::SMPTE;
-	}
+	static ParsedFileCache<Parsed> cache;
+
+	auto const path = content->path(0);
+	_parsed = cache.get(parsed_file_key(path, content->digest()), [this, path]() {
+		/* Load the XML or MXF file */
+		auto const asset = load (path);
+		asset->fix_empty_font_ids ();
+		auto parsed = make_shared<Parsed>();
+		parsed->subtitles = asset->subtitles ();
+		parsed->standard = dynamic_pointer_cast<dcp::InteropSubtitleAsset>(asset) ? dcp::Standard::INTEROP : dcp::Standard::SMPTE;
+		return shared_ptr<const Parsed>(parsed);
+	});
+	_next = _parsed->subtitles.begin ();
 
 	text.push_back (make_shared<TextDecoder>(this, content->only_text()));
 	update_position();
@@ -62,9 +65,9 @@ DCPSubtitleDecoder::seek (ContentTime time, bool accurate)
 {
 	Decoder::seek (time, accurate);
 
-	_next = _subtitles.begin ();
-	auto i = _subtitles.begin ();
-	while (i != _subtitles.end() && ContentTime::from_seconds ((*_next)->in().as_seconds()) < time) {
+	_next = _parsed->subtitles.begin ();
+	auto i = _parsed->subtitles.begin ();
+	while (i != _parsed->subtitles.end() && ContentTime::from_seconds ((*_next)->in().as_seconds()) < time) {
 		++i;
 	}
 
@@ -75,7 +78,7 @@ DCPSubtitleDecoder::seek (ContentTime time, bool accurate)
 bool
 DCPSubtitleDecoder::pass ()
 {
-	if (_next == _subtitles.end ()) {
+	if (_next == _parsed->subtitles.end ()) {
 		return true;
 	}
 
@@ -90,7 +93,7 @@ DCPSubtitleDecoder::pass ()
 	vector<dcp::SubtitleImage> i;
 	auto const p = content_time_period (*_next);
 
-	while (_next != _subtitles.end () && content_time_period (*_next) == p) {
+	while (_next != _parsed->subtitles.end () && content_time_period (*_next) == p) {
 		auto ns = dynamic_pointer_cast<const dcp::SubtitleString>(*_next);
 		if (ns) {
 			s.push_back (*ns);
@@ -108,7 +111,7 @@ DCPSubtitleDecoder::pass ()
 		}
 	}
 
-	only_text()->emit_plain(p, s, _standard);
+	only_text()->emit_plain(p, s, _parsed->standard);
 
 	update_position();
 
@@ -130,18 +133,18 @@ DCPSubtitleDecoder::content_time_period (shared_ptr<const dcp::Subtitle> s) cons
 optional<ContentTime>
 DCPSubtitleDecoder::first () const
 {
-	if (_subtitles.empty()) {
+	if (_parsed->subtitles.empty()) {
 		return {};
 	}
 
-	return ContentTime::from_seconds(_subtitles[0]->in().as_seconds());
+	return ContentTime::from_seconds(_parsed->subtitles[0]->in().as_seconds());
 }
 
 
 void
 DCPSubtitleDecoder::update_position()
 {
-	if (_next != _subtitles.end()) {
+	if (_next != _parsed->subtitles.end()) {
 		only_text()->maybe_set_position(
 			ContentTime::from_seconds((*_next)->in().as_seconds())
 			);
@@ -40,8 +40,13 @@ private:
 	dcpomatic::ContentTimePeriod content_time_period (std::shared_ptr<const dcp::Subtitle> s) const;
 	void update_position();
 
-	std::vector<std::shared_ptr<const dcp::Subtitle>> _subtitles;
+	/** What we read from our file, which may be shared with other decoders of the same file */
+	struct Parsed
+	{
+		std::vector<std::shared_ptr<const dcp::Subtitle>> subtitles;
+		dcp::Standard standard;
+	};
+
+	std::shared_ptr<const Parsed> _parsed;
 	std::vector<std::shared_ptr<const dcp::Subtitle>>::const_iterator _next;
-
-	dcp::Standard _standard;
 };
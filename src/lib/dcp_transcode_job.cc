@@ -19,19 +19,15 @@
 */
 
 
-#include "config.h"
 #include "dcp_content.h"
 #include "dcp_digest_file.h"
 #include "dcp_transcode_job.h"
 #include "film.h"
-#include "job_manager.h"
-#include "upload_job.h"
 #include <dcp/cpl.h>
 #include <dcp/search.h>
 
 
 using std::dynamic_pointer_cast;
-using std::make_shared;
 using std::shared_ptr;
 using std::vector;
 
@@ -46,9 +42,7 @@ DCPTranscodeJob::DCPTranscodeJob (shared_ptr<const Film> film, ChangedBehaviour
 void
 DCPTranscodeJob::post_transcode ()
 {
-	if (Config::instance()->upload_after_make_dcp()) {
-		JobManager::instance()->add(make_shared<UploadJob>(_film));
-	}
+	/* If Config::upload_after_make_dcp() is set the Writer has already uploaded the DCP */
 
 	/* The first directory is the project's DCP, so the first CPL will also be from the project
 	 * (not from one of the DCPs imported into the project).
@@ -30,23 +30,27 @@
  */
 
 
+#include "binary_descriptor.h"
 #include "compose.hpp"
 #include "config.h"
 #include "cross.h"
 #include "dcp_video.h"
 #include "dcpomatic_log.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
+#include "encode_server_connection.h"
 #include "encode_server_description.h"
 #include "exceptions.h"
 #include "image.h"
+#include "j2k_encode_backend.h"
 #include "log.h"
 #include "player_video.h"
+#include "rgb_to_xyz.h"
 #include "rng.h"
+#include "trace.h"
 #include <libcxml/cxml.h>
 #include <dcp/raw_convert.h>
 #include <dcp/openjpeg_image.h>
-#include <dcp/rgb_xyz.h>
-#include <dcp/j2k_transcode.h>
 #include <dcp/warnings.h>
 LIBDCP_DISABLE_WARNINGS
 #include <libxml++/libxml++.h>
@@ -54,8 +58,13 @@ LIBDCP_ENABLE_WARNINGS
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <stdint.h>
+#include <array>
+#include <atomic>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
 
 #include "i18n.h"
 
@@ -100,34 +109,168 @@ DCPVideo::DCPVideo (shared_ptr<const PlayerVideo> frame, shared_ptr<const cxml::
 	_resolution = Resolution (node->optional_number_child<int>("Resolution").get_value_or(static_cast<int>(Resolution::TWO_K)));
 }
 
+/** Construct a DCP video frame from a binary descriptor written by write_request(),
+ *  reading any image data from @p socket.  The descriptor should have been read as
+ *  far as the frame index.
+ */
+DCPVideo::DCPVideo (BinaryDescriptorReader& reader, shared_ptr<Socket> socket)
+{
+	_index = reader.read_int32 ();
+	_frames_per_second = reader.read_int32 ();
+	_j2k_bandwidth = reader.read_int32 ();
+	_resolution = static_cast<Resolution>(reader.read_int32());
+	_frame = make_shared<PlayerVideo>(reader, socket);
+}
+
 shared_ptr<dcp::OpenJPEGImage>
 DCPVideo::convert_to_xyz (shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note)
 {
+	TraceSpan span("convert_to_xyz");
+
 	shared_ptr<dcp::OpenJPEGImage> xyz;
 
-	auto image = frame->image (bind(&PlayerVideo::keep_xyz_or_rgb, _1), VideoRange::FULL, false);
 	if (frame->colour_conversion()) {
-		xyz = dcp::rgb_to_xyz (
-			image->data()[0],
-			image->size(),
-			image->stride()[0],
-			frame->colour_conversion().get(),
-			note
-			);
+		/* Convert each band of rows as soon as the player has made it, while it is still in cache,
+		 * and without keeping a whole RGB copy of the frame in the PlayerVideo.
+		 */
+		auto converter = RGBToXYZ::get(frame->colour_conversion().get());
+		xyz = make_shared<dcp::OpenJPEGImage>(frame->out_size());
+		int clamped = 0;
+		frame->render (
+			bind(&PlayerVideo::keep_xyz_or_rgb, _1),
+			VideoRange::FULL,
+			false,
+			[xyz, &clamped, converter](Image const& image, int first_row, int rows) {
+				clamped += converter->convert_rows (image.data()[0], image.stride()[0], first_row, rows, *xyz);
+			});
+
+		if (clamped) {
+			note (dcp::NoteType::NOTE, String::compose("%1 XYZ value(s) clamped", clamped));
+		}
 	} else {
+		auto image = frame->image (bind(&PlayerVideo::keep_xyz_or_rgb, _1), VideoRange::FULL, false);
 		xyz = make_shared<dcp::OpenJPEGImage>(image->data()[0], image->size(), image->stride()[0]);
 	}
 
 	return xyz;
 }
 
-/** J2K-encode this frame on the local host.
+/** Number of different noise levels that encode_locally() can try */
+static int const noise_steps = 29;
+
+
+/** Add some noise to an XYZ image in-place; the noise for a given step is always the same.
+ *  @param step Noise step, from 0 (least noise) to noise_steps - 1 (most noise).
+ */
+static void
+add_noise (shared_ptr<dcp::OpenJPEGImage> xyz, int step)
+{
+	DCPOMATIC_ASSERT (step >= 0 && step < noise_steps);
+
+	/* Steps 0 to 15 add noise of 2 to every 16th, 15th, ... pixel, then we add
+	   more and more noise to every pixel.
+	*/
+	int const pixel_skip = std::max(1, 16 - step);
+	int const noise_amount = std::max(2, step - 13);
+
+	auto const size = xyz->size ();
+	auto const pixels = size.width * size.height;
+
+	dcpomatic::RNG rng(42);
+	for (auto c = 0; c < 3; ++c) {
+		auto p = xyz->data(c);
+		auto const e = p + pixels;
+		while (p < e) {
+			*p = std::min(4095, std::max(0, *p + (rng.get() % noise_amount)));
+			p += pixel_skip;
+		}
+	}
+}
+
+
+/** @return The value of each component of an XYZ image if every pixel is the same, otherwise
+ *  an empty optional.
+ */
+static boost::optional<std::array<int32_t, 3>>
+constant_value (shared_ptr<const dcp::OpenJPEGImage> xyz)
+{
+	auto const size = xyz->size ();
+	if (size.width == 0 || size.height == 0) {
+		return {};
+	}
+
+	std::array<int32_t, 3> value;
+	for (auto c = 0; c < 3; ++c) {
+		auto const p = xyz->data(c);
+		value[c] = p[0];
+		for (auto y = 0; y < size.height; ++y) {
+			/* Count rather than break out early within each line so that the compiler can vectorise this */
+			auto const line = p + y * size.width;
+			int different = 0;
+			for (auto x = 0; x < size.width; ++x) {
+				different += line[x] != value[c];
+			}
+			if (different) {
+				return {};
+			}
+		}
+	}
+
+	return value;
+}
+
+
+/** Everything that decides the size of a J2K-encoded frame whose pixels all have the same value */
+struct ConstantFrame
+{
+	dcp::Size size;
+	std::array<int32_t, 3> value;
+	int bandwidth;
+	int frames_per_second;
+	bool three_d;
+	bool four_k;
+	string comment;
+	string backend;
+
+	bool operator< (ConstantFrame const& other) const {
+		return std::tie(size.width, size.height, value, bandwidth, frames_per_second, three_d, four_k, comment, backend) <
+			std::tie(other.size.width, other.size.height, other.value, other.bandwidth, other.frames_per_second, other.three_d, other.four_k, other.comment, other.backend);
+	}
+};
+
+
+/** Noise step that was needed to make a large-enough J2K frame from some constant frames.
+ *  Frames like this (e.g. black) tend to come in long runs, so remembering the answer saves
+ *  us from searching for it every time.
+ */
+static std::map<ConstantFrame, int> constant_frame_noise_steps;
+static boost::mutex constant_frame_noise_steps_mutex;
+
+/** true if the last frame encoded by encode_locally() needed some noise */
+static std::atomic<bool> last_frame_needed_noise (false);
+
+
+/** J2K-encode this frame on the local host using OpenJPEG.
  *  @return Encoded data.
  */
 ArrayData
 DCPVideo::encode_locally () const
+{
+	OpenJPEGEncodeBackend backend;
+	return encode_locally (backend);
+}
+
+
+/** J2K-encode this frame on the local host.
+ *  @param backend Backend to use for the JPEG2000 compression.
+ *  @return Encoded data.
+ */
+ArrayData
+DCPVideo::encode_locally (J2KEncodeBackend& backend) const
 {
 	auto const comment = Config::instance()->dcp_j2k_comment();
+	bool const three_d = _frame->eyes() == Eyes::LEFT || _frame->eyes() == Eyes::RIGHT;
+	bool const four_k = _resolution == Resolution::FOUR_K;
 
 	ArrayData enc = {};
 	/* This was empirically derived by a user: see #1902 */
@@ -135,50 +278,89 @@ DCPVideo::encode_locally () const
 	LOG_DEBUG_ENCODE("Using minimum frame size %1", minimum_size);
 
 	auto xyz = convert_to_xyz (_frame, boost::bind(&Log::dcp_log, dcpomatic_log.get(), _1, _2));
-	int noise_amount = 2;
-	int pixel_skip = 16;
+
+	/* We may need to add noise and try again if the encoded frame is too small.  The backend
+	   may corrupt its xyz parameter, so we need a way to get the same XYZ image back for each try.
+	   If the image is all one value that's easy; otherwise keep a copy if the last frame we saw
+	   needed noise (as this one probably will too), or failing that, just convert it again.
+	*/
+	auto const constant = constant_value (xyz);
+	boost::optional<ConstantFrame> constant_frame;
+	if (constant) {
+		constant_frame = ConstantFrame{xyz->size(), *constant, _j2k_bandwidth, _frames_per_second, three_d, four_k, comment, backend.name()};
+	}
+
+	std::vector<int32_t> copy;
+	if (!constant && last_frame_needed_noise) {
+		auto const pixels = xyz->size().width * xyz->size().height;
+		copy.resize (pixels * 3);
+		for (auto c = 0; c < 3; ++c) {
+			std::copy (xyz->data(c), xyz->data(c) + pixels, copy.begin() + c * pixels);
+		}
+	}
+
+	/* -1 means no noise */
+	int step = -1;
+	if (constant_frame) {
+		boost::mutex::scoped_lock lm (constant_frame_noise_steps_mutex);
+		auto known = constant_frame_noise_steps.find(*constant_frame);
+		if (known != constant_frame_noise_steps.end()) {
+			step = known->second;
+			add_noise (xyz, step);
+		}
+	}
+
 	while (true) {
-		enc = dcp::compress_j2k (
-			xyz,
-			_j2k_bandwidth,
-			_frames_per_second,
-			_frame->eyes() == Eyes::LEFT || _frame->eyes() == Eyes::RIGHT,
-			_resolution == Resolution::FOUR_K,
-			comment.empty() ? "libdcp" : comment
-		);
+		{
+			TraceSpan span("compress_j2k", _index);
+			enc = backend.encode (
+				xyz,
+				_j2k_bandwidth,
+				_frames_per_second,
+				three_d,
+				four_k,
+				comment.empty() ? "libdcp" : comment
+			);
+		}
 
 		if (enc.size() >= minimum_size) {
 			LOG_DEBUG_ENCODE(N_("Frame %1 encoded size was OK (%2)"), _index, enc.size());
 			break;
 		}
 
-		LOG_GENERAL (N_("Frame %1 encoded size was small (%2); adding noise at level %3 with pixel skip %4"), _index, enc.size(), noise_amount, pixel_skip);
+		++step;
+		/* Something's gone badly wrong if this much noise doesn't help */
+		DCPOMATIC_ASSERT (step < noise_steps);
+
+		LOG_GENERAL (N_("Frame %1 encoded size was small (%2); adding noise at step %3"), _index, enc.size(), step);
 
 		/* The JPEG2000 is too low-bitrate for some decoders <cough>DSS200</cough> so add some noise
-		 * and try again.  This is slow but hopefully won't happen too often.  We have to do
-		 * convert_to_xyz() again because compress_j2k() corrupts its xyz parameter.
+		 * and try again.  This is slow but hopefully won't happen too often.
 		 */
-
-		xyz = convert_to_xyz (_frame, boost::bind(&Log::dcp_log, dcpomatic_log.get(), _1, _2));
-		auto size = xyz->size ();
-		auto pixels = size.width * size.height;
-		dcpomatic::RNG rng(42);
-		for (auto c = 0; c < 3; ++c) {
-			auto p = xyz->data(c);
-			auto e = xyz->data(c) + pixels;
-			while (p < e) {
-				*p = std::min(4095, std::max(0, *p + (rng.get() % noise_amount)));
-				p += pixel_skip;
+		auto const pixels = xyz->size().width * xyz->size().height;
+		if (constant) {
+			for (auto c = 0; c < 3; ++c) {
+				std::fill (xyz->data(c), xyz->data(c) + pixels, (*constant)[c]);
+			}
+		} else if (!copy.empty()) {
+			for (auto c = 0; c < 3; ++c) {
+				std::copy (copy.begin() + c * pixels, copy.begin() + (c + 1) * pixels, xyz->data(c));
 			}
-		}
-
-		if (pixel_skip > 1) {
-			--pixel_skip;
 		} else {
-			++noise_amount;
+			xyz = convert_to_xyz (_frame, boost::bind(&Log::dcp_log, dcpomatic_log.get(), _1, _2));
 		}
-		/* Something's gone badly wrong if this much noise doesn't help */
-		DCPOMATIC_ASSERT (noise_amount < 16);
+
+		add_noise (xyz, step);
+	}
+
+	last_frame_needed_noise = step >= 0;
+
+	if (constant_frame && step >= 0) {
+		/* We tried each step in turn (or started from the one we looked up) so this is the least
+		   noise that works for this frame.
+		*/
+		boost::mutex::scoped_lock lm (constant_frame_noise_steps_mutex);
+		constant_frame_noise_steps[*constant_frame] = step;
 	}
 
 	switch (_frame->eyes()) {
@@ -199,60 +381,89 @@ DCPVideo::encode_locally () const
 }
 
 /** Send this frame to a remote server for J2K encoding, then read the result.
+ *  This makes a new connection to the server just for this frame; EncodeServerConnection
+ *  should be used for anything more than the odd frame.
  *  @param serv Server to send to.
  *  @param timeout timeout in seconds.
+ *  @param format Format to use to describe the frame to the server.
  *  @return Encoded data.
  */
 ArrayData
-DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout) const
+DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout, EncodeRequestFormat format) const
 {
-	boost::asio::io_service io_service;
-	boost::asio::ip::tcp::resolver resolver (io_service);
-	boost::asio::ip::tcp::resolver::query query (serv.host_name(), raw_convert<string> (ENCODE_FRAME_PORT));
-	boost::asio::ip::tcp::resolver::iterator endpoint_iterator = resolver.resolve (query);
+	EncodeServerConnection connection (serv, timeout);
+	{
+		TraceSpan span("remote_send", _index);
+		connection.send (*this, format);
+	}
+
+	auto reply = [&connection, this]() {
+		TraceSpan span("remote_receive", _index);
+		return connection.receive();
+	}();
+	if (reply.index != _index || reply.eyes != eyes()) {
+		throw NetworkError ("Server returned the wrong frame");
+	}
+	if (reply.status == EncodeServerConnection::Status::BUSY) {
+		throw NetworkError ("Server is too busy to encode frame");
+	} else if (!reply.encoded) {
+		throw NetworkError ("Server could not encode frame");
+	}
 
-	auto socket = make_shared<Socket>(timeout);
-	socket->set_send_buffer_size (512 * 1024);
+	LOG_DEBUG_ENCODE (N_("Finished remotely-encoded frame %1"), _index);
 
-	socket->connect (*endpoint_iterator);
+	return *reply.encoded;
+}
 
-	/* Collect all XML metadata */
-	xmlpp::Document doc;
-	auto root = doc.create_root_node ("EncodingRequest");
-	root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
-	add_metadata (root);
 
-	LOG_DEBUG_ENCODE (N_("Sending frame %1 to remote"), _index);
+/** @return A request for a server to encode this frame.  EncodeServerConnection sends
+ *  this with its length in front, so that the server can receive it without having
+ *  to parse it as it goes.
+ */
+std::vector<uint8_t>
+DCPVideo::request (EncodeRequestFormat format) const
+{
+	std::vector<uint8_t> request;
+	auto body = make_shared<Socket>();
+	body->set_write_buffer (&request);
 
+	switch (format) {
+	case EncodeRequestFormat::XML:
 	{
-		Socket::WriteDigestScope ds (socket);
+		xmlpp::Document doc;
+		auto root = doc.create_root_node ("EncodingRequest");
+		root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
+		root->add_child("Priority")->add_child_text(raw_convert<string>(Config::instance()->encoding_priority()));
+		add_metadata (root);
 
-		/* Send XML metadata */
 		auto xml = doc.write_to_string ("UTF-8");
-		socket->write (xml.length() + 1);
-		socket->write ((uint8_t *) xml.c_str(), xml.bytes() + 1);
-
-		/* Send binary data */
-		LOG_TIMING("start-remote-send thread=%1", thread_id ());
-		_frame->write_to_socket (socket);
+		body->write (xml.length() + 1);
+		body->write ((uint8_t *) xml.c_str(), xml.bytes() + 1);
+		break;
+	}
+	case EncodeRequestFormat::BINARY:
+	{
+		/* The server reads the version and priority before it looks at anything else */
+		BinaryDescriptorWriter writer;
+		writer.add (static_cast<int32_t>(SERVER_LINK_VERSION));
+		writer.add (static_cast<int32_t>(Config::instance()->encoding_priority()));
+		writer.add (static_cast<int32_t>(_index));
+		writer.add (static_cast<int32_t>(_frames_per_second));
+		writer.add (static_cast<int32_t>(_j2k_bandwidth));
+		writer.add (static_cast<int32_t>(_resolution));
+		_frame->add_metadata (writer);
+
+		auto const& data = writer.data();
+		body->write (binary_request_marker);
+		body->write (static_cast<uint32_t>(data.size()));
+		body->write (data.data(), data.size());
+		break;
 	}
-
-	/* Read the response (JPEG2000-encoded data); this blocks until the data
-	   is ready and sent back.
-	*/
-	Socket::ReadDigestScope ds (socket);
-	LOG_TIMING("start-remote-encode thread=%1", thread_id ());
-	ArrayData e (socket->read_uint32 ());
-	LOG_TIMING("start-remote-receive thread=%1", thread_id ());
-	socket->read (e.data(), e.size());
-	LOG_TIMING("finish-remote-receive thread=%1", thread_id ());
-	if (!ds.check()) {
-		throw NetworkError ("Checksums do not match");
 	}
 
-	LOG_DEBUG_ENCODE (N_("Finished remotely-encoded frame %1"), _index);
+	_frame->write_to_socket (body);
 
-	return e;
+	return request;
 }
 
 void
@@ -265,6 +476,22 @@ DCPVideo::add_metadata (xmlpp::Element* el) const
 	_frame->add_metadata (el);
 }
 
+/** @return Digest of everything that goes into making the J2K data for this frame,
+ *  apart from its index.
+ */
+string
+DCPVideo::cache_digest () const
+{
+	Digester digester;
+	digester.add (_frames_per_second);
+	digester.add (_j2k_bandwidth);
+	digester.add (static_cast<int>(_resolution));
+	digester.add (Config::instance()->dcp_j2k_comment());
+	_frame->add_digest (digester);
+	return digester.get ();
+}
+
+
 Eyes
 DCPVideo::eyes () const
 {
@@ -22,13 +22,17 @@
 #include "encode_server_description.h"
 #include <libcxml/cxml.h>
 #include <dcp/array_data.h>
+#include <vector>
 
 /** @file  src/dcp_video_frame.h
  *  @brief A single frame of video destined for a DCP.
  */
 
+class BinaryDescriptorReader;
+class J2KEncodeBackend;
 class Log;
 class PlayerVideo;
+class Socket;
 
 /** @class DCPVideo
  *  @brief A single frame of video destined for a DCP.
@@ -44,12 +48,15 @@ class DCPVideo
 public:
 	DCPVideo (std::shared_ptr<const PlayerVideo>, int index, int dcp_fps, int bandwidth, Resolution r);
 	DCPVideo (std::shared_ptr<const PlayerVideo>, cxml::ConstNodePtr);
+	DCPVideo (BinaryDescriptorReader& reader, std::shared_ptr<Socket> socket);
 
 	DCPVideo (DCPVideo const&) = default;
 	DCPVideo& operator= (DCPVideo const&) = default;
 
 	dcp::ArrayData encode_locally () const;
-	dcp::ArrayData encode_remotely (EncodeServerDescription, int timeout = 30) const;
+	dcp::ArrayData encode_locally (J2KEncodeBackend& backend) const;
+	dcp::ArrayData encode_remotely (EncodeServerDescription, int timeout = 30, EncodeRequestFormat format = EncodeRequestFormat::BINARY) const;
+	std::vector<uint8_t> request (EncodeRequestFormat format = EncodeRequestFormat::BINARY) const;
 
 	int index () const {
 		return _index;
@@ -59,8 +66,15 @@ public:
 
 	bool same (std::shared_ptr<const DCPVideo> other) const;
 
+	std::string cache_digest () const;
+
 	static std::shared_ptr<dcp::OpenJPEGImage> convert_to_xyz (std::shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note);
 
+	/** Value sent in place of the length of the XML at the start of a request
+	 *  to say that the request is described by a binary descriptor instead.
+	 */
+	static uint32_t const binary_request_marker = 0xffffffff;
+
 private:
 
 	void add_metadata (xmlpp::Element *) const;
@@ -24,8 +24,9 @@
 #include "dcpomatic_log.h"
 #include "dcpomatic_socket.h"
 #include "exceptions.h"
+#include "metrics.h"
 #include <boost/bind/bind.hpp>
-#include <boost/lambda/lambda.hpp>
+#include <cstring>
 #include <iostream>
 
 #include "i18n.h"
@@ -35,9 +36,20 @@ using std::shared_ptr;
 using std::weak_ptr;
 
 
+/** Add @p bytes to the count of bytes sent over the network, or received if @p sent is false */
+static void
+note_network_bytes (bool sent, size_t bytes)
+{
+	static auto& sent_metric = Metrics::instance()->counter("dcpomatic_network_bytes_total", "Bytes sent and received by DCP-o-matic's sockets", {{ "direction", "sent" }});
+	static auto& received_metric = Metrics::instance()->counter("dcpomatic_network_bytes_total", "Bytes sent and received by DCP-o-matic's sockets", {{ "direction", "received" }});
+	(sent ? sent_metric : received_metric).add(bytes);
+}
+
+
 /** @param timeout Timeout in seconds */
 Socket::Socket (int timeout)
-	: _deadline (_io_service)
+	: _io_service (_own_io_service)
+	, _deadline (_io_service)
 	, _socket (_io_service)
 	, _timeout (timeout)
 {
@@ -45,9 +57,27 @@ Socket::Socket (int timeout)
 	check ();
 }
 
+
+/** Make a socket which uses an io_service that somebody else is running; such a socket
+ *  can only be used with async_read() and async_write(), from that io_service's thread,
+ *  since the blocking calls need to run the io_service themselves.
+ *  @param timeout Timeout in seconds.
+ */
+Socket::Socket (boost::asio::io_service& io_service, int timeout)
+	: _io_service (io_service)
+	, _deadline (_own_io_service)
+	, _socket (_io_service)
+	, _timeout (timeout)
+	, _external_io_service (true)
+{
+
+}
+
 void
 Socket::check ()
 {
+	boost::mutex::scoped_lock lm (_mutex);
+
 	if (_deadline.expires_at() <= boost::asio::deadline_timer::traits_type::now ()) {
 		_socket.close ();
 		_deadline.expires_at (boost::posix_time::pos_infin);
@@ -57,18 +87,70 @@ Socket::check ()
 }
 
 
+/** Give up on the socket if the next operation does not finish within our timeout.
+ *  Caller must hold a lock on _mutex.
+ */
+void
+Socket::set_deadline ()
+{
+	_deadline.expires_from_now (boost::posix_time::seconds (_timeout));
+}
+
+
+/** Run our io_service until @p ec is no longer would_block.  A reading thread and a
+ *  writing thread may both be in here at once; only one of them runs the io_service at a
+ *  time, running handlers for both, while the other waits to see if its operation has finished.
+ */
+void
+Socket::run (boost::system::error_code& ec)
+{
+	DCPOMATIC_ASSERT (!_external_io_service);
+
+	boost::mutex::scoped_lock lm (_mutex);
+	while (ec == boost::asio::error::would_block) {
+		if (_running) {
+			_running_condition.wait (lm);
+		} else {
+			_running = true;
+			lm.unlock ();
+			_io_service.run_one ();
+			lm.lock ();
+			_running = false;
+			_running_condition.notify_all ();
+		}
+	}
+}
+
+
+/** Close the socket; this is safe to call when another thread is reading or writing,
+ *  and will make that read or write fail.
+ */
+void
+Socket::close ()
+{
+	_io_service.post([this]() {
+		boost::mutex::scoped_lock lm (_mutex);
+		_socket.close ();
+	});
+}
+
+
 /** Blocking connect.
  *  @param endpoint End-point to connect to.
  */
 void
 Socket::connect (boost::asio::ip::tcp::endpoint endpoint)
 {
-	_deadline.expires_from_now (boost::posix_time::seconds (_timeout));
 	boost::system::error_code ec = boost::asio::error::would_block;
-	_socket.async_connect (endpoint, boost::lambda::var(ec) = boost::lambda::_1);
-	do {
-		_io_service.run_one();
-	} while (ec == boost::asio::error::would_block);
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		set_deadline ();
+		_socket.async_connect (endpoint, [this, &ec](boost::system::error_code const& e) {
+			boost::mutex::scoped_lock lm (_mutex);
+			ec = e;
+		});
+	}
+	run (ec);
 
 	if (ec) {
 		throw NetworkError (String::compose (_("error during async_connect (%1)"), ec.value ()));
@@ -95,25 +177,78 @@ Socket::connect (boost::asio::ip::tcp::endpoint endpoint)
 void
 Socket::write (uint8_t const * data, int size)
 {
-	_deadline.expires_from_now (boost::posix_time::seconds (_timeout));
-	boost::system::error_code ec = boost::asio::error::would_block;
-
-	boost::asio::async_write (_socket, boost::asio::buffer (data, size), boost::lambda::var(ec) = boost::lambda::_1);
+	if (_write_buffer) {
+		_write_buffer->insert (_write_buffer->end(), data, data + size);
+		if (_write_digester) {
+			_write_digester->add (data, static_cast<size_t>(size));
+		}
+		return;
+	}
 
-	do {
-		_io_service.run_one ();
-	} while (ec == boost::asio::error::would_block);
+	boost::system::error_code ec = boost::asio::error::would_block;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		set_deadline ();
+		boost::asio::async_write (_socket, boost::asio::buffer (data, size), [this, &ec](boost::system::error_code const& e, std::size_t) {
+			boost::mutex::scoped_lock lm (_mutex);
+			ec = e;
+		});
+	}
+	run (ec);
 
 	if (ec) {
 		throw NetworkError (String::compose (_("error during async_write (%1)"), ec.value ()));
 	}
 
+	note_network_bytes (true, size);
+
 	if (_write_digester) {
 		_write_digester->add (data, static_cast<size_t>(size));
 	}
 }
 
 
+/** Blocking write of several pieces of memory, one after the other, in a single operation.
+ *  This sends the same as calling write() for each buffer in turn.
+ */
+void
+Socket::write (std::vector<boost::asio::const_buffer> const& buffers)
+{
+	auto const size = boost::asio::buffer_size(buffers);
+
+	if (_write_buffer) {
+		_write_buffer->reserve (_write_buffer->size() + size);
+		for (auto const& i: buffers) {
+			auto const data = boost::asio::buffer_cast<uint8_t const*>(i);
+			_write_buffer->insert (_write_buffer->end(), data, data + boost::asio::buffer_size(i));
+		}
+	} else {
+		boost::system::error_code ec = boost::asio::error::would_block;
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			set_deadline ();
+			boost::asio::async_write (_socket, buffers, [this, &ec](boost::system::error_code const& e, std::size_t) {
+				boost::mutex::scoped_lock lm (_mutex);
+				ec = e;
+			});
+		}
+		run (ec);
+
+		if (ec) {
+			throw NetworkError (String::compose (_("error during async_write (%1)"), ec.value ()));
+		}
+
+		note_network_bytes (true, size);
+	}
+
+	if (_write_digester) {
+		for (auto const& i: buffers) {
+			_write_digester->add (boost::asio::buffer_cast<uint8_t const*>(i), boost::asio::buffer_size(i));
+		}
+	}
+}
+
+
 void
 Socket::write (uint32_t v)
 {
@@ -129,25 +264,87 @@ Socket::write (uint32_t v)
 void
 Socket::read (uint8_t* data, int size)
 {
-	_deadline.expires_from_now (boost::posix_time::seconds (_timeout));
-	boost::system::error_code ec = boost::asio::error::would_block;
-
-	boost::asio::async_read (_socket, boost::asio::buffer (data, size), boost::lambda::var(ec) = boost::lambda::_1);
+	if (_read_buffer) {
+		if (size < 0 || static_cast<size_t>(size) > _read_buffer_size) {
+			throw NetworkError (_("end of buffer during read"));
+		}
+		memcpy (data, _read_buffer, size);
+		_read_buffer += size;
+		_read_buffer_size -= size;
+		if (_read_digester) {
+			_read_digester->add (data, static_cast<size_t>(size));
+		}
+		return;
+	}
 
-	do {
-		_io_service.run_one ();
-	} while (ec == boost::asio::error::would_block);
+	boost::system::error_code ec = boost::asio::error::would_block;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		set_deadline ();
+		boost::asio::async_read (_socket, boost::asio::buffer (data, size), [this, &ec](boost::system::error_code const& e, std::size_t) {
+			boost::mutex::scoped_lock lm (_mutex);
+			ec = e;
+		});
+	}
+	run (ec);
 
 	if (ec) {
 		throw NetworkError (String::compose (_("error during async_read (%1)"), ec.value ()));
 	}
 
+	note_network_bytes (false, size);
+
 	if (_read_digester) {
 		_read_digester->add (data, static_cast<size_t>(size));
 	}
 }
 
 
+/** Blocking read into several pieces of memory, one after the other, in a single operation.
+ *  This reads the same as calling read() for each buffer in turn.
+ */
+void
+Socket::read (std::vector<boost::asio::mutable_buffer> const& buffers)
+{
+	auto const size = boost::asio::buffer_size(buffers);
+
+	if (_read_buffer) {
+		if (size > _read_buffer_size) {
+			throw NetworkError (_("end of buffer during read"));
+		}
+		for (auto const& i: buffers) {
+			auto const length = boost::asio::buffer_size(i);
+			memcpy (boost::asio::buffer_cast<uint8_t*>(i), _read_buffer, length);
+			_read_buffer += length;
+		}
+		_read_buffer_size -= size;
+	} else {
+		boost::system::error_code ec = boost::asio::error::would_block;
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			set_deadline ();
+			boost::asio::async_read (_socket, buffers, [this, &ec](boost::system::error_code const& e, std::size_t) {
+				boost::mutex::scoped_lock lm (_mutex);
+				ec = e;
+			});
+		}
+		run (ec);
+
+		if (ec) {
+			throw NetworkError (String::compose (_("error during async_read (%1)"), ec.value ()));
+		}
+
+		note_network_bytes (false, size);
+	}
+
+	if (_read_digester) {
+		for (auto const& i: buffers) {
+			_read_digester->add (boost::asio::buffer_cast<uint8_t const*>(i), boost::asio::buffer_size(i));
+		}
+	}
+}
+
+
 uint32_t
 Socket::read_uint32 ()
 {
@@ -157,11 +354,48 @@ Socket::read_uint32 ()
 }
 
 
+void
+Socket::async_read (uint8_t* data, size_t size, std::function<void (boost::system::error_code)> handler)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	boost::asio::async_read (_socket, boost::asio::buffer(data, size), [handler](boost::system::error_code const& ec, std::size_t bytes) {
+		note_network_bytes (false, bytes);
+		handler (ec);
+	});
+}
+
+
+void
+Socket::async_write (uint8_t const* data, size_t size, std::function<void (boost::system::error_code)> handler)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	boost::asio::async_write (_socket, boost::asio::buffer(data, size), [handler](boost::system::error_code const& ec, std::size_t bytes) {
+		note_network_bytes (true, bytes);
+		handler (ec);
+	});
+}
+
+
+void
+Socket::set_read_buffer (uint8_t const* data, size_t size)
+{
+	_read_buffer = data;
+	_read_buffer_size = size;
+}
+
+
+void
+Socket::set_write_buffer (std::vector<uint8_t>* buffer)
+{
+	_write_buffer = buffer;
+}
+
+
 void
 Socket::start_read_digest ()
 {
 	DCPOMATIC_ASSERT (!_read_digester);
-	_read_digester.reset (new Digester());
+	_read_digester.reset (new Digester(_digest_algorithm));
 }
 
 
@@ -169,7 +403,7 @@ void
 Socket::start_write_digest ()
 {
 	DCPOMATIC_ASSERT (!_write_digester);
-	_write_digester.reset (new Digester());
+	_write_digester.reset (new Digester(_digest_algorithm));
 }
 
 
@@ -21,6 +21,10 @@
 #include "digester.h"
 #include <boost/asio.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <functional>
+#include <vector>
 
 /** @class Socket
  *  @brief A class to wrap a boost::asio::ip::tcp::socket with some things
@@ -28,11 +32,18 @@
  *
  *  This class wraps some things that I could not work out how to do easily with boost;
  *  most notably, sync read/write calls with timeouts.
+ *
+ *  One thread may read from a Socket while another writes to it.
+ *
+ *  A Socket can also be made to read from or write to memory rather than the network,
+ *  so that the same code can be used to parse or build messages which are sent as a
+ *  whole (see set_read_buffer() and set_write_buffer()).
  */
 class Socket
 {
 public:
 	explicit Socket (int timeout = 30);
+	Socket (boost::asio::io_service& io_service, int timeout);
 
 	Socket (Socket const&) = delete;
 	Socket& operator= (Socket const&) = delete;
@@ -43,14 +54,40 @@ public:
 	}
 
 	void set_send_buffer_size (int size);
+	/** Set the algorithm to use for digests in ReadDigestScope and WriteDigestScope;
+	 *  both ends of the connection must agree on it.
+	 */
+	void set_digest_algorithm (Digester::Algorithm algorithm) {
+		_digest_algorithm = algorithm;
+	}
 	void connect (boost::asio::ip::tcp::endpoint);
+	void close ();
 
 	void write (uint32_t n);
 	void write (uint8_t const * data, int size);
+	void write (std::vector<boost::asio::const_buffer> const& buffers);
 
 	void read (uint8_t* data, int size);
+	void read (std::vector<boost::asio::mutable_buffer> const& buffers);
 	uint32_t read_uint32 ();
 
+	/** Start reading exactly @p size bytes into @p data without waiting for them; this
+	 *  must be called from the thread that is running the io_service that we were
+	 *  constructed with.  The data is not added to any digest.
+	 */
+	void async_read (uint8_t* data, size_t size, std::function<void (boost::system::error_code)> handler);
+	/** Start writing @p size bytes from @p data without waiting for them to go; the same
+	 *  conditions apply as for async_read().
+	 */
+	void async_write (uint8_t const* data, size_t size, std::function<void (boost::system::error_code)> handler);
+
+	/** Make read() take its data from @p data rather than the network.  It is an error
+	 *  to read past the end of the buffer.
+	 */
+	void set_read_buffer (uint8_t const* data, size_t size);
+	/** Make write() append its data to @p buffer rather than sending it */
+	void set_write_buffer (std::vector<uint8_t>* buffer);
+
 	class ReadDigestScope
 	{
 	public:
@@ -77,16 +114,33 @@ private:
 	friend class DigestScope;
 
 	void check ();
+	void set_deadline ();
+	void run (boost::system::error_code& ec);
 	void start_read_digest ();
 	bool check_read_digest ();
 	void start_write_digest ();
 	void finish_write_digest ();
 
-	boost::asio::io_service _io_service;
+	/** io_service that we use if we weren't given one */
+	boost::asio::io_service _own_io_service;
+	boost::asio::io_service& _io_service;
 	boost::asio::deadline_timer _deadline;
 	boost::asio::ip::tcp::socket _socket;
 	int _timeout;
 	boost::scoped_ptr<Digester> _read_digester;
 	boost::scoped_ptr<Digester> _write_digester;
+	Digester::Algorithm _digest_algorithm = Digester::Algorithm::MD5;
 	boost::optional<int> _send_buffer_size;
+	/** true if our io_service is run by someone else, so we must only be used asynchronously */
+	bool _external_io_service = false;
+
+	uint8_t const* _read_buffer = nullptr;
+	size_t _read_buffer_size = 0;
+	std::vector<uint8_t>* _write_buffer = nullptr;
+
+	/** mutex to protect _deadline, _socket, _running and the error codes of operations in progress */
+	boost::mutex _mutex;
+	/** true if some thread is currently running _io_service */
+	bool _running = false;
+	boost::condition _running_condition;
 };
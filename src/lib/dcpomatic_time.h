@@ -286,6 +286,88 @@ typedef Time<ContentTimeDifferentiator, DCPTimeDifferentiator> ContentTime;
 /** Time relative to the start of the output DCP in its frame rate */
 typedef Time<DCPTimeDifferentiator, ContentTimeDifferentiator> DCPTime;
 
+/** @class FrameTimes
+ *  @brief Conversions between a Time and frame indices at one rate, set up once so that they
+ *  are cheap to do for every frame.
+ *
+ *  When HZ is a multiple of the rate, as it is for the usual video and audio rates, the
+ *  conversions are exact integer arithmetic and the commonest rates are divided by a constant,
+ *  which the compiler makes into a multiply and shift.  Other rates use the same calculations
+ *  as Time::from_frames() and Time::frames_floor().
+ */
+template <class T>
+class FrameTimes
+{
+public:
+	FrameTimes () = default;
+
+	explicit FrameTimes (double rate)
+		: _rate (rate)
+		, _per_frame (per_frame(rate))
+	{
+		DCPOMATIC_ASSERT (rate > 0);
+	}
+
+	/** @return Same as T::from_frames(frames, rate()) */
+	T from_frames (int64_t frames) const {
+		if (_per_frame) {
+			return T(frames * _per_frame);
+		}
+		return T::from_frames(frames, _rate);
+	}
+
+	/** @return Index of the frame that @p time is in, which is the same as
+	 *  time.frames_floor(rate()) when @p time is not negative.
+	 */
+	int64_t frames_floor (T time) const {
+		auto const t = time.get();
+		switch (_per_frame) {
+		case 0:
+			return time.frames_floor(_rate);
+		case T::HZ / 24:
+			return floor_divide<T::HZ / 24>(t);
+		case T::HZ / 25:
+			return floor_divide<T::HZ / 25>(t);
+		case T::HZ / 30:
+			return floor_divide<T::HZ / 30>(t);
+		case T::HZ / 48:
+			return floor_divide<T::HZ / 48>(t);
+		case T::HZ / 50:
+			return floor_divide<T::HZ / 50>(t);
+		case T::HZ / 60:
+			return floor_divide<T::HZ / 60>(t);
+		case T::HZ / 48000:
+			return floor_divide<T::HZ / 48000>(t);
+		case T::HZ / 96000:
+			return t;
+		}
+		return t >= 0 ? t / _per_frame : -((-t + _per_frame - 1) / _per_frame);
+	}
+
+	double rate () const {
+		return _rate;
+	}
+
+private:
+	template <int64_t D>
+	static int64_t floor_divide (int64_t t) {
+		return t >= 0 ? t / D : -((-t + D - 1) / D);
+	}
+
+	/** @return Number of Time units in each frame at @p rate, or 0 if that is not a whole number */
+	static int64_t per_frame (double rate) {
+		auto const r = llrint(rate);
+		if (r > 0 && r == rate && T::HZ % r == 0) {
+			return T::HZ / r;
+		}
+		return 0;
+	}
+
+	double _rate = 24;
+	int64_t _per_frame = T::HZ / 24;
+};
+
+
 template <class T>
 class TimePeriod
 {
@@ -0,0 +1,248 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "decode_ahead.h"
+#include "decoder.h"
+#include "trace.h"
+#include "util.h"
+#include <chrono>
+
+
+using std::function;
+using std::shared_ptr;
+using namespace dcpomatic;
+
+
+DecodeAhead::DecodeAhead (shared_ptr<Decoder> decoder, int queue_length)
+	: _decoder (decoder)
+	, _queue_length (queue_length)
+{
+
+}
+
+
+DecodeAhead::~DecodeAhead ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	try {
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+	} catch (...) {}
+}
+
+
+/** Called with something that the decoder has emitted.  If it came from our thread we
+ *  keep it until the Player asks for the pass that emitted it; otherwise we call it now.
+ *  @param bytes Memory used by the data in emission, if it is known.
+ */
+void
+DecodeAhead::emit (function<void ()> emission, size_t bytes)
+{
+	if (boost::this_thread::get_id() == _thread.get_id() && _current) {
+		_current->emissions.push_back (emission);
+		_current->bytes += bytes;
+	} else {
+		emission ();
+	}
+}
+
+
+/** @return The position that the decoder had before the pass that will be made by the
+ *  next call to pass().  This may block until our thread has made that pass.
+ */
+ContentTime
+DecodeAhead::position ()
+{
+	if (_queue_length == 0) {
+		return _decoder->position();
+	}
+
+	ensure_thread ();
+
+	boost::mutex::scoped_lock lm (_mutex);
+	while (_queue.empty() && !_finished) {
+		_condition.wait (lm);
+	}
+
+	if (_queue.empty()) {
+		/* The decoder has nothing more to emit, so it has stopped moving */
+		return _decoder->position();
+	}
+
+	return _queue.front().position;
+}
+
+
+/** Make the decoder emit whatever it would have emitted from a call to Decoder::pass().
+ *  @return true if the decoder will emit no more data unless a seek() happens.
+ */
+bool
+DecodeAhead::pass ()
+{
+	if (_queue_length == 0) {
+		TraceSpan span("decode");
+		return _decoder->pass();
+	}
+
+	ensure_thread ();
+
+	Pass next;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_queue.empty() && !_finished) {
+			_condition.wait (lm);
+		}
+
+		if (_queue.empty()) {
+			return true;
+		}
+
+		next = std::move(_queue.front());
+		_queue.pop_front ();
+		_memory.add (-static_cast<int64_t>(next.bytes));
+		_condition.notify_all ();
+	}
+
+	for (auto const& i: next.emissions) {
+		i ();
+	}
+
+	if (next.error) {
+		std::rethrow_exception (next.error);
+	}
+
+	return next.done;
+}
+
+
+/** Start our thread, if it is not already running.  We don't do this in the constructor
+ *  so that the Player has a chance to connect to the decoder's signals first.
+ */
+void
+DecodeAhead::ensure_thread ()
+{
+	if (!_thread.joinable()) {
+		_thread = boost::thread (boost::bind(&DecodeAhead::thread, this));
+#ifdef DCPOMATIC_LINUX
+		pthread_setname_np (_thread.native_handle(), "decode-ahead");
+#endif
+	}
+}
+
+
+void
+DecodeAhead::seek (ContentTime time, bool accurate)
+{
+	stop ();
+	_decoder->seek (time, accurate);
+	start ();
+}
+
+
+/** Wait for any pass that our thread is running to finish, and then throw away
+ *  everything that it has done so that the decoder can be used directly.
+ */
+void
+DecodeAhead::stop ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_paused = true;
+	while (_running) {
+		_condition.wait (lm);
+	}
+	_queue.clear ();
+	_memory.set (0);
+	_finished = false;
+}
+
+
+void
+DecodeAhead::start ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_paused = false;
+	_condition.notify_all ();
+}
+
+
+void
+DecodeAhead::thread ()
+{
+	start_of_thread ("DecodeAhead");
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		/* Don't run ahead while the pipeline is using more memory than it should, so long as the
+		 * Player has something to be going on with.
+		 */
+		while (!_stop && (_paused || _finished || static_cast<int>(_queue.size()) >= _queue_length || (!_queue.empty() && MemoryBudget::instance()->over_budget()))) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		_running = true;
+		lm.unlock ();
+
+		Pass pass;
+		pass.position = _decoder->position();
+		_current = &pass;
+		auto const start = std::chrono::steady_clock::now();
+		try {
+			TraceSpan span("decode");
+			pass.done = _decoder->pass();
+		} catch (...) {
+			pass.error = std::current_exception();
+			pass.done = true;
+		}
+		_current = nullptr;
+		auto const time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		lm.lock ();
+		_running = false;
+		_thread_time += time;
+		if (!_paused) {
+			_finished = pass.done;
+			_memory.add (pass.bytes);
+			_queue.push_back (std::move(pass));
+		}
+		_condition.notify_all ();
+	}
+}
+
+
+double
+DecodeAhead::thread_time ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _thread_time;
+}
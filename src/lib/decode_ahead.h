@@ -0,0 +1,117 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_DECODE_AHEAD_H
+#define DCPOMATIC_DECODE_AHEAD_H
+
+
+#include "dcpomatic_time.h"
+#include "memory_budget.h"
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+class Decoder;
+
+
+/** @class DecodeAhead
+ *  @brief Calls Decoder::pass() for a Player, optionally in a thread of its own which runs ahead of the Player.
+ *
+ *  When running a thread, whatever the decoder emits during each pass is recorded, and then given
+ *  to the Player when it asks for that pass.  This means that the decoders for several pieces of
+ *  content can be working at the same time, but the Player still sees the data from each one
+ *  at the same point, and in the same order, as if it had called pass() itself.
+ *
+ *  The Player should connect to the decoder's signals using emit(); when the data comes from
+ *  our thread it is recorded, and otherwise it is passed straight on.
+ */
+class DecodeAhead
+{
+public:
+	/** @param decoder Decoder to use.
+	 *  @param queue_length Number of passes to run ahead by, or 0 to not use a thread and just
+	 *  call the decoder's methods when asked.
+	 */
+	DecodeAhead (std::shared_ptr<Decoder> decoder, int queue_length);
+	~DecodeAhead ();
+
+	DecodeAhead (DecodeAhead const&) = delete;
+	DecodeAhead& operator= (DecodeAhead const&) = delete;
+
+	void emit (std::function<void ()> emission, size_t bytes = 0);
+
+	dcpomatic::ContentTime position ();
+	bool pass ();
+	void seek (dcpomatic::ContentTime time, bool accurate);
+
+	/** @return Seconds that our thread has spent in Decoder::pass() */
+	double thread_time ();
+
+private:
+	void thread ();
+	void ensure_thread ();
+	void start ();
+	void stop ();
+
+	struct Pass
+	{
+		/** position of the decoder before the pass */
+		dcpomatic::ContentTime position;
+		/** return value of Decoder::pass() */
+		bool done = false;
+		/** things that the decoder emitted during the pass */
+		std::vector<std::function<void ()>> emissions;
+		/** memory used by the things in emissions, as far as we know */
+		size_t bytes = 0;
+		/** exception thrown by Decoder::pass(), if there was one */
+		std::exception_ptr error;
+	};
+
+	std::shared_ptr<Decoder> _decoder;
+	int _queue_length;
+
+	boost::thread _thread;
+	/** Pass that our thread is running; only used by our thread */
+	Pass* _current = nullptr;
+
+	/** mutex to protect the state below */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	std::deque<Pass> _queue;
+	/** true if the thread should not start any more passes */
+	bool _paused = false;
+	/** true if the thread is running a pass */
+	bool _running = false;
+	/** true if the last pass said that the decoder has nothing more to emit */
+	bool _finished = false;
+	bool _stop = false;
+	double _thread_time = 0;
+	/** memory used by the passes in _queue */
+	MemoryBudget::Share _memory{MemoryBudget::Subsystem::DECODERS};
+};
+
+
+#endif
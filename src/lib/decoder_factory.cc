@@ -55,13 +55,21 @@ maybe_cast (shared_ptr<Decoder> d)
 /**
    @param tolerant true to proceed in the face of `survivable' errors, otherwise false.
    @param old_decoder A `used' decoder that has been previously made for this piece of content, or 0
+   @param ffmpeg_decode_threads Number of threads that an FFmpeg decoder should decode video with, or none to use all of Config::decoding_threads()
 */
 shared_ptr<Decoder>
-decoder_factory (shared_ptr<const Film> film, shared_ptr<const Content> content, bool fast, bool tolerant, shared_ptr<Decoder> old_decoder)
+decoder_factory (
+	shared_ptr<const Film> film,
+	shared_ptr<const Content> content,
+	bool fast,
+	bool tolerant,
+	shared_ptr<Decoder> old_decoder,
+	boost::optional<int> ffmpeg_decode_threads
+	)
 {
 	auto fc = dynamic_pointer_cast<const FFmpegContent> (content);
 	if (fc) {
-		return make_shared<FFmpegDecoder>(film, fc, fast);
+		return make_shared<FFmpegDecoder>(film, fc, fast, ffmpeg_decode_threads);
 	}
 
 	auto dc = dynamic_pointer_cast<const DCPContent> (content);
@@ -19,6 +19,10 @@
 */
 
 
+#include <boost/optional.hpp>
+#include <memory>
+
+
 class Decoder;
 
 
@@ -27,5 +31,6 @@ extern std::shared_ptr<Decoder> decoder_factory (
 	std::shared_ptr<const Content> content,
 	bool fast,
 	bool tolerant,
-	std::shared_ptr<Decoder> old_decoder
+	std::shared_ptr<Decoder> old_decoder,
+	boost::optional<int> ffmpeg_decode_threads = boost::none
 	);
@@ -0,0 +1,131 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "digest_cache.h"
+#include <dcp/raw_convert.h>
+#include <boost/thread/once.hpp>
+#include <algorithm>
+#include <set>
+
+
+using std::set;
+using std::string;
+using std::vector;
+using boost::optional;
+using dcp::raw_convert;
+
+
+DigestCache* DigestCache::_instance = nullptr;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+int const DigestCache::size = 4096;
+int const DigestCache::sample_size = 64;
+
+
+optional<string>
+DigestCache::get (string const& key) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	auto i = _digests.find (key);
+	if (i == _digests.end()) {
+		return {};
+	}
+	return i->second;
+}
+
+
+void
+DigestCache::put (string const& key, string digest)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_digests.size() >= static_cast<size_t>(size)) {
+		/* We don't expect to get here often, so there's no need to be clever about what to forget */
+		_digests.clear ();
+	}
+	_digests[key] = digest;
+}
+
+
+void
+DigestCache::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_digests.clear ();
+}
+
+
+/** @param files Files that are being digested.
+ *  @param head_tail_size Number of bytes at the start and end of the files which the digest covers.
+ *  @return Key to look up the digest of @p files; this changes if any of the files that the digest
+ *  reads changes, or if a sample of the others do.
+ */
+string
+DigestCache::key (vector<boost::filesystem::path> const& files, boost::uintmax_t head_tail_size)
+{
+	string key = raw_convert<string>(files.size()) + ":" + raw_convert<string>(head_tail_size);
+
+	set<size_t> done;
+	auto add = [&key, &done, &files](size_t index) -> boost::uintmax_t {
+		if (!done.insert(index).second) {
+			return 0;
+		}
+		auto const& file = files[index];
+		boost::system::error_code size_error;
+		auto const size = boost::filesystem::file_size(file, size_error);
+		boost::system::error_code time_error;
+		auto const written = boost::filesystem::last_write_time(file, time_error);
+		key += "\n" + file.string();
+		key += ":" + raw_convert<string>(size_error ? 0 : size);
+		key += ":" + raw_convert<string>(static_cast<int64_t>(time_error ? 0 : written));
+		return size_error ? 0 : size;
+	};
+
+	/* All the files that the digest reads from at the start... */
+	boost::uintmax_t covered = 0;
+	for (size_t i = 0; i < files.size() && covered < head_tail_size; ++i) {
+		covered += add(i);
+	}
+
+	/* ...and at the end */
+	covered = 0;
+	for (size_t i = files.size(); i > 0 && covered < head_tail_size; --i) {
+		covered += add(i - 1);
+	}
+
+	/* and some from the middle */
+	if (files.size() > 2) {
+		auto const step = (files.size() + sample_size - 1) / sample_size;
+		for (size_t i = step; i < files.size() - 1; i += step) {
+			add (i);
+		}
+	}
+
+	return key;
+}
+
+
+DigestCache*
+DigestCache::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new DigestCache();
+	});
+	return _instance;
+}
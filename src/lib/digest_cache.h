@@ -0,0 +1,71 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_DIGEST_CACHE_H
+#define DCPOMATIC_DIGEST_CACHE_H
+
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/** @class DigestCache
+ *  @brief Digests of sets of content files which we have already calculated, so that
+ *  loading the same content again (or checking whether it has changed) need not
+ *  read the files again.
+ *
+ *  Digests are looked up by a key made from the path, size and modification time of
+ *  some of the files; for long image sequences only a bounded sample of the files
+ *  is looked at, so that making the key does not stat every one of them.
+ */
+class DigestCache
+{
+public:
+	DigestCache (DigestCache const&) = delete;
+	DigestCache& operator= (DigestCache const&) = delete;
+
+	boost::optional<std::string> get (std::string const& key) const;
+	void put (std::string const& key, std::string digest);
+	void clear ();
+
+	static std::string key (std::vector<boost::filesystem::path> const& files, boost::uintmax_t head_tail_size);
+	static DigestCache* instance ();
+
+	/** maximum number of digests to keep */
+	static int const size;
+	/** number of files, evenly spaced through a sequence, whose details go into its key as well as the first and last */
+	static int const sample_size;
+
+private:
+	DigestCache () = default;
+
+	mutable boost::mutex _mutex;
+	std::map<std::string, std::string> _digests;
+
+	static DigestCache* _instance;
+};
+
+
+#endif
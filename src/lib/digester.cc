@@ -19,6 +19,7 @@
 */
 
 
+#include "crc32c.h"
 #include "digester.h"
 #include "dcpomatic_assert.h"
 #include <nettle/md5.h>
@@ -32,7 +33,8 @@ using std::setfill;
 using std::setw;
 
 
-Digester::Digester ()
+Digester::Digester (Algorithm algorithm)
+	: _algorithm (algorithm)
 {
 	md5_init (&_context);
 }
@@ -47,7 +49,14 @@ Digester::~Digester ()
 void
 Digester::add (void const * data, size_t size)
 {
-	md5_update (&_context, size, reinterpret_cast<uint8_t const *>(data));
+	switch (_algorithm) {
+	case Algorithm::MD5:
+		md5_update (&_context, size, reinterpret_cast<uint8_t const *>(data));
+		break;
+	case Algorithm::CRC32C:
+		_crc = crc32c (_crc, reinterpret_cast<uint8_t const *>(data), size);
+		break;
+	}
 }
 
 
@@ -63,10 +72,10 @@ Digester::get () const
 {
 	if (!_digest) {
 		unsigned char digest[MD5_DIGEST_SIZE];
-		md5_digest (&_context, MD5_DIGEST_SIZE, digest);
+		get (digest);
 
 		char hex[MD5_DIGEST_SIZE * 2 + 1];
-		for (int i = 0; i < MD5_DIGEST_SIZE; ++i) {
+		for (int i = 0; i < size(); ++i) {
 			sprintf(hex + i * 2, "%02x", digest[i]);
 		}
 
@@ -80,12 +89,29 @@ Digester::get () const
 void
 Digester::get (uint8_t* buffer) const
 {
-	md5_digest (&_context, MD5_DIGEST_SIZE, buffer);
+	switch (_algorithm) {
+	case Algorithm::MD5:
+		md5_digest (&_context, MD5_DIGEST_SIZE, buffer);
+		break;
+	case Algorithm::CRC32C:
+		for (int i = 0; i < 4; ++i) {
+			buffer[i] = (_crc >> ((3 - i) * 8)) & 0xff;
+		}
+		break;
+	}
 }
 
 
 int
 Digester::size () const
 {
-	return MD5_DIGEST_SIZE;
+	switch (_algorithm) {
+	case Algorithm::MD5:
+		return MD5_DIGEST_SIZE;
+	case Algorithm::CRC32C:
+		return 4;
+	}
+
+	DCPOMATIC_ASSERT (false);
+	return 0;
 }
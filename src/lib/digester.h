@@ -27,7 +27,15 @@
 class Digester
 {
 public:
-	Digester ();
+	enum class Algorithm
+	{
+		/** MD5, which is what everything uses unless it asks otherwise */
+		MD5 = 0,
+		/** CRC-32C, which is much quicker but only good for catching accidents */
+		CRC32C = 1
+	};
+
+	explicit Digester (Algorithm algorithm = Algorithm::MD5);
 	~Digester ();
 
 	Digester (Digester const&) = delete;
@@ -49,6 +57,8 @@ public:
 	int size () const;
 
 private:
+	Algorithm _algorithm;
 	mutable md5_ctx _context;
+	uint32_t _crc = 0;
 	mutable boost::optional<std::string> _digest;
 };
@@ -0,0 +1,81 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "disk_space_guard.h"
+
+
+using boost::optional;
+
+
+int64_t const DiskSpaceGuard::margin = 1073741824;
+
+
+DiskSpaceGuard::DiskSpaceGuard (int64_t fallback_frame_size, int64_t other_bytes_per_frame)
+	: _fallback_frame_size (fallback_frame_size)
+	, _other_bytes_per_frame (other_bytes_per_frame)
+{
+
+}
+
+
+/** Note that a picture frame has been written.
+ *  @param size Size of the frame, in bytes.
+ */
+void
+DiskSpaceGuard::frame_written (int64_t size)
+{
+	++_frames_written;
+	_bytes_written += size;
+}
+
+
+/** @param remaining_frames Number of picture frames that are still to be written.
+ *  @return Estimate of the number of bytes that writing them, and everything that goes with them, will need.
+ */
+int64_t
+DiskSpaceGuard::needed (Frame remaining_frames) const
+{
+	auto const frame_size = _frames_written ? (_bytes_written / _frames_written) : _fallback_frame_size;
+	return remaining_frames * (frame_size + _other_bytes_per_frame);
+}
+
+
+/** @param available Space that is available on the disk, in bytes.
+ *  @param remaining_frames Number of picture frames that are still to be written.
+ *  @return The new state, if it has changed since the last call.
+ */
+optional<DiskSpaceGuard::State>
+DiskSpaceGuard::check (int64_t available, Frame remaining_frames)
+{
+	auto state = State::OK;
+	if (available < margin) {
+		state = State::FULL;
+	} else if (available < needed(remaining_frames) + margin) {
+		state = State::LOW;
+	}
+
+	if (state == _state) {
+		return {};
+	}
+
+	_state = state;
+	return state;
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_DISK_SPACE_GUARD_H
+#define DCPOMATIC_DISK_SPACE_GUARD_H
+
+
+#include "types.h"
+#include <boost/optional.hpp>
+#include <stdint.h>
+
+
+/** @class DiskSpaceGuard
+ *  @brief Keeps an eye on whether an encode is going to fit on its disk.
+ *
+ *  The space that the rest of the encode will need is estimated from the sizes of the
+ *  picture frames that have been written so far, since J2K frames are often much smaller
+ *  (and sometimes larger) than the constant bit rate that the encode was set up with.
+ */
+class DiskSpaceGuard
+{
+public:
+	/** @param fallback_frame_size Size to assume for each picture frame until some have been written, in bytes.
+	 *  @param other_bytes_per_frame Size of everything else (sound, mostly) which is written for each picture frame, in bytes.
+	 */
+	DiskSpaceGuard (int64_t fallback_frame_size, int64_t other_bytes_per_frame);
+
+	void frame_written (int64_t size);
+
+	int64_t needed (Frame remaining_frames) const;
+
+	enum class State {
+		/** there looks to be enough space */
+		OK,
+		/** the rest of the encode looks unlikely to fit */
+		LOW,
+		/** the disk is about to be full */
+		FULL
+	};
+
+	boost::optional<State> check (int64_t available, Frame remaining_frames);
+
+	State state () const {
+		return _state;
+	}
+
+	/** Space that we always want to leave on the disk, in bytes */
+	static int64_t const margin;
+
+private:
+	int64_t _fallback_frame_size;
+	int64_t _other_bytes_per_frame;
+	/** number of picture frames given to frame_written() */
+	int64_t _frames_written = 0;
+	/** total size of those frames, in bytes */
+	int64_t _bytes_written = 0;
+	State _state = State::OK;
+};
+
+
+#endif
@@ -38,8 +38,10 @@
 // Front-end sends:
 
 #define DISK_WRITER_WRITE "W"
-// DCP pathname
 // Internal name of the drive to write to
+// Verification to do after writing: full, fast or sampled
+// DCP pathname (repeated for each DCP)
+// empty line
 
 // Back-end responds:
 
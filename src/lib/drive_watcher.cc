@@ -0,0 +1,110 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "dcpomatic_log.h"
+#include "drive_watcher.h"
+#include "util.h"
+
+
+using std::function;
+using std::vector;
+using boost::optional;
+
+
+DriveWatcher::DriveWatcher (function<vector<Drive> ()> get, int interval)
+	: _get(get)
+	, _interval(interval)
+{
+	_thread = boost::thread(boost::bind(&DriveWatcher::thread, this));
+}
+
+
+DriveWatcher::~DriveWatcher ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+	}
+
+	_condition.notify_all ();
+	try {
+		_thread.join ();
+	} catch (...) {}
+}
+
+
+optional<vector<Drive>>
+DriveWatcher::drives () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _drives;
+}
+
+
+void
+DriveWatcher::refresh ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_refresh = true;
+	_condition.notify_all ();
+}
+
+
+void
+DriveWatcher::thread ()
+{
+	start_of_thread ("DriveWatcher");
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		if (!_refresh && !_stop) {
+			_condition.timed_wait (lm, boost::posix_time::seconds(_interval));
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		_refresh = false;
+		lm.unlock ();
+
+		/* This can take a while if a drive is slow to answer, so don't hold the lock */
+		vector<Drive> drives;
+		try {
+			drives = _get ();
+		} catch (std::exception& e) {
+			LOG_DISK("Failed to look for drives (%1)", e.what());
+			continue;
+		}
+
+		lm.lock ();
+		if (_drives && *_drives == drives) {
+			continue;
+		}
+		_drives = drives;
+		lm.unlock ();
+
+		emit (boost::bind(boost::ref(Changed), drives));
+	}
+}
@@ -0,0 +1,81 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_DRIVE_WATCHER_H
+#define DCPOMATIC_DRIVE_WATCHER_H
+
+
+#include "cross.h"
+#include "signaller.h"
+#include <boost/optional.hpp>
+#include <boost/signals2.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <functional>
+#include <vector>
+
+
+/** @class DriveWatcher
+ *  @brief Finds the drives that are attached to the system in a background thread.
+ *
+ *  The drives are looked for again every so often, and when refresh() is called, and
+ *  Changed is emitted (in the UI thread) when what is found differs from last time.
+ *  This means that nothing which might need to wait for a slow drive is done in the UI
+ *  thread, and the UI is only rebuilt when a drive appears, disappears or changes.
+ */
+class DriveWatcher : public Signaller
+{
+public:
+	/** @param get Function to find the drives.
+	 *  @param interval Time between looks, in seconds.
+	 */
+	explicit DriveWatcher (std::function<std::vector<Drive> ()> get = &Drive::get, int interval = 2);
+	~DriveWatcher ();
+
+	DriveWatcher (DriveWatcher const&) = delete;
+	DriveWatcher& operator= (DriveWatcher const&) = delete;
+
+	/** @return The drives that were found last time we looked, or none if we have not looked yet */
+	boost::optional<std::vector<Drive>> drives () const;
+
+	/** Look for drives again as soon as possible */
+	void refresh ();
+
+	boost::signals2::signal<void (std::vector<Drive>)> Changed;
+
+private:
+	void thread ();
+
+	std::function<std::vector<Drive> ()> _get;
+	int _interval;
+
+	/** mutex to protect _drives, _refresh and _stop */
+	mutable boost::mutex _mutex;
+	boost::condition _condition;
+	boost::optional<std::vector<Drive>> _drives;
+	bool _refresh = true;
+	bool _stop = false;
+
+	boost::thread _thread;
+};
+
+
+#endif
@@ -23,6 +23,7 @@
 #include "config.h"
 #include "emailer.h"
 #include "exceptions.h"
+#include "scope_guard.h"
 #include <curl/curl.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/c_local_time_adjustor.hpp>
@@ -39,6 +40,25 @@ using std::string;
 using dcp::ArrayData;
 
 
+EmailSession::EmailSession ()
+{
+	curl_global_init (CURL_GLOBAL_DEFAULT);
+
+	_curl = curl_easy_init ();
+	if (!_curl) {
+		curl_global_cleanup ();
+		throw NetworkError ("Could not initialise libcurl");
+	}
+}
+
+
+EmailSession::~EmailSession ()
+{
+	curl_easy_cleanup (_curl);
+	curl_global_cleanup ();
+}
+
+
 Emailer::Emailer (string from, list<string> to, string subject, string body)
 	: _from (from)
 	, _to (to)
@@ -75,9 +95,16 @@ Emailer::add_bcc (string bcc)
 
 void
 Emailer::add_attachment (boost::filesystem::path file, string name, string mime_type)
+{
+	add_attachment (ArrayData(file), name, mime_type);
+}
+
+
+void
+Emailer::add_attachment (ArrayData data, string name, string mime_type)
 {
 	Attachment a;
-	a.file = file;
+	a.data = data;
 	a.name = name;
 	a.mime_type = mime_type;
 	_attachments.push_back (a);
@@ -111,6 +138,20 @@ Emailer::get_data (void* ptr, size_t size, size_t nmemb)
 void
 Emailer::send (string server, int port, EmailProtocol protocol, string user, string password)
 {
+	EmailSession session;
+	send (session, server, port, protocol, user, password);
+}
+
+
+/** Send the email using a session which may already have a connection to the server from
+ *  sending something else.  Throws TransientNetworkError if sending fails in a way which
+ *  might not happen if it is tried again.
+ */
+void
+Emailer::send (EmailSession& session, string server, int port, EmailProtocol protocol, string user, string password)
+{
+	_offset = 0;
+
 	char date_buffer[128];
 	time_t now = time (0);
 	strftime (date_buffer, sizeof(date_buffer), "%a, %d %b %Y %H:%M:%S ", localtime(&now));
@@ -171,8 +212,7 @@ Emailer::send (string server, int port, EmailProtocol protocol, string user, str
 		}
 		bio = BIO_push (b64, bio);
 
-		ArrayData data (i.file);
-		BIO_write (bio, data.data(), data.size());
+		BIO_write (bio, i.data.data(), i.data.size());
 		(void) BIO_flush (bio);
 
 		char* out;
@@ -186,12 +226,9 @@ Emailer::send (string server, int port, EmailProtocol protocol, string user, str
 		_email += "\r\n--" + boundary + "--\r\n";
 	}
 
-	curl_global_init (CURL_GLOBAL_DEFAULT);
-
-	auto curl = curl_easy_init ();
-	if (!curl) {
-		throw NetworkError ("Could not initialise libcurl");
-	}
+	/* This clears the options from any previous email but keeps the connection */
+	auto curl = session.curl();
+	curl_easy_reset (curl);
 
 	if ((protocol == EmailProtocol::AUTO && port == 465) || protocol == EmailProtocol::SSL) {
 		/* "SSL" or "Implicit TLS"; I think curl wants us to use smtps here */
@@ -210,6 +247,7 @@ Emailer::send (string server, int port, EmailProtocol protocol, string user, str
 	curl_easy_setopt (curl, CURLOPT_MAIL_FROM, _from.c_str());
 
 	struct curl_slist* recipients = nullptr;
+	ScopeGuard sg = [&recipients]() { curl_slist_free_all(recipients); };
 	for (auto i: _to) {
 		recipients = curl_slist_append (recipients, i.c_str());
 	}
@@ -237,12 +275,21 @@ Emailer::send (string server, int port, EmailProtocol protocol, string user, str
 
 	auto const r = curl_easy_perform (curl);
 	if (r != CURLE_OK) {
+		long response = 0;
+		curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &response);
+		/* 4xx replies from the server mean "try again later" */
+		if (
+			r == CURLE_COULDNT_CONNECT ||
+			r == CURLE_OPERATION_TIMEDOUT ||
+			r == CURLE_SEND_ERROR ||
+			r == CURLE_RECV_ERROR ||
+			r == CURLE_GOT_NOTHING ||
+			(response >= 400 && response < 500)
+		   ) {
+			throw TransientNetworkError (_("Failed to send email"), string(curl_easy_strerror(r)));
+		}
 		throw NetworkError (_("Failed to send email"), string(curl_easy_strerror(r)));
 	}
-
-	curl_slist_free_all (recipients);
-	curl_easy_cleanup (curl);
-	curl_global_cleanup ();
 }
 
 
@@ -19,10 +19,35 @@
 */
 
 
+#include <dcp/array_data.h>
 #include <curl/curl.h>
 #include <boost/scoped_array.hpp>
 
 
+/** @class EmailSession
+ *  @brief A libcurl handle which can be used to send several emails one after the other,
+ *  so that they can share a connection (and TLS session) with the mail server.
+ *
+ *  A session must only be used by one thread at a time.
+ */
+class EmailSession
+{
+public:
+	EmailSession ();
+	~EmailSession ();
+
+	EmailSession (EmailSession const&) = delete;
+	EmailSession& operator= (EmailSession const&) = delete;
+
+	CURL* curl () const {
+		return _curl;
+	}
+
+private:
+	CURL* _curl;
+};
+
+
 class Emailer
 {
 public:
@@ -31,8 +56,10 @@ public:
 	void add_cc (std::string cc);
 	void add_bcc (std::string bcc);
 	void add_attachment (boost::filesystem::path file, std::string name, std::string mime_type);
+	void add_attachment (dcp::ArrayData data, std::string name, std::string mime_type);
 
 	void send (std::string server, int port, EmailProtocol protocol, std::string user = "", std::string password = "");
+	void send (EmailSession& session, std::string server, int port, EmailProtocol protocol, std::string user = "", std::string password = "");
 
 	std::string notes () const {
 		return _notes;
@@ -61,7 +88,7 @@ private:
 	std::list<std::string> _bcc;
 
 	struct Attachment {
-		boost::filesystem::path file;
+		dcp::ArrayData data;
 		std::string name;
 		std::string mime_type;
 	};
@@ -39,16 +39,54 @@ using namespace dcpomatic;
 
 
 Empty::Empty (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist, function<bool (shared_ptr<const Content>)> part, DCPTime length)
+	: _part (part)
 {
-	list<DCPTimePeriod> full;
 	for (auto i: playlist->content()) {
 		if (part(i) && i->paths_valid()) {
-			full.push_back (DCPTimePeriod(i->position(), i->end(film)));
+			_full[i] = DCPTimePeriod(i->position(), i->end(film));
 		}
 	}
 
+	setup_periods (length);
+}
+
+
+/** Update our periods after a change to one piece of content, which must already have been
+ *  in the playlist that we were made with.
+ *  @param length New length of the playlist.
+ */
+void
+Empty::update (shared_ptr<const Film> film, shared_ptr<const Content> content, DCPTime length)
+{
+	if (!_part) {
+		/* We were made empty, with no playlist */
+		return;
+	}
+
+	_full.erase (content);
+	if (_part(content) && content->paths_valid()) {
+		_full[content] = DCPTimePeriod(content->position(), content->end(film));
+	}
+
+	setup_periods (length);
+}
+
+
+void
+Empty::setup_periods (DCPTime length)
+{
+	list<DCPTimePeriod> full;
+	for (auto const& i: _full) {
+		full.push_back (i.second);
+	}
+	/* coalesce() only merges neighbours, so it needs the periods in order */
+	full.sort ([](DCPTimePeriod const& a, DCPTimePeriod const& b) {
+		return a.from < b.from;
+	});
+
 	_periods = subtract (DCPTimePeriod(DCPTime(), length), coalesce(full));
 
+	_position = DCPTime();
 	if (!_periods.empty()) {
 		_position = _periods.front().from;
 	}
@@ -26,12 +26,15 @@
 #include "playlist.h"
 #include "dcpomatic_time.h"
 #include "content_part.h"
+#include <functional>
 #include <list>
+#include <map>
 
 
 struct empty_test1;
 struct empty_test2;
 struct empty_test3;
+struct empty_test_update;
 struct empty_test_with_overlapping_content;
 struct player_subframe_test;
 
@@ -52,13 +55,22 @@ public:
 
 	void set_position (dcpomatic::DCPTime amount);
 
+	void update (std::shared_ptr<const Film> film, std::shared_ptr<const Content> content, dcpomatic::DCPTime length);
+
 private:
 	friend struct ::empty_test1;
 	friend struct ::empty_test2;
 	friend struct ::empty_test3;
+	friend struct ::empty_test_update;
 	friend struct ::empty_test_with_overlapping_content;
 	friend struct ::player_subframe_test;
 
+	void setup_periods (dcpomatic::DCPTime length);
+
+	/** function to say whether some content is of the kind whose absence we are looking for */
+	std::function<bool (std::shared_ptr<const Content>)> _part;
+	/** periods covered by each piece of content of that kind */
+	std::map<std::shared_ptr<const Content>, dcpomatic::DCPTimePeriod> _full;
 	std::list<dcpomatic::DCPTimePeriod> _periods;
 	dcpomatic::DCPTime _position;
 };
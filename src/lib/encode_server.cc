@@ -25,6 +25,7 @@
  */
 
 
+#include "binary_descriptor.h"
 #include "encode_server.h"
 #include "util.h"
 #include "dcpomatic_socket.h"
@@ -37,6 +38,7 @@
 #include "log.h"
 #include "dcpomatic_log.h"
 #include "encoded_log_entry.h"
+#include "metrics.h"
 #include "version.h"
 #include <dcp/raw_convert.h>
 #include <dcp/warnings.h>
@@ -49,6 +51,8 @@ LIBDCP_ENABLE_WARNINGS
 #ifdef HAVE_VALGRIND_H
 #include <valgrind/memcheck.h>
 #endif
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -64,6 +68,7 @@ using std::cerr;
 using std::fixed;
 using std::shared_ptr;
 using std::make_shared;
+using std::make_pair;
 using boost::thread;
 using boost::bind;
 using boost::scoped_array;
@@ -73,14 +78,26 @@ using dcp::Size;
 using dcp::raw_convert;
 
 
+static void
+set_queue_metric (int frames)
+{
+	static auto& metric = Metrics::instance()->gauge("dcpomatic_server_queue_frames", "Frames waiting to be encoded by this server");
+	metric.set (frames);
+}
+
+
 EncodeServer::EncodeServer (bool verbose, int num_threads)
 #if !defined(RUNNING_ON_VALGRIND) || RUNNING_ON_VALGRIND == 0
 	: Server (ENCODE_FRAME_PORT)
 #else
 	: Server (ENCODE_FRAME_PORT, 2400)
 #endif
+	/* Enough for all the requests that we will queue, and some more on their way in */
+	, _buffers (num_threads * 4)
 	, _verbose (verbose)
 	, _num_threads (num_threads)
+	, _key (Config::instance()->encode_server_key())
+	, _history (100)
 {
 
 }
@@ -94,13 +111,16 @@ EncodeServer::~EncodeServer ()
 		boost::mutex::scoped_lock lm (_mutex);
 		_terminate = true;
 		_empty_condition.notify_all ();
-		_full_condition.notify_all ();
 	}
 
 	try {
 		_worker_threads.join_all ();
 	} catch (...) {}
 
+	for (auto i: _connections) {
+		i->socket->close ();
+	}
+
 	{
 		boost::mutex::scoped_lock lm (_broadcast.mutex);
 		if (_broadcast.socket) {
@@ -117,119 +137,632 @@ EncodeServer::~EncodeServer ()
 }
 
 
-/** @param after_read Filled in with gettimeofday() after reading the input from the network.
- *  @param after_encode Filled in with gettimeofday() after encoding the image.
+/** Largest request that we will accept, in bytes; this is more than enough for an
+ *  uncompressed 4K frame with 16-bit RGB.
+ */
+static uint32_t const maximum_request_size = 256 * 1024 * 1024;
+
+
+static uint32_t
+read_uint32 (uint8_t const* data)
+{
+	return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+
+static void
+write_uint32 (uint8_t* data, uint32_t value)
+{
+	data[0] = (value >> 24) & 0xff;
+	data[1] = (value >> 16) & 0xff;
+	data[2] = (value >> 8) & 0xff;
+	data[3] = value & 0xff;
+}
+
+
+/** @return Time now in seconds */
+static double
+time_now ()
+{
+	struct timeval now;
+	gettimeofday (&now, 0);
+	return seconds (now);
+}
+
+
+/** @return Priority that a client gave a request, looking at as little of the request as we can */
+static int
+request_priority (vector<uint8_t> const& data)
+{
+	if (data.size() < 4) {
+		throw NetworkError (_("Frame description from client is too short"));
+	}
+
+	int priority = 0;
+	auto const length = read_uint32 (data.data());
+	if (length == DCPVideo::binary_request_marker) {
+		if (data.size() < 8) {
+			throw NetworkError (_("Frame description from client is too short"));
+		}
+		/* Skip the marker and the descriptor length */
+		BinaryDescriptorReader reader (data.data() + 8, data.size() - 8);
+		reader.read_int32 ();
+		priority = reader.read_int32 ();
+	} else {
+		if (length == 0 || length > data.size() - 4 || data[length + 3] != 0) {
+			throw NetworkError (_("Frame description from client is corrupt"));
+		}
+		auto xml = make_shared<cxml::Document>("EncodingRequest");
+		xml->read_string (string(reinterpret_cast<char const*>(data.data() + 4)));
+		priority = xml->optional_number_child<int>("Priority").get_value_or(0);
+	}
+
+	return std::max(-4, std::min(4, priority));
+}
+
+
+/** Parse a request which has been received from a client.
+ *  @return Frame to encode, or nullptr if the client is not using the right protocol.
  */
-int
-EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, struct timeval& after_encode)
+shared_ptr<DCPVideo>
+EncodeServer::parse_request (Request const& request)
 {
-	Socket::ReadDigestScope ds (socket);
+	auto socket = make_shared<Socket>();
+	socket->set_read_buffer (request.data->data(), request.data->size());
 
 	auto length = socket->read_uint32 ();
+
+	if (length == DCPVideo::binary_request_marker) {
+		length = socket->read_uint32 ();
+		if (length > request.data->size()) {
+			throw NetworkError (_("Frame description from client is too short"));
+		}
+		vector<uint8_t> buffer (length);
+		socket->read (buffer.data(), buffer.size());
+		BinaryDescriptorReader reader (buffer.data(), buffer.size());
+		if (reader.read_int32() != SERVER_LINK_VERSION) {
+			return {};
+		}
+		/* Priority, which we already know */
+		reader.read_int32 ();
+		return make_shared<DCPVideo>(reader, socket);
+	}
+
 	scoped_array<char> buffer (new char[length]);
 	socket->read (reinterpret_cast<uint8_t*>(buffer.get()), length);
 
 	string s (buffer.get());
 	auto xml = make_shared<cxml::Document>("EncodingRequest");
 	xml->read_string (s);
-	/* This is a double-check; the server shouldn't even be on the candidate list
-	   if it is the wrong version, but it doesn't hurt to make sure here.
-	*/
-	if (xml->number_child<int> ("Version") != SERVER_LINK_VERSION) {
-		cerr << "Mismatched server/client versions\n";
-		LOG_ERROR_NC ("Mismatched server/client versions");
-		return -1;
+	if (xml->number_child<int>("Version") != SERVER_LINK_VERSION) {
+		return {};
 	}
 
-	auto pvf = make_shared<PlayerVideo>(xml, socket);
+	return make_shared<DCPVideo>(make_shared<PlayerVideo>(xml, socket), xml);
+}
 
-	if (!ds.check()) {
-		throw NetworkError ("Checksums do not match");
-	}
 
-	DCPVideo dcp_video_frame (pvf, xml);
+/** Start the handshake with a client, in which we agree which digest we will use to check
+ *  requests and replies and whether they are encrypted, after which we will start reading
+ *  requests from it.  Alternatively the client might just want to know about us.
+ */
+void
+EncodeServer::start_negotiation (shared_ptr<Connection> connection)
+{
+	connection->socket->async_read (connection->header, 4, [this, connection](boost::system::error_code const& ec) {
+		if (ec) {
+			finish (connection);
+			return;
+		}
+
+		auto const marker = read_uint32 (connection->header);
 
-	gettimeofday (&after_read, 0);
+		if (marker == EncodeServerConnection::status_request_marker) {
+			auto const xml = presence ();
+			auto reply = make_shared<vector<uint8_t>>(4 + xml.length() + 1);
+			write_uint32 (reply->data(), xml.length() + 1);
+			memcpy (reply->data() + 4, xml.c_str(), xml.length() + 1);
+			connection->close_when_sent = true;
+			queue_reply (connection, reply);
+			return;
+		}
 
-	auto encoded = dcp_video_frame.encode_locally ();
+		if (marker != EncodeServerConnection::digest_negotiation_marker) {
+			/* This is a double-check; the server shouldn't even be on the candidate list
+			   if it is the wrong version, but it doesn't hurt to make sure here.
+			*/
+			cerr << "Mismatched server/client versions\n";
+			LOG_ERROR_NC ("Mismatched server/client versions");
+			finish (connection);
+			return;
+		}
 
-	gettimeofday (&after_encode, 0);
+		connection->socket->async_read (connection->header + 4, 8, [this, connection](boost::system::error_code const& ec) {
+			if (ec) {
+				finish (connection);
+				return;
+			}
 
-	try {
-		Socket::WriteDigestScope ds (socket);
-		socket->write (encoded.size());
-		socket->write (encoded.data(), encoded.size());
-	} catch (std::exception& e) {
-		cerr << "Send failed; frame " << dcp_video_frame.index() << "\n";
-		LOG_ERROR ("Send failed; frame %1", dcp_video_frame.index());
-		throw;
+			if (!(read_uint32(connection->header + 8) & EncodeServerConnection::encrypted_flag)) {
+				negotiate (connection);
+				return;
+			}
+
+			connection->socket->async_read (connection->handshake, LinkCipher::nonce_size, [this, connection](boost::system::error_code const& ec) {
+				if (ec) {
+					finish (connection);
+					return;
+				}
+				negotiate (connection);
+			});
+		});
+	});
+}
+
+
+/** Called when we have had the whole of the client's side of the handshake, apart from its proof */
+void
+EncodeServer::negotiate (shared_ptr<Connection> connection)
+{
+	auto algorithm = static_cast<Digester::Algorithm>(read_uint32(connection->header + 4));
+	if (algorithm != Digester::Algorithm::MD5 && algorithm != Digester::Algorithm::CRC32C) {
+		algorithm = Digester::Algorithm::MD5;
+	}
+	connection->digest_algorithm = algorithm;
+
+	auto const flags = read_uint32 (connection->header + 8);
+	auto const encrypted = static_cast<bool>(flags & EncodeServerConnection::encrypted_flag);
+	auto const local = !encrypted && !_key && connection->loopback && (flags & EncodeServerConnection::local_flag);
+
+	auto reply = make_shared<vector<uint8_t>>(8);
+	write_uint32 (reply->data(), static_cast<uint32_t>(algorithm));
+	write_uint32 (reply->data() + 4, (_key ? EncodeServerConnection::encrypted_flag : 0) | (local ? EncodeServerConnection::local_flag : 0));
+
+	if (encrypted != static_cast<bool>(_key)) {
+		/* Tell the client what we want, so that it can give a helpful error, then stop */
+		LOG_ERROR ("Client %1 %2 a key but we %3", connection->ip, encrypted ? "has" : "does not have", _key ? "do" : "do not");
+		connection->close_when_sent = true;
+		queue_reply (connection, reply);
+		return;
+	}
+
+	if (!encrypted) {
+		queue_reply (connection, reply);
+		if (local) {
+			open_ring (connection);
+		} else {
+			start_read (connection);
+		}
+		return;
 	}
 
-	return dcp_video_frame.index ();
+	uint8_t nonce[LinkCipher::nonce_size];
+	LinkCipher::random_nonce (nonce);
+	connection->cipher.reset (new LinkCipher(*_key, connection->handshake, nonce, false));
+	auto const proof = connection->cipher->proof ();
+	reply->insert (reply->end(), nonce, nonce + LinkCipher::nonce_size);
+	reply->insert (reply->end(), proof.begin(), proof.end());
+	queue_reply (connection, reply);
+
+	connection->socket->async_read (connection->handshake, LinkCipher::proof_size, [this, connection](boost::system::error_code const& ec) {
+		if (ec) {
+			finish (connection);
+			return;
+		}
+		check_client_proof (connection);
+	});
 }
 
 
 void
-EncodeServer::worker_thread ()
+EncodeServer::check_client_proof (shared_ptr<Connection> connection)
 {
-	while (true) {
-		boost::mutex::scoped_lock lock (_mutex);
-		while (_queue.empty () && !_terminate) {
-			_empty_condition.wait (lock);
+	if (!connection->cipher->check_proof(connection->handshake)) {
+		cerr << "Client " << connection->ip << " has the wrong key\n";
+		LOG_ERROR ("Client %1 has the wrong key", connection->ip);
+		finish (connection);
+		return;
+	}
+
+	start_read (connection);
+}
+
+
+/** Read the name of the SharedMemoryRing that a client on the same host wants to put
+ *  its requests in, and try to open it.
+ */
+void
+EncodeServer::open_ring (shared_ptr<Connection> connection)
+{
+	connection->socket->async_read (connection->header, 4, [this, connection](boost::system::error_code const& ec) {
+		if (ec) {
+			finish (connection);
+			return;
 		}
 
-		if (_terminate) {
+		auto const length = read_uint32 (connection->header);
+		if (length == 0 || length > 64) {
+			LOG_ERROR ("Bad shared memory name from %1", connection->ip);
+			finish (connection);
+			return;
+		}
+
+		connection->ring_name.resize (length);
+		connection->socket->async_read (connection->ring_name.data(), length, [this, connection](boost::system::error_code const& ec) {
+			if (ec) {
+				finish (connection);
+				return;
+			}
+
+			string const name (connection->ring_name.begin(), connection->ring_name.end());
+			if (SharedMemoryRing::valid_name(name)) {
+				try {
+					connection->ring.reset (new SharedMemoryRing(name));
+				} catch (std::exception& e) {
+					LOG_WARNING ("Could not open shared memory from %1 (%2)", connection->ip, e.what());
+				}
+			}
+
+			auto reply = make_shared<vector<uint8_t>>(4);
+			write_uint32 (reply->data(), connection->ring ? 1 : 0);
+			queue_reply (connection, reply);
+			start_read (connection);
+		});
+	});
+}
+
+
+/** Start reading the next request from a client; requests are a length, then that
+ *  many bytes, then a digest of the two.
+ */
+void
+EncodeServer::start_read (shared_ptr<Connection> connection)
+{
+	connection->socket->async_read (connection->header, 4, [this, connection](boost::system::error_code const& ec) {
+		if (ec) {
+			finish (connection);
 			return;
 		}
 
-		auto socket = _queue.front ();
-		_queue.pop_front ();
+		auto const length = read_uint32 (connection->header);
+		if (length > maximum_request_size) {
+			LOG_ERROR ("Request of %1 bytes from %2 is too big", length, connection->ip);
+			finish (connection);
+			return;
+		}
+
+		connection->start = time_now ();
+		Digester digester (connection->digest_algorithm);
+		connection->request = _buffers.get (length + digester.size());
+		connection->socket->async_read (connection->request->data(), connection->request->size(), [this, connection](boost::system::error_code const& ec) {
+			if (ec) {
+				finish (connection);
+				return;
+			}
+			try {
+				received (connection);
+				start_read (connection);
+			} catch (std::exception& e) {
+				LOG_ERROR ("Bad request from %1 (%2)", connection->ip, e.what());
+				finish (connection);
+			}
+		});
+	});
+}
+
+
+/** Called when a whole request has arrived from a client */
+void
+EncodeServer::received (shared_ptr<Connection> connection)
+{
+	auto data = connection->request;
+	connection->request.reset ();
+
+	Digester digester (connection->digest_algorithm);
+	auto const length = data->size() - digester.size();
+	digester.add (connection->header, 4);
+	digester.add (data->data(), length);
+	vector<uint8_t> digest (digester.size());
+	digester.get (digest.data());
+	if (memcmp(digest.data(), data->data() + length, digest.size()) != 0) {
+		throw NetworkError ("Checksums do not match");
+	}
+	data->resize (length);
+
+	if (connection->cipher) {
+		connection->cipher->open (*data);
+	} else if (connection->ring && data->size() == 12 && read_uint32(data->data()) == EncodeServerConnection::ring_request_marker) {
+		/* The request itself is in the client's ring */
+		auto const offset = read_uint32 (data->data() + 4);
+		auto const size = read_uint32 (data->data() + 8);
+		if (size > maximum_request_size) {
+			throw NetworkError ("Request is too big");
+		}
+		data = _buffers.get (size);
+		connection->ring->get (offset, size, data->data());
+	}
+
+	Request request;
+	request.connection = connection;
+	request.data = data;
+	request.start = connection->start;
+	request.after_read = time_now ();
+	request.priority = request_priority (*data);
+
+	boost::mutex::scoped_lock lock (_mutex);
+
+	if (_terminate) {
+		return;
+	}
 
+	if (!admit(connection->ip)) {
 		lock.unlock ();
+		/* Tell the client straight away, so that it can do this frame somewhere else */
+		auto frame = parse_request (request);
+		if (frame) {
+			reply (connection, *frame, EncodeServerConnection::Status::BUSY, boost::none);
+		}
+		return;
+	}
 
-		int frame = -1;
-		string ip;
+	auto& queue = _queues[connection->ip];
+	if (queue.requests.empty()) {
+		/* This client has just become active; don't let it catch up on
+		   time that it didn't want while it was away.
+		*/
+		for (auto const& i: _queues) {
+			if (!i.second.requests.empty()) {
+				queue.served = queue.served == 0 ? i.second.served : std::min(queue.served, i.second.served);
+			}
+		}
+	}
+	queue.requests.push_back (request);
+	++_queued;
+	set_queue_metric (_queued);
+	_empty_condition.notify_all ();
+}
 
-		struct timeval start;
-		struct timeval after_read;
-		struct timeval after_encode;
-		struct timeval end;
 
-		gettimeofday (&start, 0);
+/** Stop reading from a client which has gone away or misbehaved */
+void
+EncodeServer::finish (shared_ptr<Connection> connection)
+{
+	if (_verbose) {
+		cout << "Connection from " << connection->ip << " closed\n";
+	}
+	connection->finished = true;
+	connection->socket->close ();
+}
 
-		try {
-			frame = process (socket, after_read, after_encode);
-			ip = socket->socket().remote_endpoint().address().to_string();
-		} catch (std::exception& e) {
-			cerr << "Error: " << e.what() << "\n";
-			LOG_ERROR ("Error: %1", e.what());
+
+/** Caller must hold a lock on _mutex.
+ *  @return true if we should queue another request from the client at @p ip.
+ */
+bool
+EncodeServer::admit (string const& ip) const
+{
+	auto const limit = _worker_threads.size() * 2;
+	if (_queued < limit) {
+		return true;
+	}
+
+	/* We're full, but if someone else is hogging the queue we still let this client have its share */
+	auto const existing = _queues.find (ip);
+	auto const active = _queues.size() + (existing == _queues.end() ? 1 : 0);
+	auto const queued = existing == _queues.end() ? 0 : existing->second.requests.size();
+	return queued < std::max(static_cast<size_t>(1), limit / active);
+}
+
+
+static void
+write_reply (shared_ptr<Socket> socket, DCPVideo const& frame, EncodeServerConnection::Status status, optional<ArrayData> const& encoded)
+{
+	socket->write (static_cast<uint32_t>(frame.index()));
+	socket->write (static_cast<uint32_t>(frame.eyes()));
+	socket->write (static_cast<uint32_t>(status));
+	socket->write (static_cast<uint32_t>(encoded ? encoded->size() : 0));
+	if (encoded) {
+		socket->write (encoded->data(), encoded->size());
+	}
+}
+
+
+/** Queue a reply to a request, to be sent when the connection is free; this returns
+ *  without waiting for it to go.  It can be called from any thread.
+ */
+void
+EncodeServer::reply (shared_ptr<Connection> connection, DCPVideo const& frame, EncodeServerConnection::Status status, optional<ArrayData> const& encoded)
+{
+	auto data = make_shared<vector<uint8_t>>();
+	data->reserve (20 + (encoded ? encoded->size() : 0) + 16);
+
+	auto socket = make_shared<Socket>();
+	socket->set_write_buffer (data.get());
+
+	if (connection->cipher) {
+		write_reply (socket, frame, status, encoded);
+		/* Replies must be sealed in the order that they are sent */
+		io_service().post ([this, connection, data]() {
+			queue_reply (connection, seal(connection, *data));
+		});
+		return;
+	}
+
+	socket->set_digest_algorithm (connection->digest_algorithm);
+	{
+		Socket::WriteDigestScope ds (socket);
+		write_reply (socket, frame, status, encoded);
+	}
+
+	io_service().post ([this, connection, data]() {
+		queue_reply (connection, data);
+	});
+}
+
+
+/** Encrypt a reply to send to a client; this must be called from the io_service thread.
+ *  @return The length of the sealed reply, the sealed reply and a digest of both.
+ */
+shared_ptr<vector<uint8_t>>
+EncodeServer::seal (shared_ptr<Connection> connection, vector<uint8_t> const& reply)
+{
+	auto const sealed = connection->cipher->seal (reply.data(), reply.size());
+
+	auto data = make_shared<vector<uint8_t>>();
+	data->reserve (4 + sealed.size() + 16);
+
+	auto socket = make_shared<Socket>();
+	socket->set_write_buffer (data.get());
+	socket->set_digest_algorithm (connection->digest_algorithm);
+	{
+		Socket::WriteDigestScope ds (socket);
+		socket->write (static_cast<uint32_t>(sealed.size()));
+		socket->write (sealed.data(), sealed.size());
+	}
+
+	return data;
+}
+
+
+/** Add some data to the queue of things to send to a client.  This must be called
+ *  from the io_service thread.
+ */
+void
+EncodeServer::queue_reply (shared_ptr<Connection> connection, shared_ptr<vector<uint8_t>> data)
+{
+	connection->replies.push_back (data);
+	if (connection->replies.size() == 1) {
+		start_write (connection);
+	}
+}
+
+
+/** Start sending the first thing in a connection's reply queue */
+void
+EncodeServer::start_write (shared_ptr<Connection> connection)
+{
+	auto data = connection->replies.front ();
+	connection->socket->async_write (data->data(), data->size(), [this, connection](boost::system::error_code const& ec) {
+		if (ec) {
+			cerr << "Send failed to " << connection->ip << "\n";
+			LOG_ERROR ("Send failed to %1", connection->ip);
+			connection->replies.clear ();
+			finish (connection);
+			return;
 		}
 
-		gettimeofday (&end, 0);
+		connection->replies.pop_front ();
+		if (!connection->replies.empty()) {
+			start_write (connection);
+		} else if (connection->close_when_sent) {
+			finish (connection);
+		}
+	});
+}
 
-		socket.reset ();
 
-		lock.lock ();
+/** Encode a frame and send the result back to the client that asked for it */
+void
+EncodeServer::process (Request request)
+{
+	shared_ptr<DCPVideo> frame;
+	try {
+		frame = parse_request (request);
+	} catch (std::exception& e) {
+		LOG_ERROR ("Bad request from %1 (%2)", request.connection->ip, e.what());
+		request.connection->socket->close ();
+		return;
+	}
+
+	if (!frame) {
+		cerr << "Mismatched server/client versions\n";
+		LOG_ERROR_NC ("Mismatched server/client versions");
+		request.connection->socket->close ();
+		return;
+	}
+
+	/* We don't need the request data any more, so let it go back to the pool */
+	request.data.reset ();
+
+	static auto& failures = Metrics::instance()->counter("dcpomatic_server_encode_failures_total", "Frames that this server failed to encode");
+
+	optional<ArrayData> encoded;
+	try {
+		encoded = frame->encode_locally ();
+	} catch (std::exception& e) {
+		cerr << "Encode failed; frame " << frame->index() << " (" << e.what() << ")\n";
+		LOG_ERROR ("Encode failed; frame %1 (%2)", frame->index(), e.what());
+		failures.add ();
+	}
+
+	auto const after_encode = time_now ();
+
+	reply (request.connection, *frame, encoded ? EncodeServerConnection::Status::ENCODED : EncodeServerConnection::Status::FAILED, encoded);
+	if (!encoded) {
+		return;
+	}
+
+	auto e = make_shared<EncodedLogEntry>(
+		frame->index(), request.connection->ip,
+		request.after_read - request.start,
+		after_encode - request.after_read,
+		time_now() - after_encode
+		);
+
+	if (_verbose) {
+		cout << e->get() << "\n";
+	}
+
+	dcpomatic_log->log (e);
+	_history.event ();
+
+	static auto& frames = Metrics::instance()->counter("dcpomatic_server_frames_total", "Frames that this server has encoded");
+	static auto& rate = Metrics::instance()->gauge("dcpomatic_server_frames_per_second", "Recent rate at which this server has been encoding frames");
+	static auto& encode_time = Metrics::instance()->histogram(
+		"dcpomatic_server_encode_seconds", "Time taken to encode each frame on this server", { 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 }
+		);
+	frames.add ();
+	rate.set (_history.rate().get_value_or(0));
+	encode_time.observe (after_encode - request.after_read);
+}
 
-		if (frame >= 0) {
-			struct timeval end;
-			gettimeofday (&end, 0);
 
-			auto e = make_shared<EncodedLogEntry>(
-				frame, ip,
-				seconds(after_read) - seconds(start),
-				seconds(after_encode) - seconds(after_read),
-				seconds(end) - seconds(after_encode)
-				);
+/** @param index Index of this worker, used to choose its NUMA node */
+void
+EncodeServer::worker_thread (int index)
+{
+	pin_thread_to_numa_node (index);
 
-			if (_verbose) {
-				cout << e->get() << "\n";
+	while (true) {
+		boost::mutex::scoped_lock lock (_mutex);
+		while (_queued == 0 && !_terminate) {
+			_empty_condition.wait (lock);
+		}
+
+		if (_terminate) {
+			return;
+		}
+
+		/* Serve the client which has had least of our time, allowing for its priority */
+		auto next = _queues.begin();
+		for (auto i = _queues.begin(); i != _queues.end(); ++i) {
+			if (i->second.served < next->second.served) {
+				next = i;
 			}
+		}
 
-			dcpomatic_log->log (e);
+		auto request = next->second.requests.front ();
+		next->second.requests.pop_front ();
+		next->second.served += 1.0 / pow(2, request.priority);
+		if (next->second.requests.empty()) {
+			_queues.erase (next);
 		}
+		--_queued;
+		set_queue_metric (_queued);
+
+		lock.unlock ();
 
-		_full_condition.notify_all ();
+		process (std::move(request));
 	}
 }
 
@@ -244,10 +777,10 @@ EncodeServer::run ()
 
 	for (int i = 0; i < _num_threads; ++i) {
 #ifdef DCPOMATIC_LINUX
-		boost::thread* t = _worker_threads.create_thread (bind(&EncodeServer::worker_thread, this));
+		boost::thread* t = _worker_threads.create_thread (bind(&EncodeServer::worker_thread, this, i));
 		pthread_setname_np (t->native_handle(), "encode-server-worker");
 #else
-		_worker_threads.create_thread (bind(&EncodeServer::worker_thread, this));
+		_worker_threads.create_thread (bind(&EncodeServer::worker_thread, this, i));
 #endif
 	}
 
@@ -292,11 +825,7 @@ EncodeServer::broadcast_received ()
 
 	if (strcmp (_broadcast.buffer, DCPOMATIC_HELLO) == 0) {
 		/* Reply to the client saying what we can do */
-		xmlpp::Document doc;
-		auto root = doc.create_root_node ("ServerAvailable");
-		root->add_child("Threads")->add_child_text (raw_convert<string> (_worker_threads.size ()));
-		root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
-		auto xml = doc.write_to_string ("UTF-8");
+		auto const xml = presence ();
 
 		if (_verbose) {
 			cout << "Offering services to master " << _broadcast.send_endpoint.address().to_string () << "\n";
@@ -305,8 +834,8 @@ EncodeServer::broadcast_received ()
 		try {
 			auto socket = make_shared<Socket>();
 			socket->connect (boost::asio::ip::tcp::endpoint (_broadcast.send_endpoint.address(), MAIN_SERVER_PRESENCE_PORT));
-			socket->write (xml.bytes() + 1);
-			socket->write ((uint8_t *) xml.c_str(), xml.bytes() + 1);
+			socket->write (xml.length() + 1);
+			socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
 		} catch (...) {
 
 		}
@@ -314,8 +843,8 @@ EncodeServer::broadcast_received ()
 		try {
 			auto socket = make_shared<Socket>();
 			socket->connect (boost::asio::ip::tcp::endpoint (_broadcast.send_endpoint.address(), BATCH_SERVER_PRESENCE_PORT));
-			socket->write (xml.bytes() + 1);
-			socket->write ((uint8_t *) xml.c_str(), xml.bytes() + 1);
+			socket->write (xml.length() + 1);
+			socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
 		} catch (...) {
 
 		}
@@ -331,18 +860,57 @@ EncodeServer::broadcast_received ()
 }
 
 
+/** @return ServerAvailable document saying what we can do */
+string
+EncodeServer::presence ()
+{
+	xmlpp::Document doc;
+	auto root = doc.create_root_node ("ServerAvailable");
+	root->add_child("Threads")->add_child_text (raw_convert<string> (_worker_threads.size ()));
+	root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
+	root->add_child("CPU")->add_child_text(cpu_info());
+	root->add_child("SIMD")->add_child_text(simd_features());
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		root->add_child("QueueLength")->add_child_text(raw_convert<string>(_queued));
+	}
+	if (auto rate = _history.rate()) {
+		root->add_child("FramesPerSecond")->add_child_text(raw_convert<string>(*rate));
+	}
+	return doc.write_to_string ("UTF-8");
+}
+
+
 void
 EncodeServer::handle (shared_ptr<Socket> socket)
 {
-	boost::mutex::scoped_lock lock (_mutex);
-
 	_waker.nudge ();
 
-	/* Wait until the queue has gone down a bit */
-	while (_queue.size() >= _worker_threads.size() * 2 && !_terminate) {
-		_full_condition.wait (lock);
+	auto connection = make_shared<Connection>(socket);
+	try {
+		auto const address = socket->socket().remote_endpoint().address();
+		connection->ip = address.to_string();
+		connection->loopback = address.is_loopback();
+	} catch (...) {}
+
+	{
+		boost::mutex::scoped_lock lock (_mutex);
+		if (_terminate) {
+			return;
+		}
 	}
 
-	_queue.push_back (socket);
-	_empty_condition.notify_all ();
+	/* Tidy up after any connections that have finished */
+	_connections.remove_if ([](shared_ptr<Connection> c) { return c->finished.load(); });
+	_connections.push_back (connection);
+
+	start_negotiation (connection);
+}
+
+
+shared_ptr<Socket>
+EncodeServer::create_socket (int timeout)
+{
+	/* Our sockets are all run by the io_service that accepts them */
+	return make_shared<Socket>(io_service(), timeout);
 }
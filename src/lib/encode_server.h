@@ -28,15 +28,27 @@
  */
 
 
+#include "buffer_pool.h"
 #include "cross.h"
+#include "digester.h"
+#include "encode_server_connection.h"
+#include "event_history.h"
 #include "exception_store.h"
+#include "link_cipher.h"
 #include "server.h"
+#include "shared_memory_ring.h"
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 
+class DCPVideo;
 class Log;
 class Socket;
 
@@ -44,6 +56,22 @@ class Socket;
 /** @class EncodeServer
  *  @brief A class to run a server which can accept requests to perform JPEG2000
  *  encoding work.
+ *
+ *  Each client connection can carry many requests, and the client can send new requests
+ *  before it has had replies to its earlier ones.  All the connections are read and
+ *  written asynchronously by the thread that runs the server.  Each request is received
+ *  in full into a buffer before it is put on a queue for its client, and the worker threads
+ *  take requests from the queues, parse and encode them, and queue the replies to be sent.
+ *  This means that the workers never wait for the network, however slow the clients are.
+ *
+ *  The worker threads share themselves between clients (identified by IP address)
+ *  according to the priority in each client's requests.  When the queues are full
+ *  requests from clients that are already getting their share are turned away with
+ *  a "busy" reply, so that the client can do the work elsewhere.
+ *
+ *  If Config::encode_server_key() is set only clients with the same key are served, and
+ *  their requests and our replies are encrypted.  Otherwise clients on the same host as us
+ *  can put their requests in a SharedMemoryRing rather than sending them.
  */
 class EncodeServer : public Server, public ExceptionStore
 {
@@ -54,19 +82,109 @@ public:
 	void run () override;
 
 private:
+	struct Connection
+	{
+		explicit Connection (std::shared_ptr<Socket> socket_)
+			: socket (socket_)
+		{}
+
+		std::shared_ptr<Socket> socket;
+		/** IP address of the client */
+		std::string ip;
+		/** true if the client is on the same host as us */
+		bool loopback = false;
+		/** true when we have stopped reading from the connection */
+		std::atomic<bool> finished{false};
+		/** algorithm that we agreed with the client to check requests and replies */
+		Digester::Algorithm digest_algorithm = Digester::Algorithm::MD5;
+		/** cipher for requests and replies, or nullptr if the connection is not encrypted;
+		 *  this is set up before any requests are read and only used for sealing replies
+		 *  and opening requests by the thread which runs the io_service.
+		 */
+		std::unique_ptr<LinkCipher> cipher;
+
+		/* The rest is only touched by the thread which runs the io_service */
+
+		/** start of the request which is being received */
+		uint8_t header[12];
+		/** client's nonce or proof during the handshake */
+		uint8_t handshake[LinkCipher::proof_size];
+		/** name of the client's ring, while it is being received */
+		std::vector<uint8_t> ring_name;
+		/** ring that the client puts its requests in, or nullptr */
+		std::unique_ptr<SharedMemoryRing> ring;
+		/** request which is being received, followed by its digest */
+		std::shared_ptr<std::vector<uint8_t>> request;
+		/** time that we started to receive the request, in seconds */
+		double start = 0;
+		/** replies waiting to be sent; the first one is being sent */
+		std::list<std::shared_ptr<std::vector<uint8_t>>> replies;
+		/** true to close the connection once the replies have been sent */
+		bool close_when_sent = false;
+	};
+
+	/** A request to encode a frame which has been received from a Connection */
+	struct Request
+	{
+		std::shared_ptr<Connection> connection;
+		/** the request as it came from the client */
+		std::shared_ptr<std::vector<uint8_t>> data;
+		/** time that we started to receive the request, in seconds */
+		double start = 0;
+		/** time that we finished receiving the request, in seconds */
+		double after_read = 0;
+		/** priority given by the client; each step up doubles its share of our time */
+		int priority = 0;
+	};
+
+	/** Requests from one client */
+	struct ClientQueue
+	{
+		std::list<Request> requests;
+		/** sum of 1 / weight for each request that we have taken from this queue */
+		double served = 0;
+	};
+
 	void handle (std::shared_ptr<Socket>) override;
-	void worker_thread ();
-	int process (std::shared_ptr<Socket> socket, struct timeval &, struct timeval &);
+	std::shared_ptr<Socket> create_socket (int timeout) override;
+	void start_negotiation (std::shared_ptr<Connection> connection);
+	void negotiate (std::shared_ptr<Connection> connection);
+	void check_client_proof (std::shared_ptr<Connection> connection);
+	void open_ring (std::shared_ptr<Connection> connection);
+	void start_read (std::shared_ptr<Connection> connection);
+	void received (std::shared_ptr<Connection> connection);
+	void finish (std::shared_ptr<Connection> connection);
+	std::shared_ptr<DCPVideo> parse_request (Request const& request);
+	bool admit (std::string const& ip) const;
+	void worker_thread (int index);
+	void process (Request request);
+	void reply (std::shared_ptr<Connection> connection, DCPVideo const& frame, EncodeServerConnection::Status status, boost::optional<dcp::ArrayData> const& encoded);
+	std::shared_ptr<std::vector<uint8_t>> seal (std::shared_ptr<Connection> connection, std::vector<uint8_t> const& reply);
+	void queue_reply (std::shared_ptr<Connection> connection, std::shared_ptr<std::vector<uint8_t>> data);
+	void start_write (std::shared_ptr<Connection> connection);
 	void broadcast_thread ();
 	void broadcast_received ();
+	std::string presence ();
 
 	boost::thread_group _worker_threads;
-	std::list<std::shared_ptr<Socket>> _queue;
-	boost::condition _full_condition;
+	/** Connections to clients; only touched by the thread which runs the io_service */
+	std::list<std::shared_ptr<Connection>> _connections;
+	/** Buffers to receive requests into */
+	BufferPool _buffers;
+	/** Requests that are waiting to be encoded, keyed by client IP address; there are no
+	 *  empty queues in here.
+	 */
+	std::map<std::string, ClientQueue> _queues;
+	/** total number of requests in _queues */
+	size_t _queued = 0;
 	boost::condition _empty_condition;
 	bool _verbose;
 	int _num_threads;
+	/** key that clients must have, if any */
+	boost::optional<std::string> _key;
 	Waker _waker;
+	/** History of frames that we have encoded, to work out how fast we are going */
+	EventHistory _history;
 
 	struct Broadcast {
 
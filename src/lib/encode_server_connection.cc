@@ -0,0 +1,294 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "config.h"
+#include "cross.h"
+#include "dcp_video.h"
+#include "dcpomatic_log.h"
+#include "dcpomatic_socket.h"
+#include "encode_server_connection.h"
+#include "exceptions.h"
+#include "link_cipher.h"
+#include "log.h"
+#include "shared_memory_ring.h"
+#include "util.h"
+#include <dcp/raw_convert.h>
+#include <boost/asio.hpp>
+
+#include "i18n.h"
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using dcp::raw_convert;
+
+
+/** Largest reply that we will accept from a server, in bytes */
+static uint32_t const maximum_reply_size = 64 * 1024 * 1024;
+
+/** Size of the ring that we use to send requests to a server on the same host; this
+ *  is enough for a few uncompressed 4K frames, and if it fills up requests go through
+ *  the socket instead.
+ */
+static size_t const ring_size = 256 * 1024 * 1024;
+
+
+static boost::asio::ip::tcp::endpoint
+resolve (string host_name)
+{
+	boost::asio::io_service io_service;
+	boost::asio::ip::tcp::resolver resolver (io_service);
+	boost::asio::ip::tcp::resolver::query query (host_name, raw_convert<string>(ENCODE_FRAME_PORT));
+	return *resolver.resolve (query);
+}
+
+
+/** @return Time now in seconds */
+static double
+time_now ()
+{
+	struct timeval now;
+	gettimeofday (&now, 0);
+	return seconds (now);
+}
+
+
+/** Connect to a server.
+ *  @param server Server to connect to.
+ *  @param timeout Timeout for each network operation, in seconds.
+ */
+EncodeServerConnection::EncodeServerConnection (EncodeServerDescription server, int timeout)
+	: _socket (make_shared<Socket>(timeout))
+{
+	_socket->set_send_buffer_size (512 * 1024);
+	_socket->connect (resolve(server.host_name()));
+
+	auto const key = Config::instance()->encode_server_key ();
+	uint8_t client_nonce[LinkCipher::nonce_size];
+
+	if (!key && _socket->socket().remote_endpoint().address().is_loopback()) {
+		try {
+			_ring.reset (new SharedMemoryRing(ring_size));
+		} catch (std::exception& e) {
+			LOG_WARNING ("Could not create shared memory for encode server (%1)", e.what());
+		}
+	}
+
+	auto const start = time_now ();
+	_socket->write (digest_negotiation_marker);
+	_socket->write (static_cast<uint32_t>(Digester::Algorithm::CRC32C));
+	_socket->write ((key ? encrypted_flag : 0) | (_ring ? local_flag : 0));
+	if (key) {
+		LinkCipher::random_nonce (client_nonce);
+		_socket->write (client_nonce, LinkCipher::nonce_size);
+	}
+
+	auto const algorithm = static_cast<Digester::Algorithm>(_socket->read_uint32());
+	auto const flags = _socket->read_uint32 ();
+	_round_trip_time = time_now() - start;
+
+	if (algorithm != Digester::Algorithm::MD5 && algorithm != Digester::Algorithm::CRC32C) {
+		throw NetworkError (_("Encode server asked for an unknown checksum"));
+	}
+	_socket->set_digest_algorithm (algorithm);
+
+	if ((flags & encrypted_flag) && !key) {
+		throw NetworkError (String::compose(_("Encode server %1 needs a key, but none has been set up"), server.host_name()));
+	} else if (!(flags & encrypted_flag) && key) {
+		throw NetworkError (String::compose(_("Encode server %1 has not been set up with a key"), server.host_name()));
+	}
+
+	if (key) {
+		uint8_t server_nonce[LinkCipher::nonce_size];
+		_socket->read (server_nonce, LinkCipher::nonce_size);
+		uint8_t server_proof[LinkCipher::proof_size];
+		_socket->read (server_proof, LinkCipher::proof_size);
+		_cipher.reset (new LinkCipher(*key, client_nonce, server_nonce, true));
+		if (!_cipher->check_proof(server_proof)) {
+			throw NetworkError (String::compose(_("Encode server %1 has a different key to ours"), server.host_name()));
+		}
+		auto const proof = _cipher->proof ();
+		_socket->write (proof.data(), proof.size());
+	}
+
+	if (_ring && (flags & local_flag)) {
+		auto const name = _ring->name ();
+		_socket->write (static_cast<uint32_t>(name.length()));
+		_socket->write (reinterpret_cast<uint8_t const*>(name.c_str()), name.length());
+		if (_socket->read_uint32()) {
+			/* The server has it open now, so nobody else needs to be able to find it */
+			_ring->unlink ();
+			LOG_DEBUG_ENCODE ("Using shared memory to send frames to %1", server.host_name());
+		} else {
+			_ring.reset ();
+		}
+	} else {
+		_ring.reset ();
+	}
+}
+
+
+/* This is here so that the header does not need to know what a LinkCipher is */
+EncodeServerConnection::~EncodeServerConnection ()
+{
+
+}
+
+
+/** Send a frame to be encoded.  This returns once the frame has been sent, without
+ *  waiting for the encoded version to come back.
+ */
+void
+EncodeServerConnection::send (DCPVideo const& frame, EncodeRequestFormat format)
+{
+	LOG_DEBUG_ENCODE (N_("Sending frame %1 to remote"), frame.index());
+	send (frame.request(format));
+}
+
+
+/** Send a request made by DCPVideo::request(), perhaps some time ago (so that recorded
+ *  requests can be replayed to a server).  This returns once the request has been sent.
+ */
+void
+EncodeServerConnection::send (vector<uint8_t> request)
+{
+	if (_cipher) {
+		request = _cipher->seal (request.data(), request.size());
+	} else if (_ring) {
+		auto const offset = _ring->put (request.data(), request.size());
+		_in_ring.push_back (static_cast<bool>(offset));
+		if (offset) {
+			/* Just say where it is */
+			vector<uint8_t> position;
+			auto socket = make_shared<Socket>();
+			socket->set_write_buffer (&position);
+			socket->write (ring_request_marker);
+			socket->write (static_cast<uint32_t>(*offset));
+			socket->write (static_cast<uint32_t>(request.size()));
+			request = std::move(position);
+		}
+	}
+
+	LOG_TIMING("start-remote-send thread=%1", thread_id ());
+	Socket::WriteDigestScope ds (_socket);
+	_socket->write (static_cast<uint32_t>(request.size()));
+	_socket->write (request.data(), request.size());
+	LOG_TIMING("finish-remote-send thread=%1", thread_id ());
+}
+
+
+static EncodeServerConnection::Reply
+read_reply (shared_ptr<Socket> socket)
+{
+	EncodeServerConnection::Reply reply;
+	reply.index = socket->read_uint32 ();
+	reply.eyes = static_cast<Eyes>(socket->read_uint32());
+	reply.status = static_cast<EncodeServerConnection::Status>(socket->read_uint32());
+	auto const size = socket->read_uint32 ();
+	if (size > maximum_reply_size) {
+		throw NetworkError (_("Reply from encode server is too big"));
+	}
+	if (reply.status == EncodeServerConnection::Status::ENCODED) {
+		LOG_TIMING("start-remote-receive thread=%1", thread_id());
+		dcp::ArrayData encoded (size);
+		socket->read (encoded.data(), encoded.size());
+		reply.encoded = std::move(encoded);
+		LOG_TIMING("finish-remote-receive thread=%1", thread_id());
+	}
+	return reply;
+}
+
+
+/** Wait for an encoded frame to come back from the server */
+EncodeServerConnection::Reply
+EncodeServerConnection::receive ()
+{
+	LOG_TIMING("start-remote-encode thread=%1", thread_id());
+
+	if (!_cipher) {
+		Socket::ReadDigestScope ds (_socket);
+		auto reply = read_reply (_socket);
+		if (!ds.check()) {
+			throw NetworkError ("Checksums do not match");
+		}
+		if (!_in_ring.empty()) {
+			/* The server takes requests out of the ring in the order that we sent them, before
+			   it replies to them, so now that we have a reply it must have finished with the
+			   oldest request that we are waiting for.
+			*/
+			if (_in_ring.front()) {
+				_ring->release ();
+			}
+			_in_ring.pop_front ();
+		}
+		return reply;
+	}
+
+	/* Encrypted replies are a length, then the sealed reply */
+	vector<uint8_t> sealed;
+	{
+		Socket::ReadDigestScope ds (_socket);
+		auto const size = _socket->read_uint32 ();
+		if (size > maximum_reply_size) {
+			throw NetworkError (_("Reply from encode server is too big"));
+		}
+		sealed.resize (size);
+		_socket->read (sealed.data(), sealed.size());
+		if (!ds.check()) {
+			throw NetworkError ("Checksums do not match");
+		}
+	}
+
+	_cipher->open (sealed);
+	auto socket = make_shared<Socket>();
+	socket->set_read_buffer (sealed.data(), sealed.size());
+	return read_reply (socket);
+}
+
+
+/** Ask a server to describe itself, without asking it to do anything.
+ *  @param host_name Host name or IP address of the server.
+ *  @param timeout Timeout for each network operation, in seconds.
+ */
+EncodeServerConnection::ServerStatus
+EncodeServerConnection::server_status (string host_name, int timeout)
+{
+	auto socket = make_shared<Socket>(timeout);
+	socket->connect (resolve(host_name));
+	socket->write (status_request_marker);
+
+	auto const length = socket->read_uint32 ();
+	if (length == 0 || length > 65536) {
+		throw NetworkError (_("Encode server sent a bad description of itself"));
+	}
+
+	vector<uint8_t> buffer (length);
+	socket->read (buffer.data(), buffer.size());
+	buffer.back() = '\0';
+
+	ServerStatus status;
+	status.ip = socket->socket().remote_endpoint().address().to_string();
+	status.xml = reinterpret_cast<char const*>(buffer.data());
+	return status;
+}
@@ -0,0 +1,144 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_ENCODE_SERVER_CONNECTION_H
+#define DCPOMATIC_ENCODE_SERVER_CONNECTION_H
+
+
+#include "encode_server_description.h"
+#include "types.h"
+#include <dcp/array_data.h>
+#include <boost/optional.hpp>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+class DCPVideo;
+class LinkCipher;
+class SharedMemoryRing;
+class Socket;
+
+
+/** @class EncodeServerConnection
+ *  @brief A connection to an EncodeServer which can be used for many frames.
+ *
+ *  Requests can be sent with send() before the replies to earlier ones have come back
+ *  with receive(), so that the server always has the next frame to hand when it finishes
+ *  one.  Replies are not necessarily in the same order as the requests.
+ *
+ *  Requests and replies are checked with CRC-32C rather than MD5 if the server agrees,
+ *  since MD5 is slow enough to hold up a fast network.
+ *
+ *  If Config::encode_server_key() is set the server must have the same key, and everything
+ *  after the first exchange is encrypted and authenticated with it, so that servers can be
+ *  used over links that we do not trust (such as the internet).
+ *
+ *  If the server is on the same host as us (and there is no key) requests are put in a
+ *  SharedMemoryRing, and only their positions in it are sent through the socket.
+ */
+class EncodeServerConnection
+{
+public:
+	EncodeServerConnection (EncodeServerDescription server, int timeout = 30);
+	~EncodeServerConnection ();
+
+	EncodeServerConnection (EncodeServerConnection const&) = delete;
+	EncodeServerConnection& operator= (EncodeServerConnection const&) = delete;
+
+	/** What happened to a request */
+	enum class Status
+	{
+		/** the server encoded the frame */
+		ENCODED = 0,
+		/** the server tried to encode the frame, but failed */
+		FAILED = 1,
+		/** the server is too busy to take the frame at the moment */
+		BUSY = 2
+	};
+
+	struct Reply
+	{
+		int index;
+		Eyes eyes;
+		Status status;
+		/** encoded data, if status is ENCODED */
+		boost::optional<dcp::ArrayData> encoded;
+	};
+
+	void send (DCPVideo const& frame, EncodeRequestFormat format = EncodeRequestFormat::BINARY);
+	void send (std::vector<uint8_t> request);
+	Reply receive ();
+
+	/** @return time that the server took to answer us when we connected, in seconds */
+	double round_trip_time () const {
+		return _round_trip_time;
+	}
+
+	struct ServerStatus
+	{
+		/** IP address that we reached the server on */
+		std::string ip;
+		/** ServerAvailable XML document describing the server */
+		std::string xml;
+	};
+
+	static ServerStatus server_status (std::string host_name, int timeout);
+
+	/** Sent by the client as soon as it connects, followed by the Digester::Algorithm
+	 *  that it would like to use to check requests and replies and some flags.  If the
+	 *  encrypted_flag is set a LinkCipher::nonce_size nonce follows.  The server replies with
+	 *  the algorithm that they will actually use and their flags, and if the connection is
+	 *  encrypted their nonce and their proof; then the client sends its proof.
+	 */
+	static uint32_t const digest_negotiation_marker = 0xfffffffe;
+	/** Sent by a client which only wants the server to describe itself; the server replies
+	 *  with the length of a ServerAvailable XML document, then the document.
+	 */
+	static uint32_t const status_request_marker = 0xfffffffd;
+
+	/** Sent by the client in place of a request to say that the request is in its
+	 *  SharedMemoryRing; the offset and size of the request follow.
+	 */
+	static uint32_t const ring_request_marker = 0xfffffffc;
+
+	static uint32_t const encrypted_flag = 0x1;
+	/** Set by a client which is on the same host as the server and would like to send
+	 *  requests through shared memory.  If the server agrees it sets the flag in its reply,
+	 *  and the client then sends the length of its ring's name and the name.  The server
+	 *  replies with 1 if it could open the ring, or 0 if not.
+	 */
+	static uint32_t const local_flag = 0x2;
+
+private:
+	std::shared_ptr<Socket> _socket;
+	/** cipher for everything after the handshake, or nullptr if the connection is not encrypted */
+	std::unique_ptr<LinkCipher> _cipher;
+	/** ring that we put requests in, or nullptr if the server is not using one */
+	std::unique_ptr<SharedMemoryRing> _ring;
+	/** for each request whose reply we are waiting for (oldest first), true if it is in _ring */
+	std::deque<bool> _in_ring;
+	double _round_trip_time = 0;
+};
+
+
+#endif
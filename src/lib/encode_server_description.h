@@ -23,6 +23,8 @@
 
 #include "types.h"
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
 
 /** @class EncodeServerDescription
  *  @brief Class to describe a server to which we can send encoding work.
@@ -72,6 +74,49 @@ public:
 		_threads = t;
 	}
 
+	/** @return description of the server's CPU, or an empty string if we don't know */
+	std::string cpu () const {
+		return _cpu;
+	}
+
+	/** @return space-separated list of the SIMD instruction sets that the server's CPU supports */
+	std::string simd () const {
+		return _simd;
+	}
+
+	/** @return number of frames that were waiting to be encoded on the server when it last told us */
+	int queue_length () const {
+		return _queue_length;
+	}
+
+	/** @return rate at which the server has recently been encoding frames (for all of its clients), if known */
+	boost::optional<float> frames_per_second () const {
+		return _frames_per_second;
+	}
+
+	/** @return number of threads that a master should use to send work to this server,
+	 *  taking into account how busy it is with work from other clients.
+	 */
+	int threads_to_use () const {
+		/* A server whose queue is full is already being kept busy, so just use half of
+		   its threads to get our share of it without swamping it.
+		*/
+		if (_queue_length >= _threads * 2) {
+			return std::max(1, _threads / 2);
+		}
+		return _threads;
+	}
+
+	void set_capabilities (std::string cpu, std::string simd) {
+		_cpu = cpu;
+		_simd = simd;
+	}
+
+	void set_load (int queue_length, boost::optional<float> frames_per_second) {
+		_queue_length = queue_length;
+		_frames_per_second = frames_per_second;
+	}
+
 	void set_seen () {
 		_last_seen = boost::posix_time::second_clock::local_time();
 	}
@@ -87,6 +132,10 @@ private:
 	int _threads;
 	/** server link (i.e. protocol) version number */
 	int _link_version;
+	std::string _cpu;
+	std::string _simd;
+	int _queue_length = 0;
+	boost::optional<float> _frames_per_second;
 	boost::posix_time::ptime _last_seen;
 };
 
@@ -24,13 +24,14 @@
 #include "util.h"
 #include "config.h"
 #include "cross.h"
+#include "encode_server_connection.h"
 #include "encode_server_description.h"
 #include "dcpomatic_socket.h"
-#include <dcp/raw_convert.h>
 #include <libcxml/cxml.h>
 #include <boost/bind/placeholders.hpp>
 #include <boost/lambda/lambda.hpp>
 #include <iostream>
+#include <iterator>
 
 #include "i18n.h"
 
@@ -47,7 +48,6 @@ using boost::scoped_array;
 #if BOOST_VERSION >= 106100
 using namespace boost::placeholders;
 #endif
-using dcp::raw_convert;
 
 
 EncodeServerFinder* EncodeServerFinder::_instance = 0;
@@ -131,13 +131,14 @@ try
 			}
 		}
 
-		/* Query our `definite' servers (if there are any) */
+		/* Ask our `definite' servers (if there are any) about themselves.  We do this on the
+		   connection that we would send them frames on, rather than asking them to connect back
+		   to us, so that it still works when they are on the other side of a firewall or NAT.
+		*/
 		for (auto const& i: Config::instance()->servers()) {
 			try {
-				boost::asio::ip::udp::resolver resolver (io_service);
-				boost::asio::ip::udp::resolver::query query (i, raw_convert<string>(HELLO_PORT));
-				boost::asio::ip::udp::endpoint end_point (*resolver.resolve(query));
-				socket.send_to (boost::asio::buffer(data.c_str(), data.size() + 1), end_point);
+				auto status = EncodeServerConnection::server_status (i, interval / 2);
+				server_found (status.ip, status.xml);
 			} catch (...) {
 
 			}
@@ -236,10 +237,26 @@ EncodeServerFinder::handle_accept (boost::system::error_code ec)
 		return;
 	}
 
+	try {
+		server_found (_accept_socket->socket().remote_endpoint().address().to_string(), server_available);
+	} catch (...) {
+		/* Probably a garbled description; we'll hear from the server again soon enough */
+	}
+
+	start_accept ();
+}
+
+
+/** Called when a server has told us about itself.
+ *  @param ip Server's IP address.
+ *  @param server_available ServerAvailable XML document that the server sent.
+ */
+void
+EncodeServerFinder::server_found (string ip, string server_available)
+{
 	auto xml = make_shared<cxml::Document>("ServerAvailable");
 	xml->read_string(server_available);
 
-	auto const ip = _accept_socket->socket().remote_endpoint().address().to_string();
 	bool changed = false;
 	{
 		boost::mutex::scoped_lock lm (_servers_mutex);
@@ -252,16 +269,18 @@ EncodeServerFinder::handle_accept (boost::system::error_code ec)
 			i->set_seen();
 		} else {
 			EncodeServerDescription sd (ip, xml->number_child<int>("Threads"), xml->optional_number_child<int>("Version").get_value_or(0));
+			sd.set_capabilities (xml->optional_string_child("CPU").get_value_or(""), xml->optional_string_child("SIMD").get_value_or(""));
 			_servers.push_back (sd);
+			i = std::prev(_servers.end());
 			changed = true;
 		}
+
+		i->set_load (xml->optional_number_child<int>("QueueLength").get_value_or(0), xml->optional_number_child<float>("FramesPerSecond"));
 	}
 
 	if (changed) {
 		emit (boost::bind(boost::ref (ServersListChanged)));
 	}
-
-	start_accept ();
 }
 
 
@@ -42,7 +42,8 @@ class Socket;
  *  configuration it finds servers by:
  *
  *  1. broadcasting a request to the local subnet and
- *  2. checking to see if any of the configured server hosts are up.
+ *  2. asking each of the configured server hosts to describe itself over TCP, which
+ *     works even if they are not on the local network.
  */
 class EncodeServerFinder : public Signaller, public ExceptionStore
 {
@@ -68,6 +69,7 @@ private:
 
 	void start_accept ();
 	void handle_accept (boost::system::error_code ec);
+	void server_found (std::string ip, std::string server_available);
 
 	void config_changed (Config::Property what);
 
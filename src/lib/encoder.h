@@ -23,6 +23,7 @@
 #define DCPOMATIC_ENCODER_H
 
 
+#include "performance_report.h"
 #include "player.h"
 #include "player_text.h"
 #include "types.h"
@@ -60,6 +61,16 @@ public:
 	virtual Frame frames_done () const = 0;
 	virtual bool finishing () const = 0;
 
+	/** @return a warning that the user should see while the encode is running, if there is one */
+	virtual boost::optional<std::string> warning () const {
+		return {};
+	}
+
+	/** @return a report on how the encode went, if one is available; should be called after go() */
+	virtual boost::optional<PerformanceReport> performance_report () const {
+		return {};
+	}
+
 protected:
 	std::shared_ptr<const Film> _film;
 	std::weak_ptr<Job> _job;
@@ -23,6 +23,7 @@
 #define DCPOMATIC_ENUM_INDEXED_VECTOR_H
 
 
+#include <algorithm>
 #include <vector>
 
 
@@ -51,7 +52,7 @@ public:
 	}
 
 	void clear() {
-		std::fill(_data.begin(), _data.end(), {});
+		std::fill(_data.begin(), _data.end(), Type());
 	}
 
 	typename std::vector<Type>::const_iterator begin() const {
@@ -20,8 +20,10 @@
 
 
 #include "compose.hpp"
+#include "cpu_dispatch.h"
 #include "cross.h"
 #include "log.h"
+#include "util.h"
 #include "version.h"
 #include <dcp/version.h>
 #include <dcp/warnings.h>
@@ -142,6 +144,13 @@ environment_info ()
 #endif
 
 	info.push_back (String::compose ("CPU: %1, %2 processors", cpu_info(), boost::thread::hardware_concurrency()));
+	info.push_back (String::compose("SIMD: built for %1, CPU supports %2", simd_target(), simd_features()));
+	if (auto isa = dcpomatic::cpu::forced()) {
+		info.push_back (String::compose("SIMD: forced to use at most %1", dcpomatic::cpu::isa_name(*isa)));
+	}
+	for (auto const& i: dcpomatic::cpu::choices()) {
+		info.push_back (String::compose("Kernel %1: %2", i.first, dcpomatic::cpu::isa_name(i.second)));
+	}
 	for (auto const& i: mount_info()) {
 		info.push_back (String::compose("Mount: %1 %2", i.first, i.second));
 	}
@@ -20,7 +20,9 @@
 
 
 #include "content.h"
+#include "cross.h"
 #include "examine_content_job.h"
+#include "ffmpeg_content.h"
 #include "film.h"
 #include "log.h"
 #include <boost/filesystem.hpp>
@@ -31,7 +33,9 @@
 
 using std::string;
 using std::cout;
+using std::dynamic_pointer_cast;
 using std::shared_ptr;
+using boost::optional;
 
 
 ExamineContentJob::ExamineContentJob (shared_ptr<const Film> film, shared_ptr<Content> c)
@@ -62,9 +66,31 @@ ExamineContentJob::json_name () const
 }
 
 
+/** Examinations can run alongside each other; we guess that files in the same directory
+ *  are on the same storage.
+ */
+optional<string>
+ExamineContentJob::parallel_storage () const
+{
+	auto const paths = _content->paths();
+	if (paths.empty()) {
+		return {};
+	}
+
+	return paths.front().parent_path().string();
+}
+
+
 void
 ExamineContentJob::run ()
 {
+	/* This is done here, rather than when the content is added, so that adding lots of
+	   content at once does not hold up the UI while ffprobe runs on each file.
+	*/
+	if (dynamic_pointer_cast<FFmpegContent>(_content) && _film->directory()) {
+		run_ffprobe (_content->path(0), _film->file("ffprobe.log"));
+	}
+
 	_content->examine (_film, shared_from_this());
 	set_progress (1);
 	set_state (FINISHED_OK);
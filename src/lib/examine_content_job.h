@@ -34,6 +34,10 @@ public:
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::DISK;
+	}
+	boost::optional<std::string> parallel_storage () const override;
 
 	std::shared_ptr<Content> content () const {
 		return _content;
@@ -37,7 +37,7 @@ using std::shared_ptr;
 
 ExamineFFmpegSubtitlesJob::ExamineFFmpegSubtitlesJob (shared_ptr<const Film> film, shared_ptr<FFmpegContent> c)
 	: Job (film)
-	, FFmpeg (c)
+	, FFmpeg (c, 1)
 	, _content (c)
 {
 
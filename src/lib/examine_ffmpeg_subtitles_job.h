@@ -32,6 +32,9 @@ public:
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::DISK;
+	}
 
 private:
 	std::shared_ptr<FFmpegContent> _content;
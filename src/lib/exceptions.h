@@ -269,6 +269,18 @@ private:
 };
 
 
+/** @class TransientNetworkError
+ *  @brief A NetworkError which might not happen if the same thing is tried again a little later.
+ */
+class TransientNetworkError : public NetworkError
+{
+public:
+	explicit TransientNetworkError (std::string s, boost::optional<std::string> d = boost::optional<std::string>())
+		: NetworkError (s, d)
+	{}
+};
+
+
 /** @class KDMError
  *  @brief A problem with a KDM.
  */
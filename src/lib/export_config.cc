@@ -63,6 +63,10 @@ ExportConfig::read(cxml::ConstNodePtr node)
 		_format = ExportFormat::SUBTITLES_DCP;
 	} else if (format == "h264-aac") {
 		_format = ExportFormat::H264_AAC;
+	} else if (format == "h264-hardware-aac") {
+		_format = ExportFormat::H264_HARDWARE_AAC;
+	} else if (format == "hevc-hardware-aac") {
+		_format = ExportFormat::HEVC_HARDWARE_AAC;
 	} else if (format == "prores-4444") {
 		_format = ExportFormat::PRORES_4444;
 	} else {
@@ -92,6 +96,12 @@ ExportConfig::write(xmlpp::Element* node) const
 		case ExportFormat::H264_AAC:
 			name = "h264-aac";
 			break;
+		case ExportFormat::H264_HARDWARE_AAC:
+			name = "h264-hardware-aac";
+			break;
+		case ExportFormat::HEVC_HARDWARE_AAC:
+			name = "hevc-hardware-aac";
+			break;
 		case ExportFormat::SUBTITLES_DCP:
 			name = "subtitles-dcp";
 			break;
@@ -0,0 +1,187 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "audio_buffers.h"
+#include "exceptions.h"
+#include "export_sink.h"
+#include "film.h"
+#include "player_video.h"
+#include "util.h"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "i18n.h"
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using namespace dcpomatic;
+
+
+VideoFileExportSink::VideoFileExportSink (
+	shared_ptr<const Film> film,
+	boost::filesystem::path output,
+	ExportFormat format,
+	dcp::Size size,
+	AudioMapping map,
+	int x264_crf
+	)
+	: _map (map)
+	, _encoder (size, film->video_frame_rate(), film->audio_frame_rate(), map.output_channels(), format, false, x264_crf, output)
+{
+
+}
+
+
+void
+VideoFileExportSink::video (shared_ptr<PlayerVideo> video, DCPTime time)
+{
+	if (video->eyes() != Eyes::RIGHT) {
+		_encoder.video (video, time);
+	}
+}
+
+
+void
+VideoFileExportSink::audio (shared_ptr<AudioBuffers> audio, DCPTime)
+{
+	_encoder.audio (remap(audio, _map.output_channels(), _map));
+}
+
+
+void
+VideoFileExportSink::finish ()
+{
+	_encoder.flush ();
+}
+
+
+AudioStemsExportSink::AudioStemsExportSink (
+	shared_ptr<const Film> film,
+	boost::filesystem::path directory,
+	AudioMapping map,
+	vector<string> names
+	)
+	: _map (map)
+	, _frame_rate (film->audio_frame_rate())
+{
+	DCPOMATIC_ASSERT (static_cast<int>(names.size()) == map.output_channels());
+
+	boost::filesystem::create_directories (directory);
+
+	for (auto const& name: names) {
+		auto const path = directory / (name + ".wav");
+		auto file = std::unique_ptr<dcp::File>(new dcp::File(path, "wb"));
+		if (!*file) {
+			throw OpenFileError (path, errno, OpenFileError::WRITE);
+		}
+		write_header (*file);
+		_files.push_back (std::move(file));
+		_paths.push_back (path);
+	}
+}
+
+
+/** @return the names of a film's audio channels, for use as the names of stems which
+ *  have one channel of the film's audio in each.
+ */
+vector<string>
+AudioStemsExportSink::channel_names (shared_ptr<const Film> film)
+{
+	vector<string> names;
+	for (int i = 0; i < film->audio_channels(); ++i) {
+		names.push_back (short_audio_channel_name(i));
+	}
+	return names;
+}
+
+
+template <class T>
+static void
+write_value (dcp::File& file, T value)
+{
+	file.checked_write (&value, sizeof(T));
+}
+
+
+/** Write a WAV header at the current position of @p file, using the number of frames
+ *  that we have written so far.
+ */
+void
+AudioStemsExportSink::write_header (dcp::File& file) const
+{
+	int const bytes_per_sample = 3;
+	uint32_t const data_size = _frames * bytes_per_sample;
+
+	file.checked_write ("RIFF", 4);
+	write_value<uint32_t> (file, 36 + data_size);
+	file.checked_write ("WAVE", 4);
+	file.checked_write ("fmt ", 4);
+	write_value<uint32_t> (file, 16);
+	/* PCM, one channel */
+	write_value<uint16_t> (file, 1);
+	write_value<uint16_t> (file, 1);
+	write_value<uint32_t> (file, _frame_rate);
+	write_value<uint32_t> (file, _frame_rate * bytes_per_sample);
+	write_value<uint16_t> (file, bytes_per_sample);
+	write_value<uint16_t> (file, bytes_per_sample * 8);
+	file.checked_write ("data", 4);
+	write_value<uint32_t> (file, data_size);
+}
+
+
+void
+AudioStemsExportSink::audio (shared_ptr<AudioBuffers> audio, DCPTime)
+{
+	auto stems = remap (audio, _map.output_channels(), _map);
+	auto const frames = stems->frames();
+
+	vector<uint8_t> buffer (frames * 3);
+	for (int i = 0; i < stems->channels(); ++i) {
+		auto data = stems->data(i);
+		auto p = buffer.data();
+		for (int j = 0; j < frames; ++j) {
+			auto const value = static_cast<int32_t>(lrintf(std::max(-1.0f, std::min(1.0f, data[j])) * 8388607));
+			*p++ = value & 0xff;
+			*p++ = (value >> 8) & 0xff;
+			*p++ = (value >> 16) & 0xff;
+		}
+		_files[i]->checked_write (buffer.data(), buffer.size());
+	}
+
+	_frames += frames;
+}
+
+
+void
+AudioStemsExportSink::finish ()
+{
+	for (size_t i = 0; i < _files.size(); ++i) {
+		if (_files[i]->seek(0, SEEK_SET) != 0) {
+			throw FileError (_("Could not seek in WAV file"), _paths[i]);
+		}
+		write_header (*_files[i]);
+		_files[i]->close ();
+	}
+}
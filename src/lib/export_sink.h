@@ -0,0 +1,127 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_EXPORT_SINK_H
+#define DCPOMATIC_EXPORT_SINK_H
+
+
+#include "audio_mapping.h"
+#include "dcpomatic_time.h"
+#include "ffmpeg_file_encoder.h"
+#include <dcp/file.h>
+#include <boost/filesystem.hpp>
+#include <memory>
+#include <vector>
+
+
+class AudioBuffers;
+class Film;
+class PlayerVideo;
+
+
+/** @class ExportSink
+ *  @brief Something that can be given the video and audio that a DCPEncoder's player
+ *  makes, so that another output (such as a screener or some audio stems) can be made
+ *  in the same pass as the DCP.
+ *
+ *  The same PlayerVideo is given to the DCP encoder and to each sink, so the decoded
+ *  frame is shared; each sink then makes its own image from it.
+ */
+class ExportSink
+{
+public:
+	virtual ~ExportSink () {}
+
+	/** Called with each frame of video (for each eye in a 3D film) */
+	virtual void video (std::shared_ptr<PlayerVideo> video, dcpomatic::DCPTime time) = 0;
+	/** Called with audio which has one channel for each of the film's audio channels */
+	virtual void audio (std::shared_ptr<AudioBuffers> audio, dcpomatic::DCPTime time) = 0;
+	/** Called once all the video and audio has been given to us */
+	virtual void finish () = 0;
+};
+
+
+/** @class VideoFileExportSink
+ *  @brief ExportSink which writes a video file, such as a screener, using FFmpeg.
+ *
+ *  Only the left eye of 3D films is written.
+ */
+class VideoFileExportSink : public ExportSink
+{
+public:
+	VideoFileExportSink (
+		std::shared_ptr<const Film> film,
+		boost::filesystem::path output,
+		ExportFormat format,
+		dcp::Size size,
+		AudioMapping map,
+		int x264_crf
+		);
+
+	void video (std::shared_ptr<PlayerVideo> video, dcpomatic::DCPTime time) override;
+	void audio (std::shared_ptr<AudioBuffers> audio, dcpomatic::DCPTime time) override;
+	void finish () override;
+
+private:
+	AudioMapping _map;
+	FFmpegFileEncoder _encoder;
+};
+
+
+/** @class AudioStemsExportSink
+ *  @brief ExportSink which writes each channel of audio to a 24-bit WAV file of its own.
+ */
+class AudioStemsExportSink : public ExportSink
+{
+public:
+	/** @param directory Directory to write the WAV files to.
+	 *  @param map Mapping from the film's audio channels to the stems.
+	 *  @param names Name of each stem; the WAV files will be called [name].wav.
+	 */
+	AudioStemsExportSink (
+		std::shared_ptr<const Film> film,
+		boost::filesystem::path directory,
+		AudioMapping map,
+		std::vector<std::string> names
+		);
+
+	AudioStemsExportSink (AudioStemsExportSink const&) = delete;
+	AudioStemsExportSink& operator= (AudioStemsExportSink const&) = delete;
+
+	void video (std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime) override {}
+	void audio (std::shared_ptr<AudioBuffers> audio, dcpomatic::DCPTime time) override;
+	void finish () override;
+
+	static std::vector<std::string> channel_names (std::shared_ptr<const Film> film);
+
+private:
+	void write_header (dcp::File& file) const;
+
+	AudioMapping _map;
+	int _frame_rate;
+	std::vector<std::unique_ptr<dcp::File>> _files;
+	std::vector<boost::filesystem::path> _paths;
+	/** number of frames that we have written to each file */
+	int64_t _frames = 0;
+};
+
+
+#endif
@@ -21,12 +21,15 @@
 
 #include "compose.hpp"
 #include "cross.h"
+#include "dcpomatic_assert.h"
 #include "dcpomatic_log.h"
 #include "digester.h"
 #include "disk_writer_messages.h"
+#include "exception_store.h"
 #include "exceptions.h"
 #include "ext.h"
 #include "nanomsg.h"
+#include "scope_guard.h"
 #include <dcp/file.h>
 
 #ifdef DCPOMATIC_LINUX
@@ -57,13 +60,19 @@ extern "C" {
 #include <lwext4/ext4_mbr.h>
 #include <lwext4/ext4_mkfs.h>
 }
+#include <boost/bind/bind.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
 #include <chrono>
+#include <list>
+#include <map>
 #include <string>
 
 
 using std::exception;
 using std::min;
+using boost::optional;
 using std::string;
 using std::vector;
 
@@ -76,9 +85,10 @@ using std::vector;
 uint64_t constexpr block_size = 4096 * 4096;
 
 
+/** Find the files in some directories, in the order that copy() will copy them */
 static
 void
-count (std::vector<boost::filesystem::path> dirs, uint64_t& total_bytes)
+count (std::vector<boost::filesystem::path> dirs, uint64_t& total_bytes, vector<boost::filesystem::path>& files)
 {
 	using namespace boost::filesystem;
 
@@ -86,9 +96,10 @@ count (std::vector<boost::filesystem::path> dirs, uint64_t& total_bytes)
 		dir = dcp::fix_long_path(dir);
 		for (auto path: directory_iterator(dir)) {
 			if (is_directory(path)) {
-				count({path}, total_bytes);
+				count({path}, total_bytes, files);
 			} else {
 				total_bytes += file_size(path);
+				files.push_back(path);
 			}
 		}
 	}
@@ -106,68 +117,421 @@ set_timestamps_to_now (boost::filesystem::path path)
 }
 
 
+/* Number of blocks to keep in flight between reading, writing and hashing */
+int constexpr blocks_in_flight = 4;
+
+
+/* A sampled verification checks every this-many blocks of each file, as well as its last block */
+uint64_t constexpr verify_sample_interval = 16;
+
+
+/* Read up to this many bytes of the source while the drive is being formatted */
+uint64_t constexpr format_read_ahead = 1024 * 1024 * 1024;
+
+
 static
-string
-write (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, Nanomsg* nanomsg)
+bool
+sampled (uint64_t block, uint64_t blocks)
+{
+	return (block % verify_sample_interval) == 0 || block == (blocks - 1);
+}
+
+
+static
+uint64_t
+blocks_in (uint64_t bytes)
+{
+	return (bytes + block_size - 1) / block_size;
+}
+
+
+static
+Digester::Algorithm
+algorithm (DiskVerification verification)
+{
+	return verification == DiskVerification::FAST ? Digester::Algorithm::CRC32C : Digester::Algorithm::MD5;
+}
+
+
+class Block
+{
+public:
+	Block ()
+		: data(block_size)
+	{}
+
+	std::vector<uint8_t> data;
+	/** number of bytes of data that are in use */
+	size_t size = 0;
+};
+
+
+/** A queue of blocks being passed from one stage of a copy to the next */
+class BlockQueue
+{
+public:
+	void push (Block* block)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (!_aborted) {
+			_blocks.push_back (block);
+			_condition.notify_all ();
+		}
+	}
+
+	/** @return The next block, or nullptr if there will be no more */
+	Block* pop ()
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_blocks.empty() && !_closed) {
+			_condition.wait (lm);
+		}
+		if (_blocks.empty()) {
+			return nullptr;
+		}
+		auto block = _blocks.front();
+		_blocks.pop_front ();
+		return block;
+	}
+
+	/** Say that no more blocks will be pushed; the ones already here can still be popped */
+	void close ()
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_closed = true;
+		_condition.notify_all ();
+	}
+
+	/** Throw away any blocks that are here, and any that are pushed later */
+	void abort ()
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_blocks.clear ();
+		_closed = true;
+		_aborted = true;
+		_condition.notify_all ();
+	}
+
+private:
+	boost::mutex _mutex;
+	boost::condition_variable _condition;
+	std::list<Block*> _blocks;
+	bool _closed = false;
+	bool _aborted = false;
+};
+
+
+/** Thread which takes blocks from one queue, adds them to a digest and then gives them
+ *  to another, so that hashing does not hold up reading or writing.
+ */
+class BackgroundDigester
+{
+public:
+	/** @param sample_blocks If set, make a separate digest of each of the blocks that a sampled
+	 *  verification would check (out of this many) instead of one digest of everything.
+	 */
+	BackgroundDigester (BlockQueue& input, BlockQueue& output, Digester::Algorithm algorithm, boost::optional<uint64_t> sample_blocks = {})
+		: _input(input)
+		, _output(output)
+		, _algorithm(algorithm)
+		, _sample_blocks(sample_blocks)
+		, _digester(algorithm)
+		, _thread(boost::bind(&BackgroundDigester::thread, this))
+	{}
+
+	~BackgroundDigester ()
+	{
+		_input.abort ();
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+	}
+
+	/** @return The digest of everything from the input queue; this must only be called
+	 *  after the input queue has been closed.
+	 */
+	std::string get ()
+	{
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+		return _digester.get ();
+	}
+
+	/** @return Digests of sampled blocks, indexed by block number; this must only be called
+	 *  after the input queue has been closed.
+	 */
+	std::map<uint64_t, std::string> block_digests ()
+	{
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+		return _block_digests;
+	}
+
+private:
+	void thread ()
+	{
+		uint64_t index = 0;
+		while (auto block = _input.pop()) {
+			if (!_sample_blocks) {
+				_digester.add (block->data.data(), block->size);
+			} else if (sampled(index, *_sample_blocks)) {
+				Digester digester (_algorithm);
+				digester.add (block->data.data(), block->size);
+				_block_digests[index] = digester.get();
+			}
+			_output.push (block);
+			++index;
+		}
+	}
+
+	BlockQueue& _input;
+	BlockQueue& _output;
+	Digester::Algorithm _algorithm;
+	boost::optional<uint64_t> _sample_blocks;
+	Digester _digester;
+	std::map<uint64_t, std::string> _block_digests;
+	boost::thread _thread;
+};
+
+
+/** Thread which reads a source file in blocks, so that reading it overlaps writing
+ *  the previous blocks to the drive.
+ */
+class SourceReader : public ExceptionStore
+{
+public:
+	SourceReader (boost::filesystem::path from, BlockQueue& input, BlockQueue& output)
+		: _from(from)
+		, _in(from, "rb")
+		, _input(input)
+		, _output(output)
+	{
+		if (!_in) {
+			throw CopyError (String::compose("Failed to open file %1", from.string()), 0);
+		}
+		_thread = boost::thread(boost::bind(&SourceReader::thread, this));
+	}
+
+	~SourceReader ()
+	{
+		_input.abort ();
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+	}
+
+private:
+	void thread ()
+	try
+	{
+		uint64_t remaining = file_size (_from);
+		while (remaining > 0) {
+			auto block = _input.pop();
+			if (!block) {
+				break;
+			}
+			block->size = min(remaining, block_size);
+			size_t read = _in.read(block->data.data(), 1, block->size);
+			if (read != block->size) {
+				throw CopyError (String::compose("Short read; expected %1 but read %2", block->size, read), 0);
+			}
+			_output.push (block);
+			remaining -= block->size;
+		}
+		_output.close ();
+	}
+	catch (...)
+	{
+		store_current ();
+		_output.close ();
+	}
+
+	boost::filesystem::path _from;
+	dcp::File _in;
+	BlockQueue& _input;
+	BlockQueue& _output;
+	boost::thread _thread;
+};
+
+
+/** Thread which looks at the source DCPs while the drive is being formatted, so that the
+ *  copy can start as soon as the filesystem is ready.  It finds the total size of the files
+ *  and then reads the first ones, so that the copy's first reads come from the OS's cache.
+ */
+class SourceScanner : public ExceptionStore
+{
+public:
+	explicit SourceScanner (vector<boost::filesystem::path> dcp_paths)
+		: _dcp_paths(dcp_paths)
+		, _stop(false)
+		, _thread(boost::bind(&SourceScanner::thread, this))
+	{}
+
+	~SourceScanner ()
+	{
+		stop ();
+	}
+
+	/** Stop reading the source, waiting until the total size is known.
+	 *  @return Total size of the source files in bytes.
+	 */
+	uint64_t finish ()
+	{
+		stop ();
+		rethrow ();
+		return _total_bytes;
+	}
+
+private:
+	void stop ()
+	{
+		_stop = true;
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+	}
+
+	void thread ()
+	try
+	{
+		vector<boost::filesystem::path> files;
+		count (_dcp_paths, _total_bytes, files);
+		LOG_DISK("Source is %1 bytes in %2 files", _total_bytes, files.size());
+
+		std::vector<uint8_t> buffer(block_size);
+		uint64_t read_ahead = 0;
+		for (auto const& file: files) {
+			dcp::File in(file, "rb");
+			if (!in) {
+				/* The copy will report this */
+				return;
+			}
+			while (!_stop && read_ahead < format_read_ahead) {
+				auto const this_time = in.read(buffer.data(), 1, buffer.size());
+				if (this_time == 0) {
+					break;
+				}
+				read_ahead += this_time;
+			}
+			if (_stop || read_ahead >= format_read_ahead) {
+				break;
+			}
+		}
+		LOG_DISK("Read %1 bytes of source ahead of the copy", read_ahead);
+	}
+	catch (...)
+	{
+		store_current ();
+	}
+
+	vector<boost::filesystem::path> _dcp_paths;
+	uint64_t _total_bytes = 0;
+	std::atomic<bool> _stop;
+	boost::thread _thread;
+};
+
+
+class CopiedFile
+{
+public:
+	CopiedFile (boost::filesystem::path from_, boost::filesystem::path to_)
+		: from (from_)
+		, to (to_)
+	{}
+
+	boost::filesystem::path from;
+	boost::filesystem::path to;
+	/** digest calculated from data as it was read from the source during write */
+	string write_digest;
+	/** digests of the blocks that a sampled verification will check, indexed by block number */
+	std::map<uint64_t, string> block_digests;
+};
+
+
+/** Copy a file to the drive.  The source is read in one thread and hashed in another
+ *  while this thread writes to the drive, since lwext4 must only be used from one thread.
+ *  @return Details of the copy, with digests of the data that was read from the source.
+ */
+static
+CopiedFile
+write (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, DiskVerification verification, Nanomsg* nanomsg)
 {
 	ext4_file out;
 	int r = ext4_fopen(&out, to.generic_string().c_str(), "wb");
 	if (r != EOK) {
 		throw CopyError (String::compose("Failed to open file %1", to.generic_string()), r);
 	}
-
-	dcp::File in(from, "rb");
-	if (!in) {
-		ext4_fclose (&out);
-		throw CopyError (String::compose("Failed to open file %1", from.string()), 0);
+	bool out_open = true;
+	ScopeGuard close_out = [&out, &out_open]() {
+		if (out_open) {
+			ext4_fclose (&out);
+		}
+	};
+
+	vector<Block> blocks(blocks_in_flight);
+	BlockQueue empty;
+	BlockQueue full;
+	BlockQueue written;
+	for (auto& block: blocks) {
+		empty.push (&block);
 	}
 
-	std::vector<uint8_t> buffer(block_size);
-	Digester digester;
+	SourceReader reader (from, empty, full);
 
-	int progress_frequency = 1;
-	int progress_count = 0;
 	uint64_t remaining = file_size (from);
-	while (remaining > 0) {
-		uint64_t const this_time = min(remaining, block_size);
-		size_t read = in.read(buffer.data(), 1, this_time);
-		if (read != this_time) {
-			ext4_fclose (&out);
-			throw CopyError (String::compose("Short read; expected %1 but read %2", this_time, read), 0);
-		}
-
-		digester.add (buffer.data(), this_time);
+	optional<uint64_t> sample_blocks;
+	if (verification == DiskVerification::SAMPLED) {
+		sample_blocks = blocks_in(remaining);
+	}
+	BackgroundDigester digester (written, empty, algorithm(verification), sample_blocks);
 
-		size_t written;
-		r = ext4_fwrite (&out, buffer.data(), this_time, &written);
+	while (auto block = full.pop()) {
+		size_t bytes_written;
+		r = ext4_fwrite (&out, block->data.data(), block->size, &bytes_written);
 		if (r != EOK) {
-			ext4_fclose (&out);
 			throw CopyError ("Write failed", r);
 		}
-		if (written != this_time) {
-			ext4_fclose (&out);
-			throw CopyError (String::compose("Short write; expected %1 but wrote %2", this_time, written), 0);
+		if (bytes_written != block->size) {
+			throw CopyError (String::compose("Short write; expected %1 but wrote %2", block->size, bytes_written), 0);
 		}
-		remaining -= this_time;
-		total_remaining -= this_time;
+		remaining -= block->size;
+		total_remaining -= block->size;
+		written.push (block);
 
-		++progress_count;
-		if ((progress_count % progress_frequency) == 0 && nanomsg) {
+		if (nanomsg) {
 			nanomsg->send(String::compose(DISK_WRITER_COPY_PROGRESS "\n%1\n", (1 - float(total_remaining) / total)), SHORT_TIMEOUT);
 		}
 	}
 
+	reader.rethrow ();
+	DCPOMATIC_ASSERT (remaining == 0);
+
+	written.close ();
+	CopiedFile copied (from, to);
+	if (sample_blocks) {
+		copied.block_digests = digester.block_digests ();
+	} else {
+		copied.write_digest = digester.get ();
+	}
+
 	ext4_fclose (&out);
+	out_open = false;
 
 	set_timestamps_to_now (to);
 
-	return digester.get ();
+	return copied;
 }
 
 
+/** Read back a file which has been written to the drive.  Reads are made sequentially in
+ *  this thread, with the hashing done in another so that the drive is kept busy.
+ *  @return Digest of the data that was read from the drive.
+ */
 static
 string
-read (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, Nanomsg* nanomsg)
+read (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, Digester::Algorithm algorithm, Nanomsg* nanomsg)
 {
 	ext4_file in;
 	LOG_DISK("Opening %1 for read", to.generic_string());
@@ -176,48 +540,86 @@ read (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_
 		throw VerifyError (String::compose("Failed to open file %1", to.generic_string()), r);
 	}
 	LOG_DISK("Opened %1 for read", to.generic_string());
+	ScopeGuard close_in = [&in]() { ext4_fclose(&in); };
 
-	std::vector<uint8_t> buffer(block_size);
-	Digester digester;
+	vector<Block> blocks(blocks_in_flight);
+	BlockQueue empty;
+	BlockQueue full;
+	for (auto& block: blocks) {
+		empty.push (&block);
+	}
+
+	BackgroundDigester digester (full, empty, algorithm);
 
 	uint64_t remaining = file_size (from);
 	while (remaining > 0) {
-		uint64_t const this_time = min(remaining, block_size);
+		auto block = empty.pop();
+		DCPOMATIC_ASSERT (block);
+		block->size = min(remaining, block_size);
 		size_t read;
-		r = ext4_fread (&in, buffer.data(), this_time, &read);
-		if (read != this_time) {
-			ext4_fclose (&in);
-			throw VerifyError (String::compose("Short read; expected %1 but read %2", this_time, read), 0);
+		r = ext4_fread (&in, block->data.data(), block->size, &read);
+		if (read != block->size) {
+			throw VerifyError (String::compose("Short read; expected %1 but read %2", block->size, read), 0);
 		}
 
-		digester.add (buffer.data(), this_time);
-		remaining -= this_time;
-		total_remaining -= this_time;
+		remaining -= block->size;
+		total_remaining -= block->size;
+		full.push (block);
 		if (nanomsg) {
 			nanomsg->send(String::compose(DISK_WRITER_VERIFY_PROGRESS "\n%1\n", (1 - float(total_remaining) / total)), SHORT_TIMEOUT);
 		}
 	}
 
-	ext4_fclose (&in);
-
+	full.close ();
 	return digester.get ();
 }
 
 
-class CopiedFile
+/** Read back the sampled blocks of a file which has been written to the drive, checking each
+ *  against the digest that was made when it was written.
+ */
+static
+void
+read_sampled (CopiedFile const& file, uint64_t& total_remaining, uint64_t total, Nanomsg* nanomsg)
 {
-public:
-	CopiedFile (boost::filesystem::path from_, boost::filesystem::path to_, string write_digest_)
-		: from (from_)
-		, to (to_)
-		, write_digest (write_digest_)
-	{}
+	ext4_file in;
+	LOG_DISK("Opening %1 for sampled read", file.to.generic_string());
+	int r = ext4_fopen(&in, file.to.generic_string().c_str(), "rb");
+	if (r != EOK) {
+		throw VerifyError (String::compose("Failed to open file %1", file.to.generic_string()), r);
+	}
+	ScopeGuard close_in = [&in]() { ext4_fclose(&in); };
 
-	boost::filesystem::path from;
-	boost::filesystem::path to;
-	/** digest calculated from data as it was read from the source during write */
-	string write_digest;
-};
+	uint64_t const size = file_size (file.from);
+	std::vector<uint8_t> buffer(block_size);
+
+	/* The map is ordered, so we read the drive from start to finish */
+	for (auto const& i: file.block_digests) {
+		auto const offset = i.first * block_size;
+		auto const this_time = min(size - offset, block_size);
+		r = ext4_fseek (&in, offset, SEEK_SET);
+		if (r != EOK) {
+			throw VerifyError (String::compose("Failed to seek in file %1", file.to.generic_string()), r);
+		}
+		size_t read;
+		r = ext4_fread (&in, buffer.data(), this_time, &read);
+		if (read != this_time) {
+			throw VerifyError (String::compose("Short read; expected %1 but read %2", this_time, read), 0);
+		}
+
+		Digester digester;
+		digester.add (buffer.data(), this_time);
+		if (digester.get() != i.second) {
+			LOG_DISK ("Block %1 of %2 was %3 on write, now %4", i.first, file.to.generic_string(), i.second, digester.get());
+			throw VerifyError ("Hash of written data is incorrect", 0);
+		}
+
+		total_remaining -= this_time;
+		if (nanomsg) {
+			nanomsg->send(String::compose(DISK_WRITER_VERIFY_PROGRESS "\n%1\n", (1 - float(total_remaining) / total)), SHORT_TIMEOUT);
+		}
+	}
+}
 
 
 /** @param from File to copy from.
@@ -225,7 +627,7 @@ public:
  */
 static
 void
-copy (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, vector<CopiedFile>& copied_files, Nanomsg* nanomsg)
+copy (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_remaining, uint64_t total, vector<CopiedFile>& copied_files, DiskVerification verification, Nanomsg* nanomsg)
 {
 	LOG_DISK ("Copy %1 -> %2", from.string(), to.generic_string());
 	from = dcp::fix_long_path (from);
@@ -242,23 +644,40 @@ copy (boost::filesystem::path from, boost::filesystem::path to, uint64_t& total_
 		set_timestamps_to_now (cr);
 
 		for (auto i: directory_iterator(from)) {
-			copy (i.path(), cr, total_remaining, total, copied_files, nanomsg);
+			copy (i.path(), cr, total_remaining, total, copied_files, verification, nanomsg);
 		}
 	} else {
-		string const write_digest = write (from, cr, total_remaining, total, nanomsg);
-		LOG_DISK ("Wrote %1 %2 with %3", from.string(), cr.generic_string(), write_digest);
-		copied_files.push_back (CopiedFile(from, cr, write_digest));
+		auto copied = write (from, cr, total_remaining, total, verification, nanomsg);
+		LOG_DISK ("Wrote %1 %2 with %3", from.string(), cr.generic_string(), copied.write_digest);
+		copied_files.push_back (copied);
 	}
 }
 
 
 static
 void
-verify (vector<CopiedFile> const& copied_files, uint64_t total, Nanomsg* nanomsg)
+verify (vector<CopiedFile> const& copied_files, uint64_t total, DiskVerification verification, Nanomsg* nanomsg)
 {
+	if (verification == DiskVerification::SAMPLED) {
+		/* Progress is of the blocks that we will read back */
+		uint64_t sampled_total = 0;
+		for (auto const& i: copied_files) {
+			uint64_t const size = file_size (i.from);
+			for (auto const& j: i.block_digests) {
+				sampled_total += min(size - j.first * block_size, block_size);
+			}
+		}
+
+		uint64_t total_remaining = sampled_total;
+		for (auto const& i: copied_files) {
+			read_sampled (i, total_remaining, sampled_total, nanomsg);
+		}
+		return;
+	}
+
 	uint64_t total_remaining = total;
 	for (auto const& i: copied_files) {
-		string const read_digest = read (i.from, i.to, total_remaining, total, nanomsg);
+		string const read_digest = read (i.from, i.to, total_remaining, total, algorithm(verification), nanomsg);
 		LOG_DISK ("Read %1 %2 was %3 on write, now %4", i.from.string(), i.to.generic_string(), i.write_digest, read_digest);
 		if (read_digest != i.write_digest) {
 			throw VerifyError ("Hash of written data is incorrect", 0);
@@ -279,14 +698,17 @@ format_progress (void* context, float progress)
 
 void
 #ifdef DCPOMATIC_WINDOWS
-dcpomatic::write (vector<boost::filesystem::path> dcp_paths, string device, string, Nanomsg* nanomsg)
+dcpomatic::write (vector<boost::filesystem::path> dcp_paths, string device, string, DiskVerification verification, Nanomsg* nanomsg)
 #else
-dcpomatic::write (vector<boost::filesystem::path> dcp_paths, string device, string posix_partition, Nanomsg* nanomsg)
+dcpomatic::write (vector<boost::filesystem::path> dcp_paths, string device, string posix_partition, DiskVerification verification, Nanomsg* nanomsg)
 #endif
 try
 {
 	ext4_dmask_set (DEBUG_ALL);
 
+	/* Look at the source while we format the drive */
+	SourceScanner scanner (dcp_paths);
+
 	struct ext4_fs fs;
 	fs.read_only = false;
 	fs.bdev = nullptr;
@@ -391,13 +813,12 @@ try
 	}
 	LOG_DISK_NC ("Mounted device");
 
-	uint64_t total_bytes = 0;
-	count (dcp_paths, total_bytes);
+	auto const total_bytes = scanner.finish ();
 
 	uint64_t total_remaining = total_bytes;
 	vector<CopiedFile> copied_files;
 	for (auto dcp_path: dcp_paths) {
-		copy (dcp_path, "/mp", total_remaining, total_bytes, copied_files, nanomsg);
+		copy (dcp_path, "/mp", total_remaining, total_bytes, copied_files, verification, nanomsg);
 	}
 
 	/* Unmount and re-mount to make sure the write has finished */
@@ -411,7 +832,7 @@ try
 	}
 	LOG_DISK_NC ("Re-mounted device");
 
-	verify (copied_files, total_bytes, nanomsg);
+	verify (copied_files, total_bytes, verification, nanomsg);
 
 	r = ext4_umount("/mp/");
 	if (r != EOK) {
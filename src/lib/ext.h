@@ -19,6 +19,7 @@
 */
 
 
+#include "types.h"
 #include <boost/filesystem.hpp>
 #include <string>
 
@@ -29,7 +30,13 @@ class Nanomsg;
 namespace dcpomatic {
 
 
-extern void write (std::vector<boost::filesystem::path> dcp_paths, std::string device, std::string posix_partition, Nanomsg* nanomsg);
+extern void write (
+	std::vector<boost::filesystem::path> dcp_paths,
+	std::string device,
+	std::string posix_partition,
+	DiskVerification verification,
+	Nanomsg* nanomsg
+	);
 
 
 }
@@ -31,11 +31,14 @@
 #include "film.h"
 #include "log.h"
 #include "memory_util.h"
+#include "read_ahead.h"
 #include "util.h"
 #include <dcp/raw_convert.h>
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 }
 #include <boost/algorithm/string.hpp>
@@ -57,8 +60,10 @@ using namespace dcpomatic;
 boost::mutex FFmpeg::_mutex;
 
 
-FFmpeg::FFmpeg (std::shared_ptr<const FFmpegContent> c)
+FFmpeg::FFmpeg (std::shared_ptr<const FFmpegContent> c, int video_decode_threads, optional<string> video_decode_hardware)
 	: _ffmpeg_content (c)
+	, _video_decode_threads (std::max(1, video_decode_threads))
+	, _video_decode_hardware (video_decode_hardware)
 {
 	setup_general ();
 	setup_decoders ();
@@ -73,7 +78,10 @@ FFmpeg::~FFmpeg ()
 		avcodec_free_context (&i);
 	}
 
+	av_buffer_unref (&_hardware_device);
+
 	av_frame_free (&_video_frame);
+	av_frame_free (&_downloaded_video_frame);
 	for (auto& audio_frame: _audio_frame) {
 		av_frame_free (&audio_frame.second);
 	}
@@ -209,37 +217,7 @@ FFmpeg::setup_decoders ()
 	for (uint32_t i = 0; i < _format_context->nb_streams; ++i) {
 		auto codec = avcodec_find_decoder (_format_context->streams[i]->codecpar->codec_id);
 		if (codec) {
-			auto context = avcodec_alloc_context3 (codec);
-			if (!context) {
-				throw std::bad_alloc ();
-			}
-			_codec_context[i] = context;
-
-			int r = avcodec_parameters_to_context (context, _format_context->streams[i]->codecpar);
-			if (r < 0) {
-				throw DecodeError ("avcodec_parameters_to_context", "FFmpeg::setup_decoders", r);
-			}
-
-			context->thread_count = 8;
-			context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
-
-			AVDictionary* options = nullptr;
-			/* This option disables decoding of DCA frame footers in our patched version
-			   of FFmpeg.  I believe these footers are of no use to us, and they can cause
-			   problems when FFmpeg fails to decode them (mantis #352).
-			*/
-			av_dict_set (&options, "disable_footer", "1", 0);
-			/* This allows decoding of some DNxHR 444 and HQX files; see
-			   https://trac.ffmpeg.org/ticket/5681
-			*/
-			av_dict_set_int (&options, "strict", FF_COMPLIANCE_EXPERIMENTAL, 0);
-			/* Enable following of links in files */
-			av_dict_set_int (&options, "enable_drefs", 1, 0);
-
-			r = avcodec_open2 (context, codec, &options);
-			if (r < 0) {
-				throw DecodeError (N_("avcodec_open2"), N_("FFmpeg::setup_decoders"), r);
-			}
+			_codec_context[i] = open_decoder (codec, i, 0);
 		} else {
 			dcpomatic_log->log (String::compose ("No codec found for stream %1", i), LogEntry::TYPE_WARNING);
 		}
@@ -247,6 +225,195 @@ FFmpeg::setup_decoders ()
 }
 
 
+/** get_format callback for a hardware decoder; this chooses the hardware's format if it is on offer,
+ *  and otherwise falls back to software decoding.
+ */
+AVPixelFormat
+FFmpeg::get_hardware_format (AVCodecContext* context, AVPixelFormat const* formats)
+{
+	auto const wanted = reinterpret_cast<FFmpeg*>(context->opaque)->_hardware_pixel_format;
+
+	for (auto p = formats; *p != AV_PIX_FMT_NONE; ++p) {
+		if (*p == wanted) {
+			return *p;
+		}
+	}
+
+	for (auto p = formats; *p != AV_PIX_FMT_NONE; ++p) {
+		auto const desc = av_pix_fmt_desc_get(*p);
+		if (desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+			dcpomatic_log->log (
+				String::compose("Hardware cannot decode this %1 stream; decoding it in software", context->codec->name), LogEntry::TYPE_GENERAL
+				);
+			return *p;
+		}
+	}
+
+	return AV_PIX_FMT_NONE;
+}
+
+
+/** Set up a decoder context to use our video decode hardware, if it can.  Caller must hold a lock on _mutex.
+ *  @return true if the context will decode in hardware.
+ */
+bool
+FFmpeg::setup_hardware_decode (AVCodec const* codec, AVCodecContext* context)
+{
+	auto const type = av_hwdevice_find_type_by_name (_video_decode_hardware->c_str());
+	if (type == AV_HWDEVICE_TYPE_NONE) {
+		dcpomatic_log->log (String::compose("Unknown video decode hardware %1", *_video_decode_hardware), LogEntry::TYPE_WARNING);
+		return false;
+	}
+
+	AVCodecHWConfig const* config = nullptr;
+	for (int i = 0; (config = avcodec_get_hw_config(codec, i)); ++i) {
+		if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type) {
+			break;
+		}
+	}
+
+	if (!config) {
+		dcpomatic_log->log (
+			String::compose("%1 cannot decode %2; decoding it in software", *_video_decode_hardware, codec->name), LogEntry::TYPE_GENERAL
+			);
+		return false;
+	}
+
+	if (!_hardware_device) {
+		int const r = av_hwdevice_ctx_create (&_hardware_device, type, nullptr, nullptr, 0);
+		if (r < 0) {
+			dcpomatic_log->log (
+				String::compose("Could not open %1 for video decoding (%2); decoding in software", *_video_decode_hardware, r), LogEntry::TYPE_WARNING
+				);
+			_hardware_device = nullptr;
+			return false;
+		}
+	}
+
+	_hardware_pixel_format = config->pix_fmt;
+	context->hw_device_ctx = av_buffer_ref (_hardware_device);
+	context->opaque = this;
+	context->get_format = &FFmpeg::get_hardware_format;
+	return true;
+}
+
+
+/** Open a decoder for one of our streams.  Caller must hold a lock on _mutex.
+ *  @param lowres log2 of the factor by which the decoder should reduce the size of the images that it makes;
+ *  this must be no more than codec->max_lowres.
+ *  @param allow_hardware true to use our video decode hardware (if we have any) for the video stream.
+ */
+AVCodecContext *
+FFmpeg::open_decoder (AVCodec const* codec, uint32_t stream, int lowres, bool allow_hardware)
+{
+	auto context = avcodec_alloc_context3 (codec);
+	if (!context) {
+		throw std::bad_alloc ();
+	}
+
+	int r = avcodec_parameters_to_context (context, _format_context->streams[stream]->codecpar);
+	if (r < 0) {
+		avcodec_free_context (&context);
+		throw DecodeError ("avcodec_parameters_to_context", "FFmpeg::setup_decoders", r);
+	}
+
+	bool const video = _video_stream && static_cast<int>(stream) == *_video_stream;
+
+	/* Hardware decoders can't reduce the size of what they make */
+	bool const hardware = allow_hardware && video && _video_decode_hardware && lowres == 0 && setup_hardware_decode (codec, context);
+
+	/* Audio and subtitle decoding is cheap, and a hardware decoder does not need threads of its own;
+	 * we would rather that any other threads were used for encoding.
+	 */
+	context->thread_count = (video && !hardware) ? _video_decode_threads : 1;
+	context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+	context->lowres = lowres;
+
+	AVDictionary* options = nullptr;
+	/* This option disables decoding of DCA frame footers in our patched version
+	   of FFmpeg.  I believe these footers are of no use to us, and they can cause
+	   problems when FFmpeg fails to decode them (mantis #352).
+	*/
+	av_dict_set (&options, "disable_footer", "1", 0);
+	/* This allows decoding of some DNxHR 444 and HQX files; see
+	   https://trac.ffmpeg.org/ticket/5681
+	*/
+	av_dict_set_int (&options, "strict", FF_COMPLIANCE_EXPERIMENTAL, 0);
+	/* Enable following of links in files */
+	av_dict_set_int (&options, "enable_drefs", 1, 0);
+
+	r = avcodec_open2 (context, codec, &options);
+	av_dict_free (&options);
+	if (r < 0) {
+		avcodec_free_context (&context);
+		if (hardware) {
+			dcpomatic_log->log (
+				String::compose("Could not open %1 decoder using %2 (%3); decoding in software", codec->name, *_video_decode_hardware, r), LogEntry::TYPE_WARNING
+				);
+			return open_decoder (codec, stream, lowres, false);
+		}
+		throw DecodeError (N_("avcodec_open2"), N_("FFmpeg::setup_decoders"), r);
+	}
+
+	return context;
+}
+
+
+/** If _video_frame is in the memory of some video decode hardware, replace it with a copy in normal memory */
+void
+FFmpeg::download_video_frame ()
+{
+	if (!_video_frame->hw_frames_ctx) {
+		return;
+	}
+
+	if (!_downloaded_video_frame) {
+		_downloaded_video_frame = av_frame_alloc ();
+		if (!_downloaded_video_frame) {
+			throw std::bad_alloc ();
+		}
+	}
+
+	int r = av_hwframe_transfer_data (_downloaded_video_frame, _video_frame, 0);
+	if (r < 0) {
+		throw DecodeError (N_("av_hwframe_transfer_data"), N_("FFmpeg::download_video_frame"), r);
+	}
+
+	r = av_frame_copy_props (_downloaded_video_frame, _video_frame);
+	if (r < 0) {
+		throw DecodeError (N_("av_frame_copy_props"), N_("FFmpeg::download_video_frame"), r);
+	}
+
+	av_frame_unref (_video_frame);
+	av_frame_move_ref (_video_frame, _downloaded_video_frame);
+}
+
+
+/** Ask the video decoder to make images which are smaller than the source by a factor of 2^lowres,
+ *  if it can.  This must be called before anything is decoded.
+ *  @return log2 of the reduction that the decoder will actually apply, which may be less than lowres.
+ */
+int
+FFmpeg::set_video_lowres (int lowres)
+{
+	auto context = video_codec_context ();
+	if (!context || !context->codec) {
+		return 0;
+	}
+
+	auto const codec = context->codec;
+	lowres = std::min(lowres, static_cast<int>(codec->max_lowres));
+	if (lowres == context->lowres) {
+		return lowres;
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	avcodec_free_context (&_codec_context[_video_stream.get()]);
+	_codec_context[_video_stream.get()] = open_decoder (codec, _video_stream.get(), lowres);
+	return lowres;
+}
+
+
 AVCodecContext *
 FFmpeg::video_codec_context () const
 {
@@ -273,6 +440,10 @@ FFmpeg::subtitle_codec_context () const
 int
 FFmpeg::avio_read (uint8_t* buffer, int const amount)
 {
+	if (_read_ahead) {
+		return _read_ahead->read (buffer, amount);
+	}
+
 	return _file_group.read (buffer, amount);
 }
 
@@ -280,6 +451,13 @@ FFmpeg::avio_read (uint8_t* buffer, int const amount)
 int64_t
 FFmpeg::avio_seek (int64_t const pos, int whence)
 {
+	if (_read_ahead) {
+		if (whence == AVSEEK_SIZE) {
+			return _read_ahead->length ();
+		}
+		return _read_ahead->seek (pos, whence);
+	}
+
 	if (whence == AVSEEK_SIZE) {
 		return _file_group.length ();
 	}
@@ -288,6 +466,18 @@ FFmpeg::avio_seek (int64_t const pos, int whence)
 }
 
 
+/** Start reading our files through a ReadAhead, carrying on from where we are now.
+ *  @param window Number of bytes to read ahead.
+ *  @param threads Number of threads to read ahead with.
+ */
+void
+FFmpeg::use_read_ahead (int64_t window, int threads)
+{
+	_read_ahead.reset (new ReadAhead(_ffmpeg_content->paths(), window, threads));
+	_read_ahead->seek (_file_group.seek(0, SEEK_CUR), SEEK_SET);
+}
+
+
 FFmpegSubtitlePeriod
 FFmpeg::subtitle_period (AVPacket const* packet, AVStream const* stream, AVSubtitle const & sub)
 {
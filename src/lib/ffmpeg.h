@@ -31,7 +31,10 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 }
 LIBDCP_ENABLE_WARNINGS
+#include <boost/optional.hpp>
 #include <boost/thread/mutex.hpp>
+#include <memory>
+#include <string>
 
 
 struct AVFormatContext;
@@ -42,12 +45,16 @@ struct AVIOContext;
 class FFmpegContent;
 class FFmpegAudioStream;
 class Log;
+class ReadAhead;
 
 
 class FFmpeg
 {
 public:
-	explicit FFmpeg (std::shared_ptr<const FFmpegContent>);
+	/** @param video_decode_threads Number of threads that the video decoder should use.
+	 *  @param video_decode_hardware FFmpeg name of the type of hardware to decode video with, or none to decode in software.
+	 */
+	FFmpeg (std::shared_ptr<const FFmpegContent>, int video_decode_threads, boost::optional<std::string> video_decode_hardware = boost::none);
 	virtual ~FFmpeg ();
 
 	std::shared_ptr<const FFmpegContent> ffmpeg_content () const {
@@ -60,6 +67,7 @@ public:
 protected:
 	AVCodecContext* video_codec_context () const;
 	AVCodecContext* subtitle_codec_context () const;
+	int set_video_lowres (int lowres);
 	dcpomatic::ContentTime pts_offset (
 		std::vector<std::shared_ptr<FFmpegAudioStream>> audio_streams, boost::optional<dcpomatic::ContentTime> first_video, double video_frame_rate
 		) const;
@@ -72,6 +80,8 @@ protected:
 	int _avio_buffer_size = 4096;
 	AVIOContext* _avio_context = nullptr;
 	FileGroup _file_group;
+	/** reader to use instead of _file_group, if we are reading ahead */
+	std::unique_ptr<ReadAhead> _read_ahead;
 
 	AVFormatContext* _format_context = nullptr;
 	std::vector<AVCodecContext*> _codec_context;
@@ -83,6 +93,9 @@ protected:
 
 	AVFrame* audio_frame (std::shared_ptr<const FFmpegAudioStream> stream);
 
+	void download_video_frame ();
+	void use_read_ahead (int64_t window, int threads);
+
 	/* It would appear (though not completely verified) that one must have
 	   a mutex around calls to avcodec_open* and avcodec_close... and here
 	   it is.
@@ -92,10 +105,24 @@ protected:
 private:
 	void setup_general ();
 	void setup_decoders ();
+	AVCodecContext* open_decoder (AVCodec const* codec, uint32_t stream, int lowres, bool allow_hardware = true);
+	bool setup_hardware_decode (AVCodec const* codec, AVCodecContext* context);
 
 	static void ffmpeg_log_callback (void* ptr, int level, const char* fmt, va_list vl);
+	static AVPixelFormat get_hardware_format (AVCodecContext* context, AVPixelFormat const* formats);
 	static std::weak_ptr<Log> _ffmpeg_log;
 
+	/** number of threads that the video decoder should use */
+	int _video_decode_threads;
+	/** FFmpeg name of the type of hardware to decode video with, or none to use software */
+	boost::optional<std::string> _video_decode_hardware;
+	/** device to decode video with, or nullptr if we are decoding in software */
+	AVBufferRef* _hardware_device = nullptr;
+	/** pixel format of frames that the hardware decoder gives us */
+	AVPixelFormat _hardware_pixel_format = AV_PIX_FMT_NONE;
+	/** AVFrame used to download video frames from the hardware decoder */
+	AVFrame* _downloaded_video_frame = nullptr;
+
 	/** AVFrames used for decoding audio streams; accessed with audio_frame() */
 	std::map<std::shared_ptr<const FFmpegAudioStream>, AVFrame*> _audio_frame;
 };
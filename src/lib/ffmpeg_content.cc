@@ -22,7 +22,9 @@
 #include "ffmpeg_content.h"
 #include "video_content.h"
 #include "audio_content.h"
+#include "ffmpeg_examination.h"
 #include "ffmpeg_examiner.h"
+#include "ffmpeg_seek_index.h"
 #include "ffmpeg_subtitle_stream.h"
 #include "ffmpeg_audio_stream.h"
 #include "compose.hpp"
@@ -32,6 +34,7 @@
 #include "film.h"
 #include "log.h"
 #include "config.h"
+#include "dcpomatic_log.h"
 #include "exceptions.h"
 #include "frame_rate_change.h"
 #include "text_content.h"
@@ -269,7 +272,20 @@ FFmpegContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 
 	Content::examine (film, job);
 
-	auto examiner = make_shared<FFmpegExaminer>(shared_from_this (), job);
+	/* Examining can mean reading the whole file, so if we have already seen content with the same digest
+	 * we use what we found out then.
+	 */
+	auto examiner = FFmpegExamination::cached(digest());
+	if (examiner) {
+		LOG_GENERAL ("Using cached examination of %1", path(0).string());
+	} else {
+		/* A quick examination is only any use if there is a film to follow it up with an exact one */
+		auto const quick = Config::instance()->quick_examination() && film && film->directory();
+		examiner = make_shared<FFmpegExamination>(FFmpegExaminer(shared_from_this(), job, quick));
+		FFmpegExamination::add_to_cache (digest(), examiner);
+	}
+
+	write_seek_index (film, examiner);
 
 	if (examiner->has_video ()) {
 		video.reset (new VideoContent (this));
@@ -281,6 +297,8 @@ FFmpegContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 	{
 		boost::mutex::scoped_lock lm (_mutex);
 
+		_examined_exactly = examiner->exact();
+
 		if (examiner->has_video ()) {
 			_first_video = examiner->first_video ();
 			_color_range = examiner->color_range ();
@@ -302,10 +320,11 @@ FFmpegContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 			}
 		}
 
-		if (!examiner->audio_streams().empty()) {
+		auto const audio_streams = examiner->audio_streams();
+		if (!audio_streams.empty()) {
 			audio = make_shared<AudioContent>(this);
 
-			for (auto i: examiner->audio_streams()) {
+			for (auto i: audio_streams) {
 				audio->add_stream (i);
 			}
 
@@ -338,6 +357,42 @@ FFmpegContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 }
 
 
+void
+FFmpegContent::write_seek_index (shared_ptr<const Film> film, shared_ptr<const FFmpegExamination> examination)
+{
+	if (film && film->directory() && examination->seek_index()) {
+		try {
+			examination->seek_index()->write(film->seek_index_path(shared_from_this()));
+		} catch (std::exception& e) {
+			LOG_WARNING ("Could not write seek index for %1 (%2)", path(0).string(), e.what());
+		}
+	}
+}
+
+
+/** Take the things that a quick examination could only estimate (or had to leave out) from an
+ *  exact examination of the same content, leaving everything else (including anything that the
+ *  user has changed since the quick one) alone.
+ */
+void
+FFmpegContent::take_exact_examination (shared_ptr<const Film> film, shared_ptr<const FFmpegExamination> examination)
+{
+	write_seek_index (film, examination);
+
+	if (video && examination->has_video()) {
+		auto length = examination->video_length();
+		if (examination->pulldown() && examination->video_frame_rate() && fabs(*examination->video_frame_rate() - 29.97) < 0.001) {
+			/* examine() will have treated this as 23.976fps */
+			length = length * 24.0 / 30;
+		}
+		video->set_length (length);
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_examined_exactly = true;
+}
+
+
 string
 FFmpegContent::summary () const
 {
@@ -28,8 +28,9 @@ struct AVFormatContext;
 struct AVStream;
 
 class Filter;
-class FFmpegSubtitleStream;
 class FFmpegAudioStream;
+class FFmpegExamination;
+class FFmpegSubtitleStream;
 class VideoContent;
 struct ffmpeg_pts_offset_test;
 struct audio_sampling_rate_test;
@@ -99,12 +100,24 @@ public:
 
 	void signal_subtitle_stream_changed ();
 
+	/** @return false if our last examination was a quick one, which has not yet been
+	 *  followed up by take_exact_examination().
+	 */
+	bool examined_exactly () const {
+		boost::mutex::scoped_lock lm (_mutex);
+		return _examined_exactly;
+	}
+
+	void take_exact_examination (std::shared_ptr<const Film> film, std::shared_ptr<const FFmpegExamination> examination);
+
 private:
 	void add_properties (std::shared_ptr<const Film> film, std::list<UserProperty> &) const override;
 
 	friend struct ffmpeg_pts_offset_test;
 	friend struct audio_sampling_rate_test;
 
+	void write_seek_index (std::shared_ptr<const Film> film, std::shared_ptr<const FFmpegExamination> examination);
+
 	std::vector<std::shared_ptr<FFmpegSubtitleStream>> _subtitle_streams;
 	std::shared_ptr<FFmpegSubtitleStream> _subtitle_stream;
 	boost::optional<dcpomatic::ContentTime> _first_video;
@@ -116,6 +129,7 @@ private:
 	boost::optional<AVColorTransferCharacteristic> _color_trc;
 	boost::optional<AVColorSpace> _colorspace;
 	boost::optional<int> _bits_per_pixel;
+	bool _examined_exactly = true;
 };
 
 #endif
@@ -28,6 +28,7 @@
 #include "audio_content.h"
 #include "audio_decoder.h"
 #include "compose.hpp"
+#include "config.h"
 #include "dcpomatic_log.h"
 #include "exceptions.h"
 #include "ffmpeg_audio_stream.h"
@@ -74,8 +75,8 @@ using dcp::Size;
 using namespace dcpomatic;
 
 
-FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmpegContent> c, bool fast)
-	: FFmpeg (c)
+FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmpegContent> c, bool fast, optional<int> decode_threads)
+	: FFmpeg (c, decode_threads.get_value_or(Config::instance()->decoding_threads()), Config::instance()->video_decode_hardware())
 	, Decoder (film)
 	, _filter_graphs(c->filters(), dcp::Fraction(lrint(_ffmpeg_content->video_frame_rate().get_value_or(24) * 1000), 1000))
 {
@@ -103,6 +104,36 @@ FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmp
 	for (auto i: c->ffmpeg_audio_streams()) {
 		_next_time[i] = boost::optional<dcpomatic::ContentTime>();
 	}
+
+	if (_video_stream && film->directory()) {
+		auto const index = film->seek_index_path(c);
+		if (boost::filesystem::exists(index)) {
+			try {
+				_seek_index = FFmpegSeekIndex (index);
+				_seek_index->apply (_format_context->streams[*_video_stream]);
+			} catch (std::exception& e) {
+				LOG_WARNING ("Could not read seek index %1 (%2)", index.string(), e.what());
+			}
+		}
+	}
+
+	auto const read_ahead = Config::instance()->read_ahead_size();
+	if (read_ahead > 0) {
+		use_read_ahead (int64_t(read_ahead) * 1024 * 1024, Config::instance()->read_ahead_threads());
+	}
+}
+
+
+/** Decode video at a reduced size, either because we will only be showing it small or
+ *  because we are short of time.  This must be called before anything is decoded.
+ *  @param reduction log2 of the factor by which the images should be made smaller than the source,
+ *  or boost::none for full size.
+ */
+void
+FFmpegDecoder::set_reduction (optional<int> reduction)
+{
+	_reduction = reduction.get_value_or(0);
+	_lowres = set_video_lowres (_reduction);
 }
 
 
@@ -180,6 +211,11 @@ FFmpegDecoder::flush ()
 bool
 FFmpegDecoder::pass ()
 {
+	if (_video_stream && video) {
+		/* Have the demuxer skip video packets if we are only going to ignore them */
+		_format_context->streams[_video_stream.get()]->discard = video->ignore() ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+	}
+
 	auto packet = av_packet_alloc();
 	DCPOMATIC_ASSERT (packet);
 
@@ -367,10 +403,13 @@ FFmpegDecoder::seek (ContentTime time, bool accurate)
 	Decoder::seek (time, accurate);
 
 	/* If we are doing an `accurate' seek, we need to use pre-roll, as
-	   we don't really know what the seek will give us.
+	   we don't really know what the seek will give us.  We don't need it
+	   if we have an index to find the keyframe before `time' with, unless there
+	   are subtitles which might have started before that keyframe.
 	*/
 
-	auto pre_roll = accurate ? ContentTime::from_seconds (2) : ContentTime (0);
+	bool const use_index = _seek_index && !_ffmpeg_content->subtitle_stream();
+	auto pre_roll = (accurate && !use_index) ? ContentTime::from_seconds (2) : ContentTime (0);
 	time -= pre_roll;
 
 	/* XXX: it seems debatable whether PTS should be used here...
@@ -379,8 +418,13 @@ FFmpegDecoder::seek (ContentTime time, bool accurate)
 
 	optional<int> stream;
 
-	if (_video_stream) {
+	auto const audio_streams = _ffmpeg_content->ffmpeg_audio_streams();
+
+	if (_video_stream && (!video || !video->ignore() || audio_streams.empty())) {
 		stream = _video_stream;
+	} else if (_video_stream) {
+		/* We are ignoring video, and its packets are being discarded, so seek using an audio stream */
+		stream = audio_streams.front()->index(_format_context);
 	} else {
 		DCPOMATIC_ASSERT (_ffmpeg_content->audio);
 		auto s = dynamic_pointer_cast<FFmpegAudioStream>(_ffmpeg_content->audio->stream());
@@ -395,17 +439,18 @@ FFmpegDecoder::seek (ContentTime time, bool accurate)
 	if (u < ContentTime ()) {
 		u = ContentTime ();
 	}
-	av_seek_frame (
-		_format_context,
-		stream.get(),
-		u.seconds() / av_q2d (_format_context->streams[stream.get()]->time_base),
-		AVSEEK_FLAG_BACKWARD
-		);
 
-	/* Force re-creation of filter graphs to reset them and hence to make sure
-	   they don't have any pre-seek frames knocking about.
-	*/
-	_filter_graphs.clear();
+	int64_t timestamp = u.seconds() / av_q2d (_format_context->streams[stream.get()]->time_base);
+	if (use_index && stream == _video_stream) {
+		if (auto keyframe = _seek_index->keyframe_before(timestamp)) {
+			timestamp = *keyframe;
+		}
+	}
+
+	av_seek_frame (_format_context, stream.get(), timestamp, AVSEEK_FLAG_BACKWARD);
+
+	/* Make sure the filter graphs don't have any pre-seek frames knocking about */
+	_filter_graphs.reset();
 
 	if (video_codec_context ()) {
 		avcodec_flush_buffers (video_codec_context());
@@ -567,6 +612,7 @@ FFmpegDecoder::decode_and_process_video_packet (AVPacket* packet)
 				throw DecodeError (N_("avcodec_receive_frame"), N_("FFmpeg::decode_and_process_video_packet"), r);
 			}
 
+			download_video_frame ();
 			process_video_frame ();
 		}
 	} while (pending);
@@ -588,9 +634,22 @@ FFmpegDecoder::process_video_frame ()
 		if (i.second != AV_NOPTS_VALUE) {
 			double const pts = i.second * av_q2d(_format_context->streams[_video_stream.get()]->time_base) + _pts_offset.seconds();
 
+			if (_reduction > _lowres) {
+				/* The codec couldn't do all the reduction we wanted, so do the rest here */
+				int const r = 1 << (_reduction - _lowres);
+				auto const size = image->size();
+				image = image->scale(
+					dcp::Size((size.width + r - 1) / r, (size.height + r - 1) / r),
+					dcp::YUVToRGB::REC601,
+					image->pixel_format(),
+					Image::Alignment::PADDED,
+					true
+					);
+			}
+
 			video->emit (
 				film(),
-				make_shared<RawImageProxy>(image),
+				make_shared<RawImageProxy>(image, _reduction),
 				llrint(pts * _ffmpeg_content->active_video_frame_rate(film()))
 				);
 		} else {
@@ -647,7 +706,9 @@ FFmpegDecoder::decode_and_process_subtitle_packet (AVPacket* packet)
 		case SUBTITLE_NONE:
 			break;
 		case SUBTITLE_BITMAP:
-			bitmap_text.subs.push_back(process_bitmap_subtitle(rect));
+			if (auto bitmap = process_bitmap_subtitle(rect)) {
+				bitmap_text.subs.push_back(*bitmap);
+			}
 			break;
 		case SUBTITLE_TEXT:
 			cout << "XXX: SUBTITLE_TEXT " << rect->text << "\n";
@@ -670,17 +731,13 @@ FFmpegDecoder::decode_and_process_subtitle_packet (AVPacket* packet)
 }
 
 
-BitmapText
+optional<BitmapText>
 FFmpegDecoder::process_bitmap_subtitle (AVSubtitleRect const * rect)
 {
-	/* Note BGRA is expressed little-endian, so the first byte in the word is B, second
-	   G, third R, fourth A.
-	*/
-	auto image = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size (rect->w, rect->h), Image::Alignment::PADDED);
-
 #ifdef DCPOMATIC_HAVE_AVSUBTITLERECT_PICT
 	/* Start of the first line in the subtitle */
 	auto sub_p = rect->pict.data[0];
+	auto const sub_stride = rect->pict.linesize[0];
 	/* sub_p looks up into a BGRA palette which is at rect->pict.data[1];
 	   (i.e. first byte B, second G, third R, fourth A)
 	*/
@@ -688,6 +745,7 @@ FFmpegDecoder::process_bitmap_subtitle (AVSubtitleRect const * rect)
 #else
 	/* Start of the first line in the subtitle */
 	auto sub_p = rect->data[0];
+	auto const sub_stride = rect->linesize[0];
 	/* sub_p looks up into a BGRA palette which is at rect->data[1].
 	   (first byte B, second G, third R, fourth A)
 	*/
@@ -713,25 +771,13 @@ FFmpegDecoder::process_bitmap_subtitle (AVSubtitleRect const * rect)
 		palette += 4;
 	}
 
-	/* Start of the output data */
-	auto out_p = image->data()[0];
-
-	for (int y = 0; y < rect->h; ++y) {
-		auto sub_line_p = sub_p;
-		auto out_line_p = out_p;
-		for (int x = 0; x < rect->w; ++x) {
-			auto const p = mapped_palette[*sub_line_p++];
-			*out_line_p++ = p.b;
-			*out_line_p++ = p.g;
-			*out_line_p++ = p.r;
-			*out_line_p++ = p.a;
-		}
-#ifdef DCPOMATIC_HAVE_AVSUBTITLERECT_PICT
-		sub_p += rect->pict.linesize[0];
-#else
-		sub_p += rect->linesize[0];
-#endif
-		out_p += image->stride()[0];
+	/* Keep only the part of the subtitle that is not transparent; DVB and PGS subtitles
+	   are often mostly transparent space, which we would otherwise scale and blend for
+	   every frame that they are on.
+	*/
+	auto const image = palette_image(sub_p, sub_stride, dcp::Size(rect->w, rect->h), mapped_palette);
+	if (!image) {
+		return {};
 	}
 
 	int target_width = subtitle_codec_context()->width;
@@ -739,22 +785,23 @@ FFmpegDecoder::process_bitmap_subtitle (AVSubtitleRect const * rect)
 		/* subtitle_codec_context()->width == 0 has been seen in the wild but I don't
 		   know if it's supposed to mean something from FFmpeg's point of view.
 		*/
-		target_width = video_codec_context()->width;
+		target_width = _format_context->streams[_video_stream.get()]->codecpar->width;
 	}
 	int target_height = subtitle_codec_context()->height;
 	if (target_height == 0 && video_codec_context()) {
-		target_height = video_codec_context()->height;
+		/* Use the stream's size rather than the context's, as the latter will be reduced if we are using lowres */
+		target_height = _format_context->streams[_video_stream.get()]->codecpar->height;
 	}
 	DCPOMATIC_ASSERT (target_width);
 	DCPOMATIC_ASSERT (target_height);
 	dcpomatic::Rect<double> const scaled_rect (
-		static_cast<double>(rect->x) / target_width,
-		static_cast<double>(rect->y) / target_height,
-		static_cast<double>(rect->w) / target_width,
-		static_cast<double>(rect->h) / target_height
+		static_cast<double>(rect->x + image->position.x) / target_width,
+		static_cast<double>(rect->y + image->position.y) / target_height,
+		static_cast<double>(image->image->size().width) / target_width,
+		static_cast<double>(image->image->size().height) / target_height
 		);
 
-	return { image, scaled_rect };
+	return BitmapText(image->image, scaled_rect);
 }
 
 
@@ -27,6 +27,7 @@
 #include "bitmap_text.h"
 #include "decoder.h"
 #include "ffmpeg.h"
+#include "ffmpeg_seek_index.h"
 #include "video_filter_graph_set.h"
 #include "util.h"
 extern "C" {
@@ -50,11 +51,24 @@ struct ffmpeg_pts_offset_test;
 class FFmpegDecoder : public FFmpeg, public Decoder
 {
 public:
-	FFmpegDecoder (std::shared_ptr<const Film> film, std::shared_ptr<const FFmpegContent>, bool fast);
+	/** @param decode_threads Number of threads to decode video with, or none to use all those in Config::decoding_threads() */
+	FFmpegDecoder (
+		std::shared_ptr<const Film> film,
+		std::shared_ptr<const FFmpegContent>,
+		bool fast,
+		boost::optional<int> decode_threads = boost::none
+		);
 
 	bool pass () override;
 	void seek (dcpomatic::ContentTime time, bool) override;
 
+	void set_reduction (boost::optional<int> reduction);
+
+	/** @return log2 of the factor by which we are reducing the size of images */
+	int reduction () const {
+		return _reduction;
+	}
+
 private:
 	friend struct ::ffmpeg_pts_offset_test;
 
@@ -72,7 +86,7 @@ private:
 	void decode_and_process_audio_packet (AVPacket* packet);
 	void decode_and_process_subtitle_packet (AVPacket* packet);
 
-	BitmapText process_bitmap_subtitle (AVSubtitleRect const * rect);
+	boost::optional<BitmapText> process_bitmap_subtitle (AVSubtitleRect const * rect);
 	void process_ass_subtitle (std::string ass, dcpomatic::ContentTime from);
 
 	void maybe_add_subtitle ();
@@ -86,5 +100,13 @@ private:
 
 	std::shared_ptr<Image> _black_image;
 
+	/** log2 of the factor by which we are reducing the size of images */
+	int _reduction = 0;
+	/** log2 of the part of _reduction which the codec is doing for us */
+	int _lowres = 0;
+
 	std::map<std::shared_ptr<FFmpegAudioStream>, boost::optional<dcpomatic::ContentTime>> _next_time;
+
+	/** keyframes of our video stream, if the examiner made an index of them */
+	boost::optional<FFmpegSeekIndex> _seek_index;
 };
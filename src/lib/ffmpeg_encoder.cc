@@ -22,6 +22,7 @@
 #include "butler.h"
 #include "cross.h"
 #include "ffmpeg_encoder.h"
+#include "ffmpeg_wrapper.h"
 #include "film.h"
 #include "image.h"
 #include "job.h"
@@ -29,6 +30,9 @@
 #include "player.h"
 #include "player_video.h"
 #include "compose.hpp"
+#include "dcpomatic_log.h"
+#include "scope_guard.h"
+#include "util.h"
 #include <iostream>
 
 #include "i18n.h"
@@ -39,6 +43,7 @@ using std::list;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using std::weak_ptr;
 using boost::bind;
 using boost::optional;
@@ -48,6 +53,12 @@ using namespace boost::placeholders;
 #endif
 
 
+/** Most segments that we will split an export into */
+static int constexpr maximum_segments = 8;
+/** Shortest segment that is worth exporting on its own */
+static auto const segment_minimum_length = DCPTime::from_seconds(60);
+
+
 FFmpegEncoder::FFmpegEncoder (
 	shared_ptr<const Film> film,
 	weak_ptr<Job> job,
@@ -59,6 +70,7 @@ FFmpegEncoder::FFmpegEncoder (
 	int x264_crf
 	)
 	: Encoder (film, job)
+	, _mixdown_to_stereo (mixdown_to_stereo)
 	, _output_audio_channels(mixdown_to_stereo ? 2 : (_film->audio_channels() > 8 ? 16 : _film->audio_channels()))
 	, _history (200)
 	, _output (output)
@@ -69,7 +81,7 @@ FFmpegEncoder::FFmpegEncoder (
 	, _butler(
 		_film,
 		_player,
-		mixdown_to_stereo ? stereo_map() : many_channel_map(),
+		mixdown_to_stereo ? stereo_map(_film->audio_channels()) : many_channel_map(),
 		_output_audio_channels,
 		boost::bind(&PlayerVideo::force, FFmpegFileEncoder::pixel_format(format)),
 		VideoRange::VIDEO,
@@ -84,13 +96,14 @@ FFmpegEncoder::FFmpegEncoder (
 }
 
 
+/** @return a mapping which mixes @p input_channels of DCP audio down to stereo */
 AudioMapping
-FFmpegEncoder::stereo_map() const
+FFmpegEncoder::stereo_map (int input_channels)
 {
-	auto map = AudioMapping(_film->audio_channels(), 2);
+	auto map = AudioMapping(input_channels, 2);
 	float const overall_gain = 2 / (4 + sqrt(2));
 	float const minus_3dB = 1 / sqrt(2);
-	switch (_film->audio_channels()) {
+	switch (input_channels) {
 	case 2:
 		map.set(dcp::Channel::LEFT, 0, 1);
 		map.set(dcp::Channel::RIGHT, 1, 1);
@@ -127,6 +140,109 @@ FFmpegEncoder::many_channel_map() const
 }
 
 
+/** @return the number of segments that we should split our export into, so that each can be
+ *  exported by its own thread, or 1 to export in one go.
+ */
+int
+FFmpegEncoder::segments_wanted () const
+{
+	/* Each segment is exported into a file of its own which we join together afterwards,
+	   so this only works for formats where each frame stands on its own.
+	*/
+	if (_format != ExportFormat::PRORES_4444 && _format != ExportFormat::PRORES_HQ) {
+		return 1;
+	}
+
+	if (_split_reels || _film->three_d()) {
+		return 1;
+	}
+
+	/* The ProRes encoder has some threads of its own, and there is a player and a butler
+	   for each segment, so don't try to use every core for a segment.
+	*/
+	int const by_threads = std::min(static_cast<int>(boost::thread::hardware_concurrency() / 4), maximum_segments);
+	int const by_length = _film->length().get() / segment_minimum_length.get();
+	return std::max(1, std::min(by_threads, by_length));
+}
+
+
+/** Split @p film into @p count segments, of roughly equal length, for exporting in parallel.
+ *  Segments are made to start at reel boundaries where there is one nearby, and otherwise
+ *  at a frame boundary.
+ */
+vector<DCPTimePeriod>
+FFmpegEncoder::segments (shared_ptr<const Film> film, int count)
+{
+	DCPOMATIC_ASSERT (count > 0);
+
+	auto const length = film->length();
+	auto const rate = film->video_frame_rate();
+	auto const ideal = DCPTime(length.get() / count);
+
+	vector<DCPTime> starts = { DCPTime() };
+	for (int i = 1; i < count; ++i) {
+		auto start = DCPTime(ideal.get() * i);
+		for (auto reel: film->reels()) {
+			if (reel.from > DCPTime() && (reel.from - start).abs() < DCPTime(ideal.get() / 4)) {
+				start = reel.from;
+			}
+		}
+		start = start.round(rate);
+		if (start > starts.back() && start < length) {
+			starts.push_back (start);
+		}
+	}
+
+	vector<DCPTimePeriod> periods;
+	for (size_t i = 0; i < starts.size(); ++i) {
+		periods.push_back (DCPTimePeriod(starts[i], i == starts.size() - 1 ? length : starts[i + 1]));
+	}
+	return periods;
+}
+
+
+/** Get the video and audio for one frame from @p butler and give it to @p encoder.
+ *  @param start Time at the start of @p encoder's file.
+ */
+void
+FFmpegEncoder::encode_frame (
+	Butler& butler,
+	FileEncoderSet& encoder,
+	DCPTime start,
+	std::vector<float>& interleaved,
+	shared_ptr<AudioBuffers> deinterleaved
+	)
+{
+	int const gets_per_frame = _film->three_d() ? 2 : 1;
+	for (int j = 0; j < gets_per_frame; ++j) {
+		Butler::Error e;
+		auto v = butler.get_video(Butler::Behaviour::BLOCKING, &e);
+		butler.rethrow();
+		if (v.first) {
+			auto fe = encoder.get (v.first->eyes());
+			if (fe) {
+				fe->video(v.first, v.second - start);
+			}
+		} else {
+			if (e.code != Butler::Error::Code::FINISHED) {
+				throw DecodeError(String::compose("Error during decoding: %1", e.summary()));
+			}
+		}
+	}
+
+	int const audio_frames = deinterleaved->frames();
+	butler.get_audio(Butler::Behaviour::BLOCKING, interleaved.data(), audio_frames);
+	/* XXX: inefficient; butler interleaves and we deinterleave again */
+	float* p = interleaved.data();
+	for (int j = 0; j < audio_frames; ++j) {
+		for (int k = 0; k < _output_audio_channels; ++k) {
+			deinterleaved->data(k)[j] = *p++;
+		}
+	}
+	encoder.audio (deinterleaved);
+}
+
+
 void
 FFmpegEncoder::go ()
 {
@@ -136,6 +252,15 @@ FFmpegEncoder::go ()
 		job->sub (_("Encoding"));
 	}
 
+	int const wanted = segments_wanted ();
+	if (wanted > 1) {
+		auto periods = segments (_film, wanted);
+		if (periods.size() > 1) {
+			go_segmented (periods);
+			return;
+		}
+	}
+
 	Waker waker;
 
 	list<FileEncoderSet> file_encoders;
@@ -177,7 +302,6 @@ FFmpegEncoder::go ()
 	int const audio_frames = video_frame.frames_round(_film->audio_frame_rate());
 	std::vector<float> interleaved(_output_audio_channels * audio_frames);
 	auto deinterleaved = make_shared<AudioBuffers>(_output_audio_channels, audio_frames);
-	int const gets_per_frame = _film->three_d() ? 2 : 1;
 	for (DCPTime i; i < _film->length(); i += video_frame) {
 
 		if (file_encoders.size() > 1 && !reel->contains(i)) {
@@ -188,21 +312,7 @@ FFmpegEncoder::go ()
 			DCPOMATIC_ASSERT (encoder != file_encoders.end());
 		}
 
-		for (int j = 0; j < gets_per_frame; ++j) {
-			Butler::Error e;
-			auto v = _butler.get_video(Butler::Behaviour::BLOCKING, &e);
-			_butler.rethrow();
-			if (v.first) {
-				auto fe = encoder->get (v.first->eyes());
-				if (fe) {
-					fe->video(v.first, v.second - reel->from);
-				}
-			} else {
-				if (e.code != Butler::Error::Code::FINISHED) {
-					throw DecodeError(String::compose("Error during decoding: %1", e.summary()));
-				}
-			}
-		}
+		encode_frame (_butler, *encoder, reel->from, interleaved, deinterleaved);
 
 		_history.event ();
 
@@ -217,23 +327,279 @@ FFmpegEncoder::go ()
 		}
 
 		waker.nudge ();
+	}
+
+	for (auto i: file_encoders) {
+		i.flush ();
+	}
+}
+
+
+/** Join some files, which each have the same streams set up in the same way and each start
+ *  at time zero, into one file without re-encoding them.
+ */
+static void
+concatenate_video_files (vector<boost::filesystem::path> const& inputs, boost::filesystem::path output)
+{
+	DCPOMATIC_ASSERT (!inputs.empty());
+
+	AVFormatContext* output_context = nullptr;
+	int r = avformat_alloc_output_context2 (&output_context, nullptr, nullptr, output.string().c_str());
+	if (!output_context) {
+		throw EncodeError (N_("avformat_alloc_output_context2"), N_("concatenate_video_files"), r);
+	}
+
+	ScopeGuard sg = [&output_context]() {
+		if (output_context->pb) {
+			avio_close (output_context->pb);
+		}
+		avformat_free_context (output_context);
+	};
+
+	/* Where each stream of the next input should start, in the output stream's time base */
+	vector<int64_t> offsets;
+
+	for (auto const& input: inputs) {
+		AVFormatContext* input_context = nullptr;
+		r = avformat_open_input (&input_context, input.string().c_str(), nullptr, nullptr);
+		if (r < 0) {
+			throw EncodeError (N_("avformat_open_input"), N_("concatenate_video_files"), r);
+		}
+
+		ScopeGuard close = [&input_context]() {
+			avformat_close_input (&input_context);
+		};
+
+		r = avformat_find_stream_info (input_context, nullptr);
+		if (r < 0) {
+			throw EncodeError (N_("avformat_find_stream_info"), N_("concatenate_video_files"), r);
+		}
+
+		if (offsets.empty()) {
+			/* Set the output up to be like the first input */
+			for (unsigned int i = 0; i < input_context->nb_streams; ++i) {
+				auto stream = avformat_new_stream (output_context, nullptr);
+				if (!stream) {
+					throw EncodeError (N_("avformat_new_stream"), N_("concatenate_video_files"));
+				}
+				r = avcodec_parameters_copy (stream->codecpar, input_context->streams[i]->codecpar);
+				if (r < 0) {
+					throw EncodeError (N_("avcodec_parameters_copy"), N_("concatenate_video_files"), r);
+				}
+				stream->codecpar->codec_tag = 0;
+				stream->time_base = input_context->streams[i]->time_base;
+				stream->disposition = input_context->streams[i]->disposition;
+			}
+
+			r = avio_open_boost (&output_context->pb, output, AVIO_FLAG_WRITE);
+			if (r < 0) {
+				throw EncodeError (String::compose(_("Could not open output file %1 (%2)"), output.string(), r));
+			}
 
-		_butler.get_audio(Butler::Behaviour::BLOCKING, interleaved.data(), audio_frames);
-		/* XXX: inefficient; butler interleaves and we deinterleave again */
-		float* p = interleaved.data();
-		for (int j = 0; j < audio_frames; ++j) {
-			for (int k = 0; k < _output_audio_channels; ++k) {
-				deinterleaved->data(k)[j] = *p++;
+			r = avformat_write_header (output_context, nullptr);
+			if (r < 0) {
+				throw EncodeError (N_("avformat_write_header"), N_("concatenate_video_files"), r);
 			}
+
+			offsets.resize (output_context->nb_streams);
 		}
-		encoder->audio (deinterleaved);
+
+		DCPOMATIC_ASSERT (input_context->nb_streams == output_context->nb_streams);
+		auto ends = offsets;
+
+		while (true) {
+			ffmpeg::Packet packet;
+			if (av_read_frame(input_context, packet.get()) < 0) {
+				break;
+			}
+
+			auto const index = packet->stream_index;
+			av_packet_rescale_ts (packet.get(), input_context->streams[index]->time_base, output_context->streams[index]->time_base);
+			if (packet->pts != AV_NOPTS_VALUE) {
+				packet->pts += offsets[index];
+			}
+			if (packet->dts != AV_NOPTS_VALUE) {
+				packet->dts += offsets[index];
+			}
+			if (packet->pts != AV_NOPTS_VALUE) {
+				ends[index] = std::max(ends[index], packet->pts + packet->duration);
+			}
+
+			r = av_interleaved_write_frame (output_context, packet.get());
+			if (r < 0) {
+				throw EncodeError (N_("av_interleaved_write_frame"), N_("concatenate_video_files"), r);
+			}
+		}
+
+		offsets = ends;
 	}
 
-	for (auto i: file_encoders) {
-		i.flush ();
+	r = av_write_trailer (output_context);
+	if (r < 0) {
+		throw EncodeError (N_("av_write_trailer"), N_("concatenate_video_files"), r);
 	}
 }
 
+
+/** Export each of @p periods into a file of its own, using a thread for each, and then
+ *  join the files together to make our output.
+ */
+void
+FFmpegEncoder::go_segmented (vector<DCPTimePeriod> periods)
+{
+	Waker waker;
+
+	auto const extension = boost::filesystem::extension(_output);
+	auto const stem = boost::filesystem::change_extension(_output, "").string();
+
+	vector<boost::filesystem::path> parts;
+	for (size_t i = 0; i < periods.size(); ++i) {
+		parts.push_back (String::compose("%1.part%2", stem, i + 1));
+	}
+
+	ScopeGuard sg = [&parts]() {
+		for (auto const& part: parts) {
+			boost::system::error_code ec;
+			boost::filesystem::remove (part.string() + extension, ec);
+		}
+	};
+
+	LOG_GENERAL ("Exporting %1 in %2 segments", _output.string(), periods.size());
+
+	vector<std::exception_ptr> errors(periods.size());
+	std::atomic<bool> failed(false);
+	std::atomic<size_t> finished(0);
+	vector<std::atomic<Frame>> done(periods.size());
+	for (auto& i: done) {
+		i = 0;
+	}
+
+	boost::thread_group threads;
+	ScopeGuard stop = [&threads, &failed]() {
+		boost::this_thread::disable_interruption dis;
+		failed = true;
+		threads.join_all ();
+	};
+
+	for (size_t i = 0; i < periods.size(); ++i) {
+		threads.create_thread ([this, i, &periods, &parts, &extension, &errors, &failed, &finished, &done]() {
+			start_of_thread ("FFmpegEncoder");
+			try {
+				encode_segment (periods[i], parts[i], extension, failed, done[i]);
+			} catch (...) {
+				errors[i] = std::current_exception();
+				failed = true;
+			}
+			++finished;
+		});
+	}
+
+	auto const rate = _film->video_frame_rate();
+	auto const total = _film->length().frames_round(rate);
+
+	while (true) {
+		Frame frames = 0;
+		for (auto const& i: done) {
+			frames += i;
+		}
+
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			_last_time = DCPTime::from_frames(frames, rate);
+		}
+
+		auto job = _job.lock ();
+		if (job) {
+			job->set_progress (float(frames) / total);
+		}
+
+		waker.nudge ();
+
+		if (failed || finished == periods.size()) {
+			break;
+		}
+
+		dcpomatic_sleep_milliseconds (250);
+	}
+
+	threads.join_all ();
+
+	for (auto error: errors) {
+		if (error) {
+			std::rethrow_exception (error);
+		}
+	}
+
+	vector<boost::filesystem::path> files;
+	for (auto const& part: parts) {
+		files.push_back (part.string() + extension);
+	}
+
+	auto job = _job.lock ();
+	if (job) {
+		job->sub (_("Joining segments"));
+	}
+
+	concatenate_video_files (files, _output);
+}
+
+
+/** Export the part of our film in @p period to a file at @p output, using a Player and Butler of its own.
+ *  @param failed Set by someone else if we should stop because something has gone wrong.
+ *  @param done Updated with the number of frames that we have done.
+ */
+void
+FFmpegEncoder::encode_segment (DCPTimePeriod period, boost::filesystem::path output, string extension, std::atomic<bool>& failed, std::atomic<Frame>& done)
+{
+	Player player(_film, Image::Alignment::PADDED);
+	player.set_always_burn_open_subtitles();
+	player.set_play_referenced();
+
+	Butler butler(
+		_film,
+		player,
+		_mixdown_to_stereo ? stereo_map(_film->audio_channels()) : many_channel_map(),
+		_output_audio_channels,
+		boost::bind(&PlayerVideo::force, FFmpegFileEncoder::pixel_format(_format)),
+		VideoRange::VIDEO,
+		Image::Alignment::PADDED,
+		false,
+		false,
+		Butler::Audio::ENABLED
+		);
+
+	butler.seek (period.from, true);
+
+	FileEncoderSet encoder(
+		_film->frame_size(),
+		_film->video_frame_rate(),
+		_film->audio_frame_rate(),
+		_output_audio_channels,
+		_format,
+		_audio_stream_per_channel,
+		_x264_crf,
+		false,
+		output,
+		extension
+		);
+
+	auto const video_frame = DCPTime::from_frames (1, _film->video_frame_rate ());
+	int const audio_frames = video_frame.frames_round(_film->audio_frame_rate());
+	std::vector<float> interleaved(_output_audio_channels * audio_frames);
+	auto deinterleaved = make_shared<AudioBuffers>(_output_audio_channels, audio_frames);
+	for (DCPTime i = period.from; i < period.to; i += video_frame) {
+		if (failed) {
+			return;
+		}
+		encode_frame (butler, encoder, period.from, interleaved, deinterleaved);
+		_history.event ();
+		++done;
+	}
+
+	encoder.flush ();
+}
+
+
 optional<float>
 FFmpegEncoder::current_rate () const
 {
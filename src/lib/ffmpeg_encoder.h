@@ -26,6 +26,7 @@
 #include "encoder.h"
 #include "event_history.h"
 #include "ffmpeg_file_encoder.h"
+#include <atomic>
 
 
 class FFmpegEncoder : public Encoder
@@ -50,6 +51,9 @@ public:
 		return false;
 	}
 
+	static std::vector<dcpomatic::DCPTimePeriod> segments (std::shared_ptr<const Film> film, int count);
+	static AudioMapping stereo_map (int input_channels);
+
 private:
 
 	class FileEncoderSet
@@ -76,9 +80,20 @@ private:
 		std::map<Eyes, std::shared_ptr<FFmpegFileEncoder>> _encoders;
 	};
 
-	AudioMapping stereo_map() const;
 	AudioMapping many_channel_map() const;
 
+	int segments_wanted () const;
+	void go_segmented (std::vector<dcpomatic::DCPTimePeriod> periods);
+	void encode_segment (dcpomatic::DCPTimePeriod period, boost::filesystem::path output, std::string extension, std::atomic<bool>& failed, std::atomic<Frame>& done);
+	void encode_frame (
+		Butler& butler,
+		FileEncoderSet& encoder,
+		dcpomatic::DCPTime start,
+		std::vector<float>& interleaved,
+		std::shared_ptr<AudioBuffers> deinterleaved
+		);
+
+	bool _mixdown_to_stereo;
 	int _output_audio_channels;
 
 	mutable boost::mutex _mutex;
@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ffmpeg_audio_stream.h"
+#include "ffmpeg_examination.h"
+#include "ffmpeg_examiner.h"
+#include "ffmpeg_subtitle_stream.h"
+#include <boost/thread/mutex.hpp>
+#include <list>
+
+
+using std::list;
+using std::make_pair;
+using std::make_shared;
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+/** Number of examinations to keep in the cache */
+static int const cache_size = 256;
+static boost::mutex cache_mutex;
+/** Cached examinations with their content digests, most recently used first */
+static list<pair<string, shared_ptr<const FFmpegExamination>>> cache;
+
+
+FFmpegExamination::FFmpegExamination (FFmpegExaminer const& examiner)
+	: _has_video (examiner.has_video())
+	, _first_video (examiner.first_video())
+	, _rotation (examiner.rotation())
+	, _pulldown (examiner.pulldown())
+	, _seek_index (examiner.seek_index())
+	, _exact (examiner.exact())
+{
+	if (_has_video) {
+		_video_frame_rate = examiner.video_frame_rate();
+		_video_size = examiner.video_size();
+		_video_length = examiner.video_length();
+		_sample_aspect_ratio = examiner.sample_aspect_ratio();
+		_yuv = examiner.yuv();
+		_range = examiner.range();
+		_pixel_quanta = examiner.pixel_quanta();
+		_color_range = examiner.color_range();
+		_color_primaries = examiner.color_primaries();
+		_color_trc = examiner.color_trc();
+		_colorspace = examiner.colorspace();
+		_bits_per_pixel = examiner.bits_per_pixel();
+	}
+
+	for (auto i: examiner.subtitle_streams()) {
+		_subtitle_streams.push_back (i);
+	}
+
+	for (auto i: examiner.audio_streams()) {
+		_audio_streams.push_back (i);
+	}
+}
+
+
+vector<shared_ptr<FFmpegSubtitleStream>>
+FFmpegExamination::subtitle_streams () const
+{
+	vector<shared_ptr<FFmpegSubtitleStream>> out;
+	for (auto i: _subtitle_streams) {
+		out.push_back (make_shared<FFmpegSubtitleStream>(i->name, i->id()));
+	}
+	return out;
+}
+
+
+vector<shared_ptr<FFmpegAudioStream>>
+FFmpegExamination::audio_streams () const
+{
+	vector<shared_ptr<FFmpegAudioStream>> out;
+	for (auto i: _audio_streams) {
+		auto copy = make_shared<FFmpegAudioStream>(i->name, i->id(), i->frame_rate(), i->length(), i->mapping());
+		copy->codec_name = i->codec_name;
+		copy->first_audio = i->first_audio;
+		out.push_back (copy);
+	}
+	return out;
+}
+
+
+shared_ptr<const FFmpegExamination>
+FFmpegExamination::cached (string digest)
+{
+	boost::mutex::scoped_lock lm (cache_mutex);
+
+	for (auto i = cache.begin(); i != cache.end(); ++i) {
+		if (i->first == digest) {
+			auto examination = i->second;
+			cache.erase (i);
+			cache.push_front (make_pair(digest, examination));
+			return examination;
+		}
+	}
+
+	return {};
+}
+
+
+void
+FFmpegExamination::add_to_cache (string digest, shared_ptr<const FFmpegExamination> examination)
+{
+	boost::mutex::scoped_lock lm (cache_mutex);
+
+	cache.remove_if ([digest](pair<string, shared_ptr<const FFmpegExamination>> const& i) { return i.first == digest; });
+	cache.push_front (make_pair(digest, examination));
+	while (static_cast<int>(cache.size()) > cache_size) {
+		cache.pop_back ();
+	}
+}
@@ -0,0 +1,160 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_FFMPEG_EXAMINATION_H
+#define DCPOMATIC_FFMPEG_EXAMINATION_H
+
+
+#include "dcpomatic_time.h"
+#include "ffmpeg_seek_index.h"
+#include "video_examiner.h"
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <boost/optional.hpp>
+
+
+class FFmpegAudioStream;
+class FFmpegExaminer;
+class FFmpegSubtitleStream;
+
+
+/** @class FFmpegExamination
+ *  @brief The results of running an FFmpegExaminer over some content, kept after the examiner
+ *  (and its open file) has gone.
+ *
+ *  These are cached by the digest of the content that was examined, so that adding the same
+ *  files again does not mean reading them all the way through again.
+ */
+class FFmpegExamination : public VideoExaminer
+{
+public:
+	explicit FFmpegExamination (FFmpegExaminer const& examiner);
+
+	bool has_video () const override {
+		return _has_video;
+	}
+
+	boost::optional<double> video_frame_rate () const override {
+		return _video_frame_rate;
+	}
+
+	dcp::Size video_size () const override {
+		return _video_size;
+	}
+
+	Frame video_length () const override {
+		return _video_length;
+	}
+
+	boost::optional<double> sample_aspect_ratio () const override {
+		return _sample_aspect_ratio;
+	}
+
+	bool yuv () const override {
+		return _yuv;
+	}
+
+	VideoRange range () const override {
+		return _range;
+	}
+
+	PixelQuanta pixel_quanta () const override {
+		return _pixel_quanta;
+	}
+
+	/** @return New copies of the subtitle streams, so that each piece of content can change its own */
+	std::vector<std::shared_ptr<FFmpegSubtitleStream>> subtitle_streams () const;
+	/** @return New copies of the audio streams, so that each piece of content can change its own */
+	std::vector<std::shared_ptr<FFmpegAudioStream>> audio_streams () const;
+
+	boost::optional<dcpomatic::ContentTime> first_video () const {
+		return _first_video;
+	}
+
+	AVColorRange color_range () const {
+		return _color_range;
+	}
+
+	AVColorPrimaries color_primaries () const {
+		return _color_primaries;
+	}
+
+	AVColorTransferCharacteristic color_trc () const {
+		return _color_trc;
+	}
+
+	AVColorSpace colorspace () const {
+		return _colorspace;
+	}
+
+	boost::optional<int> bits_per_pixel () const {
+		return _bits_per_pixel;
+	}
+
+	boost::optional<double> rotation () const {
+		return _rotation;
+	}
+
+	bool pulldown () const {
+		return _pulldown;
+	}
+
+	boost::optional<FFmpegSeekIndex> const& seek_index () const {
+		return _seek_index;
+	}
+
+	bool exact () const {
+		return _exact;
+	}
+
+	/** @return A cached examination of content with the given digest, or nullptr */
+	static std::shared_ptr<const FFmpegExamination> cached (std::string digest);
+	static void add_to_cache (std::string digest, std::shared_ptr<const FFmpegExamination> examination);
+
+private:
+	bool _has_video;
+	boost::optional<double> _video_frame_rate;
+	dcp::Size _video_size;
+	Frame _video_length = 0;
+	boost::optional<double> _sample_aspect_ratio;
+	bool _yuv = false;
+	VideoRange _range = VideoRange::FULL;
+	PixelQuanta _pixel_quanta;
+
+	std::vector<std::shared_ptr<const FFmpegSubtitleStream>> _subtitle_streams;
+	std::vector<std::shared_ptr<const FFmpegAudioStream>> _audio_streams;
+	boost::optional<dcpomatic::ContentTime> _first_video;
+
+	AVColorRange _color_range = AVCOL_RANGE_UNSPECIFIED;
+	AVColorPrimaries _color_primaries = AVCOL_PRI_UNSPECIFIED;
+	AVColorTransferCharacteristic _color_trc = AVCOL_TRC_UNSPECIFIED;
+	AVColorSpace _colorspace = AVCOL_SPC_UNSPECIFIED;
+	boost::optional<int> _bits_per_pixel;
+
+	boost::optional<double> _rotation;
+	bool _pulldown = false;
+	boost::optional<FFmpegSeekIndex> _seek_index;
+	bool _exact = true;
+};
+
+
+#endif
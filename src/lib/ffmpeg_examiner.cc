@@ -19,6 +19,7 @@
 */
 
 
+#include "config.h"
 #include "dcpomatic_log.h"
 #include "ffmpeg_examiner.h"
 #include "ffmpeg_content.h"
@@ -59,9 +60,14 @@ using namespace dcpomatic;
 static const int PULLDOWN_CHECK_FRAMES = 16;
 
 
-/** @param job job that the examiner is operating in, or 0 */
-FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Job> job)
-	: FFmpeg (c)
+/** @param job job that the examiner is operating in, or 0.
+ *  @param quick true to make an examination that can be used straight away, without reading
+ *  the whole file.  There will be no seek index, and if the header does not give the length
+ *  it is estimated from the timestamps near the end of the file.  exact() says whether
+ *  anything was missed out.
+ */
+FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Job> job, bool quick)
+	: FFmpeg (c, Config::instance()->decoding_threads())
 	, _video_length (0)
 	, _need_video_length (false)
 	, _pulldown (false)
@@ -100,15 +106,33 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 		}
 	}
 
+	bool estimate_length = false;
 	if (has_video ()) {
 		/* See if the header has duration information in it */
 		_need_video_length = _format_context->duration == AV_NOPTS_VALUE;
 		if (!_need_video_length) {
 			_video_length = llrint ((double (_format_context->duration) / AV_TIME_BASE) * video_frame_rate().get());
+		} else if (quick) {
+			_need_video_length = false;
+			estimate_length = true;
 		}
 	}
 
-	if (job && _need_video_length) {
+	/* MPEG transport and program streams (including VOB) and some MXFs have poor or missing indexes,
+	 * so FFmpeg can be slow, or inaccurate, when seeking in them.  For those we read the whole file
+	 * and note where the video keyframes are.
+	 */
+	if (_video_stream && ((_format_context->iformat->flags & AVFMT_TS_DISCONT) || string(_format_context->iformat->name) == "mxf")) {
+		if (quick) {
+			_exact = false;
+		} else {
+			_seek_index = FFmpegSeekIndex ();
+		}
+	}
+
+	if (job && _seek_index) {
+		job->sub (_("Indexing"));
+	} else if (job && _need_video_length) {
 		job->sub (_("Finding length"));
 	}
 
@@ -145,6 +169,12 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 
 		if (_video_stream && packet->stream_index == _video_stream.get()) {
 			video_packet (context, temporal_reference, packet);
+			if (_seek_index && (packet->flags & AV_PKT_FLAG_KEY) && packet->pos >= 0) {
+				auto const timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+				if (timestamp != AV_NOPTS_VALUE) {
+					_seek_index->add (timestamp, packet->pos);
+				}
+			}
 		}
 
 		bool got_all_audio = true;
@@ -160,7 +190,7 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 
 		av_packet_free (&packet);
 
-		if (_first_video && got_all_audio && temporal_reference.size() >= (PULLDOWN_CHECK_FRAMES * 2)) {
+		if (_first_video && got_all_audio && temporal_reference.size() >= (PULLDOWN_CHECK_FRAMES * 2) && !_seek_index && !_need_video_length) {
 			/* All done */
 			break;
 		}
@@ -176,6 +206,12 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 		audio_packet(context, i, nullptr);
 	}
 
+	if (estimate_length) {
+		_video_length = estimate_video_length().get_value_or(0);
+		_exact = false;
+		LOG_GENERAL("Estimated video length as %1 frames", _video_length);
+	}
+
 	if (_video_stream) {
 		/* This code taken from get_rotation() in ffmpeg:cmdutils.c */
 		auto stream = _format_context->streams[*_video_stream];
@@ -296,6 +332,46 @@ FFmpegExaminer::frame_time (AVFrame* frame, AVStream* stream) const
 }
 
 
+/** @return Estimate of the video length, found by looking at the timestamps of the video packets
+ *  in the last part of the file.  This means that we do not have to decode the whole file to
+ *  find the last frame.
+ */
+optional<Frame>
+FFmpegExaminer::estimate_video_length ()
+{
+	DCPOMATIC_ASSERT (_video_stream);
+
+	/* Enough to be sure of finding a few video packets, even at high bit-rates */
+	int64_t const tail = 16 * 1024 * 1024;
+	auto const length = _file_group.length ();
+	if (av_seek_frame(_format_context, -1, std::max(int64_t(0), length - tail), AVSEEK_FLAG_BYTE) < 0) {
+		return {};
+	}
+
+	auto stream = _format_context->streams[*_video_stream];
+	optional<int64_t> last;
+	auto packet = av_packet_alloc ();
+	DCPOMATIC_ASSERT (packet);
+	while (av_read_frame(_format_context, packet) >= 0) {
+		if (packet->stream_index == *_video_stream) {
+			auto const timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+			if (timestamp != AV_NOPTS_VALUE) {
+				last = std::max(last.get_value_or(timestamp), timestamp);
+			}
+		}
+		av_packet_unref (packet);
+	}
+	av_packet_free (&packet);
+
+	if (!last) {
+		return {};
+	}
+
+	/* This is the same as we get by decoding everything: the time of the last frame rounded to frames */
+	return ContentTime::from_seconds(*last * av_q2d(stream->time_base)).frames_round(video_frame_rate().get());
+}
+
+
 optional<double>
 FFmpegExaminer::video_frame_rate () const
 {
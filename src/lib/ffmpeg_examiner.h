@@ -20,6 +20,7 @@
 
 
 #include "ffmpeg.h"
+#include "ffmpeg_seek_index.h"
 #include "video_examiner.h"
 #include <boost/optional.hpp>
 
@@ -33,7 +34,7 @@ class Job;
 class FFmpegExaminer : public FFmpeg, public VideoExaminer
 {
 public:
-	FFmpegExaminer (std::shared_ptr<const FFmpegContent>, std::shared_ptr<Job> job = std::shared_ptr<Job>());
+	FFmpegExaminer (std::shared_ptr<const FFmpegContent>, std::shared_ptr<Job> job = std::shared_ptr<Job>(), bool quick = false);
 
 	bool has_video () const override;
 
@@ -85,6 +86,18 @@ public:
 		return _pulldown;
 	}
 
+	/** @return Keyframes of the video stream, if the file's format is one whose own index may not be good enough to seek with */
+	boost::optional<FFmpegSeekIndex> const& seek_index () const {
+		return _seek_index;
+	}
+
+	/** @return true if we found out everything that we could, false if a quick examination
+	 *  skipped the seek index or estimated the length.
+	 */
+	bool exact () const {
+		return _exact;
+	}
+
 private:
 	bool video_packet (AVCodecContext* context, std::string& temporal_reference, AVPacket* packet);
 	void audio_packet (AVCodecContext* context, std::shared_ptr<FFmpegAudioStream>, AVPacket* packet);
@@ -92,6 +105,7 @@ private:
 	std::string stream_name (AVStream* s) const;
 	std::string subtitle_stream_name (AVStream* s) const;
 	boost::optional<dcpomatic::ContentTime> frame_time (AVFrame* frame, AVStream* stream) const;
+	boost::optional<Frame> estimate_video_length ();
 
 	std::vector<std::shared_ptr<FFmpegSubtitleStream>> _subtitle_streams;
 	std::vector<std::shared_ptr<FFmpegAudioStream>> _audio_streams;
@@ -104,6 +118,8 @@ private:
 
 	boost::optional<double> _rotation;
 	bool _pulldown;
+	boost::optional<FFmpegSeekIndex> _seek_index;
+	bool _exact = true;
 
 	struct SubtitleStart
 	{
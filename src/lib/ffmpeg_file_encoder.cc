@@ -29,9 +29,12 @@
 #include "log.h"
 #include "player.h"
 #include "player_video.h"
+#include "util.h"
+#include <boost/algorithm/string.hpp>
 extern "C" {
 #include <libavutil/channel_layout.h>
 }
+#include <cmath>
 #include <iostream>
 
 #include "i18n.h"
@@ -50,6 +53,10 @@ using namespace boost::placeholders;
 
 int FFmpegFileEncoder::_video_stream_index = 0;
 int FFmpegFileEncoder::_audio_stream_index_base = 1;
+/** Number of pieces of video or audio that we will queue up for our thread before
+ *  holding up the caller.
+ */
+int const FFmpegFileEncoder::_queue_length = 8;
 
 
 class ExportAudioStream
@@ -220,6 +227,7 @@ FFmpegFileEncoder::FFmpegFileEncoder (
 	)
 	: _audio_stream_per_channel (audio_stream_per_channel)
 	, _audio_channels (channels)
+	, _x264_crf (x264_crf)
 	, _output (output)
 	, _video_frame_size (video_frame_size)
 	, _video_frame_rate (video_frame_rate)
@@ -230,23 +238,40 @@ FFmpegFileEncoder::FFmpegFileEncoder (
 	switch (format) {
 	case ExportFormat::PRORES_4444:
 		_sample_format = AV_SAMPLE_FMT_S16;
-		_video_codec_name = "prores_ks";
+		_video_codec_names = { "prores_ks" };
 		_audio_codec_name = "pcm_s16le";
 		av_dict_set(&_video_options, "profile", "4", 0);
 		av_dict_set(&_video_options, "threads", "auto", 0);
 		break;
 	case ExportFormat::PRORES_HQ:
 		_sample_format = AV_SAMPLE_FMT_S16;
-		_video_codec_name = "prores_ks";
+		_video_codec_names = { "prores_ks" };
 		_audio_codec_name = "pcm_s16le";
 		av_dict_set (&_video_options, "profile", "3", 0);
 		av_dict_set (&_video_options, "threads", "auto", 0);
 		break;
 	case ExportFormat::H264_AAC:
 		_sample_format = AV_SAMPLE_FMT_FLTP;
-		_video_codec_name = "libx264";
+		_video_codec_names = { "libx264" };
 		_audio_codec_name = "aac";
 		av_dict_set_int (&_video_options, "crf", x264_crf, 0);
+		av_dict_set (&_video_options, "threads", "auto", 0);
+		break;
+	case ExportFormat::H264_HARDWARE_AAC:
+		/* Hardware encoders first, falling back to x264 */
+		_sample_format = AV_SAMPLE_FMT_FLTP;
+		_video_codec_names = { "h264_nvenc", "h264_qsv", "h264_videotoolbox", "h264_amf", "libx264" };
+		_audio_codec_name = "aac";
+		av_dict_set_int (&_video_options, "crf", x264_crf, 0);
+		av_dict_set (&_video_options, "threads", "auto", 0);
+		break;
+	case ExportFormat::HEVC_HARDWARE_AAC:
+		/* Hardware encoders first, falling back to x265 */
+		_sample_format = AV_SAMPLE_FMT_FLTP;
+		_video_codec_names = { "hevc_nvenc", "hevc_qsv", "hevc_videotoolbox", "hevc_amf", "libx265" };
+		_audio_codec_name = "aac";
+		av_dict_set_int (&_video_options, "crf", x264_crf, 0);
+		av_dict_set (&_video_options, "threads", "auto", 0);
 		break;
 	default:
 		DCPOMATIC_ASSERT (false);
@@ -273,11 +298,28 @@ FFmpegFileEncoder::FFmpegFileEncoder (
 	}
 
 	_pending_audio = make_shared<AudioBuffers>(channels, 0);
+
+	_thread = boost::thread (boost::bind(&FFmpegFileEncoder::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread.native_handle(), "ffmpeg-file-encoder");
+#endif
 }
 
 
 FFmpegFileEncoder::~FFmpegFileEncoder ()
 {
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	try {
+		_thread.join ();
+	} catch (...) {}
+
 	_audio_streams.clear ();
 	avcodec_close (_video_codec_context);
 	avio_close (_format_context->pb);
@@ -295,6 +337,10 @@ FFmpegFileEncoder::pixel_format (ExportFormat format)
 		return AV_PIX_FMT_YUV422P10;
 	case ExportFormat::H264_AAC:
 		return AV_PIX_FMT_YUV420P;
+	case ExportFormat::H264_HARDWARE_AAC:
+	case ExportFormat::HEVC_HARDWARE_AAC:
+		/* This is what hardware encoders take most readily, so they can upload it as it is */
+		return AV_PIX_FMT_NV12;
 	default:
 		DCPOMATIC_ASSERT (false);
 	}
@@ -303,29 +349,108 @@ FFmpegFileEncoder::pixel_format (ExportFormat format)
 }
 
 
+/** Set up @p context, and the @p options that it will be opened with, for the video
+ *  encoder called @p name.
+ */
 void
-FFmpegFileEncoder::setup_video ()
+FFmpegFileEncoder::configure_video_codec (string const& name, AVCodecContext* context, AVDictionary** options) const
 {
-	_video_codec = avcodec_find_encoder_by_name (_video_codec_name.c_str());
-	if (!_video_codec) {
-		throw EncodeError (String::compose("avcodec_find_encoder_by_name failed for %1", _video_codec_name));
+	auto ends_with = [&name](string const& suffix) {
+		return boost::algorithm::ends_with(name, suffix);
+	};
+
+	context->width = _video_frame_size.width;
+	context->height = _video_frame_size.height;
+	context->time_base = (AVRational) { 1, _video_frame_rate };
+	context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	/* Let the codec use as many threads as it likes, working on several frames or
+	   several slices of each frame at once, whichever it can do.
+	*/
+	context->thread_count = 0;
+	context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	/* Hardware encoders don't understand x264's CRF, so we ask them for something
+	   like it in their own way.
+	*/
+	if (ends_with("_nvenc")) {
+		av_dict_set (options, "rc", "vbr", 0);
+		av_dict_set_int (options, "cq", _x264_crf, 0);
+	} else if (ends_with("_qsv")) {
+		context->flags |= AV_CODEC_FLAG_QSCALE;
+		context->global_quality = _x264_crf * FF_QP2LAMBDA;
+	} else if (ends_with("_amf")) {
+		av_dict_set (options, "rc", "cqp", 0);
+		av_dict_set_int (options, "qp_i", _x264_crf, 0);
+		av_dict_set_int (options, "qp_p", _x264_crf, 0);
+	} else if (ends_with("_videotoolbox")) {
+		/* Not all VideoToolbox encoders offer constant quality, so use a bit rate which
+		   gives about the same results as a CRF of 23 from x264, scaled by the CRF.
+		*/
+		context->bit_rate = _video_frame_size.width * _video_frame_size.height * _video_frame_rate * 0.1 * pow(2, (23 - _x264_crf) / 6.0);
+	} else {
+		/* Variable quantisation */
+		context->flags |= AV_CODEC_FLAG_QSCALE;
+		context->global_quality = 0;
 	}
+}
 
-	_video_codec_context = avcodec_alloc_context3 (_video_codec);
-	if (!_video_codec_context) {
-		throw std::bad_alloc ();
-	}
 
-	/* Variable quantisation */
-	_video_codec_context->global_quality = 0;
-	_video_codec_context->width = _video_frame_size.width;
-	_video_codec_context->height = _video_frame_size.height;
-	_video_codec_context->time_base = (AVRational) { 1, _video_frame_rate };
-	_video_codec_context->pix_fmt = _pixel_format;
-	_video_codec_context->flags |= AV_CODEC_FLAG_QSCALE | AV_CODEC_FLAG_GLOBAL_HEADER;
+void
+FFmpegFileEncoder::setup_video ()
+{
+	/* Try each of our video codecs in turn until one opens; hardware encoders will be missing
+	   from some FFmpeg builds, and will fail to open if there is no hardware for them to use.
+	*/
+	for (auto const& name: _video_codec_names) {
+		auto codec = avcodec_find_encoder_by_name (name.c_str());
+		if (!codec) {
+			if (name == _video_codec_names.back()) {
+				throw EncodeError (String::compose("avcodec_find_encoder_by_name failed for %1", name));
+			}
+			continue;
+		}
+
+		auto context = avcodec_alloc_context3 (codec);
+		if (!context) {
+			throw std::bad_alloc ();
+		}
+
+		AVDictionary* options = nullptr;
+		av_dict_copy (&options, _video_options, 0);
+		configure_video_codec (name, context, &options);
+
+		/* Use our preferred pixel format if this codec can take it, since that is what the
+		   butler will have prepared, or otherwise the nearest thing that it can take.
+		*/
+		auto pixel_format = _pixel_format;
+		if (codec->pix_fmts) {
+			bool supported = false;
+			for (auto i = codec->pix_fmts; *i != AV_PIX_FMT_NONE; ++i) {
+				if (*i == _pixel_format) {
+					supported = true;
+				}
+			}
+			if (!supported) {
+				pixel_format = avcodec_find_best_pix_fmt_of_list (codec->pix_fmts, _pixel_format, 0, nullptr);
+			}
+		}
+		context->pix_fmt = pixel_format;
+
+		int const r = avcodec_open2 (context, codec, &options);
+		av_dict_free (&options);
+		if (r >= 0) {
+			LOG_GENERAL ("Exporting video using %1", name);
+			_video_codec = codec;
+			_video_codec_context = context;
+			_pixel_format = pixel_format;
+			break;
+		}
 
-	if (avcodec_open2 (_video_codec_context, _video_codec, &_video_options) < 0) {
-		throw EncodeError(N_("avcodec_open2"), N_("FFmpegFileEncoder::setup_video"));
+		avcodec_free_context (&context);
+		if (name == _video_codec_names.back()) {
+			throw EncodeError(N_("avcodec_open2"), N_("FFmpegFileEncoder::setup_video"), r);
+		}
+		LOG_GENERAL ("Could not open video encoder %1 (%2); trying the next one", name, r);
 	}
 
 	_video_stream = avformat_new_stream (_format_context, _video_codec);
@@ -357,9 +482,81 @@ FFmpegFileEncoder::setup_audio ()
 }
 
 
+/** Give some work to our thread, waiting if it already has plenty to do */
+void
+FFmpegFileEncoder::add (std::function<void ()> work)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	while (!_error && static_cast<int>(_queue.size()) >= _queue_length) {
+		_condition.wait (lm);
+	}
+
+	if (_error) {
+		std::rethrow_exception (_error);
+	}
+
+	_queue.push_back (work);
+	_condition.notify_all ();
+}
+
+
+void
+FFmpegFileEncoder::thread ()
+{
+	start_of_thread ("FFmpegFileEncoder");
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_stop && _queue.empty()) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		auto work = _queue.front ();
+		_queue.pop_front ();
+		_busy = true;
+		_condition.notify_all ();
+		lm.unlock ();
+
+		std::exception_ptr error;
+		try {
+			work ();
+		} catch (...) {
+			error = std::current_exception ();
+		}
+
+		lm.lock ();
+		_busy = false;
+		if (error) {
+			/* Nothing more that we are given can be written properly, so stop here */
+			_error = error;
+			_queue.clear ();
+			_condition.notify_all ();
+			return;
+		}
+		_condition.notify_all ();
+	}
+}
+
+
 void
 FFmpegFileEncoder::flush ()
 {
+	{
+		/* Wait for our thread to write everything that it has been given */
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_error && (_busy || !_queue.empty())) {
+			_condition.wait (lm);
+		}
+
+		if (_error) {
+			std::rethrow_exception (_error);
+		}
+	}
+
 	if (_pending_audio->frames() > 0) {
 		audio_frame (_pending_audio->frames ());
 	}
@@ -399,6 +596,13 @@ FFmpegFileEncoder::flush ()
 
 void
 FFmpegFileEncoder::video (shared_ptr<PlayerVideo> video, DCPTime time)
+{
+	add (boost::bind(&FFmpegFileEncoder::do_video, this, video, time));
+}
+
+
+void
+FFmpegFileEncoder::do_video (shared_ptr<PlayerVideo> video, DCPTime time)
 {
 	/* All our output formats are video range at the moment */
 	auto image = video->image (
@@ -407,10 +611,15 @@ FFmpegFileEncoder::video (shared_ptr<PlayerVideo> video, DCPTime time)
 		false
 		);
 
+	if (image->size() != _video_frame_size) {
+		/* We have been asked for a different size to the one that the player makes */
+		image = image->scale (_video_frame_size, dcp::YUVToRGB::REC709, _pixel_format, Image::Alignment::PADDED, false);
+	}
+
 	auto frame = av_frame_alloc ();
 	DCPOMATIC_ASSERT (frame);
 
-	for (int i = 0; i < 3; ++i) {
+	for (int i = 0; i < image->planes(); ++i) {
 		auto buffer = _pending_images.create_buffer(image, i);
 		frame->buf[i] = av_buffer_ref (buffer);
 		frame->data[i] = buffer->data;
@@ -441,9 +650,18 @@ FFmpegFileEncoder::video (shared_ptr<PlayerVideo> video, DCPTime time)
 }
 
 
-/** Called when the player gives us some audio */
+/** Called when the player gives us some audio.  The caller may re-use @p audio
+ *  once we return, so we take a copy for our thread.
+ */
 void
 FFmpegFileEncoder::audio (shared_ptr<AudioBuffers> audio)
+{
+	add (boost::bind(&FFmpegFileEncoder::do_audio, this, make_shared<AudioBuffers>(*audio)));
+}
+
+
+void
+FFmpegFileEncoder::do_audio (shared_ptr<AudioBuffers> audio)
 {
 	_pending_audio->append (audio);
 
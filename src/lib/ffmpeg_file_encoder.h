@@ -31,6 +31,11 @@
 #include "log.h"
 #include <dcp/key.h>
 #include <dcp/warnings.h>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
+#include <exception>
+#include <functional>
 LIBDCP_DISABLE_WARNINGS
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -47,6 +52,10 @@ enum class ExportFormat
 	PRORES_4444,
 	PRORES_HQ,
 	H264_AAC,
+	/** H.264 from a hardware encoder if there is one, otherwise from x264 */
+	H264_HARDWARE_AAC,
+	/** HEVC from a hardware encoder if there is one, otherwise from x265 */
+	HEVC_HARDWARE_AAC,
 	SUBTITLES_DCP
 };
 
@@ -67,6 +76,9 @@ public:
 
 	~FFmpegFileEncoder ();
 
+	FFmpegFileEncoder (FFmpegFileEncoder const&) = delete;
+	FFmpegFileEncoder& operator= (FFmpegFileEncoder const&) = delete;
+
 	void video (std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime);
 	void audio (std::shared_ptr<AudioBuffers>);
 	void subtitle (PlayerText, dcpomatic::DCPTimePeriod);
@@ -77,9 +89,15 @@ public:
 
 private:
 	void setup_video ();
+	void configure_video_codec (std::string const& name, AVCodecContext* context, AVDictionary** options) const;
 	void setup_audio ();
 
 	void audio_frame (int size);
+	void thread ();
+	void add (std::function<void ()> work);
+
+	void do_video (std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime);
+	void do_audio (std::shared_ptr<AudioBuffers>);
 
 	AVCodec const * _video_codec = nullptr;
 	AVCodecContext* _video_codec_context = nullptr;
@@ -90,9 +108,11 @@ private:
 	AVPixelFormat _pixel_format;
 	AVSampleFormat _sample_format;
 	AVDictionary* _video_options = nullptr;
-	std::string _video_codec_name;
+	/** names of the video codecs that we can use, in order of preference */
+	std::vector<std::string> _video_codec_names;
 	std::string _audio_codec_name;
 	int _audio_channels;
+	int _x264_crf;
 
 	boost::filesystem::path _output;
 	dcp::Size _video_frame_size;
@@ -105,6 +125,23 @@ private:
 
 	ImageStore _pending_images;
 
+	/** Thread which converts, encodes and writes the video and audio that we are given,
+	 *  so that the caller can get on with fetching the next frame.
+	 */
+	boost::thread _thread;
+	/** mutex to protect the state below */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	/** video and audio waiting to be encoded, in the order that it was given to us */
+	std::deque<std::function<void ()>> _queue;
+	/** true if our thread is encoding something that it has taken off _queue */
+	bool _busy = false;
+	/** exception thrown by our thread, if there was one */
+	std::exception_ptr _error;
+	bool _stop = false;
+
+	static int const _queue_length;
+
 	static int _video_stream_index;
 	static int _audio_stream_index_base;
 };
@@ -19,10 +19,12 @@
 */
 
 
+#include "binary_descriptor.h"
 #include "compose.hpp"
 #include "cross.h"
 #include "dcpomatic_assert.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
 #include "exceptions.h"
 #include "ffmpeg_image_proxy.h"
 #include "image.h"
@@ -225,6 +227,12 @@ FFmpegImageProxy::add_metadata (xmlpp::Node* node) const
 	node->add_child("Type")->add_child_text (N_("FFmpeg"));
 }
 
+void
+FFmpegImageProxy::add_metadata (BinaryDescriptorWriter& writer) const
+{
+	writer.add (static_cast<int32_t>(ImageProxyType::FFMPEG));
+}
+
 void
 FFmpegImageProxy::write_to_socket (shared_ptr<Socket> socket) const
 {
@@ -232,14 +240,28 @@ FFmpegImageProxy::write_to_socket (shared_ptr<Socket> socket) const
 	socket->write (_data.data(), _data.size());
 }
 
+void
+FFmpegImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (_data.data(), _data.size());
+}
+
 bool
 FFmpegImageProxy::same (shared_ptr<const ImageProxy> other) const
 {
+	if (other.get() == this) {
+		return true;
+	}
+
 	auto mp = dynamic_pointer_cast<const FFmpegImageProxy>(other);
-	if (!mp) {
+	if (!mp || _data.size() != mp->_data.size()) {
 		return false;
 	}
 
+	if (auto same = same_fingerprint(*mp)) {
+		return *same;
+	}
+
 	return _data == mp->_data;
 }
 
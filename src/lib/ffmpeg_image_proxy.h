@@ -37,7 +37,9 @@ public:
 		) const override;
 
 	void add_metadata (xmlpp::Node *) const override;
+	void add_metadata (BinaryDescriptorWriter& writer) const override;
 	void write_to_socket (std::shared_ptr<Socket>) const override;
+	void add_digest (Digester& digester) const override;
 	bool same (std::shared_ptr<const ImageProxy> other) const override;
 	size_t memory_used () const override;
 
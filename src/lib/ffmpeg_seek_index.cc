@@ -0,0 +1,116 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "exceptions.h"
+#include "ffmpeg_seek_index.h"
+#include <dcp/file.h>
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+extern "C" {
+#include <libavformat/avformat.h>
+}
+LIBDCP_ENABLE_WARNINGS
+#include <algorithm>
+
+#include "i18n.h"
+
+
+using boost::optional;
+
+
+/** Version number written at the start of the file; change this if the format changes */
+static int32_t const seek_index_version = 1;
+
+
+FFmpegSeekIndex::FFmpegSeekIndex (boost::filesystem::path file)
+{
+	dcp::File f (file, "rb");
+	if (!f) {
+		throw OpenFileError (file, errno, OpenFileError::READ);
+	}
+
+	int32_t version = 0;
+	int64_t count = 0;
+	if (f.read(&version, sizeof(version), 1) != 1 || version != seek_index_version || f.read(&count, sizeof(count), 1) != 1 || count < 0) {
+		throw FileError (_("Unexpected seek index file header"), file);
+	}
+
+	_entries.resize (count);
+	if (count > 0 && f.read(_entries.data(), sizeof(Entry), count) != static_cast<size_t>(count)) {
+		throw FileError (_("Seek index file is too short"), file);
+	}
+}
+
+
+/** Add a keyframe; keyframes may be given in any order */
+void
+FFmpegSeekIndex::add (int64_t timestamp, int64_t position)
+{
+	/* Packets usually arrive in timestamp order, so this is normally just an append */
+	auto i = std::upper_bound (_entries.begin(), _entries.end(), timestamp, [](int64_t t, Entry const& e) { return t < e.timestamp; });
+	_entries.insert (i, { timestamp, position });
+}
+
+
+void
+FFmpegSeekIndex::write (boost::filesystem::path file) const
+{
+	boost::filesystem::create_directories (file.parent_path());
+
+	auto const tmp = file.string() + ".tmp";
+	{
+		dcp::File f (tmp, "wb");
+		if (!f) {
+			throw OpenFileError (tmp, errno, OpenFileError::WRITE);
+		}
+
+		int64_t const count = _entries.size();
+		f.checked_write (&seek_index_version, sizeof(seek_index_version));
+		f.checked_write (&count, sizeof(count));
+		if (count > 0) {
+			f.checked_write (_entries.data(), sizeof(Entry) * count);
+		}
+	}
+	boost::filesystem::rename (tmp, file);
+}
+
+
+/** Give our keyframes to FFmpeg so that it can use them when seeking in a stream */
+void
+FFmpegSeekIndex::apply (AVStream* stream) const
+{
+	for (auto const& i: _entries) {
+		av_add_index_entry (stream, i.position, i.timestamp, 0, 0, AVINDEX_KEYFRAME);
+	}
+}
+
+
+/** @return Timestamp of the last keyframe at or before a given timestamp, if there is one */
+optional<int64_t>
+FFmpegSeekIndex::keyframe_before (int64_t timestamp) const
+{
+	auto i = std::upper_bound (_entries.begin(), _entries.end(), timestamp, [](int64_t t, Entry const& e) { return t < e.timestamp; });
+	if (i == _entries.begin()) {
+		return {};
+	}
+
+	return std::prev(i)->timestamp;
+}
@@ -0,0 +1,72 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_FFMPEG_SEEK_INDEX_H
+#define DCPOMATIC_FFMPEG_SEEK_INDEX_H
+
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <vector>
+
+
+struct AVStream;
+
+
+/** @class FFmpegSeekIndex
+ *  @brief A list of the keyframes in a stream of some FFmpeg content, with their timestamps and
+ *  positions in the file.
+ *
+ *  The FFmpegExaminer makes one of these for formats whose own indexes are poor or missing,
+ *  and it is kept in the film's directory so that decoders can give it to FFmpeg to seek with.
+ */
+class FFmpegSeekIndex
+{
+public:
+	FFmpegSeekIndex () {}
+	/** Read an index which was written by write(); throws an exception on error */
+	explicit FFmpegSeekIndex (boost::filesystem::path file);
+
+	struct Entry
+	{
+		/** timestamp in the stream's time base */
+		int64_t timestamp;
+		/** position of the packet in the file */
+		int64_t position;
+	};
+
+	void add (int64_t timestamp, int64_t position);
+	void write (boost::filesystem::path file) const;
+	void apply (AVStream* stream) const;
+
+	boost::optional<int64_t> keyframe_before (int64_t timestamp) const;
+
+	std::vector<Entry> const& entries () const {
+		return _entries;
+	}
+
+private:
+	/** keyframes in increasing order of timestamp */
+	std::vector<Entry> _entries;
+};
+
+
+#endif
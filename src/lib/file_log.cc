@@ -22,6 +22,7 @@
 #include "file_log.h"
 #include "cross.h"
 #include "config.h"
+#include "util.h"
 #include <dcp/file.h>
 #include <cstdio>
 #include <iostream>
@@ -49,22 +50,94 @@ FileLog::FileLog (boost::filesystem::path file, int types)
 }
 
 
+FileLog::~FileLog ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_queue_mutex);
+		_stop = true;
+		_queue_condition.notify_all ();
+	}
+
+	try {
+		if (_thread.joinable()) {
+			_thread.join ();
+		}
+	} catch (...) {}
+}
+
+
 void
 FileLog::do_log (shared_ptr<const LogEntry> entry)
 {
-	dcp::File f(_file, "a");
-	if (!f) {
-		cout << "(could not log to " << _file.string() << " error " << errno << "): " << entry->get() << "\n";
-		return;
+	auto line = entry->get ();
+
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	_queue.push_back (line);
+	if (!_thread.joinable()) {
+		/* Start the thread when we first need it, so that logs that are only read from don't make one */
+		_thread = boost::thread (boost::bind(&FileLog::thread, this));
 	}
+	_queue_condition.notify_all ();
+}
+
 
-	fprintf(f.get(), "%s\n", entry->get().c_str());
+void
+FileLog::thread ()
+{
+	start_of_thread ("FileLog");
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_queue_mutex);
+		while (_queue.empty() && !_stop) {
+			_queue_condition.wait (lm);
+		}
+
+		if (_queue.empty()) {
+			/* We have been asked to stop and everything is written */
+			return;
+		}
+
+		/* Take everything that is waiting and write it with one open of the file */
+		std::deque<string> lines;
+		std::swap (lines, _queue);
+		_writing = true;
+		lm.unlock ();
+
+		dcp::File f(_file, "a");
+		for (auto const& i: lines) {
+			if (f) {
+				fprintf(f.get(), "%s\n", i.c_str());
+			} else {
+				cout << "(could not log to " << _file.string() << " error " << errno << "): " << i << "\n";
+			}
+		}
+		f.close ();
+
+		lm.lock ();
+		_writing = false;
+		_queue_condition.notify_all ();
+	}
+}
+
+
+/** Wait until everything that has been logged so far is in the file */
+void
+FileLog::flush () const
+{
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	while (!_queue.empty() || _writing) {
+		_queue_condition.wait (lm);
+	}
 }
 
 
 string
 FileLog::head_and_tail (int amount) const
 {
+	flush ();
+
 	boost::mutex::scoped_lock lm (_mutex);
 
 	uintmax_t head_amount = amount;
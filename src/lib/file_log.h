@@ -20,19 +20,42 @@
 
 
 #include "log.h"
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
 
 
+/** @class FileLog
+ *  @brief A log which writes to a file.
+ *
+ *  Entries are written by a background thread, so that logging from busy threads
+ *  does not have to wait for the disk.
+ */
 class FileLog : public Log
 {
 public:
 	explicit FileLog (boost::filesystem::path file);
 	FileLog (boost::filesystem::path file, int types);
+	~FileLog ();
 
 	std::string head_and_tail (int amount = 1024) const override;
 
+	void flush () const;
+
 private:
 	void do_log (std::shared_ptr<const LogEntry> entry) override;
+	void thread ();
 
 	/** filename to write to */
 	boost::filesystem::path _file;
+
+	boost::thread _thread;
+	/** mutex to protect _queue, _writing and _stop */
+	mutable boost::mutex _queue_mutex;
+	mutable boost::condition _queue_condition;
+	/** lines waiting to be written */
+	std::deque<std::string> _queue;
+	/** true if our thread is writing some lines that it has taken from _queue */
+	bool _writing = false;
+	bool _stop = false;
 };
@@ -49,10 +49,13 @@
 #include "job.h"
 #include "job_manager.h"
 #include "kdm_with_metadata.h"
+#include "metadata_writer.h"
 #include "null_log.h"
 #include "playlist.h"
 #include "ratio.h"
+#include "refine_ffmpeg_examination_job.h"
 #include "screen.h"
+#include "signal_manager.h"
 #include "text_content.h"
 #include "transcode_job.h"
 #include "upload_job.h"
@@ -178,6 +181,7 @@ Film::Film (optional<boost::filesystem::path> dir)
 	, _status (dcp::Status::FINAL)
 	, _state_version (current_state_version)
 	, _dirty (false)
+	, _change_count (0)
 	, _tolerant (false)
 {
 	set_isdcf_date_today ();
@@ -277,6 +281,10 @@ Film::video_identifier () const
 		s += "_R";
 	}
 
+	if (_two_pass_encoding) {
+		s += "_2P";
+	}
+
 	return s;
 }
 
@@ -315,6 +323,11 @@ Film::audio_analysis_path (shared_ptr<const Playlist> playlist) const
 
 		digester.add (i->digest());
 		digester.add (i->audio->mapping().digest());
+		/* Trim changes what is analysed, even for one piece of content.  Single-content
+		 * analyses are also used by AnalyseAudioJob to build analyses of whole playlists.
+		 */
+		digester.add (i->trim_start().get());
+		digester.add (i->trim_end().get());
 		if (playlist->content().size() != 1) {
 			/* Analyses should be considered equal regardless of gain
 			   if they were made from just one piece of content.  This
@@ -328,8 +341,6 @@ Film::audio_analysis_path (shared_ptr<const Playlist> playlist) const
 			 * whole-project view.
 			 */
 			digester.add (i->position().get());
-			digester.add (i->trim_start().get());
-			digester.add (i->trim_end().get());
 		}
 	}
 
@@ -376,6 +387,100 @@ Film::subtitle_analysis_path (shared_ptr<const Content> content) const
 }
 
 
+/** @return Path of the file to keep a CropAnalysis of some content in.  The analysis is made from
+ *  the uncropped image so it depends only on the content itself.
+ */
+boost::filesystem::path
+Film::crop_analysis_path (shared_ptr<const Content> content) const
+{
+	auto p = dir ("analysis");
+
+	Digester digester;
+	digester.add (content->digest());
+	digester.add (string("crop"));
+
+	p /= digester.get ();
+	return p;
+}
+
+
+/** @return Path of the directory to keep a ThumbnailStrip of some content in */
+boost::filesystem::path
+Film::thumbnails_path (shared_ptr<const Content> content) const
+{
+	auto p = dir ("thumbnails");
+
+	Digester digester;
+	digester.add (content->digest());
+
+	p /= digester.get ();
+	return p;
+}
+
+
+/** @return Path of the file to keep TextHints for this film's current texts in */
+boost::filesystem::path
+Film::text_hints_path () const
+{
+	auto p = dir ("analysis");
+
+	Digester digester;
+	digester.add (interop());
+	digester.add (video_frame_rate());
+	digester.add (static_cast<int>(reel_type()));
+	digester.add (reel_length());
+	digester.add (length().get());
+
+	for (auto content: _playlist->content()) {
+		/* Use the base Content identifier, as the derived ones include text colours, which would
+		 * mean re-examining all the texts after a change to a colour.
+		 */
+		auto identifier = content->Content::identifier();
+		if (auto ffmpeg = dynamic_pointer_cast<FFmpegContent>(content)) {
+			if (ffmpeg->subtitle_stream()) {
+				identifier += "_" + ffmpeg->subtitle_stream()->identifier();
+			}
+		}
+		if (auto dcp = dynamic_pointer_cast<DCPContent>(content)) {
+			for (auto type: { TextType::OPEN_SUBTITLE, TextType::CLOSED_CAPTION }) {
+				identifier += dcp->reference_text(type) ? "_1" : "_0";
+			}
+		}
+
+		for (auto text: content->text) {
+			digester.add (identifier);
+			digester.add (text->hints_identifier());
+			digester.add (static_cast<int>(text->type()));
+			digester.add (text->use());
+			digester.add (text->burn());
+			if (text->dcp_track()) {
+				digester.add (text->dcp_track()->summary());
+			}
+			for (auto font: text->fonts()) {
+				digester.add (font->id());
+			}
+		}
+	}
+
+	p /= "text_hints_" + digester.get ();
+	return p;
+}
+
+
+/** @return Path of the file to keep an FFmpegSeekIndex for some content in */
+boost::filesystem::path
+Film::seek_index_path (shared_ptr<const Content> content) const
+{
+	auto p = dir ("seek_index", false);
+
+	Digester digester;
+	digester.add (content->digest());
+
+	p /= digester.get ();
+	return p;
+}
+
+
 /** Start a job to send our DCP to the configured TMS */
 void
 Film::send_dcp_to_tms ()
@@ -422,6 +527,7 @@ Film::metadata (bool with_content_paths) const
 	root->add_child("ReelType")->add_child_text (raw_convert<string> (static_cast<int> (_reel_type)));
 	root->add_child("ReelLength")->add_child_text (raw_convert<string> (_reel_length));
 	root->add_child("ReencodeJ2K")->add_child_text (_reencode_j2k ? "1" : "0");
+	root->add_child("TwoPassEncoding")->add_child_text(_two_pass_encoding ? "1" : "0");
 	root->add_child("UserExplicitVideoFrameRate")->add_child_text(_user_explicit_video_frame_rate ? "1" : "0");
 	for (map<dcp::Marker, DCPTime>::const_iterator i = _markers.begin(); i != _markers.end(); ++i) {
 		auto m = root->add_child("Marker");
@@ -476,7 +582,7 @@ Film::metadata (bool with_content_paths) const
 void
 Film::write_metadata (boost::filesystem::path path) const
 {
-	metadata()->write_to_file_formatted(path.string());
+	MetadataWriter::write_now(metadata(), path);
 }
 
 /** Write state to our `metadata' file */
@@ -485,7 +591,22 @@ Film::write_metadata ()
 {
 	DCPOMATIC_ASSERT (directory());
 	boost::filesystem::create_directories (directory().get());
-	metadata()->write_to_file_formatted(file(metadata_file).string());
+	auto const path = file(metadata_file);
+	/* Make sure that an older state waiting to be written in the background does not overwrite this one */
+	MetadataWriter::instance()->cancel(path);
+	MetadataWriter::write_now(metadata(), path);
+	set_dirty (false);
+}
+
+/** Take a copy of our state now and write it to our `metadata' file soon, from another thread.
+ *  Calls made in quick succession result in a single write of the latest state.
+ */
+void
+Film::write_metadata_soon ()
+{
+	DCPOMATIC_ASSERT (directory());
+	boost::filesystem::create_directories (directory().get());
+	MetadataWriter::instance()->write(metadata(), file(metadata_file));
 	set_dirty (false);
 }
 
@@ -602,6 +723,7 @@ Film::read_metadata (optional<boost::filesystem::path> path)
 	_reel_type = static_cast<ReelType> (f.optional_number_child<int>("ReelType").get_value_or (static_cast<int>(ReelType::SINGLE)));
 	_reel_length = f.optional_number_child<int64_t>("ReelLength").get_value_or (2000000000);
 	_reencode_j2k = f.optional_bool_child("ReencodeJ2K").get_value_or(false);
+	_two_pass_encoding = f.optional_bool_child("TwoPassEncoding").get_value_or(false);
 	_user_explicit_video_frame_rate = f.optional_bool_child("UserExplicitVideoFrameRate").get_value_or(false);
 
 	for (auto i: f.node_children("Marker")) {
@@ -1198,6 +1320,13 @@ Film::set_reencode_j2k (bool r)
 	_reencode_j2k = r;
 }
 
+void
+Film::set_two_pass_encoding (bool t)
+{
+	FilmChangeSignaller ch (this, Property::TWO_PASS_ENCODING);
+	_two_pass_encoding = t;
+}
+
 void
 Film::signal_change (ChangeType type, int p)
 {
@@ -1236,33 +1365,6 @@ Film::set_isdcf_date_today ()
 }
 
 
-boost::filesystem::path
-Film::j2c_path (int reel, Frame frame, Eyes eyes, bool tmp) const
-{
-	boost::filesystem::path p;
-	p /= "j2c";
-	p /= video_identifier ();
-
-	char buffer[256];
-	snprintf(buffer, sizeof(buffer), "%08d_%08" PRId64, reel, frame);
-	string s (buffer);
-
-	if (eyes == Eyes::LEFT) {
-		s += ".L";
-	} else if (eyes == Eyes::RIGHT) {
-		s += ".R";
-	}
-
-	s += ".j2c";
-
-	if (tmp) {
-		s += ".tmp";
-	}
-
-	p /= s;
-	return file (p);
-}
-
 static
 bool
 cpl_summary_compare (CPLSummary const & a, CPLSummary const & b)
@@ -1321,68 +1423,138 @@ Film::content () const
 void
 Film::examine_and_add_content (shared_ptr<Content> content, bool disable_audio_analysis)
 {
-	if (dynamic_pointer_cast<FFmpegContent> (content) && _directory) {
-		run_ffprobe (content->path(0), file("ffprobe.log"));
-	}
-
 	auto j = make_shared<ExamineContentJob>(shared_from_this(), content);
 
-	_job_connections.push_back (
-		j->Finished.connect (bind (&Film::maybe_add_content, this, weak_ptr<Job>(j), weak_ptr<Content>(content), disable_audio_analysis))
-		);
+	_pending_content.push_back ({ j, content, disable_audio_analysis });
+	_job_connections.push_back (j->Finished.connect(bind(&Film::examine_finished, this)));
 
 	JobManager::instance()->add (j);
 }
 
+
+/** Called when any of our examine jobs finishes.  When many pieces of content are added at once
+ *  their examinations tend to finish close together, so rather than adding each one to the playlist
+ *  (and making everything that watches the film update) as it finishes, we wait until the UI is
+ *  next idle and then add everything that is ready in one go.
+ */
 void
-Film::maybe_add_content (weak_ptr<Job> j, weak_ptr<Content> c, bool disable_audio_analysis)
+Film::examine_finished ()
 {
-	auto job = j.lock ();
-	if (!job || !job->finished_ok ()) {
+	if (!signal_manager) {
+		add_examined_content ();
 		return;
 	}
 
-	auto content = c.lock ();
-	if (!content) {
+	if (_add_examined_content_pending) {
 		return;
 	}
 
-	add_content (content);
+	_add_examined_content_pending = true;
+	weak_ptr<Film> weak = shared_from_this();
+	signal_manager->when_idle ([weak]() {
+		auto film = weak.lock ();
+		if (film) {
+			film->add_examined_content ();
+		}
+	});
+}
+
+
+/** Examinations can run in parallel and finish in any order, so here we add content from finished jobs
+ *  at the front of _pending_content until we reach one that is still going.  This means that content
+ *  ends up in the playlist in the order that it was given to us.
+ */
+void
+Film::add_examined_content ()
+{
+	_add_examined_content_pending = false;
 
-	if (Config::instance()->automatic_audio_analysis() && content->audio && !disable_audio_analysis) {
-		auto playlist = make_shared<Playlist>();
-		playlist->add (shared_from_this(), content);
-		boost::signals2::connection c;
-		JobManager::instance()->analyse_audio (
-			shared_from_this(), playlist, false, c, bind (&Film::audio_analysis_finished, this)
-			);
-		_audio_analysis_connections.push_back (c);
+	ContentList batch;
+	vector<bool> disable_audio_analysis;
+
+	while (!_pending_content.empty()) {
+		auto const& pending = _pending_content.front();
+		auto job = pending.job.lock();
+		if (job && !job->finished()) {
+			break;
+		}
+		auto content = pending.content.lock();
+		if (job && job->finished_ok() && content) {
+			batch.push_back (content);
+			disable_audio_analysis.push_back (pending.disable_audio_analysis);
+		}
+		_pending_content.pop_front();
+	}
+
+	if (batch.empty()) {
+		return;
+	}
+
+	add_content (batch);
+
+	for (size_t i = 0; i < batch.size(); ++i) {
+		auto content = batch[i];
+		auto ffmpeg = dynamic_pointer_cast<FFmpegContent>(content);
+		if (ffmpeg && !ffmpeg->examined_exactly()) {
+			/* Find out what the quick examination missed, now that the content can be used */
+			JobManager::instance()->add(make_shared<RefineFFmpegExaminationJob>(shared_from_this(), ffmpeg));
+		}
+		if (Config::instance()->automatic_audio_analysis() && content->audio && !disable_audio_analysis[i]) {
+			auto playlist = make_shared<Playlist>();
+			playlist->add (shared_from_this(), content);
+			boost::signals2::connection c;
+			JobManager::instance()->analyse_audio (
+				shared_from_this(), playlist, false, c, bind (&Film::audio_analysis_finished, this)
+				);
+			_audio_analysis_connections.push_back (c);
+		}
 	}
 }
 
+
 void
 Film::add_content (shared_ptr<Content> c)
 {
-	/* Add {video,subtitle} content after any existing {video,subtitle} content */
-	if (c->video) {
-		c->set_position (shared_from_this(), _playlist->video_end(shared_from_this()));
-	} else if (!c->text.empty()) {
-		c->set_position (shared_from_this(), _playlist->text_end(shared_from_this()));
-	}
+	add_content (ContentList{c});
+}
+
 
-	if (_template_film) {
-		/* Take settings from the first piece of content of c's type in _template */
-		for (auto i: _template_film->content()) {
-			c->take_settings_from (i);
+/** Add some content to the playlist, with one change to the playlist for the whole lot */
+void
+Film::add_content (ContentList const& content)
+{
+	auto const film = shared_from_this();
+
+	auto video_end = _playlist->video_end(film);
+	auto text_end = _playlist->text_end(film);
+
+	for (auto c: content) {
+		/* Add {video,subtitle} content after any existing {video,subtitle} content */
+		if (c->video) {
+			c->set_position (film, video_end);
+			video_end = max(video_end, c->end(film));
+		} else if (!c->text.empty()) {
+			c->set_position (film, text_end);
+			text_end = max(text_end, c->end(film));
+		}
+
+		if (_template_film) {
+			/* Take settings from the first piece of content of c's type in _template */
+			for (auto i: _template_film->content()) {
+				c->take_settings_from (i);
+			}
 		}
 	}
 
-	_playlist->add (shared_from_this(), c);
+	_playlist->add (film, content);
 
 	maybe_set_container_and_resolution ();
-	if (c->atmos) {
-		set_audio_channels (14);
-		set_interop (false);
+	for (auto c: content) {
+		if (c->atmos) {
+			set_audio_channels (14);
+			set_interop (false);
+			break;
+		}
 	}
 }
 
@@ -1646,28 +1818,64 @@ Film::make_kdm (
 	optional<int> disable_forensic_marking_audio
 	) const
 {
-	if (!_encrypted) {
-		throw runtime_error (_("Cannot make a KDM as this project is not encrypted."));
-	}
+	return make_kdm (
+		kdm_keys(cpl_file), recipient, trusted_devices, from, until, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio
+		);
+}
 
-	auto cpl = make_shared<dcp::CPL>(cpl_file);
+
+/** Make a KDM using keys that have already been found with kdm_keys(), so that making
+ *  many KDMs for the same CPL does not mean reading the CPL and any imported KDMs each time.
+ *  This may be called from several threads at once.
+ */
+dcp::EncryptedKDM
+Film::make_kdm (
+	KDMKeys const& keys,
+	dcp::Certificate recipient,
+	vector<string> trusted_devices,
+	dcp::LocalTime from,
+	dcp::LocalTime until,
+	dcp::Formulation formulation,
+	bool disable_forensic_marking_picture,
+	optional<int> disable_forensic_marking_audio
+	) const
+{
 	auto signer = Config::instance()->signer_chain();
 	if (!signer->valid ()) {
 		throw InvalidSignerError ();
 	}
 
+	return dcp::DecryptedKDM (
+		keys.cpl_id, keys.keys, from, until, keys.content_title_text, keys.content_title_text, dcp::LocalTime().as_string()
+		).encrypt (signer, recipient, trusted_devices, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio);
+}
+
+
+/** @return The keys that a KDM for a given CPL of this film needs to carry */
+Film::KDMKeys
+Film::kdm_keys (boost::filesystem::path cpl_file) const
+{
+	if (!_encrypted) {
+		throw runtime_error (_("Cannot make a KDM as this project is not encrypted."));
+	}
+
+	auto cpl = make_shared<dcp::CPL>(cpl_file);
+
 	/* Find keys that have been added to imported, encrypted DCP content */
 	list<dcp::DecryptedKDMKey> imported_keys;
 	for (auto i: content()) {
 		auto d = dynamic_pointer_cast<DCPContent> (i);
 		if (d && d->kdm()) {
-			dcp::DecryptedKDM kdm (d->kdm().get(), Config::instance()->decryption_chain()->key().get());
+			auto kdm = decrypt_kdm_with_helpful_error (d->kdm().get());
 			auto keys = kdm.keys ();
 			copy (keys.begin(), keys.end(), back_inserter (imported_keys));
 		}
 	}
 
-	map<shared_ptr<const dcp::ReelFileAsset>, dcp::Key> keys;
+	KDMKeys result;
+	result.cpl_id = cpl->id();
+	result.content_title_text = cpl->content_title_text();
+	auto& keys = result.keys;
 
 	for (auto i: cpl->reel_file_assets()) {
 		if (!i->encrypted()) {
@@ -1691,9 +1899,7 @@ Film::make_kdm (
 		}
 	}
 
-	return dcp::DecryptedKDM (
-		cpl->id(), keys, from, until, cpl->content_title_text(), cpl->content_title_text(), dcp::LocalTime().as_string()
-		).encrypt (signer, recipient, trusted_devices, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio);
+	return result;
 }
 
 
@@ -1716,7 +1922,9 @@ Film::required_disk_space () const
 bool
 Film::should_be_enough_disk_space (double& required, double& available, bool& can_hard_link) const
 {
-	/* Create a test file and see if we can hard-link it */
+	/* Create a test file and see if we can hard-link it (or, failing that, clone it, which
+	   is just as good for our purposes as it takes no extra space either).
+	*/
 	boost::filesystem::path test = internal_video_asset_dir() / "test";
 	boost::filesystem::path test2 = internal_video_asset_dir() / "test2";
 	can_hard_link = true;
@@ -1725,7 +1933,7 @@ Film::should_be_enough_disk_space (double& required, double& available, bool& ca
 		f.close();
 		boost::system::error_code ec;
 		boost::filesystem::create_hard_link (test, test2, ec);
-		if (ec) {
+		if (ec && !clone_file(test, test2)) {
 			can_hard_link = false;
 		}
 		boost::filesystem::remove (test);
@@ -2165,6 +2373,10 @@ Film::set_dirty (bool dirty)
 {
 	auto const changed = dirty != _dirty;
 	_dirty = dirty;
+	/* We are called after every change to the film or its content, and after
+	   read_metadata() has changed things without signalling.
+	*/
+	++_change_count;
 	if (changed) {
 		emit (boost::bind(boost::ref(DirtyChange), _dirty));
 	}
@@ -45,7 +45,9 @@
 #include <boost/signals2.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <inttypes.h>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -54,6 +56,10 @@ namespace xmlpp {
 	class Document;
 }
 
+namespace dcp {
+	class ReelFileAsset;
+}
+
 namespace dcpomatic {
 	class Screen;
 }
@@ -106,12 +112,16 @@ public:
 	Film& operator= (Film const&) = delete;
 
 	std::shared_ptr<InfoFileHandle> info_file_handle (dcpomatic::DCPTimePeriod period, bool read) const;
-	boost::filesystem::path j2c_path (int, Frame, Eyes, bool) const;
+	boost::filesystem::path info_file (dcpomatic::DCPTimePeriod p) const;
 	boost::filesystem::path internal_video_asset_dir () const;
 	boost::filesystem::path internal_video_asset_filename (dcpomatic::DCPTimePeriod p) const;
 
 	boost::filesystem::path audio_analysis_path (std::shared_ptr<const Playlist>) const;
 	boost::filesystem::path subtitle_analysis_path (std::shared_ptr<const Content>) const;
+	boost::filesystem::path crop_analysis_path (std::shared_ptr<const Content>) const;
+	boost::filesystem::path thumbnails_path (std::shared_ptr<const Content>) const;
+	boost::filesystem::path text_hints_path () const;
+	boost::filesystem::path seek_index_path (std::shared_ptr<const Content>) const;
 
 	void send_dcp_to_tms ();
 
@@ -129,6 +139,7 @@ public:
 	std::list<std::string> read_metadata (boost::optional<boost::filesystem::path> path = boost::optional<boost::filesystem::path> ());
 	void write_metadata ();
 	void write_metadata (boost::filesystem::path path) const;
+	void write_metadata_soon ();
 	void write_template (boost::filesystem::path path) const;
 	std::shared_ptr<xmlpp::Document> metadata (bool with_content_paths = true) const;
 
@@ -142,6 +153,13 @@ public:
 		return _dirty;
 	}
 
+	/** @return a number which changes whenever anything about the film or its content may have changed,
+	 *  so that things worked out from the film can be kept until it does.
+	 */
+	uint64_t change_count () const {
+		return _change_count;
+	}
+
 	dcp::Size full_frame () const;
 	dcp::Size frame_size () const;
 	dcp::Size active_area () const;
@@ -163,6 +181,16 @@ public:
 	FrameRateChange active_frame_rate_change (dcpomatic::DCPTime) const;
 	std::pair<double, double> speed_up_range (int dcp_frame_rate) const;
 
+	/** The parts of a KDM for one of our CPLs which are the same whoever the KDM is for */
+	struct KDMKeys
+	{
+		std::string cpl_id;
+		std::string content_title_text;
+		std::map<std::shared_ptr<const dcp::ReelFileAsset>, dcp::Key> keys;
+	};
+
+	KDMKeys kdm_keys (boost::filesystem::path cpl_file) const;
+
 	dcp::EncryptedKDM make_kdm (
 		dcp::Certificate recipient,
 		std::vector<std::string> trusted_devices,
@@ -174,6 +202,17 @@ public:
 		boost::optional<int> disable_forensic_marking_audio
 		) const;
 
+	dcp::EncryptedKDM make_kdm (
+		KDMKeys const& keys,
+		dcp::Certificate recipient,
+		std::vector<std::string> trusted_devices,
+		dcp::LocalTime from,
+		dcp::LocalTime until,
+		dcp::Formulation formulation,
+		bool disable_forensic_marking_picture,
+		boost::optional<int> disable_forensic_marking_audio
+		) const;
+
 	int state_version () const {
 		return _state_version;
 	}
@@ -239,6 +278,7 @@ public:
 		REEL_TYPE,
 		REEL_LENGTH,
 		REENCODE_J2K,
+		TWO_PASS_ENCODING,
 		MARKERS,
 		RATINGS,
 		CONTENT_VERSIONS,
@@ -339,6 +379,13 @@ public:
 		return _reencode_j2k;
 	}
 
+	/** @return true to analyse the picture before encoding it, so that
+	 *  complex frames can be given more of the J2K bandwidth than simple ones.
+	 */
+	bool two_pass_encoding () const {
+		return _two_pass_encoding;
+	}
+
 	typedef std::map<dcp::Marker, dcpomatic::DCPTime> Markers;
 
 	boost::optional<dcpomatic::DCPTime> marker (dcp::Marker type) const;
@@ -425,6 +472,7 @@ public:
 	void set_use_isdcf_name (bool);
 	void examine_and_add_content (std::shared_ptr<Content> content, bool disable_audio_analysis = false);
 	void add_content (std::shared_ptr<Content>);
+	void add_content (ContentList const& content);
 	void remove_content (std::shared_ptr<Content>);
 	void remove_content (ContentList);
 	void move_content_earlier (std::shared_ptr<Content>);
@@ -444,6 +492,7 @@ public:
 	void set_reel_type (ReelType);
 	void set_reel_length (int64_t);
 	void set_reencode_j2k (bool);
+	void set_two_pass_encoding (bool);
 	void set_marker (dcp::Marker type, dcpomatic::DCPTime time);
 	void unset_marker (dcp::Marker type);
 	void clear_markers ();
@@ -494,8 +543,6 @@ private:
 	friend struct ::atmos_encrypted_passthrough_test;
 	template <class, class> friend class ChangeSignaller;
 
-	boost::filesystem::path info_file (dcpomatic::DCPTimePeriod p) const;
-
 	void signal_change (ChangeType, Property);
 	void signal_change (ChangeType, int);
 	std::string video_identifier () const;
@@ -503,7 +550,8 @@ private:
 	void playlist_order_changed ();
 	void playlist_content_change (ChangeType type, std::weak_ptr<Content>, int, bool frequent);
 	void playlist_length_change ();
-	void maybe_add_content (std::weak_ptr<Job>, std::weak_ptr<Content>, bool disable_audio_analysis);
+	void add_examined_content ();
+	void examine_finished ();
 	void audio_analysis_finished ();
 	void check_settings_consistency ();
 	void maybe_set_container_and_resolution ();
@@ -555,6 +603,7 @@ private:
 	/** Desired reel length in bytes, if _reel_type == REELTYPE_BY_LENGTH */
 	int64_t _reel_length;
 	bool _reencode_j2k;
+	bool _two_pass_encoding = false;
 	/** true if the user has ever explicitly set the video frame rate of this film */
 	bool _user_explicit_video_frame_rate;
 	bool _user_explicit_container;
@@ -583,6 +632,8 @@ private:
 
 	/** true if our state has changed since we last saved it */
 	mutable bool _dirty;
+	/** incremented every time set_dirty() is called */
+	std::atomic<uint64_t> _change_count;
 	/** film being used as a template, or 0 */
 	std::shared_ptr<Film> _template_film;
 
@@ -598,6 +649,20 @@ private:
 	boost::signals2::scoped_connection _playlist_content_change_connection;
 	boost::signals2::scoped_connection _playlist_length_change_connection;
 	std::list<boost::signals2::connection> _job_connections;
+
+	struct PendingContent
+	{
+		std::weak_ptr<Job> job;
+		std::weak_ptr<Content> content;
+		bool disable_audio_analysis;
+	};
+
+	/** Content that is being examined, in the order that it was given to examine_and_add_content().
+	 *  Examinations may finish in any order, but content is added to the playlist in this order.
+	 */
+	std::list<PendingContent> _pending_content;
+	/** true if we have asked to add examined content from _pending_content when the UI is next idle */
+	bool _add_examined_content_pending = false;
 	std::list<boost::signals2::connection> _audio_analysis_connections;
 
 	friend struct paths_test;
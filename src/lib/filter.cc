@@ -25,6 +25,7 @@
 
 
 #include "filter.h"
+#include <algorithm>
 #include <dcp/warnings.h>
 LIBDCP_DISABLE_WARNINGS
 extern "C" {
@@ -45,12 +46,14 @@ vector<Filter> Filter::_filters;
  *  @param n User-visible name.
  *  @param c User-visible category.
  *  @param f String for a FFmpeg filter descriptor.
+ *  @param temporal true if the filter's output for a frame can depend on other frames.
  */
-Filter::Filter (string i, string n, string c, string f)
+Filter::Filter (string i, string n, string c, string f, bool temporal)
 	: _id (i)
 	, _name (n)
 	, _category (c)
 	, _ffmpeg (f)
+	, _temporal (temporal)
 {
 
 }
@@ -76,26 +79,26 @@ Filter::setup_filters ()
 {
 	/* Note: "none" is a magic id name, so don't use it here */
 
-	maybe_add (N_("vflip"),       _("Vertical flip"),                    _("Orientation"),     N_("vflip"));
-	maybe_add (N_("hflip"),       _("Horizontal flip"),                  _("Orientation"),     N_("hflip"));
-	maybe_add (N_("90clock"),     _("Rotate 90 degrees clockwise"),      _("Orientation"),     N_("transpose=dir=clock"));
-	maybe_add (N_("90anticlock"), _("Rotate 90 degrees anti-clockwise"), _("Orientation"),     N_("transpose=dir=cclock"));
-	maybe_add (N_("mcdeint"),     _("Motion compensating deinterlacer"), _("De-interlacing"),  N_("mcdeint"));
-	maybe_add (N_("kerndeint"),   _("Kernel deinterlacer"),		     _("De-interlacing"),  N_("kerndeint"));
-	maybe_add (N_("yadif"),	      _("Yet Another Deinterlacing Filter"), _("De-interlacing"),  N_("yadif"));
-	maybe_add (N_("bwdif"),	      _("Bob Weaver Deinterlacing Filter"),  _("De-interlacing"),  N_("bwdif"));
-	maybe_add (N_("weave"),	      _("Weave filter"),                     _("De-interlacing"),  N_("weave"));
-	maybe_add (N_("gradfun"),     _("Gradient debander"),	             _("Misc"),	           N_("gradfun"));
-	maybe_add (N_("unsharp"),     _("Unsharp mask and Gaussian blur"),   _("Misc"),	           N_("unsharp"));
-	maybe_add (N_("denoise3d"),   _("3D denoiser"),		             _("Noise reduction"), N_("denoise3d"));
-	maybe_add (N_("hqdn3d"),      _("High quality 3D denoiser"),         _("Noise reduction"), N_("hqdn3d"));
-	maybe_add (N_("telecine"),    _("Telecine filter"),	             _("Misc"),	           N_("telecine"));
-	maybe_add (N_("ow"),	      _("Overcomplete wavelet denoiser"),    _("Noise reduction"), N_("mp=ow"));
+	maybe_add (N_("vflip"),       _("Vertical flip"),                    _("Orientation"),     N_("vflip"), false);
+	maybe_add (N_("hflip"),       _("Horizontal flip"),                  _("Orientation"),     N_("hflip"), false);
+	maybe_add (N_("90clock"),     _("Rotate 90 degrees clockwise"),      _("Orientation"),     N_("transpose=dir=clock"), false);
+	maybe_add (N_("90anticlock"), _("Rotate 90 degrees anti-clockwise"), _("Orientation"),     N_("transpose=dir=cclock"), false);
+	maybe_add (N_("mcdeint"),     _("Motion compensating deinterlacer"), _("De-interlacing"),  N_("mcdeint"), true);
+	maybe_add (N_("kerndeint"),   _("Kernel deinterlacer"),		     _("De-interlacing"),  N_("kerndeint"), true);
+	maybe_add (N_("yadif"),	      _("Yet Another Deinterlacing Filter"), _("De-interlacing"),  N_("yadif"), true);
+	maybe_add (N_("bwdif"),	      _("Bob Weaver Deinterlacing Filter"),  _("De-interlacing"),  N_("bwdif"), true);
+	maybe_add (N_("weave"),	      _("Weave filter"),                     _("De-interlacing"),  N_("weave"), true);
+	maybe_add (N_("gradfun"),     _("Gradient debander"),	             _("Misc"),	           N_("gradfun"), false);
+	maybe_add (N_("unsharp"),     _("Unsharp mask and Gaussian blur"),   _("Misc"),	           N_("unsharp"), false);
+	maybe_add (N_("denoise3d"),   _("3D denoiser"),		             _("Noise reduction"), N_("denoise3d"), true);
+	maybe_add (N_("hqdn3d"),      _("High quality 3D denoiser"),         _("Noise reduction"), N_("hqdn3d"), true);
+	maybe_add (N_("telecine"),    _("Telecine filter"),	             _("Misc"),	           N_("telecine"), true);
+	maybe_add (N_("ow"),	      _("Overcomplete wavelet denoiser"),    _("Noise reduction"), N_("mp=ow"), false);
 }
 
 
 void
-Filter::maybe_add (string i, string n, string c, string f)
+Filter::maybe_add (string i, string n, string c, string f, bool temporal)
 {
 	string check_name = f;
 	size_t end = check_name.find("=");
@@ -104,7 +107,7 @@ Filter::maybe_add (string i, string n, string c, string f)
 	}
 
 	if (avfilter_get_by_name(check_name.c_str())) {
-		_filters.push_back (Filter(i, n, c, f));
+		_filters.push_back (Filter(i, n, c, f, temporal));
 	}
 }
 
@@ -128,6 +131,14 @@ Filter::ffmpeg_string (vector<Filter const *> const & filters)
 }
 
 
+/** @return true if any of the given filters is temporal */
+bool
+Filter::any_temporal (vector<Filter const *> const & filters)
+{
+	return std::any_of(filters.begin(), filters.end(), [](Filter const* filter) { return filter->temporal(); });
+}
+
+
 /** @param d Our id.
  *  @return Corresponding Filter, or 0.
  */
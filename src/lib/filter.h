@@ -42,7 +42,7 @@
 class Filter
 {
 public:
-	Filter (std::string i, std::string n, std::string c, std::string f);
+	Filter (std::string i, std::string n, std::string c, std::string f, bool temporal = true);
 
 	/** @return our id */
 	std::string id () const {
@@ -63,10 +63,18 @@ public:
 		return _category;
 	}
 
+	/** @return true if this filter's output for a frame can depend on other frames, so that
+	 *  it must be reset after a seek.
+	 */
+	bool temporal () const {
+		return _temporal;
+	}
+
 	static std::vector<Filter const *> all ();
 	static Filter const * from_id (std::string d);
 	static void setup_filters ();
 	static std::string ffmpeg_string (std::vector<Filter const *> const & filters);
+	static bool any_temporal (std::vector<Filter const *> const & filters);
 
 private:
 
@@ -77,10 +85,11 @@ private:
 	std::string _category;
 	/** string for a FFmpeg filter descriptor */
 	std::string _ffmpeg;
+	bool _temporal;
 
 	/** all available filters */
 	static std::vector<Filter> _filters;
-	static void maybe_add (std::string, std::string, std::string, std::string);
+	static void maybe_add (std::string, std::string, std::string, std::string, bool);
 };
 
 
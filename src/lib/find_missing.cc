@@ -20,61 +20,268 @@
 
 
 #include "content.h"
+#include "dcpomatic_log.h"
+#include "digester.h"
 #include "find_missing.h"
+#include "state.h"
 #include "util.h"
+#include <dcp/raw_convert.h>
+#include <libcxml/cxml.h>
+#include <libxml++/libxml++.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <future>
 
 
 using std::map;
 using std::shared_ptr;
+using std::string;
 using std::vector;
+using boost::optional;
+using dcp::raw_convert;
 
 
-typedef map<shared_ptr<Content>, vector<boost::filesystem::path>> Replacements;
+namespace {
+
+struct IndexEntry
+{
+	boost::filesystem::path path;
+	boost::uintmax_t size;
+};
+
+}
+
+
+/** Files under a directory: file name to the files with that name, in the order that we found them */
+typedef map<boost::filesystem::path, vector<IndexEntry>> Index;
 
 
 static
 void
-search (Replacements& replacement_paths, boost::filesystem::path directory, int depth = 0)
+add_to_index (Index& index, boost::filesystem::directory_entry const& entry, int depth)
 {
 	boost::system::error_code ec;
-	for (auto candidate: boost::filesystem::directory_iterator(directory, ec)) {
-		if (boost::filesystem::is_regular_file(candidate.path())) {
-			for (auto& replacement: replacement_paths) {
-				for (auto& path: replacement.second) {
-					if (!boost::filesystem::exists(path) && path.filename() == candidate.path().filename()) {
-						path = candidate.path();
-					}
-				}
+	auto const status = entry.status(ec);
+	if (ec) {
+		return;
+	}
+
+	if (boost::filesystem::is_regular_file(status)) {
+		auto const size = boost::filesystem::file_size(entry.path(), ec);
+		index[entry.path().filename()].push_back({entry.path(), ec ? 0 : size});
+	} else if (boost::filesystem::is_directory(status) && depth <= 2) {
+		/* Just ignore errors when creating the directory_iterator; they can be triggered by things like
+		 * macOS' love of creating random directories (see #2291).
+		 */
+		for (auto const& i: boost::filesystem::directory_iterator(entry.path(), ec)) {
+			add_to_index (index, i, depth + 1);
+		}
+	}
+}
+
+
+/** Look for files in and below a directory, using a few threads to look below its sub-directories */
+static
+Index
+make_index (boost::filesystem::path root)
+{
+	vector<boost::filesystem::directory_entry> entries;
+	boost::system::error_code ec;
+	for (auto const& i: boost::filesystem::directory_iterator(root, ec)) {
+		entries.push_back (i);
+	}
+
+	vector<Index> found (entries.size());
+	std::atomic<size_t> next (0);
+	auto work = [&entries, &found, &next]() {
+		for (auto i = next++; i < entries.size(); i = next++) {
+			add_to_index (found[i], entries[i], 0);
+		}
+	};
+
+	vector<std::future<void>> workers;
+	auto const threads = std::min(entries.size(), static_cast<size_t>(std::max(1U, boost::thread::hardware_concurrency()) * 2));
+	for (size_t i = 1; i < threads; ++i) {
+		workers.push_back (std::async(std::launch::async, work));
+	}
+	work ();
+	for (auto& i: workers) {
+		i.get ();
+	}
+
+	/* Put things together in the order that a serial search would have found them */
+	Index index;
+	for (auto const& i: found) {
+		for (auto const& j: i) {
+			auto& all = index[j.first];
+			all.insert (all.end(), j.second.begin(), j.second.end());
+		}
+	}
+
+	return index;
+}
+
+
+static
+boost::filesystem::path
+index_file (boost::filesystem::path root)
+{
+	Digester digester;
+	digester.add (boost::filesystem::absolute(root).string());
+	return State::write_path("find_missing") / (digester.get() + ".xml");
+}
+
+
+static
+optional<Index>
+read_index (boost::filesystem::path root)
+try
+{
+	auto const file = index_file (root);
+	if (!boost::filesystem::exists(file)) {
+		return {};
+	}
+
+	cxml::Document doc ("FindMissingIndex");
+	doc.read_file (file);
+
+	Index index;
+	for (auto i: doc.node_children("File")) {
+		boost::filesystem::path const path = i->string_child("Path");
+		index[path.filename()].push_back({path, i->number_child<boost::uintmax_t>("Size")});
+	}
+	return index;
+}
+catch (std::exception& e)
+{
+	LOG_GENERAL ("Could not read find-missing index for %1 (%2)", root.string(), e.what());
+	return {};
+}
+
+
+static
+void
+write_index (boost::filesystem::path root, Index const& index)
+try
+{
+	auto const file = index_file (root);
+	boost::filesystem::create_directories (file.parent_path());
+
+	xmlpp::Document doc;
+	auto node = doc.create_root_node ("FindMissingIndex");
+	node->add_child("Root")->add_child_text(root.string());
+	for (auto const& i: index) {
+		for (auto const& j: i.second) {
+			auto file_node = node->add_child("File");
+			file_node->add_child("Path")->add_child_text(j.path.string());
+			file_node->add_child("Size")->add_child_text(raw_convert<string>(j.size));
+		}
+	}
+
+	auto const tmp = file.string() + ".tmp";
+	doc.write_to_file (tmp);
+	boost::filesystem::rename (tmp, file);
+}
+catch (std::exception& e)
+{
+	LOG_GENERAL ("Could not write find-missing index for %1 (%2)", root.string(), e.what());
+}
+
+
+/** @return the size of the first file of some content, taken from its digest (see simple_digest()) */
+static
+optional<boost::uintmax_t>
+first_file_size (string const& digest)
+{
+	auto const hex_size = MD5_DIGEST_SIZE * 2;
+	if (digest.length() <= hex_size || digest.find_first_not_of("0123456789", hex_size) != string::npos) {
+		return {};
+	}
+	return raw_convert<boost::uintmax_t>(digest.substr(hex_size));
+}
+
+
+/** Try to find the missing files of some content in an index, changing its paths if we do.
+ *  @return true if the content was fixed.
+ */
+static
+bool
+fix (shared_ptr<Content> content, Index const& index)
+{
+	auto paths = content->paths();
+	if (paths.empty()) {
+		return false;
+	}
+
+	auto const digest = content->digest();
+	auto const size = first_file_size (digest);
+
+	/* Candidates for each missing path, in the order that we found them */
+	vector<vector<boost::filesystem::path>> candidates (paths.size());
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (boost::filesystem::exists(paths[i])) {
+			candidates[i].push_back (paths[i]);
+			continue;
+		}
+		auto found = index.find (paths[i].filename());
+		if (found == index.end()) {
+			return false;
+		}
+		for (auto const& j: found->second) {
+			/* The first file's size is in the digest, so we can rule out other files of that name without reading them */
+			if ((i > 0 || !size || j.size == *size) && boost::filesystem::exists(j.path)) {
+				candidates[i].push_back (j.path);
 			}
-		} else if (boost::filesystem::is_directory(candidate.path()) && depth <= 2) {
-			search (replacement_paths, candidate, depth + 1);
+		}
+		if (candidates[i].empty()) {
+			return false;
 		}
 	}
 
-	/* Just ignore errors when creating the directory_iterator; they can be triggered by things like
-	 * macOS' love of creating random directories (see #2291).
-	 */
+	/* Try each candidate for the first file, with the first candidate for each of the others */
+	for (auto const& first: candidates[0]) {
+		paths[0] = first;
+		for (size_t i = 1; i < paths.size(); ++i) {
+			paths[i] = candidates[i].front();
+		}
+		if (simple_digest(paths) == digest) {
+			content->set_paths (paths);
+			return true;
+		}
+	}
+
+	return false;
 }
 
 
 void
 dcpomatic::find_missing (vector<shared_ptr<Content>> content_to_fix, boost::filesystem::path clue)
 {
-	using namespace boost::filesystem;
+	auto const root = boost::filesystem::is_directory(clue) ? clue : clue.parent_path();
+
+	/* Try an index that we made last time, if there is one; the files it lists may have gone
+	 * or moved since, so we look again for anything that it can't fix.
+	 */
+	vector<shared_ptr<Content>> unfixed;
+	if (auto index = read_index(root)) {
+		for (auto content: content_to_fix) {
+			if (!fix(content, *index)) {
+				unfixed.push_back (content);
+			}
+		}
+	} else {
+		unfixed = content_to_fix;
+	}
 
-	Replacements replacement_paths;
-	for (auto content: content_to_fix) {
-		replacement_paths[content] = content->paths();
+	if (unfixed.empty()) {
+		return;
 	}
 
-	search (replacement_paths, is_directory(clue) ? clue : clue.parent_path());
+	auto const index = make_index (root);
+	write_index (root, index);
 
-	for (auto content: content_to_fix) {
-		auto const& repl = replacement_paths[content];
-		bool const replacements_exist = std::find_if(repl.begin(), repl.end(), [](path p) { return !exists(p); }) == repl.end();
-		if (replacements_exist && simple_digest(replacement_paths[content]) == content->digest()) {
-			content->set_paths (repl);
-		}
+	for (auto content: unfixed) {
+		fix (content, index);
 	}
 }
@@ -33,6 +33,10 @@ namespace dcpomatic {
 /** Try to resolve some missing content file paths using a clue.  On return
  *  any content whose files were found will have been updated.
  *
+ *  The files under the clue's directory are indexed by name, and the index is kept (with the
+ *  other state) so that a later search under the same directory need not look through it again
+ *  unless the files have moved since.
+ *
  *  @param content Content, some of which may have missing files.
  *  @param clue Path to a file which gives a clue about where the missing files might be.
  */
@@ -22,9 +22,12 @@
 #include "dcpomatic_assert.h"
 #include "dcpomatic_log.h"
 #include "font_config.h"
+#include "util.h"
 #include <fontconfig/fontconfig.h>
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
+#include <boost/thread/once.hpp>
+#include <sys/time.h>
 
 
 using std::string;
@@ -32,57 +35,75 @@ using boost::optional;
 
 
 FontConfig* FontConfig::_instance;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+
+
+/** @return seconds since `start' */
+static
+double
+since(struct timeval start)
+{
+	struct timeval now;
+	gettimeofday(&now, nullptr);
+	return seconds(now) - seconds(start);
+}
 
 
 FontConfig::FontConfig()
 {
+	/* This scans the system fonts (or reads fontconfig's cache of them), which is the
+	 * only time that we do that.
+	 */
+	struct timeval start;
+	gettimeofday(&start, nullptr);
 	_config = FcInitLoadConfigAndFonts();
 	FcConfigSetCurrent(_config);
+	LOG_TIMING("fontconfig-init %1", since(start));
 }
 
 
 string
 FontConfig::make_font_available(boost::filesystem::path font_file)
 {
+	boost::mutex::scoped_lock lm(_mutex);
+
 	auto existing = _available_fonts.find(font_file);
 	if (existing != _available_fonts.end()) {
 		return existing->second;
 	}
 
-	/* Make this font available to DCP-o-matic */
+	struct timeval start;
+	gettimeofday(&start, nullptr);
+
+	/* Make this font available to DCP-o-matic.  This adds it to the application's set
+	 * of fonts without rebuilding the rest, so look for it in that set rather than
+	 * searching all the system's fonts too.
+	 */
 	optional<string> font_name;
-	FcConfigAppFontAddFile (_config, reinterpret_cast<FcChar8 const *>(font_file.string().c_str()));
-	auto pattern = FcPatternBuild (
-		0, FC_FILE, FcTypeString, font_file.string().c_str(), static_cast<char *>(0)
-		);
-	auto object_set = FcObjectSetBuild (FC_FAMILY, FC_STYLE, FC_LANG, FC_FILE, static_cast<char *> (0));
-	auto font_set = FcFontList (_config, pattern, object_set);
-	if (font_set) {
+	FcConfigAppFontAddFile(_config, reinterpret_cast<FcChar8 const *>(font_file.string().c_str()));
+	if (auto font_set = FcConfigGetFonts(_config, FcSetApplication)) {
 		for (int i = 0; i < font_set->nfont; ++i) {
 			FcPattern* font = font_set->fonts[i];
 			FcChar8* file;
 			FcChar8* family;
 			FcChar8* style;
 			if (
-				FcPatternGetString (font, FC_FILE, 0, &file) == FcResultMatch &&
-				FcPatternGetString (font, FC_FAMILY, 0, &family) == FcResultMatch &&
-				FcPatternGetString (font, FC_STYLE, 0, &style) == FcResultMatch
+				FcPatternGetString(font, FC_FILE, 0, &file) == FcResultMatch &&
+				font_file.string() == reinterpret_cast<char const *>(file) &&
+				FcPatternGetString(font, FC_FAMILY, 0, &family) == FcResultMatch &&
+				FcPatternGetString(font, FC_STYLE, 0, &style) == FcResultMatch
 				) {
-				font_name = reinterpret_cast<char const *> (family);
+				font_name = reinterpret_cast<char const *>(family);
 			}
 		}
-
-		FcFontSetDestroy (font_set);
 	}
 
-	FcObjectSetDestroy (object_set);
-	FcPatternDestroy (pattern);
-
 	DCPOMATIC_ASSERT(font_name);
 
 	_available_fonts[font_file] = *font_name;
 
-	FcConfigBuildFonts(_config);
+	++_generation;
+	LOG_TIMING("fontconfig-add-font %1 %2", font_file.string(), since(start));
 	return *font_name;
 }
 
@@ -90,6 +111,8 @@ FontConfig::make_font_available(boost::filesystem::path font_file)
 optional<boost::filesystem::path>
 FontConfig::system_font_with_name(string name)
 {
+	boost::mutex::scoped_lock lm(_mutex);
+
 	optional<boost::filesystem::path> path;
 
 	LOG_GENERAL("Searching system for font %1", name);
@@ -128,9 +151,9 @@ FontConfig::system_font_with_name(string name)
 FontConfig *
 FontConfig::instance()
 {
-	if (!_instance) {
+	boost::call_once(instance_once, []() {
 		_instance = new FontConfig();
-	}
+	});
 
 	return _instance;
 }
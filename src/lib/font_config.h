@@ -21,6 +21,7 @@
 
 #include <fontconfig/fontconfig.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
 #include <map>
 #include <string>
 
@@ -34,11 +35,22 @@ public:
 	std::string make_font_available(boost::filesystem::path font_file);
 	boost::optional<boost::filesystem::path> system_font_with_name(std::string name);
 
+	/** @return a number which changes whenever a font is made available, so that anything
+	 *  which caches what fontconfig knows can tell when it must look again.
+	 */
+	int generation() const {
+		boost::mutex::scoped_lock lm(_mutex);
+		return _generation;
+	}
+
 private:
 	FontConfig();
 
+	/** mutex to protect _config, _available_fonts and _generation */
+	mutable boost::mutex _mutex;
 	FcConfig* _config = nullptr;
 	std::map<boost::filesystem::path, std::string> _available_fonts;
+	int _generation = 0;
 
 	static FontConfig* _instance;
 };
@@ -0,0 +1,187 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_FRAME_PREFETCHER_H
+#define DCPOMATIC_FRAME_PREFETCHER_H
+
+
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/optional.hpp>
+#include <exception>
+#include <functional>
+#include <map>
+
+
+/** @class FramePrefetcher
+ *  @brief A thread which reads frames from an asset (such as a libdcp MXF reader) ahead of
+ *  a decoder, so that the decoder does not have to wait for slow storage.
+ *
+ *  Frames are read in order, up to a given number ahead of the last one that was asked for.
+ *  Asking for a frame that is not coming (because the decoder has seeked) starts reading
+ *  again from there.  The same frame can be asked for more than once, until a later one is.
+ *
+ *  The read function is only called by our thread, so it can use a reader which is not
+ *  thread-safe as long as nothing else uses the reader.
+ */
+template <class Frame>
+class FramePrefetcher
+{
+public:
+	/** @param read Function to read the frame with a given index.
+	 *  @param end Index of the frame after the last one that can be read.
+	 *  @param depth Number of frames to read ahead.
+	 */
+	FramePrefetcher (std::function<Frame (int64_t)> read, int64_t end, int depth)
+		: _read (read)
+		, _end (end)
+		, _depth (depth)
+	{
+		_thread = boost::thread ([this]() { run(); });
+#ifdef DCPOMATIC_LINUX
+		pthread_setname_np (_thread.native_handle(), "frame-prefetch");
+#endif
+	}
+
+	~FramePrefetcher ()
+	{
+		boost::this_thread::disable_interruption dis;
+
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			_stop = true;
+			_condition.notify_all ();
+		}
+
+		try {
+			_thread.join ();
+		} catch (...) {}
+	}
+
+	FramePrefetcher (FramePrefetcher const&) = delete;
+	FramePrefetcher& operator= (FramePrefetcher const&) = delete;
+
+	/** @return The frame with index @p index, having waited for it to be read if necessary;
+	 *  if reading it threw an exception, that exception is thrown here instead.
+	 */
+	Frame get (int64_t index)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		_frames.erase (_frames.begin(), _frames.lower_bound(index));
+
+		bool coming = _frames.find(index) != _frames.end() || _error_index == index;
+		if (!_error_index) {
+			coming = coming || (_reading == index && _reading_generation == _generation) || (index >= _next && index <= _next + _depth);
+		}
+		if (!coming) {
+			/* Start again from here, ignoring whatever is being read at the moment */
+			_frames.clear ();
+			_next = index;
+			_error = std::exception_ptr();
+			_error_index = boost::none;
+			++_generation;
+		}
+
+		_wanted = index;
+		_condition.notify_all ();
+
+		while (_frames.find(index) == _frames.end() && _error_index != index) {
+			_condition.wait (lm);
+		}
+
+		if (_error_index == index) {
+			std::rethrow_exception (_error);
+		}
+
+		return _frames[index];
+	}
+
+private:
+	void run ()
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		while (true) {
+			while (!_stop && (_next >= _end || _next > _wanted + _depth || _error_index)) {
+				_condition.wait (lm);
+			}
+
+			if (_stop) {
+				return;
+			}
+
+			auto const index = _next++;
+			auto const generation = _generation;
+			_reading = index;
+			_reading_generation = generation;
+			lm.unlock ();
+
+			Frame frame;
+			std::exception_ptr error;
+			try {
+				frame = _read (index);
+			} catch (...) {
+				error = std::current_exception ();
+			}
+
+			lm.lock ();
+			_reading = boost::none;
+			if (generation == _generation) {
+				if (error) {
+					_error = error;
+					_error_index = index;
+				} else {
+					_frames[index] = frame;
+				}
+			}
+			_condition.notify_all ();
+		}
+	}
+
+	std::function<Frame (int64_t)> _read;
+	int64_t const _end;
+	int const _depth;
+
+	/** mutex to protect everything below */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	/** frames that have been read, and not yet passed over, with their indices */
+	std::map<int64_t, Frame> _frames;
+	/** index of the next frame to read */
+	int64_t _next = 0;
+	/** index of the frame that was last asked for */
+	int64_t _wanted = 0;
+	/** index of the frame that our thread is reading, if there is one */
+	boost::optional<int64_t> _reading;
+	/** value of _generation when our thread started reading _reading */
+	int _reading_generation = 0;
+	/** incremented each time that we start reading from a new place */
+	int _generation = 0;
+	/** exception thrown when reading the frame with index _error_index */
+	std::exception_ptr _error;
+	boost::optional<int64_t> _error_index;
+	bool _stop = false;
+	boost::thread _thread;
+};
+
+
+#endif
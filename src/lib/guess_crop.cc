@@ -19,6 +19,7 @@
 */
 
 
+#include "dcpomatic_assert.h"
 #include "decoder.h"
 #include "decoder_factory.h"
 #include "image_proxy.h"
@@ -28,81 +29,126 @@
 
 
 using std::shared_ptr;
+using std::vector;
+using boost::optional;
 using namespace dcpomatic;
 
 
-Crop
-guess_crop (shared_ptr<const Image> image, double threshold)
+void
+BrightnessProfile::merge(BrightnessProfile const& other)
+{
+	if (rows.empty() && columns.empty()) {
+		*this = other;
+		return;
+	}
+
+	DCPOMATIC_ASSERT(rows.size() == other.rows.size());
+	DCPOMATIC_ASSERT(columns.size() == other.columns.size());
+
+	for (size_t i = 0; i < rows.size(); ++i) {
+		rows[i] = std::max(rows[i], other.rows[i]);
+	}
+
+	for (size_t i = 0; i < columns.size(); ++i) {
+		columns[i] = std::max(columns[i], other.columns[i]);
+	}
+}
+
+
+/** Scan an image once, from top to bottom, keeping the brightest value for each row and column.
+ *  @param brightness Function to get the brightness of one pixel on a row, given a pointer to the start of the row,
+ *  in units of 1 / scale.
+ */
+template <class T, class F>
+static BrightnessProfile
+scan(shared_ptr<const Image> image, int scale, F brightness)
 {
 	auto const width = image->size().width;
 	auto const height = image->size().height;
 
-	auto image_in_line = [image, threshold](int start_x, int start_y, int pixels, bool rows) {
-		double brightest = 0;
-
-		switch (image->pixel_format()) {
-		case AV_PIX_FMT_RGB24:
-		{
-			uint8_t const* data = image->data()[0] + start_x * 3 + start_y * image->stride()[0];
-			for (int p = 0; p < pixels; ++p) {
-				/* Averaging R, G and B */
-				brightest = std::max(brightest, static_cast<double>(data[0] + data[1] + data[2]) / (3 * 256));
-				data += rows ? 3 : image->stride()[0];
-			}
-			break;
-		}
-		case AV_PIX_FMT_YUV420P:
-		{
-			uint8_t const* data = image->data()[0] + start_x + start_y * image->stride()[0];
-			for (int p = 0; p < pixels; ++p) {
-				/* Just using Y */
-				brightest = std::max(brightest, static_cast<double>(*data) / 256);
-				data += rows ? 1 : image->stride()[0];
-			}
-			break;
-		}
-		case AV_PIX_FMT_YUV422P10LE:
-		{
-			uint16_t const* data = reinterpret_cast<uint16_t*>(image->data()[0] + (start_x * 2) + (start_y * image->stride()[0]));
-			for (int p = 0; p < pixels; ++p) {
-				/* Just using Y */
-				brightest = std::max(brightest, static_cast<double>(*data) / 1024);
-				data += rows ? 1 : (image->stride()[0] / 2);
-			}
-			break;
-		}
-		default:
-			throw PixelFormatError("guess_crop()", image->pixel_format());
+	vector<int> row_max(height, 0);
+	vector<int> column_max(width, 0);
+
+	for (int y = 0; y < height; ++y) {
+		auto line = reinterpret_cast<T const*>(image->data()[0] + y * image->stride()[0]);
+		int* column = column_max.data();
+		int brightest = 0;
+		for (int x = 0; x < width; ++x) {
+			int const b = brightness(line, x);
+			brightest = std::max(brightest, b);
+			column[x] = std::max(column[x], b);
 		}
+		row_max[y] = brightest;
+	}
 
-		return brightest > threshold;
+	auto to_float = [scale](vector<int> const& in) {
+		vector<float> out(in.size());
+		for (size_t i = 0; i < in.size(); ++i) {
+			out[i] = static_cast<float>(in[i]) / scale;
+		}
+		return out;
 	};
 
+	return { to_float(row_max), to_float(column_max) };
+}
+
+
+BrightnessProfile
+brightness_profile(shared_ptr<const Image> image)
+{
+	switch (image->pixel_format()) {
+	case AV_PIX_FMT_RGB24:
+		/* Averaging R, G and B */
+		return scan<uint8_t>(image, 3 * 256, [](uint8_t const* line, int x) {
+			return line[x * 3] + line[x * 3 + 1] + line[x * 3 + 2];
+		});
+	case AV_PIX_FMT_YUV420P:
+		/* Just using Y */
+		return scan<uint8_t>(image, 256, [](uint8_t const* line, int x) {
+			return line[x];
+		});
+	case AV_PIX_FMT_YUV422P10LE:
+		/* Just using Y */
+		return scan<uint16_t>(image, 1024, [](uint16_t const* line, int x) {
+			return line[x];
+		});
+	default:
+		throw PixelFormatError("brightness_profile()", image->pixel_format());
+	}
+}
+
+
+Crop
+guess_crop (BrightnessProfile const& profile, double threshold)
+{
+	auto const width = static_cast<int>(profile.columns.size());
+	auto const height = static_cast<int>(profile.rows.size());
+
 	auto crop = Crop{};
 
 	for (auto y = 0; y < height; ++y) {
-		if (image_in_line(0, y, width, true)) {
+		if (profile.rows[y] > threshold) {
 			crop.top = y;
 			break;
 		}
 	}
 
 	for (auto y = height - 1; y >= 0; --y) {
-		if (image_in_line(0, y, width, true)) {
+		if (profile.rows[y] > threshold) {
 			crop.bottom = height - 1 - y;
 			break;
 		}
 	}
 
 	for (auto x = 0; x < width; ++x) {
-		if (image_in_line(x, 0, height, false)) {
+		if (profile.columns[x] > threshold) {
 			crop.left = x;
 			break;
 		}
 	}
 
 	for (auto x = width - 1; x >= 0; --x) {
-		if (image_in_line(x, 0, height, false)) {
+		if (profile.columns[x] > threshold) {
 			crop.right = width - 1 - x;
 			break;
 		}
@@ -112,32 +158,58 @@ guess_crop (shared_ptr<const Image> image, double threshold)
 }
 
 
-/** @param position Time within the content to get a video frame from when guessing the crop */
 Crop
-guess_crop (shared_ptr<const Film> film, shared_ptr<const Content> content, double threshold, ContentTime position)
+guess_crop (shared_ptr<const Image> image, double threshold)
 {
-	DCPOMATIC_ASSERT (content->video);
+	return guess_crop(brightness_profile(image), threshold);
+}
 
-	auto decoder = decoder_factory (film, content, false, false, {});
-	DCPOMATIC_ASSERT (decoder->video);
 
-	bool done = false;
-	auto crop = Crop{};
+/** Get the brightness profile of the first video frame that a decoder gives after seeking to a position.
+ *  The seek is not accurate, so the frame will usually be a key frame near the position.
+ *  @return Profile, or empty if no frame could be found.
+ */
+optional<BrightnessProfile>
+brightness_profile(shared_ptr<Decoder> decoder, ContentTime position)
+{
+	DCPOMATIC_ASSERT(decoder->video);
 
-	auto handle_video = [&done, &crop, threshold](ContentVideo video) {
-		crop = guess_crop(video.image->image(Image::Alignment::COMPACT).image, threshold);
-		done = true;
-	};
+	optional<BrightnessProfile> profile;
 
-	decoder->video->Data.connect (handle_video);
-	decoder->seek (position, false);
+	auto connection = decoder->video->Data.connect([&profile](ContentVideo video) {
+		if (!profile) {
+			profile = brightness_profile(video.image->image(Image::Alignment::COMPACT).image);
+		}
+	});
+
+	decoder->seek(position, false);
 
 	int tries_left = 50;
-	while (!done && tries_left >= 0) {
-		decoder->pass();
+	while (!profile && tries_left >= 0) {
+		if (decoder->pass()) {
+			break;
+		}
 		--tries_left;
 	}
 
-	return crop;
+	connection.disconnect();
+	return profile;
 }
 
+
+/** @param position Time within the content to get a video frame from when guessing the crop */
+Crop
+guess_crop (shared_ptr<const Film> film, shared_ptr<const Content> content, double threshold, ContentTime position)
+{
+	DCPOMATIC_ASSERT (content->video);
+
+	auto decoder = decoder_factory (film, content, false, false, {});
+	DCPOMATIC_ASSERT (decoder->video);
+
+	auto profile = brightness_profile(decoder, position);
+	if (!profile) {
+		return {};
+	}
+
+	return guess_crop(*profile, threshold);
+}
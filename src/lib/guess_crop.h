@@ -21,14 +21,40 @@
 
 #include "dcpomatic_time.h"
 #include "types.h"
+#include <boost/optional.hpp>
 #include <memory>
+#include <vector>
 
 
 class Content;
+class Decoder;
 class Film;
 class Image;
 
 
+/** The brightness of the brightest pixel in each row and each column of an image,
+ *  from 0 to 1.
+ */
+class BrightnessProfile
+{
+public:
+	BrightnessProfile() = default;
+	BrightnessProfile(std::vector<float> rows_, std::vector<float> columns_)
+		: rows(std::move(rows_))
+		, columns(std::move(columns_))
+	{}
+
+	/** Make each row and column as bright as the brighter of it and the same one in other */
+	void merge(BrightnessProfile const& other);
+
+	std::vector<float> rows;
+	std::vector<float> columns;
+};
+
+
+BrightnessProfile brightness_profile(std::shared_ptr<const Image> image);
+boost::optional<BrightnessProfile> brightness_profile(std::shared_ptr<Decoder> decoder, dcpomatic::ContentTime position);
+Crop guess_crop (BrightnessProfile const& profile, double threshold);
 Crop guess_crop (std::shared_ptr<const Image> image, double threshold);
 Crop guess_crop (std::shared_ptr<const Film> fillm, std::shared_ptr<const Content> content, double threshold, dcpomatic::ContentTime position);
 
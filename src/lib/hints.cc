@@ -34,6 +34,7 @@
 #include "player.h"
 #include "ratio.h"
 #include "text_content.h"
+#include "text_hints.h"
 #include "types.h"
 #include "video_content.h"
 #include "writer.h"
@@ -102,6 +103,51 @@ Hints::~Hints ()
 }
 
 
+/** @return true if a change to the given property of the film could change any of our hints */
+bool
+Hints::film_change_matters (Film::Property property)
+{
+	switch (property) {
+	case Film::Property::NAME:
+	case Film::Property::USE_ISDCF_NAME:
+	case Film::Property::REENCODE_J2K:
+	case Film::Property::TWO_PASS_ENCODING:
+	case Film::Property::RATINGS:
+	case Film::Property::CONTENT_VERSIONS:
+	case Film::Property::NAME_LANGUAGE:
+	case Film::Property::RELEASE_TERRITORY:
+	case Film::Property::SIGN_LANGUAGE_VIDEO_LANGUAGE:
+	case Film::Property::VERSION_NUMBER:
+	case Film::Property::STATUS:
+	case Film::Property::CHAIN:
+	case Film::Property::DISTRIBUTOR:
+	case Film::Property::FACILITY:
+	case Film::Property::STUDIO:
+	case Film::Property::TEMP_VERSION:
+	case Film::Property::PRE_RELEASE:
+	case Film::Property::RED_BAND:
+	case Film::Property::TWO_D_VERSION_OF_THREE_D:
+	case Film::Property::LUMINANCE:
+		return false;
+	default:
+		return true;
+	}
+}
+
+
+/** @return true if a change to the given property of some of the film's content could change any of our hints */
+bool
+Hints::content_change_matters (int property)
+{
+	return property != VideoContentProperty::COLOUR_CONVERSION &&
+		property != VideoContentProperty::FADE_IN &&
+		property != VideoContentProperty::FADE_OUT &&
+		property != VideoContentProperty::RANGE &&
+		property != TextContentProperty::COLOUR &&
+		property != TextContentProperty::EFFECT_COLOUR;
+}
+
+
 void
 Hints::check_few_audio_channels ()
 {
@@ -342,6 +388,9 @@ Hints::check_loudness ()
 	} catch (OldFormatError& e) {
 		/* The audio analysis is too old to load in */
 		return false;
+	} catch (FileError& e) {
+		/* The audio analysis is damaged */
+		return false;
 	}
 
 	return true;
@@ -400,90 +449,75 @@ try
 	check_text_languages ();
 	check_audio_language ();
 
-	if (check_loudness_done) {
-		emit (bind(boost::ref(Progress), _("Examining subtitles and closed captions")));
-	} else {
-		emit (bind(boost::ref(Progress), _("Examining audio, subtitles and closed captions")));
-	}
-
-	auto player = make_shared<Player>(film, Image::Alignment::COMPACT);
-	player->set_ignore_video ();
-	if (check_loudness_done || _disable_audio_analysis) {
-		/* We don't need to analyse audio because we already loaded a suitable analysis */
-		player->set_ignore_audio ();
-	}
-	player->Audio.connect (bind(&Hints::audio, this, _1, _2));
-	player->Text.connect (bind(&Hints::text, this, _1, _2, _3, _4));
-
-	struct timeval last_pulse;
-	gettimeofday (&last_pulse, 0);
-
-	_writer->write (player->get_subtitle_fonts());
-
-	while (!player->pass()) {
-
-		struct timeval now;
-		gettimeofday (&now, 0);
-		if ((seconds(now) - seconds(last_pulse)) > 1) {
-			if (_stop) {
-				return;
-			}
-			emit (bind (boost::ref(Pulse)));
-			last_pulse = now;
+	/* If the texts have not changed since we last looked at them we can use what we found then */
+	optional<TextHints> cached_text_hints;
+	auto const text_hints_path = film->text_hints_path();
+	if (boost::filesystem::exists(text_hints_path)) {
+		try {
+			cached_text_hints = TextHints(text_hints_path);
+		} catch (...) {
+			/* Never mind; we'll look again */
 		}
 	}
 
-	if (!check_loudness_done) {
-		_analyser.finish ();
-		_analyser.get().write(film->audio_analysis_path(film->playlist()));
-		check_loudness ();
-	}
+	bool const need_audio = !check_loudness_done && !_disable_audio_analysis;
 
+	if (!cached_text_hints || need_audio) {
+		if (!need_audio) {
+			emit (bind(boost::ref(Progress), _("Examining subtitles and closed captions")));
+		} else if (cached_text_hints) {
+			emit (bind(boost::ref(Progress), _("Examining audio")));
+		} else {
+			emit (bind(boost::ref(Progress), _("Examining audio, subtitles and closed captions")));
+		}
 
-	if (_long_subtitle && !_very_long_subtitle) {
-		hint (_("At least one of your subtitle lines has more than 52 characters.  It is recommended to make each line 52 characters at most in length."));
-	} else if (_very_long_subtitle) {
-		hint (_("At least one of your subtitle lines has more than 79 characters.  You should make each line 79 characters at most in length."));
-	}
+		auto player = make_shared<Player>(film, Image::Alignment::COMPACT);
+		player->set_ignore_video ();
+		if (!need_audio) {
+			/* We don't need to analyse audio because we already loaded a suitable analysis */
+			player->set_ignore_audio ();
+		}
+		if (cached_text_hints) {
+			player->set_ignore_text ();
+		}
+		player->Audio.connect (bind(&Hints::audio, this, _1, _2));
+		player->Text.connect (bind(&Hints::text, this, _1, _2, _3, _4));
 
-	bool ccap_xml_too_big = false;
-	bool ccap_mxf_too_big = false;
-	bool subs_mxf_too_big = false;
+		struct timeval last_pulse;
+		gettimeofday (&last_pulse, 0);
 
-	auto dcp_dir = film->dir("hints") / dcpomatic::get_process_id();
-	boost::filesystem::remove_all (dcp_dir);
+		if (!cached_text_hints) {
+			_writer->write (player->get_subtitle_fonts());
+		}
 
-	_writer->finish (film->dir("hints") / dcpomatic::get_process_id());
+		while (!player->pass()) {
 
-	dcp::DCP dcp (dcp_dir);
-	dcp.read ();
-	DCPOMATIC_ASSERT (dcp.cpls().size() == 1);
-	for (auto reel: dcp.cpls()[0]->reels()) {
-		for (auto ccap: reel->closed_captions()) {
-			if (ccap->asset() && ccap->asset()->xml_as_string().length() > static_cast<size_t>(MAX_CLOSED_CAPTION_XML_SIZE - SIZE_SLACK) && !ccap_xml_too_big) {
-				hint (_(
-						"At least one of your closed caption files' XML part is larger than " MAX_CLOSED_CAPTION_XML_SIZE_TEXT
-						".  You should divide the DCP into shorter reels."
-				       ));
-				ccap_xml_too_big = true;
-			}
-			if (subtitle_mxf_too_big(ccap->asset()) && !ccap_mxf_too_big) {
-				hint (_(
-						"At least one of your closed caption files is larger than " MAX_TEXT_MXF_SIZE_TEXT
-						" in total.  You should divide the DCP into shorter reels."
-				       ));
-				ccap_mxf_too_big = true;
+			struct timeval now;
+			gettimeofday (&now, 0);
+			if ((seconds(now) - seconds(last_pulse)) > 1) {
+				if (_stop) {
+					return;
+				}
+				emit (bind (boost::ref(Pulse)));
+				last_pulse = now;
 			}
 		}
-		if (reel->main_subtitle() && subtitle_mxf_too_big(reel->main_subtitle()->asset()) && !subs_mxf_too_big) {
-			hint (_(
-					"At least one of your subtitle files is larger than " MAX_TEXT_MXF_SIZE_TEXT " in total.  "
-					"You should divide the DCP into shorter reels."
-			       ));
-			subs_mxf_too_big = true;
+
+		if (!check_loudness_done) {
+			_analyser.finish ();
+			_analyser.get().write(film->audio_analysis_path(film->playlist()));
+			check_loudness ();
 		}
 	}
-	boost::filesystem::remove_all (dcp_dir);
+
+	if (cached_text_hints) {
+		_text_hints = *cached_text_hints;
+	} else {
+		check_text_sizes ();
+		_text_hints.write (text_hints_path);
+	}
+
+	text_hints ();
 
 	emit (bind(boost::ref(Finished)));
 }
@@ -536,28 +570,17 @@ Hints::closed_caption (PlayerText text, DCPTimePeriod period)
 	for (auto i: text.string) {
 		if (utf8_strlen(i.text()) > MAX_CLOSED_CAPTION_LENGTH) {
 			++lines;
-			if (!_long_ccap) {
-				_long_ccap = true;
-				hint (
-					String::compose(
-						"At least one of your closed caption lines has more than %1 characters.  "
-						"It is advisable to make each line %1 characters at most in length.",
-						MAX_CLOSED_CAPTION_LENGTH,
-						MAX_CLOSED_CAPTION_LENGTH)
-				     );
-			}
+			_text_hints.long_ccap = true;
 		}
 	}
 
-	if (!_too_many_ccap_lines && lines > MAX_CLOSED_CAPTION_LINES) {
-		hint (String::compose(_("Some of your closed captions span more than %1 lines, so they will be truncated."), MAX_CLOSED_CAPTION_LINES));
-		_too_many_ccap_lines = true;
+	if (lines > MAX_CLOSED_CAPTION_LINES) {
+		_text_hints.too_many_ccap_lines = true;
 	}
 
 	/* XXX: maybe overlapping closed captions (i.e. different languages) are OK with Interop? */
-	if (film()->interop() && !_overlap_ccap && _last_ccap && _last_ccap->overlap(period)) {
-		_overlap_ccap = true;
-		hint (_("You have overlapping closed captions, which are not allowed in Interop DCPs.  Change your DCP standard to SMPTE."));
+	if (film()->interop() && _last_ccap && _last_ccap->overlap(period)) {
+		_text_hints.overlap_ccap = true;
 	}
 
 	_last_ccap = period;
@@ -567,26 +590,22 @@ Hints::closed_caption (PlayerText text, DCPTimePeriod period)
 void
 Hints::open_subtitle (PlayerText text, DCPTimePeriod period)
 {
-	if (period.from < DCPTime::from_seconds(4) && !_early_subtitle) {
-		_early_subtitle = true;
-		hint (_("It is advisable to put your first subtitle at least 4 seconds after the start of the DCP to make sure it is seen."));
+	if (period.from < DCPTime::from_seconds(4)) {
+		_text_hints.early_subtitle = true;
 	}
 
 	int const vfr = film()->video_frame_rate ();
 
-	if (period.duration().frames_round(vfr) < 15 && !_short_subtitle) {
-		_short_subtitle = true;
-		hint (_("At least one of your subtitles lasts less than 15 frames.  It is advisable to make each subtitle at least 15 frames long."));
+	if (period.duration().frames_round(vfr) < 15) {
+		_text_hints.short_subtitle = true;
 	}
 
-	if (_last_subtitle && DCPTime(period.from - _last_subtitle->to).frames_round(vfr) < 2 && !_subtitles_too_close) {
-		_subtitles_too_close = true;
-		hint (_("At least one of your subtitles starts less than 2 frames after the previous one.  It is advisable to make the gap between subtitles at least 2 frames."));
+	if (_last_subtitle && DCPTime(period.from - _last_subtitle->to).frames_round(vfr) < 2) {
+		_text_hints.subtitles_too_close = true;
 	}
 
-	if (text.string.size() > 3 && !_too_many_subtitle_lines) {
-		_too_many_subtitle_lines = true;
-		hint (_("At least one of your subtitles has more than 3 lines.  It is advisable to use no more than 3 lines."));
+	if (text.string.size() > 3) {
+		_text_hints.too_many_subtitle_lines = true;
 	}
 
 	size_t longest_line = 0;
@@ -595,17 +614,115 @@ Hints::open_subtitle (PlayerText text, DCPTimePeriod period)
 	}
 
 	if (longest_line > 52) {
-		_long_subtitle = true;
+		_text_hints.long_subtitle = true;
 	}
 
 	if (longest_line > 79) {
-		_very_long_subtitle = true;
+		_text_hints.very_long_subtitle = true;
 	}
 
 	_last_subtitle = period;
 }
 
 
+/** Look at the partial DCP that _writer has made to see if any of its text files are too big */
+void
+Hints::check_text_sizes ()
+{
+	auto film = this->film();
+
+	auto dcp_dir = film->dir("hints") / dcpomatic::get_process_id();
+	boost::filesystem::remove_all (dcp_dir);
+
+	_writer->finish (film->dir("hints") / dcpomatic::get_process_id());
+
+	dcp::DCP dcp (dcp_dir);
+	dcp.read ();
+	DCPOMATIC_ASSERT (dcp.cpls().size() == 1);
+	for (auto reel: dcp.cpls()[0]->reels()) {
+		for (auto ccap: reel->closed_captions()) {
+			if (ccap->asset() && ccap->asset()->xml_as_string().length() > static_cast<size_t>(MAX_CLOSED_CAPTION_XML_SIZE - SIZE_SLACK)) {
+				_text_hints.ccap_xml_too_big = true;
+			}
+			if (subtitle_mxf_too_big(ccap->asset())) {
+				_text_hints.ccap_mxf_too_big = true;
+			}
+		}
+		if (reel->main_subtitle() && subtitle_mxf_too_big(reel->main_subtitle()->asset())) {
+			_text_hints.subs_mxf_too_big = true;
+		}
+	}
+	boost::filesystem::remove_all (dcp_dir);
+}
+
+
+/** Give hints for what we found out about the film's texts */
+void
+Hints::text_hints ()
+{
+	if (_text_hints.long_ccap) {
+		hint (
+			String::compose(
+				"At least one of your closed caption lines has more than %1 characters.  "
+				"It is advisable to make each line %1 characters at most in length.",
+				MAX_CLOSED_CAPTION_LENGTH,
+				MAX_CLOSED_CAPTION_LENGTH)
+		     );
+	}
+
+	if (_text_hints.too_many_ccap_lines) {
+		hint (String::compose(_("Some of your closed captions span more than %1 lines, so they will be truncated."), MAX_CLOSED_CAPTION_LINES));
+	}
+
+	if (_text_hints.overlap_ccap) {
+		hint (_("You have overlapping closed captions, which are not allowed in Interop DCPs.  Change your DCP standard to SMPTE."));
+	}
+
+	if (_text_hints.early_subtitle) {
+		hint (_("It is advisable to put your first subtitle at least 4 seconds after the start of the DCP to make sure it is seen."));
+	}
+
+	if (_text_hints.short_subtitle) {
+		hint (_("At least one of your subtitles lasts less than 15 frames.  It is advisable to make each subtitle at least 15 frames long."));
+	}
+
+	if (_text_hints.subtitles_too_close) {
+		hint (_("At least one of your subtitles starts less than 2 frames after the previous one.  It is advisable to make the gap between subtitles at least 2 frames."));
+	}
+
+	if (_text_hints.too_many_subtitle_lines) {
+		hint (_("At least one of your subtitles has more than 3 lines.  It is advisable to use no more than 3 lines."));
+	}
+
+	if (_text_hints.long_subtitle && !_text_hints.very_long_subtitle) {
+		hint (_("At least one of your subtitle lines has more than 52 characters.  It is recommended to make each line 52 characters at most in length."));
+	} else if (_text_hints.very_long_subtitle) {
+		hint (_("At least one of your subtitle lines has more than 79 characters.  You should make each line 79 characters at most in length."));
+	}
+
+	if (_text_hints.ccap_xml_too_big) {
+		hint (_(
+				"At least one of your closed caption files' XML part is larger than " MAX_CLOSED_CAPTION_XML_SIZE_TEXT
+				".  You should divide the DCP into shorter reels."
+		       ));
+	}
+
+	if (_text_hints.ccap_mxf_too_big) {
+		hint (_(
+				"At least one of your closed caption files is larger than " MAX_TEXT_MXF_SIZE_TEXT
+				" in total.  You should divide the DCP into shorter reels."
+		       ));
+	}
+
+	if (_text_hints.subs_mxf_too_big) {
+		hint (_(
+				"At least one of your subtitle files is larger than " MAX_TEXT_MXF_SIZE_TEXT " in total.  "
+				"You should divide the DCP into shorter reels."
+		       ));
+	}
+}
+
+
 void
 Hints::check_ffec_and_ffmc_in_smpte_feature ()
 {
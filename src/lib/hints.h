@@ -22,9 +22,11 @@
 #include "audio_analyser.h"
 #include "signaller.h"
 #include "player_text.h"
+#include "text_hints.h"
 #include "types.h"
 #include "dcp_text_track.h"
 #include "dcpomatic_time.h"
+#include "film.h"
 #include "weak_film.h"
 #include <boost/signals2.hpp>
 #include <boost/atomic.hpp>
@@ -32,7 +34,6 @@
 #include <string>
 
 
-class Film;
 class Writer;
 
 
@@ -44,6 +45,9 @@ public:
 
 	void start ();
 
+	static bool film_change_matters (Film::Property property);
+	static bool content_change_matters (int property);
+
 	boost::signals2::signal<void (std::string)> Hint;
 	boost::signals2::signal<void (std::string)> Progress;
 	boost::signals2::signal<void (void)> Pulse;
@@ -64,6 +68,8 @@ private:
 	void text (PlayerText text, TextType type, boost::optional<DCPTextTrack> track, dcpomatic::DCPTimePeriod period);
 	void closed_caption (PlayerText text, dcpomatic::DCPTimePeriod period);
 	void open_subtitle (PlayerText text, dcpomatic::DCPTimePeriod period);
+	void check_text_sizes ();
+	void text_hints ();
 
 	void check_certificates ();
 	void check_interop ();
@@ -93,17 +99,9 @@ private:
 
 	AudioAnalyser _analyser;
 
-	bool _long_ccap = false;
-	bool _overlap_ccap = false;
-	bool _too_many_ccap_lines = false;
+	/** What we have found out about the texts */
+	TextHints _text_hints;
 	boost::optional<dcpomatic::DCPTimePeriod> _last_ccap;
-
-	bool _early_subtitle = false;
-	bool _short_subtitle = false;
-	bool _subtitles_too_close = false;
-	bool _too_many_subtitle_lines = false;
-	bool _long_subtitle = false;
-	bool _very_long_subtitle = false;
 	boost::optional<dcpomatic::DCPTimePeriod> _last_subtitle;
 
 	boost::atomic<bool> _stop;
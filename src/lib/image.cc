@@ -25,14 +25,17 @@
 
 
 #include "compose.hpp"
+#include "cpu_dispatch.h"
 #include "dcpomatic_assert.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
 #include "enum_indexed_vector.h"
 #include "exceptions.h"
 #include "image.h"
+#include "image_pool.h"
 #include "maths_util.h"
-#include "memory_util.h"
 #include "rect.h"
+#include "rgba.h"
 #include "timer.h"
 #include <dcp/rgb_xyz.h>
 #include <dcp/transfer_function.h>
@@ -40,6 +43,7 @@
 LIBDCP_DISABLE_WARNINGS
 extern "C" {
 #include <libavutil/frame.h>
+#include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/pixfmt.h>
 #include <libswscale/swscale.h>
@@ -48,6 +52,13 @@ LIBDCP_ENABLE_WARNINGS
 #if HAVE_VALGRIND_MEMCHECK_H
 #include <valgrind/memcheck.h>
 #endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include <algorithm>
+#include <array>
 #include <iostream>
 
 
@@ -56,14 +67,21 @@ LIBDCP_ENABLE_WARNINGS
 
 using std::cerr;
 using std::cout;
+using std::function;
 using std::list;
+using std::make_pair;
 using std::make_shared;
 using std::max;
 using std::min;
+using std::pair;
 using std::runtime_error;
 using std::shared_ptr;
 using std::string;
+using std::vector;
+using boost::optional;
 using dcp::Size;
+using dcpomatic::cpu::ISA;
+using dcpomatic::cpu::Kernel;
 
 
 /** The memory alignment, in bytes, used for each row of an image if Alignment::PADDED is requested */
@@ -123,6 +141,22 @@ Image::sample_size (int n) const
 }
 
 
+/** @param c Plane index.
+ *  @param first_row First row of the image.
+ *  @param rows Number of rows of the image.
+ *  @return The first row of plane c, and the number of its rows, which belong to the given rows of the image.
+ *  A subsampled row belongs to the image row where it starts.
+ */
+pair<int, int>
+Image::plane_rows (int c, int first_row, int rows) const
+{
+	int const f = vertical_factor(c);
+	int const first = (first_row + f - 1) / f;
+	int const last = min(sample_size(c).height, (first_row + rows + f - 1) / f);
+	return { first, max(0, last - first) };
+}
+
+
 /** @return Number of planes */
 int
 Image::planes () const
@@ -140,7 +174,12 @@ Image::planes () const
 		return 1;
 	}
 
-	return d->nb_components;
+	/* Semi-planar formats like NV12 (which hardware decoders give us) have more than one component in some planes */
+	int planes = 0;
+	for (int i = 0; i < d->nb_components; ++i) {
+		planes = std::max(planes, d->comp[i].plane + 1);
+	}
+	return planes;
 }
 
 
@@ -160,6 +199,210 @@ round_height_for_subsampling (int p, AVPixFmtDescriptor const * desc)
 }
 
 
+namespace {
+
+/** Everything that an SwsContext is set up with */
+struct ScaleContextKey
+{
+	dcp::Size in_size;
+	AVPixelFormat in_format;
+	dcp::Size out_size;
+	AVPixelFormat out_format;
+	int flags;
+	dcp::YUVToRGB yuv_to_rgb;
+	/** source range as passed to sws_setColorspaceDetails: 0 for video, 1 for full */
+	int in_range;
+	/** destination range as passed to sws_setColorspaceDetails: 0 for video, 1 for full */
+	int out_range;
+	/** number of threads for the context to scale with */
+	int threads;
+
+	bool operator== (ScaleContextKey const& other) const {
+		return in_size == other.in_size && in_format == other.in_format &&
+			out_size == other.out_size && out_format == other.out_format &&
+			flags == other.flags && yuv_to_rgb == other.yuv_to_rgb &&
+			in_range == other.in_range && out_range == other.out_range &&
+			threads == other.threads;
+	}
+};
+
+
+/** A small set of SwsContexts, most recently used first.  Setting up a context means
+ *  calculating its filter coefficients, which is expensive for large images, and the
+ *  parameters generally stay the same for a whole piece of content.  An SwsContext may
+ *  only be used by one thread at a time, so each thread has its own cache.
+ */
+class ScaleContextCache
+{
+public:
+	ScaleContextCache () = default;
+	ScaleContextCache (ScaleContextCache const&) = delete;
+	ScaleContextCache& operator= (ScaleContextCache const&) = delete;
+
+	~ScaleContextCache ()
+	{
+		for (auto const& i: _contexts) {
+			sws_freeContext (i.second);
+		}
+	}
+
+	SwsContext* get (ScaleContextKey const& key)
+	{
+		for (auto i = _contexts.begin(); i != _contexts.end(); ++i) {
+			if (i->first == key) {
+				_contexts.splice (_contexts.begin(), _contexts, i);
+				return i->second;
+			}
+		}
+
+		SwsContext* context = nullptr;
+#ifdef DCPOMATIC_HAVE_SWS_THREADS
+		if (key.threads > 1) {
+			/* We must set up the context this way to give it some threads */
+			context = sws_alloc_context ();
+			if (context) {
+				av_opt_set_int (context, "srcw", key.in_size.width, 0);
+				av_opt_set_int (context, "srch", key.in_size.height, 0);
+				av_opt_set_int (context, "src_format", key.in_format, 0);
+				av_opt_set_int (context, "dstw", key.out_size.width, 0);
+				av_opt_set_int (context, "dsth", key.out_size.height, 0);
+				av_opt_set_int (context, "dst_format", key.out_format, 0);
+				av_opt_set_int (context, "sws_flags", key.flags, 0);
+				av_opt_set_int (context, "threads", key.threads, 0);
+				if (sws_init_context(context, nullptr, nullptr) < 0) {
+					sws_freeContext (context);
+					context = nullptr;
+				}
+			}
+		}
+#endif
+
+		if (!context) {
+			context = sws_getContext (
+				key.in_size.width, key.in_size.height, key.in_format,
+				key.out_size.width, key.out_size.height, key.out_format,
+				key.flags, 0, 0, 0
+				);
+		}
+
+		if (!context) {
+			throw runtime_error (N_("Could not allocate SwsContext"));
+		}
+
+		DCPOMATIC_ASSERT (key.yuv_to_rgb < dcp::YUVToRGB::COUNT);
+		EnumIndexedVector<int, dcp::YUVToRGB> lut;
+		lut[dcp::YUVToRGB::REC601] = SWS_CS_ITU601;
+		lut[dcp::YUVToRGB::REC709] = SWS_CS_ITU709;
+		lut[dcp::YUVToRGB::REC2020] = SWS_CS_BT2020;
+
+		/* The 3rd parameter here is:
+		   0 -> source range MPEG (i.e. "video", 16-235)
+		   1 -> source range JPEG (i.e. "full", 0-255)
+		   And the 5th:
+		   0 -> destination range MPEG (i.e. "video", 16-235)
+		   1 -> destination range JPEG (i.e. "full", 0-255)
+
+		   But remember: sws_setColorspaceDetails ignores these
+		   parameters unless the both source and destination images
+		   are isYUV or isGray.  (If either is not, it uses video range).
+		*/
+		sws_setColorspaceDetails (
+			context,
+			sws_getCoefficients(lut[key.yuv_to_rgb]), key.in_range,
+			sws_getCoefficients(lut[key.yuv_to_rgb]), key.out_range,
+			0, 1 << 16, 1 << 16
+			);
+
+		_contexts.push_front (make_pair(key, context));
+		if (static_cast<int>(_contexts.size()) > _max_contexts) {
+			sws_freeContext (_contexts.back().second);
+			_contexts.pop_back ();
+		}
+
+		return context;
+	}
+
+private:
+	list<pair<ScaleContextKey, SwsContext*>> _contexts;
+	static int constexpr _max_contexts = 8;
+};
+
+}
+
+
+/** Number of threads that crop_scale_window() should use to scale on this thread */
+static thread_local int scale_thread_count = 1;
+
+
+/** Set the number of threads that crop_scale_window() will use to scale images when it is
+ *  called on the current thread.  This only has an effect if our FFmpeg supports threaded
+ *  scaling; otherwise scaling is always done on the calling thread.
+ */
+void
+Image::set_scale_threads (int threads)
+{
+	scale_thread_count = max(1, threads);
+}
+
+
+int
+Image::scale_threads ()
+{
+#ifdef DCPOMATIC_HAVE_SWS_THREADS
+	return scale_thread_count;
+#else
+	return 1;
+#endif
+}
+
+
+/** @return an SwsContext set up for `key', which may be re-used from a previous call
+ *  on this thread; the caller must not free it.
+ */
+static
+SwsContext*
+scale_context (ScaleContextKey const& key)
+{
+	thread_local ScaleContextCache cache;
+	return cache.get (key);
+}
+
+
+#ifdef DCPOMATIC_HAVE_SWS_THREADS
+/** @return A new AVFrame which refers to some image data that we own, for passing to
+ *  swscale's frame API; the AVFrame does not free the data when it goes away.
+ */
+static
+AVFrame*
+wrap_in_frame (uint8_t* const* data, int const* stride, int planes, dcp::Size size, AVPixelFormat format)
+{
+	auto frame = av_frame_alloc ();
+	if (!frame) {
+		throw std::bad_alloc ();
+	}
+
+	frame->width = size.width;
+	frame->height = size.height;
+	frame->format = format;
+	for (int i = 0; i < planes; ++i) {
+		frame->data[i] = data[i];
+		frame->linesize[i] = stride[i];
+	}
+
+	/* swscale will take references to the frame, so it needs a buffer to make it reference-counted,
+	 * otherwise the data would be copied.
+	 */
+	frame->buf[0] = av_buffer_create (data[0], stride[0] * size.height, [](void*, uint8_t*) {}, nullptr, 0);
+	if (!frame->buf[0]) {
+		av_frame_free (&frame);
+		throw std::bad_alloc ();
+	}
+
+	return frame;
+}
+#endif
+
+
 /** Crop this image, scale it to `inter_size' and then place it in a black frame of `out_size'.
  *  @param crop Amount to crop by.
  *  @param inter_size Size to scale the cropped image to.
@@ -171,6 +414,9 @@ round_height_for_subsampling (int p, AVPixFmtDescriptor const * desc)
  *  @param out_video_range Video range to use for the output image.
  *  @param fast Try to be fast at the possible expense of quality; at present this means using
  *  fast bilinear rather than bicubic scaling.
+ *  @param process_rows If set, this is called with the output image, the first row and the number of rows
+ *  as each band of rows of the output is finished, so that further processing can be done while
+ *  they are still in cache.  Each row is passed exactly once, in order from the top.
  */
 shared_ptr<Image>
 Image::crop_scale_window (
@@ -182,7 +428,8 @@ Image::crop_scale_window (
 	AVPixelFormat out_format,
 	VideoRange out_video_range,
 	Alignment out_alignment,
-	bool fast
+	bool fast,
+	function<void (Image&, int, int)> process_rows
 	) const
 {
 	/* Empirical testing suggests that sws_scale() will crash if
@@ -225,46 +472,31 @@ Image::crop_scale_window (
 	/* Size of the image after any crop */
 	auto const cropped_size = corrected_crop.apply (size());
 
-	/* Scale context for a scale from cropped_size to inter_size */
-	auto scale_context = sws_getContext (
-			cropped_size.width, cropped_size.height, pixel_format(),
-			inter_size.width, inter_size.height, out_format,
-			fast ? SWS_FAST_BILINEAR : SWS_BICUBIC, 0, 0, 0
-		);
-
-	if (!scale_context) {
-		throw runtime_error (N_("Could not allocate SwsContext"));
-	}
+	/* Scaling threads are only worth it for big images */
+	int const threads = inter_size.width * inter_size.height >= 2048 * 1080 ? scale_threads() : 1;
 
-	DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUVToRGB::COUNT);
-	EnumIndexedVector<int, dcp::YUVToRGB> lut;
-	lut[dcp::YUVToRGB::REC601] = SWS_CS_ITU601;
-	lut[dcp::YUVToRGB::REC709] = SWS_CS_ITU709;
-	lut[dcp::YUVToRGB::REC2020] = SWS_CS_BT2020;
-
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores these
-	   parameters unless the both source and destination images
-	   are isYUV or isGray.  (If either is not, it uses video range).
-	*/
-	sws_setColorspaceDetails (
-		scale_context,
-		sws_getCoefficients(lut[yuv_to_rgb]), video_range == VideoRange::VIDEO ? 0 : 1,
-		sws_getCoefficients(lut[yuv_to_rgb]), out_video_range == VideoRange::VIDEO ? 0 : 1,
-		0, 1 << 16, 1 << 16
-		);
+	/* If there is no scaling or conversion to be done we can just copy rows from the crop
+	 * into the output, without setting up a scaler.  We only do it for formats without chroma
+	 * subsampling, so that all planes have the same number of rows.
+	 */
+	bool const copy =
+		cropped_size == inter_size &&
+		out_format == pixel_format() &&
+		!in_desc->log2_chroma_w && !in_desc->log2_chroma_h &&
+		(video_range == out_video_range || (in_desc->flags & AV_PIX_FMT_FLAG_RGB));
 
-	/* Prepare input data pointers with crop */
-	uint8_t* scale_in_data[planes()];
-	for (int c = 0; c < planes(); ++c) {
-		int const x = lrintf(bytes_per_pixel(c) * corrected_crop.left);
-		scale_in_data[c] = data()[c] + x + stride()[c] * (corrected_crop.top / vertical_factor(c));
+	/* Scale context for a scale from cropped_size to inter_size */
+	SwsContext* context = nullptr;
+	if (!copy) {
+		context = scale_context ({
+			cropped_size, pixel_format(),
+			inter_size, out_format,
+			fast ? SWS_FAST_BILINEAR : SWS_BICUBIC,
+			yuv_to_rgb,
+			video_range == VideoRange::VIDEO ? 0 : 1,
+			out_video_range == VideoRange::VIDEO ? 0 : 1,
+			threads
+			});
 	}
 
 	auto out_desc = av_pix_fmt_desc_get (out_format);
@@ -284,36 +516,126 @@ Image::crop_scale_window (
 		scale_out_data[c] = out->data()[c] + x + out->stride()[c] * (corner.y / out->vertical_factor(c));
 	}
 
-	sws_scale (
-		scale_context,
-		scale_in_data, stride(),
-		0, cropped_size.height,
-		scale_out_data, out->stride()
-		);
-
-	sws_freeContext (scale_context);
-
-	/* There are some cases where there will be unwanted image data left in the image at this point:
-	 *
-	 * 1. When we are cropping without any scaling or pixel format conversion.
-	 * 2. When we are scaling to certain sizes and placing the result into a larger
-	 *    black frame.
-	 *
-	 * Clear out the sides of the image to take care of those cases.
-	 */
 	auto const pad = (out_size.width - inter_size.width) / 2;
-	out->make_part_black(0, pad);
-	out->make_part_black(corner.x + inter_size.width, pad);
-
-	if (
+	bool const convert_range =
 		video_range == VideoRange::VIDEO &&
 		out_video_range == VideoRange::FULL &&
-		av_pix_fmt_desc_get(_pixel_format)->flags & AV_PIX_FMT_FLAG_RGB
-	   ) {
-		/* libswscale will not convert video range for RGB sources, so we have to do it ourselves */
-		out->video_range_to_full_range ();
+		av_pix_fmt_desc_get(_pixel_format)->flags & AV_PIX_FMT_FLAG_RGB;
+
+	/* Number of rows of out which have been finished */
+	int finished = 0;
+	/* Finish off rows of out up to (but not including) `ready'; we only finish rows in whole
+	 * multiples of any vertical subsampling, except at the end.
+	 */
+	auto finish = [&](int ready, bool last) {
+		if (!last) {
+			ready = round_height_for_subsampling(ready, out_desc);
+		}
+		if (ready <= finished) {
+			return;
+		}
+
+		int const rows = ready - finished;
+
+		/* There are some cases where there will be unwanted image data left in the image at this point:
+		 *
+		 * 1. When we are cropping without any scaling or pixel format conversion.
+		 * 2. When we are scaling to certain sizes and placing the result into a larger
+		 *    black frame.
+		 *
+		 * Clear out the sides of the image to take care of those cases.
+		 */
+		out->make_part_black(0, pad, finished, rows);
+		out->make_part_black(corner.x + inter_size.width, pad, finished, rows);
+
+		if (convert_range) {
+			/* libswscale will not convert video range for RGB sources, so we have to do it ourselves */
+			out->video_range_to_full_range(finished, rows);
+		}
+
+		if (process_rows) {
+			process_rows(*out, finished, rows);
+		}
+
+		finished = ready;
+	};
+
+	/* Rows above the scaled image */
+	finish (corner.y, false);
+
+	uint8_t* scale_in_data[planes()];
+	auto set_scale_in_data = [&](int y) {
+		/* Input data pointers for rows from y, with crop */
+		for (int c = 0; c < planes(); ++c) {
+			int const x = lrintf(bytes_per_pixel(c) * corrected_crop.left);
+			scale_in_data[c] = data()[c] + x + stride()[c] * ((corrected_crop.top + y) / vertical_factor(c));
+		}
+	};
+
+	/* Number of input rows to scale or copy at a time when we are doing it ourselves */
+	int const slice_height = 16;
+
+	if (copy) {
+		for (int y = 0; y < cropped_size.height; y += slice_height) {
+			int const rows = min(slice_height, cropped_size.height - y);
+			set_scale_in_data (y);
+			for (int c = 0; c < planes(); ++c) {
+				auto const bytes = lrintf(bytes_per_pixel(c) * cropped_size.width);
+				for (int row = 0; row < rows; ++row) {
+					memcpy (scale_out_data[c] + (y + row) * out->stride()[c], scale_in_data[c] + row * stride()[c], bytes);
+				}
+			}
+			finish (corner.y + y + rows, false);
+		}
+	} else
+#ifdef DCPOMATIC_HAVE_SWS_THREADS
+	if (threads > 1) {
+		/* Give all the input to the scaler and then ask for bands of output which are each
+		 * scaled by all its threads.
+		 */
+		set_scale_in_data (0);
+		auto in_frame = wrap_in_frame (scale_in_data, stride(), planes(), cropped_size, pixel_format());
+		auto out_frame = wrap_in_frame (scale_out_data, out->stride(), out->planes(), inter_size, out_format);
+		if (sws_frame_start(context, out_frame, in_frame) < 0 || sws_send_slice(context, 0, cropped_size.height) < 0) {
+			av_frame_free (&in_frame);
+			av_frame_free (&out_frame);
+			throw runtime_error (N_("Could not start scaling"));
+		}
+
+		int const alignment = sws_receive_slice_alignment(context);
+		int const band_height = ((64 * threads + alignment - 1) / alignment) * alignment;
+		for (int y = 0; y < inter_size.height; y += band_height) {
+			int const height = min(band_height, inter_size.height - y);
+			sws_receive_slice (context, y, height);
+			finish (corner.y + y + height, false);
+		}
+
+		sws_frame_end (context);
+		av_frame_free (&in_frame);
+		av_frame_free (&out_frame);
+	} else
+#endif
+	{
+		/* Scale in slices and finish off each part of the output as it appears, so that the
+		 * rows we are working on are still in cache the next time we touch them.
+		 */
+		int scaled = 0;
+		for (int y = 0; y < cropped_size.height; y += slice_height) {
+			set_scale_in_data (y);
+			scaled += sws_scale (
+				context,
+				scale_in_data, stride(),
+				y, min(slice_height, cropped_size.height - y),
+				scale_out_data, out->stride()
+				);
+
+			finish (corner.y + scaled, false);
+		}
 	}
 
+	/* Anything left, including rows below the scaled image */
+	finish (out_size.height, true);
+
 	return out;
 }
 
@@ -341,45 +663,26 @@ Image::scale (dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_fo
 	DCPOMATIC_ASSERT (alignment() == Alignment::PADDED);
 
 	auto scaled = make_shared<Image>(out_format, out_size, out_alignment);
-	auto scale_context = sws_getContext (
-		size().width, size().height, pixel_format(),
-		out_size.width, out_size.height, out_format,
-		(fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND, 0, 0, 0
-		);
-
-	DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUVToRGB::COUNT);
-	EnumIndexedVector<int, dcp::YUVToRGB> lut;
-	lut[dcp::YUVToRGB::REC601] = SWS_CS_ITU601;
-	lut[dcp::YUVToRGB::REC709] = SWS_CS_ITU709;
-	lut[dcp::YUVToRGB::REC2020] = SWS_CS_BT2020;
-
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores these
-	   parameters unless the corresponding image isYUV or isGray.
-	   (If it's neither, it uses video range).
+	/* Both ranges are given as video (0) here; remember that sws_setColorspaceDetails
+	   ignores them unless the corresponding image isYUV or isGray.
 	*/
-	sws_setColorspaceDetails (
-		scale_context,
-		sws_getCoefficients(lut[yuv_to_rgb]), 0,
-		sws_getCoefficients(lut[yuv_to_rgb]), 0,
-		0, 1 << 16, 1 << 16
-		);
+	auto context = scale_context ({
+		size(), pixel_format(),
+		out_size, out_format,
+		(fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND,
+		yuv_to_rgb,
+		0,
+		0,
+		1
+		});
 
 	sws_scale (
-		scale_context,
+		context,
 		data(), stride(),
 		0, size().height,
 		scaled->data(), scaled->stride()
 		);
 
-	sws_freeContext (scale_context);
-
 	return scaled;
 }
 
@@ -390,15 +693,10 @@ Image::yuv_16_black (uint16_t v, bool alpha)
 {
 	memset (data()[0], 0, sample_size(0).height * stride()[0]);
 	for (int i = 1; i < 3; ++i) {
-		auto p = reinterpret_cast<int16_t*> (data()[i]);
-		int const lines = sample_size(i).height;
-		for (int y = 0; y < lines; ++y) {
-			/* We divide by 2 here because we are writing 2 bytes at a time */
-			for (int x = 0; x < line_size()[i] / 2; ++x) {
-				p[x] = v;
-			}
-			p += stride()[i] / 2;
-		}
+		/* Fill the whole plane, padding and all, so that it's one straight run.
+		 * We divide by 2 here because we are writing 2 bytes at a time.
+		 */
+		std::fill_n (reinterpret_cast<uint16_t*>(data()[i]), sample_size(i).height * stride()[i] / 2, v);
 	}
 
 	if (alpha) {
@@ -416,12 +714,26 @@ Image::swap_16 (uint16_t v)
 
 void
 Image::make_part_black (int const start, int const width)
+{
+	make_part_black (start, width, 0, size().height);
+}
+
+
+/** Make part of some rows of the image black.
+ *  @param start First column to blacken.
+ *  @param width Number of columns to blacken.
+ *  @param first_row First row to blacken.
+ *  @param rows Number of rows to blacken.
+ */
+void
+Image::make_part_black (int const start, int const width, int first_row, int rows)
 {
 	auto y_part = [&]() {
 		int const bpp = bytes_per_pixel(0);
-		int const h = sample_size(0).height;
+		auto const r = plane_rows(0, first_row, rows);
+		int const h = r.second;
 		int const s = stride()[0];
-		auto p = data()[0];
+		auto p = data()[0] + r.first * s;
 		for (int y = 0; y < h; ++y) {
 			memset (p + start * bpp, 0, width * bpp);
 			p += s;
@@ -439,10 +751,11 @@ Image::make_part_black (int const start, int const width)
 	case AV_PIX_FMT_RGB48BE:
 	case AV_PIX_FMT_XYZ12LE:
 	{
-		int const h = sample_size(0).height;
+		auto const r = plane_rows(0, first_row, rows);
+		int const h = r.second;
 		int const bpp = bytes_per_pixel(0);
 		int const s = stride()[0];
-		uint8_t* p = data()[0];
+		uint8_t* p = data()[0] + r.first * s;
 		for (int y = 0; y < h; y++) {
 			memset (p + start * bpp, 0, width * bpp);
 			p += s;
@@ -453,12 +766,11 @@ Image::make_part_black (int const start, int const width)
 	{
 		y_part ();
 		for (int i = 1; i < 3; ++i) {
-			auto p = data()[i];
-			int const h = sample_size(i).height;
+			auto const r = plane_rows(i, first_row, rows);
+			auto p = data()[i] + r.first * stride()[i];
+			int const h = r.second;
 			for (int y = 0; y < h; ++y) {
-				for (int x = start / 2; x < (start + width) / 2; ++x) {
-					p[x] = eight_bit_uv;
-				}
+				memset (p + start / 2, eight_bit_uv, (start + width) / 2 - start / 2);
 				p += stride()[i];
 			}
 		}
@@ -468,12 +780,11 @@ Image::make_part_black (int const start, int const width)
 	{
 		y_part ();
 		for (int i = 1; i < 3; ++i) {
-			auto p = reinterpret_cast<int16_t*>(data()[i]);
-			int const h = sample_size(i).height;
+			auto const r = plane_rows(i, first_row, rows);
+			auto p = reinterpret_cast<int16_t*>(data()[i] + r.first * stride()[i]);
+			int const h = r.second;
 			for (int y = 0; y < h; ++y) {
-				for (int x = start / 2; x < (start + width) / 2; ++x) {
-					p[x] = ten_bit_uv;
-				}
+				std::fill (p + start / 2, p + (start + width) / 2, ten_bit_uv);
 				p += stride()[i] / 2;
 			}
 		}
@@ -483,12 +794,11 @@ Image::make_part_black (int const start, int const width)
 	{
 		y_part();
 		for (int i = 1; i < 3; ++i) {
-			auto p = reinterpret_cast<int16_t*>(data()[i]);
-			int const h = sample_size(i).height;
+			auto const r = plane_rows(i, first_row, rows);
+			auto p = reinterpret_cast<int16_t*>(data()[i] + r.first * stride()[i]);
+			int const h = r.second;
 			for (int y = 0; y < h; ++y) {
-				for (int x = start; x < (start + width); ++x) {
-					p[x] = ten_bit_uv;
-				}
+				std::fill (p + start, p + start + width, ten_bit_uv);
 				p += stride()[i] / 2;
 			}
 		}
@@ -627,16 +937,178 @@ Image::make_transparent ()
 }
 
 
+/** @param p RGBA or BGRA pixels.
+ *  @param n Number of pixels to look at.
+ *  @return Number of pixels, starting at p, which are completely transparent.
+ */
+static
+int
+transparent_span (uint8_t const* p, int n)
+{
+	/* Mask to pick out the alpha bytes of two pixels */
+	static uint8_t const alpha_bytes[8] = { 0, 0, 0, 0xff, 0, 0, 0, 0xff };
+	uint64_t alpha_mask;
+	memcpy (&alpha_mask, alpha_bytes, 8);
+
+	int i = 0;
+	for (; i + 2 <= n; i += 2) {
+		uint64_t v;
+		memcpy (&v, p + i * 4, 8);
+		if (v & alpha_mask) {
+			break;
+		}
+	}
+
+	while (i < n && p[i * 4 + 3] == 0) {
+		++i;
+	}
+
+	return i;
+}
+
+
+/** Call `blend' for each pixel in a row of an RGBA or BGRA image which is not completely
+ *  transparent.  Subtitle images are mostly transparent so this saves a lot of work.
+ *  @param p First pixel of the row.
+ *  @param width Number of pixels in the row.
+ *  @param blend Function taking the index of a pixel within the row and a pointer to it.
+ */
+template <class F>
+static
+void
+for_each_visible_pixel (uint8_t const* p, int width, F blend)
+{
+	int x = 0;
+	while (x < width) {
+		x += transparent_span (p + x * 4, width - x);
+		if (x < width) {
+			blend (x, p + x * 4);
+			++x;
+		}
+	}
+}
+
+
+/** The colours of an RGBA or BGRA image converted to XYZ and multiplied by their alpha, each followed by 1 - alpha,
+ *  so that the same subtitle can be blended onto many XYZ frames without converting it each time.
+ */
+class XYZSprite
+{
+public:
+	explicit XYZSprite (shared_ptr<const Image> image)
+		: _image (image)
+		, _width (image->size().width)
+	{
+		int const blue = image->pixel_format() == AV_PIX_FMT_BGRA ? 0 : 2;
+		int const red = image->pixel_format() == AV_PIX_FMT_BGRA ? 2 : 0;
+
+		auto conv = dcp::ColourConversion::srgb_to_xyz();
+		double fast_matrix[9];
+		dcp::combined_rgb_to_xyz (conv, fast_matrix);
+		auto lut_in = conv.in()->lut(0, 1, 8, false);
+		auto lut_out = conv.out()->lut(0, 1, 16, true);
+
+		/* Transparent pixels are never blended, so we need not convert them */
+		_values.resize (_width * image->size().height * 4);
+		for (int y = 0; y < image->size().height; ++y) {
+			for_each_visible_pixel (image->data()[0] + y * image->stride()[0], _width, [&](int x, uint8_t const* o) {
+				float const alpha = float (o[3]) / 255;
+
+				/* Convert sRGB to XYZ.  First, input gamma LUT */
+				double const r = lut_in[o[red]];
+				double const g = lut_in[o[1]];
+				double const b = lut_in[o[blue]];
+
+				/* RGB to XYZ, including Bradford transform and DCI companding */
+				double const cx = max(0.0, min(1.0, r * fast_matrix[0] + g * fast_matrix[1] + b * fast_matrix[2]));
+				double const cy = max(0.0, min(1.0, r * fast_matrix[3] + g * fast_matrix[4] + b * fast_matrix[5]));
+				double const cz = max(0.0, min(1.0, r * fast_matrix[6] + g * fast_matrix[7] + b * fast_matrix[8]));
+
+				/* Out gamma LUT */
+				auto out = _values.data() + (y * _width + x) * 4;
+				out[0] = lrint(lut_out[lrint(cx * 65535)] * 65535) * alpha;
+				out[1] = lrint(lut_out[lrint(cy * 65535)] * 65535) * alpha;
+				out[2] = lrint(lut_out[lrint(cz * 65535)] * 65535) * alpha;
+				out[3] = 1 - alpha;
+			});
+		}
+	}
+
+	bool is_for (shared_ptr<const Image> image) const {
+		auto locked = _image.lock();
+		return locked && locked == image;
+	}
+
+	bool expired () const {
+		return _image.expired();
+	}
+
+	/** @return values for pixel (x, y) of the image */
+	float const* at (int x, int y) const {
+		return _values.data() + (y * _width + x) * 4;
+	}
+
+private:
+	std::weak_ptr<const Image> _image;
+	int _width;
+	vector<float> _values;
+};
+
+
+/** @return an XYZSprite for `image', which may have been made by a previous call on this thread */
+static
+shared_ptr<const XYZSprite>
+xyz_sprite (shared_ptr<const Image> image)
+{
+	/* Most recently used first */
+	thread_local list<shared_ptr<const XYZSprite>> sprites;
+	int const max_sprites = 2;
+
+	/* Don't hang on to sprites of images that have gone */
+	sprites.remove_if ([](shared_ptr<const XYZSprite> const& sprite) {
+		return sprite->expired();
+	});
+
+	for (auto i = sprites.begin(); i != sprites.end(); ++i) {
+		if ((*i)->is_for(image)) {
+			sprites.splice (sprites.begin(), sprites, i);
+			return *i;
+		}
+	}
+
+	sprites.push_front (make_shared<XYZSprite>(image));
+	if (static_cast<int>(sprites.size()) > max_sprites) {
+		sprites.pop_back ();
+	}
+
+	return sprites.front();
+}
+
+
 void
 Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
+{
+	alpha_blend (other, position, 0, size().height);
+}
+
+
+/** Blend another image onto some rows of this one.
+ *  @param other Image to blend, which must be RGBA or BGRA.
+ *  @param position Position of the top-left of other within this image.
+ *  @param first_row First row of this image to blend onto.
+ *  @param rows Number of rows of this image to blend onto.
+ *
+ *  When blending onto XYZ, what `other' looks like in XYZ is kept so that it can be used again
+ *  if `other' is blended onto another image, so it must not be changed after it is used here.
+ */
+void
+Image::alpha_blend (shared_ptr<const Image> other, Position<int> position, int first_row, int rows)
 {
 	/* We're blending RGBA or BGRA images */
 	DCPOMATIC_ASSERT (other->pixel_format() == AV_PIX_FMT_BGRA || other->pixel_format() == AV_PIX_FMT_RGBA);
 	int const blue = other->pixel_format() == AV_PIX_FMT_BGRA ? 0 : 2;
 	int const red = other->pixel_format() == AV_PIX_FMT_BGRA ? 2 : 0;
 
-	int const other_bpp = 4;
-
 	int start_tx = position.x;
 	int start_ox = 0;
 
@@ -653,218 +1125,176 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 		start_ty = 0;
 	}
 
+	if (start_ty < first_row) {
+		start_oy += first_row - start_ty;
+		start_ty = first_row;
+	}
+
+	/* Row after the last one that we will blend onto */
+	int const end_ty = min(size().height, first_row + rows);
+	if (start_ty >= end_ty || start_oy >= other->size().height) {
+		return;
+	}
+
+	/* Number of pixels in each row that we will blend */
+	int const width = min(size().width - start_tx, other->size().width - start_ox);
+
 	switch (_pixel_format) {
 	case AV_PIX_FMT_RGB24:
 	{
 		/* Going onto RGB24.  First byte is red, second green, third blue */
 		int const this_bpp = 3;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[red] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[blue] * alpha + tp[2] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+			uint8_t const* op = other->data()[0] + oy * other->stride()[0];
+			for_each_visible_pixel (op, width, [=](int x, uint8_t const* o) {
+				auto t = tp + x * this_bpp;
+				float const alpha = float (o[3]) / 255;
+				t[0] = o[red] * alpha + t[0] * (1 - alpha);
+				t[1] = o[1] * alpha + t[1] * (1 - alpha);
+				t[2] = o[blue] * alpha + t[2] * (1 - alpha);
+			});
 		}
 		break;
 	}
 	case AV_PIX_FMT_BGRA:
 	{
 		int const this_bpp = 4;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[blue] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[red] * alpha + tp[2] * (1 - alpha);
-				tp[3] = op[3] * alpha + tp[3] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+			uint8_t const* op = other->data()[0] + oy * other->stride()[0];
+			for_each_visible_pixel (op, width, [=](int x, uint8_t const* o) {
+				auto t = tp + x * this_bpp;
+				float const alpha = float (o[3]) / 255;
+				t[0] = o[blue] * alpha + t[0] * (1 - alpha);
+				t[1] = o[1] * alpha + t[1] * (1 - alpha);
+				t[2] = o[red] * alpha + t[2] * (1 - alpha);
+				t[3] = o[3] * alpha + t[3] * (1 - alpha);
+			});
 		}
 		break;
 	}
 	case AV_PIX_FMT_RGBA:
 	{
 		int const this_bpp = 4;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[red] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[blue] * alpha + tp[2] * (1 - alpha);
-				tp[3] = op[3] * alpha + tp[3] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+			uint8_t const* op = other->data()[0] + oy * other->stride()[0];
+			for_each_visible_pixel (op, width, [=](int x, uint8_t const* o) {
+				auto t = tp + x * this_bpp;
+				float const alpha = float (o[3]) / 255;
+				t[0] = o[red] * alpha + t[0] * (1 - alpha);
+				t[1] = o[1] * alpha + t[1] * (1 - alpha);
+				t[2] = o[blue] * alpha + t[2] * (1 - alpha);
+				t[3] = o[3] * alpha + t[3] * (1 - alpha);
+			});
 		}
 		break;
 	}
 	case AV_PIX_FMT_RGB48LE:
 	{
 		int const this_bpp = 6;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < other->size().height; ++ty, ++oy) {
 			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
+			uint8_t const* op = other->data()[0] + oy * other->stride()[0];
+			for_each_visible_pixel (op, width, [=](int x, uint8_t const* o) {
+				auto t = tp + x * this_bpp;
+				float const alpha = float (o[3]) / 255;
 				/* Blend high bytes */
-				tp[1] = op[red] * alpha + tp[1] * (1 - alpha);
-				tp[3] = op[1] * alpha + tp[3] * (1 - alpha);
-				tp[5] = op[blue] * alpha + tp[5] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
+				t[1] = o[red] * alpha + t[1] * (1 - alpha);
+				t[3] = o[1] * alpha + t[3] * (1 - alpha);
+				t[5] = o[blue] * alpha + t[5] * (1 - alpha);
+			});
 		}
 		break;
 	}
 	case AV_PIX_FMT_XYZ12LE:
 	{
-		auto conv = dcp::ColourConversion::srgb_to_xyz();
-		double fast_matrix[9];
-		dcp::combined_rgb_to_xyz (conv, fast_matrix);
-		auto lut_in = conv.in()->lut(0, 1, 8, false);
-		auto lut_out = conv.out()->lut(0, 1, 16, true);
+		auto sprite = xyz_sprite (other);
 		int const this_bpp = 6;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < other->size().height; ++ty, ++oy) {
 			uint16_t* tp = reinterpret_cast<uint16_t*> (data()[0] + ty * stride()[0] + start_tx * this_bpp);
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-
-				/* Convert sRGB to XYZ; op is BGRA.  First, input gamma LUT */
-				double const r = lut_in[op[red]];
-				double const g = lut_in[op[1]];
-				double const b = lut_in[op[blue]];
-
-				/* RGB to XYZ, including Bradford transform and DCI companding */
-				double const x = max(0.0, min(1.0, r * fast_matrix[0] + g * fast_matrix[1] + b * fast_matrix[2]));
-				double const y = max(0.0, min(1.0, r * fast_matrix[3] + g * fast_matrix[4] + b * fast_matrix[5]));
-				double const z = max(0.0, min(1.0, r * fast_matrix[6] + g * fast_matrix[7] + b * fast_matrix[8]));
-
-				/* Out gamma LUT and blend */
-				tp[0] = lrint(lut_out[lrint(x * 65535)] * 65535) * alpha + tp[0] * (1 - alpha);
-				tp[1] = lrint(lut_out[lrint(y * 65535)] * 65535) * alpha + tp[1] * (1 - alpha);
-				tp[2] = lrint(lut_out[lrint(z * 65535)] * 65535) * alpha + tp[2] * (1 - alpha);
-
-				tp += this_bpp / 2;
-				op += other_bpp;
-			}
+			uint8_t const* op = other->data()[0] + oy * other->stride()[0];
+			for_each_visible_pixel (op, width, [&](int i, uint8_t const*) {
+				auto t = tp + i * this_bpp / 2;
+				auto o = sprite->at(i, oy);
+				t[0] = o[0] + t[0] * o[3];
+				t[1] = o[1] + t[1] * o[3];
+				t[2] = o[2] + t[2] * o[3];
+			});
 		}
 		break;
 	}
 	case AV_PIX_FMT_YUV420P:
 	{
 		auto yuv = other->convert_pixel_format (dcp::YUVToRGB::REC709, _pixel_format, Alignment::COMPACT, false);
-		dcp::Size const ts = size();
 		dcp::Size const os = yuv->size();
-		for (int ty = start_ty, oy = start_oy; ty < ts.height && oy < os.height; ++ty, ++oy) {
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < os.height; ++ty, ++oy) {
 			int const hty = ty / 2;
 			int const hoy = oy / 2;
-			uint8_t* tY = data()[0] + (ty * stride()[0]) + start_tx;
-			uint8_t* tU = data()[1] + (hty * stride()[1]) + start_tx / 2;
-			uint8_t* tV = data()[2] + (hty * stride()[2]) + start_tx / 2;
-			uint8_t* oY = yuv->data()[0] + (oy * yuv->stride()[0]) + start_ox;
-			uint8_t* oU = yuv->data()[1] + (hoy * yuv->stride()[1]) + start_ox / 2;
-			uint8_t* oV = yuv->data()[2] + (hoy * yuv->stride()[2]) + start_ox / 2;
-			uint8_t* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
-			for (int tx = start_tx, ox = start_ox; tx < ts.width && ox < os.width; ++tx, ++ox) {
-				float const a = float(alpha[3]) / 255;
-				*tY = *oY * a + *tY * (1 - a);
-				*tU = *oU * a + *tU * (1 - a);
-				*tV = *oV * a + *tV * (1 - a);
-				++tY;
-				++oY;
-				if (tx % 2) {
-					++tU;
-					++tV;
-				}
-				if (ox % 2) {
-					++oU;
-					++oV;
-				}
-				alpha += 4;
-			}
+			uint8_t* tY = data()[0] + (ty * stride()[0]);
+			uint8_t* tU = data()[1] + (hty * stride()[1]);
+			uint8_t* tV = data()[2] + (hty * stride()[2]);
+			uint8_t const* oY = yuv->data()[0] + (oy * yuv->stride()[0]);
+			uint8_t const* oU = yuv->data()[1] + (hoy * yuv->stride()[1]);
+			uint8_t const* oV = yuv->data()[2] + (hoy * yuv->stride()[2]);
+			uint8_t const* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
+			for_each_visible_pixel (alpha, width, [=](int x, uint8_t const* o) {
+				int const tx = start_tx + x;
+				int const ox = start_ox + x;
+				float const a = float(o[3]) / 255;
+				tY[tx] = oY[ox] * a + tY[tx] * (1 - a);
+				tU[tx / 2] = oU[ox / 2] * a + tU[tx / 2] * (1 - a);
+				tV[tx / 2] = oV[ox / 2] * a + tV[tx / 2] * (1 - a);
+			});
 		}
 		break;
 	}
 	case AV_PIX_FMT_YUV420P10:
 	{
 		auto yuv = other->convert_pixel_format (dcp::YUVToRGB::REC709, _pixel_format, Alignment::COMPACT, false);
-		dcp::Size const ts = size();
 		dcp::Size const os = yuv->size();
-		for (int ty = start_ty, oy = start_oy; ty < ts.height && oy < os.height; ++ty, ++oy) {
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < os.height; ++ty, ++oy) {
 			int const hty = ty / 2;
 			int const hoy = oy / 2;
-			uint16_t* tY = ((uint16_t *) (data()[0] + (ty * stride()[0]))) + start_tx;
-			uint16_t* tU = ((uint16_t *) (data()[1] + (hty * stride()[1]))) + start_tx / 2;
-			uint16_t* tV = ((uint16_t *) (data()[2] + (hty * stride()[2]))) + start_tx / 2;
-			uint16_t* oY = ((uint16_t *) (yuv->data()[0] + (oy * yuv->stride()[0]))) + start_ox;
-			uint16_t* oU = ((uint16_t *) (yuv->data()[1] + (hoy * yuv->stride()[1]))) + start_ox / 2;
-			uint16_t* oV = ((uint16_t *) (yuv->data()[2] + (hoy * yuv->stride()[2]))) + start_ox / 2;
-			uint8_t* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
-			for (int tx = start_tx, ox = start_ox; tx < ts.width && ox < os.width; ++tx, ++ox) {
-				float const a = float(alpha[3]) / 255;
-				*tY = *oY * a + *tY * (1 - a);
-				*tU = *oU * a + *tU * (1 - a);
-				*tV = *oV * a + *tV * (1 - a);
-				++tY;
-				++oY;
-				if (tx % 2) {
-					++tU;
-					++tV;
-				}
-				if (ox % 2) {
-					++oU;
-					++oV;
-				}
-				alpha += 4;
-			}
+			uint16_t* tY = (uint16_t *) (data()[0] + (ty * stride()[0]));
+			uint16_t* tU = (uint16_t *) (data()[1] + (hty * stride()[1]));
+			uint16_t* tV = (uint16_t *) (data()[2] + (hty * stride()[2]));
+			uint16_t const* oY = (uint16_t const *) (yuv->data()[0] + (oy * yuv->stride()[0]));
+			uint16_t const* oU = (uint16_t const *) (yuv->data()[1] + (hoy * yuv->stride()[1]));
+			uint16_t const* oV = (uint16_t const *) (yuv->data()[2] + (hoy * yuv->stride()[2]));
+			uint8_t const* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
+			for_each_visible_pixel (alpha, width, [=](int x, uint8_t const* o) {
+				int const tx = start_tx + x;
+				int const ox = start_ox + x;
+				float const a = float(o[3]) / 255;
+				tY[tx] = oY[ox] * a + tY[tx] * (1 - a);
+				tU[tx / 2] = oU[ox / 2] * a + tU[tx / 2] * (1 - a);
+				tV[tx / 2] = oV[ox / 2] * a + tV[tx / 2] * (1 - a);
+			});
 		}
 		break;
 	}
 	case AV_PIX_FMT_YUV422P10LE:
 	{
 		auto yuv = other->convert_pixel_format (dcp::YUVToRGB::REC709, _pixel_format, Alignment::COMPACT, false);
-		dcp::Size const ts = size();
 		dcp::Size const os = yuv->size();
-		for (int ty = start_ty, oy = start_oy; ty < ts.height && oy < os.height; ++ty, ++oy) {
-			uint16_t* tY = ((uint16_t *) (data()[0] + (ty * stride()[0]))) + start_tx;
-			uint16_t* tU = ((uint16_t *) (data()[1] + (ty * stride()[1]))) + start_tx / 2;
-			uint16_t* tV = ((uint16_t *) (data()[2] + (ty * stride()[2]))) + start_tx / 2;
-			uint16_t* oY = ((uint16_t *) (yuv->data()[0] + (oy * yuv->stride()[0]))) + start_ox;
-			uint16_t* oU = ((uint16_t *) (yuv->data()[1] + (oy * yuv->stride()[1]))) + start_ox / 2;
-			uint16_t* oV = ((uint16_t *) (yuv->data()[2] + (oy * yuv->stride()[2]))) + start_ox / 2;
-			uint8_t* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
-			for (int tx = start_tx, ox = start_ox; tx < ts.width && ox < os.width; ++tx, ++ox) {
-				float const a = float(alpha[3]) / 255;
-				*tY = *oY * a + *tY * (1 - a);
-				*tU = *oU * a + *tU * (1 - a);
-				*tV = *oV * a + *tV * (1 - a);
-				++tY;
-				++oY;
-				if (tx % 2) {
-					++tU;
-					++tV;
-				}
-				if (ox % 2) {
-					++oU;
-					++oV;
-				}
-				alpha += 4;
-			}
+		for (int ty = start_ty, oy = start_oy; ty < end_ty && oy < os.height; ++ty, ++oy) {
+			uint16_t* tY = (uint16_t *) (data()[0] + (ty * stride()[0]));
+			uint16_t* tU = (uint16_t *) (data()[1] + (ty * stride()[1]));
+			uint16_t* tV = (uint16_t *) (data()[2] + (ty * stride()[2]));
+			uint16_t const* oY = (uint16_t const *) (yuv->data()[0] + (oy * yuv->stride()[0]));
+			uint16_t const* oU = (uint16_t const *) (yuv->data()[1] + (oy * yuv->stride()[1]));
+			uint16_t const* oV = (uint16_t const *) (yuv->data()[2] + (oy * yuv->stride()[2]));
+			uint8_t const* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
+			for_each_visible_pixel (alpha, width, [=](int x, uint8_t const* o) {
+				int const tx = start_tx + x;
+				int const ox = start_ox + x;
+				float const a = float(o[3]) / 255;
+				tY[tx] = oY[ox] * a + tY[tx] * (1 - a);
+				tU[tx / 2] = oU[ox / 2] * a + tU[tx / 2] * (1 - a);
+				tV[tx / 2] = oV[ox / 2] * a + tV[tx / 2] * (1 - a);
+			});
 		}
 		break;
 	}
@@ -890,28 +1320,59 @@ Image::copy (shared_ptr<const Image> other, Position<int> position)
 }
 
 
-void
-Image::read_from_socket (shared_ptr<Socket> socket)
+/** @return Buffers covering our image data without any alignment padding; a plane with no
+ *  padding is given as one buffer rather than one for each line.
+ */
+template <class Buffer>
+static
+vector<Buffer>
+image_buffers (Image const& image)
 {
-	for (int i = 0; i < planes(); ++i) {
-		uint8_t* p = data()[i];
-		int const lines = sample_size(i).height;
-		for (int y = 0; y < lines; ++y) {
-			socket->read (p, line_size()[i]);
-			p += stride()[i];
+	vector<Buffer> buffers;
+	for (int i = 0; i < image.planes(); ++i) {
+		uint8_t* p = image.data()[i];
+		int const lines = image.sample_size(i).height;
+		int const line_size = image.line_size()[i];
+		if (image.stride()[i] == line_size) {
+			buffers.push_back (boost::asio::buffer(p, line_size * lines));
+		} else {
+			for (int y = 0; y < lines; ++y) {
+				buffers.push_back (boost::asio::buffer(p, line_size));
+				p += image.stride()[i];
+			}
 		}
 	}
+	return buffers;
+}
+
+
+void
+Image::read_from_socket (shared_ptr<Socket> socket)
+{
+	socket->read (image_buffers<boost::asio::mutable_buffer>(*this));
 }
 
 
 void
 Image::write_to_socket (shared_ptr<Socket> socket) const
 {
+	socket->write (image_buffers<boost::asio::const_buffer>(*this));
+}
+
+
+/** Add our size, pixel format and image data (but not any alignment padding) to a digest */
+void
+Image::add_digest (Digester& digester) const
+{
+	digester.add (_size.width);
+	digester.add (_size.height);
+	digester.add (static_cast<int>(_pixel_format));
+
 	for (int i = 0; i < planes(); ++i) {
 		uint8_t* p = data()[i];
 		int const lines = sample_size(i).height;
 		for (int y = 0; y < lines; ++y) {
-			socket->write (p, line_size()[i]);
+			digester.add (p, line_size()[i]);
 			p += stride()[i];
 		}
 	}
@@ -961,7 +1422,14 @@ Image::bytes_per_pixel (int c) const
 		return bpp[0] + bpp[1] + bpp[2] + bpp[3];
 	}
 
-	return bpp[c];
+	/* Sum up the components in this plane, as there may be more than one in a semi-planar format */
+	float total = 0;
+	for (int i = 0; i < d->nb_components; ++i) {
+		if (d->comp[i].plane == c) {
+			total += bpp[i];
+		}
+	}
+	return total;
 }
 
 
@@ -984,13 +1452,8 @@ Image::Image (AVPixelFormat p, dcp::Size s, Alignment alignment)
 void
 Image::allocate ()
 {
-	_data = (uint8_t **) wrapped_av_malloc (4 * sizeof (uint8_t *));
 	_data[0] = _data[1] = _data[2] = _data[3] = 0;
-
-	_line_size = (int *) wrapped_av_malloc (4 * sizeof (int));
 	_line_size[0] = _line_size[1] = _line_size[2] = _line_size[3] = 0;
-
-	_stride = (int *) wrapped_av_malloc (4 * sizeof (int));
 	_stride[0] = _stride[1] = _stride[2] = _stride[3] = 0;
 
 	auto stride_round_up = [](int stride, int t) {
@@ -1039,17 +1502,25 @@ Image::allocate ()
 		   |XXXwrittenXXX|<------line-size------------->|XXXwrittenXXXXXXwrittenXXX
 		                                                               ^^^^ out of bounds
 		*/
-		_data[i] = (uint8_t *) wrapped_av_malloc (_stride[i] * (sample_size(i).height + 1) + ALIGNMENT);
+		_data[i] = ImagePool::instance()->get(plane_allocation(i));
 #if HAVE_VALGRIND_MEMCHECK_H
 		/* The data between the end of the line size and the stride is undefined but processed by
 		   libswscale, causing lots of valgrind errors.  Mark it all defined to quell these errors.
 		*/
-		VALGRIND_MAKE_MEM_DEFINED (_data[i], _stride[i] * (sample_size(i).height + 1) + ALIGNMENT);
+		VALGRIND_MAKE_MEM_DEFINED (_data[i], plane_allocation(i));
 #endif
 	}
 }
 
 
+/** @return Number of bytes that we allocate for a plane, including the extra discussed in allocate() */
+size_t
+Image::plane_allocation (int plane) const
+{
+	return _stride[plane] * (sample_size(plane).height + 1) + ALIGNMENT;
+}
+
+
 Image::Image (Image const & other)
 	: std::enable_shared_from_this<Image>(other)
 	, _size (other._size)
@@ -1147,12 +1618,8 @@ Image::swap (Image & other)
 Image::~Image ()
 {
 	for (int i = 0; i < planes(); ++i) {
-		av_free (_data[i]);
+		ImagePool::instance()->put(_data[i], plane_allocation(i));
 	}
-
-	av_free (_data);
-	av_free (_line_size);
-	av_free (_stride);
 }
 
 
@@ -1218,6 +1685,69 @@ merge (list<PositionImage> images, Image::Alignment alignment)
 }
 
 
+/** Make a BGRA image from a palettised one, such as a DVB or PGS subtitle, cropping off
+ *  any fully-transparent border.
+ *  @param indices Palette index of each pixel.
+ *  @param stride Bytes between the starts of consecutive rows of indices.
+ *  @param size Size of the palettised image.
+ *  @param palette Colours that the indices refer to.
+ *  @return BGRA image and its position within the palettised one, or none if every pixel is transparent.
+ */
+optional<PositionImage>
+palette_image (uint8_t const* indices, int stride, dcp::Size size, vector<RGBA> const& palette)
+{
+	/* Each palette entry as it will be written, with the first byte B, second G, third R, fourth A */
+	vector<std::array<uint8_t, 4>> bgra(256, {{ 0, 0, 0, 0 }});
+	for (size_t i = 0; i < min(palette.size(), bgra.size()); ++i) {
+		bgra[i] = {{ palette[i].b, palette[i].g, palette[i].r, palette[i].a }};
+	}
+
+	auto visible = [&bgra](uint8_t index) {
+		return bgra[index][3] != 0;
+	};
+
+	/* Find the part of the image that has something in it */
+	int min_x = size.width;
+	int max_x = -1;
+	int min_y = size.height;
+	int max_y = -1;
+	for (int y = 0; y < size.height; ++y) {
+		auto line = indices + y * stride;
+		int x = 0;
+		while (x < size.width && !visible(line[x])) {
+			++x;
+		}
+		if (x == size.width) {
+			continue;
+		}
+		int last = size.width - 1;
+		while (!visible(line[last])) {
+			--last;
+		}
+		min_x = min(min_x, x);
+		max_x = max(max_x, last);
+		min_y = min(min_y, y);
+		max_y = y;
+	}
+
+	if (max_x < 0) {
+		return {};
+	}
+
+	auto image = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size(max_x - min_x + 1, max_y - min_y + 1), Image::Alignment::PADDED);
+	for (int y = 0; y < image->size().height; ++y) {
+		auto in = indices + (y + min_y) * stride + min_x;
+		auto out = image->data()[0] + y * image->stride()[0];
+		for (int x = 0; x < image->size().width; ++x) {
+			memcpy(out, bgra[*in++].data(), 4);
+			out += 4;
+		}
+	}
+
+	return PositionImage(image, Position<int>(min_x, min_y));
+}
+
+
 bool
 operator== (Image const & a, Image const & b)
 {
@@ -1247,121 +1777,212 @@ operator== (Image const & a, Image const & b)
 }
 
 
+/** Fade some samples towards a black value; each sample x becomes black + int((x - black) * f),
+ *  exactly as it would if we did it one sample at a time.
+ */
+static
+void
+fade_samples_scalar (uint8_t* p, int n, float f, int black)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] = black + int((int(p[i]) - black) * f);
+	}
+}
+
+
+/** 16-bit version of fade_samples_scalar() above */
+static
+void
+fade_samples_scalar (uint16_t* p, int n, float f, int black)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] = black + int((int(p[i]) - black) * f);
+	}
+}
+
+
+#if defined(__SSE2__)
+
+static
+void
+fade_samples_sse2 (uint8_t* p, int n, float f, int black)
+{
+	int i = 0;
+	auto const factor = _mm_set1_ps(f);
+	auto const offset = _mm_set1_epi32(black);
+	auto const zero = _mm_setzero_si128();
+	auto fade4 = [&](__m128i v) {
+		return _mm_add_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(v, offset)), factor)), offset);
+	};
+	for (; i + 16 <= n; i += 16) {
+		auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+		auto const lo = _mm_unpacklo_epi8(v, zero);
+		auto const hi = _mm_unpackhi_epi8(v, zero);
+		auto const lo16 = _mm_packs_epi32(fade4(_mm_unpacklo_epi16(lo, zero)), fade4(_mm_unpackhi_epi16(lo, zero)));
+		auto const hi16 = _mm_packs_epi32(fade4(_mm_unpacklo_epi16(hi, zero)), fade4(_mm_unpackhi_epi16(hi, zero)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_packus_epi16(lo16, hi16));
+	}
+	fade_samples_scalar (p + i, n - i, f, black);
+}
+
+
+static
+void
+fade_samples_sse2 (uint16_t* p, int n, float f, int black)
+{
+	int i = 0;
+	auto const factor = _mm_set1_ps(f);
+	auto const offset = _mm_set1_epi32(black);
+	auto const zero = _mm_setzero_si128();
+	/* SSE2 can only pack to signed 16-bit, so we move into that range to pack and then move back */
+	auto const bias_32 = _mm_set1_epi32(32768);
+	auto const bias_16 = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+	auto fade4 = [&](__m128i v) {
+		auto const faded = _mm_add_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(v, offset)), factor)), offset);
+		return _mm_sub_epi32(faded, bias_32);
+	};
+	for (; i + 8 <= n; i += 8) {
+		auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+		auto const packed = _mm_packs_epi32(fade4(_mm_unpacklo_epi16(v, zero)), fade4(_mm_unpackhi_epi16(v, zero)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_xor_si128(packed, bias_16));
+	}
+	fade_samples_scalar (p + i, n - i, f, black);
+}
+
+#elif defined(__ARM_NEON)
+
+static
+void
+fade_samples_neon (uint8_t* p, int n, float f, int black)
+{
+	int i = 0;
+	auto const factor = vdupq_n_f32(f);
+	auto const offset = vdupq_n_s32(black);
+	auto fade4 = [&](uint16x4_t v) {
+		auto const x = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(v)), offset);
+		return vqmovun_s32(vaddq_s32(vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(x), factor)), offset));
+	};
+	for (; i + 16 <= n; i += 16) {
+		auto const v = vld1q_u8(p + i);
+		auto const lo = vmovl_u8(vget_low_u8(v));
+		auto const hi = vmovl_u8(vget_high_u8(v));
+		auto const lo_faded = vcombine_u16(fade4(vget_low_u16(lo)), fade4(vget_high_u16(lo)));
+		auto const hi_faded = vcombine_u16(fade4(vget_low_u16(hi)), fade4(vget_high_u16(hi)));
+		vst1q_u8(p + i, vcombine_u8(vqmovn_u16(lo_faded), vqmovn_u16(hi_faded)));
+	}
+	fade_samples_scalar (p + i, n - i, f, black);
+}
+
+
+static
+void
+fade_samples_neon (uint16_t* p, int n, float f, int black)
+{
+	int i = 0;
+	auto const factor = vdupq_n_f32(f);
+	auto const offset = vdupq_n_s32(black);
+	auto fade4 = [&](uint16x4_t v) {
+		auto const x = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(v)), offset);
+		return vqmovun_s32(vaddq_s32(vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(x), factor)), offset));
+	};
+	for (; i + 8 <= n; i += 8) {
+		auto const v = vld1q_u16(p + i);
+		vst1q_u16(p + i, vcombine_u16(fade4(vget_low_u16(v)), fade4(vget_high_u16(v))));
+	}
+	fade_samples_scalar (p + i, n - i, f, black);
+}
+
+#endif
+
+
+template <class T>
+using FadeSamples = void (T*, int, float, int);
+
+
+template <class T>
+static vector<pair<ISA, FadeSamples<T>*>>
+fade_samples_implementations ()
+{
+	return {
+		{ ISA::SCALAR, &fade_samples_scalar },
+#if defined(__SSE2__)
+		{ ISA::SSE2, &fade_samples_sse2 },
+#elif defined(__ARM_NEON)
+		{ ISA::NEON, &fade_samples_neon },
+#endif
+	};
+}
+
+
+static Kernel<FadeSamples<uint8_t>> fade_samples_8 ("fade_samples_8", fade_samples_implementations<uint8_t>());
+static Kernel<FadeSamples<uint16_t>> fade_samples_16 ("fade_samples_16", fade_samples_implementations<uint16_t>());
+
+
 /** Fade the image.
  *  @param f Amount to fade by; 0 is black, 1 is no fade.
  */
 void
 Image::fade (float f)
+{
+	fade (f, 0, size().height);
+}
+
+
+/** Fade some rows of the image.
+ *  @param f Factor to multiply the image by.
+ *  @param first_row First row to fade.
+ *  @param rows Number of rows to fade.
+ */
+void
+Image::fade (float f, int first_row, int rows)
 {
 	/* U/V black value for 8-bit colour */
 	static int const eight_bit_uv =    (1 << 7) - 1;
 	/* U/V black value for 10-bit colour */
 	static uint16_t const ten_bit_uv = (1 << 9) - 1;
 
-	switch (_pixel_format) {
-	case AV_PIX_FMT_YUV420P:
-	{
-		/* Y */
-		uint8_t* p = data()[0];
-		int const lines = sample_size(0).height;
-		for (int y = 0; y < lines; ++y) {
-			uint8_t* q = p;
-			for (int x = 0; x < line_size()[0]; ++x) {
-				*q = int(float(*q) * f);
-				++q;
-			}
-			p += stride()[0];
+	/* Fade the rows of plane c, which has 8-bit samples, towards `black' */
+	auto fade_plane_8 = [&](int c, int black) {
+		auto const r = plane_rows(c, first_row, rows);
+		uint8_t* p = data()[c] + r.first * stride()[c];
+		for (int y = 0; y < r.second; ++y) {
+			fade_samples_8 (p, line_size()[c], f, black);
+			p += stride()[c];
 		}
+	};
 
-		/* U, V */
-		for (int c = 1; c < 3; ++c) {
-			uint8_t* p = data()[c];
-			int const lines = sample_size(c).height;
-			for (int y = 0; y < lines; ++y) {
-				uint8_t* q = p;
-				for (int x = 0; x < line_size()[c]; ++x) {
-					*q = eight_bit_uv + int((int(*q) - eight_bit_uv) * f);
-					++q;
-				}
-				p += stride()[c];
-			}
+	/* Fade the rows of plane c, which has 16-bit little-endian samples, towards `black' */
+	auto fade_plane_16 = [&](int c, int black) {
+		auto const r = plane_rows(c, first_row, rows);
+		uint8_t* p = data()[c] + r.first * stride()[c];
+		for (int y = 0; y < r.second; ++y) {
+			fade_samples_16 (reinterpret_cast<uint16_t*>(p), line_size()[c] / 2, f, black);
+			p += stride()[c];
 		}
+	};
 
+	switch (_pixel_format) {
+	case AV_PIX_FMT_YUV420P:
+		fade_plane_8 (0, 0);
+		fade_plane_8 (1, eight_bit_uv);
+		fade_plane_8 (2, eight_bit_uv);
 		break;
-	}
 
 	case AV_PIX_FMT_RGB24:
-	{
-		/* 8-bit */
-		uint8_t* p = data()[0];
-		int const lines = sample_size(0).height;
-		for (int y = 0; y < lines; ++y) {
-			uint8_t* q = p;
-			for (int x = 0; x < line_size()[0]; ++x) {
-				*q = int (float (*q) * f);
-				++q;
-			}
-			p += stride()[0];
-		}
+		fade_plane_8 (0, 0);
 		break;
-	}
 
 	case AV_PIX_FMT_XYZ12LE:
 	case AV_PIX_FMT_RGB48LE:
-		/* 16-bit little-endian */
-		for (int c = 0; c < 3; ++c) {
-			int const stride_pixels = stride()[c] / 2;
-			int const line_size_pixels = line_size()[c] / 2;
-			uint16_t* p = reinterpret_cast<uint16_t*> (data()[c]);
-			int const lines = sample_size(c).height;
-			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = int (float (*q) * f);
-					++q;
-				}
-				p += stride_pixels;
-			}
-		}
+		fade_plane_16 (0, 0);
 		break;
 
 	case AV_PIX_FMT_YUV422P10LE:
-	{
-		/* Y */
-		{
-			int const stride_pixels = stride()[0] / 2;
-			int const line_size_pixels = line_size()[0] / 2;
-			uint16_t* p = reinterpret_cast<uint16_t*> (data()[0]);
-			int const lines = sample_size(0).height;
-			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = int(float(*q) * f);
-					++q;
-				}
-				p += stride_pixels;
-			}
-		}
-
-		/* U, V */
-		for (int c = 1; c < 3; ++c) {
-			int const stride_pixels = stride()[c] / 2;
-			int const line_size_pixels = line_size()[c] / 2;
-			uint16_t* p = reinterpret_cast<uint16_t*> (data()[c]);
-			int const lines = sample_size(c).height;
-			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = ten_bit_uv + int((int(*q) - ten_bit_uv) * f);
-					++q;
-				}
-				p += stride_pixels;
-			}
-		}
+		fade_plane_16 (0, 0);
+		fade_plane_16 (1, ten_bit_uv);
+		fade_plane_16 (2, ten_bit_uv);
 		break;
 
-	}
-
 	default:
 		throw PixelFormatError ("fade()", _pixel_format);
 	}
@@ -1392,13 +2013,21 @@ Image::memory_used () const
 
 void
 Image::video_range_to_full_range ()
+{
+	video_range_to_full_range (0, size().height);
+}
+
+
+void
+Image::video_range_to_full_range (int first_row, int rows)
 {
 	switch (_pixel_format) {
 	case AV_PIX_FMT_RGB24:
 	{
 		float const factor = 256.0 / 219.0;
-		uint8_t* p = data()[0];
-		int const lines = sample_size(0).height;
+		auto const r = plane_rows(0, first_row, rows);
+		uint8_t* p = data()[0] + r.first * stride()[0];
+		int const lines = r.second;
 		for (int y = 0; y < lines; ++y) {
 			uint8_t* q = p;
 			for (int x = 0; x < line_size()[0]; ++x) {
@@ -1412,8 +2041,9 @@ Image::video_range_to_full_range ()
 	case AV_PIX_FMT_RGB48LE:
 	{
 		float const factor = 65536.0 / 56064.0;
-		uint16_t* p = reinterpret_cast<uint16_t*>(data()[0]);
-		int const lines = sample_size(0).height;
+		auto const r = plane_rows(0, first_row, rows);
+		uint16_t* p = reinterpret_cast<uint16_t*>(data()[0] + r.first * stride()[0]);
+		int const lines = r.second;
 		for (int y = 0; y < lines; ++y) {
 			uint16_t* q = p;
 			int const line_size_pixels = line_size()[0] / 2;
@@ -1429,8 +2059,9 @@ Image::video_range_to_full_range ()
 	{
 		float const factor = 4096.0 / 3504.0;
 		for (int c = 0; c < 3; ++c) {
-			uint16_t* p = reinterpret_cast<uint16_t*>(data()[c]);
-			int const lines = sample_size(c).height;
+			auto const r = plane_rows(c, first_row, rows);
+			uint16_t* p = reinterpret_cast<uint16_t*>(data()[c] + r.first * stride()[c]);
+			int const lines = r.second;
 			for (int y = 0; y < lines; ++y) {
 				uint16_t* q = p;
 				int const line_size_pixels = line_size()[c] / 2;
@@ -33,8 +33,13 @@ extern "C" {
 }
 #include <dcp/array_data.h>
 #include <dcp/colour_conversion.h>
+#include <boost/optional.hpp>
+#include <functional>
+#include <vector>
 
 struct AVFrame;
+class Digester;
+class RGBA;
 class Socket;
 
 class Image : public std::enable_shared_from_this<Image>
@@ -77,17 +82,21 @@ public:
 		AVPixelFormat out_format,
 		VideoRange out_video_range,
 		Alignment alignment,
-		bool fast
+		bool fast,
+		std::function<void (Image&, int, int)> process_rows = std::function<void (Image&, int, int)>()
 		) const;
 
 	void make_black ();
 	void make_transparent ();
 	void alpha_blend (std::shared_ptr<const Image> image, Position<int> pos);
+	void alpha_blend (std::shared_ptr<const Image> image, Position<int> pos, int first_row, int rows);
 	void copy (std::shared_ptr<const Image> image, Position<int> pos);
 	void fade (float);
+	void fade (float, int first_row, int rows);
 
 	void read_from_socket (std::shared_ptr<Socket>);
 	void write_to_socket (std::shared_ptr<Socket>) const;
+	void add_digest (Digester& digester) const;
 
 	AVPixelFormat pixel_format () const {
 		return _pixel_format;
@@ -97,26 +106,34 @@ public:
 
 	static std::shared_ptr<const Image> ensure_alignment (std::shared_ptr<const Image> image, Alignment alignment);
 
+	static void set_scale_threads (int threads);
+	static int scale_threads ();
+
 private:
 	friend struct pixel_formats_test;
 	friend struct make_part_black_test;
 
 	void allocate ();
+	size_t plane_allocation (int plane) const;
 	void swap (Image &);
 	void make_part_black (int x, int w);
+	void make_part_black (int x, int w, int first_row, int rows);
 	void yuv_16_black (uint16_t, bool);
 	static uint16_t swap_16 (uint16_t);
 	void video_range_to_full_range ();
+	void video_range_to_full_range (int first_row, int rows);
+	std::pair<int, int> plane_rows (int plane, int first_row, int rows) const;
 
 	dcp::Size _size;
 	AVPixelFormat _pixel_format; ///< FFmpeg's way of describing the pixel format of this Image
-	uint8_t** _data; ///< array of pointers to components
-	int* _line_size; ///< array of sizes of the data in each line, in bytes (without any alignment padding bytes)
-	int* _stride; ///< array of strides for each line, in bytes (including any alignment padding bytes)
+	uint8_t* _data[4]; ///< array of pointers to components
+	int _line_size[4]; ///< array of sizes of the data in each line, in bytes (without any alignment padding bytes)
+	int _stride[4]; ///< array of strides for each line, in bytes (including any alignment padding bytes)
 	Alignment _alignment;
 };
 
 extern PositionImage merge (std::list<PositionImage> images, Image::Alignment alignment);
+extern boost::optional<PositionImage> palette_image (uint8_t const* indices, int stride, dcp::Size size, std::vector<RGBA> const& palette);
 extern bool operator== (Image const & a, Image const & b);
 
 #endif
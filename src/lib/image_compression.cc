@@ -0,0 +1,421 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "config.h"
+#include "dcpomatic_socket.h"
+#include "exceptions.h"
+#include "image.h"
+#include "image_compression.h"
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "i18n.h"
+
+
+using std::max;
+using std::min;
+using std::shared_ptr;
+
+
+/* Each plane is a byte giving one of these, then a 4-byte little-endian length, then the data */
+enum class PlaneMode : uint8_t
+{
+	/** as it is in the image */
+	RAW = 0,
+	/** predicted 8-bit samples */
+	PREDICTED_8 = 1,
+	/** predicted 16-bit little-endian samples */
+	PREDICTED_16 = 2
+};
+
+
+static int const plane_header_size = 5;
+
+
+/** Ways that we can send an image over a socket */
+enum class Transport
+{
+	/** the image data as it is */
+	RAW = 0,
+	/** compressed with compress_image() */
+	COMPRESSED = 1
+};
+
+
+/** @return Mode to use for plane @p plane of @p image, and the number of interleaved channels in each line */
+static std::pair<PlaneMode, int>
+plane_layout (Image const& image, int plane)
+{
+	auto desc = av_pix_fmt_desc_get (image.pixel_format());
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+		return { PlaneMode::RAW, 1 };
+	}
+
+#ifdef DCPOMATIC_HAVE_AVCOMPONENTDESCRIPTOR_DEPTH_MINUS1
+	int const depth = desc->comp[0].depth_minus1 + 1;
+#else
+	int const depth = desc->comp[0].depth;
+#endif
+
+	int const bytes_per_sample = depth > 8 ? 2 : 1;
+	int const channels = (desc->flags & AV_PIX_FMT_FLAG_PLANAR) ? 1 : desc->nb_components;
+
+	/* Anything where the samples are not simply packed one after the other is sent as-is */
+	if (image.line_size()[plane] != image.sample_size(plane).width * channels * bytes_per_sample) {
+		return { PlaneMode::RAW, 1 };
+	}
+
+	return { bytes_per_sample == 2 ? PlaneMode::PREDICTED_16 : PlaneMode::PREDICTED_8, channels };
+}
+
+
+/** LOCO-I's median edge detector */
+static inline int
+predict (int left, int above, int above_left)
+{
+	if (above_left >= max(left, above)) {
+		return min(left, above);
+	} else if (above_left <= min(left, above)) {
+		return max(left, above);
+	}
+	return left + above - above_left;
+}
+
+
+template <class T>
+static inline T
+get_sample (uint8_t const* line, int index)
+{
+	T s;
+	memcpy (&s, line + index * sizeof(T), sizeof(T));
+	return s;
+}
+
+
+template <class T>
+static inline void
+put_sample (uint8_t* line, int index, T s)
+{
+	memcpy (line + index * sizeof(T), &s, sizeof(T));
+}
+
+
+/** Predict sample @p x in @p line from its neighbours; @p previous is the line above, or nullptr */
+template <class T>
+static inline int
+predict_sample (uint8_t const* line, uint8_t const* previous, int x, int channels)
+{
+	int const above = previous ? get_sample<T>(previous, x) : 0;
+	if (x < channels) {
+		return above;
+	}
+	int const left = get_sample<T>(line, x - channels);
+	int const above_left = previous ? get_sample<T>(previous, x - channels) : 0;
+	return predict (left, above, above_left);
+}
+
+
+/** Number of residuals which are packed together with the same number of bits */
+static int const group_size = 16;
+
+
+/** Compress one line of samples of type T.
+ *  @param residuals Somewhere to put residuals, with space for @p samples rounded up to a multiple of group_size.
+ *  @return Pointer to the byte after the last one written.
+ */
+template <class T>
+static uint8_t*
+compress_line (uint8_t const* line, uint8_t const* previous, int samples, int channels, uint16_t* residuals, uint8_t* out)
+{
+	int const bits = sizeof(T) * 8;
+
+	for (int x = 0; x < samples; ++x) {
+		/* Residual wrapped into the range of T, then zig-zagged so that small negative numbers are small */
+		int residual = static_cast<T>(get_sample<T>(line, x) - predict_sample<T>(line, previous, x, channels));
+		if (residual >= (1 << (bits - 1))) {
+			residual -= (1 << bits);
+		}
+		residuals[x] = residual >= 0 ? residual * 2 : -residual * 2 - 1;
+	}
+
+	int const padded = (samples + group_size - 1) / group_size * group_size;
+	std::fill (residuals + samples, residuals + padded, 0);
+
+	/* Each group is a byte giving the number of bits used for each of its residuals,
+	   then the residuals packed together, least-significant bits first.
+	*/
+	for (int g = 0; g < padded; g += group_size) {
+		uint16_t all = 0;
+		for (int i = 0; i < group_size; ++i) {
+			all |= residuals[g + i];
+		}
+		int width = 0;
+		while (all >> width) {
+			++width;
+		}
+
+		*out++ = width;
+		uint32_t accumulator = 0;
+		int accumulated = 0;
+		for (int i = 0; i < group_size; ++i) {
+			accumulator |= static_cast<uint32_t>(residuals[g + i]) << accumulated;
+			accumulated += width;
+			while (accumulated >= 8) {
+				*out++ = accumulator & 0xff;
+				accumulator >>= 8;
+				accumulated -= 8;
+			}
+		}
+	}
+
+	return out;
+}
+
+
+/** Decompress one line of samples of type T.
+ *  @param residuals Somewhere to put residuals, with space for @p samples rounded up to a multiple of group_size.
+ *  @return Pointer to the byte after the last one read.
+ */
+template <class T>
+static uint8_t const*
+decompress_line (uint8_t const* in, uint8_t const* end, uint8_t* line, uint8_t const* previous, int samples, int channels, uint16_t* residuals)
+{
+	int const padded = (samples + group_size - 1) / group_size * group_size;
+
+	for (int g = 0; g < padded; g += group_size) {
+		if (in >= end) {
+			throw DecodeError (_("Compressed image data is too short"));
+		}
+		int const width = *in++;
+		if (width > static_cast<int>(sizeof(T) * 8) || (end - in) < width * group_size / 8) {
+			throw DecodeError (_("Compressed image data is corrupt"));
+		}
+
+		uint32_t accumulator = 0;
+		int accumulated = 0;
+		uint32_t const mask = (1 << width) - 1;
+		for (int i = 0; i < group_size; ++i) {
+			while (accumulated < width) {
+				accumulator |= static_cast<uint32_t>(*in++) << accumulated;
+				accumulated += 8;
+			}
+			residuals[g + i] = accumulator & mask;
+			accumulator >>= width;
+			accumulated -= width;
+		}
+	}
+
+	for (int x = 0; x < samples; ++x) {
+		int const z = residuals[x];
+		int const residual = (z & 1) ? -((z + 1) / 2) : z / 2;
+		put_sample<T>(line, x, static_cast<T>(predict_sample<T>(line, previous, x, channels) + residual));
+	}
+
+	return in;
+}
+
+
+static void
+write_plane_header (uint8_t* out, PlaneMode mode, uint32_t length)
+{
+	out[0] = static_cast<uint8_t>(mode);
+	out[1] = length & 0xff;
+	out[2] = (length >> 8) & 0xff;
+	out[3] = (length >> 16) & 0xff;
+	out[4] = (length >> 24) & 0xff;
+}
+
+
+dcp::ArrayData
+compress_image (shared_ptr<const Image> image)
+{
+	/* Each plane can't be any bigger than its raw size plus a header, and while compressing
+	   we might go a little over before we notice that we should send it raw.
+	*/
+	size_t maximum = 0;
+	int longest_line = 0;
+	for (int i = 0; i < image->planes(); ++i) {
+		maximum += plane_header_size + static_cast<size_t>(image->line_size()[i]) * (image->sample_size(i).height + 3) + group_size * 4;
+		longest_line = std::max(longest_line, image->line_size()[i]);
+	}
+	std::vector<uint16_t> residuals (longest_line + group_size);
+
+	dcp::ArrayData compressed (maximum);
+	auto out = compressed.data();
+
+	for (int i = 0; i < image->planes(); ++i) {
+		auto const layout = plane_layout (*image, i);
+		int const lines = image->sample_size(i).height;
+		int const line_size = image->line_size()[i];
+		int const stride = image->stride()[i];
+		size_t const raw_size = static_cast<size_t>(line_size) * lines;
+
+		auto const header = out;
+		auto const start = out + plane_header_size;
+		auto mode = layout.first;
+
+		if (mode != PlaneMode::RAW) {
+			int const bytes_per_sample = mode == PlaneMode::PREDICTED_16 ? 2 : 1;
+			int const samples = line_size / bytes_per_sample;
+			uint8_t const* previous = nullptr;
+			uint8_t const* line = image->data()[i];
+			out = start;
+			for (int y = 0; y < lines; ++y) {
+				if (mode == PlaneMode::PREDICTED_16) {
+					out = compress_line<uint16_t>(line, previous, samples, layout.second, residuals.data(), out);
+				} else {
+					out = compress_line<uint8_t>(line, previous, samples, layout.second, residuals.data(), out);
+				}
+				if (static_cast<size_t>(out - start) >= raw_size) {
+					/* This isn't helping */
+					mode = PlaneMode::RAW;
+					break;
+				}
+				previous = line;
+				line += stride;
+			}
+		}
+
+		if (mode == PlaneMode::RAW) {
+			out = start;
+			uint8_t const* line = image->data()[i];
+			for (int y = 0; y < lines; ++y) {
+				memcpy (out, line, line_size);
+				out += line_size;
+				line += stride;
+			}
+		}
+
+		write_plane_header (header, mode, out - start);
+	}
+
+	compressed.set_size (out - compressed.data());
+	return compressed;
+}
+
+
+void
+decompress_image (uint8_t const* data, size_t size, shared_ptr<Image> image)
+{
+	auto const end = data + size;
+
+	int longest_line = 0;
+	for (int i = 0; i < image->planes(); ++i) {
+		longest_line = std::max(longest_line, image->line_size()[i]);
+	}
+	std::vector<uint16_t> residuals (longest_line + group_size);
+
+	for (int i = 0; i < image->planes(); ++i) {
+		if ((end - data) < plane_header_size) {
+			throw DecodeError (_("Compressed image data is too short"));
+		}
+
+		auto const mode = static_cast<PlaneMode>(data[0]);
+		size_t const length = data[1] | (data[2] << 8) | (data[3] << 16) | (static_cast<uint32_t>(data[4]) << 24);
+		data += plane_header_size;
+		if (static_cast<size_t>(end - data) < length) {
+			throw DecodeError (_("Compressed image data is too short"));
+		}
+
+		auto const plane_end = data + length;
+		int const lines = image->sample_size(i).height;
+		int const line_size = image->line_size()[i];
+		int const stride = image->stride()[i];
+		uint8_t* line = image->data()[i];
+
+		switch (mode) {
+		case PlaneMode::RAW:
+			if (length != static_cast<size_t>(line_size) * lines) {
+				throw DecodeError (_("Compressed image data has the wrong size"));
+			}
+			for (int y = 0; y < lines; ++y) {
+				memcpy (line, data, line_size);
+				data += line_size;
+				line += stride;
+			}
+			break;
+		case PlaneMode::PREDICTED_8:
+		case PlaneMode::PREDICTED_16:
+		{
+			auto const layout = plane_layout (*image, i);
+			if (layout.first != mode) {
+				throw DecodeError (_("Compressed image data does not match the image"));
+			}
+			int const samples = line_size / (mode == PlaneMode::PREDICTED_16 ? 2 : 1);
+			uint8_t const* previous = nullptr;
+			for (int y = 0; y < lines; ++y) {
+				if (mode == PlaneMode::PREDICTED_16) {
+					data = decompress_line<uint16_t>(data, plane_end, line, previous, samples, layout.second, residuals.data());
+				} else {
+					data = decompress_line<uint8_t>(data, plane_end, line, previous, samples, layout.second, residuals.data());
+				}
+				previous = line;
+				line += stride;
+			}
+			break;
+		}
+		default:
+			throw DecodeError (_("Compressed image data is not recognised"));
+		}
+
+		data = plane_end;
+	}
+}
+
+
+void
+write_image_to_socket (shared_ptr<const Image> image, shared_ptr<Socket> socket)
+{
+	if (Config::instance()->compress_frames_for_servers()) {
+		auto compressed = compress_image (image);
+		socket->write (static_cast<uint32_t>(Transport::COMPRESSED));
+		socket->write (static_cast<uint32_t>(compressed.size()));
+		socket->write (compressed.data(), compressed.size());
+	} else {
+		socket->write (static_cast<uint32_t>(Transport::RAW));
+		image->write_to_socket (socket);
+	}
+}
+
+
+void
+read_image_from_socket (shared_ptr<Image> image, shared_ptr<Socket> socket)
+{
+	switch (static_cast<Transport>(socket->read_uint32())) {
+	case Transport::RAW:
+		image->read_from_socket (socket);
+		break;
+	case Transport::COMPRESSED:
+	{
+		auto const length = socket->read_uint32 ();
+		dcp::ArrayData compressed (length);
+		socket->read (compressed.data(), length);
+		decompress_image (compressed.data(), length, image);
+		break;
+	}
+	default:
+		throw NetworkError (_("Unexpected image transport received by server"));
+	}
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_IMAGE_COMPRESSION_H
+#define DCPOMATIC_IMAGE_COMPRESSION_H
+
+
+/** @file  src/lib/image_compression.h
+ *  @brief A fast lossless compressor for the data in an Image.
+ *
+ *  Each sample is predicted from its neighbours to the left, above and above-left
+ *  (as in LOCO-I) and the differences are packed in groups of 16, each group using
+ *  as many bits as its largest difference needs.  This is nothing like as good as a
+ *  proper entropy coder but it is quick enough that sending a compressed frame over
+ *  the network takes less time than sending the raw data.
+ */
+
+
+#include <dcp/array_data.h>
+#include <memory>
+
+
+class Image;
+class Socket;
+
+
+/** @return Compressed copy of the data (but not any alignment padding) in @p image */
+extern dcp::ArrayData compress_image (std::shared_ptr<const Image> image);
+
+/** Fill @p image with data which was compressed by compress_image() from an image
+ *  of the same size and pixel format.
+ */
+extern void decompress_image (uint8_t const* data, size_t size, std::shared_ptr<Image> image);
+
+/** Write @p image to @p socket, compressed if Config::compress_frames_for_servers() says so */
+extern void write_image_to_socket (std::shared_ptr<const Image> image, std::shared_ptr<Socket> socket);
+
+/** Fill @p image with data written to @p socket by write_image_to_socket() */
+extern void read_image_from_socket (std::shared_ptr<Image> image, std::shared_ptr<Socket> socket);
+
+
+#endif
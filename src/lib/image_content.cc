@@ -115,8 +115,9 @@ ImageContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 		job->sub (_("Scanning image files"));
 		vector<boost::filesystem::path> paths;
 		int n = 0;
-		for (auto i: boost::filesystem::directory_iterator(*_path_to_scan)) {
-			if (boost::filesystem::is_regular_file(i.path()) && valid_image_file (i.path())) {
+		for (auto const& i: boost::filesystem::directory_iterator(*_path_to_scan)) {
+			/* Check the name first, as that doesn't need to ask the filesystem anything */
+			if (valid_image_file(i.path()) && boost::filesystem::is_regular_file(i.status())) {
 				paths.push_back (i.path());
 			}
 			++n;
@@ -129,7 +130,7 @@ ImageContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 			throw FileError (_("No valid image files were found in the folder."), *_path_to_scan);
 		}
 
-		sort (paths.begin(), paths.end(), ImageFilenameSorter());
+		ImageFilenameSorter::sort (paths);
 		set_paths (paths);
 	}
 
@@ -19,6 +19,7 @@
 */
 
 
+#include "config.h"
 #include "exceptions.h"
 #include "ffmpeg_image_proxy.h"
 #include "film.h"
@@ -36,7 +37,10 @@
 
 
 using std::cout;
+using std::dynamic_pointer_cast;
 using std::make_shared;
+using std::max;
+using std::min;
 using std::shared_ptr;
 using dcp::Size;
 using namespace dcpomatic;
@@ -47,6 +51,116 @@ ImageDecoder::ImageDecoder (shared_ptr<const Film> film, shared_ptr<const ImageC
 	, _image_content (c)
 {
 	video = make_shared<VideoDecoder>(this, c);
+
+	if (!c->still()) {
+		auto const threads = max(1, min(Config::instance()->decoding_threads(), 4));
+		_prefetch_length = threads * 2;
+		_prefetch_work = make_shared<boost::asio::io_service::work>(_prefetch_service);
+		for (int i = 0; i < threads; ++i) {
+			_prefetch_pool.create_thread ([this]() {
+				_prefetch_service.run ();
+			});
+		}
+	}
+}
+
+
+ImageDecoder::~ImageDecoder ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	/* Abandon any frames that have not yet been started */
+	_prefetch_work.reset ();
+	_prefetch_service.stop ();
+
+	try {
+		_prefetch_pool.join_all ();
+	} catch (...) {}
+}
+
+
+/** @return An ImageProxy for a frame of our content; the image file will have been read, but not decoded */
+shared_ptr<ImageProxy>
+ImageDecoder::make_image (Frame frame) const
+{
+	auto path = _image_content->path (_image_content->still() ? 0 : frame);
+	if (valid_j2k_file (path)) {
+		AVPixelFormat pf;
+		if (_image_content->video->colour_conversion()) {
+			/* We have a specified colour conversion: assume the image is RGB */
+			pf = AV_PIX_FMT_RGB48LE;
+		} else {
+			/* No specified colour conversion: assume the image is XYZ */
+			pf = AV_PIX_FMT_XYZ12LE;
+		}
+		/* We can't extract image size from a JPEG2000 codestream without decoding it,
+		   so pass in the image content's size here.
+		*/
+		return make_shared<J2KImageProxy>(path, _image_content->video->size(), pf);
+	}
+
+	return make_shared<FFmpegImageProxy>(path);
+}
+
+
+/** Ask our prefetch threads for the frames from `frame' onwards, and then wait for `frame' to be ready.
+ *  @return An ImageProxy for `frame'.
+ */
+shared_ptr<ImageProxy>
+ImageDecoder::prefetched_image (Frame frame)
+{
+	_prefetch.erase (_prefetch.begin(), _prefetch.lower_bound(frame));
+
+	auto const end = min(frame + _prefetch_length, static_cast<Frame>(_image_content->video->length()));
+	for (auto i = frame; i < end; ++i) {
+		if (_prefetch.find(i) != _prefetch.end()) {
+			continue;
+		}
+
+		auto prefetch = make_shared<Prefetch>();
+		_prefetch[i] = prefetch;
+		_prefetch_service.post ([this, prefetch, i]() {
+			shared_ptr<ImageProxy> image;
+			std::exception_ptr error;
+			try {
+				image = make_image (i);
+				/* Work out the fingerprint here, in parallel, so that looking for repeated frames later is quick */
+				image->fingerprint ();
+				/* We can decode FFmpeg images now, but J2K decoding depends on the size that the
+				 * player wants, so we leave those for PlayerVideo::prepare().
+				 */
+				if (dynamic_pointer_cast<FFmpegImageProxy>(image)) {
+					try {
+						image->image (Image::Alignment::PADDED);
+					} catch (...) {
+						/* This will be thrown again when someone asks for the image */
+					}
+				}
+			} catch (...) {
+				error = std::current_exception ();
+			}
+
+			boost::mutex::scoped_lock lm (_prefetch_mutex);
+			prefetch->image = image;
+			prefetch->error = error;
+			prefetch->done = true;
+			_prefetch_condition.notify_all ();
+		});
+	}
+
+	auto prefetch = _prefetch[frame];
+	_prefetch.erase (frame);
+
+	boost::mutex::scoped_lock lm (_prefetch_mutex);
+	while (!prefetch->done) {
+		_prefetch_condition.wait (lm);
+	}
+
+	if (prefetch->error) {
+		std::rethrow_exception (prefetch->error);
+	}
+
+	return prefetch->image;
 }
 
 
@@ -57,25 +171,12 @@ ImageDecoder::pass ()
 		return true;
 	}
 
-	if (!_image_content->still() || !_image) {
-		/* Either we need an image or we are using moving images, so load one */
-		auto path = _image_content->path (_image_content->still() ? 0 : _frame_video_position);
-		if (valid_j2k_file (path)) {
-			AVPixelFormat pf;
-			if (_image_content->video->colour_conversion()) {
-				/* We have a specified colour conversion: assume the image is RGB */
-				pf = AV_PIX_FMT_RGB48LE;
-			} else {
-				/* No specified colour conversion: assume the image is XYZ */
-				pf = AV_PIX_FMT_XYZ12LE;
-			}
-			/* We can't extract image size from a JPEG2000 codestream without decoding it,
-			   so pass in the image content's size here.
-			*/
-			_image = make_shared<J2KImageProxy>(path, _image_content->video->size(), pf);
-		} else {
-			_image = make_shared<FFmpegImageProxy>(path);
+	if (_image_content->still()) {
+		if (!_image) {
+			_image = make_image (0);
 		}
+	} else {
+		_image = prefetched_image (_frame_video_position);
 	}
 
 	video->emit (film(), _image, _frame_video_position);
@@ -88,5 +189,6 @@ void
 ImageDecoder::seek (ContentTime time, bool accurate)
 {
 	Decoder::seek (time, accurate);
+	_prefetch.clear ();
 	_frame_video_position = time.frames_round (_image_content->active_video_frame_rate(film()));
 }
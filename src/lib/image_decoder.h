@@ -20,6 +20,11 @@
 
 
 #include "decoder.h"
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <exception>
+#include <map>
 
 
 class ImageContent;
@@ -31,6 +36,10 @@ class ImageDecoder : public Decoder
 {
 public:
 	ImageDecoder (std::shared_ptr<const Film> film, std::shared_ptr<const ImageContent> c);
+	~ImageDecoder ();
+
+	ImageDecoder (ImageDecoder const&) = delete;
+	ImageDecoder& operator= (ImageDecoder const&) = delete;
 
 	std::shared_ptr<const ImageContent> content () {
 		return _image_content;
@@ -40,8 +49,30 @@ public:
 	void seek (dcpomatic::ContentTime, bool) override;
 
 private:
+	struct Prefetch
+	{
+		std::shared_ptr<ImageProxy> image;
+		/** exception thrown when making the image, if there was one */
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	std::shared_ptr<ImageProxy> make_image (Frame frame) const;
+	std::shared_ptr<ImageProxy> prefetched_image (Frame frame);
 
 	std::shared_ptr<const ImageContent> _image_content;
 	std::shared_ptr<ImageProxy> _image;
 	Frame _frame_video_position = 0;
+
+	/** number of frames of a moving image to read (and, where possible, decode) in advance */
+	int _prefetch_length = 0;
+	boost::thread_group _prefetch_pool;
+	boost::asio::io_service _prefetch_service;
+	std::shared_ptr<boost::asio::io_service::work> _prefetch_work;
+	/** frames that have been given to _prefetch_service, indexed by frame; only used by the thread calling pass() */
+	std::map<Frame, std::shared_ptr<Prefetch>> _prefetch;
+
+	/** mutex to protect the contents of the Prefetch objects */
+	boost::mutex _prefetch_mutex;
+	boost::condition _prefetch_condition;
 };
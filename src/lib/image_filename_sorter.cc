@@ -23,11 +23,14 @@
 #include <dcp/locale_convert.h>
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
+#include <algorithm>
 #include <iostream>
+#include <numeric>
 
 
 using std::list;
 using std::string;
+using std::vector;
 using dcp::locale_convert;
 using boost::optional;
 
@@ -50,6 +53,40 @@ ImageFilenameSorter::operator() (boost::filesystem::path a, boost::filesystem::p
 	return an < bn;
 }
 
+/** Sort some paths in the same order as using operator(), but working out what to
+ *  compare only once for each path rather than once per comparison.
+ */
+void
+ImageFilenameSorter::sort (vector<boost::filesystem::path>& paths)
+{
+	vector<string> keys;
+	keys.reserve (paths.size());
+	size_t longest = 0;
+	for (auto const& i: paths) {
+		keys.push_back (extract_numbers(i));
+		longest = std::max(longest, keys.back().length());
+	}
+
+	/* Padding everything to the same length compares in the same way as padding each pair */
+	for (auto& i: keys) {
+		i.insert (0, longest - i.length(), '0');
+	}
+
+	vector<size_t> order (paths.size());
+	std::iota (order.begin(), order.end(), 0);
+	std::stable_sort (order.begin(), order.end(), [&keys](size_t a, size_t b) {
+		return keys[a] < keys[b];
+	});
+
+	vector<boost::filesystem::path> sorted;
+	sorted.reserve (paths.size());
+	for (auto i: order) {
+		sorted.push_back (std::move(paths[i]));
+	}
+	paths = std::move (sorted);
+}
+
+
 string
 ImageFilenameSorter::extract_numbers (boost::filesystem::path p)
 {
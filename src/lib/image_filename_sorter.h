@@ -20,12 +20,15 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
+#include <vector>
 
 class ImageFilenameSorter
 {
 public:
 	bool operator() (boost::filesystem::path a, boost::filesystem::path b);
 
+	static void sort (std::vector<boost::filesystem::path>& paths);
+
 private:
-	std::string extract_numbers (boost::filesystem::path p);
+	static std::string extract_numbers (boost::filesystem::path p);
 };
@@ -22,12 +22,17 @@
 #include "dcpomatic_assert.h"
 #include "exceptions.h"
 #include "image.h"
+#include "image_png.h"
 #include <png.h>
+#include <zlib.h>
+#include <unordered_map>
 
 #include "i18n.h"
 
 
 using std::shared_ptr;
+using std::unordered_map;
+using std::vector;
 
 
 class Memory
@@ -82,13 +87,62 @@ png_error_fn (png_structp, char const * message)
 }
 
 
+/** Find the palette of an RGBA image, if it has no more than 256 colours.  Pixels which are
+ *  completely transparent all become the same entry, whatever their colour.
+ *  @param colours Filled in with the colour of each palette entry.
+ *  @param alphas Filled in with the alpha of each palette entry.
+ *  @param indices Filled in with the palette index of each pixel, row by row with no padding.
+ *  @return true if the image could be described with a palette.
+ */
+static bool
+make_palette (shared_ptr<const Image> image, vector<png_color>& colours, vector<png_byte>& alphas, vector<png_byte>& indices)
+{
+	int const width = image->size().width;
+	int const height = image->size().height;
+
+	unordered_map<uint32_t, png_byte> lookup;
+	indices.resize (width * height);
+	auto out = indices.data();
+
+	/* Subtitles are mostly long runs of the same pixel, so remember the last one to save looking it up */
+	boost::optional<uint32_t> last;
+	png_byte last_index = 0;
+
+	for (int y = 0; y < height; ++y) {
+		auto p = image->data()[0] + y * image->stride()[0];
+		for (int x = 0; x < width; ++x) {
+			uint32_t const key = p[3] == 0 ? 0 : (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+			if (key != last) {
+				auto existing = lookup.find(key);
+				if (existing != lookup.end()) {
+					last_index = existing->second;
+				} else {
+					if (colours.size() == 256) {
+						return false;
+					}
+					last_index = colours.size();
+					lookup[key] = last_index;
+					colours.push_back({ static_cast<png_byte>(key & 0xff), static_cast<png_byte>((key >> 8) & 0xff), static_cast<png_byte>((key >> 16) & 0xff) });
+					alphas.push_back (key >> 24);
+				}
+				last = key;
+			}
+			*out++ = last_index;
+			p += 4;
+		}
+	}
+
+	return true;
+}
+
+
 dcp::ArrayData
-image_as_png (shared_ptr<const Image> image)
+image_as_png (shared_ptr<const Image> image, PNGCompression compression)
 {
 	DCPOMATIC_ASSERT (image->bytes_per_pixel(0) == 4);
 	DCPOMATIC_ASSERT (image->planes() == 1);
 	if (image->pixel_format() != AV_PIX_FMT_RGBA) {
-		return image_as_png(image->convert_pixel_format(dcp::YUVToRGB::REC709, AV_PIX_FMT_RGBA, Image::Alignment::PADDED, false));
+		return image_as_png(image->convert_pixel_format(dcp::YUVToRGB::REC709, AV_PIX_FMT_RGBA, Image::Alignment::PADDED, false), compression);
 	}
 
 	/* error handling? */
@@ -110,13 +164,37 @@ image_as_png (shared_ptr<const Image> image)
 	int const width = image->size().width;
 	int const height = image->size().height;
 
-	png_set_IHDR (png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	vector<png_color> colours;
+	vector<png_byte> alphas;
+	vector<png_byte> indices;
+	bool const palette = compression == PNGCompression::FAST && make_palette(image, colours, alphas, indices);
+
+	if (palette) {
+		png_set_IHDR (png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_set_PLTE (png_ptr, info_ptr, colours.data(), colours.size());
+		png_set_tRNS (png_ptr, info_ptr, alphas.data(), alphas.size(), nullptr);
+	} else {
+		png_set_IHDR (png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	}
+
+	if (compression == PNGCompression::FAST) {
+		/* Row filters do little for palette images, and trying them all is most of libpng's time
+		 * for RGBA ones; runs of the same pixel are what there is to find in subtitles.
+		 */
+		png_set_filter (png_ptr, PNG_FILTER_TYPE_BASE, palette ? PNG_FILTER_NONE : PNG_FILTER_SUB);
+		png_set_compression_level (png_ptr, 1);
+		png_set_compression_strategy (png_ptr, palette ? Z_RLE : Z_DEFAULT_STRATEGY);
+	}
 
 	auto row_pointers = reinterpret_cast<png_byte **>(png_malloc(png_ptr, image->size().height * sizeof(png_byte *)));
 	auto const data = image->data()[0];
 	auto const stride = image->stride()[0];
 	for (int i = 0; i < height; ++i) {
-		row_pointers[i] = reinterpret_cast<png_byte *>(data + i * stride);
+		if (palette) {
+			row_pointers[i] = indices.data() + i * width;
+		} else {
+			row_pointers[i] = reinterpret_cast<png_byte *>(data + i * stride);
+		}
 	}
 
 	png_write_info (png_ptr, info_ptr);
@@ -128,5 +206,3 @@ image_as_png (shared_ptr<const Image> image)
 
 	return dcp::ArrayData (state.data, state.size);
 }
-
-
@@ -26,4 +26,16 @@
 class Image;
 
 
-dcp::ArrayData image_as_png (std::shared_ptr<const Image> image);
+/** How hard image_as_png should try to make small PNGs */
+enum class PNGCompression
+{
+	/** libpng's defaults, for PNGs that people will keep */
+	DEFAULT,
+	/** Light compression without row filters, and a palette if there are few enough colours;
+	 *  much quicker for the large, mostly-transparent images of bitmap subtitles.
+	 */
+	FAST
+};
+
+
+dcp::ArrayData image_as_png (std::shared_ptr<const Image> image, PNGCompression compression = PNGCompression::DEFAULT);
@@ -0,0 +1,157 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "dcpomatic_assert.h"
+#include "image_pool.h"
+#include "memory_util.h"
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+extern "C" {
+#include <libavutil/mem.h>
+}
+LIBDCP_ENABLE_WARNINGS
+
+
+using std::make_pair;
+using std::pair;
+using std::string;
+using std::vector;
+
+
+size_t const ImagePool::_max_spare = 512 * 1024 * 1024;
+
+
+ImagePool*
+ImagePool::instance ()
+{
+	/* This is never deleted, since Images and AudioBuffers may be destroyed during static destruction */
+	static auto pool = new ImagePool;
+	return pool;
+}
+
+
+/** @return The size of block that we will allocate to satisfy a request for @p size bytes */
+size_t
+ImagePool::size_class (size_t size)
+{
+	/* Round up to a power-of-two step of between 1/32 and 1/16 of the size, so that we
+	 * never waste much but blocks for images of nearly the same size still share a class.
+	 */
+	size_t step = 4096;
+	while (step * 16 <= size) {
+		step *= 2;
+	}
+	return ((size + step - 1) / step) * step;
+}
+
+
+uint8_t*
+ImagePool::get (size_t size)
+{
+	auto const block_size = size_class(size);
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_in_use += block_size;
+		auto i = _spare.find(block_size);
+		if (i != _spare.end() && !i->second.empty()) {
+			auto block = i->second.back();
+			i->second.pop_back();
+			_spare_size -= block_size;
+			return block;
+		}
+	}
+
+	try {
+		return static_cast<uint8_t*>(wrapped_av_malloc(block_size));
+	} catch (...) {
+		boost::mutex::scoped_lock lm (_mutex);
+		_in_use -= block_size;
+		throw;
+	}
+}
+
+
+void
+ImagePool::put (uint8_t* block, size_t size)
+{
+	if (!block) {
+		return;
+	}
+
+	auto const block_size = size_class(size);
+
+	boost::mutex::scoped_lock lm (_mutex);
+	DCPOMATIC_ASSERT (_in_use >= block_size);
+	_in_use -= block_size;
+
+	if (_spare_size + block_size <= _max_spare) {
+		_spare[block_size].push_back(block);
+		_spare_size += block_size;
+	} else {
+		lm.unlock ();
+		av_free (block);
+	}
+}
+
+
+size_t
+ImagePool::in_use () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _in_use;
+}
+
+
+size_t
+ImagePool::spare () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _spare_size;
+}
+
+
+pair<size_t, string>
+ImagePool::memory_used () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return make_pair(_spare_size, String::compose("%1MB of images and audio, %2MB spare", _in_use / 1048576, _spare_size / 1048576));
+}
+
+
+void
+ImagePool::clear ()
+{
+	std::map<size_t, vector<uint8_t*>> spare;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		std::swap (spare, _spare);
+		_spare_size = 0;
+	}
+
+	for (auto const& i: spare) {
+		for (auto j: i.second) {
+			av_free (j);
+		}
+	}
+}
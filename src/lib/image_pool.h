@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_IMAGE_POOL_H
+#define DCPOMATIC_IMAGE_POOL_H
+
+
+#include <boost/thread/mutex.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/** @class ImagePool
+ *  @brief A store of the blocks of memory used for Image planes and AudioBuffers.
+ *
+ *  When an Image or AudioBuffers is destroyed its memory comes back here to be re-used by
+ *  the next one of a similar size, rather than being freed; this saves a lot of allocation
+ *  and page-faulting when we are making several large images for every frame.
+ *  Blocks are grouped into size classes so that one of a given class will do for any
+ *  request which rounds up to that class.
+ */
+class ImagePool
+{
+public:
+	ImagePool (ImagePool const&) = delete;
+	ImagePool& operator= (ImagePool const&) = delete;
+
+	/** @return A block of at least @p size bytes, aligned as av_malloc() would align it,
+	 *  whose contents are undefined.
+	 */
+	uint8_t* get (size_t size);
+	/** Give back a block which came from get().
+	 *  @param size Size that was passed to get() when the block was obtained.
+	 */
+	void put (uint8_t* block, size_t size);
+
+	/** @return Total bytes in blocks that have been given out and not returned */
+	size_t in_use () const;
+	/** @return Total bytes in blocks that are waiting to be re-used */
+	size_t spare () const;
+	std::pair<size_t, std::string> memory_used () const;
+
+	/** Free all spare blocks */
+	void clear ();
+
+	static ImagePool* instance ();
+
+private:
+	ImagePool () = default;
+
+	static size_t size_class (size_t size);
+
+	mutable boost::mutex _mutex;
+	/** Spare blocks, indexed by size class */
+	std::map<size_t, std::vector<uint8_t*>> _spare;
+	size_t _in_use = 0;
+	size_t _spare_size = 0;
+
+	/** Maximum number of bytes to keep in spare blocks */
+	static size_t const _max_spare;
+};
+
+
+#endif
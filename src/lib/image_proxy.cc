@@ -19,7 +19,9 @@
 */
 
 
+#include "binary_descriptor.h"
 #include "cross.h"
+#include "digester.h"
 #include "exceptions.h"
 #include "ffmpeg_image_proxy.h"
 #include "image.h"
@@ -37,6 +39,55 @@ using std::cout;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
+using boost::optional;
+
+
+/** @return a digest of everything that decides what image() will return (i.e. what add_digest()
+ *  adds).  This is worked out the first time it is needed and then kept, so that comparing
+ *  proxies which hold the same data again and again (as we do when looking for repeated frames)
+ *  does not need to look at all the data each time.
+ */
+string
+ImageProxy::fingerprint () const
+{
+	boost::mutex::scoped_lock lm (_fingerprint_mutex);
+	if (!_fingerprint) {
+		Digester digester;
+		add_digest (digester);
+		_fingerprint = digester.get ();
+	}
+	return *_fingerprint;
+}
+
+
+/** @return our fingerprint if it has already been worked out, otherwise an empty optional */
+optional<string>
+ImageProxy::known_fingerprint () const
+{
+	boost::mutex::scoped_lock lm (_fingerprint_mutex);
+	return _fingerprint;
+}
+
+
+/** Compare our fingerprint with another proxy's, without working either of them out.
+ *  @return true if they are the same, false if they are different, or an empty optional
+ *  if one of them is not yet known.
+ */
+optional<bool>
+ImageProxy::same_fingerprint (ImageProxy const& other) const
+{
+	auto const ours = known_fingerprint ();
+	if (!ours) {
+		return {};
+	}
+
+	auto const theirs = other.known_fingerprint ();
+	if (!theirs) {
+		return {};
+	}
+
+	return *ours == *theirs;
+}
 
 
 shared_ptr<ImageProxy>
@@ -52,3 +103,19 @@ image_proxy_factory (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
 
 	throw NetworkError (_("Unexpected image type received by server"));
 }
+
+
+shared_ptr<ImageProxy>
+image_proxy_factory (BinaryDescriptorReader& reader, shared_ptr<Socket> socket)
+{
+	switch (static_cast<ImageProxyType>(reader.read_int32())) {
+	case ImageProxyType::RAW:
+		return make_shared<RawImageProxy>(reader, socket);
+	case ImageProxyType::FFMPEG:
+		return make_shared<FFmpegImageProxy>(socket);
+	case ImageProxyType::J2K:
+		return make_shared<J2KImageProxy>(reader, socket);
+	}
+
+	throw NetworkError (_("Unexpected image type received by server"));
+}
@@ -34,9 +34,14 @@ extern "C" {
 }
 #include <dcp/types.h>
 #include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/utility.hpp>
+#include <string>
 
 
+class BinaryDescriptorReader;
+class BinaryDescriptorWriter;
+class Digester;
 class Image;
 class Socket;
 
@@ -102,19 +107,43 @@ public:
 		) const = 0;
 
 	virtual void add_metadata (xmlpp::Node *) const = 0;
+	/** Add the same things as add_metadata() to a binary descriptor */
+	virtual void add_metadata (BinaryDescriptorWriter& writer) const = 0;
 	virtual void write_to_socket (std::shared_ptr<Socket>) const = 0;
+	/** Add everything that decides what image() will return to a digest */
+	virtual void add_digest (Digester& digester) const = 0;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	virtual bool same (std::shared_ptr<const ImageProxy>) const = 0;
+	std::string fingerprint () const;
+	boost::optional<std::string> known_fingerprint () const;
 	/** Do any useful work that would speed up a subsequent call to ::image().
 	 *  This method may be called in a different thread to image().
 	 *  @return log2 of any scaling down that will be applied to the image.
 	 */
 	virtual int prepare (Image::Alignment, boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const { return 0; }
 	virtual size_t memory_used () const = 0;
+
+protected:
+	boost::optional<bool> same_fingerprint (ImageProxy const& other) const;
+
+private:
+	mutable boost::mutex _fingerprint_mutex;
+	/** digest of everything in add_digest(), worked out the first time that someone asks for it */
+	mutable boost::optional<std::string> _fingerprint;
+};
+
+
+/** Types of ImageProxy, as written to binary descriptors */
+enum class ImageProxyType
+{
+	RAW = 0,
+	FFMPEG = 1,
+	J2K = 2
 };
 
 
 std::shared_ptr<ImageProxy> image_proxy_factory (std::shared_ptr<cxml::Node> xml, std::shared_ptr<Socket> socket);
+std::shared_ptr<ImageProxy> image_proxy_factory (BinaryDescriptorReader& reader, std::shared_ptr<Socket> socket);
 
 
 #endif
@@ -0,0 +1,35 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "j2k_encode_backend.h"
+#include <dcp/j2k_transcode.h>
+#include <dcp/openjpeg_image.h>
+
+
+using std::shared_ptr;
+using std::string;
+
+
+dcp::ArrayData
+OpenJPEGEncodeBackend::encode (shared_ptr<dcp::OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool three_d, bool four_k, string comment)
+{
+	return dcp::compress_j2k (xyz, bandwidth, frames_per_second, three_d, four_k, comment);
+}
@@ -0,0 +1,93 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_J2K_ENCODE_BACKEND_H
+#define DCPOMATIC_J2K_ENCODE_BACKEND_H
+
+
+#include <dcp/array_data.h>
+#include <memory>
+#include <string>
+
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+
+/** @class J2KEncodeBackend
+ *  @brief Parent for classes which can compress an XYZ image to a JPEG2000 codestream suitable for a DCP.
+ *
+ *  An object of one of these classes is used by one encoding thread at a time, so
+ *  implementations can keep per-thread state (e.g. GPU buffers) between frames.
+ */
+class J2KEncodeBackend
+{
+public:
+	J2KEncodeBackend () {}
+	virtual ~J2KEncodeBackend () {}
+
+	J2KEncodeBackend (J2KEncodeBackend const&) = delete;
+	J2KEncodeBackend& operator= (J2KEncodeBackend const&) = delete;
+
+	/** @return name of this backend, for logging */
+	virtual std::string name () const = 0;
+
+	/** @param xyz Image to compress; this may be modified by the backend.
+	 *  @param bandwidth Bandwidth of the DCP in bits per second; for 3D this is shared between the eyes.
+	 *  @param frames_per_second Frame rate of the DCP.
+	 *  @param three_d true if this is one eye of a 3D DCP.
+	 *  @param four_k true for 4K, otherwise 2K.
+	 *  @param comment Comment to put in the codestream.
+	 */
+	virtual dcp::ArrayData encode (
+		std::shared_ptr<dcp::OpenJPEGImage> xyz,
+		int bandwidth,
+		int frames_per_second,
+		bool three_d,
+		bool four_k,
+		std::string comment
+		) = 0;
+};
+
+
+/** @class OpenJPEGEncodeBackend
+ *  @brief J2KEncodeBackend which uses OpenJPEG (via libdcp) on the CPU.
+ */
+class OpenJPEGEncodeBackend : public J2KEncodeBackend
+{
+public:
+	std::string name () const override {
+		return "openjpeg";
+	}
+
+	dcp::ArrayData encode (
+		std::shared_ptr<dcp::OpenJPEGImage> xyz,
+		int bandwidth,
+		int frames_per_second,
+		bool three_d,
+		bool four_k,
+		std::string comment
+		) override;
+};
+
+
+#endif
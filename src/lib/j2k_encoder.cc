@@ -29,15 +29,28 @@
 #include "cross.h"
 #include "dcp_video.h"
 #include "dcpomatic_log.h"
+#include "encode_server_connection.h"
 #include "encode_server_description.h"
 #include "encode_server_finder.h"
+#include "exceptions.h"
 #include "film.h"
+#include "j2k_encode_backend.h"
 #include "j2k_encoder.h"
+#include "j2k_frame_cache.h"
 #include "log.h"
+#include "memory_budget.h"
+#include "metrics.h"
+#ifdef DCPOMATIC_NVJPEG2K
+#include "nvjpeg2k_encode_backend.h"
+#endif
+#include "performance_report.h"
 #include "player_video.h"
 #include "util.h"
 #include "writer.h"
 #include <libcxml/cxml.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
 
 #include "i18n.h"
@@ -48,20 +61,67 @@ using std::exception;
 using std::list;
 using std::make_shared;
 using std::shared_ptr;
+using std::vector;
 using std::weak_ptr;
 using boost::optional;
 using dcp::Data;
 using namespace dcpomatic;
 
 
+/** Number of frames over which to measure the rate of each encoding thread */
+static int const worker_history_size = 16;
+/** Smallest and largest number of frames that each remote encoding thread sends to its server before waiting for replies */
+static int const minimum_remote_pipeline_depth = 2;
+static int const maximum_remote_pipeline_depth = 16;
+/** Longest time that a remote encoding thread will wait before trying its server again after a failure, in seconds */
+static int const maximum_remote_backoff = 60;
+
+
+static double
+time_now ()
+{
+	struct timeval tv;
+	gettimeofday (&tv, 0);
+	return seconds (tv);
+}
+
+
+/** Note the size of _queue, after it has changed */
+void
+J2KEncoder::queue_changed ()
+{
+	static auto& metric = Metrics::instance()->gauge("dcpomatic_encoder_queue_frames", "Video frames waiting to be J2K-encoded");
+	auto const frames = _queue.size();
+	metric.set (frames);
+	/* The frames in a film are usually much the same size, so this is close enough */
+	_queue_memory.set (frames * _frame_memory);
+}
+
+
+/** @return number of groups to split a queue of @p deques into so that workers pinned to
+ *  a NUMA node (by pin_thread_to_numa_node) steal work from their own node first.
+ */
+static int
+queue_groups (int deques)
+{
+	auto const nodes = numa_node_count ();
+	return deques % nodes == 0 ? nodes : 1;
+}
+
+
 /** @param film Film that we are encoding.
  *  @param writer Writer that we are using.
  */
 J2KEncoder::J2KEncoder(shared_ptr<const Film> film, Writer& writer)
 	: _film (film)
 	, _history (200)
+	, _queue (std::max(1U, boost::thread::hardware_concurrency()), queue_groups(std::max(1U, boost::thread::hardware_concurrency())))
 	, _writer (writer)
 {
+	if (auto cache = Config::instance()->j2k_frame_cache_directory()) {
+		_frame_cache = make_shared<J2KFrameCache>(*cache, static_cast<uint64_t>(Config::instance()->j2k_frame_cache_size()) * 1024 * 1024 * 1024);
+	}
+
 	servers_list_changed ();
 }
 
@@ -78,6 +138,7 @@ J2KEncoder::~J2KEncoder ()
 void
 J2KEncoder::begin ()
 {
+	_start_time = time_now ();
 	_server_found_connection = EncodeServerFinder::instance()->ServersListChanged.connect(
 		boost::bind(&J2KEncoder::servers_list_changed, this)
 		);
@@ -87,18 +148,31 @@ J2KEncoder::begin ()
 void
 J2KEncoder::end ()
 {
-	boost::mutex::scoped_lock lock (_queue_mutex);
-
+	LOG_GENERAL (N_("%1 frame(s) of J2K passed through; %2 re-encoded as they were not suitable"), _passed_through, _not_passed_through);
 	LOG_GENERAL (N_("Clearing queue of %1"), _queue.size ());
 
-	/* Keep waking workers until the queue is empty */
+	/* Wait for the workers to empty the queue */
 	while (!_queue.empty ()) {
 		rethrow ();
-		_empty_condition.notify_all ();
-		_full_condition.wait (lock);
+		_queue.wait_for_space (1);
 	}
 
-	lock.unlock ();
+	/* Now some workers are idle while others finish off the last frames.  If any of those frames
+	   are taking much longer than they should (perhaps because they are on a slow or stuck server)
+	   give them to the idle workers as well, and use whichever copy is finished first.
+	*/
+	while (outstanding()) {
+		rethrow ();
+		if (_queue.empty()) {
+			reissue_stragglers ();
+		} else if (!in_progress()) {
+			/* The only frames left are on the queue and nobody is taking them (perhaps because
+			   our servers are backing off) so mop them up below.
+			*/
+			break;
+		}
+		boost::this_thread::sleep (boost::posix_time::milliseconds(100));
+	}
 
 	LOG_GENERAL_NC (N_("Terminating encoder threads"));
 
@@ -110,6 +184,10 @@ J2KEncoder::end ()
 	/* Something might have been thrown during terminate_threads */
 	rethrow ();
 
+	if (_frame_cache) {
+		_frame_cache->prune ();
+	}
+
 	LOG_GENERAL (N_("Mopping up %1"), _queue.size());
 
 	/* The following sequence of events can occur in the above code:
@@ -121,19 +199,53 @@ J2KEncoder::end ()
 	     So just mop up anything left in the queue here.
 	*/
 
-	for (auto const& i: _queue) {
-		LOG_GENERAL(N_("Encode left-over frame %1"), i.index());
-		try {
-			_writer.write(
-				make_shared<dcp::ArrayData>(i.encode_locally()),
-				i.index(),
-				i.eyes()
-				);
-			frame_done ();
-		} catch (std::exception& e) {
-			LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
+	auto left_over = _queue.drain ();
+	if (left_over.empty()) {
+		return;
+	}
+
+	/* There could be a few of these, and they are the only thing holding up the end of the job,
+	   so encode them in parallel.
+	*/
+	vector<DCPVideo> frames (left_over.begin(), left_over.end());
+	std::atomic<size_t> next (0);
+
+	auto mop_up = [this, &frames, &next]() {
+		start_of_thread ("J2KEncoder-mop-up");
+		while (true) {
+			auto const index = next++;
+			if (index >= frames.size()) {
+				break;
+			}
+			auto const& frame = frames[index];
+			LOG_GENERAL(N_("Encode left-over frame %1"), frame.index());
+			try {
+				auto encoded = make_shared<dcp::ArrayData>(frame.encode_locally());
+				/* This might be a re-issued copy of a frame that has already been written */
+				if (claim(-1, frame)) {
+					_writer.write(encoded, frame.index(), frame.eyes());
+					{
+						boost::mutex::scoped_lock lm (_report_mutex);
+						++_frames_by_encoder["local"];
+					}
+					frame_done ();
+				}
+			} catch (std::exception& e) {
+				LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
+			} catch (...) {
+				store_current ();
+			}
 		}
+	};
+
+	boost::thread_group threads;
+	auto const count = std::min(static_cast<size_t>(std::max(1U, boost::thread::hardware_concurrency())), frames.size());
+	for (size_t i = 0; i < count; ++i) {
+		threads.create_thread (mop_up);
 	}
+	threads.join_all ();
+
+	rethrow ();
 }
 
 
@@ -147,6 +259,17 @@ J2KEncoder::current_encoding_rate () const
 }
 
 
+/** Fill in the parts of @p report that we know about */
+void
+J2KEncoder::fill_report (PerformanceReport& report) const
+{
+	boost::mutex::scoped_lock lm (_report_mutex);
+	report.frames_per_second = _frames_per_second;
+	report.frames_by_encoder = _frames_by_encoder;
+	report.passed_through = _passed_through;
+}
+
+
 /** @return Number of video frames that have been queued for encoding */
 int
 J2KEncoder::video_frames_enqueued () const
@@ -164,6 +287,66 @@ void
 J2KEncoder::frame_done ()
 {
 	_history.event ();
+
+	{
+		boost::mutex::scoped_lock lm (_report_mutex);
+		auto const second = static_cast<size_t>(std::max(0.0, time_now() - _start_time));
+		if (_frames_per_second.size() <= second) {
+			_frames_per_second.resize (second + 1);
+		}
+		++_frames_per_second[second];
+	}
+
+	static auto& frames = Metrics::instance()->counter("dcpomatic_encoder_frames_total", "Video frames given to the writer by the J2K encoder");
+	static auto& rate = Metrics::instance()->gauge("dcpomatic_encoder_frames_per_second", "Recent rate at which the J2K encoder is giving video frames to the writer");
+	frames.add ();
+	rate.set (_history.rate().get_value_or(0));
+}
+
+
+/** Caller must hold a lock on _threads_mutex.
+ *  @param pv Next frame that we are going to queue.
+ *  @return Number of frames that we should allow into the queue.
+ */
+size_t
+J2KEncoder::queue_limit (shared_ptr<const PlayerVideo> pv) const
+{
+	/* Start with twice the thread count, allowing one thing in the queue even
+	   when there are no threads.
+	*/
+	auto limit = _threads->size() * 2 + 1;
+
+	/* While a frame is being done by our slowest thread (perhaps one talking to a remote
+	   server over a long round-trip) all the threads together will get through roughly
+	   total_rate / slowest_rate frames.  Try to keep that many queued so that no thread
+	   goes hungry while we are waiting for the player.
+	*/
+	float total_rate = 0;
+	optional<float> slowest_rate;
+	for (auto history: _worker_history) {
+		if (auto rate = history->rate()) {
+			total_rate += *rate;
+			slowest_rate = slowest_rate ? std::min(*slowest_rate, *rate) : *rate;
+		}
+	}
+
+	if (slowest_rate && *slowest_rate > 0) {
+		limit = std::max(limit, static_cast<size_t>(std::ceil(total_rate / *slowest_rate)) + _threads->size());
+	}
+
+	/* But don't hold more frames than we have memory for, either in our own limit or in
+	 * what the rest of the pipeline has left of the memory budget.
+	 */
+	auto const frame_memory = pv->memory_used();
+	if (frame_memory > 0) {
+		auto memory_limit = static_cast<size_t>(Config::instance()->encode_queue_memory_limit()) * 1024 * 1024;
+		if (auto available = MemoryBudget::instance()->available(MemoryBudget::Subsystem::ENCODER_QUEUE)) {
+			memory_limit = std::min(memory_limit, static_cast<size_t>(*available));
+		}
+		limit = std::min(limit, std::max(static_cast<size_t>(1), memory_limit / frame_memory));
+	}
+
+	return limit;
 }
 
 
@@ -181,20 +364,19 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 	_waker.nudge ();
 
 	size_t threads = 0;
+	size_t limit = 0;
 	{
 		boost::mutex::scoped_lock lm (_threads_mutex);
 		threads = _threads->size();
+		limit = queue_limit (pv);
 	}
 
-	boost::mutex::scoped_lock queue_lock (_queue_mutex);
-
-	/* Wait until the queue has gone down a bit.  Allow one thing in the queue even
-	   when there are no threads.
-	*/
-	while (_queue.size() >= (threads * 2) + 1) {
-		LOG_TIMING ("decoder-sleep queue=%1 threads=%2", _queue.size(), threads);
-		_full_condition.wait (queue_lock);
-		LOG_TIMING ("decoder-wake queue=%1 threads=%2", _queue.size(), threads);
+	/* Wait until the queue has gone down a bit */
+	while (_queue.size() >= limit) {
+		LOG_TIMING ("decoder-sleep queue=%1 threads=%2 limit=%3", _queue.size(), threads, limit);
+		_queue.wait_for_space (limit);
+		LOG_TIMING ("decoder-wake queue=%1 threads=%2 limit=%3", _queue.size(), threads, limit);
+		rethrow ();
 	}
 
 	_writer.rethrow();
@@ -211,37 +393,93 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 		LOG_DEBUG_ENCODE("Frame @ %1 FAKE", to_string(time));
 		_writer.fake_write(position, pv->eyes ());
 		frame_done ();
-	} else if (pv->has_j2k() && !_film->reencode_j2k()) {
+	} else if (can_pass_through(pv)) {
 		LOG_DEBUG_ENCODE("Frame @ %1 J2K", to_string(time));
 		/* This frame already has J2K data, so just write it */
 		_writer.write(pv->j2k(), position, pv->eyes ());
+		++_passed_through;
 		frame_done ();
-	} else if (_last_player_video[pv->eyes()] && _writer.can_repeat(position) && pv->same(_last_player_video[pv->eyes()])) {
-		LOG_DEBUG_ENCODE("Frame @ %1 REPEAT", to_string(time));
-		_writer.repeat(position, pv->eyes());
+		remember (pv, position);
+	} else if (auto source = find_recent(pv, position)) {
+		LOG_DEBUG_ENCODE("Frame @ %1 REPEAT of %2", to_string(time), *source);
+		_writer.repeat(position, pv->eyes(), *source);
 	} else {
 		LOG_DEBUG_ENCODE("Frame @ %1 ENCODE", to_string(time));
 		/* Queue this new frame for encoding */
 		LOG_TIMING ("add-frame-to-queue queue=%1", _queue.size ());
-		_queue.push_back (DCPVideo(
-				pv,
-				position,
-				_film->video_frame_rate(),
-				_film->j2k_bandwidth(),
-				_film->resolution()
-				));
-
-		/* The queue might not be empty any more, so notify anything which is
-		   waiting on that.
-		*/
-		_empty_condition.notify_all ();
+		DCPVideo frame (
+			pv,
+			position,
+			_film->video_frame_rate(),
+			position < static_cast<Frame>(_frame_bandwidths.size()) ? _frame_bandwidths[position] : _film->j2k_bandwidth(),
+			_film->resolution()
+			);
+		{
+			boost::mutex::scoped_lock lm (_outstanding_mutex);
+			Outstanding outstanding;
+			outstanding.frame = frame;
+			_outstanding[std::make_pair(frame.index(), frame.eyes())] = outstanding;
+		}
+		_frame_memory = pv->memory_used();
+		_queue.push_back (frame);
+		queue_changed ();
+		remember (pv, position);
 	}
 
-	_last_player_video[pv->eyes()] = pv;
 	_last_player_video_time = time;
 }
 
 
+/** @return true if @p pv has J2K data that we can write to the DCP as it is */
+bool
+J2KEncoder::can_pass_through (shared_ptr<const PlayerVideo> pv)
+{
+	if (!pv->has_j2k() || _film->reencode_j2k()) {
+		return false;
+	}
+
+	auto const frames_per_second = _film->video_frame_rate() * (_film->three_d() ? 2 : 1);
+	if (!j2k_can_pass_through(*pv->j2k(), frames_per_second, Config::instance()->maximum_j2k_bandwidth())) {
+		++_not_passed_through;
+		return false;
+	}
+
+	return true;
+}
+
+
+/** Look for a recently-written frame which is the same as @p pv and can be repeated at @p position.
+ *  If there is one, it becomes the most recently used.
+ *  @return Position of the frame to repeat, if there is one.
+ */
+optional<Frame>
+J2KEncoder::find_recent (shared_ptr<const PlayerVideo> pv, Frame position)
+{
+	for (auto i = _recent_frames.begin(); i != _recent_frames.end(); ++i) {
+		if (i->player_video->eyes() == pv->eyes() && _writer.can_repeat(position, i->position) && pv->same(i->player_video)) {
+			/* Keep this in step with the way ReelWriter ages its recently-written frames */
+			_recent_frames.splice (_recent_frames.begin(), _recent_frames, i);
+			return _recent_frames.front().position;
+		}
+	}
+
+	return {};
+}
+
+
+/** Note that the frame @p pv has been given to the writer at @p position, so that
+ *  it can be repeated if an identical one comes along soon.
+ */
+void
+J2KEncoder::remember (shared_ptr<PlayerVideo> pv, Frame position)
+{
+	_recent_frames.push_front ({pv, position});
+	while (_recent_frames.size() > static_cast<size_t>(Writer::repeat_history)) {
+		_recent_frames.pop_back ();
+	}
+}
+
+
 /** Caller must hold a lock on _threads_mutex */
 void
 J2KEncoder::terminate_threads ()
@@ -265,113 +503,453 @@ J2KEncoder::terminate_threads ()
 }
 
 
+/** Look for a frame in the cache.
+ *  @param encoded Filled in with the cached data, if it is there.
+ *  @return Digest to use to put the frame into the cache once it has been encoded, if
+ *  we are using a cache and the frame was not already there.
+ */
+optional<std::string>
+J2KEncoder::cache_digest (DCPVideo const& vf, shared_ptr<Data>& encoded) const
+{
+	if (!_frame_cache) {
+		return {};
+	}
+
+	auto digest = vf.cache_digest ();
+	if (auto data = _frame_cache->get(digest)) {
+		LOG_DEBUG_ENCODE ("Frame %1 found in cache", vf.index());
+		encoded = make_shared<dcp::ArrayData>(std::move(*data));
+		return {};
+	}
+
+	return digest;
+}
+
+
+/** Should be called by encoding thread @p worker when it has some encoded data for a frame */
 void
-J2KEncoder::encoder_thread (optional<EncodeServerDescription> server)
+J2KEncoder::frame_encoded (int worker, DCPVideo const& vf, shared_ptr<Data> encoded, optional<std::string> digest)
+{
+	if (digest) {
+		_frame_cache->put (*digest, *encoded);
+	}
+
+	if (!claim(worker, vf)) {
+		LOG_DEBUG_ENCODE ("Frame %1 has already been written by another worker", vf.index());
+		return;
+	}
+
+	_writer.write(encoded, vf.index(), vf.eyes());
+	_worker_history[worker]->event();
+	{
+		boost::mutex::scoped_lock lm (_report_mutex);
+		++_frames_by_encoder[_worker_names[worker]];
+	}
+	frame_done ();
+}
+
+
+/** Should be called by encoding thread @p worker when it takes @p vf from the queue */
+void
+J2KEncoder::started (int worker, DCPVideo const& vf)
+{
+	boost::mutex::scoped_lock lm (_outstanding_mutex);
+	auto i = _outstanding.find (std::make_pair(vf.index(), vf.eyes()));
+	/* If this is a re-issued copy the original worker is still going, and we want to
+	   keep its start time.
+	*/
+	if (i != _outstanding.end() && i->second.worker == -1) {
+		i->second.worker = worker;
+		i->second.start = time_now ();
+	}
+}
+
+
+/** Should be called by encoding thread @p worker to put @p vf back on the queue after it failed to encode it */
+void
+J2KEncoder::requeue (int worker, DCPVideo const& vf)
+{
+	{
+		boost::mutex::scoped_lock lm (_outstanding_mutex);
+		auto i = _outstanding.find (std::make_pair(vf.index(), vf.eyes()));
+		if (i == _outstanding.end()) {
+			/* Someone else has already written it */
+			return;
+		}
+		if (i->second.worker == worker) {
+			i->second.worker = -1;
+		}
+	}
+
+	_queue.push_front (worker, vf);
+}
+
+
+/** Note that @p vf is about to be written by @p worker (or by a mop-up thread if @p worker is -1).
+ *  @return true if it should be written, or false if another worker has already written it.
+ */
+bool
+J2KEncoder::claim (int worker, DCPVideo const& vf)
+{
+	boost::mutex::scoped_lock lm (_outstanding_mutex);
+	auto i = _outstanding.find (std::make_pair(vf.index(), vf.eyes()));
+	if (i == _outstanding.end()) {
+		return false;
+	}
+
+	if (worker >= 0 && i->second.worker == worker && worker < static_cast<int>(_worker_latency.size())) {
+		auto const latency = time_now() - i->second.start;
+		auto& smoothed = _worker_latency[worker];
+		smoothed = smoothed == 0 ? latency : (smoothed * 0.9 + latency * 0.1);
+	}
+
+	_outstanding.erase (i);
+	return true;
+}
+
+
+/** @return true if any frames have been queued but not yet written */
+bool
+J2KEncoder::outstanding () const
+{
+	boost::mutex::scoped_lock lm (_outstanding_mutex);
+	return !_outstanding.empty();
+}
+
+
+/** @return true if any worker is working on a frame */
+bool
+J2KEncoder::in_progress () const
+{
+	boost::mutex::scoped_lock lm (_outstanding_mutex);
+	for (auto const& i: _outstanding) {
+		if (i.second.worker != -1) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/** Put a second copy of any frame which is taking much longer than its worker usually takes onto the queue.
+ *  This must only be called from the thread that calls encode().
+ */
+void
+J2KEncoder::reissue_stragglers ()
+{
+	/* Take a frame to be late if it takes this many times as long as usual */
+	double const factor = 3;
+	/* ...and at least this many seconds */
+	double const minimum = 1;
+	/* Time to allow for a worker that has not finished any frames yet */
+	double const unknown = 30;
+
+	list<DCPVideo> late;
+	{
+		boost::mutex::scoped_lock lm (_outstanding_mutex);
+		auto const now = time_now ();
+		for (auto& i: _outstanding) {
+			if (i.second.worker == -1 || i.second.reissued) {
+				continue;
+			}
+			double allowed = unknown;
+			if (i.second.worker < static_cast<int>(_worker_latency.size()) && _worker_latency[i.second.worker] > 0) {
+				allowed = std::max(minimum, _worker_latency[i.second.worker] * factor);
+			}
+			if ((now - i.second.start) > allowed) {
+				i.second.reissued = true;
+				late.push_back (*i.second.frame);
+			}
+		}
+	}
+
+	for (auto const& i: late) {
+		LOG_GENERAL (N_("Frame %1 is late; giving it to another worker as well"), i.index());
+		_queue.push_back (i);
+	}
+}
+
+
+void
+J2KEncoder::encoder_thread (int worker, bool gpu)
 try
 {
 	start_of_thread ("J2KEncoder");
 
-	if (server) {
-		LOG_TIMING ("start-encoder-thread thread=%1 server=%2", thread_id (), server->host_name ());
-	} else {
-		LOG_TIMING ("start-encoder-thread thread=%1 server=localhost", thread_id ());
+	if (!gpu) {
+		/* Keep this worker, and the frames that it allocates, on one NUMA node */
+		pin_thread_to_numa_node (worker);
 	}
 
-	/* Number of seconds that we currently wait between attempts
-	   to connect to the server; not relevant for localhost
-	   encodings.
-	*/
-	int remote_backoff = 0;
+	LOG_TIMING ("start-encoder-thread thread=%1 server=localhost gpu=%2", thread_id (), gpu);
+
+	/* Backend for local encodes; this is only used by this thread, so it can keep state between frames */
+	shared_ptr<J2KEncodeBackend> backend = make_shared<OpenJPEGEncodeBackend>();
+#ifdef DCPOMATIC_NVJPEG2K
+	if (gpu) {
+		try {
+			backend = make_shared<NVJPEG2KEncodeBackend>(Config::instance()->gpu_device());
+		} catch (std::exception& e) {
+			LOG_ERROR (N_("Could not set up GPU encoding (%1); using the CPU instead"), e.what());
+		}
+	}
+#endif
 
 	while (true) {
 
 		LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
-		boost::mutex::scoped_lock lock (_queue_mutex);
-		while (_queue.empty ()) {
-			_empty_condition.wait (lock);
+		/* pop() can be interrupted while it waits, but not once it has taken a frame */
+		auto vf = _queue.pop (worker);
+		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _queue.size());
+		queue_changed ();
+
+		/* We've committed to encoding this frame, so we must not be interrupted until
+		   that has happened.  This block has thread interruption disabled.
+		*/
+		boost::this_thread::disable_interruption dis;
+		started (worker, vf);
+
+		LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf.index(), static_cast<int>(vf.eyes()));
+
+		shared_ptr<Data> encoded;
+		auto digest = cache_digest (vf, encoded);
+
+		if (!encoded) {
+			try {
+				LOG_TIMING ("start-local-encode thread=%1 frame=%2", thread_id(), vf.index());
+				encoded = make_shared<dcp::ArrayData>(vf.encode_locally(*backend));
+				LOG_TIMING ("finish-local-encode thread=%1 frame=%2", thread_id(), vf.index());
+			} catch (std::exception& e) {
+				/* This is very bad, so don't cope with it, just pass it on */
+				LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
+				throw;
+			}
 		}
 
+		frame_encoded (worker, vf, encoded, digest);
+	}
+}
+catch (boost::thread_interrupted& e) {
+	/* Ignore these and just stop the thread */
+	_queue.wake_producer ();
+}
+catch (...)
+{
+	store_current ();
+	/* Wake anything waiting for space in the queue so it can see the exception */
+	_queue.wake_producer ();
+}
+
+
+/** @return Number of frames that a remote encoding thread should keep on their way to
+ *  @p server, so that the server thread that it is feeding is not left idle while replies
+ *  and new requests cross a link with a round trip time of @p round_trip_time seconds.
+ */
+static int
+remote_pipeline_depth (EncodeServerDescription const& server, double round_trip_time)
+{
+	/* Guess one frame per second per thread if we don't know better */
+	double frame_time = 1;
+	auto const fps = server.frames_per_second ();
+	if (fps && *fps > 0) {
+		frame_time = server.threads() / *fps;
+	}
+
+	auto const depth = minimum_remote_pipeline_depth + static_cast<int>(ceil(round_trip_time / frame_time));
+	return std::max(minimum_remote_pipeline_depth, std::min(maximum_remote_pipeline_depth, depth));
+}
+
+
+/** Thread which sends frames to a remote server over a connection that it keeps open,
+ *  with enough frames on their way at any one time to cover the time that they take to
+ *  cross the network (see remote_pipeline_depth()).
+ *
+ *  If the connection fails after it has been working the frames that were on it are put
+ *  back at the front of our queue and we reconnect straight away, so that a dropped link
+ *  (say, to a machine on the other side of the internet) costs us the time to re-send
+ *  those frames and no more.  We only back off if we cannot get any work done at all.
+ */
+void
+J2KEncoder::remote_encoder_thread (int worker, EncodeServerDescription server)
+try
+{
+	start_of_thread ("J2KEncoder-remote");
+
+	LOG_TIMING ("start-encoder-thread thread=%1 server=%2", thread_id (), server.host_name ());
+
+	/* A frame that has been sent to the server, and the digest to cache it with when it comes back */
+	struct InFlight
+	{
+		DCPVideo frame;
+		optional<std::string> digest;
+		/* time that we started to send it */
+		double sent;
+	};
+
+	Metrics::Labels const labels = {{ "server", server.host_name() }};
+	auto& latency = Metrics::instance()->histogram(
+		"dcpomatic_remote_encode_seconds", "Time from starting to send a frame to a remote server to getting its reply back",
+		{ 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30 }, labels
+		);
+	auto& failures = Metrics::instance()->counter("dcpomatic_remote_encode_failures_total", "Times that a remote encoding thread lost its server", labels);
+
+	shared_ptr<EncodeServerConnection> connection;
+	/* Time that connection was last used; the server will give up on it if it is idle for too long */
+	struct timeval last_used = { 0, 0 };
+	/* Number of frames that we keep on their way to the server */
+	int depth = minimum_remote_pipeline_depth;
+	/* true if we have had at least one reply on connection */
+	bool connection_worked = false;
+
+	/* Number of seconds that we wait after a failure before trying the server again.  This doubles
+	   with each failure and halves with each success, so that a server which fails now and again
+	   does not keep being left idle for long periods, but one which has gone away is not
+	   bothered too often.
+	*/
+	int backoff = 0;
+
+	while (true) {
+
+		list<InFlight> in_flight;
+		bool failed = false;
+		bool busy = false;
+
+		/* pop() can be interrupted while it waits, but not once it has taken a frame */
+		LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
+		auto first = _queue.pop (worker);
 		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _queue.size());
-		auto vf = _queue.front ();
+		queue_changed ();
 
-		/* We're about to commit to either encoding this frame or putting it back onto the queue,
-		   so we must not be interrupted until one or other of these things have happened.  This
-		   block has thread interruption disabled.
-		*/
 		{
+			/* Until everything in in_flight has been written or put back on the queue
+			   we must not be interrupted.
+			*/
 			boost::this_thread::disable_interruption dis;
 
-			LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf.index(), static_cast<int>(vf.eyes()));
-			_queue.pop_front ();
+			started (worker, first);
+			optional<DCPVideo> next = first;
 
-			lock.unlock ();
+			try {
+				struct timeval now;
+				gettimeofday (&now, 0);
+				if (connection && (seconds(now) - seconds(last_used)) > 20) {
+					connection.reset ();
+				}
 
-			shared_ptr<Data> encoded;
+				while (next || !in_flight.empty()) {
+					/* Keep the pipeline full */
+					while (next && static_cast<int>(in_flight.size()) < depth) {
+						auto frame = *next;
+						next = boost::none;
+						shared_ptr<Data> encoded;
+						auto digest = cache_digest (frame, encoded);
+						if (encoded) {
+							frame_encoded (worker, frame, encoded, digest);
+						} else {
+							in_flight.push_back ({frame, digest, 0});
+							if (!connection) {
+								connection = make_shared<EncodeServerConnection>(server);
+								connection_worked = false;
+								depth = remote_pipeline_depth (server, connection->round_trip_time());
+								LOG_DEBUG_ENCODE (
+									"Connected to %1 with round trip time %2s; keeping %3 frames in flight",
+									server.host_name(), connection->round_trip_time(), depth
+									);
+							}
+							LOG_TIMING ("start-remote-send thread=%1 frame=%2", thread_id(), frame.index());
+							in_flight.back().sent = time_now();
+							connection->send (frame);
+						}
+						next = _queue.try_pop (worker);
+						if (next) {
+							started (worker, *next);
+						}
+					}
 
-			/* We need to encode this input */
-			if (server) {
-				try {
-					encoded = make_shared<dcp::ArrayData>(vf.encode_remotely(server.get()));
+					if (in_flight.empty()) {
+						break;
+					}
 
-					if (remote_backoff > 0) {
-						LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server->host_name ());
+					auto reply = connection->receive ();
+					connection_worked = true;
+					auto i = std::find_if (in_flight.begin(), in_flight.end(), [&reply](InFlight const& f) {
+						return f.frame.index() == reply.index && f.frame.eyes() == reply.eyes;
+					});
+					if (i == in_flight.end()) {
+						throw NetworkError (String::compose("Server returned unexpected frame %1", reply.index));
 					}
+					latency.observe (time_now() - i->sent);
+
+					if (reply.encoded) {
+						frame_encoded (worker, i->frame, make_shared<dcp::ArrayData>(std::move(*reply.encoded)), i->digest);
+					} else if (reply.status == EncodeServerConnection::Status::BUSY) {
+						/* Let someone else do this one, and don't send any more for a moment */
+						LOG_DEBUG_ENCODE ("%1 is busy; pushing frame %2 back onto queue", server.host_name(), i->frame.index());
+						requeue (worker, i->frame);
+						if (next) {
+							requeue (worker, *next);
+							next = boost::none;
+						}
+						busy = true;
+					} else {
+						LOG_GENERAL (N_("[%1] Server could not encode frame %2; pushing it back onto queue"), thread_id(), i->frame.index());
+						requeue (worker, i->frame);
+					}
+					in_flight.erase (i);
+				}
 
-					/* This job succeeded, so remove any backoff */
-					remote_backoff = 0;
+				gettimeofday (&last_used, 0);
 
-				} catch (std::exception& e) {
-					if (remote_backoff < 60) {
-						/* back off more */
-						remote_backoff += 10;
+				if (backoff > 0) {
+					/* This all worked, so ease off the backoff */
+					backoff /= 2;
+					if (backoff == 0) {
+						LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server.host_name ());
 					}
-					LOG_ERROR (
-						N_("Remote encode of %1 on %2 failed (%3); thread sleeping for %4s"),
-						vf.index(), server->host_name(), e.what(), remote_backoff
-						);
 				}
 
-			} else {
-				try {
-					LOG_TIMING ("start-local-encode thread=%1 frame=%2", thread_id(), vf.index());
-					encoded = make_shared<dcp::ArrayData>(vf.encode_locally());
-					LOG_TIMING ("finish-local-encode thread=%1 frame=%2", thread_id(), vf.index());
-				} catch (std::exception& e) {
-					/* This is very bad, so don't cope with it, just pass it on */
-					LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
-					throw;
+			} catch (std::exception& e) {
+				connection.reset ();
+				failures.add ();
+				if (next) {
+					requeue (worker, *next);
+				}
+				/* Other threads can steal these back while we are backing off */
+				for (auto const& i: in_flight) {
+					LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), i.frame.index());
+					requeue (worker, i.frame);
+				}
+				if (connection_worked) {
+					/* The link dropped, but the server was there a moment ago, so try it again straight away */
+					connection_worked = false;
+					LOG_ERROR (N_("Remote encode on %1 failed (%2); reconnecting"), server.host_name(), e.what());
+				} else {
+					backoff = std::min(maximum_remote_backoff, std::max(1, backoff * 2));
+					failed = true;
+					LOG_ERROR (
+						N_("Remote encode on %1 failed (%2); thread sleeping for %3s"),
+						server.host_name(), e.what(), backoff
+						);
 				}
-			}
-
-			if (encoded) {
-				_writer.write(encoded, vf.index(), vf.eyes());
-				frame_done ();
-			} else {
-				lock.lock ();
-				LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf.index());
-				_queue.push_front (vf);
-				lock.unlock ();
 			}
 		}
 
-		if (remote_backoff > 0) {
-			boost::this_thread::sleep (boost::posix_time::seconds (remote_backoff));
+		if (failed) {
+			boost::this_thread::sleep (boost::posix_time::seconds (backoff));
+		} else if (busy) {
+			boost::this_thread::sleep (boost::posix_time::milliseconds (500));
 		}
-
-		/* The queue might not be full any more, so notify anything that is waiting on that */
-		lock.lock ();
-		_full_condition.notify_all ();
 	}
 }
 catch (boost::thread_interrupted& e) {
 	/* Ignore these and just stop the thread */
-	_full_condition.notify_all ();
+	_queue.wake_producer ();
 }
 catch (...)
 {
 	store_current ();
-	/* Wake anything waiting on _full_condition so it can see the exception */
-	_full_condition.notify_all ();
+	/* Wake anything waiting for space in the queue so it can see the exception */
+	_queue.wake_producer ();
 }
 
 
@@ -382,18 +960,41 @@ J2KEncoder::servers_list_changed ()
 
 	terminate_threads ();
 	_threads = make_shared<boost::thread_group>();
+	_worker_history.clear ();
+	_worker_names.clear ();
+	{
+		boost::mutex::scoped_lock lm2 (_outstanding_mutex);
+		_worker_latency.clear ();
+		/* Frames that the old workers had taken are back on the queue, or will be mopped up at the end */
+		for (auto& i: _outstanding) {
+			i.second.worker = -1;
+		}
+	}
 
 	/* XXX: could re-use threads */
 
+	/* Index of each worker, used to choose its part of _queue and its _worker_history */
+	int worker = 0;
+
 	if (!Config::instance()->only_servers_encode ()) {
 		for (int i = 0; i < Config::instance()->master_encoding_threads (); ++i) {
+			_worker_history.push_back (make_shared<EventHistory>(worker_history_size));
+			_worker_names.push_back ("local");
 #ifdef DCPOMATIC_LINUX
-			auto t = _threads->create_thread(boost::bind(&J2KEncoder::encoder_thread, this, optional<EncodeServerDescription>()));
+			auto t = _threads->create_thread(boost::bind(&J2KEncoder::encoder_thread, this, worker++, false));
 			pthread_setname_np (t->native_handle(), "encode-worker");
 #else
-			_threads->create_thread(boost::bind(&J2KEncoder::encoder_thread, this, optional<EncodeServerDescription>()));
+			_threads->create_thread(boost::bind(&J2KEncoder::encoder_thread, this, worker++, false));
 #endif
 		}
+
+#ifdef DCPOMATIC_NVJPEG2K
+		for (int i = 0; i < Config::instance()->gpu_encoding_threads(); ++i) {
+			_worker_history.push_back (make_shared<EventHistory>(worker_history_size));
+			_worker_names.push_back ("GPU");
+			_threads->create_thread(boost::bind(&J2KEncoder::encoder_thread, this, worker++, true));
+		}
+#endif
 	}
 
 	for (auto i: EncodeServerFinder::instance()->servers()) {
@@ -401,11 +1002,21 @@ J2KEncoder::servers_list_changed ()
 			continue;
 		}
 
-		LOG_GENERAL (N_("Adding %1 worker threads for remote %2"), i.threads(), i.host_name ());
-		for (int j = 0; j < i.threads(); ++j) {
-			_threads->create_thread(boost::bind(&J2KEncoder::encoder_thread, this, i));
+		LOG_GENERAL (
+			N_("Adding %1 worker threads for remote %2 (%3 threads, %4 frames queued, CPU %5 [%6])"),
+			i.threads_to_use(), i.host_name(), i.threads(), i.queue_length(), i.cpu(), i.simd()
+			);
+		for (int j = 0; j < i.threads_to_use(); ++j) {
+			_worker_history.push_back (make_shared<EventHistory>(worker_history_size));
+			_worker_names.push_back (i.host_name());
+			_threads->create_thread(boost::bind(&J2KEncoder::remote_encoder_thread, this, worker++, i));
 		}
 	}
 
+	{
+		boost::mutex::scoped_lock lm2 (_outstanding_mutex);
+		_worker_latency.resize (_worker_history.size());
+	}
+
 	_writer.set_encoder_threads(_threads->size());
 }
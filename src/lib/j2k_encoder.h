@@ -29,24 +29,29 @@
 
 
 #include "cross.h"
-#include "enum_indexed_vector.h"
 #include "event_history.h"
 #include "exception_store.h"
+#include "dcp_video.h"
+#include "memory_budget.h"
 #include "util.h"
+#include "work_stealing_queue.h"
 #include "writer.h"
 #include <boost/optional.hpp>
 #include <boost/signals2.hpp>
 #include <boost/thread.hpp>
-#include <boost/thread/condition.hpp>
 #include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <list>
+#include <map>
 #include <stdint.h>
+#include <vector>
 
 
-class DCPVideo;
 class EncodeServerDescription;
 class Film;
+class J2KFrameCache;
 class Job;
+class PerformanceReport;
 class PlayerVideo;
 
 
@@ -54,7 +59,10 @@ class PlayerVideo;
  *  @brief Class to manage encoding to J2K.
  *
  *  This class keeps a queue of frames to be encoded and distributes
- *  the work around threads and encoding servers.
+ *  the work around threads and encoding servers.  Each thread has its own
+ *  part of the queue, and threads with nothing to do steal from the others.
+ *  At the end of a run, frames which are taking much longer than usual are given
+ *  to idle threads as well, and whichever copy is finished first is used.
  */
 class J2KEncoder : public ExceptionStore
 {
@@ -68,6 +76,13 @@ public:
 	/** Called to indicate that a processing run is about to begin */
 	void begin ();
 
+	/** Set the J2K bandwidth to use for each DCP frame, rather than using the film's
+	 *  bandwidth for all of them.  Must be called before any calls to encode().
+	 */
+	void set_frame_bandwidths (std::vector<int> bandwidths) {
+		_frame_bandwidths = bandwidths;
+	}
+
 	/** Called to pass a bit of video to be encoded as the next DCP frame */
 	void encode (std::shared_ptr<PlayerVideo> pv, dcpomatic::DCPTime time);
 
@@ -76,15 +91,31 @@ public:
 
 	boost::optional<float> current_encoding_rate () const;
 	int video_frames_enqueued () const;
+	void fill_report (PerformanceReport& report) const;
 
 	void servers_list_changed ();
 
 private:
 
 	void frame_done ();
-
-	void encoder_thread (boost::optional<EncodeServerDescription>);
+	bool can_pass_through (std::shared_ptr<const PlayerVideo> pv);
+	boost::optional<Frame> find_recent (std::shared_ptr<const PlayerVideo> pv, Frame position);
+	void remember (std::shared_ptr<PlayerVideo> pv, Frame position);
+	size_t queue_limit (std::shared_ptr<const PlayerVideo> pv) const;
+
+	boost::optional<std::string> cache_digest (DCPVideo const& vf, std::shared_ptr<dcp::Data>& encoded) const;
+	void frame_encoded (int worker, DCPVideo const& vf, std::shared_ptr<dcp::Data> encoded, boost::optional<std::string> digest);
+	void started (int worker, DCPVideo const& vf);
+	void requeue (int worker, DCPVideo const& vf);
+	bool claim (int worker, DCPVideo const& vf);
+	bool outstanding () const;
+	bool in_progress () const;
+	void reissue_stragglers ();
+
+	void encoder_thread (int worker, bool gpu);
+	void remote_encoder_thread (int worker, EncodeServerDescription server);
 	void terminate_threads ();
+	void queue_changed ();
 
 	/** Film that we are encoding */
 	std::shared_ptr<const Film> _film;
@@ -93,19 +124,70 @@ private:
 
 	boost::mutex _threads_mutex;
 	std::shared_ptr<boost::thread_group> _threads;
-
-	mutable boost::mutex _queue_mutex;
-	std::list<DCPVideo> _queue;
-	/** condition to manage thread wakeups when we have nothing to do */
-	boost::condition _empty_condition;
-	/** condition to manage thread wakeups when we have too much to do */
-	boost::condition _full_condition;
+	/** History of frames done by each of the threads in _threads, in the same order
+	 *  as the worker indices; used to estimate each thread's encode latency.
+	 */
+	std::vector<std::shared_ptr<EventHistory>> _worker_history;
+	/** Name of the encoder used by each of the threads in _threads, in the same order as _worker_history */
+	std::vector<std::string> _worker_names;
+
+	WorkStealingQueue<DCPVideo> _queue;
+	/** memory used by the most recent frame that we put on _queue */
+	std::atomic<size_t> _frame_memory{0};
+	/** memory used by the frames in _queue */
+	MemoryBudget::Share _queue_memory{MemoryBudget::Subsystem::ENCODER_QUEUE};
+
+	/** A frame which has been queued for encoding but not yet written */
+	struct Outstanding
+	{
+		boost::optional<DCPVideo> frame;
+		/** worker which took the frame from the queue, or -1 if it is still in the queue */
+		int worker = -1;
+		/** time that the worker took it, in seconds */
+		double start = 0;
+		/** true if a second copy has been put on the queue in case this one is slow */
+		bool reissued = false;
+	};
+
+	mutable boost::mutex _outstanding_mutex;
+	/** Frames which have been queued but not yet written, keyed by index and eyes; protected by _outstanding_mutex */
+	std::map<std::pair<int, Eyes>, Outstanding> _outstanding;
+	/** Smoothed time (in seconds) that each worker takes to get a frame written from when it takes
+	 *  it from the queue, or 0 if we don't know yet; protected by _outstanding_mutex.
+	 */
+	std::vector<double> _worker_latency;
 
 	Writer& _writer;
 	Waker _waker;
 
-	EnumIndexedVector<std::shared_ptr<PlayerVideo>, Eyes> _last_player_video;
+	/** Cache of encoded frames to look in before encoding, or nullptr */
+	std::shared_ptr<J2KFrameCache> _frame_cache;
+
+	/** A frame that we have recently given to the writer, which can be repeated if it comes up again */
+	struct RecentFrame
+	{
+		std::shared_ptr<PlayerVideo> player_video;
+		/** index of the frame within the DCP */
+		Frame position;
+	};
+
+	/** Up to Writer::repeat_history recently-written frames, most recently used first */
+	std::list<RecentFrame> _recent_frames;
+	/** J2K bandwidth for each DCP frame, or empty to use the film's J2K bandwidth */
+	std::vector<int> _frame_bandwidths;
 	boost::optional<dcpomatic::DCPTime> _last_player_video_time;
+	/** number of frames whose existing J2K data we have given straight to the writer */
+	int _passed_through = 0;
+	/** number of frames which had J2K data that we re-encoded because it was not suitable for the DCP */
+	int _not_passed_through = 0;
+
+	mutable boost::mutex _report_mutex;
+	/** time that begin() was called, in seconds */
+	double _start_time = 0;
+	/** frames given to the writer in each second since begin(); protected by _report_mutex */
+	std::vector<int> _frames_per_second;
+	/** frames encoded by each of the names in _worker_names; protected by _report_mutex */
+	std::map<std::string, int> _frames_by_encoder;
 
 	boost::signals2::scoped_connection _server_found_connection;
 };
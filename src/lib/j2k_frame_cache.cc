@@ -0,0 +1,133 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "cross.h"
+#include "dcpomatic_log.h"
+#include "j2k_frame_cache.h"
+#include <dcp/raw_convert.h>
+#include <algorithm>
+#include <vector>
+
+
+using std::pair;
+using std::string;
+using std::vector;
+using boost::optional;
+
+
+J2KFrameCache::J2KFrameCache (boost::filesystem::path directory, uint64_t maximum_size)
+	: _directory (directory)
+	, _maximum_size (maximum_size)
+{
+	boost::system::error_code ec;
+	boost::filesystem::create_directories (_directory, ec);
+}
+
+
+boost::filesystem::path
+J2KFrameCache::path (string digest) const
+{
+	/* Split into sub-directories so that we don't end up with millions of files in one place */
+	return _directory / digest.substr(0, 2) / (digest + ".j2c");
+}
+
+
+optional<dcp::ArrayData>
+J2KFrameCache::get (string digest) const
+{
+	auto const p = path (digest);
+
+	boost::system::error_code ec;
+	if (!boost::filesystem::exists(p, ec)) {
+		return {};
+	}
+
+	try {
+		dcp::ArrayData data (p);
+		/* Check for the SOC marker, just in case something has gone wrong with the file */
+		if (data.size() < 2 || data.data()[0] != 0xff || data.data()[1] != 0x4f) {
+			LOG_WARNING ("Ignoring bad cached J2K frame %1", p.string());
+			return {};
+		}
+		/* Mark this frame as recently-used so that prune() keeps it */
+		boost::filesystem::last_write_time (p, time(0), ec);
+		return data;
+	} catch (std::exception& e) {
+		LOG_WARNING ("Could not read cached J2K frame %1 (%2)", p.string(), e.what());
+	}
+
+	return {};
+}
+
+
+void
+J2KFrameCache::put (string digest, dcp::Data const& data)
+{
+	auto const p = path (digest);
+
+	try {
+		boost::filesystem::create_directories (p.parent_path());
+		/* Write to a temporary file then rename it so that get() never sees a partly-written frame */
+		auto temporary = p;
+		temporary += "." + dcp::raw_convert<string>(thread_id()) + ".tmp";
+		data.write (temporary);
+		boost::filesystem::rename (temporary, p);
+	} catch (std::exception& e) {
+		LOG_WARNING ("Could not write J2K frame to cache (%1)", e.what());
+	}
+}
+
+
+/** Remove the least-recently-used frames until the cache is no bigger than its maximum size */
+void
+J2KFrameCache::prune ()
+{
+	vector<pair<time_t, boost::filesystem::path>> frames;
+	uint64_t total = 0;
+
+	boost::system::error_code ec;
+	for (auto i = boost::filesystem::recursive_directory_iterator(_directory, ec); i != boost::filesystem::recursive_directory_iterator(); i.increment(ec)) {
+		if (ec) {
+			break;
+		}
+		if (boost::filesystem::is_regular_file(i->path(), ec)) {
+			total += boost::filesystem::file_size(i->path(), ec);
+			frames.push_back (make_pair(boost::filesystem::last_write_time(i->path(), ec), i->path()));
+		}
+	}
+
+	if (total <= _maximum_size) {
+		return;
+	}
+
+	LOG_GENERAL ("Pruning J2K frame cache of %1 bytes to %2", total, _maximum_size);
+
+	std::sort (frames.begin(), frames.end());
+	for (auto const& i: frames) {
+		if (total <= _maximum_size) {
+			break;
+		}
+		auto const size = boost::filesystem::file_size(i.second, ec);
+		if (boost::filesystem::remove(i.second, ec)) {
+			total -= std::min(total, static_cast<uint64_t>(size));
+		}
+	}
+}
@@ -0,0 +1,59 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_J2K_FRAME_CACHE_H
+#define DCPOMATIC_J2K_FRAME_CACHE_H
+
+
+#include <dcp/array_data.h>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <string>
+
+
+/** @class J2KFrameCache
+ *  @brief A store of J2K-encoded frames on disk, indexed by a digest of everything
+ *  that went into making them (see DCPVideo::cache_digest()).
+ *
+ *  This means that frames can be re-used when re-encoding, even by a different film.
+ *  Methods may be called from any thread.
+ */
+class J2KFrameCache
+{
+public:
+	/** @param directory Directory to keep frames in.
+	 *  @param maximum_size Size in bytes that prune() will reduce the cache to.
+	 */
+	J2KFrameCache (boost::filesystem::path directory, uint64_t maximum_size);
+
+	boost::optional<dcp::ArrayData> get (std::string digest) const;
+	void put (std::string digest, dcp::Data const& data);
+	void prune ();
+
+private:
+	boost::filesystem::path path (std::string digest) const;
+
+	boost::filesystem::path _directory;
+	uint64_t _maximum_size;
+};
+
+
+#endif
@@ -19,8 +19,12 @@
 */
 
 
+#include "binary_descriptor.h"
+#include "cpu_dispatch.h"
 #include "dcpomatic_assert.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
+#include "exceptions.h"
 #include "image.h"
 #include "j2k_image_proxy.h"
 #include <dcp/colour_conversion.h>
@@ -35,6 +39,11 @@
 LIBDCP_DISABLE_WARNINGS
 #include <libxml++/libxml++.h>
 LIBDCP_ENABLE_WARNINGS
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include <iostream>
 
 #include "i18n.h"
@@ -117,6 +126,118 @@ J2KImageProxy::J2KImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> soc
 }
 
 
+J2KImageProxy::J2KImageProxy (BinaryDescriptorReader& reader, shared_ptr<Socket> socket)
+	: _error (false)
+{
+	auto const width = reader.read_int32 ();
+	auto const height = reader.read_int32 ();
+	_size = dcp::Size (width, height);
+	if (reader.read_bool()) {
+		_eye = static_cast<dcp::Eye>(reader.read_int32());
+	}
+	auto const size = reader.read_int32 ();
+	if (size < 0) {
+		throw NetworkError (_("Frame description from client is corrupt"));
+	}
+	auto data = make_shared<ArrayData>(size);
+	/* As in the XML constructor, this is only used for encoding so the pixel format doesn't matter */
+	_pixel_format = AV_PIX_FMT_XYZ12LE;
+	socket->read (data->data(), data->size());
+	_data = data;
+}
+
+
+/** Interleave one row of three planar components from a decompressed JPEG2000 image into
+ *  packed 16-bit samples, shifting each one left by `shift' bits.  As with a plain
+ *  `*out++ = c << shift' the result is truncated to 16 bits.
+ */
+static void
+interleave_row_scalar (int const* c0, int const* c1, int const* c2, int width, int shift, uint16_t* out)
+{
+	for (int x = 0; x < width; ++x) {
+		*out++ = c0[x] << shift;
+		*out++ = c1[x] << shift;
+		*out++ = c2[x] << shift;
+	}
+}
+
+
+#if defined(__SSE2__)
+
+static void
+interleave_row_sse2 (int const* c0, int const* c1, int const* c2, int width, int shift, uint16_t* out)
+{
+	int x = 0;
+
+	auto const count = _mm_cvtsi32_si128(shift);
+	auto shift_to_16 = [count](int const* c) {
+		auto v = _mm_sll_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(c)), count);
+		/* Sign-extend the bottom 16 bits so that the saturating pack just truncates */
+		v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+		return _mm_packs_epi32(v, v);
+	};
+
+	/* Each pixel is written as a 64-bit store of its 3 samples and one junk sample, which is
+	 * then overwritten by the next pixel.  The last pixel in the row is always left to the
+	 * scalar code so that we never write past the end.
+	 */
+	for (; x + 5 <= width; x += 4) {
+		auto const ab = _mm_unpacklo_epi16(shift_to_16(c0 + x), shift_to_16(c1 + x));
+		auto const cc = shift_to_16(c2 + x);
+		auto const c = _mm_unpacklo_epi16(cc, cc);
+		auto const lo = _mm_unpacklo_epi32(ab, c);
+		auto const hi = _mm_unpackhi_epi32(ab, c);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out), lo);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 3), _mm_srli_si128(lo, 8));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 6), hi);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 9), _mm_srli_si128(hi, 8));
+		out += 12;
+	}
+
+	interleave_row_scalar (c0 + x, c1 + x, c2 + x, width - x, shift, out);
+}
+
+#elif defined(__ARM_NEON)
+
+static void
+interleave_row_neon (int const* c0, int const* c1, int const* c2, int width, int shift, uint16_t* out)
+{
+	int x = 0;
+
+	auto const count = vdupq_n_s32(shift);
+	auto shift_to_16 = [count](int const* c) {
+		auto const lo = vmovn_s32(vshlq_s32(vld1q_s32(c), count));
+		auto const hi = vmovn_s32(vshlq_s32(vld1q_s32(c + 4), count));
+		return vreinterpretq_u16_s16(vcombine_s16(lo, hi));
+	};
+
+	for (; x + 8 <= width; x += 8) {
+		uint16x8x3_t v;
+		v.val[0] = shift_to_16(c0 + x);
+		v.val[1] = shift_to_16(c1 + x);
+		v.val[2] = shift_to_16(c2 + x);
+		vst3q_u16(out, v);
+		out += 24;
+	}
+
+	interleave_row_scalar (c0 + x, c1 + x, c2 + x, width - x, shift, out);
+}
+
+#endif
+
+
+static dcpomatic::cpu::Kernel<void (int const*, int const*, int const*, int, int, uint16_t*)> interleave_row (
+	"interleave_row",
+	{
+		{ dcpomatic::cpu::ISA::SCALAR, &interleave_row_scalar },
+#if defined(__SSE2__)
+		{ dcpomatic::cpu::ISA::SSE2, &interleave_row_sse2 },
+#elif defined(__ARM_NEON)
+		{ dcpomatic::cpu::ISA::NEON, &interleave_row_neon },
+#endif
+	});
+
+
 int
 J2KImageProxy::prepare (Image::Alignment alignment, optional<dcp::Size> target_size) const
 {
@@ -159,12 +280,8 @@ J2KImageProxy::prepare (Image::Alignment alignment, optional<dcp::Size> target_s
 		int* decomp_2 = decompressed->data (2);
 		for (int y = 0; y < decompressed->size().height; ++y) {
 			auto q = reinterpret_cast<uint16_t *>(_image->data()[0] + y * _image->stride()[0]);
-			for (int x = 0; x < width; ++x) {
-				*q++ = decomp_0[p] << shift;
-				*q++ = decomp_1[p] << shift;
-				*q++ = decomp_2[p] << shift;
-				++p;
-			}
+			interleave_row (decomp_0 + p, decomp_1 + p, decomp_2 + p, width, shift, q);
+			p += width;
 		}
 	} catch (dcp::J2KDecompressionError& e) {
 		_image = make_shared<Image>(_pixel_format, _size, alignment);
@@ -204,6 +321,20 @@ J2KImageProxy::add_metadata (xmlpp::Node* node) const
 }
 
 
+void
+J2KImageProxy::add_metadata (BinaryDescriptorWriter& writer) const
+{
+	writer.add (static_cast<int32_t>(ImageProxyType::J2K));
+	writer.add (static_cast<int32_t>(_size.width));
+	writer.add (static_cast<int32_t>(_size.height));
+	writer.add (static_cast<bool>(_eye));
+	if (_eye) {
+		writer.add (static_cast<int32_t>(_eye.get()));
+	}
+	writer.add (static_cast<int32_t>(_data->size()));
+}
+
+
 void
 J2KImageProxy::write_to_socket (shared_ptr<Socket> socket) const
 {
@@ -211,14 +342,37 @@ J2KImageProxy::write_to_socket (shared_ptr<Socket> socket) const
 }
 
 
+void
+J2KImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (_size.width);
+	digester.add (_size.height);
+	digester.add (_eye ? static_cast<int>(_eye.get()) : -1);
+	digester.add (static_cast<int>(_pixel_format));
+	digester.add (_data->data(), _data->size());
+}
+
+
 bool
 J2KImageProxy::same (shared_ptr<const ImageProxy> other) const
 {
+	if (other.get() == this) {
+		return true;
+	}
+
 	auto jp = dynamic_pointer_cast<const J2KImageProxy>(other);
-	if (!jp) {
+	if (!jp || _data->size() != jp->_data->size()) {
 		return false;
 	}
 
+	if (_data == jp->_data) {
+		return true;
+	}
+
+	if (auto same = same_fingerprint(*jp)) {
+		return *same;
+	}
+
 	return *_data == *jp->_data;
 }
 
@@ -52,6 +52,7 @@ public:
 		);
 
 	J2KImageProxy (std::shared_ptr<cxml::Node> xml, std::shared_ptr<Socket> socket);
+	J2KImageProxy (BinaryDescriptorReader& reader, std::shared_ptr<Socket> socket);
 
 	/* For tests */
 	J2KImageProxy (dcp::ArrayData data, dcp::Size size, AVPixelFormat pixel_format);
@@ -62,7 +63,9 @@ public:
 		) const override;
 
 	void add_metadata (xmlpp::Node *) const override;
+	void add_metadata (BinaryDescriptorWriter& writer) const override;
 	void write_to_socket (std::shared_ptr<Socket> override) const override;
+	void add_digest (Digester& digester) const override;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	bool same (std::shared_ptr<const ImageProxy>) const override;
 	int prepare (Image::Alignment alignment, boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const override;
@@ -73,6 +73,16 @@ Job::~Job ()
 }
 
 
+bool
+Job::depends_on (Job const& earlier) const
+{
+	/* Jobs which read from storage (e.g. examining content) may run together, but
+	 * anything else waits for what was queued before it.
+	 */
+	return !parallel_storage() || !earlier.parallel_storage();
+}
+
+
 void
 Job::stop_thread ()
 {
@@ -676,3 +686,19 @@ Job::set_message (string m)
 	boost::mutex::scoped_lock lm (_state_mutex);
 	_message = m;
 }
+
+
+optional<string>
+Job::report () const
+{
+	boost::mutex::scoped_lock lm (_state_mutex);
+	return _report;
+}
+
+
+void
+Job::set_report (string r)
+{
+	boost::mutex::scoped_lock lm (_state_mutex);
+	_report = r;
+}
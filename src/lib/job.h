@@ -54,6 +54,37 @@ public:
 	virtual bool enable_notify () const {
 		return false;
 	}
+	/** The main thing that a job uses, which decides what it may run alongside */
+	enum class Resource {
+		/** encoding, which uses all the CPU that it can get */
+		ENCODE,
+		/** reading or writing files */
+		DISK,
+		/** sending or receiving over the network */
+		NETWORK,
+		/** nothing much */
+		LIGHT
+	};
+
+	/** @return the main thing that this job uses; JobManager runs jobs which use different
+	 *  resources at the same time, within a limit for each resource.
+	 */
+	virtual Resource resource () const {
+		return Resource::ENCODE;
+	}
+
+	/** @return a name for the storage that this job mostly reads from, if it should count towards a limit of
+	 *  jobs reading from that storage at once.  Jobs which give a storage and are for the same film may also
+	 *  run alongside each other.
+	 */
+	virtual boost::optional<std::string> parallel_storage () const {
+		return {};
+	}
+
+	/** @param earlier An unfinished job for the same film which comes before this one in the queue.
+	 *  @return true if this job must wait for earlier to finish before it starts.
+	 */
+	virtual bool depends_on (Job const& earlier) const;
 
 	void start ();
 	bool pause_by_user ();
@@ -74,6 +105,7 @@ public:
 	std::string error_details () const;
 
 	boost::optional<std::string> message () const;
+	boost::optional<std::string> report () const;
 
 	virtual std::string status () const;
 	std::string json_status () const;
@@ -98,6 +130,8 @@ public:
 	boost::signals2::signal<void()> Finished;
 	/** Emitted from the job thread when the job is finished */
 	boost::signals2::signal<void()> FinishedImmediate;
+	/** Emitted from the job thread when what resource() returns has changed */
+	boost::signals2::signal<void()> ResourceChanged;
 
 protected:
 
@@ -117,6 +151,7 @@ protected:
 	void set_state (State);
 	void set_error (std::string s, std::string d = "");
 	void set_message (std::string m);
+	void set_report (std::string r);
 	int elapsed_sub_time () const;
 	void check_for_interruption_or_pause ();
 	void stop_thread ();
@@ -130,7 +165,7 @@ private:
 
 	boost::thread _thread;
 
-	/** mutex for _state, _error*, _message */
+	/** mutex for _state, _error*, _message, _report */
 	mutable boost::mutex _state_mutex;
 	/** current state of the job */
 	State _state;
@@ -139,6 +174,8 @@ private:
 	std::string _error_details;
 	/** a message that should be given to the user when the job finishes */
 	boost::optional<std::string> _message;
+	/** a report on how the job went, which the user can look at once it has finished */
+	boost::optional<std::string> _report;
 
 	/** time that this job was started */
 	time_t _start_time;
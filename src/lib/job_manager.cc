@@ -25,18 +25,24 @@
 
 
 #include "analyse_audio_job.h"
+#include "analyse_crop_job.h"
 #include "analyse_subtitles_job.h"
+#include "config.h"
 #include "cross.h"
+#include "dcpomatic_assert.h"
 #include "film.h"
 #include "job.h"
 #include "job_manager.h"
 #include <boost/thread.hpp>
+#include <map>
 
 
 using std::dynamic_pointer_cast;
 using std::function;
 using std::list;
 using std::make_shared;
+using std::map;
+using std::max;
 using std::shared_ptr;
 using std::string;
 using std::weak_ptr;
@@ -46,6 +52,30 @@ using boost::optional;
 
 JobManager* JobManager::_instance = nullptr;
 
+/** Largest number of jobs which may read from the same storage at the same time */
+static int const max_parallel_jobs_per_storage = 2;
+
+
+/** @return Largest number of jobs using a given resource which may run at the same time */
+static int
+max_parallel_jobs (Job::Resource resource)
+{
+	switch (resource) {
+	case Job::Resource::ENCODE:
+		/* Encodes use all the CPU they can get, so there's no point in running more than one */
+		return 1;
+	case Job::Resource::DISK:
+		return max(1, Config::instance()->maximum_disk_jobs());
+	case Job::Resource::NETWORK:
+		return max(1, Config::instance()->maximum_network_jobs());
+	case Job::Resource::LIGHT:
+		return max(2U, boost::thread::hardware_concurrency());
+	}
+
+	DCPOMATIC_ASSERT (false);
+	return 1;
+}
+
 
 JobManager::JobManager ()
 {
@@ -163,23 +193,52 @@ JobManager::scheduler ()
 			break;
 		}
 
-		bool have_running = false;
+		/* Jobs run in the order of the list, with as many at once as the limit for each
+		   Job::Resource allows, and no more than a few reading from the same storage.  A
+		   job does not start until the earlier jobs for the same film that it depends on
+		   have finished.
+		*/
+		map<Job::Resource, int> running;
+		map<string, int> running_on;
+		list<shared_ptr<Job>> earlier;
 		for (auto i: _jobs) {
-			if (have_running && i->running()) {
-				i->pause_by_priority();
-			} else if (!have_running && (i->is_new() || i->paused_by_priority())) {
-				if (i->is_new()) {
-					_connections.push_back (i->FinishedImmediate.connect(bind(&JobManager::job_finished, this)));
-					i->start ();
-				} else {
-					i->resume ();
+			if (!i->is_new() && !i->running() && !i->paused_by_priority()) {
+				continue;
+			}
+
+			auto const resource = i->resource();
+			auto const storage = i->parallel_storage();
+			bool can_run = running[resource] < max_parallel_jobs(resource) && (!storage || running_on[*storage] < max_parallel_jobs_per_storage);
+			if (can_run && i->film()) {
+				for (auto j: earlier) {
+					if (j->film() == i->film() && i->depends_on(*j)) {
+						can_run = false;
+						break;
+					}
+				}
+			}
+
+			if (can_run) {
+				if (!i->running()) {
+					if (i->is_new()) {
+						_connections.push_back (i->FinishedImmediate.connect(bind(&JobManager::job_finished, this)));
+						_connections.push_back (i->ResourceChanged.connect(bind(&JobManager::job_resource_changed, this)));
+						i->start ();
+					} else {
+						i->resume ();
+					}
+					emit (boost::bind (boost::ref (ActiveJobsChanged), _last_active_job, i->json_name()));
+					_last_active_job = i->json_name ();
 				}
-				emit (boost::bind (boost::ref (ActiveJobsChanged), _last_active_job, i->json_name()));
-				_last_active_job = i->json_name ();
-				have_running = true;
-			} else if (!have_running && i->running()) {
-				have_running = true;
+				++running[resource];
+				if (storage) {
+					++running_on[*storage];
+				}
+			} else if (i->running()) {
+				i->pause_by_priority();
 			}
+
+			earlier.push_back (i);
 		}
 
 		_empty_condition.wait (lm);
@@ -200,6 +259,13 @@ JobManager::job_finished ()
 }
 
 
+void
+JobManager::job_resource_changed ()
+{
+	_empty_condition.notify_all ();
+}
+
+
 JobManager *
 JobManager::instance ()
 {
@@ -291,6 +357,41 @@ JobManager::analyse_subtitles (
 }
 
 
+void
+JobManager::analyse_crop (
+	shared_ptr<const Film> film,
+	shared_ptr<const Content> content,
+	boost::signals2::connection& connection,
+	function<void()> ready
+	)
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		for (auto i: _jobs) {
+			auto a = dynamic_pointer_cast<AnalyseCropJob> (i);
+			if (a && a->path() == film->crop_analysis_path(content)) {
+				i->when_finished (connection, ready);
+				return;
+			}
+		}
+	}
+
+	shared_ptr<AnalyseCropJob> job;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+
+		job = make_shared<AnalyseCropJob>(film, content);
+		connection = job->Finished.connect (ready);
+		_jobs.push_back (job);
+		_empty_condition.notify_all ();
+	}
+
+	emit (boost::bind(boost::ref(JobAdded), weak_ptr<Job>(job)));
+}
+
+
 void
 JobManager::increase_priority (shared_ptr<Job> job)
 {
@@ -352,7 +453,7 @@ JobManager::pause ()
 
 	for (auto i: _jobs) {
 		if (i->pause_by_user()) {
-			_paused_job = i;
+			_paused_jobs.push_back (i);
 		}
 	}
 
@@ -368,10 +469,10 @@ JobManager::resume ()
 		return;
 	}
 
-	if (_paused_job) {
-		_paused_job->resume ();
+	for (auto i: _paused_jobs) {
+		i->resume ();
 	}
 
-	_paused_job.reset ();
+	_paused_jobs.clear ();
 	_paused = false;
 }
@@ -80,6 +80,13 @@ public:
 		std::function<void()> ready
 		);
 
+	void analyse_crop (
+		std::shared_ptr<const Film> film,
+		std::shared_ptr<const Content> content,
+		boost::signals2::connection& connection,
+		std::function<void()> ready
+		);
+
 	boost::signals2::signal<void (std::weak_ptr<Job>)> JobAdded;
 	boost::signals2::signal<void ()> JobsReordered;
 	boost::signals2::signal<void (boost::optional<std::string>, boost::optional<std::string>)> ActiveJobsChanged;
@@ -97,6 +104,7 @@ private:
 	void scheduler ();
 	void start ();
 	void job_finished ();
+	void job_resource_changed ();
 
 	mutable boost::mutex _mutex;
 	boost::condition _empty_condition;
@@ -105,7 +113,7 @@ private:
 	std::list<boost::signals2::connection> _connections;
 	bool _terminate = false;
 	bool _paused = false;
-	std::shared_ptr<Job> _paused_job;
+	std::list<std::shared_ptr<Job>> _paused_jobs;
 
 	boost::optional<std::string> _last_active_job;
 	boost::thread _scheduler;
@@ -23,9 +23,11 @@
 #include "job.h"
 #include "job_manager.h"
 #include "json_server.h"
+#include "metrics.h"
 #include "transcode_job.h"
 #include "util.h"
 #include <dcp/raw_convert.h>
+#include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
 #include <boost/thread.hpp>
@@ -157,6 +159,18 @@ JSONServer::request (string url, shared_ptr<tcp::socket> socket)
 {
 	cout << "request: " << url << "\n";
 
+	if (url == "/metrics" || boost::algorithm::starts_with(url, "/metrics?")) {
+		/* Metrics for Prometheus or something like it to scrape */
+		auto const metrics = Metrics::instance()->prometheus();
+		string reply = "HTTP/1.1 200 OK\r\n"
+			"Content-Length: " + raw_convert<string>(metrics.length()) + "\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"\r\n"
+			+ metrics;
+		boost::asio::write (*socket, boost::asio::buffer(reply.c_str(), reply.length()));
+		return;
+	}
+
 	auto r = split_get_request (url);
 	for (auto const& i: r) {
 		cout << i.first << " => " << i.second << "\n";
@@ -241,13 +241,9 @@ from_film (
 	auto cpl = cpls.front().cpl_file;
 
 	try {
-		list<KDMWithMetadataPtr> kdms;
-		for (auto i: screens) {
-			auto p = kdm_for_screen (film, cpl, i, valid_from, valid_to, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio);
-			if (p) {
-				kdms.push_back (p);
-			}
-		}
+		auto const kdms = kdms_for_screens (
+			film, cpl, vector<shared_ptr<Screen>>(screens.begin(), screens.end()), valid_from, valid_to, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio
+			);
 		write_files (kdms, zip, output, container_name_format, filename_format, verbose, out);
 		if (email) {
 			send_emails ({kdms}, container_name_format, filename_format, film->dcp_name(), {});
@@ -24,11 +24,15 @@
 #include "cross.h"
 #include "dcpomatic_log.h"
 #include "emailer.h"
+#include "exceptions.h"
 #include "kdm_with_metadata.h"
+#include "scoped_temporary.h"
 #include "screen.h"
 #include "util.h"
 #include "zipper.h"
 #include <dcp/file.h>
+#include <boost/thread.hpp>
+#include <atomic>
 
 #include "i18n.h"
 
@@ -91,17 +95,41 @@ KDMWithMetadata::get (char k) const
 }
 
 
+static
 void
-make_zip_file (list<KDMWithMetadataPtr> kdms, boost::filesystem::path zip_file, dcp::NameFormat name_format)
+add_to_zip (Zipper& zipper, list<KDMWithMetadataPtr> kdms, dcp::NameFormat name_format)
 {
-	Zipper zipper (zip_file);
-
 	for (auto i: kdms) {
 		auto const name = careful_string_filter(name_format.get(i->name_values(), ".xml"));
 		zipper.add (name, i->kdm_as_xml());
 	}
+}
+
+
+void
+make_zip_file (list<KDMWithMetadataPtr> kdms, boost::filesystem::path zip_file, dcp::NameFormat name_format)
+{
+	Zipper zipper (zip_file);
+	add_to_zip (zipper, kdms, name_format);
+	zipper.close ();
+}
+
 
+/** @return A ZIP file of some KDMs, made in memory unless our libzip is too old to do that */
+static
+dcp::ArrayData
+make_zip_data (list<KDMWithMetadataPtr> kdms, dcp::NameFormat name_format)
+{
+#ifdef DCPOMATIC_HAVE_ZIP_SOURCE_T
+	Zipper zipper;
+	add_to_zip (zipper, kdms, name_format);
 	zipper.close ();
+	return zipper.data ();
+#else
+	ScopedTemporary zip_file;
+	make_zip_file (kdms, zip_file.path(), name_format);
+	return dcp::ArrayData (zip_file.path());
+#endif
 }
 
 
@@ -190,7 +218,38 @@ write_zip_files (
 }
 
 
-/** Email one ZIP file per cinema to the cinema.
+/* Number of connections to the mail server to use at the same time when sending KDMs */
+int constexpr email_connections = 4;
+/* Number of times to try sending an email before giving up */
+int constexpr email_attempts = 4;
+
+
+/** Send an email, trying again a few times, with increasing delays, if it fails in a way
+ *  which might just be the server being busy.
+ */
+static
+void
+send_with_retries (Emailer& email, EmailSession& session, string server, int port, EmailProtocol protocol, string user, string password)
+{
+	int delay = 1;
+	for (int attempt = 1; ; ++attempt) {
+		try {
+			email.send (session, server, port, protocol, user, password);
+			return;
+		} catch (TransientNetworkError& e) {
+			if (attempt == email_attempts) {
+				throw;
+			}
+			LOG_GENERAL ("Failed to send email (%1); trying again in %2s", e.what(), delay);
+			dcpomatic_sleep_seconds (delay);
+			delay *= 4;
+		}
+	}
+}
+
+
+/** Email one ZIP file per cinema to the cinema.  Emails are sent over a few connections
+ *  at once, each of which is kept open to send one email after another.
  *  @param kdms KDMs to email.
  *  @param container_name_format Format of folder / ZIP to use.
  *  @param filename_format Format of filenames to use.
@@ -216,18 +275,35 @@ send_emails (
 		throw NetworkError(_("No KDM from address configured in preferences"));
 	}
 
+	/* Take what we need from the config here so that the sending threads don't use it */
+	auto const mail_server = config->mail_server();
+	auto const mail_port = config->mail_port();
+	auto const mail_protocol = config->mail_protocol();
+	auto const mail_user = config->mail_user();
+	auto const mail_password = config->mail_password();
+	auto const kdm_from = config->kdm_from();
+	auto const kdm_subject = config->kdm_subject();
+	auto const kdm_email = config->kdm_email();
+	auto const kdm_cc = config->kdm_cc();
+	auto const kdm_bcc = config->kdm_bcc();
+
+	vector<list<KDMWithMetadataPtr>> todo;
 	for (auto const& kdms_for_cinema: kdms) {
+		if (!kdms_for_cinema.front()->emails().empty()) {
+			todo.push_back (kdms_for_cinema);
+		}
+	}
 
-		auto first = kdms_for_cinema.front();
+	if (todo.empty()) {
+		return;
+	}
 
-		if (first->emails().empty()) {
-			continue;
-		}
+	auto send_to_cinema = [&](list<KDMWithMetadataPtr> const& kdms_for_cinema, EmailSession& session) {
 
-		auto zip_file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
-		boost::filesystem::create_directories (zip_file);
-		zip_file /= container_name_format.get(first->name_values(), ".zip");
-		make_zip_file (kdms_for_cinema, zip_file, filename_format);
+		auto first = kdms_for_cinema.front();
+
+		auto const zip_data = make_zip_data (kdms_for_cinema, filename_format);
+		auto const zip_name = container_name_format.get(first->name_values(), ".zip");
 
 		auto substitute_variables = [cpl_name, first](string target) {
 			boost::algorithm::replace_all(target, "$CPL_NAME", cpl_name);
@@ -238,8 +314,8 @@ send_emails (
 			return target;
 		};
 
-		auto subject = substitute_variables(config->kdm_subject());
-		auto body = substitute_variables(config->kdm_email());
+		auto subject = substitute_variables(kdm_subject);
+		auto body = substitute_variables(kdm_email);
 
 		string screens;
 		for (auto kdm: kdms_for_cinema) {
@@ -251,21 +327,21 @@ send_emails (
 		boost::algorithm::replace_all (body, "$SCREENS", screens.substr (0, screens.length() - 2));
 
 		auto emails = first->emails();
-		Emailer email (config->kdm_from(), { emails.front() }, subject, body);
+		Emailer email (kdm_from, { emails.front() }, subject, body);
 
 		/* Use CC for the second and subsequent email addresses, so we seem less spammy (#2310) */
 		for (auto cc = std::next(emails.begin()); cc != emails.end(); ++cc) {
 			email.add_cc(*cc);
 		}
 
-		for (auto cc: config->kdm_cc()) {
+		for (auto cc: kdm_cc) {
 			email.add_cc (cc);
 		}
-		if (!config->kdm_bcc().empty()) {
-			email.add_bcc (config->kdm_bcc());
+		if (!kdm_bcc.empty()) {
+			email.add_bcc (kdm_bcc);
 		}
 
-		email.add_attachment (zip_file, container_name_format.get(first->name_values(), ".zip"), "application/zip");
+		email.add_attachment (zip_data, zip_name, "application/zip");
 
 		auto log_details = [](Emailer& email) {
 			dcpomatic_log->log("Email content follows", LogEntry::TYPE_DEBUG_EMAIL);
@@ -275,9 +351,8 @@ send_emails (
 		};
 
 		try {
-			email.send (config->mail_server(), config->mail_port(), config->mail_protocol(), config->mail_user(), config->mail_password());
+			send_with_retries (email, session, mail_server, mail_port, mail_protocol, mail_user, mail_password);
 		} catch (...) {
-			boost::filesystem::remove (zip_file);
 			log_details (email);
 			throw;
 		}
@@ -285,20 +360,53 @@ send_emails (
 		log_details (email);
 
 		for (auto extra: extra_addresses) {
-			Emailer email (config->kdm_from(), { extra }, subject, body);
-			email.add_attachment (zip_file, container_name_format.get(first->name_values(), ".zip"), "application/zip");
+			Emailer email (kdm_from, { extra }, subject, body);
+			email.add_attachment (zip_data, zip_name, "application/zip");
 
 			try {
-				email.send (config->mail_server(), config->mail_port(), config->mail_protocol(), config->mail_user(), config->mail_password());
+				send_with_retries (email, session, mail_server, mail_port, mail_protocol, mail_user, mail_password);
 			} catch (...) {
-				boost::filesystem::remove (zip_file);
 				log_details (email);
 				throw;
 			}
 
 			log_details (email);
 		}
+	};
+
+	/* Make the sessions here, as libcurl's global setup might not be thread-safe */
+	vector<shared_ptr<EmailSession>> sessions;
+	for (size_t i = 0; i < std::min(todo.size(), static_cast<size_t>(email_connections)); ++i) {
+		sessions.push_back (std::make_shared<EmailSession>());
+	}
 
-		boost::filesystem::remove (zip_file);
+	vector<std::exception_ptr> errors (todo.size());
+	std::atomic<size_t> next (0);
+	std::atomic<bool> failed (false);
+
+	boost::thread_group threads;
+	for (auto session: sessions) {
+		threads.create_thread ([&todo, &errors, &next, &failed, &send_to_cinema, session]() {
+			/* Stop when something goes wrong, as we would have done sending one at a time */
+			while (!failed) {
+				auto const i = next++;
+				if (i >= todo.size()) {
+					return;
+				}
+				try {
+					send_to_cinema (todo[i], *session);
+				} catch (...) {
+					errors[i] = std::current_exception ();
+					failed = true;
+				}
+			}
+		});
+	}
+	threads.join_all ();
+
+	for (auto const& i: errors) {
+		if (i) {
+			std::rethrow_exception (i);
+		}
 	}
 }
@@ -0,0 +1,176 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "exceptions.h"
+#include "link_cipher.h"
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <cstring>
+
+#include "i18n.h"
+
+
+using std::string;
+using std::vector;
+
+
+/** Size of the IV that we use with AES-GCM */
+static int const iv_size = 12;
+
+
+LinkCipher::LinkCipher (string const& key, uint8_t const* client_nonce, uint8_t const* server_nonce, bool client)
+	: _key (32)
+	, _client (client)
+{
+	/* Stretch the key (which is probably something that a person typed) a bit */
+	char const salt[] = "dcpomatic-encode-server";
+	PKCS5_PBKDF2_HMAC (
+		key.c_str(), key.length(), reinterpret_cast<uint8_t const*>(salt), strlen(salt), 4096, EVP_sha256(), _key.size(), _key.data()
+		);
+
+	_nonces.insert (_nonces.end(), client_nonce, client_nonce + nonce_size);
+	_nonces.insert (_nonces.end(), server_nonce, server_nonce + nonce_size);
+
+	_send_key = derive (_client ? "client-to-server" : "server-to-client");
+	_receive_key = derive (_client ? "server-to-client" : "client-to-server");
+}
+
+
+/** @return HMAC of @p label and the two nonces, using our key */
+vector<uint8_t>
+LinkCipher::derive (string const& label) const
+{
+	vector<uint8_t> message (label.begin(), label.end());
+	message.insert (message.end(), _nonces.begin(), _nonces.end());
+
+	vector<uint8_t> result (EVP_MAX_MD_SIZE);
+	unsigned int length = 0;
+	HMAC (EVP_sha256(), _key.data(), _key.size(), message.data(), message.size(), result.data(), &length);
+	result.resize (length);
+	return result;
+}
+
+
+vector<uint8_t>
+LinkCipher::proof () const
+{
+	return derive (_client ? "client-proof" : "server-proof");
+}
+
+
+bool
+LinkCipher::check_proof (uint8_t const* proof) const
+{
+	auto const expected = derive (_client ? "server-proof" : "client-proof");
+	uint8_t different = 0;
+	for (int i = 0; i < proof_size; ++i) {
+		different |= expected[i] ^ proof[i];
+	}
+	return different == 0;
+}
+
+
+static void
+make_iv (uint64_t counter, uint8_t* iv)
+{
+	memset (iv, 0, iv_size);
+	for (int i = 0; i < 8; ++i) {
+		iv[i] = (counter >> (i * 8)) & 0xff;
+	}
+}
+
+
+vector<uint8_t>
+LinkCipher::seal (uint8_t const* data, size_t size)
+{
+	uint8_t iv[iv_size];
+	make_iv (_send_counter++, iv);
+
+	vector<uint8_t> sealed (size + tag_size);
+
+	auto ctx = EVP_CIPHER_CTX_new ();
+	if (!ctx) {
+		throw CryptoError ("could not create cipher context");
+	}
+
+	int length = 0;
+	bool const ok =
+		EVP_EncryptInit_ex (ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1 &&
+		EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_IVLEN, iv_size, nullptr) == 1 &&
+		EVP_EncryptInit_ex (ctx, nullptr, nullptr, _send_key.data(), iv) == 1 &&
+		EVP_EncryptUpdate (ctx, sealed.data(), &length, data, size) == 1 &&
+		EVP_EncryptFinal_ex (ctx, sealed.data() + length, &length) == 1 &&
+		EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_GET_TAG, tag_size, sealed.data() + size) == 1;
+
+	EVP_CIPHER_CTX_free (ctx);
+
+	if (!ok) {
+		throw CryptoError ("could not encrypt data");
+	}
+
+	return sealed;
+}
+
+
+void
+LinkCipher::open (vector<uint8_t>& data)
+{
+	if (data.size() < static_cast<size_t>(tag_size)) {
+		throw NetworkError (_("Encrypted message is too short"));
+	}
+
+	uint8_t iv[iv_size];
+	make_iv (_receive_counter++, iv);
+
+	auto const size = data.size() - tag_size;
+
+	auto ctx = EVP_CIPHER_CTX_new ();
+	if (!ctx) {
+		throw CryptoError ("could not create cipher context");
+	}
+
+	int length = 0;
+	bool const ok =
+		EVP_DecryptInit_ex (ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1 &&
+		EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_IVLEN, iv_size, nullptr) == 1 &&
+		EVP_DecryptInit_ex (ctx, nullptr, nullptr, _receive_key.data(), iv) == 1 &&
+		EVP_DecryptUpdate (ctx, data.data(), &length, data.data(), size) == 1 &&
+		EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_TAG, tag_size, data.data() + size) == 1 &&
+		EVP_DecryptFinal_ex (ctx, data.data() + length, &length) == 1;
+
+	EVP_CIPHER_CTX_free (ctx);
+
+	if (!ok) {
+		throw NetworkError (_("Encrypted message could not be authenticated"));
+	}
+
+	data.resize (size);
+}
+
+
+void
+LinkCipher::random_nonce (uint8_t* nonce)
+{
+	if (RAND_bytes(nonce, nonce_size) != 1) {
+		throw CryptoError ("could not make random nonce");
+	}
+}
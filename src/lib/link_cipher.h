@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_LINK_CIPHER_H
+#define DCPOMATIC_LINK_CIPHER_H
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/** @class LinkCipher
+ *  @brief Encryption and authentication of the messages on one connection to an encode server,
+ *  using a key which has been given to both ends.
+ *
+ *  Each end sends a random nonce at the start of the connection, and the keys for each direction
+ *  are derived from the shared key and the two nonces.  Each end then proves that it knows the
+ *  shared key with proof().  Messages are encrypted with AES-256-GCM, with a counter for the IV,
+ *  so they must be opened in the order that they were sealed.
+ */
+class LinkCipher
+{
+public:
+	/** @param key Key shared by both ends.
+	 *  @param client_nonce Nonce sent by the client (nonce_size bytes).
+	 *  @param server_nonce Nonce sent by the server (nonce_size bytes).
+	 *  @param client true if we are the client.
+	 */
+	LinkCipher (std::string const& key, uint8_t const* client_nonce, uint8_t const* server_nonce, bool client);
+
+	LinkCipher (LinkCipher const&) = delete;
+	LinkCipher& operator= (LinkCipher const&) = delete;
+
+	/** @return Proof that we know the key, for the other end to check */
+	std::vector<uint8_t> proof () const;
+	/** @return true if @p proof (proof_size bytes) from the other end is right */
+	bool check_proof (uint8_t const* proof) const;
+
+	/** @return @p data encrypted, with a tag_size authentication tag on the end */
+	std::vector<uint8_t> seal (uint8_t const* data, size_t size);
+	/** Decrypt and check a message from the other end in place; throws NetworkError
+	 *  if it has been tampered with or was sealed with the wrong key.
+	 */
+	void open (std::vector<uint8_t>& data);
+
+	static void random_nonce (uint8_t* nonce);
+
+	static int const nonce_size = 16;
+	static int const proof_size = 32;
+	static int const tag_size = 16;
+
+private:
+	std::vector<uint8_t> derive (std::string const& label) const;
+
+	std::vector<uint8_t> _key;
+	std::vector<uint8_t> _nonces;
+	bool _client;
+	std::vector<uint8_t> _send_key;
+	std::vector<uint8_t> _receive_key;
+	uint64_t _send_counter = 0;
+	uint64_t _receive_counter = 0;
+};
+
+
+#endif
@@ -41,6 +41,7 @@ using std::string;
 
 
 Log::Log ()
+	: _types (0)
 {
 
 }
@@ -49,12 +50,11 @@ Log::Log ()
 void
 Log::log (shared_ptr<const LogEntry> e)
 {
-	boost::mutex::scoped_lock lm (_mutex);
-
-	if ((_types & e->type()) == 0) {
+	if (!enabled(e->type())) {
 		return;
 	}
 
+	boost::mutex::scoped_lock lm (_mutex);
 	do_log (e);
 }
 
@@ -63,14 +63,13 @@ Log::log (shared_ptr<const LogEntry> e)
 void
 Log::log (string message, int type)
 {
-	boost::mutex::scoped_lock lm (_mutex);
-
-	if ((_types & type) == 0) {
+	if (!enabled(type)) {
 		return;
 	}
 
 	auto e = make_shared<StringLogEntry>(type, message);
 
+	boost::mutex::scoped_lock lm (_mutex);
 	do_log (e);
 }
 
@@ -95,6 +94,5 @@ Log::dcp_log (dcp::NoteType type, string m)
 void
 Log::set_types (int t)
 {
-	boost::mutex::scoped_lock lm (_mutex);
 	_types = t;
 }
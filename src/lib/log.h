@@ -33,6 +33,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/signals2.hpp>
+#include <atomic>
 #include <string>
 
 
@@ -57,6 +58,13 @@ public:
 		return _types;
 	}
 
+	/** @return true if entries of any of the given types will be logged.  This takes no locks,
+	 *  so it can be used to avoid building messages that would only be thrown away.
+	 */
+	bool enabled (int types) const {
+		return (_types & types) != 0;
+	}
+
 	/** @param amount Approximate number of bytes to return; the returned value
 	 *  may be shorter or longer than this.
 	 */
@@ -74,7 +82,7 @@ private:
 	virtual void do_log (std::shared_ptr<const LogEntry> entry) = 0;
 
 	/** bit-field of log types which should be put into the log (others are ignored) */
-	int _types = 0;
+	std::atomic<int> _types;
 };
 
 
@@ -22,6 +22,7 @@
 #include "config.h"
 #include "dcp_content.h"
 #include "dcp_encoder.h"
+#include "dcp_rewrap_encoder.h"
 #include "dcp_transcode_job.h"
 #include "dcpomatic_log.h"
 #include "environment_info.h"
@@ -38,11 +39,14 @@ using std::make_shared;
 using std::runtime_error;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 
 
-/** Add suitable Jobs to the JobManager to create a DCP for a Film */
+/** Add suitable Jobs to the JobManager to create a DCP for a Film.
+ *  @param sinks Other outputs to make from the same pass through the film as the DCP.
+ */
 void
-make_dcp (shared_ptr<Film> film, TranscodeJob::ChangedBehaviour behaviour)
+make_dcp (shared_ptr<Film> film, TranscodeJob::ChangedBehaviour behaviour, vector<shared_ptr<ExportSink>> sinks)
 {
 	if (film->dcp_name().find("/") != string::npos) {
 		throw BadSettingError (_("name"), _("Cannot contain slashes"));
@@ -99,7 +103,16 @@ make_dcp (shared_ptr<Film> film, TranscodeJob::ChangedBehaviour behaviour)
 	LOG_GENERAL ("J2K bandwidth %1", film->j2k_bandwidth());
 
 	auto tj = make_shared<DCPTranscodeJob>(film, behaviour);
-	tj->set_encoder (make_shared<DCPEncoder>(film, tj));
+	if (sinks.empty() && DCPRewrapEncoder::possible(film)) {
+		LOG_GENERAL_NC ("Copying frames from the existing DCP without re-encoding");
+		tj->set_encoder (make_shared<DCPRewrapEncoder>(film, tj));
+	} else {
+		auto encoder = make_shared<DCPEncoder>(film, tj);
+		for (auto sink: sinks) {
+			encoder->add_sink (sink);
+		}
+		tj->set_encoder (encoder);
+	}
 	JobManager::instance()->add (tj);
 }
 
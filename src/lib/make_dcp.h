@@ -20,10 +20,12 @@
 
 
 #include "transcode_job.h"
+#include <vector>
 
 
+class ExportSink;
 class Film;
 
 
-void make_dcp (std::shared_ptr<Film> film, TranscodeJob::ChangedBehaviour behaviour);
+void make_dcp (std::shared_ptr<Film> film, TranscodeJob::ChangedBehaviour behaviour, std::vector<std::shared_ptr<ExportSink>> sinks = {});
 
@@ -19,10 +19,23 @@
 */
 
 
+#include "cpu_dispatch.h"
 #include "maths_util.h"
+#if defined(DCPOMATIC_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include <cmath>
 
 
+using dcpomatic::cpu::ISA;
+using dcpomatic::cpu::Kernel;
+
+
 double
 db_to_linear (double db)
 {
@@ -52,3 +65,216 @@ logarithmic_fade_out_curve (float t)
 	return std::exp(-2 * c) * (1 - c);
 }
 
+
+static void
+accumulate_samples_scalar (float* d, float const* s, int n, float gain)
+{
+	for (int i = 0; i < n; ++i) {
+		d[i] += s[i] * gain;
+	}
+}
+
+
+static void
+scale_samples_scalar (float* p, int n, float gain)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] *= gain;
+	}
+}
+
+
+static void
+multiply_samples_scalar (float* p, float const* c, int n)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] *= c[i];
+	}
+}
+
+
+#if defined(__SSE2__)
+
+static void
+accumulate_samples_sse2 (float* d, float const* s, int n, float gain)
+{
+	int i = 0;
+	auto const g = _mm_set1_ps(gain);
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(d + i), _mm_mul_ps(_mm_loadu_ps(s + i), g)));
+	}
+	accumulate_samples_scalar (d + i, s + i, n - i, gain);
+}
+
+
+static void
+scale_samples_sse2 (float* p, int n, float gain)
+{
+	int i = 0;
+	auto const g = _mm_set1_ps(gain);
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(p + i, _mm_mul_ps(_mm_loadu_ps(p + i), g));
+	}
+	scale_samples_scalar (p + i, n - i, gain);
+}
+
+
+static void
+multiply_samples_sse2 (float* p, float const* c, int n)
+{
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(p + i, _mm_mul_ps(_mm_loadu_ps(p + i), _mm_loadu_ps(c + i)));
+	}
+	multiply_samples_scalar (p + i, c + i, n - i);
+}
+
+#elif defined(__ARM_NEON)
+
+static void
+accumulate_samples_neon (float* d, float const* s, int n, float gain)
+{
+	int i = 0;
+	auto const g = vdupq_n_f32(gain);
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(d + i, vaddq_f32(vld1q_f32(d + i), vmulq_f32(vld1q_f32(s + i), g)));
+	}
+	accumulate_samples_scalar (d + i, s + i, n - i, gain);
+}
+
+
+static void
+scale_samples_neon (float* p, int n, float gain)
+{
+	int i = 0;
+	auto const g = vdupq_n_f32(gain);
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(p + i, vmulq_f32(vld1q_f32(p + i), g));
+	}
+	scale_samples_scalar (p + i, n - i, gain);
+}
+
+
+static void
+multiply_samples_neon (float* p, float const* c, int n)
+{
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(p + i, vmulq_f32(vld1q_f32(p + i), vld1q_f32(c + i)));
+	}
+	multiply_samples_scalar (p + i, c + i, n - i);
+}
+
+#endif
+
+
+#if defined(DCPOMATIC_X86_DISPATCH)
+
+/* These are built for AVX2 whatever the rest of the build uses, and are only called if the CPU has it.
+ * They use separate multiplies and adds (rather than FMA) so that they give the same answers as the others.
+ */
+
+__attribute__((target("avx2")))
+static void
+accumulate_samples_avx2 (float* d, float const* s, int n, float gain)
+{
+	int i = 0;
+	auto const g = _mm256_set1_ps(gain);
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_mul_ps(_mm256_loadu_ps(s + i), g)));
+	}
+	accumulate_samples_scalar (d + i, s + i, n - i, gain);
+}
+
+
+__attribute__((target("avx2")))
+static void
+scale_samples_avx2 (float* p, int n, float gain)
+{
+	int i = 0;
+	auto const g = _mm256_set1_ps(gain);
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(p + i, _mm256_mul_ps(_mm256_loadu_ps(p + i), g));
+	}
+	scale_samples_scalar (p + i, n - i, gain);
+}
+
+
+__attribute__((target("avx2")))
+static void
+multiply_samples_avx2 (float* p, float const* c, int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(p + i, _mm256_mul_ps(_mm256_loadu_ps(p + i), _mm256_loadu_ps(c + i)));
+	}
+	multiply_samples_scalar (p + i, c + i, n - i);
+}
+
+#endif
+
+
+static Kernel<void (float*, float const*, int, float)> accumulate_samples_kernel (
+	"accumulate_samples",
+	{
+		{ ISA::SCALAR, &accumulate_samples_scalar },
+#if defined(__SSE2__)
+		{ ISA::SSE2, &accumulate_samples_sse2 },
+#elif defined(__ARM_NEON)
+		{ ISA::NEON, &accumulate_samples_neon },
+#endif
+#if defined(DCPOMATIC_X86_DISPATCH)
+		{ ISA::AVX2, &accumulate_samples_avx2 },
+#endif
+	});
+
+
+static Kernel<void (float*, int, float)> scale_samples_kernel (
+	"scale_samples",
+	{
+		{ ISA::SCALAR, &scale_samples_scalar },
+#if defined(__SSE2__)
+		{ ISA::SSE2, &scale_samples_sse2 },
+#elif defined(__ARM_NEON)
+		{ ISA::NEON, &scale_samples_neon },
+#endif
+#if defined(DCPOMATIC_X86_DISPATCH)
+		{ ISA::AVX2, &scale_samples_avx2 },
+#endif
+	});
+
+
+static Kernel<void (float*, float const*, int)> multiply_samples_kernel (
+	"multiply_samples",
+	{
+		{ ISA::SCALAR, &multiply_samples_scalar },
+#if defined(__SSE2__)
+		{ ISA::SSE2, &multiply_samples_sse2 },
+#elif defined(__ARM_NEON)
+		{ ISA::NEON, &multiply_samples_neon },
+#endif
+#if defined(DCPOMATIC_X86_DISPATCH)
+		{ ISA::AVX2, &multiply_samples_avx2 },
+#endif
+	});
+
+
+void
+accumulate_samples (float* d, float const* s, int n, float gain)
+{
+	accumulate_samples_kernel (d, s, n, gain);
+}
+
+
+void
+scale_samples (float* p, int n, float gain)
+{
+	scale_samples_kernel (p, n, gain);
+}
+
+
+void
+multiply_samples (float* p, float const* c, int n)
+{
+	multiply_samples_kernel (p, c, n);
+}
@@ -46,6 +46,14 @@ extern float logarithmic_fade_in_curve (float t);
 extern float logarithmic_fade_out_curve (float t);
 
 
+/** Add n samples from s, multiplied by gain, to n samples at d */
+extern void accumulate_samples (float* d, float const* s, int n, float gain);
+/** Multiply n samples at p by gain */
+extern void scale_samples (float* p, int n, float gain);
+/** Multiply n samples at p by the corresponding samples at c */
+extern void multiply_samples (float* p, float const* c, int n);
+
+
 template <class T>
 T clamp (T val, T minimum, T maximum)
 {
@@ -0,0 +1,200 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "config.h"
+#include "dcpomatic_assert.h"
+#include "memory_budget.h"
+#include "metrics.h"
+#include <boost/thread/once.hpp>
+
+
+using std::string;
+using boost::optional;
+
+
+MemoryBudget* MemoryBudget::_instance = nullptr;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+
+
+MemoryBudget::Share::~Share ()
+{
+	set (0);
+}
+
+
+void
+MemoryBudget::Share::set (int64_t bytes)
+{
+	auto const old = _bytes.exchange(bytes);
+	MemoryBudget::instance()->change (_subsystem, bytes - old);
+}
+
+
+void
+MemoryBudget::Share::add (int64_t bytes)
+{
+	_bytes += bytes;
+	MemoryBudget::instance()->change (_subsystem, bytes);
+}
+
+
+static void
+update_peak (std::atomic<int64_t>& peak, int64_t value)
+{
+	auto current = peak.load();
+	while (value > current && !peak.compare_exchange_weak(current, value)) {}
+}
+
+
+void
+MemoryBudget::change (Subsystem subsystem, int64_t bytes)
+{
+	if (bytes == 0) {
+		return;
+	}
+
+	auto const index = static_cast<int>(subsystem);
+	auto const now = _used[index] += bytes;
+	if (bytes > 0) {
+		update_peak (_peak[index], now);
+		update_peak (_peak_total, total());
+	}
+
+	static Metrics::Gauge* gauges[static_cast<int>(Subsystem::COUNT)] = {
+		&Metrics::instance()->gauge("dcpomatic_memory_bytes", "Memory used by each part of the encode pipeline", {{ "subsystem", name(Subsystem::DECODERS) }}),
+		&Metrics::instance()->gauge("dcpomatic_memory_bytes", "Memory used by each part of the encode pipeline", {{ "subsystem", name(Subsystem::PLAYER) }}),
+		&Metrics::instance()->gauge("dcpomatic_memory_bytes", "Memory used by each part of the encode pipeline", {{ "subsystem", name(Subsystem::ENCODER_QUEUE) }}),
+		&Metrics::instance()->gauge("dcpomatic_memory_bytes", "Memory used by each part of the encode pipeline", {{ "subsystem", name(Subsystem::WRITER_QUEUE) }}),
+		&Metrics::instance()->gauge("dcpomatic_memory_bytes", "Memory used by each part of the encode pipeline", {{ "subsystem", name(Subsystem::SUBTITLE_CACHE) }})
+	};
+	gauges[index]->set (now);
+}
+
+
+int64_t
+MemoryBudget::total () const
+{
+	int64_t t = 0;
+	for (auto const& i: _used) {
+		t += i;
+	}
+	return t;
+}
+
+
+/** @return The budget in bytes, or none if there is no budget */
+optional<int64_t>
+MemoryBudget::budget () const
+{
+	auto const megabytes = Config::instance()->memory_budget();
+	if (megabytes <= 0) {
+		return {};
+	}
+	return static_cast<int64_t>(megabytes) * 1024 * 1024;
+}
+
+
+/** @return Memory that @p subsystem may use, given what everything else is using, before the
+ *  budget is reached; or none if there is no budget.
+ */
+optional<int64_t>
+MemoryBudget::available (Subsystem subsystem) const
+{
+	auto const b = budget();
+	if (!b) {
+		return {};
+	}
+	return std::max(static_cast<int64_t>(0), *b - (total() - used(subsystem)));
+}
+
+
+bool
+MemoryBudget::over_budget () const
+{
+	auto const b = budget();
+	return b && total() > *b;
+}
+
+
+void
+MemoryBudget::reset_peaks ()
+{
+	for (int i = 0; i < static_cast<int>(Subsystem::COUNT); ++i) {
+		_peak[i] = _used[i].load();
+	}
+	_peak_total = total();
+}
+
+
+/** @return Description of the most memory that each part has used since reset_peaks(), suitable for a log */
+string
+MemoryBudget::report () const
+{
+	auto megabytes = [](int64_t bytes) {
+		return String::compose("%1MB", bytes / (1024 * 1024));
+	};
+
+	string r = "Peak memory use:";
+	for (int i = 0; i < static_cast<int>(Subsystem::COUNT); ++i) {
+		r += String::compose(" %1 %2;", name(static_cast<Subsystem>(i)), megabytes(_peak[i]));
+	}
+	r += " total " + megabytes(_peak_total);
+	if (auto b = budget()) {
+		r += String::compose(" of a budget of %1", megabytes(*b));
+	} else {
+		r += " with no budget";
+	}
+	return r;
+}
+
+
+string
+MemoryBudget::name (Subsystem subsystem)
+{
+	switch (subsystem) {
+	case Subsystem::DECODERS:
+		return "decoders";
+	case Subsystem::PLAYER:
+		return "player";
+	case Subsystem::ENCODER_QUEUE:
+		return "encoder_queue";
+	case Subsystem::WRITER_QUEUE:
+		return "writer_queue";
+	case Subsystem::SUBTITLE_CACHE:
+		return "subtitle_cache";
+	case Subsystem::COUNT:
+		break;
+	}
+
+	DCPOMATIC_ASSERT (false);
+	return "";
+}
+
+
+MemoryBudget*
+MemoryBudget::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new MemoryBudget();
+	});
+	return _instance;
+}
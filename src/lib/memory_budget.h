@@ -0,0 +1,121 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_MEMORY_BUDGET_H
+#define DCPOMATIC_MEMORY_BUDGET_H
+
+
+#include <boost/optional.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+/** @class MemoryBudget
+ *  @brief Memory used by the parts of the encode pipeline which can hold many frames, and the budget
+ *  that they share.
+ *
+ *  Each part keeps a Share which it sets to the memory it is using.  Parts that can wait (the
+ *  decoders running ahead, and the player feeding the encoder queue) hold back when the total is
+ *  over the budget, the writer puts frames in temporary files and the subtitle cache forgets
+ *  things, so that a large encode slows down rather than running out of memory.
+ */
+class MemoryBudget
+{
+public:
+	MemoryBudget (MemoryBudget const&) = delete;
+	MemoryBudget& operator= (MemoryBudget const&) = delete;
+
+	enum class Subsystem
+	{
+		DECODERS,
+		PLAYER,
+		ENCODER_QUEUE,
+		WRITER_QUEUE,
+		SUBTITLE_CACHE,
+		COUNT
+	};
+
+	/** @class Share
+	 *  @brief Memory used by one object, which is given back when the Share is destroyed.
+	 */
+	class Share
+	{
+	public:
+		explicit Share (Subsystem subsystem)
+			: _subsystem (subsystem)
+		{}
+
+		~Share ();
+
+		Share (Share const&) = delete;
+		Share& operator= (Share const&) = delete;
+
+		/** @param bytes Memory that the owner is now using */
+		void set (int64_t bytes);
+		void add (int64_t bytes);
+
+		int64_t get () const {
+			return _bytes;
+		}
+
+	private:
+		Subsystem _subsystem;
+		std::atomic<int64_t> _bytes{0};
+	};
+
+	int64_t used (Subsystem subsystem) const {
+		return _used[static_cast<int>(subsystem)];
+	}
+
+	int64_t peak (Subsystem subsystem) const {
+		return _peak[static_cast<int>(subsystem)];
+	}
+
+	int64_t peak_total () const {
+		return _peak_total;
+	}
+
+	int64_t total () const;
+	boost::optional<int64_t> budget () const;
+	boost::optional<int64_t> available (Subsystem subsystem) const;
+	bool over_budget () const;
+
+	void reset_peaks ();
+	std::string report () const;
+
+	static std::string name (Subsystem subsystem);
+	static MemoryBudget* instance ();
+
+private:
+	MemoryBudget () = default;
+
+	void change (Subsystem subsystem, int64_t bytes);
+
+	std::atomic<int64_t> _used[static_cast<int>(Subsystem::COUNT)] = {};
+	std::atomic<int64_t> _peak[static_cast<int>(Subsystem::COUNT)] = {};
+	std::atomic<int64_t> _peak_total{0};
+
+	static MemoryBudget* _instance;
+};
+
+
+#endif
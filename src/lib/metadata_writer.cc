@@ -0,0 +1,191 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "dcpomatic_log.h"
+#include "exceptions.h"
+#include "metadata_writer.h"
+#include "util.h"
+#include <libxml++/libxml++.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/thread/once.hpp>
+#include <algorithm>
+
+
+using std::shared_ptr;
+using std::string;
+using boost::algorithm::trim;
+
+
+MetadataWriter* MetadataWriter::_instance = nullptr;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+boost::posix_time::time_duration const MetadataWriter::delay = boost::posix_time::seconds(1);
+boost::posix_time::time_duration const MetadataWriter::max_delay = boost::posix_time::seconds(5);
+
+
+MetadataWriter::MetadataWriter ()
+{
+	_thread = boost::thread(boost::bind(&MetadataWriter::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread.native_handle(), "metadata-writer");
+#endif
+}
+
+
+MetadataWriter::~MetadataWriter ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	try {
+		_thread.join ();
+	} catch (...) {}
+}
+
+
+/** Write a document to a file at some point soon.  Any write of the same file which
+ *  is still waiting is replaced by this one.
+ *  @param doc Document, which must not be used by the caller after this call.
+ */
+void
+MetadataWriter::write (shared_ptr<xmlpp::Document> doc, boost::filesystem::path path)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	auto const now = boost::get_system_time();
+	auto i = _pending.find (path);
+	if (i == _pending.end()) {
+		_pending[path] = { doc, now, now + delay };
+	} else {
+		i->second.doc = doc;
+		i->second.due = std::min(now + delay, i->second.first + max_delay);
+	}
+	_condition.notify_all ();
+}
+
+
+/** Forget about any waiting write of a file, and wait for any write of it
+ *  which is already under way to finish.
+ */
+void
+MetadataWriter::cancel (boost::filesystem::path path)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_pending.erase (path);
+	while (_writing && *_writing == path) {
+		_condition.wait (lm);
+	}
+}
+
+
+/** Write everything that is waiting to be written, returning when it is all done.
+ *  Throws if any write since the last flush() failed.
+ */
+void
+MetadataWriter::flush ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_flushing = true;
+		_condition.notify_all ();
+		while (!_pending.empty() || _writing) {
+			_condition.wait (lm);
+		}
+		_flushing = false;
+	}
+
+	rethrow ();
+}
+
+
+/** Write a document to a file from the calling thread, via a temporary file */
+void
+MetadataWriter::write_now (shared_ptr<xmlpp::Document> doc, boost::filesystem::path path)
+{
+	boost::filesystem::path tmp (string(path.string()).append(".tmp"));
+	try {
+		doc->write_to_file_formatted (tmp.string());
+	} catch (xmlpp::exception& e) {
+		string s = e.what ();
+		trim (s);
+		throw FileError (s, path);
+	}
+	boost::filesystem::rename (tmp, path);
+}
+
+
+void
+MetadataWriter::thread ()
+{
+	start_of_thread ("MetadataWriter");
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (!_stop) {
+		if (_pending.empty()) {
+			_condition.wait (lm);
+			continue;
+		}
+
+		auto next = _pending.begin();
+		for (auto i = _pending.begin(); i != _pending.end(); ++i) {
+			if (i->second.due < next->second.due) {
+				next = i;
+			}
+		}
+
+		if (!_flushing && next->second.due > boost::get_system_time()) {
+			_condition.timed_wait (lm, next->second.due);
+			continue;
+		}
+
+		auto const path = next->first;
+		auto doc = next->second.doc;
+		_pending.erase (next);
+		_writing = path;
+		lm.unlock ();
+
+		try {
+			write_now (doc, path);
+		} catch (std::exception& e) {
+			LOG_ERROR ("Could not write %1 (%2)", path.string(), e.what());
+			store_current ();
+		} catch (...) {
+			store_current ();
+		}
+
+		lm.lock ();
+		_writing = boost::none;
+		_condition.notify_all ();
+	}
+}
+
+
+MetadataWriter*
+MetadataWriter::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new MetadataWriter();
+	});
+	return _instance;
+}
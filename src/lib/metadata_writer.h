@@ -0,0 +1,100 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_METADATA_WRITER_H
+#define DCPOMATIC_METADATA_WRITER_H
+
+
+#include "exception_store.h"
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
+
+
+namespace xmlpp {
+	class Document;
+}
+
+
+/** @class MetadataWriter
+ *  @brief Write XML documents (such as film metadata) to disk from a background thread.
+ *
+ *  The caller builds the document and then hands it over to write(); nothing else may
+ *  touch it after that.  Writes are held back for a short time in case another write
+ *  of the same file comes along, in which case only the newer document is written.
+ *  Files are written to a temporary name and then renamed into place, so a crash
+ *  while writing leaves the previous version intact.
+ */
+class MetadataWriter : public ExceptionStore
+{
+public:
+	~MetadataWriter ();
+
+	MetadataWriter (MetadataWriter const&) = delete;
+	MetadataWriter& operator= (MetadataWriter const&) = delete;
+
+	void write (std::shared_ptr<xmlpp::Document> doc, boost::filesystem::path path);
+	void cancel (boost::filesystem::path path);
+	void flush ();
+
+	static void write_now (std::shared_ptr<xmlpp::Document> doc, boost::filesystem::path path);
+	static MetadataWriter* instance ();
+
+	/** time to wait after a write() in case another one for the same file arrives */
+	static boost::posix_time::time_duration const delay;
+	/** longest time to hold back a file which keeps being re-written */
+	static boost::posix_time::time_duration const max_delay;
+
+private:
+	MetadataWriter ();
+
+	void thread ();
+
+	struct Pending
+	{
+		std::shared_ptr<xmlpp::Document> doc;
+		/** time of the first write() since the file was last written */
+		boost::system_time first;
+		/** time at which we should write the file */
+		boost::system_time due;
+	};
+
+	boost::mutex _mutex;
+	boost::condition _condition;
+	std::map<boost::filesystem::path, Pending> _pending;
+	/** file that the thread is writing now, if any */
+	boost::optional<boost::filesystem::path> _writing;
+	/** true if the thread should write everything in _pending without waiting */
+	bool _flushing = false;
+	bool _stop = false;
+
+	boost::thread _thread;
+
+	static MetadataWriter* _instance;
+};
+
+
+#endif
@@ -0,0 +1,201 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "metrics.h"
+#include <dcp/raw_convert.h>
+#include <boost/thread/once.hpp>
+#include <algorithm>
+
+
+using std::string;
+using std::vector;
+using dcp::raw_convert;
+
+
+Metrics* Metrics::_instance = nullptr;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+
+
+Metrics*
+Metrics::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new Metrics ();
+	});
+
+	return _instance;
+}
+
+
+Metrics::Histogram::Histogram (vector<double> bounds)
+	: _bounds (bounds)
+	, _counts (bounds.size() + 1)
+{
+	DCPOMATIC_ASSERT (std::is_sorted(_bounds.begin(), _bounds.end()));
+}
+
+
+void
+Metrics::Histogram::observe (double value)
+{
+	auto const bucket = std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin();
+	boost::mutex::scoped_lock lm (_mutex);
+	++_counts[bucket];
+	_sum += value;
+}
+
+
+/** Caller must hold a lock on _mutex */
+Metrics::Family&
+Metrics::family (string name, string type, string help)
+{
+	auto& f = _families[name];
+	if (f.type.empty()) {
+		f.type = type;
+		f.help = help;
+	}
+	/* Each name can only be used for one type of metric */
+	DCPOMATIC_ASSERT (f.type == type);
+	return f;
+}
+
+
+Metrics::Counter&
+Metrics::counter (string name, string help, Labels labels)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	auto& c = family(name, "counter", help).counters[labels];
+	if (!c) {
+		c.reset (new Counter());
+	}
+	return *c;
+}
+
+
+Metrics::Gauge&
+Metrics::gauge (string name, string help, Labels labels)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	auto& g = family(name, "gauge", help).gauges[labels];
+	if (!g) {
+		g.reset (new Gauge());
+	}
+	return *g;
+}
+
+
+Metrics::Histogram&
+Metrics::histogram (string name, string help, vector<double> bounds, Labels labels)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	auto& h = family(name, "histogram", help).histograms[labels];
+	if (!h) {
+		h.reset (new Histogram(bounds));
+	}
+	return *h;
+}
+
+
+static
+string
+escape (string s, bool quotes)
+{
+	string out;
+	for (auto c: s) {
+		if (c == '\\') {
+			out += "\\\\";
+		} else if (c == '\n') {
+			out += "\\n";
+		} else if (c == '"' && quotes) {
+			out += "\\\"";
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
+
+
+/** @param extra Extra label to add after the others, already formatted as name="value", or empty */
+static
+string
+format_labels (Metrics::Labels const& labels, string extra = "")
+{
+	if (labels.empty() && extra.empty()) {
+		return {};
+	}
+
+	string out = "{";
+	for (auto const& i: labels) {
+		if (out.length() > 1) {
+			out += ",";
+		}
+		out += i.first + "=\"" + escape(i.second, true) + "\"";
+	}
+	if (!extra.empty()) {
+		if (out.length() > 1) {
+			out += ",";
+		}
+		out += extra;
+	}
+	return out + "}";
+}
+
+
+string
+Metrics::prometheus () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	string out;
+	for (auto const& i: _families) {
+		auto const& name = i.first;
+		auto const& f = i.second;
+
+		out += "# HELP " + name + " " + escape(f.help, false) + "\n";
+		out += "# TYPE " + name + " " + f.type + "\n";
+
+		for (auto const& j: f.counters) {
+			out += name + format_labels(j.first) + " " + raw_convert<string>(j.second->value()) + "\n";
+		}
+
+		for (auto const& j: f.gauges) {
+			out += name + format_labels(j.first) + " " + raw_convert<string>(j.second->value()) + "\n";
+		}
+
+		for (auto const& j: f.histograms) {
+			auto const& h = *j.second;
+			boost::mutex::scoped_lock lm2 (h._mutex);
+			int64_t total = 0;
+			for (size_t k = 0; k < h._bounds.size(); ++k) {
+				total += h._counts[k];
+				out += name + "_bucket" + format_labels(j.first, "le=\"" + raw_convert<string>(h._bounds[k]) + "\"") + " " + raw_convert<string>(total) + "\n";
+			}
+			total += h._counts.back();
+			out += name + "_bucket" + format_labels(j.first, "le=\"+Inf\"") + " " + raw_convert<string>(total) + "\n";
+			out += name + "_sum" + format_labels(j.first) + " " + raw_convert<string>(h._sum) + "\n";
+			out += name + "_count" + format_labels(j.first) + " " + raw_convert<string>(total) + "\n";
+		}
+	}
+
+	return out;
+}
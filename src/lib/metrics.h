@@ -0,0 +1,129 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_METRICS_H
+#define DCPOMATIC_METRICS_H
+
+
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/** @class Metrics
+ *  @brief Collection of counters, gauges and histograms describing what the encoder, writer,
+ *  butler and encode server are doing, which can be given to a monitoring system such as
+ *  Prometheus.
+ *
+ *  Each metric is made the first time it is asked for and then lives for as long as the
+ *  program, so callers on busy paths can ask once and keep the reference.
+ */
+class Metrics
+{
+public:
+	Metrics (Metrics const&) = delete;
+	Metrics& operator= (Metrics const&) = delete;
+
+	typedef std::map<std::string, std::string> Labels;
+
+	class Counter
+	{
+	public:
+		void add (int64_t n = 1) {
+			_value += n;
+		}
+
+		int64_t value () const {
+			return _value;
+		}
+
+	private:
+		std::atomic<int64_t> _value{0};
+	};
+
+	class Gauge
+	{
+	public:
+		void set (double value) {
+			_value = value;
+		}
+
+		double value () const {
+			return _value;
+		}
+
+	private:
+		std::atomic<double> _value{0};
+	};
+
+	class Histogram
+	{
+	public:
+		/** @param bounds Upper bounds of each bucket, in ascending order */
+		explicit Histogram (std::vector<double> bounds);
+
+		void observe (double value);
+
+	private:
+		friend class Metrics;
+
+		mutable boost::mutex _mutex;
+		std::vector<double> _bounds;
+		/** number of observations in each bucket (not cumulative), with the last being those above all the bounds */
+		std::vector<int64_t> _counts;
+		double _sum = 0;
+	};
+
+	Counter& counter (std::string name, std::string help, Labels labels = Labels());
+	Gauge& gauge (std::string name, std::string help, Labels labels = Labels());
+	Histogram& histogram (std::string name, std::string help, std::vector<double> bounds, Labels labels = Labels());
+
+	/** @return Every metric in Prometheus' text exposition format */
+	std::string prometheus () const;
+
+	static Metrics* instance ();
+
+private:
+	Metrics () = default;
+
+	struct Family
+	{
+		std::string type;
+		std::string help;
+		std::map<Labels, std::unique_ptr<Counter>> counters;
+		std::map<Labels, std::unique_ptr<Gauge>> gauges;
+		std::map<Labels, std::unique_ptr<Histogram>> histograms;
+	};
+
+	Family& family (std::string name, std::string type, std::string help);
+
+	mutable boost::mutex _mutex;
+	std::map<std::string, Family> _families;
+
+	static Metrics* _instance;
+};
+
+
+#endif
@@ -65,19 +65,32 @@ shared_ptr<AudioBuffers>
 MidSideDecoder::run (shared_ptr<const AudioBuffers> in, int channels)
 {
 	int const N = min (channels, 3);
-	auto out = make_shared<AudioBuffers>(channels, in->frames ());
-	for (int i = 0; i < in->frames(); ++i) {
-		auto const left = in->data()[0][i];
-		auto const right = in->data()[1][i];
-		auto const mid = (left + right) / 2;
-		if (N > 0) {
-			out->data()[0][i] = left - mid;
+	int const frames = in->frames();
+	auto out = make_shared<AudioBuffers>(channels, frames);
+
+	auto const left = in->data(0);
+	auto const right = in->data(1);
+
+	if (N == 3) {
+		/* Make all three outputs in one pass, with no tests inside the loop so that it can be vectorised */
+		auto side_left = out->data(0);
+		auto side_right = out->data(1);
+		auto mid = out->data(2);
+		for (int i = 0; i < frames; ++i) {
+			auto const m = (left[i] + right[i]) / 2;
+			side_left[i] = left[i] - m;
+			side_right[i] = right[i] - m;
+			mid[i] = m;
 		}
-		if (N > 1) {
-			out->data()[1][i] = right - mid;
-		}
-		if (N > 2) {
-			out->data()[2][i] = mid;
+	} else {
+		for (int i = 0; i < frames; ++i) {
+			auto const mid = (left[i] + right[i]) / 2;
+			if (N > 0) {
+				out->data()[0][i] = left[i] - mid;
+			}
+			if (N > 1) {
+				out->data()[1][i] = right[i] - mid;
+			}
 		}
 	}
 
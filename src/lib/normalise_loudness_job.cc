@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "normalise_loudness_job.h"
+#include "audio_analysis.h"
+#include "audio_content.h"
+#include "compose.hpp"
+#include "dcpomatic_log.h"
+#include "film.h"
+#include "playlist.h"
+
+#include "i18n.h"
+
+
+using std::shared_ptr;
+using std::string;
+using boost::optional;
+
+
+/** @param target integrated loudness to aim for, in LUFS */
+NormaliseLoudnessJob::NormaliseLoudnessJob (shared_ptr<Film> film, double target)
+	: AnalyseAudioJob (film, film->playlist(), false)
+	, _normalise_film (film)
+	, _target (target)
+{
+
+}
+
+
+NormaliseLoudnessJob::~NormaliseLoudnessJob ()
+{
+	stop_thread ();
+}
+
+
+string
+NormaliseLoudnessJob::name () const
+{
+	return _("Normalising loudness");
+}
+
+
+string
+NormaliseLoudnessJob::json_name () const
+{
+	return N_("normalise_loudness");
+}
+
+
+/** As with ExamineContentJob we guess that content in the same directory is on the same storage */
+optional<string>
+NormaliseLoudnessJob::parallel_storage () const
+{
+	for (auto i: _normalise_film->content()) {
+		if (i->audio && !i->paths().empty()) {
+			return i->paths().front().parent_path().string();
+		}
+	}
+
+	return {};
+}
+
+
+/** Unlike a plain analysis, we change the content's gain, so we must not do that during an encode */
+bool
+NormaliseLoudnessJob::depends_on (Job const& earlier) const
+{
+	return Job::depends_on (earlier);
+}
+
+
+void
+NormaliseLoudnessJob::run ()
+{
+	auto analysis = make_analysis ();
+	analysis.write (path());
+
+	if (!analysis.integrated_loudness()) {
+		set_progress (1);
+		set_state (FINISHED_ERROR);
+		set_error (_("Could not measure the loudness of this film's audio."), "");
+		return;
+	}
+
+	_gain = _target - *analysis.integrated_loudness();
+	LOG_GENERAL("Normalising loudness of %1 from %2 to %3 LUFS", _normalise_film->name(), *analysis.integrated_loudness(), _target);
+
+	for (auto i: _normalise_film->content()) {
+		if (i->audio) {
+			i->audio->set_gain (i->audio->gain() + *_gain);
+		}
+	}
+
+	auto const playlist = _normalise_film->playlist();
+	if (playlist->content().size() != 1) {
+		/* Gains are part of the path of an analysis of more than one piece of content,
+		 * so write one for the new gains, saving a later re-analysis.  The analysis of
+		 * a single piece of content records its gain, so that is still valid.
+		 */
+		analysis.apply_gain (*_gain);
+		analysis.write (_normalise_film->audio_analysis_path(playlist));
+	}
+
+	_normalise_film->write_metadata ();
+
+	set_progress (1);
+	set_state (FINISHED_OK);
+}
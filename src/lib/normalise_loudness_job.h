@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/normalise_loudness_job.h
+ *  @brief NormaliseLoudnessJob class.
+ */
+
+
+#include "analyse_audio_job.h"
+
+
+class Film;
+
+
+/** @class NormaliseLoudnessJob
+ *  @brief A job to analyse the audio of a film and then change the gain of all its
+ *  audio content so that the film's integrated loudness becomes some target.
+ *
+ *  The analysis is written to Film::audio_analysis_path as AnalyseAudioJob would do,
+ *  and the film's metadata is saved with the new gains.  These jobs can run alongside
+ *  each other, so many films can be normalised at once.
+ */
+class NormaliseLoudnessJob : public AnalyseAudioJob
+{
+public:
+	NormaliseLoudnessJob (std::shared_ptr<Film> film, double target);
+	~NormaliseLoudnessJob ();
+
+	std::string name () const override;
+	std::string json_name () const override;
+	void run () override;
+	boost::optional<std::string> parallel_storage () const override;
+	bool depends_on (Job const& earlier) const override;
+
+	/** @return gain in dB that was added to each piece of audio content, if the job has finished */
+	boost::optional<double> gain () const {
+		return _gain;
+	}
+
+private:
+	std::shared_ptr<Film> _normalise_film;
+	/** target integrated loudness in LUFS */
+	double _target;
+	boost::optional<double> _gain;
+};
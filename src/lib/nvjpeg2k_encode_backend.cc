@@ -0,0 +1,253 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "dcpomatic_assert.h"
+#include "exceptions.h"
+#include "nvjpeg2k_encode_backend.h"
+#include <dcp/openjpeg_image.h>
+#include <cstring>
+
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+/** Highest target PSNR that we will ask for, in dB */
+static float const maximum_psnr = 60;
+/** Lowest target PSNR that we will ask for before giving up, in dB */
+static float const minimum_psnr = 20;
+
+
+static void
+check_cuda (cudaError_t error, string function)
+{
+	if (error != cudaSuccess) {
+		throw EncodeError (String::compose("%1 failed (%2)", function, cudaGetErrorString(error)));
+	}
+}
+
+
+static void
+check_nvjpeg2k (nvjpeg2kStatus_t status, string function)
+{
+	if (status != NVJPEG2K_STATUS_SUCCESS) {
+		throw EncodeError (function, "NVJPEG2KEncodeBackend", static_cast<int>(status));
+	}
+}
+
+
+NVJPEG2KEncodeBackend::NVJPEG2KEncodeBackend (int device)
+	: _device (device)
+	, _psnr (maximum_psnr)
+{
+	check_cuda (cudaSetDevice(_device), "cudaSetDevice");
+	check_cuda (cudaStreamCreateWithFlags(&_stream, cudaStreamNonBlocking), "cudaStreamCreateWithFlags");
+	check_nvjpeg2k (nvjpeg2kEncoderCreateSimple(&_encoder), "nvjpeg2kEncoderCreateSimple");
+	check_nvjpeg2k (nvjpeg2kEncodeStateCreate(_encoder, &_state), "nvjpeg2kEncodeStateCreate");
+	check_nvjpeg2k (nvjpeg2kEncodeParamsCreate(&_params), "nvjpeg2kEncodeParamsCreate");
+}
+
+
+NVJPEG2KEncodeBackend::~NVJPEG2KEncodeBackend ()
+{
+	free_device_data ();
+
+	if (_params) {
+		nvjpeg2kEncodeParamsDestroy (_params);
+	}
+	if (_state) {
+		nvjpeg2kEncodeStateDestroy (_state);
+	}
+	if (_encoder) {
+		nvjpeg2kEncoderDestroy (_encoder);
+	}
+	if (_stream) {
+		cudaStreamDestroy (_stream);
+	}
+}
+
+
+void
+NVJPEG2KEncodeBackend::free_device_data ()
+{
+	for (int i = 0; i < 3; ++i) {
+		if (_device_data[i]) {
+			cudaFree (_device_data[i]);
+			_device_data[i] = nullptr;
+		}
+	}
+}
+
+
+void
+NVJPEG2KEncodeBackend::allocate (dcp::Size size)
+{
+	if (size == _size) {
+		return;
+	}
+
+	free_device_data ();
+
+	for (int i = 0; i < 3; ++i) {
+		check_cuda (
+			cudaMallocPitch(reinterpret_cast<void**>(&_device_data[i]), &_device_pitch[i], size.width * sizeof(uint16_t), size.height),
+			"cudaMallocPitch"
+			);
+	}
+
+	_host_data.resize (size.width * size.height);
+	_size = size;
+}
+
+
+/** Encode the image that is already on the device */
+vector<uint8_t>
+NVJPEG2KEncodeBackend::encode_once (dcp::Size size, bool four_k, float psnr)
+{
+	nvjpeg2kImageComponentInfo_t info[3];
+	for (int i = 0; i < 3; ++i) {
+		info[i].component_width = size.width;
+		info[i].component_height = size.height;
+		info[i].precision = 12;
+		info[i].sgn = 0;
+	}
+
+	/* Apply the parts of the DCI profile that nvJPEG2000 lets us choose */
+	nvjpeg2kEncodeConfig_t config;
+	memset (&config, 0, sizeof(config));
+	config.stream_type = NVJPEG2K_STREAM_J2K;
+	config.color_space = NVJPEG2K_COLORSPACE_SRGB;
+	config.image_width = size.width;
+	config.image_height = size.height;
+	config.num_components = 3;
+	config.image_comp_info = info;
+	config.code_block_w = 32;
+	config.code_block_h = 32;
+	config.irreversible = 1;
+	config.mct_mode = 1;
+	config.prog_order = NVJPEG2K_CPRL;
+	config.num_resolutions = four_k ? 7 : 6;
+
+	check_nvjpeg2k (nvjpeg2kEncodeParamsSetEncodeConfig(_params, &config), "nvjpeg2kEncodeParamsSetEncodeConfig");
+	check_nvjpeg2k (nvjpeg2kEncodeParamsSetQuality(_params, psnr), "nvjpeg2kEncodeParamsSetQuality");
+
+	nvjpeg2kImage_t image;
+	image.pixel_data = reinterpret_cast<void**>(_device_data);
+	image.pitch_in_bytes = _device_pitch;
+	image.pixel_type = NVJPEG2K_UINT16;
+	image.num_components = 3;
+
+	check_nvjpeg2k (nvjpeg2kEncode(_encoder, _state, _params, &image, _stream), "nvjpeg2kEncode");
+
+	size_t length = 0;
+	check_nvjpeg2k (nvjpeg2kEncodeRetrieveBitstream(_encoder, _state, nullptr, &length, _stream), "nvjpeg2kEncodeRetrieveBitstream");
+	vector<uint8_t> codestream (length);
+	check_nvjpeg2k (nvjpeg2kEncodeRetrieveBitstream(_encoder, _state, codestream.data(), &length, _stream), "nvjpeg2kEncodeRetrieveBitstream");
+	check_cuda (cudaStreamSynchronize(_stream), "cudaStreamSynchronize");
+	codestream.resize (length);
+
+	return codestream;
+}
+
+
+/** Add a COM marker segment containing @p comment to the main header of @p codestream */
+static void
+add_comment (vector<uint8_t>& codestream, string comment)
+{
+	/* The first SOT marker is the end of the main header; find it by walking over the
+	   marker segments after SOC.
+	*/
+	size_t offset = 2;
+	while (offset + 4 <= codestream.size()) {
+		if (codestream[offset] == 0xff && codestream[offset + 1] == 0x90) {
+			break;
+		}
+		offset += 2 + ((codestream[offset + 2] << 8) | codestream[offset + 3]);
+	}
+
+	DCPOMATIC_ASSERT (offset + 4 <= codestream.size());
+
+	auto const length = 4 + comment.length();
+	vector<uint8_t> com = {
+		0xff, 0x64,
+		static_cast<uint8_t>((length >> 8) & 0xff), static_cast<uint8_t>(length & 0xff),
+		/* Latin text */
+		0x00, 0x01
+	};
+	com.insert (com.end(), comment.begin(), comment.end());
+	codestream.insert (codestream.begin() + offset, com.begin(), com.end());
+}
+
+
+dcp::ArrayData
+NVJPEG2KEncodeBackend::encode (shared_ptr<dcp::OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool three_d, bool four_k, string comment)
+{
+	auto const size = xyz->size();
+
+	check_cuda (cudaSetDevice(_device), "cudaSetDevice");
+	allocate (size);
+
+	for (int c = 0; c < 3; ++c) {
+		auto in = xyz->data(c);
+		auto out = _host_data.data();
+		auto const pixels = size.width * size.height;
+		for (int i = 0; i < pixels; ++i) {
+			*out++ = static_cast<uint16_t>(*in++);
+		}
+		check_cuda (
+			cudaMemcpy2DAsync(
+				_device_data[c], _device_pitch[c],
+				_host_data.data(), size.width * sizeof(uint16_t),
+				size.width * sizeof(uint16_t), size.height,
+				cudaMemcpyHostToDevice, _stream),
+			"cudaMemcpy2DAsync"
+			);
+		/* _host_data is re-used for the next component */
+		check_cuda (cudaStreamSynchronize(_stream), "cudaStreamSynchronize");
+	}
+
+	/* The same limit that libdcp applies for OpenJPEG */
+	auto maximum_size = static_cast<size_t>(bandwidth) / 8 / frames_per_second;
+	if (three_d) {
+		/* In 3D we have only half the normal bandwidth per eye */
+		maximum_size /= 2;
+	}
+	/* Leave some room for the comment */
+	maximum_size -= std::min(maximum_size, comment.length() + 6);
+
+	auto psnr = _psnr;
+	while (true) {
+		auto codestream = encode_once (size, four_k, psnr);
+		if (codestream.size() <= maximum_size) {
+			/* Next time, try for a bit better quality than this */
+			_psnr = std::min(maximum_psnr, psnr + 1);
+			add_comment (codestream, comment);
+			return dcp::ArrayData (codestream.data(), codestream.size());
+		}
+
+		psnr -= 2;
+		if (psnr < minimum_psnr) {
+			throw EncodeError (String::compose("Could not encode frame within %1 bytes", maximum_size));
+		}
+	}
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_NVJPEG2K_ENCODE_BACKEND_H
+#define DCPOMATIC_NVJPEG2K_ENCODE_BACKEND_H
+
+
+#include "j2k_encode_backend.h"
+#include <dcp/types.h>
+#include <cuda_runtime_api.h>
+#include <nvjpeg2k.h>
+#include <vector>
+
+
+/** @class NVJPEG2KEncodeBackend
+ *  @brief J2KEncodeBackend which uses NVIDIA's nvJPEG2000 to encode on a GPU.
+ *
+ *  nvJPEG2000 has no byte-rate control, so we search for a target PSNR which gives
+ *  a codestream within the DCP's bandwidth, starting each frame from the PSNR
+ *  which worked for the last one.
+ */
+class NVJPEG2KEncodeBackend : public J2KEncodeBackend
+{
+public:
+	explicit NVJPEG2KEncodeBackend (int device);
+	~NVJPEG2KEncodeBackend ();
+
+	std::string name () const override {
+		return "nvjpeg2k";
+	}
+
+	dcp::ArrayData encode (
+		std::shared_ptr<dcp::OpenJPEGImage> xyz,
+		int bandwidth,
+		int frames_per_second,
+		bool three_d,
+		bool four_k,
+		std::string comment
+		) override;
+
+private:
+	void allocate (dcp::Size size);
+	void free_device_data ();
+	std::vector<uint8_t> encode_once (dcp::Size size, bool four_k, float psnr);
+
+	int _device;
+	cudaStream_t _stream = nullptr;
+	nvjpeg2kEncoder_t _encoder = nullptr;
+	nvjpeg2kEncodeState_t _state = nullptr;
+	nvjpeg2kEncodeParams_t _params = nullptr;
+
+	/** Size of the images that _device_data is allocated for */
+	dcp::Size _size;
+	/** One component of the image, converted to 16-bit, ready to copy to the device */
+	std::vector<uint16_t> _host_data;
+	uint16_t* _device_data[3] = { nullptr, nullptr, nullptr };
+	size_t _device_pitch[3] = { 0, 0, 0 };
+
+	/** Target PSNR which gave a small-enough frame last time */
+	float _psnr;
+};
+
+
+#endif
@@ -0,0 +1,36 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "parsed_file_cache.h"
+#include <dcp/raw_convert.h>
+
+
+using std::string;
+
+
+string
+parsed_file_key (boost::filesystem::path path, string digest)
+{
+	/* The digest may be out of date if the file has been changed since its content was examined */
+	boost::system::error_code ec;
+	auto const last_write = boost::filesystem::last_write_time(path, ec);
+	return path.string() + "\n" + digest + "\n" + dcp::raw_convert<string>(static_cast<int64_t>(ec ? 0 : last_write));
+}
@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_PARSED_FILE_CACHE_H
+#define DCPOMATIC_PARSED_FILE_CACHE_H
+
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+
+/** @class ParsedFileCache
+ *  @brief A store of things that have been parsed from files, so that everything which reads the
+ *  same file (examiners and any number of decoders) can share one parse of it.  Parses are only
+ *  held here as long as something else is holding them.
+ */
+template <class T>
+class ParsedFileCache
+{
+public:
+	/** @param key Something which identifies the file, and changes if the file does; see parsed_file_key().
+	 *  @param parse Function to parse the file if we do not have it already.
+	 */
+	std::shared_ptr<const T> get (std::string const& key, std::function<std::shared_ptr<const T> ()> parse)
+	{
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			auto i = _parsed.find (key);
+			if (i != _parsed.end()) {
+				if (auto parsed = i->second.lock()) {
+					return parsed;
+				}
+			}
+		}
+
+		/* Parse without the lock so that other files can be looked up meanwhile */
+		auto parsed = parse ();
+
+		boost::mutex::scoped_lock lm (_mutex);
+		for (auto i = _parsed.begin(); i != _parsed.end(); ) {
+			if (i->second.expired()) {
+				i = _parsed.erase (i);
+			} else {
+				++i;
+			}
+		}
+
+		auto& existing = _parsed[key];
+		if (auto other = existing.lock()) {
+			/* Someone else parsed it while we were doing the same */
+			return other;
+		}
+
+		existing = parsed;
+		return parsed;
+	}
+
+private:
+	boost::mutex _mutex;
+	std::map<std::string, std::weak_ptr<const T>> _parsed;
+};
+
+
+/** @return a key for ParsedFileCache made from a file's path, its digest and its modification time */
+extern std::string parsed_file_key (boost::filesystem::path path, std::string digest);
+
+
+#endif
@@ -0,0 +1,237 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "exceptions.h"
+#include "performance_report.h"
+#include <dcp/raw_convert.h>
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+LIBDCP_ENABLE_WARNINGS
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "i18n.h"
+
+
+using std::string;
+using std::vector;
+using dcp::raw_convert;
+
+
+int const PerformanceReport::history_size = 100;
+
+
+PerformanceReport::PerformanceReport (cxml::ConstNodePtr node)
+	: version (node->string_child("Version"))
+	, date (node->string_child("Date"))
+	, frames (node->number_child<int>("Frames"))
+	, encode_time (node->number_child<double>("EncodeTime"))
+	, write_time (node->number_child<double>("WriteTime"))
+	, digest_time (node->number_child<double>("DigestTime"))
+	, finish_time (node->number_child<double>("FinishTime"))
+	, full_written (node->number_child<int>("FullWritten"))
+	, fake_written (node->number_child<int>("FakeWritten"))
+	, repeat_written (node->number_child<int>("RepeatWritten"))
+	, passed_through (node->number_child<int>("PassedThrough"))
+	, spilled (node->number_child<int>("Spilled"))
+	, total_peak_memory (node->number_child<int64_t>("TotalPeakMemory"))
+{
+	vector<string> seconds;
+	auto const fps = node->string_child("FramesPerSecond");
+	if (!fps.empty()) {
+		boost::algorithm::split (seconds, fps, boost::is_any_of(" "));
+		for (auto const& i: seconds) {
+			frames_per_second.push_back (raw_convert<int>(i));
+		}
+	}
+
+	for (auto i: node->node_children("Encoder")) {
+		frames_by_encoder[i->string_attribute("Name")] = raw_convert<int>(i->content());
+	}
+
+	for (auto i: node->node_children("PeakMemory")) {
+		peak_memory[i->string_attribute("Subsystem")] = raw_convert<int64_t>(i->content());
+	}
+}
+
+
+double
+PerformanceReport::mean_fps () const
+{
+	if (encode_time <= 0) {
+		return 0;
+	}
+
+	return frames / encode_time;
+}
+
+
+/** @param percentile Percentile between 0 and 100.
+ *  @return Frames per second that the encode managed in at least @p percentile percent of its seconds;
+ *  the last second is not counted as it will usually be only partly used.
+ */
+double
+PerformanceReport::percentile_fps (float percentile) const
+{
+	if (frames_per_second.size() < 2) {
+		return mean_fps ();
+	}
+
+	vector<int> sorted (frames_per_second.begin(), std::prev(frames_per_second.end()));
+	std::sort (sorted.begin(), sorted.end());
+	auto const index = static_cast<size_t>(std::floor((100 - percentile) * (sorted.size() - 1) / 100));
+	return sorted[index];
+}
+
+
+void
+PerformanceReport::as_xml (xmlpp::Element* node) const
+{
+	node->add_child("Version")->add_child_text(version);
+	node->add_child("Date")->add_child_text(date);
+	node->add_child("Frames")->add_child_text(raw_convert<string>(frames));
+
+	string fps;
+	for (auto i: frames_per_second) {
+		if (!fps.empty()) {
+			fps += " ";
+		}
+		fps += raw_convert<string>(i);
+	}
+	node->add_child("FramesPerSecond")->add_child_text(fps);
+
+	for (auto const& i: frames_by_encoder) {
+		auto e = node->add_child("Encoder");
+		e->set_attribute("Name", i.first);
+		e->add_child_text(raw_convert<string>(i.second));
+	}
+
+	node->add_child("EncodeTime")->add_child_text(raw_convert<string>(encode_time, 3, true));
+	node->add_child("WriteTime")->add_child_text(raw_convert<string>(write_time, 3, true));
+	node->add_child("DigestTime")->add_child_text(raw_convert<string>(digest_time, 3, true));
+	node->add_child("FinishTime")->add_child_text(raw_convert<string>(finish_time, 3, true));
+	node->add_child("FullWritten")->add_child_text(raw_convert<string>(full_written));
+	node->add_child("FakeWritten")->add_child_text(raw_convert<string>(fake_written));
+	node->add_child("RepeatWritten")->add_child_text(raw_convert<string>(repeat_written));
+	node->add_child("PassedThrough")->add_child_text(raw_convert<string>(passed_through));
+	node->add_child("Spilled")->add_child_text(raw_convert<string>(spilled));
+
+	for (auto const& i: peak_memory) {
+		auto e = node->add_child("PeakMemory");
+		e->set_attribute("Subsystem", i.first);
+		e->add_child_text(raw_convert<string>(i.second));
+	}
+	node->add_child("TotalPeakMemory")->add_child_text(raw_convert<string>(total_peak_memory));
+}
+
+
+/** @return Summary of the report for the user */
+string
+PerformanceReport::summary () const
+{
+	auto megabytes = [](int64_t bytes) {
+		return String::compose("%1MB", bytes / (1024 * 1024));
+	};
+
+	auto fps = [](double rate) {
+		return raw_convert<string>(rate, 1, true);
+	};
+
+	auto s = String::compose(_("%1 frames at %2 fps on average"), frames, fps(mean_fps()));
+	if (frames_per_second.size() > 1) {
+		s += String::compose(_(" (%1 fps or better in 95%% of seconds, %2 fps median)"), fps(percentile_fps(95)), fps(percentile_fps(50)));
+	}
+	s += "\n";
+
+	int encoded = 0;
+	for (auto const& i: frames_by_encoder) {
+		encoded += i.second;
+	}
+	for (auto const& i: frames_by_encoder) {
+		s += String::compose(_("Encoded by %1: %2 frames (%3%%)\n"), i.first, i.second, std::round(i.second * 100.0 / encoded));
+	}
+
+	s += String::compose(
+		_("Time encoding %1s, writing %2s, calculating digests %3s, finishing %4s\n"),
+		raw_convert<string>(encode_time, 1, true),
+		raw_convert<string>(write_time, 1, true),
+		raw_convert<string>(digest_time, 1, true),
+		raw_convert<string>(finish_time, 1, true)
+		);
+
+	s += String::compose(
+		_("%1 frames written, %2 already written, %3 repeated, %4 passed through without re-encoding, %5 spilled to disk\n"),
+		full_written, fake_written, repeat_written, passed_through, spilled
+		);
+
+	s += String::compose(_("Peak memory use %1"), megabytes(total_peak_memory));
+	return s;
+}
+
+
+/** Add this report to a file of reports, keeping only the most recent history_size */
+void
+PerformanceReport::add_to (boost::filesystem::path file) const
+{
+	auto reports = read (file);
+	reports.push_back (*this);
+	if (reports.size() > static_cast<size_t>(history_size)) {
+		reports.erase (reports.begin(), reports.end() - history_size);
+	}
+
+	xmlpp::Document doc;
+	auto root = doc.create_root_node ("Performance");
+	for (auto const& i: reports) {
+		i.as_xml (root->add_child("Report"));
+	}
+
+	try {
+		doc.write_to_file_formatted (file.string());
+	} catch (xmlpp::exception& e) {
+		string s = e.what ();
+		boost::algorithm::trim (s);
+		throw FileError (s, file);
+	}
+}
+
+
+/** @return Reports in @p file, oldest first, or an empty list if it does not exist or cannot be read */
+vector<PerformanceReport>
+PerformanceReport::read (boost::filesystem::path file)
+{
+	vector<PerformanceReport> reports;
+
+	try {
+		cxml::Document f ("Performance");
+		f.read_file (file);
+		for (auto i: f.node_children("Report")) {
+			reports.push_back (PerformanceReport(i));
+		}
+	} catch (...) {
+		/* Never mind; we'll start again */
+		reports.clear ();
+	}
+
+	return reports;
+}
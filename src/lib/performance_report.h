@@ -0,0 +1,103 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_PERFORMANCE_REPORT_H
+#define DCPOMATIC_PERFORMANCE_REPORT_H
+
+
+#include <libcxml/cxml.h>
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace xmlpp {
+	class Element;
+}
+
+
+/** @class PerformanceReport
+ *  @brief Summary of how fast a DCP encode went and where its time and memory went.
+ *
+ *  One of these is made at the end of each successful encode and added to the
+ *  film's performance.xml, so that runs with different versions, settings or
+ *  encoding servers can be compared.
+ */
+class PerformanceReport
+{
+public:
+	PerformanceReport () {}
+	explicit PerformanceReport (cxml::ConstNodePtr node);
+
+	/** version of DCP-o-matic which made the DCP */
+	std::string version;
+	/** time that the encode finished, in ISO8601 format */
+	std::string date;
+
+	/** video frames given to the writer */
+	int frames = 0;
+	/** video frames given to the writer in each second of the encode */
+	std::vector<int> frames_per_second;
+	/** frames J2K-encoded by each encoder: "local", "GPU" or a server's host name */
+	std::map<std::string, int> frames_by_encoder;
+
+	/** wall-clock time from the start of the encode until the last frame was encoded, in seconds */
+	double encode_time = 0;
+	/** time that the writer threads spent writing frames to the picture asset, in seconds */
+	double write_time = 0;
+	/** time spent calculating digests of the finished assets, in seconds */
+	double digest_time = 0;
+	/** time spent finishing the DCP after the last frame was encoded, not counting digest_time, in seconds */
+	double finish_time = 0;
+
+	/** frames written from newly-encoded or passed-through J2K data */
+	int full_written = 0;
+	/** frames which were already in the picture asset from a previous run */
+	int fake_written = 0;
+	/** frames written by repeating an identical earlier one */
+	int repeat_written = 0;
+	/** frames whose existing J2K data was written without re-encoding */
+	int passed_through = 0;
+	/** frames which the writer had to put into its spill file */
+	int spilled = 0;
+
+	/** peak memory used by each part of the pipeline, in bytes, keyed by MemoryBudget::name() */
+	std::map<std::string, int64_t> peak_memory;
+	/** peak memory used by the whole pipeline, in bytes */
+	int64_t total_peak_memory = 0;
+
+	double mean_fps () const;
+	double percentile_fps (float percentile) const;
+
+	void as_xml (xmlpp::Element* node) const;
+	std::string summary () const;
+
+	void add_to (boost::filesystem::path file) const;
+	static std::vector<PerformanceReport> read (boost::filesystem::path file);
+
+	/** maximum number of reports to keep in a film's performance file */
+	static int const history_size;
+};
+
+
+#endif
@@ -29,6 +29,7 @@
 
 
 class Content;
+class DecodeAhead;
 class Decoder;
 
 
@@ -39,13 +40,20 @@ public:
 		: content (c)
 		, decoder (d)
 		, frc (f)
+		, video_times (f.dcp)
 		, done (false)
 	{}
 
 	std::shared_ptr<Content> content;
 	std::shared_ptr<Decoder> decoder;
+	/** what the Player uses to drive decoder */
+	std::shared_ptr<DecodeAhead> decode_ahead;
 	boost::optional<dcpomatic::DCPTimePeriod> ignore_video;
 	FrameRateChange frc;
+	/** conversions between DCPTime and frames at the DCP's video rate */
+	dcpomatic::FrameTimes<dcpomatic::DCPTime> video_times;
+	/** conversions between DCPTime and frames at the DCP's audio rate */
+	dcpomatic::FrameTimes<dcpomatic::DCPTime> audio_times{48000};
 	bool done;
 };
 
@@ -31,16 +31,20 @@
 #include "dcp_content.h"
 #include "dcp_decoder.h"
 #include "dcpomatic_log.h"
+#include "decode_ahead.h"
 #include "decoder.h"
 #include "decoder_factory.h"
 #include "ffmpeg_content.h"
+#include "ffmpeg_decoder.h"
 #include "film.h"
 #include "frame_rate_change.h"
 #include "image.h"
 #include "image_decoder.h"
+#include "image_proxy.h"
 #include "job.h"
 #include "log.h"
 #include "maths_util.h"
+#include "memory_budget.h"
 #include "piece.h"
 #include "player.h"
 #include "player_video.h"
@@ -51,7 +55,9 @@
 #include "shuffler.h"
 #include "text_content.h"
 #include "text_decoder.h"
+#include "text_render_pool.h"
 #include "timer.h"
+#include "trace.h"
 #include "video_decoder.h"
 #include <dcp/reel.h>
 #include <dcp/reel_closed_caption_asset.h>
@@ -60,6 +66,7 @@
 #include <dcp/reel_subtitle_asset.h>
 #include <algorithm>
 #include <iostream>
+#include <map>
 #include <stdint.h>
 
 #include "i18n.h"
@@ -77,6 +84,7 @@ using std::min;
 using std::min;
 using std::pair;
 using std::shared_ptr;
+using std::string;
 using std::vector;
 using std::weak_ptr;
 using boost::optional;
@@ -99,6 +107,47 @@ int const PlayerProperty::IGNORE_TEXT = 708;
 int const PlayerProperty::ALWAYS_BURN_OPEN_SUBTITLES = 709;
 int const PlayerProperty::PLAY_REFERENCED = 710;
 
+/** Number of passes that each piece's decoder may run ahead of us */
+static int const decode_ahead_passes = 8;
+
+
+/** @return Memory used by something that a decoder emitted, as far as we can tell */
+template <class... Args>
+static size_t
+emission_memory (Args const&...)
+{
+	return 0;
+}
+
+
+static size_t
+emission_memory (ContentVideo const& video)
+{
+	return video.image ? video.image->memory_used() : 0;
+}
+
+
+static size_t
+emission_memory (AudioStreamPtr const&, ContentAudio const& audio)
+{
+	return audio.audio ? audio.audio->frames() * audio.audio->channels() * sizeof(float) : 0;
+}
+
+
+/** @return A function to connect to a decoder signal which gives the signal's parameters to handler,
+ *  via a DecodeAhead so that handler is called at the right time.
+ */
+template <class... Args, class Handler>
+std::function<void (Args...)>
+via (weak_ptr<DecodeAhead> ahead, Handler handler)
+{
+	return [ahead, handler](Args... args) {
+		if (auto a = ahead.lock()) {
+			a->emit(std::bind(handler, args...), emission_memory(args...));
+		}
+	};
+}
+
 
 Player::Player (shared_ptr<const Film> film, Image::Alignment subtitle_alignment)
 	: _film (film)
@@ -161,7 +210,7 @@ Player::connect()
 	   be first.
 	*/
 	_playlist_change_connection = playlist()->Change.connect (bind (&Player::playlist_change, this, _1), boost::signals2::at_front);
-	_playlist_content_change_connection = playlist()->ContentChange.connect (bind(&Player::playlist_content_change, this, _1, _3, _4));
+	_playlist_content_change_connection = playlist()->ContentChange.connect (bind(&Player::playlist_content_change, this, _1, _2, _3, _4));
 }
 
 
@@ -192,7 +241,9 @@ Player::Player(Player&& other)
 	, _active_texts(std::move(other._active_texts))
 	, _audio_processor(std::move(other._audio_processor))
 	, _playback_length(other._playback_length.load())
+	, _decode_threads(other._decode_threads)
 	, _subtitle_alignment(other._subtitle_alignment)
+	, _profile(std::move(other._profile))
 {
 	connect();
 }
@@ -231,7 +282,10 @@ Player::operator=(Player&& other)
 	_active_texts = std::move(other._active_texts);
 	_audio_processor = std::move(other._audio_processor);
 	_playback_length = other._playback_length.load();
+	_decode_threads = other._decode_threads;
+	_piece_times_valid = false;
 	_subtitle_alignment = other._subtitle_alignment;
+	_profile = std::move(other._profile);
 
 	connect();
 
@@ -253,13 +307,161 @@ have_audio (shared_ptr<const Content> content)
 }
 
 
+/** @return true if some of @p content is 3D, so that we need a Shuffler */
+static bool
+have_threed (ContentList const& content)
+{
+	return std::any_of(
+		content.begin(),
+		content.end(),
+		[](shared_ptr<const Content> c) {
+			return c->video && (c->video->frame_type() == VideoFrameType::THREE_D_LEFT || c->video->frame_type() == VideoFrameType::THREE_D_RIGHT);
+		});
+}
+
+
+/** Each piece's decoder runs in its own thread, so we share the decoding threads between the
+ *  FFmpeg video decoders.
+ *  @return Number of decoding threads to give each FFmpeg video decoder for @p content.
+ */
+static int
+decode_threads (ContentList const& content)
+{
+	auto const ffmpeg_videos = std::count_if(
+		content.begin(),
+		content.end(),
+		[](shared_ptr<const Content> c) {
+			return dynamic_pointer_cast<const FFmpegContent>(c) && c->video && c->video->use() && c->paths_valid();
+		});
+	return std::max(1, Config::instance()->decoding_threads() / std::max(1, static_cast<int>(ffmpeg_videos)));
+}
+
+
+/** @return true if we need a Piece for @p content */
+bool
+Player::want_piece (shared_ptr<const Content> content) const
+{
+	if (!content->paths_valid()) {
+		return false;
+	}
+
+	if (_ignore_video && _ignore_audio && content->text.empty()) {
+		/* We're only interested in text and this content has none */
+		return false;
+	}
+
+	if (_ignore_video && _ignore_text && !content->audio) {
+		/* We're only interested in audio and this content has none */
+		return false;
+	}
+
+	return true;
+}
+
+
+/** Make a Piece for some content and connect its decoder to us.  Caller must hold a lock on _mutex.
+ *  @param old_decoder Decoder that we used for this content before, or nullptr.
+ */
+shared_ptr<Piece>
+Player::make_piece (shared_ptr<const Film> film, shared_ptr<Content> content, shared_ptr<Decoder> old_decoder)
+{
+	auto decoder = decoder_factory(film, content, _fast, _tolerant, old_decoder, _decode_threads);
+	DCPOMATIC_ASSERT (decoder);
+
+	FrameRateChange frc(film, content);
+
+	/* This must come before we set up what to ignore, since it can change what the DCPDecoder ignores */
+	auto dcp = dynamic_pointer_cast<DCPDecoder> (decoder);
+	if (dcp) {
+		dcp->set_decode_referenced (_play_referenced);
+		if (_play_referenced) {
+			dcp->set_forced_reduction (_dcp_decode_reduction);
+		}
+	}
+
+	if (decoder->video && _ignore_video) {
+		decoder->video->set_ignore (true);
+	}
+
+	if (decoder->audio && _ignore_audio) {
+		decoder->audio->set_ignore (true);
+	}
+
+	if (_ignore_text) {
+		for (auto i: decoder->text) {
+			i->set_ignore (true);
+		}
+	}
+
+	auto ffmpeg = dynamic_pointer_cast<FFmpegDecoder>(decoder);
+	if (ffmpeg && decoder->video) {
+		ffmpeg->set_reduction (ffmpeg_decode_reduction(film, content));
+	}
+
+	auto piece = make_shared<Piece>(content, decoder, frc);
+	piece->audio_times = FrameTimes<DCPTime>(film->audio_frame_rate());
+	piece->decode_ahead = make_shared<DecodeAhead>(decoder, decode_ahead_passes);
+
+	/* Everything the decoder emits goes through the DecodeAhead, which holds on to it until
+	 * we ask for the pass which emitted it.
+	 */
+	weak_ptr<DecodeAhead> ahead = piece->decode_ahead;
+
+	if (decoder->video) {
+		if (_shuffler) {
+			/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
+			weak_ptr<Piece> weak_piece = piece;
+			decoder->video->Data.connect (via<ContentVideo>(ahead, [this, weak_piece](ContentVideo video) {
+				PlayerProfile::Scope scope(_profile.get(), "shuffler");
+				_shuffler->video(weak_piece, video);
+			}));
+		} else {
+			decoder->video->Data.connect (via<ContentVideo>(ahead, bind(&Player::video, this, weak_ptr<Piece>(piece), _1)));
+		}
+	}
+
+	if (decoder->audio) {
+		decoder->audio->Data.connect (via<AudioStreamPtr, ContentAudio>(ahead, bind(&Player::audio, this, weak_ptr<Piece>(piece), _1, _2)));
+	}
+
+	auto j = decoder->text.begin();
+
+	while (j != decoder->text.end()) {
+		(*j)->BitmapStart.connect (
+			via<ContentBitmapText>(ahead, bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1))
+			);
+		(*j)->PlainStart.connect (
+			via<ContentStringText>(ahead, bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1))
+			);
+		(*j)->Stop.connect (
+			via<ContentTime>(ahead, bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1))
+			);
+
+		++j;
+	}
+
+	if (decoder->atmos) {
+		decoder->atmos->Data.connect (via<ContentAtmos>(ahead, bind(&Player::atmos, this, weak_ptr<Piece>(piece), _1)));
+	}
+
+	return piece;
+}
+
+
 void
 Player::setup_pieces ()
 {
 	boost::mutex::scoped_lock lm (_mutex);
 
+	{
+		/* Subtitle appearance may be about to change */
+		boost::mutex::scoped_lock lm2 (_last_open_subtitles_mutex);
+		_last_open_subtitles = boost::none;
+	}
+
 	auto old_pieces = _pieces;
 	_pieces.clear ();
+	_piece_times_valid = false;
 
 	auto film = _film.lock();
 	if (!film) {
@@ -268,28 +470,21 @@ Player::setup_pieces ()
 
 	_playback_length = _playlist ? _playlist->length(film) : film->length();
 
-	auto playlist_content = playlist()->content();
-	bool const have_threed = std::any_of(
-		playlist_content.begin(),
-		playlist_content.end(),
-		[](shared_ptr<const Content> c) {
-			return c->video && (c->video->frame_type() == VideoFrameType::THREE_D_LEFT || c->video->frame_type() == VideoFrameType::THREE_D_RIGHT);
-		});
-
+	auto const playlist_snapshot = playlist()->content_snapshot();
+	auto const& playlist_content = *playlist_snapshot;
 
-	if (have_threed) {
+	/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence, unless we are ignoring video */
+	if (have_threed(playlist_content) && !_ignore_video) {
 		_shuffler.reset(new Shuffler());
 		_shuffler->Video.connect(bind(&Player::video, this, _1, _2));
+	} else {
+		_shuffler.reset();
 	}
 
-	for (auto content: playlist()->content()) {
-
-		if (!content->paths_valid()) {
-			continue;
-		}
+	_decode_threads = decode_threads(playlist_content);
 
-		if (_ignore_video && _ignore_audio && content->text.empty()) {
-			/* We're only interested in text and this content has none */
+	for (auto content: playlist_content) {
+		if (!want_piece(content)) {
 			continue;
 		}
 
@@ -301,70 +496,93 @@ Player::setup_pieces ()
 			}
 		}
 
-		auto decoder = decoder_factory(film, content, _fast, _tolerant, old_decoder);
-		DCPOMATIC_ASSERT (decoder);
+		_pieces.push_back (make_piece(film, content, old_decoder));
+	}
 
-		FrameRateChange frc(film, content);
+	if (_ignore_video) {
+		_black = Empty();
+	} else {
+		_black = Empty(film, playlist(), bind(&have_video, _1), _playback_length);
+	}
+	_silent = Empty(film, playlist(), bind(&have_audio, _1), _playback_length);
 
-		if (decoder->video && _ignore_video) {
-			decoder->video->set_ignore (true);
-		}
+	pieces_changed (film);
+}
 
-		if (decoder->audio && _ignore_audio) {
-			decoder->audio->set_ignore (true);
-		}
 
-		if (_ignore_text) {
-			for (auto i: decoder->text) {
-				i->set_ignore (true);
-			}
-		}
+/** Rebuild only the piece for some content which has changed, leaving the others alone.
+ *  @return false if the change means that we must rebuild all our pieces with setup_pieces().
+ */
+bool
+Player::update_piece (weak_ptr<Content> weak_content)
+{
+	boost::mutex::scoped_lock lm (_mutex);
 
-		auto dcp = dynamic_pointer_cast<DCPDecoder> (decoder);
-		if (dcp) {
-			dcp->set_decode_referenced (_play_referenced);
-			if (_play_referenced) {
-				dcp->set_forced_reduction (_dcp_decode_reduction);
-			}
-		}
+	auto film = _film.lock();
+	auto content = weak_content.lock();
+	if (!film || !content) {
+		return false;
+	}
 
-		auto piece = make_shared<Piece>(content, decoder, frc);
-		_pieces.push_back (piece);
+	auto const playlist_snapshot = playlist()->content_snapshot();
+	auto const& playlist_content = *playlist_snapshot;
 
-		if (decoder->video) {
-			if (have_threed) {
-				/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
-				decoder->video->Data.connect (bind(&Shuffler::video, _shuffler.get(), weak_ptr<Piece>(piece), _1));
-			} else {
-				decoder->video->Data.connect (bind(&Player::video, this, weak_ptr<Piece>(piece), _1));
-			}
-		}
+	if ((have_threed(playlist_content) && !_ignore_video) != static_cast<bool>(_shuffler) || decode_threads(playlist_content) != _decode_threads) {
+		return false;
+	}
+
+	/* The pieces that we want must be the same as the ones that we have, give or take the order
+	   (which will change if the content has moved).
+	*/
+	std::map<shared_ptr<const Content>, shared_ptr<Piece>> pieces;
+	for (auto i: _pieces) {
+		pieces[i->content] = i;
+	}
 
-		if (decoder->audio) {
-			decoder->audio->Data.connect (bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2));
+	list<shared_ptr<Piece>> ordered;
+	for (auto i: playlist_content) {
+		if (want_piece(i)) {
+			auto piece = pieces.find(i);
+			if (piece == pieces.end()) {
+				return false;
+			}
+			ordered.push_back (piece->second);
 		}
+	}
 
-		auto j = decoder->text.begin();
+	if (ordered.size() != _pieces.size()) {
+		return false;
+	}
 
-		while (j != decoder->text.end()) {
-			(*j)->BitmapStart.connect (
-				bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->PlainStart.connect (
-				bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->Stop.connect (
-				bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
+	{
+		/* Subtitle appearance may be about to change */
+		boost::mutex::scoped_lock lm2 (_last_open_subtitles_mutex);
+		_last_open_subtitles = boost::none;
+	}
 
-			++j;
-		}
+	_playback_length = _playlist ? _playlist->length(film) : film->length();
 
-		if (decoder->atmos) {
-			decoder->atmos->Data.connect (bind(&Player::atmos, this, weak_ptr<Piece>(piece), _1));
+	for (auto& i: ordered) {
+		if (i->content == content) {
+			i = make_piece(film, content, i->decoder);
 		}
 	}
+	_pieces = ordered;
+
+	_black.update (film, content, _playback_length);
+	_silent.update (film, content, _playback_length);
+
+	pieces_changed (film);
+	return true;
+}
 
+
+/** Update the things that depend on all our pieces after some of them have changed.
+ *  Caller must hold a lock on _mutex.
+ */
+void
+Player::pieces_changed (shared_ptr<const Film> film)
+{
 	_stream_states.clear ();
 	for (auto i: _pieces) {
 		if (i->content->audio) {
@@ -379,6 +597,7 @@ Player::setup_pieces ()
 	};
 
 	for (auto i = _pieces.begin(); i != _pieces.end(); ++i) {
+		(*i)->ignore_video = boost::none;
 		if (ignore_overlap((*i)->content->video)) {
 			/* Look for content later in the content list with in-use video that overlaps this */
 			auto const period = DCPTimePeriod((*i)->content->position(), (*i)->content->end(film));
@@ -390,17 +609,54 @@ Player::setup_pieces ()
 		}
 	}
 
-	_black = Empty(film, playlist(), bind(&have_video, _1), _playback_length);
-	_silent = Empty(film, playlist(), bind(&have_audio, _1), _playback_length);
-
 	_next_video_time = boost::none;
 	_next_video_eyes = Eyes::BOTH;
 	_next_audio_time = boost::none;
+	_piece_times_valid = false;
+}
+
+
+bool
+Player::PieceTime::operator< (PieceTime const& other) const
+{
+	if (time != other.time) {
+		return time < other.time;
+	}
+
+	/* Given two choices at the same time, pick the one with texts so we see it before
+	   the video; of those, prefer the last in the playlist, otherwise the first.
+	*/
+	if (text != other.text) {
+		return text;
+	}
+
+	return text ? order > other.order : order < other.order;
+}
+
+
+/** Put a piece into _piece_times, unless it is done, so that pass() can find it when it is
+ *  the furthest behind.  Caller must hold a lock on _mutex.
+ *  @param order Index of the piece in _pieces.
+ */
+void
+Player::add_piece_time (shared_ptr<const Film> film, shared_ptr<Piece> piece, int order)
+{
+	if (piece->done) {
+		return;
+	}
+
+	auto const t = content_time_to_dcp (piece, max(piece->decode_ahead->position(), piece->content->trim_start()));
+	if (t > piece->content->end(film)) {
+		piece->done = true;
+		return;
+	}
+
+	_piece_times.insert ({ t, !piece->decoder->text.empty(), order, piece });
 }
 
 
 void
-Player::playlist_content_change (ChangeType type, int property, bool frequent)
+Player::playlist_content_change (ChangeType type, weak_ptr<Content> weak_content, int property, bool frequent)
 {
 	auto film = _film.lock();
 	if (!film) {
@@ -422,8 +678,10 @@ Player::playlist_content_change (ChangeType type, int property, bool frequent)
 			*/
 			++_suspended;
 		} else if (type == ChangeType::DONE) {
-			/* A change in our content has gone through.  Re-build our pieces. */
-			setup_pieces ();
+			/* A change in our content has gone through.  Re-build the pieces that it affects. */
+			if (!update_piece(weak_content)) {
+				setup_pieces ();
+			}
 			--_suspended;
 		} else if (type == ChangeType::CANCELLED) {
 			--_suspended;
@@ -451,6 +709,55 @@ Player::set_video_container_size (dcp::Size s)
 		_black_image = make_shared<Image>(AV_PIX_FMT_RGB24, _video_container_size, Image::Alignment::PADDED);
 		_black_image->make_black ();
 	}
+
+	if (!_fast) {
+		return;
+	}
+
+	/* We may now be able to decode FFmpeg content at a different size */
+	bool reset = false;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		auto film = _film.lock();
+		for (auto piece: _pieces) {
+			auto ffmpeg = dynamic_pointer_cast<FFmpegDecoder>(piece->decoder);
+			if (film && ffmpeg && ffmpeg->reduction() != ffmpeg_decode_reduction(film, piece->content)) {
+				reset = true;
+			}
+		}
+	}
+
+	if (reset) {
+		setup_pieces ();
+	}
+}
+
+
+/** @return log2 of the factor by which some content's video can be reduced in size when it is decoded,
+ *  without it becoming smaller than it will be when shown in _video_container_size.
+ */
+int
+Player::ffmpeg_decode_reduction (shared_ptr<const Film> film, shared_ptr<const Content> content) const
+{
+	if (!_fast || !content->video) {
+		return 0;
+	}
+
+	auto const video = content->video;
+	auto const display = scale_for_display(video->scaled_size(film->frame_size()), _video_container_size, film->frame_size(), video->pixel_quanta());
+	auto const source = video->size_after_crop();
+	auto const source_width = source.width * video->sample_aspect_ratio().get_value_or(1);
+
+	/* Reducing by more than this starts to look bad even when the result is shown small */
+	int const maximum = 3;
+
+	/* Reduce by at least as much as we have been asked to for DCPs */
+	int reduction = std::min(_dcp_decode_reduction.load().get_value_or(0), maximum);
+	while (reduction < maximum && source_width / (2 << reduction) >= display.width && source.height / (2 << reduction) >= display.height) {
+		++reduction;
+	}
+
+	return reduction;
 }
 
 
@@ -487,6 +794,11 @@ Player::film_change (ChangeType type, Film::Property p)
 			setup_pieces ();
 		}
 		Change (type, PlayerProperty::FILM_VIDEO_FRAME_RATE, false);
+	} else if (p == Film::Property::AUDIO_FRAME_RATE) {
+		/* Likewise, pieces know the DCP audio rate */
+		if (type == ChangeType::DONE) {
+			setup_pieces ();
+		}
 	} else if (p == Film::Property::AUDIO_PROCESSOR) {
 		if (type == ChangeType::DONE && film->audio_processor ()) {
 			boost::mutex::scoped_lock lm (_mutex);
@@ -540,7 +852,8 @@ Player::dcp_to_content_video (shared_ptr<const Piece> piece, DCPTime t) const
 
 	   Instead we convert the DCPTime using the DCP video rate then account for any skip/repeat.
 	*/
-	return s.frames_floor (piece->frc.dcp) / piece->frc.factor ();
+	auto const frames = piece->video_times.frames_floor(s);
+	return piece->frc.skip ? frames * 2 : frames / piece->frc.repeat;
 }
 
 
@@ -548,7 +861,7 @@ DCPTime
 Player::content_video_to_dcp (shared_ptr<const Piece> piece, Frame f) const
 {
 	/* See comment in dcp_to_content_video */
-	auto const d = DCPTime::from_frames (f * piece->frc.factor(), piece->frc.dcp) - DCPTime(piece->content->trim_start(), piece->frc);
+	auto const d = piece->video_times.from_frames(piece->frc.skip ? f / 2 : f * piece->frc.repeat) - DCPTime(piece->content->trim_start(), piece->frc);
 	return d + piece->content->position();
 }
 
@@ -562,18 +875,15 @@ Player::dcp_to_resampled_audio (shared_ptr<const Piece> piece, DCPTime t) const
 	auto s = t - piece->content->position ();
 	s = min (piece->content->length_after_trim(film), s);
 	/* See notes in dcp_to_content_video */
-	return max (DCPTime(), DCPTime(piece->content->trim_start(), piece->frc) + s).frames_floor(film->audio_frame_rate());
+	return piece->audio_times.frames_floor(max(DCPTime(), DCPTime(piece->content->trim_start(), piece->frc) + s));
 }
 
 
 DCPTime
 Player::resampled_audio_to_dcp (shared_ptr<const Piece> piece, Frame f) const
 {
-	auto film = _film.lock();
-	DCPOMATIC_ASSERT(film);
-
 	/* See comment in dcp_to_content_video */
-	return DCPTime::from_frames(f, film->audio_frame_rate())
+	return piece->audio_times.from_frames(f)
 		- DCPTime (piece->content->trim_start(), piece->frc)
 		+ piece->content->position();
 }
@@ -661,6 +971,17 @@ Player::set_fast ()
 }
 
 
+/** @param profile Profile to note the time that we spend on things in, or nullptr to stop doing that.
+ *  The profile must only be used by the thread that calls pass().
+ */
+void
+Player::set_profile (shared_ptr<PlayerProfile> profile)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_profile = profile;
+}
+
+
 void
 Player::set_play_referenced ()
 {
@@ -673,8 +994,12 @@ Player::set_play_referenced ()
 bool
 Player::pass ()
 {
+	TraceSpan span("Player::pass");
+
 	boost::mutex::scoped_lock lm (_mutex);
 
+	PlayerProfile::Scope profile_scope(_profile.get(), "pass");
+
 	if (_suspended) {
 		/* We can't pass in this state */
 		LOG_DEBUG_PLAYER_NC ("Player is suspended");
@@ -691,27 +1016,21 @@ Player::pass ()
 
 	/* Find the decoder or empty which is farthest behind where we are and make it emit some data */
 
-	shared_ptr<Piece> earliest_content;
-	optional<DCPTime> earliest_time;
-
-	for (auto i: _pieces) {
-		if (i->done) {
-			continue;
+	if (!_piece_times_valid) {
+		_piece_times.clear ();
+		int order = 0;
+		for (auto i: _pieces) {
+			add_piece_time (film, i, order++);
 		}
+		_piece_times_valid = true;
+	}
 
-		auto const t = content_time_to_dcp (i, max(i->decoder->position(), i->content->trim_start()));
-		if (t > i->content->end(film)) {
-			i->done = true;
-		} else {
+	shared_ptr<Piece> earliest_content;
+	optional<DCPTime> earliest_time;
 
-			/* Given two choices at the same time, pick the one with texts so we see it before
-			   the video.
-			*/
-			if (!earliest_time || t < *earliest_time || (t == *earliest_time && !i->decoder->text.empty())) {
-				earliest_time = t;
-				earliest_content = i;
-			}
-		}
+	if (!_piece_times.empty()) {
+		earliest_content = _piece_times.begin()->piece;
+		earliest_time = _piece_times.begin()->time;
 	}
 
 	bool done = false;
@@ -741,7 +1060,20 @@ Player::pass ()
 	case CONTENT:
 	{
 		LOG_DEBUG_PLAYER ("Calling pass() on %1", earliest_content->content->path(0));
-		earliest_content->done = earliest_content->decoder->pass ();
+		auto const order = _piece_times.begin()->order;
+		_piece_times.erase (_piece_times.begin());
+		/* Make it again next time if pass() throws */
+		_piece_times_valid = false;
+		auto const name = _profile ? "decode: " + earliest_content->content->path_summary() : string();
+		{
+			PlayerProfile::Scope scope(_profile.get(), name);
+			earliest_content->done = earliest_content->decode_ahead->pass ();
+		}
+		add_piece_time (film, earliest_content, order);
+		_piece_times_valid = true;
+		if (_profile) {
+			_profile->set_decoder_thread_time (name, earliest_content->decode_ahead->thread_time());
+		}
 		auto dcp = dynamic_pointer_cast<DCPContent>(earliest_content->content);
 		if (dcp && !_play_referenced && dcp->reference_audio()) {
 			/* We are skipping some referenced DCP audio content, so we need to update _next_audio_time
@@ -753,12 +1085,16 @@ Player::pass ()
 		break;
 	}
 	case BLACK:
+	{
+		PlayerProfile::Scope scope(_profile.get(), "empty");
 		LOG_DEBUG_PLAYER ("Emit black for gap at %1", to_string(_black.position()));
 		emit_video (black_player_video_frame(Eyes::BOTH), _black.position());
 		_black.set_position (_black.position() + one_video_frame());
 		break;
+	}
 	case SILENT:
 	{
+		PlayerProfile::Scope scope(_profile.get(), "empty");
 		LOG_DEBUG_PLAYER ("Emit silence for gap at %1", to_string(_silent.position()));
 		DCPTimePeriod period (_silent.period_at_position());
 		if (_next_audio_time) {
@@ -876,21 +1212,62 @@ Player::pass ()
 
 
 /** @return Open subtitles for the frame at the given time, converted to images */
-optional<PositionImage>
-Player::open_subtitles_for_frame (DCPTime time) const
+/** @return true if two sets of texts will look the same when rendered at the same time */
+static bool
+same_texts (list<PlayerText> const& a, list<PlayerText> const& b)
 {
-	auto film = _film.lock();
-	if (!film) {
-		return {};
+	auto same_bitmap = [](BitmapText const& x, BitmapText const& y) {
+		return x.image == y.image && x.rectangle == y.rectangle;
+	};
+
+	auto same_string = [](StringText const& x, StringText const& y) {
+		return static_cast<dcp::SubtitleString const&>(x) == static_cast<dcp::SubtitleString const&>(y) &&
+			x.outline_width == y.outline_width && x.font == y.font && x.valign_standard == y.valign_standard;
+	};
+
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [same_bitmap, same_string](PlayerText const& x, PlayerText const& y) {
+		return x.bitmap.size() == y.bitmap.size() && std::equal(x.bitmap.begin(), x.bitmap.end(), y.bitmap.begin(), same_bitmap) &&
+			x.string.size() == y.string.size() && std::equal(x.string.begin(), x.string.end(), y.string.begin(), same_string);
+	});
+}
+
+
+/** @return true if any of some texts are fading in or out on the frame at a given time */
+static bool
+fading (list<PlayerText> const& texts, DCPTime time, int frame_rate)
+{
+	/* Allow a frame either side, as render_text rounds the fade times to frames */
+	auto const frame = DCPTime::from_frames(1, frame_rate);
+
+	for (auto const& i: texts) {
+		for (auto const& j: i.string) {
+			auto const in = DCPTime::from_seconds(j.in().as_seconds());
+			auto const out = DCPTime::from_seconds(j.out().as_seconds());
+			auto const up = DCPTime::from_seconds(j.fade_up_time().as_seconds());
+			auto const down = DCPTime::from_seconds(j.fade_down_time().as_seconds());
+			if (up != DCPTime() && time >= (in - frame) && time <= (in + up + frame)) {
+				return true;
+			}
+			if (down != DCPTime() && time >= (out - down - frame) && time <= (out + frame)) {
+				return true;
+			}
+		}
 	}
 
+	return false;
+}
+
+
+/** Render some texts to a single image.
+ *  @param time Time of the frame that the texts will be burnt into.
+ *  @param container_size Size of the container that the texts will end up in.
+ */
+static optional<PositionImage>
+render_texts (list<PlayerText> const& texts, dcp::Size container_size, DCPTime time, int vfr, Image::Alignment alignment)
+{
 	list<PositionImage> captions;
-	int const vfr = film->video_frame_rate();
 
-	for (
-		auto j:
-		_active_texts[TextType::OPEN_SUBTITLE].get_burnt(DCPTimePeriod(time, time + DCPTime::from_frames(1, vfr)), _always_burn_open_subtitles)
-		) {
+	for (auto j: texts) {
 
 		/* Bitmap subtitles */
 		for (auto i: j.bitmap) {
@@ -899,14 +1276,14 @@ Player::open_subtitles_for_frame (DCPTime time) const
 			}
 
 			/* i.image will already have been scaled to fit _video_container_size */
-			dcp::Size scaled_size (i.rectangle.width * _video_container_size.load().width, i.rectangle.height * _video_container_size.load().height);
+			dcp::Size scaled_size (i.rectangle.width * container_size.width, i.rectangle.height * container_size.height);
 
 			captions.push_back (
 				PositionImage (
 					i.image,
 					Position<int> (
-						lrint(_video_container_size.load().width * i.rectangle.x),
-						lrint(_video_container_size.load().height * i.rectangle.y)
+						lrint(container_size.width * i.rectangle.x),
+						lrint(container_size.height * i.rectangle.y)
 						)
 					)
 				);
@@ -914,7 +1291,7 @@ Player::open_subtitles_for_frame (DCPTime time) const
 
 		/* String subtitles (rendered to an image) */
 		if (!j.string.empty()) {
-			auto s = render_text(j.string, _video_container_size, time, vfr);
+			auto s = render_text(j.string, container_size, time, vfr);
 			copy (s.begin(), s.end(), back_inserter (captions));
 		}
 	}
@@ -923,7 +1300,57 @@ Player::open_subtitles_for_frame (DCPTime time) const
 		return {};
 	}
 
-	return merge (captions, _subtitle_alignment);
+	return merge (captions, alignment);
+}
+
+
+/** @return open subtitles to burn into the frame at `time', which may still be being rendered by
+ *  the TextRenderPool, or nullptr if there are none.
+ */
+shared_ptr<const PendingText>
+Player::open_subtitles_for_frame (DCPTime time) const
+{
+	auto film = _film.lock();
+	if (!film) {
+		return {};
+	}
+
+	int const vfr = film->video_frame_rate();
+	dcp::Size const container_size = _video_container_size;
+
+	auto const texts = _active_texts[TextType::OPEN_SUBTITLE].get_burnt(DCPTimePeriod(time, time + DCPTime::from_frames(1, vfr)), _always_burn_open_subtitles);
+	if (texts.empty()) {
+		return {};
+	}
+
+	/* Unless these subtitles are fading, they will look the same as the last ones if they are the same text */
+	bool const can_reuse = !fading(texts, time, vfr);
+	if (can_reuse) {
+		boost::mutex::scoped_lock lm (_last_open_subtitles_mutex);
+		if (_last_open_subtitles && _last_open_subtitles->container_size == container_size && same_texts(_last_open_subtitles->texts, texts)) {
+			return _last_open_subtitles->image;
+		}
+	}
+
+	auto const alignment = _subtitle_alignment;
+	bool const any_string = std::any_of(texts.begin(), texts.end(), [](PlayerText const& text) { return !text.string.empty(); });
+
+	shared_ptr<const PendingText> image;
+	if (any_string) {
+		/* Rendering text can be slow, so let the pool do it while we carry on */
+		image = TextRenderPool::instance()->render([texts, container_size, time, vfr, alignment]() {
+			return render_texts(texts, container_size, time, vfr, alignment);
+		});
+	} else {
+		image = ready_text(render_texts(texts, container_size, time, vfr, alignment));
+	}
+
+	if (can_reuse) {
+		boost::mutex::scoped_lock lm (_last_open_subtitles_mutex);
+		_last_open_subtitles = OpenSubtitles{texts, container_size, image};
+	}
+
+	return image;
 }
 
 
@@ -934,6 +1361,8 @@ Player::video (weak_ptr<Piece> weak_piece, ContentVideo video)
 		return;
 	}
 
+	PlayerProfile::Scope profile_scope(_profile.get(), "video");
+
 	auto piece = weak_piece.lock ();
 	if (!piece) {
 		return;
@@ -948,8 +1377,7 @@ Player::video (weak_ptr<Piece> weak_piece, ContentVideo video)
 		return;
 	}
 
-	FrameRateChange frc(film, piece->content);
-	if (frc.skip && (video.frame % 2) == 1) {
+	if (piece->frc.skip && (video.frame % 2) == 1) {
 		return;
 	}
 
@@ -1060,6 +1488,8 @@ Player::audio (weak_ptr<Piece> weak_piece, AudioStreamPtr stream, ContentAudio c
 		return;
 	}
 
+	PlayerProfile::Scope profile_scope(_profile.get(), "audio");
+
 	DCPOMATIC_ASSERT (content_audio.audio->frames() > 0);
 
 	auto piece = weak_piece.lock ();
@@ -1106,33 +1536,10 @@ Player::audio (weak_ptr<Piece> weak_piece, AudioStreamPtr stream, ContentAudio c
 
 	DCPOMATIC_ASSERT (content_audio.audio->frames() > 0);
 
-	/* Gain and fade */
+	/* Gain, fade and remap */
 
 	auto const fade_coeffs = content->fade (stream, content_audio.frame, content_audio.audio->frames(), rfr);
-	if (content->gain() != 0 || !fade_coeffs.empty()) {
-		auto gain_buffers = make_shared<AudioBuffers>(content_audio.audio);
-		if (!fade_coeffs.empty()) {
-			/* Apply both fade and gain */
-			DCPOMATIC_ASSERT (fade_coeffs.size() == static_cast<size_t>(gain_buffers->frames()));
-			auto const channels = gain_buffers->channels();
-			auto const frames = fade_coeffs.size();
-			auto data = gain_buffers->data();
-			auto const gain = db_to_linear (content->gain());
-			for (auto channel = 0; channel < channels; ++channel) {
-				for (auto frame = 0U; frame < frames; ++frame) {
-					data[channel][frame] *= gain * fade_coeffs[frame];
-				}
-			}
-		} else {
-			/* Just apply gain */
-			gain_buffers->apply_gain (content->gain());
-		}
-		content_audio.audio = gain_buffers;
-	}
-
-	/* Remap */
-
-	content_audio.audio = remap(content_audio.audio, film->audio_channels(), stream->mapping());
+	content_audio.audio = remap(content_audio.audio, film->audio_channels(), stream->mapping(), db_to_linear(content->gain()), fade_coeffs);
 
 	/* Process */
 
@@ -1301,6 +1708,7 @@ Player::seek (DCPTime time, bool accurate)
 	}
 
 	_delay.clear ();
+	_memory.set (0);
 
 	if (_audio_processor) {
 		_audio_processor->flush ();
@@ -1316,11 +1724,11 @@ Player::seek (DCPTime time, bool accurate)
 			   content we may not start right at the beginning of the next, causing a gap (if the next content has
 			   been trimmed to a point between keyframes, or something).
 			*/
-			i->decoder->seek (dcp_to_content_time (i, i->content->position()), true);
+			i->decode_ahead->seek (dcp_to_content_time (i, i->content->position()), true);
 			i->done = false;
 		} else if (i->content->position() <= time && time < i->content->end(film)) {
 			/* During; seek to position */
-			i->decoder->seek (dcp_to_content_time (i, time), accurate);
+			i->decode_ahead->seek (dcp_to_content_time (i, time), accurate);
 			i->done = false;
 		} else {
 			/* After; this piece is done */
@@ -1342,6 +1750,7 @@ Player::seek (DCPTime time, bool accurate)
 	_silent.set_position (time);
 
 	_last_video.clear ();
+	_piece_times_valid = false;
 }
 
 
@@ -1377,6 +1786,13 @@ Player::emit_video (shared_ptr<PlayerVideo> pv, DCPTime time)
 
 	auto to_do = _delay.front();
 	_delay.pop_front();
+
+	size_t delay_memory = 0;
+	for (auto const& i: _delay) {
+		delay_memory += i.first->memory_used();
+	}
+	_memory.set (delay_memory);
+
 	do_emit_video (to_do.first, to_do.second);
 }
 
@@ -1388,11 +1804,11 @@ Player::do_emit_video (shared_ptr<PlayerVideo> pv, DCPTime time)
 		std::for_each(_active_texts.begin(), _active_texts.end(), [time](ActiveText& a) { a.clear_before(time); });
 	}
 
-	auto subtitles = open_subtitles_for_frame (time);
-	if (subtitles) {
-		pv->set_text (subtitles.get ());
+	if (auto subtitles = open_subtitles_for_frame(time)) {
+		pv->set_text (subtitles);
 	}
 
+	PlayerProfile::Scope scope(_profile.get(), "sink");
 	Video (pv, time);
 }
 
@@ -1410,7 +1826,10 @@ Player::emit_audio (shared_ptr<AudioBuffers> data, DCPTime time)
 
 	/* This audio must follow on from the previous, allowing for half a sample (at 48kHz) leeway */
 	DCPOMATIC_ASSERT (!_next_audio_time || labs(time.get() - _next_audio_time->get()) < 2);
-	Audio(data, time, film->audio_frame_rate());
+	{
+		PlayerProfile::Scope scope(_profile.get(), "sink");
+		Audio(data, time, film->audio_frame_rate());
+	}
 	_next_audio_time = time + DCPTime::from_frames(data->frames(), film->audio_frame_rate());
 }
 
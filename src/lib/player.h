@@ -35,11 +35,14 @@
 #include "enum_indexed_vector.h"
 #include "film.h"
 #include "image.h"
+#include "memory_budget.h"
+#include "player_profile.h"
 #include "player_text.h"
 #include "position_image.h"
 #include "shuffler.h"
 #include <boost/atomic.hpp>
 #include <list>
+#include <set>
 
 
 namespace dcp {
@@ -49,6 +52,7 @@ namespace dcp {
 class AtmosContent;
 class AudioBuffers;
 class Content;
+class Decoder;
 class PlayerVideo;
 class Playlist;
 class ReferencedReelAsset;
@@ -103,6 +107,7 @@ public:
 	void set_fast ();
 	void set_play_referenced ();
 	void set_dcp_decode_reduction (boost::optional<int> reduction);
+	void set_profile (std::shared_ptr<PlayerProfile> profile);
 
 	boost::optional<dcpomatic::DCPTime> content_time_to_dcp (std::shared_ptr<const Content> content, dcpomatic::ContentTime t) const;
 	boost::optional<dcpomatic::ContentTime> dcp_to_content_time (std::shared_ptr<const Content> content, dcpomatic::DCPTime t) const;
@@ -138,13 +143,19 @@ private:
 	friend struct empty_test2;
 	friend struct check_reuse_old_data_test;
 	friend struct overlap_video_test1;
+	friend struct player_update_piece_test;
 
 	void construct ();
 	void connect();
 	void setup_pieces ();
+	bool update_piece (std::weak_ptr<Content> content);
+	void pieces_changed (std::shared_ptr<const Film> film);
+	bool want_piece (std::shared_ptr<const Content> content) const;
+	void add_piece_time (std::shared_ptr<const Film> film, std::shared_ptr<Piece> piece, int order);
+	std::shared_ptr<Piece> make_piece (std::shared_ptr<const Film> film, std::shared_ptr<Content> content, std::shared_ptr<Decoder> old_decoder);
 	void film_change (ChangeType, Film::Property);
 	void playlist_change (ChangeType);
-	void playlist_content_change (ChangeType, int, bool);
+	void playlist_content_change (ChangeType, std::weak_ptr<Content>, int, bool);
 	Frame dcp_to_content_video (std::shared_ptr<const Piece> piece, dcpomatic::DCPTime t) const;
 	dcpomatic::DCPTime content_video_to_dcp (std::shared_ptr<const Piece> piece, Frame f) const;
 	Frame dcp_to_resampled_audio (std::shared_ptr<const Piece> piece, dcpomatic::DCPTime t) const;
@@ -152,6 +163,7 @@ private:
 	dcpomatic::ContentTime dcp_to_content_time (std::shared_ptr<const Piece> piece, dcpomatic::DCPTime t) const;
 	dcpomatic::DCPTime content_time_to_dcp (std::shared_ptr<const Piece> piece, dcpomatic::ContentTime t) const;
 	std::shared_ptr<PlayerVideo> black_player_video_frame (Eyes eyes) const;
+	int ffmpeg_decode_reduction (std::shared_ptr<const Film> film, std::shared_ptr<const Content> content) const;
 
 	void video (std::weak_ptr<Piece>, ContentVideo);
 	void audio (std::weak_ptr<Piece>, AudioStreamPtr, ContentAudio);
@@ -165,7 +177,7 @@ private:
 	std::pair<std::shared_ptr<AudioBuffers>, dcpomatic::DCPTime> discard_audio (
 		std::shared_ptr<const AudioBuffers> audio, dcpomatic::DCPTime time, dcpomatic::DCPTime discard_to
 		) const;
-	boost::optional<PositionImage> open_subtitles_for_frame (dcpomatic::DCPTime time) const;
+	std::shared_ptr<const PendingText> open_subtitles_for_frame (dcpomatic::DCPTime time) const;
 	void emit_video (std::shared_ptr<PlayerVideo> pv, dcpomatic::DCPTime time);
 	void do_emit_video (std::shared_ptr<PlayerVideo> pv, dcpomatic::DCPTime time);
 	void emit_audio (std::shared_ptr<AudioBuffers> data, dcpomatic::DCPTime time);
@@ -185,6 +197,24 @@ private:
 	boost::atomic<int> _suspended;
 	std::list<std::shared_ptr<Piece>> _pieces;
 
+	/** A piece which is not done, and the time of the next thing that it will emit */
+	struct PieceTime
+	{
+		dcpomatic::DCPTime time;
+		/** true if the piece's decoder has any text */
+		bool text;
+		/** index of the piece in _pieces */
+		int order;
+		std::shared_ptr<Piece> piece;
+
+		bool operator< (PieceTime const& other) const;
+	};
+
+	/** Our pieces which are not done, the one furthest behind first, so that pass() need not look at them all */
+	std::set<PieceTime> _piece_times;
+	/** false if _piece_times must be made again from _pieces before it is used */
+	bool _piece_times_valid = false;
+
 	/** Size of the image we are rendering to; this may be the DCP frame size, or
 	 *  the size of preview in a window.
 	 */
@@ -221,6 +251,8 @@ private:
 	AudioMerger _audio_merger;
 	std::unique_ptr<Shuffler> _shuffler;
 	std::list<std::pair<std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime>> _delay;
+	/** memory used by the frames in _delay */
+	MemoryBudget::Share _memory{MemoryBudget::Subsystem::PLAYER};
 
 	class StreamState
 	{
@@ -244,10 +276,29 @@ private:
 	std::shared_ptr<AudioProcessor> _audio_processor;
 
 	boost::atomic<dcpomatic::DCPTime> _playback_length;
+	/** decoding threads given to each FFmpeg video decoder when our pieces were last set up */
+	int _decode_threads = 1;
 
 	/** Alignment for subtitle images that we create */
 	Image::Alignment _subtitle_alignment = Image::Alignment::PADDED;
 
+	/** where to note the time that we spend on things, or nullptr */
+	std::shared_ptr<PlayerProfile> _profile;
+
+	/** The last open subtitles that open_subtitles_for_frame() rendered, so that frames
+	 *  with the same subtitles can use them again.
+	 */
+	struct OpenSubtitles
+	{
+		std::list<PlayerText> texts;
+		dcp::Size container_size;
+		std::shared_ptr<const PendingText> image;
+	};
+
+	/** mutex to protect _last_open_subtitles */
+	mutable boost::mutex _last_open_subtitles_mutex;
+	mutable boost::optional<OpenSubtitles> _last_open_subtitles;
+
 	boost::signals2::scoped_connection _film_changed_connection;
 	boost::signals2::scoped_connection _playlist_change_connection;
 	boost::signals2::scoped_connection _playlist_content_change_connection;
@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "player_profile.h"
+
+
+using std::string;
+
+
+PlayerProfile::PlayerProfile ()
+	: _last (std::chrono::steady_clock::now())
+{
+
+}
+
+
+/** Give the time since we last looked to whatever we are in now */
+void
+PlayerProfile::charge ()
+{
+	auto const now = std::chrono::steady_clock::now();
+	if (!_stack.empty()) {
+		_counts[_stack.back()].time += std::chrono::duration<double>(now - _last).count();
+	}
+	_last = now;
+}
+
+
+void
+PlayerProfile::push (string name)
+{
+	charge ();
+	_stack.push_back (name);
+	++_counts[name].number;
+}
+
+
+void
+PlayerProfile::pop ()
+{
+	DCPOMATIC_ASSERT (!_stack.empty());
+	charge ();
+	_stack.pop_back ();
+}
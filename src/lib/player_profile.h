@@ -0,0 +1,105 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_PLAYER_PROFILE_H
+#define DCPOMATIC_PLAYER_PROFILE_H
+
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/** @class PlayerProfile
+ *  @brief Where a Player spends its time.
+ *
+ *  The Player enters a Scope for each kind of work that it does; time is given to the
+ *  innermost scope only, so time spent in (say) a piece's decoder does not count towards
+ *  the Player::pass() that called it.  A PlayerProfile must only be used by one thread.
+ */
+class PlayerProfile
+{
+public:
+	PlayerProfile ();
+
+	/** Count time as being spent on something until this is destroyed */
+	class Scope
+	{
+	public:
+		/** @param profile Profile to use, or nullptr to do nothing */
+		Scope (PlayerProfile* profile, std::string name)
+			: _profile (profile)
+		{
+			if (_profile) {
+				_profile->push (name);
+			}
+		}
+
+		~Scope ()
+		{
+			if (_profile) {
+				_profile->pop ();
+			}
+		}
+
+		Scope (Scope const&) = delete;
+		Scope& operator= (Scope const&) = delete;
+
+	private:
+		PlayerProfile* _profile;
+	};
+
+	struct Counts
+	{
+		/** time spent, in seconds */
+		double time = 0;
+		/** number of times the scope was entered */
+		int64_t number = 0;
+	};
+
+	std::map<std::string, Counts> counts () const {
+		return _counts;
+	}
+
+	/** Note the time that a decoder has spent in a thread of its own */
+	void set_decoder_thread_time (std::string name, double seconds) {
+		_decoder_thread_times[name] = seconds;
+	}
+
+	std::map<std::string, double> decoder_thread_times () const {
+		return _decoder_thread_times;
+	}
+
+private:
+	void push (std::string name);
+	void pop ();
+	void charge ();
+
+	std::vector<std::string> _stack;
+	std::chrono::steady_clock::time_point _last;
+	std::map<std::string, Counts> _counts;
+	std::map<std::string, double> _decoder_thread_times;
+};
+
+
+#endif
@@ -19,26 +19,37 @@
 */
 
 
+#include "binary_descriptor.h"
 #include "content.h"
+#include "digester.h"
 #include "film.h"
 #include "image.h"
+#include "image_compression.h"
 #include "image_proxy.h"
 #include "j2k_image_proxy.h"
 #include "player.h"
 #include "player_video.h"
+#include "trace.h"
 #include "video_content.h"
 #include <dcp/raw_convert.h>
+#include <libcxml/cxml.h>
 extern "C" {
 #include <libavutil/pixfmt.h>
 }
 #include <libxml++/libxml++.h>
 #include <iostream>
+#include <list>
+#include <map>
 
 
 using std::cout;
 using std::dynamic_pointer_cast;
 using std::function;
+using std::list;
 using std::make_shared;
+using std::make_pair;
+using std::map;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::weak_ptr;
@@ -101,9 +112,78 @@ PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<Socket> socket
 			AV_PIX_FMT_BGRA, dcp::Size(node->number_child<int>("SubtitleWidth"), node->number_child<int>("SubtitleHeight")), Image::Alignment::PADDED
 			);
 
-		image->read_from_socket (socket);
+		read_image_from_socket (image, socket);
 
-		_text = PositionImage (image, Position<int>(node->number_child<int>("SubtitleX"), node->number_child<int>("SubtitleY")));
+		set_text (PositionImage(image, Position<int>(node->number_child<int>("SubtitleX"), node->number_child<int>("SubtitleY"))));
+	}
+}
+
+
+/** Colour conversions are sent to servers in binary descriptors as XML, since there are
+ *  a lot of parameters and they hardly ever change.  Keep the ones that we have parsed so
+ *  that we don't have to parse them again for every frame.
+ */
+static optional<ColourConversion>
+colour_conversion_from_xml (string const& xml)
+{
+	static boost::mutex mutex;
+	static map<string, optional<ColourConversion>> cache;
+
+	boost::mutex::scoped_lock lm (mutex);
+	auto i = cache.find (xml);
+	if (i != cache.end()) {
+		return i->second;
+	}
+
+	if (cache.size() > 16) {
+		cache.clear ();
+	}
+
+	auto doc = make_shared<cxml::Document>("ColourConversion");
+	doc->read_string (xml);
+	/* Assume that the ColourConversion uses the current state version */
+	auto conversion = ColourConversion::from_xml (doc, Film::current_state_version);
+	cache[xml] = conversion;
+	return conversion;
+}
+
+
+PlayerVideo::PlayerVideo (BinaryDescriptorReader& reader, shared_ptr<Socket> socket)
+{
+	_crop.left = reader.read_int32 ();
+	_crop.right = reader.read_int32 ();
+	_crop.top = reader.read_int32 ();
+	_crop.bottom = reader.read_int32 ();
+	if (reader.read_bool()) {
+		_fade = reader.read_double ();
+	}
+
+	auto const inter_width = reader.read_int32 ();
+	auto const inter_height = reader.read_int32 ();
+	_inter_size = dcp::Size (inter_width, inter_height);
+	auto const out_width = reader.read_int32 ();
+	auto const out_height = reader.read_int32 ();
+	_out_size = dcp::Size (out_width, out_height);
+	_eyes = static_cast<Eyes>(reader.read_int32());
+	_part = static_cast<Part>(reader.read_int32());
+	_video_range = static_cast<VideoRange>(reader.read_int32());
+	_error = reader.read_bool ();
+
+	if (reader.read_bool()) {
+		_colour_conversion = colour_conversion_from_xml (reader.read_string());
+	}
+
+	_in = image_proxy_factory (reader, socket);
+
+	if (reader.read_bool()) {
+		auto const width = reader.read_int32 ();
+		auto const height = reader.read_int32 ();
+		auto const x = reader.read_int32 ();
+		auto const y = reader.read_int32 ();
+
+		auto image = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size(width, height), Image::Alignment::PADDED);
+		read_image_from_socket (image, socket);
+		set_text (PositionImage(image, Position<int>(x, y)));
 	}
 }
 
@@ -111,10 +191,33 @@ PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<Socket> socket
 void
 PlayerVideo::set_text (PositionImage image)
 {
-	_text = image;
+	_text = ready_text (image);
+}
+
+
+/** Set text which another thread may still be rendering; anything which needs it will wait for it */
+void
+PlayerVideo::set_text (shared_ptr<const PendingText> text)
+{
+	_text = text;
 }
 
 
+/** @return Text to burn in, waiting for it to be rendered if necessary */
+optional<PositionImage>
+PlayerVideo::text () const
+{
+	if (!_text) {
+		return {};
+	}
+
+	return _text->get();
+}
+
+
+/** @return The finished image for this frame.  This may be shared with other PlayerVideos made
+ *  from the same source image, so it must not be modified.
+ */
 shared_ptr<Image>
 PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const
 {
@@ -128,6 +231,26 @@ PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoR
 }
 
 
+/** Make an image for this frame, as image() would, handing each band of rows to @p rows_ready
+ *  as soon as it is finished.  Unlike image(), the result is not kept, so a caller which converts
+ *  the rows into some other form does not leave a full-frame copy of the image behind it.
+ *  If we already have a suitable image it is passed to @p rows_ready in one go.
+ */
+void
+PlayerVideo::render (
+	function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast, function<void (Image const&, int, int)> rows_ready
+	) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_image && _crop == _image_crop && _inter_size == _image_inter_size && _out_size == _image_out_size && _fade == _image_fade) {
+		rows_ready (*_image, 0, _image->size().height);
+		return;
+	}
+
+	render_image (pixel_format, video_range, fast, rows_ready);
+}
+
+
 shared_ptr<const Image>
 PlayerVideo::raw_image () const
 {
@@ -135,6 +258,132 @@ PlayerVideo::raw_image () const
 }
 
 
+/** @return Our image from the ImageProxy without any processing, and the part of it which
+ *  should be shown once our crop and part have been applied (as proportions of its size).
+ *  This is for callers which want to crop, scale and convert the image themselves.
+ */
+pair<shared_ptr<const Image>, dcpomatic::Rect<float>>
+PlayerVideo::raw_image_and_window () const
+{
+	auto prox = _in->image(Image::Alignment::COMPACT, _inter_size);
+
+	/* _crop is in terms of the full-size image, which may have been scaled down by the ImageProxy */
+	int const r = pow(2, prox.log2_scaling);
+	auto const width = static_cast<float>(prox.image->size().width * r);
+	auto const height = static_cast<float>(prox.image->size().height * r);
+
+	auto left = _crop.left / width;
+	auto right = _crop.right / width;
+	auto top = _crop.top / height;
+	auto bottom = _crop.bottom / height;
+
+	switch (_part) {
+	case Part::LEFT_HALF:
+		right += 0.5;
+		break;
+	case Part::RIGHT_HALF:
+		left += 0.5;
+		break;
+	case Part::TOP_HALF:
+		bottom += 0.5;
+		break;
+	case Part::BOTTOM_HALF:
+		top += 0.5;
+		break;
+	default:
+		break;
+	}
+
+	return make_pair(prox.image, dcpomatic::Rect<float>(left, top, std::max(0.0f, 1 - left - right), std::max(0.0f, 1 - top - bottom)));
+}
+
+
+namespace {
+
+/** Everything that decides what render_image() makes from a given source image, when there is no text */
+struct SharedImageKey
+{
+	std::weak_ptr<const Image> source;
+	Crop crop;
+	dcp::Size inter_size;
+	dcp::Size out_size;
+	optional<double> fade;
+	dcp::YUVToRGB yuv_to_rgb;
+	VideoRange in_range;
+	AVPixelFormat out_format;
+	VideoRange out_range;
+	bool fast;
+
+	bool matches (SharedImageKey const& other) const {
+		auto const s = source.lock();
+		return s && s == other.source.lock() && crop == other.crop && inter_size == other.inter_size &&
+			out_size == other.out_size && fade == other.fade && yuv_to_rgb == other.yuv_to_rgb &&
+			in_range == other.in_range && out_format == other.out_format && out_range == other.out_range &&
+			fast == other.fast;
+	}
+};
+
+
+/** Finished images of frames which have no text, so that frames made from the same source image
+ *  (stills, black frames and so on) share one image rather than each making their own.  Images are
+ *  only held here as long as some PlayerVideo is holding them.
+ */
+class SharedImages
+{
+public:
+	shared_ptr<Image> get (SharedImageKey const& key)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		for (auto i = _images.begin(); i != _images.end(); ++i) {
+			if (i->first.matches(key)) {
+				auto image = i->second.lock();
+				if (image) {
+					_images.splice (_images.begin(), _images, i);
+					return image;
+				}
+				_images.erase (i);
+				break;
+			}
+		}
+		return {};
+	}
+
+	void put (SharedImageKey const& key, shared_ptr<Image> image)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_images.remove_if ([](pair<SharedImageKey, weak_ptr<Image>> const& i) { return i.second.expired() || i.first.source.expired(); });
+		_images.push_front (make_pair(key, image));
+		if (_images.size() > _max_images) {
+			_images.pop_back ();
+		}
+	}
+
+	static SharedImages* instance ()
+	{
+		static auto images = new SharedImages;
+		return images;
+	}
+
+private:
+	boost::mutex _mutex;
+	/** Most recently used first */
+	list<pair<SharedImageKey, weak_ptr<Image>>> _images;
+	static size_t const _max_images = 16;
+};
+
+}
+
+
+/** @return true if Image::alpha_blend can blend RGBA/BGRA straight onto an image of format `f',
+ *  without converting the whole overlay to format `f' first.
+ */
+static bool
+can_blend_in_rows (AVPixelFormat f)
+{
+	return f == AV_PIX_FMT_RGB24 || f == AV_PIX_FMT_BGRA || f == AV_PIX_FMT_RGBA || f == AV_PIX_FMT_RGB48LE || f == AV_PIX_FMT_XYZ12LE;
+}
+
+
 /** Create an image for this frame.  A lock must be held on _mutex.
  *  @param pixel_format Function which is called to decide what pixel format the output image should be;
  *  it is passed the pixel format of the input image from the ImageProxy, and should return the desired
@@ -149,10 +398,33 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, V
 	_image_out_size = _out_size;
 	_image_fade = _fade;
 
+	_image = render_image (pixel_format, video_range, fast, {});
+}
+
+
+/** Make an image for this frame in the way described for make_image(), without keeping it.
+ *  A lock must be held on _mutex.
+ *  @param rows_ready Function to call with each band of rows once it is completely finished
+ *  (scaled, with text and fade applied), or an empty function.
+ */
+shared_ptr<Image>
+PlayerVideo::render_image (
+	function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast, function<void (Image const&, int, int)> rows_ready
+	) const
+{
 	auto prox = _in->image (Image::Alignment::PADDED, _inter_size);
 	_error = prox.error;
 
 	auto total_crop = _crop;
+	if (prox.log2_scaling > 0) {
+		/* Scale the crop down to account for the scaling that has already happened in ImageProxy::image */
+		int const r = pow(2, prox.log2_scaling);
+		total_crop.left /= r;
+		total_crop.right /= r;
+		total_crop.top /= r;
+		total_crop.bottom /= r;
+	}
+
 	switch (_part) {
 	case Part::LEFT_HALF:
 		total_crop.right += prox.image->size().width / 2;
@@ -170,31 +442,66 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, V
 		break;
 	}
 
-	if (prox.log2_scaling > 0) {
-		/* Scale the crop down to account for the scaling that has already happened in ImageProxy::image */
-		int const r = pow(2, prox.log2_scaling);
-		total_crop.left /= r;
-		total_crop.right /= r;
-		total_crop.top /= r;
-		total_crop.bottom /= r;
-	}
-
 	dcp::YUVToRGB yuv_to_rgb = dcp::YUVToRGB::REC601;
 	if (_colour_conversion) {
 		yuv_to_rgb = _colour_conversion.get().yuv_to_rgb();
 	}
 
-	_image = prox.image->crop_scale_window (
-		total_crop, _inter_size, _out_size, yuv_to_rgb, _video_range, pixel_format (prox.image->pixel_format()), video_range, Image::Alignment::COMPACT, fast
+	auto const out_format = pixel_format (prox.image->pixel_format());
+
+	/* Without any text, what we make depends only on the source image and our settings, so if another
+	 * frame with the same source has already made it we can just use theirs.
+	 */
+	auto const text = this->text();
+	bool const shareable = !text && !rows_ready;
+	SharedImageKey const key = {
+		prox.image, total_crop, _inter_size, _out_size, _fade, yuv_to_rgb, _video_range, out_format, video_range, fast
+	};
+	if (shareable) {
+		if (auto shared = SharedImages::instance()->get(key)) {
+			return shared;
+		}
+	}
+
+	/* Blending onto YUV means converting the whole text image to YUV first, which we don't
+	 * want to do once per band of rows, so text is blended afterwards in that case.
+	 */
+	bool const banded = !text || can_blend_in_rows(out_format);
+
+	function<void (Image&, int, int)> process_rows;
+	if (banded && (text || _fade || rows_ready)) {
+		process_rows = [this, text, rows_ready](Image& image, int first_row, int rows) {
+			if (text) {
+				image.alpha_blend (text->image, text->position, first_row, rows);
+			}
+			if (_fade) {
+				image.fade (_fade.get(), first_row, rows);
+			}
+			if (rows_ready) {
+				rows_ready (image, first_row, rows);
+			}
+		};
+	}
+
+	auto image = prox.image->crop_scale_window (
+		total_crop, _inter_size, _out_size, yuv_to_rgb, _video_range, out_format, video_range, Image::Alignment::COMPACT, fast, process_rows
 		);
 
-	if (_text) {
-		_image->alpha_blend (_text->image, _text->position);
+	if (!banded) {
+		image->alpha_blend (text->image, text->position);
+		if (_fade) {
+			image->fade (_fade.get ());
+		}
+		if (rows_ready) {
+			rows_ready (*image, 0, image->size().height);
+		}
 	}
 
-	if (_fade) {
-		_image->fade (_fade.get ());
+	if (shareable) {
+		SharedImages::instance()->put(key, image);
 	}
+
+	return image;
 }
 
 
@@ -217,11 +524,54 @@ PlayerVideo::add_metadata (xmlpp::Node* node) const
 	if (_colour_conversion) {
 		_colour_conversion.get().as_xml (node);
 	}
-	if (_text) {
-		node->add_child ("SubtitleWidth")->add_child_text (raw_convert<string> (_text->image->size().width));
-		node->add_child ("SubtitleHeight")->add_child_text (raw_convert<string> (_text->image->size().height));
-		node->add_child ("SubtitleX")->add_child_text (raw_convert<string> (_text->position.x));
-		node->add_child ("SubtitleY")->add_child_text (raw_convert<string> (_text->position.y));
+	if (auto text = this->text()) {
+		node->add_child ("SubtitleWidth")->add_child_text (raw_convert<string> (text->image->size().width));
+		node->add_child ("SubtitleHeight")->add_child_text (raw_convert<string> (text->image->size().height));
+		node->add_child ("SubtitleX")->add_child_text (raw_convert<string> (text->position.x));
+		node->add_child ("SubtitleY")->add_child_text (raw_convert<string> (text->position.y));
+	}
+}
+
+
+/** Write the same things as add_metadata (xmlpp::Node*) in the order that
+ *  PlayerVideo (BinaryDescriptorReader&, shared_ptr<Socket>) expects them.
+ */
+void
+PlayerVideo::add_metadata (BinaryDescriptorWriter& writer) const
+{
+	writer.add (static_cast<int32_t>(_crop.left));
+	writer.add (static_cast<int32_t>(_crop.right));
+	writer.add (static_cast<int32_t>(_crop.top));
+	writer.add (static_cast<int32_t>(_crop.bottom));
+	writer.add (static_cast<bool>(_fade));
+	if (_fade) {
+		writer.add (_fade.get());
+	}
+	writer.add (static_cast<int32_t>(_inter_size.width));
+	writer.add (static_cast<int32_t>(_inter_size.height));
+	writer.add (static_cast<int32_t>(_out_size.width));
+	writer.add (static_cast<int32_t>(_out_size.height));
+	writer.add (static_cast<int32_t>(_eyes));
+	writer.add (static_cast<int32_t>(_part));
+	writer.add (static_cast<int32_t>(_video_range));
+	writer.add (_error);
+
+	writer.add (static_cast<bool>(_colour_conversion));
+	if (_colour_conversion) {
+		xmlpp::Document doc;
+		_colour_conversion->as_xml (doc.create_root_node("ColourConversion"));
+		writer.add (doc.write_to_string("UTF-8"));
+	}
+
+	_in->add_metadata (writer);
+
+	auto const text = this->text();
+	writer.add (static_cast<bool>(text));
+	if (text) {
+		writer.add (static_cast<int32_t>(text->image->size().width));
+		writer.add (static_cast<int32_t>(text->image->size().height));
+		writer.add (static_cast<int32_t>(text->position.x));
+		writer.add (static_cast<int32_t>(text->position.y));
 	}
 }
 
@@ -230,8 +580,23 @@ void
 PlayerVideo::write_to_socket (shared_ptr<Socket> socket) const
 {
 	_in->write_to_socket (socket);
-	if (_text) {
-		_text->image->write_to_socket (socket);
+	if (auto text = this->text()) {
+		write_image_to_socket (text->image, socket);
+	}
+}
+
+
+/** Add everything that add_metadata() and write_to_socket() describe to a digest */
+void
+PlayerVideo::add_digest (Digester& digester) const
+{
+	xmlpp::Document doc;
+	add_metadata (doc.create_root_node("PlayerVideo"));
+	digester.add (doc.write_to_string("UTF-8"));
+
+	digester.add (_in->fingerprint());
+	if (auto text = this->text()) {
+		text->image->add_digest (digester);
 	}
 }
 
@@ -239,14 +604,17 @@ PlayerVideo::write_to_socket (shared_ptr<Socket> socket) const
 bool
 PlayerVideo::has_j2k () const
 {
-	/* XXX: maybe other things */
-
 	auto j2k = dynamic_pointer_cast<const J2KImageProxy> (_in);
 	if (!j2k) {
 		return false;
 	}
 
-	return _crop == Crop() && _out_size == j2k->size() && _inter_size == j2k->size() && !_text && !_fade && !_colour_conversion;
+	/* A fade of 1 and text with no area change nothing */
+	auto const no_fade = !_fade || *_fade == 1;
+	auto const text = this->text();
+	auto const no_text = !text || text->image->size().width == 0 || text->image->size().height == 0;
+
+	return _crop == Crop() && _out_size == j2k->size() && _inter_size == j2k->size() && no_text && no_fade && !_colour_conversion;
 }
 
 
@@ -281,14 +649,30 @@ PlayerVideo::same (shared_ptr<const PlayerVideo> other) const
 		return false;
 	}
 
-	if ((!_text && other->_text) || (_text && !other->_text)) {
-		/* One has a text and the other doesn't */
-		return false;
-	}
-
-	if (_text && other->_text && !_text->same (other->_text.get ())) {
-		/* They both have texts but they are different */
-		return false;
+	if (_text != other->_text) {
+		auto finished = [](shared_ptr<const PendingText> text) {
+			return !text || text->wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		};
+
+		if (!finished(_text) || !finished(other->_text)) {
+			/* They have different texts which are not yet rendered; rather than waiting to see
+			 * if they turn out to be the same we say that they are probably not.
+			 */
+			return false;
+		}
+
+		auto const text = this->text();
+		auto const other_text = other->text();
+
+		if ((!text && other_text) || (text && !other_text)) {
+			/* One has a text and the other doesn't */
+			return false;
+		}
+
+		if (text && other_text && !text->same(other_text.get())) {
+			/* They both have texts but they are different */
+			return false;
+		}
 	}
 
 	/* Now neither has subtitles */
@@ -313,6 +697,8 @@ PlayerVideo::keep_xyz_or_rgb (AVPixelFormat p)
 void
 PlayerVideo::prepare (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, Image::Alignment alignment, bool fast, bool proxy_only)
 {
+	TraceSpan span("prepare");
+
 	_in->prepare (alignment, _inter_size);
 	boost::mutex::scoped_lock lm (_mutex);
 	if (!_image && !proxy_only) {
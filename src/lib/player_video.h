@@ -28,6 +28,7 @@
 #include "image.h"
 #include "position.h"
 #include "position_image.h"
+#include "rect.h"
 #include "types.h"
 extern "C" {
 #include <libavutil/pixfmt.h>
@@ -35,6 +36,9 @@ extern "C" {
 #include <boost/thread/mutex.hpp>
 
 
+class BinaryDescriptorReader;
+class BinaryDescriptorWriter;
+class Digester;
 class Image;
 class ImageProxy;
 class Film;
@@ -64,6 +68,7 @@ public:
 		);
 
 	PlayerVideo (std::shared_ptr<cxml::Node>, std::shared_ptr<Socket>);
+	PlayerVideo (BinaryDescriptorReader& reader, std::shared_ptr<Socket>);
 
 	PlayerVideo (PlayerVideo const&) = delete;
 	PlayerVideo& operator= (PlayerVideo const&) = delete;
@@ -71,19 +76,27 @@ public:
 	std::shared_ptr<PlayerVideo> shallow_copy () const;
 
 	void set_text (PositionImage);
-	boost::optional<PositionImage> text () const {
-		return _text;
-	}
+	void set_text (std::shared_ptr<const PendingText>);
+	boost::optional<PositionImage> text () const;
 
 	void prepare (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, Image::Alignment alignment, bool fast, bool proxy_only);
 	std::shared_ptr<Image> image (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const;
+	void render (
+		std::function<AVPixelFormat (AVPixelFormat)> pixel_format,
+		VideoRange video_range,
+		bool fast,
+		std::function<void (Image const&, int, int)> rows_ready
+		) const;
 	std::shared_ptr<const Image> raw_image () const;
+	std::pair<std::shared_ptr<const Image>, dcpomatic::Rect<float>> raw_image_and_window () const;
 
 	static AVPixelFormat force (AVPixelFormat);
 	static AVPixelFormat keep_xyz_or_rgb (AVPixelFormat);
 
 	void add_metadata (xmlpp::Node* node) const;
+	void add_metadata (BinaryDescriptorWriter& writer) const;
 	void write_to_socket (std::shared_ptr<Socket> socket) const;
+	void add_digest (Digester& digester) const;
 
 	bool reset_metadata (std::shared_ptr<const Film> film, dcp::Size player_video_container_size);
 
@@ -102,6 +115,14 @@ public:
 		return _colour_conversion;
 	}
 
+	boost::optional<double> fade () const {
+		return _fade;
+	}
+
+	VideoRange video_range () const {
+		return _video_range;
+	}
+
 	/** @return Position of the content within the overall image once it has been scaled up */
 	Position<int> inter_position () const;
 
@@ -128,6 +149,12 @@ public:
 
 private:
 	void make_image (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const;
+	std::shared_ptr<Image> render_image (
+		std::function<AVPixelFormat (AVPixelFormat)> pixel_format,
+		VideoRange video_range,
+		bool fast,
+		std::function<void (Image const&, int, int)> rows_ready
+		) const;
 
 	std::shared_ptr<const ImageProxy> _in;
 	Crop _crop;
@@ -138,7 +165,8 @@ private:
 	Part _part;
 	boost::optional<ColourConversion> _colour_conversion;
 	VideoRange _video_range;
-	boost::optional<PositionImage> _text;
+	/** Text to burn in, which may still be being rendered */
+	std::shared_ptr<const PendingText> _text;
 	/** Content that we came from.  This is so that reset_metadata() can work. */
 	std::weak_ptr<Content> _content;
 	/** Video frame that we came from.  Again, this is for reset_metadata() */
@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "player_video.h"
+#include "player_video_cache.h"
+
+
+using std::make_pair;
+using std::pair;
+using std::shared_ptr;
+using boost::optional;
+using namespace dcpomatic;
+
+
+/** @param max_memory Maximum amount of memory that the PlayerVideos in the cache should use, in bytes */
+PlayerVideoCache::PlayerVideoCache (size_t max_memory)
+	: _max_memory (max_memory)
+{
+
+}
+
+
+/** Add a PlayerVideo to the cache, replacing anything that is already there for the same time */
+void
+PlayerVideoCache::put (shared_ptr<PlayerVideo> video, DCPTime time)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	auto existing = _entries.find (time);
+	if (existing != _entries.end()) {
+		_memory_used -= existing->second.memory;
+		_lru.erase (existing->second.lru);
+		_entries.erase (existing);
+	}
+
+	_lru.push_front (time);
+	auto const memory = video->memory_used();
+	_entries[time] = { video, memory, _lru.begin() };
+	_memory_used += memory;
+
+	/* Throw out the oldest entries until we fit, but always keep the one we just added */
+	while (_memory_used > _max_memory && _lru.size() > 1) {
+		auto oldest = _entries.find (_lru.back());
+		DCPOMATIC_ASSERT (oldest != _entries.end());
+		_memory_used -= oldest->second.memory;
+		_entries.erase (oldest);
+		_lru.pop_back ();
+	}
+}
+
+
+/** @param time Time to look for.
+ *  @param one_frame Length of one video frame.
+ *  @return The PlayerVideo that is shown at time, and the time that it starts, if we have it.
+ */
+optional<pair<shared_ptr<PlayerVideo>, DCPTime>>
+PlayerVideoCache::get (DCPTime time, DCPTime one_frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	/* Find the last entry which starts at or before time */
+	auto i = _entries.upper_bound (time);
+	if (i == _entries.begin()) {
+		return {};
+	}
+	--i;
+
+	if (time >= i->first + one_frame) {
+		return {};
+	}
+
+	_lru.splice (_lru.begin(), _lru, i->second.lru);
+	return make_pair(i->second.video, i->first);
+}
+
+
+void
+PlayerVideoCache::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_entries.clear ();
+	_lru.clear ();
+	_memory_used = 0;
+}
+
+
+size_t
+PlayerVideoCache::memory_used () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _memory_used;
+}
@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_PLAYER_VIDEO_CACHE_H
+#define DCPOMATIC_PLAYER_VIDEO_CACHE_H
+
+
+#include "dcpomatic_time.h"
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+#include <memory>
+
+
+class PlayerVideo;
+
+
+/** @class PlayerVideoCache
+ *  @brief A memory-bounded cache of PlayerVideos, keyed by the time at which they are shown.
+ *
+ *  When the cache is full the least-recently-used PlayerVideos are thrown away.
+ */
+class PlayerVideoCache
+{
+public:
+	explicit PlayerVideoCache (size_t max_memory);
+
+	PlayerVideoCache (PlayerVideoCache const&) = delete;
+	PlayerVideoCache& operator= (PlayerVideoCache const&) = delete;
+
+	void put (std::shared_ptr<PlayerVideo> video, dcpomatic::DCPTime time);
+	boost::optional<std::pair<std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime>> get (dcpomatic::DCPTime time, dcpomatic::DCPTime one_frame);
+	void clear ();
+
+	size_t memory_used () const;
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<PlayerVideo> video;
+		size_t memory;
+		/** our position in _lru */
+		std::list<dcpomatic::DCPTime>::iterator lru;
+	};
+
+	mutable boost::mutex _mutex;
+	std::map<dcpomatic::DCPTime, Entry> _entries;
+	/** Times of the entries in _entries, most recently used first */
+	std::list<dcpomatic::DCPTime> _lru;
+	size_t _memory_used = 0;
+	size_t _max_memory;
+};
+
+
+#endif
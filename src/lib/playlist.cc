@@ -36,6 +36,8 @@
 #include <libcxml/cxml.h>
 #include <libxml++/libxml++.h>
 #include <boost/bind/placeholders.hpp>
+#include <boost/thread.hpp>
+#include <future>
 #include <iostream>
 
 #include "i18n.h"
@@ -59,6 +61,7 @@ using namespace boost::placeholders;
 
 
 Playlist::Playlist ()
+	: _snapshot (std::make_shared<const ContentList>())
 {
 
 }
@@ -68,6 +71,7 @@ Playlist::~Playlist ()
 {
 	boost::mutex::scoped_lock lm (_mutex);
 	_content.clear ();
+	publish ();
 	disconnect ();
 }
 
@@ -106,6 +110,9 @@ Playlist::content_change (weak_ptr<const Film> weak_film, ChangeType type, weak_
 				ContentList old = _content;
 				sort (_content.begin(), _content.end(), ContentSorter ());
 				changed = _content != old;
+				if (changed) {
+					publish ();
+				}
 			}
 
 			if (changed) {
@@ -181,7 +188,8 @@ Playlist::video_identifier () const
 {
 	string t;
 
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		bool burn = false;
 		for (auto j: i->text) {
 			if (j->burn()) {
@@ -209,8 +217,33 @@ Playlist::set_from_xml (shared_ptr<const Film> film, cxml::ConstNodePtr node, in
 {
 	boost::mutex::scoped_lock lm (_mutex);
 
-	for (auto i: node->node_children ("Content")) {
-		auto content = content_factory (i, version, notes);
+	auto const children = node->node_children ("Content");
+	vector<cxml::ConstNodePtr> const nodes (children.begin(), children.end());
+
+	/* Making the content may mean looking at its files, which can be slow (on network storage
+	   for example), so make it in a few threads when there's a lot of it.
+	*/
+	vector<shared_ptr<Content>> made (nodes.size());
+	vector<list<string>> made_notes (nodes.size());
+	auto const threads = nodes.size() < 8 ? 1 : std::min(nodes.size(), static_cast<size_t>(std::max(1U, boost::thread::hardware_concurrency())));
+	auto make = [&nodes, &made, &made_notes, threads, version](size_t first) {
+		for (size_t i = first; i < nodes.size(); i += threads) {
+			made[i] = content_factory (nodes[i], version, made_notes[i]);
+		}
+	};
+
+	vector<std::future<void>> makers;
+	for (size_t i = 1; i < threads; ++i) {
+		makers.push_back (std::async(std::launch::async, make, i));
+	}
+	make (0);
+	for (auto& i: makers) {
+		i.get ();
+	}
+
+	for (size_t i = 0; i < made.size(); ++i) {
+		auto content = made[i];
+		notes.splice (notes.end(), made_notes[i]);
 
 		/* See if this content should be nudged to start on a video frame */
 		auto const old_pos = content->position();
@@ -257,6 +290,7 @@ Playlist::set_from_xml (shared_ptr<const Film> film, cxml::ConstNodePtr node, in
 
 	/* This shouldn't be necessary but better safe than sorry (there could be old files) */
 	sort (_content.begin(), _content.end(), ContentSorter ());
+	publish ();
 
 	reconnect (film);
 }
@@ -268,7 +302,8 @@ Playlist::set_from_xml (shared_ptr<const Film> film, cxml::ConstNodePtr node, in
 void
 Playlist::as_xml (xmlpp::Node* node, bool with_content_paths)
 {
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		i->as_xml (node->add_child ("Content"), with_content_paths);
 	}
 }
@@ -276,13 +311,22 @@ Playlist::as_xml (xmlpp::Node* node, bool with_content_paths)
 
 void
 Playlist::add (shared_ptr<const Film> film, shared_ptr<Content> c)
+{
+	add (film, ContentList{c});
+}
+
+
+/** Add some content, giving one change signal for all of it */
+void
+Playlist::add (shared_ptr<const Film> film, ContentList content)
 {
 	Change (ChangeType::PENDING);
 
 	{
 		boost::mutex::scoped_lock lm (_mutex);
-		_content.push_back (c);
+		_content.insert (_content.end(), content.begin(), content.end());
 		sort (_content.begin(), _content.end(), ContentSorter ());
+		publish ();
 		reconnect (film);
 	}
 
@@ -309,6 +353,7 @@ Playlist::remove (shared_ptr<Content> c)
 
 		if (i != _content.end()) {
 			_content.erase (i);
+			publish ();
 		} else {
 			cancelled = true;
 		}
@@ -344,6 +389,8 @@ Playlist::remove (ContentList c)
 				_content.erase (j);
 			}
 		}
+
+		publish ();
 	}
 
 	Change (ChangeType::DONE);
@@ -394,7 +441,8 @@ Playlist::best_video_frame_rate () const
 	while (i != candidates.end()) {
 
 		float this_error = 0;
-		for (auto j: content()) {
+		auto const snapshot = content_snapshot ();
+		for (auto const& j: *snapshot) {
 			if (!j->video || !j->video_frame_rate()) {
 				continue;
 			}
@@ -430,7 +478,8 @@ DCPTime
 Playlist::length (shared_ptr<const Film> film) const
 {
 	DCPTime len;
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		len = max (len, i->end(film));
 	}
 
@@ -442,13 +491,13 @@ Playlist::length (shared_ptr<const Film> film) const
 optional<DCPTime>
 Playlist::start () const
 {
-	auto cont = content ();
-	if (cont.empty()) {
+	auto cont = content_snapshot ();
+	if (cont->empty()) {
 		return {};
 	}
 
 	auto start = DCPTime::max ();
-	for (auto i: cont) {
+	for (auto const& i: *cont) {
 		start = min (start, i->position ());
 	}
 
@@ -484,7 +533,8 @@ DCPTime
 Playlist::video_end (shared_ptr<const Film> film) const
 {
 	DCPTime end;
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		if (i->video) {
 			end = max (end, i->end(film));
 		}
@@ -498,7 +548,8 @@ DCPTime
 Playlist::text_end (shared_ptr<const Film> film) const
 {
 	DCPTime end;
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		if (!i->text.empty ()) {
 			end = max (end, i->end(film));
 		}
@@ -511,8 +562,8 @@ Playlist::text_end (shared_ptr<const Film> film) const
 FrameRateChange
 Playlist::active_frame_rate_change (DCPTime t, int dcp_video_frame_rate) const
 {
-	auto cont = content ();
-	for (ContentList::const_reverse_iterator i = cont.rbegin(); i != cont.rend(); ++i) {
+	auto cont = content_snapshot ();
+	for (auto i = cont->rbegin(); i != cont->rend(); ++i) {
 		if (!(*i)->video) {
 			continue;
 		}
@@ -565,8 +616,26 @@ ContentSorter::operator() (shared_ptr<Content> a, shared_ptr<Content> b)
 ContentList
 Playlist::content () const
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	return _content;
+	return *content_snapshot ();
+}
+
+
+/** @return content in ascending order of position, as it was after the last change.
+ *  This does not take any lock or copy the list, so it is cheap to call often; the
+ *  list that is returned will not change, even if the playlist does.
+ */
+shared_ptr<const ContentList>
+Playlist::content_snapshot () const
+{
+	return std::atomic_load (&_snapshot);
+}
+
+
+/** Make a new snapshot of _content.  Must be called with a lock held on _mutex */
+void
+Playlist::publish ()
+{
+	std::atomic_store (&_snapshot, std::make_shared<const ContentList>(_content));
 }
 
 
@@ -597,6 +666,7 @@ Playlist::repeat (shared_ptr<const Film> film, ContentList c, int n)
 		}
 
 		sort (_content.begin(), _content.end(), ContentSorter ());
+		publish ();
 		reconnect (film);
 	}
 
@@ -659,7 +729,8 @@ Playlist::required_disk_space (shared_ptr<const Film> film, int j2k_bandwidth, i
 	int64_t video = uint64_t (j2k_bandwidth / 8) * length(film).seconds();
 	int64_t audio = uint64_t (audio_channels * audio_frame_rate * 3) * length(film).seconds();
 
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		auto d = dynamic_pointer_cast<DCPContent> (i);
 		if (d) {
 			if (d->reference_video()) {
@@ -681,7 +752,8 @@ Playlist::content_summary (shared_ptr<const Film> film, DCPTimePeriod period) co
 {
 	string best_summary;
 	int best_score = -1;
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		int score = 0;
 		auto const o = DCPTimePeriod(i->position(), i->end(film)).overlap (period);
 		if (o) {
@@ -707,7 +779,8 @@ Playlist::speed_up_range (int dcp_video_frame_rate) const
 {
 	pair<double, double> range (DBL_MAX, -DBL_MAX);
 
-	for (auto i: content()) {
+	auto const snapshot = content_snapshot ();
+	for (auto const& i: *snapshot) {
 		if (!i->video) {
 			continue;
 		}
@@ -58,12 +58,14 @@ public:
 	void set_from_xml (std::shared_ptr<const Film> film, cxml::ConstNodePtr node, int version, std::list<std::string>& notes);
 
 	void add (std::shared_ptr<const Film> film, std::shared_ptr<Content>);
+	void add (std::shared_ptr<const Film> film, ContentList content);
 	void remove (std::shared_ptr<Content>);
 	void remove (ContentList);
 	void move_earlier (std::shared_ptr<const Film> film, std::shared_ptr<Content>);
 	void move_later (std::shared_ptr<const Film> film, std::shared_ptr<Content>);
 
 	ContentList content () const;
+	std::shared_ptr<const ContentList> content_snapshot () const;
 
 	std::string video_identifier () const;
 
@@ -95,10 +97,16 @@ private:
 	void content_change (std::weak_ptr<const Film>, ChangeType, std::weak_ptr<Content>, int, bool);
 	void disconnect ();
 	void reconnect (std::shared_ptr<const Film> film);
+	void publish ();
 
 	mutable boost::mutex _mutex;
 	/** List of content.  Kept sorted in position order. */
 	ContentList _content;
+	/** Copy of _content as it was after the last change, which is replaced (rather than
+	 *  changed) each time _content changes, so that it can be read without taking _mutex.
+	 *  Use std::atomic_load and std::atomic_store to get and set it.
+	 */
+	std::shared_ptr<const ContentList> _snapshot;
 	bool _sequence = true;
 	bool _sequencing = false;
 	std::list<boost::signals2::connection> _content_connections;
@@ -37,3 +37,13 @@ PositionImage::same (PositionImage const & other) const
 
 	return *image == *(other.image);
 }
+
+
+/** @return a PendingText which is already finished */
+std::shared_ptr<const PendingText>
+ready_text (boost::optional<PositionImage> image)
+{
+	std::promise<boost::optional<PositionImage>> promise;
+	promise.set_value (image);
+	return std::make_shared<PendingText>(promise.get_future().share());
+}
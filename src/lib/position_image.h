@@ -24,6 +24,8 @@
 
 
 #include "position.h"
+#include <boost/optional.hpp>
+#include <future>
 #include <memory>
 
 
@@ -47,4 +49,10 @@ public:
 };
 
 
+/** An image which may still be being made by another thread; get() waits for it */
+typedef std::shared_future<boost::optional<PositionImage>> PendingText;
+
+extern std::shared_ptr<const PendingText> ready_text (boost::optional<PositionImage> image);
+
+
 #endif
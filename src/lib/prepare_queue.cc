@@ -0,0 +1,178 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_log.h"
+#include "metrics.h"
+#include "prepare_queue.h"
+#include "util.h"
+#include <boost/thread/locks.hpp>
+#include <chrono>
+#include <cmath>
+
+
+using std::function;
+using namespace dcpomatic;
+
+
+/** Number of threads we want per task that will be in progress on average, so that
+ *  we keep up even when some tasks take longer than usual.
+ */
+static double const headroom = 2;
+/** Weight given to each new task duration in our running average */
+static double const average_weight = 0.1;
+
+
+PrepareQueue::PrepareQueue (int threads, function<void ()> setup)
+	: _maximum_threads (std::max(1, threads))
+	, _setup (setup)
+	, _active_threads (_maximum_threads)
+{
+	for (int i = 0; i < _maximum_threads; ++i) {
+		_threads.create_thread (boost::bind(&PrepareQueue::thread, this, i));
+	}
+}
+
+
+PrepareQueue::~PrepareQueue ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_tasks.clear ();
+	}
+
+	_condition.notify_all ();
+
+	try {
+		_threads.join_all ();
+	} catch (...) {}
+}
+
+
+/** Add a task to be run after any that are already waiting for earlier times */
+void
+PrepareQueue::add (DCPTime time, function<void ()> task)
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_tasks.insert ({time, _next_index++, task});
+	}
+
+	_condition.notify_all ();
+}
+
+
+/** Drop all tasks that have not yet been started */
+void
+PrepareQueue::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_tasks.clear ();
+}
+
+
+/** Set the frame rate, in frames per second, at which the tasks must be done to keep up */
+void
+PrepareQueue::set_frame_rate (int rate)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_frame_rate = std::max(1, rate);
+	if (_average_task >= 0) {
+		_active_threads = threads_needed (_average_task, _frame_rate, _maximum_threads);
+	}
+}
+
+
+size_t
+PrepareQueue::waiting () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _tasks.size();
+}
+
+
+int
+PrepareQueue::active_threads () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _active_threads;
+}
+
+
+/** @param task_seconds Time that each task takes.
+ *  @param frame_rate Rate at which tasks must be done.
+ *  @param maximum Maximum number of threads to return.
+ *  @return Number of threads needed to keep up.
+ */
+int
+PrepareQueue::threads_needed (double task_seconds, int frame_rate, int maximum)
+{
+	auto const needed = static_cast<int>(std::ceil(task_seconds * frame_rate * headroom));
+	return std::max(1, std::min(needed, maximum));
+}
+
+
+void
+PrepareQueue::thread (int index)
+{
+	start_of_thread ("prepare");
+	_setup ();
+
+	static auto& threads_metric = Metrics::instance()->gauge("dcpomatic_butler_prepare_threads", "Threads that the butler is using to prepare video");
+
+	while (true) {
+		Task task;
+
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			/* Threads beyond the number that are needed sit here, so that the threads which
+			 * are running are not fighting over the CPUs for no gain.
+			 */
+			while (!_stop && (_tasks.empty() || index >= _active_threads)) {
+				_condition.wait (lm);
+			}
+
+			if (_stop) {
+				return;
+			}
+
+			task = *_tasks.begin();
+			_tasks.erase (_tasks.begin());
+		}
+
+		auto const start = std::chrono::steady_clock::now();
+		task.function ();
+		auto const taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		boost::mutex::scoped_lock lm (_mutex);
+		_average_task = _average_task < 0 ? taken : (_average_task * (1 - average_weight) + taken * average_weight);
+		auto const active = threads_needed (_average_task, _frame_rate, _maximum_threads);
+		if (active != _active_threads) {
+			LOG_TIMING("prepare-threads %1", active);
+			_active_threads = active;
+			threads_metric.set (active);
+			lm.unlock ();
+			_condition.notify_all ();
+		}
+	}
+}
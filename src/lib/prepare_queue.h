@@ -0,0 +1,102 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_PREPARE_QUEUE_H
+#define DCPOMATIC_PREPARE_QUEUE_H
+
+
+#include "dcpomatic_time.h"
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <functional>
+#include <set>
+
+
+/** @class PrepareQueue
+ *  @brief A pool of threads which run tasks in order of the time of the video that they
+ *  are for, earliest first.
+ *
+ *  This means that after a seek the frame which will be shown first is prepared first,
+ *  rather than waiting behind those that were asked for before it.  Tasks which have
+ *  not been started can be dropped when they are no longer needed (e.g. after another seek).
+ *
+ *  The queue keeps an average of how long its tasks take, and runs only as many threads
+ *  at once as are needed to keep up with the frame rate; cheap tasks (such as preparing
+ *  HD H.264) then use a thread or two while expensive ones (such as decoding 4K JPEG2000)
+ *  get as many as we have.
+ */
+class PrepareQueue
+{
+public:
+	/** @param threads Maximum number of threads to use.
+	 *  @param setup Function to call at the start of each thread.
+	 */
+	PrepareQueue (int threads, std::function<void ()> setup);
+	~PrepareQueue ();
+
+	PrepareQueue (PrepareQueue const&) = delete;
+	PrepareQueue& operator= (PrepareQueue const&) = delete;
+
+	void add (dcpomatic::DCPTime time, std::function<void ()> task);
+	void clear ();
+	void set_frame_rate (int rate);
+
+	size_t waiting () const;
+	int active_threads () const;
+
+	static int threads_needed (double task_seconds, int frame_rate, int maximum);
+
+private:
+	void thread (int index);
+
+	struct Task
+	{
+		dcpomatic::DCPTime time;
+		/** order in which the task was added, so that tasks for the same time run in that order */
+		uint64_t index;
+		std::function<void ()> function;
+
+		bool operator< (Task const& other) const {
+			if (time != other.time) {
+				return time < other.time;
+			}
+			return index < other.index;
+		}
+	};
+
+	int const _maximum_threads;
+	std::function<void ()> _setup;
+	boost::thread_group _threads;
+
+	/** mutex to protect everything below */
+	mutable boost::mutex _mutex;
+	boost::condition _condition;
+	std::set<Task> _tasks;
+	uint64_t _next_index = 0;
+	int _frame_rate = 24;
+	/** average time taken by a task in seconds, or a negative value if no task has finished yet */
+	double _average_task = -1;
+	int _active_threads;
+	bool _stop = false;
+};
+
+
+#endif
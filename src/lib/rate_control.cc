@@ -0,0 +1,161 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "image.h"
+#include "rate_control.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+
+using std::shared_ptr;
+using std::vector;
+
+
+/** Only look at every this-many-th pixel in each direction when measuring complexity */
+static int const complexity_skip = 4;
+
+
+/** @param image Image in AV_PIX_FMT_RGB48LE or AV_PIX_FMT_XYZ12LE.
+ *  @return A measure of how hard the image will be to compress; this is the mean
+ *  absolute difference between neighbouring values of the first component, which
+ *  is rough, but goes up with the amount of detail that the wavelet transform has to keep.
+ */
+double
+frame_complexity (shared_ptr<const Image> image)
+{
+	DCPOMATIC_ASSERT (image->pixel_format() == AV_PIX_FMT_RGB48LE || image->pixel_format() == AV_PIX_FMT_XYZ12LE);
+
+	/* Put 12-bit values on the same scale as 16-bit ones */
+	int const shift = image->pixel_format() == AV_PIX_FMT_XYZ12LE ? 4 : 0;
+	auto const size = image->size();
+
+	int64_t total = 0;
+	int64_t count = 0;
+	for (int y = 0; y < size.height - 1; y += complexity_skip) {
+		auto p = reinterpret_cast<uint16_t const*>(image->data()[0] + y * image->stride()[0]);
+		auto q = reinterpret_cast<uint16_t const*>(image->data()[0] + (y + 1) * image->stride()[0]);
+		for (int x = 0; x < size.width - 1; x += complexity_skip) {
+			int const here = p[x * 3];
+			total += std::abs(here - p[(x + 1) * 3]) + std::abs(here - q[x * 3]);
+			++count;
+		}
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	return static_cast<double>(total << shift) / count;
+}
+
+
+/** Share out some J2K bandwidth between frames according to their complexity.
+ *  @param complexity Complexity of each frame, from frame_complexity().
+ *  @param average Average bandwidth to aim for, in bits per second.
+ *  @param minimum Minimum bandwidth to give any frame.
+ *  @param maximum Maximum bandwidth to give any frame.
+ *  @return Bandwidth for each frame, in bits per second.  The mean of these will be about @p average,
+ *  unless that is impossible within @p minimum and @p maximum.
+ */
+vector<int>
+allocate_j2k_bandwidths (vector<double> const& complexity, int average, int minimum, int maximum)
+{
+	DCPOMATIC_ASSERT (minimum <= average && average <= maximum);
+
+	auto const N = complexity.size();
+	if (N == 0) {
+		return {};
+	}
+
+	/* Keep some weight on even the simplest frames so that they are never starved entirely */
+	double mean_complexity = 0;
+	for (auto i: complexity) {
+		mean_complexity += i;
+	}
+	mean_complexity /= N;
+	auto const floor = std::max(mean_complexity * 0.05, 1e-6);
+
+	vector<double> weight (N);
+	for (size_t i = 0; i < N; ++i) {
+		weight[i] = std::max(complexity[i], floor);
+	}
+
+	/* Share the budget out by weight, then fix any frames which would go outside the limits
+	   at those limits and share whatever is left between the others.  Each time round at least
+	   one more frame is fixed, so this must finish.
+	*/
+	vector<double> bandwidth (N);
+	vector<bool> fixed (N, false);
+	double budget = static_cast<double>(average) * N;
+	while (true) {
+		double free_weight = 0;
+		for (size_t i = 0; i < N; ++i) {
+			if (!fixed[i]) {
+				free_weight += weight[i];
+			}
+		}
+
+		if (free_weight == 0) {
+			break;
+		}
+
+		/* Find the frames that overflow and underflow */
+		double over = 0;
+		double under = 0;
+		for (size_t i = 0; i < N; ++i) {
+			if (!fixed[i]) {
+				bandwidth[i] = budget * weight[i] / free_weight;
+				over += std::max(0.0, bandwidth[i] - maximum);
+				under += std::max(0.0, minimum - bandwidth[i]);
+			}
+		}
+
+		if (over == 0 && under == 0) {
+			break;
+		}
+
+		/* Fix whichever sort of frame is sticking out most, since fixing those can only push the
+		   others further in the same direction.
+		*/
+		for (size_t i = 0; i < N; ++i) {
+			if (fixed[i]) {
+				continue;
+			}
+			if (over >= under && bandwidth[i] > maximum) {
+				bandwidth[i] = maximum;
+				fixed[i] = true;
+				budget -= maximum;
+			} else if (over < under && bandwidth[i] < minimum) {
+				bandwidth[i] = minimum;
+				fixed[i] = true;
+				budget -= minimum;
+			}
+		}
+	}
+
+	vector<int> result (N);
+	for (size_t i = 0; i < N; ++i) {
+		result[i] = std::max(minimum, std::min(maximum, static_cast<int>(lrint(bandwidth[i]))));
+	}
+	return result;
+}
@@ -0,0 +1,43 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/rate_control.h
+ *  @brief Helpers for two-pass encoding, where frames are given different J2K bandwidths
+ *  according to how complex they are.
+ */
+
+
+#ifndef DCPOMATIC_RATE_CONTROL_H
+#define DCPOMATIC_RATE_CONTROL_H
+
+
+#include <memory>
+#include <vector>
+
+
+class Image;
+
+
+extern double frame_complexity (std::shared_ptr<const Image> image);
+extern std::vector<int> allocate_j2k_bandwidths (std::vector<double> const& complexity, int average, int minimum, int maximum);
+
+
+#endif
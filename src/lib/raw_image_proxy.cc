@@ -19,8 +19,11 @@
 */
 
 
+#include "binary_descriptor.h"
+#include "digester.h"
 #include "raw_image_proxy.h"
 #include "image.h"
+#include "image_compression.h"
 #include <dcp/raw_convert.h>
 #include <dcp/util.h>
 #include <dcp/warnings.h>
@@ -45,8 +48,9 @@ using boost::optional;
 using dcp::raw_convert;
 
 
-RawImageProxy::RawImageProxy(shared_ptr<const Image> image)
+RawImageProxy::RawImageProxy(shared_ptr<const Image> image, int log2_scaling)
 	: _image (image)
+	, _log2_scaling (log2_scaling)
 {
 
 }
@@ -59,7 +63,19 @@ RawImageProxy::RawImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> soc
 		);
 
 	auto image = make_shared<Image>(static_cast<AVPixelFormat>(xml->number_child<int>("PixelFormat")), size, Image::Alignment::PADDED);
-	image->read_from_socket (socket);
+	read_image_from_socket (image, socket);
+	_image = image;
+}
+
+
+RawImageProxy::RawImageProxy (BinaryDescriptorReader& reader, shared_ptr<Socket> socket)
+{
+	auto const width = reader.read_int32 ();
+	auto const height = reader.read_int32 ();
+	auto const pixel_format = static_cast<AVPixelFormat>(reader.read_int32());
+
+	auto image = make_shared<Image>(pixel_format, dcp::Size(width, height), Image::Alignment::PADDED);
+	read_image_from_socket (image, socket);
 	_image = image;
 }
 
@@ -67,8 +83,16 @@ RawImageProxy::RawImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> soc
 ImageProxy::Result
 RawImageProxy::image (Image::Alignment alignment, optional<dcp::Size>) const
 {
-	/* This ensure_alignment could be wasteful */
-	return Result (Image::ensure_alignment(_image, alignment), 0);
+	if (_image->alignment() == alignment) {
+		return Result (_image, _log2_scaling);
+	}
+
+	/* Keep the copy, as the same proxy (e.g. for a black frame) may be asked for it many times */
+	boost::mutex::scoped_lock lm (_mutex);
+	if (!_realigned) {
+		_realigned = Image::ensure_alignment(_image, alignment);
+	}
+	return Result (_realigned, _log2_scaling);
 }
 
 
@@ -82,10 +106,27 @@ RawImageProxy::add_metadata (xmlpp::Node* node) const
 }
 
 
+void
+RawImageProxy::add_metadata (BinaryDescriptorWriter& writer) const
+{
+	writer.add (static_cast<int32_t>(ImageProxyType::RAW));
+	writer.add (static_cast<int32_t>(_image->size().width));
+	writer.add (static_cast<int32_t>(_image->size().height));
+	writer.add (static_cast<int32_t>(_image->pixel_format()));
+}
+
+
 void
 RawImageProxy::write_to_socket (shared_ptr<Socket> socket) const
 {
-	_image->write_to_socket (socket);
+	write_image_to_socket (_image, socket);
+}
+
+
+void
+RawImageProxy::add_digest (Digester& digester) const
+{
+	_image->add_digest (digester);
 }
 
 
@@ -97,6 +138,14 @@ RawImageProxy::same (shared_ptr<const ImageProxy> other) const
 		return false;
 	}
 
+	if (rp->_image == _image) {
+		return true;
+	}
+
+	if (auto same = same_fingerprint(*rp)) {
+		return *same;
+	}
+
 	return (*_image.get()) == (*rp->image(_image->alignment()).image.get());
 }
 
@@ -24,13 +24,16 @@
 
 
 #include "image_proxy.h"
+#include <boost/thread/mutex.hpp>
 
 
 class RawImageProxy : public ImageProxy
 {
 public:
-	explicit RawImageProxy(std::shared_ptr<const Image>);
+	/** @param log2_scaling log2 of the factor by which image is smaller than the source it came from */
+	explicit RawImageProxy(std::shared_ptr<const Image>, int log2_scaling = 0);
 	RawImageProxy (std::shared_ptr<cxml::Node> xml, std::shared_ptr<Socket> socket);
+	RawImageProxy (BinaryDescriptorReader& reader, std::shared_ptr<Socket> socket);
 
 	Result image (
 		Image::Alignment alignment,
@@ -38,12 +41,19 @@ public:
 		) const override;
 
 	void add_metadata (xmlpp::Node *) const override;
+	void add_metadata (BinaryDescriptorWriter& writer) const override;
 	void write_to_socket (std::shared_ptr<Socket>) const override;
+	void add_digest (Digester& digester) const override;
 	bool same (std::shared_ptr<const ImageProxy>) const override;
 	size_t memory_used () const override;
 
 private:
 	std::shared_ptr<const Image> _image;
+	int _log2_scaling = 0;
+
+	mutable boost::mutex _mutex;
+	/** copy of _image with the other alignment, made the first time that somebody asks for it */
+	mutable std::shared_ptr<const Image> _realigned;
 };
 
 
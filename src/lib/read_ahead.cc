@@ -0,0 +1,281 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "file_group.h"
+#include "read_ahead.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+
+
+using std::make_pair;
+using std::make_shared;
+using std::map;
+using std::max;
+using std::min;
+using std::shared_ptr;
+using std::vector;
+using std::weak_ptr;
+
+
+int const ReadAhead::block_size = 1024 * 1024;
+boost::mutex ReadAhead::_sources_mutex;
+map<vector<boost::filesystem::path>, weak_ptr<ReadAhead::Source>> ReadAhead::_sources;
+
+
+ReadAhead::ReadAhead (vector<boost::filesystem::path> paths, int64_t window, int threads)
+	: _window_blocks (max(int64_t(1), (window + block_size - 1) / block_size))
+{
+	DCPOMATIC_ASSERT (threads > 0);
+
+	{
+		boost::mutex::scoped_lock lm (_sources_mutex);
+		auto& source = _sources[paths];
+		_source = source.lock ();
+		if (!_source) {
+			_source = make_shared<Source>();
+			_source->paths = paths;
+			for (auto const& i: paths) {
+				_source->length += boost::filesystem::file_size (i);
+			}
+			source = _source;
+		}
+	}
+
+	for (int i = 0; i < threads; ++i) {
+		_threads.push_back (boost::thread(boost::bind(&ReadAhead::thread, this)));
+#ifdef DCPOMATIC_LINUX
+		pthread_setname_np (_threads.back().native_handle(), "read-ahead");
+#endif
+	}
+}
+
+
+ReadAhead::~ReadAhead ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_source->mutex);
+		_stop = true;
+		_source->pending_condition.notify_all ();
+	}
+
+	for (auto& i: _threads) {
+		try {
+			i.join ();
+		} catch (...) {}
+	}
+
+	{
+		boost::mutex::scoped_lock lm (_source->mutex);
+		_blocks.clear ();
+	}
+
+	boost::mutex::scoped_lock lm (_sources_mutex);
+	auto source = _sources.find (_source->paths);
+	_source.reset ();
+	if (source != _sources.end() && source->second.expired()) {
+		_sources.erase (source);
+	}
+}
+
+
+int64_t
+ReadAhead::length () const
+{
+	return _source->length;
+}
+
+
+int64_t
+ReadAhead::blocks_fetched () const
+{
+	boost::mutex::scoped_lock lm (_source->mutex);
+	return _source->fetched;
+}
+
+
+/** Seek in the same way as FileGroup::seek() */
+int64_t
+ReadAhead::seek (int64_t pos, int whence)
+{
+	switch (whence) {
+	case SEEK_SET:
+		_position = pos;
+		break;
+	case SEEK_CUR:
+		_position += pos;
+		break;
+	case SEEK_END:
+		_position = length() - pos;
+		break;
+	}
+
+	return _position;
+}
+
+
+/** Try to read some data from the current position into a buffer.
+ *  @param buffer Buffer to write data into.
+ *  @param amount Number of bytes to read.
+ *  @return Number of bytes read.
+ */
+int
+ReadAhead::read (uint8_t* buffer, int amount)
+{
+	int done = 0;
+
+	while (done < amount && _position >= 0 && _position < length()) {
+		auto const index = _position / block_size;
+		auto block = wait_for_block (index);
+		if (block->error) {
+			std::rethrow_exception (block->error);
+		}
+
+		auto const offset = _position - index * block_size;
+		auto const this_time = static_cast<int>(min(int64_t(amount - done), int64_t(block->data.size()) - offset));
+		if (this_time <= 0) {
+			/* The files got shorter while we were reading them */
+			break;
+		}
+		memcpy (buffer + done, block->data.data() + offset, this_time);
+		done += this_time;
+		_position += this_time;
+	}
+
+	return done;
+}
+
+
+/** Make the window start at a given block, and wait for that block to be read */
+shared_ptr<ReadAhead::Block>
+ReadAhead::wait_for_block (int64_t index)
+{
+	boost::mutex::scoped_lock lm (_source->mutex);
+
+	auto const end = index + _window_blocks;
+
+	bool dropped = false;
+	for (auto i = _blocks.begin(); i != _blocks.end(); ) {
+		if (i->first < index || i->first >= end) {
+			i = _blocks.erase (i);
+			dropped = true;
+		} else {
+			++i;
+		}
+	}
+
+	if (dropped) {
+		/* Forget about blocks that no ReadAhead wants any more.  Any that are still pending
+		   will be skipped by the threads.
+		*/
+		for (auto i = _source->blocks.begin(); i != _source->blocks.end(); ) {
+			if (i->second.expired()) {
+				i = _source->blocks.erase (i);
+			} else {
+				++i;
+			}
+		}
+	}
+
+	for (auto i = index; i < end && i * block_size < length(); ++i) {
+		if (_blocks.find(i) == _blocks.end()) {
+			auto& shared = _source->blocks[i];
+			auto block = shared.lock ();
+			if (!block) {
+				block = make_shared<Block>();
+				shared = block;
+				_source->pending.push_back (make_pair(i, weak_ptr<Block>(block)));
+			}
+			_blocks[i] = block;
+		}
+	}
+
+	_source->pending_condition.notify_all ();
+
+	auto block = _blocks[index];
+	while (!block->ready) {
+		_source->ready_condition.wait (lm);
+	}
+
+	return block;
+}
+
+
+/** Thread to read pending blocks; these may be wanted by any of the ReadAheads sharing our source */
+void
+ReadAhead::thread ()
+{
+	start_of_thread ("ReadAhead");
+
+	/* Each thread has its own files open so that they can all be reading at once */
+	FileGroup group;
+	bool opened = false;
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_source->mutex);
+		while (!_stop && _source->pending.empty()) {
+			_source->pending_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		auto const index = _source->pending.front().first;
+		auto block = _source->pending.front().second.lock();
+		_source->pending.pop_front ();
+		if (!block) {
+			/* Nobody wants this one any more */
+			continue;
+		}
+		++_source->fetched;
+		lm.unlock ();
+
+		try {
+			if (!opened) {
+				group.set_paths (_source->paths);
+				opened = true;
+			}
+			auto const start = index * block_size;
+			block->data.resize (min(int64_t(block_size), length() - start));
+			group.seek (start, SEEK_SET);
+			int done = 0;
+			while (done < static_cast<int>(block->data.size())) {
+				auto const this_time = group.read (block->data.data() + done, block->data.size() - done);
+				if (this_time == 0) {
+					/* The files got shorter since we started */
+					block->data.resize (done);
+					break;
+				}
+				done += this_time;
+			}
+		} catch (...) {
+			block->error = std::current_exception ();
+		}
+
+		lm.lock ();
+		block->ready = true;
+		_source->ready_condition.notify_all ();
+	}
+}
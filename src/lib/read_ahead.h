@@ -0,0 +1,131 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/read_ahead.h
+ *  @brief ReadAhead class.
+ */
+
+
+#ifndef DCPOMATIC_READ_AHEAD_H
+#define DCPOMATIC_READ_AHEAD_H
+
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <vector>
+
+
+/** @class ReadAhead
+ *  @brief Reads a list of files as if they were concatenated (like FileGroup) with some
+ *  threads fetching the data after the current position before it is asked for.
+ *
+ *  The files are read in fixed-size blocks.  Each read or seek asks for the blocks in a
+ *  window after the new position, and throws away any that are outside it; the blocks
+ *  are then read in parallel by our threads.  This helps when the files are on network
+ *  storage, where each read may take a while to come back but several can be in flight
+ *  at once.
+ *
+ *  Every ReadAhead of the same files shares the blocks that it has, so when several decoders
+ *  are reading one file (because it has been added to the film more than once, say) each
+ *  block is only fetched once as long as they are reading near each other.
+ */
+class ReadAhead
+{
+public:
+	/** @param paths Files to read.
+	 *  @param window Number of bytes to read ahead of the current position.
+	 *  @param threads Number of threads to read with.
+	 */
+	ReadAhead (std::vector<boost::filesystem::path> paths, int64_t window, int threads);
+	~ReadAhead ();
+
+	ReadAhead (ReadAhead const&) = delete;
+	ReadAhead& operator= (ReadAhead const&) = delete;
+
+	int64_t seek (int64_t pos, int whence);
+	int read (uint8_t* buffer, int amount);
+
+	int64_t length () const;
+
+	/** @return Number of blocks that have been fetched from the files by all ReadAheads
+	 *  which are sharing with this one.
+	 */
+	int64_t blocks_fetched () const;
+
+	static int const block_size;
+
+private:
+	struct Block
+	{
+		std::vector<uint8_t> data;
+		/** true when data has been filled in (or an error has been set) */
+		bool ready = false;
+		/** exception thrown when reading the data, if there was one */
+		std::exception_ptr error;
+	};
+
+	/** The state which is shared by all ReadAheads of some files */
+	struct Source
+	{
+		std::vector<boost::filesystem::path> paths;
+		int64_t length = 0;
+
+		/** mutex to protect the state below, and that of each ReadAhead using this source */
+		boost::mutex mutex;
+		/** signalled when there is something new in pending, or a ReadAhead should stop */
+		boost::condition pending_condition;
+		/** signalled when a block becomes ready */
+		boost::condition ready_condition;
+		/** blocks that some ReadAhead wants, by index */
+		std::map<int64_t, std::weak_ptr<Block>> blocks;
+		/** blocks which have not yet been picked up by a thread, in the order that they should be read */
+		std::deque<std::pair<int64_t, std::weak_ptr<Block>>> pending;
+		int64_t fetched = 0;
+	};
+
+	void thread ();
+	std::shared_ptr<Block> wait_for_block (int64_t index);
+
+	std::shared_ptr<Source> _source;
+	/** number of blocks to have read from the current position onwards */
+	int64_t _window_blocks;
+	/** current position; only used by the caller's thread */
+	int64_t _position = 0;
+
+	std::vector<boost::thread> _threads;
+
+	/** blocks inside our window, by index; protected by _source->mutex */
+	std::map<int64_t, std::shared_ptr<Block>> _blocks;
+	/** protected by _source->mutex */
+	bool _stop = false;
+
+	static boost::mutex _sources_mutex;
+	/** Sources that are in use, so that new ReadAheads of the same files can find them */
+	static std::map<std::vector<boost::filesystem::path>, std::weak_ptr<Source>> _sources;
+};
+
+
+#endif
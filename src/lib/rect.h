@@ -126,6 +126,13 @@ bool operator== (Rect<T> const& a, Rect<T> const& b)
 }
 
 
+template <class T>
+bool operator!= (Rect<T> const& a, Rect<T> const& b)
+{
+	return !(a == b);
+}
+
+
 }
 
 
@@ -19,6 +19,7 @@
 */
 
 
+#include "asset_digest.h"
 #include "audio_buffers.h"
 #include "compose.hpp"
 #include "config.h"
@@ -27,10 +28,13 @@
 #include "digester.h"
 #include "film.h"
 #include "image.h"
-#include "image_png.h"
 #include "job.h"
 #include "log.h"
 #include "reel_writer.h"
+#include "subtitle_png_pool.h"
+#include "trace.h"
+#include "write_behind.h"
+#include "writer.h"
 #include <dcp/atmos_asset.h>
 #include <dcp/atmos_asset_writer.h>
 #include <dcp/certificate_chain.h>
@@ -54,6 +58,14 @@
 #include <dcp/sound_asset_writer.h>
 #include <dcp/stereo_picture_asset.h>
 #include <dcp/subtitle_image.h>
+#include <dcp/util.h>
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+LIBDCP_ENABLE_WARNINGS
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cstring>
 
 #include "i18n.h"
 
@@ -79,6 +91,10 @@ using namespace dcpomatic;
 
 
 int const ReelWriter::_info_size = 48;
+/* Number of frames to write between attempts to advance the commit mark */
+int const ReelWriter::_commit_interval = 24;
+/* Twice the writer's history, since 2D frames in a 3D DCP are written here as two frames */
+int const ReelWriter::_recently_written_size = 2 * Writer::repeat_history;
 
 
 static dcp::MXFMetadata
@@ -138,7 +154,9 @@ ReelWriter::ReelWriter (
 				job->sub (_("Copying old video file"));
 				copy_in_bits (asset, asset.string() + ".tmp", bind(&Job::set_progress, job.get(), _1, false));
 			} else {
-				boost::filesystem::copy_file (asset, asset.string() + ".tmp");
+				if (!clone_file(asset, asset.string() + ".tmp")) {
+					boost::filesystem::copy_file (asset, asset.string() + ".tmp");
+				}
 			}
 			boost::filesystem::remove (asset);
 			boost::filesystem::rename (asset.string() + ".tmp", asset);
@@ -172,6 +190,26 @@ ReelWriter::ReelWriter (
 	}
 
 	if (film()->audio_channels()) {
+		if (auto existing = checkpointed_sound_asset()) {
+			try {
+				_sound_asset = make_shared<dcp::SoundAsset>(*existing);
+				if (film()->encrypted()) {
+					_sound_asset->set_key (film()->key());
+				}
+				if (existing->filename() != audio_asset_filename(_sound_asset, _reel_index, _reel_count, _content_summary)) {
+					/* The asset would be given a different name now, so make it again */
+					_sound_asset.reset ();
+				} else {
+					LOG_GENERAL ("Re-using complete sound asset %1", existing->string());
+				}
+			} catch (std::exception& e) {
+				LOG_GENERAL ("Could not re-use sound asset %1 (%2)", existing->string(), e.what());
+				_sound_asset.reset ();
+			}
+		}
+	}
+
+	if (film()->audio_channels() && !_sound_asset) {
 		auto lang = film()->audio_language();
 		_sound_asset = make_shared<dcp::SoundAsset> (
 			dcp::Fraction(film()->video_frame_rate(), 1),
@@ -202,32 +240,74 @@ ReelWriter::ReelWriter (
 }
 
 
+/** Offsets of the parts of a dcp::FrameInfo in the info file, then the hash */
+static int const info_offset_position = 0;
+static int const info_size_position = 8;
+static int const info_hash_position = 16;
+static int const info_hash_length = 32;
+
+
+static dcp::FrameInfo
+unpack_frame_info (uint8_t const* record)
+{
+	dcp::FrameInfo info;
+	memcpy (&info.offset, record + info_offset_position, sizeof(info.offset));
+	memcpy (&info.size, record + info_size_position, sizeof(info.size));
+	info.hash = string(reinterpret_cast<char const*>(record + info_hash_position), info_hash_length);
+	return info;
+}
+
+
 /** @param frame reel-relative frame */
 void
 ReelWriter::write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const
 {
-	auto handle = film()->info_file_handle(_period, false);
-	handle->get().seek(frame_info_position(frame, eyes), SEEK_SET);
-	handle->get().checked_write(&info.offset, sizeof(info.offset));
-	handle->get().checked_write(&info.size, sizeof(info.size));
-	handle->get().checked_write(info.hash.c_str(), info.hash.size());
+	DCPOMATIC_ASSERT (info.hash.size() == static_cast<size_t>(info_hash_length));
+
+	/* Build the whole record so that it goes to the file in one write */
+	uint8_t record[_info_size];
+	memcpy (record + info_offset_position, &info.offset, sizeof(info.offset));
+	memcpy (record + info_size_position, &info.size, sizeof(info.size));
+	memcpy (record + info_hash_position, info.hash.c_str(), info_hash_length);
+
+	if (!_info_file) {
+		/* Keep the file open rather than opening and closing it (which is slow on network
+		   filesystems) for every frame.  Nobody else looks at it while we are writing
+		   except by opening it afresh, so there's no need for the film's info file lock.
+		*/
+		auto const path = film()->info_file(_period);
+		auto const exists = boost::filesystem::exists(path);
+		_info_file = make_shared<dcp::File>(path, exists ? "r+b" : "wb");
+		if (!*_info_file) {
+			_info_file.reset ();
+			throw OpenFileError (path, errno, exists ? OpenFileError::READ_WRITE : OpenFileError::WRITE);
+		}
+	}
+
+	_info_file->seek(frame_info_position(frame, eyes), SEEK_SET);
+	_info_file->checked_write(record, _info_size);
+	/* Make sure that anyone who opens the file sees this */
+	fflush (_info_file->get());
 }
 
 
 dcp::FrameInfo
 ReelWriter::read_frame_info (shared_ptr<InfoFileHandle> info, Frame frame, Eyes eyes) const
 {
-	dcp::FrameInfo frame_info;
+	uint8_t record[_info_size];
 	info->get().seek(frame_info_position(frame, eyes), SEEK_SET);
-	info->get().checked_read(&frame_info.offset, sizeof(frame_info.offset));
-	info->get().checked_read(&frame_info.size, sizeof(frame_info.size));
+	info->get().checked_read(record, _info_size);
+	return unpack_frame_info (record);
+}
 
-	char hash_buffer[33];
-	info->get().checked_read(hash_buffer, 32);
-	hash_buffer[32] = '\0';
-	frame_info.hash = hash_buffer;
 
-	return frame_info;
+/** @return Information about a frame which was in the info file when we started */
+dcp::FrameInfo
+ReelWriter::existing_frame_info (Frame frame, Eyes eyes) const
+{
+	auto const index = frame_info_position(frame, eyes) / _info_size;
+	DCPOMATIC_ASSERT (index < static_cast<long>(_existing_frame_info.size()));
+	return _existing_frame_info[index];
 }
 
 
@@ -267,18 +347,51 @@ ReelWriter::check_existing_picture_asset (boost::filesystem::path asset)
 		LOG_GENERAL ("Opened existing asset at %1", asset.string());
 	}
 
-	shared_ptr<InfoFileHandle> info_file;
-
+	/* Read the whole info file in one go */
 	try {
-		info_file = film()->info_file_handle (_period, true);
+		auto info_file = film()->info_file_handle (_period, true);
+		auto const size = boost::filesystem::file_size(info_file->get().path());
+		vector<uint8_t> records (size - size % _info_size);
+		info_file->get().checked_read(records.data(), records.size());
+		for (size_t i = 0; i < records.size(); i += _info_size) {
+			_existing_frame_info.push_back (unpack_frame_info(records.data() + i));
+		}
 	} catch (OpenFileError &) {
 		LOG_GENERAL_NC ("Could not open film info file");
 		return 0;
+	} catch (exception& e) {
+		LOG_GENERAL ("Could not read film info file (%1)", e.what());
+		_existing_frame_info.clear ();
+		return 0;
 	}
 
 	/* Offset of the last dcp::FrameInfo in the info file */
-	int const n = (boost::filesystem::file_size(info_file->get().path()) / _info_size) - 1;
-	LOG_GENERAL ("The last FI is %1; info file is %2, info size %3", n, boost::filesystem::file_size(info_file->get().path()), _info_size);
+	int const n = static_cast<int>(_existing_frame_info.size()) - 1;
+	LOG_GENERAL ("The last FI is %1; info size %2", n, _info_size);
+	if (n < 0) {
+		return 0;
+	}
+
+	/* Frames before the commit mark were known to be in the asset when we last wrote, so
+	   (once we have checked the last of them, in case the asset has been changed under our
+	   feet) we only need to look at the ones after it.
+	*/
+	Frame committed_frames = 0;
+	auto const mark = read_commit_mark ();
+	if (mark) {
+		committed_frames = film()->three_d() ? *mark / 2 : *mark;
+		if (committed_frames > 0 && !existing_picture_frame_ok(asset_file, committed_frames - 1)) {
+			LOG_GENERAL ("Last committed frame %1 is not OK; ignoring commit mark", committed_frames - 1);
+			committed_frames = 0;
+		} else {
+			LOG_GENERAL ("Trusting %1 committed frames", committed_frames);
+		}
+	}
+
+	if (committed_frames == 0) {
+		boost::system::error_code ec;
+		boost::filesystem::remove (commit_mark_file(), ec);
+	}
 
 	Frame first_nonexistent_frame;
 	if (film()->three_d()) {
@@ -288,7 +401,7 @@ ReelWriter::check_existing_picture_asset (boost::filesystem::path asset)
 		first_nonexistent_frame = n;
 	}
 
-	while (!existing_picture_frame_ok(asset_file, info_file, first_nonexistent_frame) && first_nonexistent_frame > 0) {
+	while (first_nonexistent_frame >= committed_frames && !existing_picture_frame_ok(asset_file, first_nonexistent_frame) && first_nonexistent_frame > 0) {
 		--first_nonexistent_frame;
 	}
 
@@ -301,10 +414,209 @@ ReelWriter::check_existing_picture_asset (boost::filesystem::path asset)
 
 	LOG_GENERAL ("Proceeding with first nonexistent frame %1", first_nonexistent_frame);
 
+	/* Whatever we keep is as good as committed */
+	_committed_records = first_nonexistent_frame * (film()->three_d() ? 2 : 1);
+
 	return first_nonexistent_frame;
 }
 
 
+/** @return File which records how many of the frames in our info file are known
+ *  to be in our picture asset.
+ */
+boost::filesystem::path
+ReelWriter::commit_mark_file () const
+{
+	return film()->info_file(_period).string() + ".committed";
+}
+
+
+/** Replace the commit mark file, in a way that means that it is always either all the old
+ *  mark or all the new one.
+ *  @param records Number of records at the start of the info file that are committed.
+ *  @param hash Hash from the last of those records.
+ */
+void
+ReelWriter::write_commit_mark (int64_t records, string hash) const
+{
+	DCPOMATIC_ASSERT (hash.size() == static_cast<size_t>(info_hash_length));
+
+	uint8_t mark[8 + info_hash_length];
+	memcpy (mark, &records, sizeof(records));
+	memcpy (mark + 8, hash.c_str(), info_hash_length);
+
+	auto const path = commit_mark_file ();
+	auto const tmp = path.string() + ".tmp";
+	{
+		dcp::File file(tmp, "wb");
+		if (!file) {
+			throw OpenFileError (tmp, errno, OpenFileError::WRITE);
+		}
+		file.checked_write(mark, sizeof(mark));
+	}
+	boost::filesystem::rename (tmp, path);
+}
+
+
+/** @return Number of records at the start of the info file that our commit mark says are committed,
+ *  or an empty optional if there is no mark, or it does not agree with the info file.
+ */
+optional<int64_t>
+ReelWriter::read_commit_mark () const
+{
+	auto const path = commit_mark_file ();
+	boost::system::error_code ec;
+	if (boost::filesystem::file_size(path, ec) != static_cast<uintmax_t>(8 + info_hash_length) || ec) {
+		return {};
+	}
+
+	dcp::File file(path, "rb");
+	if (!file) {
+		return {};
+	}
+
+	uint8_t mark[8 + info_hash_length];
+	if (file.read(mark, 1, sizeof(mark)) != sizeof(mark)) {
+		return {};
+	}
+
+	int64_t records;
+	memcpy (&records, mark, sizeof(records));
+	if (records <= 0 || records > static_cast<int64_t>(_existing_frame_info.size())) {
+		return {};
+	}
+
+	/* Check that the info file still has the record that we marked */
+	if (_existing_frame_info[records - 1].hash != string(reinterpret_cast<char const*>(mark + 8), info_hash_length)) {
+		return {};
+	}
+
+	return records;
+}
+
+
+/** @return File which records that the sound asset for this reel was finished and which
+ *  settings it was made with.
+ */
+boost::filesystem::path
+ReelWriter::sound_checkpoint_file () const
+{
+	return film()->info_file(_period).string() + ".sound";
+}
+
+
+/** @return A digest of everything that could change what goes into this reel's sound asset */
+string
+ReelWriter::sound_identifier () const
+{
+	Digester digester;
+	digester.add (film()->metadata(false)->write_to_string());
+	digester.add (_period.from.get());
+	digester.add (_period.to.get());
+	return digester.get ();
+}
+
+
+/** Record that our sound asset is finished, so that it can be used again if this encode is
+ *  interrupted and then restarted.  The record is replaced in one go, as with the commit mark.
+ */
+void
+ReelWriter::write_sound_checkpoint () const
+{
+	DCPOMATIC_ASSERT (_sound_asset);
+
+	auto const record = sound_identifier() + "\n" + audio_asset_filename(_sound_asset, _reel_index, _reel_count, _content_summary);
+
+	auto const path = sound_checkpoint_file ();
+	auto const tmp = path.string() + ".tmp";
+	{
+		dcp::File file(tmp, "wb");
+		if (!file) {
+			throw OpenFileError (tmp, errno, OpenFileError::WRITE);
+		}
+		file.checked_write(record.c_str(), record.length());
+	}
+	boost::filesystem::rename (tmp, path);
+}
+
+
+/** @return The path to a finished sound asset for this reel which was made with our current
+ *  settings, or an empty optional if there is none.
+ */
+optional<boost::filesystem::path>
+ReelWriter::checkpointed_sound_asset () const
+{
+	auto const path = sound_checkpoint_file ();
+	if (!boost::filesystem::exists(path)) {
+		return {};
+	}
+
+	vector<string> parts;
+	auto const record = dcp::file_to_string(path);
+	boost::algorithm::split (parts, record, boost::is_any_of("\n"));
+	if (parts.size() != 2 || parts[0] != sound_identifier()) {
+		return {};
+	}
+
+	auto const asset = film()->file(parts[1]);
+	if (!boost::filesystem::exists(asset)) {
+		return {};
+	}
+
+	return asset;
+}
+
+
+/** Note that a frame has been given to the picture asset writer, and move the commit mark
+ *  on every so often.
+ */
+void
+ReelWriter::note_written (Frame frame, Eyes eyes, dcp::FrameInfo const& info)
+{
+	_uncommitted.push_back ({frame_info_position(frame, eyes) / _info_size + 1, info.offset + info.size, info.hash});
+	if (_uncommitted.size() >= static_cast<size_t>(_commit_interval)) {
+		commit_written ();
+	}
+}
+
+
+/** Move the commit mark on past all the frames that have reached the picture asset file; the
+ *  asset writer buffers some data so these may not be all the frames that we have written.
+ */
+void
+ReelWriter::commit_written ()
+{
+	if (_uncommitted.empty() || !_picture_asset || !_picture_asset->file()) {
+		return;
+	}
+
+	boost::system::error_code ec;
+	auto const on_disk = boost::filesystem::file_size(_picture_asset->file().get(), ec);
+	if (ec) {
+		return;
+	}
+
+	optional<UncommittedFrame> last;
+	while (!_uncommitted.empty() && static_cast<uintmax_t>(_uncommitted.front().end) <= on_disk) {
+		last = _uncommitted.front();
+		_uncommitted.pop_front ();
+	}
+
+	/* The frames arrive in order so the records that we are committing follow on from the
+	   ones that were already committed.
+	*/
+	if (last && last->records > _committed_records) {
+		try {
+			write_commit_mark (last->records, last->hash);
+			_committed_records = last->records;
+		} catch (exception& e) {
+			/* This just means that a resume will take longer */
+			LOG_WARNING ("Could not write commit mark (%1)", e.what());
+		}
+	}
+}
+
+
 void
 ReelWriter::write (shared_ptr<const Data> encoded, Frame frame, Eyes eyes)
 {
@@ -315,7 +627,36 @@ ReelWriter::write (shared_ptr<const Data> encoded, Frame frame, Eyes eyes)
 
 	auto fin = _picture_asset_writer->write (encoded->data(), encoded->size());
 	write_frame_info (frame, eyes, fin);
-	_last_written[eyes] = encoded;
+	note_written (frame, eyes, fin);
+	picture_written (fin);
+
+	_recently_written.push_front ({frame, eyes, encoded});
+	while (_recently_written.size() > static_cast<size_t>(_recently_written_size)) {
+		_recently_written.pop_back ();
+	}
+}
+
+
+/** Called when some data has been given to the picture asset writer */
+void
+ReelWriter::picture_written (dcp::FrameInfo const& info)
+{
+	if (!_picture_started) {
+		/* The asset writer creates the file when it is given its first frame, so only now
+		   can we set things up on it.
+		*/
+		_picture_started = true;
+		auto const file = _picture_asset->file().get();
+		/* Reserve space for the whole asset so that it does not end up in lots of pieces */
+		_picture_preallocated = preallocate_file(file, static_cast<uint64_t>(film()->j2k_bandwidth() / 8) * _period.duration().seconds());
+		if (WriteBehind::wanted(file)) {
+			_picture_write_behind = make_shared<WriteBehind>(file);
+		}
+	}
+
+	if (_picture_write_behind) {
+		_picture_write_behind->written (info.offset + info.size);
+	}
 }
 
 
@@ -348,32 +689,105 @@ ReelWriter::fake_write (int size)
 
 
 void
-ReelWriter::repeat_write (Frame frame, Eyes eyes)
+ReelWriter::repeat_write (Frame frame, Eyes eyes, Frame source)
 {
 	if (!_picture_asset_writer) {
 		/* We're not writing any data */
 		return;
 	}
 
-	auto fin = _picture_asset_writer->write(_last_written[eyes]->data(), _last_written[eyes]->size());
+	auto i = std::find_if (_recently_written.begin(), _recently_written.end(), [source, eyes](WrittenFrame const& w) {
+		return w.frame == source && w.eyes == eyes;
+	});
+	DCPOMATIC_ASSERT (i != _recently_written.end());
+	_recently_written.splice (_recently_written.begin(), _recently_written, i);
+
+	auto data = _recently_written.front().data;
+	auto fin = _picture_asset_writer->write(data->data(), data->size());
 	write_frame_info (frame, eyes, fin);
+	note_written (frame, eyes, fin);
+	picture_written (fin);
+}
+
+
+/** Finish our sound asset, once all of the audio for this reel has been written, and
+ *  record that it is complete.  If the encode is then interrupted the asset will be
+ *  used again rather than being re-made.
+ */
+void
+ReelWriter::finish_sound ()
+{
+	if (!_sound_asset_writer) {
+		return;
+	}
+
+	if (!_sound_asset_writer->finalize()) {
+		/* Nothing was written to the sound asset */
+		_sound_asset.reset ();
+	}
+	_sound_asset_writer.reset ();
+
+	if (_sound_preallocated && _sound_asset) {
+		release_preallocation (film()->file(audio_asset_filename(_sound_asset, _reel_index, _reel_count, _content_summary)));
+	}
+	_sound_preallocated = false;
+
+	if (_sound_asset) {
+		try {
+			write_sound_checkpoint ();
+		} catch (std::exception& e) {
+			/* We can carry on without it */
+			LOG_WARNING ("Could not write sound checkpoint (%1)", e.what());
+		}
+	}
+}
+
+
+/** @return true if this reel's picture and sound assets are already complete, so nothing
+ *  need be given to us to write them.
+ */
+bool
+ReelWriter::complete () const
+{
+	return _picture_asset && !_picture_asset_writer && (!film()->audio_channels() || (_sound_asset && !_sound_asset_writer));
 }
 
 
 void
 ReelWriter::finish (boost::filesystem::path output_dcp)
 {
+	add_pending_subtitle_images ();
+
 	if (_picture_asset_writer && !_picture_asset_writer->finalize ()) {
 		/* Nothing was written to the picture asset */
 		LOG_GENERAL ("Nothing was written to reel %1 of %2", _reel_index, _reel_count);
 		_picture_asset.reset ();
 	}
 
+	if (_picture_preallocated && _picture_asset) {
+		release_preallocation (_picture_asset->file().get());
+	}
+
+	if (_picture_write_behind) {
+		/* Finishing the asset will have rewritten its header, so make sure that is on the disk too */
+		_picture_write_behind->flush ();
+		_picture_write_behind.reset ();
+	}
+
+	if (_picture_asset) {
+		/* Everything should now be in the asset */
+		commit_written ();
+	}
+
 	if (_sound_asset_writer && !_sound_asset_writer->finalize ()) {
 		/* Nothing was written to the sound asset */
 		_sound_asset.reset ();
 	}
 
+	if (_sound_preallocated && _sound_asset) {
+		release_preallocation (film()->file(audio_asset_filename(_sound_asset, _reel_index, _reel_count, _content_summary)));
+	}
+
 	/* Hard-link any video asset file into the DCP */
 	if (_picture_asset) {
 		DCPOMATIC_ASSERT (_picture_asset->file());
@@ -388,7 +802,7 @@ ReelWriter::finish (boost::filesystem::path output_dcp)
 
 		boost::filesystem::create_hard_link (video_from, video_to, ec);
 		if (ec) {
-			LOG_WARNING("Hard-link failed (%1); copying instead", error_details(ec));
+			LOG_WARNING("Hard-link failed (%1); cloning or copying instead", error_details(ec));
 			auto job = _job.lock ();
 			if (job) {
 				job->sub (_("Copying video file into DCP"));
@@ -398,7 +812,7 @@ ReelWriter::finish (boost::filesystem::path output_dcp)
 					LOG_ERROR ("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), e.what());
 					throw FileError (e.what(), video_from);
 				}
-			} else {
+			} else if (!clone_file(video_from, video_to)) {
 				boost::filesystem::copy_file (video_from, video_to, ec);
 				if (ec) {
 					LOG_ERROR("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), error_details(ec));
@@ -425,6 +839,7 @@ ReelWriter::finish (boost::filesystem::path output_dcp)
 		}
 
 		_sound_asset->set_file (audio_to);
+		boost::filesystem::remove (sound_checkpoint_file(), ec);
 	}
 
 	if (_atmos_asset) {
@@ -446,6 +861,24 @@ ReelWriter::finish (boost::filesystem::path output_dcp)
 }
 
 
+/** @return The asset files that finish() has put into the DCP */
+vector<boost::filesystem::path>
+ReelWriter::finished_files () const
+{
+	vector<boost::filesystem::path> files;
+	if (_picture_asset && _picture_asset->file()) {
+		files.push_back (*_picture_asset->file());
+	}
+	if (_sound_asset && _sound_asset->file()) {
+		files.push_back (*_sound_asset->file());
+	}
+	if (_atmos_asset && _atmos_asset->file()) {
+		files.push_back (*_atmos_asset->file());
+	}
+	return files;
+}
+
+
 /** Try to make a ReelAsset for a subtitles or closed captions in a given period in the DCP.
  *  A SubtitleAsset can be provided, or we will use one from @ref refs if not.
  */
@@ -786,16 +1219,18 @@ void
 ReelWriter::calculate_digests (std::function<void (float)> set_progress)
 try
 {
+	TraceSpan span("digest");
+
 	if (_picture_asset) {
-		_picture_asset->hash (set_progress);
+		_picture_asset->set_hash (asset_digest(_picture_asset->file().get(), set_progress));
 	}
 
 	if (_sound_asset) {
-		_sound_asset->hash (set_progress);
+		_sound_asset->set_hash (asset_digest(_sound_asset->file().get(), set_progress));
 	}
 
 	if (_atmos_asset) {
-		_atmos_asset->hash (set_progress);
+		_atmos_asset->set_hash (asset_digest(_atmos_asset->file().get(), set_progress));
 	}
 } catch (boost::thread_interrupted) {
 	/* set_progress contains an interruption_point, so any of these methods
@@ -820,6 +1255,15 @@ ReelWriter::write (shared_ptr<const AudioBuffers> audio)
 
 	DCPOMATIC_ASSERT (audio);
 	_sound_asset_writer->write (audio->data(), audio->frames());
+
+	if (!_sound_started) {
+		/* Now that the writer has created the file, reserve space for the whole asset */
+		_sound_started = true;
+		_sound_preallocated = preallocate_file(
+			film()->file(audio_asset_filename(_sound_asset, _reel_index, _reel_count, _content_summary)),
+			static_cast<uint64_t>(film()->audio_channels() * film()->audio_frame_rate() * 3) * _period.duration().seconds()
+			);
+	}
 }
 
 
@@ -935,29 +1379,77 @@ ReelWriter::write (PlayerText subs, TextType type, optional<DCPTextTrack> track,
 		asset->add(sub);
 	}
 
+	auto const in = dcp::Time(period.from.seconds() - _period.from.seconds(), tcr);
+	auto const out = dcp::Time(period.to.seconds() - _period.from.seconds(), tcr);
+
+	vector<SubtitlePNGPool::Request> requests;
 	for (auto i: subs.bitmap) {
-		asset->add (
+		auto const digest = SubtitlePNGPool::digest(i.image);
+		auto const x = static_cast<float>(i.rectangle.x);
+		auto const y = static_cast<float>(i.rectangle.y);
+
+		/* Sources often repeat the same image straight after itself (PGS, for example, re-sends
+		 * pictures that have not changed) so if this one just carries on from an identical one
+		 * we can make that last longer instead of adding another copy.
+		 */
+		auto previous = std::find_if(_pending_subtitle_images.rbegin(), _pending_subtitle_images.rend(), [&](PendingSubtitleImage const& pending) {
+			return pending.out == in && pending.asset == asset && pending.digest == digest && pending.x == x && pending.y == y;
+		});
+		if (previous != _pending_subtitle_images.rend()) {
+			previous->out = out;
+			continue;
+		}
+
+		_pending_subtitle_images.push_back({
+			asset,
+			digest,
+			{},
+			in,
+			out,
+			x,
+			y
+		});
+		requests.push_back({i.image, digest});
+	}
+
+	/* Give the pool all of this text's images together so that they are compressed side-by-side */
+	auto pngs = SubtitlePNGPool::instance()->encode(requests);
+	auto png = pngs.rbegin();
+	for (auto pending = _pending_subtitle_images.rbegin(); png != pngs.rend(); ++pending, ++png) {
+		pending->png = *png;
+	}
+}
+
+
+/** Add bitmap subtitles whose PNGs we have been waiting for to their assets */
+void
+ReelWriter::add_pending_subtitle_images ()
+{
+	for (auto const& i: _pending_subtitle_images) {
+		i.asset->add (
 			make_shared<dcp::SubtitleImage>(
-				image_as_png(i.image),
-				dcp::Time(period.from.seconds() - _period.from.seconds(), tcr),
-				dcp::Time(period.to.seconds() - _period.from.seconds(), tcr),
-				i.rectangle.x, dcp::HAlign::LEFT, i.rectangle.y, dcp::VAlign::TOP, 0,
+				i.png.get(),
+				i.in,
+				i.out,
+				i.x, dcp::HAlign::LEFT, i.y, dcp::VAlign::TOP, 0,
 				dcp::Time(), dcp::Time()
 				)
 			);
 	}
+
+	_pending_subtitle_images.clear ();
 }
 
 
 bool
-ReelWriter::existing_picture_frame_ok (dcp::File& asset_file, shared_ptr<InfoFileHandle> info_file, Frame frame) const
+ReelWriter::existing_picture_frame_ok (dcp::File& asset_file, Frame frame) const
 {
 	LOG_GENERAL ("Checking existing picture frame %1", frame);
 
-	/* Read the data from the info file; for 3D we just check the left
+	/* Get the data from the info file; for 3D we just check the left
 	   frames until we find a good one.
 	*/
-	auto const info = read_frame_info (info_file, frame, film()->three_d() ? Eyes::LEFT : Eyes::BOTH);
+	auto const info = existing_frame_info (frame, film()->three_d() ? Eyes::LEFT : Eyes::BOTH);
 
 	bool ok = true;
 
@@ -22,21 +22,28 @@
 #include "atmos_metadata.h"
 #include "dcp_text_track.h"
 #include "dcpomatic_time.h"
-#include "enum_indexed_vector.h"
 #include "font_id_map.h"
 #include "player_text.h"
 #include "referenced_reel_asset.h"
 #include "types.h"
 #include "weak_film.h"
+#include <dcp/array_data.h>
 #include <dcp/atmos_asset_writer.h>
+#include <dcp/dcp_time.h>
 #include <dcp/file.h>
 #include <dcp/picture_asset_writer.h>
+#include <deque>
+#include <future>
+#include <list>
 
 
 class AudioBuffers;
 class Film;
 class InfoFileHandle;
 class Job;
+class WriteBehind;
+struct commit_mark_test;
+struct sound_checkpoint_test;
 struct write_frame_info_test;
 
 namespace dcp {
@@ -70,12 +77,14 @@ public:
 
 	void write (std::shared_ptr<const dcp::Data> encoded, Frame frame, Eyes eyes);
 	void fake_write (int size);
-	void repeat_write (Frame frame, Eyes eyes);
+	void repeat_write (Frame frame, Eyes eyes, Frame source);
 	void write (std::shared_ptr<const AudioBuffers> audio);
 	void write (PlayerText text, TextType type, boost::optional<DCPTextTrack> track, dcpomatic::DCPTimePeriod period, FontIdMap const& fonts);
 	void write (std::shared_ptr<const dcp::AtmosFrame> atmos, AtmosMetadata metadata);
 
+	void finish_sound ();
 	void finish (boost::filesystem::path output_dcp);
+	std::vector<boost::filesystem::path> finished_files () const;
 	std::shared_ptr<dcp::Reel> create_reel (
 		std::list<ReferencedReelAsset> const & refs,
 		FontIdMap const & fonts,
@@ -96,16 +105,31 @@ public:
 		return _first_nonexistent_frame;
 	}
 
+	bool complete () const;
+
 	dcp::FrameInfo read_frame_info (std::shared_ptr<InfoFileHandle> info, Frame frame, Eyes eyes) const;
+	dcp::FrameInfo existing_frame_info (Frame frame, Eyes eyes) const;
 
 private:
 
+	friend struct ::commit_mark_test;
+	friend struct ::sound_checkpoint_test;
 	friend struct ::write_frame_info_test;
 
 	void write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const;
+	void note_written (Frame frame, Eyes eyes, dcp::FrameInfo const& info);
+	void picture_written (dcp::FrameInfo const& info);
+	void commit_written ();
+	boost::filesystem::path commit_mark_file () const;
+	void write_commit_mark (int64_t records, std::string hash) const;
+	boost::optional<int64_t> read_commit_mark () const;
+	boost::filesystem::path sound_checkpoint_file () const;
+	std::string sound_identifier () const;
+	void write_sound_checkpoint () const;
+	boost::optional<boost::filesystem::path> checkpointed_sound_asset () const;
 	long frame_info_position (Frame frame, Eyes eyes) const;
 	Frame check_existing_picture_asset (boost::filesystem::path asset);
-	bool existing_picture_frame_ok (dcp::File& asset_file, std::shared_ptr<InfoFileHandle> info_file, Frame frame) const;
+	bool existing_picture_frame_ok (dcp::File& asset_file, Frame frame) const;
 	std::shared_ptr<dcp::SubtitleAsset> empty_text_asset (TextType type, boost::optional<DCPTextTrack> track, bool with_dummy) const;
 
 	std::shared_ptr<dcp::ReelPictureAsset> create_reel_picture (std::shared_ptr<dcp::Reel> reel, std::list<ReferencedReelAsset> const & refs) const;
@@ -121,12 +145,21 @@ private:
 		std::set<DCPTextTrack> ensure_closed_captions
 		) const;
 	void create_reel_markers (std::shared_ptr<dcp::Reel> reel) const;
+	void add_pending_subtitle_images ();
 
 	dcpomatic::DCPTimePeriod _period;
 	/** the first picture frame index that does not already exist in our MXF */
 	int _first_nonexistent_frame;
-	/** the data of the last written frame, if there is one */
-	EnumIndexedVector<std::shared_ptr<const dcp::Data>, Eyes> _last_written;
+	struct WrittenFrame
+	{
+		Frame frame;
+		Eyes eyes;
+		std::shared_ptr<const dcp::Data> data;
+	};
+
+	/** Recently-written frames, most recently used first */
+	std::list<WrittenFrame> _recently_written;
+	static int const _recently_written_size;
 	/** index of this reel within the DCP (starting from 0) */
 	int _reel_index;
 	/** number of reels in the DCP */
@@ -140,12 +173,57 @@ private:
 	std::shared_ptr<dcp::PictureAsset> _picture_asset;
 	/** picture asset writer, or 0 if we are not writing any picture because we already have one */
 	std::shared_ptr<dcp::PictureAssetWriter> _picture_asset_writer;
+	/** true once the picture asset writer has been given some data */
+	bool _picture_started = false;
+	/** true if we reserved disk space for the picture asset */
+	bool _picture_preallocated = false;
+	/** pushes the picture asset out to disk as it is written, if Config asks for that */
+	std::shared_ptr<WriteBehind> _picture_write_behind;
 	std::shared_ptr<dcp::SoundAsset> _sound_asset;
 	std::shared_ptr<dcp::SoundAssetWriter> _sound_asset_writer;
+	/** true once the sound asset writer has been given some data */
+	bool _sound_started = false;
+	/** true if we reserved disk space for the sound asset */
+	bool _sound_preallocated = false;
 	std::shared_ptr<dcp::SubtitleAsset> _subtitle_asset;
 	std::map<DCPTextTrack, std::shared_ptr<dcp::SubtitleAsset>> _closed_caption_assets;
+	struct PendingSubtitleImage
+	{
+		std::shared_ptr<dcp::SubtitleAsset> asset;
+		/** digest of the image */
+		std::string digest;
+		/** PNG that is being made on the SubtitlePNGPool */
+		std::shared_future<dcp::ArrayData> png;
+		dcp::Time in;
+		dcp::Time out;
+		float x;
+		float y;
+	};
+	/** Bitmap subtitles that we will add to their assets once their PNGs are ready */
+	std::list<PendingSubtitleImage> _pending_subtitle_images;
 	std::shared_ptr<dcp::AtmosAsset> _atmos_asset;
 	std::shared_ptr<dcp::AtmosAssetWriter> _atmos_asset_writer;
 
+	/** Everything that was in our info file when we started, read in one go so that checking
+	 *  and fake-writing existing frames does not need to go back to the file for each one.
+	 */
+	std::vector<dcp::FrameInfo> _existing_frame_info;
+	/** Info file, kept open for writing once we have written to it */
+	mutable std::shared_ptr<dcp::File> _info_file;
+
+	/** Number of records at the start of the info file whose frames we know are in the picture asset */
+	int64_t _committed_records = 0;
+	struct UncommittedFrame
+	{
+		/** number of records in the info file up to and including this frame's */
+		int64_t records;
+		/** position in the picture asset of the end of this frame */
+		int64_t end;
+		std::string hash;
+	};
+	/** Frames that we have given to the picture asset writer which have not yet been committed, oldest first */
+	std::deque<UncommittedFrame> _uncommitted;
+
 	static int const _info_size;
+	static int const _commit_interval;
 };
@@ -0,0 +1,73 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ffmpeg_content.h"
+#include "ffmpeg_examination.h"
+#include "ffmpeg_examiner.h"
+#include "refine_ffmpeg_examination_job.h"
+
+#include "i18n.h"
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+
+
+RefineFFmpegExaminationJob::RefineFFmpegExaminationJob (shared_ptr<const Film> film, shared_ptr<FFmpegContent> content)
+	: Job (film)
+	, _content (content)
+{
+
+}
+
+
+RefineFFmpegExaminationJob::~RefineFFmpegExaminationJob ()
+{
+	stop_thread ();
+}
+
+
+string
+RefineFFmpegExaminationJob::name () const
+{
+	return _("Indexing content");
+}
+
+
+string
+RefineFFmpegExaminationJob::json_name () const
+{
+	return N_("refine_examination");
+}
+
+
+void
+RefineFFmpegExaminationJob::run ()
+{
+	auto examination = make_shared<FFmpegExamination>(FFmpegExaminer(_content, shared_from_this()));
+	/* Replace the quick examination, so that nobody else makes do with it */
+	FFmpegExamination::add_to_cache (_content->digest(), examination);
+	_content->take_exact_examination (_film, examination);
+
+	set_progress (1);
+	set_state (FINISHED_OK);
+}
@@ -35,6 +35,7 @@ LIBDCP_DISABLE_WARNINGS
 LIBDCP_ENABLE_WARNINGS
 #include <pango/pangocairo.h>
 #include <boost/algorithm/string.hpp>
+#include <functional>
 #include <iostream>
 
 
@@ -51,23 +52,6 @@ using std::string;
 using namespace dcpomatic;
 
 
-/** Create a Pango layout using a dummy context which we can use to calculate the size
- *  of the text we will render.  Then we can transfer the layout over to the real context
- *  for the actual render.
- */
-static Glib::RefPtr<Pango::Layout>
-create_layout()
-{
-	auto c_font_map = pango_cairo_font_map_new ();
-	DCPOMATIC_ASSERT (c_font_map);
-	auto font_map = Glib::wrap (c_font_map);
-	auto c_context = pango_font_map_create_context (c_font_map);
-	DCPOMATIC_ASSERT (c_context);
-	auto context = Glib::wrap (c_context);
-	return Pango::Layout::create (context);
-}
-
-
 static void
 setup_layout (Glib::RefPtr<Pango::Layout> layout, string font_name, string markup)
 {
@@ -78,6 +62,82 @@ setup_layout (Glib::RefPtr<Pango::Layout> layout, string font_name, string marku
 }
 
 
+namespace {
+
+/** Layouts which have been set up for some markup in some font, with the font map that they
+ *  came from.  Making a font map means loading fonts, and setting up a layout means shaping
+ *  its text, and both are slow, so we keep them for the next time the same text is rendered.
+ *  Pango objects must not be used by more than one thread, so there is one of these for
+ *  each thread that renders text.
+ */
+class LayoutCache
+{
+public:
+	struct Entry
+	{
+		string font_name;
+		string markup;
+		/** layout with its own context, which we can use to calculate the size of the text
+		 *  and then transfer over to the real context for the actual render.
+		 */
+		Glib::RefPtr<Pango::Layout> layout;
+		/** ink extents of the layout before it was transferred to any real context */
+		Pango::Rectangle ink;
+	};
+
+	/** @return a layout of `markup' in `font_name'; it is only valid until the next call */
+	Entry& get (string const& font_name, string const& markup)
+	{
+		auto const generation = FontConfig::instance()->generation();
+		if (!_font_map || generation != _generation) {
+			/* The font map will not see fonts that have been added to fontconfig since it was made */
+			_entries.clear ();
+			auto c_font_map = pango_cairo_font_map_new ();
+			DCPOMATIC_ASSERT (c_font_map);
+			_font_map = Glib::wrap (c_font_map);
+			_generation = generation;
+		}
+
+		for (auto i = _entries.begin(); i != _entries.end(); ++i) {
+			if (i->font_name == font_name && i->markup == markup) {
+				_entries.splice (_entries.begin(), _entries, i);
+				return _entries.front();
+			}
+		}
+
+		auto c_context = pango_font_map_create_context (_font_map->gobj());
+		DCPOMATIC_ASSERT (c_context);
+		auto layout = Pango::Layout::create (Glib::wrap(c_context));
+		setup_layout (layout, font_name, markup);
+		_entries.push_front ({font_name, markup, layout, layout->get_ink_extents()});
+		if (static_cast<int>(_entries.size()) > _max_entries) {
+			_entries.pop_back ();
+		}
+
+		return _entries.front();
+	}
+
+private:
+	Glib::RefPtr<Pango::FontMap> _font_map;
+	/** FontConfig::generation() when _font_map was made */
+	int _generation = 0;
+	/** most recently used first */
+	list<Entry> _entries;
+	static int constexpr _max_entries = 32;
+};
+
+}
+
+
+/** @return a layout from this thread's cache, which is only valid until the next call */
+static LayoutCache::Entry&
+cached_layout (string const& font_name, string const& markup)
+{
+	thread_local LayoutCache cache;
+	return cache.get (font_name, markup);
+}
+
+
 string
 marked_up (list<StringText> subtitles, int target_height, float fade_factor, string font_name)
 {
@@ -116,11 +176,9 @@ marked_up (list<StringText> subtitles, int target_height, float fade_factor, str
 			 * be written with letter_spacing either side.  This means that to get a horizontal space x we
 			 * need to write a " " with letter spacing (x - s) / 2, where s is the width of the " ".
 			 */
-			auto layout = create_layout();
-			setup_layout(layout, font_name, make_span(i, " ", {}));
 			int space_width;
 			int dummy;
-			layout->get_pixel_size(space_width, dummy);
+			cached_layout(font_name, make_span(i, " ", {})).layout->get_pixel_size(space_width, dummy);
 			auto spacing = ((i.space_before() * i.size_in_pixels(target_height) - space_width) / 2) * pixels_to_1024ths_point;
 			out += make_span(i, " ", "letter_spacing=\"" + dcp::raw_convert<string>(spacing) + "\"");
 		}
@@ -286,11 +344,29 @@ y_position (StringText const& first, int target_height, int baseline_to_bottom,
 }
 
 
+/** Where and how a line of text will be drawn */
+struct LineGeometry
+{
+	Glib::RefPtr<Pango::Layout> layout;
+	float fade_factor;
+	float x_scale;
+	float y_scale;
+	double border_width;
+	/** size of the image that the line will be drawn into */
+	dcp::Size size;
+	/** position of the layout within the image */
+	int x_offset;
+	int y_offset;
+	/** position of the image within the target */
+	Position<int> position;
+};
+
+
 /** @param subtitles A list of subtitles that are all on the same line,
  *  at the same time and with the same fade in/out.
  */
-static PositionImage
-render_line (list<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+static LineGeometry
+line_geometry (list<StringText> const& subtitles, dcp::Size target, DCPTime time, int frame_rate)
 {
 	/* XXX: this method can only handle italic / bold changes mid-line,
 	   nothing else yet.
@@ -302,9 +378,8 @@ render_line (list<StringText> subtitles, dcp::Size target, DCPTime time, int fra
 	auto const font_name = setup_font (first);
 	auto const fade_factor = calculate_fade_factor (first, time, frame_rate);
 	auto const markup = marked_up (subtitles, target.height, fade_factor, font_name);
-	auto layout = create_layout ();
-	setup_layout (layout, font_name, markup);
-	auto ink = layout->get_ink_extents();
+	auto& cached = cached_layout (font_name, markup);
+	auto const ink = cached.ink;
 	dcp::Size size{ink.get_width() / Pango::SCALE, ink.get_height() / Pango::SCALE};
 
 	/* Calculate x and y scale factors.  These are only used to stretch
@@ -333,12 +408,33 @@ render_line (list<StringText> subtitles, dcp::Size target, DCPTime time, int fra
 	int const x_offset = (-ink.get_x() / Pango::SCALE) + ceil(border_width);
 	int const y_offset = -ink.get_y() / Pango::SCALE + ceil(border_width);
 
-	auto image = create_image (size);
+	int const x = x_position (first, target.width, size.width);
+	int const y = y_position (first, target.height, ink.get_y() / Pango::SCALE, size.height);
+
+	return { cached.layout, fade_factor, x_scale, y_scale, border_width, size, x_offset, y_offset, Position<int>(max(0, x), max(0, y)) };
+}
+
+
+/** @param subtitles A list of subtitles that are all on the same line,
+ *  at the same time and with the same fade in/out.
+ */
+static PositionImage
+render_line (list<StringText> const& subtitles, dcp::Size target, DCPTime time, int frame_rate)
+{
+	auto const& first = subtitles.front ();
+	auto const geometry = line_geometry (subtitles, target, time, frame_rate);
+	auto layout = geometry.layout;
+	auto const fade_factor = geometry.fade_factor;
+	auto const border_width = geometry.border_width;
+	auto const x_offset = geometry.x_offset;
+	auto const y_offset = geometry.y_offset;
+
+	auto image = create_image (geometry.size);
 	auto surface = create_surface (image);
 	auto context = Cairo::Context::create (surface);
 
 	context->set_line_width (1);
-	context->scale (x_scale, y_scale);
+	context->scale (geometry.x_scale, geometry.y_scale);
 	layout->update_from_cairo_context (context);
 
 	if (first.effect() == dcp::Effect::SHADOW) {
@@ -372,33 +468,55 @@ render_line (list<StringText> subtitles, dcp::Size target, DCPTime time, int fra
 	layout->add_to_cairo_context (context);
 	context->stroke ();
 
-	int const x = x_position (first, target.width, size.width);
-	int const y = y_position (first, target.height, ink.get_y() / Pango::SCALE, size.height);
-	return PositionImage (image, Position<int>(max (0, x), max(0, y)));
+	return PositionImage (image, geometry.position);
 }
 
 
-/** @param time Time of the frame that these subtitles are going on.
- *  @param target Size of the container that this subtitle will end up in.
- *  @param frame_rate DCP frame rate.
- */
-list<PositionImage>
-render_text (list<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+/** Call a handler with each group of subtitles that are on the same line */
+static void
+for_each_line (list<StringText> const& subtitles, std::function<void (list<StringText> const&)> handler)
 {
 	list<StringText> pending;
-	list<PositionImage> images;
 
 	for (auto const& i: subtitles) {
 		if (!pending.empty() && (i.v_align() != pending.back().v_align() || fabs(i.v_position() - pending.back().v_position()) > 1e-4)) {
-			images.push_back(render_line(pending, target, time, frame_rate));
+			handler (pending);
 			pending.clear ();
 		}
 		pending.push_back (i);
 	}
 
 	if (!pending.empty()) {
-		images.push_back(render_line(pending, target, time, frame_rate));
+		handler (pending);
 	}
+}
 
+
+/** @param time Time of the frame that these subtitles are going on.
+ *  @param target Size of the container that this subtitle will end up in.
+ *  @param frame_rate DCP frame rate.
+ */
+list<PositionImage>
+render_text (list<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+{
+	list<PositionImage> images;
+	for_each_line (subtitles, [&images, target, time, frame_rate](list<StringText> const& line) {
+		images.push_back(render_line(line, target, time, frame_rate));
+	});
 	return images;
 }
+
+
+/** @return the areas of the images that render_text() would make for some subtitles, found
+ *  by laying the text out without drawing it.  Parameters are as for render_text().
+ */
+list<dcpomatic::Rect<int>>
+bounding_boxes (list<StringText> subtitles, dcp::Size target, DCPTime time, int frame_rate)
+{
+	list<dcpomatic::Rect<int>> boxes;
+	for_each_line (subtitles, [&boxes, target, time, frame_rate](list<StringText> const& line) {
+		auto const geometry = line_geometry(line, target, time, frame_rate);
+		boxes.push_back({geometry.position, geometry.size.width, geometry.size.height});
+	});
+	return boxes;
+}
@@ -20,6 +20,7 @@
 
 #include "position_image.h"
 #include "dcpomatic_time.h"
+#include "rect.h"
 #include "string_text.h"
 #include <dcp/util.h>
 
@@ -29,3 +30,4 @@ namespace dcpomatic {
 
 std::string marked_up (std::list<StringText> subtitles, int target_height, float fade_factor, std::string font_name);
 std::list<PositionImage> render_text (std::list<StringText>, dcp::Size, dcpomatic::DCPTime, int);
+std::list<dcpomatic::Rect<int>> bounding_boxes (std::list<StringText> subtitles, dcp::Size target, dcpomatic::DCPTime time, int frame_rate);
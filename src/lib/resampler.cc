@@ -24,6 +24,9 @@
 #include "exceptions.h"
 #include "compose.hpp"
 #include "dcpomatic_assert.h"
+#include "util.h"
+#include <boost/thread/condition.hpp>
+#include <algorithm>
 #include <samplerate.h>
 #include <iostream>
 #include <cmath>
@@ -37,6 +40,11 @@ using std::make_shared;
 using std::pair;
 using std::runtime_error;
 using std::shared_ptr;
+using std::vector;
+
+
+/** Largest number of groups that we split a stream's channels into */
+static int const max_groups = 4;
 
 
 /** @param in Input sampling rate (Hz)
@@ -48,43 +56,157 @@ Resampler::Resampler (int in, int out, int channels)
 	, _out_rate (out)
 	, _channels (channels)
 {
-	int error;
-	_src = src_new (SRC_SINC_BEST_QUALITY, _channels, &error);
-	if (!_src) {
-		throw runtime_error (String::compose(N_("could not create sample-rate converter (%1)"), error));
+	/* Best-quality conversion is expensive enough that it's worth doing groups of
+	   (at least two) channels on separate threads.
+	*/
+	auto const groups = std::max(1, std::min({max_groups, static_cast<int>(boost::thread::hardware_concurrency()), (channels + 1) / 2}));
+	make_groups (SRC_SINC_BEST_QUALITY, groups);
+
+	if (groups > 1) {
+		_work = make_shared<boost::asio::io_service::work>(_service);
+		for (int i = 1; i < groups; ++i) {
+			_pool.create_thread ([this]() {
+				start_of_thread ("Resampler");
+				_service.run ();
+			});
+		}
 	}
 }
 
 
 Resampler::~Resampler ()
 {
-	if (_src) {
-		src_delete (_src);
+	boost::this_thread::disable_interruption dis;
+
+	_work.reset ();
+	_service.stop ();
+
+	try {
+		_pool.join_all ();
+	} catch (...) {}
+
+	delete_groups ();
+}
+
+
+void
+Resampler::make_groups (int converter, int groups)
+{
+	delete_groups ();
+
+	int first_channel = 0;
+	for (int i = 0; i < groups; ++i) {
+		Group group;
+		group.first_channel = first_channel;
+		group.channels = (_channels - first_channel) / (groups - i);
+		first_channel += group.channels;
+
+		int error;
+		group.src = src_new (converter, group.channels, &error);
+		if (!group.src) {
+			throw runtime_error (String::compose(N_("could not create sample-rate converter (%1)"), error));
+		}
+		_groups.push_back (group);
+	}
+}
+
+
+void
+Resampler::delete_groups ()
+{
+	for (auto const& i: _groups) {
+		src_delete (i.src);
 	}
+	_groups.clear ();
 }
 
 
 void
 Resampler::set_fast ()
 {
-	src_delete (_src);
-	_src = nullptr;
+	/* Linear conversion is cheap, so there's no point in using threads */
+	make_groups (SRC_LINEAR, 1);
+}
+
 
-	int error;
-	_src = src_new (SRC_LINEAR, _channels, &error);
-	if (!_src) {
-		throw runtime_error (String::compose(N_("could not create sample-rate converter (%1)"), error));
+/** Call process for each of our groups, using our threads for all but the first,
+ *  and put the results together.
+ */
+shared_ptr<const AudioBuffers>
+Resampler::run_groups (std::function<shared_ptr<AudioBuffers> (Group const&)> process)
+{
+	if (_groups.size() == 1) {
+		return process (_groups.front());
 	}
+
+	vector<shared_ptr<AudioBuffers>> outputs (_groups.size());
+	vector<std::exception_ptr> errors (_groups.size());
+
+	boost::mutex mutex;
+	boost::condition condition;
+	size_t remaining = _groups.size() - 1;
+
+	for (size_t i = 1; i < _groups.size(); ++i) {
+		_service.post ([this, i, &process, &outputs, &errors, &mutex, &condition, &remaining]() {
+			try {
+				outputs[i] = process (_groups[i]);
+			} catch (...) {
+				errors[i] = std::current_exception ();
+			}
+			boost::mutex::scoped_lock lm (mutex);
+			--remaining;
+			condition.notify_all ();
+		});
+	}
+
+	try {
+		outputs[0] = process (_groups[0]);
+	} catch (...) {
+		errors[0] = std::current_exception ();
+	}
+
+	{
+		boost::mutex::scoped_lock lm (mutex);
+		while (remaining > 0) {
+			condition.wait (lm);
+		}
+	}
+
+	for (auto const& i: errors) {
+		if (i) {
+			std::rethrow_exception (i);
+		}
+	}
+
+	/* Every group is given the same input at the same ratio, so they should all give the same number of frames */
+	auto const frames = outputs[0]->frames();
+	auto out = make_shared<AudioBuffers>(_channels, frames);
+	for (size_t i = 0; i < _groups.size(); ++i) {
+		DCPOMATIC_ASSERT (outputs[i]->frames() == frames);
+		for (int j = 0; j < _groups[i].channels; ++j) {
+			out->copy_channel_from (outputs[i].get(), j, _groups[i].first_channel + j);
+		}
+	}
+
+	return out;
 }
 
 
 shared_ptr<const AudioBuffers>
 Resampler::run (shared_ptr<const AudioBuffers> in)
+{
+	return run_groups ([this, in](Group const& group) { return run_group(group, in); });
+}
+
+
+shared_ptr<AudioBuffers>
+Resampler::run_group (Group const& group, shared_ptr<const AudioBuffers> in) const
 {
 	int in_frames = in->frames ();
 	int in_offset = 0;
 	int out_offset = 0;
-	auto resampled = make_shared<AudioBuffers>(_channels, 0);
+	auto const channels = group.channels;
+	auto resampled = make_shared<AudioBuffers>(channels, 0);
 
 	while (in_frames > 0) {
 
@@ -92,14 +214,14 @@ Resampler::run (shared_ptr<const AudioBuffers> in)
 		int const max_resampled_frames = ceil (static_cast<double>(in_frames) * _out_rate / _in_rate) + 32;
 
 		SRC_DATA data;
-		std::vector<float> in_buffer(in_frames * _channels);
-		std::vector<float> out_buffer(max_resampled_frames * _channels);
+		std::vector<float> in_buffer(in_frames * channels);
+		std::vector<float> out_buffer(max_resampled_frames * channels);
 
 		{
-			auto p = in->data ();
+			auto p = in->data () + group.first_channel;
 			auto q = in_buffer.data();
 			for (int i = 0; i < in_frames; ++i) {
-				for (int j = 0; j < _channels; ++j) {
+				for (int j = 0; j < channels; ++j) {
 					*q++ = p[j][in_offset + i];
 				}
 			}
@@ -114,7 +236,7 @@ Resampler::run (shared_ptr<const AudioBuffers> in)
 		data.end_of_input = 0;
 		data.src_ratio = double (_out_rate) / _in_rate;
 
-		int const r = src_process (_src, &data);
+		int const r = src_process (group.src, &data);
 		if (r) {
 			throw EncodeError (
 				String::compose (
@@ -122,7 +244,7 @@ Resampler::run (shared_ptr<const AudioBuffers> in)
 					src_strerror (r),
 					in_frames,
 					max_resampled_frames,
-					_channels
+					channels
 					)
 				);
 		}
@@ -137,7 +259,7 @@ Resampler::run (shared_ptr<const AudioBuffers> in)
 			auto p = data.data_out;
 			auto q = resampled->data ();
 			for (int i = 0; i < data.output_frames_gen; ++i) {
-				for (int j = 0; j < _channels; ++j) {
+				for (int j = 0; j < channels; ++j) {
 					q[j][out_offset + i] = *p++;
 				}
 			}
@@ -155,7 +277,14 @@ Resampler::run (shared_ptr<const AudioBuffers> in)
 shared_ptr<const AudioBuffers>
 Resampler::flush ()
 {
-	auto out = make_shared<AudioBuffers>(_channels, 0);
+	return run_groups ([this](Group const& group) { return flush_group(group); });
+}
+
+
+shared_ptr<AudioBuffers>
+Resampler::flush_group (Group const& group) const
+{
+	auto out = make_shared<AudioBuffers>(group.channels, 0);
 	int out_offset = 0;
 	int64_t const output_size = 65536;
 
@@ -166,11 +295,11 @@ Resampler::flush ()
 	data.data_in = dummy;
 	data.input_frames = 0;
 	data.data_out = buffer.data();
-	data.output_frames = output_size;
+	data.output_frames = output_size / group.channels;
 	data.end_of_input = 1;
 	data.src_ratio = double (_out_rate) / _in_rate;
 
-	int const r = src_process (_src, &data);
+	int const r = src_process (group.src, &data);
 	if (r) {
 		throw EncodeError (String::compose(N_("could not run sample-rate converter (%1)"), src_strerror(r)));
 	}
@@ -180,7 +309,7 @@ Resampler::flush ()
 	auto p = data.data_out;
 	auto q = out->data ();
 	for (int i = 0; i < data.output_frames_gen; ++i) {
-		for (int j = 0; j < _channels; ++j) {
+		for (int j = 0; j < group.channels; ++j) {
 			q[j][out_offset + i] = *p++;
 		}
 	}
@@ -194,6 +323,7 @@ Resampler::flush ()
 void
 Resampler::reset ()
 {
-	src_reset (_src);
+	for (auto const& i: _groups) {
+		src_reset (i.src);
+	}
 }
-
@@ -20,12 +20,22 @@
 
 
 #include "types.h"
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
 #include <samplerate.h>
+#include <functional>
+#include <vector>
 
 
 class AudioBuffers;
 
 
+/** @class Resampler
+ *  @brief Convert audio from one sampling rate to another using libsamplerate.
+ *
+ *  Streams with several channels are split into groups of channels, each with its own
+ *  converter, and the groups are converted at the same time by a few threads of our own.
+ */
 class Resampler
 {
 public:
@@ -41,8 +51,27 @@ public:
 	void set_fast ();
 
 private:
-	SRC_STATE* _src = nullptr;
+	/** Some consecutive channels which are converted together */
+	struct Group
+	{
+		SRC_STATE* src = nullptr;
+		int first_channel = 0;
+		int channels = 0;
+	};
+
+	void make_groups (int converter, int groups);
+	void delete_groups ();
+	std::shared_ptr<AudioBuffers> run_group (Group const& group, std::shared_ptr<const AudioBuffers> in) const;
+	std::shared_ptr<AudioBuffers> flush_group (Group const& group) const;
+	std::shared_ptr<const AudioBuffers> run_groups (std::function<std::shared_ptr<AudioBuffers> (Group const&)> process);
+
+	std::vector<Group> _groups;
 	int _in_rate;
 	int _out_rate;
 	int _channels;
+
+	/** service which our threads use to convert all but the first group */
+	boost::asio::io_service _service;
+	std::shared_ptr<boost::asio::io_service::work> _work;
+	boost::thread_group _pool;
 };
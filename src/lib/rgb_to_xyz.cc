@@ -0,0 +1,208 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "compose.hpp"
+#include "rgb_to_xyz.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <dcp/transfer_function.h>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+
+
+using std::list;
+using std::make_pair;
+using std::make_shared;
+using std::map;
+using std::max;
+using std::min;
+using std::pair;
+using std::shared_ptr;
+using std::string;
+
+
+/** Number of pixels that convert_row() works on at a time */
+static int const chunk = 256;
+
+
+RGBToXYZ::RGBToXYZ (ColourConversion const& conversion)
+	: _lut_out (65536)
+{
+	auto const in = conversion.in()->lut(0, 1, 12, false);
+	_lut_in.assign (in.begin(), in.end());
+
+	auto const out = conversion.out()->lut(0, 1, 16, true);
+	for (int i = 0; i < 65536; ++i) {
+		_lut_out[i] = lrint (out[i] * 4095);
+	}
+
+	dcp::combined_rgb_to_xyz (conversion, _matrix);
+}
+
+
+shared_ptr<const RGBToXYZ>
+RGBToXYZ::get (ColourConversion const& conversion)
+{
+	/* Converters that this thread has asked for recently, most recent first.  Every frame
+	 * asks again, and almost always for the one it had last time, so this saves making
+	 * the identifier (which means an MD5) and taking the shared cache's lock each time.
+	 */
+	thread_local list<pair<ColourConversion, shared_ptr<const RGBToXYZ>>> recent;
+
+	for (auto i = recent.begin(); i != recent.end(); ++i) {
+		if (i->first == conversion) {
+			recent.splice (recent.begin(), recent, i);
+			return i->second;
+		}
+	}
+
+	auto converter = shared (conversion);
+	recent.push_front (make_pair(conversion, converter));
+	if (recent.size() > 4) {
+		recent.pop_back ();
+	}
+
+	return converter;
+}
+
+
+/** @return A converter for @p conversion from the cache that is shared by all threads */
+shared_ptr<const RGBToXYZ>
+RGBToXYZ::shared (ColourConversion const& conversion)
+{
+	static boost::mutex mutex;
+	static map<string, shared_ptr<const RGBToXYZ>> cache;
+
+	auto const id = conversion.identifier ();
+
+	boost::mutex::scoped_lock lm (mutex);
+	auto i = cache.find (id);
+	if (i != cache.end()) {
+		return i->second;
+	}
+
+	/* There are only ever a handful of different conversions in use at once */
+	if (cache.size() > 16) {
+		cache.clear ();
+	}
+
+	auto converter = make_shared<const RGBToXYZ>(conversion);
+	cache[id] = converter;
+	return converter;
+}
+
+
+/** Convert one row of RGB48LE to XYZ.
+ *  @return Number of pixels whose XYZ values had to be clamped.
+ */
+int
+RGBToXYZ::convert_row (uint16_t const* rgb, int width, int* out_x, int* out_y, int* out_z) const
+{
+	double r[chunk];
+	double g[chunk];
+	double b[chunk];
+	double x[chunk];
+	double y[chunk];
+	double z[chunk];
+
+	auto const m = _matrix;
+	int clamped = 0;
+
+	for (int start = 0; start < width; start += chunk) {
+		int const N = min(chunk, width - start);
+
+		/* In gamma LUT (converting 16-bit to 12-bit) */
+		for (int i = 0; i < N; ++i) {
+			r[i] = _lut_in[rgb[0] >> 4];
+			g[i] = _lut_in[rgb[1] >> 4];
+			b[i] = _lut_in[rgb[2] >> 4];
+			rgb += 3;
+		}
+
+		/* RGB to XYZ, Bradford transform and DCI companding, then clamp */
+		for (int i = 0; i < N; ++i) {
+			double const dx = r[i] * m[0] + g[i] * m[1] + b[i] * m[2];
+			double const dy = r[i] * m[3] + g[i] * m[4] + b[i] * m[5];
+			double const dz = r[i] * m[6] + g[i] * m[7] + b[i] * m[8];
+			clamped += (dx < 0 || dy < 0 || dz < 0 || dx > 1 || dy > 1 || dz > 1) ? 1 : 0;
+			x[i] = max(0.0, min(1.0, dx)) * 65535;
+			y[i] = max(0.0, min(1.0, dy)) * 65535;
+			z[i] = max(0.0, min(1.0, dz)) * 65535;
+		}
+
+		/* Out gamma LUT */
+		for (int i = 0; i < N; ++i) {
+			out_x[i] = _lut_out[lrint(x[i])];
+			out_y[i] = _lut_out[lrint(y[i])];
+			out_z[i] = _lut_out[lrint(z[i])];
+		}
+
+		out_x += N;
+		out_y += N;
+		out_z += N;
+	}
+
+	return clamped;
+}
+
+
+/** Convert some rows of an RGB48LE image into the same rows of an XYZ image.
+ *  @param rgb First row of the whole RGB image.
+ *  @param xyz XYZ image to write to, which must be the same size as the RGB image.
+ *  @return Number of pixels whose XYZ values had to be clamped.
+ */
+int
+RGBToXYZ::convert_rows (uint8_t const* rgb, int stride, int first_row, int rows, dcp::OpenJPEGImage& xyz) const
+{
+	int const width = xyz.size().width;
+	int const offset = first_row * width;
+
+	int* x = xyz.data(0) + offset;
+	int* y = xyz.data(1) + offset;
+	int* z = xyz.data(2) + offset;
+
+	int clamped = 0;
+	for (int row = first_row; row < first_row + rows; ++row) {
+		clamped += convert_row (reinterpret_cast<uint16_t const*>(rgb + row * stride), width, x, y, z);
+		x += width;
+		y += width;
+		z += width;
+	}
+
+	return clamped;
+}
+
+
+shared_ptr<dcp::OpenJPEGImage>
+RGBToXYZ::convert (uint8_t const* rgb, dcp::Size size, int stride, dcp::NoteHandler note) const
+{
+	auto xyz = make_shared<dcp::OpenJPEGImage>(size);
+
+	auto const clamped = convert_rows (rgb, stride, 0, size.height, *xyz);
+	if (clamped) {
+		note (dcp::NoteType::NOTE, String::compose("%1 XYZ value(s) clamped", clamped));
+	}
+
+	return xyz;
+}
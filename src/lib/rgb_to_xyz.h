@@ -0,0 +1,73 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_RGB_TO_XYZ_H
+#define DCPOMATIC_RGB_TO_XYZ_H
+
+
+#include "colour_conversion.h"
+#include <dcp/types.h>
+#include <memory>
+#include <vector>
+
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+
+/** @class RGBToXYZ
+ *  @brief Converter from RGB48LE to 12-bit XYZ for a particular ColourConversion.
+ *
+ *  This gives the same results as dcp::rgb_to_xyz but the LUTs and matrix are
+ *  computed once per ColourConversion and shared between all the threads that
+ *  use it, rather than being looked up again for every frame.  Each row is converted
+ *  in a few simple passes over contiguous buffers so that the compiler can vectorise
+ *  the arithmetic.
+ */
+class RGBToXYZ
+{
+public:
+	explicit RGBToXYZ (ColourConversion const& conversion);
+
+	RGBToXYZ (RGBToXYZ const&) = delete;
+	RGBToXYZ& operator= (RGBToXYZ const&) = delete;
+
+	/** @return A converter for @p conversion, shared with anybody else who asks for the same one */
+	static std::shared_ptr<const RGBToXYZ> get (ColourConversion const& conversion);
+
+	std::shared_ptr<dcp::OpenJPEGImage> convert (uint8_t const* rgb, dcp::Size size, int stride, dcp::NoteHandler note) const;
+	int convert_rows (uint8_t const* rgb, int stride, int first_row, int rows, dcp::OpenJPEGImage& xyz) const;
+
+private:
+	static std::shared_ptr<const RGBToXYZ> shared (ColourConversion const& conversion);
+	int convert_row (uint16_t const* rgb, int width, int* x, int* y, int* z) const;
+
+	/** input transfer function for 12-bit input values */
+	std::vector<double> _lut_in;
+	/** inverse output transfer function for 16-bit XYZ values, already scaled to 12-bit output */
+	std::vector<int> _lut_out;
+	/** product of the RGB to XYZ matrix, the Bradford transform and DCI companding */
+	double _matrix[9];
+};
+
+
+#endif
@@ -108,7 +108,7 @@ LIBDCP_ENABLE_WARNINGS
 
 
 void
-SCPUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+SCPUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, function<void (boost::uintmax_t)> progress)
 {
 	auto to_do = boost::filesystem::file_size (from);
 	/* Use generic_string so that we get forward-slashes in the path, even on Windows */
@@ -121,6 +121,7 @@ LIBDCP_ENABLE_WARNINGS
 		throw NetworkError (String::compose(_("Could not open %1 to send"), from));
 	}
 
+	boost::uintmax_t done = 0;
 	boost::uintmax_t buffer_size = 64 * 1024;
 	char buffer[buffer_size];
 
@@ -138,10 +139,7 @@ LIBDCP_ENABLE_WARNINGS
 			throw NetworkError (String::compose(_("Could not write to remote file (%1)"), ssh_get_error(_session)));
 		}
 		to_do -= t;
-		transferred += t;
-
-		if (total_size > 0) {
-			_set_progress ((double) transferred / total_size);
-		}
+		done += t;
+		progress (done);
 	}
 }
@@ -34,7 +34,7 @@ public:
 
 protected:
 	virtual void create_directory (boost::filesystem::path directory) override;
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size) override;
+	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, std::function<void (boost::uintmax_t)> progress) override;
 
 private:
 	ssh_session _session;
@@ -26,6 +26,9 @@
 #include <libxml++/libxml++.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <atomic>
 
 
 using std::list;
@@ -71,10 +74,11 @@ Screen::trusted_device_thumbprints () const
 }
 
 
+static
 KDMWithMetadataPtr
 kdm_for_screen (
 	shared_ptr<const Film> film,
-	boost::filesystem::path cpl,
+	Film::KDMKeys const& keys,
 	shared_ptr<const dcpomatic::Screen> screen,
 	boost::posix_time::ptime valid_from,
 	boost::posix_time::ptime valid_to,
@@ -83,18 +87,14 @@ kdm_for_screen (
 	optional<int> disable_forensic_marking_audio
 	)
 {
-	if (!screen->recipient) {
-		return {};
-	}
-
 	auto cinema = screen->cinema;
 	dcp::LocalTime const begin(valid_from, cinema ? cinema->utc_offset_hour() : 0, cinema ? cinema->utc_offset_minute() : 0);
 	dcp::LocalTime const end  (valid_to,   cinema ? cinema->utc_offset_hour() : 0, cinema ? cinema->utc_offset_minute() : 0);
 
 	auto const kdm = film->make_kdm (
+			keys,
 			screen->recipient.get(),
 			screen->trusted_device_thumbprints(),
-			cpl,
 			begin,
 			end,
 			formulation,
@@ -117,3 +117,85 @@ kdm_for_screen (
 	return make_shared<KDMWithMetadata>(name_values, cinema.get(), cinema ? cinema->emails : list<string>(), kdm);
 }
 
+
+KDMWithMetadataPtr
+kdm_for_screen (
+	shared_ptr<const Film> film,
+	boost::filesystem::path cpl,
+	shared_ptr<const dcpomatic::Screen> screen,
+	boost::posix_time::ptime valid_from,
+	boost::posix_time::ptime valid_to,
+	dcp::Formulation formulation,
+	bool disable_forensic_marking_picture,
+	optional<int> disable_forensic_marking_audio
+	)
+{
+	if (!screen->recipient) {
+		return {};
+	}
+
+	return kdm_for_screen (
+		film, film->kdm_keys(cpl), screen, valid_from, valid_to, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio
+		);
+}
+
+
+/** Make KDMs for many screens, reading the CPL and any imported keys only once and
+ *  signing the KDMs on all available cores.
+ *  @return KDMs in the same order as the screens that they are for; screens without
+ *  a recipient certificate are skipped.
+ */
+list<KDMWithMetadataPtr>
+kdms_for_screens (
+	shared_ptr<const Film> film,
+	boost::filesystem::path cpl,
+	vector<shared_ptr<dcpomatic::Screen>> const& screens,
+	boost::posix_time::ptime valid_from,
+	boost::posix_time::ptime valid_to,
+	dcp::Formulation formulation,
+	bool disable_forensic_marking_picture,
+	optional<int> disable_forensic_marking_audio
+	)
+{
+	vector<shared_ptr<dcpomatic::Screen>> todo;
+	std::copy_if (screens.begin(), screens.end(), std::back_inserter(todo), [](shared_ptr<dcpomatic::Screen> screen) { return static_cast<bool>(screen->recipient); });
+	if (todo.empty()) {
+		return {};
+	}
+
+	auto const keys = film->kdm_keys (cpl);
+
+	vector<KDMWithMetadataPtr> kdms (todo.size());
+	vector<std::exception_ptr> errors (todo.size());
+	std::atomic<size_t> next (0);
+
+	auto sign = [&]() {
+		while (true) {
+			auto const i = next++;
+			if (i >= todo.size()) {
+				return;
+			}
+			try {
+				kdms[i] = kdm_for_screen (film, keys, todo[i], valid_from, valid_to, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio);
+			} catch (...) {
+				errors[i] = std::current_exception ();
+			}
+		}
+	};
+
+	boost::thread_group threads;
+	auto const count = std::min(static_cast<size_t>(std::max(1U, boost::thread::hardware_concurrency())), todo.size());
+	for (size_t i = 0; i < count; ++i) {
+		threads.create_thread (sign);
+	}
+	threads.join_all ();
+
+	/* Throw the error that we would have seen first if we had made the KDMs one by one */
+	for (auto const& i: errors) {
+		if (i) {
+			std::rethrow_exception (i);
+		}
+	}
+
+	return list<KDMWithMetadataPtr>(kdms.begin(), kdms.end());
+}
@@ -29,7 +29,9 @@
 #include <dcp/certificate.h>
 #include <libcxml/cxml.h>
 #include <boost/optional.hpp>
+#include <list>
 #include <string>
+#include <vector>
 
 
 class Cinema;
@@ -85,4 +87,17 @@ kdm_for_screen (
 	);
 
 
+std::list<KDMWithMetadataPtr>
+kdms_for_screens (
+	std::shared_ptr<const Film> film,
+	boost::filesystem::path cpl,
+	std::vector<std::shared_ptr<dcpomatic::Screen>> const& screens,
+	boost::posix_time::ptime valid_from,
+	boost::posix_time::ptime valid_to,
+	dcp::Formulation formulation,
+	bool disable_forensic_marking_picture,
+	boost::optional<int> disable_forensic_marking_audio
+	);
+
+
 #endif
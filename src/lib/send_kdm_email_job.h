@@ -59,6 +59,9 @@ public:
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::NETWORK;
+	}
 
 private:
 	dcp::NameFormat _container_name_format;
@@ -69,11 +69,18 @@ Server::start_accept ()
 		}
 	}
 
-	auto socket = make_shared<Socket>(_timeout);
+	auto socket = create_socket (_timeout);
 	_acceptor.async_accept (socket->socket (), boost::bind (&Server::handle_accept, this, socket, boost::asio::placeholders::error));
 }
 
 
+shared_ptr<Socket>
+Server::create_socket (int timeout)
+{
+	return make_shared<Socket>(timeout);
+}
+
+
 void
 Server::handle_accept (shared_ptr<Socket> socket, boost::system::error_code const & error)
 {
@@ -45,11 +45,18 @@ public:
 	void stop ();
 
 protected:
+	/** @return io_service which run() runs, and which accepts connections */
+	boost::asio::io_service& io_service () {
+		return _io_service;
+	}
+
 	boost::mutex _mutex;
 	bool _terminate;
 
 private:
 	virtual void handle (std::shared_ptr<Socket> socket) = 0;
+	/** @return A new Socket to accept a connection into */
+	virtual std::shared_ptr<Socket> create_socket (int timeout);
 
 	void start_accept ();
 	void handle_accept (std::shared_ptr<Socket>, boost::system::error_code const &);
@@ -0,0 +1,175 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "exceptions.h"
+#include "shared_memory_ring.h"
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <cctype>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+
+using std::string;
+using boost::optional;
+namespace bip = boost::interprocess;
+
+
+static string const name_prefix = "dcpomatic-";
+
+
+SharedMemoryRing::SharedMemoryRing (size_t size)
+	: _owner (true)
+{
+	std::random_device device;
+	std::ostringstream name;
+	name << name_prefix << std::hex << std::setfill('0');
+	for (int i = 0; i < 4; ++i) {
+		name << std::setw(8) << static_cast<uint32_t>(device());
+	}
+	_name = name.str();
+
+	bip::shared_memory_object memory (bip::create_only, _name.c_str(), bip::read_write);
+	try {
+		memory.truncate (size);
+		_region.reset (new bip::mapped_region(memory, bip::read_write));
+	} catch (...) {
+		bip::shared_memory_object::remove (_name.c_str());
+		throw;
+	}
+}
+
+
+SharedMemoryRing::SharedMemoryRing (string name)
+	: _name (name)
+	, _owner (false)
+{
+	bip::shared_memory_object memory (bip::open_only, _name.c_str(), bip::read_only);
+	_region.reset (new bip::mapped_region(memory, bip::read_only));
+}
+
+
+SharedMemoryRing::~SharedMemoryRing ()
+{
+	unlink ();
+}
+
+
+size_t
+SharedMemoryRing::size () const
+{
+	return _region->get_size();
+}
+
+
+/** Copy some data into the ring, if there is room for it.
+ *  @return Offset of the data within the ring, or none if the ring is too full.
+ */
+optional<size_t>
+SharedMemoryRing::put (uint8_t const* data, size_t size)
+{
+	DCPOMATIC_ASSERT (_owner);
+
+	optional<size_t> offset;
+	if (_allocations.empty()) {
+		if (size <= this->size()) {
+			offset = 0;
+		}
+	} else {
+		auto const oldest = _allocations.front().offset;
+		auto const end = _allocations.back().offset + _allocations.back().size;
+		if (end > oldest) {
+			/* The free space is after the newest allocation and before the oldest */
+			if (end + size <= this->size()) {
+				offset = end;
+			} else if (size <= oldest) {
+				offset = 0;
+			}
+		} else if (end + size <= oldest) {
+			/* We have wrapped around, so the free space is between the newest and the oldest */
+			offset = end;
+		}
+	}
+
+	if (!offset) {
+		return {};
+	}
+
+	memcpy (static_cast<uint8_t*>(_region->get_address()) + *offset, data, size);
+	_allocations.push_back ({*offset, size});
+	return offset;
+}
+
+
+/** Free the oldest data that was put into the ring */
+void
+SharedMemoryRing::release ()
+{
+	DCPOMATIC_ASSERT (!_allocations.empty());
+	_allocations.pop_front ();
+}
+
+
+/** Copy some data out of the ring; the offset and size may have come from somebody
+ *  that we do not trust, so they are checked.
+ */
+void
+SharedMemoryRing::get (size_t offset, size_t size, uint8_t* out) const
+{
+	if (offset > this->size() || size > this->size() - offset) {
+		throw NetworkError ("Request is outside the shared memory");
+	}
+
+	memcpy (out, static_cast<uint8_t const*>(_region->get_address()) + offset, size);
+}
+
+
+/** Remove the ring's name, if we created it, so that nobody else can open it; the memory
+ *  stays until everybody who has it open has closed it.
+ */
+void
+SharedMemoryRing::unlink ()
+{
+	if (_owner) {
+		bip::shared_memory_object::remove (_name.c_str());
+	}
+}
+
+
+/** @return true if @p name could be the name of a SharedMemoryRing */
+bool
+SharedMemoryRing::valid_name (string name)
+{
+	if (name.length() <= name_prefix.length() || name.length() > 64 || name.substr(0, name_prefix.length()) != name_prefix) {
+		return false;
+	}
+
+	for (auto i: name) {
+		if (!isalnum(static_cast<unsigned char>(i)) && i != '-') {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,91 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_SHARED_MEMORY_RING_H
+#define DCPOMATIC_SHARED_MEMORY_RING_H
+
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+
+namespace boost {
+	namespace interprocess {
+		class mapped_region;
+	}
+}
+
+
+/** @class SharedMemoryRing
+ *  @brief A ring buffer in named shared memory, which an EncodeServerConnection uses to
+ *  pass requests to an encode server on the same host without copying them through a socket.
+ *
+ *  The client creates the ring and puts requests into it.  They are released in the order
+ *  that they were put, once the server has finished with them.  The server opens the ring
+ *  by name and copies requests out of it.  Once the server has opened the ring the client
+ *  can unlink() the name, after which the memory goes away when both sides have closed it.
+ */
+class SharedMemoryRing
+{
+public:
+	/** Create a new ring of @p size bytes with a unique name */
+	explicit SharedMemoryRing (size_t size);
+	/** Open, read-only, a ring that someone else has created */
+	explicit SharedMemoryRing (std::string name);
+	~SharedMemoryRing ();
+
+	SharedMemoryRing (SharedMemoryRing const&) = delete;
+	SharedMemoryRing& operator= (SharedMemoryRing const&) = delete;
+
+	std::string name () const {
+		return _name;
+	}
+
+	size_t size () const;
+
+	boost::optional<size_t> put (uint8_t const* data, size_t size);
+	void release ();
+	void get (size_t offset, size_t size, uint8_t* out) const;
+	void unlink ();
+
+	static bool valid_name (std::string name);
+
+private:
+	std::string _name;
+	/** true if we created the ring and should remove its name when we are finished */
+	bool _owner;
+	std::unique_ptr<boost::interprocess::mapped_region> _region;
+
+	struct Allocation
+	{
+		size_t offset;
+		size_t size;
+	};
+
+	/** Parts of the ring that are in use, oldest first */
+	std::deque<Allocation> _allocations;
+};
+
+
+#endif
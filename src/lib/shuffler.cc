@@ -23,6 +23,8 @@
 #include "content_video.h"
 #include "dcpomatic_assert.h"
 #include "dcpomatic_log.h"
+#include "image_proxy.h"
+#include <algorithm>
 #include <string>
 #include <iostream>
 
@@ -35,6 +37,10 @@ using boost::optional;
 
 
 int const Shuffler::_max_size = 64;
+/** If this many complete L/R pairs are waiting after the one we expect next, we give up on
+ *  the missing eye and carry on, rather than holding video until the store is full.
+ */
+int const Shuffler::_pairs_before_skip = 2;
 
 
 struct Comparator
@@ -48,6 +54,70 @@ struct Comparator
 };
 
 
+static
+int64_t
+memory_used (ContentVideo const& video)
+{
+	return video.image ? video.image->memory_used() : 0;
+}
+
+
+Shuffler::Shuffler ()
+{
+	_store.reserve (_max_size + 1);
+}
+
+
+/** @return true if the front of _store is the video that should follow _last */
+bool
+Shuffler::front_in_sequence () const
+{
+	if (_store.empty() || !_last) {
+		return false;
+	}
+
+	auto const& front = _store.front().second;
+	return (front.frame == _last->frame       && front.eyes == Eyes::RIGHT && _last->eyes == Eyes::LEFT) ||
+	       (front.frame >= (_last->frame + 1) && front.eyes == Eyes::LEFT  && _last->eyes == Eyes::RIGHT);
+}
+
+
+/** @return true if _store holds both eyes of at least _pairs_before_skip frames after _last,
+ *  in which case whatever we are waiting for is very unlikely to arrive.
+ */
+bool
+Shuffler::later_pairs_complete () const
+{
+	if (!_last) {
+		return false;
+	}
+
+	int pairs = 0;
+	for (size_t i = 1; i < _store.size(); ++i) {
+		auto const& left = _store[i - 1].second;
+		auto const& right = _store[i].second;
+		if (left.frame > _last->frame && left.frame == right.frame && left.eyes == Eyes::LEFT && right.eyes == Eyes::RIGHT) {
+			if (++pairs >= _pairs_before_skip) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+void
+Shuffler::pop_front ()
+{
+	DCPOMATIC_ASSERT (!_store.empty());
+	_store_memory -= memory_used(_store.front().second);
+	/* There are never many entries here, so moving them is cheap compared to allocating a list node for each one */
+	_store.erase (_store.begin());
+	_memory.set (_store_memory);
+}
+
+
 void
 Shuffler::video (weak_ptr<Piece> weak_piece, ContentVideo video)
 {
@@ -70,18 +140,14 @@ Shuffler::video (weak_ptr<Piece> weak_piece, ContentVideo video)
 		return;
 	}
 
-	_store.push_back (make_pair (weak_piece, video));
-	_store.sort (Comparator());
+	auto const store = make_pair(weak_piece, video);
+	_store.insert (std::upper_bound(_store.begin(), _store.end(), store, Comparator()), store);
+	_store_memory += memory_used(video);
+	_memory.set (_store_memory);
 
 	while (true) {
 
-		bool const store_front_in_sequence =
-			!_store.empty() &&
-			_last &&
-			(
-				(_store.front().second.frame == _last->frame       && _store.front().second.eyes == Eyes::RIGHT && _last->eyes == Eyes::LEFT) ||
-				(_store.front().second.frame >= (_last->frame + 1) && _store.front().second.eyes == Eyes::LEFT  && _last->eyes == Eyes::RIGHT)
-				);
+		bool const store_front_in_sequence = front_in_sequence ();
 
 		if (!store_front_in_sequence) {
 			string const store = _store.empty() ? "store empty" : String::compose("store front frame=%1 eyes=%2", _store.front().second.frame, static_cast<int>(_store.front().second.eyes));
@@ -89,22 +155,33 @@ Shuffler::video (weak_ptr<Piece> weak_piece, ContentVideo video)
 			LOG_DEBUG_THREE_D("Shuffler not in sequence: %1 %2", store, last);
 		}
 
-		if (!store_front_in_sequence && _store.size() <= _max_size) {
-			/* store_front_in_sequence means everything is ok; otherwise if the store is getting too big just
-			   start emitting things as best we can.  This can easily happen if, for example, there is only content
-			   for one eye in some part of the timeline.
+		if (_store.empty()) {
+			break;
+		}
+
+		bool const full = static_cast<int>(_store.size()) > _max_size;
+		/* Holding lots of frames can run us out of memory, so if we are over budget let most of them go */
+		bool const over_budget = static_cast<int>(_store.size()) > _max_size / 4 && MemoryBudget::instance()->over_budget();
+
+		if (!store_front_in_sequence && !full && !over_budget && !later_pairs_complete()) {
+			/* store_front_in_sequence means everything is ok; otherwise if the store is getting too big, or
+			   later frames have arrived complete, just start emitting things as best we can.  This can easily
+			   happen if, for example, there is only content for one eye in some part of the timeline.
 			*/
 			break;
 		}
 
-		if (_store.size() > _max_size) {
+		if (full) {
 			LOG_WARNING ("Shuffler is full after receiving frame %1; 3D sync may be incorrect.", video.frame);
+		} else if (!store_front_in_sequence) {
+			LOG_DEBUG_THREE_D("Shuffler skips to frame=%1 eyes=%2", _store.front().second.frame, static_cast<int>(_store.front().second.eyes));
 		}
 
 		LOG_DEBUG_THREE_D("Shuffler emits frame=%1 eyes=%2 store=%3", _store.front().second.frame, static_cast<int>(_store.front().second.eyes), _store.size());
-		Video (_store.front().first, _store.front().second);
-		_last = _store.front().second;
-		_store.pop_front ();
+		auto const front = _store.front();
+		pop_front ();
+		Video (front.first, front.second);
+		_last = front.second;
 	}
 }
 
@@ -114,6 +191,8 @@ Shuffler::clear ()
 {
 	LOG_DEBUG_THREE_D_NC ("Shuffler::clear");
 	_store.clear ();
+	_store_memory = 0;
+	_memory.set (0);
 	_last = optional<ContentVideo>();
 }
 
@@ -24,6 +24,7 @@
 
 
 #include "content_video.h"
+#include "memory_budget.h"
 #include "types.h"
 #include <boost/signals2.hpp>
 
@@ -36,6 +37,8 @@ class Piece;
 class Shuffler
 {
 public:
+	Shuffler ();
+
 	void clear ();
 	void flush ();
 	void video (std::weak_ptr<Piece>, ContentVideo video);
@@ -47,9 +50,20 @@ public:
 private:
 	friend struct ::shuffler_test5;
 
-	std::list<Store> _store;
+	bool front_in_sequence () const;
+	bool later_pairs_complete () const;
+	void pop_front ();
+
+	/** Video that we are holding on to, sorted by frame and then eye.  This has room for
+	 *  _max_size + 1 entries so that adding to it never allocates.
+	 */
+	std::vector<Store> _store;
+	/** memory used by the images in _store */
+	int64_t _store_memory = 0;
+	MemoryBudget::Share _memory{MemoryBudget::Subsystem::PLAYER};
 	boost::optional<ContentVideo> _last;
 	static int const _max_size;
+	static int const _pairs_before_skip;
 };
 
 
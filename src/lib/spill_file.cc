@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "exceptions.h"
+#include "spill_file.h"
+
+
+using std::make_shared;
+using std::shared_ptr;
+
+
+SpillFile::SpillFile (boost::filesystem::path path)
+	: _path (path)
+	, _file (path, "w+b")
+{
+	if (!_file) {
+		throw OpenFileError (path, errno, OpenFileError::READ_WRITE);
+	}
+}
+
+
+SpillFile::~SpillFile ()
+{
+	_file.close ();
+	boost::system::error_code ec;
+	boost::filesystem::remove (_path, ec);
+}
+
+
+/** Add some data to the end of the file.
+ *  @return Offset that should be passed to take() to get it back.
+ */
+int64_t
+SpillFile::put (dcp::Data const& data)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	auto const offset = _end;
+	_file.seek (offset, SEEK_SET);
+	_file.checked_write (data.data(), data.size());
+	_end += data.size();
+	++_held;
+	return offset;
+}
+
+
+/** Read back some data which was given to put().  Each piece of data can only be taken once.
+ *  @param offset Offset returned by put().
+ *  @param size Size of the data that was given to put().
+ */
+shared_ptr<dcp::ArrayData>
+SpillFile::take (int64_t offset, int size)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	DCPOMATIC_ASSERT (_held > 0);
+	DCPOMATIC_ASSERT (offset + size <= _end);
+
+	auto data = make_shared<dcp::ArrayData>(size);
+	_file.seek (offset, SEEK_SET);
+	_file.checked_read (data->data(), size);
+
+	if (--_held == 0) {
+		/* Nothing left in the file so we can start again at the beginning */
+		_end = 0;
+	}
+
+	return data;
+}
@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_SPILL_FILE_H
+#define DCPOMATIC_SPILL_FILE_H
+
+
+#include <dcp/array_data.h>
+#include <dcp/file.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <memory>
+
+
+/** @class SpillFile
+ *  @brief A scratch file to put encoded frames in when there are too many to keep in memory.
+ *
+ *  Frames are appended to the end of the file and read back from wherever they were put.
+ *  When everything that was put in has been taken out again the file is re-used from the
+ *  start, so it only gets as big as the biggest backlog.  Frames can be put and taken
+ *  from different threads.
+ */
+class SpillFile
+{
+public:
+	explicit SpillFile (boost::filesystem::path path);
+	~SpillFile ();
+
+	SpillFile (SpillFile const&) = delete;
+	SpillFile& operator= (SpillFile const&) = delete;
+
+	int64_t put (dcp::Data const& data);
+	std::shared_ptr<dcp::ArrayData> take (int64_t offset, int size);
+
+private:
+	boost::filesystem::path _path;
+
+	boost::mutex _mutex;
+	dcp::File _file;
+	/** offset of the end of the data in the file */
+	int64_t _end = 0;
+	/** number of frames which have been put but not taken */
+	int _held = 0;
+};
+
+
+#endif
@@ -21,6 +21,7 @@
 
 #include "cross.h"
 #include "exceptions.h"
+#include "parsed_file_cache.h"
 #include "string_text_file.h"
 #include "string_text_file_content.h"
 #include <dcp/file.h>
@@ -37,6 +38,7 @@
 
 
 using std::cout;
+using std::make_shared;
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -46,7 +48,8 @@ using dcp::ArrayData;
 using namespace dcpomatic;
 
 
-StringTextFile::StringTextFile (shared_ptr<const StringTextFileContent> content)
+static shared_ptr<const vector<sub::Subtitle>>
+parse_file (shared_ptr<const StringTextFileContent> content)
 {
 	string ext = content->path(0).extension().string();
 	transform (ext.begin(), ext.end(), ext.begin(), ::tolower);
@@ -111,28 +114,37 @@ StringTextFile::StringTextFile (shared_ptr<const StringTextFileContent> content)
 		}
 	}
 
-	if (reader) {
-		_subtitles = sub::collect<vector<sub::Subtitle>>(reader->subtitles());
+	if (!reader) {
+		return make_shared<vector<sub::Subtitle>>();
 	}
+
+	return make_shared<vector<sub::Subtitle>>(sub::collect<vector<sub::Subtitle>>(reader->subtitles()));
+}
+
+
+StringTextFile::StringTextFile (shared_ptr<const StringTextFileContent> content)
+{
+	static ParsedFileCache<vector<sub::Subtitle>> cache;
+	_subtitles = cache.get(parsed_file_key(content->path(0), content->digest()), [content]() { return parse_file(content); });
 }
 
 /** @return time of first subtitle, if there is one */
 optional<ContentTime>
 StringTextFile::first () const
 {
-	if (_subtitles.empty()) {
+	if (_subtitles->empty()) {
 		return {};
 	}
 
-	return ContentTime::from_seconds(_subtitles[0].from.all_as_seconds());
+	return ContentTime::from_seconds((*_subtitles)[0].from.all_as_seconds());
 }
 
 ContentTime
 StringTextFile::length () const
 {
-	if (_subtitles.empty ()) {
+	if (_subtitles->empty ()) {
 		return {};
 	}
 
-	return ContentTime::from_seconds (_subtitles.back().to.all_as_seconds ());
+	return ContentTime::from_seconds (_subtitles->back().to.all_as_seconds ());
 }
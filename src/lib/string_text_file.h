@@ -23,6 +23,7 @@
 
 #include "dcpomatic_time.h"
 #include <sub/subtitle.h>
+#include <memory>
 #include <vector>
 
 class StringTextFileContent;
@@ -45,11 +46,12 @@ public:
 	boost::optional<dcpomatic::ContentTime> first () const;
 	dcpomatic::ContentTime length () const;
 	std::vector<sub::Subtitle> const& subtitles() const {
-		return _subtitles;
+		return *_subtitles;
 	}
 
 protected:
-	std::vector<sub::Subtitle> _subtitles;
+	/** Subtitles from the file, which may be shared with other StringTextFiles for the same file */
+	std::shared_ptr<const std::vector<sub::Subtitle>> _subtitles;
 };
 
 #endif
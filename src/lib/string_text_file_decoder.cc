@@ -58,8 +58,9 @@ StringTextFileDecoder::seek (ContentTime time, bool accurate)
 
 	Decoder::seek (time, accurate);
 
+	auto const& subs = subtitles();
 	_next = 0;
-	while (_next < _subtitles.size() && ContentTime::from_seconds (_subtitles[_next].from.all_as_seconds ()) < time) {
+	while (_next < subs.size() && ContentTime::from_seconds (subs[_next].from.all_as_seconds ()) < time) {
 		++_next;
 	}
 
@@ -70,12 +71,13 @@ StringTextFileDecoder::seek (ContentTime time, bool accurate)
 bool
 StringTextFileDecoder::pass ()
 {
-	if (_next >= _subtitles.size ()) {
+	auto const& subs = subtitles();
+	if (_next >= subs.size ()) {
 		return true;
 	}
 
-	ContentTimePeriod const p = content_time_period (_subtitles[_next]);
-	only_text()->emit_plain (p, _subtitles[_next]);
+	ContentTimePeriod const p = content_time_period (subs[_next]);
+	only_text()->emit_plain (p, subs[_next]);
 
 	++_next;
 
@@ -98,9 +100,9 @@ StringTextFileDecoder::content_time_period (sub::Subtitle s) const
 void
 StringTextFileDecoder::update_position ()
 {
-	if (_next < _subtitles.size()) {
+	if (_next < subtitles().size()) {
 		only_text()->maybe_set_position(
-			ContentTime::from_seconds(_subtitles[_next].from.all_as_seconds())
+			ContentTime::from_seconds(subtitles()[_next].from.all_as_seconds())
 			);
 	}
 }
@@ -0,0 +1,140 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "digester.h"
+#include "image.h"
+#include "image_png.h"
+#include "subtitle_png_pool.h"
+#include "util.h"
+#include <boost/thread/once.hpp>
+
+
+using std::make_shared;
+using std::max;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+int const SubtitlePNGPool::_cache_size = 512;
+int const SubtitlePNGPool::_minimum_cache_size = 16;
+SubtitlePNGPool* SubtitlePNGPool::_instance = nullptr;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+
+
+SubtitlePNGPool::SubtitlePNGPool ()
+	: _work (make_shared<boost::asio::io_service::work>(_service))
+{
+	int const threads = max (1U, boost::thread::hardware_concurrency() / 2);
+	for (int i = 0; i < threads; ++i) {
+		_pool.create_thread ([this]() {
+			start_of_thread ("SubtitlePNGPool");
+			_service.run ();
+		});
+	}
+}
+
+
+string
+SubtitlePNGPool::digest (shared_ptr<const Image> image)
+{
+	Digester digester;
+	image->add_digest (digester);
+	return digester.get ();
+}
+
+
+std::shared_future<dcp::ArrayData>
+SubtitlePNGPool::encode (shared_ptr<const Image> image, string key)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return encode_locked (image, key);
+}
+
+
+vector<std::shared_future<dcp::ArrayData>>
+SubtitlePNGPool::encode (vector<Request> const& requests)
+{
+	vector<std::shared_future<dcp::ArrayData>> pngs;
+	pngs.reserve (requests.size());
+
+	boost::mutex::scoped_lock lm (_mutex);
+	for (auto const& i: requests) {
+		pngs.push_back (encode_locked(i.image, i.digest));
+	}
+
+	return pngs;
+}
+
+
+/** Must be called with _mutex held */
+std::shared_future<dcp::ArrayData>
+SubtitlePNGPool::encode_locked (shared_ptr<const Image> image, string key)
+{
+	auto existing = _cache.find (key);
+	if (existing != _cache.end()) {
+		_recent.remove (key);
+		_recent.push_front (key);
+		return existing->second;
+	}
+
+	auto task = make_shared<std::packaged_task<dcp::ArrayData ()>>([this, image, key]() {
+		auto png = image_as_png (image, PNGCompression::FAST);
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_cache.find(key) != _cache.end() && _sizes.find(key) == _sizes.end()) {
+			_sizes[key] = png.size();
+			_memory.add (png.size());
+		}
+		return png;
+	});
+	auto png = task->get_future().share();
+	_service.post ([task]() {
+		(*task)();
+	});
+
+	_cache[key] = png;
+	_recent.push_front (key);
+	/* Forget anything that we can't keep, keeping fewer while the pipeline is short of memory */
+	auto const budget = MemoryBudget::instance();
+	while (static_cast<int>(_recent.size()) > _cache_size || (static_cast<int>(_recent.size()) > _minimum_cache_size && budget->over_budget())) {
+		auto const oldest = _recent.back();
+		_cache.erase (oldest);
+		auto size = _sizes.find (oldest);
+		if (size != _sizes.end()) {
+			_memory.add (-static_cast<int64_t>(size->second));
+			_sizes.erase (size);
+		}
+		_recent.pop_back ();
+	}
+
+	return png;
+}
+
+
+SubtitlePNGPool *
+SubtitlePNGPool::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new SubtitlePNGPool ();
+	});
+
+	return _instance;
+}
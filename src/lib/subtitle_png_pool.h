@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_SUBTITLE_PNG_POOL_H
+#define DCPOMATIC_SUBTITLE_PNG_POOL_H
+
+
+#include "memory_budget.h"
+#include <dcp/array_data.h>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+class Image;
+
+
+/** @class SubtitlePNGPool
+ *  @brief Some threads which compress bitmap subtitles to PNG for the ReelWriters, so that
+ *  writing a DCP need not wait for each one.
+ *
+ *  The PNGs of recently-compressed images are kept so that images which come up again,
+ *  in the same DCP or when it is remade, are only compressed once.
+ */
+class SubtitlePNGPool
+{
+public:
+	SubtitlePNGPool (SubtitlePNGPool const&) = delete;
+	SubtitlePNGPool& operator= (SubtitlePNGPool const&) = delete;
+
+	/** @param image Image to compress.
+	 *  @param digest Digest of `image', from digest().
+	 *  @return PNG of `image', which will rethrow any exception from compressing it.
+	 */
+	std::shared_future<dcp::ArrayData> encode (std::shared_ptr<const Image> image, std::string digest);
+
+	struct Request
+	{
+		std::shared_ptr<const Image> image;
+		/** digest of `image', from digest() */
+		std::string digest;
+	};
+
+	/** Start compressing several images at once, so that they are spread over our threads.
+	 *  @return PNGs of the images, in the same order as `requests'.
+	 */
+	std::vector<std::shared_future<dcp::ArrayData>> encode (std::vector<Request> const& requests);
+
+	static std::string digest (std::shared_ptr<const Image> image);
+
+	static SubtitlePNGPool* instance ();
+
+private:
+	SubtitlePNGPool ();
+
+	std::shared_future<dcp::ArrayData> encode_locked (std::shared_ptr<const Image> image, std::string digest);
+
+	boost::asio::io_service _service;
+	std::shared_ptr<boost::asio::io_service::work> _work;
+	boost::thread_group _pool;
+
+	boost::mutex _mutex;
+	/** PNGs by digest of the image that they were made from */
+	std::map<std::string, std::shared_future<dcp::ArrayData>> _cache;
+	/** Keys of _cache, most recently used first */
+	std::list<std::string> _recent;
+	/** Sizes of the PNGs in _cache that have been made, by key */
+	std::map<std::string, size_t> _sizes;
+	/** memory used by the PNGs in _sizes */
+	MemoryBudget::Share _memory{MemoryBudget::Subsystem::SUBTITLE_CACHE};
+
+	static int const _cache_size;
+	/** Number of PNGs to keep even when the pipeline is over its memory budget */
+	static int const _minimum_cache_size;
+	static SubtitlePNGPool* _instance;
+};
+
+
+#endif
@@ -442,6 +442,32 @@ TextContent::identifier () const
 	return s;
 }
 
+
+/** @return string which changes when something about this content changes which could affect
+ *  the hints that are given about it.  This is like identifier() but leaves out the colours,
+ *  which change neither the timing nor the size of what we write.
+ */
+string
+TextContent::hints_identifier () const
+{
+	auto s = raw_convert<string> (x_scale())
+		+ "_" + raw_convert<string> (y_scale())
+		+ "_" + raw_convert<string> (x_offset())
+		+ "_" + raw_convert<string> (y_offset())
+		+ "_" + raw_convert<string> (line_spacing())
+		+ "_" + raw_convert<string> (fade_in().get_value_or(ContentTime()).get())
+		+ "_" + raw_convert<string> (fade_out().get_value_or(ContentTime()).get())
+		+ "_" + raw_convert<string> (outline_width())
+		+ "_" + raw_convert<string> (dcp::effect_to_string(effect().get_value_or(dcp::Effect::NONE)))
+		+ "_" + raw_convert<string> (_parent->video_frame_rate().get_value_or(0));
+
+	for (auto f: _fonts) {
+		s += "_" + f->file().get_value_or("Default").string();
+	}
+
+	return s;
+}
+
 void
 TextContent::add_font (shared_ptr<Font> font)
 {
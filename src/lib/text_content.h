@@ -74,6 +74,7 @@ public:
 
 	void as_xml (xmlpp::Node *) const;
 	std::string identifier () const;
+	std::string hints_identifier () const;
 	void take_settings_from (std::shared_ptr<const TextContent> c);
 
 	void clear_fonts ();
@@ -0,0 +1,94 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "exceptions.h"
+#include "text_hints.h"
+#include <libcxml/cxml.h>
+#include <dcp/raw_convert.h>
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+LIBDCP_ENABLE_WARNINGS
+
+
+using std::make_shared;
+using std::string;
+using dcp::raw_convert;
+
+
+int const TextHints::_current_state_version = 1;
+
+
+TextHints::TextHints (boost::filesystem::path path)
+{
+	cxml::Document f ("TextHints");
+
+	f.read_file (path);
+
+	if (f.optional_number_child<int>("Version").get_value_or(1) < _current_state_version) {
+		/* Too old.  Throw an exception so that the texts are examined again */
+		throw OldFormatError ("Text hints file is too old");
+	}
+
+	long_ccap = f.bool_child("LongClosedCaption");
+	overlap_ccap = f.bool_child("OverlappingClosedCaptions");
+	too_many_ccap_lines = f.bool_child("TooManyClosedCaptionLines");
+	ccap_xml_too_big = f.bool_child("ClosedCaptionXMLTooBig");
+	ccap_mxf_too_big = f.bool_child("ClosedCaptionMXFTooBig");
+
+	early_subtitle = f.bool_child("EarlySubtitle");
+	short_subtitle = f.bool_child("ShortSubtitle");
+	subtitles_too_close = f.bool_child("SubtitlesTooClose");
+	too_many_subtitle_lines = f.bool_child("TooManySubtitleLines");
+	long_subtitle = f.bool_child("LongSubtitle");
+	very_long_subtitle = f.bool_child("VeryLongSubtitle");
+	subs_mxf_too_big = f.bool_child("SubtitleMXFTooBig");
+}
+
+
+void
+TextHints::write (boost::filesystem::path path) const
+{
+	auto doc = make_shared<xmlpp::Document>();
+	xmlpp::Element* root = doc->create_root_node ("TextHints");
+
+	root->add_child("Version")->add_child_text(raw_convert<string>(_current_state_version));
+
+	auto add = [root](string name, bool value) {
+		root->add_child(name)->add_child_text(value ? "1" : "0");
+	};
+
+	add ("LongClosedCaption", long_ccap);
+	add ("OverlappingClosedCaptions", overlap_ccap);
+	add ("TooManyClosedCaptionLines", too_many_ccap_lines);
+	add ("ClosedCaptionXMLTooBig", ccap_xml_too_big);
+	add ("ClosedCaptionMXFTooBig", ccap_mxf_too_big);
+
+	add ("EarlySubtitle", early_subtitle);
+	add ("ShortSubtitle", short_subtitle);
+	add ("SubtitlesTooClose", subtitles_too_close);
+	add ("TooManySubtitleLines", too_many_subtitle_lines);
+	add ("LongSubtitle", long_subtitle);
+	add ("VeryLongSubtitle", very_long_subtitle);
+	add ("SubtitleMXFTooBig", subs_mxf_too_big);
+
+	doc->write_to_file_formatted (path.string());
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_TEXT_HINTS_H
+#define DCPOMATIC_TEXT_HINTS_H
+
+
+#include <boost/filesystem.hpp>
+
+
+/** @class TextHints
+ *  @brief What Hints found out about a film's subtitles and closed captions, which can be kept
+ *  so that the texts need not be examined again until something about them changes.
+ */
+class TextHints
+{
+public:
+	TextHints () = default;
+	explicit TextHints (boost::filesystem::path path);
+
+	void write (boost::filesystem::path path) const;
+
+	bool long_ccap = false;
+	bool overlap_ccap = false;
+	bool too_many_ccap_lines = false;
+	bool ccap_xml_too_big = false;
+	bool ccap_mxf_too_big = false;
+
+	bool early_subtitle = false;
+	bool short_subtitle = false;
+	bool subtitles_too_close = false;
+	bool too_many_subtitle_lines = false;
+	bool long_subtitle = false;
+	bool very_long_subtitle = false;
+	bool subs_mxf_too_big = false;
+
+private:
+	static int const _current_state_version;
+};
+
+
+#endif
@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "text_render_pool.h"
+#include "util.h"
+#include <boost/thread/once.hpp>
+
+
+using std::function;
+using std::make_shared;
+using std::max;
+using std::shared_ptr;
+using boost::optional;
+
+
+TextRenderPool* TextRenderPool::_instance = nullptr;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+
+
+TextRenderPool::TextRenderPool ()
+	: _work (make_shared<boost::asio::io_service::work>(_service))
+{
+	/* Rendering a line of text is mostly single-threaded work in Pango and Cairo, and
+	 * there are rarely more than a few frames' worth of it waiting at once.
+	 */
+	int const threads = max (1U, boost::thread::hardware_concurrency() / 2);
+	for (int i = 0; i < threads; ++i) {
+		_pool.create_thread ([this]() {
+			start_of_thread ("TextRenderPool");
+			_service.run ();
+		});
+	}
+}
+
+
+shared_ptr<const PendingText>
+TextRenderPool::render (function<optional<PositionImage> ()> render)
+{
+	auto task = make_shared<std::packaged_task<optional<PositionImage> ()>>(render);
+	auto pending = make_shared<PendingText>(task->get_future().share());
+	_service.post ([task]() {
+		(*task)();
+	});
+	return pending;
+}
+
+
+TextRenderPool *
+TextRenderPool::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new TextRenderPool ();
+	});
+
+	return _instance;
+}
@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_TEXT_RENDER_POOL_H
+#define DCPOMATIC_TEXT_RENDER_POOL_H
+
+
+#include "position_image.h"
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <functional>
+
+
+/** @class TextRenderPool
+ *  @brief Some threads which render subtitles to images, so that the Player can carry on
+ *  decoding while the subtitles for the frames that it has emitted are rendered.
+ *
+ *  The threads are made when the pool is first used, and each keeps its own cache of
+ *  Pango layouts (see render_text.cc).
+ */
+class TextRenderPool
+{
+public:
+	TextRenderPool (TextRenderPool const&) = delete;
+	TextRenderPool& operator= (TextRenderPool const&) = delete;
+
+	/** Run `render' on one of our threads.
+	 *  @return Result of `render', which will rethrow any exception that it threw.
+	 */
+	std::shared_ptr<const PendingText> render (std::function<boost::optional<PositionImage> ()> render);
+
+	static TextRenderPool* instance ();
+
+private:
+	TextRenderPool ();
+
+	boost::asio::io_service _service;
+	std::shared_ptr<boost::asio::io_service::work> _work;
+	boost::thread_group _pool;
+
+	static TextRenderPool* _instance;
+};
+
+
+#endif
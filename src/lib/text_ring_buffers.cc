@@ -19,38 +19,101 @@
 */
 
 
+#include "dcpomatic_assert.h"
+#include "string_text.h"
 #include "text_ring_buffers.h"
+#include <algorithm>
 
 
-using std::pair;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
 using boost::optional;
 using namespace dcpomatic;
 
 
-void
+/** @return Distance of a piece of text from the top of the screen, as a proportion of the screen height */
+static float
+from_top (StringText const& text)
+{
+	switch (text.v_align()) {
+	case dcp::VAlign::TOP:
+		return text.v_position();
+	case dcp::VAlign::CENTER:
+		return text.v_position() + 0.5;
+	case dcp::VAlign::BOTTOM:
+		return 1.0 - text.v_position();
+	}
+	DCPOMATIC_ASSERT (false);
+	return 0;
+}
+
+
+TextRingBuffers::Data::Data (PlayerText text_, DCPTextTrack track_, DCPTimePeriod period_)
+	: text (text_)
+	, track (track_)
+	, period (period_)
+{
+	vector<StringText> strings(text.string.begin(), text.string.end());
+	std::stable_sort (strings.begin(), strings.end(), [](StringText const& a, StringText const& b) {
+		return from_top(a) < from_top(b);
+	});
+
+	for (auto const& i: strings) {
+		lines.push_back (i.text());
+	}
+}
+
+
+TextRingBuffers::TextRingBuffers (int capacity)
+	: _capacity (capacity)
+	, _data (capacity)
+	, _write (0)
+	, _read (0)
+	, _clear_to (-1)
+{
+
+}
+
+
+/** @return true if the caption was stored, false if there was no room for it */
+bool
 TextRingBuffers::put (PlayerText text, DCPTextTrack track, DCPTimePeriod period)
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	_data.push_back (Data(text, track, period));
+	auto const write = _write.load(std::memory_order_relaxed);
+	if (write - _read.load(std::memory_order_acquire) >= _capacity) {
+		return false;
+	}
+
+	std::atomic_store (&_data[write % _capacity], shared_ptr<const Data>(make_shared<Data>(text, track, period)));
+	_write.store(write + 1, std::memory_order_release);
+	return true;
 }
 
 
 optional<TextRingBuffers::Data>
 TextRingBuffers::get ()
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	if (_data.empty()) {
+	auto read = _read.load(std::memory_order_relaxed);
+
+	auto const clear_to = _clear_to.exchange(-1);
+	for (; read < clear_to; ++read) {
+		std::atomic_store (&_data[read % _capacity], shared_ptr<const Data>());
+	}
+
+	if (read == _write.load(std::memory_order_acquire)) {
+		_read.store(read, std::memory_order_release);
 		return {};
 	}
 
-	auto r = _data.front();
-	_data.pop_front();
-	return r;
+	auto data = std::atomic_exchange(&_data[read % _capacity], shared_ptr<const Data>());
+	_read.store(read + 1, std::memory_order_release);
+	return *data;
 }
 
 
 void
 TextRingBuffers::clear ()
 {
-	_data.clear ();
+	_clear_to.store(_write.load(std::memory_order_acquire));
 }
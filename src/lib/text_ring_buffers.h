@@ -26,34 +26,56 @@
 #include "dcp_text_track.h"
 #include "dcpomatic_time.h"
 #include "player_text.h"
-#include <boost/thread.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 
+/** @class TextRingBuffers
+ *  @brief A fixed-size, lock-free queue of closed captions passing from one thread to another.
+ *
+ *  put() is called from one thread and get() from another (or either from several threads, as long
+ *  as the caller serialises calls to each side).  clear() may be called from any thread; the captions
+ *  that it throws away are dropped by the next get().
+ */
 class TextRingBuffers
 {
 public:
-	void put (PlayerText text, DCPTextTrack track, dcpomatic::DCPTimePeriod period);
+	/** @param capacity Maximum number of captions that can be stored */
+	explicit TextRingBuffers (int capacity);
+
+	TextRingBuffers (TextRingBuffers const&) = delete;
+	TextRingBuffers& operator= (TextRingBuffers const&) = delete;
+
+	bool put (PlayerText text, DCPTextTrack track, dcpomatic::DCPTimePeriod period);
 
 	struct Data {
-		Data (PlayerText text_, DCPTextTrack track_, dcpomatic::DCPTimePeriod period_)
-			: text (text_)
-			, track (track_)
-			, period (period_)
-		{}
+		Data (PlayerText text_, DCPTextTrack track_, dcpomatic::DCPTimePeriod period_);
 
 		PlayerText text;
 		DCPTextTrack track;
 		dcpomatic::DCPTimePeriod period;
+		/** text of each line of the caption, from the top of the screen down; worked out by put()
+		 *  so that whoever shows the caption need not.
+		 */
+		std::vector<std::string> lines;
 	};
 
 	boost::optional<Data> get ();
 	void clear ();
 
 private:
-	boost::mutex _mutex;
-
-	std::list<Data> _data;
+	int const _capacity;
+	/** captions, accessed with std::atomic_load and friends */
+	std::vector<std::shared_ptr<const Data>> _data;
+	/** index (counting all the captions ever put) of the next caption that put() will write; changed only by put() */
+	std::atomic<int64_t> _write;
+	/** index of the next caption that get() will read; changed only by get() */
+	std::atomic<int64_t> _read;
+	/** index that get() should skip up to because clear() was called, or -1 */
+	std::atomic<int64_t> _clear_to;
 };
 
 
@@ -0,0 +1,158 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_assert.h"
+#include "decoder.h"
+#include "decoder_factory.h"
+#include "ffmpeg_image_proxy.h"
+#include "film.h"
+#include "image.h"
+#include "image_png.h"
+#include "image_proxy.h"
+#include "thumbnail_strip.h"
+#include "video_content.h"
+#include "video_decoder.h"
+#include <dcp/raw_convert.h>
+#include <dcp/util.h>
+#include <algorithm>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::sort;
+using std::string;
+using std::vector;
+using boost::optional;
+using dcp::raw_convert;
+using namespace dcpomatic;
+
+
+int const ThumbnailStrip::height = 64;
+int const ThumbnailStrip::_max_thumbnails = 64;
+int const ThumbnailStrip::_min_interval = 2;
+
+
+/** Name of the file in a strip's directory which gives the content's frame rate,
+ *  and which is written last so that its presence means the strip is complete.
+ */
+static char const* const frame_rate_file = "rate";
+
+
+ThumbnailStrip::ThumbnailStrip (boost::filesystem::path directory)
+{
+	_frame_rate = raw_convert<double>(dcp::file_to_string(directory / frame_rate_file));
+
+	vector<std::pair<Frame, boost::filesystem::path>> files;
+	for (auto i: boost::filesystem::directory_iterator(directory)) {
+		if (i.path().extension() == ".png") {
+			files.push_back({raw_convert<Frame>(i.path().stem().string()), i.path()});
+		}
+	}
+
+	sort(files.begin(), files.end());
+
+	for (auto const& i: files) {
+		auto image = FFmpegImageProxy(i.second).image(Image::Alignment::COMPACT).image;
+		if (image->pixel_format() != AV_PIX_FMT_RGB24) {
+			image = image->scale(image->size(), dcp::YUVToRGB::REC709, AV_PIX_FMT_RGB24, Image::Alignment::COMPACT, true);
+		}
+		_thumbnails.push_back({ContentTime::from_frames(i.first, _frame_rate), image});
+	}
+}
+
+
+void
+ThumbnailStrip::write (boost::filesystem::path directory) const
+{
+	/* Write to a temporary directory and then move it into place so that nobody sees a half-written strip */
+	auto tmp = directory;
+	tmp += ".tmp";
+	boost::system::error_code ec;
+	boost::filesystem::remove_all(tmp, ec);
+	boost::filesystem::create_directories(tmp);
+
+	for (auto const& i: _thumbnails) {
+		image_as_png(i.image).write(tmp / (raw_convert<string>(i.time.frames_round(_frame_rate)) + ".png"));
+	}
+
+	dcp::write_string_to_file(raw_convert<string>(_frame_rate), tmp / frame_rate_file);
+
+	boost::filesystem::remove_all(directory, ec);
+	boost::filesystem::rename(tmp, directory);
+}
+
+
+shared_ptr<ThumbnailStrip>
+ThumbnailStrip::make (shared_ptr<const Film> film, shared_ptr<const Content> content, std::function<bool ()> stop)
+{
+	DCPOMATIC_ASSERT(content->video);
+
+	/* Fast decoding is fine for thumbnails, and we only ever look at the first frame after an
+	   inaccurate seek, which will usually be a key frame.
+	*/
+	auto decoder = decoder_factory(film, content, true, true, {});
+	DCPOMATIC_ASSERT(decoder->video);
+
+	auto const rate = content->video_frame_rate().get_value_or(24);
+	auto const length = content->video->length();
+	auto const seconds = static_cast<int>(length / rate);
+	auto const count = std::max(1, std::min(_max_thumbnails, seconds / _min_interval));
+
+	auto size = content->video->size();
+	auto const ratio = size.width * content->video->sample_aspect_ratio().get_value_or(1) / std::max(1, size.height);
+	dcp::Size const thumbnail_size(std::max(2, static_cast<int>(std::lround(height * ratio / 2)) * 2), height);
+
+	vector<Thumbnail> thumbnails;
+
+	for (int i = 0; i < count; ++i) {
+		if (stop()) {
+			return {};
+		}
+
+		optional<ContentVideo> frame;
+		auto connection = decoder->video->Data.connect([&frame](ContentVideo video) {
+			if (!frame) {
+				frame = video;
+			}
+		});
+
+		auto const wanted = ContentTime::from_frames((length * (i * 2 + 1)) / (count * 2), rate);
+		decoder->seek(wanted, false);
+
+		int tries_left = 50;
+		while (!frame && tries_left >= 0) {
+			if (decoder->pass()) {
+				break;
+			}
+			--tries_left;
+		}
+
+		connection.disconnect();
+
+		if (frame) {
+			/* Asking the proxy for a small image lets J2K decoding skip the levels that we don't need */
+			auto image = frame->image->image(Image::Alignment::COMPACT, thumbnail_size).image;
+			thumbnails.push_back({ContentTime::from_frames(frame->frame, rate), image->scale(thumbnail_size, dcp::YUVToRGB::REC709, AV_PIX_FMT_RGB24, Image::Alignment::COMPACT, true)});
+		}
+	}
+
+	return make_shared<ThumbnailStrip>(thumbnails, rate);
+}
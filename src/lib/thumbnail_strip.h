@@ -0,0 +1,93 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_THUMBNAIL_STRIP_H
+#define DCPOMATIC_THUMBNAIL_STRIP_H
+
+
+#include "dcpomatic_time.h"
+#include <boost/filesystem.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+class Content;
+class Film;
+class Image;
+
+
+/** @class ThumbnailStrip
+ *  @brief Small RGB24 images of frames from evenly through some video content, for showing on the timeline.
+ *
+ *  A strip is kept on disk as a directory of PNGs, each named after the index of the content frame that it shows.
+ */
+class ThumbnailStrip
+{
+public:
+	struct Thumbnail
+	{
+		/** time of the frame within the content, ignoring any trim */
+		dcpomatic::ContentTime time;
+		std::shared_ptr<const Image> image;
+	};
+
+	/** Read a strip that was previously written to a directory */
+	explicit ThumbnailStrip (boost::filesystem::path directory);
+
+	ThumbnailStrip (std::vector<Thumbnail> thumbnails, double frame_rate)
+		: _thumbnails (std::move(thumbnails))
+		, _frame_rate (frame_rate)
+	{}
+
+	ThumbnailStrip (ThumbnailStrip const&) = delete;
+	ThumbnailStrip& operator= (ThumbnailStrip const&) = delete;
+
+	void write (boost::filesystem::path directory) const;
+
+	std::vector<Thumbnail> const& thumbnails () const {
+		return _thumbnails;
+	}
+
+	/** Make a strip by decoding frames directly from some content.
+	 *  @param stop Function which will be called between frames; if it returns true we give up and return nullptr.
+	 */
+	static std::shared_ptr<ThumbnailStrip> make (
+		std::shared_ptr<const Film> film,
+		std::shared_ptr<const Content> content,
+		std::function<bool ()> stop
+		);
+
+	/** height of each thumbnail in pixels */
+	static int const height;
+
+private:
+	std::vector<Thumbnail> _thumbnails;
+	double _frame_rate;
+
+	/** most thumbnails to make for any one piece of content */
+	static int const _max_thumbnails;
+	/** shortest time between thumbnails, in seconds */
+	static int const _min_interval;
+};
+
+
+#endif
@@ -0,0 +1,155 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_log.h"
+#include "film.h"
+#include "thumbnail_strip.h"
+#include "thumbnail_strip_maker.h"
+#include "util.h"
+#include <boost/thread/once.hpp>
+#include <algorithm>
+
+
+using std::shared_ptr;
+using std::string;
+
+
+int const ThumbnailStripMaker::_cache_size = 64;
+ThumbnailStripMaker* ThumbnailStripMaker::_instance = nullptr;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+
+
+ThumbnailStripMaker::ThumbnailStripMaker ()
+{
+	_thread = boost::thread(boost::bind(&ThumbnailStripMaker::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np(_thread.native_handle(), "thumbnails");
+#endif
+}
+
+
+shared_ptr<const ThumbnailStrip>
+ThumbnailStripMaker::get (shared_ptr<const Film> film, shared_ptr<const Content> content)
+{
+	auto const path = film->thumbnails_path(content);
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	auto existing = _cache.find (path);
+	if (existing != _cache.end()) {
+		_recent.remove (path);
+		_recent.push_front (path);
+		return existing->second;
+	}
+
+	if (_failed.find(path) != _failed.end()) {
+		return {};
+	}
+
+	for (auto const& i: _queue) {
+		if (i.path == path) {
+			return {};
+		}
+	}
+
+	_queue.push_back ({path, film, content});
+	_condition.notify_all ();
+	return {};
+}
+
+
+void
+ThumbnailStripMaker::thread ()
+{
+	start_of_thread ("ThumbnailStripMaker");
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_queue.empty()) {
+			_condition.wait (lm);
+		}
+
+		auto request = _queue.front ();
+		lm.unlock ();
+
+		shared_ptr<const ThumbnailStrip> strip;
+
+		try {
+			if (boost::filesystem::exists(request.path)) {
+				strip = std::make_shared<ThumbnailStrip>(request.path);
+			}
+		} catch (std::exception& e) {
+			/* Perhaps an old or damaged strip; just make it again */
+			LOG_GENERAL ("Could not read thumbnails from %1 (%2)", request.path.string(), e.what());
+		}
+
+		auto film = request.film.lock ();
+		auto content = request.content.lock ();
+
+		if (!strip && film && content) {
+			try {
+				auto made = ThumbnailStrip::make (film, content, [film, content]() {
+					/* Give up if the content has been removed from the film */
+					auto const all = film->content ();
+					return std::find(all.begin(), all.end(), content) == all.end();
+				});
+				if (made) {
+					made->write (request.path);
+					strip = made;
+				}
+			} catch (std::exception& e) {
+				LOG_GENERAL ("Could not make thumbnails for %1 (%2)", content->summary(), e.what());
+			}
+		}
+
+		lm.lock ();
+
+		_queue.pop_front ();
+
+		if (strip) {
+			_cache[request.path] = strip;
+			_recent.push_front (request.path);
+			while (static_cast<int>(_recent.size()) > _cache_size) {
+				_cache.erase (_recent.back());
+				_recent.pop_back ();
+			}
+		} else if (film && content) {
+			_failed.insert (request.path);
+		}
+
+		lm.unlock ();
+
+		if (strip) {
+			emit (boost::bind(boost::ref(Ready), request.path));
+		}
+	}
+}
+
+
+ThumbnailStripMaker *
+ThumbnailStripMaker::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new ThumbnailStripMaker ();
+	});
+
+	return _instance;
+}
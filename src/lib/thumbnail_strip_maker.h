@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_THUMBNAIL_STRIP_MAKER_H
+#define DCPOMATIC_THUMBNAIL_STRIP_MAKER_H
+
+
+#include "signaller.h"
+#include <boost/filesystem.hpp>
+#include <boost/signals2.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+
+
+class Content;
+class Film;
+class ThumbnailStrip;
+
+
+/** @class ThumbnailStripMaker
+ *  @brief A thread which makes ThumbnailStrips for content, or reads them from the film's
+ *  thumbnails directory if they were made before.
+ *
+ *  Strips are made by decoding the content directly, so the player that the viewer
+ *  is using is not disturbed.
+ */
+class ThumbnailStripMaker : public Signaller
+{
+public:
+	ThumbnailStripMaker (ThumbnailStripMaker const&) = delete;
+	ThumbnailStripMaker& operator= (ThumbnailStripMaker const&) = delete;
+
+	/** @return Strip for some content if it is ready, otherwise nullptr; in that case the strip
+	 *  will be found or made in the background, and Ready will be emitted when it is available.
+	 */
+	std::shared_ptr<const ThumbnailStrip> get (std::shared_ptr<const Film> film, std::shared_ptr<const Content> content);
+
+	/** Emitted, in the UI thread, with the result of Film::thumbnails_path() for some content
+	 *  when its strip is ready.
+	 */
+	boost::signals2::signal<void (boost::filesystem::path)> Ready;
+
+	static ThumbnailStripMaker* instance ();
+
+private:
+	ThumbnailStripMaker ();
+
+	void thread ();
+
+	struct Request
+	{
+		boost::filesystem::path path;
+		std::weak_ptr<const Film> film;
+		std::weak_ptr<const Content> content;
+	};
+
+	boost::thread _thread;
+	/** mutex to protect _queue, _cache, _recent and _failed */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	std::list<Request> _queue;
+	/** strips by path */
+	std::map<boost::filesystem::path, std::shared_ptr<const ThumbnailStrip>> _cache;
+	/** Keys of _cache, most recently used first */
+	std::list<boost::filesystem::path> _recent;
+	/** paths of strips that we could not make, so that we don't keep trying */
+	std::set<boost::filesystem::path> _failed;
+
+	static int const _cache_size;
+	static ThumbnailStripMaker* _instance;
+};
+
+
+#endif
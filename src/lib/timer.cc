@@ -26,6 +26,7 @@
 
 #include "compose.hpp"
 #include "timer.h"
+#include "trace.h"
 #include "util.h"
 #include <sys/time.h>
 #include <iostream>
@@ -44,6 +45,7 @@ using boost::optional;
 /** @param n Name to use when giving output */
 PeriodTimer::PeriodTimer (string n)
 	: _name (n)
+	, _trace_start (Trace::now())
 {
 	gettimeofday (&_start, 0);
 }
@@ -54,6 +56,10 @@ PeriodTimer::~PeriodTimer ()
 {
 	struct timeval stop;
 	gettimeofday (&stop, 0);
+	if (Trace::enabled()) {
+		auto trace = Trace::instance();
+		trace->record(trace->intern(_name), _trace_start, Trace::now(), -1);
+	}
 	cout << N_("T: ") << _name << N_(": ") << (seconds (stop) - seconds (_start)) << N_("\n");
 }
 
@@ -64,6 +70,7 @@ StateTimer::StateTimer (string n, string s)
 	struct timeval t;
 	gettimeofday (&t, 0);
 	_time = seconds (t);
+	_trace_time = Trace::now();
 	_state = s;
 }
 
@@ -90,6 +97,13 @@ StateTimer::set_internal (optional<string> s)
 	gettimeofday (&t, 0);
 	_time = seconds (t);
 
+	auto const trace_last = _trace_time;
+	_trace_time = Trace::now();
+	if (_state && Trace::enabled()) {
+		auto trace = Trace::instance();
+		trace->record(trace->intern(_name + ": " + *_state), trace_last, _trace_time, -1);
+	}
+
 	if (s && _counts.find(*s) == _counts.end()) {
 		_counts[*s] = Counts();
 	}
@@ -30,14 +30,17 @@
 
 #include <sys/time.h>
 #include <boost/optional.hpp>
-#include <string>
+#include <cstdint>
 #include <map>
+#include <string>
 
 
 /** @class PeriodTimer
  *  @brief A class to allow timing of a period within the caller.
  *
- *  On destruction, it will output the time since its construction.
+ *  On destruction, it will output the time since its construction, and
+ *  record it as a span if a Trace is running.  TraceSpan is cheaper
+ *  for new code.
  */
 class PeriodTimer
 {
@@ -51,6 +54,8 @@ private:
 	std::string _name;
 	/** time that this class was constructed */
 	struct timeval _start;
+	/** time that this class was constructed, according to Trace::now() */
+	int64_t _trace_start;
 };
 
 
@@ -61,6 +66,8 @@ private:
  *  Once constructed, the caller can call set_state() whenever
  *  its state changes.	When StateTimer is destroyed, it will
  *  output (to cout) a summary of the time spent in each state.
+ *  If a Trace is running each visit to a state is also recorded
+ *  as a span.
  */
 class StateTimer
 {
@@ -100,6 +107,8 @@ private:
 	boost::optional<std::string> _state;
 	/** time that _state was entered */
 	double _time;
+	/** time that _state was entered, according to Trace::now() */
+	int64_t _trace_time = 0;
 	/** total time and number of entries for each state */
 	std::map<std::string, Counts> _counts;
 };
@@ -0,0 +1,212 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "exceptions.h"
+#include "trace.h"
+#include <dcp/file.h>
+#include <boost/thread/once.hpp>
+#include <chrono>
+#include <cerrno>
+
+
+using std::make_shared;
+using std::string;
+
+
+std::atomic<bool> Trace::_enabled(false);
+Trace* Trace::_instance = nullptr;
+size_t const Trace::_buffer_size = 16384;
+static boost::once_flag instance_once = BOOST_ONCE_INIT;
+
+/** Name of this thread as given to set_thread_name() */
+static thread_local string thread_name;
+/** This thread's buffer, or nullptr if it has not yet recorded anything */
+static thread_local void* thread_buffer = nullptr;
+
+
+Trace*
+Trace::instance ()
+{
+	boost::call_once (instance_once, []() {
+		_instance = new Trace ();
+	});
+
+	return _instance;
+}
+
+
+int64_t
+Trace::now ()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void
+Trace::set_thread_name (string name)
+{
+	thread_name = name;
+}
+
+
+void
+Trace::start (boost::filesystem::path output)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_output = output;
+	_enabled = true;
+}
+
+
+void
+Trace::stop ()
+{
+	_enabled = false;
+}
+
+
+Trace::Buffer*
+Trace::buffer ()
+{
+	if (!thread_buffer) {
+		auto buffer = make_shared<Buffer>();
+		buffer->thread_name = thread_name;
+		buffer->events.resize (_buffer_size);
+		boost::mutex::scoped_lock lm (_mutex);
+		buffer->id = _buffers.size() + 1;
+		_buffers.push_back (buffer);
+		thread_buffer = buffer.get();
+	}
+
+	return static_cast<Buffer*>(thread_buffer);
+}
+
+
+void
+Trace::record (char const* name, int64_t start, int64_t end, int64_t frame)
+{
+	auto b = buffer ();
+	boost::mutex::scoped_lock lm (b->mutex);
+	b->events[b->next] = { name, start, end - start, frame };
+	if (++b->next == b->events.size()) {
+		b->next = 0;
+		b->wrapped = true;
+	}
+}
+
+
+char const*
+Trace::intern (string name)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _names.insert(name).first->c_str();
+}
+
+
+void
+Trace::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	for (auto i: _buffers) {
+		boost::mutex::scoped_lock lm2 (i->mutex);
+		i->next = 0;
+		i->wrapped = false;
+	}
+}
+
+
+static
+string
+escape (string s)
+{
+	string out;
+	for (auto c: s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+		}
+		if (static_cast<unsigned char>(c) >= 0x20) {
+			out += c;
+		}
+	}
+	return out;
+}
+
+
+void
+Trace::write () const
+{
+	boost::optional<boost::filesystem::path> output;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		output = _output;
+	}
+
+	if (_enabled && output) {
+		write (*output);
+	}
+}
+
+
+void
+Trace::write (boost::filesystem::path output) const
+{
+	dcp::File f(output, "w");
+	if (!f) {
+		throw OpenFileError (output, errno, OpenFileError::WRITE);
+	}
+
+	string const start = "{\"traceEvents\":[\n";
+	f.checked_write (start.c_str(), start.length());
+
+	bool first = true;
+	auto write_event = [&f, &first](string const& event) {
+		auto const line = (first ? string() : string(",\n")) + event;
+		f.checked_write (line.c_str(), line.length());
+		first = false;
+	};
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	for (auto i: _buffers) {
+		boost::mutex::scoped_lock lm2 (i->mutex);
+
+		auto const tid = std::to_string(i->id);
+
+		if (!i->thread_name.empty()) {
+			write_event ("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":\"" + escape(i->thread_name) + "\"}}");
+		}
+
+		auto const count = i->wrapped ? i->events.size() : i->next;
+		auto const first_event = i->wrapped ? i->next : 0;
+		for (size_t j = 0; j < count; ++j) {
+			auto const& event = i->events[(first_event + j) % i->events.size()];
+			auto json = "{\"name\":\"" + escape(event.name) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid +
+				",\"ts\":" + std::to_string(event.start) + ",\"dur\":" + std::to_string(event.duration);
+			if (event.frame >= 0) {
+				json += ",\"args\":{\"frame\":" + std::to_string(event.frame) + "}";
+			}
+			write_event (json + "}");
+		}
+	}
+
+	string const end = "\n]}\n";
+	f.checked_write (end.c_str(), end.length());
+}
@@ -0,0 +1,154 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_TRACE_H
+#define DCPOMATIC_TRACE_H
+
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+
+/** @class Trace
+ *  @brief Recorder of timed spans of work (decoding, encoding, writing and so on) in each thread,
+ *  which can be written out in the JSON format that Chrome's about:tracing and Perfetto read.
+ *
+ *  Each thread records into its own fixed-size ring buffer, so when tracing is on
+ *  the most recent spans from each thread are kept.  When it is off a TraceSpan costs
+ *  one atomic load.
+ */
+class Trace
+{
+public:
+	Trace (Trace const&) = delete;
+	Trace& operator= (Trace const&) = delete;
+
+	static bool enabled () {
+		return _enabled;
+	}
+
+	/** Start tracing; something must later call write() to save what was recorded.
+	 *  @param output File to write to when write() is called.
+	 */
+	void start (boost::filesystem::path output);
+	void stop ();
+
+	/** Write everything recorded so far to the file given to start(), if tracing is on */
+	void write () const;
+	void write (boost::filesystem::path output) const;
+
+	/** Remove all recorded spans */
+	void clear ();
+
+	void record (char const* name, int64_t start, int64_t end, int64_t frame);
+
+	/** @return A copy of name which will live as long as the Trace, for use as a span name */
+	char const* intern (std::string name);
+
+	/** Set the name that will be given to the calling thread in the trace */
+	static void set_thread_name (std::string name);
+
+	/** @return Microseconds since some fixed time */
+	static int64_t now ();
+
+	static Trace* instance ();
+
+private:
+	Trace () = default;
+
+	struct Event
+	{
+		char const* name;
+		int64_t start;
+		int64_t duration;
+		int64_t frame;
+	};
+
+	struct Buffer
+	{
+		int id;
+		std::string thread_name;
+		/** protects events and next; only contended while the trace is being written */
+		boost::mutex mutex;
+		std::vector<Event> events;
+		/** index in events of the next event to write */
+		size_t next = 0;
+		bool wrapped = false;
+	};
+
+	Buffer* buffer ();
+
+	mutable boost::mutex _mutex;
+	/** buffers for every thread which has recorded anything */
+	std::vector<std::shared_ptr<Buffer>> _buffers;
+	boost::optional<boost::filesystem::path> _output;
+	/** span names given to intern() */
+	std::set<std::string> _names;
+
+	static std::atomic<bool> _enabled;
+	static Trace* _instance;
+	/** number of events that each thread's buffer can hold */
+	static size_t const _buffer_size;
+};
+
+
+/** @class TraceSpan
+ *  @brief Record the time from construction to destruction as a span in the Trace.
+ */
+class TraceSpan
+{
+public:
+	/** @param name Name of span; this must be a string literal (or otherwise live forever).
+	 *  @param frame Index of the frame this span is working on, or -1.
+	 */
+	explicit TraceSpan (char const* name, int64_t frame = -1)
+		: _frame (frame)
+	{
+		if (Trace::enabled()) {
+			_name = name;
+			_start = Trace::now();
+		}
+	}
+
+	~TraceSpan ()
+	{
+		if (_name) {
+			Trace::instance()->record(_name, _start, Trace::now(), _frame);
+		}
+	}
+
+	TraceSpan (TraceSpan const&) = delete;
+	TraceSpan& operator= (TraceSpan const&) = delete;
+
+private:
+	char const* _name = nullptr;
+	int64_t _start = 0;
+	int64_t _frame;
+};
+
+
+#endif
@@ -29,12 +29,15 @@
 #include "content.h"
 #include "config.h"
 #include "dcp_encoder.h"
+#include "dcp_rewrap_encoder.h"
 #include "dcpomatic_log.h"
 #include "encoder.h"
 #include "examine_content_job.h"
 #include "film.h"
 #include "job_manager.h"
 #include "log.h"
+#include "memory_budget.h"
+#include "trace.h"
 #include "transcode_job.h"
 #include "upload_job.h"
 #include <iomanip>
@@ -57,6 +60,7 @@ using std::dynamic_pointer_cast;
 TranscodeJob::TranscodeJob (shared_ptr<const Film> film, ChangedBehaviour changed)
 	: Job (film)
 	, _changed (changed)
+	, _encoding_finished (false)
 {
 
 }
@@ -89,6 +93,17 @@ TranscodeJob::set_encoder (shared_ptr<Encoder> e)
 }
 
 
+/** Called from the job thread by the encoder when it has finished encoding, and is
+ *  just going to write its output.
+ */
+void
+TranscodeJob::encoding_finished ()
+{
+	_encoding_finished = true;
+	ResourceChanged ();
+}
+
+
 void
 TranscodeJob::run ()
 {
@@ -123,6 +138,13 @@ TranscodeJob::run ()
 		gettimeofday (&start, 0);
 		LOG_GENERAL_NC (N_("Transcode job starting"));
 
+		if (auto trace_file = Config::instance()->trace_file()) {
+			Trace::instance()->clear();
+			Trace::instance()->start(*trace_file);
+		}
+
+		MemoryBudget::instance()->reset_peaks();
+
 		DCPOMATIC_ASSERT (_encoder);
 		_encoder->go ();
 
@@ -135,8 +157,24 @@ TranscodeJob::run ()
 		}
 
 		LOG_GENERAL (N_("Transcode job completed successfully: %1 fps"), dcp::locale_convert<string>(fps, 2, true));
+		LOG_GENERAL_NC (MemoryBudget::instance()->report());
 
-		if (dynamic_pointer_cast<DCPEncoder>(_encoder)) {
+		if (auto report = _encoder->performance_report()) {
+			try {
+				report->add_to(_film->file("performance.xml"));
+			} catch (FileError& e) {
+				LOG_WARNING (N_("Failed to write performance report (%1)"), e.what());
+			}
+			set_report (report->summary());
+		}
+
+		try {
+			Trace::instance()->write();
+		} catch (FileError& e) {
+			LOG_WARNING (N_("Failed to write trace (%1)"), e.what());
+		}
+
+		if (dynamic_pointer_cast<DCPEncoder>(_encoder) || dynamic_pointer_cast<DCPRewrapEncoder>(_encoder)) {
 			try {
 				Analytics::instance()->successful_dcp_encode();
 			} catch (FileError& e) {
@@ -152,6 +190,7 @@ TranscodeJob::run ()
 		set_state (FINISHED_OK);
 
 	} catch (...) {
+		LOG_GENERAL_NC (MemoryBudget::instance()->report());
 		_encoder.reset ();
 		throw;
 	}
@@ -175,6 +214,10 @@ TranscodeJob::status () const
 		status += String::compose(_("; %1 fps"), dcp::locale_convert<string>(*fps, 1, true));
 	}
 
+	if (auto const warning = _encoder->warning()) {
+		status += "; " + *warning;
+	}
+
 	return status;
 }
 
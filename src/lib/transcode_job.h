@@ -29,6 +29,7 @@
 
 
 #include "job.h"
+#include <boost/atomic.hpp>
 
 
 /* Defined by Windows */
@@ -61,7 +62,15 @@ public:
 		return true;
 	}
 
+	/** While we are encoding we use Resource::ENCODE; after that we are just writing
+	 *  and hashing the output, so the next encode can start.
+	 */
+	Resource resource () const override {
+		return _encoding_finished ? Resource::DISK : Resource::ENCODE;
+	}
+
 	void set_encoder (std::shared_ptr<Encoder> t);
+	void encoding_finished ();
 
 private:
 	virtual void post_transcode () {}
@@ -70,6 +79,7 @@ private:
 
 	std::shared_ptr<Encoder> _encoder;
 	ChangedBehaviour _changed;
+	boost::atomic<bool> _encoding_finished;
 };
 
 
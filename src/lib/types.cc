@@ -85,6 +85,38 @@ string_to_resolution (string s)
 	return Resolution::TWO_K;
 }
 
+
+string
+disk_verification_to_string (DiskVerification verification)
+{
+	switch (verification) {
+	case DiskVerification::FULL:
+		return "full";
+	case DiskVerification::FAST:
+		return "fast";
+	case DiskVerification::SAMPLED:
+		return "sampled";
+	}
+
+	DCPOMATIC_ASSERT (false);
+}
+
+
+DiskVerification
+string_to_disk_verification (string s)
+{
+	if (s == "full") {
+		return DiskVerification::FULL;
+	} else if (s == "fast") {
+		return DiskVerification::FAST;
+	} else if (s == "sampled") {
+		return DiskVerification::SAMPLED;
+	}
+
+	DCPOMATIC_ASSERT (false);
+	return DiskVerification::FULL;
+}
+
 Crop::Crop (shared_ptr<cxml::Node> node)
 {
 	left = node->number_child<int> ("LeftCrop");
@@ -48,7 +48,16 @@ namespace xmlpp {
  *  64 - first version used
  *  65 - v2.16.0 - checksums added to communication
  */
-#define SERVER_LINK_VERSION (64+1)
+#define SERVER_LINK_VERSION (64+9)
+
+/** Ways of describing a frame that is sent to an encoding server */
+enum class EncodeRequestFormat
+{
+	/** an XML document; easy to debug, and still accepted by servers */
+	XML,
+	/** a BinaryDescriptorWriter block, which is much quicker to write and read */
+	BINARY
+};
 
 /** A film of F seconds at f FPS will be Ff frames;
     Consider some delta FPS d, so if we run the same
@@ -236,6 +245,19 @@ enum class Resolution {
 std::string resolution_to_string (Resolution);
 Resolution string_to_resolution (std::string);
 
+/** How the disk writer checks what it has written to a drive */
+enum class DiskVerification {
+	/** read everything back and compare its MD5 with that of the data that was written */
+	FULL,
+	/** read everything back and compare CRC-32C, which is quicker to calculate than MD5 */
+	FAST,
+	/** read back only a sample of the blocks that were written, and compare their MD5s */
+	SAMPLED
+};
+
+std::string disk_verification_to_string (DiskVerification);
+DiskVerification string_to_disk_verification (std::string);
+
 enum class FileTransferProtocol {
 	SCP,
 	FTP
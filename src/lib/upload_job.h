@@ -36,6 +36,9 @@ public:
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::NETWORK;
+	}
 	std::string status () const override;
 
 private:
@@ -22,6 +22,9 @@
 #include "uploader.h"
 #include "dcpomatic_assert.h"
 #include "compose.hpp"
+#include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
 
 #include "i18n.h"
 
@@ -29,6 +32,7 @@
 using std::string;
 using std::shared_ptr;
 using std::function;
+using std::vector;
 
 
 Uploader::Uploader (function<void (string)> set_status, function<void (float)> set_progress)
@@ -58,26 +62,148 @@ Uploader::count_file_sizes (boost::filesystem::path directory) const
 }
 
 
+int
+upload_stage (boost::filesystem::path file)
+{
+	auto const name = file.filename().string();
+	if (boost::algorithm::starts_with(name, "ASSETMAP") || boost::algorithm::starts_with(name, "VOLINDEX")) {
+		return 2;
+	} else if (boost::algorithm::iends_with(name, ".xml")) {
+		return 1;
+	}
+	return 0;
+}
+
+
 void
 Uploader::upload (boost::filesystem::path directory)
 {
+	FileList files;
+	upload_directory (directory.parent_path(), directory, files);
+
+	/* Send each stage in turn, so that (for example) nothing refers to an asset
+	 * until the whole of that asset is on the server.
+	 */
+	boost::uintmax_t const total_size = count_file_sizes(directory);
 	boost::uintmax_t transferred = 0;
-	upload_directory (directory.parent_path(), directory, transferred, count_file_sizes(directory));
+	for (int stage = 0; stage <= 2; ++stage) {
+		FileList stage_files;
+		std::copy_if (files.begin(), files.end(), std::back_inserter(stage_files), [stage](FileList::value_type const& file) {
+			return upload_stage(file.first) == stage;
+		});
+		upload_files (stage_files, transferred, total_size);
+	}
+}
+
+
+/** Upload one file from a directory, creating the remote directory (and any others that the
+ *  file is in) first if we have not already done so.
+ *  @param directory Directory that is being uploaded, as passed to upload (boost::filesystem::path).
+ *  @param file File within @p directory.
+ */
+void
+Uploader::upload (boost::filesystem::path directory, boost::filesystem::path file, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+{
+	auto const base = directory.parent_path();
+
+	boost::filesystem::path remote;
+	for (auto i: remove_prefix(base, file.parent_path())) {
+		remote /= i;
+		if (_created_directories.find(remote) == _created_directories.end()) {
+			create_directory (remote);
+			_created_directories.insert (remote);
+		}
+	}
+
+	_set_status (String::compose(_("copying %1"), file.leaf()));
+
+	boost::uintmax_t done = 0;
+	upload_file (file, remove_prefix(base, file), [this, &transferred, &done, total_size](boost::uintmax_t now) {
+		transferred = transferred - done + now;
+		done = now;
+		if (total_size > 0) {
+			_set_progress ((double) transferred / total_size);
+		}
+	});
 }
 
 
+/** Create the remote directories for a directory that we are uploading, and find the files in it */
 void
-Uploader::upload_directory (boost::filesystem::path base, boost::filesystem::path directory, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+Uploader::upload_directory (boost::filesystem::path base, boost::filesystem::path directory, FileList& files)
 {
 	using namespace boost::filesystem;
 
 	create_directory (remove_prefix(base, directory));
 	for (auto i: directory_iterator(directory)) {
 		if (is_directory(i.path())) {
-			upload_directory (base, i.path(), transferred, total_size);
+			upload_directory (base, i.path(), files);
 		} else {
-			_set_status (String::compose(_("copying %1"), i.path().leaf()));
-			upload_file (i.path(), remove_prefix (base, i.path()), transferred, total_size);
+			files.push_back ({i.path(), remove_prefix(base, i.path())});
+		}
+	}
+}
+
+
+/** Upload some files, using as many threads as parallel_uploads() allows.
+ *  @param files Local and remote paths of each file.
+ */
+void
+Uploader::upload_files (FileList const& files, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+{
+	boost::mutex mutex;
+
+	auto send = [this, &mutex, &transferred, total_size](boost::filesystem::path from, boost::filesystem::path to) {
+		{
+			boost::mutex::scoped_lock lm (mutex);
+			_set_status (String::compose(_("copying %1"), from.leaf()));
+		}
+
+		boost::uintmax_t done = 0;
+		upload_file (from, to, [this, &mutex, &transferred, &done, total_size](boost::uintmax_t now) {
+			boost::mutex::scoped_lock lm (mutex);
+			transferred = transferred - done + now;
+			done = now;
+			if (total_size > 0) {
+				_set_progress ((double) transferred / total_size);
+			}
+		});
+	};
+
+	auto const threads = std::min(static_cast<size_t>(std::max(1, parallel_uploads())), files.size());
+	if (threads <= 1) {
+		for (auto const& i: files) {
+			send (i.first, i.second);
+		}
+		return;
+	}
+
+	vector<std::exception_ptr> errors (files.size());
+	std::atomic<size_t> next (0);
+	std::atomic<bool> failed (false);
+
+	boost::thread_group pool;
+	for (size_t i = 0; i < threads; ++i) {
+		pool.create_thread ([&files, &errors, &next, &failed, &send]() {
+			while (!failed) {
+				auto const i = next++;
+				if (i >= files.size()) {
+					return;
+				}
+				try {
+					send (files[i].first, files[i].second);
+				} catch (...) {
+					errors[i] = std::current_exception ();
+					failed = true;
+				}
+			}
+		});
+	}
+	pool.join_all ();
+
+	for (auto const& i: errors) {
+		if (i) {
+			std::rethrow_exception (i);
 		}
 	}
 }
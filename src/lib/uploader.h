@@ -24,6 +24,10 @@
 
 
 #include <boost/filesystem.hpp>
+#include <functional>
+#include <set>
+#include <utility>
+#include <vector>
 
 
 class Job;
@@ -36,20 +40,41 @@ public:
 	virtual ~Uploader () {}
 
 	void upload (boost::filesystem::path directory);
+	void upload (boost::filesystem::path directory, boost::filesystem::path file, boost::uintmax_t& transferred, boost::uintmax_t total_size);
 
 protected:
 
 	virtual void create_directory (boost::filesystem::path directory) = 0;
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size) = 0;
+	/** Upload one file.  If parallel_uploads() is more than 1 this may be called from several threads at once.
+	 *  @param progress Function to call with the number of bytes of the file that have been sent so far.
+	 */
+	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, std::function<void (boost::uintmax_t)> progress) = 0;
+
+	/** @return Number of files that upload_file() can be sending at the same time */
+	virtual int parallel_uploads () const {
+		return 1;
+	}
 
 	std::function<void (float)> _set_progress;
 
 private:
-	void upload_directory (boost::filesystem::path base, boost::filesystem::path directory, boost::uintmax_t& transferred, boost::uintmax_t total_size);
+	typedef std::vector<std::pair<boost::filesystem::path, boost::filesystem::path>> FileList;
+
+	void upload_directory (boost::filesystem::path base, boost::filesystem::path directory, FileList& files);
+	void upload_files (FileList const& files, boost::uintmax_t& transferred, boost::uintmax_t total_size);
 	boost::uintmax_t count_file_sizes (boost::filesystem::path) const;
 	boost::filesystem::path remove_prefix (boost::filesystem::path prefix, boost::filesystem::path target) const;
 
 	std::function<void (std::string)> _set_status;
+	/** remote directories that upload() of a single file has created */
+	std::set<boost::filesystem::path> _created_directories;
 };
 
+/** @return The stage of a DCP upload at which a file should be sent: its assets first, then
+ *  its CPLs and PKLs, and finally the ASSETMAP and VOLINDEX, which a TMS watching its ingest
+ *  folder will take as the sign that the DCP has arrived.
+ */
+extern int upload_stage (boost::filesystem::path file);
+
+
 #endif
@@ -22,6 +22,7 @@
 #include "upmixer_a.h"
 #include "audio_buffers.h"
 #include "audio_mapping.h"
+#include "maths_util.h"
 
 #include "i18n.h"
 
@@ -76,32 +77,37 @@ UpmixerA::clone (int sampling_rate) const
 shared_ptr<AudioBuffers>
 UpmixerA::run (shared_ptr<const AudioBuffers> in, int channels)
 {
+	int const frames = in->frames();
+
 	/* Input L and R */
-	auto in_L = in->channel (0);
-	auto in_R = in->channel (1);
+	auto const in_L = in->data(0);
+	auto const in_R = in->data(1);
 
 	/* Mix of L and R; -6dB down in amplitude (3dB in terms of power) */
-	auto in_LR = in_L->clone ();
-	in_LR->accumulate_frames (in_R.get(), in_R->frames(), 0, 0);
-	in_LR->apply_gain (-6);
-
-	/* Run filters */
-	vector<shared_ptr<AudioBuffers>> all_out;
-	all_out.push_back (_left.run(in_L));
-	all_out.push_back (_right.run(in_R));
-	all_out.push_back (_centre.run(in_LR));
-	all_out.push_back (_lfe.run(in_LR));
-	all_out.push_back (_ls.run(in_L));
-	all_out.push_back (_rs.run(in_R));
-
-	auto out = make_shared<AudioBuffers>(channels, in->frames());
-	int const N = min (channels, 6);
-
-	for (int i = 0; i < N; ++i) {
-		out->copy_channel_from (all_out[i].get(), 0, i);
+	float const gain = db_to_linear(-6);
+	_mix.resize (frames);
+	for (int i = 0; i < frames; ++i) {
+		_mix[i] = (in_L[i] + in_R[i]) * gain;
 	}
 
-	for (int i = N; i < channels; ++i) {
+	auto out = make_shared<AudioBuffers>(channels, frames);
+
+	/* Run each filter straight into its output channel, and to a scratch buffer if that channel isn't wanted
+	 * (so that the filters still see all the input)
+	 */
+	_spare.resize (frames);
+	auto output = [this, &out, channels](int channel) {
+		return channel < channels ? out->data(channel) : _spare.data();
+	};
+
+	_left.run (in_L, frames, output(0));
+	_right.run (in_R, frames, output(1));
+	_centre.run (_mix.data(), frames, output(2));
+	_lfe.run (_mix.data(), frames, output(3));
+	_ls.run (in_L, frames, output(4));
+	_rs.run (in_R, frames, output(5));
+
+	for (int i = 6; i < channels; ++i) {
 		out->make_silent (i);
 	}
 
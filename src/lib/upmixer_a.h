@@ -52,4 +52,7 @@ private:
 	LowPassAudioFilter _lfe;
 	BandPassAudioFilter _ls;
 	BandPassAudioFilter _rs;
+	/** buffers for run(), kept so that we don't allocate them for every block */
+	std::vector<float> _mix;
+	std::vector<float> _spare;
 };
@@ -22,6 +22,8 @@
 #include "upmixer_b.h"
 #include "audio_buffers.h"
 #include "audio_mapping.h"
+#include "maths_util.h"
+#include <algorithm>
 
 #include "i18n.h"
 
@@ -36,6 +38,7 @@ using std::shared_ptr;
 UpmixerB::UpmixerB (int sampling_rate)
 	: _lfe (0.01, 150.0 / sampling_rate)
 	, _delay (0.02 * sampling_rate)
+	, _difference (std::make_shared<AudioBuffers>(1, 0))
 {
 
 }
@@ -72,50 +75,54 @@ UpmixerB::clone (int sampling_rate) const
 shared_ptr<AudioBuffers>
 UpmixerB::run (shared_ptr<const AudioBuffers> in, int channels)
 {
-	auto out = make_shared<AudioBuffers>(channels, in->frames());
-
-	/* L + R minus 6dB (in terms of amplitude) */
-	auto in_LR = in->channel(0);
-	in_LR->accumulate_frames (in->channel(1).get(), in->frames(), 0, 0);
-	in_LR->apply_gain (-6);
+	int const frames = in->frames();
+	auto out = make_shared<AudioBuffers>(channels, frames);
+
+	auto const L = in->data(0);
+	auto const R = in->data(1);
+
+	/* Make L + R minus 6dB (in terms of amplitude) and L - R in one pass */
+	float const gain = db_to_linear(-6);
+	_mix.resize (frames);
+	_difference->set_frames (frames);
+	auto difference = _difference->data(0);
+	for (int i = 0; i < frames; ++i) {
+		_mix[i] = (L[i] + R[i]) * gain;
+		difference[i] = L[i] - R[i];
+	}
 
 	if (channels > 0) {
 		/* L = Lt */
-		out->copy_channel_from (in.get(), 0, 0);
+		std::copy (L, L + frames, out->data(0));
 	}
 
 	if (channels > 1) {
 		/* R = Rt */
-		out->copy_channel_from (in.get(), 1, 1);
+		std::copy (R, R + frames, out->data(1));
 	}
 
 	if (channels > 2) {
 		/* C = L + R minus 3dB */
-		out->copy_channel_from (in_LR.get(), 0, 2);
+		std::copy (_mix.begin(), _mix.end(), out->data(2));
 	}
 
 	if (channels > 3) {
 		/* Lfe is filtered C */
-		out->copy_channel_from (_lfe.run(in_LR).get(), 0, 3);
+		_lfe.run (_mix.data(), frames, out->data(3));
 	}
 
-	shared_ptr<AudioBuffers> S;
 	if (channels > 4) {
 		/* Ls is L - R with some delay */
-		auto sub = make_shared<AudioBuffers>(1, in->frames());
-		sub->copy_channel_from (in.get(), 0, 0);
-		float* p = sub->data (0);
-		float const * q = in->data (1);
-		for (int i = 0; i < in->frames(); ++i) {
-			*p++ -= *q++;
-		}
-		S = _delay.run (sub);
+		auto S = _delay.run (_difference);
 		out->copy_channel_from (S.get(), 0, 4);
+		if (channels > 5) {
+			/* Rs = Ls */
+			out->copy_channel_from (S.get(), 0, 5);
+		}
 	}
 
-	if (channels > 5) {
-		/* Rs = Ls */
-		out->copy_channel_from (S.get(), 0, 5);
+	for (int i = 6; i < channels; ++i) {
+		out->make_silent (i);
 	}
 
 	return out;
@@ -46,5 +46,8 @@ public:
 private:
 	LowPassAudioFilter _lfe;
 	AudioDelay _delay;
+	/** buffers for run(), kept so that we don't allocate them for every block */
+	std::vector<float> _mix;
+	std::shared_ptr<AudioBuffers> _difference;
 };
 
@@ -31,10 +31,12 @@
 #include "cinema_sound_processor.h"
 #include "compose.hpp"
 #include "config.h"
+#include "cpu_dispatch.h"
 #include "cross.h"
 #include "crypto.h"
 #include "dcp_content_type.h"
 #include "dcpomatic_log.h"
+#include "digest_cache.h"
 #include "digester.h"
 #include "exceptions.h"
 #include "ffmpeg_image_proxy.h"
@@ -43,14 +45,17 @@
 #include "image.h"
 #include "job.h"
 #include "job_manager.h"
+#include "maths_util.h"
 #include "ratio.h"
 #include "rect.h"
 #include "render_text.h"
 #include "string_text.h"
 #include "text_decoder.h"
+#include "trace.h"
 #include "util.h"
 #include "video_content.h"
 #include <dcp/atmos_asset.h>
+#include <dcp/data.h>
 #include <dcp/decrypted_kdm.h>
 #include <dcp/locale_convert.h>
 #include <dcp/picture_asset.h>
@@ -87,6 +92,7 @@ LIBDCP_ENABLE_WARNINGS
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <future>
 #include <climits>
 #include <stdexcept>
 #ifdef DCPOMATIC_POSIX
@@ -117,7 +123,6 @@ using boost::thread;
 using boost::optional;
 using boost::lexical_cast;
 using boost::bad_lexical_cast;
-using boost::scoped_array;
 using dcp::Size;
 using dcp::raw_convert;
 using dcp::locale_convert;
@@ -363,6 +368,12 @@ dcpomatic_setup_path_encoding ()
 /** Call the required functions to set up DCP-o-matic's static arrays, etc.
  *  Must be called from the UI thread, if there is one.
  */
+#if defined(DCPOMATIC_WINDOWS) || defined(DCPOMATIC_OSX)
+/** Thread which makes fontconfig's cache when we start up */
+static boost::thread font_cache_thread;
+#endif
+
+
 void
 dcpomatic_setup ()
 {
@@ -405,14 +416,23 @@ LIBDCP_ENABLE_WARNINGS
 	dcp::init (libdcp_resources_path());
 
 #if defined(DCPOMATIC_WINDOWS) || defined(DCPOMATIC_OSX)
-	/* Render something to fontconfig to create its cache */
-	list<StringText> subs;
-	dcp::SubtitleString ss(
-		optional<string>(), false, false, false, dcp::Colour(), 42, 1, dcp::Time(), dcp::Time(), 0, dcp::HAlign::CENTER, 0, dcp::VAlign::CENTER, 0, dcp::Direction::LTR,
-		"Hello dolly", dcp::Effect::NONE, dcp::Colour(), dcp::Time(), dcp::Time(), 0
-		);
-	subs.push_back (StringText(ss, 0, {}, dcp::Standard::SMPTE));
-	render_text (subs, dcp::Size(640, 480), DCPTime(), 24);
+	/* Render something to fontconfig to create its cache.  This can take a few seconds, and
+	   nothing needs it until some text is rendered (which will wait for fontconfig if need be)
+	   so do it in the background rather than holding up start-up.
+	*/
+	font_cache_thread = boost::thread([]() {
+		try {
+			list<StringText> subs;
+			dcp::SubtitleString ss(
+				optional<string>(), false, false, false, dcp::Colour(), 42, 1, dcp::Time(), dcp::Time(), 0, dcp::HAlign::CENTER, 0, dcp::VAlign::CENTER, 0, dcp::Direction::LTR,
+				"Hello dolly", dcp::Effect::NONE, dcp::Colour(), dcp::Time(), dcp::Time(), 0
+				);
+			subs.push_back (StringText(ss, 0, {}, dcp::Standard::SMPTE));
+			render_text (subs, dcp::Size(640, 480), DCPTime(), 24);
+		} catch (...) {
+			/* This was only to make the cache, so it doesn't matter */
+		}
+	});
 #endif
 
 	Ratio::setup_ratios ();
@@ -421,6 +441,7 @@ LIBDCP_ENABLE_WARNINGS
 	Filter::setup_filters ();
 	CinemaSoundProcessor::setup_cinema_sound_processors ();
 	AudioProcessor::setup_audio_processors ();
+	dcpomatic::cpu::setup ();
 
 	curl_global_init (CURL_GLOBAL_ALL);
 
@@ -484,59 +505,73 @@ dcpomatic_setup_gettext_i18n (string lang)
 }
 
 /** Compute a digest of the first and last `size' bytes of a set of files. */
-string
-digest_head_tail (vector<boost::filesystem::path> files, boost::uintmax_t size)
+/** Read up to @p size bytes from the start of @p files (taken as one long file) or, if
+ *  @p tail is true, the end.  The tail is read backwards, file by file.
+ */
+static vector<char>
+read_head_or_tail (vector<boost::filesystem::path> const& files, boost::uintmax_t size, bool tail)
 {
-	boost::scoped_array<char> buffer (new char[size]);
-	Digester digester;
+	vector<char> buffer (size);
 
-	/* Head */
 	boost::uintmax_t to_do = size;
-	char* p = buffer.get ();
-	int i = 0;
-	while (i < int64_t (files.size()) && to_do > 0) {
-		dcp::File f(files[i], "rb");
+	char* p = buffer.data();
+	int const count = files.size();
+	for (int j = 0; j < count && to_do > 0; ++j) {
+		auto const& file = files[tail ? count - j - 1 : j];
+		dcp::File f(file, "rb");
 		if (!f) {
-			throw OpenFileError (files[i].string(), errno, OpenFileError::READ);
+			throw OpenFileError (file.string(), errno, OpenFileError::READ);
 		}
 
-		boost::uintmax_t this_time = min (to_do, boost::filesystem::file_size (files[i]));
-		f.checked_read(p, this_time);
-		p += this_time;
- 		to_do -= this_time;
-
-		++i;
-	}
-	digester.add (buffer.get(), size - to_do);
-
-	/* Tail */
-	to_do = size;
-	p = buffer.get ();
-	i = files.size() - 1;
-	while (i >= 0 && to_do > 0) {
-		dcp::File f(files[i], "rb");
-		if (!f) {
-			throw OpenFileError (files[i].string(), errno, OpenFileError::READ);
+		boost::uintmax_t this_time = min (to_do, boost::filesystem::file_size(file));
+		if (tail) {
+			f.seek(-this_time, SEEK_END);
 		}
-
-		boost::uintmax_t this_time = min (to_do, boost::filesystem::file_size (files[i]));
-		f.seek(-this_time, SEEK_END);
 		f.checked_read(p, this_time);
 		p += this_time;
 		to_do -= this_time;
-
-		--i;
 	}
-	digester.add (buffer.get(), size - to_do);
+
+	buffer.resize (size - to_do);
+	return buffer;
+}
+
+
+string
+digest_head_tail (vector<boost::filesystem::path> files, boost::uintmax_t size)
+{
+	/* The files may be on a slow network drive, so read both ends at once */
+	auto tail = std::async(std::launch::async, [&files, size]() {
+		return read_head_or_tail(files, size, true);
+	});
+	auto const head = read_head_or_tail(files, size, false);
+
+	Digester digester;
+	digester.add (head.data(), head.size());
+	auto const tail_data = tail.get();
+	digester.add (tail_data.data(), tail_data.size());
 
 	return digester.get ();
 }
 
 
+/** @return A quick digest of the first and last megabyte of @p paths with the size of the first
+ *  file on the end; this comes from DigestCache if the files do not seem to have changed since
+ *  it was last calculated.
+ */
 string
 simple_digest (vector<boost::filesystem::path> paths)
 {
-	return digest_head_tail(paths, 1000000) + raw_convert<string>(boost::filesystem::file_size(paths.front()));
+	boost::uintmax_t const size = 1000000;
+
+	auto const key = DigestCache::key(paths, size);
+	if (auto digest = DigestCache::instance()->get(key)) {
+		return *digest;
+	}
+
+	auto const digest = digest_head_tail(paths, size) + raw_convert<string>(boost::filesystem::file_size(paths.front()));
+	DigestCache::instance()->put(key, digest);
+	return digest;
 }
 
 
@@ -645,6 +680,53 @@ valid_j2k_file (boost::filesystem::path f)
 	return (ext == ".j2k" || ext == ".j2c" || ext == ".jp2");
 }
 
+/** Check whether a frame of JPEG2000 data could go into a DCP without being re-encoded.  Only
+ *  the main header is looked at, so this is quick but not a complete check.
+ *  @param data JPEG2000 codestream.
+ *  @param frames_per_second Number of these frames that will be played each second (counting both eyes of 3D).
+ *  @param max_bandwidth Largest allowed bit rate, in bits per second.
+ *  @return true if the frame is small enough, and its SIZ marker says that it is a 12-bit, 3-component
+ *  codestream using a digital cinema profile.
+ */
+bool
+j2k_can_pass_through (dcp::Data const& data, int frames_per_second, int max_bandwidth)
+{
+	if (data.size() * 8 * int64_t(frames_per_second) > max_bandwidth) {
+		return false;
+	}
+
+	auto const p = data.data();
+	auto get16 = [p](int offset) {
+		return (p[offset] << 8) | p[offset + 1];
+	};
+
+	/* SOC and SIZ markers, then the fixed part of SIZ and 3 bytes for each of 3 components */
+	if (data.size() < 42 + 3 * 3 || get16(0) != 0xff4f || get16(2) != 0xff51) {
+		return false;
+	}
+
+	/* Rsiz: 3 is the 2K and 4 the 4K digital cinema profile */
+	auto const rsiz = get16(6);
+	if (rsiz != 3 && rsiz != 4) {
+		return false;
+	}
+
+	if (get16(40) != 3) {
+		return false;
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		auto const component = p + 42 + i * 3;
+		/* Ssiz 11 is 12-bit unsigned; there must be no subsampling */
+		if (component[0] != 11 || component[1] != 1 || component[2] != 1) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 string
 tidy_for_filename (string f)
 {
@@ -849,23 +931,55 @@ audio_channel_types (list<int> mapped, int channels)
 	return make_pair (non_lfe, lfe);
 }
 
+/** Mix some audio into a new set of channels according to an AudioMapping, applying a gain and
+ *  an optional fade on the way.
+ *  @param gain Linear gain to apply to the output.
+ *  @param fade Linear gain to apply to each frame of the output, or empty.
+ */
 shared_ptr<AudioBuffers>
-remap (shared_ptr<const AudioBuffers> input, int output_channels, AudioMapping map)
+remap (shared_ptr<const AudioBuffers> input, int output_channels, AudioMapping map, float gain, vector<float> const& fade)
 {
-	auto mapped = make_shared<AudioBuffers>(output_channels, input->frames());
-	mapped->make_silent ();
+	int const frames = input->frames();
+	DCPOMATIC_ASSERT (fade.empty() || static_cast<int>(fade.size()) == frames);
+
+	auto mapped = make_shared<AudioBuffers>(output_channels, frames);
 
-	int to_do = min (map.input_channels(), input->channels());
+	/* The mapping as a list of the non-zero gains, with the overall gain folded in */
+	struct Route
+	{
+		int input;
+		int output;
+		float gain;
+	};
 
+	vector<Route> routes;
+	vector<bool> output_used (output_channels);
+	int const to_do = min (map.input_channels(), input->channels());
 	for (int i = 0; i < to_do; ++i) {
-		for (int j = 0; j < mapped->channels(); ++j) {
-			if (map.get(i, j) > 0) {
-				mapped->accumulate_channel(
-					input.get(),
-					i,
-					j,
-					map.get(i, j)
-					);
+		for (int j = 0; j < output_channels; ++j) {
+			auto const g = map.get(i, j);
+			if (g > 0) {
+				routes.push_back ({ i, j, g * gain });
+				output_used[j] = true;
+			}
+		}
+	}
+
+	/* Mix a chunk at a time so that each chunk of input stays in the cache while all of its
+	 * outputs are made, and apply the fade to the mixed output (as mixing is linear) so that
+	 * it is only done once for each output channel.
+	 */
+	int const chunk = 1024;
+	for (int start = 0; start < frames; start += chunk) {
+		int const this_chunk = min(chunk, frames - start);
+		for (auto const& route: routes) {
+			accumulate_samples (mapped->data(route.output) + start, input->data(route.input) + start, this_chunk, route.gain);
+		}
+		if (!fade.empty()) {
+			for (int j = 0; j < output_channels; ++j) {
+				if (output_used[j]) {
+					multiply_samples (mapped->data(j) + start, fade.data() + start, this_chunk);
+				}
 			}
 		}
 	}
@@ -873,6 +987,7 @@ remap (shared_ptr<const AudioBuffers> input, int output_channels, AudioMapping m
 	return mapped;
 }
 
+
 Eyes
 increment_eyes (Eyes e)
 {
@@ -1020,10 +1135,17 @@ show_jobs_on_console (bool progress)
 	return error;
 }
 
-/** XXX: could use mmap? */
+/** Copy a file, reporting progress as we go.  If the filesystem can make a copy-on-write
+ *  clone of the file we do that instead, since it is instant and takes no extra space.
+ */
 void
 copy_in_bits (boost::filesystem::path from, boost::filesystem::path to, std::function<void (float)> progress)
 {
+	if (clone_file(from, to)) {
+		progress (1);
+		return;
+	}
+
 	dcp::File f(from, "rb");
 	if (!f) {
 		throw OpenFileError (from, errno, OpenFileError::READ);
@@ -1078,11 +1200,42 @@ scale_for_display (dcp::Size s, dcp::Size display_container, dcp::Size film_cont
 }
 
 
+/** KDMs that we have already decrypted, since decryption with our private key is slow and the same
+ *  KDM is decrypted every time its content is examined or decoded.  These are keyed by a digest of
+ *  the encrypted KDM and the key that was used, and never leave memory.
+ */
+static map<string, dcp::DecryptedKDM> decrypted_kdm_cache;
+static boost::mutex decrypted_kdm_cache_mutex;
+/** Maximum number of KDMs to keep in decrypted_kdm_cache */
+static size_t constexpr decrypted_kdm_cache_size = 64;
+
+
 dcp::DecryptedKDM
 decrypt_kdm_with_helpful_error (dcp::EncryptedKDM kdm)
 {
+	auto const private_key = Config::instance()->decryption_chain()->key().get();
+
+	Digester digester;
+	digester.add (kdm.as_xml());
+	digester.add (private_key);
+	auto const cache_key = digester.get();
+
+	{
+		boost::mutex::scoped_lock lm (decrypted_kdm_cache_mutex);
+		auto cached = decrypted_kdm_cache.find(cache_key);
+		if (cached != decrypted_kdm_cache.end()) {
+			return cached->second;
+		}
+	}
+
 	try {
-		return dcp::DecryptedKDM (kdm, Config::instance()->decryption_chain()->key().get());
+		dcp::DecryptedKDM decrypted (kdm, private_key);
+		boost::mutex::scoped_lock lm (decrypted_kdm_cache_mutex);
+		if (decrypted_kdm_cache.size() >= decrypted_kdm_cache_size) {
+			decrypted_kdm_cache.clear ();
+		}
+		decrypted_kdm_cache.emplace (cache_key, decrypted);
+		return decrypted;
 	} catch (dcp::KDMDecryptionError& e) {
 		/* Try to flesh out the error a bit */
 		auto const kdm_subject_name = kdm.recipient_x509_subject_name();
@@ -1145,14 +1298,62 @@ void
 start_of_thread (string name)
 {
 	std::cout << "THREAD:" << name << ":" << std::hex << pthread_self() << "\n";
+	Trace::set_thread_name (name);
 }
 #else
 void
-start_of_thread (string)
+start_of_thread (string name)
 {
+	Trace::set_thread_name (name);
+}
+#endif
+
 
+/** @return Space-separated list of the SIMD instruction sets that this machine's CPU supports */
+string
+simd_features ()
+{
+	string features;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	if (__builtin_cpu_supports("sse2")) {
+		features += "sse2 ";
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		features += "sse4.1 ";
+	}
+	if (__builtin_cpu_supports("avx")) {
+		features += "avx ";
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		features += "avx2 ";
+	}
+	if (__builtin_cpu_supports("avx512f")) {
+		features += "avx512f ";
+	}
+#elif defined(__aarch64__)
+	features += "neon ";
+#endif
+	boost::algorithm::trim (features);
+	return features;
 }
+
+
+/** @return The SIMD instruction set that this build was compiled to use, or "scalar" if none.
+ *  Kernels may still use better ones at run time; see cpu_dispatch.h.
+ */
+string
+simd_target ()
+{
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__SSE2__)
+	return "sse2";
+#elif defined(__ARM_NEON)
+	return "neon";
+#else
+	return "scalar";
 #endif
+}
 
 
 class LogSink : public Kumu::ILogSink
@@ -47,6 +47,7 @@
 
 
 namespace dcp {
+	class Data;
 	class PictureAsset;
 	class SoundAsset;
 	class SubtitleAsset;
@@ -99,6 +100,7 @@ extern std::string short_audio_channel_name (int);
 extern bool valid_image_file (boost::filesystem::path);
 extern bool valid_sound_file (boost::filesystem::path);
 extern bool valid_j2k_file (boost::filesystem::path);
+extern bool j2k_can_pass_through (dcp::Data const& data, int frames_per_second, int max_bandwidth);
 #ifdef DCPOMATIC_WINDOWS
 extern boost::filesystem::path mo_path ();
 #endif
@@ -113,7 +115,9 @@ extern std::string atmos_asset_filename (std::shared_ptr<dcp::AtmosAsset> asset,
 extern float relaxed_string_to_float (std::string);
 extern std::string careful_string_filter (std::string);
 extern std::pair<int, int> audio_channel_types (std::list<int> mapped, int channels);
-extern std::shared_ptr<AudioBuffers> remap (std::shared_ptr<const AudioBuffers> input, int output_channels, AudioMapping map);
+extern std::shared_ptr<AudioBuffers> remap (
+	std::shared_ptr<const AudioBuffers> input, int output_channels, AudioMapping map, float gain = 1, std::vector<float> const& fade = std::vector<float>()
+	);
 extern Eyes increment_eyes (Eyes e);
 extern size_t utf8_strlen (std::string s);
 extern std::string day_of_week_to_string (boost::gregorian::greg_weekday d);
@@ -125,6 +129,8 @@ extern dcp::DecryptedKDM decrypt_kdm_with_helpful_error (dcp::EncryptedKDM kdm);
 extern boost::filesystem::path default_font_file ();
 extern std::string to_upper (std::string s);
 extern void start_of_thread (std::string name);
+extern std::string simd_features ();
+extern std::string simd_target ();
 extern void capture_asdcp_logs ();
 extern std::string error_details(boost::system::error_code ec);
 extern bool contains_assetmap(boost::filesystem::path dir);
@@ -19,13 +19,38 @@
 */
 
 
+#include "compose.hpp"
 #include "cross.h"
 #include "verify_dcp_job.h"
 #include "content.h"
+#include "dcpomatic_assert.h"
+#include "util.h"
+#include <dcp/cpl.h>
+#include <dcp/dcp.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/reel.h>
+#include <dcp/reel_file_asset.h>
+#include <dcp/reel_picture_asset.h>
+#include <dcp/reel_sound_asset.h>
+#include <dcp/sound_asset.h>
+#include <dcp/stereo_picture_asset.h>
+#include <dcp/stereo_picture_asset_reader.h>
+#include <dcp/stereo_picture_frame.h>
+#include <boost/asio.hpp>
+#include <cmath>
+#include <map>
 
 #include "i18n.h"
 
 
+using std::dynamic_pointer_cast;
+using std::make_shared;
+using std::map;
+using std::max;
+using std::min;
+using std::pair;
 using std::string;
 using std::vector;
 using std::shared_ptr;
@@ -35,10 +60,13 @@ using namespace boost::placeholders;
 #endif
 
 
-VerifyDCPJob::VerifyDCPJob (vector<boost::filesystem::path> directories)
+VerifyDCPJob::VerifyDCPJob (vector<boost::filesystem::path> directories, Level level, float sample_rate)
 	: Job (shared_ptr<Film>())
 	, _directories (directories)
+	, _level (level)
+	, _sample_rate (sample_rate)
 {
+	DCPOMATIC_ASSERT (_sample_rate > 0 && _sample_rate <= 1);
 
 }
 
@@ -63,6 +91,23 @@ VerifyDCPJob::json_name () const
 }
 
 
+optional<VerifyDCPJob::Level>
+VerifyDCPJob::level_from_string (string s)
+{
+	if (s == "structure") {
+		return Level::STRUCTURE;
+	} else if (s == "hashes") {
+		return Level::HASHES;
+	} else if (s == "sampled-frames") {
+		return Level::SAMPLED_FRAMES;
+	} else if (s == "full") {
+		return Level::FULL;
+	}
+
+	return {};
+}
+
+
 void
 VerifyDCPJob::update_stage (string s, optional<boost::filesystem::path> path)
 {
@@ -73,13 +118,294 @@ VerifyDCPJob::update_stage (string s, optional<boost::filesystem::path> path)
 }
 
 
+/** Split some DCP directories up into groups that can be verified independently of each other.
+ *  A directory whose CPLs refer to assets in another directory (e.g. a VF and its OV) is put
+ *  in the same group as that other directory.
+ */
+vector<vector<boost::filesystem::path>>
+VerifyDCPJob::independent_groups (vector<boost::filesystem::path> directories)
+{
+	/* Index of the group that each directory is in */
+	vector<int> group(directories.size());
+	for (size_t i = 0; i < directories.size(); ++i) {
+		group[i] = i;
+	}
+
+	auto find = [&group](int i) {
+		while (group[i] != i) {
+			i = group[i];
+		}
+		return i;
+	};
+
+	/* Directory index of where each asset ID is found */
+	map<string, int> found;
+	/* Asset IDs that each directory refers to but does not have */
+	vector<pair<int, string>> missing;
+
+	try {
+		for (size_t i = 0; i < directories.size(); ++i) {
+			dcp::DCP dcp(directories[i]);
+			vector<dcp::VerificationNote> notes;
+			dcp.read(&notes);
+			for (auto cpl: dcp.cpls()) {
+				for (auto asset: cpl->reel_file_assets()) {
+					if (asset->asset_ref().resolved()) {
+						found[asset->asset_ref().id()] = i;
+					} else {
+						missing.push_back({static_cast<int>(i), asset->asset_ref().id()});
+					}
+				}
+			}
+		}
+	} catch (std::exception&) {
+		/* We'll let dcp::verify report whatever the problem is */
+		return { directories };
+	}
+
+	for (auto const& i: missing) {
+		auto j = found.find(i.second);
+		if (j != found.end()) {
+			group[find(i.first)] = find(j->second);
+		}
+	}
+
+	map<int, vector<boost::filesystem::path>> groups;
+	for (size_t i = 0; i < directories.size(); ++i) {
+		groups[find(i)].push_back(directories[i]);
+	}
+
+	vector<vector<boost::filesystem::path>> result;
+	for (auto const& i: groups) {
+		result.push_back(i.second);
+	}
+	return result;
+}
+
+
+void
+VerifyDCPJob::set_group_progress (int index, float progress)
+{
+	float total = 0;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_group_progress[index] = progress;
+		for (auto i: _group_progress) {
+			total += i;
+		}
+		total /= _group_progress.size();
+	}
+
+	set_progress (total, false);
+}
+
+
+void
+VerifyDCPJob::verify_group (int index, vector<boost::filesystem::path> group)
+try
+{
+	vector<dcp::VerificationNote> notes;
+	if (_level == Level::FULL) {
+		notes = dcp::verify (
+			group,
+			bind(&VerifyDCPJob::update_stage, this, _1, _2),
+			bind(&VerifyDCPJob::set_group_progress, this, index, _1),
+			libdcp_resources_path() / "xsd"
+			);
+	} else {
+		notes = quick_verify (index, group);
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_notes.insert (_notes.end(), notes.begin(), notes.end());
+} catch (boost::thread_interrupted) {
+	/* The job is being cancelled */
+} catch (...) {
+	store_current ();
+}
+
+
+/** Check that a JPEG2000 codestream starts with SOC and SIZ markers, that SIZ gives
+ *  the expected image size and that the codestream ends with an EOC marker.
+ */
+static bool
+valid_codestream (uint8_t const* data, int size, dcp::Size expected)
+{
+	if (size < 16) {
+		return false;
+	}
+
+	if (data[0] != 0xff || data[1] != 0x4f || data[2] != 0xff || data[3] != 0x51) {
+		return false;
+	}
+
+	if (data[size - 2] != 0xff || data[size - 1] != 0xd9) {
+		return false;
+	}
+
+	auto be32 = [](uint8_t const* p) {
+		return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+	};
+
+	/* Xsiz and Ysiz come after the marker, Lsiz and Rsiz */
+	return static_cast<int>(be32(data + 8)) == expected.width && static_cast<int>(be32(data + 12)) == expected.height;
+}
+
+
+void
+VerifyDCPJob::check_hash (shared_ptr<dcp::ReelFileAsset> reel_asset, string stage, dcp::VerificationNote::Code code, vector<dcp::VerificationNote>& notes)
+{
+	if (!reel_asset->asset_ref().resolved() || !reel_asset->hash()) {
+		return;
+	}
+
+	auto asset = reel_asset->asset_ref().asset();
+	update_stage (stage, asset->file());
+	auto known = _known_digests.find(asset->id());
+	auto const hash = known != _known_digests.end() ? known->second : asset->hash([](float) { boost::this_thread::interruption_point(); });
+	if (hash != *reel_asset->hash()) {
+		notes.push_back ({dcp::VerificationNote::Type::ERROR, code, *asset->file()});
+	}
+}
+
+
+void
+VerifyDCPJob::check_sampled_frames (shared_ptr<dcp::PictureAsset> asset, vector<dcp::VerificationNote>& notes)
+{
+	if (asset->encrypted()) {
+		/* We can't see the codestreams without a key */
+		return;
+	}
+
+	update_stage (_("Checking sample of picture frames"), asset->file());
+
+	auto const step = max(1, static_cast<int>(std::round(1 / _sample_rate)));
+	auto const size = asset->size();
+
+	auto bad = [&notes, asset](int64_t frame) {
+		notes.push_back ({
+			dcp::VerificationNote::Type::ERROR,
+			dcp::VerificationNote::Code::INVALID_JPEG2000_CODESTREAM,
+			String::compose("frame %1", frame),
+			*asset->file()
+		});
+	};
+
+	if (auto mono = dynamic_pointer_cast<dcp::MonoPictureAsset>(asset)) {
+		auto reader = mono->start_read ();
+		for (int64_t i = 0; i < asset->intrinsic_duration(); i += step) {
+			boost::this_thread::interruption_point ();
+			auto frame = reader->get_frame (i);
+			if (!valid_codestream(frame->data(), frame->size(), size)) {
+				bad (i);
+			}
+		}
+	} else if (auto stereo = dynamic_pointer_cast<dcp::StereoPictureAsset>(asset)) {
+		auto reader = stereo->start_read ();
+		for (int64_t i = 0; i < asset->intrinsic_duration(); i += step) {
+			boost::this_thread::interruption_point ();
+			auto frame = reader->get_frame (i);
+			if (!valid_codestream(frame->left()->data(), frame->left()->size(), size) || !valid_codestream(frame->right()->data(), frame->right()->size(), size)) {
+				bad (i);
+			}
+		}
+	}
+}
+
+
+/** Verify a group of directories to the level that we were asked for, if that is less than Level::FULL */
+vector<dcp::VerificationNote>
+VerifyDCPJob::quick_verify (int index, vector<boost::filesystem::path> group)
+{
+	vector<dcp::VerificationNote> notes;
+
+	for (auto directory: group) {
+		update_stage (_("Checking DCP"), directory);
+		try {
+			dcp::DCP dcp(directory);
+			dcp.read (&notes);
+		} catch (std::exception& e) {
+			notes.push_back ({dcp::VerificationNote::Type::ERROR, dcp::VerificationNote::Code::FAILED_READ, string(e.what()), directory});
+		}
+	}
+
+	if (_level == Level::STRUCTURE) {
+		set_group_progress (index, 1);
+		return notes;
+	}
+
+	vector<shared_ptr<dcp::Reel>> reels;
+	for (auto cpl: dcp::find_and_resolve_cpls(group, true)) {
+		for (auto reel: cpl->reels()) {
+			reels.push_back (reel);
+		}
+	}
+
+	int done = 0;
+	for (auto reel: reels) {
+		if (auto picture = reel->main_picture()) {
+			check_hash (picture, _("Checking picture asset hash"), dcp::VerificationNote::Code::INCORRECT_PICTURE_HASH, notes);
+			if (_level == Level::SAMPLED_FRAMES && picture->asset_ref().resolved()) {
+				check_sampled_frames (picture->asset(), notes);
+			}
+		}
+		if (auto sound = reel->main_sound()) {
+			check_hash (sound, _("Checking sound asset hash"), dcp::VerificationNote::Code::INCORRECT_SOUND_HASH, notes);
+		}
+		++done;
+		set_group_progress (index, static_cast<float>(done) / reels.size());
+	}
+
+	return notes;
+}
+
+
 void
 VerifyDCPJob::run ()
 {
-	_notes = dcp::verify (_directories, bind (&VerifyDCPJob::update_stage, this, _1, _2), bind (&VerifyDCPJob::set_progress, this, _1, false), libdcp_resources_path() / "xsd");
+	auto groups = independent_groups (_directories);
+	_group_progress.resize (groups.size());
+
+	boost::asio::io_service service;
+	boost::thread_group pool;
+
+	auto work = make_shared<boost::asio::io_service::work>(service);
+
+	/* Verification mostly waits for assets to be read, so more than a few threads
+	 * would just have them competing for the same disk.
+	 */
+	int const threads = min (static_cast<int>(groups.size()), 4);
+
+	for (int i = 0; i < threads; ++i) {
+		pool.create_thread ([&service]() {
+			start_of_thread ("VerifyDCPJob");
+			service.run ();
+		});
+	}
+
+	for (size_t i = 0; i < groups.size(); ++i) {
+		service.post (boost::bind(&VerifyDCPJob::verify_group, this, i, groups[i]));
+	}
+
+	work.reset ();
+
+	try {
+		pool.join_all ();
+	} catch (boost::thread_interrupted) {
+		/* join_all was interrupted, so we need to interrupt the threads
+		 * in our pool then try again to join them.
+		 */
+		pool.interrupt_all ();
+		pool.join_all ();
+		throw;
+	}
+
+	service.stop ();
+
+	rethrow ();
 
 	bool failed = false;
-	for (auto i: _notes) {
+	for (auto i: notes()) {
 		if (i.type() == dcp::VerificationNote::Type::ERROR) {
 			failed = true;
 		}
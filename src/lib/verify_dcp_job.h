@@ -19,30 +19,77 @@
 */
 
 
+#include "exception_store.h"
 #include "job.h"
 #include <dcp/verify.h>
+#include <map>
 
 
 class Content;
+namespace dcp {
+	class PictureAsset;
+	class ReelFileAsset;
+}
 
 
-class VerifyDCPJob : public Job
+class VerifyDCPJob : public Job, public ExceptionStore
 {
 public:
-	explicit VerifyDCPJob (std::vector<boost::filesystem::path> directories);
+	/** How thoroughly to verify */
+	enum class Level {
+		/** just read the DCP, checking that the XML can be parsed and that all assets are present */
+		STRUCTURE,
+		/** STRUCTURE, and check the hashes of the picture and sound assets */
+		HASHES,
+		/** HASHES, and check the JPEG2000 codestreams of a sample of the picture frames */
+		SAMPLED_FRAMES,
+		/** everything that dcp::verify checks */
+		FULL
+	};
+
+	explicit VerifyDCPJob (std::vector<boost::filesystem::path> directories, Level level = Level::FULL, float sample_rate = 0.01);
 	~VerifyDCPJob ();
 
 	std::string name () const override;
 	std::string json_name () const override;
 	void run () override;
+	Resource resource () const override {
+		return Resource::DISK;
+	}
 
 	std::vector<dcp::VerificationNote> notes () const {
+		boost::mutex::scoped_lock lm (_mutex);
 		return _notes;
 	}
 
+	/** Give digests that are already known (e.g. because we have just made the DCP) so that
+	 *  the hash checks can use them rather than reading the assets again.
+	 *  @param digests Digests keyed by asset ID.
+	 */
+	void set_known_digests (std::map<std::string, std::string> digests) {
+		_known_digests = digests;
+	}
+
+	static boost::optional<Level> level_from_string (std::string s);
+	static std::vector<std::vector<boost::filesystem::path>> independent_groups (std::vector<boost::filesystem::path> directories);
+
 private:
 	void update_stage (std::string s, boost::optional<boost::filesystem::path> path);
+	void verify_group (int index, std::vector<boost::filesystem::path> group);
+	void set_group_progress (int index, float progress);
+	std::vector<dcp::VerificationNote> quick_verify (int index, std::vector<boost::filesystem::path> group);
+	void check_hash (std::shared_ptr<dcp::ReelFileAsset> reel_asset, std::string stage, dcp::VerificationNote::Code code, std::vector<dcp::VerificationNote>& notes);
+	void check_sampled_frames (std::shared_ptr<dcp::PictureAsset> asset, std::vector<dcp::VerificationNote>& notes);
 
 	std::vector<boost::filesystem::path> _directories;
+	Level _level;
+	/** proportion of picture frames to check with Level::SAMPLED_FRAMES */
+	float _sample_rate;
+	/** digests that we know already, keyed by asset ID */
+	std::map<std::string, std::string> _known_digests;
+
+	mutable boost::mutex _mutex;
 	std::vector<dcp::VerificationNote> _notes;
+	/** progress of verifying each of the groups of directories that we are working on */
+	std::vector<float> _group_progress;
 };
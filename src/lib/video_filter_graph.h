@@ -28,6 +28,19 @@ public:
 	VideoFilterGraph (dcp::Size s, AVPixelFormat p, dcp::Fraction r);
 
 	bool can_process (dcp::Size s, AVPixelFormat p) const;
+
+	dcp::Size size () const {
+		return _size;
+	}
+
+	AVPixelFormat pixel_format () const {
+		return _pixel_format;
+	}
+
+	dcp::Fraction frame_rate () const {
+		return _frame_rate;
+	}
+
 	std::list<std::pair<std::shared_ptr<const Image>, int64_t>> process (AVFrame * frame);
 	std::list<std::shared_ptr<const Image>> process(std::shared_ptr<const Image> image);
 
@@ -0,0 +1,202 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "dcpomatic_log.h"
+#include "filter.h"
+#include "util.h"
+#include "video_filter_graph.h"
+#include "video_filter_graph_pool.h"
+#include <boost/bind/bind.hpp>
+#include <algorithm>
+#include <tuple>
+
+#include "i18n.h"
+
+
+using std::list;
+using std::make_shared;
+using std::shared_ptr;
+using std::tie;
+using std::vector;
+#if BOOST_VERSION >= 106100
+using namespace boost::placeholders;
+#endif
+
+
+VideoFilterGraphPool* VideoFilterGraphPool::_instance = nullptr;
+/** Maximum number of graphs to keep ready */
+int const VideoFilterGraphPool::_max_spare = 16;
+/** Maximum number of graphs to keep ready with any one set of filters and parameters */
+int const VideoFilterGraphPool::_max_spare_per_key = 2;
+
+
+VideoFilterGraphPool::Key::Key (vector<Filter const*> filters_, dcp::Size size_, AVPixelFormat format_, dcp::Fraction frame_rate_)
+	: filters (Filter::ffmpeg_string(filters_))
+	, size (size_)
+	, format (format_)
+	, frame_rate (frame_rate_)
+{
+
+}
+
+
+bool
+VideoFilterGraphPool::Key::operator< (Key const& other) const
+{
+	return tie(filters, size.width, size.height, format, frame_rate.numerator, frame_rate.denominator) <
+		tie(other.filters, other.size.width, other.size.height, other.format, other.frame_rate.numerator, other.frame_rate.denominator);
+}
+
+
+VideoFilterGraphPool::VideoFilterGraphPool ()
+{
+	_thread = boost::thread (boost::bind(&VideoFilterGraphPool::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread.native_handle(), "filter-graph-pool");
+#endif
+}
+
+
+VideoFilterGraphPool::~VideoFilterGraphPool ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	try {
+		_thread.join ();
+	} catch (...) {}
+}
+
+
+VideoFilterGraphPool*
+VideoFilterGraphPool::instance ()
+{
+	if (!_instance) {
+		_instance = new VideoFilterGraphPool ();
+	}
+
+	return _instance;
+}
+
+
+shared_ptr<VideoFilterGraph>
+VideoFilterGraphPool::get (vector<Filter const*> filters, dcp::Size size, AVPixelFormat format, dcp::Fraction frame_rate, bool prepare)
+{
+	Key key (filters, size, format, frame_rate);
+	shared_ptr<VideoFilterGraph> graph;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		auto spare = _spare.find (key);
+		if (spare != _spare.end() && !spare->second.empty()) {
+			graph = spare->second.front ();
+			spare->second.pop_front ();
+			--_spare_count;
+		}
+
+		/* Only ask for another if there isn't one ready or coming already; there's
+		   no point in setting up lots of graphs if we are being asked for them quickly.
+		*/
+		auto const have_spare = spare != _spare.end() && !spare->second.empty();
+		auto const preparing = std::find_if(_to_prepare.begin(), _to_prepare.end(), [&key](Preparation const& p) { return !(p.key < key) && !(key < p.key); }) != _to_prepare.end();
+		if (prepare && !have_spare && !preparing) {
+			_to_prepare.push_back ({ key, filters });
+			_condition.notify_all ();
+		}
+	}
+
+	if (!graph) {
+		graph = make_shared<VideoFilterGraph>(size, format, frame_rate);
+		graph->setup (filters);
+	}
+
+	return graph;
+}
+
+
+void
+VideoFilterGraphPool::put (vector<Filter const*> filters, shared_ptr<VideoFilterGraph> graph)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	add_spare (Key(filters, graph->size(), graph->pixel_format(), graph->frame_rate()), graph);
+}
+
+
+/** Must be called with a lock held on _mutex */
+void
+VideoFilterGraphPool::add_spare (Key const& key, shared_ptr<VideoFilterGraph> graph)
+{
+	auto& spare = _spare[key];
+	if (static_cast<int>(spare.size()) >= _max_spare_per_key) {
+		return;
+	}
+
+	if (_spare_count >= _max_spare) {
+		/* Make room by throwing away a graph of some other kind */
+		for (auto& i: _spare) {
+			if (!i.second.empty()) {
+				i.second.pop_back ();
+				--_spare_count;
+				break;
+			}
+		}
+	}
+
+	spare.push_back (graph);
+	++_spare_count;
+}
+
+
+void
+VideoFilterGraphPool::thread ()
+{
+	start_of_thread ("VideoFilterGraphPool");
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_stop && _to_prepare.empty()) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		auto preparation = _to_prepare.front ();
+		_to_prepare.pop_front ();
+		lm.unlock ();
+
+		try {
+			auto graph = make_shared<VideoFilterGraph>(preparation.key.size, preparation.key.format, preparation.key.frame_rate);
+			graph->setup (preparation.filters);
+			lm.lock ();
+			add_spare (preparation.key, graph);
+		} catch (std::exception& e) {
+			/* Whoever wants this graph will find the same problem when they set it up themselves */
+			LOG_WARNING (N_("Could not prepare filter graph (%1)"), e.what());
+		}
+	}
+}
@@ -0,0 +1,108 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_VIDEO_FILTER_GRAPH_POOL_H
+#define DCPOMATIC_VIDEO_FILTER_GRAPH_POOL_H
+
+
+#include <dcp/types.h>
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+
+class Filter;
+class VideoFilterGraph;
+
+
+/** @class VideoFilterGraphPool
+ *  @brief A store of VideoFilterGraphs which are set up and ready to use.
+ *
+ *  Setting up a graph with some filters (deinterlacers in particular) can take tens of
+ *  milliseconds.  Graphs with temporal filters must be thrown away after a seek, so this
+ *  pool can set up their replacements in the background before they are needed.  Graphs
+ *  without temporal filters can be given back here when their decoder is finished with
+ *  them, so that the next decoder of the same sort of content can use them.
+ */
+class VideoFilterGraphPool
+{
+public:
+	~VideoFilterGraphPool ();
+
+	VideoFilterGraphPool (VideoFilterGraphPool const&) = delete;
+	VideoFilterGraphPool& operator= (VideoFilterGraphPool const&) = delete;
+
+	/** @return A graph which is set up with the given filters and parameters, and which has not been given any frames.
+	 *  @param prepare true to start setting up another graph like this one in the background, ready for the next call.
+	 */
+	std::shared_ptr<VideoFilterGraph> get (std::vector<Filter const*> filters, dcp::Size size, AVPixelFormat format, dcp::Fraction frame_rate, bool prepare);
+	/** Give back a graph which came from get() and which holds no frames */
+	void put (std::vector<Filter const*> filters, std::shared_ptr<VideoFilterGraph> graph);
+
+	static VideoFilterGraphPool* instance ();
+
+private:
+	VideoFilterGraphPool ();
+
+	struct Key
+	{
+		Key (std::vector<Filter const*> filters, dcp::Size size, AVPixelFormat format, dcp::Fraction frame_rate);
+
+		std::string filters;
+		dcp::Size size;
+		AVPixelFormat format;
+		dcp::Fraction frame_rate;
+
+		bool operator< (Key const& other) const;
+	};
+
+	struct Preparation
+	{
+		Key key;
+		std::vector<Filter const*> filters;
+	};
+
+	void thread ();
+	void add_spare (Key const& key, std::shared_ptr<VideoFilterGraph> graph);
+
+	boost::mutex _mutex;
+	boost::condition _condition;
+	/** Graphs which are ready to be used */
+	std::map<Key, std::list<std::shared_ptr<VideoFilterGraph>>> _spare;
+	int _spare_count = 0;
+	/** Graphs for our thread to set up */
+	std::list<Preparation> _to_prepare;
+	bool _stop = false;
+	boost::thread _thread;
+
+	static int const _max_spare;
+	static int const _max_spare_per_key;
+	static VideoFilterGraphPool* _instance;
+};
+
+
+#endif
@@ -20,16 +20,32 @@
 
 
 #include "dcpomatic_log.h"
+#include "filter.h"
 #include "video_filter_graph.h"
+#include "video_filter_graph_pool.h"
 #include "video_filter_graph_set.h"
 
 #include "i18n.h"
 
 
-using std::make_shared;
 using std::shared_ptr;
 
 
+VideoFilterGraphSet::~VideoFilterGraphSet()
+{
+	if (_filters.empty() || Filter::any_temporal(_filters)) {
+		return;
+	}
+
+	/* Our graphs hold no frames, so someone else can use them */
+	try {
+		for (auto graph: _graphs) {
+			VideoFilterGraphPool::instance()->put(_filters, graph);
+		}
+	} catch (...) {}
+}
+
+
 shared_ptr<VideoFilterGraph>
 VideoFilterGraphSet::get(dcp::Size size, AVPixelFormat format)
 {
@@ -44,8 +60,10 @@ VideoFilterGraphSet::get(dcp::Size size, AVPixelFormat format)
 		return *graph;
 	}
 
-	auto new_graph = make_shared<VideoFilterGraph>(size, format, _frame_rate);
-	new_graph->setup(_filters);
+	/* Graphs with temporal filters will be thrown away after every seek, so we get
+	   the pool to have the next one ready.
+	*/
+	auto new_graph = VideoFilterGraphPool::instance()->get(_filters, size, format, _frame_rate, Filter::any_temporal(_filters));
 	_graphs.push_back(new_graph);
 
 	LOG_GENERAL(N_("New graph for %1x%2, pixel format %3"), size.width, size.height, static_cast<int>(format));
@@ -54,6 +72,15 @@ VideoFilterGraphSet::get(dcp::Size size, AVPixelFormat format)
 }
 
 
+void
+VideoFilterGraphSet::reset()
+{
+	if (Filter::any_temporal(_filters)) {
+		_graphs.clear();
+	}
+}
+
+
 void
 VideoFilterGraphSet::clear()
 {
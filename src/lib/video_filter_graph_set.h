@@ -43,11 +43,15 @@ public:
 		, _frame_rate(frame_rate)
 	{}
 
+	~VideoFilterGraphSet();
+
 	VideoFilterGraphSet(VideoFilterGraphSet const&) = delete;
 	VideoFilterGraphSet& operator=(VideoFilterGraphSet const&) = delete;
 
 	std::shared_ptr<VideoFilterGraph> get(dcp::Size size, AVPixelFormat format);
 
+	/** Make sure that no frames given to our graphs before this call come out after it */
+	void reset();
 	void clear();
 
 private:
@@ -19,6 +19,7 @@
 */
 
 
+#include "config.h"
 #include "video_mxf_decoder.h"
 #include "video_decoder.h"
 #include "video_mxf_content.h"
@@ -65,14 +66,32 @@ VideoMXFDecoder::VideoMXFDecoder (shared_ptr<const Film> film, shared_ptr<const
 		}
 	}
 
+	auto const read_ahead = Config::instance()->mxf_read_ahead_frames();
+
 	if (mono) {
 		_mono_reader = mono->start_read ();
 		_mono_reader->set_check_hmac (false);
 		_size = mono->size ();
+		if (read_ahead > 0) {
+			auto reader = _mono_reader;
+			_mono_prefetcher.reset (
+				new FramePrefetcher<shared_ptr<const dcp::MonoPictureFrame>>(
+					[reader](int64_t index) { return reader->get_frame(index); }, mono->intrinsic_duration(), read_ahead
+					)
+				);
+		}
 	} else {
 		_stereo_reader = stereo->start_read ();
 		_stereo_reader->set_check_hmac (false);
 		_size = stereo->size ();
+		if (read_ahead > 0) {
+			auto reader = _stereo_reader;
+			_stereo_prefetcher.reset (
+				new FramePrefetcher<shared_ptr<const dcp::StereoPictureFrame>>(
+					[reader](int64_t index) { return reader->get_frame(index); }, stereo->intrinsic_duration(), read_ahead
+					)
+				);
+		}
 	}
 }
 
@@ -88,20 +107,23 @@ VideoMXFDecoder::pass ()
 	}
 
 	if (_mono_reader) {
+		auto picture = _mono_prefetcher ? _mono_prefetcher->get(frame) : _mono_reader->get_frame(frame);
 		video->emit (
 			film(),
-			std::make_shared<J2KImageProxy>(_mono_reader->get_frame(frame), _size, AV_PIX_FMT_XYZ12LE, optional<int>()),
+			std::make_shared<J2KImageProxy>(picture, _size, AV_PIX_FMT_XYZ12LE, optional<int>()),
 			frame
 			);
 	} else {
+		/* One read gets both eyes */
+		auto picture = _stereo_prefetcher ? _stereo_prefetcher->get(frame) : _stereo_reader->get_frame(frame);
 		video->emit (
 			film(),
-			std::make_shared<J2KImageProxy>(_stereo_reader->get_frame(frame), _size, dcp::Eye::LEFT, AV_PIX_FMT_XYZ12LE, optional<int>()),
+			std::make_shared<J2KImageProxy>(picture, _size, dcp::Eye::LEFT, AV_PIX_FMT_XYZ12LE, optional<int>()),
 			frame
 			);
 		video->emit (
 			film(),
-			std::make_shared<J2KImageProxy>(_stereo_reader->get_frame(frame), _size, dcp::Eye::RIGHT, AV_PIX_FMT_XYZ12LE, optional<int>()),
+			std::make_shared<J2KImageProxy>(picture, _size, dcp::Eye::RIGHT, AV_PIX_FMT_XYZ12LE, optional<int>()),
 			frame
 			);
 	}
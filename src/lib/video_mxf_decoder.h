@@ -20,6 +20,7 @@
 
 
 #include "decoder.h"
+#include "frame_prefetcher.h"
 #include <dcp/mono_picture_asset_reader.h>
 #include <dcp/stereo_picture_asset_reader.h>
 
@@ -44,5 +45,8 @@ private:
 
 	std::shared_ptr<dcp::MonoPictureAssetReader> _mono_reader;
 	std::shared_ptr<dcp::StereoPictureAssetReader> _stereo_reader;
+	/** things to read ahead from _mono_reader or _stereo_reader, if we are doing that */
+	std::unique_ptr<FramePrefetcher<std::shared_ptr<const dcp::MonoPictureFrame>>> _mono_prefetcher;
+	std::unique_ptr<FramePrefetcher<std::shared_ptr<const dcp::StereoPictureFrame>>> _stereo_prefetcher;
 	dcp::Size _size;
 };
@@ -22,11 +22,9 @@
 #include "video_ring_buffers.h"
 #include "player_video.h"
 #include "compose.hpp"
-#include <list>
 #include <iostream>
 
 
-using std::list;
 using std::make_pair;
 using std::cout;
 using std::pair;
@@ -36,23 +34,45 @@ using boost::optional;
 using namespace dcpomatic;
 
 
-void
+VideoRingBuffers::VideoRingBuffers (Frame capacity)
+	: _capacity (capacity)
+	, _frames (capacity)
+	, _times (capacity)
+	, _write (0)
+	, _read (0)
+{
+
+}
+
+
+/** @return true if the frame was stored, false if there was no room for it */
+bool
 VideoRingBuffers::put (shared_ptr<PlayerVideo> frame, DCPTime time)
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	_data.push_back (make_pair(frame, time));
+	auto const write = _write.load(std::memory_order_relaxed);
+	if (write - _read.load(std::memory_order_acquire) >= _capacity) {
+		return false;
+	}
+
+	auto const index = write % _capacity;
+	std::atomic_store (&_frames[index], frame);
+	_times[index] = time;
+	_write.store(write + 1, std::memory_order_release);
+	return true;
 }
 
 
 pair<shared_ptr<PlayerVideo>, DCPTime>
 VideoRingBuffers::get ()
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	if (_data.empty ()) {
+	auto const read = _read.load(std::memory_order_relaxed);
+	if (read == _write.load(std::memory_order_acquire)) {
 		return {};
 	}
-	auto const r = _data.front();
-	_data.pop_front ();
+
+	auto const index = read % _capacity;
+	auto r = make_pair(std::atomic_exchange(&_frames[index], shared_ptr<PlayerVideo>()), _times[index]);
+	_read.store(read + 1, std::memory_order_release);
 	return r;
 }
 
@@ -60,45 +80,56 @@ VideoRingBuffers::get ()
 Frame
 VideoRingBuffers::size () const
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	return _data.size ();
+	return _write.load() - _read.load();
 }
 
 
 bool
 VideoRingBuffers::empty () const
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	return _data.empty ();
+	return size() == 0;
+}
+
+
+bool
+VideoRingBuffers::full () const
+{
+	return size() >= _capacity;
 }
 
 
 void
 VideoRingBuffers::clear ()
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	_data.clear ();
+	auto const write = _write.load(std::memory_order_acquire);
+	for (auto i = _read.load(std::memory_order_relaxed); i < write; ++i) {
+		std::atomic_store (&_frames[i % _capacity], shared_ptr<PlayerVideo>());
+	}
+	_read.store(write, std::memory_order_release);
 }
 
 
 pair<size_t, string>
 VideoRingBuffers::memory_used () const
 {
-	boost::mutex::scoped_lock lm (_mutex);
 	size_t m = 0;
-	for (auto const& i: _data) {
-		m += i.first->memory_used();
+	for (auto const& i: _frames) {
+		auto frame = std::atomic_load(&i);
+		if (frame) {
+			m += frame->memory_used();
+		}
 	}
-	return make_pair(m, String::compose("%1 frames", _data.size()));
+	return make_pair(m, String::compose("%1 frames", size()));
 }
 
 
 void
 VideoRingBuffers::reset_metadata (shared_ptr<const Film> film, dcp::Size player_video_container_size)
 {
-	boost::mutex::scoped_lock lm (_mutex);
-	for (auto const& i: _data) {
-		i.first->reset_metadata (film, player_video_container_size);
+	for (auto& i: _frames) {
+		auto frame = std::atomic_load(&i);
+		if (frame) {
+			frame->reset_metadata (film, player_video_container_size);
+		}
 	}
 }
-
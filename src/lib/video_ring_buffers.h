@@ -26,36 +26,54 @@
 #include "dcpomatic_time.h"
 #include "player_video.h"
 #include "types.h"
-#include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <utility>
+#include <vector>
 
 
 class Film;
 class PlayerVideo;
 
 
+/** @class VideoRingBuffers
+ *  @brief A fixed-size, lock-free queue of video passing from one thread to another.
+ *
+ *  put() is called from one thread and get() and clear() from another (or any of these from
+ *  several threads, as long as the caller serialises calls to each side).  memory_used() and
+ *  reset_metadata() are safe to call from anywhere.
+ */
 class VideoRingBuffers
 {
 public:
-	VideoRingBuffers () {}
+	/** @param capacity Maximum number of frames that can be stored */
+	explicit VideoRingBuffers (Frame capacity);
 
 	VideoRingBuffers (VideoRingBuffers const&) = delete;
 	VideoRingBuffers& operator= (VideoRingBuffers const&) = delete;
 
-	void put (std::shared_ptr<PlayerVideo> frame, dcpomatic::DCPTime time);
+	bool put (std::shared_ptr<PlayerVideo> frame, dcpomatic::DCPTime time);
 	std::pair<std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime> get ();
 
 	void clear ();
 	Frame size () const;
 	bool empty () const;
+	bool full () const;
 
 	void reset_metadata (std::shared_ptr<const Film> film, dcp::Size player_video_container_size);
 
 	std::pair<size_t, std::string> memory_used () const;
 
 private:
-	mutable boost::mutex _mutex;
-	std::list<std::pair<std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime>> _data;
+	Frame const _capacity;
+	/** frames, accessed with std::atomic_load and friends so that they can be looked at by
+	 *  memory_used() and reset_metadata()
+	 */
+	std::vector<std::shared_ptr<PlayerVideo>> _frames;
+	std::vector<dcpomatic::DCPTime> _times;
+	/** index (counting all the frames ever put) of the next frame that put() will write; changed only by put() */
+	std::atomic<int64_t> _write;
+	/** index of the next frame that get() will read; changed only by get() and clear() */
+	std::atomic<int64_t> _read;
 };
 
 
@@ -0,0 +1,267 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_WORK_STEALING_QUEUE_H
+#define DCPOMATIC_WORK_STEALING_QUEUE_H
+
+
+#include "dcpomatic_assert.h"
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
+
+
+/** @class WorkStealingQueue
+ *  @brief A queue of work shared between one producer and many worker threads.
+ *
+ *  Items are spread between a set of deques, each with its own mutex.  Each
+ *  worker takes from the front of "its" deque (worker index modulo the number of deques)
+ *  and, if that is empty, steals from the front of the others.  This means that
+ *  workers only contend with each other when they are stealing, rather than all
+ *  of them fighting over one lock for every item.
+ *
+ *  The deques can be split into groups (deque d being in group d modulo the number
+ *  of groups), and a worker will steal from the other deques in its own group
+ *  before it looks at the rest.  This is used to keep work on one NUMA node when
+ *  the workers are pinned to nodes in the same pattern.
+ *
+ *  Threads only touch the condition variables (and their mutexes) when they
+ *  have to sleep, or when they know that someone else is sleeping.
+ */
+template <class T>
+class WorkStealingQueue
+{
+public:
+	explicit WorkStealingQueue (int deques, int groups = 1)
+		: _groups (groups)
+	{
+		DCPOMATIC_ASSERT (deques > 0);
+		DCPOMATIC_ASSERT (groups > 0);
+		for (int i = 0; i < deques; ++i) {
+			_deques.push_back (std::make_shared<Deque>());
+		}
+	}
+
+	WorkStealingQueue (WorkStealingQueue const&) = delete;
+	WorkStealingQueue& operator= (WorkStealingQueue const&) = delete;
+
+	/** Add an item to the back of the queue.  This should only be called by
+	 *  the producer thread.
+	 */
+	void push_back (T item)
+	{
+		auto deque = _deques[_next_push];
+		_next_push = (_next_push + 1) % _deques.size();
+
+		{
+			boost::mutex::scoped_lock lm (deque->mutex);
+			deque->items.push_back (std::move(item));
+		}
+
+		++_size;
+		if (_sleeping_workers > 0) {
+			boost::mutex::scoped_lock lm (_worker_mutex);
+			_worker_condition.notify_one ();
+		}
+	}
+
+	/** Put an item back at the front of a worker's deque; for example, if the
+	 *  worker failed to process it.
+	 */
+	void push_front (int worker, T item)
+	{
+		auto deque = _deques[worker % _deques.size()];
+
+		{
+			boost::mutex::scoped_lock lm (deque->mutex);
+			deque->items.push_front (std::move(item));
+		}
+
+		++_size;
+		if (_sleeping_workers > 0) {
+			boost::mutex::scoped_lock lm (_worker_mutex);
+			_worker_condition.notify_one ();
+		}
+	}
+
+	/** Take an item without blocking.
+	 *  @param worker Index of the worker thread that is calling.
+	 *  @return The item, or an empty optional if there is nothing to take.
+	 */
+	boost::optional<T> try_pop (int worker)
+	{
+		auto const N = _deques.size();
+		auto const group = (worker % N) % _groups;
+		/* Look first in our own deque, then steal from those in the same group, then from the rest */
+		for (int same = 1; same >= 0; --same) {
+			for (size_t i = 0; i < N; ++i) {
+				auto const index = (worker + i) % N;
+				if ((index % _groups == group) != static_cast<bool>(same)) {
+					continue;
+				}
+				auto item = take_front (*_deques[index]);
+				if (item) {
+					return item;
+				}
+			}
+		}
+
+		return {};
+	}
+
+	/** Take an item, blocking until there is one.  This is a boost thread interruption point
+	 *  while it is waiting, but not once an item has been taken.
+	 *  @param worker Index of the worker thread that is calling.
+	 */
+	T pop (int worker)
+	{
+		while (true) {
+			auto item = try_pop (worker);
+			if (item) {
+				return *item;
+			}
+
+			boost::mutex::scoped_lock lm (_worker_mutex);
+			++_sleeping_workers;
+			/* Something could have been pushed after we looked; if it was, the producer
+			   might not have seen us in _sleeping_workers, so look again.
+			*/
+			if (_size == 0) {
+				try {
+					_worker_condition.wait (lm);
+				} catch (...) {
+					--_sleeping_workers;
+					throw;
+				}
+			}
+			--_sleeping_workers;
+			lm.unlock ();
+
+			boost::this_thread::interruption_point ();
+		}
+	}
+
+	/** Block the producer until there are fewer than @p limit items in the queue,
+	 *  or until wake_producer() is called.
+	 */
+	void wait_for_space (size_t limit)
+	{
+		boost::mutex::scoped_lock lm (_producer_mutex);
+		_producer_waiting = true;
+		while (_size >= limit && !_producer_woken) {
+			try {
+				_producer_condition.wait (lm);
+			} catch (...) {
+				_producer_waiting = false;
+				throw;
+			}
+		}
+		_producer_waiting = false;
+		_producer_woken = false;
+	}
+
+	/** Wake the producer if it is in wait_for_space(), whether or not there is space;
+	 *  for example, to let it see an exception.
+	 */
+	void wake_producer ()
+	{
+		boost::mutex::scoped_lock lm (_producer_mutex);
+		_producer_woken = true;
+		_producer_condition.notify_all ();
+	}
+
+	/** Take everything that is left in the queue */
+	std::list<T> drain ()
+	{
+		std::list<T> all;
+		for (auto deque: _deques) {
+			boost::mutex::scoped_lock lm (deque->mutex);
+			_size -= deque->items.size();
+			std::move (deque->items.begin(), deque->items.end(), std::back_inserter(all));
+			deque->items.clear ();
+		}
+		return all;
+	}
+
+	size_t size () const {
+		return _size;
+	}
+
+	bool empty () const {
+		return _size == 0;
+	}
+
+private:
+	struct Deque
+	{
+		boost::mutex mutex;
+		std::deque<T> items;
+	};
+
+	boost::optional<T> take_front (Deque& deque)
+	{
+		boost::mutex::scoped_lock lm (deque.mutex);
+		if (deque.items.empty()) {
+			return {};
+		}
+
+		auto item = std::move (deque.items.front());
+		deque.items.pop_front ();
+		lm.unlock ();
+
+		--_size;
+		if (_producer_waiting) {
+			boost::mutex::scoped_lock plm (_producer_mutex);
+			_producer_condition.notify_all ();
+		}
+
+		return item;
+	}
+
+	std::vector<std::shared_ptr<Deque>> _deques;
+	/** Number of groups that the deques are split into */
+	size_t const _groups;
+	/** Index of the deque that the next push_back() will use; only touched by the producer */
+	size_t _next_push = 0;
+	/** Total number of items in all the deques */
+	std::atomic<size_t> _size{0};
+
+	boost::mutex _worker_mutex;
+	/** condition to wake workers when there is something to do */
+	boost::condition _worker_condition;
+	std::atomic<int> _sleeping_workers{0};
+
+	boost::mutex _producer_mutex;
+	/** condition to wake the producer when there might be space in the queue */
+	boost::condition _producer_condition;
+	std::atomic<bool> _producer_waiting{false};
+	/** true if wake_producer() has been called since the producer started waiting; protected by _producer_mutex */
+	bool _producer_woken = false;
+};
+
+
+#endif
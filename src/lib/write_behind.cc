@@ -0,0 +1,117 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "config.h"
+#include "dcpomatic_log.h"
+#include "write_behind.h"
+#include <fcntl.h>
+#ifndef DCPOMATIC_WINDOWS
+#include <unistd.h>
+#endif
+
+#include "i18n.h"
+
+
+/** Size of the chunks that we write out and drop */
+static uint64_t const chunk_size = 32 * 1024 * 1024;
+
+
+WriteBehind::WriteBehind (boost::filesystem::path file)
+{
+#ifndef DCPOMATIC_WINDOWS
+	/* The file is written through someone else's descriptor, but syncing and
+	   dropping the cache work on the file, whichever descriptor we use.
+	*/
+	_fd = open (file.string().c_str(), O_RDONLY);
+	if (_fd == -1) {
+		LOG_WARNING ("Could not open %1 to write it behind (%2)", file.string(), errno);
+	}
+#endif
+}
+
+
+WriteBehind::~WriteBehind ()
+{
+#ifndef DCPOMATIC_WINDOWS
+	if (_fd != -1) {
+		close (_fd);
+	}
+#endif
+}
+
+
+/** Called when the file has been written up to @p position */
+void
+WriteBehind::written (uint64_t position)
+{
+	if (_fd == -1) {
+		return;
+	}
+
+	while (position >= _started + chunk_size) {
+#ifdef DCPOMATIC_LINUX
+		sync_file_range (_fd, _started, chunk_size, SYNC_FILE_RANGE_WRITE);
+		if (_started >= chunk_size) {
+			auto const previous = _started - chunk_size;
+			sync_file_range (_fd, previous, chunk_size, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+			posix_fadvise (_fd, previous, chunk_size, POSIX_FADV_DONTNEED);
+		}
+#endif
+		_started += chunk_size;
+	}
+}
+
+
+/** Make sure that the whole of the file is on the disk (including anything that
+ *  has been rewritten since it was first written) and out of the cache.  This
+ *  should be called once the file has been finished.
+ */
+void
+WriteBehind::flush ()
+{
+	if (_fd == -1) {
+		return;
+	}
+
+#ifdef DCPOMATIC_LINUX
+	fdatasync (_fd);
+	posix_fadvise (_fd, 0, 0, POSIX_FADV_DONTNEED);
+#elif !defined(DCPOMATIC_WINDOWS)
+	fsync (_fd);
+#endif
+}
+
+
+/** @return true if Config says that @p file should be written behind */
+bool
+WriteBehind::wanted (boost::filesystem::path file)
+{
+	for (auto const& directory: Config::instance()->write_behind_directories()) {
+		for (auto i = file.parent_path(); !i.empty(); i = i.parent_path()) {
+			if (i == directory) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef DCPOMATIC_WRITE_BEHIND_H
+#define DCPOMATIC_WRITE_BEHIND_H
+
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+
+
+/** @class WriteBehind
+ *  @brief Keep a file which is being written by someone else (such as asdcplib) moving
+ *  out to the disk, and out of the cache, as it grows.
+ *
+ *  Each time another chunk of the file has been written we ask the kernel to start
+ *  writing it out, wait for the chunk before it to reach the disk and then drop that
+ *  chunk from the page cache.  This means that writing a big asset does not leave
+ *  gigabytes of dirty pages to be flushed later, or push the source media that we are
+ *  decoding out of the cache.  The writer is held up if the disk cannot keep up, which
+ *  is what we want.
+ *
+ *  This only does anything on Linux; elsewhere flush() just syncs the file.
+ */
+class WriteBehind
+{
+public:
+	explicit WriteBehind (boost::filesystem::path file);
+	~WriteBehind ();
+
+	WriteBehind (WriteBehind const&) = delete;
+	WriteBehind& operator= (WriteBehind const&) = delete;
+
+	void written (uint64_t position);
+	void flush ();
+
+	static bool wanted (boost::filesystem::path file);
+
+private:
+	int _fd = -1;
+	/** position up to which we have asked for the file to be written out */
+	uint64_t _started = 0;
+};
+
+
+#endif
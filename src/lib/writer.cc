@@ -19,8 +19,10 @@
 */
 
 
+#include "asset_digest.h"
 #include "audio_buffers.h"
 #include "audio_mapping.h"
+#include "background_uploader.h"
 #include "compose.hpp"
 #include "config.h"
 #include "cross.h"
@@ -29,11 +31,19 @@
 #include "dcpomatic_log.h"
 #include "film.h"
 #include "job.h"
+#include "job_manager.h"
 #include "log.h"
+#include "memory_budget.h"
+#include "metrics.h"
+#include "performance_report.h"
 #include "ratio.h"
 #include "reel_writer.h"
+#include "spill_file.h"
 #include "text_content.h"
+#include "trace.h"
+#include "upload_job.h"
 #include "util.h"
+#include "verify_dcp_job.h"
 #include "version.h"
 #include "writer.h"
 #include <dcp/cpl.h>
@@ -42,6 +52,8 @@
 #include <dcp/reel_file_asset.h>
 #include <cerrno>
 #include <cfloat>
+#include <chrono>
+#include <limits>
 #include <set>
 
 #include "i18n.h"
@@ -53,12 +65,16 @@
 
 using std::cout;
 using std::dynamic_pointer_cast;
+using std::list;
 using std::make_shared;
+using std::map;
 using std::max;
 using std::min;
+using std::multiset;
 using std::shared_ptr;
 using std::set;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 using std::weak_ptr;
 using boost::optional;
@@ -66,10 +82,28 @@ using boost::optional;
 using namespace boost::placeholders;
 #endif
 using dcp::Data;
-using dcp::ArrayData;
 using namespace dcpomatic;
 
 
+/** Largest number of threads that we will use to write reels at the same time */
+static size_t const maximum_writer_threads = 4;
+/** Largest number of threads that we will use to write reels at the same time when they are
+ *  encrypted; libdcp encrypts (and makes the HMAC of) each frame as it is written, so the
+ *  work of writing an encrypted reel is more CPU than disk and it is worth spreading further.
+ */
+static size_t const maximum_encrypted_writer_threads = 8;
+/** Interval between checks of the space left on the disk, in seconds */
+static int const disk_space_check_interval = 5;
+
+
+/** @return Number of picture frames per second (counting each eye separately) that a film's DCP will have */
+static int
+picture_frames_per_second (shared_ptr<const Film> film)
+{
+	return film->video_frame_rate() * (film->three_d() ? 2 : 1);
+}
+
+
 /** @param j Job to report progress to, or 0.
  *  @param text_only true to enable only the text (subtitle/ccap) parts of the writer.
  */
@@ -78,7 +112,12 @@ Writer::Writer (weak_ptr<const Film> weak_film, weak_ptr<Job> j, bool text_only)
 	, _job (j)
 	/* These will be reset to sensible values when J2KEncoder is created */
 	, _maximum_frames_in_memory (8)
+	, _maximum_bytes_in_memory (static_cast<int64_t>(Config::instance()->writer_memory_limit()) * 1024 * 1024)
 	, _maximum_queue_size (8)
+	, _disk_space_guard (
+		film()->j2k_bandwidth() / 8 / picture_frames_per_second(film()),
+		static_cast<int64_t>(film()->audio_channels()) * film()->audio_frame_rate() * 3 / picture_frames_per_second(film())
+		)
 	, _text_only (text_only)
 {
 	auto job = _job.lock ();
@@ -113,10 +152,16 @@ void
 Writer::start ()
 {
 	if (!_text_only) {
-		_thread = boost::thread (boost::bind(&Writer::thread, this));
+		auto const maximum = film()->encrypted() ?
+			std::max(maximum_writer_threads, std::min(maximum_encrypted_writer_threads, static_cast<size_t>(boost::thread::hardware_concurrency()))) :
+			maximum_writer_threads;
+		_writer_threads = std::min(_reels.size(), maximum);
+		for (size_t i = 0; i < _writer_threads; ++i) {
+			_threads.push_back (boost::thread(boost::bind(&Writer::thread, this, i)));
 #ifdef DCPOMATIC_LINUX
-		pthread_setname_np (_thread.native_handle(), "writer");
+			pthread_setname_np (_threads.back().native_handle(), "writer");
 #endif
+		}
 	}
 }
 
@@ -140,7 +185,7 @@ Writer::write (shared_ptr<const Data> encoded, Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queued_full_in_memory > _maximum_frames_in_memory) {
+	while (too_much_in_memory()) {
 		/* There are too many full frames in memory; wake the main writer thread and
 		   wait until it sorts everything out */
 		_empty_condition.notify_all ();
@@ -156,41 +201,146 @@ Writer::write (shared_ptr<const Data> encoded, Frame frame, Eyes eyes)
 	if (film()->three_d() && eyes == Eyes::BOTH) {
 		/* 2D material in a 3D DCP; fake the 3D */
 		qi.eyes = Eyes::LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		++_queued_full_in_memory;
+		_queued_full_bytes_in_memory += encoded->size();
 		qi.eyes = Eyes::RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		++_queued_full_in_memory;
+		_queued_full_bytes_in_memory += encoded->size();
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		++_queued_full_in_memory;
+		_queued_full_bytes_in_memory += encoded->size();
 	}
 
+	update_queue_metrics ();
+
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
 	_empty_condition.notify_all ();
 }
 
 
+/** @return true if we are holding so many encoded frames in memory that some should
+ *  be put in temporary files.  Caller must hold a lock on _state_mutex.
+ */
+bool
+Writer::too_much_in_memory () const
+{
+	/* Always allow the number of frames that set_encoder_threads() asked for, and then
+	   as many more as will fit in the memory limit (and the pipeline's memory budget), since
+	   writing frames to temporary files and reading them back is expensive.  If the disk is
+	   short of space keep more in memory, rather than using the space for frames which will be
+	   written again when they come out of the spill file.
+	*/
+	auto const maximum_bytes = _disk_space_guard.state() == DiskSpaceGuard::State::OK ? _maximum_bytes_in_memory : _maximum_bytes_in_memory * 2;
+	return _queued_full_in_memory > _maximum_frames_in_memory &&
+		(_queued_full_bytes_in_memory > maximum_bytes || MemoryBudget::instance()->over_budget());
+}
+
+
+/** Look at how much space is left on the disk (every few seconds) and tell the user, or pause
+ *  the job, if it looks like running out.  Must be called without a lock on _state_mutex.
+ */
+void
+Writer::check_disk_space ()
+{
+	auto const now = std::chrono::steady_clock::now();
+	if (_last_disk_space_check && (now - *_last_disk_space_check) < std::chrono::seconds(disk_space_check_interval)) {
+		return;
+	}
+	_last_disk_space_check = now;
+
+	boost::system::error_code ec;
+	auto const space = boost::filesystem::space(film()->internal_video_asset_dir(), ec);
+	if (ec) {
+		return;
+	}
+
+	boost::mutex::scoped_lock lock (_state_mutex);
+	Frame const total = film()->length().frames_round(film()->video_frame_rate()) * (film()->three_d() ? 2 : 1);
+	auto const remaining = max(Frame(0), total - _full_written - _fake_written - _repeat_written);
+	auto const needed = _disk_space_guard.needed(remaining);
+	auto const state = _disk_space_guard.check(space.available, remaining);
+	lock.unlock ();
+
+	if (!state) {
+		return;
+	}
+
+	double const gb = 1073741824.0;
+
+	switch (*state) {
+	case DiskSpaceGuard::State::OK:
+		LOG_GENERAL (N_("Disk space is OK again: %1GB available, about %2GB needed"), space.available / gb, needed / gb);
+		break;
+	case DiskSpaceGuard::State::LOW:
+		LOG_WARNING (N_("Disk space is low: %1GB available, about %2GB needed; spilling fewer frames to disk"), space.available / gb, needed / gb);
+		break;
+	case DiskSpaceGuard::State::FULL:
+		LOG_WARNING (N_("Disk is nearly full: %1GB available, about %2GB needed; pausing"), space.available / gb, needed / gb);
+		if (auto job = _job.lock()) {
+			job->pause_by_user ();
+		}
+		break;
+	}
+}
+
+
+/** @return A warning to show the user about the space left for this encode, if there is one */
+optional<string>
+Writer::disk_space_warning () const
+{
+	boost::mutex::scoped_lock lock (_state_mutex);
+
+	switch (_disk_space_guard.state()) {
+	case DiskSpaceGuard::State::OK:
+		return {};
+	case DiskSpaceGuard::State::LOW:
+		return string(_("the disk may not have enough space left for this DCP"));
+	case DiskSpaceGuard::State::FULL:
+		return string(_("paused because the disk is nearly full; make some space and then resume"));
+	}
+
+	return {};
+}
+
+
+/** Caller must hold a lock on _state_mutex */
+void
+Writer::update_queue_metrics () const
+{
+	static auto& frames = Metrics::instance()->gauge("dcpomatic_writer_queue_frames", "Frames waiting to be written to the DCP");
+	static auto& bytes = Metrics::instance()->gauge("dcpomatic_writer_queue_bytes", "Bytes of encoded frames waiting in memory to be written to the DCP");
+	frames.set (_queue.size());
+	bytes.set (_queued_full_bytes_in_memory);
+	_memory.set (_queued_full_bytes_in_memory);
+}
+
+
 bool
-Writer::can_repeat (Frame frame) const
+Writer::can_repeat (Frame frame, Frame source) const
 {
-	return frame > _reels[video_reel(frame)].start();
+	return source < frame && video_reel(source) == video_reel(frame);
 }
 
 
-/** Repeat the last frame that was written to a reel as a new frame.
+/** Repeat a recently-written frame as a new frame.
  *  @param frame Frame index within the DCP of the new (repeated) frame.
  *  @param eyes Eyes that this repeated frame image is for.
+ *  @param source Frame index within the DCP of the frame to repeat.  This must have been passed to write(),
+ *  it must be one of the repeat_history frames most recently written or repeated, and
+ *  can_repeat(frame, source) must be true.
  */
 void
-Writer::repeat (Frame frame, Eyes eyes)
+Writer::repeat (Frame frame, Eyes eyes, Frame source)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
-		/* The queue is too big, and the main writer thread can run and fix it, so
-		   wake it and wait until it has done.
+	while (_queue.size() > _maximum_queue_size && next_to_write() != _queue.end()) {
+		/* The queue is too big, and the writer threads can run and fix it, so
+		   wake them and wait until they have done.
 		*/
 		_empty_condition.notify_all ();
 		_full_condition.wait (lock);
@@ -200,16 +350,19 @@ Writer::repeat (Frame frame, Eyes eyes)
 	qi.type = QueueItem::Type::REPEAT;
 	qi.reel = video_reel (frame);
 	qi.frame = frame - _reels[qi.reel].start ();
+	qi.source = source - _reels[qi.reel].start ();
 	if (film()->three_d() && eyes == Eyes::BOTH) {
 		qi.eyes = Eyes::LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		qi.eyes = Eyes::RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	}
 
+	update_queue_metrics ();
+
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
 	_empty_condition.notify_all ();
 }
@@ -220,9 +373,9 @@ Writer::fake_write (Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
-		/* The queue is too big, and the main writer thread can run and fix it, so
-		   wake it and wait until it has done.
+	while (_queue.size() > _maximum_queue_size && next_to_write() != _queue.end()) {
+		/* The queue is too big, and the writer threads can run and fix it, so
+		   wake them and wait until they have done.
 		*/
 		_empty_condition.notify_all ();
 		_full_condition.wait (lock);
@@ -234,23 +387,22 @@ Writer::fake_write (Frame frame, Eyes eyes)
 	QueueItem qi;
 	qi.type = QueueItem::Type::FAKE;
 
-	{
-		shared_ptr<InfoFileHandle> info_file = film()->info_file_handle(_reels[reel].period(), true);
-		qi.size = _reels[reel].read_frame_info(info_file, frame_in_reel, eyes).size;
-	}
+	qi.size = _reels[reel].existing_frame_info(frame_in_reel, eyes).size;
 
 	qi.reel = reel;
 	qi.frame = frame_in_reel;
 	if (film()->three_d() && eyes == Eyes::BOTH) {
 		qi.eyes = Eyes::LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		qi.eyes = Eyes::RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	}
 
+	update_queue_metrics ();
+
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
 	_empty_condition.notify_all ();
 }
@@ -286,6 +438,7 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 			t = end;
 		} else if (_audio_reel->period().to <= t) {
 			/* This reel is entirely before the start of our audio; just skip the reel */
+			_audio_reel->finish_sound ();
 			++_audio_reel;
 		} else {
 			/* This audio is over a reel boundary; split the audio into two and write the first part */
@@ -313,6 +466,7 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 				audio.reset ();
 			}
 
+			_audio_reel->finish_sound ();
 			++_audio_reel;
 			t += part_lengths[0];
 		}
@@ -333,17 +487,30 @@ Writer::write (shared_ptr<const dcp::AtmosFrame> atmos, DCPTime time, AtmosMetad
 }
 
 
-/** Caller must hold a lock on _state_mutex */
-bool
-Writer::have_sequenced_image_at_queue_head ()
+/** Caller must hold a lock on _state_mutex.
+ *  @param writer_thread Index of a writer thread, or none to consider all of them.
+ *  @return The next item that can be written to one of the reels that @p writer_thread looks after,
+ *  or _queue.end() if there is none.
+ */
+multiset<QueueItem>::iterator
+Writer::next_to_write (optional<size_t> writer_thread)
 {
-	if (_queue.empty ()) {
-		return false;
+	/* Only the first item for each reel can be written next, so look at each of those and
+	   jump straight over the rest of the reel's items.
+	*/
+	auto i = _queue.begin();
+	while (i != _queue.end()) {
+		if ((!writer_thread || (i->reel % _writer_threads) == *writer_thread) && _last_written[i->reel].next(*i)) {
+			return i;
+		}
+
+		QueueItem next_reel;
+		next_reel.reel = i->reel + 1;
+		next_reel.frame = std::numeric_limits<int>::min();
+		i = _queue.lower_bound(next_reel);
 	}
 
-	_queue.sort ();
-	auto const & f = _queue.front();
-	return _last_written[f.reel].next(f);
+	return _queue.end();
 }
 
 
@@ -377,19 +544,26 @@ Writer::LastWritten::update (QueueItem qi)
 }
 
 
+/** Thread which writes frames to some reels; reel r is written by thread r % _writer_threads,
+ *  so that frames for different reels can be written to their assets at the same time.
+ *  @param index Index of this thread.
+ */
 void
-Writer::thread ()
+Writer::thread (size_t index)
 try
 {
 	start_of_thread ("Writer");
 
+	/* The first thread also puts frames into temporary files when too many are waiting in memory */
+	bool const pusher = index == 0;
+
 	while (true)
 	{
 		boost::mutex::scoped_lock lock (_state_mutex);
 
 		while (true) {
 
-			if (_finish || _queued_full_in_memory > _maximum_frames_in_memory || have_sequenced_image_at_queue_head ()) {
+			if (_finish || (pusher && too_much_in_memory()) || next_to_write(index) != _queue.end()) {
 				/* We've got something to do: go and do it */
 				break;
 			}
@@ -400,71 +574,85 @@ try
 			LOG_TIMING (N_("writer-wake queue=%1"), _queue.size());
 		}
 
-		/* We stop here if we have been asked to finish, and if either the queue
-		   is empty or we do not have a sequenced image at its head (if this is the
-		   case we will never terminate as no new frames will be sent once
-		   _finish is true).
+		/* We stop here if we have been asked to finish, and if we do not have a sequenced
+		   image to write (if this is the case we will never terminate as no new frames will
+		   be sent once _finish is true).
 		*/
-		if (_finish && (!have_sequenced_image_at_queue_head() || _queue.empty())) {
-			/* (Hopefully temporarily) log anything that was not written */
-			if (!_queue.empty() && !have_sequenced_image_at_queue_head()) {
-				LOG_WARNING (N_("Finishing writer with a left-over queue of %1:"), _queue.size());
-				for (auto const& i: _queue) {
-					if (i.type == QueueItem::Type::FULL) {
-						LOG_WARNING (N_("- type FULL, frame %1, eyes %2"), i.frame, (int) i.eyes);
-					} else {
-						LOG_WARNING (N_("- type FAKE, size %1, frame %2, eyes %3"), i.size, i.frame, (int) i.eyes);
-					}
-				}
-			}
+		if (_finish && next_to_write(index) == _queue.end()) {
 			return;
 		}
 
 		/* Write any frames that we can write; i.e. those that are in sequence. */
-		while (have_sequenced_image_at_queue_head ()) {
-			auto qi = _queue.front ();
+		for (auto i = next_to_write(index); i != _queue.end(); i = next_to_write(index)) {
+			auto qi = *i;
 			_last_written[qi.reel].update (qi);
-			_queue.pop_front ();
+			_queue.erase (i);
 			if (qi.type == QueueItem::Type::FULL && qi.encoded) {
 				--_queued_full_in_memory;
+				_queued_full_bytes_in_memory -= qi.encoded->size();
 			}
 
 			lock.unlock ();
 
 			auto& reel = _reels[qi.reel];
+			TraceSpan span("write", qi.frame);
+			int64_t written_size = 0;
+			auto const start = std::chrono::steady_clock::now();
 
 			switch (qi.type) {
 			case QueueItem::Type::FULL:
 				LOG_DEBUG_ENCODE (N_("Writer FULL-writes %1 (%2)"), qi.frame, (int) qi.eyes);
-				if (!qi.encoded) {
-					qi.encoded.reset (new ArrayData(film()->j2c_path(qi.reel, qi.frame, qi.eyes, false)));
+				if (qi.spilled) {
+					qi.encoded = _spill_file->take(*qi.spilled, qi.size);
 				}
 				reel.write (qi.encoded, qi.frame, qi.eyes);
-				++_full_written;
+				written_size = qi.encoded->size();
 				break;
 			case QueueItem::Type::FAKE:
 				LOG_DEBUG_ENCODE (N_("Writer FAKE-writes %1"), qi.frame);
 				reel.fake_write (qi.size);
-				++_fake_written;
 				break;
 			case QueueItem::Type::REPEAT:
 				LOG_DEBUG_ENCODE (N_("Writer REPEAT-writes %1"), qi.frame);
-				reel.repeat_write (qi.frame, qi.eyes);
-				++_repeat_written;
+				reel.repeat_write (qi.frame, qi.eyes, qi.source);
 				break;
 			}
 
+			auto const time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
 			lock.lock ();
+
+			_write_time += time;
+
+			switch (qi.type) {
+			case QueueItem::Type::FULL:
+				++_full_written;
+				_disk_space_guard.frame_written (written_size);
+				break;
+			case QueueItem::Type::FAKE:
+				++_fake_written;
+				break;
+			case QueueItem::Type::REPEAT:
+				++_repeat_written;
+				break;
+			}
+
+			update_queue_metrics ();
 			_full_condition.notify_all ();
 		}
 
-		while (_queued_full_in_memory > _maximum_frames_in_memory) {
+		if (pusher) {
+			lock.unlock ();
+			check_disk_space ();
+			lock.lock ();
+		}
+
+		while (pusher && too_much_in_memory()) {
 			/* Too many frames in memory which can't yet be written to the stream.
 			   Write some FULL frames to disk.
 			*/
 
 			/* Find one from the back of the queue */
-			_queue.sort ();
 			auto i = _queue.rbegin ();
 			while (i != _queue.rend() && (i->type != QueueItem::Type::FULL || !i->encoded)) {
 				++i;
@@ -472,26 +660,38 @@ try
 
 			DCPOMATIC_ASSERT (i != _queue.rend());
 			++_pushed_to_disk;
+			static auto& spilled = Metrics::instance()->counter("dcpomatic_writer_frames_spilled_total", "Encoded frames that the writer has put in its spill file because too many were waiting in memory");
+			spilled.add ();
 			/* For the log message below */
-			int const awaiting = _last_written[_queue.front().reel].frame() + 1;
-			lock.unlock ();
+			int const awaiting = _last_written[_queue.begin()->reel].frame() + 1;
 
-			/* i is valid here, even though we don't hold a lock on the mutex,
-			   since list iterators are unaffected by insertion and only this
-			   thread could erase the last item in the list.
+			/* Take the frame out of the queue while we write it, so that no other
+			   writer thread can write it to its reel in the meantime.
 			*/
+			auto qi = *i;
+			_queue.erase (std::next(i).base());
+			lock.unlock ();
 
-			LOG_GENERAL ("Writer full; pushes %1 to disk while awaiting %2", i->frame, awaiting);
+			LOG_GENERAL ("Writer full; pushes %1 to disk while awaiting %2", qi.frame, awaiting);
 
-			i->encoded->write_via_temp (
-				film()->j2c_path(i->reel, i->frame, i->eyes, true),
-				film()->j2c_path(i->reel, i->frame, i->eyes, false)
-				);
+			if (!_spill_file) {
+				/* Only this thread creates the spill file, and nobody else will look at it until
+				   they find a spilled frame in the queue, so we needn't hold the lock here.
+				*/
+				_spill_file.reset (new SpillFile(film()->dir("j2c") / "spill"));
+			}
+			qi.spilled = _spill_file->put(*qi.encoded);
+			qi.size = qi.encoded->size();
 
 			lock.lock ();
-			i->encoded.reset ();
+			_queued_full_bytes_in_memory -= qi.encoded->size();
+			qi.encoded.reset ();
 			--_queued_full_in_memory;
+			_queue.insert (qi);
+			update_queue_metrics ();
 			_full_condition.notify_all ();
+			/* The frame's reel might be waiting for it */
+			_empty_condition.notify_all ();
 		}
 	}
 }
@@ -513,9 +713,26 @@ Writer::terminate_thread (bool can_throw)
 	_full_condition.notify_all ();
 	lock.unlock ();
 
-	try {
-		_thread.join ();
-	} catch (...) {}
+	for (auto& i: _threads) {
+		try {
+			i.join ();
+		} catch (...) {}
+	}
+	_threads.clear ();
+
+	/* (Hopefully temporarily) log anything that was not written */
+	lock.lock ();
+	if (!_queue.empty()) {
+		LOG_WARNING (N_("Finishing writer with a left-over queue of %1:"), _queue.size());
+		for (auto const& i: _queue) {
+			if (i.type == QueueItem::Type::FULL) {
+				LOG_WARNING (N_("- type FULL, frame %1, eyes %2"), i.frame, (int) i.eyes);
+			} else {
+				LOG_WARNING (N_("- type FAKE, size %1, frame %2, eyes %3"), i.size, i.frame, (int) i.eyes);
+			}
+		}
+	}
+	lock.unlock ();
 
 	if (can_throw) {
 		rethrow ();
@@ -576,16 +793,29 @@ Writer::calculate_digests ()
 void
 Writer::finish (boost::filesystem::path output_dcp)
 {
-	if (_thread.joinable()) {
-		LOG_GENERAL_NC ("Terminating writer thread");
+	if (!_threads.empty()) {
+		LOG_GENERAL_NC ("Terminating writer threads");
 		terminate_thread (true);
 	}
 
+	unique_ptr<BackgroundUploader> uploader;
+	if (!_text_only && Config::instance()->upload_after_make_dcp()) {
+		/* Start sending assets to the TMS as soon as each one is ready, so that uploading
+		   overlaps the rest of the work here.
+		*/
+		uploader.reset (new BackgroundUploader(output_dcp));
+	}
+
 	LOG_GENERAL_NC ("Finishing ReelWriters");
 
 	for (auto& i: _reels) {
 		write_hanging_text (i);
 		i.finish (output_dcp);
+		if (uploader) {
+			for (auto const& file: i.finished_files()) {
+				uploader->add (file);
+			}
+		}
 	}
 
 	LOG_GENERAL_NC ("Writing XML");
@@ -600,7 +830,9 @@ Writer::finish (boost::filesystem::path output_dcp)
 
 	dcp.add (cpl);
 
+	auto const digest_start = std::chrono::steady_clock::now();
 	calculate_digests ();
+	_digest_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - digest_start).count();
 
 	/* Add reels */
 
@@ -703,6 +935,41 @@ Writer::finish (boost::filesystem::path output_dcp)
 		);
 
 	write_cover_sheet (output_dcp);
+
+	if (!_text_only && Config::instance()->verify_after_make_dcp()) {
+		/* Check the DCP while it is uploaded, using the digests that we have just calculated
+		   rather than reading the assets again for them.
+		*/
+		map<string, string> digests;
+		for (auto asset: cpl->reel_file_assets()) {
+			if (asset->asset_ref().resolved()) {
+				digests[asset->asset_ref().id()] = asset->asset_ref().asset()->hash();
+			}
+		}
+		auto verify = make_shared<VerifyDCPJob>(vector<boost::filesystem::path>{output_dcp}, VerifyDCPJob::Level::SAMPLED_FRAMES);
+		verify->set_known_digests (digests);
+		JobManager::instance()->add (verify);
+	}
+
+	if (uploader) {
+		/* Now the CPL, PKL and so on can go */
+		uploader->add_remaining ();
+		auto job = _job.lock ();
+		if (job) {
+			job->sub (_("Copying DCP to TMS"));
+		}
+		try {
+			uploader->finish ([job](float progress) {
+				if (job) {
+					job->set_progress (progress);
+				}
+			});
+		} catch (std::exception& e) {
+			/* The DCP is fine, so don't fail because of this; try again the old way */
+			LOG_ERROR ("Upload of DCP while writing failed (%1); trying again", e.what());
+			JobManager::instance()->add(make_shared<UploadJob>(film()));
+		}
+	}
 }
 
 
@@ -782,6 +1049,38 @@ Writer::write_cover_sheet (boost::filesystem::path output_dcp)
 }
 
 
+/** @return The time from which the player must run to make the rest of the DCP.  Reels at the
+ *  start whose picture and sound assets are already complete (perhaps because an earlier encode
+ *  was interrupted) can be skipped, as long as there is nothing else to go in them (subtitles,
+ *  closed captions or Atmos) which is only kept in memory while the DCP is being made.
+ */
+DCPTime
+Writer::resume_time () const
+{
+	if (film()->contains_atmos_content()) {
+		return {};
+	}
+
+	for (auto content: film()->content()) {
+		for (auto text: content->text) {
+			if (text->use() && !text->burn()) {
+				return {};
+			}
+		}
+	}
+
+	DCPTime time;
+	for (auto const& reel: _reels) {
+		if (!reel.complete()) {
+			break;
+		}
+		time = reel.period().to;
+	}
+
+	return time;
+}
+
+
 /** @param frame Frame index within the whole DCP.
  *  @return true if we can fake-write this frame.
  */
@@ -963,6 +1262,20 @@ Writer::set_encoder_threads (int threads)
 }
 
 
+/** Fill in the parts of @p report that we know about; should be called after finish() */
+void
+Writer::fill_report (PerformanceReport& report) const
+{
+	boost::mutex::scoped_lock lm (_state_mutex);
+	report.full_written = _full_written;
+	report.fake_written = _fake_written;
+	report.repeat_written = _repeat_written;
+	report.spilled = _pushed_to_disk;
+	report.write_time = _write_time;
+	report.digest_time = _digest_time;
+}
+
+
 void
 Writer::write (ReferencedReelAsset asset)
 {
@@ -1012,8 +1325,9 @@ try
 	for (auto const& i: _reel_assets) {
 		auto file = dynamic_pointer_cast<dcp::ReelFileAsset>(i.asset);
 		if (file && !file->hash()) {
-			file->asset_ref().asset()->hash (set_progress);
-			file->set_hash (file->asset_ref().asset()->hash());
+			auto asset = file->asset_ref().asset();
+			asset->set_hash (asset_digest(asset->file().get(), set_progress));
+			file->set_hash (asset->hash());
 		}
 	}
 } catch (boost::thread_interrupted) {
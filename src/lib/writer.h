@@ -31,15 +31,19 @@
 #include "atmos_metadata.h"
 #include "dcp_text_track.h"
 #include "dcpomatic_time.h"
+#include "disk_space_guard.h"
 #include "exception_store.h"
 #include "font_id_map.h"
+#include "memory_budget.h"
 #include "player_text.h"
 #include "types.h"
 #include "weak_film.h"
 #include <dcp/atmos_frame.h>
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
+#include <chrono>
 #include <list>
+#include <set>
 
 
 namespace dcp {
@@ -49,8 +53,10 @@ namespace dcp {
 class AudioBuffers;
 class Film;
 class Job;
+class PerformanceReport;
 class ReelWriter;
 class ReferencedReelAsset;
+class SpillFile;
 struct writer_disambiguate_font_ids1;
 struct writer_disambiguate_font_ids2;
 struct writer_disambiguate_font_ids3;
@@ -74,12 +80,16 @@ public:
 
 	/** encoded data for FULL */
 	std::shared_ptr<const dcp::Data> encoded;
-	/** size of data for FAKE */
+	/** size of data for FAKE, or for a FULL frame whose data is in the spill file */
 	int size = 0;
+	/** offset of the data for a FULL frame in the spill file, if it has been put there */
+	boost::optional<int64_t> spilled;
 	/** reel index */
 	size_t reel = 0;
 	/** frame index within the reel */
 	int frame = 0;
+	/** frame index within the reel of the frame to repeat, for REPEAT */
+	int source = 0;
 	/** eyes for FULL, FAKE and REPEAT */
 	Eyes eyes = Eyes::BOTH;
 };
@@ -98,6 +108,10 @@ bool operator== (QueueItem const & a, QueueItem const & b);
  *
  *  write() for Data (picture) can be called out of order, and the Writer
  *  will sort it out.  write() for AudioBuffers must be called in order.
+ *
+ *  Pictures are written by a few threads which each look after some of the reels,
+ *  taking frames from a shared queue as soon as they are next in their reel; this
+ *  means that frames for a reel need not wait for earlier reels to be finished.
  */
 
 class Writer : public ExceptionStore, public WeakConstFilm
@@ -112,11 +126,12 @@ public:
 	void start ();
 
 	bool can_fake_write (Frame) const;
+	dcpomatic::DCPTime resume_time () const;
 
 	void write (std::shared_ptr<const dcp::Data>, Frame, Eyes);
 	void fake_write (Frame, Eyes);
-	bool can_repeat (Frame) const;
-	void repeat (Frame, Eyes);
+	bool can_repeat (Frame frame, Frame source) const;
+	void repeat (Frame frame, Eyes eyes, Frame source);
 	void write (std::shared_ptr<const AudioBuffers>, dcpomatic::DCPTime time);
 	void write (PlayerText text, TextType type, boost::optional<DCPTextTrack>, dcpomatic::DCPTimePeriod period);
 	void write (std::vector<std::shared_ptr<dcpomatic::Font>> fonts);
@@ -125,15 +140,23 @@ public:
 	void finish (boost::filesystem::path output_dcp);
 
 	void set_encoder_threads (int threads);
+	void fill_report (PerformanceReport& report) const;
+	boost::optional<std::string> disk_space_warning () const;
+
+	/** Number of recently-written frames that repeat() can be asked to copy */
+	static int const repeat_history = 8;
 
 private:
 	friend struct ::writer_disambiguate_font_ids1;
 	friend struct ::writer_disambiguate_font_ids2;
 	friend struct ::writer_disambiguate_font_ids3;
 
-	void thread ();
+	void thread (size_t index);
 	void terminate_thread (bool);
-	bool have_sequenced_image_at_queue_head ();
+	std::multiset<QueueItem>::iterator next_to_write (boost::optional<size_t> writer_thread = boost::none);
+	bool too_much_in_memory () const;
+	void update_queue_metrics () const;
+	void check_disk_space ();
 	size_t video_reel (int frame) const;
 	void set_digest_progress (Job* job, float progress);
 	void write_cover_sheet (boost::filesystem::path output_dcp);
@@ -148,14 +171,20 @@ private:
 	std::map<DCPTextTrack, std::vector<ReelWriter>::iterator> _caption_reels;
 	std::vector<ReelWriter>::iterator _atmos_reel;
 
-	/** our thread */
-	boost::thread _thread;
-	/** true if our thread should finish */
+	/** our writer threads */
+	std::vector<boost::thread> _threads;
+	/** number of writer threads that we have started */
+	size_t _writer_threads = 1;
+	/** true if our threads should finish */
 	bool _finish = false;
-	/** queue of things to write to disk */
-	std::list<QueueItem> _queue;
+	/** queue of things to write to disk, kept in order */
+	std::multiset<QueueItem> _queue;
 	/** number of FULL frames whose JPEG200 data is currently held in RAM */
 	int _queued_full_in_memory = 0;
+	/** total size of the JPEG2000 data of those frames, in bytes */
+	int64_t _queued_full_bytes_in_memory = 0;
+	/** _queued_full_bytes_in_memory, as told to the MemoryBudget */
+	mutable MemoryBudget::Share _memory{MemoryBudget::Subsystem::WRITER_QUEUE};
 	/** mutex for thread state */
 	mutable boost::mutex _state_mutex;
 	/** condition to manage thread wakeups when we have nothing to do  */
@@ -166,6 +195,10 @@ private:
 	 *  ordering
 	 */
 	int _maximum_frames_in_memory;
+	/** maximum number of bytes of JPEG2000 data to hold in memory, once we have
+	 *  _maximum_frames_in_memory frames
+	 */
+	int64_t _maximum_bytes_in_memory;
 	unsigned int _maximum_queue_size;
 
 	class LastWritten
@@ -201,6 +234,17 @@ private:
 	    due to the limit of frames to be held in memory.
 	*/
 	int _pushed_to_disk = 0;
+	/** total time that the writer threads have spent writing frames to their reels, in seconds */
+	double _write_time = 0;
+	/** time that calculate_digests() took, in seconds */
+	double _digest_time = 0;
+	/** file to put frames in when there are too many to keep in memory; created when it is first needed */
+	std::unique_ptr<SpillFile> _spill_file;
+
+	/** estimates, from the frames written so far, whether the rest of the encode will fit on the disk */
+	DiskSpaceGuard _disk_space_guard;
+	/** time that the first writer thread last looked at how much disk space is left */
+	boost::optional<std::chrono::steady_clock::time_point> _last_disk_space_check;
 
 	bool _text_only;
 
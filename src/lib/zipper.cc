@@ -45,6 +45,29 @@ Zipper::Zipper (boost::filesystem::path file)
 }
 
 
+#ifdef DCPOMATIC_HAVE_ZIP_SOURCE_T
+/** Make a ZIP file in memory, which can be fetched with data() after close() */
+Zipper::Zipper ()
+{
+	zip_error_t error;
+	zip_error_init (&error);
+	_memory = zip_source_buffer_create (nullptr, 0, 0, &error);
+	if (!_memory) {
+		throw runtime_error ("could not create ZIP buffer");
+	}
+
+	_zip = zip_open_from_source (_memory, ZIP_TRUNCATE, &error);
+	if (!_zip) {
+		zip_source_free (_memory);
+		throw runtime_error ("could not create ZIP file in memory");
+	}
+
+	/* Keep the buffer when _zip is closed so that we can read the finished file out of it */
+	zip_source_keep (_memory);
+}
+#endif
+
+
 void
 Zipper::add (string name, string content)
 {
@@ -69,6 +92,24 @@ Zipper::close ()
 		throw runtime_error ("failed to close ZIP archive");
 	}
 	_zip = 0;
+
+#ifdef DCPOMATIC_HAVE_ZIP_SOURCE_T
+	if (_memory) {
+		zip_stat_t stat;
+		zip_stat_init (&stat);
+		if (zip_source_open(_memory) == -1 || zip_source_stat(_memory, &stat) == -1) {
+			throw runtime_error ("could not read ZIP archive from memory");
+		}
+		_data = dcp::ArrayData (stat.size);
+		auto const read = zip_source_read (_memory, _data.data(), stat.size);
+		zip_source_close (_memory);
+		if (read != static_cast<zip_int64_t>(stat.size)) {
+			throw runtime_error ("could not read ZIP archive from memory");
+		}
+		zip_source_free (_memory);
+		_memory = nullptr;
+	}
+#endif
 }
 
 
@@ -77,4 +118,9 @@ Zipper::~Zipper ()
 	if (_zip) {
 		zip_close(_zip);
 	}
+#ifdef DCPOMATIC_HAVE_ZIP_SOURCE_T
+	if (_memory) {
+		zip_source_free (_memory);
+	}
+#endif
 }
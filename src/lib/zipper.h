@@ -19,6 +19,7 @@
 */
 
 
+#include <dcp/array_data.h>
 #include <boost/filesystem.hpp>
 #include <memory>
 #include <vector>
@@ -28,6 +29,9 @@ class Zipper
 {
 public:
 	Zipper (boost::filesystem::path file);
+#ifdef DCPOMATIC_HAVE_ZIP_SOURCE_T
+	Zipper ();
+#endif
 	~Zipper ();
 
 	Zipper (Zipper const&) = delete;
@@ -36,8 +40,16 @@ public:
 	void add (std::string name, std::string content);
 	void close ();
 
+	/** @return the finished ZIP file, if it was made in memory; only valid after close() */
+	dcp::ArrayData const& data () const {
+		return _data;
+	}
+
 private:
 	struct zip* _zip;
+	/** buffer that we are writing to, if we are making the ZIP file in memory */
+	struct zip_source* _memory = nullptr;
+	dcp::ArrayData _data;
 	std::vector<std::shared_ptr<std::string>> _store;
 };
 
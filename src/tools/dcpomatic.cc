@@ -78,6 +78,7 @@
 #include "lib/kdm_with_metadata.h"
 #include "lib/log.h"
 #include "lib/make_dcp.h"
+#include "lib/metadata_writer.h"
 #include "lib/release_notes.h"
 #include "lib/screen.h"
 #include "lib/send_kdm_email_job.h"
@@ -637,7 +638,7 @@ private:
 
 	void file_save ()
 	{
-		_film->write_metadata ();
+		_film->write_metadata_soon ();
 	}
 
 	void file_save_as_template ()
@@ -1235,6 +1236,13 @@ private:
 			}
 		}
 
+		/* Make sure that anything saved in the background is on disk before we go */
+		try {
+			MetadataWriter::instance()->flush();
+		} catch (std::exception& e) {
+			error_dialog (this, _("Could not save film."), std_to_wx(e.what()));
+		}
+
 		/* We don't want to hear about any more configuration changes, since they
 		   cause the File menu to be altered, which itself will be deleted around
 		   now (without, as far as I can see, any way for us to find out).
@@ -1461,32 +1469,15 @@ private:
 
 	void config_changed (Config::Property what)
 	{
-		/* Instantly save any config changes when using the DCP-o-matic GUI */
-		if (what == Config::CINEMAS) {
-			try {
-				Config::instance()->write_cinemas();
-			} catch (exception& e) {
-				error_dialog (
-					this,
-					wxString::Format (
-						_("Could not write to cinemas file at %s.  Your changes have not been saved."),
-						std_to_wx (Config::instance()->cinemas_file().string()).data()
-						)
-					);
-			}
-		} else {
-			try {
-				Config::instance()->write_config();
-			} catch (exception& e) {
-				error_dialog (
-					this,
-					wxString::Format (
-						_("Could not write to config file at %s.  Your changes have not been saved."),
-						std_to_wx (Config::instance()->cinemas_file().string()).data()
-						)
-					);
-			}
+		/* Save any config changes when using the DCP-o-matic GUI.  This is done in the background,
+		 * so report any problem with the previous save before we start another.
+		 */
+		try {
+			MetadataWriter::instance()->rethrow();
+		} catch (exception& e) {
+			error_dialog (this, _("Your changes could not be saved."), std_to_wx(e.what()));
 		}
+		Config::instance()->write_soon(what);
 
 		for (int i = 0; i < _history_items; ++i) {
 			delete _file_menu->Remove (ID_file_history + i);
@@ -33,6 +33,7 @@
 #include "lib/job.h"
 #include "lib/job_manager.h"
 #include "lib/make_dcp.h"
+#include "lib/normalise_loudness_job.h"
 #include "lib/transcode_job.h"
 #include "lib/util.h"
 #include "lib/version.h"
@@ -65,10 +66,12 @@ using namespace boost::placeholders;
 
 
 static list<boost::filesystem::path> films_to_load;
+static boost::optional<double> loudness_to_normalise_to;
 
 
 enum {
 	ID_file_add_film = 1,
+	ID_file_normalise_loudness,
 	ID_tools_encoding_servers,
 	ID_help_about
 };
@@ -79,6 +82,7 @@ setup_menu (wxMenuBar* m)
 {
 	auto file = new wxMenu;
 	file->Append (ID_file_add_film, _("&Add Film...\tCtrl-A"));
+	file->Append (ID_file_normalise_loudness, _("&Normalise Loudness of Films..."));
 #ifdef DCPOMATIC_OSX
 	file->Append (wxID_EXIT, _("&Exit"));
 #else
@@ -121,6 +125,7 @@ public:
 		Config::instance()->Changed.connect (boost::bind (&DOMFrame::config_changed, this, _1));
 
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_add_film, this),    ID_file_add_film);
+		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_normalise_loudness, this), ID_file_normalise_loudness);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_quit, this),        wxID_EXIT);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::edit_preferences, this), wxID_PREFERENCES);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::tools_encoding_servers, this), ID_tools_encoding_servers);
@@ -223,6 +228,19 @@ public:
 		}
 	}
 
+	/** Add a job to change the gains of a film's audio so that its integrated loudness is `target' LUFS */
+	void start_normalise_loudness_job (boost::filesystem::path path, double target)
+	{
+		try {
+			auto film = make_shared<Film>(path);
+			film->read_metadata ();
+			JobManager::instance()->add(make_shared<NormaliseLoudnessJob>(film, target));
+		} catch (std::exception& e) {
+			auto p = std_to_wx (path.string ());
+			error_dialog (this, wxString::Format(_("Could not open film at %s"), p.data()), std_to_wx(e.what()));
+		}
+	}
+
 private:
 	void sized (wxSizeEvent& ev)
 	{
@@ -263,6 +281,52 @@ private:
 		add_film ();
 	}
 
+	/** Normalise the loudness of a film, or of every film in a folder */
+	void file_normalise_loudness ()
+	{
+		auto c = new wxDirDialog (this, _("Select film, or folder of films"), wxStandardPaths::Get().GetDocumentsDir(), wxDEFAULT_DIALOG_STYLE | wxDD_DIR_MUST_EXIST);
+		if (_last_parent) {
+			c->SetPath (std_to_wx(_last_parent.get().string()));
+		}
+
+		int const r = c->ShowModal ();
+		boost::filesystem::path const folder = wx_to_std (c->GetPath());
+		c->Destroy ();
+
+		if (r != wxID_OK) {
+			return;
+		}
+
+		list<boost::filesystem::path> films;
+		if (boost::filesystem::exists(folder / "metadata.xml")) {
+			films.push_back (folder);
+		} else {
+			for (auto i: boost::filesystem::directory_iterator(folder)) {
+				if (boost::filesystem::is_directory(i.path()) && boost::filesystem::exists(i.path() / "metadata.xml")) {
+					films.push_back (i.path());
+				}
+			}
+		}
+
+		if (films.empty()) {
+			error_dialog (this, _("No films were found in that folder."));
+			return;
+		}
+
+		auto const target = wxGetTextFromUser (_("Integrated loudness to normalise to (LUFS)"), _("Normalise loudness"), wxT("-24"), this);
+		double target_lufs;
+		if (target.IsEmpty()) {
+			return;
+		} else if (!target.ToDouble(&target_lufs)) {
+			error_dialog (this, _("That is not a valid loudness."));
+			return;
+		}
+
+		for (auto i: films) {
+			start_normalise_loudness_job (i, target_lufs);
+		}
+	}
+
 	void file_quit ()
 	{
 		if (should_close()) {
@@ -360,6 +424,7 @@ private:
 
 
 static const wxCmdLineEntryDesc command_line_description[] = {
+	{ wxCMD_LINE_OPTION, "l", "normalise-loudness", "normalise films to this integrated loudness (LUFS) before making their DCPs", wxCMD_LINE_VAL_DOUBLE, wxCMD_LINE_PARAM_OPTIONAL },
 	{ wxCMD_LINE_PARAM, 0, 0, "film to load", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_MULTIPLE | wxCMD_LINE_PARAM_OPTIONAL },
 	{ wxCMD_LINE_NONE, "", "", "", wxCmdLineParamType (0), 0 }
 };
@@ -454,6 +519,10 @@ class App : public wxApp
 				try {
 					film = make_shared<Film>(i);
 					film->read_metadata ();
+					if (loudness_to_normalise_to) {
+						/* The DCP will not be started until this job has finished */
+						JobManager::instance()->add(make_shared<NormaliseLoudnessJob>(film, *loudness_to_normalise_to));
+					}
 					make_dcp (film, TranscodeJob::ChangedBehaviour::EXAMINE_THEN_STOP);
 				} catch (exception& e) {
 					error_dialog (
@@ -485,6 +554,11 @@ class App : public wxApp
 			films_to_load.push_back (wx_to_std(parser.GetParam(i)));
 		}
 
+		double loudness;
+		if (parser.Found(wxT("normalise-loudness"), &loudness)) {
+			loudness_to_normalise_to = loudness;
+		}
+
 		return true;
 	}
 
@@ -0,0 +1,651 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/tools/dcpomatic_bench.cc
+ *  @brief Benchmark the stages of the DCP encode pipeline one at a time.
+ *
+ *  Each stage is run single-threaded on the same set of frames, which are either
+ *  made up (the same every time) or decoded from a film or a piece of content,
+ *  and the results are written as JSON so that they can be kept and compared
+ *  with later runs.
+ */
+
+
+#include "lib/audio_buffers.h"
+#include "lib/colour_conversion.h"
+#include "lib/content.h"
+#include "lib/content_factory.h"
+#include "lib/cross.h"
+#include "lib/dcp_content_type.h"
+#include "lib/dcp_video.h"
+#include "lib/encode_server_description.h"
+#include "lib/film.h"
+#include "lib/image.h"
+#include "lib/image_png.h"
+#include "lib/j2k_encode_backend.h"
+#include "lib/job_manager.h"
+#include "lib/player.h"
+#include "lib/player_video.h"
+#include "lib/ratio.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/signal_manager.h"
+#include "lib/util.h"
+#include "lib/version.h"
+#include "lib/video_content.h"
+#include "lib/writer.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/raw_convert.h>
+#include <dcp/util.h>
+#include <boost/filesystem.hpp>
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+
+using std::cerr;
+using std::cout;
+using std::function;
+using std::list;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::weak_ptr;
+using boost::optional;
+using dcp::raw_convert;
+
+
+/** Version of the JSON that we write */
+static int const results_version = 1;
+/** Frame rate and bandwidth used for the J2K stages, unless a film says otherwise */
+static int const default_frame_rate = 24;
+static int const default_bandwidth = 150000000;
+
+static list<string> const all_stages = { "decode", "crop_scale_window", "convert_to_xyz", "compress_j2k", "remote", "writer" };
+
+
+class SimpleSignalManager : public SignalManager
+{
+public:
+	/* Do nothing in this method so that UI events happen in our thread
+	   when we call SignalManager::ui_idle().
+	*/
+	void wake_ui () override {}
+};
+
+
+/** Timings of one stage */
+class Result
+{
+public:
+	explicit Result (string name_)
+		: name (name_)
+	{}
+
+	double fps () const {
+		return total > 0 ? times.size() / total : 0;
+	}
+
+	/** @param p Percentile (between 0 and 100).
+	 *  @return Time taken by a frame at that percentile, in seconds.
+	 */
+	double percentile (double p) const {
+		if (times.empty()) {
+			return 0;
+		}
+		auto sorted = times;
+		std::sort (sorted.begin(), sorted.end());
+		auto const index = static_cast<size_t>(std::ceil(p * sorted.size() / 100)) - 1;
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	string name;
+	/** time taken for each frame, in seconds */
+	vector<double> times;
+	/** total time for all frames, in seconds; this is more than the sum of times
+	 *  if the stage has work to do after the last frame (e.g. the writer finishing off).
+	 */
+	double total = 0;
+	optional<double> baseline_fps;
+};
+
+
+static double
+since (std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/** Run @p work on frames 0 to @p frames - 1 after one untimed run on frame 0
+ *  (so caches and lookup tables are set up).
+ *  @param work Function to process a frame and return the time that it took in seconds,
+ *  so that it can leave any preparation out of the timing.
+ */
+static Result
+measure (string name, int frames, function<double (int)> work)
+{
+	cerr << "Running " << name << "...\n";
+
+	Result result (name);
+	work (0);
+	for (int i = 0; i < frames; ++i) {
+		auto const time = work (i);
+		result.times.push_back (time);
+		result.total += time;
+	}
+	return result;
+}
+
+
+/** @return A made-up 1080p YUV frame with some gradients and some noise, which is the same every time for a given @p index */
+static shared_ptr<Image>
+synthetic_image (int index)
+{
+	auto const size = dcp::Size(1920, 1080);
+	auto image = make_shared<Image>(AV_PIX_FMT_YUV420P, size, Image::Alignment::PADDED);
+
+	uint32_t seed = 1 + index;
+	auto noise = [&seed]() {
+		seed = seed * 1664525 + 1013904223;
+		return static_cast<int>(seed >> 28);
+	};
+
+	for (int c = 0; c < 3; ++c) {
+		auto const plane = image->sample_size(c);
+		for (int y = 0; y < plane.height; ++y) {
+			auto p = image->data()[c] + y * image->stride()[c];
+			for (int x = 0; x < plane.width; ++x) {
+				*p++ = static_cast<uint8_t>((x + y * (c + 1) + index * 4) / (c + 1) + noise());
+			}
+		}
+	}
+
+	return image;
+}
+
+
+static shared_ptr<PlayerVideo>
+player_video (shared_ptr<const Image> image, dcp::Size out_size)
+{
+	auto const inter_size = fit_ratio_within(image->size().ratio(), out_size);
+	return make_shared<PlayerVideo>(
+		make_shared<RawImageProxy>(image),
+		Crop(),
+		optional<double>(),
+		inter_size,
+		out_size,
+		Eyes::BOTH,
+		Part::WHOLE,
+		ColourConversion(),
+		VideoRange::VIDEO,
+		weak_ptr<Content>(),
+		optional<Frame>(),
+		false
+		);
+}
+
+
+/** Wait for any jobs (e.g. examining content) to finish.
+ *  @return false if any failed.
+ */
+static bool
+wait_for_jobs ()
+{
+	auto jm = JobManager::instance();
+	while (jm->work_to_do()) {
+		while (signal_manager->ui_idle()) {}
+		dcpomatic_sleep_milliseconds (100);
+	}
+	while (signal_manager->ui_idle()) {}
+	return !jm->errors();
+}
+
+
+/** @return A new film in @p directory containing @p content, ready to be played or written */
+static shared_ptr<Film>
+make_film (boost::filesystem::path directory, vector<shared_ptr<Content>> content)
+{
+	auto film = make_shared<Film>(directory);
+	film->set_name ("Benchmark");
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name("TST"));
+	film->set_container (Ratio::from_id("185"));
+	film->write_metadata ();
+
+	for (auto i: content) {
+		film->examine_and_add_content (i);
+	}
+
+	if (!wait_for_jobs()) {
+		throw std::runtime_error ("could not examine content");
+	}
+
+	return film;
+}
+
+
+/** Play @p film to get @p count frames, timing the decode of each */
+static Result
+decode (shared_ptr<Film> film, int count, vector<shared_ptr<PlayerVideo>>& frames, vector<shared_ptr<const Image>>& images)
+{
+	cerr << "Running decode...\n";
+
+	Result result ("decode");
+
+	Player player (film, Image::Alignment::COMPACT);
+	player.set_ignore_audio ();
+	player.set_ignore_text ();
+
+	auto start = std::chrono::steady_clock::now();
+	bool first = true;
+	player.Video.connect ([&](shared_ptr<PlayerVideo> pv, dcpomatic::DCPTime) {
+		if (static_cast<int>(frames.size()) >= count) {
+			return;
+		}
+		/* Make sure the image has really been decoded */
+		images.push_back (pv->raw_image());
+		frames.push_back (pv);
+		auto const time = since (start);
+		/* The first frame includes opening the content, so leave it out */
+		if (!first) {
+			result.times.push_back (time);
+			result.total += time;
+		}
+		first = false;
+		start = std::chrono::steady_clock::now();
+	});
+
+	while (static_cast<int>(frames.size()) < count && !player.pass()) {}
+
+	return result;
+}
+
+
+static Result
+writer (boost::filesystem::path directory, vector<shared_ptr<dcp::ArrayData>> const& encoded)
+{
+	cerr << "Running writer...\n";
+
+	/* The writer needs a film with content as long as the frames that we are going to give it */
+	auto still = directory / "still.png";
+	image_as_png(synthetic_image(0)).write(still);
+	auto content = content_factory(still);
+	auto film = make_film (directory / "writer", content);
+	content[0]->video->set_length (encoded.size());
+	film->set_video_frame_rate (default_frame_rate);
+
+	Result result ("writer");
+
+	auto const audio_frames = film->audio_frame_rate() / default_frame_rate;
+	auto audio = make_shared<AudioBuffers>(film->audio_channels(), audio_frames);
+	audio->make_silent ();
+
+	auto const start = std::chrono::steady_clock::now();
+
+	Writer writer (film, weak_ptr<Job>());
+	writer.start ();
+
+	for (size_t i = 0; i < encoded.size(); ++i) {
+		auto const frame_start = std::chrono::steady_clock::now();
+		writer.write (encoded[i], i, Eyes::BOTH);
+		writer.write (audio, dcpomatic::DCPTime::from_frames(i, default_frame_rate));
+		result.times.push_back (since(frame_start));
+	}
+
+	writer.finish (film->dir(film->dcp_name()));
+	result.total = since (start);
+
+	return result;
+}
+
+
+/** @return fps of @p stage in a set of results that we wrote earlier, if it is there */
+static optional<double>
+baseline_fps (string const& json, string stage)
+{
+	auto const s = json.find("\"" + stage + "\": {");
+	if (s == string::npos) {
+		return {};
+	}
+
+	string const key = "\"fps\": ";
+	auto const f = json.find(key, s);
+	if (f == string::npos || json.find("}", s) < f) {
+		return {};
+	}
+
+	try {
+		return raw_convert<double>(json.substr(f + key.length(), json.find_first_of(",}\n", f) - f - key.length()));
+	} catch (...) {
+		return {};
+	}
+}
+
+
+static string
+to_json (string content, int frames, list<Result> const& results, double tolerance)
+{
+	auto milliseconds = [](double seconds) {
+		return raw_convert<string>(seconds * 1000, 4, true);
+	};
+
+	string json = "{\n";
+	json += "  \"version\": " + raw_convert<string>(results_version) + ",\n";
+	json += "  \"dcpomatic\": \"" + string(dcpomatic_version) + " " + string(dcpomatic_git_commit) + "\",\n";
+	json += "  \"content\": \"" + content + "\",\n";
+	json += "  \"frames\": " + raw_convert<string>(frames) + ",\n";
+	json += "  \"stages\": {\n";
+
+	int n = 0;
+	for (auto const& i: results) {
+		json += "    \"" + i.name + "\": {\n";
+		json += "      \"frames\": " + raw_convert<string>(i.times.size()) + ",\n";
+		json += "      \"seconds\": " + raw_convert<string>(i.total, 6, true) + ",\n";
+		json += "      \"p50_ms\": " + milliseconds(i.percentile(50)) + ",\n";
+		json += "      \"p90_ms\": " + milliseconds(i.percentile(90)) + ",\n";
+		json += "      \"p99_ms\": " + milliseconds(i.percentile(99)) + ",\n";
+		json += "      \"max_ms\": " + milliseconds(i.percentile(100)) + ",\n";
+		if (i.baseline_fps && *i.baseline_fps > 0) {
+			auto const change = (i.fps() - *i.baseline_fps) * 100 / *i.baseline_fps;
+			json += "      \"baseline_fps\": " + raw_convert<string>(*i.baseline_fps, 3, true) + ",\n";
+			json += "      \"change_percent\": " + raw_convert<string>(change, 2, true) + ",\n";
+			json += string("      \"regression\": ") + (change < -tolerance ? "true" : "false") + ",\n";
+		}
+		/* fps goes last so that baseline_fps() can find it without a JSON parser */
+		json += "      \"fps\": " + raw_convert<string>(i.fps(), 3, true) + "\n";
+		json += "    }";
+		if (++n != static_cast<int>(results.size())) {
+			json += ",";
+		}
+		json += "\n";
+	}
+
+	json += "  }\n";
+	json += "}\n";
+	return json;
+}
+
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " [OPTION]\n"
+	     << "  -h, --help                  show this help\n"
+	     << "  -f, --film <dir>            use frames from an existing film\n"
+	     << "  -c, --content <file>        use frames from some content (e.g. something in test/data)\n"
+	     << "  -n, --frames <n>            number of frames to use for each stage (default 48)\n"
+	     << "  -s, --stage <name>          run only this stage; may be given more than once\n"
+	     << "  -r, --server <host>         encode server to use for the remote stage\n"
+	     << "  -o, --output <file>         write results to a file rather than stdout\n"
+	     << "  -b, --baseline <file>       compare with results written earlier\n"
+	     << "  -t, --tolerance <percent>   slow-down compared to the baseline that counts as a regression (default 10)\n"
+	     << "\n"
+	     << "Stages are decode, crop_scale_window, convert_to_xyz, compress_j2k, remote and writer.\n"
+	     << "Without --film or --content made-up 1080p frames are used, and there is no decode stage.\n"
+	     << "The remote stage needs --server.  Exit status is 2 if any stage has regressed.\n";
+}
+
+
+int
+main (int argc, char* argv[])
+{
+	optional<boost::filesystem::path> film_dir;
+	optional<boost::filesystem::path> content_file;
+	int frames = 48;
+	list<string> stages;
+	optional<string> server_host;
+	optional<boost::filesystem::path> output;
+	optional<boost::filesystem::path> baseline;
+	double tolerance = 10;
+
+	int option_index = 0;
+	while (true) {
+		static struct option long_options[] = {
+			{ "help", no_argument, 0, 'h' },
+			{ "film", required_argument, 0, 'f' },
+			{ "content", required_argument, 0, 'c' },
+			{ "frames", required_argument, 0, 'n' },
+			{ "stage", required_argument, 0, 's' },
+			{ "server", required_argument, 0, 'r' },
+			{ "output", required_argument, 0, 'o' },
+			{ "baseline", required_argument, 0, 'b' },
+			{ "tolerance", required_argument, 0, 't' },
+			{ 0, 0, 0, 0 }
+		};
+
+		int c = getopt_long (argc, argv, "hf:c:n:s:r:o:b:t:", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'h':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		case 'f':
+			film_dir = optarg;
+			break;
+		case 'c':
+			content_file = optarg;
+			break;
+		case 'n':
+			frames = atoi (optarg);
+			break;
+		case 's':
+			stages.push_back (optarg);
+			break;
+		case 'r':
+			server_host = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'b':
+			baseline = optarg;
+			break;
+		case 't':
+			tolerance = atof (optarg);
+			break;
+		}
+	}
+
+	if (film_dir && content_file) {
+		cerr << "Only one of --film and --content can be given\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (frames < 1) {
+		cerr << "--frames must be at least 1\n";
+		exit (EXIT_FAILURE);
+	}
+
+	for (auto const& i: stages) {
+		if (std::find(all_stages.begin(), all_stages.end(), i) == all_stages.end()) {
+			cerr << "Unrecognised stage " << i << "\n";
+			exit (EXIT_FAILURE);
+		}
+	}
+
+	if (stages.empty()) {
+		stages = all_stages;
+		if (!film_dir && !content_file) {
+			stages.remove ("decode");
+		}
+		if (!server_host) {
+			stages.remove ("remote");
+		}
+	}
+
+	auto run = [&stages](string stage) {
+		return std::find(stages.begin(), stages.end(), stage) != stages.end();
+	};
+
+	if (run("decode") && !film_dir && !content_file) {
+		cerr << "The decode stage needs --film or --content\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (run("remote") && !server_host) {
+		cerr << "The remote stage needs --server\n";
+		exit (EXIT_FAILURE);
+	}
+
+	dcpomatic_setup_path_encoding ();
+	dcpomatic_setup ();
+	signal_manager = new SimpleSignalManager ();
+
+	auto const temporary = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("dcpomatic_bench_%%%%%%%%");
+	boost::filesystem::create_directories (temporary);
+
+	list<Result> results;
+	string content_description = "synthetic";
+
+	try {
+		int frame_rate = default_frame_rate;
+		int bandwidth = default_bandwidth;
+
+		/* The frames that each stage will work on */
+		vector<shared_ptr<PlayerVideo>> player_videos;
+		vector<shared_ptr<const Image>> images;
+
+		if (film_dir || content_file) {
+			shared_ptr<Film> film;
+			if (film_dir) {
+				film = make_shared<Film>(*film_dir);
+				film->read_metadata ();
+				content_description = film_dir->string();
+			} else {
+				film = make_film (temporary / "content", content_factory(*content_file));
+				content_description = content_file->string();
+			}
+			frame_rate = film->video_frame_rate();
+			bandwidth = film->j2k_bandwidth();
+			auto result = decode (film, frames, player_videos, images);
+			if (run("decode")) {
+				results.push_back (result);
+			}
+			if (player_videos.empty()) {
+				throw std::runtime_error ("no video could be decoded");
+			}
+		} else {
+			for (int i = 0; i < frames; ++i) {
+				images.push_back (synthetic_image(i));
+				player_videos.push_back (player_video(images.back(), dcp::Size(1998, 1080)));
+			}
+		}
+
+		auto const count = static_cast<int>(player_videos.size());
+
+		if (run("crop_scale_window")) {
+			results.push_back (measure("crop_scale_window", count, [&](int i) {
+				auto pv = player_videos[i];
+				auto const start = std::chrono::steady_clock::now();
+				images[i]->crop_scale_window (
+					Crop(), pv->inter_size(), pv->out_size(), dcp::YUVToRGB::REC709, pv->video_range(),
+					AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+					);
+				return since (start);
+			}));
+		}
+
+		/* XYZ images are needed by later stages even if we are not timing their creation */
+		vector<shared_ptr<dcp::OpenJPEGImage>> xyz (count);
+		auto convert = [&](int i) {
+			/* Use a copy so that nothing that the PlayerVideo keeps from last time is re-used */
+			auto pv = player_videos[i]->shallow_copy();
+			auto const start = std::chrono::steady_clock::now();
+			xyz[i] = DCPVideo::convert_to_xyz (pv, [](dcp::NoteType, string) {});
+			return since (start);
+		};
+
+		if (run("convert_to_xyz")) {
+			results.push_back (measure("convert_to_xyz", count, convert));
+		} else if (run("compress_j2k") || run("writer")) {
+			for (int i = 0; i < count; ++i) {
+				convert (i);
+			}
+		}
+
+		vector<shared_ptr<dcp::ArrayData>> encoded (count);
+		OpenJPEGEncodeBackend backend;
+		auto compress = [&](int i) {
+			/* The backend may change what it is given, so give it a copy */
+			auto copy = make_shared<dcp::OpenJPEGImage>(*xyz[i]);
+			auto const start = std::chrono::steady_clock::now();
+			encoded[i] = make_shared<dcp::ArrayData>(backend.encode(copy, bandwidth, frame_rate, false, false, "libdcp"));
+			return since (start);
+		};
+
+		if (run("compress_j2k")) {
+			results.push_back (measure("compress_j2k", count, compress));
+		} else if (run("writer")) {
+			for (int i = 0; i < count; ++i) {
+				compress (i);
+			}
+		}
+
+		if (run("remote")) {
+			EncodeServerDescription server (*server_host, 1, SERVER_LINK_VERSION);
+			results.push_back (measure("remote", count, [&](int i) {
+				DCPVideo frame (player_videos[i], i, frame_rate, bandwidth, Resolution::TWO_K);
+				auto const start = std::chrono::steady_clock::now();
+				frame.encode_remotely (server);
+				return since (start);
+			}));
+		}
+
+		if (run("writer")) {
+			results.push_back (writer(temporary, encoded));
+		}
+	} catch (std::exception& e) {
+		cerr << argv[0] << ": " << e.what() << "\n";
+		boost::system::error_code ec;
+		boost::filesystem::remove_all (temporary, ec);
+		exit (EXIT_FAILURE);
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::remove_all (temporary, ec);
+
+	bool regression = false;
+	if (baseline) {
+		auto const baseline_json = dcp::file_to_string (*baseline);
+		for (auto& i: results) {
+			i.baseline_fps = baseline_fps (baseline_json, i.name);
+			if (i.baseline_fps && *i.baseline_fps > 0 && (i.fps() - *i.baseline_fps) * 100 / *i.baseline_fps < -tolerance) {
+				cerr << i.name << " has regressed: " << i.fps() << "fps compared to " << *i.baseline_fps << "fps\n";
+				regression = true;
+			}
+		}
+	}
+
+	auto const json = to_json (content_description, frames, results, tolerance);
+	if (output) {
+		dcp::write_string_to_file (json, *output);
+	} else {
+		cout << json;
+	}
+
+	return regression ? 2 : EXIT_SUCCESS;
+}
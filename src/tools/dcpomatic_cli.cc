@@ -25,20 +25,28 @@
 #include "lib/dcpomatic_log.h"
 #include "lib/encode_server_finder.h"
 #include "lib/ffmpeg_encoder.h"
+#include "lib/export_sink.h"
 #include "lib/film.h"
 #include "lib/filter.h"
 #include "lib/job_manager.h"
 #include "lib/json_server.h"
 #include "lib/log.h"
 #include "lib/make_dcp.h"
+#include "lib/player.h"
+#include "lib/player_profile.h"
+#include "lib/player_video.h"
 #include "lib/ratio.h"
 #include "lib/signal_manager.h"
+#include "lib/subtitle_encoder.h"
 #include "lib/transcode_job.h"
 #include "lib/util.h"
+#include "lib/verify_dcp_job.h"
 #include "lib/version.h"
 #include "lib/video_content.h"
 #include <dcp/version.h>
 #include <getopt.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 
@@ -47,6 +55,7 @@ using std::cerr;
 using std::cout;
 using std::dynamic_pointer_cast;
 using std::list;
+using std::make_shared;
 using std::pair;
 using std::runtime_error;
 using std::setw;
@@ -66,7 +75,7 @@ help (string n)
 	     << "  -n, --no-progress                 do not print progress to stdout\n"
 	     << "  -r, --no-remote                   do not use any remote servers\n"
 	     << "  -t, --threads                     specify number of local encoding threads (overriding configuration)\n"
-	     << "  -j, --json <port>                 run a JSON server on the specified port\n"
+	     << "  -j, --json <port>                 run a JSON server on the specified port, giving metrics for monitoring at /metrics\n"
 	     << "  -k, --keep-going                  keep running even when the job is complete\n"
 	     << "  -s, --servers <file>              specify servers to use in a text file\n"
 	     << "  -l, --list-servers                just display a list of encoding servers that DCP-o-matic is configured to use; don't encode\n"
@@ -74,8 +83,15 @@ help (string n)
 	     << "  -c, --config <dir>                directory containing config.xml and cinemas.xml\n"
 	     << "      --dump                        just dump a summary of the film's settings; don't encode\n"
 	     << "      --no-check                    don't check project's content files for changes before making the DCP\n"
-	     << "      --export-format <format>      export project to a file, rather than making a DCP: specify mov or mp4\n"
+	     << "      --export-format <format>      export project to a file, rather than making a DCP: specify mov, mp4, hw-mp4, hw-hevc or subtitles\n"
 	     << "      --export-filename <filename>  filename to export to with --export-format\n"
+	     << "      --verify <level>              verify the DCP after making it: specify structure, hashes, sampled-frames or full\n"
+	     << "      --verify-sample-rate <rate>   proportion of picture frames (between 0 and 1) to check with --verify sampled-frames\n"
+	     << "      --screener <filename>         make an H.264 MP4 screener at the same time as the DCP\n"
+	     << "      --stems <directory>           write WAV files of each audio channel to a directory at the same time as making the DCP\n"
+	     << "      --trace <filename>            write a trace of the timing of the encode, which can be viewed with Perfetto or Chrome's about:tracing\n"
+	     << "      --profile-player              just run the player as quickly as possible, and say where it spends its time; don't encode\n"
+	     << "      --profile-prepare             like --profile-player, but also prepare each frame's image as an encode would\n"
 	     << "\n"
 	     << "<FILM> is the film directory.\n";
 }
@@ -130,6 +146,66 @@ print_dump (shared_ptr<Film> film)
 }
 
 
+/** Run the player for a film with nothing using what it makes, and say where it spends its time,
+ *  so that we can see whether a slow encode is because of the content or the player.
+ *  @param prepare true to prepare each frame's image as a DCP encode would.
+ */
+static void
+profile_player (shared_ptr<Film> film, bool prepare)
+{
+	Player player (film, Image::Alignment::PADDED);
+	auto profile = make_shared<PlayerProfile>();
+	player.set_profile (profile);
+
+	int64_t frames = 0;
+	player.Video.connect ([&frames, prepare](shared_ptr<PlayerVideo> pv, dcpomatic::DCPTime) {
+		if (prepare) {
+			pv->prepare (&PlayerVideo::keep_xyz_or_rgb, VideoRange::FULL, Image::Alignment::PADDED, false, false);
+		}
+		++frames;
+	});
+
+	auto const start = std::chrono::steady_clock::now();
+	while (!player.pass()) {}
+	auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	cout << frames << " frames in " << std::fixed << std::setprecision(2) << seconds << "s; "
+	     << (seconds > 0 ? frames / seconds : 0) << "fps (the film is " << film->video_frame_rate() << "fps)\n\n";
+
+	/* Time is only counted as being in the innermost thing that was happening, so these add up to the total */
+	cout << std::left << setw(48) << "In the player's thread" << std::right << setw(10) << "seconds" << setw(8) << "%" << setw(12) << "calls" << "\n";
+	for (auto const& i: profile->counts()) {
+		auto name = i.first;
+		if (name == "pass") {
+			name = "Player::pass bookkeeping";
+		} else if (name == "sink") {
+			name = prepare ? "sink (including prepare)" : "sink";
+		} else if (name == "empty") {
+			name = "filling gaps (Empty)";
+		} else if (name == "shuffler") {
+			name = "3D shuffler";
+		} else if (name == "video" || name == "audio") {
+			name = "handling " + name;
+		}
+		cout << std::left << setw(48) << name.substr(0, 47) << std::right
+		     << setw(10) << i.second.time
+		     << setw(8) << (seconds > 0 ? i.second.time * 100 / seconds : 0)
+		     << setw(12) << i.second.number << "\n";
+	}
+
+	auto const decoder_threads = profile->decoder_thread_times();
+	if (std::any_of(decoder_threads.begin(), decoder_threads.end(), [](pair<string, double> const& i) { return i.second > 0; })) {
+		cout << "\n" << std::left << setw(48) << "In decoders' own threads" << std::right << setw(10) << "seconds" << setw(8) << "%" << "\n";
+		for (auto const& i: decoder_threads) {
+			cout << std::left << setw(48) << i.first.substr(0, 47) << std::right
+			     << setw(10) << i.second
+			     << setw(8) << (seconds > 0 ? i.second * 100 / seconds : 0) << "\n";
+		}
+		cout << "\nWhen a decoder has its own thread the player's time for it is spent waiting for it and handling what it made.\n";
+	}
+}
+
+
 static void
 list_servers ()
 {
@@ -213,6 +289,13 @@ main (int argc, char* argv[])
 	bool check = true;
 	optional<string> export_format;
 	optional<boost::filesystem::path> export_filename;
+	optional<VerifyDCPJob::Level> verify;
+	float verify_sample_rate = 0.01;
+	optional<boost::filesystem::path> screener;
+	optional<boost::filesystem::path> stems;
+	optional<boost::filesystem::path> trace;
+	bool profile = false;
+	bool profile_prepare = false;
 
 	int option_index = 0;
 	while (true) {
@@ -234,10 +317,17 @@ main (int argc, char* argv[])
 			{ "no-check", no_argument, 0, 'B' },
 			{ "export-format", required_argument, 0, 'C' },
 			{ "export-filename", required_argument, 0, 'D' },
+			{ "verify", required_argument, 0, 'E' },
+			{ "verify-sample-rate", required_argument, 0, 'F' },
+			{ "screener", required_argument, 0, 'G' },
+			{ "stems", required_argument, 0, 'H' },
+			{ "trace", required_argument, 0, 'I' },
+			{ "profile-player", no_argument, 0, 'J' },
+			{ "profile-prepare", no_argument, 0, 'K' },
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long (argc, argv, "vhfnrt:j:kAs:ldc:BC:D:", long_options, &option_index);
+		int c = getopt_long (argc, argv, "vhfnrt:j:kAs:ldc:BC:D:E:F:G:H:I:JK", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -293,6 +383,35 @@ main (int argc, char* argv[])
 		case 'D':
 			export_filename = optarg;
 			break;
+		case 'E':
+			verify = VerifyDCPJob::level_from_string (optarg);
+			if (!verify) {
+				cerr << "Unrecognised verification level: must be structure, hashes, sampled-frames or full\n";
+				exit (EXIT_FAILURE);
+			}
+			break;
+		case 'F':
+			verify_sample_rate = atof (optarg);
+			if (verify_sample_rate <= 0 || verify_sample_rate > 1) {
+				cerr << "Verification sample rate must be greater than 0 and not more than 1\n";
+				exit (EXIT_FAILURE);
+			}
+			break;
+		case 'G':
+			screener = optarg;
+			break;
+		case 'H':
+			stems = optarg;
+			break;
+		case 'I':
+			trace = optarg;
+			break;
+		case 'J':
+			profile = true;
+			break;
+		case 'K':
+			profile = profile_prepare = true;
+			break;
 		}
 	}
 
@@ -336,8 +455,18 @@ main (int argc, char* argv[])
 		exit (EXIT_FAILURE);
 	}
 
-	if (export_format && *export_format != "mp4" && *export_format != "mov") {
-		cerr << "Unrecognised export format: must be mp4 or mov\n";
+	if (export_format && (screener || stems)) {
+		cerr << "Arguments --screener and --stems cannot be used with --export-format\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (export_format && verify) {
+		cerr << "Argument --verify cannot be used with --export-format\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (export_format && *export_format != "mp4" && *export_format != "hw-mp4" && *export_format != "hw-hevc" && *export_format != "mov" && *export_format != "subtitles") {
+		cerr << "Unrecognised export format: must be mp4, hw-mp4, hw-hevc, mov or subtitles\n";
 		exit (EXIT_FAILURE);
 	}
 
@@ -359,6 +488,10 @@ main (int argc, char* argv[])
 		Config::instance()->set_master_encoding_threads (threads.get ());
 	}
 
+	if (trace) {
+		Config::instance()->set_trace_file (*trace);
+	}
+
 	shared_ptr<Film> film;
 	try {
 		film.reset (new Film (film_dir));
@@ -385,6 +518,16 @@ main (int argc, char* argv[])
 		}
 	}
 
+	if (profile) {
+		try {
+			profile_player (film, profile_prepare);
+		} catch (std::exception& e) {
+			cerr << argv[0] << ": " << e.what() << "\n";
+			exit (EXIT_FAILURE);
+		}
+		exit (EXIT_SUCCESS);
+	}
+
 	if (progress) {
 		if (export_format) {
 			cout << "\nExporting " << film->name() << "\n";
@@ -395,24 +538,61 @@ main (int argc, char* argv[])
 
 	TranscodeJob::ChangedBehaviour const behaviour = check ? TranscodeJob::ChangedBehaviour::STOP : TranscodeJob::ChangedBehaviour::IGNORE;
 
-	if (export_format) {
+	if (export_format == string("subtitles")) {
+		/* This only reads the project's texts, so it is much quicker than a video export */
 		auto job = std::make_shared<TranscodeJob>(film, behaviour);
-		job->set_encoder (
-			std::make_shared<FFmpegEncoder> (
-				film, job, *export_filename, *export_format == "mp4" ? ExportFormat::H264_AAC : ExportFormat::PRORES_HQ, false, false, false, 23
-				)
-			);
+		job->set_encoder (std::make_shared<SubtitleEncoder>(film, job, *export_filename, film->isdcf_name(true), false, true));
+		JobManager::instance()->add (job);
+	} else if (export_format) {
+		auto format = ExportFormat::PRORES_HQ;
+		if (*export_format == "mp4") {
+			format = ExportFormat::H264_AAC;
+		} else if (*export_format == "hw-mp4") {
+			format = ExportFormat::H264_HARDWARE_AAC;
+		} else if (*export_format == "hw-hevc") {
+			format = ExportFormat::HEVC_HARDWARE_AAC;
+		}
+		auto job = std::make_shared<TranscodeJob>(film, behaviour);
+		job->set_encoder (std::make_shared<FFmpegEncoder>(film, job, *export_filename, format, false, false, false, 23));
 		JobManager::instance()->add (job);
 	} else {
+		vector<shared_ptr<ExportSink>> sinks;
+		if (screener) {
+			/* Screeners are often watched online, so don't make them bigger than HD */
+			auto size = film->frame_size();
+			if (size.width > 1920) {
+				size = dcp::Size(1920, (size.height * 1920 / size.width) & ~1);
+			}
+			sinks.push_back (
+				std::make_shared<VideoFileExportSink>(film, *screener, ExportFormat::H264_AAC, size, FFmpegEncoder::stereo_map(film->audio_channels()), 23)
+				);
+		}
+		if (stems) {
+			AudioMapping map(film->audio_channels(), film->audio_channels());
+			for (int i = 0; i < film->audio_channels(); ++i) {
+				map.set (i, i, 1);
+			}
+			sinks.push_back (std::make_shared<AudioStemsExportSink>(film, *stems, map, AudioStemsExportSink::channel_names(film)));
+		}
+
 		try {
-			make_dcp (film, behaviour);
+			make_dcp (film, behaviour, sinks);
 		} catch (runtime_error& e) {
 			std::cerr << "Could not make DCP: " << e.what() << "\n";
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	bool const error = show_jobs_on_console (progress);
+	bool error = show_jobs_on_console (progress);
+
+	if (verify && !error) {
+		auto job = std::make_shared<VerifyDCPJob>(vector<boost::filesystem::path>{film->dir(film->dcp_name(false))}, *verify, verify_sample_rate);
+		JobManager::instance()->add (job);
+		error = show_jobs_on_console (progress);
+		for (auto note: job->notes()) {
+			cerr << dcp::note_to_string(note) << "\n";
+		}
+	}
 
 	if (keep_going) {
 		while (true) {
@@ -33,12 +33,14 @@
 #include "lib/cross.h"
 #include "lib/dcpomatic_log.h"
 #include "lib/disk_writer_messages.h"
+#include "lib/drive_watcher.h"
 #include "lib/file_log.h"
 #include "lib/job_manager.h"
 #include "lib/signal_manager.h"
 #include "lib/util.h"
 #include "lib/version.h"
 #include <dcp/warnings.h>
+#include <wx/checklst.h>
 #include <wx/cmdline.h>
 #include <wx/wx.h>
 LIBDCP_DISABLE_WARNINGS
@@ -50,12 +52,14 @@ LIBDCP_ENABLE_WARNINGS
 #ifdef DCPOMATIC_OSX
 #include <notify.h>
 #endif
+#include <set>
 
 
 using std::cerr;
 using std::cout;
 using std::exception;
 using std::make_shared;
+using std::set;
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -145,13 +149,21 @@ public:
 
 		add_label_to_sizer (grid, overall_panel, _("Drive"), true, wxGBPosition(r, 0));
 		auto drive_sizer = new wxBoxSizer (wxHORIZONTAL);
-		_drive = new wxChoice (overall_panel, wxID_ANY);
+		_drive = new wxCheckListBox (overall_panel, wxID_ANY);
 		drive_sizer->Add (_drive, 1, wxALIGN_CENTER_VERTICAL | wxRIGHT, DCPOMATIC_SIZER_X_GAP);
 		_drive_refresh = new wxButton (overall_panel, wxID_ANY, _("Refresh"));
 		drive_sizer->Add (_drive_refresh, 0);
 		grid->Add (drive_sizer, wxGBPosition(r, 1), wxDefaultSpan, wxEXPAND);
 		++r;
 
+		add_label_to_sizer (grid, overall_panel, _("Verify"), true, wxGBPosition(r, 0));
+		_verification = new wxChoice (overall_panel, wxID_ANY);
+		_verification->Append (_("Everything (slowest)"));
+		_verification->Append (_("Everything, using a faster check"));
+		_verification->Append (_("A sample of each file (fastest)"));
+		grid->Add (_verification, wxGBPosition(r, 1));
+		++r;
+
 		_jobs = new JobManagerView (overall_panel, false);
 		grid->Add (_jobs, wxGBPosition(r, 0), wxGBSpan(6, 2), wxEXPAND);
 		r += 6;
@@ -163,8 +175,21 @@ public:
 		grid->AddGrowableCol (1);
 
 		_copy->Bind (wxEVT_BUTTON, boost::bind(&DOMFrame::copy, this));
-		_drive->Bind (wxEVT_CHOICE, boost::bind(&DOMFrame::setup_sensitivity, this));
+		_drive->Bind (wxEVT_CHECKLISTBOX, boost::bind(&DOMFrame::setup_sensitivity, this));
 		_drive_refresh->Bind (wxEVT_BUTTON, boost::bind(&DOMFrame::drive_refresh, this));
+		_verification->Bind (wxEVT_CHOICE, boost::bind(&DOMFrame::verification_changed, this));
+
+		switch (Config::instance()->disk_verification()) {
+		case DiskVerification::FULL:
+			_verification->SetSelection (0);
+			break;
+		case DiskVerification::FAST:
+			_verification->SetSelection (1);
+			break;
+		case DiskVerification::SAMPLED:
+			_verification->SetSelection (2);
+			break;
+		}
 
 		_sizer->Add (grid, 1, wxALL | wxEXPAND, DCPOMATIC_DIALOG_BORDER);
 		overall_panel->SetSizer (_sizer);
@@ -178,7 +203,8 @@ public:
 		dcpomatic_log->set_types (dcpomatic_log->types() | LogEntry::TYPE_DISK);
 		LOG_DISK("dcpomatic_disk %1 started", dcpomatic_git_commit);
 
-		drive_refresh ();
+		_drive_watcher.reset (new DriveWatcher());
+		_drive_watcher->Changed.connect(boost::bind(&DOMFrame::set_drives, this, _1));
 
 		Bind (wxEVT_SIZE, boost::bind(&DOMFrame::sized, this, _1));
 		Bind (wxEVT_CLOSE_WINDOW, boost::bind(&DOMFrame::close, this, _1));
@@ -273,14 +299,15 @@ private:
 
 	void copy ()
 	{
-		/* Check that the selected drive still exists and update its properties if so */
-		drive_refresh ();
-		if (_drive->GetSelection() == wxNOT_FOUND) {
-			error_dialog (this, _("The disk you selected is no longer available.  Please choose another."));
+		/* Check that the selected drives still exist and update their properties if so */
+		auto const checked_before = checked_drives().size();
+		set_drives (Drive::get());
+		auto const drives = checked_drives();
+		if (drives.empty() || drives.size() != checked_before) {
+			error_dialog (this, _("A disk that you selected is no longer available.  Please check your choice of disks."));
 			return;
 		}
 
-		DCPOMATIC_ASSERT (_drive->GetSelection() != wxNOT_FOUND);
 		DCPOMATIC_ASSERT (!_dcp_paths.empty());
 
 		auto ping = [this](int attempt) {
@@ -333,40 +360,48 @@ private:
 #endif
 		}
 
-		auto const& drive = _drives[_drive->GetSelection()];
-		if (drive.mounted()) {
-			auto d = new TryUnmountDialog(this, drive.description());
-			int const r = d->ShowModal ();
-			d->Destroy ();
-			if (r != wxID_OK) {
-				return;
-			}
+		for (auto const& drive: drives) {
+			if (drive.mounted()) {
+				auto d = new TryUnmountDialog(this, drive.description());
+				int const r = d->ShowModal ();
+				d->Destroy ();
+				if (r != wxID_OK) {
+					return;
+				}
 
-			LOG_DISK("Sending unmount request to disk writer for %1", drive.as_xml());
-			if (!_nanomsg.send(DISK_WRITER_UNMOUNT "\n", 2000)) {
-				LOG_DISK_NC("Failed to send unmount request.");
-				throw CommunicationFailedError ();
-			}
-			if (!_nanomsg.send(drive.as_xml(), 2000)) {
-				LOG_DISK_NC("Failed to send drive for unmount request.");
-				throw CommunicationFailedError ();
-			}
-			/* The reply may have to wait for the user to authenticate, so let's wait a while */
-			auto reply = _nanomsg.receive (30000);
-			if (!reply || *reply != DISK_WRITER_OK) {
-				auto * m = new MessageDialog (
-						this,
-						_("DCP-o-matic Disk Writer"),
-						wxString::Format(_("The drive %s could not be unmounted.\nClose any application that is using it, then try again."), std_to_wx(drive.description()))
-						);
-				m->ShowModal ();
-				m->Destroy ();
-				return;
+				LOG_DISK("Sending unmount request to disk writer for %1", drive.as_xml());
+				if (!_nanomsg.send(DISK_WRITER_UNMOUNT "\n", 2000)) {
+					LOG_DISK_NC("Failed to send unmount request.");
+					throw CommunicationFailedError ();
+				}
+				if (!_nanomsg.send(drive.as_xml(), 2000)) {
+					LOG_DISK_NC("Failed to send drive for unmount request.");
+					throw CommunicationFailedError ();
+				}
+				/* The reply may have to wait for the user to authenticate, so let's wait a while */
+				auto reply = _nanomsg.receive (30000);
+				if (!reply || *reply != DISK_WRITER_OK) {
+					auto * m = new MessageDialog (
+							this,
+							_("DCP-o-matic Disk Writer"),
+							wxString::Format(_("The drive %s could not be unmounted.\nClose any application that is using it, then try again."), std_to_wx(drive.description()))
+							);
+					m->ShowModal ();
+					m->Destroy ();
+					return;
+				}
 			}
 		}
 
+		wxString names;
+		for (auto const& drive: drives) {
+			if (!names.IsEmpty()) {
+				names += "\n";
+			}
+			names += std_to_wx(drive.description());
+		}
 
-		auto * d = new DriveWipeWarningDialog (this, _drive->GetString(_drive->GetSelection()));
+		auto * d = new DriveWipeWarningDialog (this, names);
 		int const r = d->ShowModal ();
 		bool ok = r == wxID_OK && d->confirmed();
 		d->Destroy ();
@@ -375,40 +410,71 @@ private:
 			return;
 		}
 
-		JobManager::instance()->add(make_shared<CopyToDriveJob>(_dcp_paths, _drives[_drive->GetSelection()], _nanomsg));
+		JobManager::instance()->add(make_shared<CopyToDriveJob>(_dcp_paths, drives, _nanomsg));
 		setup_sensitivity ();
 	}
 
+	/** @return The drives whose boxes are ticked */
+	void verification_changed ()
+	{
+		switch (_verification->GetSelection()) {
+		case 0:
+			Config::instance()->set_disk_verification(DiskVerification::FULL);
+			break;
+		case 1:
+			Config::instance()->set_disk_verification(DiskVerification::FAST);
+			break;
+		case 2:
+			Config::instance()->set_disk_verification(DiskVerification::SAMPLED);
+			break;
+		}
+		Config::instance()->write_config();
+	}
+
+	vector<Drive> checked_drives () const
+	{
+		vector<Drive> drives;
+		for (size_t i = 0; i < _drives.size(); ++i) {
+			if (_drive->IsChecked(i)) {
+				drives.push_back (_drives[i]);
+			}
+		}
+		return drives;
+	}
+
 	void drive_refresh ()
 	{
-		int const sel = _drive->GetSelection ();
-		wxString current;
-		if (sel != wxNOT_FOUND) {
-			current = _drive->GetString (sel);
+		_drive_watcher->refresh ();
+	}
+
+	void set_drives (vector<Drive> drives)
+	{
+		set<wxString> checked;
+		for (unsigned int i = 0; i < _drive->GetCount(); ++i) {
+			if (_drive->IsChecked(i)) {
+				checked.insert (_drive->GetString(i));
+			}
 		}
 		_drive->Clear ();
-		int re_select = wxNOT_FOUND;
-		int j = 0;
-		_drives = Drive::get ();
+		_drives = drives;
 		for (auto i: _drives) {
 			auto const s = std_to_wx(i.description());
-			if (s == current) {
-				re_select = j;
+			auto const index = _drive->Append(s);
+			if (checked.find(s) != checked.end()) {
+				_drive->Check (index);
 			}
-			_drive->Append(s);
-			++j;
 		}
-		_drive->SetSelection (re_select);
 		setup_sensitivity ();
 	}
 
 	void setup_sensitivity ()
 	{
-		_copy->Enable (!_dcp_paths.empty() && _drive->GetSelection() != wxNOT_FOUND && !JobManager::instance()->work_to_do());
+		_copy->Enable (!_dcp_paths.empty() && !checked_drives().empty() && !JobManager::instance()->work_to_do());
 	}
 
-	wxChoice* _drive;
+	wxCheckListBox* _drive;
 	wxButton* _drive_refresh;
+	wxChoice* _verification;
 	wxButton* _copy;
 	JobManagerView* _jobs;
 	std::vector<boost::filesystem::path> _dcp_paths;
@@ -418,6 +484,7 @@ private:
 #endif
 	Nanomsg _nanomsg;
 	wxSizer* _sizer;
+	std::unique_ptr<DriveWatcher> _drive_watcher;
 };
 
 
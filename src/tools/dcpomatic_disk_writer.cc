@@ -202,6 +202,13 @@ try
 		}
 		auto device = *device_opt;
 
+		auto verification_opt = nanomsg->receive (LONG_TIMEOUT);
+		if (!verification_opt) {
+			LOG_DISK_NC("Failed to receive write request");
+			throw CommunicationFailedError();
+		}
+		auto const verification = string_to_disk_verification (*verification_opt);
+
 		vector<boost::filesystem::path> dcp_paths;
 		while (true) {
 			auto dcp_path_opt = nanomsg->receive (LONG_TIMEOUT);
@@ -260,14 +267,14 @@ try
 			return true;
 		}
 
-		LOG_DISK("Here we go writing these to %1", device);
+		LOG_DISK("Here we go writing these to %1 with %2 verification", device, disk_verification_to_string(verification));
 		for (auto dcp: dcp_paths) {
 			LOG_DISK("  %1", dcp);
 		}
 
 		request_privileges (
 			"com.dcpomatic.write-drive",
-			[dcp_paths, device]() {
+			[dcp_paths, device, verification]() {
 #if defined(DCPOMATIC_LINUX)
 				auto posix_partition = device;
 				/* XXX: don't know if this logic is sensible */
@@ -276,12 +283,12 @@ try
 				} else {
 					posix_partition += "1";
 				}
-				dcpomatic::write (dcp_paths, device, posix_partition, nanomsg);
+				dcpomatic::write (dcp_paths, device, posix_partition, verification, nanomsg);
 #elif defined(DCPOMATIC_OSX)
 				auto fast_device = boost::algorithm::replace_first_copy (device, "/dev/disk", "/dev/rdisk");
-				dcpomatic::write (dcp_paths, fast_device, fast_device + "s1", nanomsg);
+				dcpomatic::write (dcp_paths, fast_device, fast_device + "s1", verification, nanomsg);
 #elif defined(DCPOMATIC_WINDOWS)
-				dcpomatic::write (dcp_paths, device, "", nanomsg);
+				dcpomatic::write (dcp_paths, device, "", verification, nanomsg);
 #endif
 			},
 			[]() {
@@ -45,6 +45,7 @@
 #include "lib/file_log.h"
 #include "lib/job_manager.h"
 #include "lib/kdm_with_metadata.h"
+#include "lib/metadata_writer.h"
 #include "lib/screen.h"
 #include "lib/send_kdm_email_job.h"
 #include "lib/util.h"
@@ -205,7 +206,7 @@ public:
 		overall_panel->SetSizer (main_sizer);
 
 		/* Instantly save any config changes when using a DCP-o-matic GUI */
-		Config::instance()->Changed.connect (boost::bind (&Config::write, Config::instance ()));
+		Config::instance()->Changed.connect(boost::bind(&Config::write_soon, Config::instance(), _1));
 
 		_screens->ScreensChanged.connect (boost::bind (&DOMFrame::setup_sensitivity, this));
 		_create->Bind (wxEVT_BUTTON, bind (&DOMFrame::create_kdms, this));
@@ -818,6 +819,18 @@ private:
 		return true;
 	}
 
+	int OnExit () override
+	{
+		/* Make sure that any configuration changes which are waiting to be written get to the disk;
+		 * MetadataWriter will already have logged any problem.
+		 */
+		try {
+			MetadataWriter::instance()->flush();
+		} catch (...) {}
+
+		return wxApp::OnExit();
+	}
+
 	/* An unhandled exception has occurred inside the main event loop */
 	bool OnExceptionInMainLoop () override
 	{
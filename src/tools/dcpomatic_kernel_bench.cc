@@ -0,0 +1,522 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/tools/dcpomatic_kernel_bench.cc
+ *  @brief Micro-benchmarks of the Image and AudioBuffers kernels that are worth optimising,
+ *  for each pixel format or channel count that they handle.
+ *
+ *  SIMD code in DCP-o-matic is chosen at run time (see cpu_dispatch.h), so to compare
+ *  implementations run once with --isa scalar, save the results, and give them to runs with
+ *  other --isa values with --reference.  As well as timings the results contain a digest (for
+ *  images) or a checksum (for audio) of each kernel's output, so that --reference also checks
+ *  that the other implementations get the same answers as the scalar version.
+ */
+
+
+#include "lib/audio_buffers.h"
+#include "lib/audio_filter.h"
+#include "lib/cpu_dispatch.h"
+#include "lib/cross.h"
+#include "lib/digester.h"
+#include "lib/image.h"
+#include "lib/resampler.h"
+#include "lib/util.h"
+#include "lib/version.h"
+#include <dcp/raw_convert.h>
+#include <dcp/util.h>
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+
+using std::cerr;
+using std::cout;
+using std::function;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+using dcp::raw_convert;
+
+
+/** Version of the JSON that we write */
+static int const results_version = 1;
+static dcp::Size const image_size (1998, 1080);
+static int const audio_frames = 48000;
+/** Relative difference between audio checksums that we still count as the same */
+static double const checksum_tolerance = 1e-4;
+
+
+class Kernel
+{
+public:
+	string name;
+	/** pixel format or channel count */
+	string variant;
+	/** number of pixels or audio frames that each run works on */
+	int64_t items;
+	/** Run the kernel once */
+	function<void ()> run;
+	/** Run the kernel once on fresh input.
+	 *  @return digest or checksum of the output, to compare between builds.
+	 */
+	function<string ()> check;
+};
+
+
+class Result
+{
+public:
+	Kernel const* kernel;
+	double ns_per_item;
+	string check;
+	/** true if the check matched the reference, false if it did not, or none if there is no reference */
+	optional<bool> matches;
+};
+
+
+static uint32_t
+next_random (uint32_t& seed)
+{
+	seed = seed * 1664525 + 1013904223;
+	return seed;
+}
+
+
+/** @return An image filled with bytes which are the same every time */
+static shared_ptr<Image>
+random_image (AVPixelFormat format, dcp::Size size)
+{
+	auto image = make_shared<Image>(format, size, Image::Alignment::PADDED);
+	uint32_t seed = 42;
+	for (int c = 0; c < image->planes(); ++c) {
+		for (int y = 0; y < image->sample_size(c).height; ++y) {
+			auto p = image->data()[c] + y * image->stride()[c];
+			for (int x = 0; x < image->line_size()[c]; ++x) {
+				*p++ = next_random(seed) >> 24;
+			}
+		}
+	}
+	return image;
+}
+
+
+/** @return Audio which is the same every time */
+static shared_ptr<AudioBuffers>
+random_audio (int channels, int frames)
+{
+	auto audio = make_shared<AudioBuffers>(channels, frames);
+	uint32_t seed = 42;
+	for (int c = 0; c < channels; ++c) {
+		for (int f = 0; f < frames; ++f) {
+			audio->data(c)[f] = (static_cast<float>(next_random(seed) >> 8) / (1 << 23)) - 1;
+		}
+	}
+	return audio;
+}
+
+
+static string
+digest (shared_ptr<const Image> image)
+{
+	Digester digester;
+	image->add_digest (digester);
+	return digester.get();
+}
+
+
+/** @return A sum of the samples in @p audio weighted so that moving samples about changes it */
+static string
+checksum (shared_ptr<const AudioBuffers> audio)
+{
+	double sum = 0;
+	for (int c = 0; c < audio->channels(); ++c) {
+		for (int f = 0; f < audio->frames(); ++f) {
+			sum += audio->data(c)[f] * ((c * 7 + f) % 13 + 1);
+		}
+	}
+	return raw_convert<string>(sum, 12);
+}
+
+
+static vector<Kernel>
+image_kernels ()
+{
+	vector<Kernel> kernels;
+
+	auto const pixels = static_cast<int64_t>(image_size.width) * image_size.height;
+	auto const overlay = random_image(AV_PIX_FMT_BGRA, image_size);
+
+	for (auto format: { AV_PIX_FMT_RGB24, AV_PIX_FMT_BGRA, AV_PIX_FMT_RGBA, AV_PIX_FMT_RGB48LE, AV_PIX_FMT_XYZ12LE, AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10LE }) {
+		auto image = random_image(format, image_size);
+		kernels.push_back ({
+			"alpha_blend", av_get_pix_fmt_name(format), pixels,
+			[image, overlay]() { image->alpha_blend(overlay, Position<int>(0, 0)); },
+			[format, overlay]() {
+				auto image = random_image(format, image_size);
+				image->alpha_blend (overlay, Position<int>(0, 0));
+				return digest (image);
+			}
+		});
+	}
+
+	for (auto format: { AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGB24, AV_PIX_FMT_XYZ12LE, AV_PIX_FMT_RGB48LE, AV_PIX_FMT_YUV422P10LE }) {
+		auto image = random_image(format, image_size);
+		kernels.push_back ({
+			"fade", av_get_pix_fmt_name(format), pixels,
+			/* Fading by 1 does not change anything, but it does all the work */
+			[image]() { image->fade(1); },
+			[format]() {
+				auto image = random_image(format, image_size);
+				image->fade (0.3);
+				return digest (image);
+			}
+		});
+	}
+
+	for (auto format: { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_YUV444P10LE, AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA, AV_PIX_FMT_BGRA, AV_PIX_FMT_RGB48LE, AV_PIX_FMT_XYZ12LE, AV_PIX_FMT_UYVY422 }) {
+		auto image = random_image(format, image_size);
+		kernels.push_back ({
+			"make_black", av_get_pix_fmt_name(format), pixels,
+			[image]() { image->make_black(); },
+			[format]() {
+				auto image = random_image(format, image_size);
+				image->make_black ();
+				return digest (image);
+			}
+		});
+	}
+
+	auto const in_size = dcp::Size(1920, 1080);
+	for (auto format: { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_YUV444P10LE, AV_PIX_FMT_RGB24, AV_PIX_FMT_RGB48LE }) {
+		auto image = random_image(format, in_size);
+		auto scale = [image]() {
+			return image->crop_scale_window (
+				Crop(), image_size, image_size, dcp::YUVToRGB::REC709, VideoRange::FULL,
+				AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+				);
+		};
+		kernels.push_back ({
+			"crop_scale_window", av_get_pix_fmt_name(format), pixels,
+			[scale]() { scale(); },
+			[scale]() { return digest(scale()); }
+		});
+	}
+
+	return kernels;
+}
+
+
+static vector<Kernel>
+audio_kernels ()
+{
+	vector<Kernel> kernels;
+
+	for (auto channels: { 2, 6, 16 }) {
+		auto const variant = raw_convert<string>(channels) + "ch";
+		auto const from = random_audio(channels, audio_frames);
+
+		auto to = random_audio(channels, audio_frames);
+		auto accumulate_channels = [channels, from](shared_ptr<AudioBuffers> out) {
+			for (int c = 0; c < channels; ++c) {
+				out->accumulate_channel (from.get(), c, channels - c - 1, 0.5);
+			}
+		};
+		kernels.push_back ({
+			"accumulate_channel", variant, audio_frames,
+			[to, accumulate_channels]() { accumulate_channels(to); },
+			[channels, accumulate_channels]() {
+				auto to = make_shared<AudioBuffers>(channels, audio_frames);
+				to->make_silent ();
+				accumulate_channels (to);
+				return checksum (to);
+			}
+		});
+
+		kernels.push_back ({
+			"accumulate_frames", variant, audio_frames,
+			[to, from]() { to->accumulate_frames(from.get(), audio_frames, 0, 0); },
+			[channels, from]() {
+				auto to = make_shared<AudioBuffers>(channels, audio_frames);
+				to->make_silent ();
+				to->accumulate_frames (from.get(), audio_frames, 0, 0);
+				return checksum (to);
+			}
+		});
+
+		auto filter = make_shared<LowPassAudioFilter>(0.02, 0.1);
+		kernels.push_back ({
+			"AudioFilter::run", variant, audio_frames,
+			[filter, from]() { filter->run(from); },
+			[from]() {
+				LowPassAudioFilter filter (0.02, 0.1);
+				return checksum (filter.run(from));
+			}
+		});
+
+		auto resampler = make_shared<Resampler>(44100, 48000, channels);
+		kernels.push_back ({
+			"Resampler::run", variant, audio_frames,
+			[resampler, from]() { resampler->run(from); },
+			[channels, from]() {
+				Resampler resampler (44100, 48000, channels);
+				return checksum (resampler.run(from));
+			}
+		});
+	}
+
+	return kernels;
+}
+
+
+/** @return Time taken by a run of @p kernel in nanoseconds per item; the median of several batches
+ *  of runs, each taking at least @p batch_seconds.
+ */
+static double
+time_kernel (Kernel const& kernel, double batch_seconds)
+{
+	auto since = [](std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	/* Warm up, and see how many runs we need for a batch */
+	auto start = std::chrono::steady_clock::now();
+	kernel.run ();
+	auto const once = std::max(1e-9, since(start));
+	int const runs = std::max(1, static_cast<int>(std::ceil(batch_seconds / once)));
+
+	vector<double> batches;
+	for (int i = 0; i < 5; ++i) {
+		start = std::chrono::steady_clock::now();
+		for (int j = 0; j < runs; ++j) {
+			kernel.run ();
+		}
+		batches.push_back (since(start) * 1e9 / (static_cast<double>(runs) * kernel.items));
+	}
+
+	std::sort (batches.begin(), batches.end());
+	return batches[batches.size() / 2];
+}
+
+
+/** @return The check of @p kernel in some results that we wrote earlier, if it is there */
+static optional<string>
+reference_check (string const& json, Kernel const& kernel)
+{
+	auto const s = json.find("\"kernel\": \"" + kernel.name + "\", \"variant\": \"" + kernel.variant + "\"");
+	if (s == string::npos) {
+		return {};
+	}
+
+	string const key = "\"check\": \"";
+	auto const c = json.find(key, s);
+	if (c == string::npos || json.find("}", s) < c) {
+		return {};
+	}
+
+	auto const start = c + key.length();
+	return json.substr(start, json.find("\"", start) - start);
+}
+
+
+static bool
+checks_match (Kernel const& kernel, string const& a, string const& b)
+{
+	if (kernel.name == "alpha_blend" || kernel.name == "fade" || kernel.name == "make_black" || kernel.name == "crop_scale_window") {
+		return a == b;
+	}
+
+	/* Floating-point sums may come out slightly differently */
+	auto const x = raw_convert<double>(a);
+	auto const y = raw_convert<double>(b);
+	return std::abs(x - y) <= checksum_tolerance * std::max({1.0, std::abs(x), std::abs(y)});
+}
+
+
+static string
+to_json (vector<Result> const& results)
+{
+	string json = "{\n";
+	json += "  \"version\": " + raw_convert<string>(results_version) + ",\n";
+	json += "  \"dcpomatic\": \"" + string(dcpomatic_version) + " " + string(dcpomatic_git_commit) + "\",\n";
+	json += "  \"target\": \"" + simd_target() + "\",\n";
+	auto const forced = dcpomatic::cpu::forced ();
+	json += "  \"isa\": \"" + (forced ? dcpomatic::cpu::isa_name(*forced) : string("best")) + "\",\n";
+	json += "  \"cpu\": \"" + cpu_info() + "\",\n";
+	json += "  \"cpu_features\": \"" + simd_features() + "\",\n";
+	json += "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		auto const& r = results[i];
+		/* Each result goes on one line, ending with its check, so that reference_check() can find it without a JSON parser */
+		json += "    { \"kernel\": \"" + r.kernel->name + "\", \"variant\": \"" + r.kernel->variant + "\", ";
+		json += "\"ns_per_item\": " + raw_convert<string>(r.ns_per_item, 3, true) + ", ";
+		if (r.matches) {
+			json += string("\"matches_reference\": ") + (*r.matches ? "true" : "false") + ", ";
+		}
+		json += "\"check\": \"" + r.check + "\" }";
+		json += i == (results.size() - 1) ? "\n" : ",\n";
+	}
+	json += "  ]\n";
+	json += "}\n";
+	return json;
+}
+
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " [OPTION]\n"
+	     << "  -h, --help                show this help\n"
+	     << "  -k, --kernel <name>       run only this kernel; may be given more than once\n"
+	     << "  -b, --batch <seconds>     shortest time for each batch of runs of a kernel (default 0.1)\n"
+	     << "  -o, --output <file>       write results to a file rather than stdout\n"
+	     << "  -r, --reference <file>    check each kernel's output against results written earlier (e.g. with --isa scalar)\n"
+	     << "  -i, --isa <name>          use nothing better than this instruction set (scalar, sse2, sse4.2, avx2, avx512f or neon)\n"
+	     << "\n"
+	     << "Kernels are alpha_blend, fade, make_black, crop_scale_window, accumulate_channel, accumulate_frames,\n"
+	     << "AudioFilter::run and Resampler::run.  Exit status is 2 if any output differs from the reference.\n";
+}
+
+
+int
+main (int argc, char* argv[])
+{
+	vector<string> only;
+	double batch_seconds = 0.1;
+	optional<boost::filesystem::path> output;
+	optional<boost::filesystem::path> reference;
+	optional<dcpomatic::cpu::ISA> isa;
+
+	int option_index = 0;
+	while (true) {
+		static struct option long_options[] = {
+			{ "help", no_argument, 0, 'h' },
+			{ "kernel", required_argument, 0, 'k' },
+			{ "batch", required_argument, 0, 'b' },
+			{ "output", required_argument, 0, 'o' },
+			{ "reference", required_argument, 0, 'r' },
+			{ "isa", required_argument, 0, 'i' },
+			{ 0, 0, 0, 0 }
+		};
+
+		int c = getopt_long (argc, argv, "hk:b:o:r:i:", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'h':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		case 'k':
+			only.push_back (optarg);
+			break;
+		case 'b':
+			batch_seconds = atof (optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'r':
+			reference = optarg;
+			break;
+		case 'i':
+			isa = dcpomatic::cpu::isa_from_name (optarg);
+			if (!isa) {
+				cerr << "Unknown instruction set " << optarg << "\n";
+				exit (EXIT_FAILURE);
+			}
+			break;
+		}
+	}
+
+	dcpomatic_setup_path_encoding ();
+	dcpomatic_setup ();
+
+	if (isa) {
+		dcpomatic::cpu::force (isa);
+	}
+
+	auto kernels = image_kernels ();
+	for (auto const& i: audio_kernels()) {
+		kernels.push_back (i);
+	}
+
+	if (!only.empty()) {
+		kernels.erase (
+			std::remove_if(kernels.begin(), kernels.end(), [&only](Kernel const& k) {
+				return std::find(only.begin(), only.end(), k.name) == only.end();
+			}),
+			kernels.end()
+			);
+		if (kernels.empty()) {
+			cerr << "No kernels to run\n";
+			exit (EXIT_FAILURE);
+		}
+	}
+
+	optional<string> reference_json;
+	if (reference) {
+		reference_json = dcp::file_to_string (*reference, 16 * 1024 * 1024);
+	}
+
+	vector<Result> results;
+	bool mismatch = false;
+
+	for (auto const& i: kernels) {
+		cerr << i.name << " " << i.variant << "...\n";
+		Result result;
+		result.kernel = &i;
+		try {
+			result.ns_per_item = time_kernel (i, batch_seconds);
+			result.check = i.check ();
+		} catch (std::exception& e) {
+			cerr << argv[0] << ": " << i.name << " " << i.variant << " failed (" << e.what() << ")\n";
+			exit (EXIT_FAILURE);
+		}
+		if (reference_json) {
+			if (auto ref = reference_check(*reference_json, i)) {
+				result.matches = checks_match (i, result.check, *ref);
+				if (!*result.matches) {
+					cerr << i.name << " " << i.variant << " gives a different result to the reference\n";
+					mismatch = true;
+				}
+			}
+		}
+		results.push_back (result);
+	}
+
+	auto const json = to_json (results);
+	if (output) {
+		dcp::write_string_to_file (json, *output);
+	} else {
+		cout << json;
+	}
+
+	return mismatch ? 2 : EXIT_SUCCESS;
+}
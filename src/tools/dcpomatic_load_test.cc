@@ -0,0 +1,682 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/tools/dcpomatic_load_test.cc
+ *  @brief Put an encode farm under load as a master would, to see how it copes and how fast it is.
+ *
+ *  Requests are first recorded from films (so that 2K, 4K and 3D ones can be mixed in any proportion)
+ *  and then replayed over many connections to one or more servers, which may come and go, over
+ *  a connection which can be made slower or less reliable than it really is.  The frames per second
+ *  that the farm sustains, the time each frame takes and how long it takes to recover from failures
+ *  are written as JSON.
+ */
+
+
+#include "lib/dcp_video.h"
+#include "lib/encode_server_connection.h"
+#include "lib/encode_server_description.h"
+#include "lib/exceptions.h"
+#include "lib/film.h"
+#include "lib/player.h"
+#include "lib/player_video.h"
+#include "lib/util.h"
+#include "lib/version.h"
+#include <dcp/raw_convert.h>
+#include <dcp/util.h>
+#include <boost/filesystem.hpp>
+#include <getopt.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+
+using std::cerr;
+using std::cout;
+using std::list;
+using std::make_shared;
+using std::map;
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+using dcp::raw_convert;
+
+
+/** Version of the JSON that we write */
+static int const results_version = 1;
+/** Longest time to wait before reconnecting to a server after a failure, in seconds */
+static double const maximum_backoff = 8;
+
+typedef std::chrono::steady_clock Clock;
+
+
+/** A request recorded from a film, ready to send to a server */
+struct Request
+{
+	int index;
+	Eyes eyes;
+	std::vector<uint8_t> data;
+};
+
+
+/** Some requests, and how often to send one of them compared to the other sets */
+struct Traffic
+{
+	boost::filesystem::path directory;
+	double weight = 1;
+	vector<Request> requests;
+};
+
+
+/** Ways to make the link to the servers worse than it is */
+struct Impairment
+{
+	/** time to wait before sending each request, in seconds */
+	double delay = 0;
+	/** largest extra random time to wait before sending each request, in seconds */
+	double jitter = 0;
+	/** largest rate at which each connection may send, in bits per second, or 0 for no limit */
+	double bandwidth = 0;
+	/** chance of the connection being dropped after each request is sent */
+	double drop = 0;
+	/** time after which to drop each connection and make a new one, in seconds, or 0 to never do it */
+	double churn = 0;
+};
+
+
+/** What happened on the connections to one server */
+struct Statistics
+{
+	void add (Statistics const& other) {
+		latencies.insert (latencies.end(), other.latencies.begin(), other.latencies.end());
+		recoveries.insert (recoveries.end(), other.recoveries.begin(), other.recoveries.end());
+		encoded += other.encoded;
+		busy += other.busy;
+		failed += other.failed;
+		lost += other.lost;
+		connections += other.connections;
+		for (auto const& i: other.errors) {
+			errors[i.first] += i.second;
+		}
+		bytes_sent += other.bytes_sent;
+		bytes_received += other.bytes_received;
+	}
+
+	/** @param p Percentile (between 0 and 100) */
+	static double percentile (vector<double> values, double p) {
+		if (values.empty()) {
+			return 0;
+		}
+		std::sort (values.begin(), values.end());
+		auto const index = static_cast<size_t>(std::ceil(p * values.size() / 100));
+		return values[std::min(std::max(index, static_cast<size_t>(1)) - 1, values.size() - 1)];
+	}
+
+	/** time from sending each frame to getting it back encoded, in seconds */
+	vector<double> latencies;
+	/** time from each failure to the next frame being encoded, in seconds */
+	vector<double> recoveries;
+	/** number of frames that came back encoded */
+	int64_t encoded = 0;
+	/** number of frames that the server was too busy to take */
+	int64_t busy = 0;
+	/** number of frames that the server could not encode */
+	int64_t failed = 0;
+	/** number of frames that were in flight when their connection failed */
+	int64_t lost = 0;
+	/** number of connections made */
+	int64_t connections = 0;
+	/** number of each kind of error */
+	map<string, int64_t> errors;
+	int64_t bytes_sent = 0;
+	int64_t bytes_received = 0;
+};
+
+
+static vector<Request>
+read_requests (boost::filesystem::path directory)
+{
+	vector<Request> requests;
+
+	for (auto const& i: boost::filesystem::directory_iterator(directory)) {
+		if (i.path().extension() != ".request") {
+			continue;
+		}
+		/* Names are <index>_<eyes>.request */
+		auto const stem = i.path().stem().string();
+		auto const underscore = stem.find("_");
+		if (underscore == string::npos) {
+			continue;
+		}
+		Request request;
+		request.index = raw_convert<int>(stem.substr(0, underscore));
+		request.eyes = static_cast<Eyes>(raw_convert<int>(stem.substr(underscore + 1)));
+		auto const data = dcp::file_to_string(i.path(), 256 * 1024 * 1024);
+		request.data.assign (data.begin(), data.end());
+		requests.push_back (request);
+	}
+
+	std::sort (requests.begin(), requests.end(), [](Request const& a, Request const& b) {
+		return a.index < b.index || (a.index == b.index && a.eyes < b.eyes);
+	});
+
+	return requests;
+}
+
+
+/** Write the requests that would be sent to servers to encode the first @p frames frames of a film */
+static int
+record (boost::filesystem::path film_directory, boost::filesystem::path output, int frames)
+{
+	auto film = make_shared<Film>(film_directory);
+	film->read_metadata ();
+
+	boost::filesystem::create_directories (output);
+
+	Player player (film, Image::Alignment::COMPACT);
+	player.set_ignore_audio ();
+	player.set_ignore_text ();
+
+	int written = 0;
+	int index = 0;
+	player.Video.connect ([&](shared_ptr<PlayerVideo> pv, dcpomatic::DCPTime) {
+		if (written >= frames) {
+			return;
+		}
+		DCPVideo frame (pv, index, film->video_frame_rate(), film->j2k_bandwidth(), film->resolution());
+		auto const request = frame.request ();
+		auto const name = raw_convert<string>(index) + "_" + raw_convert<string>(static_cast<int>(pv->eyes())) + ".request";
+		dcp::write_string_to_file (string(request.begin(), request.end()), output / name);
+		if (pv->eyes() != Eyes::LEFT) {
+			++index;
+		}
+		++written;
+	});
+
+	while (written < frames && !player.pass()) {}
+
+	cerr << "Recorded " << written << " requests from " << film_directory.string() << " in " << output.string() << "\n";
+	return written;
+}
+
+
+/** Settings for the load that we put on the servers */
+struct Load
+{
+	vector<Traffic> traffic;
+	/** number of connections to each server */
+	int connections = 2;
+	/** number of requests to keep in flight on each connection */
+	int depth = 2;
+	int timeout = 30;
+	Impairment impairment;
+};
+
+
+/** Send frames to a server over one connection, making a new connection whenever the old one fails,
+ *  until @p stop is set.  Anything that happens after @p measure_from is added to @p statistics.
+ */
+static void
+connection_thread (
+	EncodeServerDescription server,
+	int seed,
+	Load const& load,
+	std::atomic<bool> const& stop,
+	Clock::time_point measure_from,
+	Statistics& statistics,
+	std::mutex& mutex
+	)
+{
+	start_of_thread ("load-test-connection");
+
+	std::mt19937 random (seed);
+	vector<double> weights;
+	for (auto const& i: load.traffic) {
+		weights.push_back (i.requests.empty() ? 0 : i.weight);
+	}
+	std::discrete_distribution<size_t> pick_traffic (weights.begin(), weights.end());
+	std::uniform_real_distribution<double> uniform (0, 1);
+
+	auto since = [](Clock::time_point start) {
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	};
+
+	auto sleep = [&stop](double seconds) {
+		auto const until = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+		while (!stop && Clock::now() < until) {
+			std::this_thread::sleep_for (std::min(std::chrono::duration_cast<Clock::duration>(std::chrono::milliseconds(100)), until - Clock::now()));
+		}
+	};
+
+	Statistics mine;
+	auto const measuring = [measure_from]() { return Clock::now() >= measure_from; };
+
+	struct InFlight
+	{
+		int index;
+		Eyes eyes;
+		Clock::time_point sent;
+	};
+
+	optional<Clock::time_point> failed_at;
+	double backoff = 0.5;
+
+	while (!stop) {
+		list<InFlight> in_flight;
+		try {
+			EncodeServerConnection connection (server, load.timeout);
+			if (measuring()) {
+				++mine.connections;
+			}
+			auto const connected = Clock::now();
+			/* Time before which bandwidth limiting means we may not send any more */
+			auto may_send = Clock::now();
+
+			while (!stop) {
+				if (load.impairment.churn > 0 && since(connected) > load.impairment.churn) {
+					break;
+				}
+
+				while (static_cast<int>(in_flight.size()) < load.depth) {
+					auto const& traffic = load.traffic[pick_traffic(random)];
+					auto const& request = traffic.requests[std::uniform_int_distribution<size_t>(0, traffic.requests.size() - 1)(random)];
+
+					sleep (load.impairment.delay + load.impairment.jitter * uniform(random));
+					std::this_thread::sleep_until (may_send);
+
+					connection.send (request.data);
+					in_flight.push_back ({request.index, request.eyes, Clock::now()});
+					if (measuring()) {
+						mine.bytes_sent += request.data.size();
+					}
+
+					if (load.impairment.bandwidth > 0) {
+						may_send = std::max(may_send, Clock::now()) + std::chrono::duration_cast<Clock::duration>(
+							std::chrono::duration<double>(request.data.size() * 8 / load.impairment.bandwidth)
+							);
+					}
+
+					if (uniform(random) < load.impairment.drop) {
+						throw NetworkError ("connection dropped on purpose");
+					}
+				}
+
+				auto reply = connection.receive ();
+				auto i = std::find_if (in_flight.begin(), in_flight.end(), [&reply](InFlight const& f) {
+					return f.index == reply.index && f.eyes == reply.eyes;
+				});
+				if (i == in_flight.end()) {
+					throw NetworkError ("server returned a frame that we did not send");
+				}
+				auto const latency = since(i->sent);
+				in_flight.erase (i);
+
+				if (!measuring()) {
+					continue;
+				}
+
+				switch (reply.status) {
+				case EncodeServerConnection::Status::ENCODED:
+					++mine.encoded;
+					mine.latencies.push_back (latency);
+					mine.bytes_received += reply.encoded->size();
+					if (failed_at) {
+						mine.recoveries.push_back (since(*failed_at));
+						failed_at = boost::none;
+					}
+					backoff = 0.5;
+					break;
+				case EncodeServerConnection::Status::BUSY:
+					++mine.busy;
+					break;
+				case EncodeServerConnection::Status::FAILED:
+					++mine.failed;
+					break;
+				}
+			}
+		} catch (std::exception& e) {
+			if (stop) {
+				break;
+			}
+			if (measuring()) {
+				++mine.errors[e.what()];
+				mine.lost += in_flight.size();
+			}
+			if (!failed_at) {
+				failed_at = Clock::now();
+			}
+			sleep (backoff);
+			backoff = std::min(backoff * 2, maximum_backoff);
+		}
+	}
+
+	std::lock_guard<std::mutex> lm (mutex);
+	statistics.add (mine);
+}
+
+
+static string
+statistics_json (Statistics const& statistics, double seconds, string indent)
+{
+	auto milliseconds = [](double s) {
+		return raw_convert<string>(s * 1000, 3, true);
+	};
+
+	string json;
+	json += indent + "\"fps\": " + raw_convert<string>(statistics.encoded / seconds, 3, true) + ",\n";
+	json += indent + "\"encoded\": " + raw_convert<string>(statistics.encoded) + ",\n";
+	json += indent + "\"busy\": " + raw_convert<string>(statistics.busy) + ",\n";
+	json += indent + "\"failed\": " + raw_convert<string>(statistics.failed) + ",\n";
+	json += indent + "\"lost\": " + raw_convert<string>(statistics.lost) + ",\n";
+	json += indent + "\"connections\": " + raw_convert<string>(statistics.connections) + ",\n";
+	json += indent + "\"sent_mbit_per_second\": " + raw_convert<string>(statistics.bytes_sent * 8 / (seconds * 1e6), 3, true) + ",\n";
+	json += indent + "\"received_mbit_per_second\": " + raw_convert<string>(statistics.bytes_received * 8 / (seconds * 1e6), 3, true) + ",\n";
+	for (auto p: { 50.0, 90.0, 99.0, 99.9, 100.0 }) {
+		auto name = raw_convert<string>(p);
+		std::replace (name.begin(), name.end(), '.', '_');
+		json += indent + "\"" + (p == 100 ? string("max") : "p" + name) + "_ms\": " + milliseconds(Statistics::percentile(statistics.latencies, p)) + ",\n";
+	}
+	json += indent + "\"recoveries\": " + raw_convert<string>(statistics.recoveries.size()) + ",\n";
+	json += indent + "\"max_recovery_ms\": " + milliseconds(Statistics::percentile(statistics.recoveries, 100)) + ",\n";
+	json += indent + "\"errors\": {";
+	int n = 0;
+	for (auto const& i: statistics.errors) {
+		auto message = i.first;
+		std::replace (message.begin(), message.end(), '"', '\'');
+		json += (n++ ? ", \"" : " \"") + message + "\": " + raw_convert<string>(i.second);
+	}
+	json += n ? " }\n" : "}\n";
+	return json;
+}
+
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " --record <dir> --film <film> [--frames <n>]\n"
+	     << "    or: " << n << " --traffic <dir>[:<weight>] --server <host> [OPTION]\n"
+	     << "\n"
+	     << "  -h, --help                  show this help\n"
+	     << "\n"
+	     << "Recording:\n"
+	     << "  -R, --record <dir>          write the requests that a master would send for a film to <dir>\n"
+	     << "  -f, --film <film>           film to record\n"
+	     << "  -n, --frames <n>            number of frames to record (default 240)\n"
+	     << "\n"
+	     << "Replaying:\n"
+	     << "  -t, --traffic <dir>[:<w>]   send requests recorded in <dir>; give more than once to mix recordings,\n"
+	     << "                              each sent in proportion to its weight <w> (default 1)\n"
+	     << "  -s, --server <host>         server to send to; may be given more than once\n"
+	     << "  -c, --connections <n>       connections to each server (default 2)\n"
+	     << "  -q, --depth <n>             requests in flight on each connection (default 2)\n"
+	     << "  -d, --duration <seconds>    time to run for (default 60)\n"
+	     << "  -w, --warmup <seconds>      time at the start to leave out of the results (default 5)\n"
+	     << "      --timeout <seconds>     network timeout (default 30)\n"
+	     << "      --delay <ms>            wait before sending each request\n"
+	     << "      --jitter <ms>           wait up to this much longer, at random\n"
+	     << "      --bandwidth <Mbit/s>    limit the rate at which each connection sends\n"
+	     << "      --drop <probability>    drop the connection after sending a request, with this chance\n"
+	     << "      --churn <seconds>       drop connections and make new ones this often\n"
+	     << "      --target-fps <fps>      say how many servers like these would be needed to encode this fast\n"
+	     << "  -o, --output <file>         write results to a file rather than stdout\n";
+}
+
+
+int
+main (int argc, char* argv[])
+{
+	optional<boost::filesystem::path> record_to;
+	optional<boost::filesystem::path> film_dir;
+	int frames = 240;
+	Load load;
+	vector<string> servers;
+	double duration = 60;
+	double warmup = 5;
+	optional<double> target_fps;
+	optional<boost::filesystem::path> output;
+
+	int option_index = 0;
+	while (true) {
+		static struct option long_options[] = {
+			{ "help", no_argument, 0, 'h' },
+			{ "record", required_argument, 0, 'R' },
+			{ "film", required_argument, 0, 'f' },
+			{ "frames", required_argument, 0, 'n' },
+			{ "traffic", required_argument, 0, 't' },
+			{ "server", required_argument, 0, 's' },
+			{ "connections", required_argument, 0, 'c' },
+			{ "depth", required_argument, 0, 'q' },
+			{ "duration", required_argument, 0, 'd' },
+			{ "warmup", required_argument, 0, 'w' },
+			{ "timeout", required_argument, 0, 'A' },
+			{ "delay", required_argument, 0, 'B' },
+			{ "jitter", required_argument, 0, 'C' },
+			{ "bandwidth", required_argument, 0, 'D' },
+			{ "drop", required_argument, 0, 'E' },
+			{ "churn", required_argument, 0, 'F' },
+			{ "target-fps", required_argument, 0, 'G' },
+			{ "output", required_argument, 0, 'o' },
+			{ 0, 0, 0, 0 }
+		};
+
+		int c = getopt_long (argc, argv, "hR:f:n:t:s:c:q:d:w:A:B:C:D:E:F:G:o:", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'h':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		case 'R':
+			record_to = optarg;
+			break;
+		case 'f':
+			film_dir = optarg;
+			break;
+		case 'n':
+			frames = atoi (optarg);
+			break;
+		case 't':
+		{
+			Traffic traffic;
+			string const s = optarg;
+			auto const colon = s.rfind(":");
+			if (colon != string::npos && colon > 0 && !boost::filesystem::is_directory(s)) {
+				traffic.directory = s.substr(0, colon);
+				traffic.weight = atof (s.substr(colon + 1).c_str());
+			} else {
+				traffic.directory = s;
+			}
+			load.traffic.push_back (traffic);
+			break;
+		}
+		case 's':
+			servers.push_back (optarg);
+			break;
+		case 'c':
+			load.connections = atoi (optarg);
+			break;
+		case 'q':
+			load.depth = atoi (optarg);
+			break;
+		case 'd':
+			duration = atof (optarg);
+			break;
+		case 'w':
+			warmup = atof (optarg);
+			break;
+		case 'A':
+			load.timeout = atoi (optarg);
+			break;
+		case 'B':
+			load.impairment.delay = atof (optarg) / 1000;
+			break;
+		case 'C':
+			load.impairment.jitter = atof (optarg) / 1000;
+			break;
+		case 'D':
+			load.impairment.bandwidth = atof (optarg) * 1e6;
+			break;
+		case 'E':
+			load.impairment.drop = atof (optarg);
+			break;
+		case 'F':
+			load.impairment.churn = atof (optarg);
+			break;
+		case 'G':
+			target_fps = atof (optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		}
+	}
+
+	dcpomatic_setup_path_encoding ();
+	dcpomatic_setup ();
+
+	if (record_to) {
+		if (!film_dir) {
+			cerr << "--record needs --film\n";
+			exit (EXIT_FAILURE);
+		}
+		try {
+			return record(*film_dir, *record_to, frames) > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		} catch (std::exception& e) {
+			cerr << argv[0] << ": " << e.what() << "\n";
+			exit (EXIT_FAILURE);
+		}
+	}
+
+	if (load.traffic.empty() || servers.empty()) {
+		help (argv[0]);
+		exit (EXIT_FAILURE);
+	}
+
+	if (load.connections < 1 || load.depth < 1 || duration <= warmup) {
+		cerr << "--connections and --depth must be at least 1, and --duration must be longer than --warmup\n";
+		exit (EXIT_FAILURE);
+	}
+
+	double total_weight = 0;
+	for (auto& i: load.traffic) {
+		try {
+			i.requests = read_requests (i.directory);
+		} catch (std::exception& e) {
+			cerr << argv[0] << ": could not read " << i.directory.string() << " (" << e.what() << ")\n";
+			exit (EXIT_FAILURE);
+		}
+		if (i.requests.empty()) {
+			cerr << "No recorded requests in " << i.directory.string() << "\n";
+			exit (EXIT_FAILURE);
+		}
+		total_weight += i.weight;
+	}
+
+	if (total_weight <= 0) {
+		cerr << "At least one --traffic must have a weight above 0\n";
+		exit (EXIT_FAILURE);
+	}
+
+	std::atomic<bool> stop (false);
+	auto const start = Clock::now();
+	auto const measure_from = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(warmup));
+
+	std::mutex mutex;
+	map<string, Statistics> statistics;
+	for (auto const& i: servers) {
+		statistics[i];
+	}
+
+	vector<std::thread> threads;
+	int seed = 0;
+	for (auto const& i: servers) {
+		EncodeServerDescription server (i, 1, SERVER_LINK_VERSION);
+		for (int j = 0; j < load.connections; ++j) {
+			threads.push_back (
+				std::thread(connection_thread, server, seed++, std::cref(load), std::cref(stop), measure_from, std::ref(statistics[i]), std::ref(mutex))
+				);
+		}
+	}
+
+	cerr << "Running " << threads.size() << " connection(s) for " << duration << "s...\n";
+	std::this_thread::sleep_until (start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(duration)));
+	stop = true;
+	for (auto& i: threads) {
+		i.join ();
+	}
+
+	auto const seconds = duration - warmup;
+
+	Statistics total;
+	for (auto const& i: statistics) {
+		total.add (i.second);
+	}
+
+	string json = "{\n";
+	json += "  \"version\": " + raw_convert<string>(results_version) + ",\n";
+	json += "  \"dcpomatic\": \"" + string(dcpomatic_version) + " " + string(dcpomatic_git_commit) + "\",\n";
+	json += "  \"seconds\": " + raw_convert<string>(seconds, 3, true) + ",\n";
+	json += "  \"connections_per_server\": " + raw_convert<string>(load.connections) + ",\n";
+	json += "  \"depth\": " + raw_convert<string>(load.depth) + ",\n";
+	json += "  \"traffic\": [";
+	for (size_t i = 0; i < load.traffic.size(); ++i) {
+		json += string(i ? ", " : " ") + "{ \"directory\": \"" + load.traffic[i].directory.generic_string() + "\", \"weight\": " + raw_convert<string>(load.traffic[i].weight, 3, true) + " }";
+	}
+	json += " ],\n";
+	json += "  \"servers\": {\n";
+	int n = 0;
+	for (auto const& i: statistics) {
+		json += "    \"" + i.first + "\": {\n";
+		json += statistics_json (i.second, seconds, "      ");
+		json += ++n == static_cast<int>(statistics.size()) ? "    }\n" : "    },\n";
+	}
+	json += "  },\n";
+	if (target_fps) {
+		/* Assume that more servers like the ones we tried would each add as much as the average one did */
+		auto const per_server = total.encoded / seconds / servers.size();
+		json += "  \"target_fps\": " + raw_convert<string>(*target_fps, 3, true) + ",\n";
+		if (per_server > 0) {
+			json += "  \"servers_needed\": " + raw_convert<string>(static_cast<int>(std::ceil(*target_fps / per_server))) + ",\n";
+		}
+	}
+	json += "  \"total\": {\n";
+	json += statistics_json (total, seconds, "    ");
+	json += "  }\n";
+	json += "}\n";
+
+	if (output) {
+		dcp::write_string_to_file (json, *output);
+	} else {
+		cout << json;
+	}
+
+	return total.encoded > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
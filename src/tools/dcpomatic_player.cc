@@ -58,6 +58,7 @@
 #include "lib/scoped_temporary.h"
 #include "lib/server.h"
 #include "lib/text_content.h"
+#include "lib/timer.h"
 #include "lib/update_checker.h"
 #include "lib/util.h"
 #include "lib/verify_dcp_job.h"
@@ -76,6 +77,7 @@ LIBDCP_DISABLE_WARNINGS
 #include <wx/progdlg.h>
 #include <wx/splash.h>
 #include <wx/stdpaths.h>
+#include <wx/weakref.h>
 #include <wx/wx.h>
 LIBDCP_ENABLE_WARNINGS
 #ifdef __WXGTK__
@@ -118,6 +120,7 @@ enum {
 	ID_file_add_ov,
 	ID_file_add_kdm,
 	ID_file_save_frame,
+	ID_file_compare,
 	ID_file_history,
 	/* Allow spare IDs after _history for the recent files list */
 	ID_file_close = 100,
@@ -150,6 +153,82 @@ enum {
 };
 
 
+/** Set up a player's Film to suit the content that has been added to it */
+static void
+set_up_film_for_content (shared_ptr<Film> film)
+{
+	/* Start off as Flat */
+	film->set_container (Ratio::from_id("185"));
+
+	for (auto i: film->content()) {
+		for (auto j: i->text) {
+			j->set_use (true);
+		}
+
+		if (i->video) {
+			auto const r = Ratio::nearest_from_ratio(i->video->size().ratio());
+			if (r->id() == "239") {
+				/* Any scope content means we use scope */
+				film->set_container(r);
+			}
+		}
+
+		/* Any 3D content means we use 3D mode */
+		if (i->video && i->video->frame_type() != VideoFrameType::TWO_D) {
+			film->set_three_d (true);
+		}
+	}
+}
+
+
+/** A window showing a second DCP which plays in sync with the one in the main window,
+ *  so that the two can be compared.
+ */
+class ComparisonFrame : public wxFrame
+{
+public:
+	ComparisonFrame (wxWindow* parent, FilmViewer& leader, boost::filesystem::path dir)
+		: wxFrame (parent, wxID_ANY, std_to_wx(dir.filename().string()))
+		, _overall_panel (new wxPanel(this, wxID_ANY))
+		, _viewer (_overall_panel)
+		, _film (new Film(optional<boost::filesystem::path>()))
+	{
+		auto sizer = new wxBoxSizer (wxVERTICAL);
+		sizer->Add (_viewer.panel(), 1, wxEXPAND);
+		_overall_panel->SetSizer (sizer);
+
+		_film->set_tolerant (true);
+		_film->set_audio_channels (MAX_DCP_AUDIO_CHANNELS);
+		_viewer.set_dcp_decode_reduction (Config::instance()->decode_reduction());
+		_viewer.set_optimise_for_j2k (true);
+
+		auto dcp = make_shared<DCPContent>(dir);
+		auto job = make_shared<ExamineContentJob>(_film, dcp);
+		JobManager::instance()->add (job);
+		if (!display_progress(_("DCP-o-matic Player"), _("Loading content"))) {
+			return;
+		}
+		if (job->finished_in_error()) {
+			throw std::runtime_error(job->error_summary());
+		}
+
+		_film->add_content (dcp);
+		if (dcp->video_frame_rate()) {
+			_film->set_video_frame_rate(dcp->video_frame_rate().get(), true);
+		}
+		set_up_film_for_content (_film);
+
+		_viewer.set_film (_film);
+		_viewer.follow (&leader);
+	}
+
+private:
+	wxPanel* _overall_panel;
+	FilmViewer _viewer;
+	shared_ptr<Film> _film;
+};
+
+
 class DOMFrame : public wxFrame
 {
 public:
@@ -224,6 +303,7 @@ public:
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_add_ov, this), ID_file_add_ov);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_add_kdm, this), ID_file_add_kdm);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_save_frame, this), ID_file_save_frame);
+		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_compare, this), ID_file_compare);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_history, this, _1), ID_file_history, ID_file_history + HISTORY_SIZE);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_close, this), ID_file_close);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::file_exit, this), wxID_EXIT);
@@ -452,29 +532,7 @@ public:
 			_viewer.stop();
 		}
 
-		/* Start off as Flat */
-		_film->set_container (Ratio::from_id("185"));
-
-		for (auto i: _film->content()) {
-			auto dcp = dynamic_pointer_cast<DCPContent>(i);
-
-			for (auto j: i->text) {
-				j->set_use (true);
-			}
-
-			if (i->video) {
-				auto const r = Ratio::nearest_from_ratio(i->video->size().ratio());
-				if (r->id() == "239") {
-					/* Any scope content means we use scope */
-					_film->set_container(r);
-				}
-			}
-
-			/* Any 3D content means we use 3D mode */
-			if (i->video && i->video->frame_type() != VideoFrameType::TWO_D) {
-				_film->set_three_d (true);
-			}
-		}
+		set_up_film_for_content (_film);
 
 		_viewer.seek(DCPTime(), true);
 		_info->triggered_update ();
@@ -546,6 +604,7 @@ private:
 		_file_add_kdm = _file_menu->Append (ID_file_add_kdm, _("Add &KDM..."));
 		_file_menu->AppendSeparator ();
 		_file_save_frame = _file_menu->Append (ID_file_save_frame, _("&Save frame to file...\tCtrl-S"));
+		_file_compare = _file_menu->Append (ID_file_compare, _("&Compare with DCP..."));
 
 		_history_position = _file_menu->GetMenuItems().GetCount();
 
@@ -609,6 +668,29 @@ private:
 		m->Append (help, _("&Help"));
 	}
 
+	void file_compare ()
+	{
+		auto d = wxStandardPaths::Get().GetDocumentsDir();
+		if (Config::instance()->last_player_load_directory()) {
+			d = std_to_wx (Config::instance()->last_player_load_directory()->string());
+		}
+
+		auto c = new wxDirDialog (this, _("Select DCP to compare with"), d, wxDEFAULT_DIALOG_STYLE | wxDD_DIR_MUST_EXIST);
+		if (c->ShowModal() == wxID_OK) {
+			if (_comparison) {
+				_comparison->Destroy ();
+			}
+			try {
+				_comparison = new ComparisonFrame (this, _viewer, wx_to_std(c->GetPath()));
+				_comparison->Show ();
+			} catch (std::exception& e) {
+				error_dialog (this, wxString::Format(_("Could not load a DCP from %s"), c->GetPath()), std_to_wx(e.what()));
+			}
+		}
+
+		c->Destroy ();
+	}
+
 	void file_open ()
 	{
 		auto d = wxStandardPaths::Get().GetDocumentsDir();
@@ -1050,6 +1132,7 @@ private:
 		_file_add_ov->Enable (static_cast<bool>(_film));
 		_file_add_kdm->Enable (static_cast<bool>(_film));
 		_file_save_frame->Enable (static_cast<bool>(_film));
+		_file_compare->Enable (static_cast<bool>(_film));
 		_view_cpl->Enable (static_cast<bool>(_film));
 	}
 
@@ -1108,6 +1191,8 @@ private:
 	wxMenuItem* _file_add_ov = nullptr;
 	wxMenuItem* _file_add_kdm = nullptr;
 	wxMenuItem* _file_save_frame = nullptr;
+	wxMenuItem* _file_compare = nullptr;
+	wxWeakRef<ComparisonFrame> _comparison;
 	wxMenuItem* _tools_verify = nullptr;
 	wxMenuItem* _view_full_screen = nullptr;
 	wxMenuItem* _view_dual_screen = nullptr;
@@ -1167,6 +1252,8 @@ private:
 	bool OnInit () override
 	{
 		wxSplashScreen* splash = nullptr;
+		/* Time each part of our start-up, so that slow ones can be found from the log */
+		StateTimer startup ("Player start-up", "wx");
 		try {
 			wxInitAllImageHandlers ();
 
@@ -1197,11 +1284,13 @@ private:
 			   hasn't yet been called and there aren't any filters etc.
 			   set up yet.
 			*/
+			startup.set ("i18n");
 			dcpomatic_setup_i18n ();
 
 			/* Set things up, including filters etc.
 			   which will now be internationalised correctly.
 			*/
+			startup.set ("setup");
 			dcpomatic_setup ();
 
 			/* Force the configuration to be re-loaded correctly next
@@ -1211,6 +1300,7 @@ private:
 
 			signal_manager = new wxSignalManager (this);
 
+			startup.set ("window");
 			_frame = new DOMFrame ();
 			SetTopWindow (_frame);
 			_frame->Maximize ();
@@ -1231,6 +1321,7 @@ private:
 			}
 
 			if (!_dcp_to_load.empty() && boost::filesystem::is_directory (_dcp_to_load)) {
+				startup.set ("load DCP");
 				try {
 					_frame->load_dcp (_dcp_to_load);
 				} catch (exception& e) {
@@ -1251,6 +1342,11 @@ private:
 			if (Config::instance()->check_for_updates ()) {
 				UpdateChecker::instance()->run ();
 			}
+
+			startup.unset ();
+			for (auto const& i: startup.counts()) {
+				LOG_GENERAL ("Start-up: %1 took %2s", i.first, i.second.total_time);
+			}
 		}
 		catch (exception& e)
 		{
@@ -29,6 +29,7 @@
 #include "lib/version.h"
 #include "lib/encode_server.h"
 #include "lib/dcpomatic_log.h"
+#include "lib/json_server.h"
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/algorithm/string.hpp>
@@ -55,6 +56,7 @@ help (string n)
 	     << "  -v, --version      show DCP-o-matic version\n"
 	     << "  -h, --help         show this help\n"
 	     << "  -t, --threads      number of parallel encoding threads to use\n"
+	     << "  -j, --json <port>  run a JSON server on the specified port, giving metrics for monitoring at /metrics\n"
 	     << "  --verbose          be verbose to stdout\n"
 	     << "  --log              write a log file of activity\n";
 }
@@ -68,6 +70,7 @@ main (int argc, char* argv[])
 	int num_threads = Config::instance()->server_encoding_threads ();
 	bool verbose = false;
 	bool write_log = false;
+	boost::optional<int> json_port;
 
 	int option_index = 0;
 	while (true) {
@@ -75,12 +78,13 @@ main (int argc, char* argv[])
 			{ "version", no_argument, 0, 'v'},
 			{ "help", no_argument, 0, 'h'},
 			{ "threads", required_argument, 0, 't'},
+			{ "json", required_argument, 0, 'j'},
 			{ "verbose", no_argument, 0, 'A'},
 			{ "log", no_argument, 0, 'B'},
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long (argc, argv, "vht:AB", long_options, &option_index);
+		int c = getopt_long (argc, argv, "vht:j:AB", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -96,6 +100,9 @@ main (int argc, char* argv[])
 		case 't':
 			num_threads = atoi (optarg);
 			break;
+		case 'j':
+			json_port = atoi (optarg);
+			break;
 		case 'A':
 			verbose = true;
 			break;
@@ -109,6 +116,10 @@ main (int argc, char* argv[])
 		dcpomatic_log.reset (new FileLog("dcpomatic_server_cli.log"));
 	}
 
+	if (json_port) {
+		new JSONServer (*json_port);
+	}
+
 	EncodeServer server (verbose, num_threads);
 
 	try {
@@ -237,7 +237,13 @@ AudioDialog::try_to_load_analysis ()
 			film, _playlist, !static_cast<bool>(check), _analysis_finished_connection, bind (&AudioDialog::analysis_finished, this)
 			);
 		return;
-        }
+	} catch (FileError& e) {
+		/* A damaged analysis file: recreate it */
+		JobManager::instance()->analyse_audio (
+			film, _playlist, !static_cast<bool>(check), _analysis_finished_connection, bind (&AudioDialog::analysis_finished, this)
+			);
+		return;
+	}
 
 	_plot->set_analysis (_analysis);
 	_plot->set_gain_correction (_analysis->gain_correction (_playlist));
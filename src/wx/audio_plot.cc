@@ -38,6 +38,7 @@ using std::list;
 using std::map;
 using std::max;
 using std::min;
+using std::pair;
 using std::shared_ptr;
 using std::vector;
 using std::weak_ptr;
@@ -113,6 +114,7 @@ void
 AudioPlot::set_analysis (shared_ptr<AudioAnalysis> a)
 {
 	_analysis = a;
+	clear_levels ();
 
 	if (!a) {
 		_message = _("Please wait; audio is being analysed...");
@@ -244,8 +246,8 @@ AudioPlot::paint ()
 	if (_type_visible[AudioPoint::PEAK]) {
 		for (int c = 0; c < MAX_DCP_AUDIO_CHANNELS; ++c) {
 			auto p = gc->CreatePath ();
-			if (_channel_visible[c] && c < _analysis->channels()) {
-				plot_peak (p, c, metrics);
+			if (_channel_visible[c] && c < _analysis->channels() && _analysis->points(c) > 0) {
+				plot (p, c, metrics, peak_levels(c), _peak[c]);
 			}
 			auto const col = _colours[c];
 			gc->SetPen (wxPen (wxColour (col.Red(), col.Green(), col.Blue(), col.Alpha() / 2), 1, wxPENSTYLE_SOLID));
@@ -256,8 +258,8 @@ AudioPlot::paint ()
 	if (_type_visible[AudioPoint::RMS]) {
 		for (int c = 0; c < MAX_DCP_AUDIO_CHANNELS; ++c) {
 			auto p = gc->CreatePath ();
-			if (_channel_visible[c] && c < _analysis->channels()) {
-				plot_rms (p, c, metrics);
+			if (_channel_visible[c] && c < _analysis->channels() && _analysis->points(c) > 0) {
+				plot (p, c, metrics, rms_levels(c), _rms[c]);
 			}
 			auto const col = _colours[c];
 			gc->SetPen (wxPen (col, 1, wxPENSTYLE_SOLID));
@@ -296,17 +298,45 @@ AudioPlot::y_for_linear (float p, Metrics const & metrics) const
 }
 
 
-void
-AudioPlot::plot_peak (wxGraphicsPath& path, int channel, Metrics const & metrics) const
+/** Make the coarser versions of some smoothed values from the first version */
+AudioPlot::Levels
+AudioPlot::make_levels (vector<float> const& values)
 {
-	if (_analysis->points (channel) == 0) {
-		return;
+	Levels levels (1);
+	for (auto i: values) {
+		levels[0].push_back ({i, i});
 	}
 
-	_peak[channel] = PointList ();
+	while (levels.back().size() > 1) {
+		auto const& finer = levels.back();
+		vector<pair<float, float>> coarser;
+		for (size_t i = 0; i < finer.size(); i += 2) {
+			auto value = finer[i];
+			if (i + 1 < finer.size()) {
+				value.first = min(value.first, finer[i + 1].first);
+				value.second = max(value.second, finer[i + 1].second);
+			}
+			coarser.push_back (value);
+		}
+		levels.push_back (coarser);
+	}
+
+	return levels;
+}
+
+
+AudioPlot::Levels const&
+AudioPlot::peak_levels (int channel) const
+{
+	auto i = _peak_levels.find(channel);
+	if (i != _peak_levels.end()) {
+		return i->second;
+	}
 
-	float peak = 0;
 	int const N = _analysis->points(channel);
+	vector<float> values (N);
+
+	float peak = 0;
 	for (int i = 0; i < N; ++i) {
 		float const p = get_point(channel, i)[AudioPoint::PEAK];
 		peak -= 0.01f * (1 - log10 (_smoothing) / log10 (max_smoothing));
@@ -315,36 +345,21 @@ AudioPlot::plot_peak (wxGraphicsPath& path, int channel, Metrics const & metrics
 		} else if (peak < 0) {
 			peak = 0;
 		}
-
-		_peak[channel].push_back (
-			Point (
-				wxPoint (metrics.db_label_width + i * metrics.x_scale, y_for_linear (peak, metrics)),
-				DCPTime::from_frames (i * _analysis->samples_per_point(), _analysis->sample_rate()),
-				linear_to_db(peak)
-				)
-			);
+		values[i] = peak;
 	}
 
-	DCPOMATIC_ASSERT (_peak.find(channel) != _peak.end());
-
-	path.MoveToPoint (_peak[channel][0].draw);
-	for (auto const& i: _peak[channel]) {
-		path.AddLineToPoint (i.draw);
-	}
+	return _peak_levels[channel] = make_levels (values);
 }
 
 
-void
-AudioPlot::plot_rms (wxGraphicsPath& path, int channel, Metrics const & metrics) const
+AudioPlot::Levels const&
+AudioPlot::rms_levels (int channel) const
 {
-	if (_analysis->points (channel) == 0) {
-		return;
+	auto i = _rms_levels.find(channel);
+	if (i != _rms_levels.end()) {
+		return i->second;
 	}
 
-	_rms[channel] = PointList();
-
-	list<float> smoothing;
-
 	int const N = _analysis->points(channel);
 
 	float const first = get_point(channel, 0)[AudioPoint::RMS];
@@ -353,63 +368,97 @@ AudioPlot::plot_rms (wxGraphicsPath& path, int channel, Metrics const & metrics)
 	int const before = _smoothing / 2;
 	int const after = _smoothing - before;
 
-	/* Pre-load the smoothing list */
+	/* Everything that goes through the smoothing window, in order; the window for point
+	   i is the _smoothing values starting at i + 1.
+	*/
+	vector<float> input;
 	for (int i = 0; i < before; ++i) {
-		smoothing.push_back (first);
+		input.push_back (first);
 	}
 	for (int i = 0; i < after; ++i) {
-		if (i < N) {
-			smoothing.push_back (get_point(channel, i)[AudioPoint::RMS]);
-		} else {
-			smoothing.push_back (last);
-		}
+		input.push_back (i < N ? get_point(channel, i)[AudioPoint::RMS] : last);
 	}
-
 	for (int i = 0; i < N; ++i) {
+		input.push_back (i + after < N ? get_point(channel, i)[AudioPoint::RMS] : last);
+	}
 
-		int const next_for_window = i + after;
+	/* Keep a running sum of the squares of the values in the window */
+	double sum = 0;
+	for (int i = 1; i <= _smoothing; ++i) {
+		sum += pow(input[i], 2);
+	}
 
-		if (next_for_window < N) {
-			smoothing.push_back (get_point(channel, i)[AudioPoint::RMS]);
-		} else {
-			smoothing.push_back (last);
+	vector<float> values (N);
+	for (int i = 0; i < N; ++i) {
+		if (i > 0) {
+			sum += pow(input[i + _smoothing], 2) - pow(input[i], 2);
 		}
+		values[i] = _smoothing > 0 ? sqrt(max(sum, 0.0) / _smoothing) : 0;
+	}
 
-		smoothing.pop_front ();
+	return _rms_levels[channel] = make_levels (values);
+}
 
-		float p = 0;
-		for (list<float>::const_iterator j = smoothing.begin(); j != smoothing.end(); ++j) {
-			p += pow (*j, 2);
-		}
 
-		if (!smoothing.empty ()) {
-			p = sqrt (p / smoothing.size ());
-		}
+/** Add a line to @p path for some @p levels, using the coarsest version which still has an entry
+ *  for each pixel, and put what we drew in @p points.
+ */
+void
+AudioPlot::plot (wxGraphicsPath& path, int channel, Metrics const& metrics, Levels const& levels, PointList& points) const
+{
+	points.clear ();
+
+	if (_analysis->points (channel) == 0 || levels.empty()) {
+		return;
+	}
+
+	size_t level = 0;
+	while (level + 1 < levels.size() && metrics.x_scale * (1 << (level + 1)) <= 1) {
+		++level;
+	}
 
-		_rms[channel].push_back (
+	auto const step = 1 << level;
+	auto add = [this, &metrics, &points, step](size_t index, float value) {
+		auto const point = index * step;
+		points.push_back (
 			Point (
-				wxPoint (metrics.db_label_width + i * metrics.x_scale, y_for_linear (p, metrics)),
-				DCPTime::from_frames (i * _analysis->samples_per_point(), _analysis->sample_rate()),
-				linear_to_db(p)
+				wxPoint (metrics.db_label_width + point * metrics.x_scale, y_for_linear (value, metrics)),
+				DCPTime::from_frames (point * _analysis->samples_per_point(), _analysis->sample_rate()),
+				linear_to_db(value)
 				)
 			);
-	}
+	};
 
-	DCPOMATIC_ASSERT (_rms.find(channel) != _rms.end());
+	for (size_t i = 0; i < levels[level].size(); ++i) {
+		auto const& value = levels[level][i];
+		add (i, value.second);
+		if (value.first != value.second) {
+			add (i, value.first);
+		}
+	}
 
-	path.MoveToPoint (_rms[channel][0].draw);
-	for (auto const& i: _rms[channel]) {
+	path.MoveToPoint (points[0].draw);
+	for (auto const& i: points) {
 		path.AddLineToPoint (i.draw);
 	}
 }
 
 
 void
-AudioPlot::set_smoothing (int s)
+AudioPlot::clear_levels ()
 {
-	_smoothing = s;
+	_peak_levels.clear ();
+	_rms_levels.clear ();
 	_rms.clear ();
 	_peak.clear ();
+}
+
+
+void
+AudioPlot::set_smoothing (int s)
+{
+	_smoothing = s;
+	clear_levels ();
 	Refresh ();
 }
 
@@ -418,6 +467,7 @@ void
 AudioPlot::set_gain_correction (double gain)
 {
 	_gain_correction = gain;
+	clear_levels ();
 	Refresh ();
 }
 
@@ -68,9 +68,19 @@ private:
 
 	typedef std::vector<Point> PointList;
 
+	/** Smoothed values for one channel, along with coarser versions of them in which
+	 *  each entry covers twice as many points as in the version before.  This means
+	 *  that we can draw from a version which has about as many entries as there are
+	 *  pixels.  Each entry is the minimum and maximum of the values that it covers.
+	 */
+	typedef std::vector<std::vector<std::pair<float, float>>> Levels;
+
 	void paint ();
-	void plot_peak (wxGraphicsPath &, int, Metrics const &) const;
-	void plot_rms (wxGraphicsPath &, int, Metrics const &) const;
+	void plot (wxGraphicsPath& path, int channel, Metrics const& metrics, Levels const& levels, PointList& points) const;
+	Levels const& peak_levels (int channel) const;
+	Levels const& rms_levels (int channel) const;
+	void clear_levels ();
+	static Levels make_levels (std::vector<float> const& values);
 	float y_for_linear (float, Metrics const &) const;
 	AudioPoint get_point (int channel, int point) const;
 	void left_down ();
@@ -86,9 +96,14 @@ private:
 	wxString _message;
 	float _gain_correction;
 
-	/** peak values keyed by channel */
+	/** smoothed peak values keyed by channel, made when they are first needed */
+	mutable std::map<int, Levels> _peak_levels;
+	/** smoothed RMS values keyed by channel, made when they are first needed */
+	mutable std::map<int, Levels> _rms_levels;
+
+	/** peak values that were last drawn, keyed by channel */
 	mutable std::map<int, PointList> _peak;
-	/** RMS values keyed by channel */
+	/** RMS values that were last drawn, keyed by channel */
 	mutable std::map<int, PointList> _rms;
 
 	boost::optional<Point> _cursor;
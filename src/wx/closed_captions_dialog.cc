@@ -21,7 +21,6 @@
 #include "closed_captions_dialog.h"
 #include "wx_util.h"
 #include "film_viewer.h"
-#include "lib/string_text.h"
 #include "lib/butler.h"
 #include "lib/text_content.h"
 #include "lib/compose.hpp"
@@ -33,6 +32,8 @@ using std::cout;
 using std::pair;
 using std::make_pair;
 using std::shared_ptr;
+using std::string;
+using std::vector;
 using std::weak_ptr;
 using boost::optional;
 #if BOOST_VERSION >= 106100
@@ -110,42 +111,16 @@ ClosedCaptionsDialog::paint ()
 	dc.SetFont (font);
 
 	for (int i = 0; i < MAX_CLOSED_CAPTION_LINES; ++i) {
-		wxString const good = _lines[i].Left (MAX_CLOSED_CAPTION_LENGTH);
-		dc.DrawText (good, 8, line_height * i);
-		if (_lines[i].Length() > MAX_CLOSED_CAPTION_LENGTH) {
-			wxString const bad = _lines[i].Right (_lines[i].Length() - MAX_CLOSED_CAPTION_LENGTH);
-			wxSize size = dc.GetTextExtent (good);
+		dc.DrawText (_lines[i].good, 8, line_height * i);
+		if (!_lines[i].bad.IsEmpty()) {
+			wxSize size = dc.GetTextExtent (_lines[i].good);
 			dc.SetTextForeground (*wxRED);
-			dc.DrawText (bad, 8 + size.GetWidth(), line_height * i);
+			dc.DrawText (_lines[i].bad, 8 + size.GetWidth(), line_height * i);
 			dc.SetTextForeground (*wxWHITE);
 		}
 	}
 }
 
-class ClosedCaptionSorter
-{
-public:
-	bool operator() (StringText const & a, StringText const & b)
-	{
-		return from_top(a) < from_top(b);
-	}
-
-private:
-	float from_top (StringText const & c) const
-	{
-		switch (c.v_align()) {
-		case dcp::VAlign::TOP:
-			return c.v_position();
-		case dcp::VAlign::CENTER:
-			return c.v_position() + 0.5;
-		case dcp::VAlign::BOTTOM:
-			return 1.0 - c.v_position();
-		}
-		DCPOMATIC_ASSERT (false);
-		return 0;
-	}
-};
-
 void
 ClosedCaptionsDialog::update ()
 {
@@ -158,10 +133,7 @@ ClosedCaptionsDialog::update ()
 
 	if (_current && _current->period.to < time) {
 		/* Current one has finished; clear out */
-		for (int j = 0; j < MAX_CLOSED_CAPTION_LINES; ++j) {
-			_lines[j] = "";
-		}
-		Refresh ();
+		set_lines ({});
 		_current = optional<TextRingBuffers::Data>();
 	}
 
@@ -177,7 +149,8 @@ ClosedCaptionsDialog::update ()
 				if (!d) {
 					break;
 				}
-				if (d->track == track) {
+				/* Skip other tracks, and anything that finished while we weren't looking */
+				if (d->track == track && d->period.to >= time) {
 					_current = d;
 					break;
 				}
@@ -189,32 +162,34 @@ ClosedCaptionsDialog::update ()
 
 	if (_current && _current->period.contains(time)) {
 		/* We need to set this new one up */
-
-		auto to_show = _current->text.string;
-
-		for (int j = 0; j < MAX_CLOSED_CAPTION_LINES; ++j) {
-			_lines[j] = "";
-		}
-
-		to_show.sort (ClosedCaptionSorter());
-
-		auto j = to_show.begin();
-		int k = 0;
-		while (j != to_show.end() && k < MAX_CLOSED_CAPTION_LINES) {
-			_lines[k] = std_to_wx (j->text());
-			++j;
-			++k;
-		}
-
-		Refresh ();
+		set_lines (_current->lines);
 		_current_in_lines = true;
 	}
 
 	if (!_current && _tracks.empty()) {
-		for (int i = 0; i < MAX_CLOSED_CAPTION_LINES; ++i) {
-			_lines[i] = wxString();
+		set_lines ({});
+	}
+}
+
+/** Set the lines that we show, from the top down, redrawing only if they are different to what we have */
+void
+ClosedCaptionsDialog::set_lines (vector<string> const& lines)
+{
+	vector<Line> new_lines (MAX_CLOSED_CAPTION_LINES);
+	for (size_t i = 0; i < std::min(lines.size(), new_lines.size()); ++i) {
+		auto const line = std_to_wx(lines[i]);
+		new_lines[i].good = line.Left(MAX_CLOSED_CAPTION_LENGTH);
+		if (line.Length() > MAX_CLOSED_CAPTION_LENGTH) {
+			new_lines[i].bad = line.Mid(MAX_CLOSED_CAPTION_LENGTH);
 		}
 	}
+
+	if (new_lines == _lines) {
+		return;
+	}
+
+	_lines = new_lines;
+	_display->Refresh ();
 }
 
 void
@@ -222,7 +197,7 @@ ClosedCaptionsDialog::clear ()
 {
 	_current = optional<TextRingBuffers::Data>();
 	_current_in_lines = false;
-	Refresh ();
+	_display->Refresh ();
 }
 
 
@@ -44,13 +44,28 @@ private:
 	void update ();
 	void paint ();
 	void track_selected ();
+	void set_lines (std::vector<std::string> const& lines);
 
 	FilmViewer* _viewer;
 	wxPanel* _display;
 	wxChoice* _track;
 	boost::optional<TextRingBuffers::Data> _current;
 	bool _current_in_lines;
-	std::vector<wxString> _lines;
+
+	struct Line
+	{
+		/** the part of the line which is within MAX_CLOSED_CAPTION_LENGTH */
+		wxString good;
+		/** the rest of the line, which is too long */
+		wxString bad;
+
+		bool operator== (Line const& other) const {
+			return good == other.good && bad == other.bad;
+		}
+	};
+
+	/** the lines that we are showing, from the top down */
+	std::vector<Line> _lines;
 	std::vector<DCPTextTrack> _tracks;
 	std::weak_ptr<Butler> _butler;
 	wxTimer _timer;
@@ -32,6 +32,7 @@
 #include "lib/config.h"
 #include "lib/content_factory.h"
 #include "lib/copy_dcp_details_to_film.h"
+#include "lib/crop_analysis.h"
 #include "lib/dcp_content.h"
 #include "lib/dcp_examiner.h"
 #include "lib/examine_content_job.h"
@@ -517,6 +518,102 @@ ContentMenu::cpl_selected (wxCommandEvent& ev)
 }
 
 
+/** Show a crop guess in the viewer */
+void
+ContentMenu::update_crop_guess (Crop crop)
+{
+	auto film = _film.lock();
+	DCPOMATIC_ASSERT (film);
+	auto const content = _content.front();
+	auto const current_crop = content->video->actual_crop();
+	_viewer.set_crop_guess(
+		dcpomatic::Rect<float>(
+			static_cast<float>(std::max(0, crop.left - current_crop.left)) / content->video->size().width,
+			static_cast<float>(std::max(0, crop.top - current_crop.top)) / content->video->size().height,
+			1.0f - (static_cast<float>(std::max(0, crop.left - current_crop.left + crop.right - current_crop.right)) / content->video->size().width),
+			1.0f - (static_cast<float>(std::max(0, crop.top - current_crop.top + crop.bottom - current_crop.bottom)) / content->video->size().height)
+			));
+}
+
+
+/** @return Crop guess from our analysis of the whole content, if we have one, otherwise
+ *  from the frame that the viewer is showing.
+ */
+Crop
+ContentMenu::guess_crop_for_content ()
+{
+	auto const threshold = Config::instance()->auto_crop_threshold();
+
+	if (_crop_analysis && _crop_analysis->frames() > 0) {
+		return _crop_analysis->crop(threshold);
+	}
+
+	auto film = _film.lock ();
+	DCPOMATIC_ASSERT (film);
+
+	auto position = _viewer.position_in_content(_content.front()).get_value_or(
+		ContentTime::from_frames(_content.front()->video->length(), _content.front()->video_frame_rate().get_value_or(24))
+		);
+	return guess_crop(film, _content.front(), threshold, position);
+}
+
+
+/** Read the crop analysis for our content if there is one, otherwise start a job to make it */
+void
+ContentMenu::load_crop_analysis ()
+{
+	auto film = _film.lock ();
+	DCPOMATIC_ASSERT (film);
+
+	_crop_analysis.reset ();
+
+	auto const path = film->crop_analysis_path(_content.front());
+
+	if (boost::filesystem::exists(path)) {
+		try {
+			_crop_analysis = make_shared<CropAnalysis>(path);
+			return;
+		} catch (OldFormatError &) {
+			/* An old analysis file: recreate it */
+		} catch (std::exception &) {
+			/* A bad analysis file: likewise */
+		}
+	}
+
+	JobManager::instance()->analyse_crop (film, _content.front(), _crop_analysis_connection, boost::bind(&ContentMenu::crop_analysis_finished, this));
+}
+
+
+void
+ContentMenu::crop_analysis_finished ()
+{
+	if (!_auto_crop_dialog || !_auto_crop_dialog->IsShown() || _content.size() != 1) {
+		return;
+	}
+
+	auto film = _film.lock ();
+	if (!film) {
+		return;
+	}
+
+	auto const path = film->crop_analysis_path(_content.front());
+	if (!boost::filesystem::exists(path)) {
+		/* Cancelled or failed; just keep using the viewer's frame */
+		return;
+	}
+
+	try {
+		_crop_analysis = make_shared<CropAnalysis>(path);
+	} catch (std::exception &) {
+		return;
+	}
+
+	auto const crop = guess_crop_for_content ();
+	_auto_crop_dialog->set (crop);
+	update_crop_guess (crop);
+}
+
+
 void
 ContentMenu::auto_crop ()
 {
@@ -525,31 +622,13 @@ ContentMenu::auto_crop ()
 	auto film = _film.lock ();
 	DCPOMATIC_ASSERT (film);
 
-	auto update_viewer = [this](Crop crop) {
-		auto film = _film.lock();
-		DCPOMATIC_ASSERT (film);
-		auto const content = _content.front();
-		auto const current_crop = content->video->actual_crop();
-		_viewer.set_crop_guess(
-			dcpomatic::Rect<float>(
-				static_cast<float>(std::max(0, crop.left - current_crop.left)) / content->video->size().width,
-				static_cast<float>(std::max(0, crop.top - current_crop.top)) / content->video->size().height,
-				1.0f - (static_cast<float>(std::max(0, crop.left - current_crop.left + crop.right - current_crop.right)) / content->video->size().width),
-				1.0f - (static_cast<float>(std::max(0, crop.top - current_crop.top + crop.bottom - current_crop.bottom)) / content->video->size().height)
-				));
-	};
-
-	auto guess_crop_for_content = [this, film]() {
-		auto position = _viewer.position_in_content(_content.front()).get_value_or(
-			ContentTime::from_frames(_content.front()->video->length(), _content.front()->video_frame_rate().get_value_or(24))
-			);
-		return guess_crop(film, _content.front(), Config::instance()->auto_crop_threshold(), position);
-	};
+	/* Find an analysis of frames from all through the content, or start making one */
+	load_crop_analysis ();
 
 	/* Make an initial guess in the view and open the dialog */
 
 	auto const crop = guess_crop_for_content ();
-	update_viewer (crop);
+	update_crop_guess (crop);
 
 	if (_auto_crop_dialog) {
 		_auto_crop_dialog->Destroy();
@@ -559,21 +638,24 @@ ContentMenu::auto_crop ()
 	_auto_crop_dialog->Show ();
 
 	/* Update the dialog and view when the crop threshold changes */
-	_auto_crop_config_connection = Config::instance()->Changed.connect([this, guess_crop_for_content, update_viewer](Config::Property property) {
-		auto film = _film.lock();
-		DCPOMATIC_ASSERT (film);
+	_auto_crop_config_connection = Config::instance()->Changed.connect([this](Config::Property property) {
 		if (property == Config::AUTO_CROP_THRESHOLD) {
 			auto const crop = guess_crop_for_content();
 			_auto_crop_dialog->set(crop);
-			update_viewer(crop);
+			update_crop_guess(crop);
 		}
 	});
 
-	/* Also update the dialog and view when we're looking at a different frame */
-	_auto_crop_viewer_connection = _viewer.ImageChanged.connect([this, guess_crop_for_content, update_viewer](shared_ptr<PlayerVideo>) {
+	/* Also update the dialog and view when we're looking at a different frame, unless we have
+	   an analysis of the whole content (which doesn't depend on the frame).
+	*/
+	_auto_crop_viewer_connection = _viewer.ImageChanged.connect([this](shared_ptr<PlayerVideo>) {
+		if (_crop_analysis) {
+			return;
+		}
 		auto const crop = guess_crop_for_content();
 		_auto_crop_dialog->set(crop);
-		update_viewer(crop);
+		update_crop_guess(crop);
 	});
 
 	/* Handle the user closing the dialog (with OK or cancel) */
@@ -588,7 +670,7 @@ ContentMenu::auto_crop ()
 	});
 
 	/* Update the view when something in the dialog is changed */
-	_auto_crop_dialog->Changed.connect([update_viewer](Crop crop) {
-		update_viewer (crop);
+	_auto_crop_dialog->Changed.connect([this](Crop crop) {
+		update_crop_guess (crop);
 	});
 }
@@ -33,6 +33,7 @@ LIBDCP_ENABLE_WARNINGS
 
 
 class AutoCropDialog;
+class CropAnalysis;
 class DCPContent;
 class Film;
 class FilmViewer;
@@ -57,6 +58,10 @@ private:
 	void advanced ();
 	void re_examine ();
 	void auto_crop ();
+	Crop guess_crop_for_content ();
+	void update_crop_guess (Crop crop);
+	void load_crop_analysis ();
+	void crop_analysis_finished ();
 	void kdm ();
 	void ov ();
 	void set_dcp_settings ();
@@ -88,6 +93,9 @@ private:
 	AutoCropDialog* _auto_crop_dialog = nullptr;
 	boost::signals2::scoped_connection _auto_crop_config_connection;
 	boost::signals2::scoped_connection _auto_crop_viewer_connection;
+	/** analysis of frames from all through the content being auto-cropped, or empty if it is not yet ready */
+	std::shared_ptr<CropAnalysis> _crop_analysis;
+	boost::signals2::scoped_connection _crop_analysis_connection;
 };
 
 
@@ -79,6 +79,7 @@ Controls::Controls(wxWindow* parent, FilmViewer& viewer, bool editor_controls)
 	, _frame_number (new StaticText(this, wxT("")))
 	, _timecode (new StaticText(this, wxT("")))
 	, _timer (this)
+	, _refine_timer (this)
 {
 	_v_sizer = new wxBoxSizer (wxVERTICAL);
 	SetSizer (_v_sizer);
@@ -157,7 +158,8 @@ Controls::Controls(wxWindow* parent, FilmViewer& viewer, bool editor_controls)
 	viewer.Started.connect (boost::bind(&Controls::started, this));
 	viewer.Stopped.connect (boost::bind(&Controls::stopped, this));
 
-	Bind (wxEVT_TIMER, boost::bind(&Controls::update_position, this));
+	Bind (wxEVT_TIMER, boost::bind(&Controls::update_position, this), _timer.GetId());
+	Bind (wxEVT_TIMER, boost::bind(&Controls::refine_scrub, this), _refine_timer.GetId());
 	_timer.Start (80, wxTIMER_CONTINUOUS);
 
 	set_film(viewer.film());
@@ -243,18 +245,45 @@ Controls::slider_moved (bool page)
 	}
 	_viewer.seek(t, accurate);
 	update_position_label ();
+
+	if (accurate) {
+		_scrub_position = boost::none;
+		_refine_timer.Stop ();
+	} else {
+		/* An inaccurate seek will show the keyframe before t; if the slider stays here for
+		 * a little while we will go to the exact frame.
+		 */
+		_scrub_position = t;
+		_refine_timer.Start (250, wxTIMER_ONE_SHOT);
+	}
 }
 
 
 void
 Controls::slider_released ()
 {
+	/* Make sure we are on the exact frame the slider was left at before we restart */
+	refine_scrub ();
+
 	/* Restart after a drag */
 	_viewer.resume();
 	_slider_being_moved = false;
 }
 
 
+/** Follow up an inaccurate seek made while dragging the slider with an accurate one */
+void
+Controls::refine_scrub ()
+{
+	_refine_timer.Stop ();
+
+	if (_scrub_position) {
+		_viewer.seek(*_scrub_position, true);
+		_scrub_position = boost::none;
+	}
+}
+
+
 void
 Controls::update_position_slider ()
 {
@@ -94,6 +94,7 @@ private:
 	void forward_clicked (wxKeyboardState &);
 	void slider_moved (bool page);
 	void slider_released ();
+	void refine_scrub ();
 	void frame_number_clicked ();
 	void jump_to_selected_clicked ();
 	void timecode_clicked ();
@@ -108,6 +109,10 @@ private:
 	typedef std::pair<std::shared_ptr<dcp::CPL>, boost::filesystem::path> CPL;
 
 	bool _slider_being_moved;
+	/** Position of the last inaccurate seek made while dragging the slider, if we have not
+	 *  yet followed it up with an accurate one.
+	 */
+	boost::optional<dcpomatic::DCPTime> _scrub_position;
 
 	CheckBox* _outline_content;
 	wxChoice* _eye;
@@ -121,6 +126,8 @@ private:
 	ClosedCaptionsDialog* _closed_captions_dialog;
 
 	wxTimer _timer;
+	/** Timer to refine an inaccurate seek once the slider has stopped moving */
+	wxTimer _refine_timer;
 
 	boost::signals2::scoped_connection _film_change_connection;
 	boost::signals2::scoped_connection _config_changed_connection;
@@ -446,6 +446,9 @@ DCPPanel::film_changed (Film::Property p)
 	case Film::Property::REENCODE_J2K:
 		checked_set (_reencode_j2k, _film->reencode_j2k());
 		break;
+	case Film::Property::TWO_PASS_ENCODING:
+		checked_set (_two_pass_encoding, _film->two_pass_encoding());
+		break;
 	case Film::Property::INTEROP:
 		checked_set (_standard, _film->interop() ? 1 : 0);
 		setup_dcp_name ();
@@ -629,6 +632,7 @@ DCPPanel::set_film (shared_ptr<Film> film)
 	film_changed (Film::Property::REEL_TYPE);
 	film_changed (Film::Property::REEL_LENGTH);
 	film_changed (Film::Property::REENCODE_J2K);
+	film_changed (Film::Property::TWO_PASS_ENCODING);
 	film_changed (Film::Property::AUDIO_LANGUAGE);
 	film_changed (Film::Property::AUDIO_FRAME_RATE);
 
@@ -684,6 +688,7 @@ DCPPanel::setup_sensitivity ()
 		);
 
 	_reencode_j2k->Enable           (_generally_sensitive && _film);
+	_two_pass_encoding->Enable      (_generally_sensitive && _film);
 	_show_audio->Enable             (_generally_sensitive && _film);
 }
 
@@ -739,6 +744,17 @@ DCPPanel::reencode_j2k_changed ()
 }
 
 
+void
+DCPPanel::two_pass_encoding_changed ()
+{
+	if (!_film) {
+		return;
+	}
+
+	_film->set_two_pass_encoding (_two_pass_encoding->GetValue());
+}
+
+
 void
 DCPPanel::config_changed (Config::Property p)
 {
@@ -797,6 +813,7 @@ DCPPanel::make_video_panel ()
 	_mbits_label = create_label (panel, _("Mbit/s"), false);
 
 	_reencode_j2k = new CheckBox (panel, _("Re-encode JPEG2000 data from input"));
+	_two_pass_encoding = new CheckBox (panel, _("Vary bit rate with picture complexity (slower)"));
 
 	_container->Bind	 (wxEVT_CHOICE,	  boost::bind(&DCPPanel::container_changed, this));
 	_frame_rate_choice->Bind (wxEVT_CHOICE,	  boost::bind(&DCPPanel::frame_rate_choice_changed, this));
@@ -808,6 +825,7 @@ DCPPanel::make_video_panel ()
 	_resolution->Bind        (wxEVT_CHOICE,   boost::bind(&DCPPanel::resolution_changed, this));
 	_three_d->bind(&DCPPanel::three_d_changed, this);
 	_reencode_j2k->bind(&DCPPanel::reencode_j2k_changed, this);
+	_two_pass_encoding->bind(&DCPPanel::two_pass_encoding_changed, this);
 
 	for (auto i: Ratio::containers()) {
 		_container->add(i->container_nickname());
@@ -867,6 +885,8 @@ DCPPanel::add_video_panel_to_grid ()
 	_video_grid->Add (s, wxGBPosition(r, 1), wxDefaultSpan);
 	++r;
 	_video_grid->Add (_reencode_j2k, wxGBPosition(r, 0), wxGBSpan(1, 2));
+	++r;
+	_video_grid->Add (_two_pass_encoding, wxGBPosition(r, 0), wxGBSpan(1, 2));
 }
 
 
@@ -86,6 +86,7 @@ private:
 	void markers_clicked ();
 	void metadata_clicked ();
 	void reencode_j2k_changed ();
+	void two_pass_encoding_changed ();
 	void enable_audio_language_toggled ();
 	void edit_audio_language_clicked ();
 	void audio_sample_rate_changed ();
@@ -145,6 +146,7 @@ private:
 	wxButton* _best_frame_rate;
 	CheckBox* _three_d;
 	CheckBox* _reencode_j2k;
+	CheckBox* _two_pass_encoding;
 	wxStaticText* _resolution_label;
 	Choice* _resolution;
 	wxStaticText* _standard_label;
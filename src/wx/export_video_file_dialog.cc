@@ -35,31 +35,39 @@ using std::string;
 using boost::bind;
 
 
-int constexpr FORMATS = 3;
+int constexpr FORMATS = 5;
 
 
 wxString format_names[] = {
 	_("MOV / ProRes 4444"),
 	_("MOV / ProRes HQ"),
 	_("MP4 / H.264"),
+	_("MP4 / H.264 (hardware)"),
+	_("MP4 / HEVC (hardware)"),
 };
 
 wxString format_filters[] = {
 	_("MOV files (*.mov)|*.mov"),
 	_("MOV files (*.mov)|*.mov"),
 	_("MP4 files (*.mp4)|*.mp4"),
+	_("MP4 files (*.mp4)|*.mp4"),
+	_("MP4 files (*.mp4)|*.mp4"),
 };
 
 wxString format_extensions[] = {
 	"mov",
 	"mov",
 	"mp4",
+	"mp4",
+	"mp4",
 };
 
 ExportFormat formats[] = {
 	ExportFormat::PRORES_4444,
 	ExportFormat::PRORES_HQ,
 	ExportFormat::H264_AAC,
+	ExportFormat::H264_HARDWARE_AAC,
+	ExportFormat::HEVC_HARDWARE_AAC,
 };
 
 ExportVideoFileDialog::ExportVideoFileDialog (wxWindow* parent, string name)
@@ -169,9 +177,12 @@ ExportVideoFileDialog::format_changed ()
 	DCPOMATIC_ASSERT (selection >= 0 && selection < FORMATS);
 	_file->SetWildcard (format_filters[selection]);
 	_file->SetPath (_initial_name);
-	_x264_crf->Enable (formats[selection] == ExportFormat::H264_AAC);
+	auto const quality = formats[selection] == ExportFormat::H264_AAC ||
+		formats[selection] == ExportFormat::H264_HARDWARE_AAC ||
+		formats[selection] == ExportFormat::HEVC_HARDWARE_AAC;
+	_x264_crf->Enable (quality);
 	for (int i = 0; i < 2; ++i) {
-		_x264_crf_label[i]->Enable(formats[selection] == ExportFormat::H264_AAC);
+		_x264_crf_label[i]->Enable(quality);
 	}
 
 	Config::instance()->export_config().set_format(formats[selection]);
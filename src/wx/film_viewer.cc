@@ -59,6 +59,7 @@ extern "C" {
 LIBDCP_DISABLE_WARNINGS
 #include <wx/tglbtn.h>
 LIBDCP_ENABLE_WARNINGS
+#include <algorithm>
 #include <iomanip>
 
 
@@ -66,6 +67,7 @@ using std::bad_alloc;
 using std::dynamic_pointer_cast;
 using std::make_shared;
 using std::max;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -77,6 +79,10 @@ using dcp::Size;
 using namespace dcpomatic;
 
 
+/** Maximum memory that we will use to keep recently-displayed frames, in bytes */
+static constexpr size_t frame_cache_size = 512 * 1024 * 1024;
+
+
 static
 int
 rtaudio_callback (void* out, void *, unsigned int frames, double, RtAudioStreamStatus, void* data)
@@ -87,6 +93,7 @@ rtaudio_callback (void* out, void *, unsigned int frames, double, RtAudioStreamS
 
 FilmViewer::FilmViewer (wxWindow* p)
 	: _audio (DCPOMATIC_RTAUDIO_API)
+	, _frame_cache (frame_cache_size)
 	, _closed_captions_dialog (new ClosedCaptionsDialog(p, this))
 {
 #if wxCHECK_VERSION(3, 1, 0)
@@ -104,6 +111,7 @@ FilmViewer::FilmViewer (wxWindow* p)
 
 	_video_view->Sized.connect (boost::bind(&FilmViewer::video_view_sized, this));
 	_video_view->TooManyDropped.connect (boost::bind(boost::ref(TooManyDropped)));
+	_video_view->Overloaded.connect (boost::bind(&FilmViewer::video_view_overloaded, this, _1));
 
 	set_film (shared_ptr<Film>());
 
@@ -114,10 +122,89 @@ FilmViewer::FilmViewer (wxWindow* p)
 
 FilmViewer::~FilmViewer ()
 {
+	follow (nullptr);
+
+	for (auto i: _followers) {
+		i->_leader = nullptr;
+		i->_leader_connections.clear ();
+	}
+
 	stop ();
 }
 
 
+/** Make this viewer follow another, so that it plays in sync with it.  While following,
+ *  this viewer has no audio of its own, uses the leader's audio clock and starts, stops
+ *  and seeks when the leader does.  The two viewers share the leader's budget of
+ *  threads for preparing video.
+ *  @param leader Viewer to follow, or nullptr to stop following.
+ */
+void
+FilmViewer::follow (FilmViewer* leader)
+{
+	if (leader == _leader) {
+		return;
+	}
+
+	stop ();
+
+	auto old_leader = _leader;
+	if (old_leader) {
+		auto& followers = old_leader->_followers;
+		followers.erase (std::remove(followers.begin(), followers.end(), this), followers.end());
+	}
+
+	_leader_connections.clear ();
+	_leader = leader;
+
+	if (_leader) {
+		_leader->_followers.push_back (this);
+		_leader_connections.push_back (_leader->Started.connect(boost::bind(&FilmViewer::start, this)));
+		_leader_connections.push_back (_leader->Stopped.connect(boost::bind(&FilmViewer::stop, this)));
+		_leader_connections.push_back (
+			_leader->Seeked.connect(boost::bind(static_cast<void (FilmViewer::*)(DCPTime, bool)>(&FilmViewer::seek), this, _1, _2))
+			);
+		seek (_leader->position(), true);
+	}
+
+	/* Open or close our audio stream as required; this also re-makes our butler */
+	config_changed (Config::SOUND_OUTPUT);
+
+	/* Everybody's share of the prepare threads has changed */
+	for (auto viewer: { old_leader, _leader }) {
+		if (viewer) {
+			viewer->destroy_and_maybe_create_butler ();
+			for (auto i: viewer->_followers) {
+				if (i != this) {
+					i->destroy_and_maybe_create_butler ();
+				}
+			}
+		}
+	}
+}
+
+
+/** @return number of threads our butler should use to prepare video */
+int
+FilmViewer::prepare_threads () const
+{
+	auto const leader = _leader ? _leader : this;
+	return std::max(1, static_cast<int>(boost::thread::hardware_concurrency() * 2 / (leader->_followers.size() + 1)));
+}
+
+
+/** @return Number of threads that our butler should use to scale each frame.  Frames are often
+ *  big and few are prepared at once when we are playing, so it is worth sharing the scaling
+ *  of each one between a few threads to keep latency down.
+ */
+int
+FilmViewer::scale_threads () const
+{
+	auto const leader = _leader ? _leader : this;
+	return std::max(1, static_cast<int>(Config::instance()->master_encoding_threads() / (leader->_followers.size() + 1)));
+}
+
+
 /** Ask for ::idle_handler() to be called next time we are idle */
 void
 FilmViewer::request_idle_display_next_frame ()
@@ -157,6 +244,7 @@ FilmViewer::set_film (shared_ptr<Film> film)
 
 	_film = film;
 
+	_frame_cache.clear ();
 	_video_view->clear ();
 	_closed_captions_dialog->clear ();
 
@@ -170,11 +258,12 @@ FilmViewer::set_film (shared_ptr<Film> film)
 	}
 
 	try {
-		_player.emplace(_film, _optimise_for_j2k ? Image::Alignment::COMPACT : Image::Alignment::PADDED);
+		_player.emplace(_film, (_optimise_for_j2k || gl_video_view()) ? Image::Alignment::COMPACT : Image::Alignment::PADDED);
 		_player->set_fast ();
-		if (_dcp_decode_reduction) {
-			_player->set_dcp_decode_reduction (_dcp_decode_reduction);
-		}
+		_automatic_decode_reduction = 0;
+		_unloaded_periods = 0;
+		_just_decreased_automatic_decode_reduction = false;
+		update_decode_reduction ();
 	} catch (bad_alloc &) {
 		error_dialog (_video_view->get(), _("There is not enough free memory to do that."));
 		_film.reset ();
@@ -193,8 +282,13 @@ FilmViewer::set_film (shared_ptr<Film> film)
 	film_change (ChangeType::DONE, Film::Property::THREE_D);
 	film_length_change ();
 
-	/* Keep about 1 second's worth of history samples */
-	_latency_history_count = _film->audio_frame_rate() / _audio_block_size;
+	{
+		/* Keep about 1 second's worth of history samples */
+		boost::mutex::scoped_lock lm (_latency_history_mutex);
+		_latency_history.assign (std::max(1, _film->audio_frame_rate() / _audio_block_size), 0);
+		_latency_history_size = 0;
+		_latency_history_next = 0;
+	}
 
 	_closed_captions_dialog->update_tracks (_film);
 
@@ -227,14 +321,24 @@ FilmViewer::destroy_and_maybe_create_butler()
 }
 
 
-void
-FilmViewer::create_butler()
+/** @return true if we are using a GLVideoView, which crops, scales and converts the images
+ *  from our ImageProxys itself rather than having the butler do it.
+ */
+bool
+FilmViewer::gl_video_view() const
 {
 #if wxCHECK_VERSION(3, 1, 0)
-	auto const j2k_gl_optimised = dynamic_pointer_cast<GLVideoView>(_video_view) && _optimise_for_j2k;
+	return static_cast<bool>(dynamic_pointer_cast<GLVideoView>(_video_view));
 #else
-	auto const j2k_gl_optimised = false;
+	return false;
 #endif
+}
+
+
+void
+FilmViewer::create_butler()
+{
+	auto const gl = gl_video_view();
 
 	DCPOMATIC_ASSERT(_player);
 
@@ -245,10 +349,12 @@ FilmViewer::create_butler()
 		_audio_channels,
 		boost::bind(&PlayerVideo::force, AV_PIX_FMT_RGB24),
 		VideoRange::FULL,
-		j2k_gl_optimised ? Image::Alignment::COMPACT : Image::Alignment::PADDED,
+		gl ? Image::Alignment::COMPACT : Image::Alignment::PADDED,
 		true,
-		j2k_gl_optimised,
-		(Config::instance()->sound() && _audio.isStreamOpen()) ? Butler::Audio::ENABLED : Butler::Audio::DISABLED
+		gl,
+		(Config::instance()->sound() && _audio.isStreamOpen()) ? Butler::Audio::ENABLED : Butler::Audio::DISABLED,
+		prepare_threads(),
+		scale_threads()
 		);
 
 	_closed_captions_dialog->set_butler (_butler);
@@ -277,6 +383,7 @@ void
 FilmViewer::set_eyes (Eyes e)
 {
 	_video_view->set_eyes (e);
+	_frame_cache.clear ();
 	slow_refresh ();
 }
 
@@ -435,7 +542,14 @@ FilmViewer::stop ()
 void
 FilmViewer::player_change (ChangeType type, int property, bool frequent)
 {
-	if (type != ChangeType::DONE || frequent) {
+	if (type != ChangeType::DONE) {
+		return;
+	}
+
+	/* Whatever has changed may make our cached frames look different */
+	_frame_cache.clear ();
+
+	if (frequent) {
 		return;
 	}
 
@@ -571,9 +685,25 @@ FilmViewer::seek (DCPTime t, bool accurate)
 		t = _film->length() - one_video_frame();
 	}
 
+	Seeked (t, accurate);
+
 	suspend ();
 
 	_closed_captions_dialog->clear ();
+
+	if (!_playing) {
+		if (auto cached = _frame_cache.get(t, one_video_frame())) {
+			/* We have just been showing this frame, so show it again straight away and
+			 * set the butler up to give us the one after.
+			 */
+			_butler->seek (cached->second + one_video_frame(), true);
+			_video_view->set_player_video (*cached);
+			_video_view->update ();
+			resume ();
+			return;
+		}
+	}
+
 	_butler->seek (t, accurate);
 
 	if (!_playing) {
@@ -608,7 +738,7 @@ FilmViewer::config_changed (Config::Property p)
 		_audio.closeStream ();
 	}
 
-	if (Config::instance()->sound() && _audio.getDeviceCount() > 0) {
+	if (!_leader && Config::instance()->sound() && _audio.getDeviceCount() > 0) {
 		unsigned int st = 0;
 		if (Config::instance()->sound_output()) {
 			while (st < _audio.getDeviceCount()) {
@@ -665,6 +795,10 @@ FilmViewer::uncorrected_time () const
 optional<DCPTime>
 FilmViewer::audio_time () const
 {
+	if (_leader) {
+		return _leader->audio_time();
+	}
+
 	if (!_audio.isStreamRunning()) {
 		return {};
 	}
@@ -693,13 +827,13 @@ FilmViewer::audio_callback (void* out_p, unsigned int frames)
 		/* The audio we just got was (very) late; drop it and get some more. */
 	}
 
-        boost::mutex::scoped_lock lm (_latency_history_mutex, boost::try_to_lock);
-        if (lm) {
-                _latency_history.push_back (_audio.getStreamLatency ());
-                if (_latency_history.size() > static_cast<size_t> (_latency_history_count)) {
-                        _latency_history.pop_front ();
-                }
-        }
+	/* This must not block or allocate */
+	boost::mutex::scoped_lock lm (_latency_history_mutex, boost::try_to_lock);
+	if (lm && !_latency_history.empty()) {
+		_latency_history[_latency_history_next] = _audio.getStreamLatency ();
+		_latency_history_next = (_latency_history_next + 1) % _latency_history.size();
+		_latency_history_size = std::min(_latency_history_size + 1, static_cast<int>(_latency_history.size()));
+	}
 
 	return 0;
 }
@@ -708,17 +842,17 @@ FilmViewer::audio_callback (void* out_p, unsigned int frames)
 Frame
 FilmViewer::average_latency () const
 {
-        boost::mutex::scoped_lock lm (_latency_history_mutex);
-        if (_latency_history.empty()) {
-                return 0;
-        }
+	boost::mutex::scoped_lock lm (_latency_history_mutex);
+	if (_latency_history_size == 0) {
+		return 0;
+	}
 
-        Frame total = 0;
-        for (auto i: _latency_history) {
-                total += i;
-        }
+	Frame total = 0;
+	for (int i = 0; i < _latency_history_size; ++i) {
+		total += _latency_history[i];
+	}
 
-        return total / _latency_history.size();
+	return total / _latency_history_size;
 }
 
 
@@ -726,8 +860,60 @@ void
 FilmViewer::set_dcp_decode_reduction (optional<int> reduction)
 {
 	_dcp_decode_reduction = reduction;
-	if (_player) {
-		_player->set_dcp_decode_reduction (reduction);
+	update_decode_reduction ();
+}
+
+
+void
+FilmViewer::update_decode_reduction ()
+{
+	if (!_player) {
+		return;
+	}
+
+	auto reduction = _dcp_decode_reduction;
+	if (_automatic_decode_reduction > reduction.get_value_or(0)) {
+		reduction = _automatic_decode_reduction;
+	}
+
+	_player->set_dcp_decode_reduction (reduction);
+}
+
+
+/** Called when our VideoView tells us how well it is keeping up with playback; we use this
+ *  to decode at lower resolution when it is struggling, and go back to higher resolution
+ *  when it has been fine for a while.
+ */
+void
+FilmViewer::video_view_overloaded (bool overloaded)
+{
+	if (!_playing || !_player) {
+		return;
+	}
+
+	int const maximum_automatic_decode_reduction = 2;
+
+	if (overloaded) {
+		_unloaded_periods = 0;
+		if (_just_decreased_automatic_decode_reduction) {
+			/* That didn't work, so wait longer before trying again */
+			_unloaded_periods_needed = std::min(_unloaded_periods_needed * 2, 64);
+			_just_decreased_automatic_decode_reduction = false;
+		}
+		if (_automatic_decode_reduction < maximum_automatic_decode_reduction) {
+			++_automatic_decode_reduction;
+			LOG_GENERAL("Playback is dropping frames; decode reduction is now %1", _automatic_decode_reduction);
+			update_decode_reduction ();
+		}
+	} else {
+		_just_decreased_automatic_decode_reduction = false;
+		if (_automatic_decode_reduction > 0 && ++_unloaded_periods >= _unloaded_periods_needed) {
+			--_automatic_decode_reduction;
+			_unloaded_periods = 0;
+			_just_decreased_automatic_decode_reduction = true;
+			LOG_GENERAL("Playback is keeping up; decode reduction is now %1", _automatic_decode_reduction);
+			update_decode_reduction ();
+		}
 	}
 }
 
@@ -823,6 +1009,14 @@ FilmViewer::image_changed (shared_ptr<PlayerVideo> pv)
 }
 
 
+/** Called by our VideoView when it gets a frame to display; may be called from any thread */
+void
+FilmViewer::frame_displayed (pair<shared_ptr<PlayerVideo>, DCPTime> video)
+{
+	_frame_cache.put (video.first, video.second);
+}
+
+
 void
 FilmViewer::set_optimise_for_j2k (bool o)
 {
@@ -28,6 +28,7 @@
 #include "lib/config.h"
 #include "lib/film.h"
 #include "lib/player_text.h"
+#include "lib/player_video_cache.h"
 #include "lib/signaller.h"
 #include "lib/timer.h"
 #include <dcp/warnings.h>
@@ -92,6 +93,8 @@ public:
 		return _playing;
 	}
 
+	void follow (FilmViewer* leader);
+
 	void set_coalesce_player_changes (bool c);
 	void set_dcp_decode_reduction (boost::optional<int> reduction);
 	boost::optional<int> dcp_decode_reduction () const;
@@ -136,6 +139,7 @@ public:
 	}
 	void finished ();
 	void image_changed (std::shared_ptr<PlayerVideo> video);
+	void frame_displayed (std::pair<std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime> video);
 	boost::optional<dcpomatic::Rect<float>> crop_guess () const {
 		return _crop_guess;
 	}
@@ -147,6 +151,8 @@ public:
 	boost::signals2::signal<void (std::shared_ptr<PlayerVideo>)> ImageChanged;
 	boost::signals2::signal<void ()> Started;
 	boost::signals2::signal<void ()> Stopped;
+	/** Emitted from the GUI thread when seek() has been called */
+	boost::signals2::signal<void (dcpomatic::DCPTime, bool)> Seeked;
 	/** While playing back we reached the end of the film (emitted from GUI thread) */
 	boost::signals2::signal<void ()> Finished;
 	/** Emitted from the GUI thread when a lot of frames are being dropped */
@@ -165,11 +171,16 @@ private:
 	void film_change (ChangeType, Film::Property);
 	void destroy_butler();
 	void create_butler();
+	bool gl_video_view() const;
 	void destroy_and_maybe_create_butler();
 	void config_changed (Config::Property);
 	void film_length_change ();
 	void ui_finished ();
 	void start_audio_stream_if_open ();
+	void video_view_overloaded (bool overloaded);
+	int prepare_threads () const;
+	int scale_threads () const;
+	void update_decode_reduction ();
 
 	dcpomatic::DCPTime uncorrected_time () const;
 	Frame average_latency () const;
@@ -189,13 +200,33 @@ private:
 	bool _playing = false;
 	int _suspended = 0;
 	std::shared_ptr<Butler> _butler;
-
-	std::list<Frame> _latency_history;
-	/** Mutex to protect _latency_history */
+	/** Frames that we have recently displayed, so that we can go back to them
+	 *  without waiting for the butler to decode them again.
+	 */
+	PlayerVideoCache _frame_cache;
+
+	/** Recent audio latencies, used as a ring so that the audio callback need not allocate */
+	std::vector<Frame> _latency_history;
+	/** Number of entries at the start of _latency_history which have been filled in */
+	int _latency_history_size = 0;
+	/** Index into _latency_history of the next entry to write */
+	int _latency_history_next = 0;
+	/** Mutex to protect _latency_history, _latency_history_size and _latency_history_next */
 	mutable boost::mutex _latency_history_mutex;
-	int _latency_history_count = 0;
 
 	boost::optional<int> _dcp_decode_reduction;
+	/** decode reduction that we have chosen ourselves because playback could not keep up;
+	 *  the player uses this or _dcp_decode_reduction, whichever is the greater.
+	 */
+	int _automatic_decode_reduction = 0;
+	/** number of consecutive periods of playback without dropped frames since we last changed
+	 *  _automatic_decode_reduction
+	 */
+	int _unloaded_periods = 0;
+	/** number of such periods we need to see before we try decreasing _automatic_decode_reduction */
+	int _unloaded_periods_needed = 4;
+	/** true if we decreased _automatic_decode_reduction at the end of the last period */
+	bool _just_decreased_automatic_decode_reduction = false;
 
 	/** true to assume that this viewer is only being used for JPEG2000 sources
 	 *  so it can optimise accordingly.
@@ -216,5 +247,11 @@ private:
 
 	boost::optional<dcpomatic::Rect<float>> _crop_guess;
 
+	/** Viewer whose clock, audio and transport we are following, or nullptr */
+	FilmViewer* _leader = nullptr;
+	/** Viewers which are following us */
+	std::vector<FilmViewer*> _followers;
+	std::vector<boost::signals2::scoped_connection> _leader_connections;
+
 	boost::signals2::scoped_connection _config_changed_connection;
 };
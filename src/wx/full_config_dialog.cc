@@ -110,6 +110,11 @@ private:
 		table->Add (_server_encoding_threads, wxGBPosition (r, 1));
 		++r;
 
+		add_label_to_sizer (table, _panel, _("Number of threads DCP-o-matic should use for decoding video"), true, wxGBPosition (r, 0));
+		_decoding_threads = new wxSpinCtrl (_panel);
+		table->Add (_decoding_threads, wxGBPosition (r, 1));
+		++r;
+
 		add_label_to_sizer (table, _panel, _("Configuration file"), true, wxGBPosition (r, 0));
 		_config_file = new FilePickerCtrl (_panel, _("Select configuration file"), "*.xml", true, false);
 		table->Add (_config_file, wxGBPosition (r, 1));
@@ -132,6 +137,10 @@ private:
 		table->Add (_automatic_audio_analysis, wxGBPosition (r, 0), wxGBSpan (1, 2));
 		++r;
 
+		_quick_examination = new CheckBox (_panel, _("Examine content quickly, then thoroughly in the background"));
+		table->Add (_quick_examination, wxGBPosition (r, 0), wxGBSpan (1, 2));
+		++r;
+
 		add_update_controls (table, r);
 
 		_config_file->Bind  (wxEVT_FILEPICKER_CHANGED, boost::bind(&FullGeneralPage::config_file_changed,  this));
@@ -141,12 +150,15 @@ private:
 		_master_encoding_threads->Bind (wxEVT_SPINCTRL, boost::bind (&FullGeneralPage::master_encoding_threads_changed, this));
 		_server_encoding_threads->SetRange (1, 128);
 		_server_encoding_threads->Bind (wxEVT_SPINCTRL, boost::bind (&FullGeneralPage::server_encoding_threads_changed, this));
+		_decoding_threads->SetRange (1, 128);
+		_decoding_threads->Bind (wxEVT_SPINCTRL, boost::bind (&FullGeneralPage::decoding_threads_changed, this));
 		export_cinemas->Bind (wxEVT_BUTTON, boost::bind (&FullGeneralPage::export_cinemas_file, this));
 
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 		_analyse_ebur128->bind(&FullGeneralPage::analyse_ebur128_changed, this);
 #endif
 		_automatic_audio_analysis->bind(&FullGeneralPage::automatic_audio_analysis_changed, this);
+		_quick_examination->bind(&FullGeneralPage::quick_examination_changed, this);
 	}
 
 	void config_changed () override
@@ -155,10 +167,12 @@ private:
 
 		checked_set (_master_encoding_threads, config->master_encoding_threads ());
 		checked_set (_server_encoding_threads, config->server_encoding_threads ());
+		checked_set (_decoding_threads, config->decoding_threads ());
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 		checked_set (_analyse_ebur128, config->analyse_ebur128 ());
 #endif
 		checked_set (_automatic_audio_analysis, config->automatic_audio_analysis ());
+		checked_set (_quick_examination, config->quick_examination());
 		checked_set (_config_file, config->config_read_file());
 		checked_set (_cinemas_file, config->cinemas_file());
 
@@ -190,6 +204,11 @@ private:
 		Config::instance()->set_automatic_audio_analysis (_automatic_audio_analysis->GetValue());
 	}
 
+	void quick_examination_changed ()
+	{
+		Config::instance()->set_quick_examination(_quick_examination->GetValue());
+	}
+
 	void master_encoding_threads_changed ()
 	{
 		Config::instance()->set_master_encoding_threads (_master_encoding_threads->GetValue());
@@ -200,6 +219,11 @@ private:
 		Config::instance()->set_server_encoding_threads (_server_encoding_threads->GetValue());
 	}
 
+	void decoding_threads_changed ()
+	{
+		Config::instance()->set_decoding_threads (_decoding_threads->GetValue());
+	}
+
 	void config_file_changed ()
 	{
 		auto config = Config::instance();
@@ -233,12 +257,14 @@ private:
 
 	wxSpinCtrl* _master_encoding_threads;
 	wxSpinCtrl* _server_encoding_threads;
+	wxSpinCtrl* _decoding_threads;
 	FilePickerCtrl* _config_file;
 	FilePickerCtrl* _cinemas_file;
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 	CheckBox* _analyse_ebur128;
 #endif
 	CheckBox* _automatic_audio_analysis;
+	CheckBox* _quick_examination;
 };
 
 
@@ -1522,6 +1548,10 @@ private:
 		table->Add (_only_servers_encode, 1, wxEXPAND | wxLEFT, DCPOMATIC_SIZER_GAP);
 		table->AddSpacer (0);
 
+		_verify_after_make_dcp = new CheckBox (_panel, _("Check DCPs after making them"));
+		table->Add (_verify_after_make_dcp, 1, wxEXPAND | wxLEFT, DCPOMATIC_SIZER_GAP);
+		table->AddSpacer (0);
+
 		{
 			add_label_to_sizer (table, _panel, _("Maximum number of frames to store per thread"), true, 0, wxLEFT | wxRIGHT | wxALIGN_CENTRE_VERTICAL);
 			auto s = new wxBoxSizer (wxHORIZONTAL);
@@ -1620,6 +1650,7 @@ private:
 		_use_all_audio_channels->bind(&AdvancedPage::use_all_channels_changed, this);
 		_show_experimental_audio_processors->bind(&AdvancedPage::show_experimental_audio_processors_changed, this);
 		_only_servers_encode->bind(&AdvancedPage::only_servers_encode_changed, this);
+		_verify_after_make_dcp->bind(&AdvancedPage::verify_after_make_dcp_changed, this);
 		_frames_in_memory_multiplier->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::frames_in_memory_multiplier_changed, this));
 		_dcp_metadata_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_metadata_filename_format_changed, this));
 		_dcp_asset_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_asset_filename_format_changed, this));
@@ -1657,6 +1688,7 @@ private:
 		checked_set (_use_all_audio_channels, config->use_all_audio_channels());
 		checked_set (_show_experimental_audio_processors, config->show_experimental_audio_processors ());
 		checked_set (_only_servers_encode, config->only_servers_encode ());
+		checked_set (_verify_after_make_dcp, config->verify_after_make_dcp());
 		checked_set (_log_general, config->log_types() & LogEntry::TYPE_GENERAL);
 		checked_set (_log_warning, config->log_types() & LogEntry::TYPE_WARNING);
 		checked_set (_log_error, config->log_types() & LogEntry::TYPE_ERROR);
@@ -1722,6 +1754,11 @@ private:
 		Config::instance()->set_only_servers_encode (_only_servers_encode->GetValue());
 	}
 
+	void verify_after_make_dcp_changed ()
+	{
+		Config::instance()->set_verify_after_make_dcp(_verify_after_make_dcp->GetValue());
+	}
+
 	void dcp_metadata_filename_format_changed ()
 	{
 		Config::instance()->set_dcp_metadata_filename_format(_dcp_metadata_filename_format->get());
@@ -1784,6 +1821,7 @@ private:
 	CheckBox* _use_all_audio_channels = nullptr;
 	CheckBox* _show_experimental_audio_processors = nullptr;
 	CheckBox* _only_servers_encode = nullptr;
+	CheckBox* _verify_after_make_dcp = nullptr;
 	NameFormatEditor* _dcp_metadata_filename_format = nullptr;
 	NameFormatEditor* _dcp_asset_filename_format = nullptr;
 	CheckBox* _log_general = nullptr;
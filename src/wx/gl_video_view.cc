@@ -38,6 +38,8 @@
 #include "lib/image.h"
 #include "lib/player_video.h"
 #include <boost/bind/bind.hpp>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 #ifdef DCPOMATIC_OSX
@@ -76,10 +78,42 @@ check_gl_error (char const * last)
 }
 
 
+/** @return Bit depth of the samples in format, if it is a planar YUV format whose planes
+ *  we can upload as they are and then convert to RGB in the shader.
+ */
+static
+optional<int>
+planar_yuv_bits (AVPixelFormat format)
+{
+	switch (format) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return 8;
+	case AV_PIX_FMT_YUV420P10LE:
+	case AV_PIX_FMT_YUV422P10LE:
+	case AV_PIX_FMT_YUV444P10LE:
+		return 10;
+	case AV_PIX_FMT_YUV420P12LE:
+	case AV_PIX_FMT_YUV422P12LE:
+	case AV_PIX_FMT_YUV444P12LE:
+		return 12;
+	case AV_PIX_FMT_YUV420P16LE:
+	case AV_PIX_FMT_YUV422P16LE:
+	case AV_PIX_FMT_YUV444P16LE:
+		return 16;
+	default:
+		return {};
+	}
+}
+
+
 GLVideoView::GLVideoView (FilmViewer* viewer, wxWindow *parent)
 	: VideoView (viewer)
 	, _context (nullptr)
-	, _rec2020(false)
 	, _vsync_enabled (false)
 	, _playing (false)
 	, _one_shot (false)
@@ -194,12 +228,18 @@ static constexpr char fragment_source[] =
 "\n"
 "in vec2 TexCoord;\n"
 "\n"
+/* Whole image, or the Y plane of a YUV image */
 "uniform sampler2D texture_sampler;\n"
+/* Cb and Cr planes of a YUV image */
+"uniform sampler2D texture_sampler_cb;\n"
+"uniform sampler2D texture_sampler_cr;\n"
 /* type = 0: draw outline content rectangle
  * type = 1: draw crop guess rectangle
  * type = 2: draw XYZ image
  * type = 3: draw RGB image (with sRGB/Rec709 primaries)
  * type = 4: draw RGB image (converting from Rec2020 primaries)
+ * type = 5: draw YUV image (with sRGB/Rec709 primaries)
+ * type = 6: draw YUV image (converting from Rec2020 primaries)
  * See FragmentType enum below.
  */
 "uniform int type = 0;\n"
@@ -207,6 +247,14 @@ static constexpr char fragment_source[] =
 "uniform vec4 crop_guess_colour;\n"
 "uniform mat4 xyz_rec709_colour_conversion;\n"
 "uniform mat4 rec2020_rec709_colour_conversion;\n"
+/* YUV samples are multiplied by yuv_multiply and then have yuv_subtract taken away to give
+ * Y in [0, 1] and Cb/Cr in [-0.5, 0.5], before yuv_to_rgb makes them into RGB.
+ */
+"uniform mat3 yuv_to_rgb;\n"
+"uniform vec3 yuv_multiply;\n"
+"uniform vec3 yuv_subtract;\n"
+/* Amount to fade images by, from 0 (black) to 1 (no fade) */
+"uniform float fade = 1.0;\n"
 "\n"
 "out vec4 FragColor;\n"
 "\n"
@@ -260,6 +308,16 @@ static constexpr char fragment_source[] =
 "	   , sy);\n"
 "}\n"
 "\n"
+"vec4 yuv_bicubic(vec2 tex_coords)\n"
+"{\n"
+"	vec3 yuv = vec3(\n"
+"		texture_bicubic(texture_sampler, tex_coords).r,\n"
+"		texture_bicubic(texture_sampler_cb, tex_coords).r,\n"
+"		texture_bicubic(texture_sampler_cr, tex_coords).r\n"
+"		);\n"
+"	return vec4(clamp(yuv_to_rgb * (yuv * yuv_multiply - yuv_subtract), 0.0, 1.0), 1.0);\n"
+"}\n"
+"\n"
 "void main()\n"
 "{\n"
 "	switch (type) {\n"
@@ -286,6 +344,16 @@ static constexpr char fragment_source[] =
 "			FragColor = texture_bicubic(texture_sampler, TexCoord);\n"
 "			FragColor = rec2020_rec709_colour_conversion * FragColor;\n"
 "			break;\n"
+"		case 5:\n"
+"			FragColor = yuv_bicubic(TexCoord);\n"
+"			break;\n"
+"		case 6:\n"
+"			FragColor = yuv_bicubic(TexCoord);\n"
+"			FragColor = rec2020_rec709_colour_conversion * FragColor;\n"
+"			break;\n"
+"	}\n"
+"	if (type >= 2) {\n"
+"		FragColor.rgb *= fade;\n"
 "	}\n"
 "}\n";
 
@@ -297,6 +365,8 @@ enum class FragmentType
 	XYZ_IMAGE = 2,
 	REC709_IMAGE = 3,
 	REC2020_IMAGE = 4,
+	REC709_YUV_IMAGE = 5,
+	REC2020_YUV_IMAGE = 6,
 };
 
 
@@ -458,6 +528,20 @@ GLVideoView::setup_shaders ()
 
 	_fragment_type = glGetUniformLocation (program, "type");
 	check_gl_error ("glGetUniformLocation");
+	_yuv_to_rgb = glGetUniformLocation (program, "yuv_to_rgb");
+	check_gl_error ("glGetUniformLocation");
+	_yuv_multiply = glGetUniformLocation (program, "yuv_multiply");
+	check_gl_error ("glGetUniformLocation");
+	_yuv_subtract = glGetUniformLocation (program, "yuv_subtract");
+	check_gl_error ("glGetUniformLocation");
+	_fade = glGetUniformLocation (program, "fade");
+	check_gl_error ("glGetUniformLocation");
+
+	/* The Cb and Cr planes of YUV images are bound to texture units 1 and 2 */
+	glUniform1i (glGetUniformLocation(program, "texture_sampler_cb"), 1);
+	glUniform1i (glGetUniformLocation(program, "texture_sampler_cr"), 2);
+	check_gl_error ("glUniform1i");
+
 	set_outline_content_colour (program);
 	set_crop_guess_colour (program);
 
@@ -539,6 +623,56 @@ GLVideoView::set_crop_guess_colour (GLuint program)
 }
 
 
+/** Set up the shader to convert YUV images to full-range RGB.
+ *  @param bits Bit depth of the samples in the image.
+ */
+void
+GLVideoView::set_yuv_conversion (dcp::YUVToRGB yuv_to_rgb, VideoRange range, int bits)
+{
+	/* Luma coefficients for red and blue */
+	float kr = 0.299f;
+	float kb = 0.114f;
+	switch (yuv_to_rgb) {
+	case dcp::YUVToRGB::REC709:
+		kr = 0.2126f;
+		kb = 0.0722f;
+		break;
+	case dcp::YUVToRGB::REC2020:
+		kr = 0.2627f;
+		kb = 0.0593f;
+		break;
+	default:
+		break;
+	}
+	float const kg = 1 - kr - kb;
+
+	GLfloat const matrix[9] = {
+		1, 0,                          2 * (1 - kr),
+		1, -2 * kb * (1 - kb) / kg,    -2 * kr * (1 - kr) / kg,
+		1, 2 * (1 - kb),               0
+	};
+	glUniformMatrix3fv (_yuv_to_rgb, 1, GL_TRUE, matrix);
+	check_gl_error ("glUniformMatrix3fv");
+
+	/* 8-bit samples are in 8-bit textures, and everything else in 16-bit ones */
+	float const texture_max = bits > 8 ? 65535 : 255;
+	float const scale = std::pow(2, bits - 8);
+	float const chroma_offset = 128 * scale;
+	float luma_offset = 0;
+	float luma_range = std::pow(2, bits) - 1;
+	float chroma_range = luma_range;
+	if (range == VideoRange::VIDEO) {
+		luma_offset = 16 * scale;
+		luma_range = 219 * scale;
+		chroma_range = 224 * scale;
+	}
+
+	glUniform3f (_yuv_multiply, texture_max / luma_range, texture_max / chroma_range, texture_max / chroma_range);
+	glUniform3f (_yuv_subtract, luma_offset / luma_range, chroma_offset / chroma_range, chroma_offset / chroma_range);
+	check_gl_error ("glUniform3f");
+}
+
+
 void
 GLVideoView::draw ()
 {
@@ -560,14 +694,12 @@ GLVideoView::draw ()
 
 	glBindVertexArray(_vao);
 	check_gl_error ("glBindVertexArray");
-	if (_optimise_for_j2k) {
-		glUniform1i(_fragment_type, static_cast<GLint>(FragmentType::XYZ_IMAGE));
-	} else if (_rec2020) {
-		glUniform1i(_fragment_type, static_cast<GLint>(FragmentType::REC2020_IMAGE));
-	} else {
-		glUniform1i(_fragment_type, static_cast<GLint>(FragmentType::REC709_IMAGE));
-	}
+	glUniform1i(_fragment_type, _video_fragment_type);
 	_video_texture->bind();
+	if (_video_is_yuv) {
+		_video_texture_cb->bind(1);
+		_video_texture_cr->bind(2);
+	}
 	glDrawElements (GL_TRIANGLES, indices_video_texture_number, GL_UNSIGNED_INT, reinterpret_cast<void*>(indices_video_texture_offset * sizeof(int)));
 	if (_have_subtitle_to_render) {
 		glUniform1i(_fragment_type, static_cast<GLint>(FragmentType::REC709_IMAGE));
@@ -595,22 +727,55 @@ GLVideoView::draw ()
 void
 GLVideoView::set_image (shared_ptr<const PlayerVideo> pv)
 {
-	shared_ptr<const Image> video = _optimise_for_j2k ? pv->raw_image() : pv->image(boost::bind(&PlayerVideo::force, AV_PIX_FMT_RGB24), VideoRange::FULL, true);
-
-	/* Only the player's black frames should be aligned at this stage, so this should
-	 * almost always have no work to do.
+	/* Where we can we upload the image from the ImageProxy as it is, and do the crop, scale,
+	 * video range and colourspace conversion in the shader.  Otherwise we fall back to having
+	 * PlayerVideo make a RGB image on the CPU.
 	 */
-	video = Image::ensure_alignment (video, Image::Alignment::COMPACT);
+	auto raw_and_window = pv->raw_image_and_window();
+	auto video = raw_and_window.first;
+	auto window = raw_and_window.second;
+	auto const pixel_format = video->pixel_format();
+	auto const yuv_bits = planar_yuv_bits(pixel_format);
+
+	auto const raw = yuv_bits ||
+		pixel_format == AV_PIX_FMT_XYZ12 ||
+		pixel_format == AV_PIX_FMT_RGB24 ||
+		pixel_format == AV_PIX_FMT_RGBA ||
+		pixel_format == AV_PIX_FMT_BGRA;
+
+	if (!raw) {
+		video = pv->image(boost::bind(&PlayerVideo::force, AV_PIX_FMT_RGB24), VideoRange::FULL, true);
+		window = dcpomatic::Rect<float>(0, 0, 1, 1);
+	}
 
-	/** If _optimise_for_j2k is true we render a XYZ image, doing the colourspace
-	 *  conversion, scaling and video range conversion in the GL shader.
-	 *  Otherwise we render a RGB image without any shader-side processing.
-	 */
+	auto const rec2020 = pv->colour_conversion() && pv->colour_conversion()->about_equal(dcp::ColourConversion::rec2020_to_xyz(), 1e-6);
+
+	_video_is_yuv = static_cast<bool>(yuv_bits);
+	if (_video_is_yuv) {
+		_video_texture->set (video, 0);
+		_video_texture_cb->set (video, 1);
+		_video_texture_cr->set (video, 2);
+		set_yuv_conversion (pv->colour_conversion() ? pv->colour_conversion()->yuv_to_rgb() : dcp::YUVToRGB::REC601, pv->video_range(), *yuv_bits);
+		_video_fragment_type = static_cast<GLint>(rec2020 ? FragmentType::REC2020_YUV_IMAGE : FragmentType::REC709_YUV_IMAGE);
+	} else {
+		/* Only the player's black frames should be aligned at this stage, so this should
+		 * almost always have no work to do.
+		 */
+		video = Image::ensure_alignment (video, Image::Alignment::COMPACT);
+		_video_texture->set (video);
+		if (video->pixel_format() == AV_PIX_FMT_XYZ12) {
+			_video_fragment_type = static_cast<GLint>(FragmentType::XYZ_IMAGE);
+		} else {
+			_video_fragment_type = static_cast<GLint>(rec2020 ? FragmentType::REC2020_IMAGE : FragmentType::REC709_IMAGE);
+		}
+	}
 
-	_video_texture->set (video);
+	/* If we didn't get a raw image PlayerVideo will already have done the fade */
+	glUniform1f (_fade, raw ? static_cast<float>(pv->fade().get_value_or(1)) : 1.0f);
+	check_gl_error ("glUniform1f");
 
 	auto const text = pv->text();
-	_have_subtitle_to_render = static_cast<bool>(text) && _optimise_for_j2k;
+	_have_subtitle_to_render = static_cast<bool>(text) && raw;
 	if (_have_subtitle_to_render) {
 		/* opt: only do this if it's a new subtitle? */
 		DCPOMATIC_ASSERT (text->image->alignment() == Image::Alignment::COMPACT);
@@ -635,11 +800,14 @@ GLVideoView::set_image (shared_ptr<const PlayerVideo> pv)
 	_last_inter_size.set_next (inter_size);
 	_last_out_size.set_next (out_size);
 	_last_crop_guess.set_next (crop_guess);
+	_last_raw.set_next (raw);
+	_last_window.set_next (window);
 
 	class Rectangle
 	{
 	public:
-		Rectangle (wxSize canvas_size, float x, float y, dcp::Size size)
+		/** @param texture Part of the texture to put into the rectangle, as proportions of its size */
+		Rectangle (wxSize canvas_size, float x, float y, dcp::Size size, dcpomatic::Rect<float> texture = dcpomatic::Rect<float>(0, 0, 1, 1))
 			: _canvas_size (canvas_size)
 		{
 			auto const x1 = x_pixels_to_gl(x);
@@ -647,6 +815,11 @@ GLVideoView::set_image (shared_ptr<const PlayerVideo> pv)
 			auto const x2 = x_pixels_to_gl(x + size.width);
 			auto const y2 = y_pixels_to_gl(y + size.height);
 
+			auto const s1 = texture.x;
+			auto const t1 = texture.y;
+			auto const s2 = texture.x + texture.width;
+			auto const t2 = texture.y + texture.height;
+
 			/* The texture coordinates here have to account for the fact that when we put images into the texture OpenGL
 			 * expected us to start at the lower left but we actually started at the top left.  So although the
 			 * top of the texture is at 1.0 we pretend it's the other way round.
@@ -656,29 +829,29 @@ GLVideoView::set_image (shared_ptr<const PlayerVideo> pv)
 			_vertices[0] = x2;
 			_vertices[1] = y2;
 			_vertices[2] = 0.0f;
-			_vertices[3] = 1.0f;
-			_vertices[4] = 1.0f;
+			_vertices[3] = s2;
+			_vertices[4] = t2;
 
 			// top right
 			_vertices[5] = x2;
 			_vertices[6] = y1;
 			_vertices[7] = 0.0f;
-			_vertices[8] = 1.0f;
-			_vertices[9] = 0.0f;
+			_vertices[8] = s2;
+			_vertices[9] = t1;
 
 			// top left
 			_vertices[10] = x1;
 			_vertices[11] = y1;
 			_vertices[12] = 0.0f;
-			_vertices[13] = 0.0f;
-			_vertices[14] = 0.0f;
+			_vertices[13] = s1;
+			_vertices[14] = t1;
 
 			// bottom left
 			_vertices[15] = x1;
 			_vertices[16] = y2;
 			_vertices[17] = 0.0f;
-			_vertices[18] = 0.0f;
-			_vertices[19] = 1.0f;
+			_vertices[18] = s1;
+			_vertices[19] = t2;
 		}
 
 		float const * vertices () const {
@@ -704,11 +877,17 @@ GLVideoView::set_image (shared_ptr<const PlayerVideo> pv)
 		float _vertices[20];
 	};
 
-	auto const sizing_changed = _last_canvas_size.changed() || _last_inter_position.changed() || _last_inter_size.changed() || _last_out_size.changed();
+	auto const sizing_changed =
+		_last_canvas_size.changed() ||
+		_last_inter_position.changed() ||
+		_last_inter_size.changed() ||
+		_last_out_size.changed() ||
+		_last_raw.changed() ||
+		_last_window.changed();
 
 	if (sizing_changed) {
-		const auto video = _optimise_for_j2k ?
-			Rectangle(canvas_size, inter_position.x + x_offset, inter_position.y + y_offset, inter_size)
+		const auto video = raw ?
+			Rectangle(canvas_size, inter_position.x + x_offset, inter_position.y + y_offset, inter_size, window)
 			: Rectangle(canvas_size, x_offset, y_offset, out_size);
 
 		glBufferSubData (GL_ARRAY_BUFFER, array_buffer_video_offset, video.size(), video.vertices());
@@ -731,22 +910,11 @@ GLVideoView::set_image (shared_ptr<const PlayerVideo> pv)
 	}
 
 	if (_have_subtitle_to_render) {
-		const auto subtitle = Rectangle(canvas_size, inter_position.x + x_offset + text->position.x, inter_position.y + y_offset + text->position.y, text->image->size());
+		const auto subtitle = Rectangle(canvas_size, x_offset + text->position.x, y_offset + text->position.y, text->image->size());
 		glBufferSubData (GL_ARRAY_BUFFER, array_buffer_subtitle_offset, subtitle.size(), subtitle.vertices());
 		check_gl_error ("glBufferSubData (subtitle)");
 	}
 
-	_rec2020 = pv->colour_conversion() && pv->colour_conversion()->about_equal(dcp::ColourConversion::rec2020_to_xyz(), 1e-6);
-
-	/* opt: where should these go? */
-
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	check_gl_error ("glTexParameteri");
-
-	glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	check_gl_error ("glTexParameterf");
 }
 
 
@@ -856,8 +1024,10 @@ try
 	_vsync_enabled = true;
 #endif
 
-	_video_texture.reset(new Texture(_optimise_for_j2k ? 2 : 1));
-	_subtitle_texture.reset(new Texture(1));
+	_video_texture.reset(new Texture());
+	_video_texture_cb.reset(new Texture());
+	_video_texture_cr.reset(new Texture());
+	_subtitle_texture.reset(new Texture());
 
 	while (true) {
 		boost::mutex::scoped_lock lm (_playing_mutex);
@@ -905,77 +1075,145 @@ GLVideoView::request_one_shot ()
 }
 
 
-Texture::Texture (GLint unpack_alignment)
-	: _unpack_alignment (unpack_alignment)
+Texture::Texture ()
 {
 	glGenTextures (1, &_name);
 	check_gl_error ("glGenTextures");
+	glGenBuffers (_pbo_count, _pbos);
+	check_gl_error ("glGenBuffers");
 }
 
 
 Texture::~Texture ()
 {
+	glDeleteBuffers (_pbo_count, _pbos);
 	glDeleteTextures (1, &_name);
 }
 
 
 void
-Texture::bind ()
+Texture::bind (int unit)
 {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	check_gl_error ("glActiveTexture");
 	glBindTexture(GL_TEXTURE_2D, _name);
 	check_gl_error ("glBindTexture");
 }
 
 
+/** Upload an image to this texture.
+ *  @param plane Plane to upload; for planar YUV images each plane goes into its own
+ *  single-channel texture so that the shader can do the conversion to RGB.
+ */
 void
-Texture::set (shared_ptr<const Image> image)
+Texture::set (shared_ptr<const Image> image, int plane)
 {
-	auto const create = !_size || image->size() != _size;
-	_size = image->size();
+	GLint internal_format;
+	GLenum format;
+	GLenum type;
+	/* Alignment of the start of each row of the data, in bytes */
+	GLint unpack_alignment = 1;
+	/* Length of each row of the data in pixels if there is padding at the end of the rows, otherwise 0 */
+	GLint row_length = 0;
+
+	if (auto bits = planar_yuv_bits(image->pixel_format())) {
+		/* The planes are uploaded with any padding, so we don't need a compact image */
+		int const bytes = *bits > 8 ? 2 : 1;
+		internal_format = bytes == 2 ? GL_R16 : GL_R8;
+		format = GL_RED;
+		type = bytes == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+		unpack_alignment = bytes;
+		row_length = image->stride()[plane] / bytes;
+	} else {
+		DCPOMATIC_ASSERT (plane == 0);
+		DCPOMATIC_ASSERT (image->alignment() == Image::Alignment::COMPACT);
+
+		switch (image->pixel_format()) {
+		case AV_PIX_FMT_BGRA:
+			internal_format = GL_RGBA8;
+			format = GL_BGRA;
+			type = GL_UNSIGNED_BYTE;
+			break;
+		case AV_PIX_FMT_RGBA:
+			internal_format = GL_RGBA8;
+			format = GL_RGBA;
+			type = GL_UNSIGNED_BYTE;
+			break;
+		case AV_PIX_FMT_RGB24:
+			internal_format = GL_RGBA8;
+			format = GL_RGB;
+			type = GL_UNSIGNED_BYTE;
+			break;
+		case AV_PIX_FMT_XYZ12:
+			internal_format = GL_RGBA12;
+			format = GL_RGB;
+			type = GL_UNSIGNED_SHORT;
+			unpack_alignment = 2;
+			break;
+		default:
+			throw PixelFormatError ("Texture::set", image->pixel_format());
+		}
+	}
 
-	glPixelStorei (GL_UNPACK_ALIGNMENT, _unpack_alignment);
+	auto const size = image->sample_size(plane);
+	auto const create = !_size || size != _size || internal_format != _internal_format;
+	_size = size;
+	_internal_format = internal_format;
+
+	glPixelStorei (GL_UNPACK_ALIGNMENT, unpack_alignment);
+	glPixelStorei (GL_UNPACK_ROW_LENGTH, row_length);
 	check_gl_error ("glPixelStorei");
 
-	DCPOMATIC_ASSERT (image->alignment() == Image::Alignment::COMPACT);
+	bind ();
 
-	GLint internal_format;
-	GLenum format;
-	GLenum type;
+	/* Copy the image into the next of our pixel buffers and upload the texture from there.  Then
+	 * glTex[Sub]Image2D can return as soon as the transfer to the GPU has been queued, and the
+	 * copy into the next buffer need not wait for this transfer to finish.
+	 */
+	auto const bytes = static_cast<GLsizeiptr>(image->stride()[plane]) * _size->height;
+	glBindBuffer (GL_PIXEL_UNPACK_BUFFER, _pbos[_next_pbo]);
+	check_gl_error ("glBindBuffer");
+	_next_pbo = (_next_pbo + 1) % _pbo_count;
+	/* Orphan any previous storage so that we don't have to wait for the GPU to finish with it */
+	glBufferData (GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	check_gl_error ("glBufferData");
 
-	switch (image->pixel_format()) {
-	case AV_PIX_FMT_BGRA:
-		internal_format = GL_RGBA8;
-		format = GL_BGRA;
-		type = GL_UNSIGNED_BYTE;
-		break;
-	case AV_PIX_FMT_RGBA:
-		internal_format = GL_RGBA8;
-		format = GL_RGBA;
-		type = GL_UNSIGNED_BYTE;
-		break;
-	case AV_PIX_FMT_RGB24:
-		internal_format = GL_RGBA8;
-		format = GL_RGB;
-		type = GL_UNSIGNED_BYTE;
-		break;
-	case AV_PIX_FMT_XYZ12:
-		internal_format = GL_RGBA12;
-		format = GL_RGB;
-		type = GL_UNSIGNED_SHORT;
-		break;
-	default:
-		throw PixelFormatError ("Texture::set", image->pixel_format());
+	void const* pixels = nullptr;
+	auto mapped = glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped) {
+		memcpy (mapped, image->data()[plane], bytes);
+		if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+			/* The buffer's contents were lost, so upload straight from the image instead */
+			mapped = nullptr;
+		}
 	}
 
-	bind ();
+	if (!mapped) {
+		glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+		pixels = image->data()[plane];
+	}
 
 	if (create) {
-		glTexImage2D (GL_TEXTURE_2D, 0, internal_format, _size->width, _size->height, 0, format, type, image->data()[0]);
+		glTexImage2D (GL_TEXTURE_2D, 0, internal_format, _size->width, _size->height, 0, format, type, pixels);
 		check_gl_error ("glTexImage2D");
+
+		glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		check_gl_error ("glTexParameteri");
+
+		glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		check_gl_error ("glTexParameterf");
 	} else {
-		glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, _size->width, _size->height, format, type, image->data()[0]);
+		glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, _size->width, _size->height, format, type, pixels);
 		check_gl_error ("glTexSubImage2D");
 	}
+
+	glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (row_length) {
+		glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+	}
 }
 
 #endif
@@ -37,6 +37,7 @@ LIBDCP_ENABLE_WARNINGS
 #include "video_view.h"
 #include "lib/signaller.h"
 #include "lib/position.h"
+#include "lib/rect.h"
 #include <dcp/util.h>
 #include <boost/atomic.hpp>
 #include <boost/thread.hpp>
@@ -49,19 +50,24 @@ LIBDCP_ENABLE_WARNINGS
 class Texture
 {
 public:
-	Texture (GLint unpack_alignment);
+	Texture ();
 	~Texture ();
 
 	Texture (Texture const&) = delete;
 	Texture& operator= (Texture const&) = delete;
 
-	void bind ();
-	void set (std::shared_ptr<const Image> image);
+	void bind (int unit = 0);
+	void set (std::shared_ptr<const Image> image, int plane = 0);
 
 private:
 	GLuint _name;
-	GLint _unpack_alignment;
 	boost::optional<dcp::Size> _size;
+	boost::optional<GLint> _internal_format;
+
+	/** Pixel buffers which we upload through, used in turn */
+	static constexpr int _pbo_count = 2;
+	GLuint _pbos[_pbo_count];
+	int _next_pbo = 0;
 };
 
 
@@ -101,6 +107,7 @@ private:
 	void setup_shaders ();
 	void set_outline_content_colour (GLuint program);
 	void set_crop_guess_colour (GLuint program);
+	void set_yuv_conversion (dcp::YUVToRGB yuv_to_rgb, VideoRange range, int bits);
 
 	wxGLCanvas* _canvas;
 	wxGLContext* _context;
@@ -132,10 +139,19 @@ private:
 	Last<dcp::Size> _last_inter_size;
 	Last<dcp::Size> _last_out_size;
 	Last<boost::optional<dcpomatic::Rect<float>>> _last_crop_guess;
+	Last<bool> _last_raw;
+	Last<dcpomatic::Rect<float>> _last_window;
 
 	boost::atomic<wxSize> _canvas_size;
-	boost::atomic<bool> _rec2020;
+	/** Luma (Y) plane of a YUV image, or the whole of any other image */
 	std::unique_ptr<Texture> _video_texture;
+	/** Chroma planes of a YUV image */
+	std::unique_ptr<Texture> _video_texture_cb;
+	std::unique_ptr<Texture> _video_texture_cr;
+	/** true if the video textures hold YUV planes */
+	bool _video_is_yuv = false;
+	/** FragmentType to use to draw the video textures */
+	GLint _video_fragment_type = 0;
 	std::unique_ptr<Texture> _subtitle_texture;
 	bool _have_subtitle_to_render = false;
 	bool _vsync_enabled;
@@ -148,6 +164,10 @@ private:
 
 	GLuint _vao;
 	GLint _fragment_type;
+	GLint _yuv_to_rgb;
+	GLint _yuv_multiply;
+	GLint _yuv_subtract;
+	GLint _fade;
 	bool _setup_shaders_done = false;
 
 	std::shared_ptr<wxTimer> _timer;
@@ -86,21 +86,35 @@ HintsDialog::HintsDialog (wxWindow* parent, std::weak_ptr<Film> film, bool ok)
 
 	auto locked_film = _film.lock ();
 	if (locked_film) {
-		_film_change_connection = locked_film->Change.connect (boost::bind (&HintsDialog::film_change, this, _1));
-		_film_content_change_connection = locked_film->ContentChange.connect (boost::bind (&HintsDialog::film_content_change, this, _1));
+		_film_change_connection = locked_film->Change.connect (boost::bind (&HintsDialog::film_change, this, _1, _2));
+		_film_content_change_connection = locked_film->ContentChange.connect (boost::bind (&HintsDialog::film_content_change, this, _1, _3));
 	}
 
-	film_change (ChangeType::DONE);
+	restart ();
 }
 
 
 void
-HintsDialog::film_change (ChangeType type)
+HintsDialog::film_change (ChangeType type, Film::Property property)
 {
-	if (type != ChangeType::DONE) {
-		return;
+	if (type == ChangeType::DONE && Hints::film_change_matters(property)) {
+		restart ();
+	}
+}
+
+
+void
+HintsDialog::film_content_change (ChangeType type, int property)
+{
+	if (type == ChangeType::DONE && Hints::content_change_matters(property)) {
+		restart ();
 	}
+}
 
+
+void
+HintsDialog::restart ()
+{
 	_text->Clear ();
 	_current.clear ();
 
@@ -124,12 +138,6 @@ HintsDialog::film_change (ChangeType type)
 	_hints->start ();
 }
 
-void
-HintsDialog::film_content_change (ChangeType type)
-{
-	film_change (type);
-}
-
 void
 HintsDialog::update ()
 {
@@ -20,6 +20,7 @@
 
 
 #include "lib/change_signaller.h"
+#include "lib/film.h"
 #include <dcp/warnings.h>
 LIBDCP_DISABLE_WARNINGS
 #include <wx/wx.h>
@@ -28,7 +29,6 @@ LIBDCP_ENABLE_WARNINGS
 
 
 class wxRichTextCtrl;
-class Film;
 class Hints;
 
 class HintsDialog : public wxDialog
@@ -37,8 +37,9 @@ public:
 	HintsDialog (wxWindow* parent, std::weak_ptr<Film>, bool ok);
 
 private:
-	void film_change (ChangeType);
-	void film_content_change (ChangeType type);
+	void film_change (ChangeType type, Film::Property property);
+	void film_content_change (ChangeType type, int property);
+	void restart ();
 	void shut_up (wxCommandEvent& ev);
 	void update ();
 	void hint (std::string text);
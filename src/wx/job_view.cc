@@ -151,7 +151,7 @@ JobView::finished ()
 
 	_cancel->Enable (false);
 	_notify->Enable (false);
-	if (!_job->error_details().empty ()) {
+	if (!_job->error_details().empty() || _job->report()) {
 		_details->Enable (true);
 	}
 
@@ -178,6 +178,13 @@ JobView::finished ()
 void
 JobView::details_clicked (wxCommandEvent &)
 {
+	if (_job->finished_ok() && _job->report()) {
+		auto d = new MessageDialog (_parent, std_to_wx(_job->name()), std_to_wx(_job->report().get()));
+		d->ShowModal ();
+		d->Destroy ();
+		return;
+	}
+
 	auto s = _job->error_summary();
 	s[0] = toupper (s[0]);
 	error_dialog (_parent, std_to_wx(s), std_to_wx(_job->error_details()));
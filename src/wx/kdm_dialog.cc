@@ -171,12 +171,7 @@ KDMDialog::make_clicked ()
 			for_audio = _output->forensic_mark_audio_up_to();
 		}
 
-		for (auto i: _screens->screens()) {
-			auto p = kdm_for_screen (film, _cpl->cpl(), i, _timing->from(), _timing->until(), _output->formulation(), !_output->forensic_mark_video(), for_audio);
-			if (p) {
-				kdms.push_back (p);
-			}
-		}
+		kdms = kdms_for_screens (film, _cpl->cpl(), _screens->screens(), _timing->from(), _timing->until(), _output->formulation(), !_output->forensic_mark_video(), for_audio);
 	} catch (dcp::BadKDMDateError& e) {
 		if (e.starts_too_early()) {
 			error_dialog (this, _("The KDM start period is before (or close to) the start of the signing certificate's validity period.  Use a later start time for this KDM."));
@@ -29,6 +29,7 @@
 #include "lib/scope_guard.h"
 #include "lib/screen.h"
 #include "lib/timer.h"
+#include <algorithm>
 
 
 using std::cout;
@@ -64,6 +65,7 @@ ScreensPanel::ScreensPanel (wxWindow* parent)
 
 	targets->Add (_targets, 1, wxEXPAND | wxRIGHT, DCPOMATIC_SIZER_GAP);
 
+	index_cinemas ();
 	add_cinemas ();
 
 	auto side_buttons = new wxBoxSizer (wxVERTICAL);
@@ -167,18 +169,44 @@ ScreensPanel::setup_sensitivity ()
 }
 
 
+static
+string
+lower_case (string s)
+{
+	transform (s.begin(), s.end(), s.begin(), ::tolower);
+	return s;
+}
+
+
+/** Make our sorted list of cinemas from the config */
+void
+ScreensPanel::index_cinemas ()
+{
+	_cinemas.clear ();
+	for (auto cinema: Config::instance()->cinemas()) {
+		_cinemas.push_back ({cinema, lower_case(cinema->name)});
+	}
+
+	std::sort (
+		_cinemas.begin(),
+		_cinemas.end(),
+		[this](IndexedCinema const& a, IndexedCinema const& b) { return _collator.compare(a.cinema->name, b.cinema->name) < 0; }
+		);
+}
+
+
+bool
+ScreensPanel::matches_search (shared_ptr<Cinema> cinema) const
+{
+	return _search_text.empty() || lower_case(cinema->name).find(_search_text) != string::npos;
+}
+
+
 optional<wxTreeListItem>
 ScreensPanel::add_cinema (shared_ptr<Cinema> cinema, wxTreeListItem previous)
 {
-	auto search = wx_to_std (_search->GetValue ());
-	transform (search.begin(), search.end(), search.begin(), ::tolower);
-
-	if (!search.empty ()) {
-		auto name = cinema->name;
-		transform (name.begin(), name.end(), name.begin(), ::tolower);
-		if (name.find (search) == string::npos) {
-			return {};
-		}
+	if (!matches_search(cinema)) {
+		return {};
 	}
 
 	auto id = _targets->InsertItem(_targets->GetRootItem(), previous, std_to_wx(cinema->name));
@@ -220,11 +248,6 @@ ScreensPanel::add_cinema_clicked ()
 	if (dialog->ShowModal() == wxID_OK) {
 		auto cinema = make_shared<Cinema>(dialog->name(), dialog->emails(), dialog->notes(), dialog->utc_offset_hour(), dialog->utc_offset_minute());
 
-		auto cinemas = Config::instance()->cinemas();
-		cinemas.sort(
-			[this](shared_ptr<Cinema> a, shared_ptr<Cinema> b) { return _collator.compare(a->name, b->name) < 0; }
-			);
-
 		try {
 			_ignore_cinemas_changed = true;
 			ScopeGuard sg = [this]() { _ignore_cinemas_changed = false; };
@@ -234,20 +257,25 @@ ScreensPanel::add_cinema_clicked ()
 			return;
 		}
 
+		auto position = std::upper_bound(
+			_cinemas.begin(),
+			_cinemas.end(),
+			cinema,
+			[this](shared_ptr<Cinema> a, IndexedCinema const& b) { return _collator.compare(a->name, b.cinema->name) < 0; }
+			);
+
+		/* Insert the new cinema after the last one before it that is in the view */
 		wxTreeListItem previous = wxTLI_FIRST;
-		bool found = false;
-		for (auto existing_cinema: cinemas) {
-			if (_collator.compare(dialog->name(), existing_cinema->name) < 0) {
-				/* existing_cinema should be after the one we're inserting */
-				found = true;
-				break;
+		for (auto i = _cinemas.begin(); i != position; ++i) {
+			if (auto item = cinema_to_item(i->cinema)) {
+				previous = *item;
 			}
-			auto item = cinema_to_item(existing_cinema);
-			DCPOMATIC_ASSERT(item);
-			previous = *item;
 		}
+		bool const last = position == _cinemas.end();
 
-		auto item = add_cinema(cinema, found ? previous : wxTLI_LAST);
+		_cinemas.insert (position, {cinema, lower_case(cinema->name)});
+
+		auto item = add_cinema(cinema, last ? wxTLI_LAST : previous);
 
 		if (item) {
 			_targets->UnselectAll ();
@@ -292,6 +320,7 @@ ScreensPanel::edit_cinema_clicked ()
 		cinema->set_utc_offset_hour(dialog->utc_offset_hour());
 		cinema->set_utc_offset_minute(dialog->utc_offset_minute());
 		notify_cinemas_changed();
+		index_cinemas();
 		auto item = cinema_to_item(cinema);
 		DCPOMATIC_ASSERT(item);
 		_targets->SetItemText (*item, std_to_wx(dialog->name()));
@@ -316,6 +345,10 @@ ScreensPanel::remove_cinema_clicked ()
 		_ignore_cinemas_changed = true;
 		ScopeGuard sg = [this]() { _ignore_cinemas_changed = false; };
 		Config::instance()->remove_cinema(cinema);
+		_cinemas.erase(
+			std::remove_if(_cinemas.begin(), _cinemas.end(), [cinema](IndexedCinema const& i) { return i.cinema == cinema; }),
+			_cinemas.end()
+			);
 		auto item = cinema_to_item(cinema);
 		DCPOMATIC_ASSERT(item);
 		_targets->DeleteItem(*item);
@@ -483,13 +516,12 @@ ScreensPanel::selection_changed ()
 void
 ScreensPanel::add_cinemas ()
 {
-	auto cinemas = Config::instance()->cinemas();
-	cinemas.sort(
-		[this](shared_ptr<Cinema> a, shared_ptr<Cinema> b) { return _collator.compare(a->name, b->name) < 0; }
-		);
+	_search_text = lower_case(wx_to_std(_search->GetValue()));
 
-	for (auto cinema: cinemas) {
-		add_cinema (cinema, wxTLI_LAST);
+	for (auto const& cinema: _cinemas) {
+		if (cinema.search_name.find(_search_text) != string::npos) {
+			add_cinema (cinema.cinema, wxTLI_LAST);
+		}
 	}
 }
 
@@ -497,6 +529,10 @@ ScreensPanel::add_cinemas ()
 void
 ScreensPanel::clear_and_re_add()
 {
+	/* Stop the control redrawing as we change thousands of items */
+	_targets->Freeze ();
+	ScopeGuard sg = [this]() { _targets->Thaw(); };
+
 	_targets->DeleteAllItems ();
 
 	_item_to_cinema.clear ();
@@ -671,6 +707,7 @@ void
 ScreensPanel::config_changed(Config::Property property)
 {
 	if (property == Config::Property::CINEMAS && !_ignore_cinemas_changed) {
+		index_cinemas();
 		clear_and_re_add();
 	}
 }
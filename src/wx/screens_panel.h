@@ -31,6 +31,8 @@ LIBDCP_ENABLE_WARNINGS
 #include <list>
 #include <map>
 #include <set>
+#include <string>
+#include <vector>
 
 
 namespace dcpomatic {
@@ -53,6 +55,8 @@ public:
 	boost::signals2::signal<void ()> ScreensChanged;
 
 private:
+	void index_cinemas ();
+	bool matches_search (std::shared_ptr<Cinema> cinema) const;
 	void add_cinemas ();
 	boost::optional<wxTreeListItem> add_cinema (std::shared_ptr<Cinema>, wxTreeListItem previous);
 	boost::optional<wxTreeListItem> add_screen (std::shared_ptr<Cinema>, std::shared_ptr<dcpomatic::Screen>);
@@ -102,6 +106,20 @@ private:
 	 */
 	std::set<std::shared_ptr<dcpomatic::Screen>> _checked_screens;
 
+	struct IndexedCinema
+	{
+		std::shared_ptr<Cinema> cinema;
+		/** lower-case name, for searching */
+		std::string search_name;
+	};
+
+	/** All the cinemas in the config, sorted by name, so that we don't have to
+	 *  sort them (and lower-case their names) every time the search changes.
+	 */
+	std::vector<IndexedCinema> _cinemas;
+	/** lower-case search string */
+	std::string _search_text;
+
 	std::map<wxTreeListItem, std::shared_ptr<Cinema>> _item_to_cinema;
 	std::map<wxTreeListItem, std::shared_ptr<dcpomatic::Screen>> _item_to_screen;
 	std::map<std::shared_ptr<Cinema>, wxTreeListItem> _cinema_to_item;
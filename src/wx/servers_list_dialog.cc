@@ -55,6 +55,22 @@ ServersListDialog::ServersListDialog (wxWindow* parent)
 		_list->InsertColumn (1, ip);
 	}
 
+	{
+		wxListItem ip;
+		ip.SetId (2);
+		ip.SetText (_("Frames per second"));
+		ip.SetWidth (150);
+		_list->InsertColumn (2, ip);
+	}
+
+	{
+		wxListItem ip;
+		ip.SetId (3);
+		ip.SetText (_("CPU"));
+		ip.SetWidth (300);
+		_list->InsertColumn (3, ip);
+	}
+
 	s->Add (_list, 1, wxEXPAND | wxALL, 12);
 
 	wxSizer* buttons = CreateSeparatedButtonSizer (wxOK);
@@ -87,6 +103,10 @@ ServersListDialog::servers_list_changed ()
 		_list->SetItem (n, 0, std_to_wx (i.host_name ()));
 		if (i.current_link_version()) {
 			_list->SetItem (n, 1, std_to_wx (lexical_cast<string> (i.threads ())));
+			if (auto fps = i.frames_per_second()) {
+				_list->SetItem (n, 2, wxString::Format("%.1f", *fps));
+			}
+			_list->SetItem (n, 3, std_to_wx(i.cpu()));
 		} else {
 			_list->SetItem (n, 1, _("Incorrect version"));
 		}
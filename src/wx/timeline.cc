@@ -44,6 +44,7 @@ LIBDCP_DISABLE_WARNINGS
 LIBDCP_ENABLE_WARNINGS
 #include <iterator>
 #include <list>
+#include <map>
 
 
 using std::abs;
@@ -53,6 +54,7 @@ using std::make_shared;
 using std::max;
 using std::min;
 using std::shared_ptr;
+using std::vector;
 using std::weak_ptr;
 using boost::bind;
 using boost::optional;
@@ -134,7 +136,25 @@ Timeline::Timeline(wxWindow* parent, ContentPanel* cp, shared_ptr<Film> film, Fi
 void
 Timeline::update_playhead ()
 {
-	Refresh ();
+	/* Just repaint where the playhead was and where it is now, rather than the whole timeline */
+	int const x = playhead_x ();
+	if (_last_playhead_x && *_last_playhead_x == x) {
+		return;
+	}
+
+	int const height = pixels_per_track() * _tracks + 32;
+	if (_last_playhead_x) {
+		force_redraw (dcpomatic::Rect<int>(*_last_playhead_x - 2, 0, 4, height));
+	}
+	force_redraw (dcpomatic::Rect<int>(x - 2, 0, 4, height));
+	_last_playhead_x = x;
+}
+
+
+int
+Timeline::playhead_x () const
+{
+	return _viewer.position().seconds() * pixels_per_second().get_value_or(0);
 }
 
 
@@ -182,22 +202,42 @@ Timeline::paint_main ()
 
 	gc->SetAntialiasMode (wxANTIALIAS_DEFAULT);
 
+	/* Only paint the views which are in the part of the canvas that needs it */
+	auto const update = _main_canvas->GetUpdateRegion().GetBox();
+	dcpomatic::Rect<int> const dirty (update.x + vsx * _x_scroll_rate, update.y + vsy * _y_scroll_rate, update.width, update.height);
+
+	TimelineViewList visible;
+	std::map<int, TimelineContentViewList> visible_by_track;
 	for (auto i: _views) {
+		if (!i->bbox().intersection(dirty)) {
+			continue;
+		}
+		visible.push_back (i);
+		auto ic = dynamic_pointer_cast<TimelineContentView>(i);
+		/* Audio and non-active views are never shown as overlapping */
+		if (ic && ic->track() && ic->track().get() < 2 && ic->active()) {
+			visible_by_track[ic->track().get()].push_back (ic);
+		}
+	}
+
+	for (auto i: visible) {
 
 		auto ic = dynamic_pointer_cast<TimelineContentView> (i);
 
-		/* Find areas of overlap with other content views, so that we can plot them */
+		/* Find areas of overlap with other content views on the same track, so that we can plot them.
+		   Any overlap that needs painting will be with another view that needs painting.
+		*/
 		list<dcpomatic::Rect<int>> overlaps;
-		for (auto j: _views) {
-			auto jc = dynamic_pointer_cast<TimelineContentView> (j);
-			/* No overlap with non-content views, views on different tracks, audio views or non-active views */
-			if (!ic || !jc || i == j || ic->track() != jc->track() || ic->track().get_value_or(2) >= 2 || !ic->active() || !jc->active()) {
-				continue;
-			}
+		if (ic && ic->track() && visible_by_track.find(ic->track().get()) != visible_by_track.end() && ic->active()) {
+			for (auto j: visible_by_track[ic->track().get()]) {
+				if (j == ic) {
+					continue;
+				}
 
-			auto r = j->bbox().intersection(i->bbox());
-			if (r) {
-				overlaps.push_back (r.get ());
+				auto r = j->bbox().intersection(i->bbox());
+				if (r) {
+					overlaps.push_back (r.get ());
+				}
 			}
 		}
 
@@ -221,7 +261,7 @@ Timeline::paint_main ()
 
 	gc->SetPen (*wxRED_PEN);
 	auto path = gc->CreatePath ();
-	double const ph = _viewer.position().seconds() * pixels_per_second().get_value_or(0);
+	double const ph = playhead_x ();
 	path.MoveToPoint (ph, 0);
 	path.AddLineToPoint (ph, pixels_per_track() * _tracks + 32);
 	gc->StrokePath (path);
@@ -302,12 +342,21 @@ Timeline::film_content_change (ChangeType type, int property, bool frequent)
 }
 
 
+/** Put each of the views of type T in @p views on the first of its tracks where it does not overlap
+ *  any of the views that were put there before it.
+ */
 template <class T>
 int
 place (shared_ptr<const Film> film, TimelineViewList& views, int& tracks)
 {
 	int const base = tracks;
 
+	/* The periods of the content that we have put on each of our tracks, keyed by their start.
+	   The periods on a track never overlap, so a new period only needs to be checked against
+	   the last one which starts before it ends.
+	*/
+	vector<std::map<DCPTime, DCPTime>> placed;
+
 	for (auto i: views) {
 		if (!dynamic_pointer_cast<T>(i)) {
 			continue;
@@ -315,40 +364,30 @@ place (shared_ptr<const Film> film, TimelineViewList& views, int& tracks)
 
 		auto cv = dynamic_pointer_cast<TimelineContentView> (i);
 
-		int t = base;
-
 		auto content = cv->content();
 		DCPTimePeriod const content_period (content->position(), content->end(film));
+		bool const empty = content_period.from >= content_period.to;
 
-		while (true) {
-			auto j = views.begin();
-			while (j != views.end()) {
-				auto test = dynamic_pointer_cast<T> (*j);
-				if (!test) {
-					++j;
-					continue;
-				}
-
-				auto test_content = test->content();
-				if (
-					test->track() && test->track().get() == t &&
-					content_period.overlap(DCPTimePeriod(test_content->position(), test_content->end(film)))) {
-					/* we have an overlap on track `t' */
-					++t;
-					break;
-				}
-
-				++j;
-			}
-
-			if (j == views.end ()) {
+		size_t t = 0;
+		while (!empty && t < placed.size()) {
+			auto next = placed[t].lower_bound(content_period.to);
+			if (next == placed[t].begin() || std::prev(next)->second <= content_period.from) {
 				/* no overlap on `t' */
 				break;
 			}
+			++t;
 		}
 
-		cv->set_track (t);
-		tracks = max (tracks, t + 1);
+		if (t == placed.size()) {
+			placed.push_back ({});
+		}
+
+		if (!empty) {
+			placed[t][content_period.from] = content_period.to;
+		}
+
+		cv->set_track (base + t);
+		tracks = max (tracks, static_cast<int>(base + t + 1));
 	}
 
 	return tracks - base;
@@ -810,10 +849,16 @@ Timeline::set_position_from_event (wxMouseEvent& ev, bool force_emit)
 }
 
 
+/** Repaint part of the main canvas.
+ *  @param r Area to repaint, in the canvas' virtual (unscrolled) coordinates.
+ */
 void
 Timeline::force_redraw (dcpomatic::Rect<int> const & r)
 {
-	_main_canvas->RefreshRect (wxRect (r.x, r.y, r.width, r.height), false);
+	int x;
+	int y;
+	_main_canvas->CalcScrolledPosition (r.x, r.y, &x, &y);
+	_main_canvas->RefreshRect (wxRect(x, y, r.width, r.height), false);
 }
 
 
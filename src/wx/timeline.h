@@ -108,6 +108,7 @@ private:
 	void set_pixels_per_track (int h);
 	void zoom_all ();
 	void update_playhead ();
+	int playhead_x () const;
 
 	std::shared_ptr<TimelineView> event_to_view (wxMouseEvent &);
 	TimelineContentViewList selected_views () const;
@@ -141,6 +142,8 @@ private:
 	int _pixels_per_track;
 	bool _first_resize;
 	wxTimer _timer;
+	/** x position of the playhead when we last drew it */
+	boost::optional<int> _last_playhead_x;
 
 	static double const _minimum_pixels_per_second;
 	static int const _minimum_pixels_per_track;
@@ -141,6 +141,16 @@ TimelineContentView::do_paint (wxGraphicsContext* gc, list<dcpomatic::Rect<int>>
 	gc->StrokePath (path);
 	gc->FillPath (path);
 
+	auto const inside = dcpomatic::Rect<int>(
+		time_x(position) + 4, y_pos(_track.get()) + 6, time_x(position + len) - time_x(position) - 7, _timeline.pixels_per_track() - 12
+		);
+	if (inside.width > 0 && inside.height > 0) {
+		gc->PushState ();
+		gc->Clip (inside.x, inside.y, inside.width, inside.height);
+		paint_inside (gc, inside);
+		gc->PopState ();
+	}
+
 	/* Reel split points */
 	gc->SetPen (*wxThePenList->FindOrCreatePen (foreground_colour(), 1, wxPENSTYLE_DOT));
 	for (auto i: cont->reel_split_points(film)) {
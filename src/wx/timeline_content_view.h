@@ -58,6 +58,10 @@ public:
 	virtual wxString label () const;
 
 protected:
+	/** Paint anything that should appear inside the outline, underneath the reel split points and label.
+	 *  @param area Inside of the outline.
+	 */
+	virtual void paint_inside (wxGraphicsContext *, dcpomatic::Rect<int>) {}
 
 	std::weak_ptr<Content> _content;
 
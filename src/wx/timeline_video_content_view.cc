@@ -18,17 +18,32 @@
 
 */
 
+#include "timeline.h"
+#include "lib/film.h"
+#include "lib/frame_rate_change.h"
+#include "lib/image.h"
 #include "lib/image_content.h"
+#include "lib/thumbnail_strip.h"
+#include "lib/thumbnail_strip_maker.h"
 #include "lib/video_content.h"
 #include "timeline_video_content_view.h"
+#include <dcp/warnings.h>
+LIBDCP_DISABLE_WARNINGS
+#include <wx/graphics.h>
+LIBDCP_ENABLE_WARNINGS
 
 using std::dynamic_pointer_cast;
 using std::shared_ptr;
+using namespace dcpomatic;
+#if BOOST_VERSION >= 106100
+using namespace boost::placeholders;
+#endif
 
 TimelineVideoContentView::TimelineVideoContentView (Timeline& tl, shared_ptr<Content> c)
 	: TimelineContentView (tl, c)
 {
-
+	_thumbnails_connection = ThumbnailStripMaker::instance()->Ready.connect(boost::bind(&TimelineVideoContentView::thumbnails_ready, this, _1));
+	load_thumbnails ();
 }
 
 wxColour
@@ -58,3 +73,75 @@ TimelineVideoContentView::active () const
 	DCPOMATIC_ASSERT (c);
 	return c->video && c->video->use();
 }
+
+/** Find our thumbnails if they are ready, or ask for them to be made/loaded if not */
+void
+TimelineVideoContentView::load_thumbnails ()
+{
+	auto film = _timeline.film ();
+	auto content = _content.lock ();
+	if (!film || !content || !content->video) {
+		return;
+	}
+
+	auto strip = ThumbnailStripMaker::instance()->get(film, content);
+	if (!strip || strip == _strip) {
+		return;
+	}
+
+	_strip = strip;
+	_thumbnails.clear ();
+	for (auto const& i: strip->thumbnails()) {
+		wxImage image (i.image->size().width, i.image->size().height, i.image->data()[0], true);
+		_thumbnails.push_back ({i.time, wxBitmap(image)});
+	}
+}
+
+
+void
+TimelineVideoContentView::thumbnails_ready (boost::filesystem::path path)
+{
+	auto film = _timeline.film ();
+	auto content = _content.lock ();
+	if (!film || !content || path != film->thumbnails_path(content)) {
+		return;
+	}
+
+	load_thumbnails ();
+	force_redraw ();
+}
+
+
+void
+TimelineVideoContentView::paint_inside (wxGraphicsContext* gc, dcpomatic::Rect<int> area)
+{
+	auto film = _timeline.film ();
+	auto content = _content.lock ();
+	if (!film || !content || _thumbnails.empty() || !active()) {
+		return;
+	}
+
+	auto const position = content->position();
+	auto const end = content->end(film);
+	FrameRateChange const frc (film, content);
+
+	/* Draw each thumbnail in the place where its frame is, leaving out any that would
+	   overlap the one before.
+	*/
+	int next_x = area.x;
+	for (auto const& i: _thumbnails) {
+		auto const time = position + DCPTime(i.first - content->trim_start(), frc);
+		if (time < position || time >= end) {
+			continue;
+		}
+
+		auto const width = i.second.GetWidth() * area.height / i.second.GetHeight();
+		auto const x = time_x(time) - width / 2;
+		if (x < next_x) {
+			continue;
+		}
+
+		gc->DrawBitmap (i.second, x, area.y, width, area.height);
+		next_x = x + width;
+	}
+}
@@ -20,6 +20,11 @@
 
 
 #include "timeline_content_view.h"
+#include "lib/dcpomatic_time.h"
+#include <boost/filesystem.hpp>
+
+
+class ThumbnailStrip;
 
 
 /** @class TimelineVideoContentView
@@ -34,4 +39,14 @@ private:
 	bool active () const override;
 	wxColour background_colour () const override;
 	wxColour foreground_colour () const override;
+	void paint_inside (wxGraphicsContext* gc, dcpomatic::Rect<int> area) override;
+
+	void load_thumbnails ();
+	void thumbnails_ready (boost::filesystem::path path);
+
+	/** strip that _thumbnails were made from */
+	std::shared_ptr<const ThumbnailStrip> _strip;
+	std::vector<std::pair<dcpomatic::ContentTime, wxBitmap>> _thumbnails;
+
+	boost::signals2::scoped_connection _thumbnails_connection;
 };
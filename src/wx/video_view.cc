@@ -34,6 +34,10 @@ using boost::optional;
 
 static constexpr int TOO_MANY_DROPPED_FRAMES = 20;
 static constexpr int TOO_MANY_DROPPED_PERIOD = 5.0;
+/** Period over which we decide whether we are overloaded, in seconds */
+static constexpr double LOAD_CHECK_PERIOD = 2.0;
+/** Proportion of dropped frames above which we consider ourselves overloaded */
+static constexpr double OVERLOADED_DROPPED_PROPORTION = 0.05;
 
 
 VideoView::VideoView (FilmViewer* viewer)
@@ -69,6 +73,10 @@ VideoView::get_next_frame (bool non_blocking)
 	if (!butler) {
 		return FAIL;
 	}
+	/* Tell the butler what we are showing now, so that it need not prepare any frames that we will drop */
+	auto const now = _viewer->audio_time();
+	butler->set_deadline (now ? optional<dcpomatic::DCPTime>(*now - one_video_frame()) : optional<dcpomatic::DCPTime>());
+
 	add_get ();
 
 	boost::mutex::scoped_lock lm (_mutex);
@@ -94,6 +102,8 @@ VideoView::get_next_frame (bool non_blocking)
 		++_errored;
 	}
 
+	_viewer->frame_displayed (_player_video);
+
 	return SUCCESS;
 }
 
@@ -130,6 +140,9 @@ VideoView::start ()
 	_dropped = 0;
 	_errored = 0;
 	gettimeofday(&_dropped_check_period_start, nullptr);
+	_load_check_gets = 0;
+	_load_check_dropped = 0;
+	_load_check_period_start = _dropped_check_period_start;
 }
 
 
@@ -158,6 +171,7 @@ VideoView::add_dropped ()
 	{
 		boost::mutex::scoped_lock lm (_mutex);
 		++_dropped;
+		++_load_check_dropped;
 		if (_dropped > TOO_MANY_DROPPED_FRAMES) {
 			struct timeval now;
 			gettimeofday (&now, nullptr);
@@ -174,6 +188,36 @@ VideoView::add_dropped ()
 }
 
 
+void
+VideoView::add_get ()
+{
+	optional<bool> overloaded;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		++_gets;
+		++_load_check_gets;
+
+		struct timeval now;
+		gettimeofday (&now, nullptr);
+		if ((seconds(now) - seconds(_load_check_period_start)) > LOAD_CHECK_PERIOD) {
+			if (_load_check_dropped > _load_check_gets * OVERLOADED_DROPPED_PROPORTION) {
+				overloaded = true;
+			} else if (_load_check_dropped == 0) {
+				overloaded = false;
+			}
+			_load_check_gets = 0;
+			_load_check_dropped = 0;
+			_load_check_period_start = now;
+		}
+	}
+
+	if (overloaded) {
+		emit (boost::bind(boost::ref(Overloaded), *overloaded));
+	}
+}
+
+
 wxColour
 VideoView::pad_colour () const
 {
@@ -77,6 +77,10 @@ public:
 	boost::signals2::signal<void()> Sized;
 	/** Emitted from the GUI thread when a lot of frames are being dropped */
 	boost::signals2::signal<void()> TooManyDropped;
+	/** Emitted from the GUI thread every so often during playback, with true if we have been
+	 *  dropping frames since the last emission, or false if we have not been dropping any.
+	 */
+	boost::signals2::signal<void(bool)> Overloaded;
 
 
 	/* Accessors for FilmViewer */
@@ -134,6 +138,12 @@ public:
 		_optimise_for_j2k = o;
 	}
 
+	/** Set the frame to show next time we update() */
+	void set_player_video (std::pair<std::shared_ptr<PlayerVideo>, dcpomatic::DCPTime> video) {
+		boost::mutex::scoped_lock lm (_mutex);
+		_player_video = video;
+	}
+
 protected:
 	NextFrameResult get_next_frame (bool non_blocking);
 	boost::optional<int> time_until_next_frame () const;
@@ -170,10 +180,7 @@ protected:
 
 	void add_dropped ();
 
-	void add_get () {
-		boost::mutex::scoped_lock lm (_mutex);
-		++_gets;
-	}
+	void add_get ();
 
 	FilmViewer* _viewer;
 
@@ -196,6 +203,12 @@ private:
 	struct timeval _dropped_check_period_start;
 	int _errored = 0;
 	int _gets = 0;
+
+	/** frames got since _load_check_period_start */
+	int _load_check_gets = 0;
+	/** frames dropped since _load_check_period_start */
+	int _load_check_dropped = 0;
+	struct timeval _load_check_period_start;
 };
 
 
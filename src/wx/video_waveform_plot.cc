@@ -26,6 +26,7 @@
 #include "lib/film.h"
 #include "lib/image.h"
 #include "lib/player_video.h"
+#include "lib/util.h"
 #include <dcp/locale_convert.h>
 #include <dcp/openjpeg_image.h>
 #include <dcp/warnings.h>
@@ -34,6 +35,7 @@ LIBDCP_DISABLE_WARNINGS
 #include <wx/rawbmp.h>
 LIBDCP_ENABLE_WARNINGS
 #include <boost/bind/bind.hpp>
+#include <algorithm>
 
 
 using std::make_shared;
@@ -41,6 +43,7 @@ using std::max;
 using std::min;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using std::weak_ptr;
 #if BOOST_VERSION >= 106100
 using namespace boost::placeholders;
@@ -51,6 +54,7 @@ using dcp::locale_convert;
 int const VideoWaveformPlot::_vertical_margin = 8;
 int const VideoWaveformPlot::_pixel_values = 4096;
 int const VideoWaveformPlot::_x_axis_width = 52;
+int const VideoWaveformPlot::_minimum_interval_ms = 40;
 
 
 VideoWaveformPlot::VideoWaveformPlot(wxWindow* parent, weak_ptr<const Film> film, FilmViewer& viewer)
@@ -69,6 +73,29 @@ VideoWaveformPlot::VideoWaveformPlot(wxWindow* parent, weak_ptr<const Film> film
 
 	SetMinSize (wxSize (640, 512));
 	SetBackgroundColour (wxColour (0, 0, 0));
+
+	_thread = boost::thread(boost::bind(&VideoWaveformPlot::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np(_thread.native_handle(), "waveform");
+#endif
+}
+
+
+VideoWaveformPlot::~VideoWaveformPlot()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm(_mutex);
+		_stop = true;
+		_condition.notify_all();
+	}
+
+	try {
+		if (_thread.joinable()) {
+			_thread.join();
+		}
+	} catch (...) {}
 }
 
 
@@ -77,11 +104,6 @@ VideoWaveformPlot::paint ()
 {
 	wxPaintDC dc (this);
 
-	if (_dirty) {
-		create_waveform ();
-		_dirty = false;
-	}
-
 	if (!_waveform) {
 		return;
 	}
@@ -142,46 +164,162 @@ VideoWaveformPlot::paint ()
 }
 
 
+/** Ask our thread to make a new waveform; must be called from the GUI thread.
+ *  @param video New video to use, or empty to use the last video that we were given.
+ */
 void
-VideoWaveformPlot::create_waveform ()
+VideoWaveformPlot::update (shared_ptr<PlayerVideo> video)
 {
-	_waveform.reset ();
-
-	if (!_image) {
+	int const height = GetSize().GetHeight() - _vertical_margin * 2;
+	int const width = GetSize().GetWidth() - _x_axis_width;
+	if (width <= 0 || height <= 0) {
 		return;
 	}
 
-	auto const image_size = _image->size();
-	int const waveform_height = GetSize().GetHeight() - _vertical_margin * 2;
-	_waveform = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size (image_size.width, waveform_height), Image::Alignment::PADDED);
+	boost::mutex::scoped_lock lm(_mutex);
+	if (!video && _request) {
+		/* Keep any new video that is still waiting to be looked at */
+		video = _request->video;
+	}
+	_request = Request{video, _component, _contrast, dcp::Size(width, height)};
+	_condition.notify_all();
+}
+
+
+void
+VideoWaveformPlot::thread ()
+{
+	start_of_thread("VideoWaveformPlot");
+
+	while (true) {
+		boost::mutex::scoped_lock lm(_mutex);
+		while (!_stop && !_request) {
+			_condition.wait(lm);
+		}
+		if (_stop) {
+			return;
+		}
+
+		auto const since = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _last_waveform).count();
+		if (since < _minimum_interval_ms) {
+			/* Don't make waveforms faster than anyone can see them; wait a little and then
+			 * take whatever the latest request is by then.
+			 */
+			_condition.timed_wait(lm, boost::posix_time::milliseconds(_minimum_interval_ms - since));
+			continue;
+		}
+
+		auto request = *_request;
+		_request = boost::none;
+		lm.unlock();
+
+		try {
+			if (request.video) {
+				/* We must copy the PlayerVideo here as we will call ::image() on it, potentially
+				   with a different pixel_format than was used when ::prepare() was called.
+				*/
+				_image = DCPVideo::convert_to_xyz(request.video->shallow_copy(), [](dcp::NoteType, string) {});
+			}
+
+			if (_image) {
+				emit(boost::bind(&VideoWaveformPlot::waveform_ready, this, create_waveform(_image, request.component, request.contrast, request.size)));
+			}
+		} catch (std::exception&) {
+			/* Just leave the last waveform we made on display */
+		}
+
+		_last_waveform = std::chrono::steady_clock::now();
+	}
+}
+
+
+void
+VideoWaveformPlot::waveform_ready (shared_ptr<const Image> waveform)
+{
+	_waveform = waveform;
+	Refresh ();
+}
+
 
+/** Make a waveform of one component of an image.  This may be called from any thread.
+ *  @param size Size of waveform to make.
+ */
+shared_ptr<const Image>
+VideoWaveformPlot::create_waveform (shared_ptr<const dcp::OpenJPEGImage> image, int component, int contrast, dcp::Size size) const
+{
+	auto const image_size = image->size();
+	int const waveform_height = size.height;
+	/* If the waveform is wider than the image we make one column per image column and then scale
+	   it up; otherwise there are one or more image columns in each waveform column.
+	*/
+	int const columns = min(image_size.width, size.width);
+
+	/* Waveform column for each image column, and the number of image columns in each waveform column */
+	vector<int> column(image_size.width);
+	vector<int> column_width(columns, 0);
 	for (int x = 0; x < image_size.width; ++x) {
+		column[x] = static_cast<int64_t>(x) * columns / image_size.width;
+		++column_width[column[x]];
+	}
+
+	/* histogram[y * columns + x] is the number of samples in waveform column x whose value
+	   falls in waveform row y (counting from the bottom).
+	*/
+	vector<int> histogram(waveform_height * columns, 0);
+
+	/* Split the image into vertical tiles, each made of whole waveform columns so that no
+	   two tiles write to the same part of the histogram.  Each tile is then scanned
+	   row by row, which reads the image in the order that it is in memory.
+	*/
+	auto const threads = std::max(1, std::min(static_cast<int>(boost::thread::hardware_concurrency()), columns / 64));
 
-		/* Work out one vertical `slice' of waveform pixels.  Each value in
-		   strip is the number of samples in image with the corresponding group of
-		   values.
-		*/
-		int strip[waveform_height];
-		memset (strip, 0, waveform_height * sizeof(int));
+	auto tile = [&](int first_column, int last_column) {
+		int x_start = 0;
+		while (x_start < image_size.width && column[x_start] < first_column) {
+			++x_start;
+		}
+		int x_end = x_start;
+		while (x_end < image_size.width && column[x_end] < last_column) {
+			++x_end;
+		}
 
-		int* ip = _image->data (_component) + x;
+		int const* bins = column.data();
 		for (int y = 0; y < image_size.height; ++y) {
-			strip[*ip * waveform_height / _pixel_values]++;
-			ip += image_size.width;
+			int const* p = image->data(component) + y * image_size.width;
+			for (int x = x_start; x < x_end; ++x) {
+				int const value = std::max(0, std::min(_pixel_values - 1, p[x]));
+				histogram[(value * waveform_height / _pixel_values) * columns + bins[x]]++;
+			}
+		}
+	};
+
+	if (threads == 1) {
+		tile(0, columns);
+	} else {
+		boost::thread_group group;
+		for (int i = 0; i < threads; ++i) {
+			group.create_thread([&tile, i, columns, threads]() { tile(i * columns / threads, (i + 1) * columns / threads); });
 		}
+		group.join_all();
+	}
+
+	auto waveform = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(columns, waveform_height), Image::Alignment::PADDED);
 
-		/* Copy slice into the waveform */
-		uint8_t* wp = _waveform->data()[0] + x * 3;
-		for (int y = waveform_height - 1; y >= 0; --y) {
-			wp[0] = wp[1] = wp[2] = min (255, (strip[y] * 255 / waveform_height) * _contrast);
-			wp += _waveform->stride()[0];
+	/* Copy the histogram into the waveform, with the lowest values at the bottom */
+	for (int y = 0; y < waveform_height; ++y) {
+		int const* h = histogram.data() + (waveform_height - y - 1) * columns;
+		uint8_t* wp = waveform->data()[0] + y * waveform->stride()[0];
+		for (int x = 0; x < columns; ++x) {
+			wp[0] = wp[1] = wp[2] = min(255, (h[x] * 255 / (waveform_height * column_width[x])) * contrast);
+			wp += 3;
 		}
 	}
 
-	_waveform = _waveform->scale (
-		dcp::Size (GetSize().GetWidth() - _x_axis_width, waveform_height),
-		dcp::YUVToRGB::REC709, AV_PIX_FMT_RGB24, Image::Alignment::COMPACT, false
-		);
+	if (columns == size.width) {
+		return waveform;
+	}
+
+	return waveform->scale(size, dcp::YUVToRGB::REC709, AV_PIX_FMT_RGB24, Image::Alignment::COMPACT, false);
 }
 
 
@@ -192,19 +330,14 @@ VideoWaveformPlot::set_image (shared_ptr<PlayerVideo> image)
 		return;
 	}
 
-	/* We must copy the PlayerVideo here as we will call ::image() on it, potentially
-	   with a different pixel_format than was used when ::prepare() was called.
-	*/
-	_image = DCPVideo::convert_to_xyz (image->shallow_copy(), [](dcp::NoteType, string) {});
-	_dirty = true;
-	Refresh ();
+	update (image);
 }
 
 
 void
 VideoWaveformPlot::sized (wxSizeEvent &)
 {
-	_dirty = true;
+	update ();
 }
 
 
@@ -219,8 +352,7 @@ void
 VideoWaveformPlot::set_component (int c)
 {
 	_component = c;
-	_dirty = true;
-	Refresh ();
+	update ();
 }
 
 
@@ -231,23 +363,17 @@ void
 VideoWaveformPlot::set_contrast (int b)
 {
 	_contrast = b;
-	_dirty = true;
-	Refresh ();
+	update ();
 }
 
 
 void
 VideoWaveformPlot::mouse_moved (wxMouseEvent& ev)
 {
-	if (!_image) {
+	if (!_waveform) {
 		return;
 	}
 
-	if (_dirty) {
-		create_waveform ();
-		_dirty = false;
-	}
-
 	auto film = _film.lock ();
 	if (!film) {
 		return;
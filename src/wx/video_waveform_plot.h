@@ -19,11 +19,16 @@
 */
 
 
+#include "lib/signaller.h"
+#include <dcp/types.h>
 #include <dcp/warnings.h>
 LIBDCP_DISABLE_WARNINGS
 #include <wx/wx.h>
 LIBDCP_ENABLE_WARNINGS
 #include <boost/signals2.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <chrono>
 
 
 namespace dcp {
@@ -36,10 +41,14 @@ class Film;
 class FilmViewer;
 
 
-class VideoWaveformPlot : public wxPanel
+/** A panel showing a waveform of the viewer's current image.  The waveform is
+ *  calculated in a background thread so that the viewer is not held up by it.
+ */
+class VideoWaveformPlot : public wxPanel, public Signaller
 {
 public:
 	VideoWaveformPlot(wxWindow* parent, std::weak_ptr<const Film> film, FilmViewer& viewer);
+	~VideoWaveformPlot();
 
 	void set_enabled (bool e);
 	void set_component (int c);
@@ -55,21 +64,49 @@ public:
 private:
 	void paint ();
 	void sized (wxSizeEvent &);
-	void create_waveform ();
+	void update (std::shared_ptr<PlayerVideo> video = {});
 	void set_image (std::shared_ptr<PlayerVideo>);
 	void mouse_moved (wxMouseEvent &);
+	void thread ();
+	void waveform_ready (std::shared_ptr<const Image> waveform);
+	std::shared_ptr<const Image> create_waveform (std::shared_ptr<const dcp::OpenJPEGImage> image, int component, int contrast, dcp::Size size) const;
 
 	std::weak_ptr<const Film> _film;
-	std::shared_ptr<dcp::OpenJPEGImage> _image;
+	/** waveform to draw; only accessed from the GUI thread */
 	std::shared_ptr<const Image> _waveform;
-	bool _dirty = true;
 	bool _enabled = false;
 	int _component = 0;
 	int _contrast = 0;
 
+	/** Details of some work for our thread to do */
+	struct Request
+	{
+		/** new video to take the waveform of, or empty to use the last one */
+		std::shared_ptr<PlayerVideo> video;
+		int component;
+		int contrast;
+		dcp::Size size;
+	};
+
+	boost::thread _thread;
+	/** mutex to protect _request and _stop */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	/** the latest thing that we have been asked to do; older requests that were never
+	 *  started are just replaced by newer ones.
+	 */
+	boost::optional<Request> _request;
+	bool _stop = false;
+	/** XYZ version of the last image we were given; only accessed from our thread */
+	std::shared_ptr<const dcp::OpenJPEGImage> _image;
+	/** time that our thread last finished a waveform */
+	std::chrono::steady_clock::time_point _last_waveform;
+
 	static int const _vertical_margin;
 	static int const _pixel_values;
 	static int const _x_axis_width;
+	/** shortest time that we leave between waveforms, so that we do not try to make them more often than they can be seen */
+	static int const _minimum_interval_ms;
 
 	boost::signals2::connection _viewer_connection;
 };
@@ -0,0 +1,77 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/active_text_test.cc
+ *  @brief Test ActiveText class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/active_text.h"
+#include "lib/string_text_file_content.h"
+#include "lib/text_content.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using namespace dcpomatic;
+
+
+BOOST_AUTO_TEST_CASE (active_text_test)
+{
+	auto content = make_shared<StringTextFileContent>("test/data/subrip.srt");
+	auto text = content->only_text();
+
+	auto seconds = [](int s) {
+		return DCPTime::from_seconds(s);
+	};
+	auto burnt = [](ActiveText const& active, DCPTime from, DCPTime to) {
+		return active.get_burnt(DCPTimePeriod(from, to), true).size();
+	};
+
+	ActiveText active;
+	BOOST_CHECK (!active.have(text));
+
+	/* Many overlapping texts, each lasting 10s */
+	for (int i = 0; i < 100; ++i) {
+		active.add_from (text, PlayerText(), seconds(i));
+		active.add_to (text, seconds(i + 10));
+	}
+
+	/* One which has not finished yet */
+	active.add_from (text, PlayerText(), seconds(50));
+
+	BOOST_CHECK (active.have(text));
+	BOOST_CHECK_EQUAL (burnt(active, DCPTime(), seconds(1)), 1U);
+	BOOST_CHECK_EQUAL (burnt(active, seconds(20), seconds(21)), 10U);
+	BOOST_CHECK_EQUAL (burnt(active, seconds(60), seconds(61)), 11U);
+	BOOST_CHECK_EQUAL (burnt(active, seconds(200), seconds(201)), 1U);
+
+	active.clear_before (seconds(60));
+	/* Texts finishing at 60s or later, and the unfinished one, should be left */
+	BOOST_CHECK_EQUAL (burnt(active, seconds(55), seconds(56)), 7U);
+	BOOST_CHECK_EQUAL (burnt(active, seconds(60), seconds(61)), 11U);
+
+	/* Finishing the unfinished one should give back its from time */
+	BOOST_CHECK (active.add_to(text, seconds(70)).second == seconds(50));
+	active.clear_before (seconds(200));
+	BOOST_CHECK (!active.have(text));
+}
@@ -28,6 +28,7 @@
 
 
 #include "lib/analyse_audio_job.h"
+#include "lib/audio_analyser.h"
 #include "lib/audio_analysis.h"
 #include "lib/audio_content.h"
 #include "lib/content_factory.h"
@@ -36,14 +37,18 @@
 #include "lib/ffmpeg_content.h"
 #include "lib/film.h"
 #include "lib/job_manager.h"
+#include "lib/maths_util.h"
+#include "lib/normalise_loudness_job.h"
 #include "lib/playlist.h"
 #include "lib/ratio.h"
 #include "test.h"
+#include <dcp/file.h>
 #include <boost/test/unit_test.hpp>
 
 
 using std::make_shared;
 using std::shared_ptr;
+using std::string;
 using std::vector;
 using namespace dcpomatic;
 
@@ -99,6 +104,55 @@ BOOST_AUTO_TEST_CASE (audio_analysis_serialisation_test)
 }
 
 
+/** Check that analyses written as XML by older versions can still be read */
+BOOST_AUTO_TEST_CASE (audio_analysis_xml_import_test)
+{
+	boost::filesystem::path const file = "build/test/audio_analysis_xml_import_test";
+	{
+		dcp::File f (file, "w");
+		BOOST_REQUIRE (f);
+		string const xml =
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<AudioAnalysis>"
+			"<Version>3</Version>"
+			"<Channel><Point><Peak>0.5</Peak><RMS>0.25</RMS></Point><Point><Peak>0.75</Peak><RMS>0.125</RMS></Point></Channel>"
+			"<Channel><Point><Peak>0.1</Peak><RMS>0.05</RMS></Point></Channel>"
+			"<SamplePeak Time=\"96000\">0.75</SamplePeak>"
+			"<SamplePeak Time=\"0\">0.1</SamplePeak>"
+			"<TruePeak>0.8</TruePeak>"
+			"<TruePeak>0.2</TruePeak>"
+			"<IntegratedLoudness>-23</IntegratedLoudness>"
+			"<SamplesPerPoint>100</SamplesPerPoint>"
+			"<SampleRate>48000</SampleRate>"
+			"</AudioAnalysis>";
+		f.checked_write (xml.c_str(), xml.length());
+	}
+
+	AudioAnalysis a (file);
+	BOOST_REQUIRE_EQUAL (a.channels(), 2);
+	BOOST_REQUIRE_EQUAL (a.points(0), 2);
+	BOOST_REQUIRE_EQUAL (a.points(1), 1);
+	BOOST_CHECK_CLOSE (a.get_point(0, 1)[AudioPoint::PEAK], 0.75, 0.1);
+	BOOST_CHECK_CLOSE (a.get_point(1, 0)[AudioPoint::RMS], 0.05, 0.1);
+	BOOST_REQUIRE_EQUAL (a.sample_peak().size(), 2U);
+	BOOST_CHECK_EQUAL (a.sample_peak()[0].time.get(), 96000);
+	BOOST_REQUIRE_EQUAL (a.true_peak().size(), 2U);
+	BOOST_REQUIRE (a.integrated_loudness());
+	BOOST_CHECK_CLOSE (*a.integrated_loudness(), -23, 0.1);
+	BOOST_CHECK (!a.loudness_range());
+
+	/* Writing it again should give the binary format, which should read back the same */
+	a.write (file);
+	AudioAnalysis b (file);
+	BOOST_REQUIRE_EQUAL (b.channels(), 2);
+	BOOST_CHECK_EQUAL (b.points(0), 2);
+	BOOST_CHECK_EQUAL (b.get_point(0, 1)[AudioPoint::PEAK], a.get_point(0, 1)[AudioPoint::PEAK]);
+	BOOST_CHECK_EQUAL (b.sample_peak()[0].time.get(), 96000);
+	BOOST_CHECK_EQUAL (*b.integrated_loudness(), *a.integrated_loudness());
+	BOOST_CHECK (!b.loudness_range());
+}
+
+
 BOOST_AUTO_TEST_CASE (audio_analysis_test)
 {
 	auto film = new_test_film ("audio_analysis_test");
@@ -218,3 +272,75 @@ BOOST_AUTO_TEST_CASE (analyse_audio_leqm_test)
 	/* The CLI tool of leqm_nrt gives this value for betty_stereo_48k.wav */
 	BOOST_CHECK_CLOSE (analysis.leqm().get_value_or(0), 88.276, 0.001);
 }
+
+
+/** Check that an analysis of content which does not overlap is made from analyses of each piece */
+BOOST_AUTO_TEST_CASE (analyse_audio_compose_test)
+{
+	auto A = content_factory("test/data/sine_440.wav")[0];
+	auto B = content_factory("test/data/white.wav")[0];
+	auto film = new_test_film2 ("analyse_audio_compose_test", { A, B });
+	B->set_position (film, A->end(film));
+
+	auto single_path = [film](shared_ptr<Content> content) {
+		auto playlist = make_shared<Playlist>();
+		playlist->add (film, content);
+		return film->audio_analysis_path(playlist);
+	};
+
+	boost::signals2::connection c;
+	JobManager::instance()->analyse_audio(film, film->playlist(), false, c, []() {});
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	/* Each piece should have been analysed separately */
+	BOOST_REQUIRE (boost::filesystem::exists(single_path(A)));
+	BOOST_REQUIRE (boost::filesystem::exists(single_path(B)));
+	auto const peak_A = AudioAnalysis(single_path(A)).overall_sample_peak().first.peak;
+	auto const peak_B = AudioAnalysis(single_path(B)).overall_sample_peak().first.peak;
+
+	AudioAnalysis first (film->audio_analysis_path(film->playlist()));
+	BOOST_CHECK_CLOSE (first.overall_sample_peak().first.peak, std::max(peak_A, peak_B), 0.1);
+	BOOST_CHECK_EQUAL (first.samples_per_point(), AudioAnalyser::samples_per_point(film->playlist()->length(film).frames_round(film->audio_frame_rate())));
+
+	/* A gain change should need no re-analysis of the pieces */
+	auto const path_A = single_path(A);
+	auto const path_B = single_path(B);
+	A->audio->set_gain (-6);
+	B->audio->set_gain (-6);
+	BOOST_CHECK (single_path(A) == path_A);
+	BOOST_CHECK (single_path(B) == path_B);
+	JobManager::instance()->analyse_audio(film, film->playlist(), false, c, []() {});
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	AudioAnalysis second (film->audio_analysis_path(film->playlist()));
+	BOOST_CHECK_CLOSE (second.overall_sample_peak().first.peak, std::max(peak_A, peak_B) * db_to_linear(-6), 0.1);
+}
+
+
+BOOST_AUTO_TEST_CASE (normalise_loudness_test)
+{
+	auto A = content_factory("test/data/sine_440.wav")[0];
+	auto B = content_factory("test/data/white.wav")[0];
+	auto film = new_test_film2 ("normalise_loudness_test", { A, B });
+	B->set_position (film, A->end(film));
+
+	auto job = make_shared<NormaliseLoudnessJob>(film, -24);
+	JobManager::instance()->add(job);
+	BOOST_REQUIRE (!wait_for_jobs());
+	BOOST_REQUIRE (job->gain());
+	BOOST_CHECK_CLOSE (A->audio->gain(), *job->gain(), 0.1);
+	BOOST_CHECK_CLOSE (B->audio->gain(), *job->gain(), 0.1);
+
+	/* The analysis for the new gains should already be there */
+	auto const path = film->audio_analysis_path(film->playlist());
+	BOOST_REQUIRE (boost::filesystem::exists(path));
+	AudioAnalysis analysis (path);
+	BOOST_REQUIRE (analysis.integrated_loudness());
+	BOOST_CHECK_CLOSE (*analysis.integrated_loudness(), -24, 1);
+
+	/* and the new gains should have been saved */
+	auto check = make_shared<Film>(film->directory());
+	check->read_metadata ();
+	BOOST_REQUIRE_EQUAL (check->content().size(), 2U);
+	BOOST_CHECK_CLOSE (check->content()[0]->audio->gain(), *job->gain(), 0.1);
+}
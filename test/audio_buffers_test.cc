@@ -344,3 +344,32 @@ BOOST_AUTO_TEST_CASE (audio_buffers_trim_start)
        }
 }
 
+
+
+/** Check that each channel is aligned and that growing and shrinking keeps what was there and silences what's new */
+BOOST_AUTO_TEST_CASE (audio_buffers_resize_test)
+{
+	AudioBuffers a (5, 77);
+	for (int i = 0; i < a.channels(); ++i) {
+		BOOST_CHECK_EQUAL (reinterpret_cast<uintptr_t>(a.data(i)) % 16, 0U);
+	}
+
+	srand (12);
+	random_fill (a);
+
+	/* Shrink, then grow again within our allocation, then grow past it */
+	for (auto frames: { 50, 70, 4000 }) {
+		a.set_frames (frames);
+		srand (12);
+		for (int i = 0; i < std::min(frames, 50); ++i) {
+			for (int j = 0; j < a.channels(); ++j) {
+				BOOST_CHECK_CLOSE (a.data(j)[i], random_float(), tolerance);
+			}
+		}
+		for (int i = 50; i < frames; ++i) {
+			for (int j = 0; j < a.channels(); ++j) {
+				BOOST_REQUIRE_EQUAL (a.data(j)[i], 0);
+			}
+		}
+	}
+}
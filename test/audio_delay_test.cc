@@ -29,7 +29,9 @@
  */
 
 
+#include "lib/audio_buffers.h"
 #include "lib/audio_content.h"
+#include "lib/audio_delay.h"
 #include "lib/dcp_content_type.h"
 #include "lib/ffmpeg_content.h"
 #include "lib/film.h"
@@ -49,6 +51,7 @@ using std::cout;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using boost::lexical_cast;
 
 
@@ -107,3 +110,31 @@ BOOST_AUTO_TEST_CASE (audio_delay_test)
 	test_audio_delay (42);
 	test_audio_delay (-66);
 }
+
+
+/* Test the AudioDelay delay line with blocks which are shorter, the same length and longer than the delay */
+BOOST_AUTO_TEST_CASE (audio_delay_line_test)
+{
+	for (auto samples: { 0, 1, 7, 960 }) {
+		AudioDelay delay (samples);
+		vector<float> out;
+		int n = 0;
+		for (auto frames: { 3, 960, 1, 2000, 5, 7, 961, 0, 400 }) {
+			auto in = make_shared<AudioBuffers>(2, frames);
+			for (int i = 0; i < frames; ++i) {
+				in->data(0)[i] = ++n;
+				in->data(1)[i] = -n;
+			}
+			auto delayed = delay.run(in);
+			BOOST_REQUIRE_EQUAL (delayed->frames(), frames);
+			for (int i = 0; i < frames; ++i) {
+				BOOST_REQUIRE_EQUAL (delayed->data(1)[i], -delayed->data(0)[i]);
+				out.push_back (delayed->data(0)[i]);
+			}
+		}
+
+		for (int i = 0; i < static_cast<int>(out.size()); ++i) {
+			BOOST_REQUIRE_EQUAL (out[i], i < samples ? 0 : i - samples + 1);
+		}
+	}
+}
@@ -49,7 +49,7 @@ audio_filter_impulse_test_one (AudioFilter& f, int block_size, int num_blocks)
 		auto out = f.run (in);
 
 		for (int j = 0; j < out->frames(); ++j) {
-			BOOST_CHECK_EQUAL (out->data()[0][j], c + j);
+			BOOST_CHECK_SMALL (out->data()[0][j] - (c + j), 1e-3f);
 		}
 
 		c += block_size;
@@ -90,9 +90,9 @@ BOOST_AUTO_TEST_CASE (audio_filter_impulse_input_test)
 	auto out = lpf.run (in);
 	for (int j = 0; j < out->frames(); ++j) {
 		if (j <= lpf._M) {
-			BOOST_CHECK_EQUAL (out->data(0)[j], lpf._ir[j]);
+			BOOST_CHECK_SMALL (out->data(0)[j] - lpf._ir[j], 1e-6f);
 		} else {
-			BOOST_CHECK_EQUAL (out->data(0)[j], 0);
+			BOOST_CHECK_SMALL (out->data(0)[j], 1e-6f);
 		}
 	}
 
@@ -105,9 +105,63 @@ BOOST_AUTO_TEST_CASE (audio_filter_impulse_input_test)
 	out = hpf.run (in);
 	for (int j = 0; j < out->frames(); ++j) {
 		if (j <= hpf._M) {
-			BOOST_CHECK_EQUAL (out->data(0)[j], hpf._ir[j]);
+			BOOST_CHECK_SMALL (out->data(0)[j] - hpf._ir[j], 1e-6f);
 		} else {
-			BOOST_CHECK_EQUAL (out->data(0)[j], 0);
+			BOOST_CHECK_SMALL (out->data(0)[j], 1e-6f);
+		}
+	}
+}
+
+
+/** Check that the FFT convolution (used for long blocks) and the direct one (used for short
+ *  blocks) both give the same as a simple convolution, and that they can be mixed.
+ */
+BOOST_AUTO_TEST_CASE (audio_filter_fft_test)
+{
+	BandPassAudioFilter filter (0.01, 0.01, 0.1);
+
+	std::vector<float> input;
+	std::vector<float> output;
+	for (auto frames: { 3000, 17, 401, 150, 9000, 1 }) {
+		auto in = make_shared<AudioBuffers>(2, frames);
+		for (int i = 0; i < frames; ++i) {
+			in->data(0)[i] = (rand() % 2000 - 1000) / 1000.0;
+			in->data(1)[i] = -in->data(0)[i];
+			input.push_back (in->data(0)[i]);
+		}
+		auto out = filter.run (in);
+		for (int i = 0; i < frames; ++i) {
+			BOOST_REQUIRE_EQUAL (out->data(1)[i], -out->data(0)[i]);
+			output.push_back (out->data(0)[i]);
+		}
+	}
+
+	for (int i = 0; i < static_cast<int>(input.size()); ++i) {
+		double s = 0;
+		for (int j = 0; j <= filter._M && j <= i; ++j) {
+			s += input[i - j] * filter._ir[j];
+		}
+		BOOST_REQUIRE_SMALL (output[i] - s, 1e-5);
+	}
+}
+
+
+/** Check that filtering straight from and to float buffers gives the same as using AudioBuffers */
+BOOST_AUTO_TEST_CASE (audio_filter_raw_test)
+{
+	BandPassAudioFilter A (0.02, 0.04, 0.1);
+	BandPassAudioFilter B (0.02, 0.04, 0.1);
+
+	for (auto frames: { 3000, 17, 401, 0, 150, 9000, 1 }) {
+		auto in = make_shared<AudioBuffers>(1, frames);
+		for (int i = 0; i < frames; ++i) {
+			in->data(0)[i] = (rand() % 2000 - 1000) / 1000.0;
+		}
+		auto a = A.run (in);
+		std::vector<float> b (frames);
+		B.run (in->data(0), frames, b.data());
+		for (int i = 0; i < frames; ++i) {
+			BOOST_REQUIRE_EQUAL (a->data(0)[i], b[i]);
 		}
 	}
 }
@@ -26,12 +26,15 @@
 
 
 #include <boost/test/unit_test.hpp>
+#include "lib/audio_buffers.h"
 #include "lib/audio_mapping.h"
 #include "lib/util.h"
 
 
 using std::list;
+using std::make_shared;
 using std::string;
+using std::vector;
 using boost::optional;
 
 
@@ -99,3 +102,42 @@ BOOST_AUTO_TEST_CASE (audio_mapping_guess_test)
 }
 
 
+
+
+/** Check remap() with a gain and a fade against doing it the obvious way */
+BOOST_AUTO_TEST_CASE (audio_mapping_remap_test)
+{
+	int const frames = 2500;
+	auto input = make_shared<AudioBuffers>(6, frames);
+	for (int i = 0; i < input->channels(); ++i) {
+		for (int j = 0; j < frames; ++j) {
+			input->data(i)[j] = (rand() % 2000 - 1000) / 1000.0;
+		}
+	}
+
+	AudioMapping mapping (6, 3);
+	mapping.set (0, 0, 1);
+	mapping.set (1, 0, 0.5);
+	mapping.set (2, 2, 0.25);
+	mapping.set (4, 2, 1);
+	mapping.set (5, 0, 0.75);
+
+	vector<float> fade (frames);
+	for (int i = 0; i < frames; ++i) {
+		fade[i] = static_cast<float>(i) / frames;
+	}
+
+	auto output = remap (input, 3, mapping, 0.5, fade);
+	BOOST_REQUIRE_EQUAL (output->channels(), 3);
+	BOOST_REQUIRE_EQUAL (output->frames(), frames);
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < frames; ++j) {
+			float s = 0;
+			for (int k = 0; k < input->channels(); ++k) {
+				s += input->data(k)[j] * mapping.get(k, i) * 0.5 * fade[j];
+			}
+			BOOST_REQUIRE_SMALL (output->data(i)[j] - s, 1e-5f);
+		}
+	}
+}
@@ -152,6 +152,44 @@ BOOST_AUTO_TEST_CASE (audio_merger_test3)
 }
 
 
+/* Overlapping pushes which span more than the merger's initial buffer, and wrap around it */
+BOOST_AUTO_TEST_CASE (audio_merger_test5)
+{
+	AudioMerger merger (sampling_rate);
+
+	push (merger, 0, 30000, 0);
+	push (merger, 0, 30000, 20000);
+	push (merger, 0, 30000, 60000);
+
+	auto tb = merger.pull (DCPTime::from_frames(40000, sampling_rate));
+	BOOST_REQUIRE_EQUAL (tb.size(), 1U);
+	BOOST_CHECK_EQUAL (tb.front().first->frames(), 40000);
+	BOOST_CHECK_EQUAL (tb.front().second.get(), 0);
+
+	push (merger, 0, 30000, 90000);
+	push (merger, 0, 10000, 95000);
+
+	tb = merger.pull (DCPTime::from_frames(200000, sampling_rate));
+	BOOST_REQUIRE_EQUAL (tb.size(), 2U);
+	BOOST_CHECK_EQUAL (tb.front().first->frames(), 10000);
+	BOOST_CHECK_EQUAL (tb.front().second.get(), DCPTime::from_frames(40000, sampling_rate).get());
+	for (int i = 0; i < 10000; ++i) {
+		BOOST_REQUIRE_EQUAL (tb.front().first->data()[0][i], 20000 + i);
+	}
+
+	/* 60000-120000 is contiguous audio, with the last push mixed into the second part */
+	BOOST_CHECK_EQUAL (tb.back().first->frames(), 60000);
+	BOOST_CHECK_EQUAL (tb.back().second.get(), DCPTime::from_frames(60000, sampling_rate).get());
+	for (int i = 0; i < 60000; ++i) {
+		int correct = i % 30000;
+		if (i >= 35000 && i < 45000) {
+			correct += i - 35000;
+		}
+		BOOST_REQUIRE_EQUAL (tb.back().first->data()[0][i], correct);
+	}
+}
+
+
 /* Reply a sequence of calls to AudioMerger that resulted in a crash */
 BOOST_AUTO_TEST_CASE (audio_merger_test4)
 {
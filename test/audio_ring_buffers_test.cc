@@ -29,12 +29,10 @@ using namespace dcpomatic;
 
 #define CANARY 9999
 
-/* XXX: these tests don't check the timestamping in AudioRingBuffers */
-
 /** Basic tests fetching the same number of channels as went in */
 BOOST_AUTO_TEST_CASE (audio_ring_buffers_test1)
 {
-	AudioRingBuffers rb;
+	AudioRingBuffers rb (6, 4096);
 
 	/* Should start off empty */
 	BOOST_CHECK_EQUAL (rb.size(), 0);
@@ -97,7 +95,7 @@ BOOST_AUTO_TEST_CASE (audio_ring_buffers_test1)
 /** Similar tests but fetching more channels than were put in */
 BOOST_AUTO_TEST_CASE (audio_ring_buffers_test2)
 {
-	AudioRingBuffers rb;
+	AudioRingBuffers rb (6, 4096);
 
 	/* Put some data in */
 	auto data = make_shared<AudioBuffers>(2, 91);
@@ -149,7 +147,7 @@ BOOST_AUTO_TEST_CASE (audio_ring_buffers_test2)
 /** Similar tests but fetching fewer channels than were put in */
 BOOST_AUTO_TEST_CASE (audio_ring_buffers_test3)
 {
-	AudioRingBuffers rb;
+	AudioRingBuffers rb (6, 4096);
 
 	/* Put some data in */
 	auto data = make_shared<AudioBuffers>(6, 91);
@@ -193,3 +191,90 @@ BOOST_AUTO_TEST_CASE (audio_ring_buffers_test3)
 	BOOST_CHECK (!rb.get(buffer, 2, 240));
 	BOOST_CHECK_EQUAL (buffer[240 * 2], CANARY);
 }
+
+
+/** Check that data which wraps around the end of the buffer comes back intact and with the right times */
+BOOST_AUTO_TEST_CASE (audio_ring_buffers_test4)
+{
+	AudioRingBuffers rb (2, 100);
+
+	int value = 0;
+	int check = 0;
+	Frame put = 0;
+	float buffer[60 * 2];
+
+	for (int i = 0; i < 10; ++i) {
+		auto data = make_shared<AudioBuffers>(2, 60);
+		for (int j = 0; j < 60; ++j) {
+			for (int k = 0; k < 2; ++k) {
+				data->data(k)[j] = value++;
+			}
+		}
+		rb.put (data, DCPTime::from_frames(put, 48000), 48000);
+		BOOST_CHECK_EQUAL (rb.size(), 60);
+
+		BOOST_CHECK (*rb.get(buffer, 2, 60) == DCPTime::from_frames(put, 48000));
+		for (int j = 0; j < 60 * 2; ++j) {
+			BOOST_REQUIRE_EQUAL (buffer[j], check++);
+		}
+		BOOST_CHECK_EQUAL (rb.size(), 0);
+		put += 60;
+	}
+}
+
+
+/** Check that the oldest data is dropped when the buffer overflows */
+BOOST_AUTO_TEST_CASE (audio_ring_buffers_test5)
+{
+	AudioRingBuffers rb (1, 100);
+
+	for (int i = 0; i < 3; ++i) {
+		auto data = make_shared<AudioBuffers>(1, 40);
+		for (int j = 0; j < 40; ++j) {
+			data->data(0)[j] = i * 40 + j;
+		}
+		rb.put (data, DCPTime::from_frames(i * 40, 48000), 48000);
+	}
+
+	BOOST_CHECK_EQUAL (rb.size(), 100);
+	BOOST_CHECK (*rb.peek() == DCPTime::from_frames(20, 48000));
+
+	float buffer[100];
+	BOOST_CHECK (*rb.get(buffer, 1, 100) == DCPTime::from_frames(20, 48000));
+	for (int i = 0; i < 100; ++i) {
+		BOOST_REQUIRE_EQUAL (buffer[i], i + 20);
+	}
+
+	rb.clear ();
+	BOOST_CHECK_EQUAL (rb.size(), 0);
+	BOOST_CHECK (!rb.peek());
+}
+
+
+/** Check putting data with a mapping */
+BOOST_AUTO_TEST_CASE (audio_ring_buffers_mapping_test)
+{
+	AudioRingBuffers rb (3, 100);
+
+	AudioMapping mapping (2, 3);
+	mapping.set (0, 0, 1);
+	mapping.set (0, 2, 0.5);
+	mapping.set (1, 2, 0.25);
+
+	auto data = make_shared<AudioBuffers>(2, 50);
+	for (int i = 0; i < 50; ++i) {
+		data->data(0)[i] = i;
+		data->data(1)[i] = i * 4;
+	}
+
+	rb.put (data, DCPTime(), 48000, mapping);
+	BOOST_CHECK_EQUAL (rb.size(), 50);
+
+	float buffer[50 * 3];
+	BOOST_CHECK (*rb.get(buffer, 3, 50) == DCPTime());
+	for (int i = 0; i < 50; ++i) {
+		BOOST_CHECK_EQUAL (buffer[i * 3], i);
+		BOOST_CHECK_EQUAL (buffer[i * 3 + 1], 0);
+		BOOST_CHECK_CLOSE (buffer[i * 3 + 2] + 1, i * 0.5 + i * 4 * 0.25 + 1, 1e-4);
+	}
+}
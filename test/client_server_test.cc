@@ -29,11 +29,13 @@
  */
 
 
+#include "lib/config.h"
 #include "lib/cross.h"
 #include "lib/dcp_video.h"
 #include "lib/dcpomatic_log.h"
 #include "lib/encode_server.h"
 #include "lib/encode_server_description.h"
+#include "lib/exceptions.h"
 #include "lib/file_log.h"
 #include "lib/image.h"
 #include "lib/j2k_image_proxy.h"
@@ -54,16 +56,24 @@ using dcp::ArrayData;
 
 
 void
-do_remote_encode (shared_ptr<DCPVideo> frame, EncodeServerDescription description, ArrayData locally_encoded)
+do_remote_encode (shared_ptr<DCPVideo> frame, EncodeServerDescription description, ArrayData locally_encoded, EncodeRequestFormat format)
 {
 	ArrayData remotely_encoded;
-	BOOST_REQUIRE_NO_THROW (remotely_encoded = frame->encode_remotely (description, 1200));
+	BOOST_REQUIRE_NO_THROW (remotely_encoded = frame->encode_remotely (description, 1200, format));
 
 	BOOST_REQUIRE_EQUAL (locally_encoded.size(), remotely_encoded.size());
 	BOOST_CHECK_EQUAL (memcmp (locally_encoded.data(), remotely_encoded.data(), locally_encoded.size()), 0);
 }
 
 
+/** Servers should understand both ways of describing a frame, so use them alternately */
+static EncodeRequestFormat
+request_format (int i)
+{
+	return (i % 2) ? EncodeRequestFormat::XML : EncodeRequestFormat::BINARY;
+}
+
+
 BOOST_AUTO_TEST_CASE (client_server_test_rgb)
 {
 	auto image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size (1998, 1080), Image::Alignment::PADDED);
@@ -133,7 +143,7 @@ BOOST_AUTO_TEST_CASE (client_server_test_rgb)
 
 	list<thread*> threads;
 	for (int i = 0; i < 8; ++i) {
-		threads.push_back (new thread (boost::bind (do_remote_encode, frame, description, locally_encoded)));
+		threads.push_back (new thread (boost::bind (do_remote_encode, frame, description, locally_encoded, request_format(i))));
 	}
 
 	for (auto i: threads) {
@@ -216,7 +226,7 @@ BOOST_AUTO_TEST_CASE (client_server_test_yuv)
 
 	list<thread*> threads;
 	for (int i = 0; i < 8; ++i) {
-		threads.push_back (new thread(boost::bind(do_remote_encode, frame, description, locally_encoded)));
+		threads.push_back (new thread(boost::bind(do_remote_encode, frame, description, locally_encoded, request_format(i))));
 	}
 
 	for (auto i: threads) {
@@ -309,7 +319,7 @@ BOOST_AUTO_TEST_CASE (client_server_test_j2k)
 
 	list<thread*> threads;
 	for (int i = 0; i < 8; ++i) {
-		threads.push_back (new thread(boost::bind(do_remote_encode, j2k_frame, description, j2k_locally_encoded)));
+		threads.push_back (new thread(boost::bind(do_remote_encode, j2k_frame, description, j2k_locally_encoded, request_format(i))));
 	}
 
 	for (auto i: threads) {
@@ -325,3 +335,67 @@ BOOST_AUTO_TEST_CASE (client_server_test_j2k)
 	delete server_thread;
 	delete server;
 }
+
+
+/** Frames should go through a server which has the same key as us, and not through one with a different key */
+BOOST_AUTO_TEST_CASE (client_server_test_key)
+{
+	ConfigRestorer cr;
+
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(1998, 1080), Image::Alignment::PADDED);
+	uint8_t* p = image->data()[0];
+	for (int y = 0; y < 1080; ++y) {
+		for (int x = 0; x < image->line_size()[0]; ++x) {
+			p[x] = (x + y) % 256;
+		}
+		p += image->stride()[0];
+	}
+
+	LogSwitcher ls (make_shared<FileLog>("build/test/client_server_test_key.log"));
+
+	auto pvf = std::make_shared<PlayerVideo>(
+		std::make_shared<RawImageProxy>(image),
+		Crop(),
+		optional<double>(),
+		dcp::Size(1998, 1080),
+		dcp::Size(1998, 1080),
+		Eyes::BOTH,
+		Part::WHOLE,
+		ColourConversion(),
+		VideoRange::FULL,
+		weak_ptr<Content>(),
+		optional<Frame>(),
+		false
+		);
+
+	auto frame = make_shared<DCPVideo>(pvf, 0, 24, 200000000, Resolution::TWO_K);
+	auto locally_encoded = frame->encode_locally ();
+
+	Config::instance()->set_encode_server_key ("correct horse battery staple");
+	auto server = new EncodeServer (true, 2);
+	auto server_thread = new thread(boost::bind(&EncodeServer::run, server));
+	dcpomatic_sleep_seconds (1);
+
+	EncodeServerDescription description ("127.0.0.1", 2, SERVER_LINK_VERSION);
+
+	list<thread*> threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.push_back (new thread(boost::bind(do_remote_encode, frame, description, locally_encoded, request_format(i))));
+	}
+
+	for (auto i: threads) {
+		i->join ();
+		delete i;
+	}
+
+	Config::instance()->set_encode_server_key ("incorrect horse battery staple");
+	BOOST_CHECK_THROW (frame->encode_remotely(description, 1200), NetworkError);
+
+	Config::instance()->unset_encode_server_key ();
+	BOOST_CHECK_THROW (frame->encode_remotely(description, 1200), NetworkError);
+
+	server->stop ();
+	server_thread->join ();
+	delete server_thread;
+	delete server;
+}
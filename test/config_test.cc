@@ -21,6 +21,7 @@
 
 #include "lib/cinema.h"
 #include "lib/config.h"
+#include "lib/metadata_writer.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 #include <fstream>
@@ -242,10 +243,68 @@ BOOST_AUTO_TEST_CASE(keep_config_if_cinemas_fail_to_load)
 	std::ofstream corrupt(cinemas.string().c_str());
 	corrupt << "foo\n";
 	corrupt.close();
-	Config::instance();
+	/* Cinemas are only read when they are first needed */
+	Config::instance()->cinemas();
 
 	/* We should have a new cinemas.xml and the old config.xml */
 	check_text_file(dir / "2.16" / "config.xml", dir / "config_backup_for_test.xml");
 	check_text_file(cinemas, dir / "cinemas_backup_for_test.xml");
 }
 
+
+BOOST_AUTO_TEST_CASE(config_cinemas_survive_write_without_being_read)
+{
+	ConfigRestorer cr;
+
+	boost::filesystem::path dir = "build/test/config_cinemas_survive_write_without_being_read";
+	Config::override_path = dir;
+	Config::drop();
+	boost::filesystem::remove_all(dir);
+	boost::filesystem::create_directories(dir);
+
+	Config::instance()->add_cinema(make_shared<Cinema>("My Great Cinema", list<string>(), "", 0, 0));
+	Config::instance()->write();
+	boost::filesystem::copy_file(dir / "cinemas.xml", dir / "backup_for_test.xml");
+
+	/* Writing the config without having looked at the cinemas must not lose them */
+	Config::drop();
+	Config::instance()->write();
+	check_text_file(dir / "backup_for_test.xml", dir / "cinemas.xml");
+
+	Config::drop();
+	BOOST_REQUIRE_EQUAL(Config::instance()->cinemas().size(), 1U);
+	BOOST_CHECK_EQUAL(Config::instance()->cinemas().front()->name, "My Great Cinema");
+}
+
+
+BOOST_AUTO_TEST_CASE(config_write_soon_only_writes_what_changed)
+{
+	ConfigRestorer cr;
+
+	boost::filesystem::path dir = "build/test/config_write_soon_only_writes_what_changed";
+	Config::override_path = dir;
+	Config::drop();
+	boost::filesystem::remove_all(dir);
+	boost::filesystem::create_directories(dir);
+	Config::instance()->write();
+
+	auto const config = dir / "2.16" / "config.xml";
+	boost::filesystem::remove(config);
+
+	Config::instance()->add_cinema(make_shared<Cinema>("My Great Cinema", list<string>(), "", 0, 0));
+	Config::instance()->write_soon(Config::CINEMAS);
+	MetadataWriter::instance()->flush();
+
+	/* Only the cinemas should have been written */
+	BOOST_CHECK(!boost::filesystem::exists(config));
+
+	Config::instance()->set_master_encoding_threads(7);
+	Config::instance()->write_soon(Config::OTHER);
+	MetadataWriter::instance()->flush();
+	BOOST_CHECK(boost::filesystem::exists(config));
+
+	Config::drop();
+	BOOST_CHECK_EQUAL(Config::instance()->master_encoding_threads(), 7);
+	BOOST_REQUIRE_EQUAL(Config::instance()->cinemas().size(), 1U);
+	BOOST_CHECK_EQUAL(Config::instance()->cinemas().front()->name, "My Great Cinema");
+}
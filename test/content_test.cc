@@ -30,11 +30,16 @@
 #include "lib/dcp_content_type.h"
 #include "lib/content_factory.h"
 #include "lib/content.h"
+#include "lib/examine_content_job.h"
+#include "lib/job_manager.h"
+#include "lib/playlist.h"
 #include "lib/ratio.h"
+#include "lib/signal_manager.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 
 
+using std::make_shared;
 using std::shared_ptr;
 using namespace dcpomatic;
 
@@ -174,3 +179,60 @@ BOOST_AUTO_TEST_CASE (content_test7)
 	content[0]->audio->set_delay(-1000);
 	make_and_verify_dcp (film, { dcp::VerificationNote::Code::INVALID_PICTURE_FRAME_RATE_FOR_2K });
 }
+
+
+/** Adding several pieces of content at once should put them one after the other, with only one change to the film's content */
+BOOST_AUTO_TEST_CASE (content_add_batch_test)
+{
+	auto film = new_test_film2 ("content_add_batch_test");
+
+	ContentList content;
+	for (int i = 0; i < 3; ++i) {
+		content.push_back (content_factory("test/data/flat_red.png")[0]);
+		JobManager::instance()->add (make_shared<ExamineContentJob>(film, content.back()));
+	}
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	int changes = 0;
+	auto connection = film->Change.connect([&changes](ChangeType type, Film::Property property) {
+		if (type == ChangeType::DONE && property == Film::Property::CONTENT) {
+			++changes;
+		}
+	});
+
+	film->add_content (content);
+	while (signal_manager->ui_idle()) {}
+
+	BOOST_CHECK_EQUAL (changes, 1);
+	BOOST_REQUIRE_EQUAL (film->content().size(), 3U);
+	BOOST_CHECK (content[0]->position() == DCPTime());
+	BOOST_CHECK (content[1]->position() == content[0]->end(film));
+	BOOST_CHECK (content[2]->position() == content[1]->end(film));
+}
+
+
+/** A snapshot of the playlist's content should not change when the playlist does */
+BOOST_AUTO_TEST_CASE (content_snapshot_test)
+{
+	auto red = content_factory("test/data/flat_red.png")[0];
+	auto film = new_test_film2 ("content_snapshot_test", { red });
+
+	auto before = film->playlist()->content_snapshot();
+	BOOST_REQUIRE_EQUAL (before->size(), 1U);
+
+	auto blue = content_factory("test/data/flat_black.png")[0];
+	film->examine_and_add_content (blue);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	BOOST_CHECK_EQUAL (before->size(), 1U);
+	auto after = film->playlist()->content_snapshot();
+	BOOST_REQUIRE_EQUAL (after->size(), 2U);
+	BOOST_CHECK (after->front() == red);
+	BOOST_CHECK (after->back() == blue);
+	BOOST_CHECK (film->content() == *after);
+
+	film->remove_content (red);
+	BOOST_CHECK_EQUAL (after->size(), 2U);
+	BOOST_REQUIRE_EQUAL (film->playlist()->content_snapshot()->size(), 1U);
+	BOOST_CHECK (film->playlist()->content_snapshot()->front() == blue);
+}
@@ -0,0 +1,128 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/cpu_dispatch_test.cc
+ *  @brief Test the choice of kernel implementations at run time, and check that the
+ *  implementations that we have give the same answers as the scalar versions.
+ */
+
+
+#include "lib/cpu_dispatch.h"
+#include "lib/crc32c.h"
+#include "lib/image.h"
+#include "lib/maths_util.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+
+
+using std::make_shared;
+using std::vector;
+using namespace dcpomatic::cpu;
+
+
+BOOST_AUTO_TEST_CASE (cpu_dispatch_force_test)
+{
+	force (ISA::SCALAR);
+	BOOST_REQUIRE (!choices().empty());
+	for (auto const& i: choices()) {
+		BOOST_CHECK_MESSAGE (i.second == ISA::SCALAR, i.first);
+	}
+
+	force ({});
+	for (auto const& i: choices()) {
+		BOOST_CHECK_MESSAGE (supported(i.second), i.first);
+	}
+
+	BOOST_CHECK (isa_from_name("avx2") == ISA::AVX2);
+	BOOST_CHECK (isa_from_name(isa_name(ISA::SSE4_2)) == ISA::SSE4_2);
+	BOOST_CHECK (!isa_from_name("mmx"));
+}
+
+
+BOOST_AUTO_TEST_CASE (cpu_dispatch_audio_kernels_match_scalar_test)
+{
+	/* An odd length so that every implementation has some left over for its scalar tail */
+	int const N = 1001;
+
+	vector<float> source (N);
+	vector<float> curve (N);
+	for (int i = 0; i < N; ++i) {
+		source[i] = static_cast<float>(rand()) / RAND_MAX - 0.5;
+		curve[i] = static_cast<float>(i) / N;
+	}
+
+	auto run = [&]() {
+		vector<float> out (N, 0.25);
+		accumulate_samples (out.data(), source.data(), N, 0.7);
+		scale_samples (out.data(), N, 1.3);
+		multiply_samples (out.data(), curve.data(), N);
+		return out;
+	};
+
+	force (ISA::SCALAR);
+	auto const scalar = run ();
+	force ({});
+	auto const best = run ();
+
+	BOOST_CHECK (scalar == best);
+}
+
+
+BOOST_AUTO_TEST_CASE (cpu_dispatch_image_kernels_match_scalar_test)
+{
+	for (auto format: { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_RGB24, AV_PIX_FMT_RGB48LE }) {
+		auto original = make_shared<Image>(format, dcp::Size(1999, 31), Image::Alignment::PADDED);
+		for (int c = 0; c < original->planes(); ++c) {
+			for (int y = 0; y < original->sample_size(c).height; ++y) {
+				auto p = original->data()[c] + y * original->stride()[c];
+				for (int x = 0; x < original->line_size()[c]; ++x) {
+					/* In the 16-bit formats this keeps the (little-endian) samples to 10 bits */
+					p[x] = (x % 2) ? (rand() % 4) : (rand() % 256);
+				}
+			}
+		}
+
+		force (ISA::SCALAR);
+		auto scalar = make_shared<Image>(*original);
+		scalar->fade (0.37);
+		force ({});
+		auto best = make_shared<Image>(*original);
+		best->fade (0.37);
+
+		BOOST_CHECK (*scalar == *best);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE (cpu_dispatch_crc32c_matches_scalar_test)
+{
+	vector<uint8_t> data (4099);
+	for (auto& i: data) {
+		i = rand() % 256;
+	}
+
+	force (ISA::SCALAR);
+	auto const scalar = crc32c (0, data.data(), data.size());
+	force ({});
+	BOOST_CHECK_EQUAL (crc32c(0, data.data(), data.size()), scalar);
+	/* Known value for "123456789" */
+	BOOST_CHECK_EQUAL (crc32c(0, reinterpret_cast<uint8_t const*>("123456789"), 9), 0xe3069283);
+}
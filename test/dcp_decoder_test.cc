@@ -31,12 +31,20 @@
 #include "lib/dcp_decoder.h"
 #include "lib/examine_content_job.h"
 #include "lib/film.h"
+#include "lib/j2k_image_proxy.h"
 #include "lib/job_manager.h"
 #include "lib/piece.h"
 #include "lib/player.h"
+#include "lib/util.h"
+#include "lib/video_decoder.h"
 #include "test.h"
 #include <dcp/cpl.h>
 #include <dcp/dcp.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/reel.h>
+#include <dcp/reel_picture_asset.h>
 #include <boost/test/unit_test.hpp>
 #include <iostream>
 
@@ -137,3 +145,70 @@ BOOST_AUTO_TEST_CASE (check_reuse_old_data_test)
 	BOOST_REQUIRE (decoder);
 	BOOST_REQUIRE (reels != decoder->reels());
 }
+
+
+/** Check that frames of an encrypted DCP, which DCPDecoder reads ahead in several threads,
+ *  come out in order and the same as they are in the asset, including after a seek.
+ */
+BOOST_AUTO_TEST_CASE (dcp_decoder_prefetches_encrypted_frames_test)
+{
+	auto content = content_factory("test/data/test.mp4");
+	auto encrypted = new_test_film2 ("dcp_decoder_prefetches_encrypted_frames", content);
+	encrypted->set_encrypted (true);
+	make_and_verify_dcp (encrypted);
+
+	dcp::DCP dcp (encrypted->dir(encrypted->dcp_name()));
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+
+	auto kdm = encrypted->make_kdm (
+		Config::instance()->decryption_chain()->leaf(),
+		vector<string>(),
+		dcp.cpls().front()->file().get(),
+		dcp::LocalTime ("2030-07-21T00:00:00+00:00"),
+		dcp::LocalTime ("2031-07-21T00:00:00+00:00"),
+		dcp::Formulation::MODIFIED_TRANSITIONAL_1,
+		true, 0
+		);
+
+	auto dcp_content = make_shared<DCPContent>(encrypted->dir(encrypted->dcp_name()));
+	dcp_content->add_kdm (kdm);
+	auto test = new_test_film2 ("dcp_decoder_prefetches_encrypted_frames_test", { dcp_content });
+
+	dcp.add (decrypt_kdm_with_helpful_error(kdm));
+	auto asset = std::dynamic_pointer_cast<dcp::MonoPictureAsset>(dcp.cpls().front()->reels().front()->main_picture()->asset());
+	BOOST_REQUIRE (asset);
+	auto reader = asset->start_read ();
+
+	DCPDecoder decoder (test, dcp_content, false, false, shared_ptr<DCPDecoder>());
+
+	vector<ContentVideo> frames;
+	decoder.video->Data.connect ([&frames](ContentVideo cv) {
+		frames.push_back (cv);
+	});
+
+	auto check = [&](Frame first, int count) {
+		frames.clear ();
+		while (static_cast<int>(frames.size()) < count) {
+			BOOST_REQUIRE (!decoder.pass());
+		}
+		for (int i = 0; i < count; ++i) {
+			BOOST_REQUIRE_EQUAL (frames[i].frame, first + i);
+			auto proxy = std::dynamic_pointer_cast<const J2KImageProxy>(frames[i].image);
+			BOOST_REQUIRE (proxy);
+			auto const original = reader->get_frame (first + i);
+			BOOST_REQUIRE_EQUAL (proxy->j2k()->size(), original->size());
+			BOOST_CHECK (memcmp(proxy->j2k()->data(), original->data(), original->size()) == 0);
+		}
+	};
+
+	check (0, 30);
+
+	decoder.seek (dcpomatic::ContentTime::from_frames(100, 24), true);
+	frames.clear ();
+	while (frames.empty() || frames.back().frame < 100) {
+		BOOST_REQUIRE (!decoder.pass());
+	}
+	auto const after_seek = frames.back().frame;
+	check (after_seek + 1, 20);
+}
@@ -0,0 +1,95 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/dcp_examiner_test.cc
+ *  @brief Test DCPExaminer class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/content_factory.h"
+#include "lib/dcp_content.h"
+#include "lib/dcp_examiner.h"
+#include "lib/film.h"
+#include "lib/font.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+
+
+/** Check that a second examination of the same DCP comes from the cache, gives the same
+ *  answers as the first, and that changing one of the DCP's files means it is examined again.
+ */
+BOOST_AUTO_TEST_CASE (dcp_examiner_cache_test)
+{
+	auto video = content_factory("test/data/flat_red.png")[0];
+	auto text = content_factory("test/data/subrip.srt")[0];
+	auto film = new_test_film2("dcp_examiner_cache_test", { video, text });
+	make_and_verify_dcp(
+		film,
+		{
+			dcp::VerificationNote::Code::MISSING_SUBTITLE_LANGUAGE,
+			dcp::VerificationNote::Code::INVALID_SUBTITLE_FIRST_TEXT_TIME
+		});
+
+	auto content = make_shared<DCPContent>(film->dir(film->dcp_name()));
+
+	auto first = DCPExaminer::cached_or_new(content, true);
+	BOOST_CHECK(!first->from_cache());
+
+	auto second = DCPExaminer::cached_or_new(content, true);
+	BOOST_REQUIRE(second->from_cache());
+
+	BOOST_CHECK_EQUAL(first->has_video(), second->has_video());
+	BOOST_CHECK(first->video_size() == second->video_size());
+	BOOST_CHECK_EQUAL(first->video_length(), second->video_length());
+	BOOST_CHECK_EQUAL(first->has_audio(), second->has_audio());
+	BOOST_CHECK_EQUAL(first->audio_length(), second->audio_length());
+	BOOST_CHECK_EQUAL(first->name(), second->name());
+	BOOST_CHECK_EQUAL(first->cpl(), second->cpl());
+	BOOST_CHECK(first->standard() == second->standard());
+	BOOST_CHECK(first->reel_lengths() == second->reel_lengths());
+	BOOST_CHECK_EQUAL(first->text_count(TextType::OPEN_SUBTITLE), second->text_count(TextType::OPEN_SUBTITLE));
+
+	auto first_fonts = first->fonts();
+	auto second_fonts = second->fonts();
+	BOOST_REQUIRE_EQUAL(first_fonts.size(), second_fonts.size());
+	for (size_t i = 0; i < first_fonts.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(first_fonts[i].size(), second_fonts[i].size());
+		for (size_t j = 0; j < first_fonts[i].size(); ++j) {
+			BOOST_CHECK(*first_fonts[i][j] == *second_fonts[i][j]);
+			auto const first_data = first_fonts[i][j]->data();
+			auto const second_data = second_fonts[i][j]->data();
+			BOOST_REQUIRE_EQUAL(static_cast<bool>(first_data), static_cast<bool>(second_data));
+			if (first_data) {
+				BOOST_CHECK(*first_data == *second_data);
+			}
+		}
+	}
+
+	auto const cpl = dcp_file(film, "cpl");
+	boost::filesystem::last_write_time(cpl, boost::filesystem::last_write_time(cpl) + 60);
+
+	auto third = DCPExaminer::cached_or_new(content, true);
+	BOOST_CHECK(!third->from_cache());
+}
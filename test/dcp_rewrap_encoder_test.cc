@@ -0,0 +1,105 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/dcp_rewrap_encoder_test.cc
+ *  @brief Test DCPRewrapEncoder.
+ *  @ingroup feature
+ */
+
+
+#include "lib/content_factory.h"
+#include "lib/dcp_content.h"
+#include "lib/dcp_rewrap_encoder.h"
+#include "lib/film.h"
+#include "lib/video_content.h"
+#include "test.h"
+#include <dcp/cpl.h>
+#include <dcp/dcp.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/reel.h>
+#include <dcp/reel_picture_asset.h>
+#include <boost/test/unit_test.hpp>
+
+
+using std::dynamic_pointer_cast;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+
+static vector<shared_ptr<const dcp::MonoPictureFrame>>
+picture_frames (boost::filesystem::path dir)
+{
+	dcp::DCP dcp (dir);
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+
+	vector<shared_ptr<const dcp::MonoPictureFrame>> frames;
+	for (auto reel: dcp.cpls()[0]->reels()) {
+		auto asset = dynamic_pointer_cast<dcp::MonoPictureAsset>(reel->main_picture()->asset());
+		BOOST_REQUIRE (asset);
+		auto reader = asset->start_read ();
+		for (int64_t i = 0; i < reel->main_picture()->duration(); ++i) {
+			frames.push_back (reader->get_frame(reel->main_picture()->entry_point().get_value_or(0) + i));
+		}
+	}
+
+	return frames;
+}
+
+
+/** Re-split a DCP into reels and check that the picture frames are copied as they were */
+BOOST_AUTO_TEST_CASE (dcp_rewrap_encoder_test)
+{
+	auto red = content_factory("test/data/flat_red.png");
+	auto A = new_test_film2 ("dcp_rewrap_encoder_test_a", red);
+	red[0]->video->set_length (24 * 6);
+	make_and_verify_dcp (A);
+
+	auto dcp = make_shared<DCPContent>(A->dir(A->dcp_name()));
+	auto B = new_test_film2 ("dcp_rewrap_encoder_test_b", { dcp });
+	B->set_j2k_bandwidth (100000000);
+	B->set_reel_type (ReelType::BY_LENGTH);
+	/* This is just over 2.5s at 100Mbit/s; should correspond to 60 frames */
+	B->set_reel_length (31253154);
+	BOOST_REQUIRE (DCPRewrapEncoder::possible(B));
+
+	make_and_verify_dcp (B);
+
+	dcp::DCP check (B->dir(B->dcp_name()));
+	check.read ();
+	BOOST_REQUIRE_EQUAL (check.cpls().size(), 1U);
+	BOOST_CHECK_EQUAL (check.cpls()[0]->reels().size(), 3U);
+
+	auto before = picture_frames (A->dir(A->dcp_name()));
+	auto after = picture_frames (B->dir(B->dcp_name()));
+	BOOST_REQUIRE_EQUAL (before.size(), after.size());
+	for (size_t i = 0; i < before.size(); ++i) {
+		BOOST_REQUIRE_EQUAL (before[i]->size(), after[i]->size());
+		BOOST_CHECK_EQUAL (memcmp(before[i]->data(), after[i]->data(), before[i]->size()), 0);
+	}
+
+	/* Anything that changes the picture means we must go through the Player */
+	dcp->video->set_left_crop (2);
+	BOOST_CHECK (!DCPRewrapEncoder::possible(B));
+}
@@ -350,3 +350,27 @@ BOOST_AUTO_TEST_CASE (dcpomatic_time_floor_test)
 	/* Check that rounding down to non-integer frame rates works */
 	BOOST_CHECK_EQUAL (DCPTime(45312).floor(29.976).get(), 44836);
 }
+
+/* Check that FrameTimes gives the same answers as DCPTime::from_frames and DCPTime::frames_floor */
+BOOST_AUTO_TEST_CASE (dcpomatic_frame_times_test)
+{
+	for (auto rate: { 23.976, 24.0, 25.0, 29.97, 30.0, 48.0, 50.0, 60.0, 120.0, 44100.0, 48000.0, 96000.0 }) {
+		FrameTimes<DCPTime> times (rate);
+		BOOST_CHECK_EQUAL (times.rate(), rate);
+		for (int64_t frame = 0; frame < 2000; frame += 7) {
+			BOOST_CHECK_EQUAL (times.from_frames(frame).get(), DCPTime::from_frames(frame, rate).get());
+		}
+		for (int64_t t = 0; t < 1000000; t += 997) {
+			BOOST_CHECK_EQUAL (times.frames_floor(DCPTime(t)), DCPTime(t).frames_floor(rate));
+			BOOST_CHECK_EQUAL (times.frames_floor(DCPTime(-t)), DCPTime(-t).frames_floor(rate));
+		}
+	}
+
+	/* Times on and just before frame boundaries */
+	FrameTimes<DCPTime> times (24);
+	BOOST_CHECK_EQUAL (times.frames_floor(DCPTime(4000)), 1);
+	BOOST_CHECK_EQUAL (times.frames_floor(DCPTime(3999)), 0);
+	BOOST_CHECK_EQUAL (times.frames_floor(DCPTime(-1)), -1);
+	BOOST_CHECK_EQUAL (times.frames_floor(DCPTime(-4000)), -1);
+	BOOST_CHECK_EQUAL (times.frames_floor(DCPTime(-4001)), -2);
+}
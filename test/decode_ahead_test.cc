@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/decode_ahead_test.cc
+ *  @brief Test DecodeAhead class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/decode_ahead.h"
+#include "lib/decoder.h"
+#include <boost/signals2.hpp>
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+using std::weak_ptr;
+using namespace dcpomatic;
+
+
+/** Decoder which emits two numbers per pass, and is done after 10 passes */
+class CountingDecoder : public Decoder
+{
+public:
+	CountingDecoder ()
+		: Decoder (weak_ptr<const Film>())
+	{}
+
+	bool pass () override {
+		Emit (_next * 2);
+		Emit (_next * 2 + 1);
+		++_next;
+		return _next == 10;
+	}
+
+	void seek (ContentTime time, bool) override {
+		_next = time.get();
+	}
+
+	ContentTime position () const override {
+		return ContentTime(_next);
+	}
+
+	boost::signals2::signal<void (int)> Emit;
+
+private:
+	int _next = 0;
+};
+
+
+static
+void
+check (int queue_length)
+{
+	auto decoder = make_shared<CountingDecoder>();
+	auto ahead = make_shared<DecodeAhead>(decoder, queue_length);
+
+	vector<int> emitted;
+	weak_ptr<DecodeAhead> weak_ahead = ahead;
+	decoder->Emit.connect ([weak_ahead, &emitted](int n) {
+		if (auto a = weak_ahead.lock()) {
+			a->emit ([&emitted, n]() { emitted.push_back(n); });
+		}
+	});
+
+	/* Everything should come out in order, and only when we ask for the pass that emitted it */
+	for (int i = 0; i < 4; ++i) {
+		BOOST_CHECK (ahead->position() == ContentTime(i));
+		BOOST_CHECK (!ahead->pass());
+		BOOST_REQUIRE_EQUAL (emitted.size(), static_cast<size_t>((i + 1) * 2));
+		BOOST_CHECK_EQUAL (emitted.back(), i * 2 + 1);
+	}
+
+	/* Anything that was decoded ahead should be forgotten after a seek */
+	ahead->seek (ContentTime(7), true);
+	emitted.clear ();
+	BOOST_CHECK (ahead->position() == ContentTime(7));
+	BOOST_CHECK (!ahead->pass());
+	BOOST_CHECK (!ahead->pass());
+	BOOST_CHECK (ahead->pass());
+	BOOST_CHECK (emitted == vector<int>({14, 15, 16, 17, 18, 19}));
+}
+
+
+BOOST_AUTO_TEST_CASE (decode_ahead_test)
+{
+	check (0);
+	check (3);
+}
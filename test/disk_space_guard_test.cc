@@ -0,0 +1,70 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/disk_space_guard.h"
+#include <boost/test/unit_test.hpp>
+
+
+BOOST_AUTO_TEST_CASE (disk_space_guard_estimate_test)
+{
+	DiskSpaceGuard guard (1000, 10);
+
+	/* Nothing has been written yet so we have to use the constant-rate guess */
+	BOOST_CHECK_EQUAL (guard.needed(100), 100 * 1010);
+
+	/* Then the frames that have been written tell us better */
+	guard.frame_written (200);
+	guard.frame_written (400);
+	BOOST_CHECK_EQUAL (guard.needed(100), 100 * 310);
+	BOOST_CHECK_EQUAL (guard.needed(0), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE (disk_space_guard_state_test)
+{
+	int64_t const frame_size = 100000000;
+	DiskSpaceGuard guard (frame_size, 0);
+
+	/* Plenty of space: nothing to say */
+	BOOST_CHECK (!guard.check(DiskSpaceGuard::margin + 20 * frame_size, 10));
+	BOOST_CHECK (guard.state() == DiskSpaceGuard::State::OK);
+
+	/* Not quite enough for what's left */
+	auto state = guard.check(DiskSpaceGuard::margin + 5 * frame_size, 10);
+	BOOST_REQUIRE (state);
+	BOOST_CHECK (*state == DiskSpaceGuard::State::LOW);
+	BOOST_CHECK (!guard.check(DiskSpaceGuard::margin + 4 * frame_size, 10));
+
+	/* Frames coming out smaller than expected mean the rest will fit after all */
+	for (int i = 0; i < 10; ++i) {
+		guard.frame_written (frame_size / 4);
+	}
+	state = guard.check(DiskSpaceGuard::margin + 4 * frame_size, 10);
+	BOOST_REQUIRE (state);
+	BOOST_CHECK (*state == DiskSpaceGuard::State::OK);
+
+	/* About to run out altogether */
+	state = guard.check(DiskSpaceGuard::margin - 1, 10);
+	BOOST_REQUIRE (state);
+	BOOST_CHECK (*state == DiskSpaceGuard::State::FULL);
+	BOOST_CHECK (!guard.check(DiskSpaceGuard::margin / 2, 10));
+	BOOST_CHECK (guard.state() == DiskSpaceGuard::State::FULL);
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/cross.h"
+#include "lib/drive_watcher.h"
+#include "lib/signal_manager.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::string;
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (drive_watcher_test)
+{
+	boost::mutex mutex;
+	vector<Drive> attached;
+	int looks = 0;
+
+	auto get = [&mutex, &attached, &looks]() {
+		boost::mutex::scoped_lock lm (mutex);
+		++looks;
+		return attached;
+	};
+
+	auto wait_for_looks = [&mutex, &looks](int n) {
+		for (int i = 0; i < 500; ++i) {
+			{
+				boost::mutex::scoped_lock lm (mutex);
+				if (looks >= n) {
+					break;
+				}
+			}
+			dcpomatic_sleep_milliseconds (10);
+		}
+	};
+
+	vector<vector<Drive>> changes;
+
+	/* Long interval so that we only look when we start or are asked to */
+	DriveWatcher watcher (get, 60);
+	watcher.Changed.connect([&changes](vector<Drive> drives) {
+		changes.push_back (drives);
+	});
+
+	auto wait_for_changes = [&changes](size_t n) {
+		for (int i = 0; i < 500 && changes.size() < n; ++i) {
+			while (signal_manager->ui_idle()) {}
+			dcpomatic_sleep_milliseconds (10);
+		}
+	};
+
+	/* The first look is always reported, even if nothing is found */
+	wait_for_changes (1);
+	BOOST_REQUIRE_EQUAL (changes.size(), 1U);
+	BOOST_CHECK (changes[0].empty());
+	BOOST_REQUIRE (watcher.drives());
+	BOOST_CHECK (watcher.drives()->empty());
+
+	/* Looking again and finding the same thing is not */
+	watcher.refresh ();
+	wait_for_looks (2);
+	dcpomatic_sleep_milliseconds (100);
+	while (signal_manager->ui_idle()) {}
+	BOOST_CHECK_EQUAL (changes.size(), 1U);
+
+	/* but a new drive is */
+	{
+		boost::mutex::scoped_lock lm (mutex);
+		attached.push_back (Drive("/dev/sdb", {}, 2000000000000, string("Fred"), string("Jim")));
+	}
+	watcher.refresh ();
+	wait_for_changes (2);
+	BOOST_REQUIRE_EQUAL (changes.size(), 2U);
+	BOOST_REQUIRE_EQUAL (changes[1].size(), 1U);
+	BOOST_CHECK_EQUAL (changes[1][0].device(), "/dev/sdb");
+	BOOST_REQUIRE (watcher.drives());
+	BOOST_CHECK_EQUAL (watcher.drives()->size(), 1U);
+}
@@ -181,3 +181,53 @@ BOOST_AUTO_TEST_CASE (empty_test_with_overlapping_content)
 	BOOST_REQUIRE (black._periods.empty());
 }
 
+
+
+/** Check that Empty::update() gives the same result as starting again */
+BOOST_AUTO_TEST_CASE (empty_test_update)
+{
+	auto film = new_test_film2 ("empty_test_update");
+	film->set_sequence (false);
+	auto contentA = make_shared<ImageContent>("test/data/simple_testcard_640x480.png");
+	auto contentB = make_shared<ImageContent>("test/data/simple_testcard_640x480.png");
+
+	film->examine_and_add_content (contentA);
+	film->examine_and_add_content (contentB);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	int const vfr = film->video_frame_rate ();
+
+	/* 0 1 2 3 4 5 6 7
+	 *     A A A     B
+	 */
+	contentA->video->set_length (3);
+	contentA->set_position (film, DCPTime::from_frames(2, vfr));
+	contentB->video->set_length (1);
+	contentB->set_position (film, DCPTime::from_frames(7, vfr));
+
+	Empty black (film, film->playlist(), bind(&has_video, _1), film->playlist()->length(film));
+	BOOST_REQUIRE_EQUAL (black._periods.size(), 2U);
+
+	/* 0 1 2 3 4 5 6 7
+	 *     A A A B
+	 */
+	contentB->set_position (film, DCPTime::from_frames(5, vfr));
+	black.update (film, contentB, film->playlist()->length(film));
+	BOOST_REQUIRE_EQUAL (black._periods.size(), 1U);
+	BOOST_CHECK (black._periods.front().from == DCPTime::from_frames(0, vfr));
+	BOOST_CHECK (black._periods.front().to == DCPTime::from_frames(2, vfr));
+	BOOST_CHECK (black.position() == DCPTime::from_frames(0, vfr));
+
+	/* 0 1 2 3 4 5 6 7
+	 * B   A A A
+	 */
+	contentB->set_position (film, DCPTime());
+	black.update (film, contentB, film->playlist()->length(film));
+
+	Empty fresh (film, film->playlist(), bind(&has_video, _1), film->playlist()->length(film));
+	BOOST_REQUIRE_EQUAL (black._periods.size(), fresh._periods.size());
+	BOOST_REQUIRE_EQUAL (black._periods.size(), 1U);
+	BOOST_CHECK (black._periods.front() == fresh._periods.front());
+	BOOST_CHECK (black._periods.front().from == DCPTime::from_frames(1, vfr));
+	BOOST_CHECK (black._periods.front().to == DCPTime::from_frames(2, vfr));
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/audio_mapping.h"
+#include "lib/content_factory.h"
+#include "lib/export_sink.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/ffmpeg_encoder.h"
+#include "lib/ffmpeg_examiner.h"
+#include "lib/film.h"
+#include "lib/make_dcp.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::dynamic_pointer_cast;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+
+/** Make a DCP, a screener and some audio stems in one pass */
+BOOST_AUTO_TEST_CASE (export_sink_test)
+{
+	auto video = content_factory("test/data/flat_red.png")[0];
+	auto audio = content_factory("test/data/staircase.wav")[0];
+	auto film = new_test_film2 ("export_sink_test", { video, audio });
+	film->set_audio_channels (6);
+
+	auto const screener = film->file("screener.mp4");
+	auto const stems = film->file("stems");
+	auto const size = dcp::Size(film->frame_size().width / 2, film->frame_size().height / 2);
+
+	AudioMapping map(6, 6);
+	for (int i = 0; i < 6; ++i) {
+		map.set (i, i, 1);
+	}
+
+	vector<shared_ptr<ExportSink>> sinks = {
+		make_shared<VideoFileExportSink>(film, screener, ExportFormat::H264_AAC, size, FFmpegEncoder::stereo_map(6), 23),
+		make_shared<AudioStemsExportSink>(film, stems, map, AudioStemsExportSink::channel_names(film))
+	};
+
+	film->write_metadata ();
+	make_dcp (film, TranscodeJob::ChangedBehaviour::IGNORE, sinks);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	BOOST_CHECK (boost::filesystem::is_directory(film->dir(film->dcp_name())));
+
+	auto screener_content = dynamic_pointer_cast<FFmpegContent>(content_factory(screener)[0]);
+	BOOST_REQUIRE (screener_content);
+	FFmpegExaminer examiner(screener_content);
+	BOOST_CHECK_EQUAL (examiner.video_length(), film->length().frames_round(24));
+	BOOST_CHECK_EQUAL (examiner.video_size().width, size.width);
+	BOOST_CHECK_EQUAL (examiner.video_size().height, size.height);
+
+	auto const stem_size = 44 + film->length().frames_round(film->audio_frame_rate()) * 3;
+	for (auto name: AudioStemsExportSink::channel_names(film)) {
+		BOOST_CHECK_EQUAL (static_cast<int64_t>(boost::filesystem::file_size(stems / (name + ".wav"))), stem_size);
+	}
+}
@@ -57,6 +57,14 @@ ffmpeg_content_test (int number, boost::filesystem::path content, ExportFormat f
 		name += "h264";
 		extension = "mp4";
 		break;
+	case ExportFormat::H264_HARDWARE_AAC:
+		name += "h264-hardware";
+		extension = "mp4";
+		break;
+	case ExportFormat::HEVC_HARDWARE_AAC:
+		name += "hevc-hardware";
+		extension = "mp4";
+		break;
 	case ExportFormat::PRORES_4444:
 		name += "prores-444";
 		extension = "mov";
@@ -190,6 +198,13 @@ BOOST_AUTO_TEST_CASE (ffmpeg_encoder_h264_test1)
 }
 
 
+/** Red / green / blue MP4 -> H264 using a hardware encoder, or x264 if there isn't one */
+BOOST_AUTO_TEST_CASE (ffmpeg_encoder_h264_hardware_test1)
+{
+	ffmpeg_content_test(1, "test/data/test.mp4", ExportFormat::H264_HARDWARE_AAC);
+}
+
+
 /** Just subtitles -> H264 */
 BOOST_AUTO_TEST_CASE (ffmpeg_encoder_h264_test2)
 {
@@ -488,3 +503,28 @@ BOOST_AUTO_TEST_CASE (ffmpeg_encoder_prores_regression_2)
 	dcpomatic_log->set_types(logs);
 }
 
+
+
+/** Check that a film is split into segments for a parallel export at its reel boundaries where it can be */
+BOOST_AUTO_TEST_CASE (ffmpeg_encoder_segments_test)
+{
+	auto content1 = content_factory("test/data/flat_red.png")[0];
+	auto content2 = content_factory("test/data/flat_red.png")[0];
+	auto film = new_test_film2 ("ffmpeg_encoder_segments_test", { content1, content2 });
+	film->set_reel_type (ReelType::BY_VIDEO_CONTENT);
+	content1->video->set_length (230);
+	content2->video->set_length (250);
+
+	auto two = FFmpegEncoder::segments(film, 2);
+	BOOST_REQUIRE_EQUAL (two.size(), 2U);
+	BOOST_CHECK (two[0] == DCPTimePeriod(DCPTime(), DCPTime::from_frames(230, 24)));
+	BOOST_CHECK (two[1] == DCPTimePeriod(DCPTime::from_frames(230, 24), DCPTime::from_frames(480, 24)));
+
+	auto four = FFmpegEncoder::segments(film, 4);
+	BOOST_REQUIRE_EQUAL (four.size(), 4U);
+	BOOST_CHECK (four[0].from == DCPTime());
+	BOOST_CHECK (four[1].from == DCPTime::from_frames(120, 24));
+	BOOST_CHECK (four[2].from == DCPTime::from_frames(230, 24));
+	BOOST_CHECK (four[3].from == DCPTime::from_frames(360, 24));
+	BOOST_CHECK (four[3].to == DCPTime::from_frames(480, 24));
+}
@@ -94,3 +94,25 @@ BOOST_AUTO_TEST_CASE (ffmpeg_examiner_video_stream_selection_test)
 	BOOST_REQUIRE (examiner->video_frame_rate());
 	BOOST_CHECK_EQUAL (examiner->video_frame_rate().get(), 25);
 }
+
+
+/** Check that a quick examination of a transport stream leaves out the seek index, and that
+ *  it otherwise agrees with an exact one.
+ */
+BOOST_AUTO_TEST_CASE (ffmpeg_examiner_quick_test)
+{
+	auto content = make_shared<FFmpegContent>("test/data/count300bd24.m2ts");
+	auto quick = make_shared<FFmpegExaminer>(content, shared_ptr<Job>(), true);
+	auto exact = make_shared<FFmpegExaminer>(content);
+
+	BOOST_CHECK (!quick->exact());
+	BOOST_CHECK (!quick->seek_index());
+	BOOST_CHECK (exact->exact());
+	BOOST_CHECK (exact->seek_index());
+
+	BOOST_CHECK_EQUAL (quick->video_length(), exact->video_length());
+	BOOST_CHECK_EQUAL (quick->first_video().get().get(), exact->first_video().get().get());
+	BOOST_REQUIRE_EQUAL (quick->audio_streams().size(), 1U);
+	BOOST_CHECK_EQUAL (quick->audio_streams()[0]->first_audio.get().get(), exact->audio_streams()[0]->first_audio.get().get());
+	BOOST_CHECK_EQUAL (quick->pulldown(), exact->pulldown());
+}
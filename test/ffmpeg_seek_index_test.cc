@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/ffmpeg_seek_index_test.cc
+ *  @brief Test FFmpegSeekIndex.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/ffmpeg_seek_index.h"
+#include <boost/test/unit_test.hpp>
+
+
+BOOST_AUTO_TEST_CASE (ffmpeg_seek_index_test)
+{
+	FFmpegSeekIndex index;
+	index.add (1000, 188);
+	index.add (3000, 94000);
+	/* Out of order */
+	index.add (2000, 47000);
+
+	BOOST_REQUIRE_EQUAL (index.entries().size(), 3U);
+	BOOST_CHECK_EQUAL (index.entries()[1].timestamp, 2000);
+	BOOST_CHECK_EQUAL (index.entries()[1].position, 47000);
+
+	BOOST_CHECK (!index.keyframe_before(999));
+	BOOST_CHECK_EQUAL (index.keyframe_before(1000).get_value_or(0), 1000);
+	BOOST_CHECK_EQUAL (index.keyframe_before(2999).get_value_or(0), 2000);
+	BOOST_CHECK_EQUAL (index.keyframe_before(1000000).get_value_or(0), 3000);
+
+	boost::filesystem::path const file = "build/test/ffmpeg_seek_index_test/index";
+	boost::filesystem::remove_all (file.parent_path());
+	index.write (file);
+
+	FFmpegSeekIndex check (file);
+	BOOST_REQUIRE_EQUAL (check.entries().size(), 3U);
+	for (size_t i = 0; i < 3; ++i) {
+		BOOST_CHECK_EQUAL (check.entries()[i].timestamp, index.entries()[i].timestamp);
+		BOOST_CHECK_EQUAL (check.entries()[i].position, index.entries()[i].position);
+	}
+
+	/* A truncated file should give an error */
+	boost::filesystem::resize_file (file, 20);
+	BOOST_CHECK_THROW (FFmpegSeekIndex(file), std::exception);
+}
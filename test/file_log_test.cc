@@ -25,13 +25,67 @@
  */
 
 
+#include "lib/dcpomatic_log.h"
 #include "lib/file_log.h"
+#include "test.h"
+#include <dcp/util.h>
+#include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
 
 
+using std::make_shared;
+using std::string;
+using std::vector;
+
+
 BOOST_AUTO_TEST_CASE (file_log_test)
 {
 	FileLog log ("test/data/short.log");
 	BOOST_CHECK_EQUAL (log.head_and_tail(1024), "This is a short log.\nWith only two lines.\n");
 	BOOST_CHECK_EQUAL (log.head_and_tail(8), "This is \n .\n .\n .\no lines.\n");
 }
+
+
+BOOST_AUTO_TEST_CASE (file_log_write_test)
+{
+	boost::filesystem::path const path = "build/test/file_log_write_test.log";
+	boost::system::error_code ec;
+	boost::filesystem::remove (path, ec);
+
+	FileLog log (path, LogEntry::TYPE_GENERAL);
+	BOOST_CHECK (log.enabled(LogEntry::TYPE_GENERAL));
+	BOOST_CHECK (!log.enabled(LogEntry::TYPE_TIMING));
+
+	for (int i = 0; i < 100; ++i) {
+		log.log (String::compose("Line %1", i), LogEntry::TYPE_GENERAL);
+	}
+	log.log ("Not wanted", LogEntry::TYPE_TIMING);
+	log.flush ();
+
+	auto const contents = dcp::file_to_string (path);
+	vector<string> lines;
+	boost::split (lines, contents, boost::is_any_of("\n"), boost::token_compress_on);
+	BOOST_REQUIRE_EQUAL (lines.size(), 101U);
+	BOOST_CHECK (lines[0].find("Line 0") != string::npos);
+	BOOST_CHECK (lines[99].find("Line 99") != string::npos);
+	BOOST_CHECK (contents.find("Not wanted") == string::npos);
+}
+
+
+/** Check that the messages for log types which are not enabled are never built */
+BOOST_AUTO_TEST_CASE (file_log_disabled_type_test)
+{
+	LogSwitcher ls (make_shared<FileLog>("build/test/file_log_disabled_type_test.log", LogEntry::TYPE_GENERAL));
+
+	int calls = 0;
+	auto value = [&calls]() {
+		++calls;
+		return 42;
+	};
+
+	LOG_TIMING ("Timing %1", value());
+	BOOST_CHECK_EQUAL (calls, 0);
+
+	LOG_GENERAL ("General %1", value());
+	BOOST_CHECK_EQUAL (calls, 1);
+}
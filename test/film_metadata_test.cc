@@ -25,11 +25,13 @@
  */
 
 
+#include "lib/compose.hpp"
 #include "lib/content.h"
 #include "lib/content_factory.h"
 #include "lib/dcp_content.h"
 #include "lib/dcp_content_type.h"
 #include "lib/film.h"
+#include "lib/metadata_writer.h"
 #include "lib/ratio.h"
 #include "lib/text_content.h"
 #include "lib/video_content.h"
@@ -210,3 +212,60 @@ BOOST_AUTO_TEST_CASE (metadata_video_range_guessed_for_png)
 	BOOST_REQUIRE(film->content()[0]->video);
 	BOOST_CHECK(film->content()[0]->video->range() == VideoRange::FULL);
 }
+
+
+BOOST_AUTO_TEST_CASE (metadata_written_soon)
+{
+	auto film = new_test_film2("metadata_written_soon");
+	auto const path = film->file("metadata.xml");
+	boost::filesystem::remove(path);
+
+	/* Lots of quick changes should end up as one write of the latest state */
+	for (int i = 0; i < 100; ++i) {
+		film->set_name(String::compose("fred%1", i));
+		film->write_metadata_soon();
+	}
+	BOOST_CHECK(!film->dirty());
+	BOOST_CHECK(!boost::filesystem::exists(path));
+
+	MetadataWriter::instance()->flush();
+	BOOST_CHECK(!boost::filesystem::exists(path.string() + ".tmp"));
+
+	auto check = make_shared<Film>(film->directory().get());
+	check->read_metadata();
+	BOOST_CHECK_EQUAL(check->name(), "fred99");
+
+	/* A synchronous write must not be overwritten by an older one from the background */
+	film->set_name("jim");
+	film->write_metadata_soon();
+	film->set_name("sheila");
+	film->write_metadata();
+	MetadataWriter::instance()->flush();
+
+	check = make_shared<Film>(film->directory().get());
+	check->read_metadata();
+	BOOST_CHECK_EQUAL(check->name(), "sheila");
+}
+
+
+BOOST_AUTO_TEST_CASE (metadata_loads_lots_of_content)
+{
+	vector<std::shared_ptr<Content>> content;
+	for (int i = 0; i < 40; ++i) {
+		content.push_back(content_factory("test/data/flat_red.png")[0]);
+	}
+	auto film = new_test_film2("metadata_loads_lots_of_content", content);
+	for (auto i = 0U; i < content.size(); ++i) {
+		content[i]->video->set_length(24 * (i + 1));
+	}
+	film->write_metadata();
+
+	auto check = make_shared<Film>(film->directory().get());
+	check->read_metadata();
+	auto loaded = check->content();
+	BOOST_REQUIRE_EQUAL(loaded.size(), content.size());
+	for (auto i = 0U; i < loaded.size(); ++i) {
+		BOOST_CHECK(loaded[i]->position() == content[i]->position());
+		BOOST_CHECK_EQUAL(loaded[i]->video->length(), content[i]->video->length());
+	}
+}
@@ -19,11 +19,13 @@
 */
 
 
+#include "lib/compose.hpp"
 #include "lib/content.h"
 #include "lib/content_factory.h"
 #include "lib/dcp_content.h"
 #include "lib/film.h"
 #include "lib/find_missing.h"
+#include "lib/state.h"
 #include "test.h"
 #include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
@@ -154,3 +156,69 @@ BOOST_AUTO_TEST_CASE (find_missing_test_with_multiple_files_one_incorrect)
 	}
 }
 
+
+
+/** Files missing from the middle of a sequence are only noticed once check_paths() has been called */
+BOOST_AUTO_TEST_CASE (check_paths_finds_missing_sequence_files)
+{
+	using namespace boost::filesystem;
+
+	auto content_dir = path("build/test/check_paths_finds_missing_sequence_files");
+	remove_all (content_dir);
+	create_directories (content_dir);
+	for (int i = 0; i < 10; ++i) {
+		copy_file ("test/data/flat_red.png", content_dir / String::compose("%1.png", i));
+	}
+
+	auto content = content_factory(content_dir)[0];
+	BOOST_REQUIRE_EQUAL (content->number_of_paths(), 10U);
+	content->check_paths ();
+	BOOST_CHECK (content->paths_valid());
+
+	remove (content_dir / "5.png");
+	BOOST_CHECK (content->paths_valid());
+	content->check_paths ();
+	BOOST_CHECK (!content->paths_valid());
+
+	copy_file ("test/data/flat_red.png", content_dir / "5.png");
+	content->check_paths ();
+	BOOST_CHECK (content->paths_valid());
+}
+
+
+BOOST_AUTO_TEST_CASE (find_missing_test_with_index)
+{
+	using namespace boost::filesystem;
+
+	auto const content_dir = path("build/test/find_missing_test_with_index_content");
+	remove_all (content_dir);
+	create_directories (content_dir);
+	copy_file ("test/data/flat_red.png", content_dir / "X.png");
+
+	auto content = content_factory(content_dir / "X.png")[0];
+	auto film = new_test_film2 ("find_missing_test_with_index_film", { content });
+
+	/* Move the content into a tree which also has a different file with the same name */
+	auto const root = path("build/test/find_missing_test_with_index_root");
+	remove_all (root);
+	create_directories (root / "a" / "b");
+	create_directories (root / "c");
+	rename (content_dir / "X.png", root / "a" / "b" / "X.png");
+	copy_file ("test/data/flat_black.png", root / "c" / "X.png");
+	BOOST_CHECK (!content->paths_valid());
+
+	remove_all (State::write_path("find_missing"));
+	dcpomatic::find_missing (film->content(), root);
+	BOOST_REQUIRE_EQUAL (content->number_of_paths(), 1U);
+	BOOST_CHECK_EQUAL (content->path(0), root / "a" / "b" / "X.png");
+
+	/* We should have remembered what is in the tree */
+	BOOST_CHECK (std::distance(directory_iterator(State::write_path("find_missing")), directory_iterator()) == 1);
+
+	/* Move the file again, so that the index is out of date; it should still be found */
+	create_directories (root / "d");
+	rename (root / "a" / "b" / "X.png", root / "d" / "X.png");
+	BOOST_CHECK (!content->paths_valid());
+	dcpomatic::find_missing (film->content(), root);
+	BOOST_CHECK_EQUAL (content->path(0), root / "d" / "X.png");
+}
@@ -0,0 +1,119 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/frame_prefetcher_test.cc
+ *  @brief Test FramePrefetcher class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/frame_prefetcher.h"
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <stdexcept>
+
+
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (frame_prefetcher_test)
+{
+	boost::mutex mutex;
+	vector<int64_t> reads;
+
+	FramePrefetcher<int64_t> prefetcher (
+		[&mutex, &reads](int64_t index) {
+			boost::mutex::scoped_lock lm (mutex);
+			reads.push_back (index);
+			return index * 10;
+		},
+		100, 4
+		);
+
+	for (int64_t i = 0; i < 10; ++i) {
+		BOOST_CHECK_EQUAL (prefetcher.get(i), i * 10);
+	}
+
+	/* Asking again for the last frame is fine */
+	BOOST_CHECK_EQUAL (prefetcher.get(9), 90);
+
+	/* Seek forwards and backwards */
+	BOOST_CHECK_EQUAL (prefetcher.get(50), 500);
+	BOOST_CHECK_EQUAL (prefetcher.get(51), 510);
+	BOOST_CHECK_EQUAL (prefetcher.get(3), 30);
+
+	/* The last frame can be read, but nothing after it */
+	BOOST_CHECK_EQUAL (prefetcher.get(99), 990);
+
+	boost::mutex::scoped_lock lm (mutex);
+	for (auto i: reads) {
+		BOOST_CHECK (i >= 0 && i < 100);
+	}
+	/* Frames 0 to 9 should have been read once each, in order */
+	for (int64_t i = 0; i < 10; ++i) {
+		BOOST_CHECK_EQUAL (reads[i], i);
+	}
+}
+
+
+/** Check that frames are read ahead of the one that is asked for */
+BOOST_AUTO_TEST_CASE (frame_prefetcher_ahead_test)
+{
+	std::atomic<int64_t> last (-1);
+
+	FramePrefetcher<int64_t> prefetcher (
+		[&last](int64_t index) {
+			last = index;
+			return index;
+		},
+		100, 4
+		);
+
+	BOOST_CHECK_EQUAL (prefetcher.get(0), 0);
+	for (int i = 0; i < 100 && last < 4; ++i) {
+		boost::this_thread::sleep (boost::posix_time::milliseconds(10));
+	}
+	/* We should read up to 4 frames after the one that was asked for, but no further */
+	BOOST_CHECK_EQUAL (last, 4);
+	boost::this_thread::sleep (boost::posix_time::milliseconds(50));
+	BOOST_CHECK_EQUAL (last, 4);
+}
+
+
+BOOST_AUTO_TEST_CASE (frame_prefetcher_error_test)
+{
+	FramePrefetcher<int64_t> prefetcher (
+		[](int64_t index) {
+			if (index == 5) {
+				throw std::runtime_error ("bad frame");
+			}
+			return index;
+		},
+		100, 4
+		);
+
+	BOOST_CHECK_EQUAL (prefetcher.get(4), 4);
+	BOOST_CHECK_THROW (prefetcher.get(5), std::runtime_error);
+	BOOST_CHECK_THROW (prefetcher.get(5), std::runtime_error);
+	/* Reading carries on after the bad frame */
+	BOOST_CHECK_EQUAL (prefetcher.get(6), 6);
+	BOOST_CHECK_EQUAL (prefetcher.get(7), 7);
+}
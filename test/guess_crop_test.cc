@@ -19,9 +19,14 @@
 */
 
 
+#include "lib/analyse_crop_job.h"
 #include "lib/content.h"
 #include "lib/content_factory.h"
+#include "lib/crop_analysis.h"
+#include "lib/film.h"
 #include "lib/guess_crop.h"
+#include "lib/image.h"
+#include "lib/job_manager.h"
 #include "lib/types.h"
 #include "lib/video_content.h"
 #include "test.h"
@@ -30,6 +35,8 @@
 #include <vector>
 
 
+using std::make_shared;
+using std::shared_ptr;
 using namespace dcpomatic;
 
 
@@ -58,3 +65,62 @@ BOOST_AUTO_TEST_CASE (guess_crop_image_test3)
 
 	BOOST_CHECK(guess_crop(film, content[0], 0.1, {}) == Crop(113, 262, 0, 0));
 }
+
+
+static
+shared_ptr<Image>
+black_image_with_box (int x, int y, int width, int height)
+{
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(64, 48), Image::Alignment::COMPACT);
+	image->make_black ();
+	for (int yy = y; yy < y + height; ++yy) {
+		auto p = image->data()[0] + yy * image->stride()[0] + x * 3;
+		for (int xx = 0; xx < width * 3; ++xx) {
+			*p++ = 255;
+		}
+	}
+	return image;
+}
+
+
+/** Check that merging the profiles of several frames gives a crop which keeps everything that is bright in any of them */
+BOOST_AUTO_TEST_CASE (guess_crop_merged_profiles_test)
+{
+	auto one = brightness_profile(black_image_with_box(10, 4, 8, 8));
+	auto two = brightness_profile(black_image_with_box(30, 20, 20, 10));
+
+	BOOST_CHECK(guess_crop(one, 0.1) == Crop(10, 46, 4, 36));
+
+	BrightnessProfile merged;
+	merged.merge(one);
+	merged.merge(two);
+	BOOST_CHECK(guess_crop(merged, 0.1) == Crop(10, 14, 4, 18));
+}
+
+
+BOOST_AUTO_TEST_CASE (crop_analysis_write_read_test)
+{
+	auto profile = brightness_profile(black_image_with_box(3, 5, 40, 20));
+	CropAnalysis analysis(profile, 4);
+	analysis.write("build/test/crop_analysis_write_read_test.xml");
+
+	CropAnalysis check("build/test/crop_analysis_write_read_test.xml");
+	BOOST_CHECK_EQUAL(check.frames(), 4);
+	BOOST_CHECK(check.profile().rows == profile.rows);
+	BOOST_CHECK(check.profile().columns == profile.columns);
+	BOOST_CHECK(check.crop(0.1) == Crop(3, 21, 5, 23));
+}
+
+
+BOOST_AUTO_TEST_CASE (analyse_crop_job_test)
+{
+	auto content = content_factory(TestPaths::private_data() / "pillarbox.png");
+	auto film = new_test_film2 ("analyse_crop_job_test", content);
+
+	JobManager::instance()->add(make_shared<AnalyseCropJob>(film, content[0]));
+	BOOST_REQUIRE(!wait_for_jobs());
+
+	CropAnalysis analysis(film->crop_analysis_path(content[0]));
+	BOOST_CHECK(analysis.frames() > 0);
+	BOOST_CHECK(analysis.crop(0.1) == Crop(113, 262, 0, 0));
+}
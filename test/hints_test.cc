@@ -28,6 +28,7 @@
 #include "lib/font.h"
 #include "lib/hints.h"
 #include "lib/text_content.h"
+#include "lib/text_hints.h"
 #include "lib/util.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
@@ -280,3 +281,60 @@ BOOST_AUTO_TEST_CASE (hints_certificate_validity)
 		);
 }
 
+
+
+/** Check that what we find out about a film's texts is kept, and used until the texts change */
+BOOST_AUTO_TEST_CASE (hints_text_hints_are_kept)
+{
+	auto content = content_factory("test/data/hint_subtitle_too_early.srt")[0];
+	auto film = new_test_film2 ("hints_text_hints_are_kept", { content });
+	content->text.front()->set_language (dcp::LanguageTag("en-US"));
+
+	auto const early = string("It is advisable to put your first subtitle at least 4 seconds after the start of the DCP to make sure it is seen.");
+
+	auto hints = get_hints (film);
+	BOOST_REQUIRE_EQUAL (hints.size(), 1U);
+	BOOST_CHECK_EQUAL (hints[0], early);
+
+	auto const path = film->text_hints_path();
+	BOOST_REQUIRE (boost::filesystem::exists(path));
+	TextHints kept (path);
+	BOOST_CHECK (kept.early_subtitle);
+	BOOST_CHECK (!kept.short_subtitle);
+
+	/* Change what is kept, so that we can see that it is used rather than the texts being examined again */
+	kept.short_subtitle = true;
+	kept.write (path);
+
+	hints = get_hints (film);
+	BOOST_REQUIRE_EQUAL (hints.size(), 2U);
+	BOOST_CHECK_EQUAL (hints[0], early);
+	BOOST_CHECK_EQUAL (hints[1], "At least one of your subtitles lasts less than 15 frames.  It is advisable to make each subtitle at least 15 frames long.");
+
+	/* Changing the texts means they must be examined again */
+	content->text.front()->set_y_offset (0.1);
+	BOOST_CHECK (film->text_hints_path() != path);
+	hints = get_hints (film);
+	BOOST_REQUIRE_EQUAL (hints.size(), 1U);
+	BOOST_CHECK_EQUAL (hints[0], early);
+}
+
+
+BOOST_AUTO_TEST_CASE (hints_text_colour_change_keeps_text_hints)
+{
+	auto content = content_factory("test/data/hint_subtitle_too_early.srt")[0];
+	auto film = new_test_film2 ("hints_text_colour_change_keeps_text_hints", { content });
+
+	auto const path = film->text_hints_path();
+	content->text.front()->set_colour (dcp::Colour(255, 0, 0));
+	content->text.front()->set_effect_colour (dcp::Colour(0, 255, 0));
+	BOOST_CHECK (film->text_hints_path() == path);
+
+	content->text.front()->set_effect (dcp::Effect::BORDER);
+	BOOST_CHECK (film->text_hints_path() != path);
+
+	BOOST_CHECK (!Hints::film_change_matters(Film::Property::NAME));
+	BOOST_CHECK (Hints::film_change_matters(Film::Property::INTEROP));
+	BOOST_CHECK (!Hints::content_change_matters(TextContentProperty::COLOUR));
+	BOOST_CHECK (Hints::content_change_matters(TextContentProperty::Y_OFFSET));
+}
@@ -0,0 +1,86 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/image_compression_test.cc
+ *  @brief Check that compress_image() and decompress_image() give back what they were given.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/exceptions.h"
+#include "lib/image.h"
+#include "lib/image_compression.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using std::shared_ptr;
+
+
+static shared_ptr<Image>
+make_image (AVPixelFormat format, int noise)
+{
+	auto image = make_shared<Image>(format, dcp::Size(1998, 1080), Image::Alignment::PADDED);
+
+	uint32_t seed = 1;
+	for (int i = 0; i < image->planes(); ++i) {
+		for (int y = 0; y < image->sample_size(i).height; ++y) {
+			auto p = image->data()[i] + y * image->stride()[i];
+			for (int x = 0; x < image->line_size()[i]; ++x) {
+				seed = seed * 1103515245 + 12345;
+				*p++ = (x / 3 + y / 2) + (noise ? (seed >> 16) % noise : 0);
+			}
+		}
+	}
+
+	return image;
+}
+
+
+static void
+check (AVPixelFormat format, int noise)
+{
+	auto image = make_image (format, noise);
+	auto compressed = compress_image (image);
+	auto out = make_shared<Image>(format, image->size(), Image::Alignment::PADDED);
+	decompress_image (compressed.data(), compressed.size(), out);
+	BOOST_CHECK (*image == *out);
+
+	BOOST_CHECK_THROW (decompress_image(compressed.data(), compressed.size() - 1, out), DecodeError);
+}
+
+
+BOOST_AUTO_TEST_CASE (image_compression_test)
+{
+	for (auto format: { AV_PIX_FMT_RGB24, AV_PIX_FMT_RGB48LE, AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_UYVY422 }) {
+		check (format, 0);
+		check (format, 4);
+		check (format, 256);
+	}
+}
+
+
+/** A smooth image should get smaller */
+BOOST_AUTO_TEST_CASE (image_compression_ratio_test)
+{
+	auto image = make_image (AV_PIX_FMT_YUV420P, 0);
+	BOOST_CHECK (compress_image(image).size() < image->memory_used() / 2);
+}
@@ -75,3 +75,19 @@ BOOST_AUTO_TEST_CASE (image_filename_sorter_test2)
 		BOOST_CHECK_EQUAL(paths[i].string(), String::compose("some.filename.with.%1.number.tiff", i));
 	}
 }
+
+
+/** Check that ImageFilenameSorter::sort gives the same order as sorting with the comparison */
+BOOST_AUTO_TEST_CASE (image_filename_sorter_test3)
+{
+	vector<boost::filesystem::path> paths;
+	for (int i = 0; i < 300000; ++i) {
+		paths.push_back(String::compose("/my/numeric999/path/reel%1_%2.dpx", i % 3, i));
+	}
+	random_shuffle (paths.begin(), paths.end());
+
+	auto check = paths;
+	sort (check.begin(), check.end(), ImageFilenameSorter());
+	ImageFilenameSorter::sort (paths);
+	BOOST_CHECK (paths == check);
+}
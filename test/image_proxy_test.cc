@@ -66,3 +66,24 @@ BOOST_AUTO_TEST_CASE (ffmpeg_image_proxy_same_test)
 	}
 }
 
+
+
+/** Check that same() gives the same answers once fingerprints are known, and that they are kept */
+BOOST_AUTO_TEST_CASE (ffmpeg_image_proxy_fingerprint_test)
+{
+	auto proxy1 = make_shared<FFmpegImageProxy>(data_file0);
+	auto proxy2 = make_shared<FFmpegImageProxy>(data_file0);
+	auto proxy3 = make_shared<FFmpegImageProxy>(data_file1);
+
+	BOOST_CHECK (!proxy1->known_fingerprint());
+	BOOST_CHECK (proxy1->same(proxy1));
+	BOOST_CHECK (!proxy1->known_fingerprint());
+
+	BOOST_CHECK_EQUAL (proxy1->fingerprint(), proxy2->fingerprint());
+	BOOST_CHECK (proxy3->fingerprint() != proxy1->fingerprint());
+	BOOST_REQUIRE (proxy1->known_fingerprint());
+	BOOST_CHECK_EQUAL (*proxy1->known_fingerprint(), proxy1->fingerprint());
+
+	BOOST_CHECK (proxy1->same(proxy2));
+	BOOST_CHECK (!proxy1->same(proxy3));
+}
@@ -30,8 +30,11 @@
 #include "lib/image.h"
 #include "lib/image_content.h"
 #include "lib/image_decoder.h"
+#include "lib/image_pool.h"
 #include "lib/image_jpeg.h"
 #include "lib/image_png.h"
+#include "lib/rgba.h"
+#include "lib/subtitle_png_pool.h"
 #include "lib/ffmpeg_image_proxy.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
@@ -41,7 +44,9 @@
 using std::cout;
 using std::list;
 using std::make_shared;
+using std::shared_ptr;
 using std::string;
+using std::vector;
 
 
 BOOST_AUTO_TEST_CASE (aligned_image_test)
@@ -238,6 +243,44 @@ BOOST_AUTO_TEST_CASE (alpha_blend_test_onto_xyz)
 }
 
 
+/** Test that blending the same subtitle onto several XYZ12LE images gives the same result each time */
+BOOST_AUTO_TEST_CASE (alpha_blend_test_onto_xyz_repeated)
+{
+	auto overlay = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size(16, 8), Image::Alignment::PADDED);
+	overlay->make_transparent();
+	for (int y = 0; y < 8; ++y) {
+		uint8_t* p = overlay->data()[0] + (y * overlay->stride()[0]);
+		for (int x = 0; x < 16; x += 2) {
+			p[x * 4 + 0] = x * 16;
+			p[x * 4 + 1] = y * 32;
+			p[x * 4 + 2] = 200;
+			p[x * 4 + 3] = 128;
+		}
+	}
+
+	auto blend = [](shared_ptr<const Image> overlay) {
+		auto xyz = make_shared<Image>(AV_PIX_FMT_XYZ12LE, dcp::Size(40, 30), Image::Alignment::PADDED);
+		xyz->make_black();
+		xyz->alpha_blend(overlay, Position<int>(3, 5));
+		return xyz;
+	};
+
+	auto first = blend(overlay);
+	auto second = blend(overlay);
+	BOOST_CHECK (*first == *second);
+
+	/* A copy, which will not be found among the images that have been blended before, should look the same */
+	auto third = blend(make_shared<Image>(*overlay));
+	BOOST_CHECK (*first == *third);
+
+	/* Something different should look different */
+	auto other = make_shared<Image>(*overlay);
+	other->data()[0][2] = 10;
+	auto fourth = blend(other);
+	BOOST_CHECK (!(*first == *fourth));
+}
+
+
 /** Test merge (list<PositionImage>) with a single image */
 BOOST_AUTO_TEST_CASE (merge_test1)
 {
@@ -426,6 +469,190 @@ BOOST_AUTO_TEST_CASE (crop_scale_window_test8)
 }
 
 
+/** Hardware video decoders give us semi-planar images, with U and V interleaved in one plane */
+BOOST_AUTO_TEST_CASE (semi_planar_image_test)
+{
+	Image nv12 (AV_PIX_FMT_NV12, dcp::Size(64, 32), Image::Alignment::PADDED);
+	BOOST_CHECK_EQUAL (nv12.planes(), 2);
+	BOOST_CHECK_EQUAL (nv12.line_size()[0], 64);
+	BOOST_CHECK_EQUAL (nv12.line_size()[1], 64);
+	BOOST_CHECK_EQUAL (nv12.sample_size(1).height, 16);
+
+	Image p010 (AV_PIX_FMT_P010LE, dcp::Size(64, 32), Image::Alignment::PADDED);
+	BOOST_CHECK_EQUAL (p010.planes(), 2);
+	BOOST_CHECK_EQUAL (p010.line_size()[0], 128);
+	BOOST_CHECK_EQUAL (p010.line_size()[1], 128);
+
+	/* Planar formats are as they were */
+	Image yuv (AV_PIX_FMT_YUV420P, dcp::Size(64, 32), Image::Alignment::PADDED);
+	BOOST_CHECK_EQUAL (yuv.planes(), 3);
+	BOOST_CHECK_EQUAL (yuv.line_size()[1], 32);
+	Image gbr (AV_PIX_FMT_GBRP, dcp::Size(64, 32), Image::Alignment::PADDED);
+	BOOST_CHECK_EQUAL (gbr.planes(), 3);
+	BOOST_CHECK_EQUAL (gbr.line_size()[2], 64);
+}
+
+
+/** Check a crop_scale_window which only crops and places the image in a bigger frame, which does not use the scaler */
+BOOST_AUTO_TEST_CASE (crop_scale_window_copy_test)
+{
+	dcp::Size const size (640, 480);
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB48LE, size, Image::Alignment::PADDED);
+	for (int y = 0; y < size.height; ++y) {
+		auto p = reinterpret_cast<uint16_t*>(image->data()[0] + y * image->stride()[0]);
+		for (int x = 0; x < size.width * 3; ++x) {
+			*p++ = (x * 37 + y * 101) & 0xffff;
+		}
+	}
+
+	Crop const crop (4, 8, 2, 6);
+	auto const cropped = crop.apply(size);
+	dcp::Size const out_size (cropped.width + 20, cropped.height + 10);
+
+	auto out = image->crop_scale_window(
+		crop, cropped, out_size, dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+		);
+
+	for (int y = 0; y < out_size.height; ++y) {
+		auto p = reinterpret_cast<uint16_t*>(out->data()[0] + y * out->stride()[0]);
+		for (int x = 0; x < out_size.width; ++x) {
+			int const in_x = x - 10 + crop.left;
+			int const in_y = y - 5 + crop.top;
+			bool const inside = x >= 10 && x < 10 + cropped.width && y >= 5 && y < 5 + cropped.height;
+			for (int c = 0; c < 3; ++c) {
+				auto const expected = inside ? reinterpret_cast<uint16_t*>(image->data()[0] + in_y * image->stride()[0])[in_x * 3 + c] : 0;
+				BOOST_REQUIRE_EQUAL (p[x * 3 + c], expected);
+			}
+		}
+	}
+}
+
+
+/** Check that processing the output of crop_scale_window in bands gives the same result as
+ *  processing it afterwards.
+ */
+BOOST_AUTO_TEST_CASE (crop_scale_window_process_rows_test)
+{
+	auto proxy = make_shared<FFmpegImageProxy>("test/data/rgb_grey_testcard.png");
+	auto in = proxy->image(Image::Alignment::PADDED).image;
+
+	auto subtitle = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size(300, 77), Image::Alignment::PADDED);
+	for (int y = 0; y < 77; ++y) {
+		auto p = subtitle->data()[0] + y * subtitle->stride()[0];
+		for (int x = 0; x < 300; ++x) {
+			p[x * 4] = x;
+			p[x * 4 + 1] = y;
+			p[x * 4 + 2] = 128;
+			p[x * 4 + 3] = (x % 50) < 25 ? 0 : ((x + y) % 256);
+		}
+	}
+
+	for (auto format: { AV_PIX_FMT_RGB24, AV_PIX_FMT_XYZ12LE, AV_PIX_FMT_YUV420P }) {
+		/* Range conversion of the scaled image is only done (and supported) for RGB24 */
+		auto const out_range = format == AV_PIX_FMT_RGB24 ? VideoRange::FULL : VideoRange::VIDEO;
+		auto separate = in->crop_scale_window(
+			Crop(11, 0, 7, 3), dcp::Size(1280, 533), dcp::Size(1998, 1080), dcp::YUVToRGB::REC709, VideoRange::VIDEO, format, out_range, Image::Alignment::COMPACT, false
+			);
+		if (format != AV_PIX_FMT_YUV420P) {
+			separate->alpha_blend(subtitle, Position<int>(400, 701));
+		}
+		separate->fade(0.4);
+
+		int calls = 0;
+		int next_row = 0;
+		auto banded = in->crop_scale_window(
+			Crop(11, 0, 7, 3), dcp::Size(1280, 533), dcp::Size(1998, 1080), dcp::YUVToRGB::REC709, VideoRange::VIDEO, format, out_range, Image::Alignment::COMPACT, false,
+			[&](Image& image, int first_row, int rows) {
+				BOOST_REQUIRE_EQUAL(first_row, next_row);
+				next_row += rows;
+				++calls;
+				if (format != AV_PIX_FMT_YUV420P) {
+					image.alpha_blend(subtitle, Position<int>(400, 701), first_row, rows);
+				}
+				image.fade(0.4, first_row, rows);
+			});
+
+		BOOST_CHECK_EQUAL(next_row, 1080);
+		BOOST_CHECK(calls > 1);
+		BOOST_CHECK(*separate == *banded);
+	}
+}
+
+
+/** Check that scaling with several threads gives the same result as with one */
+BOOST_AUTO_TEST_CASE (crop_scale_window_threads_test)
+{
+	auto proxy = make_shared<FFmpegImageProxy>("test/data/rgb_grey_testcard.png");
+	auto in = proxy->image(Image::Alignment::PADDED).image;
+
+	auto scale = [in]() {
+		return in->crop_scale_window(
+			Crop(8, 0, 4, 0), dcp::Size(3996, 2160), dcp::Size(4096, 2160), dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_XYZ12LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+			);
+	};
+
+	Image::set_scale_threads(1);
+	auto single = scale();
+	Image::set_scale_threads(4);
+	auto threaded = scale();
+	Image::set_scale_threads(1);
+
+	BOOST_CHECK(*single == *threaded);
+}
+
+
+/** Check that re-using scale contexts does not mix up conversions which differ only in their colourspace */
+BOOST_AUTO_TEST_CASE (scale_context_reuse_test)
+{
+	auto image = make_shared<Image>(AV_PIX_FMT_YUV420P, dcp::Size(640, 480), Image::Alignment::PADDED);
+	memset(image->data()[0], 100, image->stride()[0] * 480);
+	memset(image->data()[1], 200, image->stride()[1] * 240);
+	memset(image->data()[2], 50, image->stride()[2] * 240);
+
+	auto convert = [image](dcp::YUVToRGB yuv_to_rgb) {
+		return image->convert_pixel_format(yuv_to_rgb, AV_PIX_FMT_RGB24, Image::Alignment::COMPACT, false);
+	};
+
+	auto rec601_a = convert(dcp::YUVToRGB::REC601);
+	auto rec709 = convert(dcp::YUVToRGB::REC709);
+	auto rec601_b = convert(dcp::YUVToRGB::REC601);
+
+	auto same = [](std::shared_ptr<Image> a, std::shared_ptr<Image> b) {
+		return memcmp(a->data()[0], b->data()[0], a->stride()[0] * a->size().height) == 0;
+	};
+
+	BOOST_CHECK(same(rec601_a, rec601_b));
+	BOOST_CHECK(!same(rec601_a, rec709));
+}
+
+
+/** Check that an Image's planes go back to the pool to be re-used by the next similar Image */
+BOOST_AUTO_TEST_CASE (image_pool_test)
+{
+	auto pool = ImagePool::instance();
+	pool->clear();
+	auto const in_use = pool->in_use();
+
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(1998, 1080), Image::Alignment::PADDED);
+	auto const plane = image->data()[0];
+	BOOST_CHECK(pool->in_use() >= in_use + image->memory_used());
+	BOOST_CHECK_EQUAL(pool->spare(), 0U);
+
+	image.reset();
+	BOOST_CHECK_EQUAL(pool->in_use(), in_use);
+	BOOST_CHECK(pool->spare() > 0);
+
+	/* A slightly different size should fall into the same class and get the same block back */
+	image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(1990, 1080), Image::Alignment::PADDED);
+	BOOST_CHECK(image->data()[0] == plane);
+	BOOST_CHECK_EQUAL(pool->spare(), 0U);
+
+	image.reset();
+	pool->clear();
+	BOOST_CHECK_EQUAL(pool->spare(), 0U);
+}
+
+
 BOOST_AUTO_TEST_CASE (as_png_test)
 {
 	auto proxy = make_shared<FFmpegImageProxy>("test/data/3d_test/000001.png");
@@ -504,6 +731,75 @@ BOOST_AUTO_TEST_CASE (fade_test)
 }
 
 
+/** Check that fade() gives exactly what a sample-at-a-time fade would, at widths which
+ *  leave some samples over at the end of each line.
+ */
+BOOST_AUTO_TEST_CASE (fade_matches_scalar_test)
+{
+	/* Planes, bytes per sample and black value for each plane */
+	struct Format {
+		AVPixelFormat format;
+		int planes;
+		int bytes;
+		int black[3];
+	};
+
+	vector<Format> formats = {
+		{ AV_PIX_FMT_YUV420P, 3, 1, { 0, 127, 127 } },
+		{ AV_PIX_FMT_RGB24, 1, 1, { 0, 0, 0 } },
+		{ AV_PIX_FMT_XYZ12LE, 1, 2, { 0, 0, 0 } },
+		{ AV_PIX_FMT_RGB48LE, 1, 2, { 0, 0, 0 } },
+		{ AV_PIX_FMT_YUV422P10LE, 3, 2, { 0, 511, 511 } },
+	};
+
+	srand (1);
+
+	for (auto const& format: formats) {
+		for (auto width: { 1, 7, 33, 1998 }) {
+			for (auto f: { 0.0f, 0.1f, 0.5f, 0.97f, 1.0f }) {
+				auto image = make_shared<Image>(format.format, dcp::Size(width, 6), Image::Alignment::PADDED);
+				for (int c = 0; c < format.planes; ++c) {
+					for (int y = 0; y < image->sample_size(c).height; ++y) {
+						auto p = image->data()[c] + y * image->stride()[c];
+						for (int x = 0; x < image->line_size()[c]; ++x) {
+							p[x] = rand() & 0xff;
+						}
+						if (format.format == AV_PIX_FMT_YUV422P10LE || format.format == AV_PIX_FMT_XYZ12LE) {
+							/* Keep to the format's bit depth */
+							for (int x = 1; x < image->line_size()[c]; x += 2) {
+								p[x] &= format.format == AV_PIX_FMT_XYZ12LE ? 0x0f : 0x03;
+							}
+						}
+					}
+				}
+
+				auto faded = make_shared<Image>(*image);
+				faded->fade (f);
+
+				for (int c = 0; c < format.planes; ++c) {
+					int const black = format.black[c];
+					for (int y = 0; y < image->sample_size(c).height; ++y) {
+						auto p = image->data()[c] + y * image->stride()[c];
+						auto q = faded->data()[c] + y * faded->stride()[c];
+						for (int x = 0; x < image->line_size()[c] / format.bytes; ++x) {
+							if (format.bytes == 1) {
+								uint8_t const reference = black + int((int(p[x]) - black) * f);
+								BOOST_REQUIRE_EQUAL (static_cast<int>(q[x]), static_cast<int>(reference));
+							} else {
+								auto in = reinterpret_cast<uint16_t*>(p);
+								auto out = reinterpret_cast<uint16_t*>(q);
+								uint16_t const reference = black + int((int(in[x]) - black) * f);
+								BOOST_REQUIRE_EQUAL (out[x], reference);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
 BOOST_AUTO_TEST_CASE (make_black_test)
 {
 	dcp::Size in_size (512, 512);
@@ -647,3 +943,142 @@ BOOST_AUTO_TEST_CASE (over_crop_test)
 	write_image (scaled, "build/test/" + filename);
 	check_image ("test/data/" + filename, "build/test/" + filename);
 }
+
+
+BOOST_AUTO_TEST_CASE (palette_image_test)
+{
+	vector<RGBA> palette = {
+		RGBA(0, 0, 0, 0),
+		RGBA(255, 128, 64, 255),
+		RGBA(10, 20, 30, 100)
+	};
+
+	/* 6x4 indexed image with visible pixels only in a 3x2 block starting at (2, 1) */
+	int const stride = 8;
+	vector<uint8_t> indices(stride * 4, 0);
+	indices[1 * stride + 2] = 1;
+	indices[1 * stride + 4] = 2;
+	indices[2 * stride + 3] = 1;
+
+	auto result = palette_image(indices.data(), stride, dcp::Size(6, 4), palette);
+	BOOST_REQUIRE (result);
+	BOOST_CHECK_EQUAL (result->position.x, 2);
+	BOOST_CHECK_EQUAL (result->position.y, 1);
+	BOOST_REQUIRE_EQUAL (result->image->size().width, 3);
+	BOOST_REQUIRE_EQUAL (result->image->size().height, 2);
+	BOOST_CHECK (result->image->pixel_format() == AV_PIX_FMT_BGRA);
+
+	auto pixel = [result](int x, int y) {
+		return result->image->data()[0] + y * result->image->stride()[0] + x * 4;
+	};
+
+	BOOST_CHECK_EQUAL (pixel(0, 0)[0], 64);
+	BOOST_CHECK_EQUAL (pixel(0, 0)[1], 128);
+	BOOST_CHECK_EQUAL (pixel(0, 0)[2], 255);
+	BOOST_CHECK_EQUAL (pixel(0, 0)[3], 255);
+	BOOST_CHECK_EQUAL (pixel(1, 0)[3], 0);
+	BOOST_CHECK_EQUAL (pixel(2, 0)[0], 30);
+	BOOST_CHECK_EQUAL (pixel(2, 0)[3], 100);
+	BOOST_CHECK_EQUAL (pixel(1, 1)[2], 255);
+	BOOST_CHECK_EQUAL (pixel(0, 1)[3], 0);
+
+	/* Nothing visible at all */
+	vector<uint8_t> empty(stride * 4, 0);
+	BOOST_CHECK (!palette_image(empty.data(), stride, dcp::Size(6, 4), palette));
+}
+
+
+BOOST_AUTO_TEST_CASE (subtitle_png_pool_test)
+{
+	auto image = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(64, 32), Image::Alignment::PADDED);
+	image->make_transparent ();
+	image->data()[0][3] = 255;
+
+	auto png = SubtitlePNGPool::instance()->encode(image, SubtitlePNGPool::digest(image));
+	auto const reference = image_as_png(image, PNGCompression::FAST);
+	BOOST_CHECK (png.get() == reference);
+
+	/* The same picture in a different image should give the same PNG without compressing it again */
+	auto copy = make_shared<Image>(*image);
+	auto again = SubtitlePNGPool::instance()->encode(copy, SubtitlePNGPool::digest(copy));
+	BOOST_CHECK (&again.get() == &png.get());
+
+	image->data()[0][7] = 255;
+	auto different = SubtitlePNGPool::instance()->encode(image, SubtitlePNGPool::digest(image));
+	BOOST_CHECK (different.get() != reference);
+}
+
+
+BOOST_AUTO_TEST_CASE (subtitle_png_pool_batch_test)
+{
+	vector<SubtitlePNGPool::Request> requests;
+	for (int i = 0; i < 8; ++i) {
+		auto image = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(32, 16), Image::Alignment::PADDED);
+		image->make_transparent ();
+		image->data()[0][4 * i + 3] = 255;
+		requests.push_back({image, SubtitlePNGPool::digest(image)});
+	}
+
+	auto pngs = SubtitlePNGPool::instance()->encode(requests);
+	BOOST_REQUIRE_EQUAL (pngs.size(), requests.size());
+	for (size_t i = 0; i < pngs.size(); ++i) {
+		BOOST_CHECK (pngs[i].get() == image_as_png(requests[i].image, PNGCompression::FAST));
+	}
+}
+
+
+static void
+check_fast_png_round_trip (shared_ptr<const Image> image)
+{
+	auto png = image_as_png(image, PNGCompression::FAST);
+	auto decoded = FFmpegImageProxy(png).image(Image::Alignment::PADDED).image->convert_pixel_format(dcp::YUVToRGB::REC709, AV_PIX_FMT_RGBA, Image::Alignment::PADDED, false);
+	BOOST_REQUIRE (decoded->size() == image->size());
+
+	for (int y = 0; y < image->size().height; ++y) {
+		auto a = image->data()[0] + y * image->stride()[0];
+		auto b = decoded->data()[0] + y * decoded->stride()[0];
+		for (int x = 0; x < image->size().width; ++x) {
+			BOOST_REQUIRE_EQUAL (a[3], b[3]);
+			if (a[3] != 0) {
+				BOOST_REQUIRE_EQUAL (a[0], b[0]);
+				BOOST_REQUIRE_EQUAL (a[1], b[1]);
+				BOOST_REQUIRE_EQUAL (a[2], b[2]);
+			}
+			a += 4;
+			b += 4;
+		}
+	}
+}
+
+
+/** Check that fast PNGs of images with few colours (which get a palette) and many colours (which do not)
+ *  come back as they were.
+ */
+BOOST_AUTO_TEST_CASE (image_as_png_fast_test)
+{
+	auto few = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(100, 40), Image::Alignment::PADDED);
+	few->make_transparent ();
+	for (int y = 10; y < 30; ++y) {
+		auto p = few->data()[0] + y * few->stride()[0];
+		for (int x = 0; x < 100; ++x) {
+			p[x * 4] = 255;
+			p[x * 4 + 1] = x < 50 ? 255 : 0;
+			p[x * 4 + 2] = 0;
+			p[x * 4 + 3] = y < 20 ? 255 : 128;
+		}
+	}
+	check_fast_png_round_trip (few);
+	BOOST_CHECK (image_as_png(few, PNGCompression::FAST).size() < image_as_png(few).size());
+
+	auto many = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(64, 64), Image::Alignment::PADDED);
+	for (int y = 0; y < 64; ++y) {
+		auto p = many->data()[0] + y * many->stride()[0];
+		for (int x = 0; x < 64; ++x) {
+			p[x * 4] = x * 4;
+			p[x * 4 + 1] = y * 4;
+			p[x * 4 + 2] = 0;
+			p[x * 4 + 3] = 255;
+		}
+	}
+	check_fast_png_round_trip (many);
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/j2k_frame_cache.h"
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+
+
+static dcp::ArrayData
+fake_j2k (int size, uint8_t value)
+{
+	dcp::ArrayData data (size);
+	memset (data.data(), value, size);
+	/* SOC marker */
+	data.data()[0] = 0xff;
+	data.data()[1] = 0x4f;
+	return data;
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_frame_cache_test)
+{
+	boost::filesystem::path dir = "build/test/j2k_frame_cache_test";
+	boost::system::error_code ec;
+	boost::filesystem::remove_all (dir, ec);
+
+	J2KFrameCache cache (dir, 2048);
+
+	BOOST_CHECK (!cache.get("0123456789abcdef"));
+
+	auto frame = fake_j2k (1024, 42);
+	cache.put ("0123456789abcdef", frame);
+	auto got = cache.get ("0123456789abcdef");
+	BOOST_REQUIRE (got);
+	BOOST_CHECK (*got == frame);
+
+	/* Something that isn't J2K should be ignored */
+	cache.put ("fedcba9876543210", dcp::ArrayData(16));
+	BOOST_CHECK (!cache.get("fedcba9876543210"));
+
+	/* Adding more should push us over the limit, and prune should bring us back */
+	cache.put ("aaaaaaaaaaaaaaaa", fake_j2k(1024, 43));
+	cache.put ("bbbbbbbbbbbbbbbb", fake_j2k(1024, 44));
+	cache.prune ();
+
+	uint64_t total = 0;
+	for (auto i: boost::filesystem::recursive_directory_iterator(dir)) {
+		if (boost::filesystem::is_regular_file(i.path())) {
+			total += boost::filesystem::file_size(i.path());
+		}
+	}
+	BOOST_CHECK (total <= 2048);
+}
@@ -26,9 +26,11 @@
 
 
 #include "lib/cross.h"
+#include "lib/film.h"
 #include "lib/job.h"
 #include "lib/job_manager.h"
 #include <boost/test/unit_test.hpp>
+#include <atomic>
 
 
 using std::make_shared;
@@ -40,8 +42,9 @@ using std::vector;
 class TestJob : public Job
 {
 public:
-	explicit TestJob (shared_ptr<Film> film)
+	explicit TestJob (shared_ptr<Film> film, Resource resource = Resource::ENCODE)
 		: Job (film)
+		, _resource (resource)
 	{
 
 	}
@@ -76,6 +79,18 @@ public:
 	string json_name () const override {
 		return "";
 	}
+
+	Resource resource () const override {
+		return _resource;
+	}
+
+	void set_resource (Resource resource) {
+		_resource = resource;
+		ResourceChanged ();
+	}
+
+private:
+	std::atomic<Resource> _resource;
 };
 
 
@@ -161,3 +176,70 @@ BOOST_AUTO_TEST_CASE(cancel_job_test)
 	BOOST_CHECK(jobs[1]->finished_cancelled());
 }
 
+
+
+/** Jobs which use different resources should run at the same time, unless one is for the same film and must wait for another */
+BOOST_AUTO_TEST_CASE (job_manager_resources_test)
+{
+	auto encode = make_shared<TestJob>(shared_ptr<Film>());
+	auto second_encode = make_shared<TestJob>(shared_ptr<Film>());
+	auto upload = make_shared<TestJob>(shared_ptr<Film>(), Job::Resource::NETWORK);
+
+	auto film = make_shared<Film>(boost::optional<boost::filesystem::path>());
+	auto film_encode = make_shared<TestJob>(film);
+	auto film_upload = make_shared<TestJob>(film, Job::Resource::NETWORK);
+
+	for (auto job: { encode, second_encode, upload, film_encode, film_upload }) {
+		JobManager::instance()->add (job);
+	}
+
+	dcpomatic_sleep_seconds (1);
+	BOOST_CHECK (encode->running());
+	BOOST_CHECK (!second_encode->running());
+	BOOST_CHECK (upload->running());
+	BOOST_CHECK (!film_encode->running());
+	BOOST_CHECK (!film_upload->running());
+
+	encode->set_finished_ok ();
+	upload->set_finished_ok ();
+	dcpomatic_sleep_seconds (1);
+	BOOST_CHECK (second_encode->running());
+	BOOST_CHECK (!film_encode->running());
+	BOOST_CHECK (!film_upload->running());
+
+	second_encode->set_finished_ok ();
+	dcpomatic_sleep_seconds (1);
+	BOOST_CHECK (film_encode->running());
+	/* The upload must wait for the encode of the same film */
+	BOOST_CHECK (!film_upload->running());
+
+	film_encode->set_finished_ok ();
+	dcpomatic_sleep_seconds (1);
+	BOOST_CHECK (film_upload->running());
+	film_upload->set_finished_ok ();
+
+	BOOST_REQUIRE (!wait_for_jobs());
+}
+
+
+/** A job which stops encoding (e.g. to write its output) should let the next encode start */
+BOOST_AUTO_TEST_CASE (job_manager_resource_change_test)
+{
+	auto first = make_shared<TestJob>(shared_ptr<Film>());
+	auto second = make_shared<TestJob>(shared_ptr<Film>());
+	JobManager::instance()->add (first);
+	JobManager::instance()->add (second);
+
+	dcpomatic_sleep_seconds (1);
+	BOOST_CHECK (first->running());
+	BOOST_CHECK (!second->running());
+
+	first->set_resource (Job::Resource::DISK);
+	dcpomatic_sleep_seconds (1);
+	BOOST_CHECK (first->running());
+	BOOST_CHECK (second->running());
+
+	first->set_finished_ok ();
+	second->set_finished_ok ();
+	BOOST_REQUIRE (!wait_for_jobs());
+}
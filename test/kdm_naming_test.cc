@@ -26,6 +26,8 @@
 #include "lib/kdm_with_metadata.h"
 #include "lib/screen.h"
 #include "test.h"
+#include <dcp/decrypted_kdm.h>
+#include <dcp/encrypted_kdm.h>
 #include <boost/test/unit_test.hpp>
 
 
@@ -236,3 +238,60 @@ BOOST_AUTO_TEST_CASE (directory_kdm_naming_test, * boost::unit_test::depends_on(
 	BOOST_CHECK_MESSAGE (boost::filesystem::exists(base / dir_b / ref), "File " << ref << " not found");
 }
 
+
+
+BOOST_AUTO_TEST_CASE (bulk_kdm_test, * boost::unit_test::depends_on("single_kdm_naming_test"))
+{
+	auto film = new_test_film2 ("bulk_kdm_test", { content_factory("test/data/flat_black.png")[0] });
+	film->set_encrypted (true);
+	make_and_verify_dcp (film);
+	auto cpls = film->cpls ();
+	BOOST_REQUIRE(cpls.size() == 1);
+
+	auto sign_cert = Config::instance()->signer_chain()->leaf();
+
+	dcp::LocalTime from (sign_cert.not_before());
+	from.add_months (2);
+	dcp::LocalTime until (sign_cert.not_after());
+	until.add_months (-2);
+
+	auto const valid_from = boost::posix_time::time_from_string(from.date() + " " + from.time_of_day(true, false));
+	auto const valid_to = boost::posix_time::time_from_string(until.date() + " " + until.time_of_day(true, false));
+
+	auto no_recipient = std::make_shared<dcpomatic::Screen>("No recipient", "", boost::none, boost::none, vector<TrustedDevice>());
+
+	vector<shared_ptr<dcpomatic::Screen>> screens = {
+		cinema_a_screen_2, cinema_b_screen_x, no_recipient, cinema_a_screen_1, cinema_b_screen_z, cinema_b_screen_y
+	};
+
+	auto const cpl = cpls.front().cpl_file;
+	auto const bulk = kdms_for_screens (film, cpl, screens, valid_from, valid_to, dcp::Formulation::MODIFIED_TRANSITIONAL_1, false, optional<int>());
+	BOOST_REQUIRE_EQUAL (bulk.size(), 5U);
+
+	auto key = Config::instance()->decryption_chain()->key().get();
+
+	auto bulk_kdm = bulk.begin();
+	for (auto i: screens) {
+		auto single = kdm_for_screen (film, cpl, i, valid_from, valid_to, dcp::Formulation::MODIFIED_TRANSITIONAL_1, false, optional<int>());
+		if (!single) {
+			continue;
+		}
+
+		BOOST_CHECK ((*bulk_kdm)->name_values() == single->name_values());
+		BOOST_CHECK ((*bulk_kdm)->group() == single->group());
+
+		dcp::DecryptedKDM bulk_decrypted (dcp::EncryptedKDM((*bulk_kdm)->kdm_as_xml()), key);
+		dcp::DecryptedKDM single_decrypted (dcp::EncryptedKDM(single->kdm_as_xml()), key);
+		auto const bulk_keys = bulk_decrypted.keys();
+		auto const single_keys = single_decrypted.keys();
+		BOOST_REQUIRE_EQUAL (bulk_keys.size(), single_keys.size());
+		auto j = single_keys.begin();
+		for (auto const& k: bulk_keys) {
+			BOOST_CHECK_EQUAL (k.id(), j->id());
+			BOOST_CHECK (k.key() == j->key());
+			++j;
+		}
+
+		++bulk_kdm;
+	}
+}
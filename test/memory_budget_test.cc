@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/memory_budget_test.cc
+ *  @brief Test MemoryBudget.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/config.h"
+#include "lib/memory_budget.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::string;
+
+
+BOOST_AUTO_TEST_CASE (memory_budget_test)
+{
+	auto budget = MemoryBudget::instance();
+	int64_t const megabyte = 1024 * 1024;
+
+	/* Other tests may have left things using memory, so work relative to what is there */
+	auto const writer = budget->used(MemoryBudget::Subsystem::WRITER_QUEUE);
+	auto const encoder = budget->used(MemoryBudget::Subsystem::ENCODER_QUEUE);
+	auto const total = budget->total();
+
+	Config::instance()->set_memory_budget (0);
+	BOOST_CHECK (!budget->budget());
+	BOOST_CHECK (!budget->available(MemoryBudget::Subsystem::ENCODER_QUEUE));
+	BOOST_CHECK (!budget->over_budget());
+
+	Config::instance()->set_memory_budget (total / megabyte + 10);
+	auto const limit = (total / megabyte + 10) * megabyte;
+	BOOST_REQUIRE (budget->budget());
+	BOOST_CHECK_EQUAL (*budget->budget(), limit);
+
+	{
+		MemoryBudget::Share share (MemoryBudget::Subsystem::WRITER_QUEUE);
+		share.set (4 * megabyte);
+		BOOST_CHECK_EQUAL (budget->used(MemoryBudget::Subsystem::WRITER_QUEUE), writer + 4 * megabyte);
+		share.add (2 * megabyte);
+		BOOST_CHECK_EQUAL (share.get(), 6 * megabyte);
+		BOOST_CHECK_EQUAL (budget->total(), total + 6 * megabyte);
+		BOOST_CHECK (!budget->over_budget());
+
+		/* What the writer uses leaves less for the encoder queue... */
+		BOOST_CHECK_EQUAL (*budget->available(MemoryBudget::Subsystem::ENCODER_QUEUE), limit - total - 6 * megabyte + encoder);
+		/* ...but not for the writer itself */
+		BOOST_CHECK_EQUAL (*budget->available(MemoryBudget::Subsystem::WRITER_QUEUE), limit - total + writer);
+
+		share.set (12 * megabyte);
+		BOOST_CHECK (budget->over_budget());
+		BOOST_CHECK_EQUAL (*budget->available(MemoryBudget::Subsystem::ENCODER_QUEUE), 0);
+		BOOST_CHECK (budget->peak(MemoryBudget::Subsystem::WRITER_QUEUE) >= writer + 12 * megabyte);
+	}
+
+	/* The share gives its memory back when it goes */
+	BOOST_CHECK_EQUAL (budget->used(MemoryBudget::Subsystem::WRITER_QUEUE), writer);
+	BOOST_CHECK (!budget->over_budget());
+
+	budget->reset_peaks ();
+	BOOST_CHECK_EQUAL (budget->peak(MemoryBudget::Subsystem::WRITER_QUEUE), writer);
+
+	auto const report = budget->report();
+	BOOST_CHECK (report.find("writer_queue") != string::npos);
+	BOOST_CHECK (report.find("of a budget of") != string::npos);
+
+	Config::instance()->set_memory_budget (0);
+}
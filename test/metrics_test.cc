@@ -0,0 +1,76 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/metrics_test.cc
+ *  @brief Test Metrics.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/metrics.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::string;
+
+
+BOOST_AUTO_TEST_CASE (metrics_test)
+{
+	auto metrics = Metrics::instance();
+
+	auto& counter = metrics->counter("metrics_test_total", "A test counter");
+	counter.add ();
+	counter.add (41);
+	BOOST_CHECK_EQUAL (&metrics->counter("metrics_test_total", "A test counter"), &counter);
+
+	metrics->gauge("metrics_test_gauge", "A test gauge", {{ "host", "one" }}).set(2.5);
+	metrics->gauge("metrics_test_gauge", "A test gauge", {{ "host", "t\"wo" }}).set(-1);
+
+	auto& histogram = metrics->histogram("metrics_test_seconds", "A test histogram", { 0.5, 1, 10 });
+	histogram.observe (0.25);
+	histogram.observe (0.5);
+	histogram.observe (5);
+	histogram.observe (100);
+
+	auto const text = metrics->prometheus();
+
+	BOOST_CHECK (text.find(
+		"# HELP metrics_test_total A test counter\n"
+		"# TYPE metrics_test_total counter\n"
+		"metrics_test_total 42\n"
+		) != string::npos);
+
+	BOOST_CHECK (text.find(
+		"# TYPE metrics_test_gauge gauge\n"
+		"metrics_test_gauge{host=\"one\"} 2.5\n"
+		"metrics_test_gauge{host=\"t\\\"wo\"} -1\n"
+		) != string::npos);
+
+	BOOST_CHECK (text.find(
+		"# TYPE metrics_test_seconds histogram\n"
+		"metrics_test_seconds_bucket{le=\"0.5\"} 2\n"
+		"metrics_test_seconds_bucket{le=\"1\"} 2\n"
+		"metrics_test_seconds_bucket{le=\"10\"} 3\n"
+		"metrics_test_seconds_bucket{le=\"+Inf\"} 4\n"
+		"metrics_test_seconds_sum 105.75\n"
+		"metrics_test_seconds_count 4\n"
+		) != string::npos);
+}
@@ -0,0 +1,117 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/performance_report_test.cc
+ *  @brief Test PerformanceReport and the reports that are saved with a film.
+ *  @ingroup feature
+ */
+
+
+#include "lib/content_factory.h"
+#include "lib/film.h"
+#include "lib/performance_report.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::string;
+
+
+BOOST_AUTO_TEST_CASE (performance_report_percentile_test)
+{
+	PerformanceReport report;
+	report.frames = 105;
+	report.encode_time = 10.5;
+	BOOST_CHECK_CLOSE (report.mean_fps(), 10, 0.1);
+	/* No per-second figures, so we fall back to the mean */
+	BOOST_CHECK_CLOSE (report.percentile_fps(95), 10, 0.1);
+
+	/* The last, partial, second should be ignored */
+	report.frames_per_second = { 4, 12, 11, 10, 9, 12, 8, 11, 10, 13, 5 };
+	BOOST_CHECK_EQUAL (report.percentile_fps(100), 4);
+	BOOST_CHECK_EQUAL (report.percentile_fps(95), 4);
+	BOOST_CHECK_EQUAL (report.percentile_fps(50), 10);
+	BOOST_CHECK_EQUAL (report.percentile_fps(0), 13);
+}
+
+
+BOOST_AUTO_TEST_CASE (performance_report_history_test)
+{
+	boost::filesystem::path const file = "build/test/performance_report_history_test.xml";
+	boost::filesystem::remove (file);
+
+	BOOST_CHECK (PerformanceReport::read(file).empty());
+
+	for (int i = 0; i < PerformanceReport::history_size + 2; ++i) {
+		PerformanceReport report;
+		report.version = "2.17.0";
+		report.frames = i;
+		report.frames_per_second = { 24, 23, 1 };
+		report.frames_by_encoder["local"] = 40;
+		report.frames_by_encoder["server.example.com"] = 8;
+		report.encode_time = 2.25;
+		report.spilled = 3;
+		report.peak_memory["writer_queue"] = 1024 * 1024 * 30;
+		report.total_peak_memory = 1024 * 1024 * 200;
+		report.add_to (file);
+	}
+
+	auto reports = PerformanceReport::read(file);
+	BOOST_REQUIRE_EQUAL (reports.size(), static_cast<size_t>(PerformanceReport::history_size));
+	/* The oldest two should have gone */
+	BOOST_CHECK_EQUAL (reports.front().frames, 2);
+	BOOST_CHECK_EQUAL (reports.back().frames, PerformanceReport::history_size + 1);
+
+	auto const& last = reports.back();
+	BOOST_CHECK_EQUAL (last.version, "2.17.0");
+	BOOST_REQUIRE_EQUAL (last.frames_per_second.size(), 3U);
+	BOOST_CHECK_EQUAL (last.frames_per_second[1], 23);
+	BOOST_CHECK_EQUAL (last.frames_by_encoder.at("server.example.com"), 8);
+	BOOST_CHECK_CLOSE (last.encode_time, 2.25, 0.1);
+	BOOST_CHECK_EQUAL (last.spilled, 3);
+	BOOST_CHECK_EQUAL (last.peak_memory.at("writer_queue"), 1024 * 1024 * 30);
+	BOOST_CHECK_EQUAL (last.total_peak_memory, 1024 * 1024 * 200);
+}
+
+
+/** Check that making a DCP adds a report to the film */
+BOOST_AUTO_TEST_CASE (performance_report_film_test)
+{
+	auto content = content_factory("test/data/flat_red.png");
+	auto film = new_test_film2 ("performance_report_film_test", content);
+	make_and_verify_dcp (film);
+
+	auto reports = PerformanceReport::read(film->file("performance.xml"));
+	BOOST_REQUIRE_EQUAL (reports.size(), 1U);
+	auto const& report = reports.front();
+	auto const length = film->length().frames_round(film->video_frame_rate());
+	BOOST_CHECK_EQUAL (report.frames, length);
+	BOOST_CHECK_EQUAL (report.full_written + report.repeat_written, length);
+	BOOST_CHECK_EQUAL (report.fake_written, 0);
+
+	int encoded = 0;
+	for (auto const& i: report.frames_by_encoder) {
+		encoded += i.second;
+	}
+	BOOST_CHECK (encoded <= length);
+	BOOST_CHECK (report.encode_time > 0);
+	BOOST_CHECK (!report.version.empty());
+}
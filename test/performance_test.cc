@@ -0,0 +1,297 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @defgroup performance Tests which time representative jobs and check for slowdowns */
+
+/** @file  test/performance_test.cc
+ *  @brief Time some representative jobs and compare them with earlier runs.
+ *  @ingroup performance
+ *
+ *  These tests are disabled by default; run them with
+ *
+ *      run/tests --run_test=@performance
+ *
+ *  Timings are kept in build/test/performance.xml, or in the file named by
+ *  DCPOMATIC_PERFORMANCE_RESULTS, so that a machine can keep a history
+ *  between builds.  A test fails if it takes more than
+ *  DCPOMATIC_PERFORMANCE_THRESHOLD percent (default 15) longer than its
+ *  baseline, which is the median of its last few runs which did not fail.
+ */
+
+
+#include "lib/butler.h"
+#include "lib/dcp_content.h"
+#include "lib/dcp_content_type.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/film.h"
+#include "lib/make_dcp.h"
+#include "lib/player.h"
+#include "lib/ratio.h"
+#include "lib/version.h"
+#include "test.h"
+#include <dcp/local_time.h>
+#include <dcp/raw_convert.h>
+#include <dcp/warnings.h>
+#include <libcxml/cxml.h>
+LIBDCP_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+LIBDCP_ENABLE_WARNINGS
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+
+
+using std::make_shared;
+using std::map;
+using std::string;
+using std::vector;
+using dcp::raw_convert;
+#if BOOST_VERSION >= 106100
+using namespace boost::placeholders;
+#endif
+
+
+namespace {
+
+
+/** One timed run of a test */
+struct Run
+{
+	string date;
+	string version;
+	double time = 0;
+	bool regressed = false;
+};
+
+
+/** Number of runs of each test to keep in the results file */
+int const history_size = 50;
+/** Number of recent runs to take the median of for a test's baseline */
+int const baseline_size = 5;
+
+
+boost::filesystem::path
+results_file ()
+{
+	if (auto env = getenv("DCPOMATIC_PERFORMANCE_RESULTS")) {
+		return env;
+	}
+	return "build/test/performance.xml";
+}
+
+
+double
+threshold ()
+{
+	if (auto env = getenv("DCPOMATIC_PERFORMANCE_THRESHOLD")) {
+		return raw_convert<double>(env) / 100;
+	}
+	return 0.15;
+}
+
+
+map<string, vector<Run>>
+read_results ()
+{
+	map<string, vector<Run>> results;
+
+	try {
+		cxml::Document f ("Performance");
+		f.read_file (results_file());
+		for (auto test: f.node_children("Test")) {
+			auto& runs = results[test->string_attribute("Name")];
+			for (auto i: test->node_children("Run")) {
+				Run run;
+				run.date = i->string_child("Date");
+				run.version = i->string_child("Version");
+				run.time = i->number_child<double>("Time");
+				run.regressed = i->bool_child("Regressed");
+				runs.push_back (run);
+			}
+		}
+	} catch (...) {
+		/* No results yet */
+	}
+
+	return results;
+}
+
+
+void
+write_results (map<string, vector<Run>> const& results)
+{
+	xmlpp::Document doc;
+	auto root = doc.create_root_node ("Performance");
+
+	for (auto const& i: results) {
+		auto test = root->add_child("Test");
+		test->set_attribute("Name", i.first);
+		for (auto const& j: i.second) {
+			auto run = test->add_child("Run");
+			run->add_child("Date")->add_child_text(j.date);
+			run->add_child("Version")->add_child_text(j.version);
+			run->add_child("Time")->add_child_text(raw_convert<string>(j.time, 3, true));
+			run->add_child("Regressed")->add_child_text(j.regressed ? "1" : "0");
+		}
+	}
+
+	doc.write_to_file_formatted (results_file().string());
+}
+
+
+/** @return Median time of the last few runs which did not regress, or 0 if there are none */
+double
+baseline (vector<Run> const& runs)
+{
+	vector<double> times;
+	for (auto i = runs.rbegin(); i != runs.rend() && times.size() < static_cast<size_t>(baseline_size); ++i) {
+		if (!i->regressed) {
+			times.push_back (i->time);
+		}
+	}
+
+	if (times.empty()) {
+		return 0;
+	}
+
+	std::sort (times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+
+/** Record the time for a run of a test and check it against the baseline.
+ *  @param name Name of the test.
+ *  @param time Time that the test took, in seconds.
+ */
+void
+record (string name, double time)
+{
+	auto results = read_results ();
+	auto& runs = results[name];
+
+	auto const base = baseline (runs);
+	Run run;
+	run.date = dcp::LocalTime().as_string();
+	run.version = dcpomatic_version;
+	run.time = time;
+	run.regressed = base > 0 && time > base * (1 + threshold());
+
+	BOOST_TEST_MESSAGE (name << " took " << time << "s against a baseline of " << base << "s");
+	BOOST_CHECK_MESSAGE (
+		!run.regressed,
+		name << " took " << time << "s, more than " << (threshold() * 100) << "% longer than its baseline of " << base << "s"
+		);
+
+	runs.push_back (run);
+	if (runs.size() > static_cast<size_t>(history_size)) {
+		runs.erase (runs.begin(), runs.end() - history_size);
+	}
+
+	write_results (results);
+}
+
+
+/** Time something
+ *  @return Time that @p work took, in seconds.
+ */
+template <class F>
+double
+time_of (F work)
+{
+	auto const start = std::chrono::steady_clock::now();
+	work ();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/** Make a DCP of a film, without verifying it, and return the time that took */
+double
+time_make_dcp (std::shared_ptr<Film> film)
+{
+	film->write_metadata ();
+	return time_of([film]() {
+		make_dcp (film, TranscodeJob::ChangedBehaviour::IGNORE);
+		BOOST_REQUIRE (!wait_for_jobs());
+	});
+}
+
+
+}
+
+
+/** 4K encode of a short FFmpeg file, as in fourk_test */
+BOOST_AUTO_TEST_CASE (performance_4k_encode_test, * boost::unit_test::label("performance") * boost::unit_test::disabled())
+{
+	auto film = new_test_film2 ("performance_4k_encode_test", { make_shared<FFmpegContent>("test/data/test.mp4") });
+	film->set_resolution (Resolution::FOUR_K);
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name("FTR"));
+	film->set_container (Ratio::from_id("185"));
+
+	record ("4k_encode", time_make_dcp(film));
+}
+
+
+/** 2K transcode of a short FFmpeg file, as in ffmpeg_dcp_test */
+BOOST_AUTO_TEST_CASE (performance_ffmpeg_dcp_test, * boost::unit_test::label("performance") * boost::unit_test::disabled())
+{
+	auto film = new_test_film2 ("performance_ffmpeg_dcp_test", { make_shared<FFmpegContent>("test/data/test.mp4") });
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name("TST"));
+	film->set_container (Ratio::from_id("185"));
+
+	record ("ffmpeg_dcp", time_make_dcp(film));
+}
+
+
+/** Playback of a DCP through the butler, as in dcp_playback_test */
+BOOST_AUTO_TEST_CASE (performance_dcp_playback_test, * boost::unit_test::label("performance") * boost::unit_test::disabled())
+{
+	auto content = make_shared<DCPContent>(TestPaths::private_data() / "JourneyToJah_TLR-1_F_EN-DE-FR_CH_51_2K_LOK_20140225_DGL_SMPTE_OV");
+	auto film = new_test_film2 ("performance_dcp_playback_test", { content });
+
+	Player player(film, Image::Alignment::PADDED);
+
+	auto butler = make_shared<Butler>(
+		film,
+		player,
+		AudioMapping(6, 6),
+		6,
+		boost::bind(&PlayerVideo::force, AV_PIX_FMT_RGB24),
+		VideoRange::FULL,
+		Image::Alignment::PADDED,
+		true,
+		false,
+		Butler::Audio::ENABLED
+		);
+
+	vector<float> audio_buffer(2000 * 6);
+	record ("dcp_playback", time_of([&butler, &audio_buffer]() {
+		while (true) {
+			auto p = butler->get_video (Butler::Behaviour::BLOCKING, 0);
+			if (!p.first) {
+				break;
+			}
+			butler->get_audio (Butler::Behaviour::BLOCKING, audio_buffer.data(), 2000);
+			p.first->image(boost::bind(&PlayerVideo::force, AV_PIX_FMT_RGB24), VideoRange::FULL, true);
+		}
+	}));
+}
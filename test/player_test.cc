@@ -35,7 +35,9 @@
 #include "lib/ffmpeg_content.h"
 #include "lib/film.h"
 #include "lib/image_content.h"
+#include "lib/piece.h"
 #include "lib/player.h"
+#include "lib/player_profile.h"
 #include "lib/ratio.h"
 #include "lib/string_text_file_content.h"
 #include "lib/text_content.h"
@@ -348,6 +350,43 @@ BOOST_AUTO_TEST_CASE (player_ignore_video_and_audio_test)
 }
 
 
+/** Test ignoring both video and text, so that only audio is decoded */
+BOOST_AUTO_TEST_CASE (player_ignore_video_and_text_test)
+{
+	auto image = content_factory("test/data/flat_red.png")[0];
+	auto sine = content_factory("test/data/sine_440.wav")[0];
+	auto film = new_test_film2 ("player_ignore_video_and_text_test", { image, sine });
+	sine->set_position (film, image->end(film));
+
+	accumulated = std::make_shared<AudioBuffers>(film->audio_channels(), 0);
+
+	Player player(film, Image::Alignment::COMPACT);
+	player.set_ignore_video();
+	player.set_ignore_text();
+
+	int video_frames = 0;
+	player.Video.connect([&video_frames](shared_ptr<PlayerVideo>, DCPTime) { ++video_frames; });
+	player.Audio.connect(bind(&accumulate, _1, _2));
+	while (!player.pass()) {}
+
+	BOOST_CHECK_EQUAL (video_frames, 0);
+
+	/* There should be silence for the image, then the sine */
+	auto const image_frames = image->end(film).frames_round(film->audio_frame_rate());
+	BOOST_REQUIRE (accumulated->frames() > image_frames);
+	float image_peak = 0;
+	float sine_peak = 0;
+	for (int c = 0; c < accumulated->channels(); ++c) {
+		for (int i = 0; i < accumulated->frames(); ++i) {
+			auto& peak = i < image_frames ? image_peak : sine_peak;
+			peak = std::max(peak, std::abs(accumulated->data(c)[i]));
+		}
+	}
+	BOOST_CHECK_EQUAL (image_peak, 0);
+	BOOST_CHECK (sine_peak > 0);
+}
+
+
 /** Trigger a crash due to the assertion failure in Player::emit_audio */
 BOOST_AUTO_TEST_CASE (player_trim_crash)
 {
@@ -538,3 +577,151 @@ BOOST_AUTO_TEST_CASE (interleaved_subtitle_are_emitted_correctly)
 	while (!player.pass()) {}
 }
 
+
+
+/** Check that a DCP's subtitles come out the same when we are ignoring its video and audio
+ *  (where the DCP decoder skips through reels rather than going frame by frame) as when we are not.
+ */
+BOOST_AUTO_TEST_CASE (player_dcp_texts_only_test)
+{
+	auto image = content_factory("test/data/flat_red.png")[0];
+	auto text = content_factory("test/data/subrip.srt")[0];
+	auto film = new_test_film2 ("player_dcp_texts_only_test", { image, text });
+	image->video->set_length (10 * 24);
+	make_and_verify_dcp (
+		film,
+		{
+			dcp::VerificationNote::Code::MISSING_SUBTITLE_LANGUAGE,
+			dcp::VerificationNote::Code::INVALID_SUBTITLE_FIRST_TEXT_TIME,
+			dcp::VerificationNote::Code::MISSING_CPL_METADATA
+		});
+
+	auto dcp = make_shared<DCPContent>(film->dir(film->dcp_name()));
+	auto film2 = new_test_film2 ("player_dcp_texts_only_test2", { dcp });
+
+	auto texts = [film2](bool ignore_video) {
+		Player player(film2, Image::Alignment::COMPACT);
+		if (ignore_video) {
+			player.set_ignore_video();
+		}
+		player.set_ignore_audio();
+		list<Sub> out;
+		player.Text.connect(bind(&store, &out, _1, _2, _3, _4));
+		while (!player.pass()) {}
+		return out;
+	};
+
+	auto all = texts(false);
+	auto only = texts(true);
+
+	BOOST_REQUIRE (!all.empty());
+	BOOST_REQUIRE_EQUAL (all.size(), only.size());
+	auto i = all.begin();
+	auto j = only.begin();
+	while (i != all.end()) {
+		BOOST_CHECK (i->period == j->period);
+		BOOST_REQUIRE_EQUAL (i->text.string.size(), j->text.string.size());
+		BOOST_CHECK_EQUAL (i->text.string.front().text(), j->text.string.front().text());
+		++i;
+		++j;
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE (player_profile_test)
+{
+	auto image = content_factory("test/data/flat_red.png")[0];
+	auto film = new_test_film2 ("player_profile_test", { image });
+	image->video->set_length (24);
+	/* Leave a gap at the start for the player to fill with black */
+	image->set_position (film, DCPTime::from_seconds(1));
+
+	Player player (film, Image::Alignment::COMPACT);
+	auto profile = make_shared<PlayerProfile>();
+	player.set_profile (profile);
+	int frames = 0;
+	player.Video.connect ([&frames](shared_ptr<PlayerVideo>, DCPTime) { ++frames; });
+	while (!player.pass()) {}
+	BOOST_CHECK_EQUAL (frames, 48);
+
+	auto const counts = profile->counts();
+	for (auto name: { "pass", "sink", "video", "empty" }) {
+		BOOST_REQUIRE_MESSAGE (counts.find(name) != counts.end(), name);
+		BOOST_CHECK (counts.at(name).number > 0);
+	}
+	BOOST_CHECK (std::any_of(counts.begin(), counts.end(), [](std::pair<std::string, PlayerProfile::Counts> const& i) {
+		return boost::starts_with(i.first, "decode: ");
+	}));
+}
+
+
+/** Check that a change to one piece of content only replaces that content's piece */
+BOOST_AUTO_TEST_CASE (player_update_piece_test)
+{
+	auto A = content_factory("test/data/flat_red.png")[0];
+	auto B = content_factory("test/data/flat_green.png")[0];
+	auto C = content_factory("test/data/flat_blue.png")[0];
+	auto film = new_test_film2 ("player_update_piece_test", { A, B, C });
+	film->set_sequence (false);
+
+	Player player(film, Image::Alignment::COMPACT);
+
+	auto pieces = [&player]() {
+		return std::vector<shared_ptr<Piece>>(player._pieces.begin(), player._pieces.end());
+	};
+
+	auto before = pieces();
+	BOOST_REQUIRE_EQUAL (before.size(), 3U);
+
+	B->video->set_fade_in (2);
+	auto after = pieces();
+	BOOST_REQUIRE_EQUAL (after.size(), 3U);
+	BOOST_CHECK (after[0] == before[0]);
+	BOOST_CHECK (after[1] != before[1]);
+	BOOST_CHECK (after[1]->content == B);
+	BOOST_CHECK (after[2] == before[2]);
+
+	/* Moving A to the end should re-order the pieces but keep B's and C's */
+	A->set_position (film, C->end(film));
+	auto moved = pieces();
+	BOOST_REQUIRE_EQUAL (moved.size(), 3U);
+	BOOST_CHECK (moved[0] == after[1]);
+	BOOST_CHECK (moved[1] == after[2]);
+	BOOST_CHECK (moved[2]->content == A);
+
+	/* The result should play through as if the pieces had been made from scratch */
+	int frames = 0;
+	player.Video.connect ([&frames](shared_ptr<PlayerVideo>, DCPTime) {
+		++frames;
+	});
+	player.seek (DCPTime(), true);
+	while (!player.pass()) {}
+	BOOST_CHECK_EQUAL (frames, film->length().frames_round(film->video_frame_rate()));
+}
+
+
+/** Check that the player gives the right video, in order, from many short pieces of content */
+BOOST_AUTO_TEST_CASE (player_many_pieces_test)
+{
+	std::vector<shared_ptr<Content>> content;
+	for (int i = 0; i < 40; ++i) {
+		content.push_back (content_factory(i % 2 ? "test/data/flat_red.png" : "test/data/flat_green.png")[0]);
+	}
+	auto film = new_test_film2 ("player_many_pieces_test", content);
+	for (auto i: content) {
+		i->video->set_length (3);
+	}
+
+	Player player(film, Image::Alignment::COMPACT);
+
+	std::vector<DCPTime> times;
+	player.Video.connect ([&times](shared_ptr<PlayerVideo>, DCPTime time) {
+		times.push_back (time);
+	});
+	while (!player.pass()) {}
+
+	BOOST_REQUIRE_EQUAL (times.size(), 40U * 3);
+	for (size_t i = 0; i < times.size(); ++i) {
+		BOOST_CHECK (times[i] == DCPTime::from_frames(i, film->video_frame_rate()));
+	}
+}
@@ -0,0 +1,102 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/player_video_cache_test.cc
+ *  @brief Test PlayerVideoCache class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/image.h"
+#include "lib/player_video.h"
+#include "lib/player_video_cache.h"
+#include "lib/raw_image_proxy.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::weak_ptr;
+using boost::optional;
+using namespace dcpomatic;
+
+
+static
+shared_ptr<PlayerVideo>
+make_player_video ()
+{
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(64, 64), Image::Alignment::COMPACT);
+	image->make_black ();
+	return make_shared<PlayerVideo>(
+		make_shared<RawImageProxy>(image),
+		Crop(),
+		optional<double>(),
+		dcp::Size(64, 64),
+		dcp::Size(64, 64),
+		Eyes::BOTH,
+		Part::WHOLE,
+		optional<ColourConversion>(),
+		VideoRange::FULL,
+		weak_ptr<Content>(),
+		optional<Frame>(),
+		false
+		);
+}
+
+
+BOOST_AUTO_TEST_CASE (player_video_cache_test)
+{
+	auto const one_frame = DCPTime::from_frames(1, 24);
+	auto const frame_memory = make_player_video()->memory_used();
+
+	/* Room for three frames */
+	PlayerVideoCache cache (frame_memory * 3);
+
+	auto a = make_player_video ();
+	auto b = make_player_video ();
+	auto c = make_player_video ();
+	auto d = make_player_video ();
+
+	cache.put (a, DCPTime::from_frames(0, 24));
+	cache.put (b, DCPTime::from_frames(1, 24));
+	cache.put (c, DCPTime::from_frames(2, 24));
+	BOOST_CHECK_EQUAL (cache.memory_used(), frame_memory * 3);
+
+	/* Any time within a frame should find it */
+	auto got = cache.get(DCPTime::from_frames(1, 24) + DCPTime(1), one_frame);
+	BOOST_REQUIRE (got);
+	BOOST_CHECK (got->first == b);
+	BOOST_CHECK (got->second == DCPTime::from_frames(1, 24));
+	BOOST_CHECK (!cache.get(DCPTime::from_frames(3, 24), one_frame));
+
+	/* After looking at a and c, b is the least-recently used so it should be thrown out to make room for d */
+	BOOST_REQUIRE (cache.get(DCPTime(), one_frame));
+	BOOST_REQUIRE (cache.get(DCPTime::from_frames(2, 24), one_frame));
+	cache.put (d, DCPTime::from_frames(3, 24));
+	BOOST_CHECK_EQUAL (cache.memory_used(), frame_memory * 3);
+	BOOST_CHECK (cache.get(DCPTime(), one_frame));
+	BOOST_CHECK (!cache.get(DCPTime::from_frames(1, 24), one_frame));
+	BOOST_CHECK (cache.get(DCPTime::from_frames(3, 24), one_frame)->first == d);
+
+	cache.clear ();
+	BOOST_CHECK_EQUAL (cache.memory_used(), 0U);
+	BOOST_CHECK (!cache.get(DCPTime(), one_frame));
+}
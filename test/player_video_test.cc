@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/player_video_test.cc
+ *  @brief Test PlayerVideo class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/image.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/text_render_pool.h"
+#include <boost/bind/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/barrier.hpp>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::weak_ptr;
+using boost::optional;
+
+
+static
+shared_ptr<PlayerVideo>
+make_player_video (shared_ptr<const ImageProxy> proxy, optional<double> fade)
+{
+	return make_shared<PlayerVideo>(
+		proxy,
+		Crop(),
+		fade,
+		dcp::Size(64, 64),
+		dcp::Size(64, 64),
+		Eyes::BOTH,
+		Part::WHOLE,
+		optional<ColourConversion>(),
+		VideoRange::FULL,
+		weak_ptr<Content>(),
+		optional<Frame>(),
+		false
+		);
+}
+
+
+/** Frames made from the same source image with the same settings should share a finished image */
+BOOST_AUTO_TEST_CASE (player_video_shared_image_test)
+{
+	auto source = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(64, 64), Image::Alignment::PADDED);
+	source->make_black ();
+	auto proxy = make_shared<RawImageProxy>(source);
+
+	auto const format = boost::bind(&PlayerVideo::force, AV_PIX_FMT_RGB24);
+
+	auto a = make_player_video(proxy, {})->image(format, VideoRange::FULL, false);
+	auto b = make_player_video(proxy, {})->image(format, VideoRange::FULL, false);
+	BOOST_CHECK (a == b);
+
+	/* Same source, different settings */
+	auto c = make_player_video(proxy, 0.5)->image(format, VideoRange::FULL, false);
+	BOOST_CHECK (c != a);
+
+	/* Different source which happens to be the same */
+	auto other = make_shared<Image>(*source);
+	auto d = make_player_video(make_shared<RawImageProxy>(other), {})->image(format, VideoRange::FULL, false);
+	BOOST_CHECK (d != a);
+	BOOST_CHECK (*d == *a);
+}
+
+
+/** Text which is still being rendered should be waited for when the image is made, and frames with
+ *  the same pending text should be the same without waiting.
+ */
+BOOST_AUTO_TEST_CASE (player_video_pending_text_test)
+{
+	auto source = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size(64, 64), Image::Alignment::PADDED);
+	source->make_black ();
+	auto proxy = make_shared<RawImageProxy>(source);
+
+	auto text = make_shared<Image>(AV_PIX_FMT_BGRA, dcp::Size(16, 16), Image::Alignment::PADDED);
+	text->make_black ();
+	text->data()[0][0] = 0xff;
+	text->data()[0][3] = 0xff;
+
+	boost::barrier go (2);
+	auto pending = TextRenderPool::instance()->render([&go, text]() {
+		go.wait ();
+		return optional<PositionImage>(PositionImage(text, Position<int>(0, 0)));
+	});
+
+	auto a = make_player_video(proxy, {});
+	a->set_text (pending);
+	auto b = make_player_video(proxy, {});
+	b->set_text (pending);
+	auto c = make_player_video(proxy, {});
+	c->set_text (PositionImage(text, Position<int>(0, 0)));
+
+	BOOST_CHECK (a->same(b));
+	/* c's text is the same, but we can't know that without waiting */
+	BOOST_CHECK (!a->same(c));
+
+	go.wait ();
+
+	auto const format = boost::bind(&PlayerVideo::force, AV_PIX_FMT_RGB24);
+	auto image = a->image(format, VideoRange::FULL, false);
+	BOOST_CHECK_EQUAL (image->data()[0][2], 0xff);
+	BOOST_CHECK (a->same(c));
+}
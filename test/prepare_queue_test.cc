@@ -0,0 +1,100 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/prepare_queue_test.cc
+ *  @brief Test PrepareQueue class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/prepare_queue.h"
+#include <boost/test/unit_test.hpp>
+#include <future>
+
+
+using std::vector;
+using namespace dcpomatic;
+
+
+BOOST_AUTO_TEST_CASE (prepare_queue_threads_needed_test)
+{
+	/* 4K JPEG2000 at 24fps */
+	BOOST_CHECK_EQUAL (PrepareQueue::threads_needed(0.2, 24, 16), 10);
+	/* HD H.264 */
+	BOOST_CHECK_EQUAL (PrepareQueue::threads_needed(0.002, 24, 16), 1);
+	BOOST_CHECK_EQUAL (PrepareQueue::threads_needed(0, 24, 16), 1);
+	BOOST_CHECK_EQUAL (PrepareQueue::threads_needed(10, 24, 16), 16);
+}
+
+
+/** Check that tasks run earliest-first, and that clear() drops them */
+BOOST_AUTO_TEST_CASE (prepare_queue_order_test)
+{
+	for (auto clear: { false, true }) {
+		boost::mutex mutex;
+		boost::condition condition;
+		vector<int> done;
+		std::promise<void> started;
+		std::promise<void> release;
+		auto release_future = release.get_future();
+
+		auto record = [&](int frame) {
+			boost::mutex::scoped_lock lm (mutex);
+			done.push_back (frame);
+			condition.notify_all ();
+		};
+
+		{
+			PrepareQueue queue (1, []() {});
+
+			/* This one will hold the only thread up until we have added the others */
+			queue.add (DCPTime::from_frames(100, 24), [&]() {
+				started.set_value ();
+				release_future.wait ();
+				record (100);
+			});
+			started.get_future().wait ();
+
+			for (auto frame: { 50, 30, 70, 30 }) {
+				queue.add (DCPTime::from_frames(frame, 24), [&record, frame]() { record(frame); });
+			}
+			BOOST_CHECK_EQUAL (queue.waiting(), 4U);
+
+			if (clear) {
+				queue.clear ();
+				BOOST_CHECK_EQUAL (queue.waiting(), 0U);
+			}
+
+			release.set_value ();
+
+			boost::mutex::scoped_lock lm (mutex);
+			while (done.size() < (clear ? 1U : 5U)) {
+				condition.wait (lm);
+			}
+		}
+
+		if (clear) {
+			BOOST_CHECK (done == vector<int>({ 100 }));
+		} else {
+			BOOST_CHECK (done == vector<int>({ 100, 30, 30, 50, 70 }));
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/rate_control_test.cc
+ *  @brief Test the sharing-out of J2K bandwidth for two-pass encodes.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/image.h"
+#include "lib/rate_control.h"
+#include <boost/test/unit_test.hpp>
+#include <numeric>
+
+
+using std::make_shared;
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (allocate_j2k_bandwidths_test)
+{
+	/* Everything the same */
+	auto flat = allocate_j2k_bandwidths (vector<double>(5, 3), 100000000, 25000000, 250000000);
+	BOOST_REQUIRE_EQUAL (flat.size(), 5U);
+	for (auto i: flat) {
+		BOOST_CHECK_EQUAL (i, 100000000);
+	}
+
+	/* Nothing at all; still shared out evenly */
+	auto zero = allocate_j2k_bandwidths (vector<double>(4, 0), 100000000, 25000000, 250000000);
+	for (auto i: zero) {
+		BOOST_CHECK_EQUAL (i, 100000000);
+	}
+
+	/* A mixture; the limits must be kept and the average should be (about) right */
+	vector<double> mixed = { 1, 1, 1, 100, 0, 5, 5, 5 };
+	auto result = allocate_j2k_bandwidths (mixed, 100000000, 25000000, 250000000);
+	BOOST_REQUIRE_EQUAL (result.size(), mixed.size());
+	for (auto i: result) {
+		BOOST_CHECK (i >= 25000000);
+		BOOST_CHECK (i <= 250000000);
+	}
+	BOOST_CHECK_EQUAL (result[3], 250000000);
+	BOOST_CHECK_EQUAL (result[4], 25000000);
+	BOOST_CHECK (result[5] > result[0]);
+	auto const total = std::accumulate (result.begin(), result.end(), int64_t(0));
+	BOOST_CHECK (std::abs(total - int64_t(100000000) * 8) < 8);
+
+	BOOST_CHECK (allocate_j2k_bandwidths({}, 100000000, 25000000, 250000000).empty());
+}
+
+
+BOOST_AUTO_TEST_CASE (frame_complexity_test)
+{
+	dcp::Size const size (64, 64);
+
+	auto flat = make_shared<Image>(AV_PIX_FMT_RGB48LE, size, Image::Alignment::PADDED);
+	flat->make_black ();
+	BOOST_CHECK_EQUAL (frame_complexity(flat), 0);
+
+	auto stripes = make_shared<Image>(AV_PIX_FMT_RGB48LE, size, Image::Alignment::PADDED);
+	for (int y = 0; y < size.height; ++y) {
+		auto p = reinterpret_cast<uint16_t*>(stripes->data()[0] + y * stripes->stride()[0]);
+		for (int x = 0; x < size.width * 3; ++x) {
+			p[x] = ((x / 3) % 2) ? 65535 : 0;
+		}
+	}
+	BOOST_CHECK (frame_complexity(stripes) > 0);
+}
@@ -0,0 +1,143 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/read_ahead_test.cc
+ *  @brief Test ReadAhead class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/compose.hpp"
+#include "lib/file_group.h"
+#include "lib/read_ahead.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <cstdio>
+
+
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (read_ahead_test)
+{
+	/* Files which add up to a few blocks, with one boundary between files inside a block */
+	vector<int> const length = {
+		ReadAhead::block_size + 4242,
+		ReadAhead::block_size * 2 - 100,
+		77
+	};
+
+	boost::filesystem::create_directories ("build/test/read_ahead_test");
+	vector<boost::filesystem::path> name;
+	vector<uint8_t> data;
+	for (size_t i = 0; i < length.size(); ++i) {
+		name.push_back (String::compose("build/test/read_ahead_test/%1", i));
+		vector<uint8_t> file (length[i]);
+		for (auto& j: file) {
+			j = rand() & 0xff;
+		}
+		auto f = fopen (name.back().string().c_str(), "wb");
+		fwrite (file.data(), 1, file.size(), f);
+		fclose (f);
+		data.insert (data.end(), file.begin(), file.end());
+	}
+
+	int64_t const total_length = data.size();
+
+	for (auto threads: { 1, 3 }) {
+		ReadAhead ra (name, ReadAhead::block_size * 2, threads);
+		FileGroup fg (name);
+		BOOST_CHECK_EQUAL (ra.length(), total_length);
+
+		vector<uint8_t> a (total_length + 1000);
+		vector<uint8_t> b (total_length + 1000);
+
+		/* Read the whole lot in assorted sizes */
+		int64_t pos = 0;
+		int amount = 1;
+		while (pos < total_length) {
+			auto const got = ra.read (a.data(), amount);
+			BOOST_REQUIRE_EQUAL (got, fg.read(b.data(), amount));
+			BOOST_REQUIRE (std::equal(a.begin(), a.begin() + got, b.begin()));
+			pos += got;
+			amount = amount * 7 % 300007 + 1;
+		}
+		BOOST_CHECK_EQUAL (ra.read(a.data(), 64), 0);
+
+		/* Seeks in various directions and amounts */
+		vector<std::pair<int64_t, int>> const seeks = {
+			{ 12, SEEK_SET },
+			{ ReadAhead::block_size * 2 + 7, SEEK_SET },
+			{ -ReadAhead::block_size, SEEK_CUR },
+			{ 99, SEEK_END },
+			{ ReadAhead::block_size - 10, SEEK_SET },
+			{ 0, SEEK_SET },
+		};
+
+		for (auto const& i: seeks) {
+			BOOST_CHECK_EQUAL (ra.seek(i.first, i.second), fg.seek(i.first, i.second));
+			auto const got = ra.read (a.data(), 150000);
+			BOOST_REQUIRE_EQUAL (got, fg.read(b.data(), 150000));
+			BOOST_CHECK (std::equal(a.begin(), a.begin() + got, b.begin()));
+		}
+
+		/* Seeking off the end should be remembered, as with FileGroup */
+		BOOST_CHECK_EQUAL (ra.seek(total_length * 2, SEEK_SET), total_length * 2);
+		BOOST_CHECK_EQUAL (ra.read(a.data(), 64), 0);
+		BOOST_CHECK_EQUAL (ra.seek(-total_length * 2, SEEK_CUR), 0);
+		BOOST_CHECK_EQUAL (ra.read(a.data(), 64), 64);
+		BOOST_CHECK (std::equal(a.begin(), a.begin() + 64, data.begin()));
+	}
+}
+
+
+/** Two ReadAheads of the same files, reading close to each other, should fetch each block only once */
+BOOST_AUTO_TEST_CASE (read_ahead_shared_test)
+{
+	boost::filesystem::create_directories ("build/test/read_ahead_shared_test");
+	boost::filesystem::path name = "build/test/read_ahead_shared_test/data";
+	vector<uint8_t> data (ReadAhead::block_size * 5 + 999);
+	for (auto& i: data) {
+		i = rand() & 0xff;
+	}
+	auto f = fopen (name.string().c_str(), "wb");
+	fwrite (data.data(), 1, data.size(), f);
+	fclose (f);
+
+	ReadAhead a ({ name }, ReadAhead::block_size * 2, 2);
+	ReadAhead b ({ name }, ReadAhead::block_size * 2, 2);
+
+	vector<uint8_t> buffer_a (65536);
+	vector<uint8_t> buffer_b (65536);
+	int64_t pos = 0;
+	while (pos < static_cast<int64_t>(data.size())) {
+		auto const got_a = a.read (buffer_a.data(), buffer_a.size());
+		auto const got_b = b.read (buffer_b.data(), buffer_b.size());
+		BOOST_REQUIRE_EQUAL (got_a, got_b);
+		BOOST_REQUIRE (got_a > 0);
+		BOOST_REQUIRE (std::equal(buffer_a.begin(), buffer_a.begin() + got_a, data.begin() + pos));
+		BOOST_REQUIRE (std::equal(buffer_b.begin(), buffer_b.begin() + got_b, data.begin() + pos));
+		pos += got_a;
+	}
+
+	BOOST_CHECK_EQUAL (a.blocks_fetched(), 6);
+	BOOST_CHECK_EQUAL (b.blocks_fetched(), 6);
+}
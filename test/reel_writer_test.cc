@@ -25,6 +25,7 @@
  */
 
 
+#include "lib/audio_buffers.h"
 #include "lib/audio_content.h"
 #include "lib/content.h"
 #include "lib/content_factory.h"
@@ -41,6 +42,7 @@
 #include <boost/test/unit_test.hpp>
 
 
+using std::make_shared;
 using std::shared_ptr;
 using std::string;
 using boost::optional;
@@ -103,6 +105,66 @@ BOOST_AUTO_TEST_CASE (write_frame_info_test)
 }
 
 
+BOOST_AUTO_TEST_CASE (commit_mark_test)
+{
+	auto film = new_test_film2 ("commit_mark_test");
+	dcpomatic::DCPTimePeriod const period (dcpomatic::DCPTime(0), dcpomatic::DCPTime(96000));
+	ReelWriter writer (film, period, shared_ptr<Job>(), 0, 1, false);
+
+	BOOST_CHECK (!writer.read_commit_mark());
+
+	string const hash1 = "12345678901234567890123456789012";
+	string const hash2 = "123acb789f1234ae782012n456339522";
+	writer._existing_frame_info = { dcp::FrameInfo(0, 123, hash1), dcp::FrameInfo(123, 456, hash2) };
+
+	writer.write_commit_mark (2, hash2);
+	BOOST_CHECK_EQUAL (writer.read_commit_mark().get_value_or(0), 2);
+
+	writer.write_commit_mark (1, hash1);
+	BOOST_CHECK_EQUAL (writer.read_commit_mark().get_value_or(0), 1);
+
+	/* A mark which does not agree with the info file should be ignored */
+	writer.write_commit_mark (1, hash2);
+	BOOST_CHECK (!writer.read_commit_mark());
+
+	/* and so should one which goes past the end of it */
+	writer.write_commit_mark (3, hash2);
+	BOOST_CHECK (!writer.read_commit_mark());
+}
+
+
+/** Check that a finished sound asset is used again by a new writer for the same reel, as
+ *  long as the film has not changed.
+ */
+BOOST_AUTO_TEST_CASE (sound_checkpoint_test)
+{
+	auto film = new_test_film2 ("sound_checkpoint_test");
+	dcpomatic::DCPTimePeriod const period (dcpomatic::DCPTime(0), dcpomatic::DCPTime::from_seconds(1));
+
+	{
+		ReelWriter writer (film, period, shared_ptr<Job>(), 0, 1, false);
+		auto audio = make_shared<AudioBuffers>(film->audio_channels(), film->audio_frame_rate());
+		audio->make_silent ();
+		writer.write (audio);
+		writer.finish_sound ();
+		BOOST_CHECK (boost::filesystem::exists(writer.sound_checkpoint_file()));
+	}
+
+	{
+		ReelWriter writer (film, period, shared_ptr<Job>(), 0, 1, false);
+		BOOST_CHECK (writer._sound_asset);
+		BOOST_CHECK (!writer._sound_asset_writer);
+	}
+
+	film->set_name ("sound_checkpoint_test_changed");
+
+	{
+		ReelWriter writer (film, period, shared_ptr<Job>(), 0, 1, false);
+		BOOST_CHECK (writer._sound_asset_writer);
+	}
+}
+
+
 /** Check that the reel writer correctly re-uses a video asset changed if we remake
  *  a DCP with no video changes.
  */
@@ -25,12 +25,15 @@
  */
 
 
+#include "lib/font_config.h"
 #include "lib/image.h"
 #include "lib/image_png.h"
 #include "lib/render_text.h"
 #include "lib/string_text.h"
 #include <dcp/subtitle_string.h>
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
+#include <cstring>
 
 
 using std::shared_ptr;
@@ -120,6 +123,55 @@ BOOST_AUTO_TEST_CASE (marked_up_test6)
 }
 
 
+/** Rendering the same text again (which will use a layout cached from the first time) must give the same image */
+BOOST_AUTO_TEST_CASE (render_text_repeat_test)
+{
+	std::list<StringText> s;
+	add (s, "Hello", false, false, false);
+	add (s, " world", true, false, false);
+
+	auto render = [&s]() {
+		auto images = render_text(s, dcp::Size(1998, 1080), dcpomatic::DCPTime(), 24);
+		BOOST_REQUIRE_EQUAL (images.size(), 1U);
+		return images.front();
+	};
+
+	auto first = render();
+	auto second = render();
+
+	BOOST_CHECK (first.position == second.position);
+	BOOST_REQUIRE (first.image->size() == second.image->size());
+	BOOST_CHECK (memcmp(first.image->data()[0], second.image->data()[0], first.image->stride()[0] * first.image->size().height) == 0);
+
+	std::list<StringText> other;
+	add (other, "Something much longer", false, false, false);
+	auto images = render_text(other, dcp::Size(1998, 1080), dcpomatic::DCPTime(), 24);
+	BOOST_REQUIRE_EQUAL (images.size(), 1U);
+	BOOST_CHECK (images.front().image->size().width > first.image->size().width);
+}
+
+
+/** bounding_boxes() should give the same areas as the images that render_text() makes */
+BOOST_AUTO_TEST_CASE (render_text_bounding_boxes_test)
+{
+	std::list<StringText> s;
+	add (s, "Hello", false, false, false);
+	add (s, " world", true, true, false);
+
+	auto const images = render_text(s, dcp::Size(1998, 1080), dcpomatic::DCPTime(), 24);
+	auto const boxes = bounding_boxes(s, dcp::Size(1998, 1080), dcpomatic::DCPTime(), 24);
+	BOOST_REQUIRE_EQUAL (images.size(), boxes.size());
+
+	auto image = images.begin();
+	for (auto const& box: boxes) {
+		BOOST_CHECK (box.position() == image->position);
+		BOOST_CHECK_EQUAL (box.width, image->image->size().width);
+		BOOST_CHECK_EQUAL (box.height, image->image->size().height);
+		++image;
+	}
+}
+
+
 #if 0
 
 BOOST_AUTO_TEST_CASE (render_text_test)
@@ -145,3 +197,27 @@ BOOST_AUTO_TEST_CASE (render_text_test)
 }
 
 #endif
+
+
+/** Making a font available should add it without disturbing the others, and only the first time it is asked for */
+BOOST_AUTO_TEST_CASE (font_config_make_font_available_test)
+{
+	/* Use copies of fonts so that we know nothing else has already made them available */
+	boost::filesystem::path const dir = "build/test/font_config_make_font_available_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	boost::filesystem::copy_file ("test/data/Inconsolata-VF.ttf", dir / "inconsolata.ttf");
+	boost::filesystem::copy_file ("fonts/LiberationSans-Italic.ttf", dir / "liberation.ttf");
+
+	auto config = FontConfig::instance();
+
+	auto const generation = config->generation();
+	BOOST_CHECK_EQUAL (config->make_font_available(dir / "inconsolata.ttf"), "Inconsolata");
+	BOOST_CHECK_EQUAL (config->generation(), generation + 1);
+
+	BOOST_CHECK_EQUAL (config->make_font_available(dir / "inconsolata.ttf"), "Inconsolata");
+	BOOST_CHECK_EQUAL (config->generation(), generation + 1);
+
+	BOOST_CHECK_EQUAL (config->make_font_available(dir / "liberation.ttf"), "Liberation Sans");
+	BOOST_CHECK_EQUAL (config->generation(), generation + 2);
+}
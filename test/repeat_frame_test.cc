@@ -34,11 +34,21 @@
 #include "lib/ratio.h"
 #include "lib/ffmpeg_content.h"
 #include "lib/dcp_content_type.h"
+#include "lib/image_content.h"
 #include "lib/video_content.h"
+#include <dcp/cpl.h>
+#include <dcp/dcp.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/reel.h>
+#include <dcp/reel_mono_picture_asset.h>
 
 
+using std::dynamic_pointer_cast;
 using std::make_shared;
 using std::shared_ptr;
+using namespace dcpomatic;
 
 
 BOOST_AUTO_TEST_CASE (repeat_frame_test)
@@ -54,3 +64,38 @@ BOOST_AUTO_TEST_CASE (repeat_frame_test)
 	/* Should be 32 frames of red followed by 16 frames of black to fill the DCP up to 1 second */
 	check_dcp ("test/data/repeat_frame_test", film->dir (film->dcp_name ()));
 }
+
+
+/** Check that a still which comes back after some other content is repeated in the DCP, rather than encoded again */
+BOOST_AUTO_TEST_CASE (repeat_recent_frame_test)
+{
+	auto red1 = make_shared<ImageContent>("test/data/flat_red.png");
+	auto green = make_shared<ImageContent>("test/data/flat_green.png");
+	auto red2 = make_shared<ImageContent>("test/data/flat_red.png");
+	auto film = new_test_film2 ("repeat_recent_frame_test", {red1, green, red2});
+
+	int n = 0;
+	for (auto i: { red1, green, red2 }) {
+		i->video->set_length (24);
+		i->set_position (film, DCPTime::from_frames(n * 24, 24));
+		++n;
+	}
+
+	make_and_verify_dcp (film);
+
+	dcp::DCP dcp (film->dir(film->dcp_name()));
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+	BOOST_REQUIRE_EQUAL (dcp.cpls()[0]->reels().size(), 1U);
+	auto picture = dynamic_pointer_cast<dcp::ReelMonoPictureAsset>(dcp.cpls()[0]->reels()[0]->main_picture());
+	BOOST_REQUIRE (picture);
+	auto reader = picture->mono_asset()->start_read();
+
+	auto first_red = reader->get_frame(0);
+	auto first_green = reader->get_frame(24);
+	auto second_red = reader->get_frame(48);
+
+	BOOST_REQUIRE_EQUAL (first_red->size(), second_red->size());
+	BOOST_CHECK (memcmp(first_red->data(), second_red->data(), first_red->size()) == 0);
+	BOOST_CHECK (first_red->size() != first_green->size() || memcmp(first_red->data(), first_green->data(), first_red->size()) != 0);
+}
@@ -0,0 +1,107 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/rgb_to_xyz_test.cc
+ *  @brief Test RGBToXYZ against libdcp's converter.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/colour_conversion.h"
+#include "lib/rgb_to_xyz.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <vector>
+
+
+using std::string;
+using std::vector;
+
+
+static void
+check (ColourConversion const& conversion)
+{
+	/* Odd width and padded stride, and more than one chunk per row */
+	dcp::Size const size (301, 17);
+	int const stride = 301 * 6 + 10;
+	vector<uint8_t> rgb (stride * size.height);
+
+	uint32_t seed = 1;
+	for (auto& i: rgb) {
+		seed = seed * 1103515245 + 12345;
+		i = seed >> 24;
+	}
+
+	int ref_clamped = 0;
+	auto ref = dcp::rgb_to_xyz (rgb.data(), size, stride, conversion, [&ref_clamped](dcp::NoteType, string) { ++ref_clamped; });
+	int clamped = 0;
+	auto xyz = RGBToXYZ::get(conversion)->convert(rgb.data(), size, stride, [&clamped](dcp::NoteType, string) { ++clamped; });
+
+	BOOST_CHECK_EQUAL (clamped, ref_clamped);
+	for (int c = 0; c < 3; ++c) {
+		BOOST_REQUIRE (std::equal(ref->data(c), ref->data(c) + size.width * size.height, xyz->data(c)));
+	}
+
+	/* Converting in uneven bands of rows should give the same thing */
+	dcp::OpenJPEGImage banded (size);
+	int banded_clamped = 0;
+	for (int first = 0; first < size.height; first += 5) {
+		banded_clamped += RGBToXYZ::get(conversion)->convert_rows(rgb.data(), stride, first, std::min(5, size.height - first), banded);
+	}
+
+	BOOST_CHECK_EQUAL (banded_clamped, ref_clamped);
+	for (int c = 0; c < 3; ++c) {
+		BOOST_REQUIRE (std::equal(ref->data(c), ref->data(c) + size.width * size.height, banded.data(c)));
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE (rgb_to_xyz_test)
+{
+	check (ColourConversion(dcp::ColourConversion::srgb_to_xyz()));
+	check (ColourConversion(dcp::ColourConversion::rec709_to_xyz()));
+	check (ColourConversion(dcp::ColourConversion::rec2020_to_xyz()));
+}
+
+
+BOOST_AUTO_TEST_CASE (rgb_to_xyz_shared_test)
+{
+	auto A = RGBToXYZ::get(ColourConversion(dcp::ColourConversion::srgb_to_xyz()));
+	auto B = RGBToXYZ::get(ColourConversion(dcp::ColourConversion::srgb_to_xyz()));
+	auto C = RGBToXYZ::get(ColourConversion(dcp::ColourConversion::rec709_to_xyz()));
+	BOOST_CHECK (A == B);
+	BOOST_CHECK (A != C);
+	BOOST_CHECK (RGBToXYZ::get(ColourConversion(dcp::ColourConversion::srgb_to_xyz())) == A);
+
+	/* Other threads should get the same converters */
+	std::shared_ptr<const RGBToXYZ> D;
+	std::shared_ptr<const RGBToXYZ> E;
+	boost::thread thread ([&D, &E]() {
+		D = RGBToXYZ::get(ColourConversion(dcp::ColourConversion::srgb_to_xyz()));
+		E = RGBToXYZ::get(ColourConversion(dcp::ColourConversion::rec709_to_xyz()));
+	});
+	thread.join ();
+	BOOST_CHECK (D == A);
+	BOOST_CHECK (E == C);
+}
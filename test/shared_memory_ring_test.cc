@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/shared_memory_ring_test.cc
+ *  @brief Test SharedMemoryRing class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/exceptions.h"
+#include "lib/shared_memory_ring.h"
+#include <boost/test/unit_test.hpp>
+#include <numeric>
+#include <vector>
+
+
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (shared_memory_ring_test)
+{
+	SharedMemoryRing writer (1000);
+	BOOST_REQUIRE (SharedMemoryRing::valid_name(writer.name()));
+	SharedMemoryRing reader (writer.name());
+	BOOST_CHECK_EQUAL (reader.size(), 1000U);
+
+	vector<uint8_t> data (400);
+	std::iota (data.begin(), data.end(), 0);
+
+	BOOST_CHECK_EQUAL (writer.put(data.data(), 400).get_value_or(1), 0U);
+	BOOST_CHECK_EQUAL (writer.put(data.data(), 400).get_value_or(0), 400U);
+	/* Full */
+	BOOST_CHECK (!writer.put(data.data(), 400));
+
+	vector<uint8_t> out (400);
+	reader.get (400, 400, out.data());
+	BOOST_CHECK (out == data);
+
+	/* Freeing the first allocation lets us wrap around to the start */
+	writer.release ();
+	BOOST_CHECK_EQUAL (writer.put(data.data() + 1, 300).get_value_or(1), 0U);
+	reader.get (0, 300, out.data());
+	BOOST_CHECK (vector<uint8_t>(out.begin(), out.begin() + 300) == vector<uint8_t>(data.begin() + 1, data.begin() + 301));
+	/* There are only 100 bytes between the newest and the oldest now */
+	BOOST_CHECK (!writer.put(data.data(), 101));
+	BOOST_CHECK_EQUAL (writer.put(data.data(), 100).get_value_or(0), 300U);
+
+	writer.release ();
+	writer.release ();
+	writer.release ();
+	vector<uint8_t> all (1000);
+	std::iota (all.begin(), all.end(), 0);
+	BOOST_CHECK_EQUAL (writer.put(all.data(), all.size()).get_value_or(1), 0U);
+
+	BOOST_CHECK_THROW (reader.get(900, 101, out.data()), NetworkError);
+
+	/* Once unlinked nobody else can open it, but the reader can still see what is there */
+	writer.unlink ();
+	BOOST_CHECK_THROW (SharedMemoryRing(writer.name()), std::exception);
+	reader.get (0, 400, out.data());
+	BOOST_CHECK (out == data);
+}
+
+
+BOOST_AUTO_TEST_CASE (shared_memory_ring_valid_name_test)
+{
+	BOOST_CHECK (SharedMemoryRing::valid_name("dcpomatic-0123abcd"));
+	BOOST_CHECK (!SharedMemoryRing::valid_name("dcpomatic-"));
+	BOOST_CHECK (!SharedMemoryRing::valid_name("something-0123abcd"));
+	BOOST_CHECK (!SharedMemoryRing::valid_name("dcpomatic-../../etc"));
+	BOOST_CHECK (!SharedMemoryRing::valid_name("dcpomatic-" + std::string(60, 'a')));
+}
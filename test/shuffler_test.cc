@@ -171,3 +171,31 @@ BOOST_AUTO_TEST_CASE (shuffler_test6)
 	push (s, 3, Eyes::RIGHT);
 	check (3, Eyes::RIGHT, __LINE__);
 }
+
+/** One right eye missing, after which complete pairs arrive.
+    Shuffler should give up on the missing eye once a couple of complete pairs are waiting,
+    rather than holding on to video until it is full.
+*/
+BOOST_AUTO_TEST_CASE (shuffler_test7)
+{
+	Shuffler s;
+	s.Video.connect (boost::bind (&receive, _1, _2));
+
+	push (s, 0, Eyes::LEFT);
+	check (0, Eyes::LEFT, __LINE__);
+
+	push (s, 1, Eyes::LEFT);
+	push (s, 1, Eyes::RIGHT);
+	BOOST_CHECK (pending_cv.empty());
+
+	push (s, 2, Eyes::LEFT);
+	push (s, 2, Eyes::RIGHT);
+	check (1, Eyes::LEFT, __LINE__);
+	check (1, Eyes::RIGHT, __LINE__);
+	check (2, Eyes::LEFT, __LINE__);
+	check (2, Eyes::RIGHT, __LINE__);
+	BOOST_CHECK (pending_cv.empty());
+
+	push (s, 3, Eyes::LEFT);
+	check (3, Eyes::LEFT, __LINE__);
+}
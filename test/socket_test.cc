@@ -20,6 +20,7 @@
 
 
 #include "lib/dcpomatic_socket.h"
+#include "lib/exceptions.h"
 #include "lib/server.h"
 #include <dcp/raw_convert.h>
 #include <boost/test/unit_test.hpp>
@@ -194,3 +195,104 @@ BOOST_AUTO_TEST_CASE (socket_digest_test2)
 	BOOST_CHECK (server.result());
 }
 
+
+/** Check that the socket "auto-digest" works with CRC-32C */
+BOOST_AUTO_TEST_CASE (socket_digest_test3)
+{
+	using boost::asio::ip::tcp;
+
+	TestServer server(false);
+	server.expect (13 + 4);
+
+	boost::asio::io_service io_service;
+	tcp::resolver resolver (io_service);
+	tcp::resolver::query query ("127.0.0.1", dcp::raw_convert<string>(TEST_SERVER_PORT));
+	tcp::resolver::iterator endpoint_iterator = resolver.resolve (query);
+
+	auto socket = make_shared<Socket>();
+	socket->set_digest_algorithm (Digester::Algorithm::CRC32C);
+	socket->connect (*endpoint_iterator);
+	{
+		Socket::WriteDigestScope ds(socket);
+		send (socket, "Hello world!");
+	}
+
+	server.await ();
+	BOOST_CHECK_EQUAL(strcmp(reinterpret_cast<char const *>(server.buffer()), "Hello world!"), 0);
+
+	/* CRC-32C of "Hello world!\0", big-endian */
+	char ref[] = "\xf1\x48\x92\x66";
+	BOOST_CHECK_EQUAL (memcmp(server.buffer() + 13, ref, 4), 0);
+}
+
+
+/** Check that a Socket can write to and read from memory, with digests */
+BOOST_AUTO_TEST_CASE (socket_buffer_test)
+{
+	std::vector<uint8_t> buffer;
+
+	auto writer = make_shared<Socket>();
+	writer->set_write_buffer (&buffer);
+	{
+		Socket::WriteDigestScope ds(writer);
+		writer->write (42);
+		send (writer, "Hello world!");
+	}
+
+	BOOST_CHECK_EQUAL (buffer.size(), 4U + 13U + 16U);
+
+	auto reader = make_shared<Socket>();
+	reader->set_read_buffer (buffer.data(), buffer.size());
+	{
+		Socket::ReadDigestScope ds(reader);
+		BOOST_CHECK_EQUAL (reader->read_uint32(), 42U);
+		uint8_t message[13];
+		reader->read (message, sizeof(message));
+		BOOST_CHECK_EQUAL (strcmp(reinterpret_cast<char const *>(message), "Hello world!"), 0);
+		BOOST_CHECK (ds.check());
+	}
+
+	BOOST_CHECK_THROW (reader->read_uint32(), NetworkError);
+}
+
+
+/** Check that scatter/gather reads and writes are the same as reading and writing each piece in turn */
+BOOST_AUTO_TEST_CASE (socket_scatter_gather_test)
+{
+	char const first[] = "Hello ";
+	char const second[] = "world!";
+
+	std::vector<uint8_t> one_by_one;
+	auto writer = make_shared<Socket>();
+	writer->set_write_buffer (&one_by_one);
+	{
+		Socket::WriteDigestScope ds(writer);
+		writer->write (reinterpret_cast<uint8_t const*>(first), 6);
+		writer->write (reinterpret_cast<uint8_t const*>(second), 7);
+	}
+
+	std::vector<uint8_t> gathered;
+	writer = make_shared<Socket>();
+	writer->set_write_buffer (&gathered);
+	{
+		Socket::WriteDigestScope ds(writer);
+		writer->write ({ boost::asio::buffer(first, 6), boost::asio::buffer(second, 7) });
+	}
+
+	BOOST_CHECK (one_by_one == gathered);
+
+	auto reader = make_shared<Socket>();
+	reader->set_read_buffer (gathered.data(), gathered.size());
+	{
+		Socket::ReadDigestScope ds(reader);
+		char a[4];
+		char b[9];
+		reader->read ({ boost::asio::buffer(a, sizeof(a)), boost::asio::buffer(b, sizeof(b)) });
+		BOOST_CHECK_EQUAL (memcmp(a, "Hell", 4), 0);
+		BOOST_CHECK_EQUAL (strcmp(b, "o world!"), 0);
+		BOOST_CHECK (ds.check());
+	}
+
+	uint8_t c[4];
+	BOOST_CHECK_THROW (reader->read({ boost::asio::buffer(c, sizeof(c)) }), NetworkError);
+}
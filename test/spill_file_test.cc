@@ -0,0 +1,70 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/spill_file_test.cc
+ *  @brief Test SpillFile class.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/spill_file.h"
+#include <dcp/array_data.h>
+#include <boost/test/unit_test.hpp>
+
+
+static dcp::ArrayData
+make_data (int size, uint8_t first)
+{
+	dcp::ArrayData data (size);
+	for (int i = 0; i < size; ++i) {
+		data.data()[i] = first + i;
+	}
+	return data;
+}
+
+
+BOOST_AUTO_TEST_CASE (spill_file_test)
+{
+	boost::filesystem::path const path = "build/test/spill_file_test";
+
+	{
+		SpillFile spill (path);
+
+		auto const a = spill.put(make_data(64, 0));
+		auto const b = spill.put(make_data(32, 100));
+		BOOST_CHECK_EQUAL (a, 0);
+		BOOST_CHECK_EQUAL (b, 64);
+
+		/* Take them back out of order */
+		auto b_back = spill.take(b, 32);
+		BOOST_CHECK (*b_back == make_data(32, 100));
+		auto a_back = spill.take(a, 64);
+		BOOST_CHECK (*a_back == make_data(64, 0));
+
+		/* Now that it's empty the file should be used again from the start */
+		auto const c = spill.put(make_data(16, 50));
+		BOOST_CHECK_EQUAL (c, 0);
+		BOOST_CHECK (*spill.take(c, 16) == make_data(16, 50));
+	}
+
+	/* and it should be cleaned up afterwards */
+	BOOST_CHECK (!boost::filesystem::exists(path));
+}
@@ -26,6 +26,7 @@
 
 
 #include "lib/film.h"
+#include "lib/string_text_file.h"
 #include "lib/string_text_file_content.h"
 #include "lib/dcp_content_type.h"
 #include "lib/font.h"
@@ -231,3 +232,20 @@ BOOST_AUTO_TEST_CASE (srt_subtitle_test4)
 	check_file ("build/test/subrip_render_test.png", "test/data/subrip_render_test.png");
 }
 #endif
+
+
+/** Readers of the same file should share one parse of it */
+BOOST_AUTO_TEST_CASE (srt_subtitle_shared_parse_test)
+{
+	auto content = make_shared<StringTextFileContent>("test/data/subrip2.srt");
+	auto film = new_test_film2 ("srt_subtitle_shared_parse_test", { content });
+
+	StringTextFile a (content);
+	StringTextFile b (content);
+	BOOST_CHECK (!a.subtitles().empty());
+	BOOST_CHECK (&a.subtitles() == &b.subtitles());
+
+	auto other = make_shared<StringTextFileContent>("test/data/frames.srt");
+	StringTextFile c (other);
+	BOOST_CHECK (&a.subtitles() != &c.subtitles());
+}
@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/string_text.h"
+#include "lib/text_ring_buffers.h"
+#include <dcp/subtitle_string.h>
+#include <boost/test/unit_test.hpp>
+
+
+using std::string;
+using namespace dcpomatic;
+
+
+static StringText
+caption_line (string text, float v_position, dcp::VAlign v_align)
+{
+	return StringText (
+		dcp::SubtitleString (
+			boost::optional<string>(),
+			false,
+			false,
+			false,
+			dcp::Colour(255, 255, 255),
+			42,
+			1,
+			dcp::Time(),
+			dcp::Time(),
+			0.5,
+			dcp::HAlign::CENTER,
+			v_position,
+			v_align,
+			0,
+			dcp::Direction::LTR,
+			text,
+			dcp::Effect::NONE,
+			dcp::Colour(0, 0, 0),
+			dcp::Time(),
+			dcp::Time(),
+			0
+			),
+		0,
+		std::shared_ptr<dcpomatic::Font>(),
+		dcp::Standard::SMPTE
+		);
+}
+
+
+BOOST_AUTO_TEST_CASE (text_ring_buffers_test)
+{
+	TextRingBuffers rb (4);
+	DCPTextTrack track ("Foo", dcp::LanguageTag("en-GB"));
+
+	BOOST_CHECK (!rb.get());
+
+	/* Lines should come out from the top of the screen down, however they were given */
+	PlayerText text;
+	text.string.push_back (caption_line("bottom", 0.1, dcp::VAlign::BOTTOM));
+	text.string.push_back (caption_line("top", 0.1, dcp::VAlign::TOP));
+	text.string.push_back (caption_line("middle", 0, dcp::VAlign::CENTER));
+	BOOST_CHECK (rb.put(text, track, DCPTimePeriod(DCPTime(0), DCPTime(100))));
+
+	auto data = rb.get();
+	BOOST_REQUIRE (data);
+	BOOST_REQUIRE_EQUAL (data->lines.size(), 3U);
+	BOOST_CHECK_EQUAL (data->lines[0], "top");
+	BOOST_CHECK_EQUAL (data->lines[1], "middle");
+	BOOST_CHECK_EQUAL (data->lines[2], "bottom");
+	BOOST_CHECK (data->period == DCPTimePeriod(DCPTime(0), DCPTime(100)));
+	BOOST_CHECK (!rb.get());
+
+	/* Fill it up */
+	for (int i = 0; i < 4; ++i) {
+		BOOST_CHECK (rb.put(PlayerText(), track, DCPTimePeriod(DCPTime(i * 100), DCPTime(i * 100 + 100))));
+	}
+	BOOST_CHECK (!rb.put(PlayerText(), track, DCPTimePeriod(DCPTime(400), DCPTime(500))));
+
+	data = rb.get();
+	BOOST_REQUIRE (data);
+	BOOST_CHECK (data->period.from == DCPTime(0));
+
+	/* Anything put before a clear() should not come out afterwards, and the next get()
+	 * should make room for more.
+	 */
+	rb.clear ();
+	BOOST_CHECK (!rb.get());
+	BOOST_CHECK (rb.put(PlayerText(), track, DCPTimePeriod(DCPTime(1000), DCPTime(1100))));
+	data = rb.get();
+	BOOST_REQUIRE (data);
+	BOOST_CHECK (data->period.from == DCPTime(1000));
+	BOOST_CHECK (!rb.get());
+
+	/* There should be room for everything again */
+	for (int i = 0; i < 4; ++i) {
+		BOOST_CHECK (rb.put(PlayerText(), track, DCPTimePeriod(DCPTime(i * 100), DCPTime(i * 100 + 100))));
+	}
+}
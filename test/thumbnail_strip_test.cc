@@ -0,0 +1,62 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/content_factory.h"
+#include "lib/film.h"
+#include "lib/image.h"
+#include "lib/thumbnail_strip.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+
+BOOST_AUTO_TEST_CASE (thumbnail_strip_make_write_read_test)
+{
+	auto content = content_factory("test/data/test.mp4")[0];
+	auto film = new_test_film2 ("thumbnail_strip_make_write_read_test", { content });
+
+	auto strip = ThumbnailStrip::make(film, content, []() { return false; });
+	BOOST_REQUIRE (strip);
+	BOOST_REQUIRE (!strip->thumbnails().empty());
+
+	for (auto const& i: strip->thumbnails()) {
+		BOOST_CHECK_EQUAL (i.image->size().height, ThumbnailStrip::height);
+		BOOST_CHECK (i.image->pixel_format() == AV_PIX_FMT_RGB24);
+	}
+
+	auto const path = film->thumbnails_path(content);
+	strip->write (path);
+
+	ThumbnailStrip check (path);
+	BOOST_REQUIRE_EQUAL (check.thumbnails().size(), strip->thumbnails().size());
+	for (size_t i = 0; i < check.thumbnails().size(); ++i) {
+		BOOST_CHECK (check.thumbnails()[i].time == strip->thumbnails()[i].time);
+		BOOST_CHECK (check.thumbnails()[i].image->size() == strip->thumbnails()[i].image->size());
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE (thumbnail_strip_stop_test)
+{
+	auto content = content_factory("test/data/test.mp4")[0];
+	auto film = new_test_film2 ("thumbnail_strip_stop_test", { content });
+
+	BOOST_CHECK (!ThumbnailStrip::make(film, content, []() { return true; }));
+}
@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/trace_test.cc
+ *  @brief Test Trace and TraceSpan.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/timer.h"
+#include "lib/trace.h"
+#include "lib/util.h"
+#include <dcp/util.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+
+using std::string;
+
+
+static
+int
+count (string const& haystack, string const& needle)
+{
+	int n = 0;
+	for (auto i = haystack.find(needle); i != string::npos; i = haystack.find(needle, i + 1)) {
+		++n;
+	}
+	return n;
+}
+
+
+BOOST_AUTO_TEST_CASE (trace_test)
+{
+	boost::filesystem::path const path = "build/test/trace_test.json";
+	boost::system::error_code ec;
+	boost::filesystem::remove (path, ec);
+
+	auto trace = Trace::instance();
+	trace->clear ();
+
+	{
+		/* Nothing should be recorded when tracing is off */
+		TraceSpan span("trace_test_off");
+	}
+
+	trace->start (path);
+
+	{
+		TraceSpan span("trace_test_span", 42);
+	}
+
+	auto other = boost::thread([]() {
+		start_of_thread ("TraceTestThread");
+		for (int i = 0; i < 4; ++i) {
+			TraceSpan span("trace_test_other");
+		}
+	});
+	other.join ();
+
+	{
+		StateTimer timer("trace_test_timer", "one");
+		timer.set ("two");
+	}
+
+	trace->write ();
+	trace->stop ();
+
+	{
+		TraceSpan span("trace_test_stopped");
+	}
+
+	auto const json = dcp::file_to_string (path);
+	BOOST_CHECK_EQUAL (json.substr(0, 15), "{\"traceEvents\":");
+	BOOST_CHECK_EQUAL (count(json, "trace_test_off"), 0);
+	BOOST_CHECK_EQUAL (count(json, "trace_test_stopped"), 0);
+	BOOST_CHECK_EQUAL (count(json, "\"name\":\"trace_test_span\",\"ph\":\"X\""), 1);
+	BOOST_CHECK_EQUAL (count(json, "\"args\":{\"frame\":42}"), 1);
+	BOOST_CHECK_EQUAL (count(json, "\"name\":\"trace_test_other\""), 4);
+	BOOST_CHECK_EQUAL (count(json, "\"args\":{\"name\":\"TraceTestThread\"}"), 1);
+	BOOST_CHECK_EQUAL (count(json, "\"name\":\"trace_test_timer: one\""), 1);
+	BOOST_CHECK_EQUAL (count(json, "\"name\":\"trace_test_timer: two\""), 1);
+
+	trace->clear ();
+}
+
+
+/** Check that a thread's buffer keeps the most recent spans once it fills up */
+BOOST_AUTO_TEST_CASE (trace_wrap_test)
+{
+	boost::filesystem::path const path = "build/test/trace_wrap_test.json";
+
+	auto trace = Trace::instance();
+	trace->clear ();
+	trace->start (path);
+
+	auto thread = boost::thread([]() {
+		for (int i = 0; i < 20000; ++i) {
+			TraceSpan span(i < 10000 ? "trace_wrap_old" : "trace_wrap_new", i);
+		}
+	});
+	thread.join ();
+
+	trace->write ();
+	trace->stop ();
+
+	auto const json = dcp::file_to_string (path, 16 * 1024 * 1024);
+	BOOST_CHECK_EQUAL (count(json, "\"name\":\"trace_wrap_new\""), 10000);
+	BOOST_CHECK_EQUAL (count(json, "\"name\":\"trace_wrap_old\""), 16384 - 10000);
+	BOOST_CHECK_EQUAL (count(json, "\"args\":{\"frame\":19999}"), 1);
+	BOOST_CHECK_EQUAL (count(json, "\"args\":{\"frame\":0}"), 0);
+
+	trace->clear ();
+}
@@ -26,12 +26,17 @@
 
 
 #include "lib/util.h"
+#include "lib/compose.hpp"
 #include "lib/cross.h"
+#include "lib/digest_cache.h"
 #include "lib/exceptions.h"
 #include "test.h"
+#include <dcp/array_data.h>
 #include <dcp/certificate_chain.h>
+#include <dcp/util.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/bind/bind.hpp>
+#include <algorithm>
 
 
 using std::list;
@@ -66,6 +71,41 @@ BOOST_AUTO_TEST_CASE (digest_head_tail_test)
 }
 
 
+BOOST_AUTO_TEST_CASE (simple_digest_cache_test)
+{
+	boost::filesystem::path const dir = "build/test/simple_digest_cache_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	vector<boost::filesystem::path> files;
+	for (int i = 0; i < 500; ++i) {
+		auto const file = dir / String::compose("%1.dat", i);
+		dcp::write_string_to_file (String::compose("frame %1", i), file);
+		files.push_back (file);
+	}
+
+	DigestCache::instance()->clear();
+	auto const digest = simple_digest(files);
+	BOOST_CHECK_EQUAL (digest, digest_head_tail(files, 1000000) + "7");
+	/* Without a change we should get the same thing from the cache */
+	BOOST_CHECK_EQUAL (simple_digest(files), digest);
+
+	/* The key must not grow with the length of a sequence of big files */
+	for (int i = 0; i < 500; ++i) {
+		dcp::write_string_to_file (string(4000, 'x'), files[i]);
+	}
+	auto const lines = [](string key) {
+		return std::count(key.begin(), key.end(), '\n');
+	};
+	BOOST_CHECK (lines(DigestCache::key(files, 8000)) <= 2 * 2 + DigestCache::sample_size);
+
+	/* Changing a file that the digest reads should change the digest */
+	auto const changed = simple_digest(files);
+	BOOST_CHECK (changed != digest);
+	BOOST_CHECK_EQUAL (changed, digest_head_tail(files, 1000000) + "4000");
+}
+
+
 BOOST_AUTO_TEST_CASE (timecode_test)
 {
 	auto t = DCPTime::from_seconds (2 * 60 * 60 + 4 * 60 + 31) + DCPTime::from_frames (19, 24);
@@ -148,3 +188,69 @@ BOOST_AUTO_TEST_CASE (copy_in_bits_test)
 		check_file ("build/test/random.dat", "build/test/random.dat2");
 	}
 }
+
+
+BOOST_AUTO_TEST_CASE (j2k_can_pass_through_test)
+{
+	/* SOC, SIZ for a 2K, 3-component 12-bit codestream, then some padding */
+	vector<uint8_t> header = {
+		0xff, 0x4f,
+		0xff, 0x51, 0x00, 0x2f, 0x00, 0x03,
+		0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x04, 0x38,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x04, 0x38,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x03,
+		0x0b, 0x01, 0x01,
+		0x0b, 0x01, 0x01,
+		0x0b, 0x01, 0x01
+	};
+	header.resize (1000);
+
+	auto check = [&header](int frames_per_second, int max_bandwidth) {
+		dcp::ArrayData data (header.data(), header.size());
+		return j2k_can_pass_through (data, frames_per_second, max_bandwidth);
+	};
+
+	BOOST_CHECK (check(24, 250000000));
+	/* Too big */
+	BOOST_CHECK (!check(24, 1000 * 8 * 24 - 1));
+	BOOST_CHECK (check(24, 1000 * 8 * 24));
+
+	/* No cinema profile */
+	header[7] = 0;
+	BOOST_CHECK (!check(24, 250000000));
+	header[7] = 4;
+	BOOST_CHECK (check(24, 250000000));
+
+	/* 8-bit component */
+	header[45] = 7;
+	BOOST_CHECK (!check(24, 250000000));
+	header[45] = 11;
+
+	/* Subsampled component */
+	header[49] = 2;
+	BOOST_CHECK (!check(24, 250000000));
+	header[49] = 1;
+
+	/* Not a codestream */
+	header[1] = 0;
+	BOOST_CHECK (!check(24, 250000000));
+	header[1] = 0x4f;
+
+	/* Truncated */
+	header.resize (40);
+	BOOST_CHECK (!check(24, 250000000));
+}
+
+
+BOOST_AUTO_TEST_CASE (parse_cpu_list_test)
+{
+	BOOST_CHECK (parse_cpu_list("0") == vector<int>({0}));
+	BOOST_CHECK (parse_cpu_list("0-3\n") == vector<int>({0, 1, 2, 3}));
+	BOOST_CHECK (parse_cpu_list("0-1,8-9,12") == vector<int>({0, 1, 8, 9, 12}));
+	BOOST_CHECK (parse_cpu_list("").empty());
+	BOOST_CHECK (parse_cpu_list("3-1").empty());
+	BOOST_CHECK (parse_cpu_list("0-").empty());
+	BOOST_CHECK (parse_cpu_list("1,,2").empty());
+}
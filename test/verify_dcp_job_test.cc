@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2024 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/verify_dcp_job_test.cc
+ *  @brief Test the quicker levels of VerifyDCPJob.
+ *  @ingroup completedcp
+ */
+
+
+#include "lib/config.h"
+#include "lib/content_factory.h"
+#include "lib/film.h"
+#include "lib/job_manager.h"
+#include "lib/verify_dcp_job.h"
+#include "test.h"
+#include <dcp/cpl.h>
+#include <dcp/dcp.h>
+#include <dcp/file.h>
+#include <dcp/reel.h>
+#include <dcp/reel_picture_asset.h>
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using std::vector;
+
+
+static vector<dcp::VerificationNote>
+verify (boost::filesystem::path dcp, VerifyDCPJob::Level level)
+{
+	auto job = make_shared<VerifyDCPJob>(vector<boost::filesystem::path>{dcp}, level, 0.5);
+	job->run ();
+	return job->notes ();
+}
+
+
+BOOST_AUTO_TEST_CASE (verify_dcp_job_quick_levels_test)
+{
+	auto film = new_test_film2 ("verify_dcp_job_quick_levels_test", content_factory("test/data/flat_red.png"));
+	make_and_verify_dcp (film);
+
+	auto const dcp = film->dir(film->dcp_name());
+
+	for (auto level: { VerifyDCPJob::Level::STRUCTURE, VerifyDCPJob::Level::HASHES, VerifyDCPJob::Level::SAMPLED_FRAMES }) {
+		BOOST_CHECK (verify(dcp, level).empty());
+	}
+
+	/* Change a byte in the middle of the picture asset, away from the MXF's header and footer */
+	auto const picture = find_file (dcp, "j2c_");
+	auto const middle = boost::filesystem::file_size(picture) / 2;
+	{
+		dcp::File file(picture, "r+b");
+		BOOST_REQUIRE (file);
+		file.seek (middle, SEEK_SET);
+		uint8_t byte = 0;
+		file.read (&byte, 1, 1);
+		file.seek (middle, SEEK_SET);
+		byte = ~byte;
+		file.write (&byte, 1, 1);
+	}
+
+	BOOST_CHECK (verify(dcp, VerifyDCPJob::Level::STRUCTURE).empty());
+
+	auto notes = verify (dcp, VerifyDCPJob::Level::HASHES);
+	BOOST_REQUIRE_EQUAL (notes.size(), 1U);
+	BOOST_CHECK (notes[0].code() == dcp::VerificationNote::Code::INCORRECT_PICTURE_HASH);
+}
+
+
+/** Digests which are given to the job should be used rather than reading the assets */
+BOOST_AUTO_TEST_CASE (verify_dcp_job_known_digests_test)
+{
+	auto film = new_test_film2 ("verify_dcp_job_known_digests_test", content_factory("test/data/flat_red.png"));
+	make_and_verify_dcp (film);
+
+	auto const dcp_dir = film->dir(film->dcp_name());
+	dcp::DCP dcp(dcp_dir);
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+	BOOST_REQUIRE_EQUAL (dcp.cpls()[0]->reels().size(), 1U);
+	auto picture = dcp.cpls()[0]->reels()[0]->main_picture();
+	BOOST_REQUIRE (picture);
+
+	auto job = make_shared<VerifyDCPJob>(vector<boost::filesystem::path>{dcp_dir}, VerifyDCPJob::Level::HASHES);
+	job->set_known_digests ({{ picture->asset_ref().id(), "not-the-right-digest" }});
+	job->run ();
+	auto notes = job->notes();
+	BOOST_REQUIRE_EQUAL (notes.size(), 1U);
+	BOOST_CHECK (notes[0].code() == dcp::VerificationNote::Code::INCORRECT_PICTURE_HASH);
+}
+
+
+/** With verify_after_make_dcp set, making a DCP should also check it */
+BOOST_AUTO_TEST_CASE (verify_after_make_dcp_test)
+{
+	Config::instance()->set_verify_after_make_dcp (true);
+
+	auto film = new_test_film2 ("verify_after_make_dcp_test", content_factory("test/data/flat_red.png"));
+	make_and_verify_dcp (film);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	auto const jobs = JobManager::instance()->get();
+	BOOST_CHECK (std::find_if(jobs.begin(), jobs.end(), [](std::shared_ptr<Job> job) {
+		return std::dynamic_pointer_cast<VerifyDCPJob>(job) && job->finished_ok();
+	}) != jobs.end());
+
+	Config::instance()->set_verify_after_make_dcp (false);
+}
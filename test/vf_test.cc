@@ -32,6 +32,7 @@
 #include "lib/film.h"
 #include "lib/player.h"
 #include "lib/referenced_reel_asset.h"
+#include "lib/verify_dcp_job.h"
 #include "lib/video_content.h"
 #include "test.h"
 #include <dcp/cpl.h>
@@ -95,6 +96,48 @@ BOOST_AUTO_TEST_CASE (vf_test1)
 }
 
 
+/** Check that answers from can_reference_*() are kept until the film or its content changes */
+BOOST_AUTO_TEST_CASE (vf_can_reference_cache_test)
+{
+	auto film = new_test_film ("vf_can_reference_cache_test");
+	film->set_interop (false);
+	auto dcp = make_shared<DCPContent>("test/data/reels_test2");
+	film->examine_and_add_content (dcp);
+	BOOST_REQUIRE (!wait_for_jobs());
+	film->set_reel_type (ReelType::SINGLE);
+
+	string why_not;
+	BOOST_CHECK (!dcp->can_reference_video(film, why_not));
+	auto const first_why_not = why_not;
+	BOOST_CHECK (!first_why_not.empty());
+
+	/* Asking again gives the same answer, and asking changes nothing */
+	auto const change = film->change_count();
+	why_not = "";
+	BOOST_CHECK (!dcp->can_reference_video(film, why_not));
+	BOOST_CHECK_EQUAL (why_not, first_why_not);
+	BOOST_CHECK (dcp->can_reference_audio(film, why_not) == dcp->can_reference_audio(film, why_not));
+	BOOST_CHECK_EQUAL (film->change_count(), change);
+
+	/* A change to the film is noticed */
+	film->set_reel_type (ReelType::BY_VIDEO_CONTENT);
+	BOOST_CHECK (film->change_count() != change);
+	why_not = "";
+	BOOST_CHECK (dcp->can_reference_video(film, why_not));
+	BOOST_CHECK (why_not.empty());
+	BOOST_CHECK (dcp->can_reference_audio(film, why_not));
+
+	/* and so is a change to some content */
+	auto other = make_shared<FFmpegContent>("test/data/test.mp4");
+	film->examine_and_add_content (other);
+	BOOST_REQUIRE (!wait_for_jobs());
+	other->set_position (film, DCPTime());
+	BOOST_CHECK (!dcp->can_reference_video(film, why_not));
+	other->set_position (film, dcp->end(film));
+	BOOST_CHECK (dcp->can_reference_video(film, why_not));
+}
+
+
 /** Make a OV with video and audio and a VF referencing the OV and adding subs */
 BOOST_AUTO_TEST_CASE (vf_test2)
 {
@@ -397,3 +440,40 @@ BOOST_AUTO_TEST_CASE (test_vf_with_trimmed_multi_reel_dcp)
 	make_and_verify_dcp (vf, { dcp::VerificationNote::Code::EXTERNAL_ASSET });
 }
 
+
+
+/** Check that a VF is verified along with its OV, and apart from an unrelated DCP */
+BOOST_AUTO_TEST_CASE (vf_verified_with_ov)
+{
+	auto ov = new_test_film2 ("vf_verified_with_ov_ov", content_factory("test/data/flat_red.png"));
+	make_and_verify_dcp (ov);
+
+	auto other = new_test_film2 ("vf_verified_with_ov_other", content_factory("test/data/flat_red.png"));
+	make_and_verify_dcp (other);
+
+	auto vf_dcp = make_shared<DCPContent>(ov->dir(ov->dcp_name()));
+	auto vf = new_test_film2 ("vf_verified_with_ov_vf", { vf_dcp, content_factory("test/data/white.wav")[0] });
+	vf_dcp->set_reference_video (true);
+	make_and_verify_dcp (vf, { dcp::VerificationNote::Code::EXTERNAL_ASSET });
+
+	auto const ov_dir = ov->dir(ov->dcp_name());
+	auto const other_dir = other->dir(other->dcp_name());
+	auto const vf_dir = vf->dir(vf->dcp_name());
+
+	auto groups = VerifyDCPJob::independent_groups ({ vf_dir, other_dir, ov_dir });
+	BOOST_REQUIRE_EQUAL (groups.size(), 2U);
+	std::sort (groups.begin(), groups.end(), [](std::vector<boost::filesystem::path> const& a, std::vector<boost::filesystem::path> const& b) {
+		return a.size() < b.size();
+	});
+	BOOST_REQUIRE_EQUAL (groups[0].size(), 1U);
+	BOOST_CHECK (groups[0][0] == other_dir);
+	BOOST_REQUIRE_EQUAL (groups[1].size(), 2U);
+	BOOST_CHECK (groups[1][0] == vf_dir);
+	BOOST_CHECK (groups[1][1] == ov_dir);
+
+	auto job = make_shared<VerifyDCPJob>(std::vector<boost::filesystem::path>{ vf_dir, other_dir, ov_dir });
+	job->run ();
+	for (auto note: job->notes()) {
+		BOOST_CHECK (note.type() != dcp::VerificationNote::Type::ERROR);
+	}
+}
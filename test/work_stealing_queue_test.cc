@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2022 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "lib/work_stealing_queue.h"
+#include <boost/test/unit_test.hpp>
+#include <set>
+
+
+using std::set;
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (work_stealing_queue_steal_test)
+{
+	WorkStealingQueue<int> queue (4);
+
+	for (int i = 0; i < 8; ++i) {
+		queue.push_back (i);
+	}
+	BOOST_CHECK_EQUAL (queue.size(), 8U);
+
+	/* A single worker should see everything, taking from its own deque and then stealing */
+	set<int> seen;
+	while (auto i = queue.try_pop(1)) {
+		seen.insert (*i);
+	}
+
+	BOOST_CHECK_EQUAL (seen.size(), 8U);
+	BOOST_CHECK (queue.empty());
+	BOOST_CHECK (!queue.try_pop(0));
+}
+
+
+/** Check that a worker steals from deques in its own group before the others */
+BOOST_AUTO_TEST_CASE (work_stealing_queue_groups_test)
+{
+	WorkStealingQueue<int> queue (4, 2);
+
+	/* Item i goes into deque i; deques 0 and 2 are in group 0, 1 and 3 in group 1 */
+	for (int i = 0; i < 4; ++i) {
+		queue.push_back (i);
+	}
+
+	vector<int> taken;
+	while (auto i = queue.try_pop(0)) {
+		taken.push_back (*i);
+	}
+
+	BOOST_CHECK (taken == vector<int>({0, 2, 1, 3}));
+}
+
+
+BOOST_AUTO_TEST_CASE (work_stealing_queue_push_front_test)
+{
+	WorkStealingQueue<int> queue (2);
+
+	queue.push_back (0);
+	queue.push_back (1);
+	queue.push_front (0, 42);
+
+	BOOST_CHECK_EQUAL (queue.pop(0), 42);
+	BOOST_CHECK_EQUAL (queue.pop(0), 0);
+	BOOST_CHECK_EQUAL (queue.pop(0), 1);
+
+	queue.push_back (2);
+	queue.push_back (3);
+	auto left = queue.drain ();
+	BOOST_REQUIRE_EQUAL (left.size(), 2U);
+	BOOST_CHECK (queue.empty());
+}
+
+
+/** Check that items are not lost or duplicated with many workers and a limited queue size */
+BOOST_AUTO_TEST_CASE (work_stealing_queue_threads_test)
+{
+	int const workers = 8;
+	int const items = 20000;
+
+	WorkStealingQueue<int> queue (4);
+	vector<vector<int>> taken (workers);
+
+	boost::thread_group threads;
+	for (int i = 0; i < workers; ++i) {
+		threads.create_thread ([&queue, &taken, i]() {
+			try {
+				while (true) {
+					taken[i].push_back (queue.pop(i));
+				}
+			} catch (boost::thread_interrupted&) {}
+		});
+	}
+
+	for (int i = 0; i < items; ++i) {
+		queue.wait_for_space (16);
+		queue.push_back (i);
+	}
+
+	while (!queue.empty()) {
+		queue.wait_for_space (1);
+	}
+
+	threads.interrupt_all ();
+	threads.join_all ();
+
+	set<int> all;
+	size_t total = 0;
+	for (auto const& i: taken) {
+		all.insert (i.begin(), i.end());
+		total += i.size();
+	}
+
+	BOOST_CHECK_EQUAL (total, static_cast<size_t>(items));
+	BOOST_CHECK_EQUAL (all.size(), static_cast<size_t>(items));
+}
@@ -67,3 +67,30 @@ BOOST_AUTO_TEST_CASE (zipper_test2, * boost::unit_test::depends_on("zipper_test1
 	BOOST_CHECK_THROW (Zipper("build/test/zipped.zip"), FileError);
 }
 
+
+
+#ifdef DCPOMATIC_HAVE_ZIP_SOURCE_T
+/** Check that a ZIP file made in memory is the same as one written straight to disk */
+BOOST_AUTO_TEST_CASE (zipper_memory_test, * boost::unit_test::depends_on("zipper_test1"))
+{
+	Zipper zipper;
+	zipper.add ("foo.txt", "1234567890");
+	zipper.add ("bar.txt", "xxxxxxCCCCbbbbbbb1");
+	zipper.close ();
+
+	zipper.data().write("build/test/zipped_in_memory.zip");
+
+	boost::system::error_code ec;
+	boost::filesystem::remove_all ("build/test/zipper_memory_test", ec);
+#ifdef DCPOMATIC_WINDOWS
+	boost::filesystem::create_directories ("build/test/zipper_memory_test");
+	int const r = system ("tar -xf build\\test\\zipped_in_memory.zip -C build\\test\\zipper_memory_test");
+#else
+	int const r = system ("unzip build/test/zipped_in_memory.zip -d build/test/zipper_memory_test");
+#endif
+	BOOST_REQUIRE_EQUAL (r, 0);
+
+	BOOST_CHECK_EQUAL (dcp::file_to_string("build/test/zipper_memory_test/foo.txt"), "1234567890");
+	BOOST_CHECK_EQUAL (dcp::file_to_string("build/test/zipper_memory_test/bar.txt"), "xxxxxxCCCCbbbbbbb1");
+}
+#endif